@@ -15,7 +15,9 @@ limitations under the License.
 
 #include "tensorflow/cc/saved_model/loader.h"
 
+#include <memory>
 #include <unordered_set>
+#include <utility>
 
 #include "tensorflow/cc/saved_model/constants.h"
 #include "tensorflow/cc/saved_model/loader_util.h"
@@ -41,6 +43,7 @@ limitations under the License.
 #include "tensorflow/core/protobuf/saver.pb.h"
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/tensor_bundle/naming.h"
 
 namespace tensorflow {
@@ -171,20 +174,15 @@ void AddAssetsTensorsToInputs(const StringPiece export_dir,
 // right after ReleaseCallable returns.
 //
 // However, the resource manager state remains.
-Status RunOnce(const RunOptions& run_options,
-               const std::vector<std::pair<string, Tensor>>& inputs,
-               const std::vector<string>& output_tensor_names,
-               const std::vector<string>& target_node_names,
-               std::vector<Tensor>* outputs, RunMetadata* run_metadata,
-               Session* session) {
+CallableOptions MakeCallableOptions(
+    const RunOptions& run_options,
+    const std::vector<std::pair<string, Tensor>>& inputs,
+    const std::vector<string>& output_tensor_names,
+    const std::vector<string>& target_node_names) {
   CallableOptions callable_options;
-  std::vector<Tensor> feed_tensors;
   *callable_options.mutable_run_options() = run_options;
   for (const auto& input : inputs) {
-    const string& name = input.first;
-    const Tensor& tensor = input.second;
-    callable_options.add_feed(name);
-    feed_tensors.push_back(tensor);
+    callable_options.add_feed(input.first);
   }
   for (const string& output_tensor_name : output_tensor_names) {
     callable_options.add_fetch(output_tensor_name);
@@ -192,9 +190,20 @@ Status RunOnce(const RunOptions& run_options,
   for (const string& target_node_name : target_node_names) {
     callable_options.add_target(target_node_name);
   }
+  return callable_options;
+}
 
-  Session::CallableHandle callable_handle;
-  TF_RETURN_IF_ERROR(session->MakeCallable(callable_options, &callable_handle));
+// Runs a callable made from MakeCallableOptions(..., inputs, ...) once and
+// releases it.
+Status RunCallableOnce(Session::CallableHandle callable_handle,
+                       const std::vector<std::pair<string, Tensor>>& inputs,
+                       std::vector<Tensor>* outputs, RunMetadata* run_metadata,
+                       Session* session) {
+  std::vector<Tensor> feed_tensors;
+  feed_tensors.reserve(inputs.size());
+  for (const auto& input : inputs) {
+    feed_tensors.push_back(input.second);
+  }
   const Status run_status = session->RunCallable(callable_handle, feed_tensors,
                                                  outputs, run_metadata);
   // Be sure to call ReleaseCallable() regardless of the outcome of
@@ -203,6 +212,68 @@ Status RunOnce(const RunOptions& run_options,
   return run_status;
 }
 
+Status RunOnce(const RunOptions& run_options,
+               const std::vector<std::pair<string, Tensor>>& inputs,
+               const std::vector<string>& output_tensor_names,
+               const std::vector<string>& target_node_names,
+               std::vector<Tensor>* outputs, RunMetadata* run_metadata,
+               Session* session) {
+  Session::CallableHandle callable_handle;
+  TF_RETURN_IF_ERROR(session->MakeCallable(
+      MakeCallableOptions(run_options, inputs, output_tensor_names,
+                          target_node_names),
+      &callable_handle));
+  return RunCallableOnce(callable_handle, inputs, outputs, run_metadata,
+                         session);
+}
+
+// Added by Alpa. Makes the callable of the init op on another thread, so that
+// pruning, optimizing and instantiating the init graph overlaps with the
+// variable restore. The init op itself still runs after the restore.
+class InitOpPreparer {
+ public:
+  InitOpPreparer(const RunOptions& run_options, const string& export_dir,
+                 const std::vector<AssetFileDef>& asset_file_defs,
+                 Session* session, const string& init_op_name)
+      : session_(session) {
+    AddAssetsTensorsToInputs(export_dir, asset_file_defs, &inputs_);
+    CallableOptions callable_options =
+        MakeCallableOptions(run_options, inputs_, {}, {init_op_name});
+    thread_.reset(Env::Default()->StartThread(
+        ThreadOptions(), "saved_model_prepare_init_op",
+        [this, callable_options = std::move(callable_options)]() {
+          status_ = session_->MakeCallable(callable_options, &handle_);
+        }));
+  }
+
+  // Releases the callable if it was not run.
+  ~InitOpPreparer() {
+    thread_.reset();
+    if (status_.ok() && !ran_) {
+      session_->ReleaseCallable(handle_).IgnoreError();
+    }
+  }
+
+  // Waits for the callable and runs it once.
+  Status Run() {
+    thread_.reset();
+    TF_RETURN_IF_ERROR(status_);
+    LOG(INFO) << "Running prepared initialization op on SavedModel bundle.";
+    ran_ = true;
+    RunMetadata run_metadata;
+    return RunCallableOnce(handle_, inputs_, nullptr /* outputs */,
+                           &run_metadata, session_);
+  }
+
+ private:
+  Session* session_;
+  std::vector<std::pair<string, Tensor>> inputs_;
+  std::unique_ptr<Thread> thread_;
+  Status status_;
+  Session::CallableHandle handle_;
+  bool ran_ = false;
+};
+
 // RunInitOp will return OK if the initialization op was run successfully.
 // An empty init_op_name indicates that there are no init ops to run.
 Status RunInitOp(const RunOptions& run_options, const string& export_dir,
@@ -432,6 +503,24 @@ Status RestoreSession(const RunOptions& run_options,
   const uint64 read_start_microseconds = Env::Default()->NowMicros();
   std::vector<AssetFileDef> asset_file_defs;
   TF_RETURN_IF_ERROR(internal::GetAssetFileDefs(meta_graph, &asset_file_defs));
+
+  // Added by Alpa. Optionally prepares the init graph while the variables are
+  // restored.
+  string init_op_name;
+  TF_RETURN_IF_ERROR(
+      internal::GetInitOp(export_dir, meta_graph, &init_op_name));
+  bool prepare_init_op_during_restore;
+  TF_RETURN_IF_ERROR(
+      ReadBoolFromEnvVar("TF_SAVED_MODEL_PREPARE_INIT_OP_DURING_RESTORE",
+                         false, &prepare_init_op_during_restore));
+  std::unique_ptr<InitOpPreparer> init_op_preparer;
+  if (prepare_init_op_during_restore && meta_graph.has_saver_def() &&
+      !init_op_name.empty()) {
+    init_op_preparer = std::make_unique<InitOpPreparer>(
+        run_options, export_dir, asset_file_defs, session->get(),
+        init_op_name);
+  }
+
   if (meta_graph.has_saver_def()) {
     TF_RETURN_IF_ERROR(RunRestore(run_options, export_dir,
                                   meta_graph.saver_def().restore_op_name(),
@@ -444,11 +533,13 @@ Status RestoreSession(const RunOptions& run_options,
       GetLatencyMicroseconds(read_start_microseconds);
 
   const uint64 graph_init_start_microseconds = Env::Default()->NowMicros();
-  string init_op_name;
-  TF_RETURN_IF_ERROR(
-      internal::GetInitOp(export_dir, meta_graph, &init_op_name));
-  TF_RETURN_IF_ERROR(RunInitOp(run_options, export_dir, meta_graph,
-                               asset_file_defs, session->get(), init_op_name));
+  if (init_op_preparer != nullptr) {
+    TF_RETURN_IF_ERROR(init_op_preparer->Run());
+  } else {
+    TF_RETURN_IF_ERROR(RunInitOp(run_options, export_dir, meta_graph,
+                                 asset_file_defs, session->get(),
+                                 init_op_name));
+  }
   load_latency_by_stage->GetCell(export_dir, "restore_graph")
       ->Add(restore_graph_walltime);
   // Record wall time spent in init op.
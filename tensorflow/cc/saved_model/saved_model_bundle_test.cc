@@ -289,6 +289,21 @@ TEST_F(LoaderTest, SavedModelInitOpV2Format) {
   CheckSavedModelBundle(export_dir, bundle);
 }
 
+TEST_F(LoaderTest, PrepareInitOpDuringRestore) {
+  setenv("TF_SAVED_MODEL_PREPARE_INIT_OP_DURING_RESTORE", "true",
+         /*overwrite=*/1);
+  SavedModelBundle bundle;
+  SessionOptions session_options;
+  RunOptions run_options;
+
+  const string export_dir =
+      io::JoinPath(testing::TensorFlowSrcRoot(), kTestDataInitOpV2);
+  TF_ASSERT_OK(LoadSavedModel(session_options, run_options, export_dir,
+                              {kSavedModelTagServe}, &bundle));
+  CheckSavedModelBundle(export_dir, bundle);
+  unsetenv("TF_SAVED_MODEL_PREPARE_INIT_OP_DURING_RESTORE");
+}
+
 TEST_F(LoaderTest, SavedModelV2DebugInfo) {
   SavedModelBundle bundle;
   SessionOptions session_options;
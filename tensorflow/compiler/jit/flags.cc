@@ -155,7 +155,12 @@ void AppendMarkForCompilationPassFlagsInternal(std::vector<Flag>* flag_list) {
       Flag("tf_xla_persistent_cache_prefix",
            &mark_for_compilation_flags->tf_xla_persistent_cache_prefix,
            "Specifies the persistance cache prefix. Default is "
-           "\"xla_compile_cache\"")};
+           "\"xla_compile_cache\""),
+      Flag("tf_xla_cost_based_clustering",
+           &mark_for_compilation_flags->tf_xla_cost_based_clustering,
+           "If true, do not auto-cluster subgraphs with too few fusible "
+           "operations, or subgraphs whose earlier clusters were found to "
+           "recompile too often for shape changes.")};
   flag_list->insert(flag_list->end(), new_flags.begin(), new_flags.end());
 }
 
@@ -206,6 +211,7 @@ void AllocateAndParseFlags() {
   mark_for_compilation_flags->tf_xla_disable_strict_signature_checks = false;
   mark_for_compilation_flags->tf_xla_persistent_cache_prefix =
       "xla_compile_cache";
+  mark_for_compilation_flags->tf_xla_cost_based_clustering = false;
 
   device_flags = new XlaDeviceFlags;
   device_flags->tf_xla_compile_on_demand = false;
@@ -214,6 +220,7 @@ void AllocateAndParseFlags() {
   ops_flags = new XlaOpsCommonFlags;
   ops_flags->tf_xla_always_defer_compilation = false;
   ops_flags->tf_xla_async_compilation = false;
+  ops_flags->tf_xla_async_compilation_threads = 10;
 
   jitter_flags = new IntroduceFloatingPointJitterPassFlags;
   jitter_flags->jitter_amount = 1e-5;
@@ -231,6 +238,8 @@ void AllocateAndParseFlags() {
   bool mlir_bridge_safe_mode = false;
   bool enable_mlir_merge_control_flow_pass = true;
   bool enable_mlir_convert_control_to_data_outputs_pass = false;
+  int32 mlir_bridge_num_threads = 0;
+  int32 mlir_legalization_cache_size = 0;
   auto setter_for_jitter_tensor_names = [](string sequence) {
     jitter_flags->tensor_names = absl::StrSplit(sequence, ',');
     return true;
@@ -274,6 +283,11 @@ void AllocateAndParseFlags() {
             "When lazy compilation is enabled, asynchronous compilation starts "
             "the cluster compilation in the background, and the fallback path "
             "is executed until the compilation has finished."),
+       Flag("tf_xla_async_compilation_threads",
+            &ops_flags->tf_xla_async_compilation_threads,
+            "Number of background threads used for asynchronous compilation. "
+            "At most this many clusters are compiled concurrently; further "
+            "requests keep running the fallback path until a thread is free."),
 
        Flag("tf_introduce_floating_point_jitter_to_tensors",
             setter_for_jitter_tensor_names, "",
@@ -295,6 +309,15 @@ void AllocateAndParseFlags() {
             &enable_mlir_convert_control_to_data_outputs_pass,
             "Enables `tf-executor-convert-control-to-data-outputs` pass for "
             "MLIR-Based TensorFlow Compiler Bridge."),
+       Flag("tf_mlir_bridge_num_threads", &mlir_bridge_num_threads,
+            "Number of threads shared by the MLIR-Based TensorFlow Compiler "
+            "Bridge to run the passes of the functions of a module "
+            "concurrently. If 0, each compilation creates its own threads."),
+       Flag("tf_mlir_legalization_cache_size", &mlir_legalization_cache_size,
+            "Maximum number of modules whose legalization to HLO is cached by "
+            "the MLIR-Based TensorFlow Compiler Bridge, so that retracing an "
+            "unchanged function does not legalize it again. 0 disables the "
+            "cache."),
        Flag(
            "tf_mlir_bridge_safe_mode", &mlir_bridge_safe_mode,
            "When tf_mlir_enable_mlir_bridge is true, this field can enable "
@@ -328,6 +351,8 @@ void AllocateAndParseFlags() {
       enable_mlir_merge_control_flow_pass;
   mlir_flags->tf_mlir_enable_convert_control_to_data_outputs_pass =
       enable_mlir_convert_control_to_data_outputs_pass;
+  mlir_flags->tf_mlir_bridge_num_threads = mlir_bridge_num_threads;
+  mlir_flags->tf_mlir_legalization_cache_size = mlir_legalization_cache_size;
 
   if (use_tfg_graph_dumper) {
     UseMlirForGraphDump(MlirDumpConfig{}.elide_large_attributes().emit_dialect(
@@ -100,6 +100,11 @@ struct MarkForCompilationPassFlags {
 
   // Specifies the persistance cache prefix. Default is "xla_compile_cache"
   string tf_xla_persistent_cache_prefix;
+
+  // If true, auto-clustering uses a cost model to leave clusters that are
+  // unlikely to benefit from XLA (too few fusible ops, or observed to
+  // recompile too often in an earlier instantiation) to the TF executor.
+  bool tf_xla_cost_based_clustering;
 };
 
 // Flags associated with the XLA bridge's xla_device module.
@@ -122,6 +127,9 @@ struct XlaOpsCommonFlags {
   // If true, _XlaCompile compiles the cluster asynchronously with respect to
   // the main execution. The fallback path is taken while compilation happens.
   bool tf_xla_async_compilation;
+  // Number of background threads used for asynchronous compilation. This also
+  // bounds the number of clusters that are compiled concurrently.
+  int32 tf_xla_async_compilation_threads;
 };
 
 // Flags for the build_xla_ops pass.
@@ -164,6 +172,14 @@ struct MlirCommonFlags {
 
   bool tf_mlir_enable_merge_control_flow_pass;
   bool tf_mlir_enable_convert_control_to_data_outputs_pass;
+
+  // Number of threads of the pool shared by the MLIR contexts of the bridge,
+  // which run the function passes of a module concurrently. If 0, each
+  // context creates its own pool.
+  int32 tf_mlir_bridge_num_threads;
+  // Maximum number of modules whose legalization to HLO is cached, keyed by
+  // the module before legalization. 0 disables the cache.
+  int32 tf_mlir_legalization_cache_size;
 };
 
 // Flags for the JitRt pipeline -- see tf_jitrt_pipeline.h for details.
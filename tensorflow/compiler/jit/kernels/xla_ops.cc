@@ -658,12 +658,17 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
     const Status status = CompileToLocalExecutable(
         ctx, function_, has_ref_vars_, platform_info_, args, compile_mode,
         /*may_alias_resource_update=*/false, &client, &kernel, &executable);
-    if (compile_mode != XlaCompilationCache::CompileMode::kLazy ||
-        status.code() != error::UNIMPLEMENTED) {
+    // With asynchronous compilation the fallback path has been serving this
+    // cluster all along, so a failed background compilation keeps using it
+    // instead of failing the step.
+    const bool can_fall_back =
+        compile_mode == XlaCompilationCache::CompileMode::kAsync
+            ? !status.ok()
+            : compile_mode == XlaCompilationCache::CompileMode::kLazy &&
+                  status.code() == error::UNIMPLEMENTED;
+    if (!can_fall_back) {
       OP_REQUIRES_OK(ctx, status);
-    }
-
-    if (status.code() == error::UNIMPLEMENTED) {
+    } else {
       LOG(WARNING) << "Compilation failed:" << status.ToString()
                    << ".  Falling back to TF function call.";
 
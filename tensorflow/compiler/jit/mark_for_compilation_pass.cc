@@ -115,6 +115,10 @@ class MarkForCompilationPassImpl {
     std::atomic<int64_t>* fuel;
 
     bool dump_graphs;
+
+    // If true, clusters that are unlikely to benefit from XLA are not
+    // compiled.  See `FindUnprofitableClusters`.
+    bool cost_based_clustering;
   };
 
   MarkForCompilationPassImpl(DebugOptions debug_options, Graph* graph,
@@ -300,6 +304,18 @@ class MarkForCompilationPassImpl {
   // tf_xla_min_cluster_size, are applied here.
   Status CreateClusters();
 
+  // Returns the auto-clusters that the cost model expects to run slower under
+  // XLA than in the TF executor:
+  // * clusters whose members previously formed a cluster that went
+  //   megamorphic (recompiled for too many distinct shapes), and
+  // * clusters with too few fusible ops to pay for their compilation.
+  // Clusters that must be compiled (explicit _XlaCompile, functional control
+  // flow or XLA devices) are never returned.
+  StatusOr<absl::flat_hash_set<const Cluster*>> FindUnprofitableClusters();
+
+  // Returns true if `cluster` is placed on a device that always compiles.
+  StatusOr<bool> IsCompilationMandatory(const Cluster& cluster);
+
   Status DumpDebugInfo();
 
   bool IsCompilationCandidate(Node* n) const {
@@ -450,6 +466,8 @@ class MarkForCompilationPassImpl {
   OptimizerOptions::GlobalJitLevel global_jit_level_;
   bool cpu_global_jit_;
   absl::flat_hash_map<const Cluster*, bool> should_compile_cluster_cache_;
+  // Member fingerprints of clusters considered by the cost model.
+  absl::flat_hash_map<const Cluster*, uint64> cluster_fingerprints_;
   jit::DeviceInfoCache device_info_cache_;
 
   bool initialized_ = false;
@@ -942,17 +960,23 @@ Status MarkForCompilationPassImpl::CreateClusters() {
     DumpGraphToFile("before_mark_for_compilation", *graph_, flib_def_);
   }
 
+  absl::flat_hash_set<const Cluster*> unprofitable_clusters;
+  if (debug_options_.cost_based_clustering) {
+    TF_ASSIGN_OR_RETURN(unprofitable_clusters, FindUnprofitableClusters());
+  }
+
   // Mark clusters for compilation that:
   // * are placed on a device that requires compilation (an XlaDevice),
   // * are explicitly marked for compilation (_XlaCompile=true), or
   // * have more than debug_options_.xla_min_cluster_size elements (applicable
   //   only if compilation is enabled, otherwise there will be no such
-  //   candidates).
+  //   candidates) and are not rejected by the cost model.
   for (Node* n : compilation_candidates_) {
     Cluster* cluster = GetClusterForNode(n);
     TF_ASSIGN_OR_RETURN(bool should_compile_cluster,
                         ShouldCompileCluster(*cluster));
-    if (!should_compile_cluster || declustered_nodes_.contains(n)) {
+    if (!should_compile_cluster || declustered_nodes_.contains(n) ||
+        unprofitable_clusters.contains(cluster)) {
       continue;
     }
 
@@ -974,6 +998,10 @@ Status MarkForCompilationPassImpl::CreateClusters() {
           name = absl::StrCat("cluster_",
                               GetNextClusterSequenceNumber(graph_fingerprint_));
         }
+        auto fingerprint_it = cluster_fingerprints_.find(cluster);
+        if (fingerprint_it != cluster_fingerprints_.end()) {
+          RegisterXlaClusterFingerprint(name, fingerprint_it->second);
+        }
       }
 
       n->AddAttr(kXlaClusterAttr, name);
@@ -985,6 +1013,68 @@ Status MarkForCompilationPassImpl::CreateClusters() {
   return OkStatus();
 }
 
+StatusOr<absl::flat_hash_set<const MarkForCompilationPassImpl::Cluster*>>
+MarkForCompilationPassImpl::FindUnprofitableClusters() {
+  // XLA's main win on auto-clustered graphs is fusing memory bound ops, which
+  // needs at least two fusible ops in a cluster.  We also require fusible ops
+  // to make up a minimum fraction of the cluster since compile time grows
+  // with cluster size while the fusion benefit does not.
+  constexpr int kMinFusibleOps = 2;
+  constexpr int kMaxOpsPerFusibleOp = 8;
+
+  static const auto* fusible_ops = [] {
+    auto* result = new absl::flat_hash_set<string>;
+    for (const char* category : {"PW", "RED", "PWRED", "BN"}) {
+      const std::vector<string>& ops = GetAllowlistTable()->at(category);
+      result->insert(ops.begin(), ops.end());
+    }
+    return result;
+  }();
+
+  absl::flat_hash_map<const Cluster*, std::vector<Node*>> cluster_members;
+  for (Node* n : compilation_candidates_) {
+    if (declustered_nodes_.contains(n)) continue;
+    cluster_members[GetClusterForNode(n)].push_back(n);
+  }
+
+  absl::flat_hash_set<const Cluster*> unprofitable;
+  for (const auto& [cluster, members] : cluster_members) {
+    if (cluster->is_xla_compile_attr_true() ||
+        cluster->has_functional_control_flow()) {
+      continue;
+    }
+    TF_ASSIGN_OR_RETURN(bool should_compile, ShouldCompileCluster(*cluster));
+    if (!should_compile) continue;
+    TF_ASSIGN_OR_RETURN(bool is_mandatory, IsCompilationMandatory(*cluster));
+    if (is_mandatory) continue;
+
+    const uint64 fingerprint = FingerprintClusterMembers(members);
+    cluster_fingerprints_[cluster] = fingerprint;
+    if (IsKnownMegamorphicXlaCluster(fingerprint)) {
+      VLOG(2) << "Not compiling " << cluster->DebugString(*graph_)
+              << ": an earlier cluster with the same nodes was megamorphic";
+      unprofitable.insert(cluster);
+      continue;
+    }
+
+    int num_fusible = 0;
+    for (const Node* n : members) {
+      if (!n->IsConstant() && !n->IsIdentity() &&
+          fusible_ops->contains(n->type_string())) {
+        ++num_fusible;
+      }
+    }
+    if (num_fusible < kMinFusibleOps ||
+        num_fusible * kMaxOpsPerFusibleOp < cluster->effective_cluster_size()) {
+      VLOG(2) << "Not compiling " << cluster->DebugString(*graph_) << ": "
+              << num_fusible << " fusible ops out of "
+              << cluster->effective_cluster_size();
+      unprofitable.insert(cluster);
+    }
+  }
+  return unprofitable;
+}
+
 Status MarkForCompilationPassImpl::DumpDebugInfo() {
   TF_RET_CHECK(initialized_ && edges_contracted_ && clusters_created_);
 
@@ -1805,6 +1895,19 @@ proper command-line flag, not via TF_XLA_FLAGS).)";
   return should_compile;
 }
 
+StatusOr<bool> MarkForCompilationPassImpl::IsCompilationMandatory(
+    const Cluster& cluster) {
+  TF_ASSIGN_OR_RETURN(DeviceId chosen_device,
+                      PickDeviceForXla(device_info_cache_, cluster.devices(),
+                                       /*allow_mixing_unknown_and_cpu=*/false));
+  const XlaOpRegistry::DeviceRegistration* registration =
+      device_info_cache_.GetCompilationDevice(chosen_device);
+  TF_RET_CHECK(registration)
+      << "chosen device = " << device_info_cache_.GetNameFor(chosen_device);
+  return registration->autoclustering_policy ==
+         XlaOpRegistry::AutoclusteringPolicy::kAlways;
+}
+
 StatusOr<bool> MarkForCompilationPassImpl::ShouldCompileCluster(
     const Cluster& cluster) {
   auto it = should_compile_cluster_cache_.find(&cluster);
@@ -1882,6 +1985,7 @@ Status MarkForCompilationPass::Run(
   debug_options.min_cluster_size = flags->tf_xla_min_cluster_size;
   debug_options.fuel = GetPointerToFuel(flags->tf_xla_clustering_fuel);
   debug_options.dump_graphs = flags->tf_xla_clustering_debug;
+  debug_options.cost_based_clustering = flags->tf_xla_cost_based_clustering;
 
   return MarkForCompilation(options, debug_options);
 }
@@ -1901,6 +2005,7 @@ Status MarkForCompilationPass::RunForTest(
   debug_options.min_cluster_size = flags->tf_xla_min_cluster_size;
   debug_options.fuel = GetPointerToFuel(flags->tf_xla_clustering_fuel);
   debug_options.dump_graphs = flags->tf_xla_clustering_debug;
+  debug_options.cost_based_clustering = flags->tf_xla_cost_based_clustering;
 
   return MarkForCompilation(options, debug_options);
 }
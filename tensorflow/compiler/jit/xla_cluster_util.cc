@@ -15,10 +15,14 @@ limitations under the License.
 
 #include "tensorflow/compiler/jit/xla_cluster_util.h"
 
+#include <algorithm>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/container/inlined_vector.h"
 #include "absl/strings/match.h"
 #include "absl/strings/numbers.h"
@@ -34,6 +38,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/proto_serialization.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow/core/util/device_name_utils.h"
 #include "tensorflow/core/util/xla_config_registry.h"
@@ -615,6 +620,57 @@ StatusOr<uint64> FingerprintGraph(const Graph& graph) {
   return Hash64(serialized.data(), serialized.size());
 }
 
+namespace {
+// Process wide history of auto-clusters, used to feed runtime behavior of
+// earlier clusters back into later clustering decisions.
+struct XlaClusterHistory {
+  mutex mu;
+  absl::flat_hash_map<std::string, uint64> fingerprint_for_name
+      TF_GUARDED_BY(mu);
+  absl::flat_hash_set<uint64> megamorphic_fingerprints TF_GUARDED_BY(mu);
+
+  static XlaClusterHistory& Global() {
+    static XlaClusterHistory* history = new XlaClusterHistory;
+    return *history;
+  }
+};
+}  // namespace
+
+uint64 FingerprintClusterMembers(absl::Span<Node* const> nodes) {
+  std::vector<std::string> members;
+  members.reserve(nodes.size());
+  for (const Node* n : nodes) {
+    members.push_back(absl::StrCat(n->name(), ":", n->type_string()));
+  }
+  std::sort(members.begin(), members.end());
+  uint64 fingerprint = 0;
+  for (const std::string& member : members) {
+    fingerprint = FingerprintCat64(fingerprint, Fingerprint64(member));
+  }
+  return fingerprint;
+}
+
+void RegisterXlaClusterFingerprint(absl::string_view cluster_name,
+                                   uint64 fingerprint) {
+  XlaClusterHistory& history = XlaClusterHistory::Global();
+  mutex_lock lock(history.mu);
+  history.fingerprint_for_name[cluster_name] = fingerprint;
+}
+
+void RecordMegamorphicXlaCluster(absl::string_view cluster_name) {
+  XlaClusterHistory& history = XlaClusterHistory::Global();
+  mutex_lock lock(history.mu);
+  auto it = history.fingerprint_for_name.find(cluster_name);
+  if (it == history.fingerprint_for_name.end()) return;
+  history.megamorphic_fingerprints.insert(it->second);
+}
+
+bool IsKnownMegamorphicXlaCluster(uint64 fingerprint) {
+  XlaClusterHistory& history = XlaClusterHistory::Global();
+  mutex_lock lock(history.mu);
+  return history.megamorphic_fingerprints.contains(fingerprint);
+}
+
 // Register a callback for querying XlaGlobalJitLevel.
 REGISTER_XLA_CONFIG_GETTER(GetXlaGlobalJitLevel);
 
@@ -23,6 +23,7 @@ limitations under the License.
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "tensorflow/compiler/jit/xla_activity.pb.h"
 #include "tensorflow/compiler/xla/service/graphcycles/graphcycles.h"
 #include "tensorflow/compiler/xla/statusor.h"
@@ -109,6 +110,25 @@ StatusOr<std::string> SerializeGraphDeterministic(const Graph& graph);
 // determining if the graphs are identical.
 StatusOr<uint64> FingerprintGraph(const Graph& graph);
 
+// Computes a fingerprint of an auto-cluster from the names and op types of its
+// member nodes.  Retracing a function usually reproduces the same clusters, so
+// this identifies "the same" cluster across graph instantiations.
+uint64 FingerprintClusterMembers(absl::Span<Node* const> nodes);
+
+// Associates the auto-cluster named `cluster_name` with the fingerprint of its
+// members, see `FingerprintClusterMembers`.
+void RegisterXlaClusterFingerprint(absl::string_view cluster_name,
+                                   uint64 fingerprint);
+
+// Records that the auto-cluster named `cluster_name` went megamorphic, i.e. it
+// recompiled too often for the number of times it ran.  No-op for clusters
+// that were not registered with `RegisterXlaClusterFingerprint`.
+void RecordMegamorphicXlaCluster(absl::string_view cluster_name);
+
+// Returns true if a cluster with member fingerprint `fingerprint` was
+// previously recorded as megamorphic in this process.
+bool IsKnownMegamorphicXlaCluster(uint64 fingerprint);
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_COMPILER_JIT_XLA_CLUSTER_UTIL_H_
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/jit/xla_compilation_cache.h"
 
+#include <algorithm>
 #include <memory>
 #include <numeric>
 #include <string>
@@ -141,7 +142,8 @@ std::string XlaSerializedCacheKeyToString(const XlaSerializedCacheKey& key) {
       key.prefix(), key.prefix().empty() ? "" : kXlaSerializedCacheKeySeparator,
       key.signature_fingerprint(), kXlaSerializedCacheKeySeparator,
       key.cluster_fingerprint(), kXlaSerializedCacheKeySeparator,
-      key.device_type());
+      key.device_type(), kXlaSerializedCacheKeySeparator,
+      key.compile_options_fingerprint());
 }
 
 }  // namespace
@@ -512,7 +514,8 @@ Status XlaCompilationCache::CompileStrict(
     const xla::HloModuleProto& hlo_module =
         entry->compilation_result.computation->proto();
 
-    XlaSerializedCacheKey cache_key = BuildSerializedCacheKey(sig, hlo_module);
+    XlaSerializedCacheKey cache_key =
+        BuildSerializedCacheKey(options, sig, entry->compilation_result);
 
     {
       XLA_SCOPED_LOGGING_TIMER(absl::StrCat(
@@ -583,6 +586,15 @@ Status XlaCompilationCache::CompileStrict(
   return OkStatus();
 }
 
+XlaCompilationCache::AsyncCompilationState::AsyncCompilationState()
+    : num_compiler_threads(std::max<int64_t>(
+          1, GetXlaOpsCommonFlags().tf_xla_async_compilation_threads)),
+      max_num_ongoing_compilations(num_compiler_threads) {
+  compiler_threads = std::make_unique<tensorflow::thread::ThreadPool>(
+      tensorflow::Env::Default(), "async_compiler_threads",
+      num_compiler_threads);
+}
+
 Status XlaCompilationCache::CompileAsynchronous(
     const Signature& signature, Entry* entry,
     const XlaCompiler::CompileOptions& compile_options,
@@ -669,7 +681,7 @@ bool XlaCompilationCache::ShouldCompileCluster(CompileMode compile_mode,
     // Asynchronous compilation is enabled.
     mutex_lock lock(async_compilation_state_.async_compilation_state_mu);
     if (async_compilation_state_.num_ongoing_compilations >=
-        async_compilation_state_.kMaxNumOngoingCompilations) {
+        async_compilation_state_.max_num_ongoing_compilations) {
       VLOG(2) << "Not asynchronously compiling cluster " << function.name()
               << " because of too many ongoing compilations.";
       return false;
@@ -790,6 +802,7 @@ Status XlaCompilationCache::CompileImpl(
               << " as megamorphic, compile_count=" << it->second.compile_count
               << " execution_count=" << it->second.execution_count;
       it->second.is_megamorphic = true;
+      RecordMegamorphicXlaCluster(function.name());
     }
 
     is_megamorphic = it->second.is_megamorphic;
@@ -864,13 +877,38 @@ Status XlaCompilationCache::CompileImpl(
 }
 
 XlaSerializedCacheKey XlaCompilationCache::BuildSerializedCacheKey(
-    const Signature& sig, const xla::HloModuleProto& hlo_module) const {
+    const XlaCompiler::Options& options, const Signature& sig,
+    const XlaCompiler::CompilationResult& result) const {
+  const xla::ExecutableBuildOptions build_options =
+      GetBuildOptions(options, result, client_->default_device_ordinal());
+  uint64 compile_options_fingerprint =
+      DeterministicProtoHash64(build_options.debug_options());
+  compile_options_fingerprint = FingerprintCat64(
+      compile_options_fingerprint, build_options.num_replicas());
+  compile_options_fingerprint = FingerprintCat64(
+      compile_options_fingerprint, build_options.alias_passthrough_params());
+  // Executables are not portable across device models (e.g. GPU compute
+  // capabilities), so the device description is part of the key.
+  StatusOr<se::StreamExecutor*> executor =
+      client_->backend().stream_executor(build_options.device_ordinal());
+  if (executor.ok()) {
+    const se::DeviceDescription& description =
+        (*executor)->GetDeviceDescription();
+    compile_options_fingerprint = FingerprintCat64(
+        compile_options_fingerprint, Fingerprint64(description.name()));
+    compile_options_fingerprint =
+        FingerprintCat64(compile_options_fingerprint,
+                         Fingerprint64(description.platform_version()));
+  }
+
   XlaSerializedCacheKey serialized_cache_key;
   serialized_cache_key.set_signature_fingerprint(Signature::Hash()(sig));
   serialized_cache_key.set_cluster_fingerprint(
-      DeterministicProtoHash64(hlo_module));
+      DeterministicProtoHash64(result.computation->proto()));
   serialized_cache_key.set_device_type(device_type_.type_string());
   serialized_cache_key.set_prefix(persistance_prefix_);
+  serialized_cache_key.set_compile_options_fingerprint(
+      compile_options_fingerprint);
   return serialized_cache_key;
 }
 
@@ -925,7 +963,8 @@ StatusOr<XlaSerializedCacheEntry> XlaCompilationCache::SerializeEntry(
   XlaSerializedCacheEntry serialized_entry;
   const xla::HloModuleProto& hlo_module =
       entry.compilation_result.computation->proto();
-  *serialized_entry.mutable_key() = BuildSerializedCacheKey(sig, hlo_module);
+  *serialized_entry.mutable_key() =
+      BuildSerializedCacheKey(options, sig, entry.compilation_result);
   *serialized_entry.mutable_hlo_module() = hlo_module;
 
   TF_ASSIGN_OR_RETURN(
@@ -953,7 +992,26 @@ Status XlaCompilationCache::SaveSerializedEntry(
   TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(persistent_cache_directory_));
   const std::string file_path =
       GetFilePath(entry.key(), persistent_cache_directory_);
-  return WriteBinaryProto(env, file_path, entry);
+  // Entries are immutable for a given key, so if another process sharing the
+  // directory already published this one there is nothing left to do.
+  if (env->FileExists(file_path).ok()) {
+    VLOG(2) << "Persistent cache entry already exists: " << file_path;
+    return OkStatus();
+  }
+
+  // Write to a unique temporary file first and rename it into place, so that
+  // concurrent readers never observe a partially written entry.
+  std::string temp_path = file_path;
+  if (!env->CreateUniqueFileName(&temp_path, ".tmp")) {
+    return errors::Internal("Failed to create a temporary file name for ",
+                            file_path);
+  }
+  TF_RETURN_IF_ERROR(WriteBinaryProto(env, temp_path, entry));
+  Status status = env->RenameFile(temp_path, file_path);
+  if (!status.ok()) {
+    env->DeleteFile(temp_path).IgnoreError();
+  }
+  return status;
 }
 
 StatusOr<std::optional<XlaSerializedCacheEntry>>
@@ -965,7 +1023,14 @@ XlaCompilationCache::TryLoadSerializedEntry(const XlaSerializedCacheKey& key) {
   }
 
   XlaSerializedCacheEntry entry;
-  TF_RETURN_IF_ERROR(ReadTextOrBinaryProto(env, file_path, &entry));
+  Status status = ReadTextOrBinaryProto(env, file_path, &entry);
+  if (!status.ok()) {
+    // A shared cache may contain entries written by other binaries; treat
+    // anything unreadable as a miss and recompile.
+    LOG(WARNING) << "Ignoring unreadable persistent cache entry " << file_path
+                 << ": " << status;
+    return StatusOr<std::optional<XlaSerializedCacheEntry>>(std::nullopt);
+  }
   return StatusOr<std::optional<XlaSerializedCacheEntry>>(entry);
 }
 
@@ -241,7 +241,8 @@ class XlaCompilationCache : public ResourceBase {
   // Returns a cache key proto that identifies an entry in the compilation
   // cache.
   XlaSerializedCacheKey BuildSerializedCacheKey(
-      const Signature& sig, const xla::HloModuleProto& hlo_module) const;
+      const XlaCompiler::Options& options, const Signature& sig,
+      const XlaCompiler::CompilationResult& result) const;
 
   // Serializes the signature and its corresponding entry to a proto message.
   StatusOr<XlaSerializedCacheEntry> SerializeEntry(
@@ -268,12 +269,15 @@ class XlaCompilationCache : public ResourceBase {
                              CompileScope scope);
 
   // Saves the cache entry in the file directory supplied during the
-  // construction of this class. Overwrites existing entries.
+  // construction of this class. The directory may be shared between processes
+  // (including on remote filesystems such as GCS): the entry is written to a
+  // temporary file and renamed into place, and an entry already published by
+  // another process is left untouched.
   Status SaveSerializedEntry(const XlaSerializedCacheEntry& entry);
 
   // Tries to load a cache entry given a `key` by searching the file directory
   // supplied during the construction of this class. Returns std::nullopt if no
-  // cache entry is found.
+  // cache entry is found or if the entry could not be parsed.
   StatusOr<std::optional<XlaSerializedCacheEntry>> TryLoadSerializedEntry(
       const XlaSerializedCacheKey& key);
 
@@ -306,11 +310,12 @@ class XlaCompilationCache : public ResourceBase {
   struct AsyncCompilationState {
     mutex async_compilation_state_mu;
 
-    // Number of threads for asynchronous compilations.
-    static constexpr int64_t kNumCompilerThreads = 10;
+    // Number of threads for asynchronous compilations, taken from
+    // --tf_xla_async_compilation_threads.
+    const int64_t num_compiler_threads;
 
     // Maximum number of ongoing compilations.
-    static constexpr int64_t kMaxNumOngoingCompilations = kNumCompilerThreads;
+    const int64_t max_num_ongoing_compilations;
 
     // Number of ongoing compilations.
     int64_t num_ongoing_compilations TF_GUARDED_BY(async_compilation_state_mu) =
@@ -319,11 +324,7 @@ class XlaCompilationCache : public ResourceBase {
     // Pool of threads for asynchronous compilations.
     std::unique_ptr<thread::ThreadPool> compiler_threads;
 
-    AsyncCompilationState() {
-      compiler_threads = std::make_unique<tensorflow::thread::ThreadPool>(
-          tensorflow::Env::Default(), "async_compiler_threads",
-          kNumCompilerThreads);
-    }
+    AsyncCompilationState();
 
   } async_compilation_state_;
 
@@ -15,7 +15,11 @@ limitations under the License.
 
 #include "tensorflow/compiler/mlir/tensorflow/utils/compile_mlir_util.h"
 
+#include <list>
+
 #include "tensorflow/compiler/mlir/tf2xla/mlir_bridge_rollout_policy.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
 #include "absl/types/optional.h"
 #include "absl/types/variant.h"
 #include "llvm/ADT/ArrayRef.h"
@@ -23,6 +27,7 @@ limitations under the License.
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"  // from @llvm-project
 #include "mlir/Dialect/Shape/IR/Shape.h"  // from @llvm-project
@@ -37,6 +42,7 @@ limitations under the License.
 #include "mlir/Support/LLVM.h"  // from @llvm-project
 #include "mlir/Transforms/Passes.h"  // from @llvm-project
 #include "stablehlo/dialect/Register.h"  // from @stablehlo
+#include "tensorflow/compiler/jit/flags.h"
 #include "tensorflow/compiler/mlir/tensorflow/dialect_registration.h"
 #include "tensorflow/compiler/mlir/tensorflow/ir/tf_executor.h"
 #include "tensorflow/compiler/mlir/tensorflow/ir/tf_ops.h"
@@ -71,7 +77,9 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/platform/error_payloads.h"
 #include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/protobuf/core_platform_payloads.pb.h"
 #include "tensorflow/core/tpu/tpu_defs.h"
 
@@ -324,6 +332,86 @@ bool CanInlineFunctionsPostLegalization(llvm::StringRef device_type) {
   return device_type == DEVICE_TPU_XLA_JIT;
 }
 
+// Added by Alpa
+// The thread pool shared by the MLIR contexts of the bridge, or nullptr if
+// each context creates its own pool. Compilations that run at the same time
+// then share the threads instead of each starting one per core.
+llvm::ThreadPool* GetBridgeThreadPool() {
+  static llvm::ThreadPool* pool = []() -> llvm::ThreadPool* {
+    int num_threads = GetMlirCommonFlags()->tf_mlir_bridge_num_threads;
+    if (num_threads <= 0) return nullptr;
+    llvm::ThreadPoolStrategy strategy;
+    strategy.ThreadsRequested = num_threads;
+    return new llvm::ThreadPool(strategy);
+  }();
+  return pool;
+}
+
+// The threading of a new context of the bridge. A context must be created
+// without threads to be given the shared pool.
+mlir::MLIRContext::Threading GetBridgeThreading() {
+  return GetBridgeThreadPool() ? mlir::MLIRContext::Threading::DISABLED
+                               : mlir::MLIRContext::Threading::ENABLED;
+}
+
+void MaybeUseBridgeThreadPool(mlir::MLIRContext& context) {
+  if (llvm::ThreadPool* pool = GetBridgeThreadPool()) {
+    context.setThreadPool(*pool);
+  }
+}
+
+// A least recently used cache of legalized modules, keyed by the fingerprint
+// of the module before legalization and the options of the legalization. The
+// modules are kept as text, since they outlive the contexts that created them.
+class LegalizationCache {
+ public:
+  static LegalizationCache* Get() {
+    static LegalizationCache* cache = new LegalizationCache;
+    return cache;
+  }
+
+  bool Lookup(const Fprint128& key, std::string* module) {
+    mutex_lock lock(mu_);
+    auto it = index_.find(key);
+    if (it == index_.end()) return false;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    *module = it->second->second;
+    return true;
+  }
+
+  void Insert(const Fprint128& key, std::string module, int capacity) {
+    mutex_lock lock(mu_);
+    if (index_.contains(key)) return;
+    entries_.emplace_front(key, std::move(module));
+    index_[key] = entries_.begin();
+    while (entries_.size() > capacity) {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+  }
+
+ private:
+  using Entry = std::pair<Fprint128, std::string>;
+
+  mutex mu_;
+  // The most recently used entry first.
+  std::list<Entry> entries_ TF_GUARDED_BY(mu_);
+  absl::flat_hash_map<Fprint128, std::list<Entry>::iterator, Fprint128Hasher>
+      index_ TF_GUARDED_BY(mu_);
+};
+
+// Replaces the body and the attributes of `module_op` with those of the
+// serialized module `legalized`.
+Status RestoreLegalizedModule(llvm::StringRef legalized,
+                              mlir::ModuleOp module_op) {
+  mlir::OwningOpRef<mlir::ModuleOp> cached;
+  TF_RETURN_IF_ERROR(
+      DeserializeMlirModule(legalized, module_op.getContext(), &cached));
+  module_op.getBodyRegion().takeBody(cached->getBodyRegion());
+  module_op->setAttrs(cached.get()->getAttrDictionary());
+  return OkStatus();
+}
+
 }  //  namespace
 
 Status RefineShapes(llvm::ArrayRef<TensorOrResourceShape> arg_shapes,
@@ -464,6 +552,29 @@ Status LegalizeToHlo(mlir::ModuleOp module_op, llvm::StringRef device_type,
                      bool prefer_tf2xla,
                      llvm::MutableArrayRef<std::unique_ptr<mlir::Pass>>
                          custom_legalization_passes) {
+  // Added by Alpa
+  // Retracing a function that did not change produces the same module, whose
+  // legalization is taken from the cache. Custom passes are opaque, so their
+  // legalizations are not cached.
+  const int cache_size =
+      GetMlirCommonFlags()->tf_mlir_legalization_cache_size;
+  const bool use_cache = cache_size > 0 && custom_legalization_passes.empty();
+  Fprint128 cache_key;
+  if (use_cache) {
+    cache_key = Fingerprint128(absl::StrCat(SerializeMlirModule(module_op), ";",
+                                            device_type.str(), ";",
+                                            prefer_tf2xla));
+    std::string legalized;
+    if (LegalizationCache::Get()->Lookup(cache_key, &legalized)) {
+      Status status = RestoreLegalizedModule(legalized, module_op);
+      if (status.ok()) {
+        VLOG(1) << "Reused the cached legalization of the module.";
+        return status;
+      }
+      LOG(WARNING) << "Failed to restore a cached legalization: " << status;
+    }
+  }
+
   mlir::PassManager tf2xla(module_op.getContext());
   applyTensorflowAndCLOptions(tf2xla);
   CreateConvertMlirToXlaHloPipeline(tf2xla, device_type, prefer_tf2xla,
@@ -498,6 +609,10 @@ Status LegalizeToHlo(mlir::ModuleOp module_op, llvm::StringRef device_type,
   tensorflow::OkOrSetErrorCounterPayload(
       tensorflow::core::platform::ErrorSourceProto::MLIR_BRIDGE_PHASE_2,
       status);
+  if (use_cache && status.ok()) {
+    LegalizationCache::Get()->Insert(cache_key, SerializeMlirModule(module_op),
+                                     cache_size);
+  }
   return status;
 }
 
@@ -674,7 +789,8 @@ Status CompileSerializedMlirToXlaHlo(
         custom_legalization_passes) {
   mlir::DialectRegistry mlir_registry;
   RegisterDialects(mlir_registry);
-  mlir::MLIRContext mlir_context(mlir_registry);
+  mlir::MLIRContext mlir_context(mlir_registry, GetBridgeThreading());
+  MaybeUseBridgeThreadPool(mlir_context);
   mlir::OwningOpRef<mlir::ModuleOp> mlir_module;
 
   TF_RETURN_IF_ERROR(
@@ -884,7 +1000,8 @@ Status CompileGraphToXlaHlo(
     XlaCompilationResult* compilation_result,
     llvm::MutableArrayRef<std::unique_ptr<mlir::Pass>>
         custom_legalization_passes) {
-  mlir::MLIRContext context;
+  mlir::MLIRContext context(GetBridgeThreading());
+  MaybeUseBridgeThreadPool(context);
   TF_ASSIGN_OR_RETURN(
       mlir::OwningOpRef<mlir::ModuleOp> module,
       GraphToModule(graph, control_rets, flib_def, debug_info, &context));
@@ -822,6 +822,18 @@ StatusOr<lmhlo_gpu::CublasLtMatmulEpilogue> AsLhloEpilogue(
     case xla::gpu::GemmBackendConfig::BIAS:
       return lmhlo_gpu::CublasLtMatmulEpilogue::Bias;
       break;
+    case xla::gpu::GemmBackendConfig::RELU:
+      return lmhlo_gpu::CublasLtMatmulEpilogue::Relu;
+      break;
+    case xla::gpu::GemmBackendConfig::BIAS_RELU:
+      return lmhlo_gpu::CublasLtMatmulEpilogue::BiasRelu;
+      break;
+    case xla::gpu::GemmBackendConfig::GELU:
+      return lmhlo_gpu::CublasLtMatmulEpilogue::Gelu;
+      break;
+    case xla::gpu::GemmBackendConfig::BIAS_GELU:
+      return lmhlo_gpu::CublasLtMatmulEpilogue::BiasGelu;
+      break;
     default:
       return xla::InternalError("unknown epilogue");
   }
@@ -859,7 +871,10 @@ StatusOr<Operation*> LhloDialectEmitter::EmitCublasLtMatmul(
       custom_call->backend_config<xla::gpu::GemmBackendConfig>());
 
   bool has_matrix_bias = config.beta() != 0.;
-  bool has_vector_bias = config.epilogue() == xla::gpu::GemmBackendConfig::BIAS;
+  bool has_vector_bias =
+      config.epilogue() == xla::gpu::GemmBackendConfig::BIAS ||
+      config.epilogue() == xla::gpu::GemmBackendConfig::BIAS_RELU ||
+      config.epilogue() == xla::gpu::GemmBackendConfig::BIAS_GELU;
   TF_RET_CHECK(custom_call->operand_count() ==
                2 + int{has_matrix_bias} + int{has_vector_bias});
 
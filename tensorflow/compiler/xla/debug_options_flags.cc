@@ -96,6 +96,9 @@ DebugOptions DefaultDebugOptionsIgnoringFlags() {
   opts.set_xla_gpu_enable_mlir_lowering(true);
   opts.set_xla_gpu_normalize_layouts(false);
   opts.set_xla_gpu_simplify_all_fp_conversions(true);
+
+  // Added by Alpa
+  opts.set_xla_memory_scheduler_beam_time_limit_ms(1000);
   return opts;
 }
 
@@ -770,6 +773,39 @@ static void AllocateFlags() {
       "By default, XLA:CPU will run fp16 dot/conv as fp32, as this is "
       "generally (much) faster on our hardware.  Set this flag to true to "
       "disable this behavior."));
+  // Added by Alpa
+  flag_objects->push_back(tsl::Flag(
+      "xla_gpu_load_autotune_results_from",
+      string_setter_for(&DebugOptions::set_xla_gpu_load_autotune_results_from),
+      flag_values->xla_gpu_load_autotune_results_from(),
+      "File to load the GPU autotuning results from before autotuning. A "
+      "text proto if the name ends with .pbtxt, a binary proto otherwise."));
+  flag_objects->push_back(tsl::Flag(
+      "xla_gpu_dump_autotune_results_to",
+      string_setter_for(&DebugOptions::set_xla_gpu_dump_autotune_results_to),
+      flag_values->xla_gpu_dump_autotune_results_to(),
+      "File to write the GPU autotuning results to after each compilation. A "
+      "text proto if the name ends with .pbtxt, a binary proto otherwise."));
+  flag_objects->push_back(tsl::Flag(
+      "xla_memory_scheduler_beam_width",
+      int32_setter_for(&DebugOptions::set_xla_memory_scheduler_beam_width),
+      flag_values->xla_memory_scheduler_beam_width(),
+      "If positive, the memory scheduler also tries a beam search of this "
+      "width and keeps the schedule with the lowest peak memory."));
+  flag_objects->push_back(tsl::Flag(
+      "xla_memory_scheduler_beam_time_limit_ms",
+      int64_setter_for(
+          &DebugOptions::set_xla_memory_scheduler_beam_time_limit_ms),
+      flag_values->xla_memory_scheduler_beam_time_limit_ms(),
+      "Time budget in milliseconds of the memory scheduler beam search for "
+      "one computation. No limit if not positive."));
+  flag_objects->push_back(tsl::Flag(
+      "xla_memory_scheduler_exact_max_instructions",
+      int32_setter_for(
+          &DebugOptions::set_xla_memory_scheduler_exact_max_instructions),
+      flag_values->xla_memory_scheduler_exact_max_instructions(),
+      "If positive, computations with at most this many instructions (and at "
+      "most 64) are also scheduled by an exact minimum peak memory search."));
 
   ParseFlagsFromEnvAndDieIfUnknown("XLA_FLAGS", *flag_objects);
 }  // NOLINT(readability/fn_size)
@@ -33,6 +33,8 @@ limitations under the License.
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "tensorflow/compiler/xla/hlo/experimental/auto_sharding/auto_sharding_cost_graph.h"
 #include "tensorflow/compiler/xla/hlo/experimental/auto_sharding/auto_sharding_strategy.h"
 #include "tensorflow/compiler/xla/hlo/experimental/auto_sharding/auto_sharding_util.h"
@@ -2891,6 +2893,7 @@ StatusOr<bool> AutoSharding::Run(
     return false;
   }
   bool module_is_changed = false;
+  stats_ = AutoShardingStats();
   VLOG(1) << "Start auto sharding pass";
 
   TF_RETURN_IF_ERROR(option_.CheckAndSetup());
@@ -3109,6 +3112,12 @@ StatusOr<bool> AutoSharding::Run(
     spmd::LeafStrategies leaf_strategies;
     spmd::AssociativeDotPairs associative_dot_pairs;
 
+    absl::Time phase_start = absl::Now();
+    auto end_phase = [&phase_start](double* seconds) {
+      absl::Time now = absl::Now();
+      *seconds += absl::ToDoubleSeconds(now - phase_start);
+      phase_start = now;
+    };
     TF_ASSIGN_OR_RETURN(
         std::tie(strategy_map, leaf_strategies, associative_dot_pairs),
         BuildStrategyAndCost(sequence, ins_depth_map, batch_dim_map, alias_map,
@@ -3116,10 +3125,12 @@ StatusOr<bool> AutoSharding::Run(
     spmd::AliasSet alias_set = spmd::BuildAliasSet(module, strategy_map);
     CheckAliasSetCompatibility(alias_set, leaf_strategies, sequence);
     XLA_VLOG_LINES(8, PrintStrategyMap(strategy_map, sequence));
+    end_phase(&stats_.strategy_building_seconds);
 
     // ----- Build cost graph and merge unimporant nodes -----
     spmd::CostGraph cost_graph(leaf_strategies, associative_dot_pairs);
     cost_graph.Simplify(option_.simplify_graph);
+    end_phase(&stats_.cost_graph_simplification_seconds);
 
     // ----- Call the ILP Solver -----
     std::vector<int64_t> s_val, e_val;
@@ -3133,6 +3144,8 @@ StatusOr<bool> AutoSharding::Run(
     } else {
       s_val = option_.strategy_vector;
     }
+    end_phase(&stats_.solver_seconds);
+    stats_.solver_objective = objective;
 
     XLA_VLOG_LINES(5, PrintAutoShardingSolution(sequence, liveness_set,
                                                 strategy_map, leaf_strategies,
@@ -3141,6 +3154,7 @@ StatusOr<bool> AutoSharding::Run(
                                                cost_graph, s_val));
 
     // ----- Substitute all-reduce with reduce-scatter -----
+    phase_start = absl::Now();
     if (solver_option.prefer_reduce_scatter) {
       GenerateReduceScatter(sequence, alias_map, ins_depth_map, strategy_map,
                             cost_graph, s_val, cluster_env, solver_option);
@@ -3154,6 +3168,7 @@ StatusOr<bool> AutoSharding::Run(
     } else {
       spmd::RecoverShardingsFromPartialMesh(sequence, preserve_shardings);
     }
+    end_phase(&stats_.set_sharding_seconds);
   }
 
   if (VLOG_IS_ON(1)) {
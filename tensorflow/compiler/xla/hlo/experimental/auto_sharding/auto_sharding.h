@@ -299,6 +299,17 @@ struct AutoShardingOption {
   }
 };
 
+// Wall-clock time spent in each phase of the last AutoSharding::Run, summed
+// over the partial meshes when solving iteratively, and the objective of the
+// last ILP solve.
+struct AutoShardingStats {
+  double strategy_building_seconds = 0.0;
+  double cost_graph_simplification_seconds = 0.0;
+  double solver_seconds = 0.0;
+  double set_sharding_seconds = 0.0;
+  double solver_objective = -1.0;
+};
+
 class AutoSharding : public HloModulePass {
  public:
   explicit AutoSharding(const AutoShardingOption& option);
@@ -324,8 +335,11 @@ class AutoSharding : public HloModulePass {
   //     tensorflow/compiler/xla/pjrt/utils.cc
   Status CanonicalizeLayouts(HloModule* module);
 
+  const AutoShardingStats& stats() const { return stats_; }
+
  private:
   AutoShardingOption option_;
+  AutoShardingStats stats_;
 };
 
 }  // namespace xla
@@ -0,0 +1,276 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Usage:
+//   auto_sharding_benchmark --hlo_dir=DIR --mesh_shapes=2x2,1x4
+//     [--collective_profile=FILE] [--output_file=FILE]
+//
+// Runs the auto-sharding pass on every HLO module in DIR (.hlo, .txt, .pb and
+// .pbtxt files) for every mesh shape, partitions the result with the SPMD
+// partitioner, and writes one JSON record per (module, mesh) pair with the
+// per-phase pass timing, the peak host memory, the solver objective and the
+// EstimateHloModuleCost of the partitioned module.
+//
+// Peak host memory is read from VmHWM in /proc/self/status, which is reset
+// before every run. It is reported as -1 where that is not available.
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "tensorflow/compiler/xla/hlo/experimental/auto_sharding/auto_sharding.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_cost_model.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/spmd/collective_cost_model.h"
+#include "tensorflow/compiler/xla/service/spmd/spmd_partitioner.h"
+#include "tensorflow/compiler/xla/status.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/tools/hlo_module_loader.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/init_main.h"
+#include "tensorflow/tsl/platform/path.h"
+#include "tensorflow/tsl/util/command_line_flags.h"
+
+namespace xla {
+namespace spmd {
+namespace {
+
+struct BenchmarkRun {
+  std::string module_file;
+  std::vector<int64_t> mesh_shape;
+  Status status;
+  AutoShardingStats stats;
+  double total_seconds = 0.0;
+  int64_t peak_host_memory_bytes = -1;
+  double estimated_cost = -1.0;
+};
+
+StatusOr<std::vector<int64_t>> ParseMeshShape(absl::string_view text) {
+  std::vector<int64_t> shape;
+  for (absl::string_view dim : absl::StrSplit(text, 'x')) {
+    int64_t size;
+    if (!absl::SimpleAtoi(dim, &size) || size <= 0) {
+      return InvalidArgument("Invalid mesh shape: %s", text);
+    }
+    shape.push_back(size);
+  }
+  return shape;
+}
+
+StatusOr<std::vector<std::string>> ListHloFiles(const std::string& dir) {
+  std::vector<std::string> children;
+  TF_RETURN_IF_ERROR(tsl::Env::Default()->GetChildren(dir, &children));
+  std::vector<std::string> files;
+  for (const std::string& child : children) {
+    absl::string_view extension = tsl::io::Extension(child);
+    if (extension == "hlo" || extension == "txt" || extension == "pb" ||
+        extension == "pbtxt") {
+      files.push_back(tsl::io::JoinPath(dir, child));
+    }
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+// Resets the peak resident set size of this process (Linux only).
+void ResetPeakHostMemory() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+}
+
+int64_t PeakHostMemoryBytes() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    absl::string_view value = line;
+    int64_t kb;
+    if (absl::ConsumePrefix(&value, "VmHWM:") &&
+        absl::SimpleAtoi(
+            absl::StripSuffix(absl::StripAsciiWhitespace(value), " kB"), &kb)) {
+      return kb * 1024;
+    }
+  }
+  return -1;
+}
+
+Status RunOnce(const std::string& module_file,
+               const std::vector<int64_t>& mesh_shape,
+               const CollectiveCostModel& cost_model, BenchmarkRun* run) {
+  int64_t num_devices = 1;
+  for (int64_t dim : mesh_shape) {
+    num_devices *= dim;
+  }
+  hlo_module_loader_details::Config ovr_config;
+  ovr_config.num_partitions = num_devices;
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<HloModule> hlo_module,
+      LoadModuleFromFile(module_file, ovr_config, /*format=*/"",
+                         [](HloModuleConfig* config) {
+                           config->set_use_spmd_partitioning(true);
+                         }));
+
+  AutoShardingOption option;
+  option.enable = true;
+  option.device_mesh_shape = mesh_shape;
+  option.device_mesh_ids.resize(num_devices);
+  std::iota(option.device_mesh_ids.begin(), option.device_mesh_ids.end(), 0);
+  option.device_mesh_alpha.assign(mesh_shape.size(), kDeviceMeshAlpha);
+  option.device_mesh_beta.assign(mesh_shape.size(), kDeviceMeshBeta);
+
+  AutoSharding pass(option);
+  absl::Time start = absl::Now();
+  StatusOr<bool> changed = pass.Run(hlo_module.get());
+  run->total_seconds = absl::ToDoubleSeconds(absl::Now() - start);
+  run->peak_host_memory_bytes = PeakHostMemoryBytes();
+  run->stats = pass.stats();
+  TF_RETURN_IF_ERROR(changed.status());
+
+  SpmdPartitioner partitioner(num_devices, /*num_replicas=*/1,
+                              SpmdPartitionerOptions());
+  TF_RETURN_IF_ERROR(partitioner.Run(hlo_module.get()).status());
+  run->estimated_cost =
+      gpu::EstimateHloModuleCost(hlo_module.get(), cost_model);
+  return OkStatus();
+}
+
+std::string JsonString(absl::string_view text) {
+  std::string out = "\"";
+  for (char c : text) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          absl::StrAppendFormat(&out, "\\u%04x", static_cast<int>(c));
+        } else {
+          out += c;
+        }
+    }
+  }
+  return out + "\"";
+}
+
+std::string JsonNumber(double value) {
+  return std::isfinite(value) ? absl::StrCat(value) : "null";
+}
+
+std::string ToJson(const std::vector<BenchmarkRun>& runs) {
+  std::vector<std::string> records;
+  for (const BenchmarkRun& run : runs) {
+    records.push_back(absl::StrCat(
+        "    {\"module\": ", JsonString(run.module_file), ", \"mesh_shape\": [",
+        absl::StrJoin(run.mesh_shape, ", "), "], \"status\": ",
+        JsonString(run.status.ok() ? "OK" : run.status.ToString()),
+        ", \"strategy_building_seconds\": ",
+        JsonNumber(run.stats.strategy_building_seconds),
+        ", \"cost_graph_simplification_seconds\": ",
+        JsonNumber(run.stats.cost_graph_simplification_seconds),
+        ", \"solver_seconds\": ", JsonNumber(run.stats.solver_seconds),
+        ", \"set_sharding_seconds\": ",
+        JsonNumber(run.stats.set_sharding_seconds),
+        ", \"total_seconds\": ", JsonNumber(run.total_seconds),
+        ", \"peak_host_memory_bytes\": ", run.peak_host_memory_bytes,
+        ", \"solver_objective\": ", JsonNumber(run.stats.solver_objective),
+        ", \"estimated_cost\": ", JsonNumber(run.estimated_cost), "}"));
+  }
+  return absl::StrCat("{\n  \"runs\": [\n", absl::StrJoin(records, ",\n"),
+                      "\n  ]\n}\n");
+}
+
+Status RunBenchmark(const std::string& hlo_dir, const std::string& mesh_shapes,
+                    const std::string& collective_profile,
+                    const std::string& output_file) {
+  std::vector<std::vector<int64_t>> meshes;
+  for (absl::string_view text : absl::StrSplit(mesh_shapes, ',')) {
+    TF_ASSIGN_OR_RETURN(std::vector<int64_t> mesh_shape, ParseMeshShape(text));
+    meshes.push_back(std::move(mesh_shape));
+  }
+  CollectiveCostModel cost_model;
+  if (!collective_profile.empty()) {
+    TF_ASSIGN_OR_RETURN(cost_model,
+                        CollectiveCostModel::LoadFromFile(collective_profile));
+  }
+  TF_ASSIGN_OR_RETURN(std::vector<std::string> files, ListHloFiles(hlo_dir));
+
+  std::vector<BenchmarkRun> runs;
+  for (const std::string& file : files) {
+    for (const std::vector<int64_t>& mesh_shape : meshes) {
+      LOG(INFO) << "Benchmarking " << file << " on mesh "
+                << absl::StrJoin(mesh_shape, "x");
+      BenchmarkRun& run = runs.emplace_back();
+      run.module_file = file;
+      run.mesh_shape = mesh_shape;
+      ResetPeakHostMemory();
+      run.status = RunOnce(file, mesh_shape, cost_model, &run);
+      if (!run.status.ok()) {
+        LOG(WARNING) << "Failed on " << file << ": " << run.status;
+      }
+    }
+  }
+
+  std::string json = ToJson(runs);
+  if (output_file.empty()) {
+    std::cout << json;
+    return OkStatus();
+  }
+  return tsl::WriteStringToFile(tsl::Env::Default(), output_file, json);
+}
+
+}  // namespace
+}  // namespace spmd
+}  // namespace xla
+
+int main(int argc, char** argv) {
+  std::string hlo_dir, mesh_shapes = "2x2", collective_profile, output_file;
+  const std::vector<tsl::Flag> flag_list = {
+      tsl::Flag("hlo_dir", &hlo_dir, "Directory of HLO modules to shard."),
+      tsl::Flag("mesh_shapes", &mesh_shapes,
+                "Comma-separated device mesh shapes, e.g. 2x2,1x4."),
+      tsl::Flag("collective_profile", &collective_profile,
+                "Optional collective profile used by the cost estimate."),
+      tsl::Flag("output_file", &output_file,
+                "Where to write the JSON report. Defaults to stdout."),
+  };
+  const std::string usage = tsl::Flags::Usage(argv[0], flag_list);
+  bool parse_ok = tsl::Flags::Parse(&argc, argv, flag_list);
+  tsl::port::InitMain(usage.c_str(), &argc, &argv);
+  QCHECK(parse_ok && !hlo_dir.empty()) << usage;
+  TF_CHECK_OK(xla::spmd::RunBenchmark(hlo_dir, mesh_shapes, collective_profile,
+                                      output_file));
+  return 0;
+}
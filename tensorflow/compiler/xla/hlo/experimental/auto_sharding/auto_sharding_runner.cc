@@ -29,11 +29,11 @@ namespace spmd {
 namespace {
 
 Status RunAutoShardingPassFromFile(const std::string& file_name) {
-  std::string hlo_text;
-  TF_RETURN_IF_ERROR(
-      tsl::ReadFileToString(tsl::Env::Default(), file_name, &hlo_text));
-  TF_ASSIGN_OR_RETURN(std::unique_ptr<HloModule> hlo_module,
-                      LoadModuleFromData(/*data=*/hlo_text, /*format=*/"hlo"));
+  // Added by Alpa: load from the mapped file instead of a copy of it.
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<HloModule> hlo_module,
+      LoadModuleFromFile(file_name, hlo_module_loader_details::Config(),
+                         /*format=*/"hlo"));
 
   AutoShardingOption option;
   option.enable = true;
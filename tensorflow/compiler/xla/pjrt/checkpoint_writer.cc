@@ -0,0 +1,220 @@
+#include "tensorflow/compiler/xla/pjrt/checkpoint_writer.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/tsl/lib/io/zlib_compression_options.h"
+#include "tensorflow/tsl/lib/io/zlib_outputbuffer.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/mem.h"
+#include "tensorflow/tsl/platform/threadpool.h"
+#include "tensorflow/tsl/profiler/lib/traceme.h"
+
+namespace xla {
+namespace {
+
+// A fixed set of host buffers of `chunk_bytes` shared by the files of a
+// write.
+class StagingBuffers {
+ public:
+  StagingBuffers(int num_buffers, int64_t chunk_bytes,
+                 tsl::Allocator* allocator)
+      : allocator_(allocator) {
+    for (int i = 0; i < num_buffers; ++i) {
+      void* ptr = allocator_ != nullptr
+                      ? allocator_->AllocateRaw(
+                            tsl::Allocator::kAllocatorAlignment, chunk_bytes)
+                      : tsl::port::AlignedMalloc(
+                            chunk_bytes, tsl::Allocator::kAllocatorAlignment);
+      if (ptr == nullptr) {
+        break;
+      }
+      all_.push_back(ptr);
+    }
+    free_ = all_;
+  }
+
+  ~StagingBuffers() {
+    for (void* ptr : all_) {
+      if (allocator_ != nullptr) {
+        allocator_->DeallocateRaw(ptr);
+      } else {
+        tsl::port::AlignedFree(ptr);
+      }
+    }
+  }
+
+  int size() const { return all_.size(); }
+
+  // Blocks until a buffer is free.
+  void* Acquire() {
+    absl::MutexLock lock(&mu_);
+    auto has_free = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      return !free_.empty();
+    };
+    mu_.Await(absl::Condition(&has_free));
+    void* ptr = free_.back();
+    free_.pop_back();
+    return ptr;
+  }
+
+  // Returns null if no buffer is free.
+  void* TryAcquire() {
+    absl::MutexLock lock(&mu_);
+    if (free_.empty()) {
+      return nullptr;
+    }
+    void* ptr = free_.back();
+    free_.pop_back();
+    return ptr;
+  }
+
+  void Release(void* ptr) {
+    absl::MutexLock lock(&mu_);
+    free_.push_back(ptr);
+  }
+
+ private:
+  tsl::Allocator* allocator_;
+  std::vector<void*> all_;
+  absl::Mutex mu_;
+  std::vector<void*> free_ ABSL_GUARDED_BY(mu_);
+};
+
+// The most chunks of a file that are copied to host at a time.
+constexpr int kMaxChunksInFlightPerFile = 2;
+
+Status WriteBufferToFile(PjRtBuffer* buffer, const std::string& path,
+                         const CheckpointWriterOptions& options,
+                         StagingBuffers& staging) {
+  tsl::profiler::TraceMe traceme("WriteBufferToFile");
+  TF_ASSIGN_OR_RETURN(size_t size, buffer->GetOnDeviceSizeInBytes());
+
+  std::unique_ptr<tsl::WritableFile> raw_file;
+  TF_RETURN_IF_ERROR(tsl::Env::Default()->NewWritableFile(path, &raw_file));
+  std::unique_ptr<tsl::io::ZlibOutputBuffer> zlib_file;
+  tsl::WritableFile* file = raw_file.get();
+  if (options.compress) {
+    tsl::io::ZlibCompressionOptions zlib_options =
+        tsl::io::ZlibCompressionOptions::GZIP();
+    zlib_file = std::make_unique<tsl::io::ZlibOutputBuffer>(
+        raw_file.get(), zlib_options.input_buffer_size,
+        zlib_options.output_buffer_size, zlib_options);
+    TF_RETURN_IF_ERROR(zlib_file->Init());
+    file = zlib_file.get();
+  }
+
+  struct Chunk {
+    void* host;
+    int64_t size;
+    PjRtFuture<Status> copied;
+  };
+  std::deque<Chunk> chunks;
+  // Return the staging buffers of the chunks in flight on an early error,
+  // after their copies are done.
+  auto release_chunks = [&]() {
+    for (Chunk& chunk : chunks) {
+      chunk.copied.Await().IgnoreError();
+      staging.Release(chunk.host);
+    }
+    chunks.clear();
+  };
+
+  int64_t offset = 0;
+  while (offset < static_cast<int64_t>(size) || !chunks.empty()) {
+    // Only block for a staging buffer when none is held, so that the files
+    // cannot hold all buffers while waiting for more.
+    while (offset < static_cast<int64_t>(size) &&
+           chunks.size() < kMaxChunksInFlightPerFile) {
+      void* host = chunks.empty() ? staging.Acquire() : staging.TryAcquire();
+      if (host == nullptr) {
+        break;
+      }
+      int64_t chunk_size =
+          std::min<int64_t>(options.chunk_bytes, size - offset);
+      chunks.push_back(
+          {host, chunk_size, buffer->CopyRawToHost(host, offset, chunk_size)});
+      offset += chunk_size;
+    }
+
+    Chunk chunk = std::move(chunks.front());
+    chunks.pop_front();
+    Status status = chunk.copied.Await();
+    if (status.ok()) {
+      status = file->Append(absl::string_view(
+          static_cast<const char*>(chunk.host), chunk.size));
+    }
+    staging.Release(chunk.host);
+    if (!status.ok()) {
+      release_chunks();
+      return status;
+    }
+  }
+
+  if (zlib_file != nullptr) {
+    TF_RETURN_IF_ERROR(zlib_file->Close());
+  }
+  return raw_file->Close();
+}
+
+}  // namespace
+
+Status WriteBuffersToFiles(absl::Span<PjRtBuffer* const> buffers,
+                           absl::Span<const std::string> paths,
+                           const CheckpointWriterOptions& options) {
+  if (buffers.size() != paths.size()) {
+    return InvalidArgument("Got %d buffers but %d paths", buffers.size(),
+                           paths.size());
+  }
+  if (options.chunk_bytes <= 0 || options.num_staging_buffers <= 0 ||
+      options.num_threads <= 0) {
+    return InvalidArgument(
+        "Checkpoint writer chunk_bytes, num_staging_buffers and num_threads "
+        "must be positive");
+  }
+  tsl::profiler::TraceMe traceme("WriteBuffersToFiles");
+  StagingBuffers staging(options.num_staging_buffers, options.chunk_bytes,
+                         options.staging_allocator);
+  if (staging.size() == 0) {
+    return ResourceExhausted(
+        "Failed to allocate a staging buffer of %d bytes for a checkpoint",
+        options.chunk_bytes);
+  }
+
+  absl::Mutex mu;
+  Status status;
+  {
+    tsl::thread::ThreadPool pool(
+        tsl::Env::Default(), "checkpoint_writer",
+        std::min<int>(options.num_threads, std::max<int>(buffers.size(), 1)));
+    for (int i = 0; i < buffers.size(); ++i) {
+      pool.Schedule([&, i]() {
+        {
+          absl::MutexLock lock(&mu);
+          if (!status.ok()) {
+            return;
+          }
+        }
+        Status file_status =
+            WriteBufferToFile(buffers[i], paths[i], options, staging);
+        if (!file_status.ok()) {
+          absl::MutexLock lock(&mu);
+          status.Update(tsl::errors::CreateWithUpdatedMessage(
+              file_status, absl::StrCat("Writing ", paths[i], ": ",
+                                        file_status.error_message())));
+        }
+      });
+    }
+  }
+  return status;
+}
+
+}  // namespace xla
@@ -0,0 +1,43 @@
+// This file contains a writer that streams the bytes of device buffers to
+// files in chunks, so that a checkpoint never needs a host copy of the whole
+// model.
+
+#ifndef TENSORFLOW_COMPILER_XLA_PJRT_CHECKPOINT_WRITER_H_
+#define TENSORFLOW_COMPILER_XLA_PJRT_CHECKPOINT_WRITER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/pjrt/pjrt_client.h"
+#include "tensorflow/compiler/xla/status.h"
+#include "tensorflow/tsl/framework/allocator.h"
+
+namespace xla {
+
+struct CheckpointWriterOptions {
+  // The bytes of a buffer copied to host at a time.
+  int64_t chunk_bytes = 32 << 20;
+  // The number of host staging buffers of `chunk_bytes`, which bounds the
+  // host memory of a write.
+  int num_staging_buffers = 8;
+  // The number of files written in parallel.
+  int num_threads = 4;
+  // Whether to write the files gzip-compressed.
+  bool compress = false;
+  // Allocates the staging buffers, e.g. from pinned host memory so that the
+  // copies are asynchronous. If null, they are allocated with malloc.
+  tsl::Allocator* staging_allocator = nullptr;
+};
+
+// Writes the on-device bytes of `buffers[i]` to the file `paths[i]`. The
+// copy of a chunk to host overlaps the compression and write of the previous
+// chunk of the file, and the files are written in parallel. Returns the
+// first error; the files are then incomplete.
+Status WriteBuffersToFiles(absl::Span<PjRtBuffer* const> buffers,
+                           absl::Span<const std::string> paths,
+                           const CheckpointWriterOptions& options);
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_PJRT_CHECKPOINT_WRITER_H_
@@ -0,0 +1,94 @@
+#include "tensorflow/compiler/xla/pjrt/checkpoint_writer.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/client/client_library.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/pjrt/pjrt_stream_executor_client.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/test.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/path.h"
+
+namespace xla {
+namespace {
+
+StatusOr<std::unique_ptr<PjRtStreamExecutorClient>> GetClient() {
+  LocalClient* local_client = xla::ClientLibrary::LocalClientOrDie();
+  TF_ASSIGN_OR_RETURN(se::Platform * platform,
+                      PlatformUtil::GetPlatform("Host"));
+  se::StreamExecutorConfig config;
+  config.ordinal = 0;
+  TF_ASSIGN_OR_RETURN(se::StreamExecutor * executor,
+                      platform->GetExecutor(config));
+  auto device_state = std::make_unique<LocalDeviceState>(
+      executor, local_client, LocalDeviceState::kSynchronous,
+      /*max_inflight_computations=*/32,
+      /*allow_event_reuse=*/false, /*use_callback_stream=*/false);
+  auto device = std::make_unique<PjRtStreamExecutorDevice>(
+      0, std::move(device_state), "cpu");
+  std::vector<std::unique_ptr<PjRtStreamExecutorDevice>> devices;
+  devices.emplace_back(std::move(device));
+  return std::make_unique<PjRtStreamExecutorClient>(
+      "cpu", local_client, std::move(devices), /*process_index=*/0,
+      /*allocator=*/nullptr, /*host_memory_allocator=*/nullptr,
+      /*should_stage_host_to_device_transfers=*/false,
+      /*gpu_run_options=*/nullptr);
+}
+
+TEST(CheckpointWriterTest, WritesBuffersInChunks) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetClient());
+  std::vector<std::vector<float>> values = {std::vector<float>(1000),
+                                            std::vector<float>(37)};
+  std::vector<std::unique_ptr<PjRtBuffer>> buffers;
+  std::vector<PjRtBuffer*> buffer_ptrs;
+  std::vector<std::string> paths;
+  for (int i = 0; i < values.size(); ++i) {
+    for (int j = 0; j < values[i].size(); ++j) {
+      values[i][j] = i * 10000 + j;
+    }
+    TF_ASSERT_OK_AND_ASSIGN(
+        buffers.emplace_back(),
+        client->BufferFromHostLiteral(LiteralUtil::CreateR1<float>(values[i]),
+                                      client->addressable_devices()[0]));
+    buffer_ptrs.push_back(buffers.back().get());
+    paths.push_back(tsl::io::JoinPath(tsl::testing::TmpDir(),
+                                      absl::StrCat("shard_", i, ".bin")));
+  }
+
+  CheckpointWriterOptions options;
+  // Many chunks per file, and fewer staging buffers than files can hold.
+  options.chunk_bytes = 256;
+  options.num_staging_buffers = 3;
+  options.num_threads = 2;
+  TF_ASSERT_OK(WriteBuffersToFiles(buffer_ptrs, paths, options));
+
+  for (int i = 0; i < values.size(); ++i) {
+    std::string contents;
+    TF_ASSERT_OK(
+        tsl::ReadFileToString(tsl::Env::Default(), paths[i], &contents));
+    ASSERT_EQ(contents.size(), values[i].size() * sizeof(float));
+    EXPECT_EQ(std::memcmp(contents.data(), values[i].data(), contents.size()),
+              0);
+  }
+}
+
+TEST(CheckpointWriterTest, MismatchedPaths) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetClient());
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto buffer,
+      client->BufferFromHostLiteral(LiteralUtil::CreateR0<float>(1.0f),
+                                    client->addressable_devices()[0]));
+  PjRtBuffer* buffer_ptr = buffer.get();
+  Status status = WriteBuffersToFiles({buffer_ptr}, {},
+                                      CheckpointWriterOptions());
+  EXPECT_EQ(status.code(), tensorflow::error::INVALID_ARGUMENT);
+}
+
+}  // namespace
+}  // namespace xla
@@ -0,0 +1,250 @@
+#include "tensorflow/compiler/xla/pjrt/compile_farm.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/tsl/lib/strings/proto_serialization.h"
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/fingerprint.h"
+#include "tensorflow/tsl/platform/logging.h"
+#include "tensorflow/tsl/profiler/lib/traceme.h"
+
+namespace xla {
+
+namespace {
+
+// A result is the serialized executable or the error of the compilation.
+constexpr absl::string_view kOkPrefix = "ok:";
+constexpr absl::string_view kErrorPrefix = "error:";
+
+std::string Key(const CompileFarmOptions& options, absl::string_view kind,
+                absl::string_view fingerprint) {
+  return absl::StrCat(options.directory, "/", kind, "/", fingerprint);
+}
+
+std::string Directory(const CompileFarmOptions& options,
+                      absl::string_view kind) {
+  return absl::StrCat(options.directory, "/", kind);
+}
+
+// The fingerprint of a key in `directory`.
+absl::string_view FingerprintOfKey(absl::string_view key,
+                                   absl::string_view directory) {
+  key.remove_prefix(std::min(key.size(), directory.size() + 1));
+  return key;
+}
+
+// Another host may have published the same entries first.
+Status IgnoreAlreadyExists(Status status) {
+  return tsl::errors::IsAlreadyExists(status) ? OkStatus() : status;
+}
+
+}  // namespace
+
+std::string CompileFarmTarget(const PjRtClient& client) {
+  std::string device_kind;
+  if (!client.addressable_devices().empty()) {
+    device_kind = std::string(client.addressable_devices()[0]->device_kind());
+  }
+  return absl::StrCat(client.platform_name(), ";", client.platform_version(),
+                      ";", device_kind);
+}
+
+StatusOr<std::string> CompileFarmFingerprint(const HloModuleProto& module,
+                                             const CompileOptions& options,
+                                             absl::string_view target) {
+  std::string module_bytes, options_bytes;
+  TF_ASSIGN_OR_RETURN(CompileOptionsProto options_proto, options.ToProto());
+  if (!tsl::SerializeToStringDeterministic(module, &module_bytes) ||
+      !tsl::SerializeToStringDeterministic(options_proto, &options_bytes)) {
+    return InternalError("Failed to serialize the compilation request.");
+  }
+  tsl::Fprint128 fingerprint = tsl::Fingerprint128(absl::StrCat(
+      module_bytes.size(), ";", module_bytes, options_bytes.size(), ";",
+      options_bytes, target));
+  return absl::StrFormat("%016x%016x", fingerprint.high64, fingerprint.low64);
+}
+
+CompileFarmClient::CompileFarmClient(
+    PjRtClient* client, std::shared_ptr<DistributedRuntimeClient> kv_client,
+    CompileFarmOptions options)
+    : client_(client),
+      kv_client_(std::move(kv_client)),
+      options_(std::move(options)) {}
+
+StatusOr<std::unique_ptr<PjRtLoadedExecutable>> CompileFarmClient::Compile(
+    const XlaComputation& computation, CompileOptions options) {
+  StatusOr<std::string> serialized = CompileSerialized(computation, options);
+  if (serialized.ok()) {
+    auto executable = client_->DeserializeExecutable(*serialized, options);
+    if (executable.ok() || !options_.fallback_to_local) {
+      return executable;
+    }
+    serialized = executable.status();
+  } else if (!options_.fallback_to_local) {
+    return serialized.status();
+  }
+  LOG(WARNING) << "Compiling " << computation.name()
+               << " locally, since the compile farm failed: "
+               << serialized.status();
+  return client_->Compile(computation, std::move(options));
+}
+
+StatusOr<std::string> CompileFarmClient::CompileSerialized(
+    const XlaComputation& computation, const CompileOptions& options) {
+  tsl::profiler::TraceMe traceme("CompileFarmClient::CompileSerialized");
+  const HloModuleProto& module = computation.proto();
+  std::string target = CompileFarmTarget(*client_);
+  TF_ASSIGN_OR_RETURN(std::string fingerprint,
+                      CompileFarmFingerprint(module, options, target));
+
+  std::shared_ptr<InFlight> in_flight;
+  bool owner = false;
+  {
+    absl::MutexLock lock(&mu_);
+    auto [iter, inserted] = in_flight_.try_emplace(fingerprint);
+    if (inserted) {
+      iter->second = std::make_shared<InFlight>();
+      owner = true;
+    }
+    in_flight = iter->second;
+  }
+  if (!owner) {
+    in_flight->done.WaitForNotification();
+    return in_flight->result;
+  }
+
+  in_flight->result = Request(fingerprint, module, options, target);
+  {
+    absl::MutexLock lock(&mu_);
+    in_flight_.erase(fingerprint);
+  }
+  in_flight->done.Notify();
+  return in_flight->result;
+}
+
+StatusOr<std::string> CompileFarmClient::Request(
+    const std::string& fingerprint, const HloModuleProto& module,
+    const CompileOptions& options, const std::string& target) {
+  TF_ASSIGN_OR_RETURN(CompileOptionsProto options_proto, options.ToProto());
+  std::string module_bytes, options_bytes;
+  if (!module.SerializeToString(&module_bytes) ||
+      !options_proto.SerializeToString(&options_bytes)) {
+    return InternalError("Failed to serialize the compilation request.");
+  }
+  // The request is published last, so that a server that sees it finds the
+  // module and the options.
+  TF_RETURN_IF_ERROR(IgnoreAlreadyExists(kv_client_->KeyValueBatchSet(
+      {{Key(options_, "module", fingerprint), std::move(module_bytes)},
+       {Key(options_, "options", fingerprint), std::move(options_bytes)}})));
+  TF_RETURN_IF_ERROR(IgnoreAlreadyExists(kv_client_->KeyValueSet(
+      Key(options_, "request", fingerprint), target)));
+  VLOG(1) << "Requested compilation " << fingerprint << " of "
+          << module.name() << " from the compile farm.";
+
+  TF_ASSIGN_OR_RETURN(
+      std::string result,
+      kv_client_->BlockingKeyValueGet(Key(options_, "result", fingerprint),
+                                      options_.timeout));
+  if (absl::StartsWith(result, kOkPrefix)) {
+    result.erase(0, kOkPrefix.size());
+    return result;
+  }
+  if (absl::StartsWith(result, kErrorPrefix)) {
+    return InternalError("The compile farm failed to compile %s: %s",
+                         module.name(), result.substr(kErrorPrefix.size()));
+  }
+  return InternalError("Invalid result of the compile farm for %s.",
+                       module.name());
+}
+
+CompileFarmServer::CompileFarmServer(
+    PjRtClient* client, std::shared_ptr<DistributedRuntimeClient> kv_client,
+    int server_index, int num_servers, CompileFarmOptions options)
+    : client_(client),
+      kv_client_(std::move(kv_client)),
+      server_index_(server_index),
+      num_servers_(num_servers),
+      options_(std::move(options)),
+      target_(CompileFarmTarget(*client)) {
+  CHECK_GE(server_index_, 0);
+  CHECK_LT(server_index_, num_servers_);
+}
+
+StatusOr<int> CompileFarmServer::ServeOnce() {
+  std::string request_dir = Directory(options_, "request");
+  std::string done_dir = Directory(options_, "done");
+  TF_ASSIGN_OR_RETURN(auto requests, kv_client_->KeyValueDirGet(request_dir));
+  if (requests.size() == served_.size()) {
+    return 0;
+  }
+  // Requests served by another server, or by an earlier run of this one.
+  TF_ASSIGN_OR_RETURN(auto done, kv_client_->KeyValueDirGet(done_dir));
+  for (const auto& [key, value] : done) {
+    served_.insert(std::string(FingerprintOfKey(key, done_dir)));
+  }
+
+  int num_compiled = 0;
+  for (const auto& [key, target] : requests) {
+    std::string fingerprint(FingerprintOfKey(key, request_dir));
+    if (served_.contains(fingerprint) || target != target_ ||
+        tsl::Fingerprint64(fingerprint) % num_servers_ != server_index_) {
+      continue;
+    }
+    tsl::profiler::TraceMe traceme("CompileFarmServer::Compile");
+    TF_ASSIGN_OR_RETURN(
+        std::vector<std::string> values,
+        kv_client_->BlockingKeyValueBatchGet(
+            {Key(options_, "module", fingerprint),
+             Key(options_, "options", fingerprint)},
+            absl::Minutes(1)));
+
+    StatusOr<std::string> serialized = [&]() -> StatusOr<std::string> {
+      HloModuleProto module;
+      CompileOptionsProto options_proto;
+      if (!module.ParseFromString(values[0]) ||
+          !options_proto.ParseFromString(values[1])) {
+        return InvalidArgument("Failed to parse the compilation request.");
+      }
+      TF_ASSIGN_OR_RETURN(CompileOptions options,
+                          CompileOptions::FromProto(options_proto));
+      TF_ASSIGN_OR_RETURN(
+          std::unique_ptr<PjRtLoadedExecutable> executable,
+          client_->Compile(XlaComputation(std::move(module)), options));
+      return client_->SerializeExecutable(*executable);
+    }();
+    std::string result;
+    if (serialized.ok()) {
+      result = absl::StrCat(kOkPrefix, *serialized);
+    } else {
+      LOG(WARNING) << "Failed to compile request " << fingerprint << ": "
+                   << serialized.status();
+      result = absl::StrCat(kErrorPrefix, serialized.status().ToString());
+    }
+    TF_RETURN_IF_ERROR(IgnoreAlreadyExists(kv_client_->KeyValueBatchSet(
+        {{Key(options_, "result", fingerprint), std::move(result)},
+         {Key(options_, "done", fingerprint), "1"}})));
+    served_.insert(std::move(fingerprint));
+    ++num_compiled;
+  }
+  return num_compiled;
+}
+
+Status CompileFarmServer::Serve(absl::Duration poll_interval) {
+  while (!stop_.HasBeenNotified()) {
+    TF_ASSIGN_OR_RETURN(int num_compiled, ServeOnce());
+    if (num_compiled == 0) {
+      stop_.WaitForNotificationWithTimeout(poll_interval);
+    }
+  }
+  return OkStatus();
+}
+
+void CompileFarmServer::Stop() { stop_.Notify(); }
+
+}  // namespace xla
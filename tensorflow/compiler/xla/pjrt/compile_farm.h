@@ -0,0 +1,131 @@
+// This file contains a compile farm, which offloads the compilation of
+// executables from the hosts that run them to compile servers, through the
+// key-value store of the distributed runtime. Identical compilations requested
+// by several hosts are compiled once, and the serialized executable is shared.
+
+#ifndef TENSORFLOW_COMPILER_XLA_PJRT_COMPILE_FARM_H_
+#define TENSORFLOW_COMPILER_XLA_PJRT_COMPILE_FARM_H_
+
+#include <memory>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/pjrt/distributed/client.h"
+#include "tensorflow/compiler/xla/pjrt/pjrt_client.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace xla {
+
+// The target of the executables compiled by `client`: its platform, platform
+// version and device kind. Executables are only shared between clients with
+// the same target.
+std::string CompileFarmTarget(const PjRtClient& client);
+
+// The fingerprint of compiling `module` with `options` for `target`.
+StatusOr<std::string> CompileFarmFingerprint(const HloModuleProto& module,
+                                             const CompileOptions& options,
+                                             absl::string_view target);
+
+struct CompileFarmOptions {
+  // The directory of the key-value store used by the farm. The clients and
+  // the servers of one farm must use the same directory.
+  std::string directory = "compile_farm";
+  // How long a client waits for the executable of a request.
+  absl::Duration timeout = absl::Minutes(30);
+  // Whether a client compiles locally when the farm does not deliver a
+  // usable executable in time. Otherwise the error is returned.
+  bool fallback_to_local = true;
+};
+
+// Requests compilations from the compile servers of a farm.
+//
+// A request is published under the fingerprint of the module, the options
+// and the target. Hosts that request the same compilation publish the same
+// request and wait for the same result, so they are compiled once. Requests
+// on one client are also deduplicated before they reach the store. The
+// results stay in the store, so a later identical request does not wait for a
+// compilation.
+//
+// The executables are deserialized with PjRtClient::DeserializeExecutable,
+// which on GPU requires the XLA runtime
+// (--xla_gpu_enable_xla_runtime_executable=true).
+class CompileFarmClient {
+ public:
+  CompileFarmClient(PjRtClient* client,
+                    std::shared_ptr<DistributedRuntimeClient> kv_client,
+                    CompileFarmOptions options = {});
+
+  // Compile through the farm, or locally on fallback.
+  StatusOr<std::unique_ptr<PjRtLoadedExecutable>> Compile(
+      const XlaComputation& computation, CompileOptions options);
+
+  // Return the serialized executable compiled by the farm.
+  StatusOr<std::string> CompileSerialized(const XlaComputation& computation,
+                                          const CompileOptions& options);
+
+ private:
+  // A request of this client that is waiting for its result.
+  struct InFlight {
+    absl::Notification done;
+    StatusOr<std::string> result;
+  };
+
+  StatusOr<std::string> Request(const std::string& fingerprint,
+                                const HloModuleProto& module,
+                                const CompileOptions& options,
+                                const std::string& target);
+
+  PjRtClient* client_;
+  std::shared_ptr<DistributedRuntimeClient> kv_client_;
+  CompileFarmOptions options_;
+
+  absl::Mutex mu_;
+  absl::flat_hash_map<std::string, std::shared_ptr<InFlight>> in_flight_
+      ABSL_GUARDED_BY(mu_);
+};
+
+// Compiles the requests of a farm with `client`, which only needs to be able
+// to compile for the target of the requests. Several servers can serve one
+// farm: server `server_index` of `num_servers` takes the requests whose
+// fingerprints hash to its index. A server skips the requests for other
+// targets, so servers of different targets can share a farm.
+class CompileFarmServer {
+ public:
+  CompileFarmServer(PjRtClient* client,
+                    std::shared_ptr<DistributedRuntimeClient> kv_client,
+                    int server_index = 0, int num_servers = 1,
+                    CompileFarmOptions options = {});
+
+  // Compile the pending requests of this server, and return how many were
+  // compiled. A failed compilation is reported to the clients that wait for
+  // it, and is not an error of the server.
+  StatusOr<int> ServeOnce();
+
+  // Serve the requests, polling every `poll_interval`, until Stop() is
+  // called.
+  Status Serve(absl::Duration poll_interval = absl::Seconds(1));
+
+  void Stop();
+
+ private:
+  PjRtClient* client_;
+  std::shared_ptr<DistributedRuntimeClient> kv_client_;
+  int server_index_;
+  int num_servers_;
+  CompileFarmOptions options_;
+  std::string target_;
+
+  // The requests that are known to be served.
+  absl::flat_hash_set<std::string> served_;
+  absl::Notification stop_;
+};
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_PJRT_COMPILE_FARM_H_
@@ -0,0 +1,204 @@
+#include "tensorflow/compiler/xla/pjrt/compile_farm.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/strings/match.h"
+#include "absl/synchronization/mutex.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/pjrt/tfrt_cpu_pjrt_client.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/tsl/platform/env.h"
+
+namespace xla {
+namespace {
+
+// An in-memory key-value store with the semantics of the coordination
+// service: setting an existing key fails.
+class FakeKeyValueClient : public DistributedRuntimeClient {
+ public:
+  Status Connect() override { return OkStatus(); }
+  Status Shutdown() override { return OkStatus(); }
+  Status EnumerateDevices(const LocalTopologyProto& local_topology,
+                          GlobalTopologyProto* global_topology) override {
+    return Unimplemented("EnumerateDevices");
+  }
+
+  StatusOr<std::string> BlockingKeyValueGet(std::string key,
+                                            absl::Duration timeout) override {
+    absl::MutexLock lock(&mu_);
+    auto has_key = [&]() ABSL_SHARED_LOCKS_REQUIRED(mu_) {
+      return store_.contains(key);
+    };
+    if (!mu_.AwaitWithTimeout(absl::Condition(&has_key), timeout)) {
+      return tsl::errors::DeadlineExceeded("Timed out waiting for ", key);
+    }
+    return store_[key];
+  }
+
+  Status KeyValueSet(std::string key, std::string value) override {
+    absl::MutexLock lock(&mu_);
+    if (!store_.emplace(std::move(key), std::move(value)).second) {
+      return tsl::errors::AlreadyExists("The key exists.");
+    }
+    return OkStatus();
+  }
+
+  StatusOr<std::vector<std::string>> BlockingKeyValueBatchGet(
+      std::vector<std::string> keys, absl::Duration timeout) override {
+    std::vector<std::string> values;
+    for (std::string& key : keys) {
+      TF_ASSIGN_OR_RETURN(std::string value,
+                          BlockingKeyValueGet(std::move(key), timeout));
+      values.push_back(std::move(value));
+    }
+    return values;
+  }
+
+  Status KeyValueBatchSet(
+      std::vector<std::pair<std::string, std::string>> entries) override {
+    Status status;
+    for (auto& [key, value] : entries) {
+      status.Update(KeyValueSet(std::move(key), std::move(value)));
+    }
+    return status;
+  }
+
+  StatusOr<std::vector<std::pair<std::string, std::string>>> KeyValueDirGet(
+      std::string directory) override {
+    absl::MutexLock lock(&mu_);
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (const auto& [key, value] : store_) {
+      if (absl::StartsWith(key, directory + "/")) {
+        entries.push_back({key, value});
+      }
+    }
+    return entries;
+  }
+
+  Status WaitAtBarrier(std::string barrier_id,
+                       absl::Duration timeout) override {
+    return Unimplemented("WaitAtBarrier");
+  }
+
+  StatusOr<tensorflow::CoordinationServiceAgent*> GetCoordinationServiceAgent()
+      override {
+    return Unimplemented("GetCoordinationServiceAgent");
+  }
+
+ private:
+  absl::Mutex mu_;
+  std::map<std::string, std::string> store_ ABSL_GUARDED_BY(mu_);
+};
+
+constexpr char kProgram[] = R"(HloModule Add
+ENTRY Add {
+  x = f32[2,2] parameter(0)
+  ROOT add = f32[2,2] add(x, x)
+})";
+
+XlaComputation ParseComputation(const char* program) {
+  auto hlo_module = ParseAndReturnUnverifiedModule(program, {});
+  CHECK(hlo_module.ok()) << hlo_module.status();
+  return XlaComputation((*hlo_module)->ToProto());
+}
+
+TEST(CompileFarmTest, CompileOnServer) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(/*asynchronous=*/true));
+  TF_ASSERT_OK_AND_ASSIGN(auto server_client,
+                          GetTfrtCpuClient(/*asynchronous=*/true));
+  auto kv_client = std::make_shared<FakeKeyValueClient>();
+  CompileFarmServer server(server_client.get(), kv_client);
+  std::unique_ptr<tsl::Thread> server_thread(tsl::Env::Default()->StartThread(
+      {}, "compile_farm_server",
+      [&] { TF_CHECK_OK(server.Serve(absl::Milliseconds(10))); }));
+
+  CompileFarmOptions options;
+  options.fallback_to_local = false;
+  CompileFarmClient farm(client.get(), kv_client, options);
+  TF_ASSERT_OK_AND_ASSIGN(auto executable,
+                          farm.Compile(ParseComputation(kProgram), {}));
+  server.Stop();
+  server_thread.reset();
+
+  std::vector<float> data = {1, 2, 3, 4};
+  Shape shape = ShapeUtil::MakeShape(F32, {2, 2});
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto buffer,
+      client->BufferFromHostBuffer(
+          data.data(), shape.element_type(), shape.dimensions(),
+          /*byte_strides=*/std::nullopt,
+          PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall, nullptr,
+          client->addressable_devices()[0]));
+  TF_ASSERT_OK_AND_ASSIGN(auto result,
+                          executable->Execute(
+                              /*argument_handles=*/{{buffer.get()}},
+                              /*options=*/{}));
+  TF_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Literal> literal,
+                          result[0][0]->ToLiteralSync());
+  EXPECT_TRUE(LiteralTestUtil::Equal(
+      LiteralUtil::CreateR2<float>({{2, 4}, {6, 8}}), *literal));
+}
+
+TEST(CompileFarmTest, IdenticalRequestsCompileOnce) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(/*asynchronous=*/true));
+  auto kv_client = std::make_shared<FakeKeyValueClient>();
+  CompileFarmOptions options;
+  options.fallback_to_local = false;
+  CompileFarmClient farm_a(client.get(), kv_client, options);
+  CompileFarmClient farm_b(client.get(), kv_client, options);
+
+  // Two hosts request the same compilation before the server runs.
+  std::string serialized_a, serialized_b;
+  {
+    std::unique_ptr<tsl::Thread> host_a(tsl::Env::Default()->StartThread(
+        {}, "host_a", [&] {
+          serialized_a =
+              farm_a.CompileSerialized(ParseComputation(kProgram), {}).value();
+        }));
+    std::unique_ptr<tsl::Thread> host_b(tsl::Env::Default()->StartThread(
+        {}, "host_b", [&] {
+          serialized_b =
+              farm_b.CompileSerialized(ParseComputation(kProgram), {}).value();
+        }));
+    while (kv_client->KeyValueDirGet("compile_farm/request")->empty()) {
+      tsl::Env::Default()->SleepForMicroseconds(1000);
+    }
+    CompileFarmServer server(client.get(), kv_client);
+    int num_compiled = 0;
+    while (num_compiled == 0) {
+      TF_ASSERT_OK_AND_ASSIGN(num_compiled, server.ServeOnce());
+    }
+    EXPECT_EQ(num_compiled, 1);
+    TF_ASSERT_OK_AND_ASSIGN(num_compiled, server.ServeOnce());
+    EXPECT_EQ(num_compiled, 0);
+  }
+  EXPECT_FALSE(serialized_a.empty());
+  EXPECT_EQ(serialized_a, serialized_b);
+}
+
+TEST(CompileFarmTest, FallBackToLocalCompilation) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(/*asynchronous=*/true));
+  auto kv_client = std::make_shared<FakeKeyValueClient>();
+  CompileFarmOptions options;
+  options.timeout = absl::Milliseconds(10);
+
+  // No server serves the farm.
+  CompileFarmClient farm(client.get(), kv_client, options);
+  TF_ASSERT_OK_AND_ASSIGN(auto executable,
+                          farm.Compile(ParseComputation(kProgram), {}));
+  EXPECT_NE(executable, nullptr);
+
+  options.fallback_to_local = false;
+  CompileFarmClient strict_farm(client.get(), kv_client, options);
+  EXPECT_FALSE(strict_farm.Compile(ParseComputation(kProgram), {}).ok());
+}
+
+}  // namespace
+}  // namespace xla
@@ -0,0 +1,248 @@
+#include "tensorflow/compiler/xla/pjrt/continuous_batching.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/algorithm/container.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/logging.h"
+#include "tensorflow/tsl/profiler/lib/traceme.h"
+
+namespace xla {
+
+PagedKvCacheAllocator::PagedKvCacheAllocator(int num_pages)
+    : num_pages_(num_pages) {
+  // Pop the low pages first.
+  for (int32_t page = num_pages - 1; page >= 0; --page) {
+    free_pages_.push_back(page);
+  }
+}
+
+bool PagedKvCacheAllocator::Allocate(int num_pages,
+                                     std::vector<int32_t>* pages) {
+  if (num_pages > num_free_pages()) {
+    return false;
+  }
+  for (int i = 0; i < num_pages; ++i) {
+    pages->push_back(free_pages_.back());
+    free_pages_.pop_back();
+  }
+  return true;
+}
+
+void PagedKvCacheAllocator::Free(absl::Span<const int32_t> pages) {
+  free_pages_.insert(free_pages_.end(), pages.rbegin(), pages.rend());
+}
+
+StatusOr<std::unique_ptr<ContinuousBatchingEngine>>
+ContinuousBatchingEngine::Create(
+    PjRtLoadedExecutable* decode_step,
+    std::vector<std::unique_ptr<PjRtBuffer>> kv_cache,
+    ContinuousBatchingOptions options) {
+  if (decode_step->addressable_devices().size() != 1) {
+    return InvalidArgument(
+        "The decode step of continuous batching must run on one device, but "
+        "runs on %d.",
+        decode_step->addressable_devices().size());
+  }
+  if (options.num_slots <= 0 || options.num_pages <= 0 ||
+      options.page_size <= 0 || options.max_pages_per_slot <= 0) {
+    return InvalidArgument("Invalid continuous batching options.");
+  }
+  if (kv_cache.empty()) {
+    return InvalidArgument("Continuous batching needs a KV cache.");
+  }
+  for (const auto& buffer : kv_cache) {
+    const Shape& shape = buffer->on_device_shape();
+    if (!shape.IsArray() || shape.rank() == 0 ||
+        shape.dimensions(0) != options.num_pages) {
+      return InvalidArgument("The KV cache buffer %s does not have %d pages.",
+                             shape.ToString(), options.num_pages);
+    }
+  }
+  return std::unique_ptr<ContinuousBatchingEngine>(new ContinuousBatchingEngine(
+      decode_step, std::move(kv_cache), std::move(options)));
+}
+
+ContinuousBatchingEngine::ContinuousBatchingEngine(
+    PjRtLoadedExecutable* decode_step,
+    std::vector<std::unique_ptr<PjRtBuffer>> kv_cache,
+    ContinuousBatchingOptions options)
+    : decode_step_(decode_step),
+      device_(decode_step->addressable_devices()[0]),
+      kv_cache_(std::move(kv_cache)),
+      options_(std::move(options)),
+      allocator_(options_.num_pages),
+      slots_(options_.num_slots) {}
+
+void ContinuousBatchingEngine::Submit(std::vector<int32_t> prompt,
+                                      int max_new_tokens, DoneCallback done) {
+  // The last generated token is never fed back, so its KV is not cached.
+  const int64_t max_cached_tokens =
+      static_cast<int64_t>(prompt.size()) + max_new_tokens - 1;
+  const int64_t max_pages =
+      (max_cached_tokens + options_.page_size - 1) / options_.page_size;
+  if (prompt.empty() || max_new_tokens <= 0) {
+    done(InvalidArgument("A request needs a prompt and new tokens."));
+    return;
+  }
+  if (max_pages > std::min(options_.num_pages, options_.max_pages_per_slot)) {
+    done(InvalidArgument(
+        "A request of %d tokens needs %d pages of the KV cache, more than the "
+        "%d pages of a slot.",
+        max_cached_tokens + 1, max_pages,
+        std::min(options_.num_pages, options_.max_pages_per_slot)));
+    return;
+  }
+  auto sequence = std::make_unique<Sequence>();
+  sequence->num_prompt_tokens = prompt.size();
+  sequence->tokens = std::move(prompt);
+  sequence->max_new_tokens = max_new_tokens;
+  sequence->done = std::move(done);
+  absl::MutexLock lock(&mu_);
+  queue_.push_back(std::move(sequence));
+}
+
+void ContinuousBatchingEngine::Admit() {
+  absl::MutexLock lock(&mu_);
+  for (int slot = 0; slot < options_.num_slots; ++slot) {
+    if (queue_.empty() || allocator_.num_free_pages() == 0) {
+      return;
+    }
+    if (slots_[slot] == nullptr) {
+      slots_[slot] = std::move(queue_.front());
+      queue_.pop_front();
+      admission_order_.push_back(slot);
+    }
+  }
+}
+
+std::unique_ptr<ContinuousBatchingEngine::Sequence>
+ContinuousBatchingEngine::Release(int slot) {
+  std::unique_ptr<Sequence> sequence = std::move(slots_[slot]);
+  allocator_.Free(sequence->pages);
+  sequence->pages.clear();
+  admission_order_.erase(absl::c_find(admission_order_, slot));
+  return sequence;
+}
+
+bool ContinuousBatchingEngine::IsDone(const Sequence& sequence) const {
+  const int num_generated =
+      sequence.tokens.size() - sequence.num_prompt_tokens;
+  return num_generated >= sequence.max_new_tokens ||
+         (num_generated > 0 && options_.eos_token >= 0 &&
+          sequence.tokens.back() == options_.eos_token);
+}
+
+StatusOr<int> ContinuousBatchingEngine::Step() {
+  tsl::profiler::TraceMe traceme("ContinuousBatchingEngine::Step");
+  Admit();
+
+  // Give each sequence the page of its input token, the earliest admitted
+  // first, preempting the latest admitted sequences when the cache is full.
+  for (size_t i = 0; i < admission_order_.size();) {
+    Sequence& sequence = *slots_[admission_order_[i]];
+    if (sequence.position <
+            static_cast<int>(sequence.pages.size()) * options_.page_size ||
+        allocator_.Allocate(1, &sequence.pages)) {
+      ++i;
+      continue;
+    }
+    std::unique_ptr<Sequence> preempted = Release(admission_order_.back());
+    preempted->position = 0;
+    ++stats_.num_preemptions;
+    VLOG(2) << "Preempted a sequence of " << preempted->tokens.size()
+            << " tokens.";
+    absl::MutexLock lock(&mu_);
+    queue_.push_front(std::move(preempted));
+  }
+  if (admission_order_.empty()) {
+    return 0;
+  }
+
+  const int num_slots = options_.num_slots;
+  const int max_pages = options_.max_pages_per_slot;
+  std::vector<int32_t> page_table(num_slots * max_pages, -1);
+  std::vector<int32_t> tokens(num_slots, 0);
+  std::vector<int32_t> positions(num_slots, -1);
+  for (int slot : admission_order_) {
+    const Sequence& sequence = *slots_[slot];
+    tokens[slot] = sequence.tokens[sequence.position];
+    positions[slot] = sequence.position;
+    absl::c_copy(sequence.pages, page_table.begin() + slot * max_pages);
+  }
+  PjRtClient* client = decode_step_->client();
+  auto to_device = [&](const std::vector<int32_t>& data,
+                       std::vector<int64_t> dims) {
+    return client->BufferFromHostBuffer(
+        data.data(), S32, dims, /*byte_strides=*/std::nullopt,
+        PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall,
+        /*on_done_with_host_buffer=*/nullptr, device_);
+  };
+  TF_ASSIGN_OR_RETURN(auto page_table_buffer,
+                      to_device(page_table, {num_slots, max_pages}));
+  TF_ASSIGN_OR_RETURN(auto tokens_buffer, to_device(tokens, {num_slots}));
+  TF_ASSIGN_OR_RETURN(auto positions_buffer,
+                      to_device(positions, {num_slots}));
+
+  std::vector<PjRtBuffer*> arguments;
+  for (const auto& buffer : kv_cache_) {
+    arguments.push_back(buffer.get());
+  }
+  arguments.push_back(page_table_buffer.get());
+  arguments.push_back(tokens_buffer.get());
+  arguments.push_back(positions_buffer.get());
+  ExecuteOptions execute_options;
+  execute_options.untuple_result = true;
+  TF_ASSIGN_OR_RETURN(
+      std::vector<std::unique_ptr<PjRtBuffer>> outputs,
+      decode_step_->ExecuteSharded(arguments, device_, execute_options));
+  if (outputs.size() != kv_cache_.size() + 1) {
+    return InternalError(
+        "The decode step returns %d outputs instead of the %d KV cache "
+        "buffers and the next tokens.",
+        outputs.size(), kv_cache_.size());
+  }
+  // The KV cache buffers were donated to the step.
+  for (size_t i = 0; i < kv_cache_.size(); ++i) {
+    kv_cache_[i] = std::move(outputs[i]);
+  }
+  TF_ASSIGN_OR_RETURN(std::shared_ptr<Literal> next_tokens,
+                      outputs.back()->ToLiteralSync());
+
+  const int num_active = admission_order_.size();
+  ++stats_.num_steps;
+  stats_.num_tokens += num_active;
+  for (int slot : std::vector<int>(admission_order_)) {
+    Sequence& sequence = *slots_[slot];
+    // The outputs of the prompt tokens but the last are not generated.
+    if (++sequence.position == static_cast<int>(sequence.tokens.size())) {
+      sequence.tokens.push_back(next_tokens->data<int32_t>()[slot]);
+      ++stats_.num_generated_tokens;
+    }
+    if (IsDone(sequence)) {
+      std::unique_ptr<Sequence> finished = Release(slot);
+      finished->done(std::vector<int32_t>(
+          finished->tokens.begin() + finished->num_prompt_tokens,
+          finished->tokens.end()));
+    }
+  }
+  return num_active;
+}
+
+Status ContinuousBatchingEngine::RunUntilIdle() {
+  while (true) {
+    TF_ASSIGN_OR_RETURN(int num_active, Step());
+    if (num_active == 0) {
+      absl::MutexLock lock(&mu_);
+      if (queue_.empty()) {
+        return OkStatus();
+      }
+      return InternalError("%d requests can not be admitted.", queue_.size());
+    }
+  }
+}
+
+}  // namespace xla
@@ -0,0 +1,153 @@
+// This file contains a continuous batching engine, which serves autoregressive
+// generation requests with a decode step compiled once for a fixed number of
+// batch slots. Requests enter and leave the batch between decode steps, so
+// new requests do not wait for the whole batch to finish, and the KV cache is
+// paged so that sequences only hold the device memory of their tokens.
+
+#ifndef TENSORFLOW_COMPILER_XLA_PJRT_CONTINUOUS_BATCHING_H_
+#define TENSORFLOW_COMPILER_XLA_PJRT_CONTINUOUS_BATCHING_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/pjrt/pjrt_client.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace xla {
+
+// Allocates the pages of a paged KV cache. The pages live in the KV cache
+// buffers on the device; this only tracks which of them are free.
+class PagedKvCacheAllocator {
+ public:
+  explicit PagedKvCacheAllocator(int num_pages);
+
+  // Appends `num_pages` pages to `pages`. Returns false, and allocates
+  // nothing, if fewer pages are free.
+  bool Allocate(int num_pages, std::vector<int32_t>* pages);
+
+  void Free(absl::Span<const int32_t> pages);
+
+  int num_pages() const { return num_pages_; }
+  int num_free_pages() const { return free_pages_.size(); }
+
+ private:
+  int num_pages_;
+  std::vector<int32_t> free_pages_;
+};
+
+struct ContinuousBatchingOptions {
+  // The batch size of the decode step.
+  int num_slots = 8;
+  // The number of pages of the KV cache buffers.
+  int num_pages = 256;
+  // The number of tokens of a page.
+  int page_size = 16;
+  // The number of columns of the page table, which bounds the length of a
+  // sequence to `max_pages_per_slot * page_size` tokens.
+  int max_pages_per_slot = 128;
+  // The token that ends a sequence, or -1.
+  int32_t eos_token = -1;
+};
+
+struct ContinuousBatchingStats {
+  int64_t num_steps = 0;
+  // The tokens computed by the decode steps, including the prompt tokens.
+  int64_t num_tokens = 0;
+  int64_t num_generated_tokens = 0;
+  int64_t num_preemptions = 0;
+};
+
+// Serves generation requests with `decode_step`, an executable of one device
+// with the parameters
+//
+//   kv_cache_0, ..., kv_cache_{k-1}: the KV cache buffers, whose leading
+//       dimension is the page, e.g., f32[num_pages, page_size, heads, dim]
+//   page_table: s32[num_slots, max_pages_per_slot], the pages of each slot,
+//       -1 past the last page
+//   tokens: s32[num_slots], the input token of each slot
+//   positions: s32[num_slots], the position of the input token in its
+//       sequence, or -1 for an empty slot
+//
+// that writes the KV of each input token to its position in the pages of its
+// slot, skipping the slots at position -1, and returns the tuple
+// (kv_cache_0, ..., kv_cache_{k-1}, next_tokens: s32[num_slots]). The KV cache
+// parameters should be aliased to the outputs, so that the cache buffers are
+// donated to each step instead of being copied.
+//
+// The prompts are fed one token per step through the same decode step, so
+// prefill and decode of different requests share the batch. Pages are
+// allocated as the sequences grow. When a sequence needs a page and none is
+// free, the latest admitted sequence is preempted: its pages are freed and it
+// is queued again, to recompute its cache when it is readmitted.
+//
+// Submit() may be called from any thread. Step() and RunUntilIdle() must be
+// called from a single thread, which also runs the callbacks.
+class ContinuousBatchingEngine {
+ public:
+  // The generated tokens, or the error of the request.
+  using DoneCallback = std::function<void(StatusOr<std::vector<int32_t>>)>;
+
+  static StatusOr<std::unique_ptr<ContinuousBatchingEngine>> Create(
+      PjRtLoadedExecutable* decode_step,
+      std::vector<std::unique_ptr<PjRtBuffer>> kv_cache,
+      ContinuousBatchingOptions options);
+
+  // Queue a request to generate up to `max_new_tokens` tokens after `prompt`.
+  void Submit(std::vector<int32_t> prompt, int max_new_tokens,
+              DoneCallback done);
+
+  // Fill the free slots with queued requests and run one decode step. Return
+  // the number of slots in the step.
+  StatusOr<int> Step();
+
+  // Step until all the submitted requests are done.
+  Status RunUntilIdle();
+
+  ContinuousBatchingStats stats() const { return stats_; }
+
+ private:
+  struct Sequence {
+    // The prompt and the generated tokens.
+    std::vector<int32_t> tokens;
+    int num_prompt_tokens;
+    int max_new_tokens;
+    DoneCallback done;
+    // The number of tokens in the KV cache.
+    int position = 0;
+    std::vector<int32_t> pages;
+  };
+
+  ContinuousBatchingEngine(PjRtLoadedExecutable* decode_step,
+                           std::vector<std::unique_ptr<PjRtBuffer>> kv_cache,
+                           ContinuousBatchingOptions options);
+
+  void Admit();
+  // Free the pages of the sequence in `slot` and empty the slot.
+  std::unique_ptr<Sequence> Release(int slot);
+  bool IsDone(const Sequence& sequence) const;
+
+  PjRtLoadedExecutable* decode_step_;
+  PjRtDevice* device_;
+  std::vector<std::unique_ptr<PjRtBuffer>> kv_cache_;
+  ContinuousBatchingOptions options_;
+  PagedKvCacheAllocator allocator_;
+
+  // The sequence of each slot, or null, and the occupied slots in the order
+  // of admission.
+  std::vector<std::unique_ptr<Sequence>> slots_;
+  std::vector<int> admission_order_;
+  ContinuousBatchingStats stats_;
+
+  absl::Mutex mu_;
+  std::deque<std::unique_ptr<Sequence>> queue_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_PJRT_CONTINUOUS_BATCHING_H_
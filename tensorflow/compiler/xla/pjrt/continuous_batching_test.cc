@@ -0,0 +1,137 @@
+#include "tensorflow/compiler/xla/pjrt/continuous_batching.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/pjrt/tfrt_cpu_pjrt_client.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/tsl/lib/core/status_test_util.h"
+
+namespace xla {
+namespace {
+
+using ::testing::ElementsAre;
+
+// A decode step of 2 slots and a KV cache of 4 pages of 2 tokens that
+// generates the successor of each input token.
+constexpr char kDecodeStep[] = R"(
+HloModule DecodeStep, input_output_alias={ {0}: (0, {}, may-alias) }
+
+ENTRY DecodeStep {
+  kv_cache = f32[4,2] parameter(0)
+  page_table = s32[2,8] parameter(1)
+  tokens = s32[2] parameter(2)
+  positions = s32[2] parameter(3)
+  one = s32[] constant(1)
+  ones = s32[2] broadcast(one), dimensions={}
+  next_tokens = s32[2] add(tokens, ones)
+  ROOT result = (f32[4,2], s32[2]) tuple(kv_cache, next_tokens)
+}
+)";
+
+class ContinuousBatchingTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    TF_ASSERT_OK_AND_ASSIGN(client_, GetTfrtCpuClient(/*asynchronous=*/true));
+    TF_ASSERT_OK_AND_ASSIGN(auto module,
+                            ParseAndReturnUnverifiedModule(kDecodeStep));
+    TF_ASSERT_OK_AND_ASSIGN(
+        decode_step_,
+        client_->Compile(XlaComputation(module->ToProto()), CompileOptions()));
+  }
+
+  StatusOr<std::unique_ptr<ContinuousBatchingEngine>> CreateEngine(
+      int num_pages) {
+    std::vector<float> kv_cache(num_pages * 2, 0.0f);
+    TF_ASSIGN_OR_RETURN(
+        std::unique_ptr<PjRtBuffer> buffer,
+        client_->BufferFromHostBuffer(
+            kv_cache.data(), F32, {num_pages, 2},
+            /*byte_strides=*/std::nullopt,
+            PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall,
+            nullptr, client_->addressable_devices()[0]));
+    std::vector<std::unique_ptr<PjRtBuffer>> buffers;
+    buffers.push_back(std::move(buffer));
+    ContinuousBatchingOptions options;
+    options.num_slots = 2;
+    options.num_pages = num_pages;
+    options.page_size = 2;
+    options.max_pages_per_slot = 8;
+    options.eos_token = 100;
+    return ContinuousBatchingEngine::Create(decode_step_.get(),
+                                            std::move(buffers), options);
+  }
+
+  std::unique_ptr<PjRtClient> client_;
+  std::unique_ptr<PjRtLoadedExecutable> decode_step_;
+};
+
+TEST(PagedKvCacheAllocatorTest, AllocateAndFree) {
+  PagedKvCacheAllocator allocator(4);
+  std::vector<int32_t> pages;
+  EXPECT_TRUE(allocator.Allocate(3, &pages));
+  EXPECT_THAT(pages, ElementsAre(0, 1, 2));
+  EXPECT_FALSE(allocator.Allocate(2, &pages));
+  EXPECT_EQ(allocator.num_free_pages(), 1);
+  allocator.Free(pages);
+  EXPECT_EQ(allocator.num_free_pages(), 4);
+}
+
+TEST_F(ContinuousBatchingTest, RefillsFinishedSlots) {
+  TF_ASSERT_OK_AND_ASSIGN(auto engine, CreateEngine(/*num_pages=*/4));
+  std::vector<std::vector<int32_t>> results(4);
+  // More requests than slots, of different lengths.
+  const std::vector<std::vector<int32_t>> prompts = {{5}, {10, 11}, {20}, {98}};
+  const std::vector<int> max_new_tokens = {3, 1, 2, 5};
+  for (int i = 0; i < static_cast<int>(prompts.size()); ++i) {
+    engine->Submit(prompts[i], max_new_tokens[i],
+                   [&results, i](StatusOr<std::vector<int32_t>> tokens) {
+                     TF_ASSERT_OK(tokens.status());
+                     results[i] = *std::move(tokens);
+                   });
+  }
+  TF_ASSERT_OK(engine->RunUntilIdle());
+  EXPECT_THAT(results[0], ElementsAre(6, 7, 8));
+  EXPECT_THAT(results[1], ElementsAre(12));
+  EXPECT_THAT(results[2], ElementsAre(21, 22));
+  // Stops at the end token.
+  EXPECT_THAT(results[3], ElementsAre(99, 100));
+  // The second slot is refilled while the first request still runs.
+  EXPECT_LT(engine->stats().num_steps, 3 + 2 + 2 + 2);
+  EXPECT_EQ(engine->stats().num_generated_tokens, 8);
+}
+
+TEST_F(ContinuousBatchingTest, PreemptsWhenTheCacheIsFull) {
+  // Each request needs 3 of the 4 pages.
+  TF_ASSERT_OK_AND_ASSIGN(auto engine, CreateEngine(/*num_pages=*/4));
+  std::vector<std::vector<int32_t>> results(2);
+  for (int i = 0; i < 2; ++i) {
+    engine->Submit({10 * i}, 6,
+                   [&results, i](StatusOr<std::vector<int32_t>> tokens) {
+                     TF_ASSERT_OK(tokens.status());
+                     results[i] = *std::move(tokens);
+                   });
+  }
+  TF_ASSERT_OK(engine->RunUntilIdle());
+  EXPECT_THAT(results[0], ElementsAre(1, 2, 3, 4, 5, 6));
+  EXPECT_THAT(results[1], ElementsAre(11, 12, 13, 14, 15, 16));
+  EXPECT_GT(engine->stats().num_preemptions, 0);
+}
+
+TEST_F(ContinuousBatchingTest, RejectsTooLongRequests) {
+  TF_ASSERT_OK_AND_ASSIGN(auto engine, CreateEngine(/*num_pages=*/4));
+  bool rejected = false;
+  engine->Submit({1, 2, 3}, 8, [&](StatusOr<std::vector<int32_t>> tokens) {
+    rejected = !tokens.ok();
+  });
+  EXPECT_TRUE(rejected);
+  TF_ASSERT_OK(engine->RunUntilIdle());
+  EXPECT_EQ(engine->stats().num_steps, 0);
+}
+
+}  // namespace
+}  // namespace xla
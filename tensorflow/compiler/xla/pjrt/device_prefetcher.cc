@@ -0,0 +1,182 @@
+#include "tensorflow/compiler/xla/pjrt/device_prefetcher.h"
+
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/pjrt/pjrt_stream_executor_client.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/profiler/lib/traceme.h"
+
+namespace xla {
+namespace {
+
+// Calls the on_done callback of a host array when the last transfer reading
+// it releases it.
+class HostArrayRelease {
+ public:
+  explicit HostArrayRelease(std::function<void()> on_done)
+      : on_done_(std::move(on_done)) {}
+  ~HostArrayRelease() {
+    if (on_done_) on_done_();
+  }
+
+ private:
+  std::function<void()> on_done_;
+};
+
+}  // namespace
+
+DevicePrefetcher::DevicePrefetcher(PjRtClient* client,
+                                   std::vector<PjRtDevice*> devices,
+                                   HostBatchProducer producer,
+                                   const DevicePrefetcherOptions& options)
+    : client_(client),
+      devices_(std::move(devices)),
+      producer_(std::move(producer)),
+      options_(options) {
+  CHECK(!devices_.empty());
+  CHECK_GT(options_.prefetch_depth, 0);
+  thread_.reset(tsl::Env::Default()->StartThread(
+      tsl::ThreadOptions(), "DevicePrefetcher", [this]() { Run(); }));
+}
+
+DevicePrefetcher::~DevicePrefetcher() {
+  {
+    absl::MutexLock lock(&mu_);
+    cancelled_ = true;
+  }
+  // Joins the thread, which finishes the batch it is transferring.
+  thread_.reset();
+}
+
+void DevicePrefetcher::Run() {
+  while (true) {
+    {
+      absl::MutexLock lock(&mu_);
+      auto has_room = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        return cancelled_ || ready_.size() < options_.prefetch_depth;
+      };
+      mu_.Await(absl::Condition(&has_room));
+      if (cancelled_) return;
+    }
+
+    StatusOr<std::optional<std::vector<HostArray>>> batch = producer_();
+    StatusOr<DeviceBatch> device_batch;
+    if (!batch.ok()) {
+      device_batch = batch.status();
+    } else if (!batch->has_value()) {
+      absl::MutexLock lock(&mu_);
+      exhausted_ = true;
+      return;
+    } else {
+      device_batch = TransferToDevices(std::move(**batch));
+    }
+
+    absl::MutexLock lock(&mu_);
+    if (!device_batch.ok()) {
+      exhausted_ = true;
+    }
+    ready_.push_back(std::move(device_batch));
+    if (exhausted_) return;
+  }
+}
+
+StatusOr<DeviceBatch> DevicePrefetcher::TransferToDevices(
+    std::vector<HostArray> batch) {
+  tsl::profiler::TraceMe traceme("DevicePrefetcher::TransferToDevices");
+  const int64_t num_devices = devices_.size();
+  std::vector<std::shared_ptr<HostArrayRelease>> releases;
+  releases.reserve(batch.size());
+  for (HostArray& array : batch) {
+    releases.push_back(
+        std::make_shared<HostArrayRelease>(std::move(array.on_done)));
+  }
+
+  // The shape and byte size of the shard of each array.
+  std::vector<std::vector<int64_t>> shard_dims(batch.size());
+  std::vector<int64_t> shard_bytes(batch.size());
+  for (int i = 0; i < batch.size(); ++i) {
+    const HostArray& array = batch[i];
+    if (array.dims.empty() || array.dims[0] % num_devices != 0) {
+      return InvalidArgument(
+          "The leading dimension of array %d of the batch, of shape [%s], is "
+          "not divisible by the %d devices",
+          i, absl::StrJoin(array.dims, ","), num_devices);
+    }
+    shard_dims[i] = array.dims;
+    shard_dims[i][0] /= num_devices;
+    shard_bytes[i] = ShapeUtil::ByteSizeOfPrimitiveType(array.type);
+    for (int64_t dim : shard_dims[i]) {
+      shard_bytes[i] *= dim;
+    }
+  }
+  auto shard_data = [&](int i, int d) {
+    return static_cast<const char*>(batch[i].data) + d * shard_bytes[i];
+  };
+
+  DeviceBatch device_batch(batch.size());
+  for (auto& shards : device_batch) {
+    shards.resize(num_devices);
+  }
+  auto* se_client = dynamic_cast<PjRtStreamExecutorClient*>(client_);
+  for (int d = 0; d < num_devices; ++d) {
+    if (se_client != nullptr) {
+      // The shards are copied to pinned staging memory during the call.
+      std::vector<PjRtStreamExecutorClient::HostBuffer> host_buffers;
+      host_buffers.reserve(batch.size());
+      for (int i = 0; i < batch.size(); ++i) {
+        host_buffers.push_back(
+            {shard_data(i, d), batch[i].type, shard_dims[i]});
+      }
+      TF_ASSIGN_OR_RETURN(
+          std::vector<std::unique_ptr<PjRtBuffer>> buffers,
+          se_client->BuffersFromHostBuffers(host_buffers, devices_[d]));
+      for (int i = 0; i < batch.size(); ++i) {
+        device_batch[i][d] = std::move(buffers[i]);
+      }
+      continue;
+    }
+    for (int i = 0; i < batch.size(); ++i) {
+      TF_ASSIGN_OR_RETURN(
+          device_batch[i][d],
+          client_->BufferFromHostBuffer(
+              shard_data(i, d), batch[i].type, shard_dims[i],
+              /*byte_strides=*/std::nullopt,
+              PjRtClient::HostBufferSemantics::kImmutableUntilTransferCompletes,
+              [release = releases[i]]() {}, devices_[d]));
+    }
+  }
+  // Releases the host arrays whose transfers no longer read them.
+  releases.clear();
+
+  if (options_.wait_until_ready) {
+    for (auto& shards : device_batch) {
+      for (auto& buffer : shards) {
+        TF_RETURN_IF_ERROR(buffer->GetReadyFuture().Await());
+      }
+    }
+  }
+  return device_batch;
+}
+
+StatusOr<std::optional<DeviceBatch>> DevicePrefetcher::GetNext() {
+  absl::MutexLock lock(&mu_);
+  auto has_batch = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return !ready_.empty() || exhausted_;
+  };
+  mu_.Await(absl::Condition(&has_batch));
+  if (ready_.empty()) {
+    return std::optional<DeviceBatch>();
+  }
+  StatusOr<DeviceBatch> batch = std::move(ready_.front());
+  ready_.pop_front();
+  TF_RETURN_IF_ERROR(batch.status());
+  return std::optional<DeviceBatch>(std::move(*batch));
+}
+
+}  // namespace xla
@@ -0,0 +1,88 @@
+// This file contains a prefetcher that shards the batches of a host input
+// pipeline, e.g. a tf.data iterator, across a list of devices ahead of the
+// step that consumes them, so that the input transfer of a batch overlaps the
+// previous step.
+
+#ifndef TENSORFLOW_COMPILER_XLA_PJRT_DEVICE_PREFETCHER_H_
+#define TENSORFLOW_COMPILER_XLA_PJRT_DEVICE_PREFETCHER_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "tensorflow/compiler/xla/pjrt/pjrt_client.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+#include "tensorflow/tsl/platform/env.h"
+
+namespace xla {
+
+// A dense major-to-minor host array of a batch. Its leading dimension is
+// split evenly across the devices.
+struct HostArray {
+  const void* data;
+  PrimitiveType type;
+  std::vector<int64_t> dims;
+  // Called once the prefetcher no longer reads `data`. May be null.
+  std::function<void()> on_done;
+};
+
+// Returns the next batch of the input, or std::nullopt at its end.
+using HostBatchProducer =
+    std::function<StatusOr<std::optional<std::vector<HostArray>>>()>;
+
+// The shards of a batch. shards[i][d] is the shard of array i on device d.
+using DeviceBatch = std::vector<std::vector<std::unique_ptr<PjRtBuffer>>>;
+
+struct DevicePrefetcherOptions {
+  // The number of batches transferred ahead of GetNext().
+  int prefetch_depth = 2;
+  // Whether a batch is only handed out once its transfers are complete.
+  // Otherwise the buffers may still be pending, and computations that use
+  // them wait for their definition events.
+  bool wait_until_ready = true;
+};
+
+// Pulls batches from a producer on a background thread and transfers them to
+// `devices`, keeping a ring of up to `prefetch_depth` batches ready for
+// GetNext(). On PjRtStreamExecutorClient the shards of a device are staged
+// through pinned host memory and copied with one BuffersFromHostBuffers call.
+class DevicePrefetcher {
+ public:
+  DevicePrefetcher(PjRtClient* client, std::vector<PjRtDevice*> devices,
+                   HostBatchProducer producer,
+                   const DevicePrefetcherOptions& options = {});
+
+  // Stops pulling batches and drops the batches not handed out.
+  ~DevicePrefetcher();
+
+  // Blocks until the next batch is on the devices. Returns std::nullopt at
+  // the end of the input, and the error of the producer or of a transfer
+  // once the batches before it are handed out.
+  StatusOr<std::optional<DeviceBatch>> GetNext();
+
+ private:
+  void Run();
+  StatusOr<DeviceBatch> TransferToDevices(std::vector<HostArray> batch);
+
+  PjRtClient* const client_;
+  const std::vector<PjRtDevice*> devices_;
+  const HostBatchProducer producer_;
+  const DevicePrefetcherOptions options_;
+
+  absl::Mutex mu_;
+  std::deque<StatusOr<DeviceBatch>> ready_ ABSL_GUARDED_BY(mu_);
+  // Whether the producer reached the end of the input or failed.
+  bool exhausted_ ABSL_GUARDED_BY(mu_) = false;
+  bool cancelled_ ABSL_GUARDED_BY(mu_) = false;
+
+  std::unique_ptr<tsl::Thread> thread_;
+};
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_PJRT_DEVICE_PREFETCHER_H_
@@ -0,0 +1,91 @@
+#include "tensorflow/compiler/xla/pjrt/device_prefetcher.h"
+
+#include <atomic>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/pjrt/tfrt_cpu_pjrt_client.h"
+#include "tensorflow/compiler/xla/test.h"
+
+namespace xla {
+namespace {
+
+// Produces `num_batches` batches of one [8, 3] f32 array, whose elements are
+// their index in the batch plus 1000 times the index of the batch.
+HostBatchProducer MakeProducer(int num_batches,
+                               std::atomic<int>* num_released) {
+  auto next = std::make_shared<int>(0);
+  return [=]() -> StatusOr<std::optional<std::vector<HostArray>>> {
+    if (*next == num_batches) {
+      return std::optional<std::vector<HostArray>>();
+    }
+    auto values = std::make_shared<std::vector<float>>(24);
+    std::iota(values->begin(), values->end(), 1000.0f * (*next)++);
+    std::vector<HostArray> batch;
+    batch.push_back({values->data(), F32, {8, 3}, [values, num_released]() {
+                       ++*num_released;
+                     }});
+    return std::optional<std::vector<HostArray>>(std::move(batch));
+  };
+}
+
+TEST(DevicePrefetcherTest, ShardsBatchesAcrossDevices) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(
+                                           /*asynchronous=*/true,
+                                           /*cpu_device_count=*/2));
+  std::vector<PjRtDevice*> devices(client->addressable_devices().begin(),
+                                   client->addressable_devices().end());
+  ASSERT_EQ(devices.size(), 2);
+  std::atomic<int> num_released = 0;
+  DevicePrefetcherOptions options;
+  options.prefetch_depth = 2;
+  DevicePrefetcher prefetcher(client.get(), devices,
+                              MakeProducer(/*num_batches=*/3, &num_released),
+                              options);
+
+  for (int b = 0; b < 3; ++b) {
+    TF_ASSERT_OK_AND_ASSIGN(std::optional<DeviceBatch> batch,
+                            prefetcher.GetNext());
+    ASSERT_TRUE(batch.has_value());
+    ASSERT_EQ(batch->size(), 1);
+    ASSERT_EQ((*batch)[0].size(), 2);
+    for (int d = 0; d < 2; ++d) {
+      PjRtBuffer* buffer = (*batch)[0][d].get();
+      EXPECT_EQ(buffer->device(), devices[d]);
+      TF_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Literal> literal,
+                              buffer->ToLiteralSync());
+      std::vector<float> expected(12);
+      std::iota(expected.begin(), expected.end(), 1000.0f * b + 12 * d);
+      EXPECT_THAT(literal->data<float>(),
+                  ::testing::ElementsAreArray(expected));
+    }
+  }
+  TF_ASSERT_OK_AND_ASSIGN(std::optional<DeviceBatch> end,
+                          prefetcher.GetNext());
+  EXPECT_FALSE(end.has_value());
+  EXPECT_EQ(num_released, 3);
+}
+
+TEST(DevicePrefetcherTest, IndivisibleBatch) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(
+                                           /*asynchronous=*/true,
+                                           /*cpu_device_count=*/3));
+  std::vector<PjRtDevice*> devices(client->addressable_devices().begin(),
+                                   client->addressable_devices().end());
+  std::atomic<int> num_released = 0;
+  DevicePrefetcher prefetcher(client.get(), devices,
+                              MakeProducer(/*num_batches=*/1, &num_released));
+  StatusOr<std::optional<DeviceBatch>> batch = prefetcher.GetNext();
+  EXPECT_EQ(batch.status().code(), tensorflow::error::INVALID_ARGUMENT);
+  TF_ASSERT_OK_AND_ASSIGN(std::optional<DeviceBatch> end,
+                          prefetcher.GetNext());
+  EXPECT_FALSE(end.has_value());
+  EXPECT_EQ(num_released, 1);
+}
+
+}  // namespace
+}  // namespace xla
@@ -22,6 +22,7 @@ limitations under the License.
 #include <random>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
@@ -56,6 +57,12 @@ class DistributedRuntimeClientImpl : public DistributedRuntimeClient {
   xla::StatusOr<std::string> BlockingKeyValueGet(
       std::string key, absl::Duration timeout) override;
   xla::Status KeyValueSet(std::string key, std::string value) override;
+  xla::StatusOr<std::vector<std::string>> BlockingKeyValueBatchGet(
+      std::vector<std::string> keys, absl::Duration timeout) override;
+  xla::Status KeyValueBatchSet(
+      std::vector<std::pair<std::string, std::string>> entries) override;
+  xla::StatusOr<std::vector<std::pair<std::string, std::string>>>
+  KeyValueDirGet(std::string directory) override;
   xla::Status WaitAtBarrier(std::string barrier_id,
                             absl::Duration timeout) override;
   xla::StatusOr<tensorflow::CoordinationServiceAgent*>
@@ -123,6 +130,12 @@ class DistributedRuntimeCoordinationServiceClient
   xla::StatusOr<std::string> BlockingKeyValueGet(
       std::string key, absl::Duration timeout) override;
   xla::Status KeyValueSet(std::string key, std::string value) override;
+  xla::StatusOr<std::vector<std::string>> BlockingKeyValueBatchGet(
+      std::vector<std::string> keys, absl::Duration timeout) override;
+  xla::Status KeyValueBatchSet(
+      std::vector<std::pair<std::string, std::string>> entries) override;
+  xla::StatusOr<std::vector<std::pair<std::string, std::string>>>
+  KeyValueDirGet(std::string directory) override;
   xla::Status WaitAtBarrier(std::string barrier_id,
                             absl::Duration timeout) override;
   xla::StatusOr<tensorflow::CoordinationServiceAgent*>
@@ -347,6 +360,90 @@ xla::Status DistributedRuntimeClientImpl::KeyValueSet(std::string key,
   return FromGrpcStatus(status);
 }
 
+xla::StatusOr<std::vector<std::string>>
+DistributedRuntimeClientImpl::BlockingKeyValueBatchGet(
+    std::vector<std::string> keys, absl::Duration timeout) {
+  {
+    absl::MutexLock lock(&mu_);
+    if (state_ != State::kConnected) {
+      return xla::FailedPrecondition(
+          "BlockingKeyValueBatchGet() called when client not connected.");
+    }
+  }
+  ::grpc::ClientContext ctx;
+  ctx.set_fail_fast(false);
+  ctx.set_deadline(absl::ToChronoTime(absl::Now() + timeout));
+  KeyValueBatchGetRequest request;
+  request.set_session_id(session_id_);
+  for (std::string& key : keys) {
+    request.add_keys(std::move(key));
+  }
+  timeout = std::min(timeout, absl::Minutes(10));  // Avoid overflow
+  request.set_timeout_milliseconds(absl::ToInt64Milliseconds(timeout));
+  VLOG(10) << "BlockingKeyValueBatchGet: " << request.DebugString();
+  KeyValueBatchGetResponse response;
+  ::grpc::Status status = stub_->KeyValueBatchGet(&ctx, request, &response);
+  if (!status.ok()) {
+    return FromGrpcStatus(status);
+  }
+  return std::vector<std::string>(response.values().begin(),
+                                  response.values().end());
+}
+
+xla::Status DistributedRuntimeClientImpl::KeyValueBatchSet(
+    std::vector<std::pair<std::string, std::string>> entries) {
+  {
+    absl::MutexLock lock(&mu_);
+    if (state_ != State::kConnected) {
+      return xla::FailedPrecondition(
+          "KeyValueBatchSet() called when client not connected.");
+    }
+  }
+  ::grpc::ClientContext ctx;
+  ctx.set_fail_fast(false);
+  ctx.set_deadline(absl::ToChronoTime(absl::Now() + options_.rpc_timeout));
+  KeyValueBatchSetRequest request;
+  request.set_session_id(session_id_);
+  for (auto& [key, value] : entries) {
+    KeyValueEntryProto* entry = request.add_entries();
+    entry->set_key(std::move(key));
+    entry->set_value(std::move(value));
+  }
+  VLOG(10) << "KeyValueBatchSet: " << request.DebugString();
+  KeyValueBatchSetResponse response;
+  ::grpc::Status status = stub_->KeyValueBatchSet(&ctx, request, &response);
+  return FromGrpcStatus(status);
+}
+
+xla::StatusOr<std::vector<std::pair<std::string, std::string>>>
+DistributedRuntimeClientImpl::KeyValueDirGet(std::string directory) {
+  {
+    absl::MutexLock lock(&mu_);
+    if (state_ != State::kConnected) {
+      return xla::FailedPrecondition(
+          "KeyValueDirGet() called when client not connected.");
+    }
+  }
+  ::grpc::ClientContext ctx;
+  ctx.set_fail_fast(false);
+  ctx.set_deadline(absl::ToChronoTime(absl::Now() + options_.rpc_timeout));
+  KeyValueDirGetRequest request;
+  request.set_session_id(session_id_);
+  request.set_directory(std::move(directory));
+  VLOG(10) << "KeyValueDirGet: " << request.DebugString();
+  KeyValueDirGetResponse response;
+  ::grpc::Status status = stub_->KeyValueDirGet(&ctx, request, &response);
+  if (!status.ok()) {
+    return FromGrpcStatus(status);
+  }
+  std::vector<std::pair<std::string, std::string>> entries;
+  entries.reserve(response.entries_size());
+  for (const KeyValueEntryProto& entry : response.entries()) {
+    entries.emplace_back(entry.key(), entry.value());
+  }
+  return entries;
+}
+
 xla::Status DistributedRuntimeClientImpl::WaitAtBarrier(
     std::string barrier_id, absl::Duration timeout) {
   {
@@ -524,6 +621,44 @@ xla::Status DistributedRuntimeCoordinationServiceClient::KeyValueSet(
   return coord_agent_->InsertKeyValue(key, value);
 }
 
+xla::StatusOr<std::vector<std::string>>
+DistributedRuntimeCoordinationServiceClient::BlockingKeyValueBatchGet(
+    std::vector<std::string> keys, absl::Duration timeout) {
+  const absl::Time deadline = absl::Now() + timeout;
+  std::vector<std::string> values;
+  values.reserve(keys.size());
+  for (const std::string& key : keys) {
+    TF_ASSIGN_OR_RETURN(
+        std::string value,
+        coord_agent_->GetKeyValue(
+            key, std::max(deadline - absl::Now(), absl::ZeroDuration())));
+    values.push_back(std::move(value));
+  }
+  return values;
+}
+
+xla::Status DistributedRuntimeCoordinationServiceClient::KeyValueBatchSet(
+    std::vector<std::pair<std::string, std::string>> entries) {
+  for (const auto& [key, value] : entries) {
+    TF_RETURN_IF_ERROR(coord_agent_->InsertKeyValue(key, value));
+  }
+  return OkStatus();
+}
+
+xla::StatusOr<std::vector<std::pair<std::string, std::string>>>
+DistributedRuntimeCoordinationServiceClient::KeyValueDirGet(
+    std::string directory) {
+  TF_ASSIGN_OR_RETURN(std::vector<tensorflow::KeyValueEntry> kvs,
+                      coord_agent_->GetKeyValueDir(directory));
+  std::vector<std::pair<std::string, std::string>> entries;
+  entries.reserve(kvs.size());
+  for (const tensorflow::KeyValueEntry& kv : kvs) {
+    entries.emplace_back(kv.key(), kv.value());
+  }
+  std::sort(entries.begin(), entries.end());
+  return entries;
+}
+
 xla::Status DistributedRuntimeCoordinationServiceClient::WaitAtBarrier(
     std::string barrier_id, absl::Duration timeout) {
   return coord_agent_->WaitAtBarrier(barrier_id, timeout, /*tasks=*/{});
@@ -19,6 +19,8 @@ limitations under the License.
 #include <functional>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/time/time.h"
 #include "grpcpp/channel.h"
@@ -117,6 +119,19 @@ class DistributedRuntimeClient {
 
   virtual xla::Status KeyValueSet(std::string key, std::string value) = 0;
 
+  // Added by Alpa. Batched versions of the above, in one round trip to the
+  // service. The values are returned in the order of `keys`.
+  virtual xla::StatusOr<std::vector<std::string>> BlockingKeyValueBatchGet(
+      std::vector<std::string> keys, absl::Duration timeout) = 0;
+
+  virtual xla::Status KeyValueBatchSet(
+      std::vector<std::pair<std::string, std::string>> entries) = 0;
+
+  // Added by Alpa. Returns the entries whose keys are in `directory`, i.e.,
+  // start with `directory` followed by a '/', sorted by key. Doesn't block.
+  virtual xla::StatusOr<std::vector<std::pair<std::string, std::string>>>
+  KeyValueDirGet(std::string directory) = 0;
+
   // Blocks until all nodes are at the barrier or the barrier times out.
   // `barrier_id` should be unique across barriers.
   virtual xla::Status WaitAtBarrier(std::string barrier_id,
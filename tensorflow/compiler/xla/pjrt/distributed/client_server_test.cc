@@ -18,6 +18,7 @@ limitations under the License.
 #include <string>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/barrier.h"
 #include "absl/synchronization/notification.h"
@@ -296,6 +297,50 @@ TEST_P(ClientServerTest, ZeroInitTimeoutShouldStillWaitForOtherTasks) {
   }
 }
 
+TEST_P(ClientServerTest, KeyValueBatchAndDirectory) {
+  int num_nodes = 2;
+  StartService(num_nodes, GetParam().use_coordination_service);
+
+  auto thread_fn = [&](int node_id) -> xla::Status {
+    auto client = GetClient(node_id, GetParam().use_coordination_service);
+    TF_RETURN_IF_ERROR(client->Connect());
+    std::string own = absl::StrCat(node_id);
+    TF_RETURN_IF_ERROR(client->KeyValueBatchSet(
+        {{absl::StrCat("dir/a", own), absl::StrCat("a", own)},
+         {absl::StrCat("dir/b", own), absl::StrCat("b", own)},
+         {absl::StrCat("other/", own), own}}));
+    std::string peer = absl::StrCat(1 - node_id);
+    TF_ASSIGN_OR_RETURN(
+        std::vector<std::string> values,
+        client->BlockingKeyValueBatchGet(
+            {absl::StrCat("dir/b", peer), absl::StrCat("dir/a", peer)},
+            absl::Seconds(10)));
+    std::vector<std::string> expected_values = {absl::StrCat("b", peer),
+                                                absl::StrCat("a", peer)};
+    TF_RET_CHECK(values == expected_values);
+
+    // Both nodes have set their keys once the other node's keys are found.
+    TF_RETURN_IF_ERROR(client->WaitAtBarrier("kv_barrier", absl::Seconds(10)));
+    TF_ASSIGN_OR_RETURN(auto entries, client->KeyValueDirGet("dir"));
+    std::vector<std::pair<std::string, std::string>> expected = {
+        {"dir/a0", "a0"}, {"dir/a1", "a1"}, {"dir/b0", "b0"}, {"dir/b1", "b1"}};
+    TF_RET_CHECK(entries == expected);
+    return OkStatus();
+  };
+
+  std::vector<xla::Status> statuses(num_nodes);
+  {
+    tsl::thread::ThreadPool thread_pool(tsl::Env::Default(), "test_threads",
+                                        num_nodes);
+    for (int i = 0; i < num_nodes; ++i) {
+      thread_pool.Schedule([&, i]() { statuses[i] = thread_fn(i); });
+    }
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    TF_EXPECT_OK(statuses[i]);
+  }
+}
+
 TEST_P(ClientServerTest, ClientsTerminateShutdownIfAnyClientGoesAway) {
   int num_nodes = 3;
   StartService(num_nodes, GetParam().use_coordination_service);
@@ -15,30 +15,77 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/pjrt/distributed/key_value_store.h"
 
+#include <algorithm>
+
+#include "absl/hash/hash.h"
+#include "absl/strings/match.h"
+
 namespace xla {
 
 KeyValueStore::KeyValueStore() = default;
 
+KeyValueStore::Shard& KeyValueStore::ShardFor(const std::string& key) {
+  return shards_[absl::HashOf(key) % kNumShards];
+}
+
 ::grpc::Status KeyValueStore::Get(const std::string& key,
                                   absl::Duration timeout, std::string* value) {
+  Shard& shard = ShardFor(key);
   auto key_is_present = [&]() {
-    mu_.AssertHeld();
-    return entries_.find(key) != entries_.end();
+    shard.mu.AssertHeld();
+    return shard.entries.find(key) != shard.entries.end();
   };
-  absl::MutexLock lock(&mu_);
+  absl::MutexLock lock(&shard.mu);
   // TODO(phawkins): the synchronization here is very coarse, but probably
   // sufficient for its current application.
-  if (!mu_.AwaitWithTimeout(absl::Condition(&key_is_present), timeout)) {
+  if (!shard.mu.AwaitWithTimeout(absl::Condition(&key_is_present), timeout)) {
     return ::grpc::Status(::grpc::StatusCode::NOT_FOUND, key);
   }
-  *value = entries_.find(key)->second;
+  *value = shard.entries.find(key)->second;
   return ::grpc::Status::OK;
 }
 
 ::grpc::Status KeyValueStore::Set(const std::string& key, std::string value) {
-  absl::MutexLock lock(&mu_);
-  entries_[key] = std::move(value);
+  Shard& shard = ShardFor(key);
+  absl::MutexLock lock(&shard.mu);
+  shard.entries[key] = std::move(value);
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status KeyValueStore::BatchGet(const std::vector<std::string>& keys,
+                                       absl::Duration timeout,
+                                       std::vector<std::string>* values) {
+  const absl::Time deadline = absl::Now() + timeout;
+  values->resize(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ::grpc::Status status =
+        Get(keys[i], std::max(deadline - absl::Now(), absl::ZeroDuration()),
+            &(*values)[i]);
+    if (!status.ok()) {
+      values->clear();
+      return status;
+    }
+  }
   return ::grpc::Status::OK;
 }
 
+std::vector<std::pair<std::string, std::string>> KeyValueStore::GetDirectory(
+    const std::string& directory) {
+  std::string prefix = directory;
+  if (prefix.empty() || prefix.back() != '/') {
+    prefix.push_back('/');
+  }
+  std::vector<std::pair<std::string, std::string>> entries;
+  for (Shard& shard : shards_) {
+    absl::MutexLock lock(&shard.mu);
+    for (const auto& [key, value] : shard.entries) {
+      if (absl::StartsWith(key, prefix)) {
+        entries.emplace_back(key, value);
+      }
+    }
+  }
+  std::sort(entries.begin(), entries.end());
+  return entries;
+}
+
 }  // namespace xla
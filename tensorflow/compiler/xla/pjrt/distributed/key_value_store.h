@@ -16,6 +16,11 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_KEY_VALUE_STORE_H_
 #define TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_KEY_VALUE_STORE_H_
 
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
@@ -24,7 +29,8 @@ limitations under the License.
 
 namespace xla {
 
-// A simple blocking key-value store class.
+// A simple blocking key-value store class. Added by Alpa: the keys are sharded
+// over several mutexes, so that the requests of many nodes don't serialize.
 class KeyValueStore {
  public:
   KeyValueStore();
@@ -43,9 +49,29 @@ class KeyValueStore {
   // Replaces the value of `key` with `value`.
   ::grpc::Status Set(const std::string& key, std::string value);
 
+  // Added by Alpa. Looks up all of `keys`, waiting until `timeout` expires in
+  // total. Returns NOT_FOUND with the first missing key on expiry.
+  ::grpc::Status BatchGet(const std::vector<std::string>& keys,
+                          absl::Duration timeout,
+                          std::vector<std::string>* values);
+
+  // Added by Alpa. Returns the entries whose keys are in the directory
+  // `directory`, i.e., start with `directory` followed by a '/', sorted by
+  // key. Doesn't block.
+  std::vector<std::pair<std::string, std::string>> GetDirectory(
+      const std::string& directory);
+
  private:
-  absl::Mutex mu_;
-  absl::flat_hash_map<std::string, std::string> entries_ ABSL_GUARDED_BY(mu_);
+  static constexpr int kNumShards = 16;
+
+  struct Shard {
+    absl::Mutex mu;
+    absl::flat_hash_map<std::string, std::string> entries ABSL_GUARDED_BY(mu);
+  };
+
+  Shard& ShardFor(const std::string& key);
+
+  std::array<Shard, kNumShards> shards_;
 };
 
 }  // namespace xla
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "absl/time/time.h"
@@ -35,7 +36,6 @@ limitations under the License.
 #include "tensorflow/tsl/platform/threadpool.h"
 
 namespace {
-constexpr int kBarrierTimedOut = -1000;
 
 std::unique_ptr<tensorflow::CoordinationServiceInterface>
 EnableCoordinationService(
@@ -73,6 +73,7 @@ DistributedRuntimeServiceImpl::~DistributedRuntimeServiceImpl() {
     absl::MutexLock lock(&mu_);
     state_ = State::kClosed;
     service_status_ = tsl::errors::FailedPrecondition("Service shutting down.");
+    AbortBarriers();
     if (!stop_heartbeat_thread_.HasBeenNotified()) {
       stop_heartbeat_thread_.Notify();
     }
@@ -336,6 +337,7 @@ void DistributedRuntimeServiceImpl::HeartbeatLoop() {
         state_ = State::kClosed;
         service_status_ = tsl::errors::Aborted(
             "Shutting down due to missed heartbeat from task ", i);
+        AbortBarriers();
         return;
       }
     }
@@ -387,6 +389,79 @@ void DistributedRuntimeServiceImpl::HeartbeatLoop() {
   return key_value_store_.Set(request->key(), request->value());
 }
 
+xla::Status DistributedRuntimeServiceImpl::ValidateKeyValueRequest(
+    uint64_t session_id, absl::string_view method) {
+  TF_RETURN_IF_ERROR(ValidateSessionId(session_id));
+  absl::MutexLock lock(&mu_);
+  if (state_ != State::kRunning) {
+    if (!service_status_.ok()) {
+      return service_status_;
+    }
+    return xla::FailedPrecondition(
+        "%s() called when system is not running; clients must call "
+        "Connect() first",
+        method);
+  }
+  return OkStatus();
+}
+
+::grpc::Status DistributedRuntimeServiceImpl::KeyValueBatchGet(
+    ::grpc::ServerContext* context, const KeyValueBatchGetRequest* request,
+    KeyValueBatchGetResponse* response) {
+  VLOG(10) << "KeyValueBatchGet " << request->DebugString();
+  xla::Status status =
+      ValidateKeyValueRequest(request->session_id(), "KeyValueBatchGet");
+  if (!status.ok()) {
+    return xla::ToGrpcStatus(status);
+  }
+  std::vector<std::string> keys(request->keys().begin(),
+                                request->keys().end());
+  std::vector<std::string> values;
+  ::grpc::Status get_status = key_value_store_.BatchGet(
+      keys, absl::Milliseconds(request->timeout_milliseconds()), &values);
+  for (std::string& value : values) {
+    response->add_values(std::move(value));
+  }
+  return get_status;
+}
+
+::grpc::Status DistributedRuntimeServiceImpl::KeyValueBatchSet(
+    ::grpc::ServerContext* context, const KeyValueBatchSetRequest* request,
+    KeyValueBatchSetResponse* response) {
+  VLOG(10) << "KeyValueBatchSet " << request->DebugString();
+  xla::Status status =
+      ValidateKeyValueRequest(request->session_id(), "KeyValueBatchSet");
+  if (!status.ok()) {
+    return xla::ToGrpcStatus(status);
+  }
+  for (const KeyValueEntryProto& entry : request->entries()) {
+    ::grpc::Status set_status =
+        key_value_store_.Set(entry.key(), entry.value());
+    if (!set_status.ok()) {
+      return set_status;
+    }
+  }
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status DistributedRuntimeServiceImpl::KeyValueDirGet(
+    ::grpc::ServerContext* context, const KeyValueDirGetRequest* request,
+    KeyValueDirGetResponse* response) {
+  VLOG(10) << "KeyValueDirGet " << request->DebugString();
+  xla::Status status =
+      ValidateKeyValueRequest(request->session_id(), "KeyValueDirGet");
+  if (!status.ok()) {
+    return xla::ToGrpcStatus(status);
+  }
+  for (auto& [key, value] :
+       key_value_store_.GetDirectory(request->directory())) {
+    KeyValueEntryProto* entry = response->add_entries();
+    entry->set_key(std::move(key));
+    entry->set_value(std::move(value));
+  }
+  return ::grpc::Status::OK;
+}
+
 ::grpc::Status DistributedRuntimeServiceImpl::WaitAtBarrier(
     ::grpc::ServerContext* context, const WaitAtBarrierRequest* request,
     WaitAtBarrierResponse* response) {
@@ -409,33 +484,46 @@ void DistributedRuntimeServiceImpl::HeartbeatLoop() {
     return xla::ToGrpcStatus(status);
   }
 
-  std::string barrier_id = request->barrier_id();
+  Barrier* barrier;
+  {
+    std::unique_ptr<Barrier>& slot = barriers_[request->barrier_id()];
+    if (slot == nullptr) {
+      slot = std::make_unique<Barrier>();
+    }
+    barrier = slot.get();
+  }
 
-  if (barrier_id_to_num_nodes_[barrier_id] == nodes_.size()) {
+  if (barrier->num_nodes_at_barrier == nodes_.size()) {
     return xla::ToGrpcStatus(
         xla::FailedPrecondition("Calling WaitAtBarrier with the same id "
                                 "across barriers is not allowed. Please use "
                                 "unique barrier ids across barriers."));
   }
 
-  if (barrier_id_to_num_nodes_[barrier_id] == kBarrierTimedOut) {
+  if (barrier->timed_out) {
     return xla::ToGrpcStatus(xla::FailedPrecondition(
         "A process timed out waiting at the barrier. Exiting early because the "
         "current process will also timeout."));
   }
 
-  ++barrier_id_to_num_nodes_[barrier_id];
+  if (++barrier->num_nodes_at_barrier == nodes_.size()) {
+    barrier->done.Notify();
+    return ::grpc::Status::OK;
+  }
 
+  // Barriers are never erased, so `barrier` stays valid while mu_ is
+  // released.
   absl::Duration timeout = absl::Milliseconds(request->timeout_milliseconds());
-  auto all_nodes_at_barrier = [&]() {
-    mu_.AssertHeld();
-    return barrier_id_to_num_nodes_[barrier_id] == nodes_.size() ||
-           !service_status_.ok();
-  };
-  // TODO(yashkatariya,hanyangtay): Do something similar to the coordination
-  // service here.
-  if (!mu_.AwaitWithTimeout(absl::Condition(&all_nodes_at_barrier), timeout)) {
-    barrier_id_to_num_nodes_[barrier_id] = kBarrierTimedOut;
+  bool notified;
+  {
+    mu_.Unlock();
+    notified = barrier->done.WaitForNotificationWithTimeout(timeout);
+    mu_.Lock();
+  }
+  // The barrier may have completed between the timeout and the relock.
+  if (!notified && !barrier->done.HasBeenNotified()) {
+    barrier->timed_out = true;
+    barrier->done.Notify();
     return xla::ToGrpcStatus(tsl::errors::DeadlineExceeded(
         "Timed out after ", timeout,
         " waiting for all nodes to be at WaitAtBarrier()"));
@@ -444,9 +532,22 @@ void DistributedRuntimeServiceImpl::HeartbeatLoop() {
   if (!service_status_.ok()) {
     return xla::ToGrpcStatus(service_status_);
   }
+  if (barrier->timed_out) {
+    return xla::ToGrpcStatus(tsl::errors::DeadlineExceeded(
+        "Another node timed out waiting for all nodes to be at "
+        "WaitAtBarrier()"));
+  }
   return ::grpc::Status::OK;
 }
 
+void DistributedRuntimeServiceImpl::AbortBarriers() {
+  for (auto& [barrier_id, barrier] : barriers_) {
+    if (!barrier->done.HasBeenNotified()) {
+      barrier->done.Notify();
+    }
+  }
+}
+
 CoordinationServiceImpl::CoordinationServiceImpl(
     const DistributedRuntimeServiceImpl::Options& options,
     ::grpc::ServerBuilder* builder)
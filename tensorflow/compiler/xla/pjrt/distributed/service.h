@@ -96,6 +96,19 @@ class DistributedRuntimeServiceImpl final
                              const KeyValueSetRequest* request,
                              KeyValueSetResponse* response) override;
 
+  // Added by Alpa
+  ::grpc::Status KeyValueBatchGet(::grpc::ServerContext* context,
+                                  const KeyValueBatchGetRequest* request,
+                                  KeyValueBatchGetResponse* response) override;
+
+  ::grpc::Status KeyValueBatchSet(::grpc::ServerContext* context,
+                                  const KeyValueBatchSetRequest* request,
+                                  KeyValueBatchSetResponse* response) override;
+
+  ::grpc::Status KeyValueDirGet(::grpc::ServerContext* context,
+                                const KeyValueDirGetRequest* request,
+                                KeyValueDirGetResponse* response) override;
+
   ::grpc::Status WaitAtBarrier(::grpc::ServerContext* context,
                                const WaitAtBarrierRequest* request,
                                WaitAtBarrierResponse* response) override;
@@ -110,6 +123,11 @@ class DistributedRuntimeServiceImpl final
   // Validates a node id number.
   xla::Status ValidateNodeId(int node_id);
 
+  // Added by Alpa. Validates that a key-value request of `method` comes from
+  // the current session while the service is running.
+  xla::Status ValidateKeyValueRequest(uint64_t session_id,
+                                      absl::string_view method);
+
   const Options options_;
   const uint64_t session_id_;
 
@@ -142,10 +160,21 @@ class DistributedRuntimeServiceImpl final
   // Shutdown() barrier.
   int num_nodes_shutting_down_ ABSL_GUARDED_BY(mu_) = 0;
 
-  // This dictionary tracks the number of nodes per barrier.
-  absl::flat_hash_map<std::string, int> barrier_id_to_num_nodes_
+  // Added by Alpa. State of one WaitAtBarrier() id. The last node to arrive
+  // notifies the others, so waiting nodes are not woken by every update of
+  // mu_ and a barrier costs O(N) condition checks rather than O(N^2).
+  struct Barrier {
+    int num_nodes_at_barrier = 0;
+    bool timed_out = false;
+    absl::Notification done;
+  };
+  absl::flat_hash_map<std::string, std::unique_ptr<Barrier>> barriers_
       ABSL_GUARDED_BY(mu_);
 
+  // Added by Alpa. Releases the nodes waiting at all barriers after
+  // service_status_ became an error.
+  void AbortBarriers() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   // Key-value store, used by distributed GPU code to share NCCL state.
   KeyValueStore key_value_store_;
 
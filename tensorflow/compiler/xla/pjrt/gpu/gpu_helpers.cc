@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/pjrt/gpu/gpu_helpers.h"
 
+#include <algorithm>
 #include <memory>
 #include <optional>
 #include <set>
@@ -72,7 +73,8 @@ void EnablePeerAccess(absl::Span<se::StreamExecutor* const> executors) {
 
 // Builds a BFCAllocator for all local GPUs.
 StatusOr<std::unique_ptr<tsl::BFCAllocator>> CreateBFCAllocator(
-    se::StreamExecutor* executor, double memory_fraction, bool preallocate) {
+    se::StreamExecutor* executor, double memory_fraction, bool preallocate,
+    int64_t small_chunk_cache_bytes) {
   bool enable_unified_memory;
   Status status = tsl::ReadBoolFromEnvVar("TF_FORCE_UNIFIED_MEMORY", false,
                                           &enable_unified_memory);
@@ -111,27 +113,43 @@ StatusOr<std::unique_ptr<tsl::BFCAllocator>> CreateBFCAllocator(
 
   tsl::BFCAllocator::Options opts;
   opts.allow_growth = !preallocate;
+  // Added by Alpa
+  opts.small_chunk_cache_bytes = std::max<int64_t>(small_chunk_cache_bytes, 0);
   return std::make_unique<tsl::BFCAllocator>(
       std::move(sub_allocator), allocator_memory,
       absl::StrCat("GPU_", device_ordinal, "_bfc"), opts);
 }
 
 // Returns a GPU pinned host memory allocator to use when staging host->GPU
-// transfers. We use a fixed 64MB pool of pinned memory.
+// transfers.
 std::unique_ptr<tsl::BFCAllocator> GetGpuHostAllocator(
-    se::StreamExecutor* executor) {
+    se::StreamExecutor* executor, int64_t memory_limit_bytes,
+    int64_t preallocate_bytes) {
   std::unique_ptr<tsl::SubAllocator> sub_allocator(
       new se::DeviceHostAllocator(executor, /*numa_node=*/0,
                                   /*alloc_visitors=*/{},
                                   /*free_visitors=*/{}));
-  // TODO(phawkins): allow the user to tune this.
-  const int64_t kGpuHostMemoryLimitBytes = 64 * (1LL << 30);
 
   tsl::BFCAllocator::Options opts;
   opts.allow_growth = true;
-  return std::make_unique<tsl::BFCAllocator>(std::move(sub_allocator),
-                                             kGpuHostMemoryLimitBytes,
-                                             /*name=*/"xla_gpu_host_bfc", opts);
+  auto allocator = std::make_unique<tsl::BFCAllocator>(
+      std::move(sub_allocator), memory_limit_bytes,
+      /*name=*/"xla_gpu_host_bfc", opts);
+  // Added by Alpa. The BFC allocator keeps the memory it pins, so the first
+  // region serves later allocations of up to preallocate_bytes.
+  if (preallocate_bytes > 0) {
+    void* ptr = allocator->AllocateRaw(tsl::Allocator::kAllocatorAlignment,
+                                       preallocate_bytes);
+    if (ptr == nullptr) {
+      LOG(WARNING) << "Failed to preallocate " << preallocate_bytes
+                   << " bytes of pinned host memory.";
+    } else {
+      LOG(INFO) << "XLA backend preallocated " << preallocate_bytes
+                << " bytes of pinned host memory.";
+      allocator->DeallocateRaw(ptr);
+    }
+  }
+  return allocator;
 }
 
 }  // namespace xla
@@ -57,14 +57,33 @@ struct GpuAllocatorConfig {
   // fragmentation, allowing more of the total memory to be used. If false, the
   // allocator will allocate more memory as allocations are requested.
   bool preallocate = true;
+
+  // Added by Alpa. The maximum size of the pool of pinned host memory used to
+  // stage transfers between the host and the GPUs.
+  int64_t host_memory_limit_bytes = int64_t{64} << 30;
+
+  // Added by Alpa. The size of pinned host memory to allocate when the client
+  // is created, so that transfers don't pay for pinning memory on first use.
+  int64_t host_memory_preallocate_bytes = 0;
+
+  // Added by Alpa. Only used if kind == kBFC. If positive, the freed chunks of
+  // small buffers are cached per thread, up to this many bytes, and reused
+  // without taking the allocator lock.
+  int64_t small_chunk_cache_bytes = 0;
 };
 
+// Returns a GPU pinned host memory allocator to use when staging transfers
+// between the host and the GPUs, of up to `memory_limit_bytes`, with
+// `preallocate_bytes` of it allocated up front.
 std::unique_ptr<tsl::BFCAllocator> GetGpuHostAllocator(
-    se::StreamExecutor* executor);
+    se::StreamExecutor* executor,
+    int64_t memory_limit_bytes = int64_t{64} << 30,
+    int64_t preallocate_bytes = 0);
 
 // Builds a BFCAllocator for all local GPUs.
 StatusOr<std::unique_ptr<tsl::BFCAllocator>> CreateBFCAllocator(
-    se::StreamExecutor* executor, double memory_fraction, bool preallocate);
+    se::StreamExecutor* executor, double memory_fraction, bool preallocate,
+    int64_t small_chunk_cache_bytes = 0);
 
 }  // namespace xla
 
@@ -73,7 +73,7 @@ StatusOr<std::unique_ptr<se::MultiDeviceAdapter>> CreateCudaAsyncAllocator(
       return Unavailable("Failed to query available memory from device %i",
                          device_ordinal);
     }
-    // To allow full GPU memory to be visible to the BFC allocator if using
+    // To allow full GPU memory to be visible to the allocator if using
     // unified memory.
     // When unified memory is enabled, allow GPU memory oversubscription by
     // setting memory_fraction > 1.
@@ -81,11 +81,11 @@ StatusOr<std::unique_ptr<se::MultiDeviceAdapter>> CreateCudaAsyncAllocator(
     if (preallocate) {
       LOG(INFO) << "XLA backend allocating " << allocator_memory
                 << " bytes on device " << device_ordinal
-                << " for BFCAllocator.";
+                << " for CudaAsyncAllocator.";
     } else {
       LOG(INFO) << "XLA backend will use up to " << allocator_memory
                 << " bytes on device " << device_ordinal
-                << " for BFCAllocator.";
+                << " for CudaAsyncAllocator.";
     }
 
     auto allocator = std::make_unique<tensorflow::GpuCudaMallocAsyncAllocator>(
@@ -201,7 +201,8 @@ GetStreamExecutorGpuDeviceAllocator(
             auto bfc_allocator,
             CreateBFCAllocator(ordinal_and_device.second->executor(),
                                allocator_config.memory_fraction,
-                               allocator_config.preallocate));
+                               allocator_config.preallocate,
+                               allocator_config.small_chunk_cache_bytes));
         allocators_and_streams.emplace_back(
             std::move(bfc_allocator),
             ordinal_and_device.second->compute_stream());
@@ -332,7 +333,9 @@ StatusOr<std::unique_ptr<PjRtClient>> GetStreamExecutorGpuClient(
       GetStreamExecutorGpuDeviceAllocator(
           xla_client->platform(), allocator_config, local_device_states));
   auto host_memory_allocator =
-      GetGpuHostAllocator(local_device_states.begin()->second->executor());
+      GetGpuHostAllocator(local_device_states.begin()->second->executor(),
+                          allocator_config.host_memory_limit_bytes,
+                          allocator_config.host_memory_preallocate_bytes);
 
   std::vector<std::unique_ptr<PjRtStreamExecutorDevice>> devices;
   auto gpu_run_options = std::make_unique<gpu::GpuExecutableRunOptions>();
@@ -41,4 +41,29 @@ StatusOr<CompileOptionsProto> CompileOptions::ToProto() const {
   return output;
 }
 
+StatusOr<CompileOptions> CompileOptions::FromProto(
+    const CompileOptionsProto& proto) {
+  if (!proto.serialized_multi_slice_config().empty()) {
+    return Unimplemented(
+        "Multi-slice config is not supported when deserializing "
+        "CompileOptions.");
+  }
+  CompileOptions output;
+  if (proto.argument_layouts_size() > 0) {
+    std::vector<Shape> argument_layouts;
+    argument_layouts.reserve(proto.argument_layouts_size());
+    for (const auto& layout : proto.argument_layouts()) {
+      argument_layouts.emplace_back(Shape(layout));
+    }
+    output.argument_layouts = std::move(argument_layouts);
+  }
+  output.parameter_is_tupled_arguments = proto.parameter_is_tupled_arguments();
+  TF_ASSIGN_OR_RETURN(
+      output.executable_build_options,
+      ExecutableBuildOptionsFromProto(proto.executable_build_options()));
+  output.compile_portable_executable = proto.compile_portable_executable();
+  output.profile_version = proto.profile_version();
+  return output;
+}
+
 }  // namespace xla
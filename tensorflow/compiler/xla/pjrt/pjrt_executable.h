@@ -81,6 +81,10 @@ struct CompileOptions {
 
   // Serialize the CompileOptions into a CompileOptionsProto.
   StatusOr<CompileOptionsProto> ToProto() const;
+
+  // Deserialize a CompileOptionsProto. A serialized multi-slice config cannot
+  // be restored, since CompileOptions does not own it.
+  static StatusOr<CompileOptions> FromProto(const CompileOptionsProto& proto);
 };
 
 // Static device memory usage for a compiled program.
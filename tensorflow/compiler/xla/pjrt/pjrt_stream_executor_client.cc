@@ -155,6 +155,23 @@ absl::string_view PjRtStreamExecutorDevice::ToString() const {
   return to_string_;
 }
 
+// Added by Alpa
+StatusOr<tsl::AllocatorStats> PjRtStreamExecutorDevice::GetAllocatorStats()
+    const {
+  if (!IsAddressable()) {
+    return FailedPrecondition(
+        "GetAllocatorStats() is allowed only for addressable devices");
+  }
+  auto* client = tensorflow::down_cast<PjRtStreamExecutorClient*>(client_);
+  std::optional<tsl::AllocatorStats> stats =
+      client->allocator()->GetAllocatorStats(local_hardware_id());
+  if (!stats.has_value()) {
+    return Unimplemented("The allocator of %s does not keep stats",
+                         DebugString());
+  }
+  return *stats;
+}
+
 StatusOr<DeviceAssignment> DevicesToDeviceAssignment(
     absl::Span<const std::vector<PjRtDevice*>> devices) {
   if (devices.empty()) {
@@ -513,6 +530,18 @@ Status AddDestinationBufferSynchronization(
   return OkStatus();
 }
 
+// Added by Alpa. Whether a copy of a buffer of `on_device_shape` to `literal`
+// is a single memcpy that can be staged through pinned host memory.
+bool CanStageCopyToLiteral(const PjRtStreamExecutorClient& client,
+                           const Shape& on_device_shape,
+                           const MutableLiteralBase& literal) {
+  return client.should_stage_host_to_device_transfers() &&
+         on_device_shape.IsArray() && on_device_shape.is_static() &&
+         literal.size_bytes() > 0 &&
+         ShapeUtil::Equal(literal.shape(),
+                          ShapeUtil::DeviceShapeToHostShape(on_device_shape));
+}
+
 }  // namespace
 
 PjRtStreamExecutorBuffer::ScopedHold::~ScopedHold() {
@@ -799,16 +828,28 @@ PjRtStreamExecutorClient::BufferFromHostBuffer(
         });
   }
 
+  // Added by Alpa. Large relayouts that block the caller are split across
+  // the thread pool. The ones on the thread pool stay on one thread, so they
+  // can't wait for work queued behind them.
+  constexpr int64_t kMinParallelTransposeBytes = int64_t{16} << 20;
+  const bool parallel_transpose =
+      host_buffer_semantics == HostBufferSemantics::kImmutableOnlyDuringCall &&
+      size >= kMinParallelTransposeBytes;
   std::shared_ptr<TransposePlan> transpose;
   if (!host_and_device_strides_equal) {
     absl::InlinedVector<int64_t, 4> permutation(dims.size());
     absl::c_reverse_copy(compact_shape.layout().minor_to_major(),
                          permutation.begin());
     absl::MutexLock lock(&transpose_mu_);
-    TF_ASSIGN_OR_RETURN(transpose,
-                        transpose_cache_.GetOrCreate(
-                            primitive_util::ByteWidth(type), dims, permutation,
-                            TransposePlan::Striding{*byte_strides}));
+    TF_ASSIGN_OR_RETURN(
+        transpose,
+        transpose_cache_.GetOrCreate(
+            primitive_util::ByteWidth(type), dims, permutation,
+            TransposePlan::Striding{*byte_strides},
+            /*output_tiling=*/TransposePlan::Tiling{},
+            TransposePlan::Transformation::kNone,
+            /*num_threads=*/parallel_transpose ? thread_pool()->NumThreads()
+                                               : 1));
   }
 
   // Copy the buffer into a staging buffer before returning control to the
@@ -817,7 +858,10 @@ PjRtStreamExecutorClient::BufferFromHostBuffer(
   // thread.
   if (host_buffer_semantics == HostBufferSemantics::kImmutableOnlyDuringCall) {
     if (transpose) {
-      transpose->Execute(data, staging_buffer.get());
+      transpose->Execute(data, staging_buffer.get(),
+                         [this](std::function<void(void)> fn) {
+                           thread_pool()->Schedule(std::move(fn));
+                         });
     } else {
       std::memcpy(staging_buffer.get(), data, size);
     }
@@ -905,6 +949,277 @@ PjRtStreamExecutorClient::BufferFromHostBuffer(
   return std::unique_ptr<PjRtBuffer>(std::move(py_buffer));
 }
 
+// Added by Alpa
+StatusOr<std::vector<std::unique_ptr<PjRtBuffer>>>
+PjRtStreamExecutorClient::BuffersFromHostBuffers(
+    absl::Span<const HostBuffer> host_buffers, PjRtDevice* device,
+    int64_t staging_arena_bytes) {
+  tsl::profiler::TraceMe traceme(
+      "PjRtStreamExecutorClient::BuffersFromHostBuffers");
+  VLOG(1) << "PjRtStreamExecutorClient::BuffersFromHostBuffers: "
+          << host_buffers.size() << " buffers, device: "
+          << device->DebugString();
+  TF_ASSIGN_OR_RETURN(LocalDeviceState * local_device,
+                      tensorflow::down_cast<PjRtStreamExecutorDevice*>(device)
+                          ->GetLocalDeviceState());
+  TransferManager* transfer_manager = client()->backend().transfer_manager();
+  se::Stream* stream = local_device->host_to_device_stream();
+
+  // Allocates all the destination buffers, with one definition event for all
+  // of them.
+  auto definition_event = std::make_shared<BufferSequencingEvent>();
+  std::vector<std::unique_ptr<PjRtStreamExecutorBuffer>> buffers;
+  std::vector<int64_t> sizes;
+  buffers.reserve(host_buffers.size());
+  sizes.reserve(host_buffers.size());
+  for (const HostBuffer& host_buffer : host_buffers) {
+    Shape shape = ShapeUtil::MakeShape(host_buffer.type, host_buffer.dims);
+    TF_ASSIGN_OR_RETURN(Shape compact_shape,
+                        transfer_manager->ChooseCompactLayoutForShape(shape));
+    absl::InlinedVector<int64_t, 4> strides(shape.dimensions_size());
+    absl::InlinedVector<int64_t, 4> compact_strides(shape.dimensions_size());
+    TF_RETURN_IF_ERROR(ShapeUtil::ByteStrides(shape, absl::MakeSpan(strides)));
+    TF_RETURN_IF_ERROR(ShapeUtil::ByteStrides(
+        compact_shape, absl::MakeSpan(compact_strides)));
+    int64_t size = ShapeUtil::ByteSizeOf(shape);
+    if (size != 0 && strides != compact_strides) {
+      return InvalidArgument(
+          "BuffersFromHostBuffers requires major-to-minor device layouts, got "
+          "%s",
+          compact_shape.ToString(/*print_layout=*/true));
+    }
+    TF_ASSIGN_OR_RETURN(ScopedShapedBuffer dst_buffer,
+                        transfer_manager->AllocateScopedShapedBuffer(
+                            compact_shape, allocator(),
+                            local_device->device_ordinal()));
+    Shape on_device_shape = dst_buffer.on_device_shape();
+    std::shared_ptr<TrackedDeviceBuffer> device_buffer =
+        TrackedDeviceBuffer::FromScopedShapedBuffer(&dst_buffer,
+                                                    {definition_event});
+    buffers.push_back(std::make_unique<PjRtStreamExecutorBuffer>(
+        on_device_shape, std::move(device_buffer), this, device));
+    sizes.push_back(size);
+  }
+
+  // Packs the arrays, in order, into arenas of up to staging_arena_bytes. An
+  // array larger than that gets an arena of its own.
+  const int64_t kAlignment = tsl::Allocator::kAllocatorAlignment;
+  std::vector<int64_t> offsets(sizes.size());
+  std::vector<int64_t> arena_of(sizes.size());
+  std::vector<int64_t> arena_sizes;
+  for (int64_t i = 0; i < sizes.size(); ++i) {
+    int64_t size = RoundUpTo(sizes[i], kAlignment);
+    if (arena_sizes.empty() ||
+        arena_sizes.back() + size > staging_arena_bytes) {
+      arena_sizes.push_back(0);
+    }
+    arena_of[i] = arena_sizes.size() - 1;
+    offsets[i] = arena_sizes.back();
+    arena_sizes.back() += size;
+  }
+  std::vector<std::shared_ptr<void>> arenas;
+  arenas.reserve(arena_sizes.size());
+  for (int64_t arena_size : arena_sizes) {
+    void* ptr = host_memory_allocator()->AllocateRaw(
+        kAlignment, std::max(arena_size, kAlignment));
+    if (ptr == nullptr) {
+      return ResourceExhausted(
+          "Failed to allocate %d bytes of host memory for staging transfers",
+          arena_size);
+    }
+    arenas.push_back(std::shared_ptr<void>(
+        ptr, [host_memory_allocator = host_memory_allocator()](void* ptr) {
+          host_memory_allocator->DeallocateRaw(ptr);
+        }));
+  }
+
+  if (local_device->allocation_model() ==
+      LocalDeviceState::kComputeSynchronized) {
+    stream->ThenWaitFor(local_device->compute_stream());
+  }
+
+  // Stages and copies the arrays. The usage holds keep the buffers alive until
+  // the copies are recorded below.
+  std::vector<PjRtStreamExecutorBuffer::ScopedHold> device_buffers;
+  device_buffers.reserve(buffers.size());
+  for (int64_t i = 0; i < buffers.size(); ++i) {
+    device_buffers.push_back(buffers[i]->GetBufferWithUsageHold());
+    CHECK(device_buffers.back().ok());
+    if (sizes[i] == 0) {
+      continue;
+    }
+    char* staging = static_cast<char*>(arenas[arena_of[i]].get()) + offsets[i];
+    std::memcpy(staging, host_buffers[i].data, sizes[i]);
+    se::DeviceMemoryBase dst = device_buffers.back()->device_memory()[0];
+    stream->ThenMemcpy(&dst, staging, sizes[i]);
+  }
+
+  StatusOr<EventPool::Handle> event_or =
+      local_device->event_pool().ThenAllocateAndRecordEvent(stream);
+  if (!event_or.ok()) {
+    StallStreamOnError(local_device, stream);
+    return event_or.status();
+  }
+  definition_event->SetSequencingEvent(std::move(event_or).value(), stream);
+  // See AddDestinationBufferSynchronization for why no reference is retained.
+  for (PjRtStreamExecutorBuffer::ScopedHold& device_buffer : device_buffers) {
+    RecordUsage(std::move(device_buffer), local_device, local_device,
+                definition_event, stream,
+                /*prefer_to_retain_reference=*/false);
+  }
+  local_device->ThenRelease(stream, std::move(arenas));
+
+  std::vector<std::unique_ptr<PjRtBuffer>> results;
+  results.reserve(buffers.size());
+  for (std::unique_ptr<PjRtStreamExecutorBuffer>& buffer : buffers) {
+    results.push_back(std::move(buffer));
+  }
+  return results;
+}
+
+// Added by Alpa
+PjRtFuture<Status> PjRtStreamExecutorClient::ToLiterals(
+    absl::Span<PjRtBuffer* const> buffers,
+    absl::Span<MutableLiteralBase* const> literals) {
+  tsl::profiler::TraceMe traceme("PjRtStreamExecutorClient::ToLiterals");
+  VLOG(1) << "PjRtStreamExecutorClient::ToLiterals: " << buffers.size()
+          << " buffers";
+  if (buffers.size() != literals.size()) {
+    return PjRtFuture<Status>(InvalidArgument(
+        "ToLiterals got %d buffers and %d literals", buffers.size(),
+        literals.size()));
+  }
+
+  // Counts down the copies, plus one for issuing them, and sets the promise
+  // with the first error after the last one.
+  struct Countdown {
+    explicit Countdown(PjRtFuture<Status>::Promise promise)
+        : promise(std::move(promise)) {}
+    void Done(Status status) {
+      absl::MutexLock lock(&mu);
+      this->status.Update(status);
+      if (--pending == 0) {
+        promise.Set(this->status);
+      }
+    }
+    absl::Mutex mu;
+    int64_t pending = 1;
+    Status status;
+    PjRtFuture<Status>::Promise promise;
+  };
+  auto promise = PjRtFuture<Status>::CreatePromise();
+  auto countdown = std::make_shared<Countdown>(promise);
+  auto add_pending = [&](int64_t n) {
+    absl::MutexLock lock(&countdown->mu);
+    countdown->pending += n;
+  };
+  auto to_literal = [&](PjRtBuffer* buffer, MutableLiteralBase* literal) {
+    add_pending(1);
+    buffer->ToLiteral(literal, [countdown](Status status) {
+      countdown->Done(std::move(status));
+    });
+  };
+
+  // The buffers of each device whose copies are staged together, in order.
+  std::vector<std::pair<PjRtDevice*, std::vector<int64_t>>> device_buffers;
+  for (int64_t i = 0; i < buffers.size(); ++i) {
+    if (buffers[i]->client() != this || buffers[i]->IsOnCpu() ||
+        !CanStageCopyToLiteral(*this, buffers[i]->on_device_shape(),
+                               *literals[i])) {
+      to_literal(buffers[i], literals[i]);
+      continue;
+    }
+    auto it = absl::c_find_if(device_buffers, [&](const auto& entry) {
+      return entry.first == buffers[i]->device();
+    });
+    if (it == device_buffers.end()) {
+      device_buffers.push_back({buffers[i]->device(), {}});
+      it = device_buffers.end() - 1;
+    }
+    it->second.push_back(i);
+  }
+
+  const int64_t kAlignment = tsl::Allocator::kAllocatorAlignment;
+  for (auto& [device, indices] : device_buffers) {
+    LocalDeviceState* local_device =
+        tensorflow::down_cast<PjRtStreamExecutorDevice*>(device)
+            ->local_device_state();
+    se::Stream* stream = local_device->GetDeviceToHostStream();
+
+    // The buffers still alive, and their offsets in the staging buffer.
+    std::vector<int64_t> copied;
+    std::vector<PjRtStreamExecutorBuffer::ScopedHold> holds;
+    std::vector<int64_t> offsets;
+    int64_t staging_size = 0;
+    for (int64_t i : indices) {
+      PjRtStreamExecutorBuffer::ScopedHold hold =
+          tensorflow::down_cast<PjRtStreamExecutorBuffer*>(buffers[i])
+              ->GetBufferWithUsageHold();
+      if (!hold.ok()) {
+        add_pending(1);
+        countdown->Done(hold.status());
+        continue;
+      }
+      copied.push_back(i);
+      holds.push_back(std::move(hold));
+      offsets.push_back(staging_size);
+      staging_size += RoundUpTo(literals[i]->size_bytes(), kAlignment);
+    }
+    if (copied.empty()) {
+      continue;
+    }
+    StatusOr<EventPool::Handle> event_or =
+        local_device->event_pool().AllocateEvent(stream->parent());
+    void* ptr = event_or.ok() && stream->ok()
+                    ? host_memory_allocator()->AllocateRaw(kAlignment,
+                                                           staging_size)
+                    : nullptr;
+    if (ptr == nullptr) {
+      // Copy them one by one instead.
+      holds.clear();
+      for (int64_t i : copied) {
+        to_literal(buffers[i], literals[i]);
+      }
+      continue;
+    }
+    std::shared_ptr<void> staging_buffer(
+        ptr, [host_memory_allocator = host_memory_allocator()](void* ptr) {
+          host_memory_allocator->DeallocateRaw(ptr);
+        });
+
+    std::vector<std::pair<MutableLiteralBase*, int64_t>> copies;
+    for (int64_t j = 0; j < copied.size(); ++j) {
+      MutableLiteralBase* literal = literals[copied[j]];
+      WaitForBufferDefinitionEventsOnStream(*holds[j], stream);
+      stream->ThenMemcpy(static_cast<char*>(ptr) + offsets[j],
+                         holds[j]->device_memory()[0], literal->size_bytes());
+      copies.push_back({literal, offsets[j]});
+    }
+    auto usage_event = std::make_shared<BufferSequencingEvent>();
+    local_device->event_pool().ThenRecordEvent(stream, event_or.value());
+    usage_event->SetSequencingEvent(std::move(event_or).value(), stream);
+    // As in ToLiteral, retain the buffers until the copies are done.
+    for (PjRtStreamExecutorBuffer::ScopedHold& hold : holds) {
+      RecordUsage(std::move(hold), local_device, local_device, usage_event,
+                  stream, /*prefer_to_retain_reference=*/true);
+    }
+    add_pending(1);
+    local_device->ThenExecuteCallback(
+        stream, [countdown, copies{std::move(copies)},
+                 staging_buffer{std::move(staging_buffer)}]() {
+          for (const auto& [literal, offset] : copies) {
+            std::memcpy(literal->untyped_data(),
+                        static_cast<char*>(staging_buffer.get()) + offset,
+                        literal->size_bytes());
+          }
+          countdown->Done(OkStatus());
+        });
+  }
+
+  countdown->Done(OkStatus());
+  return PjRtFuture<Status>(std::move(promise));
+}
+
 StatusOr<std::unique_ptr<PjRtBuffer>>
 PjRtStreamExecutorClient::CreateUninitializedBuffer(const Shape& shape,
                                                     PjRtDevice* device) {
@@ -1340,9 +1655,37 @@ PjRtFuture<Status> PjRtStreamExecutorBuffer::ToLiteral(
     return PjRtFuture<Status>(event_or.status());
   }
   auto promise = PjRtFuture<Status>::CreatePromise();
-  client_->client()->backend().transfer_manager()->TransferLiteralFromDevice(
-      stream, shaped_buffer, literal,
-      [promise](Status status) mutable { promise.Set(status); });
+  // Added by Alpa. If host-to-device transfers are staged, i.e., on GPU, copy
+  // dense arrays through the pinned host memory pool and complete the future
+  // from a callback, instead of copying to pageable memory and blocking until
+  // the copy is done.
+  std::shared_ptr<void> staging_buffer;
+  const int64_t size = literal->size_bytes();
+  if (CanStageCopyToLiteral(*client_, on_device_shape_, *literal)) {
+    tsl::Allocator* host_memory_allocator = client_->host_memory_allocator();
+    void* ptr = host_memory_allocator->AllocateRaw(
+        tsl::Allocator::kAllocatorAlignment, size);
+    if (ptr != nullptr) {
+      staging_buffer = std::shared_ptr<void>(
+          ptr, [host_memory_allocator](void* ptr) {
+            host_memory_allocator->DeallocateRaw(ptr);
+          });
+    }
+  }
+  if (staging_buffer != nullptr && stream->ok()) {
+    stream->ThenMemcpy(staging_buffer.get(), shaped_buffer.root_buffer(),
+                       size);
+    local_device->ThenExecuteCallback(
+        stream, [promise, literal, size,
+                 staging_buffer{std::move(staging_buffer)}]() mutable {
+          std::memcpy(literal->untyped_data(), staging_buffer.get(), size);
+          promise.Set(OkStatus());
+        });
+  } else {
+    client_->client()->backend().transfer_manager()->TransferLiteralFromDevice(
+        stream, shaped_buffer, literal,
+        [promise](Status status) mutable { promise.Set(status); });
+  }
 
   auto usage_event = std::make_shared<BufferSequencingEvent>();
   local_device->event_pool().ThenRecordEvent(stream, event_or.value());
@@ -1395,6 +1738,57 @@ PjRtFuture<Status> PjRtStreamExecutorBuffer::CopyRawToHost(
   return client_->CopyRawSubBufferToHost(this, dst, offset, transfer_size);
 }
 
+PjRtFuture<Status> PjRtStreamExecutorClient::CopyRawSubBufferToHost(
+    PjRtBuffer* pjrt_buffer, void* dst, int64_t offset,
+    int64_t transfer_size) {
+  auto* buffer = tensorflow::down_cast<PjRtStreamExecutorBuffer*>(pjrt_buffer);
+  PjRtStreamExecutorBuffer::ScopedHold device_buffer =
+      buffer->GetBufferWithUsageHold();
+  if (!device_buffer.ok()) {
+    return PjRtFuture<Status>(device_buffer.status());
+  }
+  if (device_buffer->device_memory().size() != 1) {
+    return PjRtFuture<Status>(
+        InvalidArgument("CopyRawToHost called on tuple-shaped buffer"));
+  }
+  const se::DeviceMemoryBase& device_memory =
+      device_buffer->device_memory()[0];
+  if (offset < 0 || transfer_size < 0 ||
+      offset + transfer_size > static_cast<int64_t>(device_memory.size())) {
+    return PjRtFuture<Status>(InvalidArgument(
+        "CopyRawToHost of %d bytes at offset %d is out of range for a "
+        "buffer of %d bytes",
+        transfer_size, offset, device_memory.size()));
+  }
+  LocalDeviceState* local_device = buffer->device()->local_device_state();
+  se::Stream* stream = local_device->GetDeviceToHostStream();
+  StatusOr<EventPool::Handle> event_or =
+      local_device->event_pool().AllocateEvent(stream->parent());
+  if (!event_or.ok()) {
+    return PjRtFuture<Status>(event_or.status());
+  }
+
+  WaitForBufferDefinitionEventsOnStream(*device_buffer, stream);
+  if (transfer_size > 0) {
+    se::DeviceMemoryBase sub_buffer(
+        static_cast<char*>(device_memory.opaque()) + offset, transfer_size);
+    stream->ThenMemcpy(dst, sub_buffer, transfer_size);
+  }
+  auto promise = PjRtFuture<Status>::CreatePromise();
+  local_device->ThenExecuteCallback(stream, [promise, stream]() mutable {
+    promise.Set(stream->ok() ? OkStatus()
+                             : InternalError("CopyRawToHost failed"));
+  });
+
+  auto usage_event = std::make_shared<BufferSequencingEvent>();
+  local_device->event_pool().ThenRecordEvent(stream, event_or.value());
+  usage_event->SetSequencingEvent(std::move(event_or).value(), stream);
+  RecordUsage(std::move(device_buffer), local_device, local_device, usage_event,
+              stream,
+              /*prefer_to_retain_reference=*/true);
+  return PjRtFuture<Status>(std::move(promise));
+}
+
 StatusOr<ShapedBuffer> PjRtStreamExecutorBuffer::AsShapedBuffer() const {
   absl::MutexLock lock(&mu_);
   if (device_buffer_ == nullptr) {
@@ -1420,11 +1814,14 @@ PjRtStreamExecutorBuffer::CopyToDeviceHelper(
     PjRtDevice* dst_device, LocalDeviceState* dst_local_device,
     LocalDeviceState* transfer_local_device, se::Stream* transfer_stream,
     std::shared_ptr<TrackedDeviceBuffer> src_device_buffer) {
+  // The destination buffer belongs to the client of dst_device, which may not
+  // be client_, see CopyToDevice.
   TF_ASSIGN_OR_RETURN(std::unique_ptr<PjRtStreamExecutorBuffer> py_buffer,
                       AllocateDestinationBuffer(
                           ShapeUtil::DeviceShapeToHostShape(on_device_shape_),
                           dst_device, dst_local_device, transfer_stream,
-                          /*is_uninitialized_create=*/false, client_));
+                          /*is_uninitialized_create=*/false,
+                          dst_device->client()));
 
   TF_ASSIGN_OR_RETURN(ShapedBuffer src_buffer, AsShapedBuffer());
 
@@ -1486,7 +1883,18 @@ StatusOr<std::unique_ptr<PjRtBuffer>> PjRtStreamExecutorBuffer::CopyToDevice(
   }
 
   // Copying across PjRtClients involves a copy through the host.
-  if (dst_device->client() != client_) {
+  // Added by Alpa. Unless both are stream executor clients of the same
+  // platform in this process, e.g., of two meshes of a pipeline, whose devices
+  // can copy to each other directly.
+  auto* dst_se_device = dynamic_cast<PjRtStreamExecutorDevice*>(dst_device);
+  bool is_local_peer_copy =
+      dst_device->client() != client_ && dst_se_device != nullptr &&
+      dst_se_device->local_device_state() != nullptr &&
+      dst_se_device->local_device_state()->executor()->platform() ==
+          device_->local_device_state()->executor()->platform() &&
+      dst_se_device->local_device_state()->allocation_model() ==
+          device_->local_device_state()->allocation_model();
+  if (dst_device->client() != client_ && !is_local_peer_copy) {
     TF_ASSIGN_OR_RETURN(std::shared_ptr<Literal> literal, ToLiteralSync());
     // Avoid use-after-free on `literal` due to unsequenced move and use.
     Literal* literal_pointer = literal.get();
@@ -118,6 +118,9 @@ class PjRtStreamExecutorDevice : public PjRtDevice {
 
   Status TransferFromOutfeed(MutableBorrowingLiteral literal) override;
 
+  // Added by Alpa
+  StatusOr<tsl::AllocatorStats> GetAllocatorStats() const override;
+
   std::unique_ptr<ScopedAsyncTrackingEvent> CreateAsyncTrackingEvent(
       absl::string_view description) const override {
     return nullptr;
@@ -231,6 +234,35 @@ class PjRtStreamExecutorClient : public PjRtClient {
       std::function<void()> on_done_with_host_buffer,
       PjRtDevice* device) override;
 
+  // Added by Alpa. A dense major-to-minor host array, see
+  // BuffersFromHostBuffers.
+  struct HostBuffer {
+    const void* data;
+    PrimitiveType type;
+    absl::Span<int64_t const> dims;
+  };
+
+  // Added by Alpa. Transfers many arrays to `device` at once, e.g., to restore
+  // the parameters of a checkpoint. The arrays are packed into pinned staging
+  // arenas of up to `staging_arena_bytes` before the call returns, so the host
+  // buffers only need to be valid during the call. All the copies are issued
+  // back to back on the host-to-device stream, with one callback releasing the
+  // arenas, and the returned buffers share one definition event, instead of
+  // the per-array staging buffer, event and thread-pool hop of
+  // BufferFromHostBuffer. The device layouts of the arrays must be
+  // major-to-minor.
+  StatusOr<std::vector<std::unique_ptr<PjRtBuffer>>> BuffersFromHostBuffers(
+      absl::Span<const HostBuffer> host_buffers, PjRtDevice* device,
+      int64_t staging_arena_bytes = int64_t{64} << 20);
+
+  // Added by Alpa. Copies each of `buffers` to the literal at the same index,
+  // like PjRtBuffer::ToLiteral, and returns one future for all the copies. If
+  // host-to-device transfers are staged, the dense arrays of each device are
+  // copied into one pinned staging region, with one event and one callback
+  // per device. The literals must stay alive until the future is ready.
+  PjRtFuture<Status> ToLiterals(absl::Span<PjRtBuffer* const> buffers,
+                                absl::Span<MutableLiteralBase* const> literals);
+
   StatusOr<std::unique_ptr<PjRtBuffer>> BufferFromHostLiteral(
       const LiteralSlice& literal, PjRtDevice* device) override;
 
@@ -313,12 +345,11 @@ class PjRtStreamExecutorClient : public PjRtClient {
     }
   }
 
+  // Added by Alpa. Copies the bytes on the device-to-host stream of the
+  // buffer's device, like ToLiteral.
   virtual PjRtFuture<Status> CopyRawSubBufferToHost(PjRtBuffer* buffer,
                                                     void* dst, int64_t offset,
-                                                    int64_t transfer_size) {
-    return PjRtFuture<Status>(
-        Unimplemented("Raw copies to host not implemented."));
-  }
+                                                    int64_t transfer_size);
 
   // Helper function for creating PjRtStreamExecutorExecutables. Modifies
   // `options` in-place.
@@ -741,6 +772,17 @@ class PjRtStreamExecutorExecutable : public PjRtLoadedExecutable {
     }
     CompiledMemoryStats memory_stats = CompiledMemoryStats();
     memory_stats.generated_code_size_in_bytes = SizeOfGeneratedCodeInBytes();
+    // Added by Alpa
+    Executable::BufferSizes sizes =
+        executables_[0]->executable()->GetBufferSizes();
+    memory_stats.argument_size_in_bytes =
+        std::max<int64_t>(sizes.argument_size_in_bytes, 0);
+    memory_stats.output_size_in_bytes =
+        std::max<int64_t>(sizes.output_size_in_bytes, 0);
+    memory_stats.alias_size_in_bytes =
+        std::max<int64_t>(sizes.alias_size_in_bytes, 0);
+    memory_stats.temp_size_in_bytes =
+        std::max<int64_t>(sizes.temp_size_in_bytes, 0);
     const HloProto* proto = executables_[0]->executable()->hlo_proto();
     if (proto != nullptr) {
       memory_stats.serialized_hlo_proto = proto->SerializeAsString();
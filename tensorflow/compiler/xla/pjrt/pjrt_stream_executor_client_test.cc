@@ -24,6 +24,7 @@ limitations under the License.
 #include "absl/functional/any_invocable.h"
 #include "tensorflow/compiler/xla/client/client_library.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/literal_util.h"
 #include "tensorflow/compiler/xla/pjrt/pjrt_client.h"
 #include "tensorflow/compiler/xla/service/platform_util.h"
 #include "tensorflow/compiler/xla/shape_util.h"
@@ -114,5 +115,71 @@ TEST(PjRtStreamExecutorClientTest, DonateSameBufferTwice) {
               ::testing::HasSubstr("f(donate(a), donate(a))"));
 }
 
+TEST(PjRtStreamExecutorClientTest, BuffersFromHostBuffers) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetClient());
+  TF_ASSERT_OK_AND_ASSIGN(auto* device0, client->LookupDevice(0));
+  std::vector<float> a = {1, 2, 3, 4, 5, 6};
+  std::vector<int32_t> b = {7, 8};
+  std::vector<float> c(100, 9);
+  std::vector<int64_t> a_dims = {2, 3};
+  std::vector<int64_t> b_dims = {2};
+  std::vector<int64_t> c_dims = {100};
+  std::vector<int64_t> empty_dims = {0};
+  std::vector<PjRtStreamExecutorClient::HostBuffer> host_buffers = {
+      {a.data(), F32, a_dims},
+      {b.data(), S32, b_dims},
+      {nullptr, F32, empty_dims},
+      {c.data(), F32, c_dims},
+  };
+  // a and b share an arena, c is larger than an arena.
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto buffers,
+      client->BuffersFromHostBuffers(host_buffers, device0,
+                                     /*staging_arena_bytes=*/256));
+  ASSERT_EQ(buffers.size(), 4);
+
+  TF_ASSERT_OK_AND_ASSIGN(auto a_literal, buffers[0]->ToLiteralSync());
+  EXPECT_EQ(*a_literal, LiteralUtil::CreateR2<float>({{1, 2, 3}, {4, 5, 6}}));
+  TF_ASSERT_OK_AND_ASSIGN(auto b_literal, buffers[1]->ToLiteralSync());
+  EXPECT_EQ(*b_literal, LiteralUtil::CreateR1<int32_t>(b));
+  TF_ASSERT_OK_AND_ASSIGN(auto empty_literal, buffers[2]->ToLiteralSync());
+  EXPECT_EQ(empty_literal->element_count(), 0);
+  TF_ASSERT_OK_AND_ASSIGN(auto c_literal, buffers[3]->ToLiteralSync());
+  EXPECT_EQ(*c_literal, LiteralUtil::CreateR1<float>(c));
+}
+
+TEST(PjRtStreamExecutorClientTest, ToLiterals) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetClient());
+  TF_ASSERT_OK_AND_ASSIGN(auto* device0, client->LookupDevice(0));
+  std::vector<float> a = {1, 2, 3, 4, 5, 6};
+  std::vector<int32_t> b = {7, 8};
+  std::vector<int64_t> a_dims = {2, 3};
+  std::vector<int64_t> b_dims = {2};
+  std::vector<PjRtStreamExecutorClient::HostBuffer> host_buffers = {
+      {a.data(), F32, a_dims},
+      {b.data(), S32, b_dims},
+  };
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto buffers, client->BuffersFromHostBuffers(host_buffers, device0));
+
+  Literal a_literal(ShapeUtil::MakeShape(F32, a_dims));
+  Literal b_literal(ShapeUtil::MakeShape(S32, b_dims));
+  std::vector<PjRtBuffer*> buffer_ptrs = {buffers[0].get(), buffers[1].get()};
+  std::vector<MutableLiteralBase*> literals = {&a_literal, &b_literal};
+  TF_ASSERT_OK(client->ToLiterals(buffer_ptrs, literals).Await());
+  EXPECT_EQ(a_literal, LiteralUtil::CreateR2<float>({{1, 2, 3}, {4, 5, 6}}));
+  EXPECT_EQ(b_literal, LiteralUtil::CreateR1<int32_t>(b));
+
+  EXPECT_FALSE(client->ToLiterals(buffer_ptrs, {&a_literal}).Await().ok());
+}
+
+TEST(PjRtStreamExecutorClientTest, GetAllocatorStatsWithoutStats) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetClient());
+  TF_ASSERT_OK_AND_ASSIGN(auto* device0, client->LookupDevice(0));
+  // The default stream executor allocator keeps no stats.
+  StatusOr<tsl::AllocatorStats> stats = device0->GetAllocatorStats();
+  EXPECT_EQ(stats.status().code(), tensorflow::error::UNIMPLEMENTED);
+}
+
 }  // namespace
 }  // namespace xla
@@ -0,0 +1,176 @@
+#include "tensorflow/compiler/xla/pjrt/shape_bucketing.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/logging.h"
+
+namespace xla {
+namespace {
+
+// Makes the dynamic dimensions of the result static, so that the result
+// buffers have the padded shape of the bucket.
+XlaOp RemoveDynamicDimensions(XlaOp op, const Shape& shape) {
+  if (shape.IsTuple()) {
+    std::vector<XlaOp> elements;
+    elements.reserve(shape.tuple_shapes_size());
+    for (int64_t i = 0; i < shape.tuple_shapes_size(); ++i) {
+      elements.push_back(RemoveDynamicDimensions(GetTupleElement(op, i),
+                                                 shape.tuple_shapes(i)));
+    }
+    return Tuple(op.builder(), elements);
+  }
+  if (!shape.IsArray()) {
+    return op;
+  }
+  for (int64_t i = 0; i < shape.rank(); ++i) {
+    if (shape.is_dynamic_dimension(i)) {
+      op = RemoveDynamicDimension(op, i);
+    }
+  }
+  return op;
+}
+
+}  // namespace
+
+ShapeBucketedExecutable::ShapeBucketedExecutable(
+    PjRtClient* client, std::string name,
+    std::vector<BucketedParameter> parameters,
+    BucketedComputationBuilder builder, ShapeBucketingOptions options)
+    : client_(client),
+      name_(std::move(name)),
+      parameters_(std::move(parameters)),
+      builder_(std::move(builder)),
+      options_(std::move(options)) {
+  std::vector<int64_t>& buckets = options_.bucket_sizes;
+  std::sort(buckets.begin(), buckets.end());
+  buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+}
+
+StatusOr<int64_t> ShapeBucketedExecutable::SelectBucket(int64_t length) const {
+  auto it = std::lower_bound(options_.bucket_sizes.begin(),
+                             options_.bucket_sizes.end(), length);
+  if (length < 0 || it == options_.bucket_sizes.end()) {
+    return InvalidArgument("No bucket of %s holds length %d", name_, length);
+  }
+  return *it;
+}
+
+StatusOr<XlaComputation> ShapeBucketedExecutable::BuildComputation(
+    int64_t bucket) const {
+  XlaBuilder builder(absl::StrCat(name_, "_bucket_", bucket));
+  std::vector<XlaOp> parameters;
+  parameters.reserve(parameters_.size());
+  for (int64_t i = 0; i < parameters_.size(); ++i) {
+    const BucketedParameter& parameter = parameters_[i];
+    Shape shape = parameter.shape;
+    if (parameter.dimension >= 0) {
+      if (!shape.IsArray() || parameter.dimension >= shape.rank()) {
+        return InvalidArgument(
+            "Bucketed dimension %d is out of range of parameter %d of %s: %s",
+            parameter.dimension, i, name_, shape.ToString());
+      }
+      shape.set_dimensions(parameter.dimension, bucket);
+      shape.set_dynamic_dimension(parameter.dimension, false);
+    }
+    parameters.push_back(Parameter(&builder, i, shape, absl::StrCat("p", i)));
+  }
+  XlaOp length = Parameter(&builder, parameters_.size(),
+                           ShapeUtil::MakeScalarShape(S32), "length");
+  for (int64_t i = 0; i < parameters_.size(); ++i) {
+    if (parameters_[i].dimension >= 0) {
+      parameters[i] =
+          SetDimensionSize(parameters[i], length, parameters_[i].dimension);
+    }
+  }
+  TF_ASSIGN_OR_RETURN(XlaOp result, builder_(&builder, parameters));
+  TF_ASSIGN_OR_RETURN(Shape result_shape, builder.GetShape(result));
+  return builder.Build(RemoveDynamicDimensions(result, result_shape));
+}
+
+StatusOr<PjRtLoadedExecutable*> ShapeBucketedExecutable::GetExecutable(
+    int64_t bucket) {
+  if (!std::binary_search(options_.bucket_sizes.begin(),
+                          options_.bucket_sizes.end(), bucket)) {
+    return InvalidArgument("%d is not a bucket of %s", bucket, name_);
+  }
+  // Compiles under the lock, so that concurrent executions of a new bucket
+  // compile it once.
+  absl::MutexLock lock(&mu_);
+  auto it = executables_.find(bucket);
+  if (it != executables_.end()) {
+    return it->second.get();
+  }
+  TF_ASSIGN_OR_RETURN(XlaComputation computation, BuildComputation(bucket));
+  VLOG(1) << "Compiling " << name_ << " for bucket " << bucket;
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<PjRtLoadedExecutable> executable,
+                      client_->Compile(computation, options_.compile_options));
+  PjRtLoadedExecutable* result = executable.get();
+  executables_[bucket] = std::move(executable);
+  return result;
+}
+
+StatusOr<std::vector<std::unique_ptr<PjRtBuffer>>>
+ShapeBucketedExecutable::Execute(absl::Span<PjRtBuffer* const> arguments,
+                                 int64_t length, PjRtDevice* device,
+                                 const ExecuteOptions& options) {
+  if (arguments.size() != parameters_.size()) {
+    return InvalidArgument("%s takes %d arguments, but got %d", name_,
+                           parameters_.size(), arguments.size());
+  }
+  TF_ASSIGN_OR_RETURN(int64_t bucket, SelectBucket(length));
+  for (int64_t i = 0; i < arguments.size(); ++i) {
+    int64_t dimension = parameters_[i].dimension;
+    if (dimension < 0) {
+      continue;
+    }
+    const Shape& shape = arguments[i]->on_device_shape();
+    if (!shape.IsArray() || dimension >= shape.rank() ||
+        shape.dimensions(dimension) != bucket) {
+      return InvalidArgument(
+          "Argument %d of %s must be padded to %d on dimension %d, but has "
+          "shape %s",
+          i, name_, bucket, dimension, shape.ToString());
+    }
+  }
+  TF_ASSIGN_OR_RETURN(PjRtLoadedExecutable * executable,
+                      GetExecutable(bucket));
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<PjRtBuffer> length_buffer,
+      client_->BufferFromHostLiteral(
+          LiteralUtil::CreateR0<int32_t>(static_cast<int32_t>(length)),
+          device));
+  std::vector<PjRtBuffer*> all_arguments(arguments.begin(), arguments.end());
+  all_arguments.push_back(length_buffer.get());
+  return executable->ExecuteSharded(all_arguments, device, options);
+}
+
+int64_t ShapeBucketedExecutable::num_compiled_buckets() const {
+  absl::MutexLock lock(&mu_);
+  return executables_.size();
+}
+
+StatusOr<Literal> PadToBucket(const LiteralSlice& literal, int64_t dimension,
+                              int64_t bucket) {
+  const Shape& shape = literal.shape();
+  if (!shape.IsArray() || dimension < 0 || dimension >= shape.rank() ||
+      shape.dimensions(dimension) > bucket) {
+    return InvalidArgument("Cannot pad dimension %d of %s to %d", dimension,
+                           shape.ToString(), bucket);
+  }
+  Shape padded_shape = shape;
+  padded_shape.set_dimensions(dimension, bucket);
+  Literal padded = Literal::CreateFromShape(padded_shape);
+  std::vector<int64_t> base(shape.rank(), 0);
+  TF_RETURN_IF_ERROR(
+      padded.CopySliceFrom(literal, base, base, shape.dimensions()));
+  return std::move(padded);
+}
+
+}  // namespace xla
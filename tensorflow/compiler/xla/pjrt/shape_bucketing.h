@@ -0,0 +1,99 @@
+// This file contains a compile mode for computations with a variable-length
+// dimension, e.g. the sequence length. The computation is compiled once per
+// padded bucket size instead of once per length, and the padding is masked by
+// the dynamic padder.
+
+#ifndef TENSORFLOW_COMPILER_XLA_PJRT_SHAPE_BUCKETING_H_
+#define TENSORFLOW_COMPILER_XLA_PJRT_SHAPE_BUCKETING_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/pjrt/pjrt_client.h"
+#include "tensorflow/compiler/xla/shape.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace xla {
+
+struct BucketedParameter {
+  Shape shape;
+  // The dimension of `shape` padded to the bucket size, or -1 if the
+  // parameter is not bucketed. The size of the dimension in `shape` is
+  // ignored.
+  int64_t dimension = -1;
+};
+
+// Builds the result of the computation for one bucket. The bucketed
+// dimensions of `parameters` have the bucket size as their bound and the
+// actual length as their dynamic size, so the ops built on them only see the
+// first `length` elements.
+using BucketedComputationBuilder = std::function<StatusOr<XlaOp>(
+    XlaBuilder* builder, absl::Span<const XlaOp> parameters)>;
+
+struct ShapeBucketingOptions {
+  // The sizes of the bucketed dimensions to compile for.
+  std::vector<int64_t> bucket_sizes;
+  CompileOptions compile_options;
+};
+
+// A computation compiled for a set of padded shape buckets. The executable of
+// a bucket is compiled on its first execution and cached. The compiled
+// computations take the actual length as an extra s32 parameter after the
+// bucketed parameters. Their results are padded to the bucket size on the
+// dimensions that depend on the length; the values of the padding are
+// unspecified.
+class ShapeBucketedExecutable {
+ public:
+  ShapeBucketedExecutable(PjRtClient* client, std::string name,
+                          std::vector<BucketedParameter> parameters,
+                          BucketedComputationBuilder builder,
+                          ShapeBucketingOptions options);
+
+  // Returns the smallest bucket that holds `length`.
+  StatusOr<int64_t> SelectBucket(int64_t length) const;
+
+  // Returns the computation compiled for `bucket`.
+  StatusOr<XlaComputation> BuildComputation(int64_t bucket) const;
+
+  // Returns the executable of `bucket`, compiling it on first use.
+  StatusOr<PjRtLoadedExecutable*> GetExecutable(int64_t bucket);
+
+  // Runs the executable of the bucket of `length` on `device`. The bucketed
+  // dimensions of `arguments` must be padded to that bucket, e.g. with
+  // PadToBucket().
+  StatusOr<std::vector<std::unique_ptr<PjRtBuffer>>> Execute(
+      absl::Span<PjRtBuffer* const> arguments, int64_t length,
+      PjRtDevice* device, const ExecuteOptions& options = {});
+
+  // Returns the number of buckets compiled so far.
+  int64_t num_compiled_buckets() const;
+
+ private:
+  PjRtClient* const client_;
+  const std::string name_;
+  const std::vector<BucketedParameter> parameters_;
+  const BucketedComputationBuilder builder_;
+  // The bucket sizes are sorted.
+  ShapeBucketingOptions options_;
+
+  mutable absl::Mutex mu_;
+  absl::flat_hash_map<int64_t, std::unique_ptr<PjRtLoadedExecutable>>
+      executables_ ABSL_GUARDED_BY(mu_);
+};
+
+// Returns `literal` padded with zeros on `dimension` to `bucket` elements.
+StatusOr<Literal> PadToBucket(const LiteralSlice& literal, int64_t dimension,
+                              int64_t bucket);
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_PJRT_SHAPE_BUCKETING_H_
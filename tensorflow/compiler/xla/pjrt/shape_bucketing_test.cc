@@ -0,0 +1,73 @@
+#include "tensorflow/compiler/xla/pjrt/shape_bucketing.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/compiler/xla/client/lib/arithmetic.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/pjrt/tfrt_cpu_pjrt_client.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/test.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+
+namespace xla {
+namespace {
+
+// Sums the first `length` elements of a vector.
+std::unique_ptr<ShapeBucketedExecutable> MakeSum(PjRtClient* client) {
+  ShapeBucketingOptions options;
+  options.bucket_sizes = {8, 4};
+  BucketedParameter parameter;
+  parameter.shape = ShapeUtil::MakeShape(F32, {0});
+  parameter.dimension = 0;
+  return std::make_unique<ShapeBucketedExecutable>(
+      client, "sum", std::vector<BucketedParameter>{parameter},
+      [](XlaBuilder* builder,
+         absl::Span<const XlaOp> parameters) -> StatusOr<XlaOp> {
+        return Reduce(parameters[0], ConstantR0<float>(builder, 0),
+                      CreateScalarAddComputation(F32, builder), {0});
+      },
+      options);
+}
+
+TEST(ShapeBucketingTest, CompilesOncePerBucket) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(/*asynchronous=*/true));
+  auto sum = MakeSum(client.get());
+  PjRtDevice* device = client->addressable_devices()[0];
+
+  auto run = [&](std::vector<float> values) -> StatusOr<Literal> {
+    int64_t length = values.size();
+    TF_ASSIGN_OR_RETURN(int64_t bucket, sum->SelectBucket(length));
+    // Fill the padding with values that would change the sum.
+    values.resize(bucket, 100);
+    TF_ASSIGN_OR_RETURN(
+        auto argument,
+        client->BufferFromHostLiteral(LiteralUtil::CreateR1<float>(values),
+                                      device));
+    TF_ASSIGN_OR_RETURN(auto results,
+                        sum->Execute({argument.get()}, length, device));
+    return results[0]->ToLiteralSync();
+  };
+
+  TF_ASSERT_OK_AND_ASSIGN(Literal result, run({1, 2, 3}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(LiteralUtil::CreateR0<float>(6), result));
+  TF_ASSERT_OK_AND_ASSIGN(result, run({1, 2, 3, 4, 5}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(LiteralUtil::CreateR0<float>(15), result));
+  TF_ASSERT_OK_AND_ASSIGN(result, run({1, 2}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(LiteralUtil::CreateR0<float>(3), result));
+  EXPECT_EQ(sum->num_compiled_buckets(), 2);
+
+  EXPECT_FALSE(sum->SelectBucket(9).ok());
+}
+
+TEST(ShapeBucketingTest, PadToBucket) {
+  Literal literal = LiteralUtil::CreateR2<int32_t>({{1, 2}, {3, 4}});
+  TF_ASSERT_OK_AND_ASSIGN(Literal padded,
+                          PadToBucket(literal, /*dimension=*/1, /*bucket=*/3));
+  EXPECT_TRUE(LiteralTestUtil::Equal(
+      LiteralUtil::CreateR2<int32_t>({{1, 2, 0}, {3, 4, 0}}), padded));
+  EXPECT_FALSE(PadToBucket(literal, /*dimension=*/1, /*bucket=*/1).ok());
+}
+
+}  // namespace
+}  // namespace xla
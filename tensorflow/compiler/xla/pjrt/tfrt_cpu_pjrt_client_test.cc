@@ -15,13 +15,17 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/pjrt/tfrt_cpu_pjrt_client.h"
 
+#include <memory>
+#include <string>
 #include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "tensorflow/compiler/xla/literal_util.h"
 #include "tensorflow/compiler/xla/service/custom_call_status.h"
 #include "tensorflow/compiler/xla/service/custom_call_target_registry.h"
 #include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
 
 namespace xla {
 namespace {
@@ -72,5 +76,42 @@ ENTRY DonationWithExecutionError() -> f32[2, 2] {
               ::testing::HasSubstr("Donation requested for invalid buffer"));
 }
 
+TEST(TfrtCpuClientTest, SerializeAndDeserializeExecutable) {
+  constexpr char kProgram[] = R"(HloModule Add
+ENTRY Add {
+  x = f32[2,2] parameter(0)
+  ROOT add = f32[2,2] add(x, x)
+})";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(/*asynchronous=*/true));
+  TF_ASSERT_OK_AND_ASSIGN(auto hlo_module,
+                          ParseAndReturnUnverifiedModule(kProgram, {}));
+  XlaComputation xla_computation(hlo_module->ToProto());
+  TF_ASSERT_OK_AND_ASSIGN(auto pjrt_executable,
+                          client->Compile(xla_computation, {}));
+  TF_ASSERT_OK_AND_ASSIGN(std::string serialized,
+                          client->SerializeExecutable(*pjrt_executable));
+  TF_ASSERT_OK_AND_ASSIGN(auto loaded_executable,
+                          client->DeserializeExecutable(serialized, {}));
+
+  std::vector<float> data = {1, 2, 3, 4};
+  Shape shape = ShapeUtil::MakeShape(F32, {2, 2});
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto buffer,
+      client->BufferFromHostBuffer(
+          data.data(), shape.element_type(), shape.dimensions(),
+          /*byte_strides=*/std::nullopt,
+          PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall, nullptr,
+          client->addressable_devices()[0]));
+  TF_ASSERT_OK_AND_ASSIGN(auto result,
+                          loaded_executable->Execute(
+                              /*argument_handles=*/{{buffer.get()}},
+                              /*options=*/{}));
+  TF_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Literal> literal,
+                          result[0][0]->ToLiteralSync());
+  EXPECT_TRUE(LiteralTestUtil::Equal(
+      LiteralUtil::CreateR2<float>({{2, 4}, {6, 8}}), *literal));
+}
+
 }  // namespace
 }  // namespace xla
@@ -512,6 +512,13 @@ void TransposePlan::Execute(
 TransposePlan::TransposePlan() = default;
 TransposePlan::~TransposePlan() = default;
 
+// Added by Alpa. The largest vectorized kernel for 2- and 4-byte elements.
+#ifdef EIGEN_VECTORIZE_AVX512
+static constexpr int kMaxInnerBlockElems16And32Bit = 16;
+#else
+static constexpr int kMaxInnerBlockElems16And32Bit = 8;
+#endif
+
 static void ComputeStrides(
     int64_t elem_size_in_bytes, absl::Span<const int64_t> dims,
     absl::Span<const int64_t> tiling,
@@ -1110,11 +1117,11 @@ void TransposePlan::Initialize() {
         break;
       case 2:
         min_inner_block_elems = 8;
-        max_inner_block_elems = 8;
+        max_inner_block_elems = kMaxInnerBlockElems16And32Bit;
         break;
       case 4:
         min_inner_block_elems = 4;
-        max_inner_block_elems = 8;
+        max_inner_block_elems = kMaxInnerBlockElems16And32Bit;
         break;
       case 8:
         min_inner_block_elems = 2;
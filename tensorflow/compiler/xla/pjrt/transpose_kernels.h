@@ -287,6 +287,52 @@ struct TransposeMicroKernel<uint64_t, /*bs=*/4> {
 
 #endif  // EIGEN_VECTORIZE_AVX
 
+// Added by Alpa. 16x16 kernels for 2- and 4-byte elements, one 512-bit (or,
+// for 2-byte elements, 256-bit) register per row.
+#ifdef EIGEN_VECTORIZE_AVX512
+
+template <>
+struct TransposeMicroKernel<uint16_t, /*bs=*/16> {
+  static void Apply(const char* __restrict a, int64_t lda, char* __restrict b,
+                    int64_t ldb) {
+    using Eigen::internal::Packet16h;
+    using Eigen::internal::PacketBlock;
+    constexpr int bs = 16;
+    PacketBlock<Packet16h, bs> block;
+    for (int i = 0; i < bs; ++i) {
+      block.packet[i] = Eigen::internal::ploadu<Packet16h>(
+          reinterpret_cast<const Eigen::half*>(a + lda * i));
+    }
+    Eigen::internal::ptranspose(block);
+    for (int i = 0; i < bs; ++i) {
+      Eigen::internal::pstoreu<Eigen::half>(
+          reinterpret_cast<Eigen::half*>(b + ldb * i), block.packet[i]);
+    }
+  }
+};
+
+template <>
+struct TransposeMicroKernel<uint32_t, /*bs=*/16> {
+  static void Apply(const char* __restrict a, int64_t lda, char* __restrict b,
+                    int64_t ldb) {
+    using Eigen::internal::Packet16f;
+    using Eigen::internal::PacketBlock;
+    constexpr int bs = 16;
+    PacketBlock<Packet16f, bs> block;
+    for (int i = 0; i < bs; ++i) {
+      block.packet[i] = Eigen::internal::ploadu<Packet16f>(
+          reinterpret_cast<const float*>(a + lda * i));
+    }
+    Eigen::internal::ptranspose(block);
+    for (int i = 0; i < bs; ++i) {
+      Eigen::internal::pstoreu<float>(reinterpret_cast<float*>(b + ldb * i),
+                                      block.packet[i]);
+    }
+  }
+};
+
+#endif  // EIGEN_VECTORIZE_AVX512
+
 }  // namespace xla
 
 #endif  // TENSORFLOW_COMPILER_XLA_PJRT_TRANSPOSE_KERNELS_H_
@@ -17,9 +17,12 @@ limitations under the License.
 
 #include <sys/types.h>
 
+#include <algorithm>
 #include <memory>
 #include <queue>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_format.h"
@@ -66,6 +69,17 @@ limitations under the License.
 // on CPU and GPU the next outfeed operation from the device will block. On
 // TPU there is a buffer, but eventually the TPU will also block.
 //
+// Optionally, the listening threads drop the received data instead of waiting
+// when the queues are full, so that high-rate outfeeds never stall the device.
+//
+// Batching:
+// ---------
+//
+// A callback thread dequeues up to a configurable number of outfeeds that are
+// already queued for its device and passes them to one callback invocation,
+// so that the Python callbacks for all of them run under one acquisition of
+// the GIL.
+//
 // Shutdown:
 // ---------
 //
@@ -151,9 +165,9 @@ std::string OutfeedData::DebugString() const {
 
 class OutfeedReceiverImpl {
  public:
-  OutfeedReceiverImpl(OutfeedReceiver::Callback callback,
+  OutfeedReceiverImpl(OutfeedReceiver::BatchCallback callback,
                       absl::Span<PjRtClient* const> clients,
-                      ssize_t max_callback_queue_size_bytes);
+                      const OutfeedReceiver::Options& options);
 
   OutfeedReceiverImpl(const OutfeedReceiverImpl&) = delete;
   OutfeedReceiverImpl& operator=(const OutfeedReceiverImpl&) = delete;
@@ -164,6 +178,11 @@ class OutfeedReceiverImpl {
 
   void Start();
 
+  int64_t num_dropped() {
+    absl::MutexLock lock(&mu_);
+    return num_dropped_;
+  }
+
   StatusOr<XlaOp> AddOutfeedToBuilder(XlaBuilder* builder, XlaOp token,
                                       uint32_t consumer_id,
                                       std::vector<XlaOp> arrays);
@@ -196,11 +215,15 @@ class OutfeedReceiverImpl {
   // It is not safe to restart an OutfeedReceiver after shutting down one.
   void Shutdown();
 
-  OutfeedReceiver::Callback callback_;
+  OutfeedReceiver::BatchCallback callback_;
   // The devices on which we are listening.
   std::vector<PjRtDevice*> devices_;
   // Maximum bytes capacity of the ensemble of callback queues.
   uint64_t max_callback_queue_size_bytes_;
+  // Maximum number of outfeeds passed to one callback invocation.
+  size_t max_callback_batch_size_;
+  // Whether to drop received outfeeds when the callback queues are full.
+  bool drop_when_queue_full_;
 
   absl::Mutex mu_;
   // Registered shapes by consumer id.
@@ -211,6 +234,8 @@ class OutfeedReceiverImpl {
   uint64_t callback_queue_size_bytes_ ABSL_GUARDED_BY(mu_);
   // Threads listening.
   int num_listening_threads_ ABSL_GUARDED_BY(mu_);
+  // How many outfeeds were dropped because the callback queues were full.
+  int64_t num_dropped_ ABSL_GUARDED_BY(mu_);
   bool shutdown_started_ ABSL_GUARDED_BY(mu_);
 
   // How many callback threads are still working. Used for shutdown.
@@ -224,10 +249,13 @@ class OutfeedReceiverImpl {
 };
 
 OutfeedReceiverImpl::OutfeedReceiverImpl(
-    OutfeedReceiver::Callback callback, absl::Span<PjRtClient* const> clients,
-    ssize_t max_callback_queue_size_bytes) {
+    OutfeedReceiver::BatchCallback callback,
+    absl::Span<PjRtClient* const> clients,
+    const OutfeedReceiver::Options& options) {
   callback_ = callback;
-  max_callback_queue_size_bytes_ = max_callback_queue_size_bytes;
+  max_callback_queue_size_bytes_ = options.max_callback_queue_size_bytes;
+  max_callback_batch_size_ = std::max(options.max_callback_batch_size, 1);
+  drop_when_queue_full_ = options.drop_when_queue_full;
   for (const auto& client : clients) {
     for (auto device : client->addressable_devices()) {
       devices_.push_back(device);
@@ -239,6 +267,7 @@ OutfeedReceiverImpl::OutfeedReceiverImpl(
 
   callback_queue_size_bytes_ = 0;
   num_listening_threads_ = 0;
+  num_dropped_ = 0;
   num_working_callback_threads_ = 0;
   shutdown_started_ = false;
 }
@@ -330,7 +359,20 @@ void OutfeedReceiverImpl::DeviceListenerThreadLoop(int device_idx) {
 void OutfeedReceiverImpl::EnqueueReceivedData(
     uint32_t device_idx, std::unique_ptr<OutfeedData> received)
     ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-  mu_.Await(absl::Condition(this, &OutfeedReceiverImpl::CallbackQueueHasSpace));
+  if (drop_when_queue_full_) {
+    // The shutdown marker is never dropped, it must reach the callback thread.
+    if (!CallbackQueueHasSpace() &&
+        received->consumer_id() != kOutfeedCidShutdown) {
+      ++num_dropped_;
+      LOG_EVERY_N_SEC(WARNING, 10)
+          << "Outfeed callback queue is full; dropped " << num_dropped_
+          << " outfeeds so far. Last dropped: " << received->DebugString();
+      return;
+    }
+  } else {
+    mu_.Await(
+        absl::Condition(this, &OutfeedReceiverImpl::CallbackQueueHasSpace));
+  }
   ssize_t literal_size_bytes = received->literal_size_bytes();
   callback_queue_size_bytes_ += literal_size_bytes;
   VLOG(2) << "Listener enqueues data " << received->DebugString() << " of size "
@@ -355,7 +397,8 @@ void OutfeedReceiverImpl::CallbackThreadLoop(int device_idx) {
     num_working_callback_threads_++;
   }
   while (true) {
-    std::unique_ptr<OutfeedData> received;
+    std::vector<OutfeedReceiver::Received> batch;
+    bool shutdown = false;
     {
       absl::MutexLock lock(&mu_);
       mu_.Await(absl::Condition(
@@ -363,31 +406,38 @@ void OutfeedReceiverImpl::CallbackThreadLoop(int device_idx) {
             return !queue->empty();
           },
           &callback_queues_[device_idx]));
-      received = std::move(callback_queues_[device_idx].front());
-      callback_queues_[device_idx].pop();
-      callback_queue_size_bytes_ -= received->literal_size_bytes();
-      VLOG(2) << "[" << device->DebugString() << "] Dequeued callback for "
-              << received->DebugString() << "; "
-              << callback_queues_[device_idx].size()
-              << " callbacks in queue of total size "
-              << callback_queue_size_bytes_ << " bytes.\n";
+      auto& queue = callback_queues_[device_idx];
+      while (!queue.empty() && batch.size() < max_callback_batch_size_) {
+        std::unique_ptr<OutfeedData> received = std::move(queue.front());
+        queue.pop();
+        callback_queue_size_bytes_ -= received->literal_size_bytes();
+        VLOG(2) << "[" << device->DebugString() << "] Dequeued callback for "
+                << received->DebugString() << "; " << queue.size()
+                << " callbacks in queue of total size "
+                << callback_queue_size_bytes_ << " bytes.\n";
+        if (received->consumer_id() == kOutfeedCidShutdown) {
+          VLOG(2) << "[" << device->DebugString()
+                  << "] Callback loop received shutdown signal";
+          CHECK(queue.empty());
+          shutdown = true;
+          break;
+        }
+        batch.push_back({received->device(), received->consumer_id(),
+                         received->literal()});
+      }
     }
-    if (received->consumer_id() == kOutfeedCidShutdown) {
-      VLOG(2) << "[" << device->DebugString()
-              << "] Callback loop received shutdown signal";
+    if (!batch.empty()) {
+      tsl::profiler::TraceMe traceme("OutfeedReceiver::Callback");
+      callback_(std::move(batch));
+    }
+    if (shutdown) {
       {
         absl::MutexLock lock(&mu_);
-        CHECK(callback_queues_[device_idx].empty());
         --num_working_callback_threads_;
       }
       VLOG(2) << "[" << device->DebugString() << "] Callback loop done";
       return;
     }
-    {
-      tsl::profiler::TraceMe traceme("OutfeedReceiver::Callback");
-      callback_(received->device(), received->consumer_id(),
-                received->literal());
-    }
   }
 }
 
@@ -467,14 +517,31 @@ StatusOr<XlaOp> OutfeedReceiverImpl::AddOutfeedToBuilder(
 OutfeedReceiver::OutfeedReceiver(Callback callback,
                                  absl::Span<PjRtClient* const> clients,
                                  ssize_t max_callback_queue_size_bytes) {
+  Options options;
+  options.max_callback_queue_size_bytes = max_callback_queue_size_bytes;
   p_impl_ = std::make_unique<OutfeedReceiverImpl>(
-      callback, clients, max_callback_queue_size_bytes);
+      [callback = std::move(callback)](std::vector<Received> batch) {
+        for (Received& received : batch) {
+          callback(received.device, received.consumer_id,
+                   std::move(received.literal));
+        }
+      },
+      clients, options);
+}
+
+OutfeedReceiver::OutfeedReceiver(BatchCallback callback,
+                                 absl::Span<PjRtClient* const> clients,
+                                 const Options& options) {
+  p_impl_ = std::make_unique<OutfeedReceiverImpl>(std::move(callback), clients,
+                                                  options);
 }
 
 OutfeedReceiver::~OutfeedReceiver() {}
 
 void OutfeedReceiver::Start() { p_impl_->Start(); }
 
+int64_t OutfeedReceiver::num_dropped() const { return p_impl_->num_dropped(); }
+
 StatusOr<XlaOp> OutfeedReceiver::AddOutfeedToBuilder(
     XlaBuilder* builder, XlaOp token, uint32_t consumer_id,
     std::vector<XlaOp> arrays) {
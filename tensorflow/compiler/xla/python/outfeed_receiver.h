@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_PYTHON_OUTFEED_RECEIVER_H_
 
 #include <memory>
+#include <vector>
 
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/literal.h"
@@ -35,6 +36,30 @@ class OutfeedReceiver {
   using Callback =
       std::function<void(PjRtDevice*, uint32_t, std::shared_ptr<Literal>)>;
 
+  // An outfeed received from a device.
+  struct Received {
+    PjRtDevice* device;
+    uint32_t consumer_id;
+    std::shared_ptr<Literal> literal;
+  };
+
+  // A batch callback takes outfeeds received from one device, in the order
+  // in which they were received.
+  using BatchCallback = std::function<void(std::vector<Received>)>;
+
+  struct Options {
+    // The maximum number of bytes for all received outfeeds queued to be
+    // processed.
+    ssize_t max_callback_queue_size_bytes = 256 * 1024 * 1024;
+    // The maximum number of outfeeds passed to one invocation of the batch
+    // callback. Outfeeds that are already queued are batched; we never wait
+    // for more outfeeds to fill a batch.
+    int max_callback_batch_size = 1;
+    // When the callback queue is full, drop the received outfeeds instead of
+    // pausing receiving outfeeds from devices, which stalls the device.
+    bool drop_when_queue_full = false;
+  };
+
   // Constructs the receiver for the given clients and callback function.
   //
   // Args:
@@ -47,6 +72,11 @@ class OutfeedReceiver {
   OutfeedReceiver(Callback callback, absl::Span<PjRtClient* const> clients,
                   ssize_t max_callback_queue_size_bytes);
 
+  // Constructs the receiver for the given clients, calling the batch callback
+  // with the outfeeds received from one device.
+  OutfeedReceiver(BatchCallback callback, absl::Span<PjRtClient* const> clients,
+                  const Options& options);
+
   OutfeedReceiver(const OutfeedReceiver&) = delete;
   OutfeedReceiver& operator=(const OutfeedReceiver&) = delete;
 
@@ -57,6 +87,10 @@ class OutfeedReceiver {
   // Starts the listener threads and the callback thread.
   void Start();
 
+  // Returns the number of outfeeds that were dropped because the callback
+  // queue was full. Always 0 unless `drop_when_queue_full` is set.
+  int64_t num_dropped() const;
+
   // Adds to the computation builder the outfeed of the arrays.
   // Has the side-effect of registering the sent shape for the consumer_id.
   // Returns error status if the outfeed shape is different than the
@@ -43,21 +43,20 @@ class OutfeedReceiverForPython {
 
   OutfeedReceiverForPython(CallbackToPython callback_python,
                            std::vector<std::shared_ptr<PyClient>> clients,
-                           ssize_t max_callback_queue_size_bytes)
+                           const OutfeedReceiver::Options& options)
       : callback_python_(std::move(callback_python)),
         clients_(std::move(clients)) {
-    OutfeedReceiver::Callback callback =
-        [this](PjRtDevice* device, uint32_t consumer_id,
-               std::shared_ptr<Literal> literal) {
-          this->Callback(device, consumer_id, std::move(literal));
+    OutfeedReceiver::BatchCallback callback =
+        [this](std::vector<OutfeedReceiver::Received> batch) {
+          this->Callback(std::move(batch));
         };
     std::vector<PjRtClient*> client_ptrs(clients_.size());
     absl::c_transform(clients_, client_ptrs.begin(),
                       [](const std::shared_ptr<PyClient>& client) {
                         return client->pjrt_client();
                       });
-    outfeed_receiver_ = std::make_unique<OutfeedReceiver>(
-        callback, client_ptrs, max_callback_queue_size_bytes);
+    outfeed_receiver_ =
+        std::make_unique<OutfeedReceiver>(callback, client_ptrs, options);
   }
   OutfeedReceiverForPython(const OutfeedReceiverForPython&) = delete;
   OutfeedReceiverForPython& operator=(const OutfeedReceiverForPython&) = delete;
@@ -79,14 +78,17 @@ class OutfeedReceiverForPython {
 
   void Start() { outfeed_receiver_->Start(); }
 
+  int64_t num_dropped() const { return outfeed_receiver_->num_dropped(); }
+
   StatusOr<XlaOp> AddOutfeed(XlaBuilder* builder, XlaOp token,
                              uint32_t consumer_id, std::vector<XlaOp> arrays) {
     return outfeed_receiver_->AddOutfeedToBuilder(builder, token, consumer_id,
                                                   arrays);
   }
 
-  void Callback(PjRtDevice* device, uint32_t consumer_id,
-                std::shared_ptr<Literal> literal) {
+  // Calls back to Python for a batch of outfeeds received from one device,
+  // acquiring the GIL once for the whole batch.
+  void Callback(std::vector<OutfeedReceiver::Received> batch) {
     {
       absl::MutexLock lock(&mu_);
       if (outfeed_receiver_shutting_down_) {
@@ -94,6 +96,8 @@ class OutfeedReceiverForPython {
         return;
       }
     }
+    // All outfeeds in a batch are received from the same device.
+    PjRtDevice* device = batch.front().device;
     // We expect the number of clients to be small, so an O(n) search is fine.
     auto it = absl::c_find_if(
         clients_, [device](const std::shared_ptr<PyClient>& client) {
@@ -101,11 +105,15 @@ class OutfeedReceiverForPython {
         });
     CHECK(it != clients_.end());
     py::gil_scoped_acquire gil_acquire;  // Need GIL also for LiteralToPython
-    py::object literal_python = LiteralToPython(std::move(literal)).value();
-    // The callback_ should handle all exceptions in user-code. If we get
-    // an exception here, it is a bug in the callback and we should stop.
-    callback_python_(WrapWithClient<PjRtDevice>(*it, device), consumer_id,
-                     std::move(literal_python));
+    for (OutfeedReceiver::Received& received : batch) {
+      // The numpy arrays alias the literal buffers, no data is copied.
+      py::object literal_python =
+          LiteralToPython(std::move(received.literal)).value();
+      // The callback_ should handle all exceptions in user-code. If we get
+      // an exception here, it is a bug in the callback and we should stop.
+      callback_python_(WrapWithClient<PjRtDevice>(*it, device),
+                       received.consumer_id, std::move(literal_python));
+    }
   }
 
  private:
@@ -125,15 +133,22 @@ void BuildOutfeedReceiverSubmodule(py::module* m) {
       "start",
       [](OutfeedReceiverForPython::CallbackToPython callback_to_python,
          std::vector<std::shared_ptr<PyClient>> clients,
-         ssize_t max_callback_queue_size_bytes)
+         ssize_t max_callback_queue_size_bytes, int max_callback_batch_size,
+         bool drop_when_queue_full)
           -> std::unique_ptr<OutfeedReceiverForPython> {
+        OutfeedReceiver::Options options;
+        options.max_callback_queue_size_bytes = max_callback_queue_size_bytes;
+        options.max_callback_batch_size = max_callback_batch_size;
+        options.drop_when_queue_full = drop_when_queue_full;
         auto server = std::make_unique<OutfeedReceiverForPython>(
-            callback_to_python, clients, max_callback_queue_size_bytes);
+            callback_to_python, clients, options);
         server->Start();
         return server;
       },
       py::arg("callback_to_python"), py::arg("backends"),
       py::arg("max_queue_size_bytes") = 256 * 1024 * 1024,
+      py::arg("max_callback_batch_size") = 1,
+      py::arg("drop_when_queue_full") = false,
       R"(Starts a multithreaded outfeed receiver.
 
       There is one thread for each of the specified devices. When Python
@@ -148,6 +163,11 @@ void BuildOutfeedReceiverSubmodule(py::module* m) {
         * max_queue_size_bytes: an optional integer to bound the maximum size
             of arrays in the callback queue. When this limit is reached the
             device listener pauses.
+        * max_callback_batch_size: an optional integer, the maximum number
+            of queued outfeeds from a device for which the Python callback is
+            called under one acquisition of the GIL.
+        * drop_when_queue_full: if true, outfeeds received when the callback
+            queue is full are dropped instead of pausing the device listener.
       )",
       py::call_guard<py::gil_scoped_release>());
 
@@ -163,6 +183,11 @@ void BuildOutfeedReceiverSubmodule(py::module* m) {
       ID. Returns error if the outfeed shape is not compatible with previously
       used shape for the same consumer ID.)",
       py::call_guard<py::gil_scoped_release>());
+
+  outfeed_receiver_class.def(
+      "num_dropped", &OutfeedReceiverForPython::num_dropped,
+      "Returns the number of outfeeds dropped because the queue was full.",
+      py::call_guard<py::gil_scoped_release>());
 }
 
 }  // namespace xla
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/python/outfeed_receiver.h"
 
+#include <algorithm>
 #include <memory>
 
 #include "absl/synchronization/mutex.h"
@@ -226,6 +227,89 @@ TEST(OutfeedReceiverTest, ReceiveOutfeedTwoOutfeed) {
   EXPECT_EQ(ShapeUtil::MakeTupleShape({shape1}), received[1].data->shape());
 }
 
+TEST(OutfeedReceiverTest, ReceiveOutfeedBatches) {
+  TF_ASSERT_OK_AND_ASSIGN(std::shared_ptr<PjRtClient> cpu_client,
+                          GetCpuClient(true));
+  std::vector<PjRtClient*> clients{cpu_client.get()};
+
+  auto receiver = std::make_unique<Accumulator>();
+  int max_batch_size = 0;
+  OutfeedReceiver::BatchCallback callback =
+      [&](std::vector<OutfeedReceiver::Received> batch) {
+        max_batch_size = std::max<int>(max_batch_size, batch.size());
+        for (OutfeedReceiver::Received& received : batch) {
+          receiver->Receive(received.consumer_id, received.literal);
+        }
+      };
+  OutfeedReceiver::Options options;
+  options.max_callback_queue_size_bytes = 1024;
+  options.max_callback_batch_size = 2;
+  auto outfeed_receiver =
+      std::make_shared<OutfeedReceiver>(callback, clients, options);
+  outfeed_receiver->Start();
+
+  XlaBuilder builder("execute_test_outfeed");
+  const Shape shape = ShapeUtil::MakeShape(U32, {16});
+  XlaOp send = CreateToken(&builder);
+  for (int consumer_id = 5; consumer_id < 8; ++consumer_id) {
+    XlaOp data = Iota(&builder, shape, 0);
+    send = outfeed_receiver
+               ->AddOutfeedToBuilder(&builder, send, consumer_id, {data})
+               .value();
+  }
+  EXPECT_TRUE(CompileAndExecute(&builder, send, 0, cpu_client.get()).ok());
+
+  // Shutdown the receiver, to force it to wait to deliver the callbacks.
+  outfeed_receiver = nullptr;
+  std::vector<Accumulator::Data> received = receiver->received();
+  ASSERT_EQ(3, received.size());
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(5 + i, received[i].consumer_id);
+    EXPECT_EQ(ShapeUtil::MakeTupleShape({shape}), received[i].data->shape());
+  }
+  EXPECT_GE(max_batch_size, 1);
+  EXPECT_LE(max_batch_size, 2);
+}
+
+TEST(OutfeedReceiverTest, DropOutfeedWhenQueueFull) {
+  TF_ASSERT_OK_AND_ASSIGN(std::shared_ptr<PjRtClient> cpu_client,
+                          GetCpuClient(true));
+  std::vector<PjRtClient*> clients{cpu_client.get()};
+
+  auto receiver = std::make_unique<Accumulator>();
+  OutfeedReceiver::BatchCallback callback =
+      [&receiver](std::vector<OutfeedReceiver::Received> batch) {
+        for (OutfeedReceiver::Received& received : batch) {
+          receiver->Receive(received.consumer_id, received.literal);
+        }
+      };
+  // The queue is always full, so all outfeeds are dropped without blocking.
+  OutfeedReceiver::Options options;
+  options.max_callback_queue_size_bytes = 0;
+  options.drop_when_queue_full = true;
+  auto outfeed_receiver =
+      std::make_shared<OutfeedReceiver>(callback, clients, options);
+  outfeed_receiver->Start();
+
+  XlaBuilder builder("execute_test_outfeed");
+  constexpr int consumer_id0 = 5;
+  const Shape shape0 = ShapeUtil::MakeShape(U32, {16});
+  XlaOp data0 = Iota(&builder, shape0, 0);
+  XlaOp send0 = outfeed_receiver
+                    ->AddOutfeedToBuilder(&builder, CreateToken(&builder),
+                                          consumer_id0, {data0})
+                    .value();
+  XlaOp send1 = outfeed_receiver
+                    ->AddOutfeedToBuilder(&builder, send0, consumer_id0,
+                                          {Iota(&builder, shape0, 0)})
+                    .value();
+  EXPECT_TRUE(CompileAndExecute(&builder, send1, 0, cpu_client.get()).ok());
+
+  // Shutdown the receiver, to wait until all outfeeds are received.
+  outfeed_receiver = nullptr;
+  EXPECT_TRUE(receiver->received().empty());
+}
+
 TEST(OutfeedReceiverTest, DifferentShapeForConsumerIdError) {
   TF_ASSERT_OK_AND_ASSIGN(std::shared_ptr<PjRtClient> cpu_client,
                           GetCpuClient(true));
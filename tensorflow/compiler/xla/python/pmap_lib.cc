@@ -634,23 +634,20 @@ xla::StatusOr<py::object> PmapFunction::Call(py::args args, py::kwargs kwargs) {
       flat_sharded_device_arrays.push_back(std::move(py_array));
     }
   } else {
-    std::vector<std::vector<xla::PyBuffer::object>> outputs;
-    outputs.resize(num_outputs);
-    for (int output_id = 0; output_id < num_outputs; ++output_id) {
-      outputs[output_id].reserve(num_computations);
+    // Added by Alpa. The outputs hold their buffers in C++, and only create
+    // PyBuffers when their device_buffers are accessed.
+    for (int i = 0; i < num_outputs; ++i) {
+      std::vector<std::shared_ptr<xla::PjRtBuffer>> outputs;
+      outputs.reserve(num_computations);
       for (int computation = 0; computation < num_computations; ++computation) {
-        outputs[output_id].push_back(xla::PyBuffer::Make(
-            client, std::move(output_buffers[computation][output_id]),
-            traceback));
+        outputs.push_back(std::move(output_buffers[computation][i]));
       }
-    }
-
-    for (int i = 0; i < num_outputs; ++i) {
       const ResultSpec& result_spec = output_specs[i];
       flat_sharded_device_arrays.push_back(ShardedDeviceArray::Make(
           /*aval=*/result_spec.out_aval,
           /*sharding_spec=*/result_spec.out_spec,
-          /*device_buffers=*/py::cast(std::move(outputs[i])),
+          /*sharded_buffer=*/
+          xla::PyShardedBuffer(client, std::move(outputs), traceback),
           /*indices=*/result_spec.out_indices,
           /*weak_type=*/result_spec.weak_type));
     }
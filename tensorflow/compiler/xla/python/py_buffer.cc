@@ -23,9 +23,11 @@ limitations under the License.
 #include <vector>
 
 #include "absl/base/casts.h"
+#include "absl/container/flat_hash_map.h"
 #include "pybind11/pybind11.h"
 #include "pybind11/pytypes.h"
 #include "tensorflow/compiler/xla/pjrt/pjrt_client.h"
+#include "tensorflow/compiler/xla/pjrt/pjrt_stream_executor_client.h"
 #include "tensorflow/compiler/xla/python/py_client.h"
 #include "tensorflow/compiler/xla/python/python_ref_manager.h"
 #include "tensorflow/compiler/xla/python/python_utils.h"
@@ -271,6 +273,71 @@ Status PyBuffer::CopyToHostAsync() {
   return OkStatus();
 }
 
+// Added by Alpa
+Status PyBuffer::CopyToHostAsyncBatch(absl::Span<PyBuffer* const> buffers) {
+  std::vector<PjRtBuffer*> pending;
+  std::vector<std::shared_ptr<HostValue>> host_values;
+  for (PyBuffer* buffer : buffers) {
+    if (buffer->buffer_->IsOnCpu() || buffer->host_value_) {
+      continue;
+    }
+    auto transfer_guard_formatter = [buffer] {
+      auto shape = py::cast<std::string>(py::str(buffer->python_shape()));
+      auto dtype = py::cast<std::string>(py::str(buffer->python_dtype()));
+      return absl::StrCat("shape=", shape, ", dtype=", dtype,
+                          ", device=", buffer->device()->DebugString());
+    };
+    TF_RETURN_IF_ERROR(
+        jax::ApplyTransferGuardToDeviceToHost(transfer_guard_formatter));
+    TF_ASSIGN_OR_RETURN(const auto* dynamic_shape,
+                        buffer->xla_dynamic_shape());
+    auto host_value = std::make_shared<HostValue>();
+    host_value->value = std::make_shared<Literal>(
+        ShapeUtil::DeviceShapeToHostShape(*dynamic_shape));
+    buffer->host_value_ = host_value;
+    pending.push_back(buffer->buffer_.get());
+    host_values.push_back(std::move(host_value));
+  }
+
+  py::gil_scoped_release gil;
+  // Batches the buffers of each stream-executor client.
+  absl::flat_hash_map<PjRtStreamExecutorClient*, std::vector<int>> by_client;
+  for (int i = 0; i < pending.size(); ++i) {
+    auto* se_client =
+        dynamic_cast<PjRtStreamExecutorClient*>(pending[i]->client());
+    if (se_client != nullptr) {
+      by_client[se_client].push_back(i);
+      continue;
+    }
+    std::shared_ptr<HostValue>& host_value = host_values[i];
+    pending[i]->ToLiteral(host_value->value.get(),
+                          [host_value](Status status) {
+                            host_value->status = std::move(status);
+                            host_value->ready.Notify();
+                          });
+  }
+  for (auto& [se_client, indices] : by_client) {
+    std::vector<PjRtBuffer*> client_buffers;
+    std::vector<MutableLiteralBase*> literals;
+    std::vector<std::shared_ptr<HostValue>> client_host_values;
+    for (int i : indices) {
+      client_buffers.push_back(pending[i]);
+      literals.push_back(host_values[i]->value.get());
+      client_host_values.push_back(host_values[i]);
+    }
+    se_client->ToLiterals(client_buffers, literals)
+        .OnReady([client_host_values =
+                      std::move(client_host_values)](Status status) {
+          for (const std::shared_ptr<HostValue>& host_value :
+               client_host_values) {
+            host_value->status = status;
+            host_value->ready.Notify();
+          }
+        });
+  }
+  return OkStatus();
+}
+
 StatusOr<pybind11::object> PyBuffer::AsNumPyArray(py::handle this_obj) {
   if (buffer_->IsDeleted()) {
     return InvalidArgument("DeviceArray has been deleted.");
@@ -726,6 +793,19 @@ Status PyBuffer::RegisterTypes(py::module& m) {
       py::is_method(type));
   type.attr("__module__") = m.attr("__name__");
 
+  // Added by Alpa
+  m.def(
+      "copy_to_host_async_batch",
+      [](std::vector<PyBuffer::object> buffers) {
+        std::vector<PyBuffer*> bufs;
+        bufs.reserve(buffers.size());
+        for (const PyBuffer::object& buffer : buffers) {
+          bufs.push_back(buffer.buf());
+        }
+        return PyBuffer::CopyToHostAsyncBatch(bufs);
+      },
+      py::arg("buffers"));
+
   py::class_<PyShardedBuffer>(m, "ShardedBuffer")
       .def(py::init(&PyShardedBuffer::CreateFromPyBuffers))
       .def("get_device_buffers", &PyShardedBuffer::GetPyBuffers)
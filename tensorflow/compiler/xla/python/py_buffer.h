@@ -115,6 +115,9 @@ class PyBuffer {
   // Returns xla::InvalidArgument if the buffer has been deleted.
   Status BlockHostUntilReady();
   Status CopyToHostAsync();
+  // Added by Alpa. Starts CopyToHostAsync for all of `buffers` at once. The
+  // buffers of a stream-executor client share one staging copy per device.
+  static Status CopyToHostAsyncBatch(absl::Span<PyBuffer* const> buffers);
 
   const Shape& shape() { return buffer_->on_device_shape(); }
 
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/python/py_client.h"
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <utility>
@@ -128,48 +129,71 @@ Status PyClient::Defragment() {
     case PjRtRuntimeType::kTfrt:
       return pjrt_client_->Defragment();
     case PjRtRuntimeType::kStreamExecutor:
+      // Added by Alpa. Buffers are moved one device at a time, so that the
+      // host copies are bounded by the memory of one device, and each
+      // PjRtBuffer is moved once even if several PyBuffers share it.
       struct TmpBuffer {
-        PyBuffer* py_buffer;
+        std::vector<PyBuffer*> py_buffers;
         // TODO(skyewm): maybe use py_buffer's HostValue
         std::shared_ptr<Literal> host_copy;
       };
 
-      // Synchronously copy all buffers to host
-      std::vector<TmpBuffer> tmp_buffers;
       for (PyBuffer* device_buffers : buffers_) {
+        // Synchronously copy all buffers of the device to host
+        std::vector<PjRtBuffer*> pjrt_buffers;
+        absl::flat_hash_map<PjRtBuffer*, TmpBuffer> tmp_buffers;
         for (PyBuffer* buffer = device_buffers; buffer;
              buffer = buffer->next_) {
-          if (!buffer->is_deleted()) {
-            TF_ASSIGN_OR_RETURN(std::shared_ptr<Literal> literal,
-                                buffer->buffer_->ToLiteralSync());
-            tmp_buffers.push_back({buffer, literal});
+          if (buffer->is_deleted()) {
+            continue;
           }
+          PjRtBuffer* pjrt_buffer = buffer->buffer_.get();
+          auto [it, inserted] = tmp_buffers.try_emplace(pjrt_buffer);
+          if (inserted) {
+            TF_ASSIGN_OR_RETURN(it->second.host_copy,
+                                pjrt_buffer->ToLiteralSync());
+            pjrt_buffers.push_back(pjrt_buffer);
+          }
+          it->second.py_buffers.push_back(buffer);
+        }
+        if (pjrt_buffers.empty()) {
+          continue;
         }
-      }
 
-      // All buffers successfully copied to host, delete on-device copies.
-      //
-      // Use blocking delete operation to ensure all memory is actually cleared
-      // before we start rewriting buffers.
-      //
-      // Die instead of returning a bad status because program presumably can't
-      // continue if we fail to reconstitute device buffers.
-      for (TmpBuffer& tmp_buffer : tmp_buffers) {
-        TF_CHECK_OK(tensorflow::down_cast<PjRtStreamExecutorBuffer*>(
-                        tmp_buffer.py_buffer->buffer_.get())
-                        ->Release(/*wait_for_operations_to_complete=*/true)
-                        .status());
-      }
+        // All buffers successfully copied to host, delete on-device copies.
+        //
+        // Use blocking delete operation to ensure all memory is actually
+        // cleared before we start rewriting buffers.
+        //
+        // Die instead of returning a bad status because program presumably
+        // can't continue if we fail to reconstitute device buffers.
+        for (PjRtBuffer* pjrt_buffer : pjrt_buffers) {
+          TF_CHECK_OK(
+              tensorflow::down_cast<PjRtStreamExecutorBuffer*>(pjrt_buffer)
+                  ->Release(/*wait_for_operations_to_complete=*/true)
+                  .status());
+        }
 
-      // Copy host copies back to device and update PyBuffers in-place.
-      for (TmpBuffer& tmp_buffer : tmp_buffers) {
-        std::unique_ptr<PjRtBuffer> new_copy =
-            pjrt_client_
-                ->BufferFromHostLiteral(*tmp_buffer.host_copy,
-                                        tmp_buffer.py_buffer->buffer_->device())
-                .value();
-        TF_CHECK_OK(new_copy->BlockHostUntilReady());
-        tmp_buffer.py_buffer->buffer_.reset(new_copy.release());
+        // Copy host copies back to device, largest first so that the large
+        // buffers are packed before the small ones fill the gaps, and update
+        // PyBuffers in-place.
+        std::stable_sort(pjrt_buffers.begin(), pjrt_buffers.end(),
+                         [&](PjRtBuffer* a, PjRtBuffer* b) {
+                           return tmp_buffers[a].host_copy->size_bytes() >
+                                  tmp_buffers[b].host_copy->size_bytes();
+                         });
+        for (PjRtBuffer* pjrt_buffer : pjrt_buffers) {
+          TmpBuffer& tmp_buffer = tmp_buffers[pjrt_buffer];
+          std::shared_ptr<PjRtBuffer> new_copy =
+              pjrt_client_
+                  ->BufferFromHostLiteral(*tmp_buffer.host_copy,
+                                          pjrt_buffer->device())
+                  .value();
+          TF_CHECK_OK(new_copy->BlockHostUntilReady());
+          for (PyBuffer* py_buffer : tmp_buffer.py_buffers) {
+            py_buffer->buffer_ = new_copy;
+          }
+        }
       }
 
       // TODO(skyewm): delete executables?
@@ -127,6 +127,10 @@ class PyClient : public std::enable_shared_from_this<PyClient> {
   std::vector<std::shared_ptr<PyLoadedExecutable>> LiveExecutables();
 
   // TODO(zhangqiaorjc): Remove when we have transparent defragmentation.
+  // Added by Alpa. On StreamExecutor clients, the live buffers are moved
+  // through host memory device by device, waiting for their pending uses, so
+  // that the free device memory coalesces. Meant for safe points, such as
+  // step boundaries.
   Status Defragment();
 
   StatusOr<std::vector<std::vector<ClientAndPtr<PjRtDevice>>>>
@@ -113,6 +113,19 @@ bool PyTreeDef::operator==(const PyTreeDef& other) const {
 
 /*static*/ PyTreeKind PyTreeDef::GetKind(
     const py::handle& obj, PyTreeTypeRegistry::Registration const** custom) {
+  // Added by Alpa. The builtin containers can't be registered again, so
+  // their exact types don't need a registry lookup.
+  *custom = nullptr;
+  PyObject* ptr = obj.ptr();
+  if (PyTuple_CheckExact(ptr)) {
+    return PyTreeKind::kTuple;
+  } else if (PyList_CheckExact(ptr)) {
+    return PyTreeKind::kList;
+  } else if (PyDict_CheckExact(ptr)) {
+    return PyTreeKind::kDict;
+  } else if (ptr == Py_None) {
+    return PyTreeKind::kNone;
+  }
   const PyTreeTypeRegistry::Registration* registration =
       PyTreeTypeRegistry::Lookup(obj.get_type());
   if (registration) {
@@ -143,7 +156,7 @@ void PyTreeDef::FlattenIntoImpl(
   } else {
     node.kind = GetKind(handle, &node.custom);
     auto recurse = [this, &leaf_predicate, &leaves](py::handle child) {
-      FlattenInto(child, leaves, leaf_predicate);
+      FlattenIntoImpl(child, leaves, leaf_predicate);
     };
     switch (node.kind) {
       case PyTreeKind::kNone:
@@ -171,7 +184,7 @@ void PyTreeDef::FlattenIntoImpl(
           throw py::error_already_set();
         }
         for (py::handle key : keys) {
-          recurse(dict[key]);
+          recurse(PyDict_GetItem(dict.ptr(), key.ptr()));
         }
         node.arity = dict.size();
         node.node_data = std::move(keys);
@@ -271,7 +284,7 @@ py::object PyTreeDef::UnflattenImpl(T leaves) const {
         }
         py::object o = MakeNode(node, span);
         agenda.resize(size - node.arity);
-        agenda.push_back(o);
+        agenda.push_back(std::move(o));
         break;
       }
     }
@@ -310,7 +323,7 @@ py::object PyTreeDef::Unflatten(absl::Span<const py::object> leaves) const {
     case PyTreeKind::kNamedTuple: {
       py::tuple tuple(node.arity);
       for (int i = 0; i < node.arity; ++i) {
-        tuple[i] = std::move(children[i]);
+        PyTuple_SET_ITEM(tuple.ptr(), i, children[i].release().ptr());
       }
       if (node.kind == PyTreeKind::kNamedTuple) {
         return node.node_data(*tuple);
@@ -322,16 +335,19 @@ py::object PyTreeDef::Unflatten(absl::Span<const py::object> leaves) const {
     case PyTreeKind::kList: {
       py::list list(node.arity);
       for (int i = 0; i < node.arity; ++i) {
-        list[i] = std::move(children[i]);
+        PyList_SET_ITEM(list.ptr(), i, children[i].release().ptr());
       }
       return std::move(list);
     }
 
     case PyTreeKind::kDict: {
       py::dict dict;
-      py::list keys = py::reinterpret_borrow<py::list>(node.node_data);
+      PyObject* keys = node.node_data.ptr();
       for (int i = 0; i < node.arity; ++i) {
-        dict[keys[i]] = std::move(children[i]);
+        if (PyDict_SetItem(dict.ptr(), PyList_GET_ITEM(keys, i),
+                           children[i].ptr())) {
+          throw py::error_already_set();
+        }
       }
       return std::move(dict);
       break;
@@ -339,7 +355,7 @@ py::object PyTreeDef::Unflatten(absl::Span<const py::object> leaves) const {
     case PyTreeKind::kCustom: {
       py::tuple tuple(node.arity);
       for (int i = 0; i < node.arity; ++i) {
-        tuple[i] = std::move(children[i]);
+        PyTuple_SET_ITEM(tuple.ptr(), i, children[i].release().ptr());
       }
       return node.custom->from_iterable(node.node_data, tuple);
     }
@@ -347,6 +363,125 @@ py::object PyTreeDef::Unflatten(absl::Span<const py::object> leaves) const {
   throw std::logic_error("Unreachable code.");
 }
 
+// Added by Alpa
+bool PyTreeDef::FlattenWithStructure(py::handle x,
+                                     std::vector<py::object>& leaves) const {
+  const int start_num_leaves = leaves.size();
+  auto mismatch = [&]() {
+    leaves.resize(start_num_leaves);
+    return false;
+  };
+  leaves.resize(start_num_leaves + num_leaves());
+  // Walks the nodes in reverse, so the children of a node are visited last to
+  // first and the leaves are filled in from the back.
+  int leaf = leaves.size() - 1;
+  absl::InlinedVector<py::object, 4> agenda;
+  agenda.push_back(py::reinterpret_borrow<py::object>(x));
+  for (auto it = traversal_.rbegin(); it != traversal_.rend(); ++it) {
+    const Node& node = *it;
+    DCHECK(!agenda.empty());
+    py::object object = std::move(agenda.back());
+    agenda.pop_back();
+    PyObject* ptr = object.ptr();
+    switch (node.kind) {
+      case PyTreeKind::kLeaf: {
+        const PyTreeTypeRegistry::Registration* custom;
+        if (GetKind(object, &custom) != PyTreeKind::kLeaf) {
+          return mismatch();
+        }
+        leaves[leaf--] = std::move(object);
+        break;
+      }
+
+      case PyTreeKind::kNone:
+        if (ptr != Py_None) {
+          return mismatch();
+        }
+        break;
+
+      case PyTreeKind::kTuple:
+        if (!PyTuple_CheckExact(ptr) || PyTuple_GET_SIZE(ptr) != node.arity) {
+          return mismatch();
+        }
+        for (int i = 0; i < node.arity; ++i) {
+          agenda.push_back(
+              py::reinterpret_borrow<py::object>(PyTuple_GET_ITEM(ptr, i)));
+        }
+        break;
+
+      case PyTreeKind::kList:
+        if (!PyList_CheckExact(ptr) || PyList_GET_SIZE(ptr) != node.arity) {
+          return mismatch();
+        }
+        for (int i = 0; i < node.arity; ++i) {
+          agenda.push_back(
+              py::reinterpret_borrow<py::object>(PyList_GET_ITEM(ptr, i)));
+        }
+        break;
+
+      case PyTreeKind::kDict: {
+        if (!PyDict_CheckExact(ptr) || PyDict_GET_SIZE(ptr) != node.arity) {
+          return mismatch();
+        }
+        // Same size and all the sorted keys present means the same keys.
+        PyObject* keys = node.node_data.ptr();
+        for (int i = 0; i < node.arity; ++i) {
+          PyObject* value =
+              PyDict_GetItemWithError(ptr, PyList_GET_ITEM(keys, i));
+          if (value == nullptr) {
+            if (PyErr_Occurred()) {
+              throw py::error_already_set();
+            }
+            return mismatch();
+          }
+          agenda.push_back(py::reinterpret_borrow<py::object>(value));
+        }
+        break;
+      }
+
+      case PyTreeKind::kNamedTuple: {
+        const PyTreeTypeRegistry::Registration* custom;
+        if (GetKind(object, &custom) != PyTreeKind::kNamedTuple ||
+            Py_TYPE(ptr) != reinterpret_cast<PyTypeObject*>(
+                                node.node_data.ptr()) ||
+            PyTuple_GET_SIZE(ptr) != node.arity) {
+          return mismatch();
+        }
+        for (int i = 0; i < node.arity; ++i) {
+          agenda.push_back(
+              py::reinterpret_borrow<py::object>(PyTuple_GET_ITEM(ptr, i)));
+        }
+        break;
+      }
+
+      case PyTreeKind::kCustom: {
+        const PyTreeTypeRegistry::Registration* custom;
+        if (GetKind(object, &custom) != PyTreeKind::kCustom ||
+            custom != node.custom) {
+          return mismatch();
+        }
+        py::tuple out = py::cast<py::tuple>(node.custom->to_iterable(object));
+        if (out.size() != 2) {
+          throw xla::XlaRuntimeError(
+              "PyTree custom to_iterable function should return a pair");
+        }
+        if (node.node_data.not_equal(out[1])) {
+          return mismatch();
+        }
+        const int size = agenda.size();
+        for (py::handle entry : py::cast<py::iterable>(out[0])) {
+          agenda.push_back(py::reinterpret_borrow<py::object>(entry));
+        }
+        if (static_cast<int>(agenda.size()) - size != node.arity) {
+          return mismatch();
+        }
+        break;
+      }
+    }
+  }
+  return true;
+}
+
 py::list PyTreeDef::FlattenUpTo(py::handle xs) const {
   py::list leaves(num_leaves());
   std::vector<py::object> agenda;
@@ -779,6 +914,19 @@ void BuildPytreeSubmodule(py::module& m) {
            static_cast<pybind11::object (PyTreeDef::*)(
                pybind11::iterable leaves) const>(&PyTreeDef::Unflatten))
       .def("flatten_up_to", &PyTreeDef::FlattenUpTo)
+      // Added by Alpa
+      .def("flatten_with_structure",
+           [](const PyTreeDef& t, py::handle x) -> py::object {
+             std::vector<py::object> leaves;
+             if (!t.FlattenWithStructure(x, leaves)) {
+               return py::none();
+             }
+             py::list list(leaves.size());
+             for (int i = 0; i < leaves.size(); ++i) {
+               PyList_SET_ITEM(list.ptr(), i, leaves[i].release().ptr());
+             }
+             return std::move(list);
+           })
       .def("compose", &PyTreeDef::Compose)
       .def("walk", &PyTreeDef::Walk,
            "Walk pytree, calling f_node(node, node_data) at nodes, and f_leaf "
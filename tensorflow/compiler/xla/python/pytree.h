@@ -130,6 +130,12 @@ class PyTreeDef {
   // list of leaves [1, (2, 3), {"foo": 4}].
   pybind11::list FlattenUpTo(pybind11::handle x) const;
 
+  // Added by Alpa. Appends the leaves of `x` to `leaves` if `x` has exactly
+  // this tree structure, and returns false otherwise. Reuses the sorted dict
+  // keys of this PyTreeDef instead of sorting them again.
+  bool FlattenWithStructure(pybind11::handle x,
+                            std::vector<pybind11::object>& leaves) const;
+
   // Returns an unflattened PyTree given an iterable of leaves and a PyTreeDef.
   pybind11::object Unflatten(pybind11::iterable leaves) const;
   pybind11::object Unflatten(absl::Span<const pybind11::object> leaves) const;
@@ -85,6 +85,7 @@ void ShardedDeviceArray::Delete() {
     pjrt_buffer->Delete();
   }
   device_buffers_ = std::nullopt;
+  sharded_buffer_ = std::nullopt;
   cpp_device_buffers_ = std::nullopt;
   npy_value_ = std::nullopt;
   is_deleted_ = true;
@@ -96,6 +97,17 @@ ShardedDeviceArray::GetPjRtBuffers() {
     return absl::MakeConstSpan(cpp_device_buffers_.value());
   }
 
+  // Added by Alpa
+  if (sharded_buffer_.has_value()) {
+    std::vector<xla::PjRtBuffer*> cpp_device_buffers;
+    cpp_device_buffers.reserve(sharded_buffer_->num_devices());
+    for (int i = 0; i < sharded_buffer_->num_devices(); ++i) {
+      cpp_device_buffers.push_back(sharded_buffer_->GetPjRtBuffer(i));
+    }
+    cpp_device_buffers_ = std::move(cpp_device_buffers);
+    return absl::MakeConstSpan(cpp_device_buffers_.value());
+  }
+
   if (!device_buffers_.has_value()) {
     return xla::InvalidArgument("ShardedDeviceArray has been deleted.");
   }
@@ -114,6 +126,18 @@ ShardedDeviceArray::GetPjRtBuffers() {
   return absl::MakeConstSpan(cpp_device_buffers_.value());
 }
 
+// Added by Alpa
+std::optional<py::list> ShardedDeviceArray::device_buffers() {
+  if (!device_buffers_.has_value() && sharded_buffer_.has_value()) {
+    py::list device_buffers(sharded_buffer_->num_devices());
+    for (int i = 0; i < sharded_buffer_->num_devices(); ++i) {
+      device_buffers[i] = sharded_buffer_->GetPyBuffer(i);
+    }
+    device_buffers_ = std::move(device_buffers);
+  }
+  return device_buffers_;
+}
+
 PyObject* ShardedDeviceArray::base_type_ = nullptr;
 PyObject* ShardedDeviceArray::type_ = nullptr;
 
@@ -135,13 +159,16 @@ PyObject* ShardedDeviceArray::type_ = nullptr;
     py::object aval, ShardingSpec sharding_spec,
     const xla::PyShardedBuffer& sharded_buffer, py::object indices,
     bool weak_type) {
-  int num_devices = sharded_buffer.num_devices();
-  py::list device_buffers(num_devices);
-  for (int i = 0; i < num_devices; ++i) {
-    device_buffers[i] = sharded_buffer.GetPyBuffer(i);
-  }
-  return Make(std::move(aval), std::move(sharding_spec),
-              std::move(device_buffers), std::move(indices), weak_type);
+  // Added by Alpa. Keeps the buffers in C++ until they are accessed from
+  // Python.
+  py::object obj =
+      py::reinterpret_steal<py::object>(sharded_device_array_tp_new(
+          reinterpret_cast<PyTypeObject*>(type_), nullptr, nullptr));
+  ShardedDeviceArrayObject* sda =
+      reinterpret_cast<ShardedDeviceArrayObject*>(obj.ptr());
+  new (&sda->sda) ShardedDeviceArray(aval, std::move(sharding_spec),
+                                     sharded_buffer, indices, weak_type);
+  return py::reinterpret_borrow<ShardedDeviceArray::object>(obj);
 }
 
 bool ShardedDeviceArray::IsShardedDeviceArray(py::handle handle) {
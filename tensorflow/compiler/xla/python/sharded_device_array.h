@@ -246,9 +246,9 @@ class ShardedDeviceArray {
 
   bool is_deleted() const { return is_deleted_; }
   bool weak_type() const { return weak_type_; }
-  std::optional<pybind11::list> device_buffers() const {
-    return device_buffers_;
-  }
+  // Added by Alpa. The PyBuffers of an array made from a PyShardedBuffer are
+  // only created on the first access.
+  std::optional<pybind11::list> device_buffers();
   pybind11::object aval() const { return aval_; }
   pybind11::object indices() const { return indices_; }
 
@@ -315,6 +315,15 @@ class ShardedDeviceArray {
         indices_(std::move(indices)),
         device_buffers_(std::move(device_buffers)),
         weak_type_(weak_type) {}
+  // Added by Alpa
+  ShardedDeviceArray(pybind11::object aval, ShardingSpec sharding_spec,
+                     xla::PyShardedBuffer sharded_buffer,
+                     pybind11::object indices, bool weak_type)
+      : aval_(std::move(aval)),
+        sharding_spec_(std::move(sharding_spec)),
+        indices_(std::move(indices)),
+        sharded_buffer_(std::move(sharded_buffer)),
+        weak_type_(weak_type) {}
   static PyObject* base_type_;
   static PyObject* type_;
 
@@ -329,6 +338,10 @@ class ShardedDeviceArray {
   // shape and on a different device. Buffers are in row-major order, with
   // replication treated as an extra innermost dimension.
   std::optional<pybind11::list> device_buffers_;
+  // Added by Alpa. The buffers as C++ objects when the array was made from a
+  // PyShardedBuffer, so that no Python object is created per buffer unless
+  // `device_buffers_` is accessed.
+  std::optional<xla::PyShardedBuffer> sharded_buffer_;
 
   std::optional<pybind11::object> npy_value_ = std::nullopt;
   std::optional<pybind11::object> one_replica_buffer_indices_ = std::nullopt;
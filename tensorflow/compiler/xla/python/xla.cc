@@ -31,11 +31,14 @@ limitations under the License.
 #include "pybind11/stl_bind.h"
 #include "tensorflow/compiler/xla/layout_util.h"
 #include "tensorflow/compiler/xla/pjrt/cpu_device.h"
+#include "tensorflow/compiler/xla/pjrt/checkpoint_writer.h"
+#include "tensorflow/compiler/xla/pjrt/compile_farm.h"
 #include "tensorflow/compiler/xla/pjrt/distributed/client.h"
 #include "tensorflow/compiler/xla/pjrt/distributed/distributed.h"
 #include "tensorflow/compiler/xla/pjrt/distributed/service.h"
 #include "tensorflow/compiler/xla/pjrt/mlir_to_hlo.h"
 #include "tensorflow/compiler/xla/pjrt/pjrt_compiler.h"
+#include "tensorflow/compiler/xla/pjrt/pjrt_stream_executor_client.h"
 #include "tensorflow/core/distributed_runtime/preemption/preemption_sync_manager.h"
 #ifdef XLA_PYTHON_ENABLE_GPU
 #include "tensorflow/compiler/xla/pjrt/gpu/se_gpu_pjrt_client.h"
@@ -82,6 +85,8 @@ limitations under the License.
 #ifdef XLA_PYTHON_ENABLE_GPU
 #include "tensorflow/compiler/xla/service/gpu/alpa_events.h"
 #include "tensorflow/compiler/xla/service/gpu/alpa_nccl_wrapper.h"
+#include "tensorflow/compiler/xla/service/gpu/alpa_pipeline_executor.h"
+#include "tensorflow/compiler/xla/service/gpu/autotune_results_store.h"
 
 PYBIND11_MAKE_OPAQUE(std::vector<ncclComm_t>);
 #endif // XLA_PYTHON_ENABLE_GPU
@@ -101,6 +106,32 @@ bool IsOptimizedBuild() {
 #endif  // NDEBUG
 }
 
+// Added by Alpa. The compile farm with the client it compiles for.
+struct PyCompileFarmClient {
+  PyCompileFarmClient(std::shared_ptr<PyClient> client,
+                      std::shared_ptr<DistributedRuntimeClient> kv_client,
+                      CompileFarmOptions options)
+      : client(std::move(client)),
+        farm(this->client->pjrt_client(), std::move(kv_client),
+             std::move(options)) {}
+
+  std::shared_ptr<PyClient> client;
+  CompileFarmClient farm;
+};
+
+struct PyCompileFarmServer {
+  PyCompileFarmServer(std::shared_ptr<PyClient> client,
+                      std::shared_ptr<DistributedRuntimeClient> kv_client,
+                      int server_index, int num_servers,
+                      CompileFarmOptions options)
+      : client(std::move(client)),
+        server(this->client->pjrt_client(), std::move(kv_client),
+               server_index, num_servers, std::move(options)) {}
+
+  std::shared_ptr<PyClient> client;
+  CompileFarmServer server;
+};
+
 }  // namespace
 
 PYBIND11_MODULE(xla_extension, m) {
@@ -221,6 +252,26 @@ PYBIND11_MODULE(xla_extension, m) {
 			CHECK(gpu_client != nullptr);
             return gpu_client->allocator()->ClearStats(device.local_hardware_id());
           })
+      // Added by Alpa
+      .def("memory_stats",
+           [](const PjRtDevice& device) -> StatusOr<py::dict> {
+             TF_ASSIGN_OR_RETURN(tsl::AllocatorStats stats,
+                                 device.GetAllocatorStats());
+             py::dict result;
+             result["num_allocs"] = stats.num_allocs;
+             result["bytes_in_use"] = stats.bytes_in_use;
+             result["peak_bytes_in_use"] = stats.peak_bytes_in_use;
+             result["largest_alloc_size"] = stats.largest_alloc_size;
+             if (stats.bytes_limit) {
+               result["bytes_limit"] = *stats.bytes_limit;
+             }
+             result["bytes_reserved"] = stats.bytes_reserved;
+             result["peak_bytes_reserved"] = stats.peak_bytes_reserved;
+             result["largest_free_block_bytes"] =
+                 stats.largest_free_block_bytes;
+             return result;
+           },
+           "the stats of the allocator of the device memory")
       .def("synchronize_all_activity", [](PjRtDevice& device) {
              PjRtStreamExecutorDevice* stream_device =
                dynamic_cast<PjRtStreamExecutorDevice*>(&device);
@@ -381,7 +432,14 @@ PYBIND11_MODULE(xla_extension, m) {
   alloc_config.def(py::init<>())
       .def_readwrite("kind", &GpuAllocatorConfig::kind)
       .def_readwrite("memory_fraction", &GpuAllocatorConfig::memory_fraction)
-      .def_readwrite("preallocate", &GpuAllocatorConfig::preallocate);
+      .def_readwrite("preallocate", &GpuAllocatorConfig::preallocate)
+      // Added by Alpa
+      .def_readwrite("host_memory_limit_bytes",
+                     &GpuAllocatorConfig::host_memory_limit_bytes)
+      .def_readwrite("host_memory_preallocate_bytes",
+                     &GpuAllocatorConfig::host_memory_preallocate_bytes)
+      .def_readwrite("small_chunk_cache_bytes",
+                     &GpuAllocatorConfig::small_chunk_cache_bytes);
   py::enum_<GpuAllocatorConfig::Kind>(alloc_config, "Kind")
       .value("DEFAULT", GpuAllocatorConfig::Kind::kDefault)
       .value("PLATFORM", GpuAllocatorConfig::Kind::kPlatform)
@@ -612,7 +670,100 @@ PYBIND11_MODULE(xla_extension, m) {
             py::gil_scoped_release gil_release;
             return client.KeyValueSet(key, value);
           },
-          py::arg("key"), py::arg("value"));
+          py::arg("key"), py::arg("value"))
+      // Added by Alpa
+      .def(
+          "blocking_key_value_batch_get",
+          [](DistributedRuntimeClient& client, std::vector<std::string> keys,
+             int64_t timeout_in_ms) {
+            py::gil_scoped_release gil_release;
+            return client.BlockingKeyValueBatchGet(
+                std::move(keys), absl::Milliseconds(timeout_in_ms));
+          },
+          py::arg("keys"), py::arg("timeout_in_ms"))
+      .def(
+          "key_value_batch_set",
+          [](DistributedRuntimeClient& client,
+             std::vector<std::pair<std::string, std::string>> entries) {
+            py::gil_scoped_release gil_release;
+            return client.KeyValueBatchSet(std::move(entries));
+          },
+          py::arg("entries"))
+      .def(
+          "key_value_dir_get",
+          [](DistributedRuntimeClient& client, std::string directory) {
+            py::gil_scoped_release gil_release;
+            return client.KeyValueDirGet(std::move(directory));
+          },
+          py::arg("directory"));
+
+  // Added by Alpa
+  py::class_<PyCompileFarmClient, std::shared_ptr<PyCompileFarmClient>>(
+      m, "CompileFarmClient")
+      .def(py::init([](std::shared_ptr<PyClient> client,
+                       std::shared_ptr<DistributedRuntimeClient> kv_client,
+                       std::string directory, int64_t timeout_in_ms,
+                       bool fallback_to_local) {
+             CompileFarmOptions options;
+             options.directory = std::move(directory);
+             options.timeout = absl::Milliseconds(timeout_in_ms);
+             options.fallback_to_local = fallback_to_local;
+             return std::make_shared<PyCompileFarmClient>(
+                 std::move(client), std::move(kv_client), std::move(options));
+           }),
+           py::arg("client"), py::arg("distributed_client"),
+           py::arg("directory") = "compile_farm",
+           py::arg("timeout_in_ms") = 30 * 60 * 1000,
+           py::arg("fallback_to_local") = true)
+      .def(
+          "compile",
+          [](PyCompileFarmClient& farm, const XlaComputation& computation,
+             CompileOptions options)
+              -> StatusOr<std::shared_ptr<PyLoadedExecutable>> {
+            std::unique_ptr<PjRtLoadedExecutable> executable;
+            std::optional<std::string> fingerprint;
+            {
+              py::gil_scoped_release gil_release;
+              TF_ASSIGN_OR_RETURN(executable, farm.farm.Compile(
+                                                  computation, options));
+              TF_ASSIGN_OR_RETURN(fingerprint,
+                                  farm.client->pjrt_client()
+                                      ->ExecutableFingerprint(*executable));
+            }
+            return std::make_shared<PyLoadedExecutable>(
+                farm.client, std::move(executable), Traceback::Get(),
+                std::move(fingerprint),
+                /*host_callbacks=*/std::vector<py::capsule>());
+          },
+          py::arg("computation"),
+          py::arg("compile_options") = CompileOptions());
+  py::class_<PyCompileFarmServer, std::shared_ptr<PyCompileFarmServer>>(
+      m, "CompileFarmServer")
+      .def(py::init([](std::shared_ptr<PyClient> client,
+                       std::shared_ptr<DistributedRuntimeClient> kv_client,
+                       int server_index, int num_servers,
+                       std::string directory) {
+             CompileFarmOptions options;
+             options.directory = std::move(directory);
+             return std::make_shared<PyCompileFarmServer>(
+                 std::move(client), std::move(kv_client), server_index,
+                 num_servers, std::move(options));
+           }),
+           py::arg("client"), py::arg("distributed_client"),
+           py::arg("server_index") = 0, py::arg("num_servers") = 1,
+           py::arg("directory") = "compile_farm")
+      .def(
+          "serve_once",
+          [](PyCompileFarmServer& server) { return server.server.ServeOnce(); },
+          py::call_guard<py::gil_scoped_release>())
+      .def(
+          "serve",
+          [](PyCompileFarmServer& server, int64_t poll_interval_in_ms) {
+            return server.server.Serve(absl::Milliseconds(poll_interval_in_ms));
+          },
+          py::arg("poll_interval_in_ms") = 1000,
+          py::call_guard<py::gil_scoped_release>())
+      .def("stop", [](PyCompileFarmServer& server) { server.server.Stop(); });
 
   m.def(
       "get_distributed_runtime_service",
@@ -700,6 +851,39 @@ PYBIND11_MODULE(xla_extension, m) {
 
   m.def("collect_garbage", []() { GlobalPyRefManager()->CollectGarbage(); });
 
+  // Added by Alpa
+  m.def(
+      "write_buffers_to_files",
+      [](std::vector<PyBuffer::object> buffers, std::vector<std::string> paths,
+         int64_t chunk_bytes, int num_staging_buffers, int num_threads,
+         bool compress) -> Status {
+        CheckpointWriterOptions options;
+        options.chunk_bytes = chunk_bytes;
+        options.num_staging_buffers = num_staging_buffers;
+        options.num_threads = num_threads;
+        options.compress = compress;
+        std::vector<PjRtBuffer*> pjrt_buffers;
+        pjrt_buffers.reserve(buffers.size());
+        for (PyBuffer::object& buffer : buffers) {
+          pjrt_buffers.push_back(buffer.buf()->buffer());
+        }
+        // Stage through pinned host memory when the client has a pool of it.
+        if (!pjrt_buffers.empty()) {
+          auto* se_client = dynamic_cast<PjRtStreamExecutorClient*>(
+              pjrt_buffers[0]->client());
+          if (se_client != nullptr) {
+            options.staging_allocator = se_client->host_memory_allocator();
+          }
+        }
+        py::gil_scoped_release gil_release;
+        return WriteBuffersToFiles(pjrt_buffers, paths, options);
+      },
+      "stream the device bytes of each buffer to the file of the same index "
+      "in chunks, optionally gzip-compressed",
+      py::arg("buffers"), py::arg("paths"), py::arg("chunk_bytes") = 32 << 20,
+      py::arg("num_staging_buffers") = 8, py::arg("num_threads") = 4,
+      py::arg("compress") = false);
+
   m.def("is_optimized_build", &IsOptimizedBuild);
 
   m.def("json_to_pprof_profile", &JsonToPprofProfile,
@@ -739,6 +923,54 @@ PYBIND11_MODULE(xla_extension, m) {
       py::arg("compile_options") = CompileOptions());
 
 #ifdef XLA_PYTHON_ENABLE_GPU
+  py::class_<gpu::alpa::ReshardingTask> resharding_task(m, "ReshardingTask");
+  py::enum_<gpu::alpa::ReshardingTask::Kind>(resharding_task, "Kind")
+      .value("SEND", gpu::alpa::ReshardingTask::Kind::kSend)
+      .value("RECV", gpu::alpa::ReshardingTask::Kind::kRecv)
+      .value("BROADCAST", gpu::alpa::ReshardingTask::Kind::kBroadcast);
+  resharding_task
+      .def(py::init([](gpu::alpa::ReshardingTask::Kind kind,
+                       const gpu::alpa::AlpaNcclUid& key,
+                       std::vector<int> buffer_indices,
+                       std::vector<uint> start_positions, uint n_elements,
+                       int peer_rank, bool use_recv_stream) {
+             gpu::alpa::ReshardingTask task;
+             task.kind = kind;
+             task.key = key;
+             task.buffer_indices = std::move(buffer_indices);
+             task.start_positions = std::move(start_positions);
+             task.n_elements = n_elements;
+             task.peer_rank = peer_rank;
+             task.use_recv_stream = use_recv_stream;
+             return task;
+           }),
+           py::arg("kind"), py::arg("key"), py::arg("buffer_indices"),
+           py::arg("start_positions"), py::arg("n_elements"),
+           py::arg("peer_rank"), py::arg("use_recv_stream") = false)
+      .def_readwrite("kind", &gpu::alpa::ReshardingTask::kind)
+      .def_readwrite("key", &gpu::alpa::ReshardingTask::key)
+      .def_readwrite("buffer_indices",
+                     &gpu::alpa::ReshardingTask::buffer_indices)
+      .def_readwrite("start_positions",
+                     &gpu::alpa::ReshardingTask::start_positions)
+      .def_readwrite("n_elements", &gpu::alpa::ReshardingTask::n_elements)
+      .def_readwrite("peer_rank", &gpu::alpa::ReshardingTask::peer_rank)
+      .def_readwrite("use_recv_stream",
+                     &gpu::alpa::ReshardingTask::use_recv_stream);
+  m.def("tile_resharding_tasks", &gpu::alpa::TileReshardingTasks,
+        "split the transfer of an n-d tile into one task per contiguous chunk",
+        py::arg("kind"), py::arg("key"), py::arg("buffer_indices"),
+        py::arg("buffer_dims"), py::arg("tile_offsets"), py::arg("tile_shape"),
+        py::arg("all_dims"), py::arg("peer_rank"),
+        py::arg("use_recv_stream") = false);
+  py::class_<gpu::alpa::ReshardingPlan,
+             std::shared_ptr<gpu::alpa::ReshardingPlan>>(m, "ReshardingPlan")
+      .def_readonly("num_buffers", &gpu::alpa::ReshardingPlan::num_buffers)
+      .def_property_readonly("num_peer_copies",
+                             [](const gpu::alpa::ReshardingPlan& plan) {
+                               return plan.peer_copies.size();
+                             });
+
   py::class_<gpu::alpa::PyCommGroup, std::shared_ptr<gpu::alpa::PyCommGroup>>
       alpa_comm_group(m, "CommGroup");
   alpa_comm_group
@@ -751,17 +983,125 @@ PYBIND11_MODULE(xla_extension, m) {
       .def("compute_wait_comm", &gpu::alpa::PyCommGroup::ComputeWaitComm)
       .def("nccl_create_communicators",
            &gpu::alpa::PyCommGroup::NcclCreateCommunicators,
-           "create nccl communicators for cross-mesh communication")
+           "create nccl communicators for cross-mesh communication",
+           py::arg("world_size"), py::arg("device_global_ranks"),
+           py::arg("device_ids"), py::arg("nccl_uid"), py::arg("lazy") = false,
+           py::arg("device_set_key") = "")
       .def("nccl_destroy_comms", &gpu::alpa::PyCommGroup::NcclDestroyComms,
            "destroy comms")
+      .def("nccl_share_comms_with_xla",
+           &gpu::alpa::PyCommGroup::NcclShareCommsWithXla,
+           "lend the communicators of a clique to XLA collectives",
+           py::arg("nccl_uid"), py::arg("global_device_ids"))
       .def("nccl_local_all_gather", &gpu::alpa::PyCommGroup::NcclLocalAllGather,
            "nccl local allgather")
       .def("nccl_broadcast_partial_gpus",
            &gpu::alpa::PyCommGroup::NcclBroadcastPartialGPUs,
            "nccl broadcast with only a subset of gpus in the host are involved")
+      .def("nccl_broadcast_pipelined",
+           &gpu::alpa::PyCommGroup::NcclBroadcastPipelined,
+           "two-level nccl broadcast pipelined over chunks")
       .def("nccl_recv", &gpu::alpa::PyCommGroup::NcclRecv, "nccl recv data")
-      .def("nccl_send", &gpu::alpa::PyCommGroup::NcclSend, "nccl send data");
+      .def("nccl_send", &gpu::alpa::PyCommGroup::NcclSend, "nccl send data")
+      .def("nccl_send_tile", &gpu::alpa::PyCommGroup::NcclSendTile,
+           "nccl send an n-d tile of a buffer")
+      .def("nccl_recv_tile", &gpu::alpa::PyCommGroup::NcclRecvTile,
+           "nccl recv an n-d tile of a buffer")
+      .def("compile_resharding_plan",
+           &gpu::alpa::PyCommGroup::CompileReshardingPlan,
+           "compile a list of resharding tasks against the communicators")
+      .def("execute_resharding_plan",
+           &gpu::alpa::PyCommGroup::ExecuteReshardingPlan,
+           "issue a compiled resharding plan with one nccl group per stream")
+      .def("set_transfer_timing", &gpu::alpa::PyCommGroup::SetTransferTiming,
+           "time the operations on their streams")
+      .def(
+          "get_transfer_stats",
+          [](gpu::alpa::PyCommGroup &group) {
+            py::list stats;
+            for (const auto &[key, counter] : group.GetTransferStats()) {
+              py::dict entry;
+              entry["nccl_uid"] = key.first;
+              entry["peer"] = key.second;
+              entry["num_calls"] = counter.num_calls;
+              entry["bytes"] = counter.bytes;
+              entry["num_timed"] = counter.num_timed;
+              entry["seconds"] = counter.seconds;
+              stats.append(std::move(entry));
+            }
+            return stats;
+          },
+          "the calls, bytes and timed seconds per (nccl uid, peer rank)")
+      .def("reset_transfer_stats",
+           &gpu::alpa::PyCommGroup::ResetTransferStats);
+  py::class_<gpu::alpa::PipelineInstruction> pipeline_instruction(
+      m, "PipelineInstruction");
+  py::enum_<gpu::alpa::PipelineInstruction::Kind>(pipeline_instruction, "Kind")
+      .value("RUN", gpu::alpa::PipelineInstruction::Kind::kRun)
+      .value("SEND", gpu::alpa::PipelineInstruction::Kind::kSend)
+      .value("RECV", gpu::alpa::PipelineInstruction::Kind::kRecv)
+      .value("RESHARD", gpu::alpa::PipelineInstruction::Kind::kReshard)
+      .value("WAIT_EVENTS", gpu::alpa::PipelineInstruction::Kind::kWaitEvents)
+      .value("RECORD_EVENTS",
+             gpu::alpa::PipelineInstruction::Kind::kRecordEvents)
+      .value("FREE", gpu::alpa::PipelineInstruction::Kind::kFree);
+  pipeline_instruction
+      .def(py::init([](gpu::alpa::PipelineInstruction::Kind kind) {
+             gpu::alpa::PipelineInstruction instruction;
+             instruction.kind = kind;
+             return instruction;
+           }),
+           py::arg("kind"))
+      .def_readwrite("kind", &gpu::alpa::PipelineInstruction::kind)
+      .def_readwrite("executable",
+                     &gpu::alpa::PipelineInstruction::executable)
+      .def_readwrite("comm_group",
+                     &gpu::alpa::PipelineInstruction::comm_group)
+      .def_readwrite("plan", &gpu::alpa::PipelineInstruction::plan)
+      .def_readwrite("input_uuids",
+                     &gpu::alpa::PipelineInstruction::input_uuids)
+      .def_readwrite("output_uuids",
+                     &gpu::alpa::PipelineInstruction::output_uuids)
+      .def_readwrite("key", &gpu::alpa::PipelineInstruction::key)
+      .def_readwrite("device_index",
+                     &gpu::alpa::PipelineInstruction::device_index)
+      .def_readwrite("start", &gpu::alpa::PipelineInstruction::start)
+      .def_readwrite("n_elements",
+                     &gpu::alpa::PipelineInstruction::n_elements)
+      .def_readwrite("peer_rank", &gpu::alpa::PipelineInstruction::peer_rank)
+      .def_readwrite("use_default_stream",
+                     &gpu::alpa::PipelineInstruction::use_default_stream)
+      .def_readwrite("event_uuids",
+                     &gpu::alpa::PipelineInstruction::event_uuids)
+      .def_readwrite("is_send", &gpu::alpa::PipelineInstruction::is_send)
+      .def_readwrite("stage", &gpu::alpa::PipelineInstruction::stage)
+      .def_readwrite("microbatch",
+                     &gpu::alpa::PipelineInstruction::microbatch);
+  py::class_<gpu::alpa::PipelineExecutor,
+             std::shared_ptr<gpu::alpa::PipelineExecutor>>(m,
+                                                           "PipelineExecutor")
+      .def(py::init([](std::shared_ptr<PyClient> client) {
+        return std::make_shared<gpu::alpa::PipelineExecutor>(client);
+      }))
+      .def("add_executable", &gpu::alpa::PipelineExecutor::AddExecutable)
+      .def("add_comm_group", &gpu::alpa::PipelineExecutor::AddCommGroup)
+      .def("add_resharding_plan",
+           &gpu::alpa::PipelineExecutor::AddReshardingPlan)
+      .def("add_instruction_list",
+           &gpu::alpa::PipelineExecutor::AddInstructionList,
+           "check a list of instructions and return its index")
+      .def("put_buffers", &gpu::alpa::PipelineExecutor::PutBuffers,
+           py::arg("uuid"), py::arg("buffers"))
+      .def("get_buffers", &gpu::alpa::PipelineExecutor::GetBuffers)
+      .def("delete_buffers", &gpu::alpa::PipelineExecutor::DeleteBuffers)
+      .def("has_buffers", &gpu::alpa::PipelineExecutor::HasBuffers)
+      .def_property_readonly("num_buffers",
+                             &gpu::alpa::PipelineExecutor::num_buffers)
+      .def("run", &gpu::alpa::PipelineExecutor::Run,
+           "run the instructions of a list in order", py::arg("list"));
   m.def("set_num_device_on_host", &gpu::SetNumDeviceOnHost);
+  m.def("set_async_event_wait", &gpu::SetAsyncEventWait,
+        "wait for cross-mesh events on the device instead of the host");
   m.def("set_idx_to_uuid", &gpu::XlaSetIdxToUuid);
   m.def("computation_wait_events", &gpu::alpa::ComputationWaitEvents);
   m.def("set_comm_group_info", &gpu::alpa::SetPyCommGroup,
@@ -773,6 +1113,18 @@ PYBIND11_MODULE(xla_extension, m) {
   m.def("nccl_get_unique_id", &gpu::alpa::NcclGetUniqueId,
         "get unique nccl id");
   m.def("nccl_get_version", &gpu::alpa::NcclGetVersion, "get nccl version");
+  m.def(
+      "get_gpu_autotune_results",
+      []() -> py::bytes { return py::bytes(gpu::SerializeAutotuneResults()); },
+      "serialize the gemm and conv autotuning results of this process, e.g., "
+      "to share them with other workers through the distributed runtime "
+      "key-value store");
+  m.def(
+      "load_gpu_autotune_results",
+      [](py::bytes serialized) -> Status {
+        return gpu::LoadAutotuneResults(std::string(serialized));
+      },
+      "load the autotuning results serialized by get_gpu_autotune_results");
 #endif // XLA_PYTHON_ENABLE_GPU
 }  // NOLINT(readability/fn_size)
 
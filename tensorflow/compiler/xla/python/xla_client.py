@@ -71,6 +71,11 @@ def make_gpu_client(distributed_client=None, node_id=0, platform_name=None,
   allocator = os.getenv('XLA_PYTHON_CLIENT_ALLOCATOR', 'default').lower()
   memory_fraction = os.getenv('XLA_PYTHON_CLIENT_MEM_FRACTION')
   preallocate = os.getenv('XLA_PYTHON_CLIENT_PREALLOCATE')
+  # Added by Alpa
+  host_memory_limit = os.getenv('XLA_PYTHON_CLIENT_HOST_MEM_LIMIT_BYTES')
+  host_memory_preallocate = os.getenv(
+      'XLA_PYTHON_CLIENT_HOST_MEM_PREALLOCATE_BYTES')
+  small_chunk_cache = os.getenv('XLA_PYTHON_CLIENT_SMALL_CHUNK_CACHE_BYTES')
   if allocator not in ('default', 'platform', 'bfc', 'cuda_async'):
     raise ValueError(
         'XLA_PYTHON_CLIENT_ALLOCATOR env var must be "default", "platform", '
@@ -87,6 +92,12 @@ def make_gpu_client(distributed_client=None, node_id=0, platform_name=None,
   if memory_fraction:
     config.memory_fraction = float(memory_fraction)
   config.preallocate = preallocate not in ('0', 'false', 'False')
+  if host_memory_limit:
+    config.host_memory_limit_bytes = int(host_memory_limit)
+  if host_memory_preallocate:
+    config.host_memory_preallocate_bytes = int(host_memory_preallocate)
+  if small_chunk_cache:
+    config.small_chunk_cache_bytes = int(small_chunk_cache)
 
   return _xla.get_gpu_client(
       asynchronous=True,
@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/python/xla_compiler.h"
 
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
 #include <utility>
@@ -57,6 +58,7 @@ limitations under the License.
 #include "tensorflow/tsl/lib/strings/proto_serialization.h"
 
 // Added by Alpa
+#include "tensorflow/compiler/xla/service/compilation_stats.h"
 #include "tensorflow/compiler/xla/service/pass_context.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_cost_model.h"
 #include "tensorflow/compiler/xla/service/spmd/alpa_compiler.h"
@@ -221,6 +223,14 @@ void DefRepeatedProperty(py::class_<T>& cls, const char* name,
       });
 }
 
+// Added by Alpa. The compilation stats collected on this thread between
+// start_compilation_stats and stop_compilation_stats.
+struct ThreadCompilationStats {
+  std::unique_ptr<CompilationStats> stats;
+  std::unique_ptr<ScopedCompilationStats> scope;
+};
+thread_local ThreadCompilationStats thread_compilation_stats;
+
 }  // namespace
 
 void BuildXlaCompilerSubmodule(py::module& m) {
@@ -853,12 +863,95 @@ void BuildXlaCompilerSubmodule(py::module& m) {
   /***** Alpa Functions Begin *****/
   m.def("set_pass_context", &pass_context::SetPassContext);
   m.def("clear_pass_context", &pass_context::ClearPassContext);
-  m.def("estimate_hlo_module_cost", &gpu::EstimateHloModuleCost);
+  m.def("estimate_hlo_module_cost",
+        [](const HloModule* hlo_module) {
+          return gpu::EstimateHloModuleCost(hlo_module);
+        });
+  m.def("estimate_stage_boundary_cost",
+        [](const HloModule* stage_module,
+           const std::vector<OpSharding>& dst_op_shardings,
+           int64_t dst_num_devices) -> StatusOr<double> {
+          std::vector<HloSharding> dst_shardings;
+          for (const OpSharding& op_sharding : dst_op_shardings) {
+            TF_ASSIGN_OR_RETURN(HloSharding sharding,
+                                HloSharding::FromProto(op_sharding));
+            dst_shardings.push_back(std::move(sharding));
+          }
+          return gpu::EstimateStageBoundaryCost(
+              stage_module, dst_shardings, dst_num_devices,
+              gpu::LoadCollectiveCostModel());
+        },
+        py::arg("stage_module"), py::arg("dst_shardings"),
+        py::arg("dst_num_devices"));
+  // Plan the cross-mesh transfers that reshard a set of tensors, e.g., the
+  // training state when the cluster is resized. Returns, for each tensor, a
+  // list of (offset, limit, src_device, dst_devices, seconds).
+  m.def(
+      "plan_cross_mesh_resharding",
+      [](const std::vector<Shape>& shapes,
+         const std::vector<OpSharding>& src_op_shardings,
+         int64_t src_num_devices,
+         const std::vector<OpSharding>& dst_op_shardings,
+         int64_t dst_num_devices) -> StatusOr<py::list> {
+        std::vector<HloSharding> src_shardings, dst_shardings;
+        for (const OpSharding& op_sharding : src_op_shardings) {
+          TF_ASSIGN_OR_RETURN(HloSharding sharding,
+                              HloSharding::FromProto(op_sharding));
+          src_shardings.push_back(std::move(sharding));
+        }
+        for (const OpSharding& op_sharding : dst_op_shardings) {
+          TF_ASSIGN_OR_RETURN(HloSharding sharding,
+                              HloSharding::FromProto(op_sharding));
+          dst_shardings.push_back(std::move(sharding));
+        }
+        spmd::CollectiveCostModel prof_result = gpu::LoadCollectiveCostModel();
+        std::vector<std::vector<gpu::ReshardingTransfer>> plan;
+        {
+          py::gil_scoped_release gil_release;
+          TF_ASSIGN_OR_RETURN(
+              plan, gpu::PlanResharding(shapes, src_shardings, src_num_devices,
+                                        dst_shardings, dst_num_devices,
+                                        prof_result));
+        }
+        py::list ret;
+        for (const auto& transfers : plan) {
+          py::list tensor_transfers;
+          for (const gpu::ReshardingTransfer& transfer : transfers) {
+            tensor_transfers.append(py::make_tuple(
+                transfer.offset, transfer.limit, transfer.src_device,
+                transfer.dst_devices, transfer.seconds));
+          }
+          ret.append(std::move(tensor_transfers));
+        }
+        return ret;
+      },
+      py::arg("shapes"), py::arg("src_shardings"), py::arg("src_num_devices"),
+      py::arg("dst_shardings"), py::arg("dst_num_devices"));
   m.def("set_hlo_module_output_shardings", &spmd::SetHloModuleOutputShardings);
   m.def("set_hlo_module_input_shardings", &spmd::SetHloModuleInputShardings);
   m.def("get_grad_sync_channel_ids", &spmd::GetGradSyncChannelIds);
   m.def("get_alpa_jaxlib_version", [] { return "0.2.2"; });
 
+  // Profile the passes of the compilations run on this thread, and return
+  // them as JSON when stopped.
+  m.def("start_compilation_stats", []() {
+    ThreadCompilationStats& state = thread_compilation_stats;
+    state.scope.reset();
+    state.stats = CompilationStats::MakeStats();
+    state.scope = std::make_unique<ScopedCompilationStats>(state.stats.get());
+  });
+  m.def("stop_compilation_stats", []() -> StatusOr<std::string> {
+    ThreadCompilationStats& state = thread_compilation_stats;
+    if (state.stats == nullptr) {
+      return FailedPrecondition("start_compilation_stats was not called");
+    }
+    state.scope.reset();
+    state.stats->CompilationReport();
+    std::string json = state.stats->ToJson();
+    state.stats.reset();
+    return json;
+  });
+
   m.def(
       "run_auto_sharding",
       [](HloModule* hlo_module, const CompileOptions& options) {
@@ -868,6 +961,41 @@ void BuildXlaCompilerSubmodule(py::module& m) {
       },
       py::arg("hlo_module"), py::arg("compile_options") = CompileOptions());
 
+  // Fit the auto-sharding cost calibration to the measured seconds of the
+  // operations of a partitioned module, e.g., parsed from a profile.
+  m.def(
+      "calibrate_auto_sharding_costs",
+      [](const HloModule* hlo_module,
+         const absl::flat_hash_map<std::string, double>& op_seconds,
+         const std::string& output_file, double damping) {
+        py::gil_scoped_release gil_release;
+        return spmd::CalibrateAutoShardingCostsFromPassContext(
+            *hlo_module, op_seconds, damping, output_file);
+      },
+      py::arg("hlo_module"), py::arg("op_seconds"), py::arg("output_file"),
+      py::arg("damping") = 0.5);
+
+  py::class_<spmd::AutoShardingProblem>(m, "AutoShardingProblem")
+      // Return (solution vector, objective) for the current pass context.
+      .def("solve",
+           [](spmd::AutoShardingProblem& problem)
+               -> StatusOr<std::pair<std::vector<int64_t>, double>> {
+             py::gil_scoped_release gil_release;
+             TF_ASSIGN_OR_RETURN(spmd::AutoShardingSolution solution,
+                                 problem.Solve());
+             return std::make_pair(std::move(solution.s_val),
+                                   solution.objective);
+           });
+
+  m.def(
+      "build_auto_sharding_problem",
+      [](const HloModule* hlo_module, const CompileOptions& options)
+          -> StatusOr<std::unique_ptr<spmd::AutoShardingProblem>> {
+        py::gil_scoped_release gil_release;
+        return spmd::BuildAutoShardingProblem(hlo_module, options);
+      },
+      py::arg("hlo_module"), py::arg("compile_options") = CompileOptions());
+
   m.def(
       "run_spmd_partitioner",
       [](HloModule* hlo_module, const CompileOptions& options) {
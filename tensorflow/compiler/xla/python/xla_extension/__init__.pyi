@@ -321,6 +321,7 @@ class Device:
   def transfer_to_infeed(self, literal: _LiteralSlice): ...
   def transfer_from_outfeed(self, shape: Shape): ...
   def live_buffers(self) -> List[Buffer]: ...
+  def memory_stats(self) -> Dict[str, int]: ...
   def __getattr__(self, name: str) -> Any: ...
 
 class GpuDevice(Device):
@@ -343,7 +344,10 @@ class GpuAllocatorConfig:
       self,
       kind: _GpuAllocatorKind = ...,
       memory_fraction: float = ...,
-      preallocate: bool = ...) -> None: ...
+      preallocate: bool = ...,
+      host_memory_limit_bytes: int = ...,
+      host_memory_preallocate_bytes: int = ...,
+      small_chunk_cache_bytes: int = ...) -> None: ...
 
 class HostBufferSemantics(enum.IntEnum):
   IMMUTABLE_ONLY_DURING_CALL: HostBufferSemantics
@@ -359,6 +363,7 @@ class Client:
   def devices(self) -> List[Device]: ...
   def local_devices(self) -> List[Device]: ...
   def live_buffers(self) -> List[Buffer]: ...
+  def memory_stats(self) -> Dict[str, int]: ...
   def live_executables(self) -> List[LoadedExecutable]: ...
   def host_id(self) -> int: ...
   def process_index(self) -> int: ...
@@ -411,6 +416,7 @@ class Client:
                                          operand_shapes: Any, send_channel_ids: Any, recv_channel_ids: Any) -> Any: ...
 
 
+def copy_to_host_async_batch(buffers: Sequence[DeviceArray]) -> _Status: ...
 def get_cpu_client(asynchronous: bool = ...) -> Client: ...
 def get_tfrt_cpu_client(asynchronous: bool = ...) -> Client: ...
 def get_interpreter_client() -> Client: ...
@@ -566,6 +572,11 @@ class DistributedRuntimeClient:
   def shutdown(self) -> _Status: ...
   def blocking_key_value_get(self, key: str, timeout_in_ms: int) -> _Status: ...
   def key_value_set(self, key: str, value: str) -> _Status: ...
+  def blocking_key_value_batch_get(
+      self, keys: Sequence[str], timeout_in_ms: int) -> List[str]: ...
+  def key_value_batch_set(
+      self, entries: Sequence[Tuple[str, str]]) -> _Status: ...
+  def key_value_dir_get(self, directory: str) -> List[Tuple[str, str]]: ...
   def wait_at_barrier(self, barrier_id: str, timeout_in_ms: int) -> _Status: ...
 def get_distributed_runtime_service(
     address: str,
@@ -594,6 +605,14 @@ def create_preemption_sync_manager() -> PreemptionSyncManager: ...
 
 def collect_garbage() -> None: ...
 
+def write_buffers_to_files(
+    buffers: Sequence[Buffer],
+    paths: Sequence[str],
+    chunk_bytes: int = ...,
+    num_staging_buffers: int = ...,
+    num_threads: int = ...,
+    compress: bool = ...) -> None: ...
+
 def is_optimized_build() -> bool: ...
 
 def json_to_pprof_profile(json: str) -> bytes: ...
@@ -27,7 +27,9 @@ _CallbackToPython = Any
 def start(
     callback_to_python: _CallbackToPython,
     backends: Sequence[Client],
-    max_queue_size_bytes: int = ...) -> OutfeedReceiverForPython: ...
+    max_queue_size_bytes: int = ...,
+    max_callback_batch_size: int = ...,
+    drop_when_queue_full: bool = ...) -> OutfeedReceiverForPython: ...
 
 class OutfeedReceiverForPython:
   def add_outfeed(
@@ -35,3 +37,4 @@ class OutfeedReceiverForPython:
       token: XlaOp,
       consumer_id: int,
       arrays: Sequence[XlaOp]) -> XlaOp: ...
+  def num_dropped(self) -> int: ...
@@ -30,6 +30,7 @@ def all_leaves(arg0: Iterable[Any]) -> bool: ...
 class PyTreeDef:
   def unflatten(self, __leaves: Iterable[Any]) -> PyTreeDef: ...
   def flatten_up_to(self, __xs: Any) -> List[Any]: ...
+  def flatten_with_structure(self, __xs: Any) -> Optional[List[Any]]: ...
   def compose(self, __inner: PyTreeDef) -> PyTreeDef: ...
   def walk(self,
            __f_node: Callable[[Any, Any], Any],
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/runtime/jit_executable.h"
 
+#include <cstring>
 #include <memory>
 #include <optional>
 #include <string_view>
@@ -221,6 +222,84 @@ static llvm::hash_code CombineWithValueConstraineOperands(
   return hash;
 }
 
+// Arguments copied from the caller, so that a specialization can be compiled
+// after `GetExecutable` returns.
+struct SpecializationArguments {
+  explicit SpecializationArguments(size_t num_args) : arguments(num_args) {}
+
+  Arguments<OpaqueArg, ScalarArg, MemrefDesc> arguments;
+  // Copies of the data of value constrained memrefs.
+  std::vector<std::unique_ptr<uint8_t[]>> values;
+};
+
+// Copies the arguments required for specialization. Returns nullptr if some of
+// the arguments can't be copied (e.g. arguments of user-defined types).
+static std::unique_ptr<SpecializationArguments> CopySpecializationArguments(
+    ArgumentsRef arguments, Span<const ArgumentConstraint> constraints) {
+  auto copy = std::make_unique<SpecializationArguments>(arguments.size());
+
+  for (unsigned i = 0; i < arguments.size(); ++i) {
+    if (auto* opaque = dyn_cast<OpaqueArg>(&arguments[i])) {
+      copy->arguments.push_back(OpaqueArg(*opaque));
+      continue;
+    }
+
+    if (auto* scalar = dyn_cast<ScalarArg>(&arguments[i])) {
+      copy->arguments.push_back(ScalarArg(*scalar));
+      continue;
+    }
+
+    auto* memref = dyn_cast<MemrefDesc>(&arguments[i]);
+    if (!memref) return nullptr;
+
+    // Only value constrained memrefs are read by the specialization, all other
+    // memrefs only contribute their type and shape.
+    void* data = nullptr;
+    if (constraints[i] == ArgumentConstraint::kValue) {
+      size_t num_values = memref->rank() == 0 ? 1 : memref->size(0);
+      size_t len = num_values * primitive_util::ByteWidth(memref->dtype());
+      auto& value = copy->values.emplace_back(new uint8_t[len]);
+      std::memcpy(value.get(), memref->data(), len);
+      data = value.get();
+    }
+
+    copy->arguments.emplace_back<MemrefDesc>(
+        memref->dtype(), data, /*offset=*/0, memref->sizes(),
+        memref->strides());
+  }
+
+  return copy;
+}
+
+// Instantiates a compiler for the exported function `name` of the module and
+// specializes it to the arguments.
+static StatusOr<std::unique_ptr<JitCompiler>> InstantiateSpecialization(
+    const JitCompiler::Options& opts, std::string_view mlir_module,
+    std::string_view name, ArgumentsRef arguments,
+    Span<const ArgumentConstraint> constraints,
+    absl::Span<const SymbolicShapesResolver::SymbolicShape> symbolic_shapes,
+    const SpecializationListener* listener) {
+  // Try to instantiate compilation context from the mlir source.
+  StatusOr<std::unique_ptr<JitCompiler>> compiler =
+      JitCompiler::Instantiate(opts, mlir_module, {name});
+
+  if (!compiler.ok()) {
+    llvm::errs() << compiler.status().message();
+    assert(false && "parsing mlir module must always succeed at this point");
+    return compiler.status();
+  }
+
+  // Specialize executable to the concrete operands.
+  if (auto specialized = (*compiler)->Specialize(0, arguments, symbolic_shapes,
+                                                 constraints, listener);
+      !specialized.ok()) {
+    return InternalError("failed to specialize executable: %s",
+                         specialized.message());
+  }
+
+  return compiler;
+}
+
 // TODO(ezhulenev): The fast path should be free of mutex to find the
 // pre-compiled specialization. Maybe use atomic pointers (multiple atomic
 // pointers?) to keep the most commonly used specialization available without
@@ -300,29 +379,65 @@ StatusOr<AsyncValuePtr<Executable>> JitExecutable::GetExecutable(
     return cached;
   }
 
-  // Instantiation from the source and specialization are cheap, so we do it in
-  // the caller thread. We only use compilation runner for expensive part.
-
-  // Try to instantiate compilation context from the mlir source.
-  StatusOr<std::unique_ptr<JitCompiler>> compiler =
-      JitCompiler::Instantiate(opts_.compiler, mlir_module_, {fn.name});
-
-  if (!compiler.ok()) {
-    llvm::errs() << compiler.status().message();
-    assert(false && "parsing mlir module must always succeed at this point");
-    return compiler.status();
-  }
-
-  // Specialize executable to the concrete operands.
   StatusOr<llvm::SmallVector<SymbolicShapesResolver::SymbolicShape>>
       symbolic_shapes = fn.symbolic_shapes_resolver.Resolve(arguments);
-  if (auto specialized = (*compiler)->Specialize(0, arguments, *symbolic_shapes,
-                                                 fn.constraints, listener);
-      !specialized.ok()) {
-    return InternalError("failed to specialize executable: %s",
-                         specialized.message());
+  if (!symbolic_shapes.ok()) return symbolic_shapes.status();
+
+  // If the default executable serves requests while the specialization is
+  // compiled, do all of the specialization work, including parsing the mlir
+  // source, in the compilation task. All arguments that have the same symbolic
+  // shapes will share the compiled specialization.
+  if (opts_.specialization == Specialization::kEnabled &&
+      has_default_executable_ && listener == nullptr) {
+    if (auto copy = CopySpecializationArguments(arguments, fn.constraints)) {
+      Specializations::Entry entry = specializations_->Allocate(*hash);
+
+      // We lost the race; some other invocation will do the compilation.
+      if (!entry.allocated)
+        return entry.ptr.IsAvailable() ? entry.ptr : DefaultExecutable();
+
+      size_t specialization = entry.size - 1;
+
+      auto compile = CompilationTask(
+          [opts = opts_.compiler, mlir_module = mlir_module_, name = fn.name,
+           constraints = fn.constraints, copy = std::move(copy),
+           symbolic_shapes = std::move(*symbolic_shapes),
+           ref = entry.ptr.CopyRef(), memory_region_name = memory_region_name_,
+           specialization]() mutable {
+            StatusOr<std::unique_ptr<JitCompiler>> compiler =
+                InstantiateSpecialization(
+                    opts, mlir_module, name, copy->arguments, constraints,
+                    symbolic_shapes, /*listener=*/nullptr);
+            if (!compiler.ok()) {
+              ref.SetError(compiler.status());
+              return;
+            }
+
+            StatusOr<Executable> executable = JitCompiler::Compile(
+                std::move(*compiler), memory_region_name, specialization);
+
+            // Set the allocated entry async value state to error or concrete.
+            if (!executable.ok()) {
+              ref.SetError(executable.status());
+            } else {
+              ref.emplace(std::move(*executable));
+            }
+          });
+
+      runner_(specialization, fn.constraints, arguments, std::move(compile),
+              user_data);
+
+      return DefaultExecutable();
+    }
   }
 
+  // Otherwise instantiate the compiler and specialize it in the caller thread,
+  // and only use the compilation runner for the expensive code generation.
+  StatusOr<std::unique_ptr<JitCompiler>> compiler = InstantiateSpecialization(
+      opts_.compiler, mlir_module_, fn.name, arguments, fn.constraints,
+      *symbolic_shapes, listener);
+  if (!compiler.ok()) return compiler.status();
+
   // Allocate a placeholder for the compiled specialization only after we are
   // ready to dispatch the compilation task.
   Specializations::Entry entry = specializations_->Allocate(*hash);
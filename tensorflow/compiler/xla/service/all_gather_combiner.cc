@@ -133,9 +133,11 @@ std::optional<GroupKey> CombineKey(const HloInstruction* instruction,
 }  // namespace
 
 AllGatherCombiner::AllGatherCombiner(int64_t combine_threshold_in_bytes,
-                                     int64_t combine_threshold_count)
+                                     int64_t combine_threshold_count,
+                                     CollectiveCombinerOptions options)
     : combine_threshold_in_bytes_(combine_threshold_in_bytes),
-      combine_threshold_count_(combine_threshold_count) {}
+      combine_threshold_count_(combine_threshold_count),
+      options_(std::move(options)) {}
 
 StatusOr<bool> AllGatherCombiner::Run(
     HloModule* module,
@@ -168,7 +170,7 @@ StatusOr<bool> AllGatherCombiner::Run(
         bool computation_changed,
         CombineInstructionsByKey<GroupKey>(
             computation, key_fn, &CombineAllGathers,
-            combine_threshold_in_bytes_, combine_threshold_count_));
+            combine_threshold_in_bytes_, combine_threshold_count_, options_));
     changed |= computation_changed;
   }
 
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "absl/strings/string_view.h"
 #include "tensorflow/compiler/xla/array2d.h"
+#include "tensorflow/compiler/xla/service/collective_combiner_utils.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
 #include "tensorflow/compiler/xla/statusor.h"
@@ -32,7 +33,8 @@ namespace xla {
 class AllGatherCombiner : public HloModulePass {
  public:
   AllGatherCombiner(int64_t combine_threshold_in_bytes,
-                    int64_t combine_threshold_count);
+                    int64_t combine_threshold_count,
+                    CollectiveCombinerOptions options = {});
 
   absl::string_view name() const override { return "all-gather-combiner"; }
 
@@ -47,6 +49,8 @@ class AllGatherCombiner : public HloModulePass {
 
   // Combine all gather ops up to this threshold (number of operands).
   int64_t combine_threshold_count_;
+
+  CollectiveCombinerOptions options_;
 };
 
 }  // namespace xla
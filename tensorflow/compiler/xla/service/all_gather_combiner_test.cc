@@ -317,5 +317,81 @@ ENTRY entry {
   EXPECT_FALSE(changed);
 }
 
+// Tests that the threshold of each replica group can be set separately.
+TEST_F(AllGatherCombinerTest, CombineWithPerGroupThreshold) {
+  const char* const hlo_string = R"(
+HloModule Module
+
+ENTRY entry {
+  param0 = f32[8] parameter(0)
+  param1 = f32[8] parameter(1)
+  param2 = f32[8] parameter(2)
+  param3 = f32[8] parameter(3)
+  allgather0 = f32[16] all-gather(param0), replica_groups={{0, 1}, {2, 3}},
+    dimensions={0}
+  allgather1 = f32[16] all-gather(param1), replica_groups={{0, 1}, {2, 3}},
+    dimensions={0}
+  allgather2 = f32[16] all-gather(param2), replica_groups={{0, 2}, {1, 3}},
+    dimensions={0}
+  allgather3 = f32[16] all-gather(param3), replica_groups={{0, 2}, {1, 3}},
+    dimensions={0}
+  ROOT tuple = (f32[16], f32[16], f32[16], f32[16])
+    tuple(allgather0, allgather1, allgather2, allgather3)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+
+  // Only the all-gathers over {0, 2} and {1, 3} fit in their threshold.
+  CollectiveCombinerOptions options;
+  options.combine_threshold_bytes_fn = [](const HloInstruction* instruction) {
+    return instruction->replica_groups()[0].replica_ids(1) == 2 ? 128 : 127;
+  };
+  AllGatherCombiner combine(0, kMaxCombineCount, options);
+  ASSERT_EQ(AllGatherCount(*module), 4);
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, combine.Run(module.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              op::Tuple(op::AllGather(op::Parameter(0)),
+                        op::AllGather(op::Parameter(1)),
+                        op::GetTupleElement(
+                            op::AllGather(op::Parameter(2), op::Parameter(3))),
+                        op::GetTupleElement(
+                            op::AllGather(op::Parameter(2), op::Parameter(3)))));
+}
+
+// Tests that a schedule-aware combination does not delay the users of the
+// earlier all-gathers.
+TEST_F(AllGatherCombinerTest, ScheduleAwareDoesNotDelayFirstUser) {
+  const char* const hlo_string = R"(
+HloModule Module
+
+ENTRY entry {
+  param0 = f32[8] parameter(0)
+  param1 = f32[8] parameter(1)
+  allgather0 = f32[32] all-gather(param0), replica_groups={}, dimensions={0}
+  negate0 = f32[32] negate(allgather0)
+  allgather1 = f32[32] all-gather(param1), replica_groups={}, dimensions={0}
+  ROOT tuple = (f32[32], f32[32]) tuple(negate0, allgather1)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+
+  CollectiveCombinerOptions options;
+  options.schedule_aware = true;
+  AllGatherCombiner combine(1024 * 1024, kMaxCombineCount, options);
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, combine.Run(module.get()));
+  EXPECT_FALSE(changed);
+  EXPECT_EQ(AllGatherCount(*module), 2);
+
+  // Without it, the all-gathers are combined.
+  TF_ASSERT_OK_AND_ASSIGN(
+      changed,
+      AllGatherCombiner(1024 * 1024, kMaxCombineCount).Run(module.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_EQ(AllGatherCount(*module), 1);
+}
+
 }  // namespace
 }  // namespace xla
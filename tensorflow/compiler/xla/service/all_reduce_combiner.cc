@@ -114,9 +114,11 @@ Status CombineAllReduces(absl::Span<HloInstruction* const> to_combine) {
 }  // namespace
 
 AllReduceCombiner::AllReduceCombiner(int64_t combine_threshold_in_bytes,
-                                     int64_t combine_threshold_count)
+                                     int64_t combine_threshold_count,
+                                     CollectiveCombinerOptions options)
     : combine_threshold_in_bytes_(combine_threshold_in_bytes),
-      combine_threshold_count_(combine_threshold_count) {}
+      combine_threshold_count_(combine_threshold_count),
+      options_(std::move(options)) {}
 
 // Add a new boolean field to the original AllReduceKey.
 // This field indicates whether the all-reduce is a skippable
@@ -164,7 +166,7 @@ StatusOr<bool> AllReduceCombiner::Run(
         bool computation_changed,
         CombineInstructionsByKey<AllReduceKeyWithSkip>(
             computation, key_fn, &CombineAllReduces,
-            combine_threshold_in_bytes_, combine_threshold_count_));
+            combine_threshold_in_bytes_, combine_threshold_count_, options_));
     changed |= computation_changed;
   }
 
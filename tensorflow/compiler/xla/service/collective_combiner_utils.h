@@ -16,7 +16,9 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_COMBINER_UTILS_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_COMBINER_UTILS_H_
 
+#include <algorithm>
 #include <functional>
+#include <limits>
 #include <utility>
 #include <vector>
 
@@ -34,6 +36,20 @@ limitations under the License.
 
 namespace xla {
 
+// Options of the collective combiners beyond the global thresholds.
+struct CollectiveCombinerOptions {
+  // If set, the byte threshold of a combined instruction, given the first
+  // instruction combined into it, e.g., to use larger buckets for the
+  // latency bound collectives over slow links. Otherwise
+  // `combine_threshold_bytes` is used.
+  std::function<int64_t(const HloInstruction*)> combine_threshold_bytes_fn;
+
+  // Do not combine an instruction that comes after the first user of the
+  // instructions already combined in the post order, so that the combined
+  // instruction does not delay that user.
+  bool schedule_aware = false;
+};
+
 // Combines instructions with matching keys together.
 //
 // Instructions are combined in topological post-order.
@@ -46,7 +62,8 @@ StatusOr<bool> CombineInstructionsByKey(
     HloComputation* computation,
     const std::function<std::optional<K>(const HloInstruction*)>& key_fn,
     const std::function<Status(absl::Span<HloInstruction* const>)>& combine_fn,
-    int64_t combine_threshold_bytes, int64_t combine_threshold_count) {
+    int64_t combine_threshold_bytes, int64_t combine_threshold_count,
+    const CollectiveCombinerOptions& options = {}) {
   // Cache keys for each instruction and build sets of instructions with the
   // same key that might be combined together.
   absl::flat_hash_map<HloInstruction*, K> keys;
@@ -66,6 +83,7 @@ StatusOr<bool> CombineInstructionsByKey(
   while (!keys.empty()) {
     std::vector<HloInstruction*> to_combine;
     int64_t to_combine_bytes = 0;
+    int64_t threshold_bytes = combine_threshold_bytes;
     absl::flat_hash_set<HloInstruction*>* group = nullptr;
 
     // Recompute reachability after every combine group because we can't
@@ -74,14 +92,26 @@ StatusOr<bool> CombineInstructionsByKey(
     std::unique_ptr<HloReachabilityMap> reachability =
         HloReachabilityMap::Build(computation);
 
-    for (HloInstruction* instruction :
-         computation->MakeInstructionPostOrder()) {
+    std::vector<HloInstruction*> post_order =
+        computation->MakeInstructionPostOrder();
+    absl::flat_hash_map<const HloInstruction*, int64_t> positions;
+    if (options.schedule_aware) {
+      for (int64_t i = 0; i < post_order.size(); ++i) {
+        positions[post_order[i]] = i;
+      }
+    }
+    int64_t first_user_position = std::numeric_limits<int64_t>::max();
+
+    for (HloInstruction* instruction : post_order) {
       auto it = keys.find(instruction);
       if (it == keys.end()) continue;
 
       // If this is the first instruction, set the active group.
       if (to_combine.empty()) {
         group = &groups.find(it->second)->second;
+        if (options.combine_threshold_bytes_fn) {
+          threshold_bytes = options.combine_threshold_bytes_fn(instruction);
+        }
       }
 
       // Check instruction is in the active group.
@@ -107,17 +137,23 @@ StatusOr<bool> CombineInstructionsByKey(
 
       // If the instruction is greater than the threshold, then we can never
       // combine it with anything.
-      if (instruction_bytes > combine_threshold_bytes) {
+      if (instruction_bytes > threshold_bytes) {
         VLOG(1) << "Size " << instruction_bytes << " above threshold.";
         keys.erase(it);
         continue;
       }
 
-      if (to_combine_bytes + instruction_bytes > combine_threshold_bytes) {
+      if (to_combine_bytes + instruction_bytes > threshold_bytes) {
         VLOG(1) << "Combined size threshold exceeded.";
         break;
       }
 
+      if (options.schedule_aware &&
+          positions[instruction] > first_user_position) {
+        VLOG(1) << "Instruction is after the first user of the set.";
+        break;
+      }
+
       // We can't combine dependent instructions.
       bool is_reachable =
           absl::c_any_of(to_combine, [&](HloInstruction* to_combine_inst) {
@@ -132,6 +168,12 @@ StatusOr<bool> CombineInstructionsByKey(
       to_combine.push_back(instruction);
       to_combine_bytes += instruction_bytes;
       keys.erase(it);
+      if (options.schedule_aware) {
+        for (const HloInstruction* user : instruction->users()) {
+          first_user_position =
+              std::min(first_user_position, positions[user]);
+        }
+      }
 
       if (to_combine.size() >= combine_threshold_count) {
         VLOG(1) << "Combined count threshold reached.";
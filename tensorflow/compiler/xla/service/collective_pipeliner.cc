@@ -0,0 +1,396 @@
+#include "tensorflow/compiler/xla/service/collective_pipeliner.h"
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/service/call_graph.h"
+#include "tensorflow/compiler/xla/service/collective_ops_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_dce.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/service/hlo_query.h"
+#include "tensorflow/compiler/xla/service/tuple_simplifier.h"
+#include "tensorflow/compiler/xla/service/while_loop_analysis.h"
+#include "tensorflow/compiler/xla/service/while_util.h"
+
+namespace xla {
+
+namespace {
+
+bool IsLoopStateElement(const HloInstruction* instruction,
+                        const HloInstruction* param) {
+  return instruction->opcode() == HloOpcode::kGetTupleElement &&
+         instruction->operand(0) == param;
+}
+
+// Whether `instruction` can be computed once more, one iteration early or
+// outside of the loop, without changing the results of the program.
+bool IsClonable(const HloInstruction* instruction) {
+  switch (instruction->opcode()) {
+    case HloOpcode::kParameter:
+    case HloOpcode::kWhile:
+    case HloOpcode::kConditional:
+    case HloOpcode::kCall:
+    case HloOpcode::kFusion:
+    case HloOpcode::kCustomCall:
+    case HloOpcode::kRng:
+    case HloOpcode::kRngBitGenerator:
+    case HloOpcode::kAllGather:
+    case HloOpcode::kAllReduce:
+    case HloOpcode::kAllToAll:
+    case HloOpcode::kReduceScatter:
+    case HloOpcode::kCollectivePermute:
+      return false;
+    default:
+      return !instruction->HasSideEffect() && !instruction->IsAsynchronous();
+  }
+}
+
+// Collect, in post order, the instructions of the while body that
+// `instruction` transitively depends on, stopping at the elements of the loop
+// state. Returns false if it depends on an element that is neither the
+// induction variable nor loop invariant, or on an instruction that cannot be
+// cloned.
+bool CollectOperands(HloInstruction* instruction, const HloInstruction* param,
+                     int64_t induction_idx,
+                     const absl::flat_hash_set<int64_t>& invariant_indices,
+                     absl::flat_hash_set<HloInstruction*>* visited,
+                     std::vector<HloInstruction*>* post_order,
+                     bool* uses_induction_var) {
+  if (!visited->insert(instruction).second) {
+    return true;
+  }
+  if (IsLoopStateElement(instruction, param)) {
+    if (instruction->tuple_index() == induction_idx) {
+      *uses_induction_var = true;
+    } else if (!invariant_indices.contains(instruction->tuple_index())) {
+      return false;
+    }
+    post_order->push_back(instruction);
+    return true;
+  }
+  if (!IsClonable(instruction)) {
+    return false;
+  }
+  for (HloInstruction* operand : instruction->operands()) {
+    if (!CollectOperands(operand, param, induction_idx, invariant_indices,
+                         visited, post_order, uses_induction_var)) {
+      return false;
+    }
+  }
+  post_order->push_back(instruction);
+  return true;
+}
+
+// Clone `post_order` into `computation`, replacing each element of the loop
+// state with `map_element(element)`. Collectives get new channel ids. Returns
+// the clone of the last instruction.
+HloInstruction* CloneInto(
+    HloComputation* computation, const HloInstruction* param,
+    absl::Span<HloInstruction* const> post_order,
+    const std::function<HloInstruction*(HloInstruction*)>& map_element,
+    int64_t* next_channel_id) {
+  absl::flat_hash_map<const HloInstruction*, HloInstruction*> clones;
+  for (HloInstruction* instruction : post_order) {
+    if (IsLoopStateElement(instruction, param)) {
+      clones[instruction] = map_element(instruction);
+      continue;
+    }
+    std::vector<HloInstruction*> operands;
+    for (const HloInstruction* operand : instruction->operands()) {
+      operands.push_back(clones.at(operand));
+    }
+    HloInstruction* clone = computation->AddInstruction(
+        instruction->CloneWithNewOperands(instruction->shape(), operands));
+    if (clone->channel_id().has_value()) {
+      clone->set_channel_id((*next_channel_id)++);
+    }
+    clones[instruction] = clone;
+  }
+  return clones.at(post_order.back());
+}
+
+// Rotate the pipelinable all-gathers of `while_instr` into the previous
+// iteration. Returns the new while loop, or nullptr if nothing changed.
+StatusOr<HloInstruction*> PipelineAllGathers(HloInstruction* while_instr,
+                                             int64_t* next_channel_id) {
+  HloComputation* body = while_instr->while_body();
+  HloInstruction* root = body->root_instruction();
+  HloInstruction* param = body->parameter_instruction(0);
+  std::optional<int64_t> induction_idx =
+      GetLoopInductionVarTupleIdx(while_instr);
+  if (root->opcode() != HloOpcode::kTuple || !induction_idx.has_value()) {
+    return nullptr;
+  }
+
+  absl::flat_hash_set<int64_t> invariant_indices;
+  for (int64_t i = 0; i < root->operand_count(); ++i) {
+    const HloInstruction* operand = root->operand(i);
+    if (IsLoopStateElement(operand, param) && operand->tuple_index() == i) {
+      invariant_indices.insert(i);
+    }
+  }
+
+  // Each all-gather with the instructions computing its operands.
+  std::vector<std::vector<HloInstruction*>> candidates;
+  for (HloInstruction* instruction : body->MakeInstructionPostOrder()) {
+    if (instruction->opcode() != HloOpcode::kAllGather) {
+      continue;
+    }
+    std::vector<HloInstruction*> post_order;
+    absl::flat_hash_set<HloInstruction*> visited;
+    bool uses_induction_var = false;
+    bool pipelinable = true;
+    for (HloInstruction* operand : instruction->operands()) {
+      pipelinable &=
+          CollectOperands(operand, param, *induction_idx, invariant_indices,
+                          &visited, &post_order, &uses_induction_var);
+    }
+    // An all-gather that does not depend on the induction variable is loop
+    // invariant, and left to the invariant code motion passes.
+    if (pipelinable && uses_induction_var) {
+      post_order.push_back(instruction);
+      candidates.push_back(std::move(post_order));
+    }
+  }
+  if (candidates.empty()) {
+    return nullptr;
+  }
+  VLOG(1) << "Pipelining " << candidates.size() << " all-gathers of "
+          << while_instr->name();
+
+  // Gather the operands of the first iteration before the loop.
+  HloComputation* computation = while_instr->parent();
+  HloInstruction* init = while_instr->mutable_operand(0);
+  std::vector<HloInstruction*> prologue;
+  for (const std::vector<HloInstruction*>& post_order : candidates) {
+    prologue.push_back(CloneInto(
+        computation, param, post_order,
+        [&](HloInstruction* element) {
+          return computation->AddInstruction(
+              HloInstruction::CreateGetTupleElement(element->shape(), init,
+                                                    element->tuple_index()));
+        },
+        next_channel_id));
+  }
+
+  int64_t num_elements = root->operand_count();
+  TF_ASSIGN_OR_RETURN(WhileUtil::MakeInstructionsLiveInResult result,
+                      WhileUtil::MakeInstructionsLiveIn(while_instr, prologue));
+  HloComputation* new_body = result.new_while_instr->while_body();
+  HloInstruction* new_root = new_body->root_instruction();
+  HloInstruction* next_induction_var =
+      new_root->mutable_operand(*induction_idx);
+
+  // Each iteration uses the value gathered by the previous one, and gathers
+  // the operands of the next one.
+  for (int64_t i = 0; i < candidates.size(); ++i) {
+    const std::vector<HloInstruction*>& post_order = candidates[i];
+    HloInstruction* next = CloneInto(
+        new_body, param, post_order,
+        [&](HloInstruction* element) {
+          return element->tuple_index() == *induction_idx
+                     ? next_induction_var
+                     : result.while_body_instruction_map.at(element);
+        },
+        next_channel_id);
+    TF_RETURN_IF_ERROR(new_root->ReplaceOperandWith(num_elements + i, next));
+    HloInstruction* all_gather =
+        result.while_body_instruction_map.at(post_order.back());
+    TF_RETURN_IF_ERROR(all_gather->ReplaceAllUsesWith(
+        result.while_body_live_in_values[i]));
+    TF_RETURN_IF_ERROR(new_body->RemoveInstructionAndUnusedOperands(all_gather));
+  }
+  return result.new_while_instr;
+}
+
+// Defer the reduce-scatters of `while_instr` that are only accumulated to the
+// next iteration. Returns the new while loop, or nullptr if nothing changed.
+StatusOr<HloInstruction*> DeferReduceScatters(HloInstruction* while_instr,
+                                              int64_t* next_channel_id) {
+  HloComputation* body = while_instr->while_body();
+  HloInstruction* root = body->root_instruction();
+  HloInstruction* param = body->parameter_instruction(0);
+  if (root->opcode() != HloOpcode::kTuple) {
+    return nullptr;
+  }
+
+  // The accumulation buffers must only be read by their accumulation, so the
+  // loop state elements must only be read through get-tuple-elements.
+  absl::flat_hash_map<int64_t, int64_t> num_reads;
+  for (const HloInstruction* user : param->users()) {
+    if (!IsLoopStateElement(user, param)) {
+      return nullptr;
+    }
+    ++num_reads[user->tuple_index()];
+  }
+  const HloComputation* condition = while_instr->while_condition();
+  for (const HloInstruction* user :
+       condition->parameter_instruction(0)->users()) {
+    if (user->opcode() != HloOpcode::kGetTupleElement) {
+      return nullptr;
+    }
+    ++num_reads[user->tuple_index()];
+  }
+
+  // Each accumulation buffer index with its reduce-scatter.
+  std::vector<std::pair<int64_t, HloInstruction*>> candidates;
+  for (int64_t i = 0; i < root->operand_count(); ++i) {
+    const HloInstruction* add = root->operand(i);
+    if (add->opcode() != HloOpcode::kAdd || add->user_count() != 1 ||
+        root->OperandIndices(add).size() != 1 || num_reads[i] != 1) {
+      continue;
+    }
+    for (int64_t j = 0; j < 2; ++j) {
+      const HloInstruction* buffer = add->operand(j);
+      HloInstruction* reduce_scatter = add->mutable_operand(1 - j);
+      if (IsLoopStateElement(buffer, param) && buffer->tuple_index() == i &&
+          buffer->user_count() == 1 &&
+          reduce_scatter->opcode() == HloOpcode::kReduceScatter &&
+          reduce_scatter->operand_count() == 1 &&
+          reduce_scatter->user_count() == 1 &&
+          MatchReductionComputation(reduce_scatter->to_apply()) ==
+              ReductionKind::SUM) {
+        candidates.push_back({i, reduce_scatter});
+        break;
+      }
+    }
+  }
+  if (candidates.empty()) {
+    return nullptr;
+  }
+  VLOG(1) << "Deferring " << candidates.size() << " reduce-scatters of "
+          << while_instr->name();
+
+  // The first iteration reduce-scatters zeros.
+  HloComputation* computation = while_instr->parent();
+  std::vector<HloInstruction*> zeros;
+  for (const auto& [index, reduce_scatter] : candidates) {
+    const Shape& shape = reduce_scatter->operand(0)->shape();
+    HloInstruction* zero = computation->AddInstruction(
+        HloInstruction::CreateConstant(LiteralUtil::Zero(shape.element_type())));
+    zeros.push_back(computation->AddInstruction(
+        HloInstruction::CreateBroadcast(shape, zero, {})));
+  }
+
+  int64_t num_elements = root->operand_count();
+  TF_ASSIGN_OR_RETURN(WhileUtil::MakeInstructionsLiveInResult result,
+                      WhileUtil::MakeInstructionsLiveIn(while_instr, zeros));
+  HloComputation* new_body = result.new_while_instr->while_body();
+  HloInstruction* new_root = new_body->root_instruction();
+
+  for (int64_t i = 0; i < candidates.size(); ++i) {
+    const auto& [index, reduce_scatter] = candidates[i];
+    // Reduce-scatter the operand carried from the previous iteration, and
+    // carry the operand of this one to the next.
+    HloInstruction* old_reduce_scatter =
+        result.while_body_instruction_map.at(reduce_scatter);
+    HloInstruction* deferred =
+        new_body->AddInstruction(old_reduce_scatter->CloneWithNewOperands(
+            old_reduce_scatter->shape(), {result.while_body_live_in_values[i]}));
+    if (deferred->channel_id().has_value()) {
+      deferred->set_channel_id((*next_channel_id)++);
+    }
+    TF_RETURN_IF_ERROR(new_root->ReplaceOperandWith(
+        num_elements + i, old_reduce_scatter->mutable_operand(0)));
+    TF_RETURN_IF_ERROR(old_reduce_scatter->ReplaceAllUsesWith(deferred));
+    TF_RETURN_IF_ERROR(new_body->RemoveInstruction(old_reduce_scatter));
+
+    // Accumulate the operand of the last iteration after the loop.
+    HloInstruction* pending =
+        computation->AddInstruction(HloInstruction::CreateGetTupleElement(
+            reduce_scatter->operand(0)->shape(), result.new_while_instr,
+            num_elements + i));
+    HloInstruction* last = computation->AddInstruction(
+        reduce_scatter->CloneWithNewOperands(reduce_scatter->shape(),
+                                             {pending}));
+    if (last->channel_id().has_value()) {
+      last->set_channel_id((*next_channel_id)++);
+    }
+    HloInstruction* buffer = result.replacement_instr->mutable_operand(index);
+    HloInstruction* sum = computation->AddInstruction(
+        HloInstruction::CreateBinary(buffer->shape(), HloOpcode::kAdd, buffer,
+                                     last));
+    TF_RETURN_IF_ERROR(result.replacement_instr->ReplaceOperandWith(index, sum));
+  }
+  return result.new_while_instr;
+}
+
+// Apply `rewrite` to every while loop whose body is not shared with another
+// loop. The rewritten loops are left with tuples and get-tuple-elements that
+// the next rewrite cannot see through, so they are simplified afterwards.
+StatusOr<bool> RewriteWhileLoops(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads,
+    const std::function<StatusOr<HloInstruction*>(HloInstruction*)>& rewrite) {
+  bool changed = false;
+  std::unique_ptr<CallGraph> call_graph = CallGraph::Build(module);
+  for (HloComputation* computation :
+       module->MakeComputationPostOrder(execution_threads)) {
+    std::vector<HloInstruction*> while_instrs;
+    for (HloInstruction* instruction : computation->instructions()) {
+      if (instruction->opcode() == HloOpcode::kWhile &&
+          call_graph->GetNode(instruction->while_body())
+                  .caller_callsites()
+                  .size() == 1) {
+        while_instrs.push_back(instruction);
+      }
+    }
+    for (HloInstruction* while_instr : while_instrs) {
+      TF_ASSIGN_OR_RETURN(HloInstruction * new_while, rewrite(while_instr));
+      changed |= new_while != nullptr;
+    }
+  }
+  if (changed) {
+    TF_RETURN_IF_ERROR(
+        TupleSimplifier().Run(module, execution_threads).status());
+    TF_RETURN_IF_ERROR(HloDCE().Run(module, execution_threads).status());
+  }
+  return changed;
+}
+
+}  // namespace
+
+StatusOr<bool> CollectivePipeliner::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  // In case of MPMD, collectives might be cross-module and should preserve
+  // their channel ID.
+  if (module->config().num_partitions() > 1 &&
+      !module->config().use_spmd_partitioning()) {
+    return false;
+  }
+
+  bool changed = false;
+  int64_t next_channel_id = hlo_query::NextChannelId(*module);
+  if (pipeline_all_gathers_) {
+    TF_ASSIGN_OR_RETURN(
+        bool rotated,
+        RewriteWhileLoops(module, execution_threads,
+                          [&](HloInstruction* while_instr) {
+                            return PipelineAllGathers(while_instr,
+                                                      &next_channel_id);
+                          }));
+    changed |= rotated;
+  }
+  if (pipeline_reduce_scatters_) {
+    TF_ASSIGN_OR_RETURN(
+        bool deferred,
+        RewriteWhileLoops(module, execution_threads,
+                          [&](HloInstruction* while_instr) {
+                            return DeferReduceScatters(while_instr,
+                                                       &next_channel_id);
+                          }));
+    changed |= deferred;
+  }
+  return changed;
+}
+
+}  // namespace xla
@@ -0,0 +1,72 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_PIPELINER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_PIPELINER_H_
+
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace xla {
+
+// HLO pass that moves collectives in while loops across iterations, so that
+// they can overlap with the compute of a neighbouring iteration. This is meant
+// for the per-layer weight all-gathers and gradient reduce-scatters of scanned
+// layers and gradient accumulation loops with ZeRO-3 style shardings.
+//
+// An all-gather whose operand only depends on the induction variable and on
+// loop-invariant values is rotated into the previous iteration. The all-gather
+// of the first iteration runs before the loop.
+//
+// Pattern before this pass:
+// while:
+//   w = all-gather(dynamic-slice(weights, i))
+//   ... = f(w)
+//   i = i + 1
+// Pattern after this pass:
+// w = all-gather(dynamic-slice(weights, i))
+// while:
+//   ... = f(w)
+//   i = i + 1
+//   w = all-gather(dynamic-slice(weights, i))
+//
+// A sum reduce-scatter whose result is only added to an accumulation buffer
+// that is not otherwise used in the loop is deferred to the next iteration.
+// The reduce-scatter of the last iteration runs after the loop.
+//
+// Pattern before this pass:
+// while:
+//   g = ...
+//   a = a + reduce-scatter(g)
+// Pattern after this pass:
+// p = 0
+// while:
+//   a = a + reduce-scatter(p)
+//   p = ...
+// a = a + reduce-scatter(p)
+//
+// Both rewrites keep one more buffer live across iterations, and the rotated
+// all-gather of the last iteration gathers a clamped slice that is not used.
+// The moved collectives only overlap with compute if they are made
+// asynchronous and scheduled by the latency hiding scheduler.
+class CollectivePipeliner : public HloModulePass {
+ public:
+  explicit CollectivePipeliner(bool pipeline_all_gathers = true,
+                               bool pipeline_reduce_scatters = true)
+      : pipeline_all_gathers_(pipeline_all_gathers),
+        pipeline_reduce_scatters_(pipeline_reduce_scatters) {}
+  ~CollectivePipeliner() override = default;
+
+  absl::string_view name() const override { return "collective-pipeliner"; }
+
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+
+ private:
+  bool pipeline_all_gathers_;
+  bool pipeline_reduce_scatters_;
+};
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_PIPELINER_H_
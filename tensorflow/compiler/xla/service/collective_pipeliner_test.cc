@@ -0,0 +1,212 @@
+#include "tensorflow/compiler/xla/service/collective_pipeliner.h"
+
+#include <memory>
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_matchers.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_verifier.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/tsl/lib/core/status_test_util.h"
+
+namespace xla {
+namespace {
+
+namespace op = xla::testing::opcode_matchers;
+
+class CollectivePipelinerTest : public HloTestBase {
+ protected:
+  StatusOr<std::unique_ptr<VerifiedHloModule>> ParseSpmdModule(
+      absl::string_view hlo) {
+    HloModuleConfig config = GetModuleConfigForTest(/*replica_count=*/1,
+                                                    /*num_partitions=*/4);
+    config.set_use_spmd_partitioning(true);
+    return ParseAndReturnVerifiedModule(hlo, config);
+  }
+
+  const HloInstruction* FindWhile(const HloModule& module) {
+    for (const HloInstruction* instruction :
+         module.entry_computation()->instructions()) {
+      if (instruction->opcode() == HloOpcode::kWhile) {
+        return instruction;
+      }
+    }
+    return nullptr;
+  }
+};
+
+// A scan over 4 layers whose weights are sharded along the layer dimension
+// and gathered in every iteration.
+constexpr absl::string_view kScanHlo = R"(
+HloModule scan
+
+%condition {
+  %param = (s32[], f32[4,2,8], f32[8]) parameter(0)
+  %i = s32[] get-tuple-element(%param), index=0
+  %n = s32[] constant(4)
+  ROOT %lt = pred[] compare(%i, %n), direction=LT
+}
+
+%body {
+  %param = (s32[], f32[4,2,8], f32[8]) parameter(0)
+  %i = s32[] get-tuple-element(%param), index=0
+  %weights = f32[4,2,8] get-tuple-element(%param), index=1
+  %x = f32[8] get-tuple-element(%param), index=2
+  %zero = s32[] constant(0)
+  %slice = f32[1,2,8] dynamic-slice(%weights, %i, %zero, %zero), dynamic_slice_sizes={1,2,8}
+  %shard = f32[2,8] reshape(%slice)
+  %all-gather = f32[8,8] all-gather(%shard), channel_id=1, replica_groups={{0,1,2,3}}, dimensions={0}, use_global_device_ids=true
+  %y = f32[8] dot(%all-gather, %x), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  %one = s32[] constant(1)
+  %next_i = s32[] add(%i, %one)
+  ROOT %tuple = (s32[], f32[4,2,8], f32[8]) tuple(%next_i, %weights, %y)
+}
+
+ENTRY %main {
+  %weights = f32[4,2,8] parameter(0)
+  %x = f32[8] parameter(1)
+  %zero = s32[] constant(0)
+  %init = (s32[], f32[4,2,8], f32[8]) tuple(%zero, %weights, %x)
+  ROOT %while = (s32[], f32[4,2,8], f32[8]) while(%init), condition=%condition, body=%body
+}
+)";
+
+TEST_F(CollectivePipelinerTest, RotateAllGather) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseSpmdModule(kScanHlo));
+  TF_ASSERT_OK_AND_ASSIGN(
+      bool changed,
+      CollectivePipeliner(/*pipeline_all_gathers=*/true,
+                          /*pipeline_reduce_scatters=*/false)
+          .Run(module.get()));
+  ASSERT_TRUE(changed);
+  TF_ASSERT_OK(HloVerifier(/*layout_sensitive=*/false,
+                           /*allow_mixed_precision=*/true)
+                   .Run(module.get())
+                   .status());
+
+  // The first all-gather runs before the loop and is carried into it.
+  const HloInstruction* while_instr = FindWhile(*module);
+  ASSERT_NE(while_instr, nullptr);
+  ASSERT_EQ(while_instr->shape().tuple_shapes_size(), 4);
+  EXPECT_THAT(while_instr->operand(0)->operand(3), op::AllGather());
+
+  // The body computes with the carried value, and gathers the slice of the
+  // next iteration.
+  const HloInstruction* root = while_instr->while_body()->root_instruction();
+  EXPECT_THAT(root->operand(2),
+              op::Dot(op::GetTupleElement(op::Parameter(0), 3), op::_));
+  EXPECT_THAT(root->operand(3),
+              op::AllGather(op::Reshape(op::DynamicSlice(
+                  op::GetTupleElement(op::Parameter(0), 1), op::Add(),
+                  op::Constant(), op::Constant()))));
+}
+
+TEST_F(CollectivePipelinerTest, DontRotateAllGatherOfLoopCarriedValue) {
+  constexpr absl::string_view kHlo = R"(
+HloModule loop
+
+%condition {
+  %param = (s32[], f32[2,8]) parameter(0)
+  %i = s32[] get-tuple-element(%param), index=0
+  %n = s32[] constant(4)
+  ROOT %lt = pred[] compare(%i, %n), direction=LT
+}
+
+%body {
+  %param = (s32[], f32[2,8]) parameter(0)
+  %i = s32[] get-tuple-element(%param), index=0
+  %x = f32[2,8] get-tuple-element(%param), index=1
+  %all-gather = f32[8,8] all-gather(%x), channel_id=1, replica_groups={{0,1,2,3}}, dimensions={0}, use_global_device_ids=true
+  %y = f32[2,8] slice(%all-gather), slice={[0:2], [0:8]}
+  %one = s32[] constant(1)
+  %next_i = s32[] add(%i, %one)
+  ROOT %tuple = (s32[], f32[2,8]) tuple(%next_i, %y)
+}
+
+ENTRY %main {
+  %x = f32[2,8] parameter(0)
+  %zero = s32[] constant(0)
+  %init = (s32[], f32[2,8]) tuple(%zero, %x)
+  ROOT %while = (s32[], f32[2,8]) while(%init), condition=%condition, body=%body
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseSpmdModule(kHlo));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          CollectivePipeliner().Run(module.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(CollectivePipelinerTest, DeferReduceScatter) {
+  constexpr absl::string_view kHlo = R"(
+HloModule grad_acc
+
+%sum {
+  %a = f32[] parameter(0)
+  %b = f32[] parameter(1)
+  ROOT %add = f32[] add(%a, %b)
+}
+
+%condition {
+  %param = (s32[], f32[8,8], f32[2,8]) parameter(0)
+  %i = s32[] get-tuple-element(%param), index=0
+  %n = s32[] constant(4)
+  ROOT %lt = pred[] compare(%i, %n), direction=LT
+}
+
+%body {
+  %param = (s32[], f32[8,8], f32[2,8]) parameter(0)
+  %i = s32[] get-tuple-element(%param), index=0
+  %x = f32[8,8] get-tuple-element(%param), index=1
+  %acc = f32[2,8] get-tuple-element(%param), index=2
+  %grad = f32[8,8] multiply(%x, %x)
+  %reduce-scatter = f32[2,8] reduce-scatter(%grad), channel_id=1, replica_groups={{0,1,2,3}}, dimensions={0}, use_global_device_ids=true, to_apply=%sum
+  %new_acc = f32[2,8] add(%acc, %reduce-scatter)
+  %one = s32[] constant(1)
+  %next_i = s32[] add(%i, %one)
+  ROOT %tuple = (s32[], f32[8,8], f32[2,8]) tuple(%next_i, %x, %new_acc)
+}
+
+ENTRY %main {
+  %x = f32[8,8] parameter(0)
+  %zero = s32[] constant(0)
+  %zero_f = f32[] constant(0)
+  %acc = f32[2,8] broadcast(%zero_f), dimensions={}
+  %init = (s32[], f32[8,8], f32[2,8]) tuple(%zero, %x, %acc)
+  %while = (s32[], f32[8,8], f32[2,8]) while(%init), condition=%condition, body=%body
+  ROOT %result = f32[2,8] get-tuple-element(%while), index=2
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseSpmdModule(kHlo));
+  TF_ASSERT_OK_AND_ASSIGN(
+      bool changed,
+      CollectivePipeliner(/*pipeline_all_gathers=*/false,
+                          /*pipeline_reduce_scatters=*/true)
+          .Run(module.get()));
+  ASSERT_TRUE(changed);
+  TF_ASSERT_OK(HloVerifier(/*layout_sensitive=*/false,
+                           /*allow_mixed_precision=*/true)
+                   .Run(module.get())
+                   .status());
+
+  // The loop carries the unreduced gradient of the previous iteration,
+  // starting from zeros.
+  const HloInstruction* while_instr = FindWhile(*module);
+  ASSERT_NE(while_instr, nullptr);
+  ASSERT_EQ(while_instr->shape().tuple_shapes_size(), 4);
+  EXPECT_THAT(while_instr->operand(0)->operand(3), op::Broadcast());
+  const HloInstruction* root = while_instr->while_body()->root_instruction();
+  EXPECT_THAT(root->operand(2),
+              op::Add(op::GetTupleElement(op::Parameter(0), 2),
+                      op::ReduceScatter(
+                          op::GetTupleElement(op::Parameter(0), 3))));
+  EXPECT_THAT(root->operand(3), op::Multiply());
+
+  // The gradient of the last iteration is reduced after the loop.
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              op::Add(op::GetTupleElement(op::While(), 2),
+                      op::ReduceScatter(op::GetTupleElement(op::While(), 3))));
+}
+
+}  // namespace
+}  // namespace xla
@@ -15,12 +15,20 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/compilation_stats.h"
 
+#include <cstdio>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/tsl/platform/env.h"
 
@@ -32,11 +40,13 @@ class NoopStats : public CompilationStats {
 
   void StartPass(absl::string_view pass_name) override {}
 
-  void EndPass(absl::string_view pass_name) override {}
+  void EndPass(absl::string_view pass_name, bool module_changed) override {}
 
   void CompilationReport() override {}
 
   int GetPassesSize() override { return 0; }
+
+  std::string ToJson() override { return "[]"; }
 };
 
 class Stats : public CompilationStats {
@@ -45,12 +55,14 @@ class Stats : public CompilationStats {
 
   void StartPass(absl::string_view pass_name) override;
 
-  void EndPass(absl::string_view pass_name) override;
+  void EndPass(absl::string_view pass_name, bool module_changed) override;
 
   void CompilationReport() override;
 
   int GetPassesSize() override;
 
+  std::string ToJson() override;
+
  private:
   struct PassInfo {
     PassInfo(absl::string_view name, double duration)
@@ -59,6 +71,9 @@ class Stats : public CompilationStats {
     std::string name;
     int num_runs = 1;
     double duration_ms;
+    // Added by Alpa
+    int64_t memory_delta_bytes = 0;
+    int num_changed = 0;
   };
 
   // Info about the passes that have been run so far.
@@ -68,8 +83,50 @@ class Stats : public CompilationStats {
   std::string current_pass_;
   // The start time of the currently running pass.
   uint64_t start_micros_;
+  // Added by Alpa. The resident memory at the start of the running pass.
+  int64_t start_memory_bytes_;
 };
 
+namespace {
+
+// Returns the resident memory of the process, or 0 if it is unknown.
+int64_t ResidentMemoryBytes() {
+#if defined(__linux__)
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (file == nullptr) {
+    return 0;
+  }
+  long size_pages = 0;      // NOLINT
+  long resident_pages = 0;  // NOLINT
+  int num_read = fscanf(file, "%ld %ld", &size_pages, &resident_pages);
+  fclose(file);
+  if (num_read != 2) {
+    return 0;
+  }
+  return static_cast<int64_t>(resident_pages) * sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+thread_local CompilationStats* current_compilation_stats = nullptr;
+
+}  // namespace
+
+ScopedCompilationStats::ScopedCompilationStats(CompilationStats* stats)
+    : previous_(current_compilation_stats) {
+  current_compilation_stats = stats;
+}
+
+ScopedCompilationStats::~ScopedCompilationStats() {
+  current_compilation_stats = previous_;
+}
+
+/* static */
+CompilationStats* ScopedCompilationStats::Current() {
+  return current_compilation_stats;
+}
+
 /* static */
 std::unique_ptr<CompilationStats> CompilationStats::MakeNoopStats() {
   return std::make_unique<NoopStats>();
@@ -86,15 +143,19 @@ void Stats::StartPass(absl::string_view pass_name) {
   pass_running_ = true;
   current_pass_ = std::string(pass_name);
   start_micros_ = tsl::Env::Default()->NowMicros();
+  start_memory_bytes_ = ResidentMemoryBytes();
 }
 
-void Stats::EndPass(absl::string_view pass_name) {
+void Stats::EndPass(absl::string_view pass_name, bool module_changed) {
   CHECK(pass_running_);
   CHECK_EQ(current_pass_, std::string(pass_name));
   pass_running_ = false;
   uint64_t end_micros = tsl::Env::Default()->NowMicros();
   double duration_ms = (end_micros - start_micros_) / 1000.0;
   passes_.push_back(PassInfo(current_pass_, duration_ms));
+  passes_.back().memory_delta_bytes =
+      ResidentMemoryBytes() - start_memory_bytes_;
+  passes_.back().num_changed = module_changed ? 1 : 0;
 }
 
 void Stats::CompilationReport() {
@@ -111,6 +172,8 @@ void Stats::CompilationReport() {
     } else {
       ++summary.at(pass_name).num_runs;
       summary.at(pass_name).duration_ms += pass_run.duration_ms;
+      summary.at(pass_name).memory_delta_bytes += pass_run.memory_delta_bytes;
+      summary.at(pass_name).num_changed += pass_run.num_changed;
     }
   }
 
@@ -125,13 +188,29 @@ void Stats::CompilationReport() {
            std::make_pair(a.duration_ms, b.name);
   });
   LOG(INFO) << "Total runtime (ms) of HLO passes: " << total_duration;
-  LOG(INFO) << "Pass name, num runs, time (ms)";
+  LOG(INFO) << "Pass name, num runs, time (ms), num changed, "
+               "memory delta (bytes)";
   for (auto& pass_info : sorted_summary) {
     LOG(INFO) << pass_info.name << ", " << pass_info.num_runs << ", "
-              << pass_info.duration_ms;
+              << pass_info.duration_ms << ", " << pass_info.num_changed
+              << ", " << pass_info.memory_delta_bytes;
   }
 }
 
 int Stats::GetPassesSize() { return passes_.size(); }
 
+std::string Stats::ToJson() {
+  std::vector<std::string> runs;
+  runs.reserve(passes_.size());
+  for (const PassInfo& pass_run : passes_) {
+    // Pass names are identifiers, so they need no escaping.
+    runs.push_back(absl::StrFormat(
+        "{\"pass\": \"%s\", \"duration_ms\": %.3f, "
+        "\"memory_delta_bytes\": %d, \"changed\": %s}",
+        pass_run.name, pass_run.duration_ms, pass_run.memory_delta_bytes,
+        pass_run.num_changed > 0 ? "true" : "false"));
+  }
+  return absl::StrCat("[", absl::StrJoin(runs, ", "), "]");
+}
+
 }  // namespace xla
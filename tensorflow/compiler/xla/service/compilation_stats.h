@@ -38,11 +38,36 @@ class CompilationStats {
 
   virtual void StartPass(absl::string_view pass_name) = 0;
 
-  virtual void EndPass(absl::string_view pass_name) = 0;
+  // Added by Alpa. `module_changed` is the result of the pass.
+  virtual void EndPass(absl::string_view pass_name, bool module_changed) = 0;
 
   virtual void CompilationReport() = 0;
 
   virtual int GetPassesSize() = 0;
+
+  // Added by Alpa. Returns every run of a pass recorded so far as a JSON
+  // array of {"pass", "duration_ms", "memory_delta_bytes", "changed"}
+  // objects, in the order they ran. The memory delta is the change of the
+  // resident memory of the process during the pass.
+  virtual std::string ToJson() = 0;
+};
+
+// Added by Alpa. While alive, makes `stats` collect the passes of the
+// pipelines run on this thread that were not given their own
+// CompilationStats, e.g. to profile a whole compilation.
+class ScopedCompilationStats {
+ public:
+  explicit ScopedCompilationStats(CompilationStats* stats);
+  ~ScopedCompilationStats();
+
+  ScopedCompilationStats(const ScopedCompilationStats&) = delete;
+  ScopedCompilationStats& operator=(const ScopedCompilationStats&) = delete;
+
+  // Returns the innermost stats installed on this thread, or null.
+  static CompilationStats* Current();
+
+ private:
+  CompilationStats* previous_;
 };
 
 }  // namespace xla
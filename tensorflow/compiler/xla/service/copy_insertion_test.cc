@@ -3384,5 +3384,33 @@ ROOT %arg_tuple.1 = (f32[]{:T(256)}, f32[]{:T(256)}) parameter(0), parameter_rep
   VLOG(2) << module->ToString();
 }
 
+TEST_F(CopyInsertionTest, DonatedParameterThroughPipelineMarker) {
+  // The donated weight flows through the marker to the update that reuses its
+  // buffer. Forwarding the value through the marker needs no copies, while
+  // treating the marker as an in-place update would copy the weight because
+  // it is read again after the marker.
+  const char* const kModuleString = R"(
+HloModule stage, input_output_alias={ {0}: (0, {}, may-alias) }
+
+ENTRY main {
+  w = f32[1024] parameter(0)
+  g = f32[1024] parameter(1)
+  start = (f32[1024], f32[1024]) tuple(w, g)
+  marker = (f32[1024], f32[1024]) custom-call(start), custom_call_target="pipeline_marker", output_to_operand_aliasing={{0}: (0, {0}), {1}: (0, {1})}
+  w_in = f32[1024] get-tuple-element(marker), index=0
+  g_in = f32[1024] get-tuple-element(marker), index=1
+  norm = f32[1024] multiply(w, w)
+  scaled = f32[1024] multiply(g_in, norm)
+  new_w = f32[1024] subtract(w_in, scaled)
+  ROOT out = (f32[1024], f32[1024]) tuple(new_w, norm)
+}
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kModuleString));
+  InsertCopies(module.get());
+  EXPECT_EQ(CountCopies(*module), 0);
+}
+
 }  // namespace
 }  // namespace xla
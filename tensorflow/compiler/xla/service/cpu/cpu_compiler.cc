@@ -441,6 +441,30 @@ class CollectProfileCandidates : public DfsHloVisitorWithDefault {
   const absl::flat_hash_map<const HloInstruction*, int64_t>& assigned_indices_;
 };
 
+// Added by Alpa. Keeps the BF16 operands of the dots that are emitted as calls
+// to the bf16 MKL GEMM, and converts all other BF16 operations to F32.
+class CpuBfloat16Support : public BFloat16Support {
+ public:
+  explicit CpuBfloat16Support(
+      const TargetMachineFeatures* target_machine_features)
+      : target_machine_features_(target_machine_features) {}
+
+  bool SupportsBF16Operand(const HloInstruction& hlo,
+                           int64_t operand_index) const override {
+    return BFloat16Support::SupportsBF16Operand(hlo, operand_index) ||
+           (operand_index < 2 &&
+            CanEmitBF16Gemm(hlo, *target_machine_features_));
+  }
+
+  bool SupportsMixedPrecisions(const HloInstruction& hlo) const override {
+    return BFloat16Support::SupportsMixedPrecisions(hlo) ||
+           CanEmitBF16Gemm(hlo, *target_machine_features_);
+  }
+
+ private:
+  const TargetMachineFeatures* target_machine_features_;
+};
+
 // Adds the HloVerifier for CPU to the given pipeline.
 void AddHloVerifier(HloPassPipeline* pipeline, HloVerifierOpts&& opts = {},
                     bool debug_only = false) {
@@ -519,7 +543,8 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
   // Convert BF16 operations to F32 operations so that the CPU backend can
   // support BF16 operations without directly implementing a BF16 lowering for
   // most ops.
-  BFloat16Support bf16;
+  // Added by Alpa: large bf16 GEMMs keep their BF16 operands.
+  CpuBfloat16Support bf16(target_machine_features);
   pipeline.AddPass<BFloat16Normalization>(&bf16);
   // After canonicalization, there may be more batch dots that can be
   // simplified.
@@ -892,6 +917,19 @@ StatusOr<std::unique_ptr<BufferAssignment>> CpuCompiler::AssignBuffers(
 
 namespace {
 
+// Added by Alpa. Describes the object files compiled for `target_machine`.
+CpuExecutable::JitObjectFiles MakeJitObjectFiles(
+    const llvm::TargetMachine& target_machine,
+    std::vector<std::string> obj_files) {
+  CpuExecutable::JitObjectFiles jit_object_files;
+  jit_object_files.obj_files = std::move(obj_files);
+  jit_object_files.target_triple = target_machine.getTargetTriple().str();
+  jit_object_files.target_cpu = target_machine.getTargetCPU().str();
+  jit_object_files.target_features =
+      target_machine.getTargetFeatureString().str();
+  return jit_object_files;
+}
+
 // Post-compilation callback functor for use by SimpleOrcJIT.
 //
 // Dumps machine code if dumping is enabled for the module.
@@ -1206,6 +1244,9 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
   auto llvm_module =
       std::make_unique<llvm::Module>("__compute_module", *llvm_context);
 
+  // Added by Alpa: keep the object files of the JIT, so that Export() can
+  // serialize them.
+  auto obj_files = std::make_shared<std::vector<std::string>>();
   auto jit = SimpleOrcJIT::Create(
       CompilerTargetOptions(module->config()),
       CodeGenOptLevel(module->config()),
@@ -1213,7 +1254,12 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
       module->config().debug_options().xla_llvm_disable_expensive_passes(),
       llvm_ir::GetCpuFastMathFlags(module->config()), pre_optimization_ir_hook,
       post_optimization_ir_hook,
-      OrcJITPostCompilationHook::Create(module.get()));
+      [obj_files, dump_hook = OrcJITPostCompilationHook::Create(module.get())](
+          const llvm::object::ObjectFile& obj_file) {
+        dump_hook(obj_file);
+        obj_files->emplace_back(obj_file.getData().data(),
+                                obj_file.getData().size());
+      });
   if (!jit) {
     return InternalError("Creating JIT failed: %s",
                          llvm::toString(jit.takeError()));
@@ -1345,10 +1391,13 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
   llvm::orc::ThreadSafeModule thread_safe_module(std::move(llvm_module),
                                                  std::move(llvm_context));
   cantFail((*jit)->AddModule(std::move(thread_safe_module)));
+  const llvm::TargetMachine* target_machine = (*jit)->target_machine();
 
   auto cpu_executable = std::make_unique<CpuExecutable>(
       std::move(*jit), std::move(assignment), std::move(module), function_name,
       std::move(hlo_profile_printer_data), std::move(hlo_profile_index_map));
+  cpu_executable->set_jit_object_files(
+      MakeJitObjectFiles(*target_machine, std::move(*obj_files)));
 
   if (embed_ir_in_executable) {
     cpu_executable->set_ir_module_string(ir_module_string);
@@ -1786,6 +1835,35 @@ StatusOr<std::unique_ptr<AotCompilationResult>> CpuCompiler::Export(
   if (!cpu_executable)
     return Internal("Could not downcast Executable to CpuExecutable");
 
+  // Added by Alpa.
+  if (!cpu_executable->IsXlaRuntime()) {
+    const CpuExecutable::JitObjectFiles& jit_object_files =
+        cpu_executable->jit_object_files();
+    if (jit_object_files.obj_files.empty()) {
+      return FailedPrecondition("CpuExecutable %s has no object files",
+                                cpu_executable->module().name());
+    }
+    const HloModule& module = cpu_executable->module();
+    CpuJitExecutableProto proto;
+    *proto.mutable_hlo_module() = module.ToProto();
+    *proto.mutable_debug_options() = module.config().debug_options();
+    proto.set_replica_count(module.config().replica_count());
+    proto.set_num_partitions(module.config().num_partitions());
+    for (const std::string& obj_file : jit_object_files.obj_files) {
+      proto.add_obj_files(obj_file);
+    }
+    proto.set_entry_function_name(cpu_executable->entry_function_name());
+    for (const BufferAllocation& allocation :
+         cpu_executable->buffer_assignment().Allocations()) {
+      *proto.add_buffer_allocations() = allocation.ToProto();
+    }
+    proto.set_target_triple(jit_object_files.target_triple);
+    proto.set_target_cpu(jit_object_files.target_cpu);
+    proto.set_target_features(jit_object_files.target_features);
+    return std::unique_ptr<AotCompilationResult>(
+        std::make_unique<CpuJitAotCompilationResult>(std::move(proto)));
+  }
+
   HloModuleProto module_proto = cpu_executable->module().ToProto();
   TF_ASSIGN_OR_RETURN(std::string obj_file, cpu_executable->GetObjFile());
   TF_ASSIGN_OR_RETURN(std::string mlir_module, cpu_executable->GetMlirModule());
@@ -1799,6 +1877,149 @@ StatusOr<std::unique_ptr<AotCompilationResult>> CpuCompiler::Export(
   return result;
 }
 
+StatusOr<std::unique_ptr<AotCompilationResult>>
+CpuCompiler::LoadAotCompilationResult(
+    const std::string& serialized_aot_result) {
+  XlaRuntimeCpuExecutableProto proto;
+  if (!proto.ParseFromString(serialized_aot_result)) {
+    return InvalidArgument("Failed to parse serialized CPU executable.");
+  }
+  if (proto.has_jit_executable()) {
+    return std::unique_ptr<AotCompilationResult>(
+        std::make_unique<CpuJitAotCompilationResult>(
+            std::move(*proto.mutable_jit_executable())));
+  }
+  return std::unique_ptr<AotCompilationResult>(
+      std::make_unique<CpuXlaRuntimeAotCompilationResult>(std::move(proto)));
+}
+
+namespace {
+
+// Returns whether `assignment` has the buffer allocations that the machine
+// code of `proto` was emitted for.
+bool HasSameAllocations(const BufferAssignment& assignment,
+                        const CpuJitExecutableProto& proto) {
+  const std::vector<BufferAllocation>& allocations = assignment.Allocations();
+  if (allocations.size() != proto.buffer_allocations_size()) {
+    return false;
+  }
+  for (int64_t i = 0; i < allocations.size(); ++i) {
+    if (allocations[i].ToProto().SerializeAsString() !=
+        proto.buffer_allocations(i).SerializeAsString()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<Executable>> CpuCompiler::LoadJitExecutable(
+    const CpuJitExecutableProto& proto) {
+  TF_ASSIGN_OR_RETURN(HloModuleConfig config,
+                      HloModule::CreateModuleConfigFromProto(
+                          proto.hlo_module(), proto.debug_options()));
+  config.set_replica_count(proto.replica_count());
+  config.set_num_partitions(proto.num_partitions());
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<HloModule> module,
+                      HloModule::CreateFromProto(proto.hlo_module(), config));
+  XLA_SCOPED_LOGGING_TIMER(
+      absl::StrFormat("Loading [%s] for CPU", module->name()));
+
+  absl::call_once(llvm_command_line_options_initialized,
+                  &InitializeLLVMCommandLineOptions, module->config());
+  auto jit = SimpleOrcJIT::Create(
+      CompilerTargetOptions(module->config()),
+      CodeGenOptLevel(module->config()),
+      options::OptimizeForSizeRequested(module->config()),
+      module->config().debug_options().xla_llvm_disable_expensive_passes(),
+      llvm_ir::GetCpuFastMathFlags(module->config()),
+      /*pre_optimization_hook=*/nullptr, /*post_optimization_hook=*/nullptr,
+      /*post_codegen_hook=*/nullptr);
+  if (!jit) {
+    return InternalError("Creating JIT failed: %s",
+                         llvm::toString(jit.takeError()));
+  }
+
+  // The object files can only be linked if they were compiled for the target
+  // of this host, and for the same buffer assignment that the executable uses
+  // to lay out its buffer table.
+  const llvm::TargetMachine* target_machine = (*jit)->target_machine();
+  CpuExecutable::JitObjectFiles jit_object_files =
+      MakeJitObjectFiles(*target_machine,
+                         std::vector<std::string>(proto.obj_files().begin(),
+                                                  proto.obj_files().end()));
+  std::unique_ptr<BufferAssignment> assignment;
+  if (jit_object_files.target_triple == proto.target_triple() &&
+      jit_object_files.target_cpu == proto.target_cpu() &&
+      jit_object_files.target_features == proto.target_features()) {
+    TF_ASSIGN_OR_RETURN(assignment, AssignBuffers(module.get()));
+    if (!HasSameAllocations(*assignment, proto)) {
+      LOG(WARNING) << "The buffer assignment of " << module->name()
+                   << " changed, compiling it again.";
+      assignment.reset();
+    }
+  } else {
+    LOG(WARNING) << module->name() << " was compiled for "
+                 << proto.target_cpu() << " (" << proto.target_features()
+                 << "), not for " << jit_object_files.target_cpu << " ("
+                 << jit_object_files.target_features
+                 << "), compiling it again.";
+  }
+  if (!assignment) {
+    return RunBackend(std::move(module), /*stream_exec=*/nullptr,
+                      CompileOptions{});
+  }
+
+  for (const std::string& obj_file : jit_object_files.obj_files) {
+    if (llvm::Error error = (*jit)->AddObjFile(
+            llvm::MemoryBuffer::getMemBufferCopy(obj_file, module->name()))) {
+      return InternalError("Linking object file failed: %s",
+                           llvm::toString(std::move(error)));
+    }
+  }
+
+  std::unique_ptr<HloProfileIndexMap> hlo_profile_index_map;
+  std::unique_ptr<HloProfilePrinterData> hlo_profile_printer_data;
+  if (module->config().hlo_profiling_enabled()) {
+    absl::flat_hash_map<const HloInstruction*, int64_t>
+        instruction_to_profile_idx;
+    absl::flat_hash_map<const HloComputation*, int64_t>
+        computation_to_profile_idx;
+    TF_RETURN_IF_ERROR(CreateHloProfilingArtifacts(
+        *module, &instruction_to_profile_idx, &computation_to_profile_idx,
+        &hlo_profile_index_map, &hlo_profile_printer_data));
+  }
+
+  auto cpu_executable = std::make_unique<CpuExecutable>(
+      std::move(*jit), std::move(assignment), std::move(module),
+      proto.entry_function_name(), std::move(hlo_profile_printer_data),
+      std::move(hlo_profile_index_map));
+  cpu_executable->set_jit_object_files(std::move(jit_object_files));
+
+  auto hlo_proto = std::make_unique<HloProto>();
+  *hlo_proto->mutable_hlo_module() = cpu_executable->module().ToProto();
+  *hlo_proto->mutable_buffer_assignment() =
+      cpu_executable->buffer_assignment().ToProto();
+  cpu_executable->set_hlo_proto(std::move(hlo_proto));
+  cpu_executable->set_debug_info(
+      cpu_executable->buffer_assignment().GetStats().ToString());
+  return std::unique_ptr<Executable>(std::move(cpu_executable));
+}
+
+StatusOr<std::string> CpuJitAotCompilationResult::SerializeAsString() const {
+  XlaRuntimeCpuExecutableProto proto;
+  *proto.mutable_jit_executable() = executable_;
+  return proto.SerializeAsString();
+}
+
+StatusOr<std::unique_ptr<Executable>>
+CpuJitAotCompilationResult::LoadExecutable(
+    Compiler* compiler, se::StreamExecutor* executor) const {
+  return tensorflow::down_cast<CpuCompiler*>(compiler)->LoadJitExecutable(
+      executable_);
+}
+
 }  // namespace cpu
 }  // namespace xla
 
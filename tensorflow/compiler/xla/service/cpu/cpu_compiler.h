@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_COMPILER_H_
 
 #include <memory>
+#include <utility>
 
 #include "absl/types/span.h"
 #include "llvm/Target/TargetMachine.h"
@@ -120,6 +121,24 @@ class CpuXlaRuntimeAotCompilationResult : public AotCompilationResult {
   XlaRuntimeCpuExecutableProto xla_runtime_cpu_executable_;
 };
 
+// Added by Alpa. An executable compiled by SimpleOrcJIT, with the object files
+// of its machine code. Loading it links the object files into a new JIT
+// without running LLVM if the host has the target they were compiled for, and
+// compiles the optimized HLO module again otherwise.
+class CpuJitAotCompilationResult : public AotCompilationResult {
+ public:
+  explicit CpuJitAotCompilationResult(CpuJitExecutableProto executable)
+      : executable_(std::move(executable)) {}
+
+  StatusOr<std::string> SerializeAsString() const override;
+
+  StatusOr<std::unique_ptr<Executable>> LoadExecutable(
+      Compiler* compiler, se::StreamExecutor* executor) const override;
+
+ private:
+  CpuJitExecutableProto executable_;
+};
+
 class CpuAotCompilationResult : public AotCompilationResult {
  public:
   CpuAotCompilationResult(
@@ -194,6 +213,15 @@ class CpuCompiler : public LLVMCompiler {
   StatusOr<std::unique_ptr<AotCompilationResult>> Export(
       Executable* executable) const override;
 
+  // Added by Alpa. Parses the result of Export().
+  StatusOr<std::unique_ptr<AotCompilationResult>> LoadAotCompilationResult(
+      const std::string& serialized_aot_result) override;
+
+  // Added by Alpa. Links the object files of `proto` into a new JIT, or
+  // compiles its HLO module if they were compiled for another target.
+  StatusOr<std::unique_ptr<Executable>> LoadJitExecutable(
+      const CpuJitExecutableProto& proto);
+
  private:
   // Initialize the LLVM target.
   static void InitializeLLVMTarget();
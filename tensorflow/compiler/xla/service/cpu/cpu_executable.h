@@ -204,6 +204,23 @@ class CpuExecutable : public Executable {
     return xla_runtime_executable_->xla_framework_mapping();
   }
 
+  // Added by Alpa. The object files linked by the JIT of an executable that is
+  // not an XLA Runtime one, which CpuCompiler::Export serializes.
+  struct JitObjectFiles {
+    std::vector<std::string> obj_files;
+    // The target the object files were compiled for.
+    std::string target_triple;
+    std::string target_cpu;
+    std::string target_features;
+  };
+  const JitObjectFiles& jit_object_files() const { return jit_object_files_; }
+  void set_jit_object_files(JitObjectFiles jit_object_files) {
+    jit_object_files_ = std::move(jit_object_files);
+  }
+  const std::string& entry_function_name() const {
+    return entry_function_name_;
+  }
+
  private:
   // Creates an array suitable for passing as the "buffer_table" argument to the
   // JIT compiled function pointer.
@@ -264,6 +281,9 @@ class CpuExecutable : public Executable {
   // If not null, XLA Runtime is enabled.
   std::unique_ptr<XlaRuntimeCpuExecutable> xla_runtime_executable_;
 
+  // Added by Alpa.
+  JitObjectFiles jit_object_files_;
+
   CpuExecutable(const CpuExecutable&) = delete;
   CpuExecutable& operator=(const CpuExecutable&) = delete;
 };
@@ -102,6 +102,11 @@ extern const char* const kMKLSingleThreadedMatMulF32SymbolName =
     "__xla_cpu_runtime_MKLSingleThreadedMatMulF32";
 extern const char* const kMKLSingleThreadedMatMulF64SymbolName =
     "__xla_cpu_runtime_MKLSingleThreadedMatMulF64";
+// Added by Alpa
+extern const char* const kMKLMatMulBF16F32SymbolName =
+    "__xla_cpu_runtime_MKLMatMulBF16F32";
+extern const char* const kMKLSingleThreadedMatMulBF16F32SymbolName =
+    "__xla_cpu_runtime_MKLSingleThreadedMatMulBF16F32";
 extern const char* const kEigenConv2DF16SymbolName =
     "__xla_cpu_runtime_EigenConv2DF16";
 extern const char* const kEigenConv2DF32SymbolName =
@@ -58,6 +58,9 @@ extern const char* const kACLMatMulF32SymbolName;
 extern const char* const kACLBatchMatMulF32SymbolName;
 extern const char* const kMKLSingleThreadedMatMulF32SymbolName;
 extern const char* const kMKLSingleThreadedMatMulF64SymbolName;
+// Added by Alpa
+extern const char* const kMKLMatMulBF16F32SymbolName;
+extern const char* const kMKLSingleThreadedMatMulBF16F32SymbolName;
 extern const char* const kEigenConv2DF16SymbolName;
 extern const char* const kEigenConv2DF32SymbolName;
 extern const char* const kEigenConv3DF16SymbolName;
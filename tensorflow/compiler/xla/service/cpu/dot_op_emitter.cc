@@ -857,14 +857,28 @@ Status DotOpEmitter::EmitCallToRuntime() {
       return Unimplemented("Invalid type %s for dot operation",
                            PrimitiveType_Name(type));
   }
+  // Added by Alpa. The operands have the type of the result, except for the
+  // bf16 GEMMs of CanEmitBF16Gemm.
+  llvm::Type* operand_type = float_type;
+  if (lhs_array_.GetShape().element_type() == BF16) {
+    if (type != F32 || !use_mkl_dnn) {
+      return Unimplemented("bf16 dot with %s result requires MKL",
+                           PrimitiveType_Name(type));
+    }
+    fn_name = multi_threaded
+                  ? runtime::kMKLMatMulBF16F32SymbolName
+                  : runtime::kMKLSingleThreadedMatMulBF16F32SymbolName;
+    operand_type = b_->getInt16Ty();
+  }
 
   llvm::Type* float_ptr_type = float_type->getPointerTo();
+  llvm::Type* operand_ptr_type = operand_type->getPointerTo();
   llvm::Type* int64_type = b_->getInt64Ty();
   llvm::Type* int32_type = b_->getInt32Ty();
   llvm::Type* int8_ptr_type = b_->getInt8Ty()->getPointerTo();
   llvm::FunctionType* matmul_type = llvm::FunctionType::get(
       b_->getVoidTy(),
-      {int8_ptr_type, float_ptr_type, float_ptr_type, float_ptr_type,
+      {int8_ptr_type, float_ptr_type, operand_ptr_type, operand_ptr_type,
        int64_type, int64_type, int64_type, int32_type, int32_type},
       /*isVarArg=*/false);
 
@@ -906,8 +920,8 @@ Status DotOpEmitter::EmitCallToRuntime() {
       matmul_func,
       {b_->CreateBitCast(executable_run_options_value_, int8_ptr_type),
        b_->CreateBitCast(target_array_.GetBasePointer(), float_ptr_type),
-       b_->CreateBitCast(lhs->GetBasePointer(), float_ptr_type),
-       b_->CreateBitCast(rhs->GetBasePointer(), float_ptr_type),
+       b_->CreateBitCast(lhs->GetBasePointer(), operand_ptr_type),
+       b_->CreateBitCast(rhs->GetBasePointer(), operand_ptr_type),
        b_->getInt64(mat_mult_dims.m), b_->getInt64(mat_mult_dims.n),
        b_->getInt64(mat_mult_dims.k), b_->getInt32(transpose_lhs),
        b_->getInt32(transpose_rhs)});
@@ -1499,6 +1513,31 @@ bool DotOperandsAndResultMustHaveRowMajorLayout(
          impl_strategy == DotImplementationStrategy::kEigen;
 }
 
+bool CanEmitBF16Gemm(const HloInstruction& dot,
+                     const TargetMachineFeatures& target_machine_features) {
+  const HloModuleConfig& config = dot.GetModule()->config();
+  if (dot.opcode() != HloOpcode::kDot ||
+      !config.debug_options().xla_cpu_use_mkl_dnn() ||
+      !target_machine_features.has_bf16_dot_instructions() ||
+      options::ForceEnableExperimentalLlvmIrGemm(config)) {
+    return false;
+  }
+  const Shape& lhs_shape = dot.operand(0)->shape();
+  const Shape& rhs_shape = dot.operand(1)->shape();
+  const DotDimensionNumbers& dnums = dot.dot_dimension_numbers();
+  if (!IsRank2(lhs_shape) || !IsRank2(rhs_shape) || !IsRank2(dot.shape()) ||
+      dnums.lhs_batch_dimensions_size() != 0 ||
+      dnums.lhs_contracting_dimensions_size() != 1) {
+    return false;
+  }
+  // Large enough dots always take the runtime GEMM path, never the tiled or
+  // naive LLVM IR emitters, which do not support mixed precision.
+  int64_t k = lhs_shape.dimensions(dnums.lhs_contracting_dimensions(0));
+  return dot.shape().dimensions(0) >= kMinBF16GemmDimension &&
+         dot.shape().dimensions(1) >= kMinBF16GemmDimension &&
+         k >= kMinBF16GemmDimension;
+}
+
 Status EmitDotOperation(const HloInstruction& dot,
                         const llvm_ir::IrArray& target_array,
                         const llvm_ir::IrArray& lhs_array,
@@ -42,6 +42,14 @@ bool DotImplementationCanHandleTranspose(
     const HloInstruction& dot_instr,
     const TargetMachineFeatures& target_machine_features);
 
+// Added by Alpa. Returns true if `dot` can take bf16 operands with an f32
+// result, which is emitted as a call to the bf16 MKL GEMM. This requires MKL
+// (xla_cpu_use_mkl_dnn), a CPU with bf16 dot instructions, and a matrix-matrix
+// product whose dimensions are all at least kMinBF16GemmDimension.
+bool CanEmitBF16Gemm(const HloInstruction& dot,
+                     const TargetMachineFeatures& target_machine_features);
+inline constexpr int64_t kMinBF16GemmDimension = 128;
+
 // Returns the index for an operand to `hlo` that should ideally be column
 // major.  Returns nullopt if there is no such operand or if `hlo` is not a dot
 // or a fusion containing a dot.
@@ -81,7 +81,14 @@ class DefaultCostModel : public ParallelCostModel {
       max_parallelism = std::min<int64_t>(
           max_parallelism_, std::ceil(std::sqrt(tsl::port::MaxParallelism())));
       // Use shape size instruction cost and L2 cache size min per-thread cost.
-      instruction_cost = shape_size_(instruction->shape());
+      // Added by Alpa: reductions and fusions can read much more than they
+      // write, so use the bytes they access instead.
+      const HloOpcode opcode = instruction->opcode();
+      instruction_cost = opcode == HloOpcode::kReduce ||
+                                 opcode == HloOpcode::kReduceWindow ||
+                                 opcode == HloOpcode::kFusion
+                             ? bytes_accessed
+                             : shape_size_(instruction->shape());
       min_cost_per_thread = 256LL << 10;  // 256KB L2 Cache size.
     } else {
       // Use max parallelism for compute bound instructions.
@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/test.h"
 #include "tensorflow/compiler/xla/tests/hlo_test_base.h"
 #include "tensorflow/tsl/lib/core/status_test_util.h"
+#include "tensorflow/tsl/platform/cpu_info.h"
 
 namespace xla {
 namespace {
@@ -206,5 +207,31 @@ TEST_F(ParallelTaskAssignmentTest, ConstantNotParallelized) {
   EXPECT_FALSE(changed);
 }
 
+TEST_F(ParallelTaskAssignmentTest, ReduceWithSmallOutputParallelized) {
+  // The output is much smaller than the L2 cache, but the input is not.
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_reduce
+    add {
+      x = f32[] parameter(0)
+      y = f32[] parameter(1)
+      ROOT sum = f32[] add(x, y)
+    }
+
+    ENTRY reduce {
+      p = f32[4096,1024] parameter(0)
+      zero = f32[] constant(0)
+      ROOT r = f32[4096] reduce(p, zero), dimensions={1}, to_apply=add
+    }
+  )";
+  if (tsl::port::MaxParallelism() < 2) {
+    GTEST_SKIP() << "Needs at least two cores";
+  }
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+}
+
 }  // namespace
 }  // namespace xla
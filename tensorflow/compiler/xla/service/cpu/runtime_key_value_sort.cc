@@ -15,6 +15,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/cpu/runtime_key_value_sort.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <memory>
 #include <numeric>
@@ -22,29 +23,18 @@ limitations under the License.
 
 #include "absl/base/dynamic_annotations.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/compiler/xla/executable_run_options.h"
 
-ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
-    int64_t a, int64_t b, int64_t c, char** values, int32_t values_count,
-    int32_t* values_primitive_type_size_in_bytes, bool is_stable,
-    char* run_options, int64_t* prof_counters,
-    void (*less_than)(char*, char*, char**, char**, int64_t*)) {
-  // 'values' and 'values_primitive_type_size_in_bytes' are managed by the JIT
-  // code, so msan can't tell they are initialized.
-  ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(values, values_count * sizeof(char*));
-  ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(values_primitive_type_size_in_bytes,
-                                      values_count * sizeof(int32_t));
-
-  // High-level idea of the iteration/sorting logic:
-  // Conceptually we have a 3-dimensional shape [a, b, c]. b corresponds to the
-  // dimension to sort, c is the product of the more minor dimensions (set to 1
-  // if b is the most minor dimension), and a is the product of the more major
-  // dimensions (set to 1 if b is the most major dimension). There are a * c
-  // many rows that we need to sort. We iterate through these, calculate a
-  // 'base_offset' value which points to the first element in that row, and add
-  // i * c for accessing the 'i'-th element in that row.
+namespace {
 
+// Added by Alpa. Sorts the rows [begin, end) of the [a, b, c] shapes in
+// 'values', with the arguments of __xla_cpu_runtime_KeyValueSort.
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void SortRows(
+    int64_t begin, int64_t end, int64_t b, int64_t c, char** values,
+    int32_t values_count, int32_t* values_primitive_type_size_in_bytes,
+    bool is_stable, char* run_options, int64_t* prof_counters,
+    void (*less_than)(char*, char*, char**, char**, int64_t*)) {
   int64_t sort_dimension_elements = b;
-  int64_t num_iteration_elements = a * c;
   int64_t sort_dimension_offset = c;
 
   std::unique_ptr<int64_t[]> indices(new int64_t[sort_dimension_elements]);
@@ -52,10 +42,10 @@ ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
   std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
   std::unique_ptr<std::string[]> reordered_values(
       new std::string[sort_dimension_elements]);
-  for (int64_t index = 0; index < num_iteration_elements; ++index) {
+  for (int64_t index = begin; index < end; ++index) {
     // If the sort should be stable, we have to reinitialize indices to iota to
     // guarantee that we still keep the relative order in case of ties.
-    if (is_stable && index > 0) {
+    if (is_stable && index > begin) {
       std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
     }
     // 'index' can be split into two values which index into the 'c' dimension
@@ -109,3 +99,62 @@ ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
     }
   }
 }
+
+}  // namespace
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
+    int64_t a, int64_t b, int64_t c, char** values, int32_t values_count,
+    int32_t* values_primitive_type_size_in_bytes, bool is_stable,
+    char* run_options, int64_t* prof_counters,
+    void (*less_than)(char*, char*, char**, char**, int64_t*)) {
+  // 'values' and 'values_primitive_type_size_in_bytes' are managed by the JIT
+  // code, so msan can't tell they are initialized.
+  ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(values, values_count * sizeof(char*));
+  ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(values_primitive_type_size_in_bytes,
+                                      values_count * sizeof(int32_t));
+
+  // High-level idea of the iteration/sorting logic:
+  // Conceptually we have a 3-dimensional shape [a, b, c]. b corresponds to the
+  // dimension to sort, c is the product of the more minor dimensions (set to 1
+  // if b is the most minor dimension), and a is the product of the more major
+  // dimensions (set to 1 if b is the most major dimension). There are a * c
+  // many rows that we need to sort. We iterate through these, calculate a
+  // 'base_offset' value which points to the first element in that row, and add
+  // i * c for accessing the 'i'-th element in that row.
+  int64_t num_iteration_elements = a * c;
+
+  // Added by Alpa. The rows are independent, so they are sorted in parallel on
+  // the intra-op thread pool, which runs them inline if the cost model finds
+  // them too cheap to split. The comparator updates the profile counters, so
+  // profiled sorts stay sequential.
+  const Eigen::ThreadPoolDevice* thread_pool =
+      run_options == nullptr
+          ? nullptr
+          : reinterpret_cast<const xla::ExecutableRunOptions*>(run_options)
+                ->intra_op_thread_pool();
+  if (thread_pool == nullptr || prof_counters != nullptr ||
+      num_iteration_elements < 2) {
+    SortRows(0, num_iteration_elements, b, c, values, values_count,
+             values_primitive_type_size_in_bytes, is_stable, run_options,
+             prof_counters, less_than);
+    return;
+  }
+  int64_t row_bytes = 0;
+  for (int32_t i = 0; i < values_count; ++i) {
+    row_bytes += b * values_primitive_type_size_in_bytes[i];
+  }
+  // Each comparison calls less_than on every value, and each row is read and
+  // written once more to reorder it.
+  constexpr double kCyclesPerComparedValue = 10;
+  double comparisons = b * std::max(1.0, std::log2(static_cast<double>(b)));
+  Eigen::TensorOpCost row_cost(
+      /*bytes_loaded=*/row_bytes, /*bytes_stored=*/row_bytes,
+      /*compute_cycles=*/comparisons * values_count * kCyclesPerComparedValue);
+  thread_pool->parallelFor(num_iteration_elements, row_cost,
+                           [&](Eigen::Index first, Eigen::Index last) {
+                             SortRows(first, last, b, c, values, values_count,
+                                      values_primitive_type_size_in_bytes,
+                                      is_stable, run_options, prof_counters,
+                                      less_than);
+                           });
+}
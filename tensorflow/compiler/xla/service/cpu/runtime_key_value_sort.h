@@ -36,6 +36,9 @@ extern "C" {
 // - pointers to the parameter buffers (char**)
 // - pointers to the buffer tables = nullptr for thread local functions (char**)
 // - profile counters = 'prof_counters' (int64_t*)
+// Added by Alpa: without 'prof_counters', the rows are sorted in parallel on
+// the intra-op thread pool of 'run_options', so 'less_than' must be thread
+// safe.
 extern void __xla_cpu_runtime_KeyValueSort(
     int64_t a, int64_t b, int64_t c, char** values, int32_t values_count,
     int32_t* values_primitive_type_size_in_bytes, bool is_stable,
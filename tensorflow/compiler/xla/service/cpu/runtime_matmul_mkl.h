@@ -38,6 +38,18 @@ extern void __xla_cpu_runtime_MKLSingleThreadedMatMulF64(
     double* lhs, double* rhs, int64_t m, int64_t n, int64_t k,
     int32_t transpose_lhs, int32_t transpose_rhs);
 
+// Added by Alpa. bf16 x bf16 -> f32 GEMMs. 'lhs' and 'rhs' hold the bits of
+// bf16 values. MKL uses AMX or AVX-512 BF16 instructions when the CPU has
+// them.
+extern void __xla_cpu_runtime_MKLMatMulBF16F32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, float* out,
+    uint16_t* lhs, uint16_t* rhs, int64_t m, int64_t n, int64_t k,
+    int32_t transpose_lhs, int32_t transpose_rhs);
+extern void __xla_cpu_runtime_MKLSingleThreadedMatMulBF16F32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, float* out,
+    uint16_t* lhs, uint16_t* rhs, int64_t m, int64_t n, int64_t k,
+    int32_t transpose_lhs, int32_t transpose_rhs);
+
 #else
 extern void __xla_cpu_runtime_MKLMatMulF32(
     const void* /* xla::ExecutableRunOptions* */ run_options_ptr, float* out,
@@ -72,5 +84,23 @@ extern void __xla_cpu_runtime_MKLSingleThreadedMatMulF64(
   exit(1);
 }
 
+// Added by Alpa
+extern void __xla_cpu_runtime_MKLMatMulBF16F32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, float* out,
+    uint16_t* lhs, uint16_t* rhs, int64_t m, int64_t n, int64_t k,
+    int32_t transpose_lhs, int32_t transpose_rhs) {
+  std::cerr << "Attempt to call MKL MatMul runtime library without defining "
+               "ENABLE_MKL. Add --config=mkl to build with MKL.";
+  exit(1);
+}
+extern void __xla_cpu_runtime_MKLSingleThreadedMatMulBF16F32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, float* out,
+    uint16_t* lhs, uint16_t* rhs, int64_t m, int64_t n, int64_t k,
+    int32_t transpose_lhs, int32_t transpose_rhs) {
+  std::cerr << "Attempt to call MKL MatMul runtime library without defining "
+               "ENABLE_MKL. Add --config=mkl to build with MKL.";
+  exit(1);
+}
+
 #endif  // ENABLE_MKL
 #endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_MATMUL_MKL_H_
@@ -51,5 +51,10 @@ int64_t LLVMTargetMachineFeatures::minimum_alignment_for_allocation(
                            cpu_function_runtime::MinAlign());
 }
 
+bool LLVMTargetMachineFeatures::has_bf16_dot_instructions() const {
+  llvm::StringRef features = target_machine_->getTargetFeatureString();
+  return features.contains("+avx512bf16") || features.contains("+amx-bf16");
+}
+
 }  // namespace cpu
 }  // namespace xla
@@ -62,6 +62,10 @@ class TargetMachineFeatures {
   virtual int64_t minimum_alignment_for_allocation(
       int64_t size_bytes) const = 0;
 
+  // Added by Alpa. Returns whether the CPU has bf16 dot product instructions
+  // (AVX-512 BF16 or AMX BF16).
+  virtual bool has_bf16_dot_instructions() const { return false; }
+
   virtual ~TargetMachineFeatures() = default;
 };
 
@@ -101,6 +105,9 @@ class LLVMTargetMachineFeatures : public TargetMachineFeatures {
 
   int64_t minimum_alignment_for_allocation(int64_t size_bytes) const override;
 
+  // Added by Alpa
+  bool has_bf16_dot_instructions() const override;
+
  private:
   llvm::TargetTransformInfo* GetTargetTransformInfoFor(
       const llvm::Function& function) const;
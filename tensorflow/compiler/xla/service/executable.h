@@ -369,6 +369,17 @@ class Executable {
   // Return the total size of allocated buffers in bytes. This is GPU only.
   virtual int64_t TotalAllocationSize() const { return -1; }
 
+  // Added by Alpa. The sizes in bytes of the buffers of a run by kind, from
+  // the buffer assignment, or -1 if unknown. This is GPU only.
+  struct BufferSizes {
+    int64_t argument_size_in_bytes = -1;
+    int64_t output_size_in_bytes = -1;
+    // The part of the arguments that is reused for the outputs.
+    int64_t alias_size_in_bytes = -1;
+    int64_t temp_size_in_bytes = -1;
+  };
+  virtual BufferSizes GetBufferSizes() const { return BufferSizes(); }
+
   // Dumping helpers.
   void set_hlo_proto(std::unique_ptr<xla::HloProto> hlo_proto) {
     hlo_proto_ = std::move(hlo_proto);
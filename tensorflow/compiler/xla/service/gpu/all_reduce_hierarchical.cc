@@ -0,0 +1,336 @@
+#include "tensorflow/compiler/xla/service/gpu/all_reduce_hierarchical.h"
+
+#include <optional>
+#include <vector>
+
+#include "absl/container/btree_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/service/collective_ops_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_creation_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_instructions.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/service/hlo_query.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+struct HierarchicalGroups {
+  // The devices of a replica group on the same host.
+  std::vector<ReplicaGroup> intra_node_groups;
+  // The devices of a replica group with the same rank on their hosts.
+  std::vector<ReplicaGroup> inter_node_groups;
+};
+
+// Returns the flattened ids, i.e., replica_id * num_partitions + partition_id,
+// of the participants in the replica groups of the all-reduce, or nullopt for
+// the group modes whose ids do not identify one device.
+StatusOr<std::optional<std::vector<std::vector<int64_t>>>> GetFlattenedGroups(
+    const HloAllReduceInstruction& all_reduce) {
+  const HloModuleConfig& config = all_reduce.GetModule()->config();
+  TF_ASSIGN_OR_RETURN(
+      CollectiveOpGroupMode mode,
+      GetCollectiveOpGroupMode(all_reduce.channel_id().has_value(),
+                               all_reduce.use_global_device_ids()));
+  int64_t num_participants;
+  switch (mode) {
+    case CollectiveOpGroupMode::kCrossReplica:
+      if (config.num_partitions() != 1) {
+        return {std::nullopt};
+      }
+      num_participants = config.replica_count();
+      break;
+    case CollectiveOpGroupMode::kCrossPartition:
+      if (config.replica_count() != 1) {
+        return {std::nullopt};
+      }
+      num_participants = config.num_partitions();
+      break;
+    case CollectiveOpGroupMode::kFlattenedID:
+      num_participants = config.replica_count() * config.num_partitions();
+      break;
+    default:
+      return {std::nullopt};
+  }
+
+  std::vector<std::vector<int64_t>> groups;
+  if (all_reduce.replica_groups().empty()) {
+    groups.emplace_back();
+    for (int64_t id = 0; id < num_participants; ++id) {
+      groups.back().push_back(id);
+    }
+  }
+  for (const ReplicaGroup& group : all_reduce.replica_groups()) {
+    groups.emplace_back(group.replica_ids().begin(),
+                        group.replica_ids().end());
+  }
+  return {std::move(groups)};
+}
+
+StatusOr<std::optional<HierarchicalGroups>> TryDecomposeReplicaGroups(
+    const HloAllReduceInstruction& all_reduce,
+    absl::Span<const int64_t> host_ids) {
+  TF_ASSIGN_OR_RETURN(std::optional<std::vector<std::vector<int64_t>>> groups,
+                      GetFlattenedGroups(all_reduce));
+  if (!groups.has_value()) {
+    return {std::nullopt};
+  }
+
+  const HloModuleConfig& config = all_reduce.GetModule()->config();
+  auto get_host = [&](int64_t id) -> std::optional<int64_t> {
+    int64_t device_id = id;
+    if (config.has_static_device_assignment()) {
+      device_id = config.static_device_assignment()(
+          id / config.num_partitions(), id % config.num_partitions());
+    }
+    if (device_id < 0 || device_id >= static_cast<int64_t>(host_ids.size())) {
+      return std::nullopt;
+    }
+    return host_ids[device_id];
+  };
+
+  HierarchicalGroups decomposed;
+  std::optional<size_t> num_local_devices;
+  std::optional<size_t> num_hosts;
+  for (const std::vector<int64_t>& group : *groups) {
+    absl::btree_map<int64_t, std::vector<int64_t>> ids_by_host;
+    for (int64_t id : group) {
+      std::optional<int64_t> host = get_host(id);
+      if (!host.has_value()) {
+        VLOG(1) << "No host for participant " << id << " of "
+                << all_reduce.ToString();
+        return {std::nullopt};
+      }
+      ids_by_host[*host].push_back(id);
+    }
+
+    // All groups must have the same shape, so that every device scatters into
+    // shards of the same size.
+    if (!num_local_devices.has_value()) {
+      num_local_devices = ids_by_host.begin()->second.size();
+      num_hosts = ids_by_host.size();
+    }
+    if (ids_by_host.size() != *num_hosts) {
+      return {std::nullopt};
+    }
+    for (const auto& [host, ids] : ids_by_host) {
+      if (ids.size() != *num_local_devices) {
+        return {std::nullopt};
+      }
+    }
+    // A group on a single host, or with a single device on each of its
+    // hosts, has nothing to decompose.
+    if (*num_hosts < 2 || *num_local_devices < 2) {
+      return {std::nullopt};
+    }
+
+    for (const auto& [host, ids] : ids_by_host) {
+      ReplicaGroup& intra = decomposed.intra_node_groups.emplace_back();
+      for (int64_t id : ids) {
+        intra.add_replica_ids(id);
+      }
+    }
+    for (size_t rank = 0; rank < *num_local_devices; ++rank) {
+      ReplicaGroup& inter = decomposed.inter_node_groups.emplace_back();
+      for (const auto& [host, ids] : ids_by_host) {
+        inter.add_replica_ids(ids[rank]);
+      }
+    }
+  }
+  return {std::move(decomposed)};
+}
+
+std::vector<HloInstruction*> GetOutputs(HloInstruction* instruction) {
+  if (!instruction->shape().IsTuple()) {
+    return {instruction};
+  }
+  std::vector<HloInstruction*> outputs;
+  outputs.reserve(instruction->shape().tuple_shapes_size());
+  for (int64_t i = 0; i < instruction->shape().tuple_shapes_size(); ++i) {
+    outputs.push_back(instruction->parent()->AddInstruction(
+        HloInstruction::CreateGetTupleElement(instruction, i)));
+  }
+  return outputs;
+}
+
+HloComputation* MakeSumComputation(HloModule* module, PrimitiveType type) {
+  HloComputation::Builder builder(
+      absl::StrCat("sum.", primitive_util::LowercasePrimitiveTypeName(type)));
+  Shape scalar = ShapeUtil::MakeShape(type, {});
+  HloInstruction* lhs = builder.AddInstruction(
+      HloInstruction::CreateParameter(0, scalar, "lhs"));
+  HloInstruction* rhs = builder.AddInstruction(
+      HloInstruction::CreateParameter(1, scalar, "rhs"));
+  builder.AddInstruction(
+      HloInstruction::CreateBinary(scalar, HloOpcode::kAdd, lhs, rhs));
+  return module->AddEmbeddedComputation(builder.Build());
+}
+
+class Decomposer {
+ public:
+  Decomposer(HloModule* module, absl::Span<const int64_t> host_ids,
+             PrimitiveType inter_node_type)
+      : module_(module),
+        host_ids_(host_ids),
+        inter_node_type_(inter_node_type),
+        next_channel_id_(hlo_query::NextChannelId(*module)) {}
+
+  StatusOr<bool> TryDecompose(HloAllReduceInstruction* all_reduce) {
+    TF_ASSIGN_OR_RETURN(std::optional<HierarchicalGroups> groups,
+                        TryDecomposeReplicaGroups(*all_reduce, host_ids_));
+    if (!groups.has_value()) {
+      return false;
+    }
+    const int64_t num_local_devices =
+        groups->intra_node_groups[0].replica_ids_size();
+    for (const HloInstruction* operand : all_reduce->operands()) {
+      TF_RET_CHECK(operand->shape().IsArray());
+      if (ShapeUtil::ElementsIn(operand->shape()) % num_local_devices != 0) {
+        return false;
+      }
+    }
+
+    // Bitcast the operands to 1D, so that they can be scattered evenly.
+    std::vector<HloInstruction*> flat_operands;
+    std::vector<Shape> flat_shapes;
+    std::vector<Shape> scattered_shapes;
+    HloComputation* computation = all_reduce->parent();
+    for (HloInstruction* operand : all_reduce->operands()) {
+      int64_t num_elements = ShapeUtil::ElementsIn(operand->shape());
+      PrimitiveType type = operand->shape().element_type();
+      Shape flat_shape = ShapeUtil::MakeShape(type, {num_elements});
+      flat_operands.push_back(computation->AddInstruction(
+          HloInstruction::CreateBitcast(flat_shape, operand)));
+      flat_shapes.push_back(std::move(flat_shape));
+      scattered_shapes.push_back(
+          ShapeUtil::MakeShape(type, {num_elements / num_local_devices}));
+    }
+
+    HloInstruction* reduce_scatter =
+        computation->AddInstruction(HloInstruction::CreateReduceScatter(
+            ShapeUtil::MakeMaybeTupleShape(scattered_shapes), flat_operands,
+            all_reduce->to_apply(), groups->intra_node_groups,
+            /*constrain_layout=*/false, NextChannelId(*all_reduce),
+            all_reduce->use_global_device_ids(), /*scatter_dimension=*/0));
+
+    std::vector<HloInstruction*> shards = GetOutputs(reduce_scatter);
+    HloComputation* reduction = all_reduce->to_apply();
+    bool compress = ShouldCompress(*all_reduce);
+    if (compress) {
+      for (HloInstruction*& shard : shards) {
+        shard = computation->AddInstruction(HloInstruction::CreateConvert(
+            ShapeUtil::ChangeElementType(shard->shape(), inter_node_type_),
+            shard));
+      }
+      reduction = GetCompressedReduction();
+    }
+    std::vector<Shape> shard_shapes;
+    for (const HloInstruction* shard : shards) {
+      shard_shapes.push_back(shard->shape());
+    }
+    HloInstruction* inter_node_all_reduce =
+        computation->AddInstruction(HloInstruction::CreateAllReduce(
+            ShapeUtil::MakeMaybeTupleShape(shard_shapes), shards, reduction,
+            groups->inter_node_groups, /*constrain_layout=*/false,
+            NextChannelId(*all_reduce), all_reduce->use_global_device_ids()));
+    shards = GetOutputs(inter_node_all_reduce);
+    if (compress) {
+      for (int64_t i = 0; i < shards.size(); ++i) {
+        shards[i] = computation->AddInstruction(
+            HloInstruction::CreateConvert(scattered_shapes[i], shards[i]));
+      }
+    }
+
+    HloInstruction* all_gather =
+        computation->AddInstruction(HloInstruction::CreateAllGather(
+            ShapeUtil::MakeMaybeTupleShape(flat_shapes), shards,
+            /*all_gather_dimension=*/0, groups->intra_node_groups,
+            /*constrain_layout=*/false, NextChannelId(*all_reduce),
+            all_reduce->use_global_device_ids()));
+
+    std::vector<HloInstruction*> outputs = GetOutputs(all_gather);
+    for (int64_t i = 0; i < outputs.size(); ++i) {
+      outputs[i] = computation->AddInstruction(HloInstruction::CreateBitcast(
+          all_reduce->operand(i)->shape(), outputs[i]));
+    }
+    TF_RETURN_IF_ERROR(
+        computation->ReplaceInstruction(all_reduce, MaybeMakeTuple(outputs)));
+    return true;
+  }
+
+ private:
+  // Keeps the all-reduces without a channel id in the same group mode.
+  std::optional<int64_t> NextChannelId(const HloAllReduceInstruction& hlo) {
+    if (!hlo.channel_id().has_value()) {
+      return std::nullopt;
+    }
+    return next_channel_id_++;
+  }
+
+  bool ShouldCompress(const HloAllReduceInstruction& all_reduce) const {
+    if (inter_node_type_ == PRIMITIVE_TYPE_INVALID ||
+        MatchReductionComputation(all_reduce.to_apply()) !=
+            ReductionKind::SUM) {
+      return false;
+    }
+    for (const HloInstruction* operand : all_reduce.operands()) {
+      if (operand->shape().element_type() != F32) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  HloComputation* GetCompressedReduction() {
+    if (compressed_reduction_ == nullptr) {
+      compressed_reduction_ = MakeSumComputation(module_, inter_node_type_);
+    }
+    return compressed_reduction_;
+  }
+
+  HloModule* module_;
+  absl::Span<const int64_t> host_ids_;
+  PrimitiveType inter_node_type_;
+  int64_t next_channel_id_;
+  HloComputation* compressed_reduction_ = nullptr;
+};
+
+}  // namespace
+
+StatusOr<bool> AllReduceHierarchical::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  if (hlo_query::ContainsLayoutConstrainedAllReduce(*module)) {
+    VLOG(1) << "Skip AllReduceHierarchical because the module contains "
+               "all-reduce with constrained layouts";
+    return false;
+  }
+
+  std::vector<HloAllReduceInstruction*> all_reduces;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    for (HloInstruction* instruction : computation->instructions()) {
+      if (instruction->opcode() == HloOpcode::kAllReduce) {
+        all_reduces.push_back(Cast<HloAllReduceInstruction>(instruction));
+      }
+    }
+  }
+
+  Decomposer decomposer(module, host_ids_, inter_node_type_);
+  bool changed = false;
+  for (HloAllReduceInstruction* all_reduce : all_reduces) {
+    TF_ASSIGN_OR_RETURN(bool decomposed, decomposer.TryDecompose(all_reduce));
+    changed |= decomposed;
+  }
+  return changed;
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,56 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_ALL_REDUCE_HIERARCHICAL_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_ALL_REDUCE_HIERARCHICAL_H_
+
+#include <utility>
+#include <vector>
+
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+
+namespace xla {
+namespace gpu {
+
+// Decomposes every all-reduce whose replica groups span several hosts into
+//   1. a reduce-scatter among the devices of each group on the same host,
+//   2. an all-reduce of the scattered shards among the devices with the same
+//      rank on their hosts,
+//   3. an all-gather among the devices of each group on the same host,
+// so that only 1/k of the data crosses the inter-node network, where k is the
+// number of devices of a group on one host.
+//
+// Unlike AllReduceBlueConnect, the hosts are given by an explicit
+// device-to-host mapping instead of assuming that every run of
+// num_devices_per_host device ids is a host, and any replica group layout
+// with the same number of devices on each of its hosts is decomposed.
+// `host_ids[i]` is the host (e.g., the PjRt process index) of device i. The
+// device of a participant is given by the static device assignment if the
+// module has one, and is the flattened participant id otherwise.
+//
+// If `inter_node_type` is valid, the shards of f32 sum all-reduces are
+// converted to it around the inter-node all-reduce, which halves the
+// inter-node traffic at the cost of precision.
+class AllReduceHierarchical : public HloModulePass {
+ public:
+  explicit AllReduceHierarchical(
+      std::vector<int64_t> host_ids,
+      PrimitiveType inter_node_type = PRIMITIVE_TYPE_INVALID)
+      : host_ids_(std::move(host_ids)), inter_node_type_(inter_node_type) {}
+
+  absl::string_view name() const override { return "all-reduce-hierarchical"; }
+
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+
+ private:
+  std::vector<int64_t> host_ids_;
+  PrimitiveType inter_node_type_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_ALL_REDUCE_HIERARCHICAL_H_
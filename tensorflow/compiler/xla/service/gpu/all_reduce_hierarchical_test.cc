@@ -0,0 +1,109 @@
+#include "tensorflow/compiler/xla/service/gpu/all_reduce_hierarchical.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_matchers.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/tsl/platform/status_matchers.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+using ::testing::AllOf;
+using ::tsl::testing::IsOkAndHolds;
+namespace op = xla::testing::opcode_matchers;
+
+constexpr absl::string_view kHloString = R"(
+HloModule module
+
+%add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY %comp {
+  p0 = f32[4,4] parameter(0)
+  ROOT crs = f32[4,4] all-reduce(p0), replica_groups={}, to_apply=add
+})";
+
+class AllReduceHierarchicalTest : public HloTestBase {
+ protected:
+  StatusOr<std::unique_ptr<HloModule>> ParseModule() {
+    return ParseAndReturnVerifiedModule(
+        kHloString, GetModuleConfigForTest(/*replica_count=*/8));
+  }
+};
+
+TEST_F(AllReduceHierarchicalTest, ContiguousHosts) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module, ParseModule());
+
+  AllReduceHierarchical pass(/*host_ids=*/{0, 0, 0, 0, 1, 1, 1, 1});
+  EXPECT_THAT(pass.Run(module.get()), IsOkAndHolds(true));
+
+  std::vector<std::vector<int64_t>> intra_node_groups = {{0, 1, 2, 3},
+                                                         {4, 5, 6, 7}};
+  std::vector<std::vector<int64_t>> inter_node_groups = {
+      {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+
+  auto bitcast = AllOf(op::Shape("f32[16]"), op::Bitcast(op::Parameter(0)));
+  auto reduce_scatter = AllOf(op::Shape("f32[4]"), op::ReduceScatter(bitcast),
+                              op::ReplicaGroups(intra_node_groups));
+  auto all_reduce = AllOf(op::Shape("f32[4]"), op::AllReduce(reduce_scatter),
+                          op::ReplicaGroups(inter_node_groups));
+  auto all_gather = AllOf(op::Shape("f32[16]"), op::AllGather(all_reduce),
+                          op::ReplicaGroups(intra_node_groups));
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              AllOf(op::Shape("f32[4,4]"), op::Bitcast(all_gather)));
+}
+
+TEST_F(AllReduceHierarchicalTest, InterleavedHosts) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module, ParseModule());
+
+  AllReduceHierarchical pass(/*host_ids=*/{0, 1, 0, 1, 0, 1, 0, 1});
+  EXPECT_THAT(pass.Run(module.get()), IsOkAndHolds(true));
+
+  std::vector<std::vector<int64_t>> intra_node_groups = {{0, 2, 4, 6},
+                                                         {1, 3, 5, 7}};
+  std::vector<std::vector<int64_t>> inter_node_groups = {
+      {0, 1}, {2, 3}, {4, 5}, {6, 7}};
+
+  auto reduce_scatter =
+      AllOf(op::ReduceScatter(), op::ReplicaGroups(intra_node_groups));
+  auto all_reduce = AllOf(op::AllReduce(reduce_scatter),
+                          op::ReplicaGroups(inter_node_groups));
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              op::Bitcast(AllOf(op::AllGather(all_reduce),
+                                op::ReplicaGroups(intra_node_groups))));
+}
+
+TEST_F(AllReduceHierarchicalTest, CompressInterNode) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module, ParseModule());
+
+  AllReduceHierarchical pass(/*host_ids=*/{0, 0, 0, 0, 1, 1, 1, 1},
+                             /*inter_node_type=*/BF16);
+  EXPECT_THAT(pass.Run(module.get()), IsOkAndHolds(true));
+
+  auto all_reduce =
+      AllOf(op::Shape("bf16[4]"),
+            op::AllReduce(AllOf(op::Shape("bf16[4]"),
+                                op::Convert(op::ReduceScatter()))));
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              op::Bitcast(op::AllGather(
+                  AllOf(op::Shape("f32[4]"), op::Convert(all_reduce)))));
+}
+
+TEST_F(AllReduceHierarchicalTest, SingleHost) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module, ParseModule());
+
+  AllReduceHierarchical pass(/*host_ids=*/{0, 0, 0, 0, 0, 0, 0, 0});
+  EXPECT_THAT(pass.Run(module.get()), IsOkAndHolds(false));
+}
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
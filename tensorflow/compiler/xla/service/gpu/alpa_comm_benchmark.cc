@@ -0,0 +1,388 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// A microbenchmark of the communication primitives of alpa::CommGroup. See
+// kUsage for details.
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "tensorflow/compiler/xla/pjrt/gpu/se_gpu_pjrt_client.h"
+#include "tensorflow/compiler/xla/pjrt/pjrt_stream_executor_client.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/service/gpu/alpa_nccl_group_base.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/tsl/platform/casts.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/init_main.h"
+#include "tensorflow/tsl/util/command_line_flags.h"
+
+namespace xla {
+namespace gpu {
+namespace alpa {
+namespace {
+
+const char* const kUsage = R"(
+This tool measures the local all-gather, the partial broadcast and the p2p
+send/recv of alpa::CommGroup on the GPUs of this host. It sweeps the message
+sizes, the dtypes, the number of devices and the stream modes, and prints the
+results in the profile format of spmd::CollectiveCostModel::LoadFromFile:
+
+  <kind> <replica groups> <dtype> <stream mode> <bytes>:<seconds> ...
+
+The algorithm column holds the stream mode, and the sizes are the bytes sent
+or received by one device. A send/recv is measured between the first and the
+last device of each device count.
+
+Usage:
+
+  bazel run alpa_comm_benchmark -- --num_devices=2,4,8 --dtypes=f16,f32 \
+      --output=/tmp/profile.txt
+)";
+
+struct BenchmarkOptions {
+  std::vector<int> num_devices;
+  std::vector<PrimitiveType> dtypes;
+  int64_t min_bytes;
+  int64_t max_bytes;
+  int warmup;
+  int iters;
+};
+
+class CommBenchmark {
+ public:
+  CommBenchmark(PjRtStreamExecutorClient* client,
+                const BenchmarkOptions& options)
+      : client_(client), options_(options) {}
+
+  // Run the sweep and return the profile lines.
+  StatusOr<std::vector<std::string>> Run() {
+    std::vector<std::string> lines;
+    for (int n : options_.num_devices) {
+      if (n > client_->addressable_device_count()) {
+        return InvalidArgument("%d devices are requested, but only %d exist.",
+                               n, client_->addressable_device_count());
+      }
+      std::vector<int> devices(n);
+      for (int i = 0; i < n; ++i) {
+        devices[i] = i;
+      }
+      for (PrimitiveType dtype : options_.dtypes) {
+        TF_RETURN_IF_ERROR(BenchmarkAllGather(devices, dtype, &lines));
+        TF_RETURN_IF_ERROR(BenchmarkBroadcast(devices, dtype, &lines));
+        if (n >= 2) {
+          TF_RETURN_IF_ERROR(BenchmarkSendRecv({0, n - 1}, dtype, &lines));
+        }
+      }
+    }
+    return lines;
+  }
+
+ private:
+  // The message sizes of the sweep, in elements of `dtype`.
+  std::vector<int64_t> Sizes(PrimitiveType dtype) const {
+    int64_t dtype_size = primitive_util::ByteWidth(dtype);
+    std::vector<int64_t> sizes;
+    for (int64_t bytes = options_.min_bytes; bytes <= options_.max_bytes;
+         bytes *= 2) {
+      sizes.push_back(std::max<int64_t>(bytes / dtype_size, 1));
+    }
+    return sizes;
+  }
+
+  StatusOr<std::vector<std::unique_ptr<PjRtBuffer>>> AllocateBuffers(
+      const std::vector<int>& devices, PrimitiveType dtype,
+      int64_t n_elements) {
+    std::vector<std::unique_ptr<PjRtBuffer>> buffers;
+    for (int device : devices) {
+      TF_ASSIGN_OR_RETURN(
+          std::unique_ptr<PjRtBuffer> buffer,
+          client_->CreateUninitializedBuffer(
+              ShapeUtil::MakeShape(dtype, {n_elements}),
+              client_->addressable_devices()[device]));
+      buffers.push_back(std::move(buffer));
+    }
+    TF_RETURN_IF_ERROR(Synchronize(devices));
+    return buffers;
+  }
+
+  // Create a clique of `devices` with their order as ranks.
+  StatusOr<AlpaNcclUid> CreateClique(CommGroup& group,
+                                     const std::vector<int>& devices) {
+    TF_ASSIGN_OR_RETURN(AlpaNcclUid uid, NcclGetUniqueId());
+    std::vector<int> ranks(devices.size());
+    for (size_t i = 0; i < ranks.size(); ++i) {
+      ranks[i] = i;
+    }
+    TF_RETURN_IF_ERROR(
+        group.NcclCreateCommunicators(devices.size(), ranks, devices, uid));
+    return uid;
+  }
+
+  Status Synchronize(const std::vector<int>& devices) {
+    for (int device : devices) {
+      if (!client_->device_state(device).executor()->SynchronizeAllActivity()) {
+        return InternalError("Failed to synchronize device %d.", device);
+      }
+    }
+    return OkStatus();
+  }
+
+  // The seconds per call of `issue`, which issues the given number of calls.
+  StatusOr<double> Time(const std::vector<int>& devices,
+                        const std::function<Status(int)>& issue) {
+    TF_RETURN_IF_ERROR(issue(options_.warmup));
+    TF_RETURN_IF_ERROR(Synchronize(devices));
+    absl::Time start = absl::Now();
+    TF_RETURN_IF_ERROR(issue(options_.iters));
+    TF_RETURN_IF_ERROR(Synchronize(devices));
+    return absl::ToDoubleSeconds(absl::Now() - start) / options_.iters;
+  }
+
+  void AddLine(absl::string_view kind, const std::vector<int>& devices,
+               PrimitiveType dtype, absl::string_view stream_mode,
+               const std::vector<std::pair<int64_t, double>>& points,
+               std::vector<std::string>* lines) {
+    std::vector<std::string> point_strs;
+    for (const auto& [bytes, seconds] : points) {
+      point_strs.push_back(absl::StrFormat("%d:%.17g", bytes, seconds));
+    }
+    lines->push_back(absl::StrCat(
+        kind, " ((", absl::StrJoin(devices, ","), ",),) ",
+        primitive_util::LowercasePrimitiveTypeName(dtype), " ", stream_mode,
+        " ", absl::StrJoin(point_strs, " ")));
+  }
+
+  Status BenchmarkAllGather(const std::vector<int>& devices,
+                            PrimitiveType dtype,
+                            std::vector<std::string>* lines) {
+    CommGroup group(client_);
+    TF_ASSIGN_OR_RETURN(AlpaNcclUid uid, CreateClique(group, devices));
+    int n = devices.size();
+    std::vector<int64_t> sizes = Sizes(dtype);
+    TF_ASSIGN_OR_RETURN(auto buffers,
+                        AllocateBuffers(devices, dtype, sizes.back() * n));
+    std::vector<PjRtBuffer*> raw_buffers;
+    for (auto& buffer : buffers) {
+      raw_buffers.push_back(buffer.get());
+    }
+
+    for (bool use_default_stream : {false, true}) {
+      std::vector<std::pair<int64_t, double>> points;
+      for (int64_t n_elements : sizes) {
+        // In place: every device contributes its slice of the output.
+        std::vector<uint> starts(n);
+        for (int i = 0; i < n; ++i) {
+          starts[i] = i * n_elements;
+        }
+        TF_ASSIGN_OR_RETURN(double seconds, Time(devices, [&](int iters) {
+          for (int i = 0; i < iters; ++i) {
+            TF_RETURN_IF_ERROR(group.NcclLocalAllGatherImpl(
+                uid, raw_buffers, starts, /*global_start=*/0, n_elements,
+                use_default_stream));
+          }
+          return OkStatus();
+        }));
+        points.push_back(
+            {n_elements * primitive_util::ByteWidth(dtype), seconds});
+      }
+      AddLine("all-gather", devices, dtype,
+              use_default_stream ? "default_stream" : "recv_stream", points,
+              lines);
+    }
+    return group.NcclDestroyComms(uid);
+  }
+
+  Status BenchmarkBroadcast(const std::vector<int>& devices,
+                            PrimitiveType dtype,
+                            std::vector<std::string>* lines) {
+    CommGroup group(client_);
+    TF_ASSIGN_OR_RETURN(AlpaNcclUid uid, CreateClique(group, devices));
+    int n = devices.size();
+    std::vector<int64_t> sizes = Sizes(dtype);
+    TF_ASSIGN_OR_RETURN(auto buffers,
+                        AllocateBuffers(devices, dtype, sizes.back()));
+    std::vector<PjRtBuffer*> raw_buffers;
+    for (auto& buffer : buffers) {
+      raw_buffers.push_back(buffer.get());
+    }
+    std::vector<uint> starts(n, 0);
+
+    for (absl::string_view mode :
+         {"send_stream", "recv_stream", "default_stream"}) {
+      bool use_recv_stream = mode == "recv_stream";
+      bool use_default_stream = mode == "default_stream";
+      std::vector<std::pair<int64_t, double>> points;
+      for (int64_t n_elements : sizes) {
+        TF_ASSIGN_OR_RETURN(double seconds, Time(devices, [&](int iters) {
+          for (int i = 0; i < iters; ++i) {
+            TF_RETURN_IF_ERROR(group.NcclBroadcastPartialGPUsImpl(
+                uid, raw_buffers, starts, n_elements, /*root_rank=*/0,
+                use_recv_stream, use_default_stream));
+          }
+          return OkStatus();
+        }));
+        points.push_back(
+            {n_elements * primitive_util::ByteWidth(dtype), seconds});
+      }
+      AddLine("broadcast", devices, dtype, mode, points, lines);
+    }
+    return group.NcclDestroyComms(uid);
+  }
+
+  Status BenchmarkSendRecv(const std::vector<int>& devices,
+                           PrimitiveType dtype,
+                           std::vector<std::string>* lines) {
+    // A p2p clique has one local device per CommGroup, so the sender and the
+    // receiver get their own groups. Both ranks are in this process, so every
+    // collective step of the two ranks runs on its own thread.
+    CommGroup send_group(client_), recv_group(client_);
+    TF_ASSIGN_OR_RETURN(AlpaNcclUid uid, NcclGetUniqueId());
+    auto run_both = [](const std::function<Status()>& send,
+                       const std::function<Status()>& recv) {
+      Status recv_status;
+      std::thread receiver([&] { recv_status = recv(); });
+      Status send_status = send();
+      receiver.join();
+      TF_RETURN_IF_ERROR(send_status);
+      return recv_status;
+    };
+    TF_RETURN_IF_ERROR(run_both(
+        [&] {
+          return send_group.NcclCreateCommunicators(2, {0}, {devices[0]}, uid);
+        },
+        [&] {
+          return recv_group.NcclCreateCommunicators(2, {1}, {devices[1]}, uid);
+        }));
+
+    std::vector<int64_t> sizes = Sizes(dtype);
+    TF_ASSIGN_OR_RETURN(auto buffers,
+                        AllocateBuffers(devices, dtype, sizes.back()));
+    for (bool use_default_stream : {false, true}) {
+      std::vector<std::pair<int64_t, double>> points;
+      for (int64_t n_elements : sizes) {
+        TF_ASSIGN_OR_RETURN(double seconds, Time(devices, [&](int iters) {
+          return run_both(
+              [&]() -> Status {
+                for (int i = 0; i < iters; ++i) {
+                  TF_RETURN_IF_ERROR(send_group.NcclSendImpl(
+                      uid, buffers[0].get(), 0, n_elements,
+                      /*peer_p2p_rank=*/1, use_default_stream));
+                }
+                return OkStatus();
+              },
+              [&]() -> Status {
+                for (int i = 0; i < iters; ++i) {
+                  TF_RETURN_IF_ERROR(recv_group.NcclRecvImpl(
+                      uid, buffers[1].get(), 0, n_elements,
+                      /*peer_p2p_rank=*/0, use_default_stream));
+                }
+                return OkStatus();
+              });
+        }));
+        points.push_back(
+            {n_elements * primitive_util::ByteWidth(dtype), seconds});
+      }
+      AddLine("send-recv", devices, dtype,
+              use_default_stream ? "default_stream" : "send_recv_streams",
+              points, lines);
+    }
+    TF_RETURN_IF_ERROR(send_group.NcclDestroyComms(uid));
+    return recv_group.NcclDestroyComms(uid);
+  }
+
+  PjRtStreamExecutorClient* client_;
+  BenchmarkOptions options_;
+};
+
+}  // namespace
+}  // namespace alpa
+}  // namespace gpu
+}  // namespace xla
+
+int main(int argc, char** argv) {
+  std::string num_devices = "2,4,8";
+  std::string dtypes = "f16,f32";
+  int64_t min_bytes = 1 << 10;
+  int64_t max_bytes = 1 << 28;
+  int32_t warmup = 5;
+  int32_t iters = 20;
+  std::string output;
+  std::vector<tsl::Flag> flag_list = {
+      tsl::Flag("num_devices", &num_devices,
+                "comma-separated numbers of local devices to sweep"),
+      tsl::Flag("dtypes", &dtypes, "comma-separated dtypes, e.g. f16,f32"),
+      tsl::Flag("min_bytes", &min_bytes, "smallest message size"),
+      tsl::Flag("max_bytes", &max_bytes,
+                "largest message size; the sizes double from min_bytes"),
+      tsl::Flag("warmup", &warmup, "untimed calls per measurement"),
+      tsl::Flag("iters", &iters, "timed calls per measurement"),
+      tsl::Flag("output", &output, "the profile file; stdout if empty")};
+  const std::string kUsageString = absl::StrCat(
+      xla::gpu::alpa::kUsage, "\n\n", tsl::Flags::Usage(argv[0], flag_list));
+  bool parse_ok = tsl::Flags::Parse(&argc, argv, flag_list);
+  tsl::port::InitMain(kUsageString.c_str(), &argc, &argv);
+  if (!parse_ok || min_bytes <= 0 || max_bytes < min_bytes || iters <= 0) {
+    LOG(QFATAL) << kUsageString;
+  }
+
+  xla::gpu::alpa::BenchmarkOptions options;
+  options.min_bytes = min_bytes;
+  options.max_bytes = max_bytes;
+  options.warmup = warmup;
+  options.iters = iters;
+  for (absl::string_view n : absl::StrSplit(num_devices, ',')) {
+    int value;
+    if (!absl::SimpleAtoi(n, &value) || value <= 0) {
+      LOG(QFATAL) << "Invalid number of devices: " << n;
+    }
+    options.num_devices.push_back(value);
+  }
+  for (absl::string_view name : absl::StrSplit(dtypes, ',')) {
+    options.dtypes.push_back(
+        xla::primitive_util::StringToPrimitiveType(name).value());
+  }
+
+  std::unique_ptr<xla::PjRtClient> client =
+      xla::GetStreamExecutorGpuClient(/*asynchronous=*/true,
+                                      xla::GpuAllocatorConfig(),
+                                      /*distributed_client=*/nullptr,
+                                      /*node_id=*/0)
+          .value();
+  xla::gpu::alpa::CommBenchmark benchmark(
+      tensorflow::down_cast<xla::PjRtStreamExecutorClient*>(client.get()),
+      options);
+  std::string contents =
+      absl::StrCat(absl::StrJoin(benchmark.Run().value(), "\n"), "\n");
+  if (output.empty()) {
+    std::cout << contents;
+  } else {
+    TF_CHECK_OK(tsl::WriteStringToFile(tsl::Env::Default(), output, contents));
+  }
+  return 0;
+}
@@ -1,96 +1,266 @@
-#include <stack>
-
 #include "tensorflow/compiler/xla/service/gpu/alpa_events.h"
 
+#include <algorithm>
+
+#include "tensorflow/compiler/xla/util.h"
+
+#if GOOGLE_CUDA
+#include "tensorflow/compiler/xla/stream_executor/gpu/gpu_activation.h"
+#include "tensorflow/compiler/xla/stream_executor/gpu/gpu_stream.h"
+#include "third_party/gpus/cuda/include/cuda.h"
+#endif
+
 // FIXME(yonghao): only record events used for cross-mesh resharding
 namespace xla {
 namespace gpu {
 absl::Mutex events_mu_;
 using UuidToEvent_t = absl::flat_hash_map<int, std::shared_ptr<DoneEventStats>>;
-std::shared_ptr<UuidToEvent_t> uuid_to_events =
-    std::make_shared<UuidToEvent_t>();
+UuidToEvent_t uuid_to_events ABSL_GUARDED_BY(events_mu_);
 std::vector<int> index_to_uuid;
 int num_devices = -1;
+std::atomic<bool> async_event_wait{false};
+
+DoneEventStats::DoneEventStats() : slots_(std::max(num_devices, 0)) {}
+
+DoneEventStats::~DoneEventStats() {
+#if GOOGLE_CUDA
+  if (flags_ != nullptr) {
+    cuMemFreeHost(flags_);
+  }
+#endif
+}
+
+bool DoneEventStats::InitAsyncFlags(se::StreamExecutor* executor) {
+#if GOOGLE_CUDA
+  absl::call_once(flags_once_, [&]() {
+    se::gpu::ScopedActivateExecutorContext activation(executor);
+    void* ptr = nullptr;
+    CUresult result = cuMemHostAlloc(
+        &ptr, sizeof(uint32_t) * slots_.size(),
+        CU_MEMHOSTALLOC_PORTABLE | CU_MEMHOSTALLOC_DEVICEMAP);
+    if (result != CUDA_SUCCESS) {
+      LOG(WARNING) << "Failed to allocate the flags of async event waits ("
+                   << result << "). Fall back to blocking waits.";
+      return;
+    }
+    flags_ = static_cast<uint32_t*>(ptr);
+    std::fill(flags_, flags_ + slots_.size(), 0);
+  });
+  return flags_ != nullptr;
+#else
+  return false;
+#endif
+}
+
+bool DoneEventStats::WaitForFlag(se::Stream* stream, int device_ordinal,
+                                 uint32_t generation) {
+#if GOOGLE_CUDA
+  CUresult result = cuStreamWaitValue32(
+      se::gpu::AsGpuStreamValue(stream),
+      reinterpret_cast<CUdeviceptr>(&flags_[device_ordinal]), generation,
+      CU_STREAM_WAIT_VALUE_GEQ);
+  if (result != CUDA_SUCCESS) {
+    LOG(WARNING) << "cuStreamWaitValue32 failed (" << result
+                 << "). Fall back to blocking waits.";
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
 
 void DoneEventStats::WaitForAllEventRecorded() {
-  absl::MutexLock lock(&stat_mutex);
-  auto all_event_recorded = [&]() { return record_counter == num_devices; };
-  stat_mutex.Await(absl::Condition(&all_event_recorded));
+  // Fast path: all events are already recorded.
+  if (record_counter.load() == num_devices) {
+    return;
+  }
+  num_waiters.fetch_add(1);
+  {
+    absl::MutexLock lock(&stat_mutex);
+    auto all_event_recorded = [&]() {
+      return record_counter.load() == num_devices || !active_.load();
+    };
+    stat_mutex.Await(absl::Condition(&all_event_recorded));
+  }
+  num_waiters.fetch_sub(1);
 }
 
-se::Event* DoneEventStats::RecordEvent(int device_ordinal,
-                                       se::StreamExecutor* executor) {
-  absl::MutexLock lock(&stat_mutex);
-  CHECK(record_counter < num_devices);
-  value_[device_ordinal] = std::make_unique<se::Event>(executor);
-  record_counter += 1;
-  return value_[device_ordinal].get();
+StatusOr<se::Event*> DoneEventStats::RecordEvent(
+    int device_ordinal, se::StreamExecutor* executor) {
+  TF_RET_CHECK(device_ordinal >= 0 && device_ordinal < num_devices &&
+               device_ordinal < static_cast<int>(slots_.size()));
+  Slot& slot = slots_[device_ordinal];
+  if (slot.event == nullptr || slot.executor != executor) {
+    slot.event = std::make_unique<se::Event>(executor);
+    slot.executor = executor;
+    TF_RET_CHECK(slot.event->Init());
+  }
+  int64_t recorded = record_counter.fetch_add(1) + 1;
+  CHECK_LE(recorded, num_devices);
+  if (recorded == num_devices && num_waiters.load() > 0) {
+    // Wake up the waiters, which re-evaluate their condition on unlock.
+    absl::MutexLock lock(&stat_mutex);
+  }
+  return slot.event.get();
 }
 
-Status DoneEventStats::WaitOnStreams(std::vector<se::Stream*>& streams) {
+Status DoneEventStats::RecordOnStream(int device_ordinal, se::Stream* stream) {
+  uint32_t generation = generation_.load();
+  bool use_flags =
+      AsyncEventWaitEnabled() && InitAsyncFlags(stream->parent());
+  TF_ASSIGN_OR_RETURN(se::Event * event,
+                      RecordEvent(device_ordinal, stream->parent()));
+  stream->ThenRecordEvent(event);
+#if GOOGLE_CUDA
+  if (use_flags) {
+    CUresult result = cuStreamWriteValue32(
+        se::gpu::AsGpuStreamValue(stream),
+        reinterpret_cast<CUdeviceptr>(&flags_[device_ordinal]), generation,
+        CU_STREAM_WRITE_VALUE_DEFAULT);
+    if (result != CUDA_SUCCESS) {
+      return InternalError("cuStreamWriteValue32 failed (%d).", result);
+    }
+  }
+#endif
+  return OkStatus();
+}
+
+template <typename StreamPtr>
+Status DoneEventStats::WaitOnStreamsImpl(std::vector<StreamPtr>& streams) {
+  if (record_counter.load() != num_devices && active_.load() &&
+      AsyncEventWaitEnabled() && !streams.empty() &&
+      InitAsyncFlags(streams[0]->parent())) {
+    // Stream-ordered wait: do not block the host on records that are not
+    // issued yet.
+    CHECK_EQ(streams.size(), num_devices);
+    uint32_t generation = generation_.load();
+    bool ok = true;
+    for (int device_ordinal = 0; ok && device_ordinal < num_devices;
+         ++device_ordinal) {
+      ok = WaitForFlag(&*streams[device_ordinal], device_ordinal, generation);
+    }
+    if (ok) {
+      return OkStatus();
+    }
+  }
+
   WaitForAllEventRecorded();
+  if (!active_.load()) {
+    return OkStatus();
+  }
   CHECK_EQ(streams.size(), num_devices);
   for (int device_ordinal = 0; device_ordinal < num_devices; ++device_ordinal) {
-    streams[device_ordinal]->ThenWaitFor(value_[device_ordinal].get());
+    streams[device_ordinal]->ThenWaitFor(slots_[device_ordinal].event.get());
   }
   return OkStatus();
 }
 
+Status DoneEventStats::WaitOnStreams(std::vector<se::Stream*>& streams) {
+  return WaitOnStreamsImpl(streams);
+}
+
 Status DoneEventStats::WaitOnStreams(
     std::vector<std::unique_ptr<se::Stream>>& streams) {
-  WaitForAllEventRecorded();
-  CHECK_EQ(streams.size(), num_devices);
-  for (int device_ordinal = 0; device_ordinal < num_devices; ++device_ordinal) {
-    streams[device_ordinal]->ThenWaitFor(value_[device_ordinal].get());
+  return WaitOnStreamsImpl(streams);
+}
+
+void DoneEventStats::Reset() {
+  generation_.fetch_add(1);
+  record_counter.store(0);
+  active_.store(true);
+}
+
+void DoneEventStats::Deactivate() {
+  active_.store(false);
+  if (num_waiters.load() > 0) {
+    absl::MutexLock lock(&stat_mutex);
   }
-  return OkStatus();
 }
 
 void SetNumDeviceOnHost(int nd) { num_devices = nd; }
 
+void SetAsyncEventWait(bool enabled) { async_event_wait.store(enabled); }
+
+bool AsyncEventWaitEnabled() { return async_event_wait.load(); }
+
 Status XlaSetIdxToUuid(const std::vector<int>& mapping) {
   index_to_uuid = mapping;
   for (int uuid : mapping) {
-    ResetEvents(uuid);
+    TF_RETURN_IF_ERROR(ResetEvents(uuid));
   }
   return OkStatus();
 }
 
 Status ResetEvents(int uuid) {
+  {
+    absl::ReaderMutexLock lock(&events_mu_);
+    auto iter = uuid_to_events.find(uuid);
+    if (iter != uuid_to_events.end()) {
+      iter->second->Reset();
+      return OkStatus();
+    }
+  }
   absl::MutexLock lock(&events_mu_);
-  uuid_to_events->insert_or_assign(uuid, std::make_shared<DoneEventStats>());
+  auto& stats = uuid_to_events[uuid];
+  if (stats == nullptr) {
+    stats = std::make_shared<DoneEventStats>();
+  } else {
+    stats->Reset();
+  }
   return OkStatus();
 }
 
-se::Event* SetEvent(int uuid, int device_ordinal,
-                    se::StreamExecutor* executor) {
-  absl::MutexLock lock(&events_mu_);
-  return uuid_to_events->at(uuid)->RecordEvent(device_ordinal, executor);
+Status SetEvent(int uuid, int device_ordinal, se::Stream* stream) {
+  std::shared_ptr<DoneEventStats> stats;
+  {
+    absl::ReaderMutexLock lock(&events_mu_);
+    stats = uuid_to_events.at(uuid);
+  }
+  return stats->RecordOnStream(device_ordinal, stream);
 }
 
 std::shared_ptr<DoneEventStats> GetEventStats(int index) {
   int uuid = index_to_uuid[index];
-  absl::MutexLock lock(&events_mu_);
-  return uuid_to_events->at(uuid);
+  absl::ReaderMutexLock lock(&events_mu_);
+  return uuid_to_events.at(uuid);
 }
 
-Status WaitEventOnStreams(int uuid, std::vector<se::Stream*>& streams) {
-  absl::MutexLock lock(&events_mu_);
-  if (uuid_to_events->count(uuid)) {
-    TF_RETURN_IF_ERROR(uuid_to_events->at(uuid)->WaitOnStreams(streams));
+namespace {
+template <typename StreamPtr>
+Status WaitEventOnStreamsImpl(int uuid, std::vector<StreamPtr>& streams) {
+  std::shared_ptr<DoneEventStats> stats;
+  {
+    absl::ReaderMutexLock lock(&events_mu_);
+    auto iter = uuid_to_events.find(uuid);
+    if (iter == uuid_to_events.end()) {
+      return OkStatus();
+    }
+    stats = iter->second;
+  }
+  if (stats->active()) {
+    TF_RETURN_IF_ERROR(stats->WaitOnStreams(streams));
   }
   return OkStatus();
 }
+}  // namespace
+
+Status WaitEventOnStreams(int uuid, std::vector<se::Stream*>& streams) {
+  return WaitEventOnStreamsImpl(uuid, streams);
+}
 
 Status WaitEventOnStreams(int uuid,
                           std::vector<std::unique_ptr<se::Stream>>& streams) {
-  absl::MutexLock lock(&events_mu_);
-  if (uuid_to_events->count(uuid)) {
-    TF_RETURN_IF_ERROR(uuid_to_events->at(uuid)->WaitOnStreams(streams));
-  }
-  return OkStatus();
+  return WaitEventOnStreamsImpl(uuid, streams);
 }
 
-void ResetAlpaEvents() { uuid_to_events = std::make_shared<UuidToEvent_t>(); }
+void ResetAlpaEvents() {
+  // Keep the pooled events. Deactivated stats behave as if the uuid was
+  // never registered until ResetEvents registers it again.
+  absl::ReaderMutexLock lock(&events_mu_);
+  for (auto& iter : uuid_to_events) {
+    iter.second->Deactivate();
+  }
+}
 };  // namespace gpu
 };  // namespace xla
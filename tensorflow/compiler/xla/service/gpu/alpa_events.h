@@ -1,8 +1,15 @@
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_ALPA_EVENTS_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_ALPA_EVENTS_H_
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "absl/base/call_once.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/compiler/xla/statusor.h"
 #include "tensorflow/stream_executor/stream.h"
 // This file provides APIs to sync Alpa's multi-stream behavior with
 // XLA's own streams
@@ -10,32 +17,83 @@ namespace xla {
 namespace gpu {
 namespace se = ::stream_executor;
 
+// The done events of one uuid, one per device on this host.
+// The events are pooled: they are created and initialized on first use and
+// re-recorded on every run, so a run does not allocate events. Recording and
+// waiting for events that are already recorded do not take a lock.
+//
+// In async mode (see SetAsyncEventWait), every record also writes the
+// generation of the current round to a per-device flag in pinned host memory
+// on the recording stream. A wait that comes before all records makes the
+// waiting stream wait on the flag on the device, instead of blocking the
+// host until the records are issued.
 class DoneEventStats {
  public:
+  DoneEventStats();
+  ~DoneEventStats();
+
   void WaitForAllEventRecorded();
-  se::Event* RecordEvent(int device_ordinal, se::StreamExecutor* executor);
+  StatusOr<se::Event*> RecordEvent(int device_ordinal,
+                                   se::StreamExecutor* executor);
+  // Record the event of a device on `stream`, and in async mode publish the
+  // round to the flag of the device.
+  Status RecordOnStream(int device_ordinal, se::Stream* stream);
   Status WaitOnStreams(std::vector<se::Stream*>& streams);
   Status WaitOnStreams(std::vector<std::unique_ptr<se::Stream>>& streams);
 
-  bool empty() const { return value_.empty(); }
+  // Expect a new round of records. The pooled events are kept.
+  void Reset();
+  // Stop expecting records, so that waits return immediately.
+  void Deactivate();
+  bool active() const { return active_.load(); }
 
  private:
+  struct Slot {
+    se::StreamExecutor* executor = nullptr;
+    std::unique_ptr<se::Event> event;
+  };
+
+  template <typename StreamPtr>
+  Status WaitOnStreamsImpl(std::vector<StreamPtr>& streams);
+  // Allocate the flags of async mode on first use. Return false if the
+  // flags are not available.
+  bool InitAsyncFlags(se::StreamExecutor* executor);
+  // Make `stream` wait on the device until the flag of `device_ordinal`
+  // reaches `generation`.
+  bool WaitForFlag(se::Stream* stream, int device_ordinal,
+                   uint32_t generation);
+
   absl::Mutex stat_mutex;
-  int64_t record_counter ABSL_GUARDED_BY(stat_mutex) = 0;
-  absl::flat_hash_map<int, std::unique_ptr<se::Event>> value_;
+  std::atomic<int64_t> record_counter{0};
+  std::atomic<int64_t> num_waiters{0};
+  std::atomic<bool> active_{true};
+  // The round of records, bumped by Reset.
+  std::atomic<uint32_t> generation_{1};
+  absl::once_flag flags_once_;
+  // One flag per device in pinned host memory mapped to all devices.
+  uint32_t* flags_ = nullptr;
+  // Indexed by the device ordinal. Each slot is only written by the thread
+  // that records the event of its device.
+  std::vector<Slot> slots_;
 };
 
 // Init function
 void SetNumDeviceOnHost(int nd);
 
+// Enable stream-ordered waits, so that waiting for events that are not
+// recorded yet does not block the host. This must be set before any event is
+// recorded.
+void SetAsyncEventWait(bool enabled);
+bool AsyncEventWaitEnabled();
+
 // Set idx to uuid for computations to record events
 Status XlaSetIdxToUuid(const std::vector<int>& mapping);
 
 // Reset event ids
 Status ResetEvents(int uuid);
 
-// Set events for communications to record events
-se::Event* SetEvent(int uuid, int device_ordinal, se::StreamExecutor* executor);
+// Record the event of a device for communications on `stream`
+Status SetEvent(int uuid, int device_ordinal, se::Stream* stream);
 
 // Get event stats for computation to record it
 std::shared_ptr<DoneEventStats> GetEventStats(int index);
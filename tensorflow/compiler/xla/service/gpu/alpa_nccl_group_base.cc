@@ -21,9 +21,16 @@ limitations under the License.
 #include "tensorflow/compiler/xla/stream_executor/gpu/gpu_stream.h"
 #include "third_party/gpus/cuda/include/cuda.h"
 #endif
+#include <algorithm>
 #include <cstdlib>
 #include <string>
 
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/compiler/xla/layout_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/tsl/profiler/lib/traceme.h"
+#include "tensorflow/tsl/profiler/lib/traceme_encode.h"
+
 namespace stream_executor {};
 namespace se = ::stream_executor;
 
@@ -101,6 +108,78 @@ CUstream GetCudaStream(se::Stream *stream) {
   return reinterpret_cast<CUstream>(se::gpu::AsGpuStreamValue(stream));
 }
 
+// Split an N-d tile of a row-major buffer into contiguous chunks of
+// (element offset, number of elements). See CommGroup::NcclSendTileImpl.
+StatusOr<std::vector<std::pair<int64_t, int64_t>>> TileToContiguousChunks(
+    const Shape &shape, const std::vector<int64_t> &tile_offsets,
+    const std::vector<int64_t> &tile_shape,
+    const std::vector<int64_t> &peer_dims) {
+  const int64_t rank = shape.rank();
+  if (static_cast<int64_t>(tile_offsets.size()) != rank ||
+      static_cast<int64_t>(tile_shape.size()) != rank ||
+      static_cast<int64_t>(peer_dims.size()) != rank) {
+    return InvalidArgument(
+        "The tile offsets, the tile shape and the peer dims must have the "
+        "rank of the buffer (%d).",
+        rank);
+  }
+  if (shape.has_layout() &&
+      !LayoutUtil::IsMonotonicWithDim0Major(shape.layout())) {
+    return Unimplemented("Only row-major buffers support tile send/recv.");
+  }
+  for (int64_t d = 0; d < rank; ++d) {
+    if (tile_offsets[d] < 0 || tile_shape[d] < 0 ||
+        tile_offsets[d] + tile_shape[d] > shape.dimensions(d)) {
+      return InvalidArgument("The tile is out of the bounds of dim %d.", d);
+    }
+  }
+
+  std::vector<int64_t> strides(rank, 1);
+  for (int64_t d = rank - 2; d >= 0; --d) {
+    strides[d] = strides[d + 1] * shape.dimensions(d + 1);
+  }
+
+  // Merge trailing dims that are fully covered on both sides.
+  int64_t k = rank - 1;
+  int64_t chunk_size = 1;
+  while (k >= 0 && tile_shape[k] == shape.dimensions(k) &&
+         tile_shape[k] == peer_dims[k]) {
+    chunk_size *= tile_shape[k];
+    --k;
+  }
+  std::vector<std::pair<int64_t, int64_t>> chunks;
+  if (k >= 0) {
+    chunk_size *= tile_shape[k];
+  }
+  if (chunk_size == 0) {
+    return chunks;
+  }
+  if (k < 0) {
+    chunks.push_back({0, chunk_size});
+    return chunks;
+  }
+
+  // Iterate over the outer dims [0, k) of the tile.
+  std::vector<int64_t> index(k, 0);
+  while (true) {
+    int64_t start = tile_offsets[k] * strides[k];
+    for (int64_t d = 0; d < k; ++d) {
+      start += (tile_offsets[d] + index[d]) * strides[d];
+    }
+    chunks.push_back({start, chunk_size});
+
+    int64_t d = k - 1;
+    while (d >= 0 && ++index[d] == tile_shape[d]) {
+      index[d] = 0;
+      --d;
+    }
+    if (d < 0) {
+      break;
+    }
+  }
+  return chunks;
+}
+
 using CrossMeshCommInfo = std::pair<std::shared_ptr<CommGroup>, AlpaNcclUid>;
 absl::flat_hash_map<std::string, CrossMeshCommInfo> cross_mesh_comms;
 CUstream default_stream = NULL;
@@ -125,35 +204,210 @@ CommGroup::CommGroup(PjRtStreamExecutorClient *client) : client_(client) {
 // Communicator related functions:
 Status CommGroup::NcclCreateCommunicators(
     int world_size, const std::vector<int> &device_global_ranks,
-    const std::vector<int> &device_ids, const AlpaNcclUid &nccl_uid_vec) {
+    const std::vector<int> &device_ids, const AlpaNcclUid &nccl_uid_vec,
+    bool lazy, const std::string &device_set_key) {
+#if XLA_ENABLE_XCCL
+  CHECK_EQ(device_global_ranks.size(), device_ids.size());
+  {
+    absl::MutexLock lock(&comms_mu_);
+    if (comm_aliases_.contains(nccl_uid_vec)) {
+      return InvalidArgument("Communicators of the nccl uid already exist.");
+    }
+    auto iter = device_set_key.empty() ? device_set_comms_.end()
+                                       : device_set_comms_.find(device_set_key);
+    if (iter != device_set_comms_.end()) {
+      CommSpec &spec = comm_specs_.at(iter->second);
+      if (spec.world_size != world_size ||
+          spec.device_global_ranks != device_global_ranks ||
+          spec.device_ids != device_ids) {
+        return InvalidArgument(
+            "The clique of device set %s has different ranks or devices.",
+            device_set_key);
+      }
+      ++spec.num_users;
+      comm_aliases_[nccl_uid_vec] = iter->second;
+      local_ids[nccl_uid_vec] = device_ids;
+      return OkStatus();
+    }
+    CommSpec &spec = comm_specs_[nccl_uid_vec];
+    spec.world_size = world_size;
+    spec.device_global_ranks = device_global_ranks;
+    spec.device_ids = device_ids;
+    spec.device_set_key = device_set_key;
+    spec.num_users = 1;
+    comm_aliases_[nccl_uid_vec] = nccl_uid_vec;
+    if (!device_set_key.empty()) {
+      device_set_comms_[device_set_key] = nccl_uid_vec;
+    }
+    local_ids[nccl_uid_vec] = device_ids;
+  }
+  if (lazy) {
+    return OkStatus();
+  }
+  return EnsureCommunicators({nccl_uid_vec});
+#else   // XLA_ENABLE_XCCL
+  return Unimplemented("NCCL support is not available.");
+#endif  // XLA_ENABLE_XCCL
+}
+
+Status CommGroup::EnsureCommunicators(const std::vector<AlpaNcclUid> &keys) {
 #if XLA_ENABLE_XCCL
-  int n_devices = device_global_ranks.size();
-  CHECK_EQ(n_devices, device_ids.size());
-  ncclUniqueId nccl_uid = NcclUidDeserialize(nccl_uid_vec);
-  // Create Communicators
+  auto pending = [&]() ABSL_SHARED_LOCKS_REQUIRED(comms_mu_) {
+    std::vector<AlpaNcclUid> canonical_keys;
+    for (const AlpaNcclUid &key : keys) {
+      auto alias = comm_aliases_.find(key);
+      if (alias == comm_aliases_.end()) {
+        continue;
+      }
+      if (!comm_specs_.at(alias->second).initialized &&
+          std::find(canonical_keys.begin(), canonical_keys.end(),
+                    alias->second) == canonical_keys.end()) {
+        canonical_keys.push_back(alias->second);
+      }
+    }
+    return canonical_keys;
+  };
+  {
+    absl::ReaderMutexLock lock(&comms_mu_);
+    if (pending().empty()) {
+      return OkStatus();
+    }
+  }
+
+  // Another thread may have initialized the communicators meanwhile.
+  absl::MutexLock init_lock(&init_mu_);
+  std::vector<AlpaNcclUid> canonical_keys;
+  std::vector<CommSpec> specs;
+  {
+    absl::ReaderMutexLock lock(&comms_mu_);
+    canonical_keys = pending();
+    for (const AlpaNcclUid &key : canonical_keys) {
+      specs.push_back(comm_specs_.at(key));
+    }
+  }
+  if (canonical_keys.empty()) {
+    return OkStatus();
+  }
   XLA_CUDA_RETURN_IF_ERROR(ncclGroupStart());
-  for (int i = 0; i < n_devices; i++) {
-    cudaSetDevice(device_ids[i]);
-    int rank = device_global_ranks[i];
-    auto comm_key = std::make_pair(nccl_uid_vec, device_ids[i]);
-    NcclComm::Lock comm = comm_map[comm_key].Acquire();
-    XLA_CUDA_RETURN_IF_ERROR(
-        ncclCommInitRank(comm.get(), world_size, nccl_uid, rank));
+  for (size_t k = 0; k < canonical_keys.size(); ++k) {
+    const CommSpec &spec = specs[k];
+    ncclUniqueId nccl_uid = NcclUidDeserialize(canonical_keys[k]);
+    for (size_t i = 0; i < spec.device_ids.size(); ++i) {
+      cudaSetDevice(spec.device_ids[i]);
+      auto comm_key = std::make_pair(canonical_keys[k], spec.device_ids[i]);
+      NcclComm::Lock comm = comm_map[comm_key].Acquire();
+      XLA_CUDA_RETURN_IF_ERROR(ncclCommInitRank(
+          comm.get(), spec.world_size, nccl_uid, spec.device_global_ranks[i]));
+    }
   }
-  local_ids[nccl_uid_vec] = device_ids;
   XLA_CUDA_RETURN_IF_ERROR(ncclGroupEnd());
+  absl::MutexLock lock(&comms_mu_);
+  for (const AlpaNcclUid &key : canonical_keys) {
+    auto iter = comm_specs_.find(key);
+    if (iter != comm_specs_.end()) {
+      iter->second.initialized = true;
+    }
+  }
   return OkStatus();
 #else   // XLA_ENABLE_XCCL
   return Unimplemented("NCCL support is not available.");
 #endif  // XLA_ENABLE_XCCL
 }
 
+std::pair<AlpaNcclUid, int> CommGroup::CommKey(const AlpaNcclUid &key,
+                                               int device_id) {
+  absl::ReaderMutexLock lock(&comms_mu_);
+  auto iter = comm_aliases_.find(key);
+  return std::make_pair(iter != comm_aliases_.end() ? iter->second : key,
+                        device_id);
+}
+
+int CommGroup::GlobalRank(const AlpaNcclUid &key, int device_id) {
+  absl::ReaderMutexLock lock(&comms_mu_);
+  auto alias = comm_aliases_.find(key);
+  if (alias == comm_aliases_.end()) {
+    return -1;
+  }
+  const CommSpec &spec = comm_specs_.at(alias->second);
+  auto pos =
+      std::find(spec.device_ids.begin(), spec.device_ids.end(), device_id);
+  if (pos == spec.device_ids.end()) {
+    return -1;
+  }
+  return spec.device_global_ranks[pos - spec.device_ids.begin()];
+}
+
 Status CommGroup::NcclDestroyComms(const AlpaNcclUid &nccl_uid_vec) {
 #if XLA_ENABLE_XCCL
-  for (int device_id : local_ids[nccl_uid_vec]) {
-    auto key = std::make_pair(nccl_uid_vec, device_id);
-    XLA_CUDA_RETURN_IF_ERROR(ncclCommDestroy(*comm_map[key].Acquire()));
+  // Wait for an initialization in progress.
+  absl::MutexLock init_lock(&init_mu_);
+  absl::MutexLock lock(&comms_mu_);
+  auto alias = comm_aliases_.find(nccl_uid_vec);
+  if (alias == comm_aliases_.end()) {
+    return OkStatus();
+  }
+  AlpaNcclUid canonical_key = alias->second;
+  comm_aliases_.erase(alias);
+  auto iter = comm_specs_.find(canonical_key);
+  CommSpec &spec = iter->second;
+  if (--spec.num_users > 0) {
+    return OkStatus();
+  }
+  if (spec.xla_clique.has_value()) {
+    for (size_t i = 0; i < spec.device_ids.size(); ++i) {
+      UnregisterSharedNcclComm(*spec.xla_clique, spec.device_global_ranks[i]);
+    }
+  }
+  if (spec.initialized) {
+    for (int device_id : spec.device_ids) {
+      auto key = std::make_pair(canonical_key, device_id);
+      XLA_CUDA_RETURN_IF_ERROR(ncclCommDestroy(*comm_map[key].Acquire()));
+    }
+  }
+  if (!spec.device_set_key.empty()) {
+    device_set_comms_.erase(spec.device_set_key);
+  }
+  comm_specs_.erase(iter);
+  return OkStatus();
+#else   // XLA_ENABLE_XCCL
+  return Unimplemented("NCCL support is not available.");
+#endif  // XLA_ENABLE_XCCL
+}
+
+Status CommGroup::NcclShareCommsWithXla(
+    const AlpaNcclUid &key, const std::vector<int> &global_device_ids) {
+#if XLA_ENABLE_XCCL
+  TF_RETURN_IF_ERROR(EnsureCommunicators({key}));
+  absl::MutexLock lock(&comms_mu_);
+  auto alias = comm_aliases_.find(key);
+  if (alias == comm_aliases_.end()) {
+    return InvalidArgument("No communicators of the nccl uid.");
+  }
+  CommSpec &spec = comm_specs_.at(alias->second);
+  if (static_cast<int>(global_device_ids.size()) != spec.world_size) {
+    return InvalidArgument("Got %d global device ids for a clique of %d ranks.",
+                           global_device_ids.size(), spec.world_size);
   }
+  std::vector<GlobalDeviceId> devices;
+  devices.reserve(global_device_ids.size());
+  for (int id : global_device_ids) {
+    devices.push_back(GlobalDeviceId(id));
+  }
+  NcclCliqueKey clique_key(std::move(devices));
+  if (spec.xla_clique.has_value()) {
+    if (*spec.xla_clique == clique_key) {
+      return OkStatus();
+    }
+    return InvalidArgument(
+        "The communicators are already lent to XLA for the devices %s.",
+        spec.xla_clique->ToString());
+  }
+  for (size_t i = 0; i < spec.device_ids.size(); ++i) {
+    RegisterSharedNcclComm(
+        clique_key, spec.device_global_ranks[i],
+        &comm_map[std::make_pair(alias->second, spec.device_ids[i])]);
+  }
+  spec.xla_clique = std::move(clique_key);
   return OkStatus();
 #else   // XLA_ENABLE_XCCL
   return Unimplemented("NCCL support is not available.");
@@ -167,6 +421,7 @@ Status CommGroup::NcclLocalAllGatherImpl(
     std::vector<uint> local_start_positions, uint global_start, uint n_elements,
     bool use_default_stream) {
 #if XLA_ENABLE_XCCL
+  TF_RETURN_IF_ERROR(EnsureCommunicators({key}));
   const auto &device_ids = local_ids[key];
   int n_devices = device_ids.size();
   CHECK_EQ(n_devices, buffers.size());
@@ -176,11 +431,16 @@ Status CommGroup::NcclLocalAllGatherImpl(
       ncclDataType_t dtype,
       ToNcclDataType(buffers[0]->on_device_shape().element_type()));
   int dtype_size = SizeOfType(dtype);
-  // ----------------------------------------------------------------------------------------------------
-  int repeat_comm = 1;
-  if (const char* env = std::getenv("ALPA_TEST_REPEAT_COMM"))
-    repeat_comm = std::stoi(env);
-  // ----------------------------------------------------------------------------------------------------
+  int64_t bytes = int64_t{n_elements} * dtype_size * n_devices;
+  tsl::profiler::TraceMe trace([&] {
+    return tsl::profiler::TraceMeEncode("CommGroup::NcclLocalAllGather",
+                                        {{"bytes", bytes}});
+  });
+  std::vector<se::Stream *> se_streams;
+  for (int i = 0; i < n_devices && !use_default_stream; ++i) {
+    se_streams.push_back(recv_streams[i].get());
+  }
+  auto transfer = StartTransfer(key, /*peer=*/-1, bytes, se_streams);
   XLA_CUDA_RETURN_IF_ERROR(ncclGroupStart());
   for (int i = 0; i < n_devices; ++i) {
     // FIXME(yonghao): use assign or return
@@ -188,14 +448,14 @@ Status CommGroup::NcclLocalAllGatherImpl(
     sendbuff = sendbuff + local_start_positions[i] * dtype_size;
     TF_ASSIGN_OR_RETURN(std::uintptr_t recvbuff, ToUnsafePointer(buffers[i]));
     recvbuff = recvbuff + global_start * dtype_size;
-    auto comm = *comm_map[std::make_pair(key, device_ids[i])].Acquire();
+    auto comm = *comm_map[CommKey(key, device_ids[i])].Acquire();
     auto stream = (use_default_stream ? default_stream
                                       : GetCudaStream(recv_streams[i].get()));
-    for (int _repeat=0; _repeat<repeat_comm; _repeat++)
     XLA_CUDA_RETURN_IF_ERROR(ncclAllGather((void *)sendbuff, (void *)recvbuff,
                                            n_elements, dtype, comm, stream));
   }
   XLA_CUDA_RETURN_IF_ERROR(ncclGroupEnd());
+  FinishTransfer(std::move(transfer));
   return OkStatus();
 #else   // XLA_ENABLE_XCCL
   return Unimplemented("NCCL support is not available.");
@@ -207,6 +467,7 @@ Status CommGroup::NcclBroadcastPartialGPUsImpl(
     std::vector<uint> local_start_positions, uint n_elements, int root_rank,
     bool use_recv_stream, bool use_default_stream) {
 #if XLA_ENABLE_XCCL
+  TF_RETURN_IF_ERROR(EnsureCommunicators({key}));
   const auto &device_ids = local_ids[key];
   int n_devices = device_ids.size();
   CHECK_EQ(n_devices, buffers.size());
@@ -216,12 +477,18 @@ Status CommGroup::NcclBroadcastPartialGPUsImpl(
       ncclDataType_t dtype,
       ToNcclDataType(buffers[0]->on_device_shape().element_type()));
   int dtype_size = SizeOfType(dtype);
-
-  // ----------------------------------------------------------------------------------------------------
-  int repeat_comm = 1;
-  if (const char* env = std::getenv("ALPA_TEST_REPEAT_COMM"))
-    repeat_comm = std::stoi(env);
-  // ----------------------------------------------------------------------------------------------------
+  int64_t bytes = int64_t{n_elements} * dtype_size * n_devices;
+  tsl::profiler::TraceMe trace([&] {
+    return tsl::profiler::TraceMeEncode(
+        "CommGroup::NcclBroadcastPartialGPUs",
+        {{"bytes", bytes}, {"root", root_rank}});
+  });
+  std::vector<se::Stream *> se_streams;
+  for (int i = 0; i < n_devices && !use_default_stream; ++i) {
+    se_streams.push_back(use_recv_stream ? recv_streams[device_ids[i]].get()
+                                         : send_streams[device_ids[i]].get());
+  }
+  auto transfer = StartTransfer(key, root_rank, bytes, se_streams);
   XLA_CUDA_RETURN_IF_ERROR(ncclGroupStart());
   for (int i = 0; i < n_devices; ++i) {
     int device_id = device_ids[i];
@@ -230,19 +497,111 @@ Status CommGroup::NcclBroadcastPartialGPUsImpl(
     TF_ASSIGN_OR_RETURN(std::uintptr_t recvbuff, ToUnsafePointer(buffers[i]));
     recvbuff = recvbuff + local_start_positions[i] * dtype_size;
 
-    auto comm = *comm_map[std::make_pair(key, device_id)].Acquire();
+    auto comm = *comm_map[CommKey(key, device_id)].Acquire();
     auto se_stream = use_default_stream
                          ? nullptr
                          : use_recv_stream ? recv_streams[device_id].get()
                                            : send_streams[device_id].get();
     auto stream =
         use_default_stream ? default_stream : GetCudaStream(se_stream);
-    for (int _repeat=0; _repeat<repeat_comm; _repeat++)
     XLA_CUDA_RETURN_IF_ERROR(ncclBroadcast((void *)sendbuff, (void *)recvbuff,
                                            n_elements, dtype, root_rank, comm,
                                            stream));
   }
   XLA_CUDA_RETURN_IF_ERROR(ncclGroupEnd());
+  FinishTransfer(std::move(transfer));
+  return OkStatus();
+#else   // XLA_ENABLE_XCCL
+  return Unimplemented("NCCL support is not available.");
+#endif  // XLA_ENABLE_XCCL
+}
+
+Status CommGroup::NcclBroadcastPipelinedImpl(
+    const AlpaNcclUid &inter_key, const AlpaNcclUid &intra_key,
+    std::vector<PjRtBuffer *> buffers, std::vector<uint> local_start_positions,
+    uint n_elements, int inter_root_rank, int intra_root_rank,
+    uint chunk_elements) {
+#if XLA_ENABLE_XCCL
+  TF_RETURN_IF_ERROR(EnsureCommunicators({inter_key, intra_key}));
+  auto inter_iter = local_ids.find(inter_key);
+  auto intra_iter = local_ids.find(intra_key);
+  // The devices that take part in the fan-out, or only the root device.
+  const std::vector<int> &device_ids =
+      intra_iter != local_ids.end() ? intra_iter->second : inter_iter->second;
+  int n_devices = device_ids.size();
+  CHECK_EQ(n_devices, buffers.size());
+  CHECK_EQ(n_devices, local_start_positions.size());
+  // The position of the leader in `device_ids`, or -1 if no local device is in
+  // the inter-host communicator.
+  int leader = -1;
+  if (inter_iter != local_ids.end()) {
+    TF_RET_CHECK(inter_iter->second.size() == 1)
+        << "A host has at most one device in the inter-host communicator.";
+    auto pos = std::find(device_ids.begin(), device_ids.end(),
+                         inter_iter->second[0]);
+    TF_RET_CHECK(pos != device_ids.end());
+    leader = pos - device_ids.begin();
+  }
+  if (chunk_elements == 0 || chunk_elements > n_elements) {
+    chunk_elements = std::max(n_elements, 1u);
+  }
+
+  TF_ASSIGN_OR_RETURN(
+      ncclDataType_t dtype,
+      ToNcclDataType(buffers[0]->on_device_shape().element_type()));
+  int dtype_size = SizeOfType(dtype);
+  std::vector<std::uintptr_t> buffs(n_devices);
+  for (int i = 0; i < n_devices; ++i) {
+    TF_ASSIGN_OR_RETURN(buffs[i], ToUnsafePointer(buffers[i]));
+    buffs[i] += local_start_positions[i] * dtype_size;
+  }
+
+  int64_t bytes = int64_t{n_elements} * dtype_size;
+  tsl::profiler::TraceMe trace([&] {
+    return tsl::profiler::TraceMeEncode(
+        "CommGroup::NcclBroadcastPipelined",
+        {{"bytes", bytes}, {"chunk_elements", chunk_elements}});
+  });
+  std::vector<se::Stream *> se_streams;
+  if (leader >= 0) {
+    se_streams.push_back(send_streams[device_ids[leader]].get());
+  }
+  for (int i = 0; i < n_devices && intra_iter != local_ids.end(); ++i) {
+    se_streams.push_back(recv_streams[device_ids[i]].get());
+  }
+  auto transfer = StartTransfer(inter_key, inter_root_rank, bytes, se_streams);
+  for (uint offset = 0; offset < n_elements; offset += chunk_elements) {
+    uint count = std::min(chunk_elements, n_elements - offset);
+    std::unique_ptr<se::Event> inter_done;
+    if (leader >= 0) {
+      int device_id = device_ids[leader];
+      void *buff = (void *)(buffs[leader] + offset * dtype_size);
+      auto comm = *comm_map[CommKey(inter_key, device_id)].Acquire();
+      se::Stream *stream = send_streams[device_id].get();
+      XLA_CUDA_RETURN_IF_ERROR(ncclBroadcast(buff, buff, count, dtype,
+                                             inter_root_rank, comm,
+                                             GetCudaStream(stream)));
+      inter_done = std::make_unique<se::Event>(executors[device_id]);
+      TF_RET_CHECK(inter_done->Init());
+      stream->ThenRecordEvent(inter_done.get());
+    }
+    if (intra_iter == local_ids.end()) {
+      continue;
+    }
+    if (inter_done != nullptr) {
+      recv_streams[device_ids[leader]]->ThenWaitFor(inter_done.get());
+    }
+    XLA_CUDA_RETURN_IF_ERROR(ncclGroupStart());
+    for (int i = 0; i < n_devices; ++i) {
+      void *buff = (void *)(buffs[i] + offset * dtype_size);
+      auto comm = *comm_map[CommKey(intra_key, device_ids[i])].Acquire();
+      XLA_CUDA_RETURN_IF_ERROR(
+          ncclBroadcast(buff, buff, count, dtype, intra_root_rank, comm,
+                        GetCudaStream(recv_streams[device_ids[i]].get())));
+    }
+    XLA_CUDA_RETURN_IF_ERROR(ncclGroupEnd());
+  }
+  FinishTransfer(std::move(transfer));
   return OkStatus();
 #else   // XLA_ENABLE_XCCL
   return Unimplemented("NCCL support is not available.");
@@ -253,25 +612,28 @@ Status CommGroup::NcclSendImpl(const AlpaNcclUid &key, PjRtBuffer *buffer,
                                uint start, uint n_elements, int peer_p2p_rank,
                                bool use_default_stream) {
 #if XLA_ENABLE_XCCL
+  TF_RETURN_IF_ERROR(EnsureCommunicators({key}));
   const int device_id = local_ids[key][0];
   TF_ASSIGN_OR_RETURN(ncclDataType_t dtype,
                       ToNcclDataType(buffer->on_device_shape().element_type()));
   int dtype_size = SizeOfType(dtype);
   TF_ASSIGN_OR_RETURN(std::uintptr_t sendbuff, ToUnsafePointer(buffer));
   sendbuff = sendbuff + start * dtype_size;
-  auto comm = *comm_map[std::make_pair(key, device_id)].Acquire();
+  auto comm = *comm_map[CommKey(key, device_id)].Acquire();
   auto stream = use_default_stream
                     ? default_stream
                     : GetCudaStream(send_streams[device_id].get());
-  // ----------------------------------------------------------------------------------------------------
-  int repeat_comm = 1;
-  if (const char* env = std::getenv("ALPA_TEST_REPEAT_COMM"))
-    repeat_comm = std::stoi(env);
-  // ----------------------------------------------------------------------------------------------------
-  for (int _repeat=0; _repeat<repeat_comm; _repeat++)
+  int64_t bytes = int64_t{n_elements} * dtype_size;
+  tsl::profiler::TraceMe trace([&] {
+    return tsl::profiler::TraceMeEncode(
+        "CommGroup::NcclSend", {{"bytes", bytes}, {"peer", peer_p2p_rank}});
+  });
+  auto transfer = StartTransfer(
+      key, peer_p2p_rank, bytes,
+      {use_default_stream ? nullptr : send_streams[device_id].get()});
   XLA_CUDA_RETURN_IF_ERROR(ncclSend((void *)sendbuff, n_elements, dtype,
                                     peer_p2p_rank, comm, stream));
-  // cudaDeviceSynchronize();
+  FinishTransfer(std::move(transfer));
   return OkStatus();
 #else   // XLA_ENABLE_XCCL
   return Unimplemented("NCCL support is not available.");
@@ -282,34 +644,498 @@ Status CommGroup::NcclRecvImpl(const AlpaNcclUid &key, PjRtBuffer *buffer,
                                uint start, uint n_elements, int peer_p2p_rank,
                                bool use_default_stream) {
 #if XLA_ENABLE_XCCL
+  TF_RETURN_IF_ERROR(EnsureCommunicators({key}));
   const int device_id = local_ids[key][0];
   TF_ASSIGN_OR_RETURN(ncclDataType_t dtype,
                       ToNcclDataType(buffer->on_device_shape().element_type()));
   int dtype_size = SizeOfType(dtype);
   TF_ASSIGN_OR_RETURN(std::uintptr_t recvbuff, ToUnsafePointer(buffer));
   recvbuff = recvbuff + start * dtype_size;
-  auto comm = *comm_map[std::make_pair(key, device_id)].Acquire();
+  auto comm = *comm_map[CommKey(key, device_id)].Acquire();
   auto stream = use_default_stream
                     ? default_stream
                     : GetCudaStream(recv_streams[device_id].get());
-  // ----------------------------------------------------------------------------------------------------
-  int repeat_comm = 1;
-  if (const char* env = std::getenv("ALPA_TEST_REPEAT_COMM"))
-    repeat_comm = std::stoi(env);
-  // ----------------------------------------------------------------------------------------------------
-  for (int _repeat=0; _repeat<repeat_comm; _repeat++)
+  int64_t bytes = int64_t{n_elements} * dtype_size;
+  tsl::profiler::TraceMe trace([&] {
+    return tsl::profiler::TraceMeEncode(
+        "CommGroup::NcclRecv", {{"bytes", bytes}, {"peer", peer_p2p_rank}});
+  });
+  auto transfer = StartTransfer(
+      key, peer_p2p_rank, bytes,
+      {use_default_stream ? nullptr : recv_streams[device_id].get()});
   XLA_CUDA_RETURN_IF_ERROR(ncclRecv((void *)recvbuff, n_elements, dtype,
                                     peer_p2p_rank, comm, stream));
-  // cudaDeviceSynchronize();
+  FinishTransfer(std::move(transfer));
   return OkStatus();
 #else   // XLA_ENABLE_XCCL
   return Unimplemented("NCCL support is not available.");
 #endif  // XLA_ENABLE_XCCL
 }
 
+Status CommGroup::NcclSendTileImpl(const AlpaNcclUid &key, PjRtBuffer *buffer,
+                                   const std::vector<int64_t> &tile_offsets,
+                                   const std::vector<int64_t> &tile_shape,
+                                   const std::vector<int64_t> &peer_dims,
+                                   int peer_p2p_rank, bool use_default_stream) {
+#if XLA_ENABLE_XCCL
+  TF_RETURN_IF_ERROR(EnsureCommunicators({key}));
+  const int device_id = local_ids[key][0];
+  const Shape &shape = buffer->on_device_shape();
+  TF_ASSIGN_OR_RETURN(ncclDataType_t dtype,
+                      ToNcclDataType(shape.element_type()));
+  int dtype_size = SizeOfType(dtype);
+  TF_ASSIGN_OR_RETURN(
+      auto chunks,
+      TileToContiguousChunks(shape, tile_offsets, tile_shape, peer_dims));
+  TF_ASSIGN_OR_RETURN(std::uintptr_t sendbuff, ToUnsafePointer(buffer));
+  auto comm = *comm_map[CommKey(key, device_id)].Acquire();
+  auto stream = use_default_stream
+                    ? default_stream
+                    : GetCudaStream(send_streams[device_id].get());
+  int64_t bytes = 0;
+  for (const auto &[start, n_elements] : chunks) {
+    bytes += n_elements * dtype_size;
+  }
+  tsl::profiler::TraceMe trace([&] {
+    return tsl::profiler::TraceMeEncode(
+        "CommGroup::NcclSendTile",
+        {{"bytes", bytes}, {"chunks", chunks.size()}, {"peer", peer_p2p_rank}});
+  });
+  auto transfer = StartTransfer(
+      key, peer_p2p_rank, bytes,
+      {use_default_stream ? nullptr : send_streams[device_id].get()});
+  XLA_CUDA_RETURN_IF_ERROR(ncclGroupStart());
+  for (const auto &[start, n_elements] : chunks) {
+    XLA_CUDA_RETURN_IF_ERROR(
+        ncclSend((void *)(sendbuff + start * dtype_size), n_elements, dtype,
+                 peer_p2p_rank, comm, stream));
+  }
+  XLA_CUDA_RETURN_IF_ERROR(ncclGroupEnd());
+  FinishTransfer(std::move(transfer));
+  return OkStatus();
+#else   // XLA_ENABLE_XCCL
+  return Unimplemented("NCCL support is not available.");
+#endif  // XLA_ENABLE_XCCL
+}
+
+Status CommGroup::NcclRecvTileImpl(const AlpaNcclUid &key, PjRtBuffer *buffer,
+                                   const std::vector<int64_t> &tile_offsets,
+                                   const std::vector<int64_t> &tile_shape,
+                                   const std::vector<int64_t> &peer_dims,
+                                   int peer_p2p_rank, bool use_default_stream) {
+#if XLA_ENABLE_XCCL
+  TF_RETURN_IF_ERROR(EnsureCommunicators({key}));
+  const int device_id = local_ids[key][0];
+  const Shape &shape = buffer->on_device_shape();
+  TF_ASSIGN_OR_RETURN(ncclDataType_t dtype,
+                      ToNcclDataType(shape.element_type()));
+  int dtype_size = SizeOfType(dtype);
+  TF_ASSIGN_OR_RETURN(
+      auto chunks,
+      TileToContiguousChunks(shape, tile_offsets, tile_shape, peer_dims));
+  TF_ASSIGN_OR_RETURN(std::uintptr_t recvbuff, ToUnsafePointer(buffer));
+  auto comm = *comm_map[CommKey(key, device_id)].Acquire();
+  auto stream = use_default_stream
+                    ? default_stream
+                    : GetCudaStream(recv_streams[device_id].get());
+  int64_t bytes = 0;
+  for (const auto &[start, n_elements] : chunks) {
+    bytes += n_elements * dtype_size;
+  }
+  tsl::profiler::TraceMe trace([&] {
+    return tsl::profiler::TraceMeEncode(
+        "CommGroup::NcclRecvTile",
+        {{"bytes", bytes}, {"chunks", chunks.size()}, {"peer", peer_p2p_rank}});
+  });
+  auto transfer = StartTransfer(
+      key, peer_p2p_rank, bytes,
+      {use_default_stream ? nullptr : recv_streams[device_id].get()});
+  XLA_CUDA_RETURN_IF_ERROR(ncclGroupStart());
+  for (const auto &[start, n_elements] : chunks) {
+    XLA_CUDA_RETURN_IF_ERROR(
+        ncclRecv((void *)(recvbuff + start * dtype_size), n_elements, dtype,
+                 peer_p2p_rank, comm, stream));
+  }
+  XLA_CUDA_RETURN_IF_ERROR(ncclGroupEnd());
+  FinishTransfer(std::move(transfer));
+  return OkStatus();
+#else   // XLA_ENABLE_XCCL
+  return Unimplemented("NCCL support is not available.");
+#endif  // XLA_ENABLE_XCCL
+}
+
+// Resharding plan related functions:
+StatusOr<std::shared_ptr<ReshardingPlan>> CommGroup::CompileReshardingPlan(
+    const std::vector<ReshardingTask> &tasks) {
+  auto plan = std::make_shared<ReshardingPlan>();
+  absl::flat_hash_set<std::pair<int, int>> send_stream_buffers;
+  for (const ReshardingTask &task : tasks) {
+    auto iter = local_ids.find(task.key);
+    if (iter == local_ids.end()) {
+      return InvalidArgument("No communicator is created for the task.");
+    }
+    const std::vector<int> &device_ids = iter->second;
+    size_t n_devices =
+        task.kind == ReshardingTask::Kind::kBroadcast ? device_ids.size() : 1;
+    if (task.buffer_indices.size() != n_devices ||
+        task.start_positions.size() != n_devices) {
+      return InvalidArgument(
+          "A resharding task has %d buffers and %d start positions for %d "
+          "devices.",
+          task.buffer_indices.size(), task.start_positions.size(), n_devices);
+    }
+    bool on_send_stream =
+        task.kind == ReshardingTask::Kind::kSend ||
+        (task.kind == ReshardingTask::Kind::kBroadcast &&
+         !task.use_recv_stream);
+    for (size_t i = 0; i < n_devices; ++i) {
+      ReshardingPlan::Op op;
+      op.kind = task.kind;
+      op.device_id = device_ids[i];
+      // If both ends of a send or a recv are local, it runs on the other end
+      // than the peer.
+      if (task.kind != ReshardingTask::Kind::kBroadcast &&
+          device_ids.size() > 1) {
+        auto device = std::find_if(
+            device_ids.begin(), device_ids.end(), [&](int device_id) {
+              return GlobalRank(task.key, device_id) != task.peer_rank;
+            });
+        if (device == device_ids.end()) {
+          return InvalidArgument("The peer rank %d is the only local rank.",
+                                 task.peer_rank);
+        }
+        op.device_id = *device;
+      }
+      op.comm_key = CommKey(task.key, op.device_id);
+      if (std::find(plan->comm_keys.begin(), plan->comm_keys.end(),
+                    op.comm_key.first) == plan->comm_keys.end()) {
+        plan->comm_keys.push_back(op.comm_key.first);
+      }
+      op.buffer_index = task.buffer_indices[i];
+      op.start = task.start_positions[i];
+      op.n_elements = task.n_elements;
+      op.peer_rank = task.peer_rank;
+      if (op.buffer_index < 0) {
+        return InvalidArgument("Invalid buffer index %d.", op.buffer_index);
+      }
+      plan->num_buffers = std::max(plan->num_buffers, op.buffer_index + 1);
+      if (on_send_stream) {
+        if (send_stream_buffers.insert({op.device_id, op.buffer_index})
+                .second) {
+          plan->send_stream_buffers.push_back(
+              {op.device_id, op.buffer_index});
+        }
+        plan->send_stream_ops.push_back(std::move(op));
+      } else {
+        plan->recv_stream_ops.push_back(std::move(op));
+      }
+    }
+  }
+
+  // Turn the sends and recvs between local devices into peer copies. Issued
+  // through nccl, both of them would have to be in one nccl group. The k-th
+  // send of a channel matches its k-th recv, as in nccl.
+  std::vector<ReshardingPlan::Op> send_stream_ops;
+  std::vector<bool> is_peer_copy(plan->recv_stream_ops.size(), false);
+  for (ReshardingPlan::Op &send : plan->send_stream_ops) {
+    const AlpaNcclUid &comm = send.comm_key.first;
+    int rank = send.kind == ReshardingTask::Kind::kSend
+                   ? GlobalRank(comm, send.device_id)
+                   : -1;
+    int recv_index = -1;
+    for (size_t j = 0; j < plan->recv_stream_ops.size() && rank >= 0; ++j) {
+      const ReshardingPlan::Op &recv = plan->recv_stream_ops[j];
+      if (!is_peer_copy[j] && recv.kind == ReshardingTask::Kind::kRecv &&
+          recv.comm_key.first == comm && recv.peer_rank == rank &&
+          GlobalRank(comm, recv.device_id) == send.peer_rank) {
+        recv_index = j;
+        break;
+      }
+    }
+    if (recv_index < 0) {
+      send_stream_ops.push_back(std::move(send));
+      continue;
+    }
+    const ReshardingPlan::Op &recv = plan->recv_stream_ops[recv_index];
+    if (recv.n_elements != send.n_elements) {
+      return InvalidArgument(
+          "A send of %d elements matches a recv of %d elements.",
+          send.n_elements, recv.n_elements);
+    }
+    is_peer_copy[recv_index] = true;
+    ReshardingPlan::PeerCopy copy;
+    copy.comm_key = send.comm_key;
+    copy.src_device_id = send.device_id;
+    copy.src_buffer_index = send.buffer_index;
+    copy.src_start = send.start;
+    copy.dst_device_id = recv.device_id;
+    copy.dst_buffer_index = recv.buffer_index;
+    copy.dst_start = recv.start;
+    copy.n_elements = send.n_elements;
+    copy.peer_rank = send.peer_rank;
+    plan->peer_copies.push_back(std::move(copy));
+  }
+  std::vector<ReshardingPlan::Op> recv_stream_ops;
+  for (size_t j = 0; j < plan->recv_stream_ops.size(); ++j) {
+    if (!is_peer_copy[j]) {
+      recv_stream_ops.push_back(std::move(plan->recv_stream_ops[j]));
+    }
+  }
+  plan->send_stream_ops = std::move(send_stream_ops);
+  plan->recv_stream_ops = std::move(recv_stream_ops);
+  return plan;
+}
+
+Status CommGroup::ExecuteReshardingPlanImpl(
+    const ReshardingPlan &plan, const std::vector<PjRtBuffer *> &buffers,
+    bool use_default_stream) {
+#if XLA_ENABLE_XCCL
+  if (buffers.size() < static_cast<size_t>(plan.num_buffers)) {
+    return InvalidArgument("The resharding plan needs %d buffers, got %d.",
+                           plan.num_buffers, buffers.size());
+  }
+  TF_RETURN_IF_ERROR(EnsureCommunicators(plan.comm_keys));
+  tsl::profiler::TraceMe trace([&] {
+    return tsl::profiler::TraceMeEncode(
+        "CommGroup::ExecuteReshardingPlan",
+        {{"send_stream_ops", plan.send_stream_ops.size()},
+         {"recv_stream_ops", plan.recv_stream_ops.size()},
+         {"peer_copies", plan.peer_copies.size()}});
+  });
+  // The streams are created with the default flags, so a copy on them is also
+  // ordered with the default streams of its devices.
+  for (const ReshardingPlan::PeerCopy &copy : plan.peer_copies) {
+    PjRtBuffer *src = buffers[copy.src_buffer_index];
+    PjRtBuffer *dst = buffers[copy.dst_buffer_index];
+    TF_ASSIGN_OR_RETURN(ncclDataType_t dtype,
+                        ToNcclDataType(src->on_device_shape().element_type()));
+    int dtype_size = SizeOfType(dtype);
+    int64_t bytes = int64_t{copy.n_elements} * dtype_size;
+    TF_ASSIGN_OR_RETURN(std::uintptr_t src_buff, ToUnsafePointer(src));
+    TF_ASSIGN_OR_RETURN(std::uintptr_t dst_buff, ToUnsafePointer(dst));
+    se::DeviceMemoryBase src_memory(
+        (void *)(src_buff + copy.src_start * dtype_size), bytes);
+    se::DeviceMemoryBase dst_memory(
+        (void *)(dst_buff + copy.dst_start * dtype_size), bytes);
+    StartTransfer(copy.comm_key.first, copy.peer_rank, bytes, {});
+    se::Stream *src_stream = send_streams[copy.src_device_id].get();
+    se::Stream *dst_stream = recv_streams[copy.dst_device_id].get();
+    dst_stream->ThenWaitFor(src_stream);
+    dst_stream->ThenMemcpy(&dst_memory, src_memory, bytes);
+    src_stream->ThenWaitFor(dst_stream);
+    if (!dst_stream->ok() || !src_stream->ok()) {
+      return InternalError("Failed to copy %d bytes from device %d to %d.",
+                           bytes, copy.src_device_id, copy.dst_device_id);
+    }
+  }
+  // One nccl group per kind of stream, so that issuing the plan costs a
+  // single group launch instead of one per tile.
+  for (bool on_send_stream : {true, false}) {
+    const std::vector<ReshardingPlan::Op> &ops =
+        on_send_stream ? plan.send_stream_ops : plan.recv_stream_ops;
+    if (ops.empty()) {
+      continue;
+    }
+    auto &streams = on_send_stream ? send_streams : recv_streams;
+    XLA_CUDA_RETURN_IF_ERROR(ncclGroupStart());
+    for (const ReshardingPlan::Op &op : ops) {
+      PjRtBuffer *buffer = buffers[op.buffer_index];
+      TF_ASSIGN_OR_RETURN(
+          ncclDataType_t dtype,
+          ToNcclDataType(buffer->on_device_shape().element_type()));
+      TF_ASSIGN_OR_RETURN(std::uintptr_t buff, ToUnsafePointer(buffer));
+      buff = buff + op.start * SizeOfType(dtype);
+      // The ops of a plan share one nccl group, so they are only counted.
+      StartTransfer(op.comm_key.first, op.peer_rank,
+                    int64_t{op.n_elements} * SizeOfType(dtype), {});
+      auto comm = *comm_map[op.comm_key].Acquire();
+      auto stream = use_default_stream
+                        ? default_stream
+                        : GetCudaStream(streams[op.device_id].get());
+      switch (op.kind) {
+        case ReshardingTask::Kind::kSend:
+          XLA_CUDA_RETURN_IF_ERROR(ncclSend((void *)buff, op.n_elements, dtype,
+                                            op.peer_rank, comm, stream));
+          break;
+        case ReshardingTask::Kind::kRecv:
+          XLA_CUDA_RETURN_IF_ERROR(ncclRecv((void *)buff, op.n_elements, dtype,
+                                            op.peer_rank, comm, stream));
+          break;
+        case ReshardingTask::Kind::kBroadcast:
+          XLA_CUDA_RETURN_IF_ERROR(
+              ncclBroadcast((void *)buff, (void *)buff, op.n_elements, dtype,
+                            op.peer_rank, comm, stream));
+          break;
+      }
+    }
+    XLA_CUDA_RETURN_IF_ERROR(ncclGroupEnd());
+  }
+  return OkStatus();
+#else   // XLA_ENABLE_XCCL
+  return Unimplemented("NCCL support is not available.");
+#endif  // XLA_ENABLE_XCCL
+}
+
+StatusOr<std::vector<ReshardingTask>> TileReshardingTasks(
+    ReshardingTask::Kind kind, const AlpaNcclUid &key,
+    const std::vector<int> &buffer_indices,
+    const std::vector<std::vector<int64_t>> &buffer_dims,
+    const std::vector<std::vector<int64_t>> &tile_offsets,
+    const std::vector<int64_t> &tile_shape,
+    const std::vector<std::vector<int64_t>> &all_dims, int peer_rank,
+    bool use_recv_stream) {
+  if (buffer_dims.size() != buffer_indices.size() ||
+      tile_offsets.size() != buffer_indices.size()) {
+    return InvalidArgument(
+        "Got %d buffers, %d buffer dims and %d tile offsets.",
+        buffer_indices.size(), buffer_dims.size(), tile_offsets.size());
+  }
+  // A dim of the tile can only be merged if it is covered in every buffer.
+  // TileToContiguousChunks merges the dims whose peer dim is the tile dim.
+  const int64_t rank = tile_shape.size();
+  std::vector<int64_t> peer_dims = tile_shape;
+  for (const std::vector<int64_t> &dims : all_dims) {
+    if (static_cast<int64_t>(dims.size()) != rank) {
+      return InvalidArgument("The buffers must have the rank of the tile.");
+    }
+    for (int64_t d = 0; d < rank; ++d) {
+      if (dims[d] != tile_shape[d]) {
+        peer_dims[d] = -1;
+      }
+    }
+  }
+
+  std::vector<std::vector<std::pair<int64_t, int64_t>>> chunks;
+  for (size_t i = 0; i < buffer_indices.size(); ++i) {
+    // Only the dims of the shape are used.
+    Shape shape = ShapeUtil::MakeShape(U8, buffer_dims[i]);
+    TF_ASSIGN_OR_RETURN(
+        auto buffer_chunks,
+        TileToContiguousChunks(shape, tile_offsets[i], tile_shape, peer_dims));
+    if (!chunks.empty() && buffer_chunks.size() != chunks[0].size()) {
+      return InvalidArgument(
+          "The tile is split into %d chunks in one buffer and %d in another.",
+          chunks[0].size(), buffer_chunks.size());
+    }
+    chunks.push_back(std::move(buffer_chunks));
+  }
+
+  std::vector<ReshardingTask> tasks;
+  for (size_t c = 0; !chunks.empty() && c < chunks[0].size(); ++c) {
+    ReshardingTask task;
+    task.kind = kind;
+    task.key = key;
+    task.buffer_indices = buffer_indices;
+    for (const auto &buffer_chunks : chunks) {
+      task.start_positions.push_back(buffer_chunks[c].first);
+    }
+    task.n_elements = chunks[0][c].second;
+    task.peer_rank = peer_rank;
+    task.use_recv_stream = use_recv_stream;
+    tasks.push_back(std::move(task));
+  }
+  return tasks;
+}
+
+// Instrumentation functions:
+std::unique_ptr<CommGroup::TimedTransfer> CommGroup::StartTransfer(
+    const AlpaNcclUid &key, int peer, int64_t bytes,
+    std::vector<se::Stream *> streams) {
+  bool timing;
+  {
+    absl::MutexLock lock(&stats_mu_);
+    CommTransferCounter &counter = transfer_stats_[std::make_pair(key, peer)];
+    ++counter.num_calls;
+    counter.bytes += bytes;
+    timing = transfer_timing_;
+  }
+  streams.erase(std::remove(streams.begin(), streams.end(), nullptr),
+                streams.end());
+  if (!timing || streams.empty()) {
+    return nullptr;
+  }
+  auto transfer = std::make_unique<TimedTransfer>();
+  transfer->key = std::make_pair(key, peer);
+  for (se::Stream *stream : streams) {
+    auto timer = std::make_unique<se::Timer>(stream->parent());
+    stream->InitTimer(timer.get()).ThenStartTimer(timer.get());
+    transfer->timers.push_back(std::move(timer));
+  }
+  transfer->streams = std::move(streams);
+  return transfer;
+}
+
+void CommGroup::FinishTransfer(std::unique_ptr<TimedTransfer> transfer) {
+  if (transfer == nullptr) {
+    return;
+  }
+  for (size_t i = 0; i < transfer->streams.size(); ++i) {
+    se::Stream *stream = transfer->streams[i];
+    stream->ThenStopTimer(transfer->timers[i].get());
+    auto done = std::make_unique<se::Event>(stream->parent());
+    if (!done->Init()) {
+      LOG(WARNING) << "Failed to create the event of a timed transfer.";
+      return;
+    }
+    stream->ThenRecordEvent(done.get());
+    transfer->done.push_back(std::move(done));
+  }
+  absl::MutexLock lock(&stats_mu_);
+  CollectTimedTransfers();
+  timed_transfers_.push_back(std::move(transfer));
+}
+
+void CommGroup::CollectTimedTransfers() {
+  std::vector<std::unique_ptr<TimedTransfer>> running;
+  for (std::unique_ptr<TimedTransfer> &transfer : timed_transfers_) {
+    bool done = true, failed = false;
+    for (const auto &event : transfer->done) {
+      se::Event::Status status = event->PollForStatus();
+      done &= status != se::Event::Status::kPending;
+      failed |= status != se::Event::Status::kPending &&
+                status != se::Event::Status::kComplete;
+    }
+    if (!done) {
+      running.push_back(std::move(transfer));
+      continue;
+    }
+    if (failed) {
+      continue;
+    }
+    uint64_t microseconds = 0;
+    for (const auto &timer : transfer->timers) {
+      microseconds = std::max(microseconds, timer->Microseconds());
+    }
+    CommTransferCounter &counter = transfer_stats_[transfer->key];
+    ++counter.num_timed;
+    counter.seconds += microseconds * 1e-6;
+  }
+  timed_transfers_ = std::move(running);
+}
+
+void CommGroup::SetTransferTiming(bool timing) {
+  absl::MutexLock lock(&stats_mu_);
+  transfer_timing_ = timing;
+}
+
+absl::flat_hash_map<std::pair<AlpaNcclUid, int>, CommTransferCounter>
+CommGroup::GetTransferStats() {
+  absl::MutexLock lock(&stats_mu_);
+  CollectTimedTransfers();
+  return transfer_stats_;
+}
+
+void CommGroup::ResetTransferStats() {
+  absl::MutexLock lock(&stats_mu_);
+  transfer_stats_.clear();
+  timed_transfers_.clear();
+}
+
 // Other function
-NcclComm::Lock CommGroup::AcquireComm(const AlpaNcclUid &key, int device_id) {
-  return comm_map[std::make_pair(key, device_id)].Acquire();
+StatusOr<NcclComm::Lock> CommGroup::AcquireComm(const AlpaNcclUid &key,
+                                                int device_id) {
+  TF_RETURN_IF_ERROR(EnsureCommunicators({key}));
+  return comm_map[CommKey(key, device_id)].Acquire();
 }
 
 // Cross-mesh allreduce thunk related
@@ -318,7 +1144,7 @@ void SetCommGroup(std::string key, std::shared_ptr<CommGroup> g,
   cross_mesh_comms.emplace(key, std::make_pair(g, uid));
 }
 
-NcclComm::Lock GetCommunicator(std::string key, size_t device_id) {
+StatusOr<NcclComm::Lock> GetCommunicator(std::string key, size_t device_id) {
   CrossMeshCommInfo &info = cross_mesh_comms.at(key);
   return info.first->AcquireComm(info.second, device_id);
 }
@@ -24,6 +24,12 @@ limitations under the License.
 #include "third_party/nccl/nccl.h"
 #endif
 
+#include <optional>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "tensorflow/compiler/xla/pjrt/pjrt_stream_executor_client.h"
 #include "tensorflow/compiler/xla/service/gpu/nccl_utils.h"
 #include "tensorflow/compiler/xla/service/rendezvous.h"
@@ -34,17 +40,120 @@ namespace alpa {
 using AlpaNcclUid = std::vector<int8_t>;
 using AlpaUuids = std::vector<int>;
 
+// One send, recv or broadcast of a cross-mesh resharding.
+struct ReshardingTask {
+  enum class Kind { kSend, kRecv, kBroadcast };
+  Kind kind;
+  // The nccl uid of the communicator.
+  AlpaNcclUid key;
+  // The buffer (an index into the buffers passed to ExecuteReshardingPlan)
+  // and the element offset in it of every local device of the communicator,
+  // in the order of the device ids the communicator is created with. Send
+  // and recv tasks have exactly one entry.
+  std::vector<int> buffer_indices;
+  std::vector<uint> start_positions;
+  uint n_elements;
+  // The peer rank of a send or a recv, or the root rank of a broadcast.
+  int peer_rank;
+  // Broadcast only: issue on the recv streams instead of the send streams.
+  bool use_recv_stream = false;
+};
+
+// A list of resharding tasks compiled against the communicators of a
+// CommGroup. The tasks of each kind of stream are issued in one nccl group.
+struct ReshardingPlan {
+  struct Op {
+    ReshardingTask::Kind kind;
+    std::pair<AlpaNcclUid, int> comm_key;
+    int device_id;
+    int buffer_index;
+    uint start;
+    uint n_elements;
+    int peer_rank;
+  };
+  // The communicators used by the ops, initialized before the plan is issued.
+  std::vector<AlpaNcclUid> comm_keys;
+  // A send and the matching recv between two local devices of a clique,
+  // issued as a device-to-device copy on the recv stream of the destination
+  // instead of nccl p2p. The streams of both ends wait for each other around
+  // the copy, so the buffers are synchronized as for a send and a recv.
+  struct PeerCopy {
+    std::pair<AlpaNcclUid, int> comm_key;
+    int src_device_id;
+    int src_buffer_index;
+    uint src_start;
+    int dst_device_id;
+    int dst_buffer_index;
+    uint dst_start;
+    uint n_elements;
+    // The rank of the destination.
+    int peer_rank;
+  };
+  std::vector<Op> send_stream_ops;
+  std::vector<Op> recv_stream_ops;
+  std::vector<PeerCopy> peer_copies;
+  // The distinct (device id, buffer index) pairs read on the send streams.
+  std::vector<std::pair<int, int>> send_stream_buffers;
+  int num_buffers = 0;
+};
+
+// Split a send, recv or broadcast of an N-d tile of row-major buffers into one
+// task per contiguous chunk of the tile, so that all tiles of a resharding,
+// e.g., the transfers planned by gpu::PlanResharding, are issued together by
+// one ReshardingPlan. `buffer_indices`, `buffer_dims` and `tile_offsets`
+// follow the local devices of the task as in ReshardingTask. `all_dims` are
+// the dims of the buffers of all ranks taking part, including the remote
+// ones. Trailing dims are only merged into one chunk if the tile covers them
+// in all of these buffers, so that every rank splits the tile the same way.
+StatusOr<std::vector<ReshardingTask>> TileReshardingTasks(
+    ReshardingTask::Kind kind, const AlpaNcclUid &key,
+    const std::vector<int> &buffer_indices,
+    const std::vector<std::vector<int64_t>> &buffer_dims,
+    const std::vector<std::vector<int64_t>> &tile_offsets,
+    const std::vector<int64_t> &tile_shape,
+    const std::vector<std::vector<int64_t>> &all_dims, int peer_rank,
+    bool use_recv_stream = false);
+
+// The traffic of the operations of a CommGroup on one (clique, peer rank).
+struct CommTransferCounter {
+  int64_t num_calls = 0;
+  int64_t bytes = 0;
+  // The operations timed with the timers on their streams, and their total
+  // time. An operation on several streams takes the longest of them.
+  int64_t num_timed = 0;
+  double seconds = 0;
+};
+
 class CommGroup {
  public:
   CommGroup(PjRtStreamExecutorClient *client);
   // Communicator related functions:
+  // Create the communicators of the local devices `device_ids` in the clique
+  // of `nccl_uid_vec`. With `lazy`, the blocking ncclCommInitRank is deferred
+  // to the first operation on the clique.
+  // A non-empty `device_set_key` names the global devices and ranks of the
+  // clique. A clique whose key was seen before reuses the communicators of
+  // the earlier clique instead of creating new ones, so all ranks of the
+  // clique must pass the same key.
   Status NcclCreateCommunicators(int world_size,
                                  const std::vector<int> &device_global_ranks,
                                  const std::vector<int> &device_ids,
-                                 const AlpaNcclUid &nccl_uid_vec);
+                                 const AlpaNcclUid &nccl_uid_vec,
+                                 bool lazy = false,
+                                 const std::string &device_set_key = "");
 
   Status NcclDestroyComms(const AlpaNcclUid &storage);
 
+  // Lend the communicators of the local devices in the clique of `key` to
+  // the collectives of XLA executables over the same devices, so that they do
+  // not create communicators of their own. `global_device_ids` are the global
+  // ids of the devices of all ranks, in rank order. Lazily created
+  // communicators are initialized first, so all ranks call this together.
+  // The caller orders the operations of the group on the clique with the
+  // executables, as for the other operations on the compute streams.
+  Status NcclShareCommsWithXla(const AlpaNcclUid &key,
+                               const std::vector<int> &global_device_ids);
+
   // Communication operations:
   Status NcclLocalAllGatherImpl(const AlpaNcclUid &key,
                                 std::vector<PjRtBuffer *> buffers,
@@ -59,6 +168,21 @@ class CommGroup {
                                       bool use_recv_stream,
                                       bool use_default_stream);
 
+  // A two-level broadcast pipelined over chunks of `chunk_elements`. The
+  // chunks are broadcast over `inter_key` (the root and one leader device per
+  // receiving host) on the send streams, and each chunk is then fanned out
+  // from the leader over `intra_key` (the local devices) on the recv
+  // streams, so the fan-out of a chunk overlaps the inter-host hop of the
+  // next one. `buffers` and `local_start_positions` follow the device order of
+  // `intra_key`, or contain only the root device on the host of the root,
+  // which has no `intra_key` communicator.
+  Status NcclBroadcastPipelinedImpl(const AlpaNcclUid &inter_key,
+                                    const AlpaNcclUid &intra_key,
+                                    std::vector<PjRtBuffer *> buffers,
+                                    std::vector<uint> local_start_positions,
+                                    uint n_elements, int inter_root_rank,
+                                    int intra_root_rank, uint chunk_elements);
+
   Status NcclSendImpl(const AlpaNcclUid &key, PjRtBuffer *buffer, uint start,
                       uint n_elements, int peer_p2p_rank,
                       bool use_default_stream);
@@ -67,8 +191,48 @@ class CommGroup {
                       uint n_elements, int peer_p2p_rank,
                       bool use_default_stream);
 
+  // Send or recv an N-d tile of a row-major buffer without packing it into
+  // a temporary buffer. The tile is issued as contiguous chunks in one nccl
+  // group. Trailing dims that the tile covers fully in both the local and the
+  // peer buffer are merged into one chunk, so both sides split the tile in
+  // the same way. `peer_dims` is the shape of the buffer on the peer.
+  Status NcclSendTileImpl(const AlpaNcclUid &key, PjRtBuffer *buffer,
+                          const std::vector<int64_t> &tile_offsets,
+                          const std::vector<int64_t> &tile_shape,
+                          const std::vector<int64_t> &peer_dims,
+                          int peer_p2p_rank, bool use_default_stream);
+
+  Status NcclRecvTileImpl(const AlpaNcclUid &key, PjRtBuffer *buffer,
+                          const std::vector<int64_t> &tile_offsets,
+                          const std::vector<int64_t> &tile_shape,
+                          const std::vector<int64_t> &peer_dims,
+                          int peer_p2p_rank, bool use_default_stream);
+
+  // Resharding plan related functions:
+  StatusOr<std::shared_ptr<ReshardingPlan>> CompileReshardingPlan(
+      const std::vector<ReshardingTask> &tasks);
+
+  Status ExecuteReshardingPlanImpl(const ReshardingPlan &plan,
+                                   const std::vector<PjRtBuffer *> &buffers,
+                                   bool use_default_stream);
+
+  // Instrumentation functions:
+  // Every operation is annotated with a TraceMe and counted per (clique, peer
+  // rank). The peer of a broadcast is its root, and the peer of an all-gather
+  // is -1. With `timing`, the operations that are not issued on the default
+  // stream are also timed on their streams.
+  void SetTransferTiming(bool timing);
+
+  // The counters since the last reset. A timed operation that is still
+  // running is only counted as timed by a later call.
+  absl::flat_hash_map<std::pair<AlpaNcclUid, int>, CommTransferCounter>
+  GetTransferStats();
+
+  void ResetTransferStats();
+
   // Other functions
-  NcclComm::Lock AcquireComm(const AlpaNcclUid &uuids, int device_id);
+  StatusOr<NcclComm::Lock> AcquireComm(const AlpaNcclUid &uuids,
+                                       int device_id);
 
  protected:
   std::vector<std::unique_ptr<se::Stream>> send_streams, recv_streams;
@@ -76,15 +240,77 @@ class CommGroup {
   std::vector<se::StreamExecutor *> executors;
   PjRtStreamExecutorClient *client_;
 
+  // The key of the communicators of a local device in the clique of `key`,
+  // which may be shared with another clique of the same device set.
+  std::pair<AlpaNcclUid, int> CommKey(const AlpaNcclUid &key, int device_id);
+
+  // The global rank of a local device in the clique of `key`, or -1.
+  int GlobalRank(const AlpaNcclUid &key, int device_id);
+
+  // Initialize the lazily created communicators of the cliques in one nccl
+  // group.
+  Status EnsureCommunicators(const std::vector<AlpaNcclUid> &keys);
+
+  // An operation being timed on its streams.
+  struct TimedTransfer {
+    std::pair<AlpaNcclUid, int> key;
+    std::vector<se::Stream *> streams;
+    std::vector<std::unique_ptr<se::Timer>> timers;
+    std::vector<std::unique_ptr<se::Event>> done;
+  };
+
+  // Count an operation of `bytes` and, if the timing is enabled, start its
+  // timers on the non-null `streams`. Returns null if it is not timed.
+  std::unique_ptr<TimedTransfer> StartTransfer(
+      const AlpaNcclUid &key, int peer, int64_t bytes,
+      std::vector<se::Stream *> streams);
+
+  // Stop the timers after the nccl calls of the operation are issued.
+  void FinishTransfer(std::unique_ptr<TimedTransfer> transfer);
+
  private:
+  // The arguments of the communicators created with a clique.
+  struct CommSpec {
+    int world_size;
+    std::vector<int> device_global_ranks;
+    std::vector<int> device_ids;
+    std::string device_set_key;
+    // The number of cliques that use the communicators.
+    int num_users = 0;
+    bool initialized = false;
+    // The clique under which the communicators are lent to XLA collectives.
+    std::optional<NcclCliqueKey> xla_clique;
+  };
+
   ThreadSafeMap<std::pair<AlpaNcclUid, int>, NcclComm> comm_map;
+  // Serializes the initialization of communicators.
+  absl::Mutex init_mu_;
+  absl::Mutex comms_mu_;
+  // Keyed by the cliques whose communicators are in comm_map.
+  absl::flat_hash_map<AlpaNcclUid, CommSpec> comm_specs_
+      ABSL_GUARDED_BY(comms_mu_);
+  // Maps every created clique to the clique whose communicators it uses.
+  absl::flat_hash_map<AlpaNcclUid, AlpaNcclUid> comm_aliases_
+      ABSL_GUARDED_BY(comms_mu_);
+  absl::flat_hash_map<std::string, AlpaNcclUid> device_set_comms_
+      ABSL_GUARDED_BY(comms_mu_);
+
+  // Add the time of the timed operations that are done to their counters.
+  void CollectTimedTransfers() ABSL_EXCLUSIVE_LOCKS_REQUIRED(stats_mu_);
+
+  absl::Mutex stats_mu_;
+  bool transfer_timing_ ABSL_GUARDED_BY(stats_mu_) = false;
+  absl::flat_hash_map<std::pair<AlpaNcclUid, int>, CommTransferCounter>
+      transfer_stats_ ABSL_GUARDED_BY(stats_mu_);
+  std::vector<std::unique_ptr<TimedTransfer>> timed_transfers_
+      ABSL_GUARDED_BY(stats_mu_);
 };
 
 // Cross-mesh allreduce thunk related
 void SetCommGroup(std::string key, std::shared_ptr<CommGroup> g,
                   const AlpaNcclUid &uid);
 
-NcclComm::Lock GetCommunicator(std::string key, size_t device_id);
+StatusOr<NcclComm::Lock> GetCommunicator(std::string key, size_t device_id);
 
 // Other functions
 ncclUniqueId NcclUidDeserialize(const AlpaNcclUid &nccl_uid_chars);
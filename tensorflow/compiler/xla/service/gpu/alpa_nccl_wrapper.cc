@@ -109,6 +109,40 @@ Status PyCommGroup::NcclBroadcastPartialGPUs(
 #endif  // XLA_ENABLE_XCCL
 }
 
+Status PyCommGroup::NcclBroadcastPipelined(
+    const AlpaNcclUid &inter_key, const AlpaNcclUid &intra_key,
+    std::vector<PyBuffer::object> buffers,
+    std::vector<uint> local_start_positions, uint n_elements,
+    int inter_root_rank, int intra_root_rank, uint chunk_elements) {
+#if XLA_ENABLE_XCCL
+  std::vector<PjRtBuffer *> pjrt_buffers;
+  for (PyBuffer::object &buf : buffers) {
+    pjrt_buffers.push_back(buf.buf()->buffer());
+  }
+  TF_RETURN_IF_ERROR(NcclBroadcastPipelinedImpl(
+      inter_key, intra_key, pjrt_buffers, local_start_positions, n_elements,
+      inter_root_rank, intra_root_rank, chunk_elements));
+
+  // The buffer of the leader is read on its send stream.
+  auto inter_iter = local_ids.find(inter_key);
+  if (inter_iter != local_ids.end()) {
+    int leader_id = inter_iter->second[0];
+    auto intra_iter = local_ids.find(intra_key);
+    const std::vector<int> &device_ids = intra_iter != local_ids.end()
+                                             ? intra_iter->second
+                                             : inter_iter->second;
+    for (size_t i = 0; i < device_ids.size(); ++i) {
+      if (device_ids[i] == leader_id) {
+        AddCallBackReleasingBuffer(send_streams[leader_id].get(), buffers[i]);
+      }
+    }
+  }
+  return OkStatus();
+#else   // XLA_ENABLE_XCCL
+  return Unimplemented("NCCL support is not available.");
+#endif  // XLA_ENABLE_XCCL
+}
+
 Status PyCommGroup::NcclSend(const AlpaNcclUid &key, PyBuffer::object buffer,
                              uint start, uint n_elements, int peer_p2p_rank,
                              bool use_default_stream) {
@@ -139,6 +173,67 @@ Status PyCommGroup::NcclRecv(const AlpaNcclUid &key, PyBuffer::object buffer,
 #endif  // XLA_ENABLE_XCCL
 }
 
+Status PyCommGroup::NcclSendTile(const AlpaNcclUid &key,
+                                 PyBuffer::object buffer,
+                                 std::vector<int64_t> tile_offsets,
+                                 std::vector<int64_t> tile_shape,
+                                 std::vector<int64_t> peer_dims,
+                                 int peer_p2p_rank, bool use_default_stream) {
+#if XLA_ENABLE_XCCL
+  const int device_id = local_ids[key][0];
+  TF_RETURN_IF_ERROR(NcclSendTileImpl(key, buffer.buf()->buffer(),
+                                      tile_offsets, tile_shape, peer_dims,
+                                      peer_p2p_rank, use_default_stream));
+  if (!use_default_stream) {
+    AddCallBackReleasingBuffer(send_streams[device_id].get(), buffer);
+  }
+  return OkStatus();
+#else   // XLA_ENABLE_XCCL
+  return Unimplemented("NCCL support is not available.");
+#endif  // XLA_ENABLE_XCCL
+}
+
+Status PyCommGroup::NcclRecvTile(const AlpaNcclUid &key,
+                                 PyBuffer::object buffer,
+                                 std::vector<int64_t> tile_offsets,
+                                 std::vector<int64_t> tile_shape,
+                                 std::vector<int64_t> peer_dims,
+                                 int peer_p2p_rank, bool use_default_stream) {
+#if XLA_ENABLE_XCCL
+  TF_RETURN_IF_ERROR(NcclRecvTileImpl(key, buffer.buf()->buffer(),
+                                      tile_offsets, tile_shape, peer_dims,
+                                      peer_p2p_rank, use_default_stream));
+  return OkStatus();
+#else   // XLA_ENABLE_XCCL
+  return Unimplemented("NCCL support is not available.");
+#endif  // XLA_ENABLE_XCCL
+}
+
+Status PyCommGroup::ExecuteReshardingPlan(const ReshardingPlan &plan,
+                                          std::vector<PyBuffer::object> buffers,
+                                          bool use_default_stream) {
+#if XLA_ENABLE_XCCL
+  std::vector<PjRtBuffer *> pjrt_buffers;
+  for (PyBuffer::object &buf : buffers) {
+    pjrt_buffers.push_back(buf.buf()->buffer());
+  }
+  {
+    pybind11::gil_scoped_release gil_release;
+    TF_RETURN_IF_ERROR(
+        ExecuteReshardingPlanImpl(plan, pjrt_buffers, use_default_stream));
+  }
+  if (!use_default_stream) {
+    for (const auto &[device_id, buffer_index] : plan.send_stream_buffers) {
+      AddCallBackReleasingBuffer(send_streams[device_id].get(),
+                                 buffers[buffer_index]);
+    }
+  }
+  return OkStatus();
+#else   // XLA_ENABLE_XCCL
+  return Unimplemented("NCCL support is not available.");
+#endif  // XLA_ENABLE_XCCL
+}
+
 // Sync functions:
 Status PyCommGroup::CommunicatorRecordEvents(const AlpaUuids &uuids,
                                              int num_devices, bool is_send) {
@@ -149,9 +244,7 @@ Status PyCommGroup::CommunicatorRecordEvents(const AlpaUuids &uuids,
     se::Stream *stream =
         is_send ? send_streams[device_id].get() : recv_streams[device_id].get();
     for (int uuid : uuids) {
-      se::Event *event = SetEvent(uuid, device_id, executors[device_id]);
-      TF_RET_CHECK(event->Init());
-      stream->ThenRecordEvent(event);
+      TF_RETURN_IF_ERROR(SetEvent(uuid, device_id, stream));
     }
   }
   return OkStatus();
@@ -52,12 +52,38 @@ class PyCommGroup : public CommGroup {
                                   bool use_recv_stream,
                                   bool use_default_stream);
 
+  Status NcclBroadcastPipelined(const AlpaNcclUid &inter_key,
+                                const AlpaNcclUid &intra_key,
+                                std::vector<PyBuffer::object> buffers,
+                                std::vector<uint> local_start_positions,
+                                uint n_elements, int inter_root_rank,
+                                int intra_root_rank, uint chunk_elements);
+
   Status NcclSend(const AlpaNcclUid &key, PyBuffer::object buffer, uint start,
                   uint n_elements, int peer_p2p_rank, bool use_default_stream);
 
   Status NcclRecv(const AlpaNcclUid &key, PyBuffer::object buffer, uint start,
                   uint n_elements, int peer_p2p_rank, bool use_default_stream);
 
+  Status NcclSendTile(const AlpaNcclUid &key, PyBuffer::object buffer,
+                      std::vector<int64_t> tile_offsets,
+                      std::vector<int64_t> tile_shape,
+                      std::vector<int64_t> peer_dims, int peer_p2p_rank,
+                      bool use_default_stream);
+
+  Status NcclRecvTile(const AlpaNcclUid &key, PyBuffer::object buffer,
+                      std::vector<int64_t> tile_offsets,
+                      std::vector<int64_t> tile_shape,
+                      std::vector<int64_t> peer_dims, int peer_p2p_rank,
+                      bool use_default_stream);
+
+  // Issue all tasks of a compiled resharding plan with one nccl group per
+  // kind of stream. This replaces one NcclSend/NcclRecv/
+  // NcclBroadcastPartialGPUs call per tile.
+  Status ExecuteReshardingPlan(const ReshardingPlan &plan,
+                               std::vector<PyBuffer::object> buffers,
+                               bool use_default_stream);
+
   // Sync functions:
   Status CommunicatorRecordEvents(const AlpaUuids &uuids, int num_devices,
                                   bool is_send);
@@ -0,0 +1,298 @@
+// This file implements the C++ executor of Alpa's pipeshard instructions.
+#include "tensorflow/compiler/xla/service/gpu/alpa_pipeline_executor.h"
+
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/fingerprint.h"
+#include "tensorflow/tsl/profiler/lib/context_types.h"
+#include "tensorflow/tsl/profiler/lib/traceme.h"
+#include "tensorflow/tsl/profiler/lib/traceme_encode.h"
+
+namespace xla {
+namespace gpu {
+namespace alpa {
+
+PipelineExecutor::PipelineExecutor(std::shared_ptr<PyClient> client)
+    : client_(std::move(client)) {}
+
+int PipelineExecutor::AddExecutable(
+    std::shared_ptr<PyLoadedExecutable> executable) {
+  executables_.push_back(std::move(executable));
+  return executables_.size() - 1;
+}
+
+int PipelineExecutor::AddCommGroup(std::shared_ptr<PyCommGroup> comm_group) {
+  comm_groups_.push_back(std::move(comm_group));
+  return comm_groups_.size() - 1;
+}
+
+int PipelineExecutor::AddReshardingPlan(std::shared_ptr<ReshardingPlan> plan) {
+  plans_.push_back(std::move(plan));
+  return plans_.size() - 1;
+}
+
+StatusOr<int> PipelineExecutor::AddInstructionList(
+    std::vector<PipelineInstruction> instructions) {
+  using Kind = PipelineInstruction::Kind;
+  for (int i = 0; i < instructions.size(); ++i) {
+    const PipelineInstruction &instruction = instructions[i];
+    auto in_range = [](int index, size_t size) {
+      return index >= 0 && static_cast<size_t>(index) < size;
+    };
+    switch (instruction.kind) {
+      case Kind::kRun:
+        if (!in_range(instruction.executable, executables_.size())) {
+          return InvalidArgument("Instruction %d runs unknown executable %d",
+                                 i, instruction.executable);
+        }
+        break;
+      case Kind::kSend:
+      case Kind::kRecv:
+        if (instruction.input_uuids.size() != 1) {
+          return InvalidArgument(
+              "Instruction %d transfers %d buffers instead of one", i,
+              instruction.input_uuids.size());
+        }
+        [[fallthrough]];
+      case Kind::kReshard:
+      case Kind::kRecordEvents:
+        if (!in_range(instruction.comm_group, comm_groups_.size())) {
+          return InvalidArgument("Instruction %d uses unknown comm group %d",
+                                 i, instruction.comm_group);
+        }
+        if (instruction.kind == Kind::kReshard &&
+            !in_range(instruction.plan, plans_.size())) {
+          return InvalidArgument(
+              "Instruction %d issues unknown resharding plan %d", i,
+              instruction.plan);
+        }
+        break;
+      case Kind::kWaitEvents:
+        if (instruction.comm_group != -1 &&
+            !in_range(instruction.comm_group, comm_groups_.size())) {
+          return InvalidArgument("Instruction %d uses unknown comm group %d",
+                                 i, instruction.comm_group);
+        }
+        break;
+      case Kind::kFree:
+        break;
+    }
+  }
+  instruction_lists_.push_back(std::move(instructions));
+  return instruction_lists_.size() - 1;
+}
+
+void PipelineExecutor::PutBuffers(int64_t uuid,
+                                  std::vector<PyBuffer::object> buffers) {
+  buffers_[uuid] = std::move(buffers);
+}
+
+StatusOr<std::vector<PyBuffer::object>> PipelineExecutor::GetBuffers(
+    int64_t uuid) const {
+  TF_ASSIGN_OR_RETURN(const std::vector<PyBuffer::object> *buffers,
+                      LookupBuffers(uuid));
+  return *buffers;
+}
+
+void PipelineExecutor::DeleteBuffers(const std::vector<int64_t> &uuids) {
+  for (int64_t uuid : uuids) {
+    buffers_.erase(uuid);
+  }
+}
+
+StatusOr<const std::vector<PyBuffer::object> *>
+PipelineExecutor::LookupBuffers(int64_t uuid) const {
+  auto it = buffers_.find(uuid);
+  if (it == buffers_.end()) {
+    return NotFound("No buffers for uuid %d", uuid);
+  }
+  return &it->second;
+}
+
+namespace {
+
+// Returns the TraceMe name of the instructions that do work on the devices,
+// or nullptr for bookkeeping instructions, which are not traced.
+const char *TraceMeName(PipelineInstruction::Kind kind) {
+  using Kind = PipelineInstruction::Kind;
+  switch (kind) {
+    case Kind::kRun:
+      return "PipelineRun";
+    case Kind::kSend:
+      return "PipelineSend";
+    case Kind::kRecv:
+      return "PipelineRecv";
+    case Kind::kReshard:
+      return "PipelineReshard";
+    default:
+      return nullptr;
+  }
+}
+
+// Encodes the pipeline annotations of `instruction` for the profiler. A send
+// and its recv are connected as producer and consumer of a transfer, keyed
+// by the nccl uid of the communicator, the stage, the microbatch and the
+// slice of the buffer.
+std::string InstructionTraceMe(const char *name,
+                               const PipelineInstruction &instruction) {
+  using Kind = PipelineInstruction::Kind;
+  std::string trace = tsl::profiler::TraceMeEncode(
+      name, {{"pipeline_stage", instruction.stage},
+             {"microbatch", instruction.microbatch}});
+  if (instruction.kind != Kind::kSend && instruction.kind != Kind::kRecv) {
+    return trace;
+  }
+  const uint64_t comm_key = tsl::Fingerprint64(absl::string_view(
+      reinterpret_cast<const char *>(instruction.key.data()),
+      instruction.key.size()));
+  const uint64_t transfer_id = tsl::FingerprintCat64(
+      tsl::FingerprintCat64(comm_key, tsl::Fingerprint64(instruction.stage)),
+      tsl::FingerprintCat64(
+          instruction.microbatch,
+          (static_cast<uint64_t>(instruction.start) << 32) |
+              instruction.n_elements));
+  const int context_type =
+      static_cast<int>(tsl::profiler::ContextType::kAlpaPipelineTransfer);
+  if (instruction.kind == Kind::kSend) {
+    tsl::profiler::traceme_internal::AppendMetadata(
+        &trace, tsl::profiler::TraceMeEncode({{"comm_key", comm_key},
+                                              {"peer_rank",
+                                               instruction.peer_rank},
+                                              {"_pt", context_type},
+                                              {"_p", transfer_id}}));
+  } else {
+    tsl::profiler::traceme_internal::AppendMetadata(
+        &trace, tsl::profiler::TraceMeEncode({{"comm_key", comm_key},
+                                              {"peer_rank",
+                                               instruction.peer_rank},
+                                              {"_ct", context_type},
+                                              {"_c", transfer_id}}));
+  }
+  return trace;
+}
+
+}  // namespace
+
+Status PipelineExecutor::Run(int instruction_list) {
+  if (instruction_list < 0 || instruction_list >= instruction_lists_.size()) {
+    return InvalidArgument("Unknown instruction list %d", instruction_list);
+  }
+  tsl::profiler::TraceMe traceme("PipelineExecutor::Run");
+  const std::vector<PipelineInstruction> &instructions =
+      instruction_lists_[instruction_list];
+  for (int i = 0; i < instructions.size(); ++i) {
+    const PipelineInstruction &instruction = instructions[i];
+    std::optional<tsl::profiler::TraceMe> instruction_traceme;
+    if (const char *name = TraceMeName(instruction.kind)) {
+      instruction_traceme.emplace(
+          [&] { return InstructionTraceMe(name, instruction); },
+          tsl::profiler::TraceMeLevel::kInfo);
+    }
+    Status status = RunInstruction(instruction);
+    if (!status.ok()) {
+      return tsl::errors::CreateWithUpdatedMessage(
+          status, absl::StrCat("Instruction ", i, " of list ",
+                               instruction_list, ": ", status.error_message()));
+    }
+  }
+  return OkStatus();
+}
+
+Status PipelineExecutor::RunExecutable(
+    const PipelineInstruction &instruction) {
+  std::vector<std::vector<PyBuffer::object>> args;
+  args.reserve(instruction.input_uuids.size());
+  for (int64_t uuid : instruction.input_uuids) {
+    TF_ASSIGN_OR_RETURN(const std::vector<PyBuffer::object> *buffers,
+                        LookupBuffers(uuid));
+    args.push_back(*buffers);
+  }
+  TF_ASSIGN_OR_RETURN(
+      std::vector<std::vector<PyBuffer::object>> outputs,
+      executables_[instruction.executable]->ExecuteShardedOnLocalDevices(
+          args));
+  if (outputs.size() != instruction.output_uuids.size()) {
+    return InvalidArgument("Executable %d returned %d outputs instead of %d",
+                           instruction.executable, outputs.size(),
+                           instruction.output_uuids.size());
+  }
+  for (int i = 0; i < outputs.size(); ++i) {
+    buffers_[instruction.output_uuids[i]] = std::move(outputs[i]);
+  }
+  return OkStatus();
+}
+
+Status PipelineExecutor::RunInstruction(
+    const PipelineInstruction &instruction) {
+  using Kind = PipelineInstruction::Kind;
+  switch (instruction.kind) {
+    case Kind::kRun:
+      return RunExecutable(instruction);
+
+    case Kind::kSend:
+    case Kind::kRecv: {
+      TF_ASSIGN_OR_RETURN(const std::vector<PyBuffer::object> *buffers,
+                          LookupBuffers(instruction.input_uuids[0]));
+      if (instruction.device_index < 0 ||
+          static_cast<size_t>(instruction.device_index) >= buffers->size()) {
+        return InvalidArgument("No buffer on device %d of uuid %d",
+                               instruction.device_index,
+                               instruction.input_uuids[0]);
+      }
+      PyCommGroup &comm_group = *comm_groups_[instruction.comm_group];
+      const PyBuffer::object &buffer = (*buffers)[instruction.device_index];
+      return instruction.kind == Kind::kSend
+                 ? comm_group.NcclSend(instruction.key, buffer,
+                                       instruction.start,
+                                       instruction.n_elements,
+                                       instruction.peer_rank,
+                                       instruction.use_default_stream)
+                 : comm_group.NcclRecv(instruction.key, buffer,
+                                       instruction.start,
+                                       instruction.n_elements,
+                                       instruction.peer_rank,
+                                       instruction.use_default_stream);
+    }
+
+    case Kind::kReshard: {
+      std::vector<PyBuffer::object> plan_buffers;
+      for (int64_t uuid : instruction.input_uuids) {
+        TF_ASSIGN_OR_RETURN(const std::vector<PyBuffer::object> *buffers,
+                            LookupBuffers(uuid));
+        plan_buffers.insert(plan_buffers.end(), buffers->begin(),
+                            buffers->end());
+      }
+      return comm_groups_[instruction.comm_group]->ExecuteReshardingPlan(
+          *plans_[instruction.plan], std::move(plan_buffers),
+          instruction.use_default_stream);
+    }
+
+    case Kind::kWaitEvents:
+      if (instruction.comm_group == -1) {
+        return ComputationWaitEvents(instruction.event_uuids, client_);
+      }
+      return comm_groups_[instruction.comm_group]->CommunicatorWaitEvents(
+          instruction.event_uuids, client_->addressable_device_count(),
+          instruction.is_send);
+
+    case Kind::kRecordEvents:
+      return comm_groups_[instruction.comm_group]->CommunicatorRecordEvents(
+          instruction.event_uuids, client_->addressable_device_count(),
+          instruction.is_send);
+
+    case Kind::kFree:
+      DeleteBuffers(instruction.input_uuids);
+      return OkStatus();
+  }
+  return InvalidArgument("Unknown instruction kind %d",
+                         static_cast<int>(instruction.kind));
+}
+
+}  // namespace alpa
+}  // namespace gpu
+}  // namespace xla
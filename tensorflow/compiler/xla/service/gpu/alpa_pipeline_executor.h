@@ -0,0 +1,109 @@
+// This file contains a C++ executor of the instructions of Alpa's pipeshard
+// runtime, so that a worker issues a whole step with one call from Python.
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_ALPA_PIPELINE_EXECUTOR_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_ALPA_PIPELINE_EXECUTOR_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/compiler/xla/python/py_buffer.h"
+#include "tensorflow/compiler/xla/python/py_client.h"
+#include "tensorflow/compiler/xla/python/py_executable.h"
+#include "tensorflow/compiler/xla/service/gpu/alpa_nccl_wrapper.h"
+
+namespace xla {
+namespace gpu {
+namespace alpa {
+
+// One instruction of a pipeshard step. Buffers are named by uuids; a uuid
+// refers to one buffer per local device of the mesh, in device order.
+struct PipelineInstruction {
+  enum class Kind {
+    // Run `executable` on the buffers of `input_uuids` and name its outputs
+    // `output_uuids`.
+    kRun,
+    // Send or receive the buffer of `input_uuids[0]` on `device_index` with
+    // the communicator `key` of `comm_group`.
+    kSend,
+    kRecv,
+    // Issue `plan` of `comm_group` on the buffers of all of `input_uuids`,
+    // concatenated in order.
+    kReshard,
+    // Make the compute streams wait for `event_uuids`, or the send or recv
+    // streams of `comm_group` if it is set.
+    kWaitEvents,
+    // Record `event_uuids` on the send or recv streams of `comm_group`.
+    kRecordEvents,
+    // Drop the buffers of `input_uuids`.
+    kFree,
+  };
+
+  Kind kind = Kind::kFree;
+  int executable = -1;
+  int comm_group = -1;
+  int plan = -1;
+  std::vector<int64_t> input_uuids;
+  std::vector<int64_t> output_uuids;
+  AlpaNcclUid key;
+  int device_index = 0;
+  uint start = 0;
+  uint n_elements = 0;
+  int peer_rank = 0;
+  bool use_default_stream = false;
+  AlpaUuids event_uuids;
+  bool is_send = false;
+  // Profiler annotations of kRun, kSend, kRecv and kReshard: the pipeline
+  // stage (as named by slice_auto_sharded_stages) and microbatch the
+  // instruction belongs to. A send and its recv must use the same values.
+  std::string stage;
+  int microbatch = -1;
+};
+
+// Runs precompiled lists of instructions against PjRt, registered comm
+// groups and the Alpa event registry. The executables, comm groups, plans and
+// instruction lists are registered once and named by their index; the buffers
+// persist across steps in a table keyed by uuid. Not thread-safe: it is used
+// under the GIL, like the PyBuffers it holds.
+class PipelineExecutor {
+ public:
+  explicit PipelineExecutor(std::shared_ptr<PyClient> client);
+
+  int AddExecutable(std::shared_ptr<PyLoadedExecutable> executable);
+  int AddCommGroup(std::shared_ptr<PyCommGroup> comm_group);
+  int AddReshardingPlan(std::shared_ptr<ReshardingPlan> plan);
+  // Checks the references of `instructions` and returns the index to run
+  // them with.
+  StatusOr<int> AddInstructionList(
+      std::vector<PipelineInstruction> instructions);
+
+  void PutBuffers(int64_t uuid, std::vector<PyBuffer::object> buffers);
+  StatusOr<std::vector<PyBuffer::object>> GetBuffers(int64_t uuid) const;
+  void DeleteBuffers(const std::vector<int64_t> &uuids);
+  bool HasBuffers(int64_t uuid) const { return buffers_.contains(uuid); }
+  int num_buffers() const { return buffers_.size(); }
+
+  // Runs the instructions of a list in order and stops at the first error.
+  Status Run(int instruction_list);
+
+ private:
+  StatusOr<const std::vector<PyBuffer::object> *> LookupBuffers(
+      int64_t uuid) const;
+  Status RunInstruction(const PipelineInstruction &instruction);
+  Status RunExecutable(const PipelineInstruction &instruction);
+
+  std::shared_ptr<PyClient> client_;
+  std::vector<std::shared_ptr<PyLoadedExecutable>> executables_;
+  std::vector<std::shared_ptr<PyCommGroup>> comm_groups_;
+  std::vector<std::shared_ptr<ReshardingPlan>> plans_;
+  std::vector<std::vector<PipelineInstruction>> instruction_lists_;
+  absl::flat_hash_map<int64_t, std::vector<PyBuffer::object>> buffers_;
+};
+
+}  // namespace alpa
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_ALPA_PIPELINE_EXECUTOR_H_
@@ -0,0 +1,467 @@
+#include "tensorflow/compiler/xla/service/gpu/attention_chunking.h"
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_instructions.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+#include "tensorflow/tsl/platform/logging.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+// The operand of an instruction computed per chunk is used whole.
+constexpr int64_t kNoRowDim = -1;
+
+// The dimensions of operand `operand_index` of `dot` that are neither batch
+// nor contracting dimensions, in the order of the dot output.
+std::vector<int64_t> FreeDims(const HloInstruction* dot,
+                              int64_t operand_index) {
+  const DotDimensionNumbers& dnums = dot->dot_dimension_numbers();
+  const auto& batch_dims = operand_index == 0 ? dnums.lhs_batch_dimensions()
+                                              : dnums.rhs_batch_dimensions();
+  const auto& contracting_dims = operand_index == 0
+                                     ? dnums.lhs_contracting_dimensions()
+                                     : dnums.rhs_contracting_dimensions();
+  std::vector<int64_t> free_dims;
+  for (int64_t i = 0; i < dot->operand(operand_index)->shape().rank(); ++i) {
+    if (!absl::c_linear_search(batch_dims, i) &&
+        !absl::c_linear_search(contracting_dims, i)) {
+      free_dims.push_back(i);
+    }
+  }
+  return free_dims;
+}
+
+// Whether each block of rows of `instr` can be computed from the
+// corresponding blocks of rows of its operands.
+bool CanComputeByRow(const HloInstruction* instr) {
+  if (!instr->shape().IsArray() || instr->HasSideEffect() ||
+      !instr->control_predecessors().empty() ||
+      !instr->control_successors().empty()) {
+    return false;
+  }
+  switch (instr->opcode()) {
+    case HloOpcode::kBroadcast:
+    case HloOpcode::kCopy:
+    case HloOpcode::kDot:
+    case HloOpcode::kIota:
+    case HloOpcode::kTranspose:
+      return true;
+    case HloOpcode::kReduce:
+      return instr->operand_count() == 2;
+    case HloOpcode::kRng:
+      return false;
+    default:
+      return instr->IsElementwise();
+  }
+}
+
+// The dimension of operand `operand_index` of `instr` that the row dimension
+// `row_dim` of `instr` comes from, or kNoRowDim if the operand does not vary
+// along the rows. `instr` must satisfy CanComputeByRow, and for a reduce,
+// `row_dim` must not be reduced, which holds as it is a dimension of the
+// output.
+int64_t OperandRowDim(const HloInstruction* instr, int64_t operand_index,
+                      int64_t row_dim) {
+  switch (instr->opcode()) {
+    case HloOpcode::kBroadcast: {
+      auto it = absl::c_find(instr->dimensions(), row_dim);
+      return it == instr->dimensions().end()
+                 ? kNoRowDim
+                 : it - instr->dimensions().begin();
+    }
+    case HloOpcode::kCopy:
+      return row_dim;
+    case HloOpcode::kTranspose:
+      return instr->dimensions(row_dim);
+    case HloOpcode::kReduce: {
+      // The init value.
+      if (operand_index == 1) {
+        return kNoRowDim;
+      }
+      int64_t output_dim = 0;
+      for (int64_t i = 0; i < instr->operand(0)->shape().rank(); ++i) {
+        if (absl::c_linear_search(instr->dimensions(), i)) {
+          continue;
+        }
+        if (output_dim++ == row_dim) {
+          return i;
+        }
+      }
+      LOG(FATAL) << "Invalid row dimension " << row_dim << " of "
+                 << instr->ToString();
+    }
+    case HloOpcode::kDot: {
+      const DotDimensionNumbers& dnums = instr->dot_dimension_numbers();
+      int64_t num_batch_dims = dnums.lhs_batch_dimensions_size();
+      if (row_dim < num_batch_dims) {
+        return operand_index == 0 ? dnums.lhs_batch_dimensions(row_dim)
+                                  : dnums.rhs_batch_dimensions(row_dim);
+      }
+      std::vector<int64_t> lhs_free_dims = FreeDims(instr, 0);
+      int64_t free_dim = row_dim - num_batch_dims;
+      if (free_dim < static_cast<int64_t>(lhs_free_dims.size())) {
+        return operand_index == 0 ? lhs_free_dims[free_dim] : kNoRowDim;
+      }
+      return operand_index == 1
+                 ? FreeDims(instr, 1)[free_dim - lhs_free_dims.size()]
+                 : kNoRowDim;
+    }
+    default:
+      // Elementwise, e.g., the scalar bounds of a clamp.
+      return ShapeUtil::IsScalar(instr->operand(operand_index)->shape())
+                 ? kNoRowDim
+                 : row_dim;
+  }
+}
+
+// The instructions that are computed per chunk of rows of `root`.
+struct Region {
+  HloInstruction* root;
+  // In post order.
+  std::vector<HloInstruction*> instrs;
+  // The dimension of the rows of each instruction.
+  absl::flat_hash_map<const HloInstruction*, int64_t> row_dims;
+  // The operands of the instructions that are computed outside the loop.
+  std::vector<HloInstruction*> inputs;
+  // The scalar constants, which are cloned into the loop.
+  std::vector<HloInstruction*> constants;
+};
+
+// Collects the largest region of instructions that only feed `root` and can
+// be computed by blocks of its rows along `row_dim`.
+Region CollectRegion(HloInstruction* root, int64_t row_dim) {
+  // Instructions that have to be computed whole, e.g., because they are used
+  // outside the region.
+  absl::flat_hash_set<const HloInstruction*> excluded;
+  while (true) {
+    Region region;
+    region.root = root;
+    region.row_dims[root] = row_dim;
+
+    bool restart = false;
+    std::vector<HloInstruction*> stack = {root};
+    while (!stack.empty() && !restart) {
+      HloInstruction* instr = stack.back();
+      stack.pop_back();
+      for (int64_t i = 0; i < instr->operand_count(); ++i) {
+        HloInstruction* operand = instr->mutable_operand(i);
+        int64_t operand_row_dim =
+            OperandRowDim(instr, i, region.row_dims.at(instr));
+        if (operand_row_dim == kNoRowDim || excluded.contains(operand) ||
+            !CanComputeByRow(operand)) {
+          continue;
+        }
+        auto [it, inserted] =
+            region.row_dims.try_emplace(operand, operand_row_dim);
+        if (inserted) {
+          stack.push_back(operand);
+        } else if (it->second != operand_row_dim) {
+          // Used with different row dimensions.
+          excluded.insert(operand);
+          restart = true;
+          break;
+        }
+      }
+    }
+    if (restart) {
+      continue;
+    }
+
+    // The instructions used outside the region or used whole in it.
+    for (const auto& [instr, instr_row_dim] : region.row_dims) {
+      if (instr == root) {
+        continue;
+      }
+      for (const HloInstruction* user : instr->users()) {
+        auto it = region.row_dims.find(user);
+        bool used_whole = it == region.row_dims.end();
+        for (int64_t i = 0; !used_whole && i < user->operand_count(); ++i) {
+          used_whole = user->operand(i) == instr &&
+                       OperandRowDim(user, i, it->second) == kNoRowDim;
+        }
+        if (used_whole) {
+          excluded.insert(instr);
+          restart = true;
+          break;
+        }
+      }
+    }
+    if (restart) {
+      continue;
+    }
+
+    // Order the region and find its inputs.
+    absl::flat_hash_set<const HloInstruction*> visited;
+    std::function<void(HloInstruction*)> visit = [&](HloInstruction* instr) {
+      if (!visited.insert(instr).second) {
+        return;
+      }
+      if (!region.row_dims.contains(instr)) {
+        if (instr->opcode() == HloOpcode::kConstant &&
+            ShapeUtil::IsEffectiveScalar(instr->shape())) {
+          region.constants.push_back(instr);
+        } else {
+          region.inputs.push_back(instr);
+        }
+        return;
+      }
+      for (HloInstruction* operand : instr->operands()) {
+        visit(operand);
+      }
+      region.instrs.push_back(instr);
+    };
+    visit(root);
+    return region;
+  }
+}
+
+// Whether the region materializes a matrix larger than its output, which is
+// computed from a dot through a reduction, e.g., the softmax of the
+// attention scores.
+bool IsAttention(const Region& region) {
+  bool has_dot = false;
+  bool has_reduce = false;
+  int64_t max_bytes = 0;
+  for (const HloInstruction* instr : region.instrs) {
+    if (instr == region.root) {
+      continue;
+    }
+    has_dot |= instr->opcode() == HloOpcode::kDot;
+    has_reduce |= instr->opcode() == HloOpcode::kReduce;
+    max_bytes = std::max(max_bytes, ShapeUtil::ByteSizeOf(instr->shape()));
+  }
+  return has_dot && has_reduce &&
+         max_bytes > ShapeUtil::ByteSizeOf(region.root->shape());
+}
+
+// The largest divisor of `length` that is at most `max_chunk_size`.
+int64_t GetChunkSize(int64_t length, int64_t max_chunk_size) {
+  for (int64_t size = max_chunk_size; size > 1; --size) {
+    if (length % size == 0) {
+      return size;
+    }
+  }
+  return 1;
+}
+
+// Replaces the root of `region` with a while loop that computes it by chunks
+// of `chunk_size` rows.
+Status ChunkRegion(const Region& region, int64_t chunk_size) {
+  HloInstruction* root = region.root;
+  HloComputation* computation = root->parent();
+  HloModule* module = computation->parent();
+  int64_t root_row_dim = region.row_dims.at(root);
+  int64_t num_chunks = root->shape().dimensions(root_row_dim) / chunk_size;
+
+  // The loop state is (chunk index, output, inputs...).
+  const Shape index_shape = ShapeUtil::MakeShape(S32, {});
+  std::vector<Shape> state_shapes = {index_shape, root->shape()};
+  for (const HloInstruction* input : region.inputs) {
+    state_shapes.push_back(input->shape());
+  }
+  const Shape state_shape = ShapeUtil::MakeTupleShape(state_shapes);
+
+  HloComputation::Builder body_builder(
+      absl::StrCat(root->name(), ".chunk_body"));
+  HloInstruction* state = body_builder.AddInstruction(
+      HloInstruction::CreateParameter(0, state_shape, "state"));
+  std::vector<HloInstruction*> state_elements;
+  for (int64_t i = 0; i < state_shapes.size(); ++i) {
+    state_elements.push_back(body_builder.AddInstruction(
+        HloInstruction::CreateGetTupleElement(state_shapes[i], state, i)));
+  }
+  HloInstruction* zero = body_builder.AddInstruction(
+      HloInstruction::CreateConstant(LiteralUtil::CreateR0<int32_t>(0)));
+  HloInstruction* offset =
+      body_builder.AddInstruction(HloInstruction::CreateBinary(
+          index_shape, HloOpcode::kMultiply, state_elements[0],
+          body_builder.AddInstruction(HloInstruction::CreateConstant(
+              LiteralUtil::CreateR0<int32_t>(chunk_size)))));
+
+  absl::flat_hash_map<const HloInstruction*, HloInstruction*> input_values;
+  for (int64_t i = 0; i < region.inputs.size(); ++i) {
+    input_values[region.inputs[i]] = state_elements[i + 2];
+  }
+  for (HloInstruction* constant : region.constants) {
+    input_values[constant] = body_builder.AddInstruction(constant->Clone());
+  }
+
+  // The rows of the chunk of an input.
+  absl::flat_hash_map<std::pair<const HloInstruction*, int64_t>,
+                      HloInstruction*>
+      sliced_inputs;
+  auto slice_rows = [&](const HloInstruction* input, int64_t row_dim) {
+    HloInstruction*& slice = sliced_inputs[{input, row_dim}];
+    if (slice == nullptr) {
+      std::vector<HloInstruction*> start_indices(input->shape().rank(), zero);
+      start_indices[row_dim] = offset;
+      std::vector<int64_t> slice_sizes(input->shape().dimensions().begin(),
+                                       input->shape().dimensions().end());
+      slice_sizes[row_dim] = chunk_size;
+      Shape slice_shape = input->shape();
+      slice_shape.set_dimensions(row_dim, chunk_size);
+      slice = body_builder.AddInstruction(HloInstruction::CreateDynamicSlice(
+          slice_shape, input_values.at(input), start_indices, slice_sizes));
+    }
+    return slice;
+  };
+
+  absl::flat_hash_map<const HloInstruction*, HloInstruction*> chunks;
+  for (HloInstruction* instr : region.instrs) {
+    int64_t row_dim = region.row_dims.at(instr);
+    std::vector<HloInstruction*> new_operands;
+    for (int64_t i = 0; i < instr->operand_count(); ++i) {
+      const HloInstruction* operand = instr->operand(i);
+      auto it = chunks.find(operand);
+      if (it != chunks.end()) {
+        new_operands.push_back(it->second);
+        continue;
+      }
+      int64_t operand_row_dim = OperandRowDim(instr, i, row_dim);
+      new_operands.push_back(operand_row_dim == kNoRowDim
+                                 ? input_values.at(operand)
+                                 : slice_rows(operand, operand_row_dim));
+    }
+
+    Shape chunk_shape = instr->shape();
+    chunk_shape.set_dimensions(row_dim, chunk_size);
+    HloInstruction* chunk = body_builder.AddInstruction(
+        instr->CloneWithNewOperands(chunk_shape, new_operands));
+    // The rows of an iota along the rows, e.g., of a causal mask, start at
+    // the offset of the chunk.
+    if (instr->opcode() == HloOpcode::kIota &&
+        Cast<HloIotaInstruction>(instr)->iota_dimension() == row_dim) {
+      PrimitiveType type = instr->shape().element_type();
+      HloInstruction* row_offset =
+          body_builder.AddInstruction(HloInstruction::CreateConvert(
+              ShapeUtil::MakeShape(type, {}), offset));
+      row_offset = body_builder.AddInstruction(
+          HloInstruction::CreateBroadcast(chunk_shape, row_offset, {}));
+      chunk = body_builder.AddInstruction(HloInstruction::CreateBinary(
+          chunk_shape, HloOpcode::kAdd, chunk, row_offset));
+    }
+    chunks[instr] = chunk;
+  }
+
+  std::vector<HloInstruction*> update_indices(root->shape().rank(), zero);
+  update_indices[root_row_dim] = offset;
+  std::vector<HloInstruction*> next_state = state_elements;
+  next_state[0] = body_builder.AddInstruction(HloInstruction::CreateBinary(
+      index_shape, HloOpcode::kAdd, state_elements[0],
+      body_builder.AddInstruction(
+          HloInstruction::CreateConstant(LiteralUtil::CreateR0<int32_t>(1)))));
+  next_state[1] =
+      body_builder.AddInstruction(HloInstruction::CreateDynamicUpdateSlice(
+          root->shape(), state_elements[1], chunks.at(root), update_indices));
+  HloComputation* body = module->AddEmbeddedComputation(body_builder.Build(
+      body_builder.AddInstruction(HloInstruction::CreateTuple(next_state))));
+
+  HloComputation::Builder cond_builder(
+      absl::StrCat(root->name(), ".chunk_cond"));
+  HloInstruction* cond_state = cond_builder.AddInstruction(
+      HloInstruction::CreateParameter(0, state_shape, "state"));
+  HloInstruction* index = cond_builder.AddInstruction(
+      HloInstruction::CreateGetTupleElement(index_shape, cond_state, 0));
+  HloInstruction* limit = cond_builder.AddInstruction(
+      HloInstruction::CreateConstant(LiteralUtil::CreateR0<int32_t>(num_chunks)));
+  HloComputation* cond = module->AddEmbeddedComputation(
+      cond_builder.Build(cond_builder.AddInstruction(
+          HloInstruction::CreateCompare(ShapeUtil::MakeShape(PRED, {}), index,
+                                        limit, ComparisonDirection::kLt))));
+
+  std::vector<HloInstruction*> init_state = {
+      computation->AddInstruction(
+          HloInstruction::CreateConstant(LiteralUtil::CreateR0<int32_t>(0))),
+      computation->AddInstruction(HloInstruction::CreateBroadcast(
+          root->shape(),
+          computation->AddInstruction(HloInstruction::CreateConstant(
+              LiteralUtil::Zero(root->shape().element_type()))),
+          {}))};
+  init_state.insert(init_state.end(), region.inputs.begin(),
+                    region.inputs.end());
+  HloInstruction* loop = computation->AddInstruction(
+      HloInstruction::CreateWhile(state_shape, cond, body,
+                                  computation->AddInstruction(
+                                      HloInstruction::CreateTuple(init_state))));
+  WhileLoopBackendConfig config;
+  config.mutable_known_trip_count()->set_n(num_chunks);
+  TF_RETURN_IF_ERROR(loop->set_backend_config(config));
+
+  VLOG(1) << "Computing " << root->name() << " in " << num_chunks
+          << " chunks of " << chunk_size << " rows of dimension "
+          << root_row_dim;
+  return computation->ReplaceInstruction(
+      root, computation->AddInstruction(HloInstruction::CreateGetTupleElement(
+                root->shape(), loop, 1)));
+}
+
+// Chunks the attention whose output is `dot`, if any.
+StatusOr<bool> MaybeChunkAttention(HloInstruction* dot,
+                                   int64_t max_chunk_size) {
+  int64_t num_batch_dims =
+      dot->dot_dimension_numbers().lhs_batch_dimensions_size();
+  for (int64_t row_dim = num_batch_dims; row_dim < dot->shape().rank();
+       ++row_dim) {
+    int64_t length = dot->shape().dimensions(row_dim);
+    if (length <= max_chunk_size) {
+      continue;
+    }
+    int64_t chunk_size = GetChunkSize(length, max_chunk_size);
+    if (chunk_size == 1) {
+      continue;
+    }
+    Region region = CollectRegion(dot, row_dim);
+    if (!IsAttention(region)) {
+      continue;
+    }
+    TF_RETURN_IF_ERROR(ChunkRegion(region, chunk_size));
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+StatusOr<bool> AttentionChunking::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  bool changed = false;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    bool rewritten = true;
+    while (rewritten) {
+      rewritten = false;
+      for (HloInstruction* instr : computation->MakeInstructionPostOrder()) {
+        if (instr->opcode() != HloOpcode::kDot) {
+          continue;
+        }
+        TF_ASSIGN_OR_RETURN(rewritten,
+                            MaybeChunkAttention(instr, query_chunk_size_));
+        if (rewritten) {
+          changed = true;
+          break;
+        }
+      }
+    }
+  }
+  return changed;
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,50 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_ATTENTION_CHUNKING_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_ATTENTION_CHUNKING_H_
+
+#include <cstdint>
+
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace xla {
+namespace gpu {
+
+// Computes attention, i.e., dot(softmax(dot(Q, K)), V) with optional scaling,
+// bias, masks and dropout, as a while loop over chunks of the query sequence,
+// so that only the [query_chunk_size, key_length] block of the attention
+// scores of each (batch, head) is live at a time instead of the full
+// [query_length, key_length] matrix.
+//
+// The pass looks for a dot whose operand is computed row by row from another
+// dot, i.e., the computation between the two dots only consists of
+// elementwise ops, broadcasts, transposes, iotas and reductions that do not
+// reduce the query dimension, and contains a reduction. That computation is
+// cloned into the loop body, with the inputs that vary along the query
+// dimension (e.g., Q, a bias or a dropout mask) dynamic-sliced and the
+// others (e.g., K and V) used whole. Iotas along the query dimension, e.g.,
+// of causal masks, are offset by the start of the chunk.
+//
+// Each (batch, head) is still computed by the same dots, so the shardings of
+// the heads chosen by auto-sharding are kept. The rewrite runs after the SPMD
+// partitioner, on the per-device shapes.
+class AttentionChunking : public HloModulePass {
+ public:
+  explicit AttentionChunking(int64_t query_chunk_size)
+      : query_chunk_size_(query_chunk_size) {}
+
+  absl::string_view name() const override { return "attention-chunking"; }
+
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+
+ private:
+  int64_t query_chunk_size_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_ATTENTION_CHUNKING_H_
@@ -0,0 +1,140 @@
+#include "tensorflow/compiler/xla/service/gpu/attention_chunking.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/service/hlo_evaluator.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_matchers.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/compiler/xla/tests/test_utils.h"
+#include "tensorflow/tsl/platform/status_matchers.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+using ::tsl::testing::IsOkAndHolds;
+namespace op = xla::testing::opcode_matchers;
+
+// Causal attention of 2 heads with 8 queries and keys.
+constexpr absl::string_view kHloString = R"(
+HloModule module
+
+%max {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT max = f32[] maximum(lhs, rhs)
+}
+
+%add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY %attention {
+  q = f32[2,8,4] parameter(0)
+  k = f32[2,8,4] parameter(1)
+  v = f32[2,8,4] parameter(2)
+  scores = f32[2,8,8] dot(q, k), lhs_batch_dims={0}, rhs_batch_dims={0},
+    lhs_contracting_dims={2}, rhs_contracting_dims={2}
+  row = s32[2,8,8] iota(), iota_dimension=1
+  col = s32[2,8,8] iota(), iota_dimension=2
+  causal = pred[2,8,8] compare(row, col), direction=GE
+  min = f32[] constant(-1e9)
+  min_bcast = f32[2,8,8] broadcast(min), dimensions={}
+  masked = f32[2,8,8] select(causal, scores, min_bcast)
+  max_init = f32[] constant(-inf)
+  row_max = f32[2,8] reduce(masked, max_init), dimensions={2}, to_apply=%max
+  row_max_bcast = f32[2,8,8] broadcast(row_max), dimensions={0,1}
+  shifted = f32[2,8,8] subtract(masked, row_max_bcast)
+  exp = f32[2,8,8] exponential(shifted)
+  zero = f32[] constant(0)
+  row_sum = f32[2,8] reduce(exp, zero), dimensions={2}, to_apply=%add
+  row_sum_bcast = f32[2,8,8] broadcast(row_sum), dimensions={0,1}
+  probs = f32[2,8,8] divide(exp, row_sum_bcast)
+  ROOT out = f32[2,8,4] dot(probs, v), lhs_batch_dims={0}, rhs_batch_dims={0},
+    lhs_contracting_dims={2}, rhs_contracting_dims={1}
+})";
+
+class AttentionChunkingTest : public HloTestBase {};
+
+TEST_F(AttentionChunkingTest, ChunkCausalAttention) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  std::unique_ptr<HloModule> reference = module->Clone();
+
+  AttentionChunking pass(/*query_chunk_size=*/4);
+  EXPECT_THAT(pass.Run(module.get()), IsOkAndHolds(true));
+
+  const HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, op::GetTupleElement(op::While(), 1));
+  // Q is sliced and K and V are used whole.
+  EXPECT_THAT(root->operand(0)->operand(0),
+              op::Tuple(op::Constant(), op::Broadcast(), op::Parameter(0),
+                        op::Parameter(1), op::Parameter(2)));
+  TF_ASSERT_OK_AND_ASSIGN(
+      WhileLoopBackendConfig config,
+      root->operand(0)->backend_config<WhileLoopBackendConfig>());
+  EXPECT_EQ(config.known_trip_count().n(), 2);
+
+  TF_ASSERT_OK_AND_ASSIGN(std::vector<Literal> args,
+                          MakeFakeArguments(reference.get()));
+  std::vector<const Literal*> arg_ptrs;
+  for (const Literal& arg : args) {
+    arg_ptrs.push_back(&arg);
+  }
+  HloEvaluator evaluator;
+  TF_ASSERT_OK_AND_ASSIGN(Literal expected,
+                          evaluator.Evaluate(*reference, arg_ptrs));
+  TF_ASSERT_OK_AND_ASSIGN(Literal actual,
+                          evaluator.Evaluate(*module, arg_ptrs));
+  EXPECT_TRUE(LiteralTestUtil::Near(expected, actual, ErrorSpec(1e-5)));
+}
+
+TEST_F(AttentionChunkingTest, ShortSequence) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  AttentionChunking pass(/*query_chunk_size=*/8);
+  EXPECT_THAT(pass.Run(module.get()), IsOkAndHolds(false));
+}
+
+TEST_F(AttentionChunkingTest, ScoresUsedElsewhere) {
+  // The probabilities are also an output, so they are materialized anyway.
+  constexpr absl::string_view kHlo = R"(
+HloModule module
+
+%add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY %attention {
+  q = f32[8,4] parameter(0)
+  k = f32[8,4] parameter(1)
+  v = f32[8,4] parameter(2)
+  scores = f32[8,8] dot(q, k), lhs_contracting_dims={1},
+    rhs_contracting_dims={1}
+  exp = f32[8,8] exponential(scores)
+  zero = f32[] constant(0)
+  row_sum = f32[8] reduce(exp, zero), dimensions={1}, to_apply=%add
+  row_sum_bcast = f32[8,8] broadcast(row_sum), dimensions={0}
+  probs = f32[8,8] divide(exp, row_sum_bcast)
+  out = f32[8,4] dot(probs, v), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+  ROOT tuple = (f32[8,4], f32[8,8]) tuple(out, probs)
+})";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHlo));
+  AttentionChunking pass(/*query_chunk_size=*/4);
+  EXPECT_THAT(pass.Run(module.get()), IsOkAndHolds(false));
+}
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
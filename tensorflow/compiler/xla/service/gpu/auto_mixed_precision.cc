@@ -0,0 +1,165 @@
+#include "tensorflow/compiler/xla/service/gpu/auto_mixed_precision.h"
+
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_creation_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/logging.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+bool IsF32Array(const HloInstruction* instr) {
+  return instr->shape().IsArray() && instr->shape().element_type() == F32;
+}
+
+// Ops that are always computed in the low precision type.
+bool IsAllowOp(const HloInstruction* instr) {
+  if (instr->opcode() != HloOpcode::kDot &&
+      instr->opcode() != HloOpcode::kConvolution) {
+    return false;
+  }
+  // Respect the ops that explicitly ask for full precision.
+  return absl::c_none_of(
+      instr->precision_config().operand_precision(),
+      [](int precision) { return precision == PrecisionConfig::HIGHEST; });
+}
+
+// Ops whose precision follows their operands.
+bool IsInferOp(const HloInstruction* instr) {
+  switch (instr->opcode()) {
+    case HloOpcode::kAbs:
+    case HloOpcode::kAdd:
+    case HloOpcode::kBroadcast:
+    case HloOpcode::kClamp:
+    case HloOpcode::kConcatenate:
+    case HloOpcode::kCopy:
+    case HloOpcode::kDynamicSlice:
+    case HloOpcode::kDynamicUpdateSlice:
+    case HloOpcode::kMaximum:
+    case HloOpcode::kMinimum:
+    case HloOpcode::kMultiply:
+    case HloOpcode::kNegate:
+    case HloOpcode::kPad:
+    case HloOpcode::kReshape:
+    case HloOpcode::kReverse:
+    case HloOpcode::kSelect:
+    case HloOpcode::kSlice:
+    case HloOpcode::kSubtract:
+    case HloOpcode::kTranspose:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Values that are free to convert, e.g., the scalars of a multiply.
+bool IsConstantLike(const HloInstruction* instr) {
+  switch (instr->opcode()) {
+    case HloOpcode::kConstant:
+    case HloOpcode::kIota:
+      return true;
+    case HloOpcode::kBroadcast:
+      return IsConstantLike(instr->operand(0));
+    default:
+      return false;
+  }
+}
+
+// Whether `instr` is computed in the low precision type, given the already
+// converted instructions `low`.
+bool ShouldConvert(const HloInstruction* instr,
+                   const absl::flat_hash_set<HloInstruction*>& low) {
+  if (!IsF32Array(instr) || instr->HasSideEffect()) {
+    return false;
+  }
+  if (IsAllowOp(instr)) {
+    return absl::c_all_of(instr->operands(), [&](HloInstruction* operand) {
+      return IsF32Array(operand) || low.contains(operand);
+    });
+  }
+  if (IsInferOp(instr)) {
+    bool has_low_operand = false;
+    for (HloInstruction* operand : instr->operands()) {
+      if (low.contains(operand)) {
+        has_low_operand = true;
+      } else if (IsF32Array(operand) && !IsConstantLike(operand)) {
+        return false;
+      }
+    }
+    return has_low_operand;
+  }
+  return false;
+}
+
+StatusOr<bool> RunOnComputation(HloComputation* computation,
+                                PrimitiveType low_precision_type) {
+  absl::flat_hash_set<HloInstruction*> low;
+  std::vector<HloInstruction*> converted;
+  for (HloInstruction* instr : computation->MakeInstructionPostOrder()) {
+    if (!ShouldConvert(instr, low)) {
+      continue;
+    }
+    for (int64_t i = 0; i < instr->operand_count(); ++i) {
+      HloInstruction* operand = instr->mutable_operand(i);
+      if (IsF32Array(operand)) {
+        TF_RETURN_IF_ERROR(instr->ReplaceOperandWith(
+            i, MakeConvertToHlo(operand, low_precision_type,
+                                &operand->metadata())));
+      }
+    }
+    instr->mutable_shape()->set_element_type(low_precision_type);
+    low.insert(instr);
+    converted.push_back(instr);
+  }
+
+  // Convert back to f32 for the users that stay in f32.
+  for (HloInstruction* instr : converted) {
+    HloInstruction* back = nullptr;
+    auto get_back = [&]() {
+      if (back == nullptr) {
+        back = MakeConvertToHlo(instr, F32, &instr->metadata());
+      }
+      return back;
+    };
+    std::vector<HloInstruction*> users = instr->users();
+    for (HloInstruction* user : users) {
+      if (!low.contains(user)) {
+        TF_RETURN_IF_ERROR(instr->ReplaceUseWith(user, get_back()));
+      }
+    }
+    if (instr == computation->root_instruction()) {
+      computation->set_root_instruction(get_back());
+    }
+  }
+  VLOG(2) << "Converted " << converted.size() << " instructions of "
+          << computation->name() << " to "
+          << PrimitiveType_Name(low_precision_type);
+  return !converted.empty();
+}
+
+}  // namespace
+
+StatusOr<bool> AutoMixedPrecision::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  bool changed = false;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    TF_ASSIGN_OR_RETURN(bool computation_changed,
+                        RunOnComputation(computation, low_precision_type_));
+    changed |= computation_changed;
+  }
+  return changed;
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,45 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_AUTO_MIXED_PRECISION_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_AUTO_MIXED_PRECISION_H_
+
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+
+namespace xla {
+namespace gpu {
+
+// Converts the f32 computation of a program to a low precision type, like the
+// auto mixed precision of grappler, with lists of opcodes:
+//
+// - allow: dots and convolutions, which run on the tensor cores and are
+//   always computed in the low precision type (they still accumulate in f32).
+// - infer: elementwise and data movement ops, which are computed in the low
+//   precision type when all their f32 operands are, so that the activations
+//   between allowed ops are kept in the low precision type.
+// - deny: everything else, e.g., reductions, exp, log, divide and rsqrt, so
+//   that reductions, softmax and normalizations are still computed in f32.
+//
+// Converts are inserted where values cross between the two precisions. The
+// types of parameters, computation roots and ops with other result types are
+// not changed.
+class AutoMixedPrecision : public HloModulePass {
+ public:
+  explicit AutoMixedPrecision(PrimitiveType low_precision_type = BF16)
+      : low_precision_type_(low_precision_type) {}
+
+  absl::string_view name() const override { return "auto-mixed-precision"; }
+
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+
+ private:
+  PrimitiveType low_precision_type_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_AUTO_MIXED_PRECISION_H_
@@ -0,0 +1,101 @@
+#include "tensorflow/compiler/xla/service/gpu/auto_mixed_precision.h"
+
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_matchers.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/tsl/platform/status_matchers.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+using ::tsl::testing::IsOkAndHolds;
+namespace op = xla::testing::opcode_matchers;
+
+using AutoMixedPrecisionTest = HloTestBase;
+
+TEST_F(AutoMixedPrecisionTest, DotsAndActivationsInLowPrecision) {
+  constexpr absl::string_view kHloString = R"(
+HloModule module
+
+ENTRY %mlp {
+  x = f32[8,16] parameter(0)
+  w0 = f32[16,32] parameter(1)
+  w1 = f32[32,4] parameter(2)
+  h = f32[8,32] dot(x, w0), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  zero = f32[] constant(0)
+  zero_bcast = f32[8,32] broadcast(zero), dimensions={}
+  relu = f32[8,32] maximum(h, zero_bcast)
+  ROOT out = f32[8,4] dot(relu, w1), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  AutoMixedPrecision pass;
+  EXPECT_THAT(RunHloPass(&pass, module.get()), IsOkAndHolds(true));
+
+  // The activation between the dots stays in bf16.
+  HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, op::Convert(op::Dot(
+                        op::Maximum(op::Dot(op::Convert(op::Parameter(0)),
+                                            op::Convert(op::Parameter(1))),
+                                    op::Convert(op::Broadcast())),
+                        op::Convert(op::Parameter(2)))));
+  EXPECT_EQ(root->shape().element_type(), F32);
+  EXPECT_EQ(root->operand(0)->shape().element_type(), BF16);
+  EXPECT_EQ(root->operand(0)->operand(0)->shape().element_type(), BF16);
+}
+
+TEST_F(AutoMixedPrecisionTest, ReductionsStayInF32) {
+  constexpr absl::string_view kHloString = R"(
+HloModule module
+
+%add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY %softmax_denominator {
+  x = f32[8,16] parameter(0)
+  w = f32[16,32] parameter(1)
+  logits = f32[8,32] dot(x, w), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  exp = f32[8,32] exponential(logits)
+  zero = f32[] constant(0)
+  ROOT sum = f32[8] reduce(exp, zero), dimensions={1}, to_apply=%add
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  AutoMixedPrecision pass;
+  EXPECT_THAT(RunHloPass(&pass, module.get()), IsOkAndHolds(true));
+
+  HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, op::Reduce(op::Exp(op::Convert(op::Dot())),
+                               op::Constant()));
+  EXPECT_EQ(root->operand(0)->shape().element_type(), F32);
+  EXPECT_EQ(root->operand(0)->operand(0)->operand(0)->shape().element_type(),
+            BF16);
+  EXPECT_EQ(root->to_apply()->root_instruction()->shape().element_type(), F32);
+}
+
+TEST_F(AutoMixedPrecisionTest, HighestPrecisionDotStaysInF32) {
+  constexpr absl::string_view kHloString = R"(
+HloModule module
+
+ENTRY %dot {
+  x = f32[8,16] parameter(0)
+  w = f32[16,32] parameter(1)
+  ROOT dot = f32[8,32] dot(x, w), lhs_contracting_dims={1}, rhs_contracting_dims={0}, operand_precision={highest,highest}
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  AutoMixedPrecision pass;
+  EXPECT_THAT(RunHloPass(&pass, module.get()), IsOkAndHolds(false));
+}
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,170 @@
+#include "tensorflow/compiler/xla/service/gpu/autotune_results_store.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/stream_executor/device_description.h"
+#include "tensorflow/compiler/xla/stream_executor/dnn.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/logging.h"
+#include "tensorflow/tsl/platform/protobuf.h"
+#include "tensorflow/tsl/platform/random.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+// Bump this when the keys or the meaning of the results change.
+constexpr int kAutotuneResultsVersion = 1;
+
+}  // namespace
+
+/*static*/ AutotuneResultsStore& AutotuneResultsStore::Get() {
+  static auto* store = new AutotuneResultsStore();
+  return *store;
+}
+
+/*static*/ std::string AutotuneResultsStore::DeviceKey(
+    se::StreamExecutor* stream_exec) {
+  const se::DeviceDescription& desc = stream_exec->GetDeviceDescription();
+  std::string key = desc.name();
+  if (stream_exec->platform_kind() == se::PlatformKind::kROCm) {
+    absl::StrAppend(&key, ";", desc.rocm_compute_capability().gcn_arch_name());
+  } else {
+    absl::StrAppend(&key, ";sm_",
+                    desc.cuda_compute_capability().ToString());
+  }
+  absl::StrAppend(&key, ";", desc.runtime_version());
+
+  // Conv algorithms are only valid for the same cuDNN/MIOpen version.
+  if (auto* dnn = stream_exec->AsDnn()) {
+    auto version = dnn->GetVersion();
+    if (version.ok()) {
+      absl::StrAppend(&key, ";dnn_", version->major_version(), ".",
+                      version->minor_version(), ".", version->patch());
+    }
+  }
+  return key;
+}
+
+std::optional<tensorflow::AutotuneResult> AutotuneResultsStore::Lookup(
+    Kind kind, const std::string& device, const std::string& hlo) {
+  absl::MutexLock lock(&mutex_);
+  Map& map = GetMap(kind);
+  auto it = map.find(Key(device, hlo));
+  if (it == map.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+void AutotuneResultsStore::Insert(Kind kind, const std::string& device,
+                                  const std::string& hlo,
+                                  tensorflow::AutotuneResult result) {
+  absl::MutexLock lock(&mutex_);
+  GetMap(kind).try_emplace(Key(device, hlo), std::move(result));
+}
+
+AutotuneResults AutotuneResultsStore::Export() {
+  AutotuneResults results;
+  results.set_version(kAutotuneResultsVersion);
+
+  auto export_map = [](const Map& map,
+                       tsl::protobuf::RepeatedPtrField<
+                           AutotuneResults::Entry>* entries) {
+    std::vector<const Map::value_type*> sorted;
+    sorted.reserve(map.size());
+    for (const auto& item : map) {
+      sorted.push_back(&item);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const Map::value_type* a, const Map::value_type* b) {
+                return a->first < b->first;
+              });
+    for (const Map::value_type* item : sorted) {
+      AutotuneResults::Entry* entry = entries->Add();
+      entry->set_device(item->first.first);
+      entry->set_hlo(item->first.second);
+      *entry->mutable_result() = item->second;
+    }
+  };
+
+  absl::MutexLock lock(&mutex_);
+  export_map(convs_, results.mutable_convs());
+  export_map(gemms_, results.mutable_gemms());
+  return results;
+}
+
+Status AutotuneResultsStore::Import(const AutotuneResults& results) {
+  if (results.version() != kAutotuneResultsVersion) {
+    return InvalidArgument(
+        "Autotuning results of version %d are incompatible with version %d.",
+        results.version(), kAutotuneResultsVersion);
+  }
+
+  absl::MutexLock lock(&mutex_);
+  for (const AutotuneResults::Entry& entry : results.convs()) {
+    convs_.try_emplace(Key(entry.device(), entry.hlo()), entry.result());
+  }
+  for (const AutotuneResults::Entry& entry : results.gemms()) {
+    gemms_.try_emplace(Key(entry.device(), entry.hlo()), entry.result());
+  }
+  VLOG(1) << "Loaded " << results.convs_size() << " conv and "
+          << results.gemms_size() << " gemm autotuning results";
+  return OkStatus();
+}
+
+std::string SerializeAutotuneResults() {
+  return AutotuneResultsStore::Get().Export().SerializeAsString();
+}
+
+Status LoadAutotuneResults(absl::string_view serialized) {
+  AutotuneResults results;
+  if (!results.ParseFromArray(serialized.data(), serialized.size())) {
+    return InvalidArgument("Failed to parse autotuning results.");
+  }
+  return AutotuneResultsStore::Get().Import(results);
+}
+
+Status LoadAutotuneResultsFromFile(const std::string& path) {
+  std::string contents;
+  TF_RETURN_IF_ERROR(
+      tsl::ReadFileToString(tsl::Env::Default(), path, &contents));
+
+  AutotuneResults results;
+  if (absl::EndsWith(path, ".pbtxt")) {
+    if (!tsl::protobuf::TextFormat::ParseFromString(contents, &results)) {
+      return InvalidArgument("Failed to parse autotuning results in %s.",
+                             path);
+    }
+    return AutotuneResultsStore::Get().Import(results);
+  }
+  return LoadAutotuneResults(contents);
+}
+
+Status DumpAutotuneResultsToFile(const std::string& path) {
+  AutotuneResults results = AutotuneResultsStore::Get().Export();
+  std::string contents;
+  if (absl::EndsWith(path, ".pbtxt")) {
+    if (!tsl::protobuf::TextFormat::PrintToString(results, &contents)) {
+      return InternalError("Failed to print autotuning results.");
+    }
+  } else {
+    contents = results.SerializeAsString();
+  }
+
+  // Write to a temporary file first so that workers loading the file never
+  // see a partially written one.
+  tsl::Env* env = tsl::Env::Default();
+  std::string tmp_path = absl::StrCat(path, ".tmp.", tsl::random::New64());
+  TF_RETURN_IF_ERROR(tsl::WriteStringToFile(env, tmp_path, contents));
+  return env->RenameFile(tmp_path, path);
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,86 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_AUTOTUNE_RESULTS_STORE_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_AUTOTUNE_RESULTS_STORE_H_
+
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_autotuning.pb.h"
+#include "tensorflow/compiler/xla/status.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/stream_executor/stream_executor.h"
+#include "tensorflow/core/protobuf/autotuning.pb.h"
+
+namespace xla {
+namespace gpu {
+
+// The process-wide store of the results of GemmAlgorithmPicker and
+// GpuConvAlgorithmPicker.
+//
+// Results are keyed by the kind of the device rather than the device itself,
+// so that the devices of the same model share their results, and the store
+// can be exported by one worker and imported by the others (e.g., through the
+// distributed runtime key-value store or a file) to skip autotuning the same
+// instructions again.
+class AutotuneResultsStore {
+ public:
+  enum class Kind { kConv, kGemm };
+
+  static AutotuneResultsStore& Get();
+
+  // The device model, compute capability and library versions of
+  // `stream_exec`. The algorithms of a result are only valid on devices with
+  // the same key.
+  static std::string DeviceKey(se::StreamExecutor* stream_exec);
+
+  std::optional<tensorflow::AutotuneResult> Lookup(Kind kind,
+                                                   const std::string& device,
+                                                   const std::string& hlo);
+
+  // Keeps the existing result if there is one, which happens when devices of
+  // the same kind autotune the same instruction concurrently.
+  void Insert(Kind kind, const std::string& device, const std::string& hlo,
+              tensorflow::AutotuneResult result);
+
+  // Export all results, sorted so that the same results always serialize to
+  // the same string.
+  AutotuneResults Export();
+
+  // Add the results that are not in the store yet.
+  Status Import(const AutotuneResults& results);
+
+ private:
+  using Key = std::pair<std::string, std::string>;
+  using Map = absl::flat_hash_map<Key, tensorflow::AutotuneResult>;
+
+  Map& GetMap(Kind kind) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return kind == Kind::kConv ? convs_ : gemms_;
+  }
+
+  absl::Mutex mutex_;
+  Map convs_ ABSL_GUARDED_BY(mutex_);
+  Map gemms_ ABSL_GUARDED_BY(mutex_);
+};
+
+// Serialize the process-wide autotuning results, e.g., to share them through
+// the distributed runtime key-value store.
+std::string SerializeAutotuneResults();
+
+// Import serialized autotuning results into the process-wide store.
+Status LoadAutotuneResults(absl::string_view serialized);
+
+// Import the autotuning results in the text or binary proto file at `path`.
+Status LoadAutotuneResultsFromFile(const std::string& path);
+
+// Write the process-wide autotuning results to `path`, as a text proto if it
+// ends with ".pbtxt" and as a binary proto otherwise.
+Status DumpAutotuneResultsToFile(const std::string& path);
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_AUTOTUNE_RESULTS_STORE_H_
@@ -0,0 +1,70 @@
+#include "tensorflow/compiler/xla/service/gpu/autotune_results_store.h"
+
+#include <string>
+
+#include "tensorflow/compiler/xla/service/gpu/gpu_autotuning.pb.h"
+#include "tensorflow/tsl/lib/core/status_test_util.h"
+#include "tensorflow/tsl/platform/path.h"
+#include "tensorflow/tsl/platform/test.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+using Kind = AutotuneResultsStore::Kind;
+
+tensorflow::AutotuneResult GemmResult(int64_t algorithm) {
+  tensorflow::AutotuneResult result;
+  result.mutable_gemm()->set_algorithm(algorithm);
+  return result;
+}
+
+TEST(AutotuneResultsStoreTest, ExportAndImport) {
+  AutotuneResultsStore store;
+  store.Insert(Kind::kGemm, "device", "gemm", GemmResult(3));
+  store.Insert(Kind::kConv, "device", "conv", GemmResult(4));
+  // An existing result is kept.
+  store.Insert(Kind::kGemm, "device", "gemm", GemmResult(5));
+  EXPECT_EQ(store.Lookup(Kind::kGemm, "device", "gemm")->gemm().algorithm(),
+            3);
+  EXPECT_FALSE(store.Lookup(Kind::kGemm, "other_device", "gemm").has_value());
+  EXPECT_FALSE(store.Lookup(Kind::kGemm, "device", "conv").has_value());
+
+  AutotuneResults results = store.Export();
+  EXPECT_EQ(results.gemms_size(), 1);
+  EXPECT_EQ(results.convs_size(), 1);
+
+  // Another worker imports the results.
+  AutotuneResultsStore other_store;
+  TF_ASSERT_OK(other_store.Import(results));
+  EXPECT_EQ(
+      other_store.Lookup(Kind::kGemm, "device", "gemm")->gemm().algorithm(), 3);
+  EXPECT_EQ(
+      other_store.Lookup(Kind::kConv, "device", "conv")->gemm().algorithm(), 4);
+  EXPECT_EQ(other_store.Export().SerializeAsString(),
+            results.SerializeAsString());
+
+  results.set_version(results.version() + 1);
+  EXPECT_FALSE(other_store.Import(results).ok());
+}
+
+TEST(AutotuneResultsStoreTest, DumpAndLoadFile) {
+  AutotuneResultsStore::Get().Insert(Kind::kGemm, "device", "dumped_gemm",
+                                     GemmResult(7));
+  for (const char* name : {"results.pb", "results.pbtxt"}) {
+    std::string path = tsl::io::JoinPath(tsl::testing::TmpDir(), name);
+    TF_ASSERT_OK(DumpAutotuneResultsToFile(path));
+    TF_ASSERT_OK(LoadAutotuneResultsFromFile(path));
+  }
+  EXPECT_FALSE(LoadAutotuneResults("garbage").ok());
+  TF_EXPECT_OK(LoadAutotuneResults(SerializeAutotuneResults()));
+  EXPECT_EQ(AutotuneResultsStore::Get()
+                .Lookup(Kind::kGemm, "device", "dumped_gemm")
+                ->gemm()
+                .algorithm(),
+            7);
+}
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
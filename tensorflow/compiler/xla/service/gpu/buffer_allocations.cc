@@ -32,7 +32,7 @@ namespace gpu {
 
 Status BufferAllocations::TearDown(
     const std::set<se::DeviceMemoryBase>& live_addresses,
-    absl::Span<const BufferAllocation> allocations) {
+    absl::Span<const BufferAllocation> allocations, bool keep_temp_buffers) {
   // Deallocate temporary buffers, taking care to try to deallocate all of them
   // even if one of the deallocations fails.
   Status status;
@@ -41,7 +41,13 @@ Status BufferAllocations::TearDown(
     const BufferAllocation& allocation = allocations[i];
     se::DeviceMemoryBase buffer_address = GetDeviceAddress(allocation.index());
     // Deallocate buffers marked "maybe_live_out" but aren't actually live out,
-    // and temp buffers.
+    // and temp buffers. Host temp buffers are owned by the executable.
+    if (allocation.color() == kHostMemorySpaceColor) {
+      continue;
+    }
+    if (keep_temp_buffers && allocation.IsPreallocatedTempBuffer()) {
+      continue;
+    }
     if ((allocation.maybe_live_out() &&
          !live_addresses.count(buffer_address)) ||
         allocation.IsPreallocatedTempBuffer()) {
@@ -52,6 +52,9 @@ class BufferAllocations {
   }
   int device_ordinal() const { return device_ordinal_; }
 
+  // Returns the number of buffers, i.e., the number of buffer allocations.
+  int64_t size() const { return buffers_.size(); }
+
   // Returns the device address of buffer `buffer_index`. `buffer_index` must be
   // a valid index, i.e., in [0, buffer_count). This function returns null if
   // `buffer_index` is not assigned to a buffer address.
@@ -68,9 +71,11 @@ class BufferAllocations {
       const BufferAllocation::Slice& buffer_slice) const;
 
   // Tears down all buffers allocated by this object that are not in
-  // `live_addresses`.
+  // `live_addresses`. Added by Alpa: if `keep_temp_buffers`, the temp buffers
+  // are owned by the executable and kept.
   Status TearDown(const std::set<se::DeviceMemoryBase>& live_addresses,
-                  absl::Span<const BufferAllocation> allocations);
+                  absl::Span<const BufferAllocation> allocations,
+                  bool keep_temp_buffers = false);
 
   std::string ToString() {
     std::string out;
@@ -0,0 +1,160 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/gpu/cub_sort_custom_call.h"
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/service/custom_call_status.h"
+#include "tensorflow/compiler/xla/service/custom_call_target_registry.h"
+#include "tensorflow/compiler/xla/status.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/compiler/xla/util.h"
+
+#if GOOGLE_CUDA
+#include "tensorflow/compiler/xla/service/gpu/cub_sort_kernel.h"
+#endif  // GOOGLE_CUDA
+
+namespace xla {
+namespace gpu {
+
+const char* const kCubSortCustomCallTarget = "__xla_gpu_cub_sort";
+
+std::string CubSortDescriptor::ToOpaque() const {
+  return absl::StrCat(PrimitiveType_Name(key_type), ",", descending, ",",
+                      has_values, ",", num_items, ",", segment_size);
+}
+
+StatusOr<CubSortDescriptor> CubSortDescriptor::FromOpaque(
+    absl::string_view opaque) {
+  std::vector<absl::string_view> fields = absl::StrSplit(opaque, ',');
+  CubSortDescriptor descriptor;
+  int descending, has_values;
+  if (fields.size() != 5 ||
+      !PrimitiveType_Parse(std::string(fields[0]), &descriptor.key_type) ||
+      !absl::SimpleAtoi(fields[1], &descending) ||
+      !absl::SimpleAtoi(fields[2], &has_values) ||
+      !absl::SimpleAtoi(fields[3], &descriptor.num_items) ||
+      !absl::SimpleAtoi(fields[4], &descriptor.segment_size)) {
+    return InvalidArgument("Invalid CUB sort descriptor: %s", opaque);
+  }
+  descriptor.descending = descending;
+  descriptor.has_values = has_values;
+  return descriptor;
+}
+
+bool IsCubSortKeyType(PrimitiveType type) {
+  switch (type) {
+    case F32:
+    case F64:
+    case S32:
+    case S64:
+    case U32:
+    case U64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+#if GOOGLE_CUDA
+
+static StatusOr<CubSortKeyType> GetCubSortKeyType(PrimitiveType type) {
+  switch (type) {
+    case F32:
+      return CubSortKeyType::kF32;
+    case F64:
+      return CubSortKeyType::kF64;
+    case S32:
+      return CubSortKeyType::kS32;
+    case S64:
+      return CubSortKeyType::kS64;
+    case U32:
+      return CubSortKeyType::kU32;
+    case U64:
+      return CubSortKeyType::kU64;
+    default:
+      return Unimplemented("CUB sort does not support %s keys",
+                           PrimitiveType_Name(type));
+  }
+}
+
+static Status RunCubSort(const CubSortDescriptor& descriptor, void* stream,
+                         void* scratch, size_t* scratch_size,
+                         const void* keys_in, void* keys_out,
+                         const void* values_in, void* values_out) {
+  TF_ASSIGN_OR_RETURN(CubSortKeyType key_type,
+                      GetCubSortKeyType(descriptor.key_type));
+  TF_RET_CHECK(descriptor.num_items <= std::numeric_limits<int>::max());
+  if (const char* error = CubRadixSort(
+          key_type, descriptor.descending, descriptor.has_values, scratch,
+          scratch_size, keys_in, keys_out, values_in, values_out,
+          descriptor.num_items, descriptor.segment_size, stream)) {
+    return InternalError("CUB radix sort failed: %s", error);
+  }
+  return OkStatus();
+}
+
+StatusOr<int64_t> GetCubSortScratchSize(const CubSortDescriptor& descriptor) {
+  size_t scratch_size = 0;
+  // With null scratch memory CUB only computes the required scratch size.
+  TF_RETURN_IF_ERROR(RunCubSort(descriptor, /*stream=*/nullptr,
+                                /*scratch=*/nullptr, &scratch_size, nullptr,
+                                nullptr, nullptr, nullptr));
+  return scratch_size;
+}
+
+static Status CubSort(void* stream, void** buffers, absl::string_view opaque) {
+  TF_ASSIGN_OR_RETURN(CubSortDescriptor descriptor,
+                      CubSortDescriptor::FromOpaque(opaque));
+  TF_ASSIGN_OR_RETURN(size_t scratch_size, GetCubSortScratchSize(descriptor));
+
+  int i = 0;
+  const void* keys_in = buffers[i++];
+  const void* values_in = descriptor.has_values ? buffers[i++] : nullptr;
+  void* keys_out = buffers[i++];
+  void* values_out = descriptor.has_values ? buffers[i++] : nullptr;
+  void* scratch = buffers[i++];
+  return RunCubSort(descriptor, stream, scratch, &scratch_size, keys_in,
+                    keys_out, values_in, values_out);
+}
+
+static void CubSortCustomCall(void* stream, void** buffers, const char* opaque,
+                              size_t opaque_len, XlaCustomCallStatus* status) {
+  Status s = CubSort(stream, buffers, absl::string_view(opaque, opaque_len));
+  if (!s.ok()) {
+    XlaCustomCallStatusSetFailure(status, s.error_message().c_str(),
+                                  s.error_message().size());
+  }
+}
+
+XLA_REGISTER_CUSTOM_CALL_TARGET_WITH_SYM(kCubSortCustomCallTarget,
+                                         CubSortCustomCall, "CUDA");
+
+#else  // GOOGLE_CUDA
+
+StatusOr<int64_t> GetCubSortScratchSize(const CubSortDescriptor& descriptor) {
+  return Unimplemented("CUB sort requires XLA built with CUDA");
+}
+
+#endif  // GOOGLE_CUDA
+
+}  // namespace gpu
+}  // namespace xla
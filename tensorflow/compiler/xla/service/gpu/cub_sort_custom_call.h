@@ -0,0 +1,58 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_CUB_SORT_CUSTOM_CALL_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_CUB_SORT_CUSTOM_CALL_H_
+
+#include <cstdint>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+
+namespace xla {
+namespace gpu {
+
+// Custom call target of the CUB radix sort. The buffers of the custom call are
+// the keys, the optional 32-bit values, the sorted keys, the optional sorted
+// values and the scratch memory of the sort.
+extern const char* const kCubSortCustomCallTarget;
+
+// Parameters of a CUB radix sort, serialized to the custom call opaque.
+struct CubSortDescriptor {
+  PrimitiveType key_type;
+  bool descending;
+  bool has_values;
+  // Total number of keys, and number of keys in each of the contiguous
+  // segments that are sorted independently.
+  int64_t num_items;
+  int64_t segment_size;
+
+  std::string ToOpaque() const;
+  static StatusOr<CubSortDescriptor> FromOpaque(absl::string_view opaque);
+};
+
+// Returns true if the CUB radix sort supports keys of the given type.
+bool IsCubSortKeyType(PrimitiveType type);
+
+// Returns the size of the scratch memory required by the CUB radix sort.
+// Returns an error if XLA is built without CUDA.
+StatusOr<int64_t> GetCubSortScratchSize(const CubSortDescriptor& descriptor);
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_CUB_SORT_CUSTOM_CALL_H_
@@ -0,0 +1,162 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/gpu/cub_sort_kernel.h"
+
+#include <cstdint>
+
+#include "cub/device/device_radix_sort.cuh"
+#include "cub/device/device_segmented_radix_sort.cuh"
+#include "cub/iterator/counting_input_iterator.cuh"
+#include "cub/iterator/transform_input_iterator.cuh"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+// Maps a segment index to the offset of its first key.
+struct SegmentOffset {
+  __host__ __device__ explicit SegmentOffset(int segment_size)
+      : segment_size(segment_size) {}
+
+  __host__ __device__ __forceinline__ int operator()(int idx) const {
+    return idx * segment_size;
+  }
+
+  int segment_size;
+};
+
+using SegmentOffsets =
+    cub::TransformInputIterator<int, SegmentOffset,
+                                cub::CountingInputIterator<int>>;
+
+template <typename KeyT>
+cudaError_t SortKeys(bool descending, void* d_temp_storage, size_t& temp_bytes,
+                     const KeyT* d_keys_in, KeyT* d_keys_out, int num_items,
+                     int segment_size, cudaStream_t stream) {
+  if (segment_size == num_items) {
+    return descending ? cub::DeviceRadixSort::SortKeysDescending(
+                            d_temp_storage, temp_bytes, d_keys_in, d_keys_out,
+                            num_items, 0, sizeof(KeyT) * 8, stream)
+                      : cub::DeviceRadixSort::SortKeys(
+                            d_temp_storage, temp_bytes, d_keys_in, d_keys_out,
+                            num_items, 0, sizeof(KeyT) * 8, stream);
+  }
+
+  int num_segments = num_items / segment_size;
+  SegmentOffsets offsets(cub::CountingInputIterator<int>(0),
+                         SegmentOffset(segment_size));
+  return descending ? cub::DeviceSegmentedRadixSort::SortKeysDescending(
+                          d_temp_storage, temp_bytes, d_keys_in, d_keys_out,
+                          num_items, num_segments, offsets, offsets + 1, 0,
+                          sizeof(KeyT) * 8, stream)
+                    : cub::DeviceSegmentedRadixSort::SortKeys(
+                          d_temp_storage, temp_bytes, d_keys_in, d_keys_out,
+                          num_items, num_segments, offsets, offsets + 1, 0,
+                          sizeof(KeyT) * 8, stream);
+}
+
+template <typename KeyT>
+cudaError_t SortPairs(bool descending, void* d_temp_storage,
+                      size_t& temp_bytes, const KeyT* d_keys_in,
+                      KeyT* d_keys_out, const uint32_t* d_values_in,
+                      uint32_t* d_values_out, int num_items, int segment_size,
+                      cudaStream_t stream) {
+  if (segment_size == num_items) {
+    return descending ? cub::DeviceRadixSort::SortPairsDescending(
+                            d_temp_storage, temp_bytes, d_keys_in, d_keys_out,
+                            d_values_in, d_values_out, num_items, 0,
+                            sizeof(KeyT) * 8, stream)
+                      : cub::DeviceRadixSort::SortPairs(
+                            d_temp_storage, temp_bytes, d_keys_in, d_keys_out,
+                            d_values_in, d_values_out, num_items, 0,
+                            sizeof(KeyT) * 8, stream);
+  }
+
+  int num_segments = num_items / segment_size;
+  SegmentOffsets offsets(cub::CountingInputIterator<int>(0),
+                         SegmentOffset(segment_size));
+  return descending ? cub::DeviceSegmentedRadixSort::SortPairsDescending(
+                          d_temp_storage, temp_bytes, d_keys_in, d_keys_out,
+                          d_values_in, d_values_out, num_items, num_segments,
+                          offsets, offsets + 1, 0, sizeof(KeyT) * 8, stream)
+                    : cub::DeviceSegmentedRadixSort::SortPairs(
+                          d_temp_storage, temp_bytes, d_keys_in, d_keys_out,
+                          d_values_in, d_values_out, num_items, num_segments,
+                          offsets, offsets + 1, 0, sizeof(KeyT) * 8, stream);
+}
+
+template <typename KeyT>
+cudaError_t Sort(bool descending, bool has_values, void* d_temp_storage,
+                 size_t& temp_bytes, const void* d_keys_in, void* d_keys_out,
+                 const void* d_values_in, void* d_values_out, int num_items,
+                 int segment_size, cudaStream_t stream) {
+  if (!has_values) {
+    return SortKeys<KeyT>(descending, d_temp_storage, temp_bytes,
+                          static_cast<const KeyT*>(d_keys_in),
+                          static_cast<KeyT*>(d_keys_out), num_items,
+                          segment_size, stream);
+  }
+  return SortPairs<KeyT>(descending, d_temp_storage, temp_bytes,
+                         static_cast<const KeyT*>(d_keys_in),
+                         static_cast<KeyT*>(d_keys_out),
+                         static_cast<const uint32_t*>(d_values_in),
+                         static_cast<uint32_t*>(d_values_out), num_items,
+                         segment_size, stream);
+}
+
+}  // namespace
+
+const char* CubRadixSort(CubSortKeyType key_type, bool descending,
+                         bool has_values, void* d_temp_storage, size_t* temp_bytes,
+                         const void* d_keys_in, void* d_keys_out,
+                         const void* d_values_in, void* d_values_out,
+                         int num_items, int segment_size, void* stream) {
+  if (segment_size <= 0 || num_items % segment_size != 0) {
+    return "invalid CUB sort segment size";
+  }
+
+  auto cuda_stream = static_cast<cudaStream_t>(stream);
+  cudaError_t err = cudaSuccess;
+#define SORT(type)                                                          \
+  err = Sort<type>(descending, has_values, d_temp_storage, *temp_bytes,     \
+                   d_keys_in, d_keys_out, d_values_in, d_values_out,        \
+                   num_items, segment_size, cuda_stream)
+  switch (key_type) {
+    case CubSortKeyType::kF32:
+      SORT(float);
+      break;
+    case CubSortKeyType::kF64:
+      SORT(double);
+      break;
+    case CubSortKeyType::kS32:
+      SORT(int32_t);
+      break;
+    case CubSortKeyType::kS64:
+      SORT(int64_t);
+      break;
+    case CubSortKeyType::kU32:
+      SORT(uint32_t);
+      break;
+    case CubSortKeyType::kU64:
+      SORT(uint64_t);
+      break;
+  }
+#undef SORT
+  return err == cudaSuccess ? nullptr : cudaGetErrorString(err);
+}
+
+}  // namespace gpu
+}  // namespace xla
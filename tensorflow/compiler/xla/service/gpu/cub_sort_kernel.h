@@ -0,0 +1,44 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_CUB_SORT_KERNEL_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_CUB_SORT_KERNEL_H_
+
+#include <cstddef>
+
+namespace xla {
+namespace gpu {
+
+// Key types supported by the CUB radix sort.
+enum class CubSortKeyType { kF32, kF64, kS32, kS64, kU32, kU64 };
+
+// Sorts `num_items` keys in contiguous segments of `segment_size` keys with
+// the CUB radix sort, and permutes the 32-bit values along with the keys if
+// `has_values` is set. The sort is stable.
+//
+// If `d_temp_storage` is null, only stores the size of the required scratch
+// memory to `temp_bytes`.
+//
+// Returns an error message, or nullptr on success.
+const char* CubRadixSort(CubSortKeyType key_type, bool descending,
+                         bool has_values, void* d_temp_storage, size_t* temp_bytes,
+                         const void* d_keys_in, void* d_keys_out,
+                         const void* d_values_in, void* d_values_out,
+                         int num_items, int segment_size, void* stream);
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_CUB_SORT_KERNEL_H_
@@ -0,0 +1,173 @@
+#include "tensorflow/compiler/xla/service/gpu/cuda_graph_thunk_runner.h"
+
+#include <utility>
+
+#include "absl/algorithm/container.h"
+#include "tensorflow/compiler/xla/service/gpu/buffer_allocations.h"
+#include "tensorflow/compiler/xla/service/gpu/sequential_thunk.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/tsl/platform/logging.h"
+#include "tensorflow/tsl/profiler/lib/scoped_annotation.h"
+
+#if GOOGLE_CUDA
+#include "third_party/gpus/cuda/include/cuda_runtime_api.h"
+#include "tensorflow/compiler/xla/stream_executor/gpu/gpu_stream.h"
+#endif  // #if GOOGLE_CUDA
+
+namespace xla {
+namespace gpu {
+
+using ::tsl::profiler::ScopedAnnotation;
+
+bool IsCapturableThunk(const Thunk& thunk) {
+  switch (thunk.kind()) {
+    case Thunk::kCopy:
+    case Thunk::kGemm:
+    case Thunk::kKernel:
+    case Thunk::kMemset32BitValue:
+    case Thunk::kMemzero:
+      return true;
+    case Thunk::kSequential:
+      return absl::c_all_of(
+          static_cast<const SequentialThunk&>(thunk).thunks(),
+          [](const std::unique_ptr<Thunk>& sub_thunk) {
+            return IsCapturableThunk(*sub_thunk);
+          });
+    default:
+      return false;
+  }
+}
+
+CudaGraphThunkRunner::CudaGraphThunkRunner(const ThunkSequence* thunks,
+                                           int64_t min_graph_size)
+    : thunks_(thunks) {
+  const int64_t num_thunks = thunks_->size();
+  int64_t begin = 0;
+  while (begin < num_thunks) {
+    int64_t end = begin;
+    while (end < num_thunks && IsCapturableThunk(*(*thunks_)[end])) {
+      ++end;
+    }
+    if (end - begin >= min_graph_size) {
+      graph_begins_[begin] = graph_ranges_.size();
+      graph_ranges_.push_back({begin, end});
+    }
+    begin = end + 1;
+  }
+  VLOG(1) << "Capture " << graph_ranges_.size() << " CUDA graphs of "
+          << num_thunks << " thunks";
+}
+
+CudaGraphThunkRunner::~CudaGraphThunkRunner() {
+#if GOOGLE_CUDA
+  absl::MutexLock lock(&mutex_);
+  for (auto& [executor, execs] : graph_execs_) {
+    CHECK(executor->SynchronizeAllActivity());
+    for (GraphExec& exec : execs) {
+      if (exec.exec != nullptr) {
+        cudaGraphExecDestroy(static_cast<cudaGraphExec_t>(exec.exec));
+      }
+    }
+  }
+#endif  // #if GOOGLE_CUDA
+}
+
+StatusOr<int64_t> CudaGraphThunkRunner::MaybeLaunchGraph(
+    int64_t index, const Thunk::ExecuteParams& params) {
+  auto it = graph_begins_.find(index);
+  if (it == graph_begins_.end()) {
+    return index;
+  }
+  absl::MutexLock lock(&mutex_);
+  std::vector<GraphExec>& execs = graph_execs_[params.stream->parent()];
+  execs.resize(graph_ranges_.size());
+  TF_RETURN_IF_ERROR(LaunchGraph(it->second, params, &execs[it->second]));
+  return graph_ranges_[it->second].second;
+}
+
+Status CudaGraphThunkRunner::LaunchGraph(int64_t range_index,
+                                         const Thunk::ExecuteParams& params,
+                                         GraphExec* exec) {
+#if GOOGLE_CUDA
+  auto [begin, end] = graph_ranges_[range_index];
+  // The graphs are keyed by the addresses of all buffer allocations, since
+  // any of them may be baked into the kernel parameters of a graph.
+  const BufferAllocations& buffer_allocations = *params.buffer_allocations;
+  std::vector<void*> addresses(buffer_allocations.size());
+  for (int64_t i = 0; i < buffer_allocations.size(); ++i) {
+    addresses[i] = buffer_allocations.GetDeviceAddress(i).opaque();
+  }
+
+  cudaStream_t stream = se::gpu::AsGpuStreamValue(params.stream);
+  cudaGraphExec_t instance = static_cast<cudaGraphExec_t>(exec->exec);
+
+  if (instance == nullptr || exec->addresses != addresses) {
+    VLOG(2) << "Capture the CUDA graph of thunks [" << begin << ", " << end
+            << ")";
+    // Only capture the work of this thread, so that other threads can keep
+    // allocating memory and launching work on other streams.
+    cudaError_t err =
+        cudaStreamBeginCapture(stream, cudaStreamCaptureModeThreadLocal);
+    if (err != cudaSuccess) {
+      return InternalError("Stream begin capture failed: %s",
+                           cudaGetErrorString(err));
+    }
+    Status status = OkStatus();
+    for (int64_t i = begin; i < end && status.ok(); ++i) {
+      Thunk& thunk = *(*thunks_)[i];
+      ScopedAnnotation annotation([&] { return thunk.profile_annotation(); });
+      status = thunk.ExecuteOnStream(params);
+    }
+    cudaGraph_t graph = nullptr;
+    err = cudaStreamEndCapture(stream, &graph);
+    TF_RETURN_IF_ERROR(status);
+    if (err != cudaSuccess) {
+      return InternalError("Stream end capture failed: %s",
+                           cudaGetErrorString(err));
+    }
+
+    // Update the kernel parameters of the instantiated graph in place, or
+    // instantiate the graph if its topology changed.
+    if (instance != nullptr) {
+#if CUDART_VERSION >= 12000
+      cudaGraphExecUpdateResultInfo result_info;
+      err = cudaGraphExecUpdate(instance, graph, &result_info);
+#else
+      cudaGraphNode_t error_node;
+      cudaGraphExecUpdateResult result;
+      err = cudaGraphExecUpdate(instance, graph, &error_node, &result);
+#endif  // CUDART_VERSION >= 12000
+      if (err != cudaSuccess) {
+        VLOG(2) << "Instantiate the CUDA graph again: "
+                << cudaGetErrorString(err);
+        cudaGetLastError();
+        cudaGraphExecDestroy(instance);
+        instance = nullptr;
+      }
+    }
+    if (instance == nullptr) {
+      err = cudaGraphInstantiate(&instance, graph, nullptr, nullptr, 0);
+    }
+    cudaGraphDestroy(graph);
+    if (err != cudaSuccess) {
+      exec->exec = nullptr;
+      return InternalError("Graph instantiation failed: %s",
+                           cudaGetErrorString(err));
+    }
+    exec->exec = instance;
+    exec->addresses = std::move(addresses);
+  }
+
+  cudaError_t err = cudaGraphLaunch(instance, stream);
+  if (err != cudaSuccess) {
+    return InternalError("Failed to run captured graph: %s",
+                         cudaGetErrorString(err));
+  }
+  return OkStatus();
+#else
+  return InternalError("Cuda graphs are not supported");
+#endif  // #if GOOGLE_CUDA
+}
+
+}  // namespace gpu
+}  // namespace xla
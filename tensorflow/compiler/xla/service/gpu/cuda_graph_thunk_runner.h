@@ -0,0 +1,79 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_CUDA_GRAPH_THUNK_RUNNER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_CUDA_GRAPH_THUNK_RUNNER_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "tensorflow/compiler/xla/service/gpu/thunk.h"
+#include "tensorflow/compiler/xla/status.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/stream_executor/stream_executor.h"
+
+namespace xla {
+namespace gpu {
+
+// Returns whether a thunk only enqueues device work on the main stream that
+// does not depend on the host, so that it can be captured into a CUDA graph.
+// Collectives, host callbacks, control flow and thunks that allocate scratch
+// memory at run time are not capturable.
+bool IsCapturableThunk(const Thunk& thunk);
+
+// Runs the maximal runs of capturable thunks of a thunk sequence by replaying
+// CUDA graphs, while the other thunks are executed as usual. The graphs are
+// captured on the first run on an executor and are recaptured whenever the
+// addresses of the buffer allocations change. The instantiated graphs are then
+// updated in place if possible, which is much cheaper than instantiating them
+// again.
+class CudaGraphThunkRunner {
+ public:
+  // `thunks` must outlive the runner. Runs of fewer than
+  // `min_graph_size` capturable thunks are not captured, because a graph
+  // launch is not cheaper than a few kernel launches.
+  explicit CudaGraphThunkRunner(const ThunkSequence* thunks,
+                                int64_t min_graph_size = 2);
+  ~CudaGraphThunkRunner();
+
+  // If a graph begins at thunk `index`, launches it on `params.stream` and
+  // returns the end of its thunks. Returns `index` otherwise. The thunks must
+  // be initialized.
+  StatusOr<int64_t> MaybeLaunchGraph(int64_t index,
+                                     const Thunk::ExecuteParams& params);
+
+  // Returns the half-open ranges of the thunks captured into graphs.
+  const std::vector<std::pair<int64_t, int64_t>>& graph_ranges() const {
+    return graph_ranges_;
+  }
+
+ private:
+  // An instantiated graph of a range of thunks.
+  struct GraphExec {
+    // The buffer addresses the graph was captured with.
+    std::vector<void*> addresses;
+    // A cudaGraphExec_t.
+    void* exec = nullptr;
+  };
+
+  Status LaunchGraph(int64_t range_index, const Thunk::ExecuteParams& params,
+                     GraphExec* exec);
+
+  const ThunkSequence* thunks_;
+  std::vector<std::pair<int64_t, int64_t>> graph_ranges_;
+  // The index in `graph_ranges_` of the graph beginning at every thunk.
+  absl::flat_hash_map<int64_t, int64_t> graph_begins_;
+
+  // Graph launches on an executor are serialized, because a graph cannot be
+  // launched while it is updated.
+  absl::Mutex mutex_;
+  std::map<se::StreamExecutor*, std::vector<GraphExec>> graph_execs_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_CUDA_GRAPH_THUNK_RUNNER_H_
@@ -29,11 +29,7 @@ Status DoneEventThunk::ExecuteOnStream(const ExecuteParams& params) {
     };
     mu_.Await(absl::Condition(&run_id_match));
   }
-  se::Event* done_event =
-      event_stats->RecordEvent(device_ordinal, stream.parent());
-  TF_RET_CHECK(done_event->Init());
-  stream.ThenRecordEvent(done_event);
-  return OkStatus();
+  return event_stats->RecordOnStream(device_ordinal, &stream);
 }
 };  // namespace gpu
 };  // namespace xla
@@ -0,0 +1,127 @@
+#include "tensorflow/compiler/xla/service/gpu/fusion_cost_model.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/service/dump.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_hlo_cost_analysis.h"
+#include "tensorflow/tsl/platform/errors.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+// Runs `analysis` on `instr` alone, without its operands.
+Status AnalyzeInstruction(HloInstruction* instr,
+                          GpuHloCostAnalysis* analysis) {
+  TF_RETURN_IF_ERROR(analysis->Preprocess(instr));
+  ConstDfsHloVisitor* visitor = analysis;
+  TF_RETURN_IF_ERROR(instr->Visit(visitor));
+  return analysis->Postprocess(instr);
+}
+
+double Flops(const HloCostAnalysis& analysis, const HloInstruction& instr) {
+  return analysis.flop_count(instr) + analysis.transcendental_count(instr);
+}
+
+// Custom calls have unknown, i.e., negative, bytes.
+double Bytes(const HloCostAnalysis& analysis, const HloInstruction& instr) {
+  return std::max<double>(0, analysis.bytes_accessed(instr));
+}
+
+}  // namespace
+
+double FusionCostModel::KernelTime(double flops, double bytes) const {
+  const HloCostAnalysis::Options& cost_options = options_.cost_options;
+  return std::max(
+             flops / cost_options.per_second_rate(HloCostAnalysis::kFlopsKey),
+             bytes / cost_options.per_second_rate(
+                         HloCostAnalysis::kBytesAccessedKey)) +
+         options_.kernel_launch_overhead;
+}
+
+StatusOr<FusionCostModel::RunTimes> FusionCostModel::EstimateRunTimes(
+    HloInstruction* producer,
+    absl::Span<HloInstruction* const> fused_consumers) const {
+  GpuHloCostAnalysis analysis(options_.cost_options);
+  TF_RETURN_IF_ERROR(AnalyzeInstruction(producer, &analysis));
+  const double producer_flops = Flops(analysis, *producer);
+  const double producer_time =
+      KernelTime(producer_flops, Bytes(analysis, *producer));
+  // A recomputed producer reads its operands instead of its output.
+  const double producer_input_bytes =
+      std::max<double>(0, Bytes(analysis, *producer) -
+                              analysis.output_bytes_accessed(*producer));
+
+  RunTimes times{producer_time, 0.0};
+  for (HloInstruction* consumer : fused_consumers) {
+    TF_RETURN_IF_ERROR(AnalyzeInstruction(consumer, &analysis));
+    double flops = Flops(analysis, *consumer);
+    double bytes = Bytes(analysis, *consumer);
+    times.time_unfused += KernelTime(flops, bytes);
+
+    for (int64_t i = 0; i < consumer->operand_count(); ++i) {
+      if (consumer->operand(i) != producer) {
+        continue;
+      }
+      // The utilization counts the reads of each element of the producer.
+      const double utilization = analysis.operand_utilization(*consumer, i);
+      bytes += utilization * producer_input_bytes -
+               analysis.operand_bytes_accessed(*consumer, i);
+      flops += utilization * producer_flops;
+    }
+    times.time_fused += KernelTime(flops, std::max(0.0, bytes));
+  }
+
+  if (producer->user_count() > static_cast<int64_t>(fused_consumers.size())) {
+    times.time_fused += producer_time;
+  }
+  return times;
+}
+
+FusionDecision FusionCostModel::IsFusionFaster(
+    HloInstruction* producer,
+    absl::Span<HloInstruction* const> fused_consumers) {
+  StatusOr<RunTimes> times = EstimateRunTimes(producer, fused_consumers);
+  if (!times.ok()) {
+    VLOG(1) << "Cannot estimate the fusion of " << producer->name() << ": "
+            << times.status();
+    return {};
+  }
+  if (times->time_fused <= times->time_unfused) {
+    return {};
+  }
+
+  std::string explanation = absl::StrFormat(
+      "the fusion is predicted to be slower: %.3fus fused vs %.3fus unfused",
+      times->time_fused * 1e6, times->time_unfused * 1e6);
+  std::string candidate = absl::StrCat(
+      producer->name(), " into ",
+      absl::StrJoin(fused_consumers, ", ",
+                    [](std::string* out, const HloInstruction* consumer) {
+                      absl::StrAppend(out, consumer->name());
+                    }));
+  VLOG(2) << "Not fusing " << candidate << ": " << explanation;
+  rejected_fusions_[candidate] = explanation;
+  return explanation;
+}
+
+void FusionCostModel::DumpRejectedFusions(const HloModule& module) const {
+  if (rejected_fusions_.empty() || !DumpingEnabledForHloModule(module)) {
+    return;
+  }
+  std::string contents;
+  for (const auto& [candidate, explanation] : rejected_fusions_) {
+    absl::StrAppend(&contents, candidate, ": ", explanation, "\n");
+  }
+  DumpToFileInDirOrStdout(module, "",
+                          absl::StrCat(dump_name_, ".rejected_fusions.txt"),
+                          contents);
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,72 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_FUSION_COST_MODEL_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_FUSION_COST_MODEL_H_
+
+#include <map>
+#include <string>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/instruction_fusion.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace xla {
+namespace gpu {
+
+// A roofline model of the run times of candidate fusions. Each kernel takes
+// the larger of its flops over the peak flops and of its HBM bytes over the
+// memory bandwidth, plus a launch overhead. A consumer with a fused producer
+// recomputes the producer, and reads the operands of the producer, for each
+// element of the producer it reads, so fusing into consumers that reuse their
+// operands (e.g., broadcasts or reduce-windows) can be slower than writing the
+// producer once.
+class FusionCostModel {
+ public:
+  struct Options {
+    // The shape size function and the flops and bytes per second.
+    HloCostAnalysis::Options cost_options;
+    // In seconds.
+    double kernel_launch_overhead = 5e-6;
+  };
+
+  struct RunTimes {
+    double time_unfused;
+    double time_fused;
+  };
+
+  // `dump_name` names the dump of the rejected candidates.
+  FusionCostModel(Options options, std::string dump_name)
+      : options_(std::move(options)), dump_name_(std::move(dump_name)) {}
+
+  // Estimates the run times of `producer` and `fused_consumers` as separate
+  // kernels, and of `fused_consumers` with `producer` fused into each of them.
+  // The users of `producer` that are not in `fused_consumers` still read it
+  // from memory.
+  StatusOr<RunTimes> EstimateRunTimes(
+      HloInstruction* producer,
+      absl::Span<HloInstruction* const> fused_consumers) const;
+
+  // Returns whether fusing `producer` into `fused_consumers` is predicted to
+  // be faster, and records the rejected candidates.
+  FusionDecision IsFusionFaster(
+      HloInstruction* producer,
+      absl::Span<HloInstruction* const> fused_consumers);
+
+  // Dumps the rejected candidates so far to
+  // "<module>.<dump_name>.rejected_fusions.txt" if dumping is enabled.
+  void DumpRejectedFusions(const HloModule& module) const;
+
+ private:
+  double KernelTime(double flops, double bytes) const;
+
+  Options options_;
+  std::string dump_name_;
+  // Keyed by the candidate, since a candidate is often evaluated repeatedly.
+  std::map<std::string, std::string> rejected_fusions_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_FUSION_COST_MODEL_H_
@@ -0,0 +1,79 @@
+#include "tensorflow/compiler/xla/service/gpu/fusion_cost_model.h"
+
+#include <memory>
+
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+constexpr double kMiB = 1 << 20;
+
+FusionCostModel::Options TestOptions() {
+  FusionCostModel::Options options;
+  options.cost_options.shape_size = [](const Shape& shape) {
+    return ShapeUtil::ByteSizeOf(shape, /*pointer_size=*/8);
+  };
+  options.cost_options.set_flops_per_second(1e14);
+  options.cost_options.set_bytes_per_second(1e12);
+  options.kernel_launch_overhead = 5e-6;
+  return options;
+}
+
+class FusionCostModelTest : public HloTestBase {};
+
+TEST_F(FusionCostModelTest, ElementwiseFusionIsFaster) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(R"(
+HloModule module
+
+ENTRY entry {
+  p0 = f32[1024,1024] parameter(0)
+  p1 = f32[1024,1024] parameter(1)
+  add = f32[1024,1024] add(p0, p1)
+  ROOT negate = f32[1024,1024] negate(add)
+})"));
+  HloInstruction* negate = module->entry_computation()->root_instruction();
+  HloInstruction* add = negate->mutable_operand(0);
+
+  FusionCostModel cost_model(TestOptions(), "test");
+  TF_ASSERT_OK_AND_ASSIGN(FusionCostModel::RunTimes times,
+                          cost_model.EstimateRunTimes(add, {negate}));
+  // 12MiB and 8MiB in two kernels vs. 12MiB in one kernel.
+  EXPECT_NEAR(times.time_unfused, 20 * kMiB / 1e12 + 2 * 5e-6, 1e-9);
+  EXPECT_NEAR(times.time_fused, 12 * kMiB / 1e12 + 5e-6, 1e-9);
+  EXPECT_TRUE(cost_model.IsFusionFaster(add, {negate}));
+}
+
+TEST_F(FusionCostModelTest, RecomputingForBroadcastIsSlower) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(R"(
+HloModule module
+
+ENTRY entry {
+  p0 = f32[1024] parameter(0)
+  p1 = f32[1024] parameter(1)
+  add = f32[1024] add(p0, p1)
+  ROOT broadcast = f32[1024,1024] broadcast(add), dimensions={1}
+})"));
+  HloInstruction* broadcast = module->entry_computation()->root_instruction();
+  HloInstruction* add = broadcast->mutable_operand(0);
+
+  // Each element of the add is recomputed from p0 and p1 1024 times.
+  FusionCostModel cost_model(TestOptions(), "test");
+  TF_ASSERT_OK_AND_ASSIGN(FusionCostModel::RunTimes times,
+                          cost_model.EstimateRunTimes(add, {broadcast}));
+  EXPECT_GT(times.time_fused, times.time_unfused);
+  FusionDecision decision = cost_model.IsFusionFaster(add, {broadcast});
+  EXPECT_FALSE(decision);
+  EXPECT_THAT(decision.Explain(),
+              ::testing::HasSubstr("predicted to be slower"));
+}
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
@@ -130,8 +130,10 @@ double GetMergedBytesTransferred(HloInstruction* fusion) {
 // if can't fuse into at least one).
 class FusionInstructionMerger {
  public:
-  explicit FusionInstructionMerger(HloComputation* computation)
+  FusionInstructionMerger(HloComputation* computation,
+                          FusionCostModel* cost_model)
       : computation_(computation),
+        cost_model_(cost_model),
         dump_fusion_visualization_(computation->parent()
                                        ->config()
                                        .debug_options()
@@ -146,6 +148,9 @@ class FusionInstructionMerger {
   Status FuseIntoAllUsers(HloInstruction* instruction);
 
   HloComputation* computation_;
+  // Added by Alpa. Replaces the bytes transferred and expensive instruction
+  // heuristics if not null.
+  FusionCostModel* cost_model_;
 
   bool changed_ = false;
   bool dump_fusion_visualization_ = false;
@@ -161,6 +166,7 @@ class FusionInstructionMerger {
   int num_fail_inefficient_fusion_emitter_ = 0;
   int num_fail_fusion_too_large_ = 0;
   int num_fail_uncoalesced_read_ = 0;
+  int num_fail_slower_ = 0;
 
   FusionInstructionMerger(const FusionInstructionMerger&) = delete;
   FusionInstructionMerger& operator=(const FusionInstructionMerger&) = delete;
@@ -244,7 +250,8 @@ Status FusionInstructionMerger::Run() {
           << " net_bytes_transferred: " << num_fail_net_bytes_transferred_ratio_
           << " inefficient_fusion_emitter: "
           << num_fail_inefficient_fusion_emitter_
-          << " fusion_too_large: " << num_fail_fusion_too_large_ << " }";
+          << " fusion_too_large: " << num_fail_fusion_too_large_
+          << " slower: " << num_fail_slower_ << " }";
   return OkStatus();
 }
 
@@ -306,6 +313,17 @@ FusionDecision FusionInstructionMerger::HandleFusion(HloInstruction* fusion) {
     return "would read mostly uncoalesced";
   }
 
+  // Added by Alpa. The cost model replaces the heuristics on the bytes
+  // transferred and on expensive instructions below.
+  if (cost_model_ != nullptr) {
+    FusionDecision faster =
+        cost_model_->IsFusionFaster(fusion, fusion->users());
+    if (!faster) {
+      ++num_fail_slower_;
+      return faster;
+    }
+  }
+
   // Skip 'fusion' instruction if merging it into all users would result in a
   // net increase in bytes transferred (currently allowing the net bytes
   // transferred to be exceeded up to ~10% in exchange for eliminating the
@@ -314,7 +332,7 @@ FusionDecision FusionInstructionMerger::HandleFusion(HloInstruction* fusion) {
   const double merged_bytes_transferred = GetMergedBytesTransferred(fusion);
   const double merged_to_current_bytes_ratio =
       merged_bytes_transferred / std::max(1.0, current_bytes_transferred);
-  if (merged_to_current_bytes_ratio > 1.10) {
+  if (cost_model_ == nullptr && merged_to_current_bytes_ratio > 1.10) {
     ++num_fail_net_bytes_transferred_ratio_;
     return FusionDecision{} << "merged-to-current-bytes-ratio of "
                             << merged_to_current_bytes_ratio
@@ -341,7 +359,7 @@ FusionDecision FusionInstructionMerger::HandleFusion(HloInstruction* fusion) {
         int64_t operand_index = user->operand_index(fusion);
         return user->ReusesOperandElements(operand_index);
       });
-  if (!allow_expensive_ops) {
+  if (cost_model_ == nullptr && !allow_expensive_ops) {
     for (const HloInstruction* instruction : fusion->fused_instructions()) {
       if (instruction->opcode() != HloOpcode::kParameter &&
           GpuInstructionFusion::IsExpensive(*instruction)) {
@@ -390,7 +408,8 @@ StatusOr<bool> FusionMerger::Run(
             << computation->name();
     XLA_VLOG_LINES(3, computation->ToString());
 
-    FusionInstructionMerger fusion_merger(computation);
+    FusionInstructionMerger fusion_merger(
+        computation, cost_model_.has_value() ? &*cost_model_ : nullptr);
     TF_RETURN_IF_ERROR(fusion_merger.Run());
     changed |= fusion_merger.changed();
 
@@ -398,6 +417,9 @@ StatusOr<bool> FusionMerger::Run(
             << computation->name() << " changed: " << changed;
     XLA_VLOG_LINES(3, computation->ToString());
   }
+  if (cost_model_.has_value()) {
+    cost_model_->DumpRejectedFusions(*module);
+  }
   return changed;
 }
 
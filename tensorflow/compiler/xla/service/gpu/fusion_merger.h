@@ -16,6 +16,10 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_FUSION_MERGER_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_FUSION_MERGER_H_
 
+#include <optional>
+#include <utility>
+
+#include "tensorflow/compiler/xla/service/gpu/fusion_cost_model.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
 
@@ -59,12 +63,25 @@ namespace gpu {
 
 class FusionMerger : public HloModulePass {
  public:
+  FusionMerger() = default;
+
+  // Added by Alpa. Merges the fusions that `cost_model_options` predicts to be
+  // faster, instead of the fusions that do not increase the bytes transferred
+  // much and that do not duplicate expensive instructions.
+  explicit FusionMerger(FusionCostModel::Options cost_model_options) {
+    cost_model_.emplace(std::move(cost_model_options), "fusion_merger");
+  }
+
   absl::string_view name() const override { return "fusion_merger"; }
 
   using HloPassInterface::Run;
   StatusOr<bool> Run(
       HloModule* module,
       const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+
+ private:
+  // Added by Alpa.
+  std::optional<FusionCostModel> cost_model_;
 };
 
 }  // namespace gpu
@@ -689,6 +689,50 @@ ENTRY main {
   EXPECT_FALSE(FusionMerger().Run(module.get()).value());
 }
 
+// Added by Alpa.
+TEST_F(FusionMergerTest, CostModelRejectsRecomputingForBroadcast) {
+  constexpr absl::string_view kHlo = R"(
+HloModule module
+
+fused_add {
+  p0 = f32[1024] parameter(0)
+  p1 = f32[1024] parameter(1)
+  p2 = f32[1024] parameter(2)
+  p3 = f32[1024] parameter(3)
+  add0 = f32[1024] add(p0, p1)
+  add1 = f32[1024] add(p2, p3)
+  ROOT add2 = f32[1024] add(add0, add1)
+}
+
+fused_broadcast {
+  p0 = f32[1024] parameter(0)
+  ROOT broadcast = f32[1024,1024] broadcast(p0), dimensions={1}
+}
+
+ENTRY entry {
+  p0 = f32[1024] parameter(0)
+  p1 = f32[1024] parameter(1)
+  p2 = f32[1024] parameter(2)
+  p3 = f32[1024] parameter(3)
+  add = f32[1024] fusion(p0, p1, p2, p3), kind=kLoop, calls=fused_add
+  ROOT broadcast = f32[1024,1024] fusion(add), kind=kLoop,
+    calls=fused_broadcast
+})";
+  FusionCostModel::Options options;
+  options.cost_options.shape_size = [](const Shape& shape) {
+    return ShapeUtil::ByteSizeOf(shape, /*pointer_size=*/8);
+  };
+  options.cost_options.set_flops_per_second(1e14);
+  options.cost_options.set_bytes_per_second(1e12);
+
+  // Merging reads fewer bytes than writing and reading the add, but the four
+  // inputs of the add are read for each element of the broadcast.
+  auto module = ParseAndReturnVerifiedModule(kHlo).value();
+  EXPECT_TRUE(FusionMerger().Run(module.get()).value());
+  module = ParseAndReturnVerifiedModule(kHlo).value();
+  EXPECT_FALSE(FusionMerger(options).Run(module.get()).value());
+}
+
 }  // namespace
 }  // namespace gpu
 }  // namespace xla
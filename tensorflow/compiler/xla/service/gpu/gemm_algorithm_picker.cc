@@ -18,9 +18,9 @@ limitations under the License.
 #include <functional>
 #include <limits>
 #include <string>
-#include <tuple>
 #include <utility>
 
+#include "tensorflow/compiler/xla/service/gpu/autotune_results_store.h"
 #include "tensorflow/compiler/xla/service/gpu/backend_configs.pb.h"
 #include "tensorflow/compiler/xla/service/gpu/buffer_comparator.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_asm_opts_util.h"
@@ -217,31 +217,42 @@ StatusOr<std::optional<se::blas::AlgorithmType>> DoGemmAutotune(
   // Don't run autotuning concurrently on the same GPU.
   absl::MutexLock gpu_lock(&GetGpuMutex(stream->parent()));
 
-  auto key = std::make_tuple(stream->parent(), lhs->shape(), rhs->shape(),
-                             gemm->shape(), gemm_config.SerializeAsString(),
-                             IsCublasLtMatmul(*gemm));
+  // Added by Alpa
+  // The results are shared through the AutotuneResultsStore by the devices of
+  // the same kind and across processes. A result without a gemm algorithm
+  // means the generic algorithm.
+  std::string device_key = AutotuneResultsStore::DeviceKey(stream->parent());
+  std::string hlo_key = absl::StrCat(
+      ShapeUtil::HumanStringWithLayout(lhs->shape()), ", ",
+      ShapeUtil::HumanStringWithLayout(rhs->shape()), " -> ",
+      ShapeUtil::HumanStringWithLayout(gemm->shape()), "; ",
+      gemm_config.ShortDebugString(),
+      IsCublasLtMatmul(*gemm) ? "; cublas_lt" : "");
 
   static absl::Mutex mutex(absl::kConstInit);
-  static auto& cache ABSL_GUARDED_BY(mutex) =
-      *new absl::flat_hash_map<decltype(key),
-                               std::optional<se::blas::AlgorithmType>>();
   static int64_t cache_hits ABSL_GUARDED_BY(mutex) = 0;
   static int64_t cache_misses ABSL_GUARDED_BY(mutex) = 0;
 
+  std::optional<tensorflow::AutotuneResult> cached =
+      AutotuneResultsStore::Get().Lookup(AutotuneResultsStore::Kind::kGemm,
+                                         device_key, hlo_key);
   absl::MutexLock lock(&mutex);
-  auto it = cache.find(key);
   int64_t requests = cache_hits + cache_misses;
   if (requests && requests % 10 == 0) {
     VLOG(2) << "Autotuning cache hits/(hits + misses): " << cache_hits << "/"
             << requests;
   }
 
-  if (it != cache.end()) {
+  if (cached.has_value()) {
     cache_hits++;
+    std::optional<se::blas::AlgorithmType> algorithm;
+    if (cached->has_gemm()) {
+      algorithm = cached->gemm().algorithm();
+    }
     VLOG(4) << "Autotuning cache hit, using algorithm: "
-            << (it->second.has_value() ? absl::StrCat(*(it->second))
-                                       : "<generic>");
-    return it->second;
+            << (algorithm.has_value() ? absl::StrCat(*algorithm)
+                                      : "<generic>");
+    return algorithm;
   }
   cache_misses++;
   VLOG(4) << "Autotuning cache miss";
@@ -267,10 +278,10 @@ StatusOr<std::optional<se::blas::AlgorithmType>> DoGemmAutotune(
   std::optional<se::blas::AlgorithmType> best_algorithm;
   if (IsCublasLtMatmul(*gemm)) {
     bool has_matrix_bias = config.beta != 0.;
-    bool has_vector_bias = gemm_config.epilogue() == GemmBackendConfig::BIAS;
+    bool has_vector_bias = EpilogueAddsVectorBias(gemm_config.epilogue());
 
-    auto epilogue = has_vector_bias ? se::cuda::BlasLt::Epilogue::kBias
-                                    : se::cuda::BlasLt::Epilogue::kDefault;
+    TF_ASSIGN_OR_RETURN(auto epilogue,
+                        cublas_lt::AsBlasLtEpilogue(gemm_config.epilogue()));
 
     se::DeviceMemoryBase bias_buffer;
     if (has_vector_bias) {
@@ -331,7 +342,12 @@ StatusOr<std::optional<se::blas::AlgorithmType>> DoGemmAutotune(
     if (best_algorithm_idx) best_algorithm = algorithms[*best_algorithm_idx];
   }
 
-  CHECK(cache.emplace(key, best_algorithm).second);
+  tensorflow::AutotuneResult result;
+  if (best_algorithm.has_value()) {
+    result.mutable_gemm()->set_algorithm(*best_algorithm);
+  }
+  AutotuneResultsStore::Get().Insert(AutotuneResultsStore::Kind::kGemm,
+                                     device_key, hlo_key, std::move(result));
   return best_algorithm;
 }
 
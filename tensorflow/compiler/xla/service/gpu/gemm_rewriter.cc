@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/gpu/gemm_rewriter.h"
 
+#include <cmath>
 #include <memory>
 #include <numeric>
 #include <utility>
@@ -22,6 +23,7 @@ limitations under the License.
 
 #include "absl/algorithm/container.h"
 #include "absl/strings/string_view.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
 #include "tensorflow/compiler/xla/service/dfs_hlo_visitor_with_default.h"
 #include "tensorflow/compiler/xla/service/gpu/backend_configs.pb.h"
 #include "tensorflow/compiler/xla/service/gpu/cublas_cudnn.h"
@@ -115,6 +117,47 @@ HloInstruction *MaybeConstantFoldBias(HloInstruction *bias) {
   return bias;
 }
 
+// Added by Alpa
+// A broadcast of a scalar constant equal to `value` up to the rounding to a
+// low precision floating-point type.
+auto BcastConstScalar(double value) {
+  return m::Broadcast(
+      m::ConstantScalar().WithPredicate([value](const HloInstruction *instr) {
+        std::optional<double> constant = instr->literal().GetAsDouble({});
+        return constant.has_value() &&
+               std::abs(*constant - value) <= 1e-2 * std::abs(value);
+      }));
+}
+
+// Matches 0.5 * (1 + tanh(sqrt(2 / pi) * (x + 0.044715 * x^3))), the
+// cumulative distribution function of the tanh approximation of GELU, which
+// is how JAX and Flax compute gelu(x) = x * cdf(x).
+bool IsGeluApproximateCdf(const HloInstruction *cdf, const HloInstruction *x) {
+  auto input = m::Op().Is(x);
+  return Match(
+      cdf,
+      m::MultiplyAnyOrder(
+          BcastConstScalar(0.5),
+          m::AddAnyOrder(
+              BcastConstScalar(1.0),
+              m::Tanh(
+                  m::MultiplyAnyOrder(
+                      BcastConstScalar(std::sqrt(M_2_PI)),
+                      m::AddAnyOrder(
+                          input,
+                          m::MultiplyAnyOrder(
+                              BcastConstScalar(0.044715),
+                              m::MultiplyAnyOrder(
+                                  input, m::MultiplyAnyOrder(input, input)
+                                             .WithOneUser())
+                                  .WithOneUser())
+                              .WithOneUser())
+                          .WithOneUser())
+                      .WithOneUser())
+                  .WithOneUser())
+              .WithOneUser()));
+}
+
 // The rewriting proceeds in a bottom-up way:
 //
 // (kDot A B) is rewritten into a (kCustomCall:gemm A B)
@@ -127,6 +170,12 @@ HloInstruction *MaybeConstantFoldBias(HloInstruction *bias) {
 // and provided C has no other users).
 // We then guide the buffer assignment to alias the buffer of the custom call
 // and C.
+//
+// (kMaximum (kCustomCall:cublas-lt-matmul A B) 0) and the tanh approximation
+// of GELU of a cublasLt matmul are folded into the epilogue of the matmul.
+//
+// The requantization of an int8 cublasLt matmul to int8 is folded into its
+// alpha and output type.
 class GemmRewriterVisitor : public DfsHloRewriteVisitor {
  public:
   explicit GemmRewriterVisitor(
@@ -164,6 +213,18 @@ class GemmRewriterVisitor : public DfsHloRewriteVisitor {
   }
 
   Status HandleMultiply(HloInstruction *instr) override {
+    // Added by Alpa
+    // gelu(x) = x * cdf(x), in either operand order.
+    for (int64_t i = 0; i < 2; ++i) {
+      HloInstruction *input = instr->mutable_operand(i);
+      const HloInstruction *cdf = instr->operand(1 - i);
+      if (cdf->user_count() == 1 && IsGeluApproximateCdf(cdf, input)) {
+        // `input` is used by instr, the add and the two multiplies of x^3.
+        return FuseActivation(instr, input, /*num_input_users=*/4,
+                              GemmBackendConfig::GELU);
+      }
+    }
+
     HloInstruction *alpha, *existing_gemm;
     if (Match(instr,
               m::MultiplyAnyOrder(
@@ -173,9 +234,10 @@ class GemmRewriterVisitor : public DfsHloRewriteVisitor {
       TF_ASSIGN_OR_RETURN(auto config,
                           existing_gemm->backend_config<GemmBackendConfig>());
 
-      // Do not fuse alpha into S32 GEMM, as they only support fixed values for
-      // alpha/beta.
-      if (existing_gemm->shape().element_type() == S32) {
+      // Do not fuse alpha into integer GEMMs, as they only support fixed
+      // values for alpha/beta.
+      if (primitive_util::IsIntegralType(
+              existing_gemm->shape().element_type())) {
         return OkStatus();
       }
 
@@ -246,6 +308,18 @@ class GemmRewriterVisitor : public DfsHloRewriteVisitor {
     return OkStatus();
   }
 
+  // Added by Alpa
+  Status HandleMaximum(HloInstruction *instr) override {
+    HloInstruction *input;
+    // relu(x) = max(x, 0)
+    if (Match(instr,
+              m::MaximumAnyOrder(m::Op(&input), BcastConstScalar(0.0)))) {
+      return FuseActivation(instr, input, /*num_input_users=*/1,
+                            GemmBackendConfig::RELU);
+    }
+    return OkStatus();
+  }
+
   Status HandleConvert(HloInstruction *instr) override {
     HloInstruction *bias, *existing_gemm;
     if (Match(
@@ -259,16 +333,68 @@ class GemmRewriterVisitor : public DfsHloRewriteVisitor {
                 .WithElementType(BF16))) {
       return FuseMatrixBiasAdd(instr, bias, existing_gemm);
     }
+
+    // Added by Alpa
+    // Requantization of an int8 matmul to int8:
+    //   convert<s8>(clamp(-128, round(convert<f32>(matmul) * scale), 127))
+    HloInstruction *scale;
+    if (Match(instr,
+              m::Convert(
+                  m::Clamp(
+                      m::Broadcast(m::ConstantScalar(-128)),
+                      m::Op()
+                          .WithOpcode(HloOpcode::kRoundNearestEven)
+                          .WithOperand(
+                              0, m::MultiplyAnyOrder(
+                                     m::Convert(
+                                         m::CustomCall(
+                                             &existing_gemm,
+                                             {kCublasLtMatmulCallTarget})
+                                             .WithElementType(S32)
+                                             .WithOneUser())
+                                         .WithElementType(F32)
+                                         .WithOneUser(),
+                                     m::Broadcast(m::ConstantScalar(&scale)))
+                                     .WithOneUser())
+                          .WithOneUser(),
+                      m::Broadcast(m::ConstantScalar(127)))
+                      .WithOneUser())
+                  .WithElementType(S8))) {
+      return FuseRequantize(instr, scale, existing_gemm);
+    }
     return OkStatus();
   }
 
+  // Added by Alpa
+  // Folds the requantization `instr` of an int8 matmul into the matmul, which
+  // then scales its int32 accumulators by `scale` in f32, and rounds and
+  // saturates them to int8 on the tensor cores, instead of writing int32
+  // results for a separate kernel.
+  Status FuseRequantize(HloInstruction *instr, HloInstruction *scale,
+                        HloInstruction *gemm) {
+    std::optional<double> scale_value = scale->literal().GetAsDouble({});
+    TF_ASSIGN_OR_RETURN(auto config,
+                        gemm->backend_config<GemmBackendConfig>());
+    if (!scale_value.has_value() || config.beta() != 0 ||
+        config.epilogue() != GemmBackendConfig::DEFAULT) {
+      return OkStatus();
+    }
+    config.set_alpha_real(*scale_value);
+
+    std::unique_ptr<HloInstruction> fused_op =
+        gemm->CloneWithNewOperands(instr->shape(), gemm->operands());
+    TF_RETURN_IF_ERROR(fused_op->set_backend_config(config));
+    TF_RETURN_IF_ERROR(SetName(instr->GetModule(), fused_op.get()));
+    return ReplaceWithNewInstruction(instr, std::move(fused_op));
+  }
+
   Status FuseMatrixBiasAdd(HloInstruction *instr, HloInstruction *bias,
                            HloInstruction *gemm) {
     TF_RET_CHECK(bias->shape() == gemm->shape());
 
-    // Do not fuse bias into S32 GEMM, as for this datatype cuBLAS only
+    // Do not fuse bias into integer GEMMs, as for these datatypes cuBLAS only
     // supports fixed values for alpha/beta.
-    if (gemm->shape().element_type() == S32) {
+    if (primitive_util::IsIntegralType(gemm->shape().element_type())) {
       return OkStatus();
     }
 
@@ -342,6 +468,7 @@ class GemmRewriterVisitor : public DfsHloRewriteVisitor {
 
     HloInstruction *bias = broadcast_bias->mutable_operand(0);
     if ((matmul->user_count() != 1) ||
+        primitive_util::IsIntegralType(matmul->shape().element_type()) ||
         (config.epilogue() != GemmBackendConfig::DEFAULT) ||
         (bias->shape().rank() != num_col_dims)) {
       return false;
@@ -381,6 +508,85 @@ class GemmRewriterVisitor : public DfsHloRewriteVisitor {
     return true;
   }
 
+  // Added by Alpa
+  // Folds the activation `instr` of `input` into the epilogue of a cublasLt
+  // matmul. `input` is either the matmul or the matmul behind the bitcasts
+  // and widening converts that the SPMD partitioner and mixed precision insert
+  // between a (partitioned) dot and its activation, and must only be used by
+  // the `num_input_users` instructions of the activation.
+  Status FuseActivation(HloInstruction *instr, HloInstruction *input,
+                        int64_t num_input_users,
+                        GemmBackendConfig::Epilogue activation) {
+    if (input->user_count() != num_input_users) {
+      return OkStatus();
+    }
+
+    HloInstruction *gemm = input;
+    bool has_convert = false;
+    while (gemm->opcode() == HloOpcode::kBitcast ||
+           gemm->opcode() == HloOpcode::kConvert) {
+      if (gemm->opcode() == HloOpcode::kConvert) {
+        PrimitiveType from = gemm->operand(0)->shape().element_type();
+        PrimitiveType to = gemm->shape().element_type();
+        if (!primitive_util::IsFloatingPointType(from) ||
+            !primitive_util::IsFloatingPointType(to) ||
+            primitive_util::BitWidth(from) >= primitive_util::BitWidth(to)) {
+          return OkStatus();
+        }
+        has_convert = true;
+      }
+      gemm = gemm->mutable_operand(0);
+      if (gemm->user_count() != 1) {
+        return OkStatus();
+      }
+    }
+    if (!IsCublasLtMatmul(*gemm) ||
+        !primitive_util::IsFloatingPointType(gemm->shape().element_type())) {
+      return OkStatus();
+    }
+
+    // The epilogue computes the activation before rounding the matmul result
+    // to its type, which is exact for relu. For other activations behind a
+    // widening convert, require that the activation is rounded back to the
+    // matmul type anyway.
+    if (has_convert && activation != GemmBackendConfig::RELU) {
+      if (instr->user_count() != 1 ||
+          instr->users()[0]->opcode() != HloOpcode::kConvert ||
+          instr->users()[0]->shape().element_type() !=
+              gemm->shape().element_type()) {
+        return OkStatus();
+      }
+    }
+
+    TF_ASSIGN_OR_RETURN(auto config,
+                        gemm->backend_config<GemmBackendConfig>());
+    if (config.epilogue() == GemmBackendConfig::DEFAULT) {
+      config.set_epilogue(activation);
+    } else if (config.epilogue() == GemmBackendConfig::BIAS) {
+      config.set_epilogue(activation == GemmBackendConfig::RELU
+                              ? GemmBackendConfig::BIAS_RELU
+                              : GemmBackendConfig::BIAS_GELU);
+    } else {
+      return OkStatus();
+    }
+
+    HloInstruction *fused_op = instr->parent()->AddInstruction(
+        gemm->CloneWithNewOperands(gemm->shape(), gemm->operands()));
+    TF_RETURN_IF_ERROR(fused_op->set_backend_config(config));
+    TF_RETURN_IF_ERROR(SetName(instr->GetModule(), fused_op));
+
+    // Redo the converts and bitcasts between the matmul and the activation.
+    HloInstruction *result = fused_op;
+    if (result->shape().element_type() != instr->shape().element_type()) {
+      result = MakeConvertToHlo(result, instr->shape().element_type(),
+                                &instr->metadata());
+    }
+    if (!ShapeUtil::Equal(result->shape(), instr->shape())) {
+      result = MakeBitcastHlo(result, instr->shape(), &instr->metadata());
+    }
+    return ReplaceInstruction(instr, result);
+  }
+
  private:
   se::CudaComputeCapability cuda_compute_capability_;
 
@@ -401,9 +607,12 @@ class GemmRewriterVisitor : public DfsHloRewriteVisitor {
     // cublasLt is enabled.
     if (lhs->shape().element_type() == S8 ||
         rhs->shape().element_type() == S8) {
-      // TODO(b/241446501) The XLA usage of cublasLt does not yet handle
-      // int8 matmuls. Fallback to legacy cublas.
-      return absl::string_view(kGemmCallTarget);
+      // Added by Alpa
+      // cublasLt runs int8 matmuls on the integer tensor cores (IMMA), which
+      // need Turing or newer. Fallback to legacy cublas on older GPUs.
+      if (!cuda_compute_capability_.IsAtLeast(7, 5)) {
+        return absl::string_view(kGemmCallTarget);
+      }
     }
 
     TF_ASSIGN_OR_RETURN(bool gemm_is_supported_by_cublas_lt,
@@ -0,0 +1,101 @@
+#include "tensorflow/compiler/xla/service/gpu/gpu_binary_cache.h"
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/service/gpu/executable.pb.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/xla.pb.h"
+#include "tensorflow/tsl/lib/strings/proto_serialization.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/fingerprint.h"
+#include "tensorflow/tsl/platform/logging.h"
+#include "tensorflow/tsl/platform/path.h"
+#include "tensorflow/tsl/platform/random.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+// Bump this when the IR emission or the file format changes.
+constexpr int kCacheFormatVersion = 1;
+
+}  // namespace
+
+std::string GpuBinaryCache::ComputeKey(
+    const HloModule& module, const BufferAssignment& buffer_assignment,
+    absl::string_view device_version) {
+  // Unlike a fingerprint, the kernels depend on the instruction names and the
+  // values of the constants.
+  HloPrintOptions print_options = HloPrintOptions::Canonical()
+                                      .set_canonicalize_instruction_names(false)
+                                      .set_print_operand_names(true)
+                                      .set_print_backend_config(true)
+                                      .set_print_large_constants(true);
+
+  // Options that only affect the debugging output do not change the binary.
+  DebugOptions debug_options = module.config().debug_options();
+  debug_options.clear_xla_dump_to();
+  std::string serialized_debug_options;
+  CHECK(tsl::SerializeToStringDeterministic(debug_options,
+                                            &serialized_debug_options));
+
+  std::string key = absl::StrCat(
+      "v", kCacheFormatVersion, ";", module.ToString(print_options), ";",
+      buffer_assignment.ToString(), ";", serialized_debug_options, ";",
+      device_version);
+  tsl::Fprint128 fp = tsl::Fingerprint128(key);
+  return absl::StrCat(absl::Hex(fp.high64, absl::kZeroPad16),
+                      absl::Hex(fp.low64, absl::kZeroPad16));
+}
+
+std::string GpuBinaryCache::GetPath(const std::string& key) const {
+  return tsl::io::JoinPath(cache_dir_, absl::StrCat(key, ".gpubin"));
+}
+
+std::optional<GpuBinaryCache::Binary> GpuBinaryCache::Lookup(
+    const std::string& key) const {
+  std::string path = GetPath(key);
+  tsl::Env* env = tsl::Env::Default();
+  if (!env->FileExists(path).ok()) {
+    return std::nullopt;
+  }
+
+  std::string contents;
+  if (!tsl::ReadFileToString(env, path, &contents).ok()) {
+    LOG(WARNING) << "Failed to read GPU binary cache: " << path;
+    return std::nullopt;
+  }
+
+  GpuBinaryCacheEntryProto entry;
+  if (!entry.ParseFromString(contents) || entry.key() != key) {
+    LOG(WARNING) << "Corrupted GPU binary cache: " << path;
+    return std::nullopt;
+  }
+
+  VLOG(1) << "Hit GPU binary cache: " << path;
+  return Binary(std::move(*entry.mutable_gpu_asm_text()),
+                std::vector<uint8_t>(entry.gpu_binary().begin(),
+                                     entry.gpu_binary().end()));
+}
+
+Status GpuBinaryCache::Insert(const std::string& key,
+                              const Binary& binary) const {
+  tsl::Env* env = tsl::Env::Default();
+  TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(cache_dir_));
+
+  GpuBinaryCacheEntryProto entry;
+  entry.set_key(key);
+  entry.set_gpu_asm_text(binary.first);
+  entry.set_gpu_binary(binary.second.data(), binary.second.size());
+
+  // Write to a temporary file first so that concurrent readers never see a
+  // partially written entry.
+  std::string path = GetPath(key);
+  std::string tmp_path = absl::StrCat(path, ".tmp.", tsl::random::New64());
+  TF_RETURN_IF_ERROR(
+      tsl::WriteStringToFile(env, tmp_path, entry.SerializeAsString()));
+  return env->RenameFile(tmp_path, path);
+}
+
+}  // namespace gpu
+}  // namespace xla
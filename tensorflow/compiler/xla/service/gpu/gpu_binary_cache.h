@@ -0,0 +1,56 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_BINARY_CACHE_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_BINARY_CACHE_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/compiler/xla/service/buffer_assignment.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/status.h"
+
+namespace xla {
+namespace gpu {
+
+// An on-disk cache of the target binaries (e.g., PTX and CUBIN) of compiled
+// GPU modules, which can be shared by the processes on a host.
+// Each entry is a file named by a fingerprint of the optimized HLO module,
+// its buffer assignment, the debug options and the device version. The buffer
+// assignment is part of the key because it determines the kernel parameters.
+// Entries are written to a temporary file and renamed, so that concurrent
+// readers never see a partially written entry; concurrent writers of the same
+// entry write identical contents.
+class GpuBinaryCache {
+ public:
+  using Binary = std::pair<std::string, std::vector<uint8_t>>;
+
+  // `cache_dir` is created if it does not exist.
+  explicit GpuBinaryCache(std::string cache_dir)
+      : cache_dir_(std::move(cache_dir)) {}
+
+  // Compute the cache key of compiling `module` for the device of
+  // `device_version`, e.g., the compute capability.
+  static std::string ComputeKey(const HloModule& module,
+                                const BufferAssignment& buffer_assignment,
+                                absl::string_view device_version);
+
+  // Return the cached binary, or nullopt if there is no valid entry.
+  std::optional<Binary> Lookup(const std::string& key) const;
+
+  // Store a binary. Errors are returned but are not fatal for the
+  // compilation.
+  Status Insert(const std::string& key, const Binary& binary) const;
+
+ private:
+  std::string GetPath(const std::string& key) const;
+
+  std::string cache_dir_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_BINARY_CACHE_H_
@@ -0,0 +1,54 @@
+#include "tensorflow/compiler/xla/service/gpu/gpu_binary_cache.h"
+
+#include <string>
+
+#include "tensorflow/tsl/lib/core/status_test_util.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/path.h"
+#include "tensorflow/tsl/platform/test.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+class GpuBinaryCacheTest : public ::testing::Test {
+ protected:
+  std::string CacheDir() {
+    return tsl::io::JoinPath(
+        tsl::testing::TmpDir(),
+        ::testing::UnitTest::GetInstance()->current_test_info()->name());
+  }
+};
+
+TEST_F(GpuBinaryCacheTest, InsertAndLookup) {
+  GpuBinaryCache cache(CacheDir());
+  EXPECT_FALSE(cache.Lookup("key").has_value());
+
+  GpuBinaryCache::Binary binary("ptx", {1, 2, 0, 3});
+  TF_ASSERT_OK(cache.Insert("key", binary));
+  EXPECT_EQ(cache.Lookup("key"), binary);
+  EXPECT_FALSE(cache.Lookup("other_key").has_value());
+
+  // Another cache on the same directory, e.g., of another process, sees the
+  // entry.
+  EXPECT_EQ(GpuBinaryCache(CacheDir()).Lookup("key"), binary);
+}
+
+TEST_F(GpuBinaryCacheTest, IgnoreCorruptedEntry) {
+  GpuBinaryCache cache(CacheDir());
+  TF_ASSERT_OK(cache.Insert("key", GpuBinaryCache::Binary("ptx", {1})));
+
+  tsl::Env* env = tsl::Env::Default();
+  std::string path = tsl::io::JoinPath(CacheDir(), "key.gpubin");
+  // An entry of another key.
+  TF_ASSERT_OK(env->CopyFile(
+      path, tsl::io::JoinPath(CacheDir(), "other_key.gpubin")));
+  EXPECT_FALSE(cache.Lookup("other_key").has_value());
+
+  TF_ASSERT_OK(tsl::WriteStringToFile(env, path, "garbage"));
+  EXPECT_FALSE(cache.Lookup("key").has_value());
+}
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
@@ -28,6 +28,7 @@ limitations under the License.
 #include <variant>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/types/variant.h"
@@ -72,8 +73,10 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/broadcast_canonicalizer.h"
 #include "tensorflow/compiler/xla/service/buffer_assignment.h"
 #include "tensorflow/compiler/xla/service/call_inliner.h"
+#include "tensorflow/compiler/xla/service/collective_pipeliner.h"
 #include "tensorflow/compiler/xla/service/collectives_schedule_linearizer.h"
 #include "tensorflow/compiler/xla/service/comparison_expander.h"
+#include "tensorflow/compiler/xla/service/compilation_stats.h"
 #include "tensorflow/compiler/xla/service/conditional_canonicalizer.h"
 #include "tensorflow/compiler/xla/service/conditional_simplifier.h"
 #include "tensorflow/compiler/xla/service/convert_mover.h"
@@ -92,26 +95,37 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/gather_simplifier.h"
 #include "tensorflow/compiler/xla/service/gpu/alias_passthrough_params.h"
 #include "tensorflow/compiler/xla/service/gpu/all_reduce_blueconnect.h"
+#include "tensorflow/compiler/xla/service/gpu/all_reduce_hierarchical.h"
+#include "tensorflow/compiler/xla/service/gpu/attention_chunking.h"
+#include "tensorflow/compiler/xla/service/gpu/auto_mixed_precision.h"
+#include "tensorflow/compiler/xla/service/gpu/autotune_results_store.h"
 #include "tensorflow/compiler/xla/service/gpu/conditional_thunk.h"
 #include "tensorflow/compiler/xla/service/gpu/for_thunk.h"
 #include "tensorflow/compiler/xla/service/gpu/fusion_bitcast_lift.h"
+#include "tensorflow/compiler/xla/service/gpu/fusion_cost_model.h"
 #include "tensorflow/compiler/xla/service/gpu/fusion_merger.h"
 #include "tensorflow/compiler/xla/service/gpu/gemm_broadcast_folding_rewriter.h"
 #include "tensorflow/compiler/xla/service/gpu/gemm_rewriter.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_binary_cache.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_constants.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_conv_algorithm_picker.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_conv_rewriter.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_cost_model.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_deterministic_scatter_rewriter.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_executable.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_hlo_cost_analysis.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_hlo_schedule.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_layout_assignment.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_reduce_scatter_creator.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_rematerialization.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_sanitize_constant_names.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_scatter_expander.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_shape_verifier.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_sort_rewriter.h"
 #include "tensorflow/compiler/xla/service/gpu/hlo_fusion_stats.h"
 #include "tensorflow/compiler/xla/service/gpu/horizontal_input_fusion.h"
 #include "tensorflow/compiler/xla/service/gpu/horizontal_loop_fusion.h"
+#include "tensorflow/compiler/xla/service/gpu/host_offload.h"
 #include "tensorflow/compiler/xla/service/gpu/instruction_fusion.h"
 #include "tensorflow/compiler/xla/service/gpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/gpu/ir_emitter_context.h"
@@ -133,6 +147,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/gpu/sequential_thunk.h"
 #include "tensorflow/compiler/xla/service/gpu/stream_executor_util.h"
 #include "tensorflow/compiler/xla/service/gpu/target_constants.h"
+#include "tensorflow/compiler/xla/service/gpu/thunk_stream_assignment.h"
 #include "tensorflow/compiler/xla/service/gpu/tree_reduction_rewriter.h"
 #include "tensorflow/compiler/xla/service/gpu/variadic_op_splitter.h"
 #include "tensorflow/compiler/xla/service/gpu/while_thunk.h"
@@ -192,6 +207,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/tsl/platform/blocking_counter.h"
 #include "tensorflow/tsl/platform/casts.h"
+#include "tensorflow/tsl/platform/cpu_info.h"
 #include "tensorflow/tsl/platform/env.h"
 #include "tensorflow/tsl/platform/logging.h"
 #include "tensorflow/tsl/platform/regexp.h"
@@ -346,6 +362,62 @@ void AddHloVerifier(HloPassPipeline* pipeline, HloVerifierOpts&& opts = {},
                                                "hlo verifier");
   }
 }
+
+// Added by Alpa. Schedules the module to hide the latency of asynchronous
+// collectives behind compute if "gpu_schedule::latency_hiding" is set.
+StatusOr<HloSchedule> ScheduleGpuModuleWithOptions(const HloModule* module,
+                                                   int64_t pointer_size) {
+  if (!pass_context::GetBool("gpu_schedule::latency_hiding", false)) {
+    return ScheduleGpuModule(module, pointer_size);
+  }
+  HloCostAnalysis::Options cost_options{
+      [pointer_size](const Shape& shape) {
+        return GetSizeOfShape(shape, pointer_size);
+      }};
+  cost_options.set_flops_per_second(
+      pass_context::GetDouble("auto_sharding::device_peak_flops", 1.25e14));
+  cost_options.set_bytes_per_second(pass_context::GetDouble(
+      "auto_sharding::device_memory_bandwidth", 9e11));
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<ProfiledLatencyEstimator> latency_estimator,
+      ProfiledLatencyEstimator::Create(
+          module, cost_options, LoadCollectiveCostModel(),
+          pass_context::GetDouble("gpu_schedule::collective_bandwidth",
+                                  1e11)));
+  return ScheduleGpuModule(
+      module, pointer_size, latency_estimator.get(),
+      pass_context::GetInt(
+          "gpu_schedule::memory_limit_bytes",
+          pass_context::GetInt("auto_sharding::memory_budget_per_device",
+                               -1)));
+}
+
+// Added by Alpa. Returns the options of the roofline fusion cost model if
+// "fusion_cost_model::enable" is set. The memory bandwidth defaults to the
+// one reported by the device.
+std::optional<FusionCostModel::Options> GetFusionCostModelOptions(
+    HloCostAnalysis::ShapeSizeFunction shape_size,
+    se::StreamExecutor* stream_exec) {
+  if (!pass_context::GetBool("fusion_cost_model::enable", false)) {
+    return std::nullopt;
+  }
+  double memory_bandwidth = pass_context::GetDouble(
+      "auto_sharding::device_memory_bandwidth", 9e11);
+  if (stream_exec != nullptr &&
+      stream_exec->GetDeviceDescription().memory_bandwidth() > 0) {
+    memory_bandwidth = stream_exec->GetDeviceDescription().memory_bandwidth();
+  }
+  FusionCostModel::Options options;
+  options.cost_options.shape_size = std::move(shape_size);
+  options.cost_options.set_flops_per_second(
+      pass_context::GetDouble("auto_sharding::device_peak_flops", 1.25e14));
+  options.cost_options.set_bytes_per_second(pass_context::GetDouble(
+      "fusion_cost_model::memory_bandwidth", memory_bandwidth));
+  options.kernel_launch_overhead = pass_context::GetDouble(
+      "fusion_cost_model::kernel_launch_overhead",
+      options.kernel_launch_overhead);
+  return options;
+}
 }  // namespace
 
 // Runs optimization passes on the given HLO module.
@@ -366,6 +438,11 @@ Status GpuCompiler::OptimizeHloModule(
     layout_insensitive_algsimp_opts.set_enable_conv_operand_swap(false);
   }
 
+  // Added by Alpa. Skip the simplification passes that already ran on an
+  // identical module in an earlier iteration of their fixed-point loop.
+  const bool skip_unchanged_passes =
+      pass_context::GetBool("hlo_pass_pipeline::skip_unchanged_passes", false);
+
   if (hlo_module->config().use_spmd_partitioning()) {
     HloPassPipeline spmd_pipeline("spmd-partitioner");
     AddHloVerifier(&spmd_pipeline);
@@ -379,6 +456,8 @@ Status GpuCompiler::OptimizeHloModule(
 
       HloPassPipeline& spmd_simplify =
           spmd_pipeline.AddPass<HloPassFix<HloPassPipeline>>("spmd-simplify");
+      // Added by Alpa
+      spmd_simplify.set_skip_unchanged_passes(skip_unchanged_passes);
 
       spmd_simplify.AddPass<AlgebraicSimplifier>(
           layout_insensitive_algsimp_opts);
@@ -439,9 +518,17 @@ Status GpuCompiler::OptimizeHloModule(
     // handle it.
     pipeline.AddPass<ZeroSizedHloElimination>();
 
+    // Rewrite scatter-adds to sorted scatters with unique indices, which are
+    // deterministic and avoid atomics. Large scatters are always rewritten.
+    pipeline.AddPass<GpuDeterministicScatterRewriter>(
+        /*rewrite_all=*/debug_options.xla_gpu_deterministic_ops(),
+        /*min_num_indices=*/pass_context::GetInt(
+            "gpu_scatter::deterministic_min_indices", 1 << 20));
+
     if (debug_options.xla_gpu_deterministic_ops()) {
-      // Scatter is nondeterministic, so eliminate all Scatters.
-      pipeline.AddPass<ScatterExpander>(ScatterExpander::kEliminateAllScatters);
+      // Scatter with non-unique indices is nondeterministic, so eliminate all
+      // such Scatters.
+      pipeline.AddPass<GpuScatterExpander>(/*deterministic=*/true);
     } else {
       // Only Scatters unsupported on XLA:GPU are eliminated.
       pipeline.AddPass<GpuScatterExpander>();
@@ -463,9 +550,25 @@ Status GpuCompiler::OptimizeHloModule(
     // Replace PRED convolutions with F16.
     pipeline.AddPass<ConvolutionPredExpander>();
 
+    // Rewrite large sorts to the CUB radix sort before they get tie-breaking
+    // iota operands for stability, the radix sort is stable already.
+    int64_t cub_sort_min_size = pass_context::GetInt(
+        "gpu_sort::cub_min_size", GpuSortRewriter::kDefaultMinSortSize);
+    if (cub_sort_min_size > 0) {
+      pipeline.AddPass<GpuSortRewriter>(cub_sort_min_size);
+    }
+
     // Expand the sort op to support stable sorting if required.
     pipeline.AddPass<StableSortExpander>();
 
+    // Added by Alpa
+    // Compute the dots, convolutions and the activations between them in
+    // bf16, keeping reductions, softmax and normalizations in f32.
+    if (pass_context::GetBool("auto_mixed_precision::enable", false)) {
+      pipeline.AddPass<AutoMixedPrecision>(BF16);
+      pipeline.AddPass<SimplifyFPConversions>();
+    }
+
     GpuBfloat16Support bf16(/*supports_matrix_multiplication=*/true,
                             stream_exec);
     pipeline.AddPass<BFloat16Normalization>(&bf16);
@@ -515,6 +618,8 @@ Status GpuCompiler::OptimizeHloModule(
     // point.
     [&, &pipeline =
             pipeline.AddPass<HloPassFix<HloPassPipeline>>("simplification")] {
+      // Added by Alpa
+      pipeline.set_skip_unchanged_passes(skip_unchanged_passes);
       AddHloVerifier(&pipeline, HloVerifierOpts{}, /*debug_only=*/true);
 
       // BatchNormExpander can create zero-sized ops, so zero-sized HLO
@@ -557,6 +662,8 @@ Status GpuCompiler::OptimizeHloModule(
     // and then run ConvertMover + algsimp to a fixed point.
     [&, &pipeline =
             pipeline.AddPass<HloPassFix<HloPassPipeline>>("simplification-2")] {
+      // Added by Alpa
+      pipeline.set_skip_unchanged_passes(skip_unchanged_passes);
       pipeline.AddPass<ConvertMover>();
       pipeline.AddPass<AlgebraicSimplifier>(layout_insensitive_algsimp_opts);
     }();
@@ -591,9 +698,29 @@ Status GpuCompiler::OptimizeHloModule(
         layout_insensitive_algsimp_opts);
 
     collectives_pipeline.AddPass<AllGatherBroadcastReorder>();
+
+    // Added by Alpa. Overlap the per-layer all-gathers and reduce-scatters of
+    // scanned layers and gradient accumulation loops across iterations.
+    if (pass_context::GetBool("collective_pipeliner::enable", false)) {
+      collectives_pipeline.AddPass<CollectivePipeliner>(
+          pass_context::GetBool("collective_pipeliner::all_gather", true),
+          pass_context::GetBool("collective_pipeliner::reduce_scatter", true));
+    }
     TF_RETURN_IF_ERROR(collectives_pipeline.Run(hlo_module).status());
   }
 
+  // Added by Alpa
+  // Compute long attentions by chunks of queries, so that the full attention
+  // matrix is never materialized. This runs after the SPMD partitioner, on
+  // the per-device number of heads.
+  if (pass_context::GetBool("attention_chunking::enable", false)) {
+    HloPassPipeline pipeline("attention-chunking");
+    pipeline.AddPass<AttentionChunking>(
+        pass_context::GetInt("attention_chunking::query_chunk_size", 1024));
+    pipeline.AddPass<HloDCE>();
+    TF_RETURN_IF_ERROR(pipeline.Run(hlo_module).status());
+  }
+
   // Run target-specific HLO optimization passes for convolution
   // canonicalization.
   TF_RETURN_IF_ERROR(OptimizeHloConvolutionCanonicalization(
@@ -613,7 +740,9 @@ Status GpuCompiler::OptimizeHloModule(
     ChannelLayoutConstraints layout_constraints;
     pipeline.AddPass<GpuLayoutAssignment>(
         hlo_module->mutable_entry_computation_layout(), stream_exec,
-        &layout_constraints);
+        &layout_constraints,
+        /*cost_based_dot_layouts=*/pass_context::GetBool(
+            "gpu_layout::cost_based_dot_layouts", false));
     TF_RETURN_IF_ERROR(pipeline.Run(hlo_module).status());
   }
 
@@ -631,9 +760,20 @@ Status GpuCompiler::OptimizeHloModule(
         HloVerifierOpts{}.MakeLayoutSensitive().WithInstructionCanChangeLayout(
             LayoutAssignment::InstructionCanChangeLayout),
         /*debug_only=*/true);
-    fusion.AddPass<GpuInstructionFusion>(/*may_duplicate=*/false);
-    fusion.AddPass<GpuInstructionFusion>(/*may_duplicate=*/true);
-    fusion.AddPass<FusionMerger>();
+    // Added by Alpa.
+    std::optional<FusionCostModel::Options> cost_model_options =
+        GetFusionCostModelOptions(ShapeSizeBytesFunction(), stream_exec);
+    if (cost_model_options.has_value()) {
+      fusion.AddPass<GpuInstructionFusion>(/*may_duplicate=*/false,
+                                           *cost_model_options);
+      fusion.AddPass<GpuInstructionFusion>(/*may_duplicate=*/true,
+                                           *cost_model_options);
+      fusion.AddPass<FusionMerger>(*cost_model_options);
+    } else {
+      fusion.AddPass<GpuInstructionFusion>(/*may_duplicate=*/false);
+      fusion.AddPass<GpuInstructionFusion>(/*may_duplicate=*/true);
+      fusion.AddPass<FusionMerger>();
+    }
     fusion.AddPass<GpuMultiOutputFusion>();
     fusion.AddPass<HloCSE>(/*is_layout_sensitive=*/true,
                            /*only_fusion_computations=*/true);
@@ -643,7 +783,18 @@ Status GpuCompiler::OptimizeHloModule(
 
   {
     HloPassFix<HloPassPipeline> horizontal_fusion("horizontal fusion");
-    horizontal_fusion.AddPass<GpuHorizontalLoopFusion>();
+    // Added by Alpa. Fuse the many small optimizer updates of apply-grad
+    // modules into few kernels.
+    HorizontalLoopFusionOptions horizontal_fusion_options;
+    horizontal_fusion_options.multi_tensor =
+        pass_context::GetBool("horizontal_fusion::multi_tensor", false);
+    horizontal_fusion_options.max_fusion_batch_size = pass_context::GetInt(
+        "horizontal_fusion::max_fusion_batch_size",
+        horizontal_fusion_options.multi_tensor
+            ? 1024
+            : horizontal_fusion_options.max_fusion_batch_size);
+    horizontal_fusion.AddPass<GpuHorizontalLoopFusion>(
+        /*prefix=*/"", horizontal_fusion_options);
     horizontal_fusion.AddPass<GpuHorizontalInputFusion>();
     // FusionBitcastLift must be after InstructionFusion, as it undoes
     // part of it.
@@ -662,19 +813,58 @@ Status GpuCompiler::OptimizeHloModule(
 
   {
     HloPassPipeline pipeline("post-fusion optimization");
+
+    // Added by Alpa. Size the buckets of each replica group from the profiled
+    // latency and bandwidth of its collectives, so that the latency bound
+    // collectives over slow links are combined into larger buckets. The
+    // global thresholds are used for the collectives that are not profiled.
+    CollectiveCombinerOptions combiner_options;
+    combiner_options.schedule_aware =
+        pass_context::GetBool("combiner::schedule_aware", false);
+    std::shared_ptr<const spmd::CollectiveCostModel> prof_result;
+    if (pass_context::GetBool("combiner::cost_model_thresholds", false)) {
+      prof_result = std::make_shared<const spmd::CollectiveCostModel>(
+          LoadCollectiveCostModel());
+    }
+    double scale = pass_context::GetDouble("combiner::crossover_scale", 4.0);
+    int64_t max_threshold = pass_context::GetInt("combiner::max_threshold",
+                                                 1024 * 1024 * 1024);
+    int64_t num_devices = hlo_module->config().num_partitions();
+    auto threshold_fn = [&](int64_t default_threshold)
+        -> std::function<int64_t(const HloInstruction*)> {
+      if (prof_result == nullptr) {
+        return nullptr;
+      }
+      return [=](const HloInstruction* collective) {
+        std::optional<int64_t> threshold = CombineThresholdFromCostModel(
+            collective, num_devices, *prof_result, scale);
+        return threshold.has_value() ? std::min(*threshold, max_threshold)
+                                     : default_threshold;
+      };
+    };
+
+    int64_t all_gather_threshold = pass_context::GetInt(
+        "combiner::all_gather_threshold", 1024 * 1024 * 1024);
+    combiner_options.combine_threshold_bytes_fn =
+        threshold_fn(all_gather_threshold);
     pipeline.AddPass<AllGatherCombiner>(
-        /*combine_threshold_in_bytes=*/
-        pass_context::GetInt("combiner::all_gather_threshold", 1024 * 1024 * 1024),
-        /*combine_threshold_count=*/512);
+        /*combine_threshold_in_bytes=*/all_gather_threshold,
+        /*combine_threshold_count=*/512, combiner_options);
+    int64_t all_reduce_threshold = pass_context::GetInt(
+        "combiner::all_reduce_threshold",
+        debug_options.xla_gpu_all_reduce_combine_threshold_bytes());
+    combiner_options.combine_threshold_bytes_fn =
+        threshold_fn(all_reduce_threshold);
     pipeline.AddPass<AllReduceCombiner>(
-        /*combine_threshold_in_bytes=*/
-        pass_context::GetInt("combiner::all_reduce_threshold",
-                             debug_options.xla_gpu_all_reduce_combine_threshold_bytes()),
-        /*combine_threshold_count=*/512);
+        /*combine_threshold_in_bytes=*/all_reduce_threshold,
+        /*combine_threshold_count=*/512, combiner_options);
+    int64_t reduce_scatter_threshold = pass_context::GetInt(
+        "combiner::all_reduce_threshold", 30 * 1024 * 1024);
+    combiner_options.combine_threshold_bytes_fn =
+        threshold_fn(reduce_scatter_threshold);
     pipeline.AddPass<ReduceScatterCombiner>(
-        /*combine_threshold_in_bytes=*/
-        pass_context::GetInt("combiner::all_reduce_threshold", 30 * 1024 * 1024),
-        /*combine_threshold_count=*/512);
+        /*combine_threshold_in_bytes=*/reduce_scatter_threshold,
+        /*combine_threshold_count=*/512, combiner_options);
 
     if (true || debug_options.xla_gpu_all_reduce_contiguous()) {
       pipeline.AddPass<AllReduceContiguous>();
@@ -686,6 +876,17 @@ Status GpuCompiler::OptimizeHloModule(
       pipeline.AddPass<AllReduceBlueConnect>(blueconnect_num_devices_per_host);
     }
 
+    // Added by Alpa. The host of every device is the process index of the
+    // PjRt device, which is only known by the runtime.
+    if (pass_context::GetBool("hierarchical_all_reduce::enable", false)) {
+      pipeline.AddPass<AllReduceHierarchical>(
+          pass_context::GetIntVector("hierarchical_all_reduce::host_ids"),
+          pass_context::GetBool("hierarchical_all_reduce::compress_inter_node",
+                                false)
+              ? BF16
+              : PRIMITIVE_TYPE_INVALID);
+    }
+
     if (debug_options.xla_gpu_enable_async_all_reduce()) {
       AsyncCollectiveCreator::CollectiveCreatorConfig config;
       config.convert_all_reduce = [](const HloInstruction*) { return true; };
@@ -704,6 +905,31 @@ Status GpuCompiler::OptimizeHloModule(
     TF_RETURN_IF_ERROR(pipeline.Run(hlo_module).status());
   }
 
+  // Added by Alpa. Offload idle values to host memory and trade compute for
+  // memory on partitioned modules over the per-device memory budget.
+  HloCostAnalysis::Options cost_options{ShapeSizeBytesFunction()};
+  cost_options.set_flops_per_second(
+      pass_context::GetDouble("auto_sharding::device_peak_flops", 1.25e14));
+  cost_options.set_bytes_per_second(pass_context::GetDouble(
+      "auto_sharding::device_memory_bandwidth", 9e11));
+  const int64_t memory_budget_per_device =
+      pass_context::GetInt("auto_sharding::memory_budget_per_device", -1);
+  if (pass_context::GetBool("host_offload::enable", false)) {
+    HloPassPipeline pipeline("host offload");
+    pipeline.AddPass<HostOffload>(
+        memory_budget_per_device, cost_options, pointer_size_,
+        pass_context::GetDouble("host_offload::host_bandwidth", 2.5e10),
+        pass_context::GetInt("host_offload::min_offload_bytes", 1024 * 1024),
+        pass_context::GetDouble("host_offload::min_overlap_ratio", 1.0));
+    TF_RETURN_IF_ERROR(pipeline.Run(hlo_module).status());
+  }
+  if (pass_context::GetBool("rematerialization::enable", false)) {
+    HloPassPipeline pipeline("rematerialization");
+    pipeline.AddPass<GpuRematerialization>(memory_budget_per_device,
+                                           cost_options, pointer_size_);
+    TF_RETURN_IF_ERROR(pipeline.Run(hlo_module).status());
+  }
+
   if (pass_context::GetBool("done-event::enable", false)) {
     HloPassPipeline pipeline("done event insertion");
     pipeline.AddPass<HloDoneInsertion>();
@@ -863,9 +1089,31 @@ StatusOr<std::unique_ptr<HloModule>> GpuCompiler::RunHloPasses(
   tsl::profiler::TraceMe activity(
       [&] { return absl::StrCat("HLO Transforms:", module->name()); },
       tsl::profiler::TraceMeLevel::kInfo);
+
+  // Added by Alpa
+  // Reuse the autotuning results of other workers. A missing file is not an
+  // error, since the first worker creates it.
+  const DebugOptions& debug_options = module->config().debug_options();
+  if (!debug_options.xla_gpu_load_autotune_results_from().empty()) {
+    Status status = LoadAutotuneResultsFromFile(
+        debug_options.xla_gpu_load_autotune_results_from());
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to load the autotuning results: " << status;
+    }
+  }
+
   TF_RETURN_IF_ERROR(
       OptimizeHloModule(module.get(), stream_exec, options.device_allocator));
 
+  // Added by Alpa
+  if (!debug_options.xla_gpu_dump_autotune_results_to().empty()) {
+    Status status = DumpAutotuneResultsToFile(
+        debug_options.xla_gpu_dump_autotune_results_to());
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to dump the autotuning results: " << status;
+    }
+  }
+
   TF_RETURN_IF_ERROR(PrepareHloModuleForIrEmitting(module.get()));
 
   uint64_t end_usecs = tsl::Env::Default()->NowMicros();
@@ -886,7 +1134,7 @@ static std::optional<bool> DummyCanShareBufferFunction(const HloInstruction*,
 StatusOr<std::unique_ptr<BufferAssignment>> GpuCompiler::AssignBuffers(
     const HloModule* hlo_module) {
   TF_ASSIGN_OR_RETURN(HloSchedule hlo_schedule,
-                      ScheduleGpuModule(hlo_module, pointer_size_));
+                      ScheduleGpuModuleWithOptions(hlo_module, pointer_size_));
 
   auto buffer_size_bytes_function =
       [this](const BufferValue& buffer_value) -> int64_t {
@@ -997,6 +1245,8 @@ struct CompileModuleResults {
   OutputInfoMap output_info;
   Shape output_shape;
   std::string module_name;
+  // Added by Alpa
+  std::unique_ptr<ThunkStreamAssignment> stream_assignment;
 };
 
 static void ForAllThunks(const std::function<void(Thunk*)>& fn,
@@ -1041,7 +1291,7 @@ static Status CompileModuleToLlvmIrImpl(
   results->llvm_module->setDataLayout(data_layout);
 
   TF_ASSIGN_OR_RETURN(HloSchedule hlo_schedule,
-                      ScheduleGpuModule(hlo_module, pointer_size));
+                      ScheduleGpuModuleWithOptions(hlo_module, pointer_size));
 
   auto buffer_size_bytes_function =
       [pointer_size](const BufferValue& buffer_value) -> int64_t {
@@ -1145,6 +1395,19 @@ static Status CompileModuleToLlvmIrImpl(
   }
 
   auto thunk_sequence = ir_emitter->ConsumeThunkSequence();
+  // Added by Alpa
+  // The buffers of the thunks are only known before the compile time info is
+  // cleared.
+  int64_t num_streams =
+      pass_context::GetInt("stream_assignment::num_streams", 1);
+  if (num_streams > 1) {
+    results->stream_assignment = std::make_unique<ThunkStreamAssignment>(
+        GetThunkBufferUses(*thunk_sequence, results->allocations),
+        num_streams);
+    VLOG(1) << "Run " << hlo_module->name() << " on "
+            << results->stream_assignment->num_streams() << " streams with "
+            << results->stream_assignment->num_waits() << " waits";
+  }
   ForAllThunks([](Thunk* thunk) { thunk->ClearCompileTimeInfo(); },
                thunk_sequence.get());
   results->executable = std::move(thunk_sequence);
@@ -1256,6 +1519,21 @@ GpuCompiler::CompileToTargetBinary(const HloModuleConfig& module_config,
       module_config.debug_options().xla_gpu_force_compilation_parallelism()) {
     case 0:
       thread_pool = options.thread_pool;
+      // Added by Alpa
+      // Without a thread pool from the client, let the pass context choose
+      // the parallelism, -1 meaning all cores.
+      if (!thread_pool) {
+        int64_t parallelism =
+            pass_context::GetInt("gpu_compiler::compilation_parallelism", 0);
+        if (parallelism < 0) {
+          parallelism = tsl::port::MaxParallelism();
+        }
+        if (parallelism > 1) {
+          overriding_thread_pool.emplace(tsl::Env::Default(), "",
+                                         parallelism);
+          thread_pool = &*overriding_thread_pool;
+        }
+      }
       break;
     case 1:
       thread_pool = nullptr;
@@ -1312,10 +1590,17 @@ GpuCompiler::CompileToTargetBinary(const HloModuleConfig& module_config,
     }
   }
 
+  // Added by Alpa
+  // Split the module into several shards per thread, so that a few large
+  // kernels do not leave the other threads idle.
+  const int shards_per_thread =
+      pass_context::GetInt("gpu_compiler::shards_per_thread", 4);
   llvm::SplitModule(
       *llvm_module,
       std::max<unsigned>(
-          1, std::min<unsigned>(thread_pool->NumThreads(), num_functions)),
+          1, std::min<unsigned>(thread_pool->NumThreads() *
+                                    std::max(shards_per_thread, 1),
+                                num_functions)),
       [&](std::unique_ptr<llvm::Module> module) {
         // Change the linkage type of some global constant variables to internal
         for (llvm::GlobalVariable& gv : module->globals()) {
@@ -1331,8 +1616,20 @@ GpuCompiler::CompileToTargetBinary(const HloModuleConfig& module_config,
 
   std::vector<StatusOr<BackendCompileResult>> compile_results(
       llvm_modules.size());
-  tsl::BlockingCounter counter(llvm_modules.size());
+  // Added by Alpa
+  // Schedule the largest shards first. The results are still linked in the
+  // order of the shards, so the output does not depend on the schedule.
+  std::vector<int> schedule(llvm_modules.size());
+  std::vector<unsigned> instruction_counts(llvm_modules.size());
   for (int i = 0; i < llvm_modules.size(); i++) {
+    schedule[i] = i;
+    instruction_counts[i] = llvm_modules[i]->getInstructionCount();
+  }
+  absl::c_stable_sort(schedule, [&](int a, int b) {
+    return instruction_counts[a] > instruction_counts[b];
+  });
+  tsl::BlockingCounter counter(llvm_modules.size());
+  for (int i : schedule) {
     thread_pool->Schedule(
         [&compile_results, compile_single_module, i, &llvm_modules, &counter] {
           llvm::Module* original_module = llvm_modules[i].get();
@@ -1445,11 +1742,50 @@ StatusOr<std::unique_ptr<Executable>> GpuCompiler::RunBackend(
                            /*optimized=*/false);
 
   using BackendCompileResult = std::pair<std::string, std::vector<uint8_t>>;
-  TF_ASSIGN_OR_RETURN(
-      BackendCompileResult backend_result,
-      CompileToTargetBinary(module->config(),
-                            std::move(compile_module_results.llvm_module),
-                            stream_exec, options, module.get()));
+  // Added by Alpa. Reuse the target binary compiled by another process.
+  std::string binary_cache_dir =
+      pass_context::GetString("gpu_compiler::binary_cache_dir", "");
+  std::string binary_cache_key;
+  std::optional<BackendCompileResult> cached_backend_result;
+  if (!binary_cache_dir.empty()) {
+    se::RocmComputeCapability rocm_compute_capability =
+        stream_exec->GetDeviceDescription().rocm_compute_capability();
+    binary_cache_key = GpuBinaryCache::ComputeKey(
+        *module, *compile_module_results.buffer_assignment,
+        absl::StrCat(stream_exec->platform()->Name(), ";",
+                     stream_exec->GetDeviceDescription()
+                         .cuda_compute_capability()
+                         .ToString(),
+                     ";", rocm_compute_capability.gcn_arch_name()));
+    cached_backend_result =
+        GpuBinaryCache(binary_cache_dir).Lookup(binary_cache_key);
+  }
+
+  BackendCompileResult backend_result;
+  if (cached_backend_result.has_value()) {
+    backend_result = std::move(*cached_backend_result);
+  } else {
+    // Added by Alpa. Report the LLVM backend as a pass of the compilation.
+    CompilationStats* compilation_stats = ScopedCompilationStats::Current();
+    if (compilation_stats != nullptr) {
+      compilation_stats->StartPass("llvm-backend");
+    }
+    StatusOr<BackendCompileResult> compile_result =
+        CompileToTargetBinary(module->config(),
+                              std::move(compile_module_results.llvm_module),
+                              stream_exec, options, module.get());
+    if (compilation_stats != nullptr) {
+      compilation_stats->EndPass("llvm-backend", /*module_changed=*/false);
+    }
+    TF_ASSIGN_OR_RETURN(backend_result, std::move(compile_result));
+    if (!binary_cache_key.empty()) {
+      Status status = GpuBinaryCache(binary_cache_dir)
+                          .Insert(binary_cache_key, backend_result);
+      if (!status.ok()) {
+        LOG(WARNING) << "Failed to write the GPU binary cache: " << status;
+      }
+    }
+  }
   if (DumpingEnabledForHloModule(*module) &&
       std::holds_alternative<OwnedThunkSequence>(
           compile_module_results.executable)) {
@@ -1457,6 +1793,12 @@ StatusOr<std::unique_ptr<Executable>> GpuCompiler::RunBackend(
         *std::get<OwnedThunkSequence>(compile_module_results.executable);
     DumpToFileInDirOrStdout(*module, "", "thunk_sequence",
                             thunk_sequence.ToString());
+    // Added by Alpa
+    if (compile_module_results.stream_assignment != nullptr) {
+      DumpToFileInDirOrStdout(
+          *module, "", "thunk_stream_assignment",
+          compile_module_results.stream_assignment->ToString());
+    }
   }
 
   auto buffer_assignment_proto = std::make_unique<BufferAssignmentProto>(
@@ -1480,7 +1822,15 @@ StatusOr<std::unique_ptr<Executable>> GpuCompiler::RunBackend(
            std::move(compile_module_results.allocations),
            std::move(buffer_assignment_proto),
            [buffer_assignment] { return buffer_assignment->ToVerboseString(); },
-           std::move(module)}));
+           std::move(module),
+           /*enable_cuda_graphs=*/
+           pass_context::GetBool("cuda_graph::enable", false),
+           std::move(compile_module_results.stream_assignment),
+           /*reuse_temp_buffers=*/
+           pass_context::GetBool("gpu_executable::reuse_temp_buffers",
+                                 false),
+           /*reuse_nccl_comms=*/
+           pass_context::GetBool("gpu_executable::reuse_nccl_comms", false)}));
   if (embed_ir_in_executable) {
     DCHECK_NE("", ir_module_string_before_opt);
     gpu_executable->set_ir_module_string(ir_module_string_before_opt);
@@ -44,6 +44,11 @@ inline constexpr int64_t kXlaAllocatedBufferAlignBytes = 128;
 inline constexpr int64_t kConstantBufferAlignBytes =
     kXlaAllocatedBufferAlignBytes;
 
+// Added by Alpa. The memory space (and buffer color) of values offloaded to
+// pinned host memory by HostOffload. Their temp buffer is allocated with
+// cuMemHostAlloc and accessed by kernels through unified addressing.
+inline constexpr int64_t kHostMemorySpaceColor = 1;
+
 }  // namespace gpu
 }  // namespace xla
 
@@ -25,6 +25,7 @@ limitations under the License.
 #include "absl/strings/str_format.h"
 #include "absl/time/time.h"
 #include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/service/gpu/autotune_results_store.h"
 #include "tensorflow/compiler/xla/service/gpu/backend_configs.pb.h"
 #include "tensorflow/compiler/xla/service/gpu/convolution_thunk.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_asm_opts_util.h"
@@ -306,8 +307,12 @@ StatusOr<bool> CheckRedzones(const se::RedzoneAllocator& allocator,
 }
 #endif
 
+// Added by Alpa
+// The device key and the canonical string of the conv in the
+// AutotuneResultsStore, which shares the results among the devices of the
+// same kind and across processes.
 using ConvCacheKey =
-    std::tuple<se::StreamExecutor*,
+    std::tuple</* AutotuneResultsStore::DeviceKey(se) */ std::string,
                /* conv->ToString(HloPrintOptions::Canonical()) */ std::string>;
 
 struct ConvCacheStats {
@@ -324,12 +329,11 @@ ConvCacheKey AutotuneCacheKeyfromInstruction(
     const HloCustomCallInstruction* conv, se::StreamExecutor* se) {
   auto options = HloPrintOptions::Canonical();
   options.set_print_backend_config(true);
-  return std::make_tuple(se, conv->ToString(options));
+  return std::make_tuple(AutotuneResultsStore::DeviceKey(se),
+                         conv->ToString(options));
 }
 
 absl::Mutex autotune_cache_lock(absl::kConstInit);
-auto& autotune_cache ABSL_GUARDED_BY(autotune_cache_lock) =
-    *new absl::flat_hash_map<ConvCacheKey, AutotuneResult>();
 auto& autotune_cache_stats ABSL_GUARDED_BY(autotune_cache_lock) =
     *new ConvCacheStats();
 }  // anonymous namespace
@@ -353,11 +357,12 @@ StatusOr<AutotuneResult> GpuConvAlgorithmPicker::PickBestAlgorithm(
   // models).
   ConvCacheKey key = AutotuneCacheKeyfromInstruction(instr, stream_exec_);
   {
+    std::optional<AutotuneResult> cached = AutotuneResultsStore::Get().Lookup(
+        AutotuneResultsStore::Kind::kConv, std::get<0>(key), std::get<1>(key));
     absl::MutexLock lock(&autotune_cache_lock);
-    auto it = autotune_cache.find(key);
-    if (it != autotune_cache.end()) {
+    if (cached.has_value()) {
       autotune_cache_stats.cache_hits++;
-      return it->second;
+      return *std::move(cached);
     }
     autotune_cache_stats.cache_misses++;
   }
@@ -396,8 +401,9 @@ StatusOr<AutotuneResult> GpuConvAlgorithmPicker::PickBestAlgorithm(
   }
 
   if (result_or.ok()) {
-    absl::MutexLock lock(&autotune_cache_lock);
-    CHECK(autotune_cache.insert({key, result_or.value()}).second);
+    AutotuneResultsStore::Get().Insert(AutotuneResultsStore::Kind::kConv,
+                                       std::get<0>(key), std::get<1>(key),
+                                       result_or.value());
   }
   return result_or;
 }
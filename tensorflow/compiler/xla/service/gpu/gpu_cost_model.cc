@@ -1,245 +1,50 @@
 #include "tensorflow/compiler/xla/service/gpu/gpu_cost_model.h"
 
-#include "tensorflow/compiler/xla/primitive_util.h"
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+
 #include "tensorflow/compiler/xla/service/gpu/backend_configs.pb.h"
 #include "tensorflow/compiler/xla/service/gpu/cublas_cudnn.h"
 #include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
 #include "tensorflow/compiler/xla/service/hlo_instructions.h"
 #include "tensorflow/compiler/xla/service/pass_context.h"
 #include "tensorflow/compiler/xla/service/spmd/auto_sharding_util.h"
+#include "tensorflow/compiler/xla/service/spmd/collective_cost_model.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/util.h"
 
 namespace xla {
 namespace gpu {
 
-namespace py = pybind11;
-
-std::string ToString(const PrimitiveType& type) {
-  return primitive_util::LowercasePrimitiveTypeName(type);
-}
-
-// Make a string key of a replica_groups.
-std::string Group2Str(py::object tuple) {
-  if (tuple.is_none()) {
-    return "()";
-  }
-
-  py::tuple replica_groups = py::cast<py::tuple>(tuple);
-  std::ostringstream os;
-  os << "(";
+// Convert replica groups to the form used by the cost model.
+std::vector<std::vector<int>> ToGroups(
+    const std::vector<ReplicaGroup>& replica_groups) {
+  std::vector<std::vector<int>> ret;
   for (const auto& group : replica_groups) {
-    os << "(";
-    for (const auto& id : py::cast<py::tuple>(group)) {
-      os << py::cast<int64_t>(id) << ",";
-    }
-    os << "),";
+    ret.push_back(std::vector<int>(group.replica_ids().begin(),
+                                   group.replica_ids().end()));
   }
-  os << ")";
-
-  return os.str();
+  return ret;
 }
 
-// Make a string key of a replica_groups.
-std::string Group2Str(const std::vector<std::vector<int>>& replica_groups) {
-  std::ostringstream os;
-
-  os << "(";
-  for (const auto& group : replica_groups) {
-    os << "(";
-    for (const auto& id : group) {
-      os << id << ",";
-    }
-    os << "),";
+// Return the estimated cost, or `size` if the operation is not profiled.
+double CostOrSize(std::optional<double> cost, double size,
+                  const HloInstruction* ins) {
+  if (!cost.has_value()) {
+    LOG(WARNING) << "Warning: cannot find the profiling result of "
+                 << ins->ToString();
+    return size;
   }
-  os << ")";
-
-  return os.str();
+  return *cost;
 }
 
-// Make a string key of a replica_groups.
-std::string Group2Str(const std::vector<ReplicaGroup>& replica_groups) {
-  std::ostringstream os;
-
-  os << "(";
-  for (const auto& group : replica_groups) {
-    os << "(";
-    for (const auto& id : group.replica_ids()) {
-      os << id << ",";
-    }
-    os << "),";
-  }
-  os << ")";
-
-  return os.str();
-}
-
-// Store the profiling results of communication and computation.
-class ProfilingResult {
- public:
-  // Construct the class from the corresponding python object
-  // alpa/mesh_profiling.py::ProfilingResult.
-  ProfilingResult(py::object prof_result) {
-    if (!prof_result.is_none()) {
-      PyGILState_STATE gstate = PyGILState_Ensure();
-      {
-        CommDictPyToCpp(
-            py::cast<py::dict>(prof_result.attr("all_gather_cost_dict")),
-            all_gather_cost_dict_);
-        CommDictPyToCpp(
-            py::cast<py::dict>(prof_result.attr("all_reduce_cost_dict")),
-            all_reduce_cost_dict_);
-        CommDictPyToCpp(
-            py::cast<py::dict>(prof_result.attr("all_to_all_cost_dict")),
-            all_to_all_cost_dict_);
-        CommDictPyToCpp(
-            py::cast<py::dict>(prof_result.attr("reduce_scatter_cost_dict")),
-            reduce_scatter_cost_dict_);
-        CommDictPyToCpp(py::cast<py::dict>(prof_result.attr("dot_cost_dict")),
-                        dot_cost_dict_);
-      }
-      PyGILState_Release(gstate);
-    }
-  }
-
-  bool Enabled() const { return enabled_; }
-
-  double EstimateAllGatherCost(const std::vector<ReplicaGroup>& replica_groups,
-                               int64_t size, PrimitiveType dtype) const {
-    return EstimateInternal(replica_groups, size, dtype,
-                            all_gather_cost_dict_) -
-           EstimateInternal(replica_groups, 0, dtype, all_gather_cost_dict_);
-  }
-
-  double EstimateAllReduceCost(const std::vector<ReplicaGroup>& replica_groups,
-                               int64_t size, PrimitiveType dtype) const {
-    return EstimateInternal(replica_groups, size, dtype,
-                            all_reduce_cost_dict_) -
-           EstimateInternal(replica_groups, 0, dtype, all_reduce_cost_dict_);
-  }
-
-  double EstimateAllToAllCost(const std::vector<ReplicaGroup>& replica_groups,
-                              int64_t size, PrimitiveType dtype) const {
-    return EstimateInternal(replica_groups, size, dtype,
-                            all_to_all_cost_dict_) -
-           EstimateInternal(replica_groups, 0, dtype, all_to_all_cost_dict_);
-  }
-
-  double EstimateReduceScatterCost(
-      const std::vector<ReplicaGroup>& replica_groups, int64_t size,
-      PrimitiveType dtype) const {
-    return EstimateInternal(replica_groups, size, dtype,
-                            reduce_scatter_cost_dict_) -
-           EstimateInternal(replica_groups, 0, dtype,
-                            reduce_scatter_cost_dict_);
-  }
-
-  double EstimateDotCost(int64_t flop_count, PrimitiveType dtype) {
-    std::vector<ReplicaGroup> fake_replica_groups;
-    return EstimateInternal(fake_replica_groups, flop_count, dtype,
-                            dot_cost_dict_) -
-           EstimateInternal(fake_replica_groups, 0, dtype, dot_cost_dict_);
-  }
-
-  std::string ToString() {
-    std::ostringstream os;
-    os << "all-reduce cost dict:\n";
-    for (const auto& item : all_reduce_cost_dict_) {
-      os << "key: (" << item.first.first << ", "
-         << gpu::ToString(item.first.second) << ")\n";
-    }
-    os << "dot cost dict:\n";
-    for (const auto& item : dot_cost_dict_) {
-      os << "key: (" << item.first.first << ", "
-         << gpu::ToString(item.first.second) << ")\n";
-    }
-    return os.str();
-  }
-
- private:
-  // Dictionary type for communicaiton cost.
-  // Dict[Tuple(group, dtype) -> List[Tuple(size, time)]]
-  // pair<group, dtype>
-  using CommDictKey = std::pair<std::string, PrimitiveType>;
-  // vector<pair<size, time>>
-  using CommDictValue = std::vector<std::pair<int64_t, double>>;
-  using CommDict = absl::flat_hash_map<CommDictKey, CommDictValue>;
-
-  // Estimate the cost by linear interpolation bewteen the two closest points.
-  double EstimateInternal(const std::vector<ReplicaGroup>& replica_groups,
-                          int64_t size, PrimitiveType dtype,
-                          const CommDict& cost_dict) const {
-    if (dtype != PrimitiveType::F16 && dtype != PrimitiveType::F32) {
-      // Cast other types to F32.
-      dtype = PrimitiveType::F32;
-    }
-
-    CommDictKey key(Group2Str(replica_groups), dtype);
-    if (!cost_dict.count(key)) {
-      LOG(WARNING) << "Warning: cannot find key: (" << key.first << ", "
-                   << gpu::ToString(key.second) << ")" << std::endl;
-      return size;
-    }
-    CommDictValue cost_list = cost_dict.at(key);
-
-    CHECK(!cost_list.empty());
-
-    size_t i;
-    if (size > cost_list.back().first) {
-      i = cost_list.size() - 2;
-    } else if (size < cost_list.front().first) {
-      i = 0;
-    } else {
-      for (i = 0; i < cost_list.size() - 1; ++i) {
-        if (cost_list[i].first <= size && size <= cost_list[i + 1].first) {
-          break;
-        }
-      }
-    }
-
-    int64_t left_size = cost_list[i].first;
-    double left_cost = cost_list[i].second;
-    int64_t right_size = cost_list[i + 1].first;
-    double right_cost = cost_list[i + 1].second;
-
-    return 1.0 * (size - left_size) / (right_size - left_size) *
-               (right_cost - left_cost) +
-           left_cost;
-  }
-
-  // Convert a python communication cost dict to c++ dict.
-  void CommDictPyToCpp(py::dict py_dict, CommDict& cpp_dict) {
-    // the type of py_dict: Dict[Tuple(group, dtype) -> List[Tuple(size, time)]]
-    for (auto item : py_dict) {
-      py::tuple tuple_key = py::cast<py::tuple>(item.first);
-      std::string dtype_str = py::cast<std::string>(tuple_key[1]);
-      PrimitiveType dtype;
-
-      if (dtype_str == "f16") {
-        dtype = PrimitiveType::F16;
-      } else if (dtype_str == "f32") {
-        dtype = PrimitiveType::F32;
-      } else {
-        LOG(FATAL) << "Invalid dtype: " << dtype_str;
-      }
-
-      CommDictKey key(Group2Str(tuple_key[0]), dtype);
-
-      py::list list_val = py::cast<py::list>(item.second);
-      for (const auto x : list_val) {
-        py::tuple tuple_val = py::cast<py::tuple>(x);
-        cpp_dict[key].push_back(std::make_pair(py::cast<int64_t>(tuple_val[0]),
-                                               py::cast<double>(tuple_val[1])));
-      }
-    }
-  }
-
-  bool enabled_;
-  CommDict all_reduce_cost_dict_;
-  CommDict all_gather_cost_dict_;
-  CommDict reduce_scatter_cost_dict_;
-  CommDict all_to_all_cost_dict_;
-  CommDict dot_cost_dict_;  // Reuse CommDict data structure for dot.
-};
-
 // Expand the special replica_groups {{0}} to {{0,1,2,..,n}}
 const std::vector<ReplicaGroup> ExpandSpecialReplicaGroups(
     const std::vector<ReplicaGroup>& replica_groups, int64_t num_devices) {
@@ -255,10 +60,61 @@ const std::vector<ReplicaGroup> ExpandSpecialReplicaGroups(
   }
 }
 
+// Whether the op runs a kernel whose time is bounded by its memory traffic or
+// its flops. This excludes the ops that only alias or name buffers, the
+// collectives and the library calls.
+bool IsMemoryBoundOp(const HloInstruction* ins) {
+  switch (ins->opcode()) {
+    case HloOpcode::kParameter:
+    case HloOpcode::kConstant:
+    case HloOpcode::kTuple:
+    case HloOpcode::kGetTupleElement:
+    case HloOpcode::kBitcast:
+    case HloOpcode::kCustomCall:
+    case HloOpcode::kAfterAll:
+    case HloOpcode::kOptimizationBarrier:
+    case HloOpcode::kAllGather:
+    case HloOpcode::kAllGatherStart:
+    case HloOpcode::kAllGatherDone:
+    case HloOpcode::kAllReduce:
+    case HloOpcode::kAllReduceStart:
+    case HloOpcode::kAllReduceDone:
+    case HloOpcode::kAllToAll:
+    case HloOpcode::kReduceScatter:
+    case HloOpcode::kCollectivePermute:
+    case HloOpcode::kCollectivePermuteStart:
+    case HloOpcode::kCollectivePermuteDone:
+    case HloOpcode::kSend:
+    case HloOpcode::kSendDone:
+    case HloOpcode::kRecv:
+    case HloOpcode::kRecvDone:
+      return false;
+    default:
+      return !ins->IsAsynchronous();
+  }
+}
+
+spmd::CollectiveCostModel LoadCollectiveCostModel() {
+  // A profile file does not need python.
+  std::string prof_file =
+      pass_context::GetString("gpu_cost_model::profiling_file", "");
+  if (!prof_file.empty()) {
+    StatusOr<spmd::CollectiveCostModel> loaded =
+        spmd::CollectiveCostModel::LoadFromFile(prof_file);
+    CHECK(loaded.ok()) << loaded.status();
+    return std::move(loaded).value();
+  }
+  return spmd::CollectiveCostModel::FromPyObject(
+      pass_context::GetPyObject("gpu_cost_model::profiling_results"));
+}
+
 double EstimateHloModuleCost(const HloModule* hlo_module) {
   // Load profiling results.
-  ProfilingResult prof_result(
-      pass_context::GetPyObject("gpu_cost_model::profiling_results"));
+  return EstimateHloModuleCost(hlo_module, LoadCollectiveCostModel());
+}
+
+double EstimateHloModuleCost(const HloModule* hlo_module,
+                             const spmd::CollectiveCostModel& prof_result) {
   const int64_t num_devices = hlo_module->config().num_partitions();
   int verbose = pass_context::GetInt("gpu_cost_model::verbose", 0);
   int num_micro_batches =
@@ -266,9 +122,35 @@ double EstimateHloModuleCost(const HloModule* hlo_module) {
   std::string grad_sync_channel_ids =
       pass_context::GetString("gpu_cost_model::grad_sync_channel_ids", "");
 
+  // Fusions, convolutions and other non-GEMM ops are charged by their flops at
+  // the peak throughput and their bytes at the memory bandwidth, whichever
+  // takes longer. The scales calibrate these estimates against profiled runs.
+  bool count_non_gemm_ops =
+      pass_context::GetBool("gpu_cost_model::count_non_gemm_ops", true);
+  double peak_flops =
+      pass_context::GetDouble("auto_sharding::device_peak_flops", 1.25e14);
+  double memory_bandwidth =
+      pass_context::GetDouble("auto_sharding::device_memory_bandwidth", 9e11);
+  double memory_bound_scale =
+      pass_context::GetDouble("gpu_cost_model::memory_bound_scale", 1.0);
+  double conv_scale = pass_context::GetDouble("gpu_cost_model::conv_scale", 1.0);
+
+  const HloComputation* entry_computation = hlo_module->entry_computation();
+  HloCostAnalysis::Options cost_options{[](const Shape& shape) {
+    return ShapeUtil::ByteSizeOf(shape, sizeof(void*));
+  }};
+  GpuHloCostAnalysis cost_analysis(cost_options);
+  if (count_non_gemm_ops) {
+    Status status = entry_computation->Accept(&cost_analysis);
+    if (!status.ok()) {
+      LOG(WARNING) << "Warning: cannot analyze the cost of non-GEMM ops: "
+                   << status;
+      count_non_gemm_ops = false;
+    }
+  }
+
   // Compute cost of all instruction.
   double sum = 0.0;
-  const HloComputation* entry_computation = hlo_module->entry_computation();
   for (const HloInstruction* ins : entry_computation->instructions()) {
     double cost = 0.0;
 
@@ -279,16 +161,18 @@ double EstimateHloModuleCost(const HloModule* hlo_module) {
       auto coll = DynCast<HloCollectiveInstruction>(ins);
       CHECK(coll != nullptr);
 
-      std::vector<ReplicaGroup> replica_groups = coll->replica_groups();
       // Expand the special replica_groups {{0}}
-      replica_groups = ExpandSpecialReplicaGroups(replica_groups, num_devices);
+      std::vector<std::vector<int>> replica_groups = ToGroups(
+          ExpandSpecialReplicaGroups(coll->replica_groups(), num_devices));
 
       for (const auto operand : ins->operands()) {
         int64_t size = spmd::GetBytes(operand->shape());
         switch (ins->opcode()) {
           case HloOpcode::kAllGather:
-            cost += prof_result.EstimateAllGatherCost(
-                replica_groups, size, operand->shape().element_type());
+            cost += CostOrSize(
+                prof_result.EstimateAllGatherCost(replica_groups, size,
+                                             operand->shape().element_type()),
+                size, ins);
             break;
           case HloOpcode::kAllReduce: {
             double normalizer = 1.0;
@@ -299,18 +183,24 @@ double EstimateHloModuleCost(const HloModule* hlo_module) {
               normalizer = num_micro_batches;
             }
 
-            cost += prof_result.EstimateAllReduceCost(
-                        replica_groups, size, operand->shape().element_type()) /
+            cost += CostOrSize(prof_result.EstimateAllReduceCost(
+                                   replica_groups, size,
+                                   operand->shape().element_type()),
+                               size, ins) /
                     normalizer;
             break;
           }
           case HloOpcode::kAllToAll:
-            cost += prof_result.EstimateAllToAllCost(
-                replica_groups, size, operand->shape().element_type());
+            cost += CostOrSize(
+                prof_result.EstimateAllToAllCost(replica_groups, size,
+                                             operand->shape().element_type()),
+                size, ins);
             break;
           case HloOpcode::kReduceScatter:
-            cost += prof_result.EstimateReduceScatterCost(
-                replica_groups, size, operand->shape().element_type());
+            cost += CostOrSize(
+                prof_result.EstimateReduceScatterCost(replica_groups, size,
+                                             operand->shape().element_type()),
+                size, ins);
             break;
           default:
             break;
@@ -336,8 +226,27 @@ double EstimateHloModuleCost(const HloModule* hlo_module) {
       }
       flop_count *= 2;
 
-      cost +=
-          prof_result.EstimateDotCost(flop_count, ins->shape().element_type());
+      cost += CostOrSize(prof_result.EstimateDotCost(
+                             flop_count, ins->shape().element_type()),
+                         flop_count, ins);
+    }
+
+    if (count_non_gemm_ops) {
+      double flop_count = cost_analysis.flop_count(*ins);
+      if (IsCustomCallToDnnConvolution(*ins)) {
+        // A cuDNN convolution returns (output, scratch).
+        const Shape& output_shape = ins->shape().IsTuple()
+                                        ? ins->shape().tuple_shapes(0)
+                                        : ins->shape();
+        std::optional<double> conv_cost = prof_result.EstimateDotCost(
+            flop_count, output_shape.element_type());
+        cost = (conv_cost.has_value() ? *conv_cost : flop_count / peak_flops) *
+               conv_scale;
+      } else if (IsMemoryBoundOp(ins)) {
+        cost = std::max(flop_count / peak_flops,
+                        cost_analysis.bytes_accessed(*ins) / memory_bandwidth) *
+               memory_bound_scale;
+      }
     }
 
     if (cost > 0) {
@@ -351,5 +260,371 @@ double EstimateHloModuleCost(const HloModule* hlo_module) {
   return sum;
 }
 
+namespace {
+
+// The devices of a mesh that hold the same tile of a sharded tensor, and the
+// bounds [offset, limit) of that tile.
+struct TileReplicas {
+  std::vector<int64_t> offset;
+  std::vector<int64_t> limit;
+  std::vector<int64_t> devices;
+};
+
+std::vector<TileReplicas> GroupDevicesByTile(const Shape& shape,
+                                             const HloSharding& sharding,
+                                             int64_t num_devices) {
+  std::vector<int64_t> devices;
+  bool whole_tensor = sharding.IsTileMaximal() || sharding.IsManual();
+  if (sharding.IsReplicated() || sharding.IsManual()) {
+    devices.resize(num_devices);
+    std::iota(devices.begin(), devices.end(), 0);
+  } else if (sharding.IsTileMaximal()) {
+    devices.push_back(sharding.GetUniqueDevice());
+  } else {
+    sharding.tile_assignment().Each(
+        [&](absl::Span<const int64_t> index, int64_t device) {
+          devices.push_back(device);
+        });
+  }
+
+  std::vector<TileReplicas> groups;
+  absl::flat_hash_map<std::vector<int64_t>, size_t> group_index;
+  for (int64_t device : devices) {
+    std::vector<int64_t> offset =
+        whole_tensor ? std::vector<int64_t>(shape.rank(), 0)
+                     : sharding.TileOffsetForDevice(shape, device);
+    auto [iter, inserted] = group_index.try_emplace(offset, groups.size());
+    if (inserted) {
+      std::vector<int64_t> limit =
+          whole_tensor ? std::vector<int64_t>(shape.dimensions().begin(),
+                                              shape.dimensions().end())
+                       : sharding.TileLimitForDevice(shape, device);
+      groups.push_back({std::move(offset), std::move(limit), {}});
+    }
+    groups[iter->second].devices.push_back(device);
+  }
+  return groups;
+}
+
+// Estimate the time to send `bytes` from one device to `num_receivers`
+// devices of another mesh. Without a profiled broadcast, the sender sends to
+// the receivers one after another.
+double EstimateTransferTime(int64_t bytes, int64_t num_receivers,
+                            PrimitiveType dtype,
+                            const spmd::CollectiveCostModel& prof_result) {
+  std::optional<double> cost;
+  if (num_receivers > 1) {
+    std::vector<std::vector<int>> group(1, std::vector<int>(num_receivers + 1));
+    std::iota(group[0].begin(), group[0].end(), 0);
+    cost = prof_result.Estimate(spmd::ProfiledOpKind::kBroadcast, group, bytes,
+                                dtype);
+  }
+  if (!cost.has_value()) {
+    cost = prof_result.Estimate(spmd::ProfiledOpKind::kSendRecv, {{0, 1}},
+                                bytes, dtype);
+    if (cost.has_value()) {
+      *cost *= num_receivers;
+    }
+  }
+  if (!cost.has_value()) {
+    LOG_FIRST_N(WARNING, 1)
+        << "Warning: cannot find the profiling result of cross-mesh send/recv "
+        << "for " << PrimitiveType_Name(dtype);
+    return bytes;
+  }
+  return *cost;
+}
+
+// Plan the transfers of resharding one tensor, and add their time to the
+// devices sending and receiving them.
+void PlanTensorResharding(const Shape& shape, const HloSharding& src_sharding,
+                          int64_t src_num_devices,
+                          const HloSharding& dst_sharding,
+                          int64_t dst_num_devices,
+                          const spmd::CollectiveCostModel& prof_result,
+                          absl::flat_hash_map<int64_t, double>* src_loads,
+                          absl::flat_hash_map<int64_t, double>* dst_loads,
+                          std::vector<ReshardingTransfer>* transfers) {
+  if (!shape.IsArray()) {
+    return;
+  }
+  std::vector<TileReplicas> src_tiles =
+      GroupDevicesByTile(shape, src_sharding, src_num_devices);
+  std::vector<TileReplicas> dst_tiles =
+      GroupDevicesByTile(shape, dst_sharding, dst_num_devices);
+  int64_t element_bytes =
+      ShapeUtil::ByteSizeOfPrimitiveType(shape.element_type());
+
+  for (const TileReplicas& dst : dst_tiles) {
+    for (const TileReplicas& src : src_tiles) {
+      std::vector<int64_t> offset(shape.rank()), limit(shape.rank());
+      int64_t num_elements = 1;
+      for (int64_t i = 0; i < shape.rank(); ++i) {
+        offset[i] = std::max(src.offset[i], dst.offset[i]);
+        limit[i] = std::max(offset[i], std::min(src.limit[i], dst.limit[i]));
+        num_elements *= limit[i] - offset[i];
+      }
+      if (num_elements == 0) {
+        continue;
+      }
+      int64_t bytes = num_elements * element_bytes;
+
+      // Split the receivers into k groups, each served by a different replica
+      // of the source tile, with the k that finishes first given the current
+      // loads. Replicas are taken from the least loaded.
+      std::vector<int64_t> senders = src.devices;
+      absl::c_stable_sort(senders, [&](int64_t a, int64_t b) {
+        return (*src_loads)[a] < (*src_loads)[b];
+      });
+      const int64_t num_receivers = dst.devices.size();
+      const int64_t max_groups =
+          std::min<int64_t>(senders.size(), num_receivers);
+      int64_t best_groups = 1;
+      double best_finish = std::numeric_limits<double>::infinity();
+      for (int64_t k = 1; k <= max_groups; ++k) {
+        double finish = 0.0;
+        int64_t begin = 0;
+        for (int64_t g = 0; g < k; ++g) {
+          int64_t end = begin + (num_receivers - begin) / (k - g);
+          double time =
+              EstimateTransferTime(bytes, end - begin, shape.element_type(),
+                                   prof_result);
+          finish = std::max(finish, (*src_loads)[senders[g]] + time);
+          for (int64_t r = begin; r < end; ++r) {
+            finish = std::max(finish, (*dst_loads)[dst.devices[r]] + time);
+          }
+          begin = end;
+        }
+        if (finish < best_finish) {
+          best_finish = finish;
+          best_groups = k;
+        }
+      }
+
+      int64_t begin = 0;
+      for (int64_t g = 0; g < best_groups; ++g) {
+        int64_t end = begin + (num_receivers - begin) / (best_groups - g);
+        ReshardingTransfer transfer;
+        transfer.offset = offset;
+        transfer.limit = limit;
+        transfer.src_device = senders[g];
+        transfer.dst_devices.assign(dst.devices.begin() + begin,
+                                    dst.devices.begin() + end);
+        transfer.seconds =
+            EstimateTransferTime(bytes, end - begin, shape.element_type(),
+                                 prof_result);
+        (*src_loads)[transfer.src_device] += transfer.seconds;
+        for (int64_t receiver : transfer.dst_devices) {
+          (*dst_loads)[receiver] += transfer.seconds;
+        }
+        if (transfers != nullptr) {
+          transfers->push_back(std::move(transfer));
+        }
+        begin = end;
+      }
+    }
+  }
+}
+
+double MaxLoad(const absl::flat_hash_map<int64_t, double>& src_loads,
+               const absl::flat_hash_map<int64_t, double>& dst_loads) {
+  double max_load = 0.0;
+  for (const auto* loads : {&src_loads, &dst_loads}) {
+    for (const auto& [device, load] : *loads) {
+      max_load = std::max(max_load, load);
+    }
+  }
+  return max_load;
+}
+
+}  // namespace
+
+double EstimateReshardingCost(const Shape& shape,
+                              const HloSharding& src_sharding,
+                              int64_t src_num_devices,
+                              const HloSharding& dst_sharding,
+                              int64_t dst_num_devices,
+                              const spmd::CollectiveCostModel& prof_result) {
+  absl::flat_hash_map<int64_t, double> src_loads, dst_loads;
+  PlanTensorResharding(shape, src_sharding, src_num_devices, dst_sharding,
+                       dst_num_devices, prof_result, &src_loads, &dst_loads,
+                       /*transfers=*/nullptr);
+  return MaxLoad(src_loads, dst_loads);
+}
+
+StatusOr<double> EstimateStageBoundaryCost(
+    const HloModule* stage_module,
+    absl::Span<const HloSharding> dst_shardings, int64_t dst_num_devices,
+    const spmd::CollectiveCostModel& prof_result) {
+  const HloInstruction* root =
+      stage_module->entry_computation()->root_instruction();
+  std::vector<ShapeUtil::IndexedShape> leaves =
+      ShapeUtil::GetLeafShapes(root->shape());
+  if (leaves.size() != dst_shardings.size()) {
+    return InvalidArgument(
+        "The stage has %d outputs, but %d destination shardings are given.",
+        leaves.size(), dst_shardings.size());
+  }
+  HloSharding root_sharding =
+      root->has_sharding() ? root->sharding() : HloSharding::Replicate();
+  const int64_t src_num_devices = stage_module->config().num_partitions();
+
+  absl::flat_hash_map<int64_t, double> src_loads, dst_loads;
+  for (size_t i = 0; i < leaves.size(); ++i) {
+    HloSharding src_sharding =
+        root_sharding.IsTuple()
+            ? root_sharding.GetSubSharding(root->shape(), leaves[i].index)
+            : root_sharding;
+    PlanTensorResharding(leaves[i].shape, src_sharding, src_num_devices,
+                         dst_shardings[i], dst_num_devices, prof_result,
+                         &src_loads, &dst_loads, /*transfers=*/nullptr);
+  }
+  return MaxLoad(src_loads, dst_loads);
+}
+
+StatusOr<std::vector<std::vector<ReshardingTransfer>>> PlanResharding(
+    absl::Span<const Shape> shapes, absl::Span<const HloSharding> src_shardings,
+    int64_t src_num_devices, absl::Span<const HloSharding> dst_shardings,
+    int64_t dst_num_devices, const spmd::CollectiveCostModel& prof_result) {
+  if (src_shardings.size() != shapes.size() ||
+      dst_shardings.size() != shapes.size()) {
+    return InvalidArgument(
+        "Got %d tensors, %d source shardings and %d destination shardings.",
+        shapes.size(), src_shardings.size(), dst_shardings.size());
+  }
+  // Plan the largest tensors first, so that the small ones fill in the
+  // devices that are left less loaded.
+  std::vector<size_t> order(shapes.size());
+  std::iota(order.begin(), order.end(), 0);
+  absl::c_stable_sort(order, [&](size_t a, size_t b) {
+    return ShapeUtil::ByteSizeOf(shapes[a]) > ShapeUtil::ByteSizeOf(shapes[b]);
+  });
+
+  absl::flat_hash_map<int64_t, double> src_loads, dst_loads;
+  std::vector<std::vector<ReshardingTransfer>> transfers(shapes.size());
+  for (size_t i : order) {
+    if (!shapes[i].IsArray()) {
+      return InvalidArgument("Cannot reshard a tensor of shape %s.",
+                             shapes[i].ToString());
+    }
+    PlanTensorResharding(shapes[i], src_shardings[i], src_num_devices,
+                         dst_shardings[i], dst_num_devices, prof_result,
+                         &src_loads, &dst_loads, &transfers[i]);
+  }
+  return transfers;
+}
+
+std::optional<int64_t> CombineThresholdFromCostModel(
+    const HloInstruction* collective, int64_t num_devices,
+    const spmd::CollectiveCostModel& prof_result, double scale) {
+  auto coll = DynCast<HloCollectiveInstruction>(collective);
+  if (coll == nullptr) {
+    return std::nullopt;
+  }
+  std::vector<std::vector<int>> replica_groups = ToGroups(
+      ExpandSpecialReplicaGroups(coll->replica_groups(), num_devices));
+  PrimitiveType dtype = collective->operand(0)->shape().element_type();
+
+  std::optional<double> crossover;
+  switch (collective->opcode()) {
+    case HloOpcode::kAllGather:
+      crossover = prof_result.EstimateCrossoverSize(
+          spmd::ProfiledOpKind::kAllGather, replica_groups, dtype);
+      break;
+    case HloOpcode::kReduceScatter:
+      crossover = prof_result.EstimateCrossoverSize(
+          spmd::ProfiledOpKind::kReduceScatter, replica_groups, dtype);
+      break;
+    case HloOpcode::kAllToAll:
+      crossover = prof_result.EstimateCrossoverSize(
+          spmd::ProfiledOpKind::kAllToAll, replica_groups, dtype);
+      break;
+    default:
+      break;
+  }
+  // Use all-reduce to approximate the other collectives, like the cost
+  // estimates do.
+  if (!crossover.has_value()) {
+    crossover = prof_result.EstimateCrossoverSize(
+        spmd::ProfiledOpKind::kAllReduce, replica_groups, dtype);
+  }
+  if (!crossover.has_value()) {
+    return std::nullopt;
+  }
+  // The profiles are keyed by the operand size, but the combiners count the
+  // output size.
+  double output_ratio = 1.0;
+  int64_t operand_bytes = spmd::GetBytes(collective->operand(0)->shape());
+  if (operand_bytes > 0) {
+    output_ratio =
+        static_cast<double>(spmd::GetBytes(collective->shape())) / operand_bytes;
+  }
+  return static_cast<int64_t>(*crossover * scale * output_ratio);
+}
+
+StatusOr<std::unique_ptr<ProfiledLatencyEstimator>>
+ProfiledLatencyEstimator::Create(const HloModule* module,
+                                 const HloCostAnalysis::Options& cost_options,
+                                 spmd::CollectiveCostModel prof_result,
+                                 double fallback_bandwidth) {
+  std::unique_ptr<ProfiledLatencyEstimator> estimator(
+      new ProfiledLatencyEstimator(cost_options, std::move(prof_result),
+                                   fallback_bandwidth,
+                                   module->config().num_partitions()));
+  for (const HloComputation* computation :
+       module->MakeNonfusionComputations()) {
+    TF_RETURN_IF_ERROR(computation->Accept(&estimator->cost_analysis_));
+  }
+  return estimator;
+}
+
+double ProfiledLatencyEstimator::ComputeTime(
+    const HloInstruction& instruction) const {
+  return cost_analysis_.optimal_seconds(instruction);
+}
+
+double ProfiledLatencyEstimator::AsyncLatency(
+    const HloInstruction& start) const {
+  const HloInstruction* op = &start;
+  if (start.opcode() == HloOpcode::kAsyncStart) {
+    op = start.async_wrapped_instruction();
+  }
+
+  double cost = 0.0;
+  for (const HloInstruction* operand : op->operands()) {
+    int64_t size = spmd::GetBytes(operand->shape());
+    std::optional<double> estimated;
+    if (auto coll = DynCast<HloCollectiveInstruction>(op)) {
+      std::vector<std::vector<int>> replica_groups = ToGroups(
+          ExpandSpecialReplicaGroups(coll->replica_groups(), num_devices_));
+      PrimitiveType dtype = operand->shape().element_type();
+      switch (op->opcode()) {
+        case HloOpcode::kAllReduce:
+        case HloOpcode::kAllReduceStart:
+          estimated =
+              prof_result_.EstimateAllReduceCost(replica_groups, size, dtype);
+          break;
+        case HloOpcode::kAllGather:
+        case HloOpcode::kAllGatherStart:
+          estimated =
+              prof_result_.EstimateAllGatherCost(replica_groups, size, dtype);
+          break;
+        case HloOpcode::kReduceScatter:
+          estimated = prof_result_.EstimateReduceScatterCost(replica_groups,
+                                                             size, dtype);
+          break;
+        case HloOpcode::kAllToAll:
+          estimated =
+              prof_result_.EstimateAllToAllCost(replica_groups, size, dtype);
+          break;
+        default:
+          break;
+      }
+    }
+    cost += estimated.has_value() ? *estimated : size / fallback_bandwidth_;
+  }
+  return cost;
+}
+
 }  // namespace gpu
 }  // namespace xla
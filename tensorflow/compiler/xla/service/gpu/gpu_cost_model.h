@@ -1,13 +1,134 @@
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_COST_MODEL_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_COST_MODEL_H_
 
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "tensorflow/compiler/xla/service/gpu/gpu_hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_hlo_schedule.h"
+#include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_sharding.h"
+#include "tensorflow/compiler/xla/service/spmd/collective_cost_model.h"
+#include "tensorflow/compiler/xla/statusor.h"
 
 namespace xla {
 namespace gpu {
 
+// Estimate the time of the entry computation of a sharded module. Collectives
+// and GEMMs are charged by the profiled collective cost model. Convolutions
+// are charged by the profiled dot curve, or by their flops at
+// "auto_sharding::device_peak_flops". The other kernels, e.g., fusions,
+// reductions and copies, take the longer of their flops at the peak throughput
+// and their bytes accessed at "auto_sharding::device_memory_bandwidth". The
+// non-GEMM costs are scaled by "gpu_cost_model::conv_scale" and
+// "gpu_cost_model::memory_bound_scale", and are skipped if
+// "gpu_cost_model::count_non_gemm_ops" is false.
 double EstimateHloModuleCost(const HloModule* hlo_module);
 
+// Same as above, but with an explicit collective cost model instead of the one
+// in the pass context, for callers outside of python.
+double EstimateHloModuleCost(const HloModule* hlo_module,
+                             const spmd::CollectiveCostModel& prof_result);
+
+// Estimate the time to move a tensor of `shape` from a mesh of
+// `src_num_devices` devices, where it has `src_sharding`, to another mesh of
+// `dst_num_devices` devices, where it should have `dst_sharding`. The device ids
+// in both shardings are the logical ids within their own mesh.
+//
+// Every distinct destination tile receives the overlapping part of each source
+// tile, with a send/recv when the tile has one replica and a broadcast to its
+// replicas otherwise. The transfers of a source tile are spread over its
+// replicas, which may each serve a part of the replicas of the destination
+// tile. The devices of both meshes work in parallel, so the cost is the
+// busiest device's total transfer time.
+double EstimateReshardingCost(const Shape& shape,
+                              const HloSharding& src_sharding,
+                              int64_t src_num_devices,
+                              const HloSharding& dst_sharding,
+                              int64_t dst_num_devices,
+                              const spmd::CollectiveCostModel& prof_result);
+
+// One transfer of a cross-mesh resharding: the slice [offset, limit) of a
+// tensor moves from `src_device` to `dst_devices`, with a send/recv for one
+// destination and a broadcast otherwise. The device ids are the logical ids
+// within their own mesh.
+struct ReshardingTransfer {
+  std::vector<int64_t> offset;
+  std::vector<int64_t> limit;
+  int64_t src_device;
+  std::vector<int64_t> dst_devices;
+  // The estimated time of the transfer.
+  double seconds;
+};
+
+// Plan the transfers that move the tensors of `shapes` from a mesh of
+// `src_num_devices` devices, where they have `src_shardings`, to a mesh of
+// `dst_num_devices` devices, where they should have `dst_shardings`, e.g., to
+// move the training state to a resized cluster without a checkpoint. Returns
+// the transfers of each tensor.
+//
+// The transfers are planned as in EstimateReshardingCost, but over all the
+// tensors at once, so that the busiest device of both meshes finishes as
+// early as possible when all transfers run concurrently. The receivers of a
+// replicated destination tile may be split over several replicas of the
+// source tile, when broadcasting from each of them to a part of the receivers
+// is estimated to finish first.
+StatusOr<std::vector<std::vector<ReshardingTransfer>>> PlanResharding(
+    absl::Span<const Shape> shapes, absl::Span<const HloSharding> src_shardings,
+    int64_t src_num_devices, absl::Span<const HloSharding> dst_shardings,
+    int64_t dst_num_devices, const spmd::CollectiveCostModel& prof_result);
+
+// Estimate the time to send all outputs of the sharded stage `stage_module`
+// to the next stage on a mesh of `dst_num_devices` devices, whose inputs have
+// `dst_shardings` (one per output leaf). The outputs are sent concurrently, so
+// this is not the sum of the EstimateReshardingCost of each output.
+StatusOr<double> EstimateStageBoundaryCost(
+    const HloModule* stage_module,
+    absl::Span<const HloSharding> dst_shardings, int64_t dst_num_devices,
+    const spmd::CollectiveCostModel& prof_result);
+
+// The combine threshold of collectives like `collective`, in bytes: `scale`
+// times the size at which the fixed overhead of the collective equals its
+// bandwidth term in the profiled cost model, over the replica groups of
+// `collective`. Return nullopt if the collective is not profiled.
+std::optional<int64_t> CombineThresholdFromCostModel(
+    const HloInstruction* collective, int64_t num_devices,
+    const spmd::CollectiveCostModel& prof_result, double scale);
+
+// Load the collective profile given by "gpu_cost_model::profiling_file" or
+// "gpu_cost_model::profiling_results".
+spmd::CollectiveCostModel LoadCollectiveCostModel();
+
+// Estimate the compute times with GpuHloCostAnalysis and the latencies of
+// asynchronous collectives with the profiled collective cost model. The
+// collectives without a profiled curve, and the other asynchronous ops, take
+// their bytes over `fallback_bandwidth`.
+class ProfiledLatencyEstimator : public GpuLatencyEstimator {
+ public:
+  static StatusOr<std::unique_ptr<ProfiledLatencyEstimator>> Create(
+      const HloModule* module, const HloCostAnalysis::Options& cost_options,
+      spmd::CollectiveCostModel prof_result, double fallback_bandwidth);
+
+  double ComputeTime(const HloInstruction& instruction) const override;
+  double AsyncLatency(const HloInstruction& start) const override;
+
+ private:
+  ProfiledLatencyEstimator(const HloCostAnalysis::Options& cost_options,
+                           spmd::CollectiveCostModel prof_result,
+                           double fallback_bandwidth, int64_t num_devices)
+      : cost_analysis_(cost_options),
+        prof_result_(std::move(prof_result)),
+        fallback_bandwidth_(fallback_bandwidth),
+        num_devices_(num_devices) {}
+
+  GpuHloCostAnalysis cost_analysis_;
+  spmd::CollectiveCostModel prof_result_;
+  double fallback_bandwidth_;
+  int64_t num_devices_;
+};
+
 }  // namespace gpu
 }  // namespace xla
 
@@ -0,0 +1,280 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/gpu/gpu_deterministic_scatter_rewriter.h"
+
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "tensorflow/compiler/xla/comparison_util.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_creation_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+// Returns true if the computation adds its two parameters.
+bool IsScalarAdd(const HloComputation* computation) {
+  const HloInstruction* root = computation->root_instruction();
+  return computation->num_parameters() == 2 &&
+         root->opcode() == HloOpcode::kAdd &&
+         root->operand(0)->opcode() == HloOpcode::kParameter &&
+         root->operand(1)->opcode() == HloOpcode::kParameter &&
+         root->operand(0) != root->operand(1);
+}
+
+// Returns the comparator that sorts the indices in ascending order, carrying
+// their positions along.
+HloComputation* MakeIndicesComparator(HloModule* module,
+                                      PrimitiveType index_type) {
+  HloComputation::Builder b("compare_scatter_indices");
+  const Shape index_shape = ShapeUtil::MakeShape(index_type, {});
+  const Shape position_shape = ShapeUtil::MakeShape(S32, {});
+  HloInstruction* lhs = b.AddInstruction(
+      HloInstruction::CreateParameter(0, index_shape, "lhs"));
+  HloInstruction* rhs = b.AddInstruction(
+      HloInstruction::CreateParameter(1, index_shape, "rhs"));
+  b.AddInstruction(
+      HloInstruction::CreateParameter(2, position_shape, "lhs_position"));
+  b.AddInstruction(
+      HloInstruction::CreateParameter(3, position_shape, "rhs_position"));
+  b.AddInstruction(HloInstruction::CreateCompare(
+      ShapeUtil::MakeShape(PRED, {}), lhs, rhs, ComparisonDirection::kLt));
+  return module->AddEmbeddedComputation(b.Build());
+}
+
+// Shifts the elements of `operand` along dimension 0 by `offset`, towards
+// higher indices for a positive offset. Vacated elements are zero.
+StatusOr<HloInstruction*> ShiftMajorDimension(HloInstruction* operand,
+                                              int64_t offset) {
+  const Shape& shape = operand->shape();
+  int64_t size = shape.dimensions(0);
+  std::vector<int64_t> start(shape.rank(), 0);
+  std::vector<int64_t> limit(shape.dimensions().begin(),
+                             shape.dimensions().end());
+  std::vector<int64_t> strides(shape.rank(), 1);
+  if (offset > 0) {
+    limit[0] = size - offset;
+  } else {
+    start[0] = -offset;
+  }
+  TF_ASSIGN_OR_RETURN(HloInstruction * slice,
+                      MakeSliceHlo(operand, start, limit, strides));
+
+  PaddingConfig padding = MakeNoPaddingConfig(shape.rank());
+  if (offset > 0) {
+    padding.mutable_dimensions(0)->set_edge_padding_low(offset);
+  } else {
+    padding.mutable_dimensions(0)->set_edge_padding_high(-offset);
+  }
+  HloInstruction* zero = operand->AddInstruction(HloInstruction::CreateConstant(
+      LiteralUtil::Zero(shape.element_type())));
+  return MakePadHlo(slice, zero, padding);
+}
+
+}  // namespace
+
+StatusOr<bool> GpuDeterministicScatterRewriter::RewriteScatter(
+    HloScatterInstruction* scatter) {
+  if (scatter->scatter_operand_count() != 1 || scatter->unique_indices() ||
+      !IsScalarAdd(scatter->to_apply())) {
+    return false;
+  }
+
+  HloInstruction* operand = scatter->scatter_operands()[0];
+  HloInstruction* indices = scatter->scatter_indices();
+  HloInstruction* updates = scatter->scatter_updates()[0];
+  const Shape& operand_shape = operand->shape();
+  const Shape& indices_shape = indices->shape();
+  const Shape& updates_shape = updates->shape();
+  PrimitiveType type = operand_shape.element_type();
+  PrimitiveType index_type = indices_shape.element_type();
+  if (!primitive_util::IsFloatingPointType(type) &&
+      !primitive_util::IsIntegralType(type)) {
+    return false;
+  }
+
+  // Scalar indices into the major-most operand dimension.
+  const ScatterDimensionNumbers& dnums = scatter->scatter_dimension_numbers();
+  if (dnums.index_vector_dim() < indices_shape.rank() &&
+      indices_shape.dimensions(dnums.index_vector_dim()) != 1) {
+    return false;
+  }
+  if (dnums.scatter_dims_to_operand_dims_size() != 1 ||
+      dnums.scatter_dims_to_operand_dims(0) != 0 ||
+      dnums.inserted_window_dims_size() != 1 ||
+      dnums.inserted_window_dims(0) != 0) {
+    return false;
+  }
+
+  // The update windows are full rows of the operand, in the minor-most
+  // dimensions of the updates.
+  const int64_t num_window_dims = operand_shape.rank() - 1;
+  const int64_t num_scatter_dims = updates_shape.rank() - num_window_dims;
+  if (dnums.update_window_dims_size() != num_window_dims ||
+      num_scatter_dims < 0) {
+    return false;
+  }
+  for (int64_t i = 0; i < num_window_dims; ++i) {
+    if (dnums.update_window_dims(i) != num_scatter_dims + i ||
+        updates_shape.dimensions(num_scatter_dims + i) !=
+            operand_shape.dimensions(i + 1)) {
+      return false;
+    }
+  }
+
+  // Updates that are not the last of a run of duplicate indices are
+  // redirected to distinct out of bounds indices, which must be representable.
+  const int64_t num_indices = ShapeUtil::ElementsIn(indices_shape);
+  const int64_t num_rows = operand_shape.dimensions(0);
+  const int64_t max_index =
+      index_type == S64 ? std::numeric_limits<int64_t>::max()
+                        : std::numeric_limits<int32_t>::max();
+  if ((index_type != S32 && index_type != S64) || num_indices < 2 ||
+      num_indices > std::numeric_limits<int32_t>::max() ||
+      num_rows > max_index - num_indices) {
+    return false;
+  }
+  if (!rewrite_all_ && num_indices < min_num_indices_) {
+    return false;
+  }
+
+  HloComputation* computation = scatter->parent();
+
+  // Sort the indices together with their positions.
+  TF_ASSIGN_OR_RETURN(HloInstruction * keys,
+                      MakeReshapeHlo({num_indices}, indices));
+  HloInstruction* positions =
+      MakeIotaHlo(computation, ShapeUtil::MakeShape(S32, {num_indices}),
+                  /*iota_dimension=*/0);
+  HloInstruction* sort = computation->AddInstruction(HloInstruction::CreateSort(
+      ShapeUtil::MakeTupleShape({keys->shape(), positions->shape()}),
+      /*dimension=*/0, {keys, positions},
+      MakeIndicesComparator(scatter->GetModule(), index_type),
+      /*is_stable=*/true));
+  TF_ASSIGN_OR_RETURN(HloInstruction * sorted_keys,
+                      MakeGetTupleElementHlo(sort, 0));
+  TF_ASSIGN_OR_RETURN(HloInstruction * sorted_positions,
+                      MakeGetTupleElementHlo(sort, 1));
+
+  // Gather the updates in the sorted order.
+  std::vector<int64_t> rows_dims = {num_indices};
+  std::vector<int64_t> slice_sizes = {1};
+  for (int64_t i = 1; i < operand_shape.rank(); ++i) {
+    rows_dims.push_back(operand_shape.dimensions(i));
+    slice_sizes.push_back(operand_shape.dimensions(i));
+  }
+  TF_ASSIGN_OR_RETURN(HloInstruction * rows,
+                      MakeReshapeHlo(rows_dims, updates));
+  TF_ASSIGN_OR_RETURN(HloInstruction * gather_indices,
+                      MakeReshapeHlo({num_indices, 1}, sorted_positions));
+  std::vector<int64_t> window_dims(num_window_dims);
+  std::iota(window_dims.begin(), window_dims.end(), 1);
+  HloInstruction* sums =
+      computation->AddInstruction(HloInstruction::CreateGather(
+          rows->shape(), rows, gather_indices,
+          HloGatherInstruction::MakeGatherDimNumbers(
+              /*offset_dims=*/window_dims, /*collapsed_slice_dims=*/{0},
+              /*start_index_map=*/{0}, /*index_vector_dim=*/1),
+          slice_sizes, /*indices_are_sorted=*/false));
+
+  // Segmented inclusive scan: after the step with offset 2^k, every element
+  // holds the sum of the up to 2^(k+1) elements with the same index that end
+  // at it. As the indices are sorted, equal indices at a distance `offset`
+  // imply that all elements between them have the same index.
+  HloInstruction* zeros = MakeScalarLike(sums, 0);
+  for (int64_t offset = 1; offset < num_indices; offset *= 2) {
+    TF_ASSIGN_OR_RETURN(HloInstruction * shifted_keys,
+                        ShiftMajorDimension(sorted_keys, offset));
+    TF_ASSIGN_OR_RETURN(HloInstruction * shifted_sums,
+                        ShiftMajorDimension(sums, offset));
+    TF_ASSIGN_OR_RETURN(
+        HloInstruction * has_predecessor,
+        MakeCompareHlo(ComparisonDirection::kGe, positions,
+                       MakeScalarLike(positions, offset)));
+    TF_ASSIGN_OR_RETURN(
+        HloInstruction * same_index,
+        MakeCompareHlo(ComparisonDirection::kEq, sorted_keys, shifted_keys));
+    TF_ASSIGN_OR_RETURN(
+        HloInstruction * same_segment,
+        MakeBinaryHlo(HloOpcode::kAnd, has_predecessor, same_index));
+    TF_ASSIGN_OR_RETURN(
+        HloInstruction * addend,
+        MakeSelectHlo(MakeBroadcastHlo(same_segment, {0}, sums->shape()),
+                      shifted_sums, zeros));
+    TF_ASSIGN_OR_RETURN(sums, MakeBinaryHlo(HloOpcode::kAdd, sums, addend));
+  }
+
+  // Only the last element of each run of equal indices is written.
+  TF_ASSIGN_OR_RETURN(HloInstruction * next_keys,
+                      ShiftMajorDimension(sorted_keys, -1));
+  TF_ASSIGN_OR_RETURN(
+      HloInstruction * next_differs,
+      MakeCompareHlo(ComparisonDirection::kNe, sorted_keys, next_keys));
+  TF_ASSIGN_OR_RETURN(
+      HloInstruction * is_last_position,
+      MakeCompareHlo(ComparisonDirection::kEq, positions,
+                     MakeScalarLike(positions, num_indices - 1)));
+  TF_ASSIGN_OR_RETURN(
+      HloInstruction * is_last,
+      MakeBinaryHlo(HloOpcode::kOr, next_differs, is_last_position));
+  TF_ASSIGN_OR_RETURN(
+      HloInstruction * out_of_bounds,
+      MakeBinaryHlo(HloOpcode::kAdd, MakeConvertToHlo(positions, index_type),
+                    MakeScalarLike(sorted_keys, num_rows)));
+  TF_ASSIGN_OR_RETURN(HloInstruction * new_keys,
+                      MakeSelectHlo(is_last, sorted_keys, out_of_bounds));
+  TF_ASSIGN_OR_RETURN(HloInstruction * new_indices,
+                      MakeReshapeHlo({num_indices, 1}, new_keys));
+
+  HloInstruction* new_scatter =
+      computation->AddInstruction(HloInstruction::CreateScatter(
+          scatter->shape(), operand, new_indices, sums, scatter->to_apply(),
+          HloScatterInstruction::MakeScatterDimNumbers(
+              /*update_window_dims=*/window_dims,
+              /*inserted_window_dims=*/{0},
+              /*scatter_dims_to_operand_dims=*/{0}, /*index_vector_dim=*/1),
+          /*indices_are_sorted=*/false, /*unique_indices=*/true));
+  new_scatter->set_metadata(scatter->metadata());
+  TF_RETURN_IF_ERROR(computation->ReplaceInstruction(scatter, new_scatter));
+  return true;
+}
+
+StatusOr<bool> GpuDeterministicScatterRewriter::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  bool changed = false;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    for (HloInstruction* instruction :
+         computation->MakeInstructionPostOrder()) {
+      if (auto* scatter = DynCast<HloScatterInstruction>(instruction)) {
+        TF_ASSIGN_OR_RETURN(bool rewritten, RewriteScatter(scatter));
+        changed |= rewritten;
+      }
+    }
+  }
+  return changed;
+}
+
+}  // namespace gpu
+}  // namespace xla
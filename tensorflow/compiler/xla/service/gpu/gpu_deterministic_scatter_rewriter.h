@@ -0,0 +1,70 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_DETERMINISTIC_SCATTER_REWRITER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_DETERMINISTIC_SCATTER_REWRITER_H_
+
+#include <cstdint>
+
+#include "tensorflow/compiler/xla/service/hlo_instructions.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace xla {
+namespace gpu {
+
+// Rewrites scatter-adds of rows (e.g. embedding gradients) into a scatter with
+// unique indices, which XLA:GPU emits without atomics:
+//
+// 1. sort the indices together with their positions (a stable radix sort for
+//    large scatters, see GpuSortRewriter);
+// 2. gather the updates in the sorted order and sum the updates of duplicate
+//    indices with a segmented inclusive scan over log2(n) steps;
+// 3. scatter the sum of each run of duplicate indices from its last element,
+//    and redirect all other updates out of bounds so they are dropped.
+//
+// The result is deterministic, as the summation order only depends on the
+// order of the indices.
+//
+// Matches scatters with a single operand, an add combiner and scalar indices
+// into the major-most operand dimension, that update full rows of the operand.
+// Scatters that already have unique indices are left alone.
+class GpuDeterministicScatterRewriter : public HloModulePass {
+ public:
+  // If `rewrite_all` is set, all matching scatters are rewritten, otherwise
+  // only the ones with at least `min_num_indices` indices.
+  GpuDeterministicScatterRewriter(bool rewrite_all, int64_t min_num_indices)
+      : rewrite_all_(rewrite_all), min_num_indices_(min_num_indices) {}
+
+  absl::string_view name() const override {
+    return "gpu-deterministic-scatter-rewriter";
+  }
+
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+
+ private:
+  StatusOr<bool> RewriteScatter(HloScatterInstruction* scatter);
+
+  bool rewrite_all_;
+  int64_t min_num_indices_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_DETERMINISTIC_SCATTER_REWRITER_H_
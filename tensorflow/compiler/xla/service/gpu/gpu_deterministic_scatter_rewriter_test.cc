@@ -0,0 +1,134 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/gpu/gpu_deterministic_scatter_rewriter.h"
+
+#include <memory>
+
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_evaluator.h"
+#include "tensorflow/compiler/xla/service/hlo_instructions.h"
+#include "tensorflow/compiler/xla/service/hlo_matchers.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/tsl/lib/core/status_test_util.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+namespace op = xla::testing::opcode_matchers;
+
+using GpuDeterministicScatterRewriterTest = HloTestBase;
+
+constexpr char kEmbeddingGradHlo[] = R"(
+HloModule EmbeddingGrad
+
+%add {
+  %lhs = f32[] parameter(0)
+  %rhs = f32[] parameter(1)
+  ROOT %add = f32[] add(%lhs, %rhs)
+}
+
+ENTRY %main {
+  %operand = f32[5,3] parameter(0)
+  %indices = s32[7,1] parameter(1)
+  %updates = f32[7,3] parameter(2)
+  ROOT %scatter = f32[5,3] scatter(%operand, %indices, %updates),
+      update_window_dims={1}, inserted_window_dims={0},
+      scatter_dims_to_operand_dims={0}, index_vector_dim=1, to_apply=%add
+})";
+
+TEST_F(GpuDeterministicScatterRewriterTest, RewriteScatterAdd) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kEmbeddingGradHlo));
+  std::unique_ptr<HloModule> reference = module->Clone();
+
+  TF_ASSERT_OK_AND_ASSIGN(
+      bool changed, GpuDeterministicScatterRewriter(/*rewrite_all=*/true,
+                                                    /*min_num_indices=*/0)
+                        .Run(module.get()));
+  EXPECT_TRUE(changed);
+
+  const HloInstruction* root = module->entry_computation()->root_instruction();
+  ASSERT_THAT(root, op::Scatter(op::Parameter(0), op::Reshape(op::Select()),
+                                op::Add()));
+  EXPECT_TRUE(Cast<HloScatterInstruction>(root)->unique_indices());
+
+  // The rewritten scatter computes the same result, including for duplicate
+  // and out of bounds indices.
+  Literal operand = LiteralUtil::CreateR2<float>(
+      {{1, 1, 1}, {2, 2, 2}, {3, 3, 3}, {4, 4, 4}, {5, 5, 5}});
+  Literal indices =
+      LiteralUtil::CreateR2<int32_t>({{3}, {0}, {3}, {7}, {1}, {3}, {0}});
+  Literal updates = LiteralUtil::CreateR2<float>({{1, 2, 3},
+                                                  {4, 5, 6},
+                                                  {7, 8, 9},
+                                                  {10, 11, 12},
+                                                  {13, 14, 15},
+                                                  {16, 17, 18},
+                                                  {19, 20, 21}});
+  HloEvaluator evaluator;
+  TF_ASSERT_OK_AND_ASSIGN(
+      Literal expected,
+      evaluator.Evaluate(*reference, {&operand, &indices, &updates}));
+  TF_ASSERT_OK_AND_ASSIGN(
+      Literal actual,
+      evaluator.Evaluate(*module, {&operand, &indices, &updates}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(expected, actual));
+}
+
+TEST_F(GpuDeterministicScatterRewriterTest, NoRewriteSmallScatter) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kEmbeddingGradHlo));
+  TF_ASSERT_OK_AND_ASSIGN(
+      bool changed, GpuDeterministicScatterRewriter(/*rewrite_all=*/false,
+                                                    /*min_num_indices=*/8)
+                        .Run(module.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(GpuDeterministicScatterRewriterTest, NoRewriteScatterMultiply) {
+  constexpr char kHlo[] = R"(
+HloModule ScatterMultiply
+
+%multiply {
+  %lhs = f32[] parameter(0)
+  %rhs = f32[] parameter(1)
+  ROOT %multiply = f32[] multiply(%lhs, %rhs)
+}
+
+ENTRY %main {
+  %operand = f32[5,3] parameter(0)
+  %indices = s32[7,1] parameter(1)
+  %updates = f32[7,3] parameter(2)
+  ROOT %scatter = f32[5,3] scatter(%operand, %indices, %updates),
+      update_window_dims={1}, inserted_window_dims={0},
+      scatter_dims_to_operand_dims={0}, index_vector_dim=1,
+      to_apply=%multiply
+})";
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(kHlo));
+  TF_ASSERT_OK_AND_ASSIGN(
+      bool changed, GpuDeterministicScatterRewriter(/*rewrite_all=*/true,
+                                                    /*min_num_indices=*/0)
+                        .Run(module.get()));
+  EXPECT_FALSE(changed);
+}
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
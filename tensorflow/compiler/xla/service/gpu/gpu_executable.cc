@@ -246,10 +246,20 @@ class GpuExecutable::XlaRuntimeGpuExecutable {
 
 StatusOr<std::unique_ptr<GpuExecutable>> GpuExecutable::Create(Params params) {
   auto executable = std::move(params.executable);
+  const bool enable_cuda_graphs = params.enable_cuda_graphs;
+  auto stream_assignment = std::move(params.stream_assignment);
   std::unique_ptr<GpuExecutable> result(new GpuExecutable(std::move(params)));
 
   if (std::holds_alternative<OwnedThunkSequence>(executable)) {
     result->thunks_ = std::move(std::get<OwnedThunkSequence>(executable));
+    if (enable_cuda_graphs) {
+      result->graph_runner_ =
+          std::make_unique<CudaGraphThunkRunner>(result->thunks_.get());
+    } else if (stream_assignment != nullptr &&
+               stream_assignment->num_streams() > 1) {
+      // Added by Alpa. The graphs are captured on the main stream only.
+      result->stream_assignment_ = std::move(stream_assignment);
+    }
     return result;
   }
 
@@ -277,6 +287,8 @@ GpuExecutable::GpuExecutable(GpuExecutable::Params params)
       debug_buffer_assignment_(std::move(params.debug_buffer_assignment)),
       verbose_buffer_assignment_string_dumper_(
           params.verbose_buffer_assignment_string_dumper),
+      reuse_temp_buffers_(params.reuse_temp_buffers),
+      reuse_nccl_comms_(params.reuse_nccl_comms),
       constants_(std::move(params.constants)),
       output_info_(std::move(params.output_info)) {
   if (has_module()) {
@@ -301,7 +313,15 @@ GpuExecutable::~GpuExecutable() {
     for (const auto& pair : module_globals_) {
       CHECK(pair.first->SynchronizeAllActivity());
     }
+    for (auto& [executor, buffers] : host_buffers_) {
+      CHECK(executor->SynchronizeAllActivity());
+      for (auto& [index, buffer] : buffers) {
+        executor->HostMemoryDeallocate(buffer.opaque());
+      }
+    }
   }
+  // Added by Alpa
+  TF_CHECK_OK(ReleaseTempArenas());
 
   delete xla_runtime_executable_;
 }
@@ -344,20 +364,68 @@ Status ExecuteThunks(const std::string& module_name,
                      const ThunkSequence& thunk_sequence,
                      const ServiceExecutableRunOptions* run_options,
                      const BufferAllocations& buffer_allocations,
-                     bool block_host_until_done) {
+                     bool block_host_until_done,
+                     CudaGraphThunkRunner* graph_runner,
+                     const ThunkStreamAssignment* stream_assignment,
+                     bool reuse_nccl_comms) {
   se::Stream* main_stream = run_options->stream();
   se::StreamExecutor* executor = main_stream->parent();
 
   StatusOr<StreamPool::Ptr> async_comms_stream =
       run_options->BorrowStream(executor->device_ordinal());
 
+  // Added by Alpa
+  // Borrow the other streams of the stream assignment. If fewer streams are
+  // available, several assigned streams share a stream, which only elides
+  // some parallelism.
+  std::vector<StreamPool::Ptr> borrowed_streams;
+  std::vector<se::Stream*> streams = {main_stream};
+  if (stream_assignment != nullptr) {
+    for (int s = 1; s < stream_assignment->num_streams(); ++s) {
+      StatusOr<StreamPool::Ptr> stream =
+          run_options->BorrowStream(executor->device_ordinal());
+      if (!stream.ok()) {
+        VLOG(1) << "Run on " << streams.size() << " streams instead of "
+                << stream_assignment->num_streams() << ": "
+                << stream.status();
+        break;
+      }
+      streams.push_back(stream->get());
+      borrowed_streams.push_back(std::move(*stream));
+    }
+    for (int s = 1; s < streams.size(); ++s) {
+      streams[s]->ThenWaitFor(main_stream);
+    }
+  }
+  auto get_stream = [&](int s) { return streams[s % streams.size()]; };
+
+  // Added by Alpa
+  // Keep the NCCL communicators locked by the collectives of this run until
+  // all thunks are enqueued.
+  NcclCommCache nccl_comm_cache;
+  NcclCommCache* comm_cache = reuse_nccl_comms ? &nccl_comm_cache : nullptr;
+
   uint64_t start_micros = tsl::Env::Default()->NowMicros();
 
   tsl::profiler::TraceMe hlo_module_activity(
       [&] { return absl::StrCat(module_name, ":XLA GPU module"); },
       tsl::profiler::TraceMeLevel::kInfo);
 
-  for (const std::unique_ptr<Thunk>& thunk : thunk_sequence) {
+  for (int64_t i = 0; i < thunk_sequence.size(); ++i) {
+    const std::unique_ptr<Thunk>& thunk = thunk_sequence[i];
+    if (graph_runner != nullptr) {
+      Thunk::ExecuteParams graph_params{
+          *run_options, buffer_allocations, main_stream,
+          async_comms_stream.ok() ? async_comms_stream->get() : nullptr};
+      graph_params.nccl_params.nccl_comm_cache = comm_cache;
+      TF_ASSIGN_OR_RETURN(int64_t graph_end,
+                          graph_runner->MaybeLaunchGraph(i, graph_params));
+      if (graph_end > i) {
+        i = graph_end - 1;
+        continue;
+      }
+    }
+
     // Annotate execution of this op if tracing was enabled when we started
     // running this module.  If tracing is enabled *while* we're running the
     // module, we won't get any data, but that's probably an OK trade-off.
@@ -366,11 +434,33 @@ Status ExecuteThunks(const std::string& module_name,
     TF_RET_CHECK(async_comms_stream.ok() || !NeedsAsyncCommsStream(*thunk))
         << "`run_options` must have a stream borrower for async thunks.";
 
+    se::Stream* stream = main_stream;
+    if (stream_assignment != nullptr) {
+      const ThunkStreamAssignment::ThunkStream& thunk_stream =
+          stream_assignment->thunk_stream(i);
+      stream = get_stream(thunk_stream.stream);
+      for (int wait_for : thunk_stream.wait_for) {
+        if (get_stream(wait_for) != stream) {
+          stream->ThenWaitFor(get_stream(wait_for));
+        }
+      }
+    }
+
     Thunk::ExecuteParams thunk_params{
-        *run_options, buffer_allocations, main_stream,
+        *run_options, buffer_allocations, stream,
         async_comms_stream.ok() ? async_comms_stream->get() : nullptr};
+    thunk_params.nccl_params.nccl_comm_cache = comm_cache;
     TF_RETURN_IF_ERROR(thunk->ExecuteOnStream(thunk_params));
   }
+
+  // Added by Alpa
+  if (stream_assignment != nullptr) {
+    for (int join : stream_assignment->join_streams()) {
+      if (get_stream(join) != main_stream) {
+        main_stream->ThenWaitFor(get_stream(join));
+      }
+    }
+  }
   return MaybeSyncAndProfile(run_options, start_micros,
                              block_host_until_done ? main_stream : nullptr);
 }
@@ -479,6 +569,92 @@ GpuExecutable::ResolveConstantGlobals(se::Stream* stream) {
   return &module_globals_.emplace(executor, std::move(globals)).first->second;
 }
 
+StatusOr<const GpuExecutable::BufferAllocToDeviceMemoryMap*>
+GpuExecutable::ResolveHostBuffers(se::StreamExecutor* executor) {
+  absl::MutexLock lock(&module_handle_mutex_);
+  auto it = host_buffers_.find(executor);
+  if (it != host_buffers_.end()) {
+    return &it->second;
+  }
+
+  BufferAllocToDeviceMemoryMap buffers;
+  for (const BufferAllocation& allocation : allocations_) {
+    if (allocation.color() != kHostMemorySpaceColor) {
+      continue;
+    }
+    TF_RET_CHECK(allocation.IsPreallocatedTempBuffer())
+        << "Only temp buffers can be in host memory: "
+        << allocation.ToString();
+    void* host_memory = executor->HostMemoryAllocate(allocation.size());
+    if (host_memory == nullptr) {
+      for (auto& [index, buffer] : buffers) {
+        executor->HostMemoryDeallocate(buffer.opaque());
+      }
+      return ResourceExhausted(
+          "Failed to allocate %d bytes of pinned host memory for %s",
+          allocation.size(), module_name_);
+    }
+    buffers.emplace(allocation.index(),
+                    se::DeviceMemoryBase(host_memory, allocation.size()));
+  }
+  return &host_buffers_.emplace(executor, std::move(buffers)).first->second;
+}
+
+StatusOr<const GpuExecutable::BufferAllocToDeviceMemoryMap*>
+GpuExecutable::ResolveTempArena(se::Stream* stream,
+                                se::DeviceMemoryAllocator* memory_allocator,
+                                int device_ordinal) {
+  absl::MutexLock lock(&temp_arena_mutex_);
+  auto it = temp_arenas_.find(stream);
+  if (it != temp_arenas_.end()) {
+    if (it->second.memory_allocator != memory_allocator ||
+        it->second.device_ordinal != device_ordinal) {
+      return nullptr;
+    }
+    return &it->second.buffers;
+  }
+
+  TempArena arena{memory_allocator, device_ordinal, {}};
+  for (const BufferAllocation& allocation : allocations_) {
+    if (!allocation.IsPreallocatedTempBuffer() ||
+        allocation.color() == kHostMemorySpaceColor) {
+      continue;
+    }
+    se::DeviceMemoryBase buffer;
+    if (allocation.size() > 0) {
+      StatusOr<se::OwningDeviceMemory> owning =
+          memory_allocator->Allocate(device_ordinal, allocation.size());
+      if (!owning.ok()) {
+        VLOG(1) << "Failed to allocate the temp arena of " << module_name_
+                << ": " << owning.status();
+        for (auto& [index, allocated] : arena.buffers) {
+          memory_allocator->Deallocate(device_ordinal, allocated).IgnoreError();
+        }
+        return nullptr;
+      }
+      buffer = owning->Release();
+    }
+    arena.buffers.emplace(allocation.index(), buffer);
+  }
+  return &temp_arenas_.emplace(stream, std::move(arena)).first->second.buffers;
+}
+
+Status GpuExecutable::ReleaseTempArenas() {
+  absl::MutexLock lock(&temp_arena_mutex_);
+  Status status;
+  for (auto& [stream, arena] : temp_arenas_) {
+    for (auto& [index, buffer] : arena.buffers) {
+      Status dealloc_status =
+          arena.memory_allocator->Deallocate(arena.device_ordinal, buffer);
+      if (!dealloc_status.ok() && status.ok()) {
+        status = dealloc_status;
+      }
+    }
+  }
+  temp_arenas_.clear();
+  return status;
+}
+
 StatusOr<se::DeviceMemoryBase> GpuExecutable::BufferForAllocation(
     VariantArguments arguments,
     const GpuExecutable::BufferAllocToDeviceMemoryMap* globals,
@@ -557,6 +733,8 @@ static Status CheckAlignment(const BufferAllocation& allocation,
 StatusOr<BufferAllocations> GpuExecutable::GenerateBufferAllocations(
     VariantArguments arguments,
     const GpuExecutable::BufferAllocToDeviceMemoryMap* globals,
+    const GpuExecutable::BufferAllocToDeviceMemoryMap* host_buffers,
+    const GpuExecutable::BufferAllocToDeviceMemoryMap* temp_arena,
     se::DeviceMemoryAllocator* const memory_allocator, int device_ordinal) {
   tsl::profiler::TraceMe hlo_module_activity(
       [&] { return std::string("Build buffer allocations"); },
@@ -567,6 +745,17 @@ StatusOr<BufferAllocations> GpuExecutable::GenerateBufferAllocations(
   buffers.reserve(num_buffers);
   for (int64_t i = 0; i < num_buffers; ++i) {
     const BufferAllocation& allocation = allocations_[i];
+    if (auto it = host_buffers->find(i); it != host_buffers->end()) {
+      buffers.push_back(it->second);
+      continue;
+    }
+    // Added by Alpa
+    if (temp_arena != nullptr) {
+      if (auto it = temp_arena->find(i); it != temp_arena->end()) {
+        buffers.push_back(it->second);
+        continue;
+      }
+    }
     TF_ASSIGN_OR_RETURN(
         se::DeviceMemoryBase buffer,
         BufferForAllocation(arguments, globals, allocation, memory_allocator,
@@ -743,15 +932,37 @@ StatusOr<ExecutionOutput> GpuExecutable::ExecuteAsyncOnStreamImpl(
 
     TF_ASSIGN_OR_RETURN(globals, ResolveConstantGlobals(run_options->stream()));
   }
+  TF_ASSIGN_OR_RETURN(const BufferAllocToDeviceMemoryMap* host_buffers,
+                      ResolveHostBuffers(executor));
 
   auto device_ordinal = executor->device_ordinal();
   ExecutionOutput result(/*on_device_shape=*/output_shape_, memory_allocator,
                          device_ordinal);
 
-  TF_ASSIGN_OR_RETURN(
-      BufferAllocations buffer_allocations,
-      GenerateBufferAllocations(arguments, globals, memory_allocator,
-                                device_ordinal));
+  // Added by Alpa
+  const BufferAllocToDeviceMemoryMap* temp_arena = nullptr;
+  if (reuse_temp_buffers_) {
+    TF_ASSIGN_OR_RETURN(temp_arena,
+                        ResolveTempArena(run_options->stream(),
+                                         memory_allocator, device_ordinal));
+  }
+
+  StatusOr<BufferAllocations> maybe_buffer_allocations =
+      GenerateBufferAllocations(arguments, globals, host_buffers, temp_arena,
+                                memory_allocator, device_ordinal);
+  if (temp_arena != nullptr &&
+      tsl::errors::IsResourceExhausted(maybe_buffer_allocations.status())) {
+    // Added by Alpa. Under memory pressure, give the arenas back to the
+    // allocator and allocate the temp buffers of this run as usual.
+    VLOG(1) << "Releasing the temp arenas of " << module_name_;
+    TF_RETURN_IF_ERROR(ReleaseTempArenas());
+    temp_arena = nullptr;
+    maybe_buffer_allocations =
+        GenerateBufferAllocations(arguments, globals, host_buffers, temp_arena,
+                                  memory_allocator, device_ordinal);
+  }
+  TF_ASSIGN_OR_RETURN(BufferAllocations buffer_allocations,
+                      std::move(maybe_buffer_allocations));
   VLOG(2) << buffer_allocations.ToString();
   std::set<se::DeviceMemoryBase> buffers_in_result;
 
@@ -869,8 +1080,9 @@ StatusOr<ExecutionOutput> GpuExecutable::ExecuteAsyncOnStreamImpl(
                                                block_host_until_done));
 
   // Free all temporary allocations.
-  TF_RETURN_IF_ERROR(
-      buffer_allocations.TearDown(buffers_in_result, allocations_));
+  TF_RETURN_IF_ERROR(buffer_allocations.TearDown(
+      buffers_in_result, allocations_,
+      /*keep_temp_buffers=*/temp_arena != nullptr));
 
   // Free allocations for arguments.
   if (auto args = std::get_if<absl::Span<ExecutionInput>>(&arguments)) {
@@ -891,7 +1103,9 @@ Status GpuExecutable::ExecuteThunksOrXlaRuntime(
       TF_RETURN_IF_ERROR(thunk->Initialize(*this, executor));
     }
     return ExecuteThunks(module_name_, *thunks_, run_options,
-                         buffer_allocations, block_host_until_done);
+                         buffer_allocations, block_host_until_done,
+                         graph_runner_.get(), stream_assignment_.get(),
+                         reuse_nccl_comms_);
   }
 
   if (xla_runtime_executable_) {
@@ -1187,5 +1401,30 @@ int64_t GpuExecutable::TotalAllocationSize() const {
   return total_size;
 }
 
+// Added by Alpa
+Executable::BufferSizes GpuExecutable::GetBufferSizes() const {
+  BufferSizes sizes;
+  sizes.argument_size_in_bytes = 0;
+  sizes.output_size_in_bytes = 0;
+  sizes.alias_size_in_bytes = 0;
+  sizes.temp_size_in_bytes = 0;
+  for (const BufferAllocation& allocation : allocations_) {
+    if (allocation.is_entry_computation_parameter()) {
+      sizes.argument_size_in_bytes += allocation.size();
+    }
+    if (allocation.maybe_live_out()) {
+      sizes.output_size_in_bytes += allocation.size();
+    }
+    if (allocation.is_entry_computation_parameter() &&
+        allocation.maybe_live_out()) {
+      sizes.alias_size_in_bytes += allocation.size();
+    }
+    if (allocation.IsPreallocatedTempBuffer()) {
+      sizes.temp_size_in_bytes += allocation.size();
+    }
+  }
+  return sizes;
+}
+
 }  // namespace gpu
 }  // namespace xla
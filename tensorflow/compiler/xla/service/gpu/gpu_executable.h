@@ -33,8 +33,10 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/buffer_assignment.h"
 #include "tensorflow/compiler/xla/service/executable.h"
 #include "tensorflow/compiler/xla/service/gpu/buffer_allocations.h"
+#include "tensorflow/compiler/xla/service/gpu/cuda_graph_thunk_runner.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_types.h"
 #include "tensorflow/compiler/xla/service/gpu/thunk.h"
+#include "tensorflow/compiler/xla/service/gpu/thunk_stream_assignment.h"
 #include "tensorflow/compiler/xla/service/hlo_dataflow_analysis.h"
 #include "tensorflow/compiler/xla/service/hlo_execution_profile.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
@@ -126,6 +128,17 @@ class GpuExecutable : public Executable {
     };
 
     std::unique_ptr<HloModule> debug_module = nullptr;
+
+    // Added by Alpa. Whether to replay the capturable thunks as CUDA graphs.
+    bool enable_cuda_graphs = false;
+    // Added by Alpa. The streams of the thunks, if they run on several streams.
+    std::unique_ptr<ThunkStreamAssignment> stream_assignment = nullptr;
+    // Added by Alpa. Whether to keep the temp buffers of a run for the next
+    // runs on the same stream.
+    bool reuse_temp_buffers = false;
+    // Added by Alpa. Whether the collectives of a run lock each NCCL
+    // communicator once, rather than with a rendezvous per collective.
+    bool reuse_nccl_comms = false;
   };
 
   // TODO(hanbinyoon): Once BEF replaces Thunks, hide this method as an
@@ -202,6 +215,12 @@ class GpuExecutable : public Executable {
 
   // Added by Alpa
   int64_t TotalAllocationSize() const override;
+  BufferSizes GetBufferSizes() const override;
+
+  // Added by Alpa. Frees the temp arenas kept for reuse_temp_buffers, e.g.
+  // under memory pressure. Must not race with executions of this executable;
+  // later executions allocate new arenas.
+  Status ReleaseTempArenas();
 
   absl::Span<const BufferAllocation> GetAllocations() const {
     return allocations_;
@@ -245,14 +264,34 @@ class GpuExecutable : public Executable {
   StatusOr<const BufferAllocToDeviceMemoryMap*> ResolveConstantGlobals(
       stream_executor::Stream* stream);
 
+  // Added by Alpa. Allocates the temp buffers in kHostMemorySpaceColor with
+  // pinned host memory for the given executor. The buffers are cached and
+  // reused by every execution, which must be ordered on the executor, and are
+  // freed when this executable is destroyed.
+  //
+  // Returns a map from buffer allocation indices to host memory pointers.
+  StatusOr<const BufferAllocToDeviceMemoryMap*> ResolveHostBuffers(
+      stream_executor::StreamExecutor* executor);
+
   // GpuExecutable check with either AMD's ISA version, or Nvidia's major minor
   // version for compute capability, depending on the hardware.
   Status CheckCompatibilityWithServiceExecutableRunOptions(
       const ServiceExecutableRunOptions* run_options);
 
+  // Added by Alpa. Allocates the device temp buffers once per stream and
+  // returns them for every execution on the stream, which orders the uses.
+  // Returns nullptr if the arena can't be allocated on `memory_allocator`;
+  // the temp buffers of the execution are then allocated as usual.
+  StatusOr<const BufferAllocToDeviceMemoryMap*> ResolveTempArena(
+      se::Stream* stream, se::DeviceMemoryAllocator* memory_allocator,
+      int device_ordinal);
+
+  // `temp_arena`, if not null, provides the device temp buffers.
   StatusOr<BufferAllocations> GenerateBufferAllocations(
       VariantArguments arguments,
       const GpuExecutable::BufferAllocToDeviceMemoryMap* globals,
+      const GpuExecutable::BufferAllocToDeviceMemoryMap* host_buffers,
+      const GpuExecutable::BufferAllocToDeviceMemoryMap* temp_arena,
       se::DeviceMemoryAllocator* const memory_allocator, int device_ordinal);
 
   StatusOr<se::DeviceMemoryBase> BufferForAllocation(
@@ -307,6 +346,29 @@ class GpuExecutable : public Executable {
   // Cache of constant buffer allocation maps used by `ResolveConstantGlobals`.
   std::map<stream_executor::StreamExecutor*, BufferAllocToDeviceMemoryMap>
       module_globals_ ABSL_GUARDED_BY(module_handle_mutex_);
+  // Cache of host temp buffers used by `ResolveHostBuffers`.
+  std::map<stream_executor::StreamExecutor*, BufferAllocToDeviceMemoryMap>
+      host_buffers_ ABSL_GUARDED_BY(module_handle_mutex_);
+
+  // Replays the capturable thunks as CUDA graphs if set. Declared after the
+  // module handles so that the graphs are destroyed before the modules are
+  // unloaded.
+  std::unique_ptr<CudaGraphThunkRunner> graph_runner_;
+  // Added by Alpa. Runs the thunks on several streams if set.
+  std::unique_ptr<ThunkStreamAssignment> stream_assignment_;
+
+  // Added by Alpa. The device temp buffers kept by `ResolveTempArena`.
+  struct TempArena {
+    se::DeviceMemoryAllocator* memory_allocator;
+    int device_ordinal;
+    BufferAllocToDeviceMemoryMap buffers;
+  };
+  const bool reuse_temp_buffers_ = false;
+  // Added by Alpa. See Params::reuse_nccl_comms.
+  const bool reuse_nccl_comms_ = false;
+  absl::Mutex temp_arena_mutex_;
+  std::map<se::Stream*, TempArena> temp_arenas_
+      ABSL_GUARDED_BY(temp_arena_mutex_);
 
   std::vector<ConstantInfo> constants_;
   const absl::flat_hash_map<ShapeIndex, OutputInfo> output_info_;
@@ -18,10 +18,12 @@ limitations under the License.
 
 #include <functional>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "tensorflow/compiler/xla/service/global_device_id.h"
 #include "tensorflow/compiler/xla/service/service_executable_run_options.h"
 #include "tensorflow/compiler/xla/statusor.h"
@@ -82,6 +84,17 @@ class GpuExecutableRunOptions {
 };
 
 // NCCL-related execution parameters.
+// Added by Alpa. The NCCL communicators that the collectives of one run on
+// one device have locked. The first collective on a clique locks the
+// communicator with a rendezvous of the local participants; the later ones
+// of the run reuse it without one. Destroying the cache unlocks them.
+//
+// This is thread-compatible.
+struct NcclCommCache {
+  // Type-erased NcclComm::Lock per clique, to keep NCCL headers out of here.
+  absl::flat_hash_map<NcclCliqueKey, std::shared_ptr<void>> comms;
+};
+
 struct NcclExecuteParams {
   NcclExecuteParams(const ServiceExecutableRunOptions& run_options,
                     se::Stream* stream);
@@ -91,6 +104,7 @@ struct NcclExecuteParams {
   const DeviceAssignment* device_assn;                         // never null
   const std::map<int, GlobalDeviceId>* gpu_global_device_ids;  // may be null
   const NcclUniqueIdCallback* nccl_unique_id_callback;         // may be null
+  NcclCommCache* nccl_comm_cache = nullptr;  // Added by Alpa. may be null
 
   StatusOr<GlobalDeviceId> GetGlobalDeviceId() const;
 };
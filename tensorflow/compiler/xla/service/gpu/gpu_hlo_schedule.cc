@@ -15,11 +15,18 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/gpu/gpu_hlo_schedule.h"
 
+#include <algorithm>
 #include <deque>
+#include <functional>
 #include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "tensorflow/compiler/xla/service/buffer_value.h"
+#include "tensorflow/compiler/xla/service/gpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/hlo_instructions.h"
 #include "tensorflow/compiler/xla/service/hlo_memory_scheduler.h"
 #include "tensorflow/compiler/xla/service/hlo_schedule.h"
@@ -29,7 +36,6 @@ namespace gpu {
 
 namespace {
 
-
 bool ShouldScheduleAsEarlyAsPossible(const HloInstruction& instr) {
   switch (instr.opcode()) {
     case HloOpcode::kAllReduceStart:
@@ -149,18 +155,202 @@ HloInstructionSequence PostprocessorToScheduleAsEarlyOrLateAsPossible(
   return result;
 }
 
+bool IsAsyncStart(const HloInstruction& instr) {
+  switch (instr.opcode()) {
+    case HloOpcode::kAllGatherStart:
+    case HloOpcode::kAsyncStart:
+    case HloOpcode::kCollectivePermuteStart:
+    case HloOpcode::kCopyStart:
+      return true;
+    default:
+      return ShouldScheduleAsEarlyAsPossible(instr);
+  }
+}
+
+bool IsAsyncDone(const HloInstruction& instr) {
+  switch (instr.opcode()) {
+    case HloOpcode::kAllGatherDone:
+    case HloOpcode::kAsyncDone:
+    case HloOpcode::kCollectivePermuteDone:
+    case HloOpcode::kCopyDone:
+      return true;
+    default:
+      return ShouldScheduleAsLateAsPossible(instr);
+  }
+}
+
+// Returns the bytes of the new buffers defined by `instr`, ignoring the
+// instructions that alias the buffers of their operands.
+int64_t DefinedBytes(const HloInstruction& instr, int64_t pointer_size) {
+  switch (instr.opcode()) {
+    case HloOpcode::kBitcast:
+    case HloOpcode::kGetTupleElement:
+    case HloOpcode::kTuple:
+      return 0;
+    default:
+      break;
+  }
+  if (IsAsyncDone(instr)) {
+    return 0;
+  }
+  int64_t bytes = 0;
+  ShapeUtil::ForEachSubshape(
+      instr.shape(), [&](const Shape& subshape, const ShapeIndex& /*index*/) {
+        if (subshape.IsArray()) {
+          bytes += ShapeUtil::ByteSizeOf(subshape, pointer_size);
+        }
+      });
+  return bytes;
+}
+
+// Reorders `input` with a list scheduler that simulates the execution time
+// given by `estimator`. Asynchronous starts and done events are scheduled as
+// soon as they are ready, asynchronous dones once the latency of their start
+// has elapsed, and the rest in the order of `input`. If no other instruction
+// is ready, the done that completes first is scheduled and waited for. While
+// the estimated live memory exceeds `memory_limit_bytes`, starts are no longer
+// hoisted and dones are scheduled first.
+HloInstructionSequence PostprocessorToHideLatency(
+    const HloInstructionSequence& input,
+    const GpuLatencyEstimator& estimator, int64_t pointer_size,
+    int64_t memory_limit_bytes) {
+  const std::vector<HloInstruction*>& instructions = input.instructions();
+  const int64_t num_instructions = instructions.size();
+  absl::flat_hash_map<const HloInstruction*, int64_t> positions;
+  for (int64_t i = 0; i < num_instructions; ++i) {
+    positions[instructions[i]] = i;
+  }
+
+  // The successors of every instruction, and the number of its predecessors
+  // and users not scheduled yet.
+  std::vector<std::vector<int64_t>> successors(num_instructions);
+  std::vector<int64_t> num_pending_predecessors(num_instructions, 0);
+  std::vector<int64_t> num_pending_users(num_instructions, 0);
+  for (int64_t i = 0; i < num_instructions; ++i) {
+    absl::flat_hash_set<int64_t> predecessors;
+    for (const HloInstruction* operand : instructions[i]->unique_operands()) {
+      auto it = positions.find(operand);
+      if (it != positions.end()) {
+        predecessors.insert(it->second);
+        ++num_pending_users[it->second];
+      }
+    }
+    for (const HloInstruction* predecessor :
+         instructions[i]->control_predecessors()) {
+      auto it = positions.find(predecessor);
+      if (it != positions.end()) {
+        predecessors.insert(it->second);
+      }
+    }
+    num_pending_predecessors[i] = predecessors.size();
+    for (int64_t predecessor : predecessors) {
+      successors[predecessor].push_back(i);
+    }
+  }
+
+  using IndexQueue = std::priority_queue<int64_t, std::vector<int64_t>,
+                                         std::greater<int64_t>>;
+  using TimedQueue =
+      std::priority_queue<std::pair<double, int64_t>,
+                          std::vector<std::pair<double, int64_t>>,
+                          std::greater<std::pair<double, int64_t>>>;
+  IndexQueue eager;
+  IndexQueue compute;
+  TimedQueue dones;
+  absl::flat_hash_map<const HloInstruction*, double> completion_times;
+  double now = 0;
+  int64_t live_bytes = 0;
+
+  auto add_ready = [&](int64_t i) {
+    const HloInstruction& instr = *instructions[i];
+    if (IsAsyncStart(instr) || instr.IsCustomCall(kBuiltinDoneEventTarget)) {
+      eager.push(i);
+    } else if (IsAsyncDone(instr)) {
+      double ready_time = now;
+      if (instr.operand_count() > 0) {
+        auto it = completion_times.find(instr.operand(0));
+        if (it != completion_times.end()) {
+          ready_time = it->second;
+        }
+      }
+      dones.push({ready_time, i});
+    } else {
+      compute.push(i);
+    }
+  };
+  for (int64_t i = 0; i < num_instructions; ++i) {
+    if (num_pending_predecessors[i] == 0) {
+      add_ready(i);
+    }
+  }
+
+  HloInstructionSequence result;
+  while (result.size() < num_instructions) {
+    const bool over_limit =
+        memory_limit_bytes > 0 && live_bytes > memory_limit_bytes;
+    int64_t next;
+    if (!eager.empty()) {
+      next = eager.top();
+      eager.pop();
+      if (over_limit && IsAsyncStart(*instructions[next])) {
+        compute.push(next);
+        continue;
+      }
+    } else if (!dones.empty() && (dones.top().first <= now || over_limit ||
+                                  compute.empty())) {
+      now = std::max(now, dones.top().first);
+      next = dones.top().second;
+      dones.pop();
+    } else {
+      CHECK(!compute.empty()) << "The sequence has a dependency cycle";
+      next = compute.top();
+      compute.pop();
+    }
+
+    HloInstruction* instr = instructions[next];
+    result.push_back(instr);
+    now += estimator.ComputeTime(*instr);
+    if (IsAsyncStart(*instr)) {
+      completion_times[instr] = now + estimator.AsyncLatency(*instr);
+    }
+    live_bytes += DefinedBytes(*instr, pointer_size);
+    for (const HloInstruction* operand : instr->unique_operands()) {
+      auto it = positions.find(operand);
+      if (it != positions.end() && --num_pending_users[it->second] == 0 &&
+          operand != operand->parent()->root_instruction()) {
+        live_bytes -= DefinedBytes(*operand, pointer_size);
+      }
+    }
+    for (int64_t successor : successors[next]) {
+      if (--num_pending_predecessors[successor] == 0) {
+        add_ready(successor);
+      }
+    }
+  }
+  return result;
+}
+
 }  // end namespace
 
-StatusOr<HloSchedule> ScheduleGpuModule(const HloModule* module,
-                                        int64_t pointer_size) {
+StatusOr<HloSchedule> ScheduleGpuModule(
+    const HloModule* module, int64_t pointer_size,
+    const GpuLatencyEstimator* latency_estimator,
+    int64_t memory_limit_bytes) {
+  MemorySchedulerPostprocessor postprocessor =
+      PostprocessorToScheduleAsEarlyOrLateAsPossible;
+  if (latency_estimator != nullptr) {
+    postprocessor = [=](const HloInstructionSequence& sequence) {
+      return PostprocessorToHideLatency(sequence, *latency_estimator,
+                                        pointer_size, memory_limit_bytes);
+    };
+  }
   return ScheduleModule(
       module,
       [pointer_size](const BufferValue& buffer) {
         return ShapeUtil::ByteSizeOf(buffer.shape(), pointer_size);
       },
-      ComputationSchedulerToModuleScheduler(
-          DefaultMemoryScheduler,
-          PostprocessorToScheduleAsEarlyOrLateAsPossible));
+      ComputationSchedulerToModuleScheduler(DefaultMemoryScheduler,
+                                            postprocessor));
 }
 
 }  // namespace gpu
@@ -25,9 +25,33 @@ limitations under the License.
 namespace xla {
 namespace gpu {
 
+// Estimates the times used by the latency-hiding scheduler.
+class GpuLatencyEstimator {
+ public:
+  virtual ~GpuLatencyEstimator() = default;
+
+  // Returns the time in seconds of running a synchronous instruction.
+  virtual double ComputeTime(const HloInstruction& instruction) const = 0;
+
+  // Returns the time in seconds from an asynchronous start, e.g.,
+  // all-reduce-start, until its operation completes.
+  virtual double AsyncLatency(const HloInstruction& start) const = 0;
+};
+
 // Determines the schedule of HLO instructions for a module run on the GPU.
-StatusOr<HloSchedule> ScheduleGpuModule(const HloModule* module,
-                                        int64_t pointer_size);
+//
+// If `latency_estimator` is given, the memory-minimizing sequence of every
+// computation is reordered by a list scheduler that simulates the execution
+// time: asynchronous starts and cross-mesh done events are scheduled as soon
+// as they are ready, and asynchronous dones are deferred until their latency
+// is covered by the compute scheduled after their start, as long as there is
+// other work to schedule. While the estimated live memory exceeds
+// `memory_limit_bytes` (if positive), no start is hoisted and the pending
+// dones are scheduled first, so that their users can free memory.
+StatusOr<HloSchedule> ScheduleGpuModule(
+    const HloModule* module, int64_t pointer_size,
+    const GpuLatencyEstimator* latency_estimator = nullptr,
+    int64_t memory_limit_bytes = -1);
 
 }  // namespace gpu
 }  // namespace xla
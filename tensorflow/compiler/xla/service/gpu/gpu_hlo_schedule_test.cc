@@ -17,11 +17,14 @@ limitations under the License.
 
 #include <algorithm>
 #include <memory>
+#include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_set.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/service/hlo_ordering.h"
 #include "tensorflow/compiler/xla/test_helpers.h"
 #include "tensorflow/compiler/xla/tests/hlo_test_base.h"
 #include "tensorflow/compiler/xla/tests/test_utils.h"
@@ -51,6 +54,43 @@ class GpuHloScheduleTest : public HloTestBase {
   }
 };
 
+// Takes a second for every add and no time for the other instructions, and
+// `latency` seconds for every asynchronous operation.
+class FakeLatencyEstimator : public GpuLatencyEstimator {
+ public:
+  explicit FakeLatencyEstimator(double latency) : latency_(latency) {}
+
+  double ComputeTime(const HloInstruction& instruction) const override {
+    return instruction.opcode() == HloOpcode::kAdd ? 1.0 : 0.0;
+  }
+  double AsyncLatency(const HloInstruction& start) const override {
+    return latency_;
+  }
+
+ private:
+  double latency_;
+};
+
+constexpr char kAsyncAllReduceHlo[] = R"(
+HloModule module
+
+add {
+  x = f32[] parameter(0)
+  y = f32[] parameter(1)
+  ROOT add = f32[] add(x, y)
+}
+
+ENTRY entry {
+  p0 = f32[2,2] parameter(0)
+  p1 = f32[2,2] parameter(1)
+  start = f32[2,2] all-reduce-start(p0), to_apply=add
+  done = f32[2,2] all-reduce-done(start)
+  add1 = f32[2,2] add(p0, p1)
+  add2 = f32[2,2] add(add1, add1)
+  add3 = f32[2,2] add(add2, add2)
+  ROOT add4 = f32[2,2] add(add3, done)
+})";
+
 // Test of a single stream, where data dependencies fully determine the
 // execution order.
 TEST_F(GpuHloScheduleTest, SequentialMatMul) {
@@ -235,5 +275,45 @@ TEST_F(GpuHloScheduleTest, AsyncAllReduce) {
   EXPECT_TRUE(order.ExecutesBefore(all_reduce_done, add4));
 }
 
+TEST_F(GpuHloScheduleTest, LatencyHidingDefersDoneUntilCovered) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kAsyncAllReduceHlo));
+  FakeLatencyEstimator estimator(/*latency=*/2.0);
+  TF_ASSERT_OK_AND_ASSIGN(
+      HloSchedule schedule,
+      ScheduleGpuModule(module.get(), /*pointer_size=*/8, &estimator));
+  SequentialHloOrdering order(schedule);
+  HloComputation* entry = module->entry_computation();
+
+  // The start is issued before any compute, and the done waits for the two
+  // adds covering its latency, but not for the add that does not need it.
+  EXPECT_TRUE(order.ExecutesBefore(entry->GetInstructionWithName("start"),
+                                   entry->GetInstructionWithName("add1")));
+  EXPECT_TRUE(order.ExecutesBefore(entry->GetInstructionWithName("add2"),
+                                   entry->GetInstructionWithName("done")));
+  EXPECT_TRUE(order.ExecutesBefore(entry->GetInstructionWithName("done"),
+                                   entry->GetInstructionWithName("add3")));
+}
+
+TEST_F(GpuHloScheduleTest, LatencyHidingOverMemoryLimit) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kAsyncAllReduceHlo));
+  FakeLatencyEstimator estimator(/*latency=*/2.0);
+  TF_ASSERT_OK_AND_ASSIGN(
+      HloSchedule schedule,
+      ScheduleGpuModule(module.get(), /*pointer_size=*/8, &estimator,
+                        /*memory_limit_bytes=*/1));
+
+  // Over the memory limit, the done is waited for right after its start.
+  const std::vector<HloInstruction*>& sequence =
+      schedule.sequence(module->entry_computation()).instructions();
+  auto start = absl::c_find_if(sequence, [](const HloInstruction* instr) {
+    return instr->opcode() == HloOpcode::kAllReduceStart;
+  });
+  ASSERT_NE(start, sequence.end());
+  ASSERT_NE(start + 1, sequence.end());
+  EXPECT_EQ((*(start + 1))->opcode(), HloOpcode::kAllReduceDone);
+}
+
 }  // namespace gpu
 }  // namespace xla
@@ -16,7 +16,9 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/gpu/gpu_layout_assignment.h"
 
 #include <memory>
+#include <optional>
 #include <utility>
+#include <vector>
 
 #include "absl/algorithm/container.h"
 #include "absl/types/span.h"
@@ -29,6 +31,8 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_instructions.h"
+#include "tensorflow/compiler/xla/permutation_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/compiler/xla/window_util.h"
 #include "tensorflow/compiler/xla/xla_data.pb.h"
@@ -300,6 +304,12 @@ Status GpuLayoutAssignment::AddBackendConstraints(
         TF_RETURN_IF_ERROR(SetOperandBatchRowsColsLayout(
             instruction, 1, rhs_batch_dims, rhs_col_dims, rhs_row_dims));
         TF_RETURN_IF_ERROR(SetDotLayout(instruction, constraints));
+      } else if (cost_based_dot_layouts_) {
+        TF_RETURN_IF_ERROR(SetCostBasedDotOperandLayout(
+            instruction, 0, lhs_batch_dims, lhs_row_dims, lhs_col_dims));
+        TF_RETURN_IF_ERROR(SetCostBasedDotOperandLayout(
+            instruction, 1, rhs_batch_dims, rhs_row_dims, rhs_col_dims));
+        TF_RETURN_IF_ERROR(SetDotLayout(instruction, constraints));
       } else if (!lhs_batch_dims.empty()) {
         TF_RETURN_IF_ERROR(SetDotOperandLayout(instruction, 0, lhs_batch_dims,
                                                lhs_row_dims, lhs_col_dims));
@@ -393,6 +403,16 @@ Status GpuLayoutAssignment::AddBackendConstraints(
           ShapeUtil::MoveDimToMajor(all_to_all->shape(),
                                     *all_to_all->split_dimension()),
           all_to_all));
+    } else if (instruction->IsCustomCall(kBuiltinRaggedAllToAllTarget)) {
+      // Rows are sent as contiguous chunks, so they must be the most major
+      // dimension of the data and of the output.
+      for (int64_t i = 0; i < instruction->operand_count(); ++i) {
+        TF_RETURN_IF_ERROR(SetOperandLayout(
+            LayoutUtil::GetWithDefaultLayout(instruction->operand(i)->shape()),
+            instruction, i));
+      }
+      TF_RETURN_IF_ERROR(SetInstructionLayout(
+          LayoutUtil::GetWithDefaultLayout(instruction->shape()), instruction));
     }
   }
   return OkStatus();
@@ -420,6 +440,119 @@ Status GpuLayoutAssignment::SetDotOperandLayout(
                                        row_dims, col_dims);
 }
 
+std::optional<Layout> GpuLayoutAssignment::KnownLayout(
+    const HloInstruction* instruction) {
+  if (!instruction->shape().IsArray()) {
+    return std::nullopt;
+  }
+  if (instruction->shape().has_layout()) {
+    return instruction->shape().layout();
+  }
+  // Entry parameters and other mandatory layouts.
+  auto buffer = points_to_analysis_->GetBufferDefinedAt(instruction, {});
+  if (buffer.ok()) {
+    if (const BufferLayoutConstraint* constraint =
+            GetBufferLayoutConstraint(**buffer)) {
+      return constraint->layout();
+    }
+  }
+  switch (instruction->opcode()) {
+    // The collectives that XLA:GPU requires in a fixed layout, see
+    // AddBackendConstraints.
+    case HloOpcode::kAllGather:
+      return ShapeUtil::MoveDimToMajor(
+                 instruction->shape(),
+                 Cast<HloAllGatherInstruction>(instruction)
+                     ->all_gather_dimension())
+          .layout();
+    case HloOpcode::kReduceScatter:
+      return ShapeUtil::MoveDimToMajor(
+                 instruction->shape(),
+                 Cast<HloReduceScatterInstruction>(instruction)
+                     ->scatter_dimension())
+          .layout();
+    // A copy or transpose of a value with a known layout is free in the layout
+    // that makes it a bitcast.
+    case HloOpcode::kCopy:
+      return KnownLayout(instruction->operand(0));
+    case HloOpcode::kTranspose: {
+      std::optional<Layout> operand_layout =
+          KnownLayout(instruction->operand(0));
+      if (!operand_layout.has_value()) {
+        return std::nullopt;
+      }
+      std::vector<int64_t> inverse_permutation =
+          InversePermutation(instruction->dimensions());
+      std::vector<int64_t> minor_to_major;
+      for (int64_t dim : operand_layout->minor_to_major()) {
+        minor_to_major.push_back(inverse_permutation[dim]);
+      }
+      return LayoutUtil::MakeLayout(minor_to_major);
+    }
+    default:
+      return std::nullopt;
+  }
+}
+
+Status GpuLayoutAssignment::SetCostBasedDotOperandLayout(
+    const HloInstruction* instruction, int64_t operand,
+    absl::Span<const int64_t> batch_dims, absl::Span<const int64_t> row_dims,
+    absl::Span<const int64_t> col_dims) {
+  Shape shape = instruction->operand(operand)->shape();
+  const std::optional<Layout> known_layout =
+      KnownLayout(instruction->operand(operand));
+
+  auto batch_major_layout = [&](absl::Span<const int64_t> major_dims,
+                                absl::Span<const int64_t> minor_dims) {
+    std::vector<int64_t> dims(batch_dims.begin(), batch_dims.end());
+    dims.insert(dims.end(), major_dims.begin(), major_dims.end());
+    dims.insert(dims.end(), minor_dims.begin(), minor_dims.end());
+    return LayoutUtil::MakeLayoutFromMajorToMinor(dims);
+  };
+  std::vector<Layout> candidates;
+  if (known_layout.has_value()) {
+    candidates.push_back(*known_layout);
+  }
+  candidates.push_back(LayoutUtil::GetDefaultLayoutForShape(shape));
+  candidates.push_back(batch_major_layout(row_dims, col_dims));
+  candidates.push_back(batch_major_layout(col_dims, row_dims));
+
+  // A layout other than the known one costs a copy, which reads and writes the
+  // operand. A leading dimension that is not a multiple of 8 keeps 16-bit
+  // float GEMMs off tensor cores, or makes cublas_pad_for_gemms pad them.
+  const int64_t bytes = ShapeUtil::ByteSizeOfElements(shape);
+  const bool tensor_core_type =
+      shape.element_type() == F16 || shape.element_type() == BF16;
+  std::optional<Shape> best_shape;
+  int64_t best_cost = 0;
+  for (const Layout& layout : candidates) {
+    *shape.mutable_layout() = layout;
+    if (!MatrixLayout::For(shape, batch_dims, row_dims, col_dims).ok()) {
+      continue;
+    }
+    int64_t cost = 0;
+    if (known_layout.has_value() &&
+        !absl::c_equal(layout.minor_to_major(),
+                       known_layout->minor_to_major())) {
+      cost += 2 * bytes;
+    }
+    if (tensor_core_type && shape.rank() > 0 &&
+        shape.dimensions(layout.minor_to_major(0)) % 8 != 0) {
+      cost += bytes;
+    }
+    if (!best_shape.has_value() || cost < best_cost) {
+      best_shape = shape;
+      best_cost = cost;
+    }
+  }
+  TF_RET_CHECK(best_shape.has_value())
+      << "No supported operand layout for " << instruction->ToString();
+  VLOG(2) << "Operand " << operand << " of " << instruction->name()
+          << " assigned " << best_shape->ToString(/*print_layout=*/true)
+          << " with estimated cost " << best_cost;
+  return SetOperandLayout(*best_shape, instruction, operand);
+}
+
 Status GpuLayoutAssignment::SetOperandBatchRowsColsLayout(
     const HloInstruction* instruction, int64_t operand,
     absl::Span<const int64_t> batch_dims, absl::Span<const int64_t> row_dims,
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_LAYOUT_ASSIGNMENT_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_LAYOUT_ASSIGNMENT_H_
 
+#include <optional>
+
 #include "tensorflow/compiler/xla/service/computation_layout.h"
 #include "tensorflow/compiler/xla/service/hlo_instructions.h"
 #include "tensorflow/compiler/xla/service/layout_assignment.h"
@@ -27,14 +29,21 @@ namespace gpu {
 
 // GPU-specific layout assignment pass which preassigns layouts to satisfy
 // layout constraints for operands and results of library calls.
+//
+// If `cost_based_dot_layouts` is set, the operand layouts of all dots, not only
+// batched ones, are picked by the estimated bytes of the copies and transposes
+// they cause, with a penalty for 16-bit float matrices whose leading dimension
+// is not a multiple of 8 and so cannot use tensor cores.
 class GpuLayoutAssignment : public LayoutAssignment {
  public:
   explicit GpuLayoutAssignment(
       ComputationLayout* entry_computation_layout,
       se::StreamExecutor* stream_executor,
-      ChannelLayoutConstraints* channel_constraints = nullptr)
+      ChannelLayoutConstraints* channel_constraints = nullptr,
+      bool cost_based_dot_layouts = false)
       : LayoutAssignment(entry_computation_layout, channel_constraints),
-        stream_executor_(stream_executor) {}
+        stream_executor_(stream_executor),
+        cost_based_dot_layouts_(cost_based_dot_layouts) {}
   ~GpuLayoutAssignment() override {}
 
  protected:
@@ -55,10 +64,21 @@ class GpuLayoutAssignment : public LayoutAssignment {
                              absl::Span<const int64_t> row_dims,
                              absl::Span<const int64_t> col_dims);
 
+  // Returns the layout `instruction` is known to be produced in, before the
+  // layouts of the computation are propagated.
+  std::optional<Layout> KnownLayout(const HloInstruction* instruction);
+
+  Status SetCostBasedDotOperandLayout(const HloInstruction* instruction,
+                                      int64_t operand,
+                                      absl::Span<const int64_t> batch_dims,
+                                      absl::Span<const int64_t> row_dims,
+                                      absl::Span<const int64_t> col_dims);
+
   Status SetDotLayout(const HloInstruction* instruction,
                       LayoutConstraints* constraints);
 
   se::StreamExecutor* stream_executor_;
+  bool cost_based_dot_layouts_;
 };
 
 }  // namespace gpu
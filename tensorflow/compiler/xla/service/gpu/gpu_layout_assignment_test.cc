@@ -227,6 +227,64 @@ TEST_F(LayoutAssignmentTest, TransposedDotLayout) {
                     op::ShapeWithLayout("f32[2,5,4]{2,1,0}")));
 }
 
+TEST_F(LayoutAssignmentTest, CostBasedDotOperandLayoutMakesTransposeBitcast) {
+  const char* hlo_text = R"(
+  HloModule DotLayout
+  ENTRY dot {
+    p0 = f32[5,3,2]{2,1,0} parameter(0)
+    p1 = f32[5,3,4]{2,1,0} parameter(1)
+    transpose = f32[5,2,3] transpose(p0), dimensions={0,2,1}
+    ROOT dot = f32[5,2,4]{2,1,0} dot(transpose, p1),
+      lhs_batch_dims={0}, lhs_contracting_dims={2},
+      rhs_batch_dims={0}, rhs_contracting_dims={1}
+  })";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_text));
+
+  ComputationLayout computation_layout(
+      module->entry_computation()->ComputeProgramShape(),
+      /*ignore_layouts=*/false);
+  GpuLayoutAssignment layout_assignment(
+      &computation_layout, backend().default_stream_executor(),
+      /*channel_constraints=*/nullptr, /*cost_based_dot_layouts=*/true);
+  EXPECT_THAT(layout_assignment.Run(module.get()), IsOkAndHolds(true));
+  // The lhs takes the layout in which the transpose is a bitcast, instead of
+  // the default layout.
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              op::Dot(AllOf(op::Transpose(op::Parameter(0)),
+                            op::ShapeWithLayout("f32[5,2,3]{1,2,0}")),
+                      op::ShapeWithLayout("f32[5,3,4]{2,1,0}")));
+}
+
+TEST_F(LayoutAssignmentTest, CostBasedDotOperandLayoutAlignsLeadingDim) {
+  const char* hlo_text = R"(
+  HloModule DotLayout
+  ENTRY dot {
+    p0 = bf16[64,12]{1,0} parameter(0)
+    p1 = bf16[12,32]{1,0} parameter(1)
+    negate = bf16[64,12] negate(p0)
+    ROOT dot = bf16[64,32]{1,0} dot(negate, p1),
+      lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  })";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_text));
+
+  ComputationLayout computation_layout(
+      module->entry_computation()->ComputeProgramShape(),
+      /*ignore_layouts=*/false);
+  GpuLayoutAssignment layout_assignment(
+      &computation_layout, backend().default_stream_executor(),
+      /*channel_constraints=*/nullptr, /*cost_based_dot_layouts=*/true);
+  EXPECT_THAT(layout_assignment.Run(module.get()), IsOkAndHolds(true));
+  // The lhs, whose layout is free, gets the layout with the leading dimension
+  // of 64 elements. The rhs keeps the layout of its parameter.
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              op::Dot(op::ShapeWithLayout("bf16[64,12]{0,1}"),
+                      op::ShapeWithLayout("bf16[12,32]{1,0}")));
+}
+
 TEST_F(LayoutAssignmentTest, DotLayoutS8) {
   const char* hlo_text = R"(
   HloModule DotLayout
@@ -347,6 +405,32 @@ ENTRY entry {
   expect_layout(call_0->operand(1)->shape(), {1, 2, 0});
 }
 
+TEST_F(LayoutAssignmentTest, RaggedAllToAllRowsMajor) {
+  const char* module_str = R"(
+HloModule TestModule
+
+ENTRY entry {
+  data = f32[16,8]{0,1} parameter(0)
+  send_counts = s32[4]{0} parameter(1)
+  ragged = (f32[16,8], s32[4]) custom-call(data, send_counts), custom_call_target="__builtin$RaggedAllToAll", backend_config="1;{{0,1,2,3}}"
+  ROOT output = f32[16,8] get-tuple-element(ragged), index=0
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(module_str));
+  ComputationLayout computation_layout(
+      m->entry_computation()->ComputeProgramShape(),
+      /*ignore_layouts=*/false);
+  GpuLayoutAssignment layout_assignment(&computation_layout,
+                                        backend().default_stream_executor());
+
+  EXPECT_THAT(layout_assignment.Run(m.get()), IsOkAndHolds(true));
+  const HloInstruction* ragged = FindInstruction(m.get(), "ragged");
+  EXPECT_THAT(ragged->operand(0), op::ShapeWithLayout("f32[16,8]{1,0}"));
+  EXPECT_TRUE(LayoutUtil::Equal(ragged->shape().tuple_shapes(0).layout(),
+                                LayoutUtil::MakeLayout({1, 0})));
+}
+
 }  // namespace
 }  // namespace gpu
 }  // namespace xla
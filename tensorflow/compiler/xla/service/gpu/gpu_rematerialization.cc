@@ -0,0 +1,125 @@
+#include "tensorflow/compiler/xla/service/gpu/gpu_rematerialization.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_constants.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_hlo_schedule.h"
+#include "tensorflow/compiler/xla/service/hlo_alias_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_live_range.h"
+#include "tensorflow/compiler/xla/service/hlo_rematerialization.h"
+#include "tensorflow/tsl/platform/logging.h"
+#include "tensorflow/tsl/platform/numbers.h"
+#include "tensorflow/tsl/platform/statusor.h"
+
+namespace xla {
+namespace gpu {
+
+StatusOr<int64_t> ComputePeakMemoryFromLiveRange(
+    const HloModule* module,
+    const HloCostAnalysis::ShapeSizeFunction& size_fn) {
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<HloAliasAnalysis> alias_analysis,
+                      HloAliasAnalysis::Run(module));
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<HloLiveRange> live_range,
+      HloLiveRange::Run(module->schedule(), *alias_analysis,
+                        module->entry_computation()));
+
+  // The memory allocated (positive) or freed (negative) at every time.
+  std::vector<std::pair<int64_t, int64_t>> events;
+  for (const HloBuffer& buffer : alias_analysis->buffers()) {
+    int64_t start = -1, end = -1, size = 0;
+    for (const HloValue* value : buffer.values()) {
+      auto it = live_range->buffer_live_ranges().find(value);
+      if (it == live_range->buffer_live_ranges().end()) {
+        continue;
+      }
+      start = start < 0 ? it->second.start
+                        : std::min(start, it->second.start);
+      end = std::max(end, it->second.end);
+      size = std::max(size, size_fn(value->shape()));
+    }
+    if (start < 0 || size == 0) {
+      continue;
+    }
+    events.push_back({start, size});
+    events.push_back({end + 1, -size});
+  }
+  // Frees come before allocations at the same time.
+  absl::c_sort(events);
+
+  int64_t memory = 0, peak = 0;
+  for (const auto& [time, delta] : events) {
+    memory += delta;
+    peak = std::max(peak, memory);
+  }
+  return peak;
+}
+
+StatusOr<bool> GpuRematerialization::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  if (memory_limit_bytes_ <= 0) {
+    return false;
+  }
+
+  TF_ASSIGN_OR_RETURN(HloSchedule schedule,
+                      ScheduleGpuModule(module, pointer_size_));
+  TF_RETURN_IF_ERROR(module->set_schedule(std::move(schedule)));
+
+  // The recompute cost of an instruction is its time relative to the average
+  // instruction of the entry computation. Instructions of nested computations
+  // are not analyzed and are free to recompute.
+  GpuHloCostAnalysis cost_analysis(cost_options_);
+  const HloComputation* entry = module->entry_computation();
+  TF_RETURN_IF_ERROR(entry->Accept(&cost_analysis));
+  double average_seconds = cost_analysis.optimal_seconds() /
+                           std::max<int64_t>(entry->instruction_count(), 1);
+  HloRematerialization::RecomputeCostFunction recompute_cost_fn = nullptr;
+  if (average_seconds > 0) {
+    recompute_cost_fn = [&](const HloInstruction& instruction) {
+      return cost_analysis.optimal_seconds(instruction) / average_seconds;
+    };
+  }
+
+  // Values offloaded by HostOffload do not take device memory.
+  HloRematerialization::ShapeSizeFunction device_size =
+      [&](const Shape& shape) -> int64_t {
+    if (shape.IsArray() && shape.has_layout() &&
+        shape.layout().memory_space() == kHostMemorySpaceColor) {
+      return 0;
+    }
+    return cost_options_.shape_size(shape);
+  };
+
+  HloRematerialization::RematerializationSizes sizes;
+  HloRematerialization remat(
+      device_size, memory_limit_bytes_, &sizes,
+      HloRematerialization::RematerializationPass::kPostFusion,
+      block_size_limit_, /*block_rematerialization_factor=*/1,
+      /*compact_shape_function=*/nullptr,
+      HloRematerialization::RematerializationMode::kRecomputeOnly,
+      /*min_remat_size=*/0, std::move(recompute_cost_fn));
+  TF_ASSIGN_OR_RETURN(bool changed, remat.Run(module, execution_threads));
+
+  TF_ASSIGN_OR_RETURN(
+      int64_t peak_bytes,
+      ComputePeakMemoryFromLiveRange(module, device_size));
+  LOG(INFO) << "Peak memory of " << module->name() << " after "
+            << "rematerialization: "
+            << tsl::strings::HumanReadableNumBytes(peak_bytes) << " (was "
+            << tsl::strings::HumanReadableNumBytes(sizes.before_bytes)
+            << ", budget "
+            << tsl::strings::HumanReadableNumBytes(memory_limit_bytes_)
+            << ")";
+
+  module->clear_schedule();
+  return changed;
+}
+
+}  // namespace gpu
+}  // namespace xla
@@ -0,0 +1,55 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_REMATERIALIZATION_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_REMATERIALIZATION_H_
+
+#include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace xla {
+namespace gpu {
+
+// Rematerializes instructions of a partitioned module until the peak memory
+// of one device fits in `memory_limit_bytes`, so that stage modules slightly
+// over the HBM limit trade compute for memory instead of running out of
+// memory at runtime. The module is scheduled with ScheduleGpuModule and the
+// recomputes are picked by HloRematerialization, with the recompute cost of
+// an entry instruction given by its GpuHloCostAnalysis time relative to the
+// average instruction. The achieved peak is computed with HloLiveRange and
+// logged.
+//
+// The schedule is only used to pick the recomputes and is cleared afterwards,
+// because the backend reschedules the module before buffer assignment.
+class GpuRematerialization : public HloModulePass {
+ public:
+  GpuRematerialization(int64_t memory_limit_bytes,
+                       const HloCostAnalysis::Options& cost_options,
+                       int64_t pointer_size, int block_size_limit = 1)
+      : memory_limit_bytes_(memory_limit_bytes),
+        cost_options_(cost_options),
+        pointer_size_(pointer_size),
+        block_size_limit_(block_size_limit) {}
+
+  absl::string_view name() const override { return "gpu-rematerialization"; }
+
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+
+ private:
+  int64_t memory_limit_bytes_;
+  HloCostAnalysis::Options cost_options_;
+  int64_t pointer_size_;
+  int block_size_limit_;
+};
+
+// Returns the peak memory of the scheduled `module` computed from the live
+// ranges of its buffers.
+StatusOr<int64_t> ComputePeakMemoryFromLiveRange(
+    const HloModule* module, const HloCostAnalysis::ShapeSizeFunction& size_fn);
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_REMATERIALIZATION_H_
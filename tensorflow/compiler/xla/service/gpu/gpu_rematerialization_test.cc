@@ -0,0 +1,81 @@
+#include "tensorflow/compiler/xla/service/gpu/gpu_rematerialization.h"
+
+#include <memory>
+#include <utility>
+
+#include "tensorflow/compiler/xla/service/gpu/gpu_hlo_schedule.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/tsl/platform/status_matchers.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+using ::tsl::testing::IsOkAndHolds;
+
+constexpr int64_t kPointerSize = 8;
+
+// `bcast` is live until `concat_2`, so the peak at `concat_1` holds `bcast`,
+// `negate` and `concat_1`: 16KiB plus the parameter.
+constexpr absl::string_view kHloString = R"(
+HloModule module
+
+ENTRY %entry {
+  param = f32[] parameter(0)
+  bcast = f32[1024]{0} broadcast(param), dimensions={}
+  negate = f32[1024]{0} negate(bcast)
+  concat_1 = f32[2048]{0} concatenate(negate, negate), dimensions={0}
+  slice_1 = f32[1]{0} slice(concat_1), slice={[0:1]}
+  concat_2 = f32[1025]{0} concatenate(bcast, slice_1), dimensions={0}
+  ROOT slice_2 = f32[1]{0} slice(concat_2), slice={[0:1]}
+})";
+
+int64_t ShapeSize(const Shape& shape) {
+  return ShapeUtil::ByteSizeOf(shape, kPointerSize);
+}
+
+class GpuRematerializationTest : public HloTestBase {};
+
+TEST_F(GpuRematerializationTest, PeakMemoryFromLiveRange) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  TF_ASSERT_OK_AND_ASSIGN(HloSchedule schedule,
+                          ScheduleGpuModule(module.get(), kPointerSize));
+  TF_ASSERT_OK(module->set_schedule(std::move(schedule)));
+
+  EXPECT_THAT(ComputePeakMemoryFromLiveRange(module.get(), ShapeSize),
+              IsOkAndHolds(16 * 1024 + 4));
+}
+
+TEST_F(GpuRematerializationTest, RecomputeToFitBudget) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHloString));
+
+  GpuRematerialization pass(/*memory_limit_bytes=*/14 * 1024,
+                            HloCostAnalysis::Options{ShapeSize}, kPointerSize);
+  EXPECT_THAT(pass.Run(module.get()), IsOkAndHolds(true));
+  EXPECT_FALSE(module->has_schedule());
+
+  // `concat_2` uses a recomputed broadcast instead of the original one.
+  const HloInstruction* concat_2 =
+      module->entry_computation()->root_instruction()->operand(0);
+  const HloInstruction* negate = concat_2->operand(1)->operand(0)->operand(0);
+  EXPECT_EQ(concat_2->operand(0)->opcode(), HloOpcode::kBroadcast);
+  EXPECT_NE(concat_2->operand(0), negate->operand(0));
+}
+
+TEST_F(GpuRematerializationTest, NoBudget) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHloString));
+
+  GpuRematerialization pass(/*memory_limit_bytes=*/-1,
+                            HloCostAnalysis::Options{ShapeSize}, kPointerSize);
+  EXPECT_THAT(pass.Run(module.get()), IsOkAndHolds(false));
+}
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
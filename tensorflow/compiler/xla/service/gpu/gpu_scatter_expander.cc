@@ -16,8 +16,10 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/gpu/gpu_scatter_expander.h"
 
 #include "absl/algorithm/container.h"
+#include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_instructions.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/statusor.h"
 
@@ -29,7 +31,9 @@ bool GpuScatterExpander::InstructionMatchesPattern(HloInstruction* inst) {
   // TODO(b/227486631): Variadic scatter is not yet supported by GPU.
   return inst->opcode() == HloOpcode::kScatter &&
          (inst->shape().IsTuple() ||
-          primitive_util::BitWidth(inst->shape().element_type()) > 64);
+          primitive_util::BitWidth(inst->shape().element_type()) > 64 ||
+          (deterministic_ &&
+           !Cast<HloScatterInstruction>(inst)->unique_indices()));
 }
 
 }  // namespace xla
@@ -25,12 +25,18 @@ class GpuScatterExpander : public ScatterExpander {
  public:
   // Although we pass kEliminateAllScatters, we override this behavior in
   // InstruuctionMatchesPattern and select only some scatters to expand.
-  GpuScatterExpander() : ScatterExpander(kEliminateAllScatters) {}
+  // If `deterministic` is set, all scatters that may have duplicate indices
+  // are expanded too, as they are emitted with atomics.
+  explicit GpuScatterExpander(bool deterministic = false)
+      : ScatterExpander(kEliminateAllScatters), deterministic_(deterministic) {}
 
   absl::string_view name() const override { return "gpu_scatter_expander"; }
 
  protected:
   bool InstructionMatchesPattern(HloInstruction* inst) override;
+
+ private:
+  bool deterministic_;
 };
 
 }  // namespace xla
@@ -0,0 +1,168 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/gpu/gpu_sort_rewriter.h"
+
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "tensorflow/compiler/xla/comparison_util.h"
+#include "tensorflow/compiler/xla/layout_util.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/service/gpu/cub_sort_custom_call.h"
+#include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+// Returns whether the comparator of the sort orders the keys in descending
+// order, or nullopt if it is not a LT or GT comparison of the keys that
+// matches the order of the radix sort.
+std::optional<bool> IsDescendingSort(const HloSortInstruction* sort) {
+  const auto* compare =
+      DynCast<HloCompareInstruction>(sort->to_apply()->root_instruction());
+  if (compare == nullptr ||
+      compare->operand(0)->opcode() != HloOpcode::kParameter ||
+      compare->operand(1)->opcode() != HloOpcode::kParameter) {
+    return std::nullopt;
+  }
+
+  // The comparator must only compare the keys, which are parameters 0 and 1.
+  int64_t lhs = compare->operand(0)->parameter_number();
+  int64_t rhs = compare->operand(1)->parameter_number();
+  bool swapped;
+  if (lhs == 0 && rhs == 1) {
+    swapped = false;
+  } else if (lhs == 1 && rhs == 0) {
+    swapped = true;
+  } else {
+    return std::nullopt;
+  }
+
+  // The radix sort orders floating point keys by their total order, e.g. NaNs
+  // are ordered after infinities.
+  PrimitiveType key_type = sort->operand(0)->shape().element_type();
+  if (primitive_util::IsFloatingPointType(key_type) &&
+      compare->type() != Comparison::Type::kFloatTotalOrder) {
+    return std::nullopt;
+  }
+
+  switch (compare->direction()) {
+    case ComparisonDirection::kLt:
+      return swapped;
+    case ComparisonDirection::kGt:
+      return !swapped;
+    default:
+      return std::nullopt;
+  }
+}
+
+}  // namespace
+
+StatusOr<bool> GpuSortRewriter::RewriteSort(HloSortInstruction* sort) {
+  if (sort->operand_count() > 2) {
+    return false;
+  }
+
+  const Shape& keys_shape = sort->operand(0)->shape();
+  if (keys_shape.rank() > 2 ||
+      sort->sort_dimension() != keys_shape.rank() - 1 ||
+      !IsCubSortKeyType(keys_shape.element_type())) {
+    return false;
+  }
+
+  bool has_values = sort->operand_count() == 2;
+  if (has_values &&
+      primitive_util::ByteWidth(sort->operand(1)->shape().element_type()) !=
+          4) {
+    return false;
+  }
+
+  int64_t segment_size = keys_shape.dimensions(sort->sort_dimension());
+  int64_t num_items = ShapeUtil::ElementsIn(keys_shape);
+  if (segment_size < min_sort_size_ ||
+      num_items > std::numeric_limits<int>::max()) {
+    return false;
+  }
+
+  std::optional<bool> descending = IsDescendingSort(sort);
+  if (!descending.has_value()) {
+    return false;
+  }
+
+  CubSortDescriptor descriptor{keys_shape.element_type(), *descending,
+                               has_values, num_items, segment_size};
+  StatusOr<int64_t> scratch_size = GetCubSortScratchSize(descriptor);
+  if (!scratch_size.ok()) {
+    VLOG(2) << "Not rewriting " << sort->name()
+            << " to a CUB sort: " << scratch_size.status();
+    return false;
+  }
+
+  // The CUB sort reads and writes row-major arrays.
+  std::vector<Shape> operand_shapes;
+  for (const HloInstruction* operand : sort->operands()) {
+    operand_shapes.push_back(
+        LayoutUtil::GetWithDefaultLayout(operand->shape()));
+  }
+  std::vector<Shape> result_shapes = operand_shapes;
+  result_shapes.push_back(
+      ShapeUtil::MakeShapeWithDescendingLayout(U8, {*scratch_size}));
+
+  HloComputation* computation = sort->parent();
+  HloInstruction* custom_call =
+      computation->AddInstruction(HloInstruction::CreateCustomCall(
+          ShapeUtil::MakeTupleShape(result_shapes), sort->operands(),
+          kCubSortCustomCallTarget, operand_shapes, descriptor.ToOpaque(),
+          API_VERSION_STATUS_RETURNING));
+  custom_call->set_metadata(sort->metadata());
+
+  HloInstruction* keys = computation->AddInstruction(
+      HloInstruction::CreateGetTupleElement(custom_call, 0));
+  HloInstruction* replacement = keys;
+  if (has_values) {
+    HloInstruction* values = computation->AddInstruction(
+        HloInstruction::CreateGetTupleElement(custom_call, 1));
+    replacement = computation->AddInstruction(
+        HloInstruction::CreateTuple({keys, values}));
+  }
+  TF_RETURN_IF_ERROR(computation->ReplaceInstruction(sort, replacement));
+  return true;
+}
+
+StatusOr<bool> GpuSortRewriter::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  bool changed = false;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    for (HloInstruction* instruction :
+         computation->MakeInstructionPostOrder()) {
+      if (auto* sort = DynCast<HloSortInstruction>(instruction)) {
+        TF_ASSIGN_OR_RETURN(bool rewritten, RewriteSort(sort));
+        changed |= rewritten;
+      }
+    }
+  }
+  return changed;
+}
+
+}  // namespace gpu
+}  // namespace xla
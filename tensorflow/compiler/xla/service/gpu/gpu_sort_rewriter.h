@@ -0,0 +1,63 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_SORT_REWRITER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_SORT_REWRITER_H_
+
+#include <cstdint>
+
+#include "tensorflow/compiler/xla/service/hlo_instructions.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace xla {
+namespace gpu {
+
+// Rewrites large sorts into a custom call to the CUB radix sort, which is much
+// faster than the bitonic sort emitted for kSort. This also covers top-k over
+// large inputs (e.g. vocabulary-sized beam search), which is a sort followed
+// by slices on GPU.
+//
+// A sort is rewritten if it has at least `min_sort_size` keys along the sort
+// dimension and:
+// * it sorts the keys with an optional second operand of 32-bit values;
+// * the sort dimension is the minor-most dimension of a rank 1 or 2 array;
+// * the comparator compares the keys with LT or GT, using the total order for
+//   floating point keys.
+class GpuSortRewriter : public HloModulePass {
+ public:
+  static constexpr int64_t kDefaultMinSortSize = 32768;
+
+  explicit GpuSortRewriter(int64_t min_sort_size = kDefaultMinSortSize)
+      : min_sort_size_(min_sort_size) {}
+
+  absl::string_view name() const override { return "gpu-sort-rewriter"; }
+
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+
+ private:
+  StatusOr<bool> RewriteSort(HloSortInstruction* sort);
+
+  int64_t min_sort_size_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_GPU_SORT_REWRITER_H_
@@ -0,0 +1,174 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/gpu/gpu_sort_rewriter.h"
+
+#include "tensorflow/compiler/xla/service/gpu/cub_sort_custom_call.h"
+#include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_instructions.h"
+#include "tensorflow/compiler/xla/service/hlo_matchers.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/tsl/lib/core/status_test_util.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+namespace op = xla::testing::opcode_matchers;
+
+class GpuSortRewriterTest : public HloTestBase {
+ protected:
+  void SetUp() override {
+    HloTestBase::SetUp();
+    // The rewrite needs the CUB scratch size, which requires CUDA.
+    if (!GetCubSortScratchSize({F32, false, false, 1024, 1024}).ok()) {
+      GTEST_SKIP() << "XLA is built without CUDA";
+    }
+  }
+
+  bool RunRewrite(HloModule* module) {
+    StatusOr<bool> changed =
+        GpuSortRewriter(/*min_sort_size=*/1024).Run(module);
+    TF_EXPECT_OK(changed.status());
+    return changed.value_or(false);
+  }
+};
+
+TEST_F(GpuSortRewriterTest, RewriteKeysSort) {
+  constexpr char kHlo[] = R"(
+HloModule TestModule
+
+%compare {
+  %lhs = f32[] parameter(0)
+  %rhs = f32[] parameter(1)
+  ROOT %lt = pred[] compare(%lhs, %rhs), direction=LT, type=TOTALORDER
+}
+
+ENTRY %main {
+  %input = f32[4,1024] parameter(0)
+  ROOT %sort = f32[4,1024] sort(%input), dimensions={1}, to_apply=%compare
+})";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(kHlo));
+  EXPECT_TRUE(RunRewrite(module.get()));
+
+  const HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, op::GetTupleElement(op::CustomCall(op::Parameter(0)), 0));
+  TF_ASSERT_OK_AND_ASSIGN(
+      CubSortDescriptor descriptor,
+      CubSortDescriptor::FromOpaque(
+          Cast<HloCustomCallInstruction>(root->operand(0))->opaque()));
+  EXPECT_EQ(descriptor.key_type, F32);
+  EXPECT_FALSE(descriptor.descending);
+  EXPECT_FALSE(descriptor.has_values);
+  EXPECT_EQ(descriptor.num_items, 4096);
+  EXPECT_EQ(descriptor.segment_size, 1024);
+}
+
+TEST_F(GpuSortRewriterTest, RewriteDescendingPairsSort) {
+  constexpr char kHlo[] = R"(
+HloModule TestModule
+
+%compare {
+  %lhs = s32[] parameter(0)
+  %rhs = s32[] parameter(1)
+  %lhs_index = s32[] parameter(2)
+  %rhs_index = s32[] parameter(3)
+  ROOT %gt = pred[] compare(%lhs, %rhs), direction=GT
+}
+
+ENTRY %main {
+  %input = s32[2048] parameter(0)
+  %iota = s32[2048] iota(), iota_dimension=0
+  ROOT %sort = (s32[2048], s32[2048]) sort(%input, %iota), dimensions={0},
+      to_apply=%compare
+})";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(kHlo));
+  EXPECT_TRUE(RunRewrite(module.get()));
+
+  const HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root,
+              op::Tuple(op::GetTupleElement(op::CustomCall(), 0),
+                        op::GetTupleElement(op::CustomCall(), 1)));
+  TF_ASSERT_OK_AND_ASSIGN(
+      CubSortDescriptor descriptor,
+      CubSortDescriptor::FromOpaque(
+          Cast<HloCustomCallInstruction>(root->operand(0)->operand(0))
+              ->opaque()));
+  EXPECT_TRUE(descriptor.descending);
+  EXPECT_TRUE(descriptor.has_values);
+}
+
+TEST_F(GpuSortRewriterTest, NoRewriteSmallSort) {
+  constexpr char kHlo[] = R"(
+HloModule TestModule
+
+%compare {
+  %lhs = s32[] parameter(0)
+  %rhs = s32[] parameter(1)
+  ROOT %lt = pred[] compare(%lhs, %rhs), direction=LT
+}
+
+ENTRY %main {
+  %input = s32[512] parameter(0)
+  ROOT %sort = s32[512] sort(%input), dimensions={0}, to_apply=%compare
+})";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(kHlo));
+  EXPECT_FALSE(RunRewrite(module.get()));
+}
+
+TEST_F(GpuSortRewriterTest, NoRewritePartialOrderFloatSort) {
+  constexpr char kHlo[] = R"(
+HloModule TestModule
+
+%compare {
+  %lhs = f32[] parameter(0)
+  %rhs = f32[] parameter(1)
+  ROOT %lt = pred[] compare(%lhs, %rhs), direction=LT
+}
+
+ENTRY %main {
+  %input = f32[2048] parameter(0)
+  ROOT %sort = f32[2048] sort(%input), dimensions={0}, to_apply=%compare
+})";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(kHlo));
+  EXPECT_FALSE(RunRewrite(module.get()));
+}
+
+TEST_F(GpuSortRewriterTest, NoRewriteMajorDimensionSort) {
+  constexpr char kHlo[] = R"(
+HloModule TestModule
+
+%compare {
+  %lhs = s32[] parameter(0)
+  %rhs = s32[] parameter(1)
+  ROOT %lt = pred[] compare(%lhs, %rhs), direction=LT
+}
+
+ENTRY %main {
+  %input = s32[2048,4] parameter(0)
+  ROOT %sort = s32[2048,4] sort(%input), dimensions={0}, to_apply=%compare
+})";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(kHlo));
+  EXPECT_FALSE(RunRewrite(module.get()));
+}
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
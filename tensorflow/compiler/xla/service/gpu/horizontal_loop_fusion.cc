@@ -36,26 +36,27 @@ namespace gpu {
 
 namespace {
 
-PrimitiveType GetUniqueOutputTypeOfFusible(const HloInstruction& fusible) {
+// Added by Alpa. Returns the types of the outputs of `fusible`. Fusibles are
+// only fused if they have the same output types, so that the i-th outputs of
+// them can be concatenated.
+std::vector<PrimitiveType> GetOutputTypesOfFusible(
+    const HloInstruction& fusible) {
   auto outputs = GetOutputsOfFusible(fusible);
   CHECK(!outputs.empty());
-  PrimitiveType first_output_type = outputs[0]->shape().element_type();
-  for (size_t i = 1; i < outputs.size(); ++i) {
-    PrimitiveType cur_output_type = outputs[i]->shape().element_type();
-    CHECK(first_output_type == cur_output_type)
-        << "Output types are expected to be unique, but see "
-        << PrimitiveType_Name(first_output_type) << " and "
-        << PrimitiveType_Name(cur_output_type);
+  std::vector<PrimitiveType> output_types;
+  output_types.reserve(outputs.size());
+  for (const HloInstruction* output : outputs) {
+    output_types.push_back(output->shape().element_type());
   }
-
-  return first_output_type;
+  return output_types;
 }
 
 class HorizontalLoopFusionImpl {
  public:
-  explicit HorizontalLoopFusionImpl(HloComputation* computation,
-                                    absl::string_view prefix)
-      : computation_(computation), prefix_(prefix) {}
+  HorizontalLoopFusionImpl(HloComputation* computation,
+                           absl::string_view prefix,
+                           const HorizontalLoopFusionOptions& options)
+      : computation_(computation), prefix_(prefix), options_(options) {}
 
   ~HorizontalLoopFusionImpl() {}
 
@@ -82,8 +83,9 @@ class HorizontalLoopFusionImpl {
   // acquire the next set of fusion candidates based on some heuristics.
   class FusionCandidates {
    public:
-    explicit FusionCandidates(HloInstruction* consumer)
-        : fusible_instrs_(), pos_(0) {
+    FusionCandidates(HloInstruction* consumer,
+                     const HorizontalLoopFusionOptions& options)
+        : fusible_instrs_(), pos_(0), options_(options) {
       Initialize(consumer);
     }
 
@@ -96,13 +98,16 @@ class HorizontalLoopFusionImpl {
     std::vector<HloInstruction*> fusible_instrs_;
     // `pos_` points to the start position of the next span.
     size_t pos_;
+    const HorizontalLoopFusionOptions& options_;  // Added by Alpa
   };
 
   HloComputation* computation_;
   std::string prefix_;
+  const HorizontalLoopFusionOptions& options_;  // Added by Alpa
 };  // HorizontalLoopFusionImpl
 
-bool IsFusibleCandidate(const HloInstruction& instr) {
+bool IsFusibleCandidate(const HloInstruction& instr,
+                        const HorizontalLoopFusionOptions& options) {
   // Require no further check for element-wise instructions.
   if (instr.IsElementwise() && instr.operand_count() > 0) {
     return true;
@@ -113,6 +118,12 @@ bool IsFusibleCandidate(const HloInstruction& instr) {
     return false;
   }
 
+  // Added by Alpa. The i-th outputs of the fused computations are
+  // concatenated, so different outputs may have different types.
+  if (options.multi_tensor) {
+    return true;
+  }
+
   // Cannot support fusion who has multiple output types, because the
   // concatenate (inserted for horizontal fusion) requires the same type
   // for all of its operands.
@@ -192,12 +203,18 @@ bool HasOnlyRowMajorLayout(const HloInstruction& instr) {
 }
 
 // Returns whether any operand of `instr` is a parameter instruction that
-// is shared with `fusion_instrs`.
+// is shared with `fusion_instrs`. If `only_aliased_params`, only counts the
+// parameters aliased with an output of the module.
 bool AnyOpndIsParamSharedAmongFusions(
     const HloInstruction* instr,
-    const absl::flat_hash_set<HloInstruction*>& fusion_instrs) {
+    const absl::flat_hash_set<HloInstruction*>& fusion_instrs,
+    bool only_aliased_params = false) {
+  const HloInputOutputAliasConfig& alias_config =
+      instr->GetModule()->input_output_alias_config();
   return absl::c_any_of(instr->operands(), [&](const HloInstruction* opnd) {
     return opnd->opcode() == HloOpcode::kParameter &&
+           (!only_aliased_params || opnd->shape().IsTuple() ||
+            alias_config.ParameterHasAlias(opnd->parameter_number(), {})) &&
            absl::c_any_of(opnd->users(), [&](const HloInstruction* user) {
              return user != instr && fusion_instrs.contains(user);
            });
@@ -214,7 +231,7 @@ void HorizontalLoopFusionImpl::FusionCandidates::Initialize(
     HloInstruction* predecessor = opnd->LatestNonGteAncestor();
     // We support kLoop fusion and element-wise HLOs now. We may extend the
     // support list if needs arise.
-    if (IsFusibleCandidate(*predecessor)) {
+    if (IsFusibleCandidate(*predecessor, options_)) {
       if (fusible_candidates.insert(predecessor).second) {
         // Add unseen fusion to ordered list.
         ordered_fusible_candidates.push_back(predecessor);
@@ -234,7 +251,9 @@ void HorizontalLoopFusionImpl::FusionCandidates::Initialize(
     } else if (!HasOnlyRowMajorLayout(*instr)) {
       VLOG(2) << "Reject non-row-major fusion instr " << instr->ToString();
       continue;
-    } else if (AnyOpndIsParamSharedAmongFusions(instr, fusible_candidates)) {
+    } else if (AnyOpndIsParamSharedAmongFusions(
+                   instr, fusible_candidates,
+                   /*only_aliased_params=*/options_.multi_tensor)) {
       // Don't fuse fusions whose operands are parameter instructions that are
       // shared among fusions because we cannot i/o alias the produced
       // horizontal fusion due to the concat insertion.
@@ -249,19 +268,15 @@ void HorizontalLoopFusionImpl::FusionCandidates::Initialize(
     }
   }
 
-  // Sort `fusible_instrs_` according to output types, the number of outputs,
-  // and instruction counts, because we only fuse instructions with the same
-  // number/type of outputs and whose computations have the same instruction
-  // count.
+  // Sort `fusible_instrs_` according to output types (ordered by the types
+  // and then the number of outputs), and instruction counts, because we only
+  // fuse instructions with the same number/type of outputs and whose
+  // computations have the same instruction count.
   std::sort(
       fusible_instrs_.begin(), fusible_instrs_.end(),
       [&](const HloInstruction* a, const HloInstruction* b) {
-        if (GetUniqueOutputTypeOfFusible(*a) !=
-            GetUniqueOutputTypeOfFusible(*b)) {
-          return GetUniqueOutputTypeOfFusible(*a) <
-                 GetUniqueOutputTypeOfFusible(*b);
-        } else if (GetOutputSizeOfFusible(*a) != GetOutputSizeOfFusible(*b)) {
-          return GetOutputSizeOfFusible(*a) < GetOutputSizeOfFusible(*b);
+        if (GetOutputTypesOfFusible(*a) != GetOutputTypesOfFusible(*b)) {
+          return GetOutputTypesOfFusible(*a) < GetOutputTypesOfFusible(*b);
         } else {
           return GetInstrCountOfFusible(*a) < GetInstrCountOfFusible(*b);
         }
@@ -277,12 +292,12 @@ HorizontalLoopFusionImpl::FusionCandidates::GetNextSpanOfFusions() {
 
   // Fusing too many computations at a time may not be easily profitable and
   // may increase compile time due to large kernels. Set a limit to it.
-  constexpr int64_t kMaxFusionBatchSize = 32;
+  const int64_t max_fusion_batch_size = options_.max_fusion_batch_size;
   // CUDA has a parameter size limit of ~4k bytes.
   constexpr int64_t kMaxCudaParamSize = 4000;
   size_t accum_io_size = 0;
   auto reach_max_fusion_batch_size = [&](size_t left, size_t right) -> bool {
-    if (right - left >= kMaxFusionBatchSize) {
+    if (static_cast<int64_t>(right - left) >= max_fusion_batch_size) {
       return true;
     }
 
@@ -298,21 +313,17 @@ HorizontalLoopFusionImpl::FusionCandidates::GetNextSpanOfFusions() {
 
   size_t left = pos_;
   size_t right = pos_ + 1;
-  size_t first_output_size = GetOutputSizeOfFusible(*fusible_instrs_[left]);
-  PrimitiveType first_output_type =
-      GetUniqueOutputTypeOfFusible(*fusible_instrs_[left]);
+  std::vector<PrimitiveType> first_output_types =
+      GetOutputTypesOfFusible(*fusible_instrs_[left]);
   for (; right < fusible_instrs_.size(); ++right) {
-    PrimitiveType cur_output_type =
-        GetUniqueOutputTypeOfFusible(*fusible_instrs_[right]);
-    if (first_output_type != cur_output_type) {
-      // Cannot fuse computations who have multiple output types.
-      break;
-    } else if (first_output_size !=
-               GetOutputSizeOfFusible(*fusible_instrs_[right])) {
-      // Cannot fuse computations who have different numbers of outputs.
+    if (first_output_types !=
+        GetOutputTypesOfFusible(*fusible_instrs_[right])) {
+      // Cannot fuse computations who have different numbers or types of
+      // outputs.
       break;
-    } else if (GetInstrCountOfFusible(*fusible_instrs_[left]) !=
-               GetInstrCountOfFusible(*fusible_instrs_[right])) {
+    } else if (!options_.multi_tensor &&
+               GetInstrCountOfFusible(*fusible_instrs_[left]) !=
+                   GetInstrCountOfFusible(*fusible_instrs_[right])) {
       // Do not fuse computations of different instruction counts as it may
       // introduce control divergence. This is a very simple heuristic to avoid
       // fusing computations with too much discrepancy and we may improve it
@@ -532,7 +543,8 @@ StatusOr<bool> HorizontalLoopFusionImpl::Run() {
   absl::c_reverse(use_to_def_order);
   for (size_t i = 0; i < use_to_def_order.size(); ++i) {
     HloInstruction* consumer = use_to_def_order[i];
-    HorizontalLoopFusionImpl::FusionCandidates fusion_candidates(consumer);
+    HorizontalLoopFusionImpl::FusionCandidates fusion_candidates(consumer,
+                                                                 options_);
     while (true) {
       auto fusibles = fusion_candidates.GetNextSpanOfFusions();
       if (fusibles.empty()) {
@@ -567,7 +579,8 @@ StatusOr<bool> HorizontalLoopFusionImpl::Run() {
 
 StatusOr<bool> GpuHorizontalLoopFusion::RunOnComputation(
     HloComputation* computation) {
-  HorizontalLoopFusionImpl horizontal_fusion_impl(computation, prefix_);
+  HorizontalLoopFusionImpl horizontal_fusion_impl(computation, prefix_,
+                                                  options_);
   return horizontal_fusion_impl.Run();
 }
 
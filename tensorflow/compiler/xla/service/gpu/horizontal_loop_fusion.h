@@ -95,10 +95,30 @@ namespace gpu {
 // outputs of Mul and Add are row-major.
 //
 // Note, reshapes are added only if the tensors isn't already a vector.
+
+// Added by Alpa.
+struct HorizontalLoopFusionOptions {
+  // The maximum number of computations fused into one kernel. The kernels are
+  // also limited by the size of the kernel parameters.
+  int64_t max_fusion_batch_size = 32;
+  // Fuses computations like a multi-tensor apply of optimizer updates, e.g.,
+  // the per-parameter Adam updates of an apply-grad module, into as few
+  // kernels as possible. The computations may have different instruction
+  // counts, multi-output fusions may have outputs of different types as long
+  // as the i-th outputs of the fused computations have the same type, and the
+  // computations may share the parameters that are not aliased with outputs,
+  // e.g., the learning rate.
+  bool multi_tensor = false;
+};
+
 class GpuHorizontalLoopFusion : public HloModulePass {
  public:
   GpuHorizontalLoopFusion() {}
   GpuHorizontalLoopFusion(absl::string_view prefix) : prefix_(prefix) {}
+  // Added by Alpa.
+  GpuHorizontalLoopFusion(absl::string_view prefix,
+                          HorizontalLoopFusionOptions options)
+      : prefix_(prefix), options_(options) {}
 
   absl::string_view name() const override {
     return "gpu_horizontal_loop_fusion";
@@ -112,6 +132,7 @@ class GpuHorizontalLoopFusion : public HloModulePass {
  private:
   StatusOr<bool> RunOnComputation(HloComputation*);
   std::string prefix_;
+  HorizontalLoopFusionOptions options_;  // Added by Alpa
 };
 
 }  // namespace gpu
@@ -612,6 +612,95 @@ TEST_F(HorizontalLoopFusionTest, TraversalOrder) {
 //  - as a result some inputs were overwritten before being read
 // Conditional operation is meaningless (branches are equivalent) and
 // is there only to properly confuse the buffer assignment.
+// Added by Alpa.
+TEST_F(HorizontalLoopFusionTest, MultiTensorAdamLike) {
+  constexpr absl::string_view kHlo = R"(
+ HloModule MultiTensorAdamLike
+
+ fused_computation.1 {
+   param.1 = bf16[1024]{0} parameter(0)
+   grad.1 = f32[1024]{0} parameter(1)
+   m.1 = f32[1024]{0} parameter(2)
+   lr.1 = f32[] parameter(3)
+   new_m.1 = f32[1024]{0} add(m.1, grad.1)
+   lr_bcast.1 = f32[1024]{0} broadcast(lr.1), dimensions={}
+   update.1 = f32[1024]{0} multiply(lr_bcast.1, new_m.1)
+   param_f32.1 = f32[1024]{0} convert(param.1)
+   new_param_f32.1 = f32[1024]{0} subtract(param_f32.1, update.1)
+   new_param.1 = bf16[1024]{0} convert(new_param_f32.1)
+   ROOT tuple.1 = (bf16[1024]{0}, f32[1024]{0}) tuple(new_param.1, new_m.1)
+ }
+
+ fused_computation.2 {
+   param.2 = bf16[33,7]{1,0} parameter(0)
+   grad.2 = f32[33,7]{1,0} parameter(1)
+   m.2 = f32[33,7]{1,0} parameter(2)
+   lr.2 = f32[] parameter(3)
+   new_m.2 = f32[33,7]{1,0} add(m.2, grad.2)
+   lr_bcast.2 = f32[33,7]{1,0} broadcast(lr.2), dimensions={}
+   update.2 = f32[33,7]{1,0} multiply(lr_bcast.2, new_m.2)
+   param_f32.2 = f32[33,7]{1,0} convert(param.2)
+   // With a weight decay.
+   decay.2 = f32[33,7]{1,0} multiply(lr_bcast.2, param_f32.2)
+   decayed.2 = f32[33,7]{1,0} subtract(param_f32.2, decay.2)
+   new_param_f32.2 = f32[33,7]{1,0} subtract(decayed.2, update.2)
+   new_param.2 = bf16[33,7]{1,0} convert(new_param_f32.2)
+   ROOT tuple.2 = (bf16[33,7]{1,0}, f32[33,7]{1,0}) tuple(new_param.2, new_m.2)
+ }
+
+ ENTRY entry_computation {
+   lr = f32[] parameter(0)
+   param.1 = bf16[1024]{0} parameter(1)
+   grad.1 = f32[1024]{0} parameter(2)
+   m.1 = f32[1024]{0} parameter(3)
+   param.2 = bf16[33,7]{1,0} parameter(4)
+   grad.2 = f32[33,7]{1,0} parameter(5)
+   m.2 = f32[33,7]{1,0} parameter(6)
+   fusion.1 = (bf16[1024]{0}, f32[1024]{0})
+       fusion(param.1, grad.1, m.1, lr), kind=kLoop, calls=fused_computation.1
+   fusion.2 = (bf16[33,7]{1,0}, f32[33,7]{1,0})
+       fusion(param.2, grad.2, m.2, lr), kind=kLoop, calls=fused_computation.2
+   gte.1 = bf16[1024]{0} get-tuple-element(fusion.1), index=0
+   gte.2 = f32[1024]{0} get-tuple-element(fusion.1), index=1
+   gte.3 = bf16[33,7]{1,0} get-tuple-element(fusion.2), index=0
+   gte.4 = f32[33,7]{1,0} get-tuple-element(fusion.2), index=1
+   ROOT tuple = (bf16[1024]{0}, f32[1024]{0}, bf16[33,7]{1,0}, f32[33,7]{1,0})
+       tuple(gte.1, gte.2, gte.3, gte.4)
+ }
+)";
+
+  // The fusions share the learning rate, have different instruction counts and
+  // outputs of different types, so they are only fused as a multi-tensor
+  // apply.
+  auto module = ParseAndReturnVerifiedModule(kHlo).value();
+  EXPECT_FALSE(GpuHorizontalLoopFusion().Run(module.get()).value());
+
+  module = ParseAndReturnVerifiedModule(kHlo).value();
+  HorizontalLoopFusionOptions options;
+  options.multi_tensor = true;
+  EXPECT_TRUE(GpuHorizontalLoopFusion(/*prefix=*/"", options)
+                  .Run(module.get())
+                  .value());
+  TF_ASSERT_OK(verifier().Run(module.get()).status());
+
+  const HloInstruction* fusion = nullptr;
+  for (const HloInstruction* instr :
+       module->entry_computation()->instructions()) {
+    if (instr->opcode() == HloOpcode::kFusion) {
+      ASSERT_EQ(fusion, nullptr) << "expected a single fusion";
+      fusion = instr;
+    }
+  }
+  ASSERT_NE(fusion, nullptr);
+  EXPECT_THAT(fusion->fused_expression_root(),
+              op::Tuple(op::Slice(op::Concatenate()),
+                        op::Slice(op::Concatenate()),
+                        op::Slice(op::Concatenate()),
+                        op::Slice(op::Concatenate())));
+  // The shared learning rate is passed once.
+  EXPECT_EQ(fusion->operand_count(), 7);
+}
+
 TEST_F(HorizontalLoopFusionTest, NoBufferAliasingOfDuplicateParameter) {
   const char* hlo_text = R"(
 HloModule m
@@ -0,0 +1,203 @@
+#include "tensorflow/compiler/xla/service/gpu/host_offload.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_constants.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/gpu/gpu_hlo_schedule.h"
+#include "tensorflow/compiler/xla/service/hlo_alias_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_live_range.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/tsl/platform/logging.h"
+#include "tensorflow/tsl/platform/numbers.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+// An interval of the schedule over which a value can live in host memory.
+struct OffloadCandidate {
+  const HloValue* value;
+  int64_t size;
+  // The value is copied to the host after the instruction at `start` and
+  // copied back before the instruction at `end`.
+  int64_t start;
+  int64_t end;
+};
+
+bool InHostMemory(const Shape& shape) {
+  return shape.IsArray() && shape.has_layout() &&
+         shape.layout().memory_space() == kHostMemorySpaceColor;
+}
+
+}  // namespace
+
+StatusOr<bool> HostOffload::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  if (memory_limit_bytes_ <= 0) {
+    return false;
+  }
+
+  TF_ASSIGN_OR_RETURN(HloSchedule schedule,
+                      ScheduleGpuModule(module, pointer_size_));
+  HloComputation* entry = module->entry_computation();
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<HloAliasAnalysis> alias_analysis,
+                      HloAliasAnalysis::Run(module));
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<HloLiveRange> live_range,
+      HloLiveRange::Run(schedule, *alias_analysis, entry,
+                        /*module_scoped_analysis=*/false));
+  const std::vector<HloInstruction*>& sequence =
+      live_range->flattened_instruction_sequence().instructions();
+  const int64_t num_times = sequence.size();
+  if (num_times < 3) {
+    return false;
+  }
+
+  auto device_size = [&](const Shape& shape) -> int64_t {
+    return InHostMemory(shape) ? 0 : cost_options_.shape_size(shape);
+  };
+
+  // The device memory in use at every time.
+  std::vector<int64_t> memory(num_times + 1, 0);
+  for (const auto& [value, time_bound] : live_range->buffer_live_ranges()) {
+    int64_t size = device_size(value->shape());
+    memory[time_bound.start] += size;
+    memory[std::min(time_bound.end + 1, num_times)] -= size;
+  }
+  for (int64_t t = 1; t <= num_times; ++t) {
+    memory[t] += memory[t - 1];
+  }
+  memory.pop_back();
+
+  // The compute time before every time.
+  GpuHloCostAnalysis cost_analysis(cost_options_);
+  TF_RETURN_IF_ERROR(entry->Accept(&cost_analysis));
+  std::vector<double> elapsed(num_times + 1, 0.0);
+  for (int64_t t = 0; t < num_times; ++t) {
+    elapsed[t + 1] = elapsed[t] + cost_analysis.optimal_seconds(*sequence[t]);
+  }
+
+  std::vector<OffloadCandidate> candidates;
+  const auto& instruction_schedule = live_range->instruction_schedule();
+  for (const HloValue* value : alias_analysis->dataflow_analysis().values()) {
+    const HloInstruction* defining = value->defining_instruction();
+    const Shape& shape = value->shape();
+    if (defining->parent() != entry || !value->defining_index().empty() ||
+        !shape.IsArray() || InHostMemory(shape) ||
+        value->positions().size() != 1 || value->live_out_of_module() ||
+        defining->opcode() == HloOpcode::kParameter ||
+        defining->opcode() == HloOpcode::kConstant) {
+      continue;
+    }
+    int64_t size = device_size(shape);
+    if (size < min_offload_bytes_) {
+      continue;
+    }
+
+    std::vector<int64_t> times = {instruction_schedule.at(defining)};
+    bool supported = true;
+    for (const HloUse& use : value->GetUses()) {
+      auto it = instruction_schedule.find(use.instruction);
+      if (it == instruction_schedule.end()) {
+        supported = false;
+        break;
+      }
+      times.push_back(it->second);
+    }
+    if (!supported || times.size() < 2) {
+      continue;
+    }
+    absl::c_sort(times);
+
+    // The longest interval between consecutive uses.
+    OffloadCandidate best{value, size, 0, 0};
+    for (size_t i = 0; i + 1 < times.size(); ++i) {
+      if (times[i + 1] - times[i] > best.end - best.start) {
+        best.start = times[i];
+        best.end = times[i + 1];
+      }
+    }
+    if (best.end - best.start < 2) {
+      continue;
+    }
+    double transfer_seconds =
+        host_bandwidth_ > 0 ? 2.0 * size / host_bandwidth_ : 0.0;
+    double overlap_seconds = elapsed[best.end] - elapsed[best.start + 1];
+    if (overlap_seconds < min_overlap_ratio_ * transfer_seconds) {
+      continue;
+    }
+    candidates.push_back(best);
+  }
+
+  // Greedily offload the largest value spanning the peak until the peak fits.
+  std::vector<OffloadCandidate> offloaded;
+  while (!candidates.empty()) {
+    int64_t peak_time = std::distance(
+        memory.begin(), std::max_element(memory.begin(), memory.end()));
+    if (memory[peak_time] <= memory_limit_bytes_) {
+      break;
+    }
+    auto best = candidates.end();
+    for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+      if (it->start < peak_time && peak_time < it->end &&
+          (best == candidates.end() || it->size > best->size)) {
+        best = it;
+      }
+    }
+    if (best == candidates.end()) {
+      break;
+    }
+    for (int64_t t = best->start + 1; t < best->end; ++t) {
+      memory[t] -= best->size;
+    }
+    offloaded.push_back(*best);
+    candidates.erase(best);
+  }
+
+  for (const OffloadCandidate& candidate : offloaded) {
+    HloInstruction* defining = candidate.value->defining_instruction();
+    Shape host_shape = candidate.value->shape();
+    host_shape.mutable_layout()->set_memory_space(kHostMemorySpaceColor);
+    HloInstruction* to_host = entry->AddInstruction(
+        HloInstruction::CreateUnary(host_shape, HloOpcode::kCopy, defining));
+    HloInstruction* to_device = entry->AddInstruction(
+        HloInstruction::CreateUnary(candidate.value->shape(), HloOpcode::kCopy,
+                                    to_host));
+    for (const HloUse& use : candidate.value->GetUses()) {
+      if (instruction_schedule.at(use.instruction) >= candidate.end) {
+        TF_RETURN_IF_ERROR(use.instruction->ReplaceOperandWith(
+            use.operand_number, to_device));
+      }
+    }
+    // Every control edge goes forward in the original sequence, so no cycle
+    // is introduced.
+    TF_RETURN_IF_ERROR(
+        to_host->AddControlDependencyTo(sequence[candidate.start + 1]));
+    TF_RETURN_IF_ERROR(
+        sequence[candidate.end - 1]->AddControlDependencyTo(to_device));
+    VLOG(1) << "Offload " << defining->name() << " ("
+            << tsl::strings::HumanReadableNumBytes(candidate.size)
+            << ") to host between " << sequence[candidate.start]->name()
+            << " and " << sequence[candidate.end]->name();
+  }
+
+  if (!offloaded.empty()) {
+    LOG(INFO) << "Offloaded " << offloaded.size() << " values of "
+              << module->name() << " to host memory, estimated peak device "
+              << "memory "
+              << tsl::strings::HumanReadableNumBytes(
+                     *std::max_element(memory.begin(), memory.end()));
+  }
+  return !offloaded.empty();
+}
+
+}  // namespace gpu
+}  // namespace xla
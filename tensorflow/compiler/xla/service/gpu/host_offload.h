@@ -0,0 +1,65 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_HOST_OFFLOAD_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_HOST_OFFLOAD_H_
+
+#include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace xla {
+namespace gpu {
+
+// Offloads long-lived values of the entry computation to pinned host memory
+// until the peak device memory fits in `memory_limit_bytes`.
+//
+// The module is scheduled with ScheduleGpuModule and the live ranges of its
+// values are computed with HloLiveRange. A value can be offloaded over the
+// longest interval between two of its consecutive uses (or its definition
+// and first use): a copy to kHostMemorySpaceColor is added after the start,
+// and the uses after the end read a copy back to device memory, so the device
+// buffer is free in between. Like the prefetch interval picker of
+// MemorySpaceAssignment, an interval is only used if the compute in it, as
+// estimated by GpuHloCostAnalysis, takes at least `min_overlap_ratio` times
+// the time of transferring the value both ways at `host_bandwidth` bytes per
+// second. Among the intervals spanning the current peak, the largest value is
+// offloaded first.
+//
+// Control dependencies pin the copies next to the ends of their interval, so
+// that the schedule the backend computes later keeps the device buffer free.
+// The copies run on the compute stream, because this backend cannot lower
+// copy-start/copy-done. Parameters are never offloaded, because their device
+// buffers are owned by the caller.
+class HostOffload : public HloModulePass {
+ public:
+  HostOffload(int64_t memory_limit_bytes,
+              const HloCostAnalysis::Options& cost_options,
+              int64_t pointer_size, double host_bandwidth,
+              int64_t min_offload_bytes = 1024 * 1024,
+              double min_overlap_ratio = 1.0)
+      : memory_limit_bytes_(memory_limit_bytes),
+        cost_options_(cost_options),
+        pointer_size_(pointer_size),
+        host_bandwidth_(host_bandwidth),
+        min_offload_bytes_(min_offload_bytes),
+        min_overlap_ratio_(min_overlap_ratio) {}
+
+  absl::string_view name() const override { return "host-offload"; }
+
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+
+ private:
+  int64_t memory_limit_bytes_;
+  HloCostAnalysis::Options cost_options_;
+  int64_t pointer_size_;
+  double host_bandwidth_;
+  int64_t min_offload_bytes_;
+  double min_overlap_ratio_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_HOST_OFFLOAD_H_
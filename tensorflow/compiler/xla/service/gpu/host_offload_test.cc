@@ -0,0 +1,89 @@
+#include "tensorflow/compiler/xla/service/gpu/host_offload.h"
+
+#include <memory>
+
+#include "tensorflow/compiler/xla/service/gpu/gpu_constants.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_matchers.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/tsl/platform/status_matchers.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+using ::testing::ElementsAre;
+using ::tsl::testing::IsOkAndHolds;
+namespace op = xla::testing::opcode_matchers;
+
+constexpr int64_t kPointerSize = 8;
+
+// `a` is idle from `b` to `e`, while the peak of 16MiB is at `c` and `d`.
+constexpr absl::string_view kHloString = R"(
+HloModule module
+
+ENTRY %entry {
+  p0 = f32[1024,1024]{1,0} parameter(0)
+  a = f32[1024,1024]{1,0} negate(p0)
+  b = f32[1024,1024]{1,0} exponential(a)
+  c = f32[1024,1024]{1,0} exponential(b)
+  d = f32[1024,1024]{1,0} exponential(c)
+  ROOT e = f32[1024,1024]{1,0} add(d, a)
+})";
+
+int64_t ShapeSize(const Shape& shape) {
+  return ShapeUtil::ByteSizeOf(shape, kPointerSize);
+}
+
+class HostOffloadTest : public HloTestBase {};
+
+TEST_F(HostOffloadTest, OffloadIdleValue) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHloString));
+
+  HostOffload pass(/*memory_limit_bytes=*/14 * 1024 * 1024,
+                   HloCostAnalysis::Options{ShapeSize}, kPointerSize,
+                   /*host_bandwidth=*/0);
+  EXPECT_THAT(pass.Run(module.get()), IsOkAndHolds(true));
+
+  const HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, op::Add(op::Exp(), op::Copy(op::Copy(op::Negate()))));
+  const HloInstruction* to_device = root->operand(1);
+  const HloInstruction* to_host = to_device->operand(0);
+  EXPECT_EQ(to_host->shape().layout().memory_space(), kHostMemorySpaceColor);
+  EXPECT_EQ(to_device->shape().layout().memory_space(), 0);
+
+  // The copies are pinned around `c` and `d`.
+  const HloInstruction* d = root->operand(0);
+  const HloInstruction* c = d->operand(0);
+  EXPECT_THAT(to_host->control_successors(), ElementsAre(c));
+  EXPECT_THAT(to_device->control_predecessors(), ElementsAre(d));
+}
+
+TEST_F(HostOffloadTest, FitsInBudget) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHloString));
+
+  HostOffload pass(/*memory_limit_bytes=*/16 * 1024 * 1024,
+                   HloCostAnalysis::Options{ShapeSize}, kPointerSize,
+                   /*host_bandwidth=*/0);
+  EXPECT_THAT(pass.Run(module.get()), IsOkAndHolds(false));
+}
+
+TEST_F(HostOffloadTest, TransferNotHidden) {
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHloString));
+
+  // Without compute rates the interval takes no time, so no transfer over a
+  // finite bandwidth is hidden.
+  HostOffload pass(/*memory_limit_bytes=*/14 * 1024 * 1024,
+                   HloCostAnalysis::Options{ShapeSize}, kPointerSize,
+                   /*host_bandwidth=*/1e9);
+  EXPECT_THAT(pass.Run(module.get()), IsOkAndHolds(false));
+}
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
@@ -104,6 +104,15 @@ FusionDecision GpuInstructionFusion::ShouldFuse(HloInstruction* consumer,
     return !too_large;
   }
 
+  // Added by Alpa. The producer is only removed if it is fused into all of
+  // its users, which the estimate takes into account.
+  if (cost_model_.has_value()) {
+    if (NoFusionPossible slower = !cost_model_->IsFusionFaster(
+            consumer->mutable_operand(operand_index), {consumer})) {
+      return !slower;
+    }
+  }
+
   if (consumer->opcode() != HloOpcode::kFusion) {
     return {};
   }
@@ -16,8 +16,12 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_INSTRUCTION_FUSION_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_INSTRUCTION_FUSION_H_
 
+#include <optional>
+#include <utility>
+
 #include "absl/container/flat_hash_map.h"
 #include "tensorflow/compiler/xla/service/fusion_node_indexing_evaluation.h"
+#include "tensorflow/compiler/xla/service/gpu/fusion_cost_model.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/instruction_fusion.h"
 
@@ -29,6 +33,15 @@ class GpuInstructionFusion : public InstructionFusion {
   explicit GpuInstructionFusion(bool may_duplicate)
       : InstructionFusion(GpuInstructionFusion::IsExpensive, may_duplicate) {}
 
+  // Added by Alpa. Also rejects the fusions that `cost_model_options`
+  // predicts to be slower.
+  GpuInstructionFusion(bool may_duplicate,
+                       FusionCostModel::Options cost_model_options)
+      : InstructionFusion(GpuInstructionFusion::IsExpensive, may_duplicate) {
+    cost_model_.emplace(std::move(cost_model_options),
+                        may_duplicate ? "fusion_may_duplicate" : "fusion");
+  }
+
   static bool IsExpensive(const HloInstruction& instruction);
 
   using HloPassInterface::Run;
@@ -36,7 +49,11 @@ class GpuInstructionFusion : public InstructionFusion {
                      const absl::flat_hash_set<absl::string_view>&
                          execution_threads) override {
     fusion_node_evaluations_.clear();
-    return InstructionFusion::Run(module, execution_threads);
+    StatusOr<bool> changed = InstructionFusion::Run(module, execution_threads);
+    if (cost_model_.has_value()) {
+      cost_model_->DumpRejectedFusions(*module);
+    }
+    return changed;
   }
 
  protected:
@@ -59,6 +76,9 @@ class GpuInstructionFusion : public InstructionFusion {
   // indexed with different index vectors.
   absl::flat_hash_map<const HloInstruction*, FusionNodeIndexingEvaluation>
       fusion_node_evaluations_;
+
+  // Added by Alpa.
+  std::optional<FusionCostModel> cost_model_;
 };
 
 }  // namespace gpu
@@ -697,5 +697,34 @@ TEST_F(InstructionFusionTest, SmallReducedDimensionIsNotLoweredToLoop) {
   EXPECT_EQ(root->fusion_kind(), HloInstruction::FusionKind::kInput);
 }
 
+// Added by Alpa.
+TEST_F(InstructionFusionTest, CostModelRejectsRecomputingForBroadcast) {
+  constexpr absl::string_view kHlo = R"(
+    HloModule test_module
+
+    ENTRY entry {
+      p0 = f32[1024] parameter(0)
+      p1 = f32[1024] parameter(1)
+      add = f32[1024] add(p0, p1)
+      ROOT broadcast = f32[1024,1024] broadcast(add), dimensions={1}
+    })";
+  FusionCostModel::Options options;
+  options.cost_options.shape_size = [](const Shape& shape) {
+    return ShapeUtil::ByteSizeOf(shape, /*pointer_size=*/8);
+  };
+  options.cost_options.set_flops_per_second(1e14);
+  options.cost_options.set_bytes_per_second(1e12);
+
+  // The heuristics fuse the cheap add into the broadcast, but recomputing it
+  // for each element of the broadcast is slower.
+  auto module = ParseAndReturnVerifiedModule(kHlo).value();
+  EXPECT_TRUE(
+      GpuInstructionFusion(/*may_duplicate=*/true).Run(module.get()).value());
+  module = ParseAndReturnVerifiedModule(kHlo).value();
+  EXPECT_FALSE(GpuInstructionFusion(/*may_duplicate=*/true, options)
+                   .Run(module.get())
+                   .value());
+}
+
 }  // namespace gpu
 }  // namespace xla
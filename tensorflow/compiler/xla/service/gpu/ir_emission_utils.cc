@@ -146,6 +146,7 @@ const char* const kBuiltinMemZeroTarget = "__builtin$MemZero";
 const char* const kBuiltinCrossMeshAllReduceTarget =
     "__builtin$CrossMeshAllReduce";
 const char* const kBuiltinDoneEventTarget = "__builtin$DoneEvent";
+const char* const kBuiltinRaggedAllToAllTarget = "__builtin$RaggedAllToAll";
 
 bool IsCustomCallToCusolver(const HloInstruction& hlo) {
   if (hlo.opcode() != HloOpcode::kCustomCall) {
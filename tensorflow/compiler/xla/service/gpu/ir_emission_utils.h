@@ -73,6 +73,9 @@ extern const char* const kCusolverCholeskyCallTarget;
 extern const char* const kBuiltinMemZeroTarget;
 extern const char* const kBuiltinCrossMeshAllReduceTarget;
 extern const char* const kBuiltinDoneEventTarget;
+// All-to-all with per-peer row counts computed on the device, see
+// NcclRaggedAllToAllThunk.
+extern const char* const kBuiltinRaggedAllToAllTarget;
 
 // Returns true if either the dimensions being reduced or the dimensions being
 // kept are contiguous in the input of the reduce instruction.
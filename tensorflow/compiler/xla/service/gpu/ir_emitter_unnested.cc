@@ -1716,6 +1716,35 @@ Status IrEmitterUnnested::EmitLoopFusion(mlir::Operation* op) {
   return OkStatus();
 }
 
+// Added by Alpa
+// Returns the number of consecutive elements of each row of the tile that a
+// thread of a tiled transpose reads and writes. With 16-bit elements, a warp
+// reading one element per thread only reads half a cache line of each row, so
+// the tile is doubled to two elements per thread when the transposed
+// dimensions are large enough and the shared memory tiles stay small.
+static int GetTransposeVectorSize(absl::Span<HloInstruction* const> hlo_roots,
+                                  const Vector3& dims) {
+  constexpr int kVectorSize = 2;
+  constexpr int64_t kMaxSharedMemoryBytes = 48 * 1024;
+  int64_t tile_size = kVectorSize * WarpSize();
+  if (dims[1] < tile_size || dims[2] < tile_size) {
+    return 1;
+  }
+  int64_t shared_memory_bytes = 0;
+  for (HloInstruction* root : hlo_roots) {
+    if (!FindAnyTiledTranspose(*root)) {
+      continue;
+    }
+    PrimitiveType element_type = root->operand(0)->shape().element_type();
+    if (primitive_util::BitWidth(element_type) > 16) {
+      return 1;
+    }
+    shared_memory_bytes += tile_size * (tile_size + 1) *
+                           ShapeUtil::ByteSizeOfPrimitiveType(element_type);
+  }
+  return shared_memory_bytes <= kMaxSharedMemoryBytes ? kVectorSize : 1;
+}
+
 Status IrEmitterUnnested::EmitUnnestedTranspose(
     mlir::lmhlo::FusionOp fusion, HloComputation* fused_computation) {
   std::vector<HloInstruction*> hlo_roots = GetFusionRoots(fused_computation);
@@ -1735,12 +1764,16 @@ Status IrEmitterUnnested::EmitUnnestedTranspose(
   // 3D view over the input shape.
   Vector3 permuted_dims = {dims->at(0), dims->at(2), dims->at(1)};
 
+  // Added by Alpa
+  int vector_size = GetTransposeVectorSize(hlo_roots, *dims);
+
   TilingScheme tiling_scheme(
       /*permuted_dims*/ permuted_dims,
-      /*tile_sizes=*/{1, WarpSize() / kNumRows, 1},
+      /*tile_sizes=*/
+      {1, vector_size * WarpSize() / kNumRows, vector_size},
       /*num_threads=*/{1, kNumRows, WarpSize()},
       /*indexing_order=*/kLinearIndexingX,
-      /*vector_size=*/1,
+      /*vector_size=*/vector_size,
       /*scaling_factor=*/1);
   LaunchDimensions launch_dimensions(
       tiling_scheme.GetNumberOfBlocksPhysical(),
@@ -4582,6 +4615,24 @@ static bool CanVectorizeReduction(
   return false;
 }
 
+// Added by Alpa
+// Returns the number of consecutive elements each thread of a vectorized row
+// reduction reads at once. Inputs narrower than 32 bits read up to 128 bits
+// at once instead of two elements, as long as the rows and the tile stay
+// aligned to the vector.
+static int GetRowReductionVectorSize(int smallest_input_dtype_bits,
+                                     int64_t reduced_dimension_size,
+                                     int64_t tile_size_x) {
+  constexpr int kMaxVectorBits = 128;
+  int vector_size = 2;
+  while (2 * vector_size * smallest_input_dtype_bits <= kMaxVectorBits &&
+         tile_size_x % (2 * vector_size) == 0 &&
+         reduced_dimension_size % (2 * vector_size) == 0) {
+    vector_size *= 2;
+  }
+  return vector_size;
+}
+
 StatusOr<ReductionCodegenInfo> IrEmitterUnnested::ComputeReductionCodegenInfo(
     mlir::lmhlo::FusionOp fusion, HloComputation* fused_computation,
     HloInstruction* first_reduce) {
@@ -4632,6 +4683,14 @@ StatusOr<ReductionCodegenInfo> IrEmitterUnnested::ComputeReductionCodegenInfo(
       CanVectorizeReduction(cc, fusion, fused_computation, reduction_dimensions,
                             num_threads_x, reduction_tiling, input_shape);
   int vector_size = vectorize ? 2 : 1;
+  // Added by Alpa
+  if (vectorize && reduction_dimensions.is_row_reduction &&
+      smallest_input_dtype_bits < 32 &&
+      cc.IsAtLeast(se::CudaComputeCapability::VOLTA)) {
+    vector_size = GetRowReductionVectorSize(
+        smallest_input_dtype_bits, reduction_dimensions.dimensions[kDimX],
+        reduction_tiling[kDimX]);
+  }
   int num_partial_results = 1;
   if (!reduction_dimensions.is_row_reduction && vectorize) {
     if (smallest_input_dtype_bits <= 32) {
@@ -4643,6 +4702,12 @@ StatusOr<ReductionCodegenInfo> IrEmitterUnnested::ComputeReductionCodegenInfo(
       //   CU_LIMIT_MAX_L2_FETCH_GRANULARITY); // 0x05
       // But we need a context to be active. Which isn't the case here.
       num_partial_results = std::min(64 / smallest_input_dtype_bits, 8);
+      // Added by Alpa
+      // 16-bit inputs read 128 bits per thread, so that a warp reads whole
+      // 512-byte segments of each row.
+      if (smallest_input_dtype_bits == 16) {
+        num_partial_results = 8;
+      }
 
       // Limit register presure, PRED dtype is only one bit.
       num_partial_results = std::min(num_partial_results, 8);
@@ -5331,6 +5396,9 @@ Status IrEmitterUnnested::EmitOp(mlir::Operation* op) {
     if (call.getCallTargetName() == kBuiltinDoneEventTarget) {
       return EmitDoneEventThunk(op);
     }
+    if (call.getCallTargetName() == kBuiltinRaggedAllToAllTarget) {
+      return EmitRaggedAllToAllThunk(op);
+    }
 
     return EmitCustomCallThunk(op);
   }
@@ -5612,6 +5680,24 @@ Status IrEmitterUnnested::EmitCrossMeshAllReduceTarget(mlir::Operation* op) {
   return OkStatus();
 }
 
+Status IrEmitterUnnested::EmitRaggedAllToAllThunk(mlir::Operation* op) {
+  auto custom_call = mlir::cast<mlir::lmhlo::CustomCallOp>(op);
+  TF_ASSIGN_OR_RETURN(NcclRaggedAllToAllConfig config,
+                      NcclRaggedAllToAllThunk::GetNcclRaggedAllToAllConfig(
+                          custom_call));
+  TF_ASSIGN_OR_RETURN(auto all_buffers, CustomCallParseBuffers(op));
+  Slices& operands = all_buffers.first;
+  Slices& results = all_buffers.second;
+  NcclCollectiveThunk::Buffer data;
+  data.element_count =
+      ShapeUtil::ElementsIn(GetShape(custom_call.getArgs()[0]));
+  data.source_buffer = *operands[0];
+  data.destination_buffer = *results[0];
+  AddThunkToThunkSequence(std::make_unique<NcclRaggedAllToAllThunk>(
+      GetThunkInfo(op), std::move(config), data, *operands[1], *results[1]));
+  return OkStatus();
+}
+
 Status IrEmitterUnnested::EmitDoneEventThunk(mlir::Operation* op) {
   auto custom_call = mlir::cast<mlir::lmhlo::CustomCallOp>(op);
   int64_t output_index = std::stoll(custom_call.getBackendConfig().str());
@@ -792,6 +792,7 @@ class IrEmitterUnnested : public IrEmitter {
   Status EmitMemZeroThunk(mlir::Operation* op);
   Status EmitDoneEventThunk(mlir::Operation* op);
   Status EmitCrossMeshAllReduceTarget(mlir::Operation* op);
+  Status EmitRaggedAllToAllThunk(mlir::Operation* op);
   Status EmitRngGetAndUpdateStateThunk(mlir::Operation* op);
   using Slices = std::vector<CustomCallThunk::OptionalSlice>;
   StatusOr<std::pair<Slices, Slices>> CustomCallParseBuffers(
@@ -67,6 +67,9 @@ Status KernelThunk::Initialize(const GpuExecutable& executable,
         CreateKernel(kernel_name_, args_.size(), executable.text(),
                      executable.binary(), executor));
 
+    launch_cache_.emplace(executor,
+                          std::make_unique<PreparedKernelLaunch>(
+                              kernel.get(), args_.size(), launch_dimensions_));
     kernel_cache_.emplace(executor, std::move(kernel));
   }
 
@@ -91,36 +94,36 @@ static void PrintBufferContents(
 }
 
 Status KernelThunk::ExecuteOnStream(const ExecuteParams& params) {
-  // Load the kernel.
   se::StreamExecutor* executor = params.stream->parent();
-  LaunchDimensions launch_dimensions;
-  const se::KernelBase* kernel = nullptr;
-
-  {
-    absl::MutexLock lock(&mutex_);
-    auto it = kernel_cache_.find(executor);
-    CHECK(it != kernel_cache_.end())
-        << "Initialize() not called for StreamExecutor " << executor;
-    launch_dimensions = launch_dimensions_;
-    kernel = it->second.get();
-  }
 
-  VLOG(3) << "Launching " << kernel->name();
-  absl::InlinedVector<se::DeviceMemoryBase, 4> buffer_args;
-  for (const BufferAllocation* arg : args_) {
-    se::DeviceMemoryBase buf =
-        params.buffer_allocations->GetDeviceAddress(arg->index());
-    VLOG(3) << "  Arg: alloc #" << arg->index() << ": " << buf.opaque() << "  ("
-            << buf.size() << "B)";
-    buffer_args.push_back(buf);
+  if (VLOG_IS_ON(3)) {
+    absl::InlinedVector<se::DeviceMemoryBase, 4> buffer_args;
+    VLOG(3) << "Launching " << kernel_name_;
+    for (const BufferAllocation* arg : args_) {
+      se::DeviceMemoryBase buf =
+          params.buffer_allocations->GetDeviceAddress(arg->index());
+      VLOG(3) << "  Arg: alloc #" << arg->index() << ": " << buf.opaque()
+              << "  (" << buf.size() << "B)";
+      buffer_args.push_back(buf);
+    }
+    if (VLOG_IS_ON(100)) {
+      PrintBufferContents(params.stream, buffer_args);
+    }
   }
 
-  if (VLOG_IS_ON(100)) {
-    PrintBufferContents(params.stream, buffer_args);
+  // The prepared launch is shared by concurrent executions on the same
+  // executor, so its arguments are set and launched under the lock. The
+  // driver copies the arguments at launch time.
+  absl::MutexLock lock(&mutex_);
+  auto it = launch_cache_.find(executor);
+  CHECK(it != launch_cache_.end())
+      << "Initialize() not called for StreamExecutor " << executor;
+  PreparedKernelLaunch& launch = *it->second;
+  for (int i = 0; i < args_.size(); ++i) {
+    launch.SetArgument(
+        i, params.buffer_allocations->GetDeviceAddress(args_[i]->index()));
   }
-
-  return ExecuteKernelOnStream(*kernel, buffer_args, launch_dimensions,
-                               params.stream);
+  return launch.Launch(params.stream);
 }
 
 }  // namespace gpu
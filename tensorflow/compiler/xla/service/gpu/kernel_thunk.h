@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/buffer_assignment.h"
 #include "tensorflow/compiler/xla/service/gpu/buffer_allocations.h"
 #include "tensorflow/compiler/xla/service/gpu/launch_dimensions.h"
+#include "tensorflow/compiler/xla/service/gpu/stream_executor_util.h"
 #include "tensorflow/compiler/xla/service/gpu/thunk.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/stream_executor/stream_executor.h"
@@ -95,6 +96,12 @@ class KernelThunk : public Thunk {
   // values.
   absl::flat_hash_map<se::StreamExecutor*, std::unique_ptr<se::KernelBase>>
       kernel_cache_ ABSL_GUARDED_BY(mutex_);
+
+  // Added by Alpa. Prepared launches of the kernels in kernel_cache_, so that
+  // ExecuteOnStream() only writes the buffer addresses before launching.
+  absl::flat_hash_map<se::StreamExecutor*,
+                      std::unique_ptr<PreparedKernelLaunch>>
+      launch_cache_ ABSL_GUARDED_BY(mutex_);
 };
 
 }  // namespace gpu
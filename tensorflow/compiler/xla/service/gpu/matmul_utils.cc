@@ -295,12 +295,13 @@ StatusOr<bool> CanFoldTransposeOperandIntoDot(const HloInstruction& dot,
     case C64:
     case C128:
       break;
+    case S8:  // Added by Alpa
     case S32:
       TF_RET_CHECK(alpha_imag == 0);
       if (lhs_layout.dtype != PrimitiveType::S8 ||
           rhs_layout.dtype != PrimitiveType::S8) {
         return InternalError(
-            "For int32 gemm output only int8 input is supported, got input: "
+            "For integer gemm output only int8 input is supported, got input: "
             "%s, %s",
             primitive_util::LowercasePrimitiveTypeName(lhs_layout.dtype),
             primitive_util::LowercasePrimitiveTypeName(rhs_layout.dtype));
@@ -395,6 +396,7 @@ StatusOr<se::blas::ComputationType> GetBlasComputationType(
     case F64:  // fall-through
     case C128:
       return se::blas::ComputationType::kF64;
+    case S8:  // The int8 output of a requantized int8 matmul.
     case S32:
       return se::blas::ComputationType::kI32;
     default:
@@ -558,6 +560,12 @@ Status RunGemm(const GemmConfig& config, se::DeviceMemoryBase lhs_buffer,
   }
 }
 
+bool EpilogueAddsVectorBias(GemmBackendConfig::Epilogue epilogue) {
+  return epilogue == GemmBackendConfig::BIAS ||
+         epilogue == GemmBackendConfig::BIAS_RELU ||
+         epilogue == GemmBackendConfig::BIAS_GELU;
+}
+
 #if GOOGLE_CUDA
 
 namespace {
@@ -576,6 +584,11 @@ StatusOr<se::blas::DataType> AsBlasDataType(PrimitiveType dtype) {
       return se::blas::DataType::kComplexFloat;
     case C128:
       return se::blas::DataType::kComplexDouble;
+    // Added by Alpa
+    case S8:
+      return se::blas::DataType::kInt8;
+    case S32:
+      return se::blas::DataType::kInt32;
     default:
       return InternalError("unsupported type");
   }
@@ -605,6 +618,34 @@ StatusOr<se::cuda::BlasLt::Epilogue> AsBlasLtEpilogue(
       return se::cuda::BlasLt::Epilogue::kDefault;
     case mlir::lmhlo_gpu::CublasLtMatmulEpilogue::Bias:
       return se::cuda::BlasLt::Epilogue::kBias;
+    case mlir::lmhlo_gpu::CublasLtMatmulEpilogue::Relu:
+      return se::cuda::BlasLt::Epilogue::kReLU;
+    case mlir::lmhlo_gpu::CublasLtMatmulEpilogue::BiasRelu:
+      return se::cuda::BlasLt::Epilogue::kBiasThenReLU;
+    case mlir::lmhlo_gpu::CublasLtMatmulEpilogue::Gelu:
+      return se::cuda::BlasLt::Epilogue::kGeLU;
+    case mlir::lmhlo_gpu::CublasLtMatmulEpilogue::BiasGelu:
+      return se::cuda::BlasLt::Epilogue::kBiasThenGeLUApproximate;
+    default:
+      return InternalError("unknown epilogue");
+  }
+}
+
+StatusOr<se::cuda::BlasLt::Epilogue> AsBlasLtEpilogue(
+    GemmBackendConfig::Epilogue epilogue) {
+  switch (epilogue) {
+    case GemmBackendConfig::DEFAULT:
+      return se::cuda::BlasLt::Epilogue::kDefault;
+    case GemmBackendConfig::BIAS:
+      return se::cuda::BlasLt::Epilogue::kBias;
+    case GemmBackendConfig::RELU:
+      return se::cuda::BlasLt::Epilogue::kReLU;
+    case GemmBackendConfig::BIAS_RELU:
+      return se::cuda::BlasLt::Epilogue::kBiasThenReLU;
+    case GemmBackendConfig::GELU:
+      return se::cuda::BlasLt::Epilogue::kGeLU;
+    case GemmBackendConfig::BIAS_GELU:
+      return se::cuda::BlasLt::Epilogue::kBiasThenGeLUApproximate;
     default:
       return InternalError("unknown epilogue");
   }
@@ -685,7 +726,7 @@ StatusOr<se::cuda::BlasLt::Epilogue> AsBlasLtEpilogue(
       config.alpha, config.beta, must_swap_operands};
 }
 
-template <typename Input, typename Scale>
+template <typename Input, typename Scale, typename Output>
 Status MatmulPlan::DoMatmul(se::Stream* stream, se::DeviceMemoryBase a_buffer,
                             se::DeviceMemoryBase b_buffer,
                             se::DeviceMemoryBase c_buffer,
@@ -707,13 +748,13 @@ Status MatmulPlan::DoMatmul(se::Stream* stream, se::DeviceMemoryBase a_buffer,
 
   Scale beta = static_cast<Scale>(beta_);
 
-  se::DeviceMemory<Input> output(d_buffer);
+  se::DeviceMemory<Output> output(d_buffer);
   return blas_lt->DoMatmul(
       stream, plan_, se::HostOrDeviceScalar<Scale>(alpha),
       se::DeviceMemory<Input>(a_buffer), se::DeviceMemory<Input>(b_buffer),
-      se::HostOrDeviceScalar<Scale>(beta), se::DeviceMemory<Input>(c_buffer),
+      se::HostOrDeviceScalar<Scale>(beta), se::DeviceMemory<Output>(c_buffer),
       output, algorithm, scratch_allocator,
-      se::DeviceMemory<Input>(bias_buffer), profile_result);
+      se::DeviceMemory<Output>(bias_buffer), profile_result);
 }
 
 Status MatmulPlan::ExecuteOnStream(
@@ -752,6 +793,17 @@ Status MatmulPlan::ExecuteOnStream(
       return DoMatmul<complex128>(stream, a_buffer, b_buffer, c_buffer,
                                   d_buffer, bias_buffer, algorithm,
                                   scratch_allocator, profile_result);
+    // Added by Alpa
+    // int8 matmuls accumulate in int32, and are scaled in f32 when they are
+    // requantized to int8.
+    case CUDA_R_32I:
+      return DoMatmul<int8_t, int32_t, int32_t>(
+          stream, a_buffer, b_buffer, c_buffer, d_buffer, bias_buffer,
+          algorithm, scratch_allocator, profile_result);
+    case CUDA_R_8I:
+      return DoMatmul<int8_t, float, int8_t>(
+          stream, a_buffer, b_buffer, c_buffer, d_buffer, bias_buffer,
+          algorithm, scratch_allocator, profile_result);
     default:
       return InternalError("Unexpected dtype");
   }
@@ -23,6 +23,7 @@ limitations under the License.
 
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/mlir_hlo/include/mlir-hlo/Dialect/lhlo_gpu/IR/lhlo_gpu_ops.h"
+#include "tensorflow/compiler/xla/service/gpu/backend_configs.pb.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/shape.h"
 #include "tensorflow/compiler/xla/statusor.h"
@@ -117,6 +118,10 @@ Status RunGemm(const GemmConfig& config, se::DeviceMemoryBase lhs_buffer,
                std::optional<se::blas::AlgorithmType> algorithm = std::nullopt,
                se::blas::ProfileResult* profile_result = nullptr);
 
+// Added by Alpa
+// Whether the cublasLt epilogue reads a bias vector operand.
+bool EpilogueAddsVectorBias(GemmBackendConfig::Epilogue epilogue);
+
 #if GOOGLE_CUDA
 
 namespace cublas_lt {
@@ -124,6 +129,10 @@ namespace cublas_lt {
 StatusOr<se::cuda::BlasLt::Epilogue> AsBlasLtEpilogue(
     mlir::lmhlo_gpu::CublasLtMatmulEpilogue epilogue);
 
+// Added by Alpa
+StatusOr<se::cuda::BlasLt::Epilogue> AsBlasLtEpilogue(
+    GemmBackendConfig::Epilogue epilogue);
+
 class MatmulPlan {
  public:
   static StatusOr<MatmulPlan> For(mlir::lmhlo_gpu::CublasLtMatmulOp op);
@@ -150,7 +159,7 @@ class MatmulPlan {
         beta_(beta),
         must_swap_operands_(must_swap_operands) {}
 
-  template <typename Input, typename Scale = Input>
+  template <typename Input, typename Scale = Input, typename Output = Input>
   Status DoMatmul(se::Stream* stream, se::DeviceMemoryBase a_buffer,
                   se::DeviceMemoryBase b_buffer, se::DeviceMemoryBase c_buffer,
                   se::DeviceMemoryBase d_buffer,
@@ -520,7 +520,8 @@ Status CrossMeshNcclAllReduceThunk::ExecuteOnStream(
   // TODO(yonghao): support CrossMeshNcclAllReduce for different mesh groups as
   // above using participants info created at compile time
   int device_ordinal = params.stream->parent()->device_ordinal();
-  NcclComm::Lock comm = alpa::GetCommunicator(key_, device_ordinal);
+  TF_ASSIGN_OR_RETURN(NcclComm::Lock comm,
+                      alpa::GetCommunicator(key_, device_ordinal));
 
   se::Stream& stream = *params.stream;
   TF_ASSIGN_OR_RETURN(
@@ -23,11 +23,14 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
 #include "tensorflow/compiler/xla/layout_util.h"
 #include "tensorflow/compiler/xla/service/gpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
 #include "tensorflow/compiler/xla/service/hlo_instructions.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
 
@@ -172,5 +175,167 @@ Status RunAllToAll(bool has_split_dimension,
 #endif  // XLA_ENABLE_XCCL
 }
 
+// Added by Alpa
+/*static*/ StatusOr<NcclRaggedAllToAllConfig>
+NcclRaggedAllToAllThunk::GetNcclRaggedAllToAllConfig(
+    mlir::lmhlo::CustomCallOp op) {
+  TF_RET_CHECK(op.getArgs().size() == 2 && op.getOutput().size() == 2)
+      << "Ragged all-to-all takes data and send counts, and returns the "
+         "received data and receive counts.";
+  const Shape input_shape = GetShape(op.getArgs()[0]);
+  const Shape output_shape = GetShape(op.getOutput()[0]);
+  TF_RET_CHECK(input_shape.rank() >= 1 && output_shape.rank() >= 1);
+  TF_RET_CHECK(input_shape.element_type() == output_shape.element_type());
+  TF_RET_CHECK(GetShape(op.getArgs()[1]).element_type() == S32 &&
+               GetShape(op.getOutput()[1]).element_type() == S32);
+
+  std::vector<std::string> fields =
+      absl::StrSplit(op.getBackendConfig().str(), absl::MaxSplits(';', 1));
+  int64_t channel_id;
+  if (fields.size() != 2 || !absl::SimpleAtoi(fields[0], &channel_id)) {
+    return InvalidArgument(
+        "Invalid ragged all-to-all backend config \"%s\", expected "
+        "\"<channel_id>;<replica_groups>\".",
+        op.getBackendConfig().str());
+  }
+
+  NcclRaggedAllToAllConfig config;
+  config.config.operand_count = 1;
+  config.config.operand_element_type = {input_shape.element_type()};
+  TF_ASSIGN_OR_RETURN(config.config.replica_groups,
+                      ParseReplicaGroupsOnly(fields[1]));
+  config.config.collective_op_kind = RendezvousKey::kCrossModule;
+  config.config.op_id = channel_id;
+  config.config.group_mode = CollectiveOpGroupMode::kFlattenedID;
+  config.row_elements =
+      ShapeUtil::ElementsIn(input_shape) / input_shape.dimensions(0);
+  TF_RET_CHECK(ShapeUtil::ElementsIn(output_shape) ==
+               config.row_elements * output_shape.dimensions(0))
+      << "Ragged all-to-all input and output rows differ.";
+  config.num_input_rows = input_shape.dimensions(0);
+  config.num_output_rows = output_shape.dimensions(0);
+  return config;
+}
+
+NcclRaggedAllToAllThunk::NcclRaggedAllToAllThunk(
+    ThunkInfo thunk_info, NcclRaggedAllToAllConfig config, Buffer data,
+    BufferAllocation::Slice send_counts, BufferAllocation::Slice recv_counts)
+    : NcclCollectiveThunk(Thunk::kNcclRaggedAllToAll, thunk_info),
+      config_(std::move(config)),
+      data_(std::move(data)),
+      send_counts_(send_counts),
+      recv_counts_(recv_counts) {}
+
+Status NcclRaggedAllToAllThunk::RunNcclCollective(const ExecuteParams& params,
+                                                  ncclComm_t comm) {
+  TF_ASSIGN_OR_RETURN(
+      std::vector<DeviceBufferPair> device_buffers,
+      ConvertToDeviceBuffers(params, {data_},
+                             config_.config.operand_element_type));
+  return RunRaggedAllToAll(
+      config_, device_buffers[0],
+      params.buffer_allocations->GetDeviceAddress(send_counts_),
+      params.buffer_allocations->GetDeviceAddress(recv_counts_),
+      *params.stream, comm);
+}
+
+Status RunRaggedAllToAll(const NcclRaggedAllToAllConfig& config,
+                         DeviceBufferPair& data,
+                         se::DeviceMemoryBase send_counts,
+                         se::DeviceMemoryBase recv_counts, se::Stream& stream,
+                         ncclComm_t comm) {
+#if XLA_ENABLE_XCCL
+  int device_ordinal = stream.parent()->device_ordinal();
+  VLOG(3) << "Performing ragged all-to-all from device ordinal: "
+          << device_ordinal;
+
+  se::gpu::GpuStreamHandle gpu_stream = se::gpu::AsGpuStreamValue(&stream);
+
+  int num_participants;
+  XLA_CUDA_RETURN_IF_ERROR(ncclCommCount(comm, &num_participants));
+  const int64_t counts_bytes = num_participants * sizeof(int32_t);
+  TF_RET_CHECK(send_counts.size() == counts_bytes &&
+               recv_counts.size() == counts_bytes)
+      << "Ragged all-to-all needs one count per participant.";
+
+  // Exchange the row counts, and copy them to the host to issue the sends and
+  // receives of the rows.
+  const int32_t* send_counts_ptr =
+      static_cast<const int32_t*>(send_counts.opaque());
+  int32_t* recv_counts_ptr = static_cast<int32_t*>(recv_counts.opaque());
+  XLA_CUDA_RETURN_IF_ERROR(ncclGroupStart());
+  for (int rank = 0; rank < num_participants; ++rank) {
+    XLA_CUDA_RETURN_IF_ERROR(ncclSend(send_counts_ptr + rank, 1, ncclInt32,
+                                      rank, comm, gpu_stream));
+    XLA_CUDA_RETURN_IF_ERROR(ncclRecv(recv_counts_ptr + rank, 1, ncclInt32,
+                                      rank, comm, gpu_stream));
+  }
+  XLA_CUDA_RETURN_IF_ERROR(ncclGroupEnd());
+
+  std::vector<int32_t> host_send_counts(num_participants);
+  std::vector<int32_t> host_recv_counts(num_participants);
+  stream.ThenMemcpy(host_send_counts.data(), send_counts, counts_bytes);
+  stream.ThenMemcpy(host_recv_counts.data(), recv_counts, counts_bytes);
+  TF_RETURN_IF_ERROR(stream.BlockHostUntilDone());
+
+  int64_t num_send_rows = 0;
+  int64_t num_recv_rows = 0;
+  for (int rank = 0; rank < num_participants; ++rank) {
+    TF_RET_CHECK(host_send_counts[rank] >= 0 && host_recv_counts[rank] >= 0);
+    num_send_rows += host_send_counts[rank];
+    num_recv_rows += host_recv_counts[rank];
+  }
+  if (num_send_rows > config.num_input_rows ||
+      num_recv_rows > config.num_output_rows) {
+    return InvalidArgument(
+        "Ragged all-to-all sends %d of %d rows and receives %d rows into %d "
+        "rows.",
+        num_send_rows, config.num_input_rows, num_recv_rows,
+        config.num_output_rows);
+  }
+
+  TF_ASSIGN_OR_RETURN(auto dtype_and_multiplier,
+                      ToNcclDataTypeAndCountMultiplier(data.element_type));
+  ncclDataType_t dtype = dtype_and_multiplier.first;
+  const int64_t row_count = config.row_elements * dtype_and_multiplier.second;
+  const int64_t row_bytes =
+      config.row_elements *
+      ShapeUtil::ByteSizeOfPrimitiveType(data.element_type);
+  const uint8_t* send_buffer =
+      static_cast<const uint8_t*>(data.source_buffer.opaque());
+  uint8_t* recv_buffer =
+      static_cast<uint8_t*>(data.destination_buffer.opaque());
+
+  int64_t send_offset = 0;
+  int64_t recv_offset = 0;
+  XLA_CUDA_RETURN_IF_ERROR(ncclGroupStart());
+  for (int rank = 0; rank < num_participants; ++rank) {
+    if (host_send_counts[rank] > 0) {
+      XLA_CUDA_RETURN_IF_ERROR(
+          ncclSend(send_buffer + send_offset * row_bytes,
+                   host_send_counts[rank] * row_count, dtype, rank, comm,
+                   gpu_stream));
+    }
+    if (host_recv_counts[rank] > 0) {
+      XLA_CUDA_RETURN_IF_ERROR(
+          ncclRecv(recv_buffer + recv_offset * row_bytes,
+                   host_recv_counts[rank] * row_count, dtype, rank, comm,
+                   gpu_stream));
+    }
+    send_offset += host_send_counts[rank];
+    recv_offset += host_recv_counts[rank];
+  }
+  XLA_CUDA_RETURN_IF_ERROR(ncclGroupEnd());
+
+  VLOG(3) << "Done performing ragged all-to-all for ordinal: "
+          << device_ordinal;
+  return OkStatus();
+#else   // XLA_ENABLE_XCCL
+  return Unimplemented(
+      "NCCL support is not available: this binary was not built with a CUDA "
+      "compiler, which is necessary to build the NCCL source library.");
+#endif  // XLA_ENABLE_XCCL
+}
+
 }  // namespace gpu
 }  // namespace xla
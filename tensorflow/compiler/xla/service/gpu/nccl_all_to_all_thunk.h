@@ -69,6 +69,57 @@ Status RunAllToAll(bool has_split_dimension,
                    std::vector<DeviceBufferPair>& buffers, se::Stream& stream,
                    ncclComm_t comm);
 
+// Added by Alpa
+struct NcclRaggedAllToAllConfig {
+  NcclCollectiveConfig config;
+  // Number of elements in one row, i.e. in all but the major dimension.
+  int64_t row_elements;
+  int64_t num_input_rows;
+  int64_t num_output_rows;
+};
+
+// Thunk for the kBuiltinRaggedAllToAllTarget custom call, an all-to-all with
+// per-peer row counts that are only known on the device. Its operands are
+//   - data[R, ...], with the rows sent to every peer packed in rank order,
+//   - send_counts s32[P], the number of rows sent to every peer,
+// and its results are
+//   - output[R', ...], with the rows received from every peer packed in rank
+//     order; the rows after them are left unchanged,
+//   - recv_counts s32[P], the number of rows received from every peer.
+// The backend config is "<channel_id>;<replica_groups>", with replica groups of
+// global device ids, e.g. "1;{{0,1,2,3}}".
+//
+// The counts are exchanged first and copied to the host, which synchronizes
+// the stream, and then only the routed rows are sent.
+class NcclRaggedAllToAllThunk : public NcclCollectiveThunk {
+ public:
+  NcclRaggedAllToAllThunk(ThunkInfo thunk_info,
+                          NcclRaggedAllToAllConfig config, Buffer data,
+                          BufferAllocation::Slice send_counts,
+                          BufferAllocation::Slice recv_counts);
+
+  static StatusOr<NcclRaggedAllToAllConfig> GetNcclRaggedAllToAllConfig(
+      mlir::lmhlo::CustomCallOp op);
+
+ protected:
+  Status RunNcclCollective(const ExecuteParams& params,
+                           ncclComm_t comm) override;
+
+  const NcclCollectiveConfig& config() const override { return config_.config; }
+
+ private:
+  const NcclRaggedAllToAllConfig config_;
+  const Buffer data_;
+  const BufferAllocation::Slice send_counts_;
+  const BufferAllocation::Slice recv_counts_;
+};
+
+Status RunRaggedAllToAll(const NcclRaggedAllToAllConfig& config,
+                         DeviceBufferPair& data,
+                         se::DeviceMemoryBase send_counts,
+                         se::DeviceMemoryBase recv_counts, se::Stream& stream,
+                         ncclComm_t comm);
+
 }  // namespace gpu
 }  // namespace xla
 
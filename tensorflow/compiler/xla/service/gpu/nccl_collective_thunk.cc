@@ -152,7 +152,8 @@ StatusOr<NcclComm::Lock> LockNcclComm(
   se::gpu::ScopedActivateExecutorContext scoped_context(executor);
 
   return AcquireNcclComm(params.run_id, OpId(op_id), std::move(participants),
-                         num_local_participants, *unique_id_callback, rank);
+                         num_local_participants, *unique_id_callback, rank,
+                         params.nccl_comm_cache);
 }
 #endif  // XLA_ENABLE_XCCL
 
@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/gpu/nccl_utils.h"
 
 #include <memory>
+#include <optional>
 #include <string_view>
 #include <utility>
 
@@ -189,6 +190,25 @@ void CheckNcclAsyncError(NcclComm& lockable_comm) {
   if (!status.ok()) LOG(ERROR) << status.ToString();
 }
 
+// The communicators lent by RegisterSharedNcclComm().
+struct SharedNcclComms {
+  absl::Mutex mu;
+  absl::flat_hash_map<std::pair<NcclCliqueKey, int>, NcclComm*> comms
+      ABSL_GUARDED_BY(mu);
+};
+
+SharedNcclComms& GetSharedNcclComms() {
+  static auto& shared_comms = *new SharedNcclComms;
+  return shared_comms;
+}
+
+// Returns a lock on a communicator of `comm_cache` that leaves it locked when
+// released.
+NcclComm::Lock BorrowCachedNcclComm(const std::shared_ptr<void>& cached) {
+  return NcclComm::Lock(static_cast<NcclComm::Lock*>(cached.get())->get(),
+                        [](ncclComm_t*) {});
+}
+
 }  // namespace
 
 StatusOr<std::pair<ncclDataType_t, int>> ToNcclDataTypeAndCountMultiplier(
@@ -223,10 +243,41 @@ StatusOr<const NcclUniqueIdCallback*> GetNcclUniqueIdCallback(
 StatusOr<NcclComm::Lock> AcquireNcclComm(
     RunId run_id, OpId op_id, std::vector<GlobalDeviceId> participants,
     size_t num_local_participants,
-    const NcclUniqueIdCallback& unique_id_callback, int rank) {
+    const NcclUniqueIdCallback& unique_id_callback, int rank,
+    NcclCommCache* comm_cache) {
+  NcclCliqueKey clique_key(std::move(participants));
+  if (comm_cache != nullptr) {
+    auto it = comm_cache->comms.find(clique_key);
+    if (it != comm_cache->comms.end()) {
+      return BorrowCachedNcclComm(it->second);
+    }
+  }
+
+  // Added by Alpa
+  // Use the communicator of the clique lent by its owner, if any, without a
+  // rendezvous: the owner orders the operations on it. The registry stays
+  // locked while waiting for the communicator, so that it is not
+  // unregistered and destroyed meanwhile.
+  std::optional<NcclComm::Lock> shared_comm;
+  {
+    SharedNcclComms& shared_comms = GetSharedNcclComms();
+    absl::MutexLock lock(&shared_comms.mu);
+    auto it = shared_comms.comms.find(std::make_pair(clique_key, rank));
+    if (it != shared_comms.comms.end()) {
+      shared_comm = it->second->Acquire();
+    }
+  }
+  if (shared_comm.has_value()) {
+    if (comm_cache != nullptr) {
+      auto cached = std::make_shared<NcclComm::Lock>(std::move(*shared_comm));
+      comm_cache->comms[clique_key] = cached;
+      return BorrowCachedNcclComm(cached);
+    }
+    return std::move(*shared_comm);
+  }
+
   // Ensure that this group of threads have exclusive access to the clique to
   // prevent threads from different groups locking communicators in the clique.
-  NcclCliqueKey clique_key(std::move(participants));
   std::shared_ptr<StatusOr<NcclClique::Lock>> clique = AcquireNcclClique(
       run_id, op_id, clique_key, unique_id_callback, num_local_participants);
 
@@ -292,7 +343,25 @@ StatusOr<NcclComm::Lock> AcquireNcclComm(
   if (!state.status.ok()) {
     return state.status;
   }
+  if (comm_cache != nullptr) {
+    auto cached = std::make_shared<NcclComm::Lock>(std::move(comm));
+    comm_cache->comms[clique_key] = cached;
+    return BorrowCachedNcclComm(cached);
+  }
   return comm;
 }
+
+void RegisterSharedNcclComm(const NcclCliqueKey& clique_key, int rank,
+                            NcclComm* comm) {
+  SharedNcclComms& shared_comms = GetSharedNcclComms();
+  absl::MutexLock lock(&shared_comms.mu);
+  shared_comms.comms[std::make_pair(clique_key, rank)] = comm;
+}
+
+void UnregisterSharedNcclComm(const NcclCliqueKey& clique_key, int rank) {
+  SharedNcclComms& shared_comms = GetSharedNcclComms();
+  absl::MutexLock lock(&shared_comms.mu);
+  shared_comms.comms.erase(std::make_pair(clique_key, rank));
+}
 }  // namespace gpu
 }  // namespace xla
@@ -118,7 +118,18 @@ struct NcclComm : public Lockable<ncclComm_t> {
 StatusOr<NcclComm::Lock> AcquireNcclComm(
     RunId run_id, OpId op_id, std::vector<GlobalDeviceId> participants,
     size_t num_local_participants,
-    const NcclUniqueIdCallback& unique_id_callback, int rank);
+    const NcclUniqueIdCallback& unique_id_callback, int rank,
+    NcclCommCache* comm_cache = nullptr);  // Added by Alpa. may be null
+
+// Added by Alpa. Lends `comm`, the communicator of `rank` in the clique of
+// `clique_key`, to the collectives of XLA executables, which then use it
+// instead of creating another communicator over the same devices. The owner
+// keeps `comm` alive until UnregisterSharedNcclComm() returns, and orders its
+// own operations on `comm` with the streams of the executables, since NCCL
+// does not order operations issued on different streams.
+void RegisterSharedNcclComm(const NcclCliqueKey& clique_key, int rank,
+                            NcclComm* comm);
+void UnregisterSharedNcclComm(const NcclCliqueKey& clique_key, int rank);
 
 }  // namespace gpu
 }  // namespace xla
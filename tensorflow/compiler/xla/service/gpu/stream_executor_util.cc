@@ -367,6 +367,43 @@ Status ExecuteKernelOnStream(const se::KernelBase& kernel,
       *kernel_args);
 }
 
+template <int n>
+static void SetKernelArg(se::KernelArgsArrayBase* kernel_args, int index,
+                         se::DeviceMemoryBase buffer) {
+  static_cast<se::KernelArgsArray<n>*>(kernel_args)
+      ->set_device_memory_argument(index, buffer);
+}
+
+PreparedKernelLaunch::PreparedKernelLaunch(const se::KernelBase* kernel,
+                                           int num_args,
+                                           const LaunchDimensions& dims)
+    : kernel_(kernel) {
+  static constexpr int kKernelArgsLimit = 1024;
+  // Pack placeholder arguments once; launches only overwrite their
+  // addresses.
+  std::vector<se::DeviceMemoryBase> args(num_args);
+  if (num_args <= 64) {
+    kernel_args_ = MakeKernelArgs<64>(args);
+    set_argument_ = &SetKernelArg<64>;
+  } else if (num_args <= 256) {
+    kernel_args_ = MakeKernelArgs<256>(args);
+    set_argument_ = &SetKernelArg<256>;
+  } else {
+    kernel_args_ = MakeKernelArgs<kKernelArgsLimit>(args);
+    set_argument_ = &SetKernelArg<kKernelArgsLimit>;
+  }
+  LaunchDimensions::Dim3D thread_counts = dims.thread_counts_per_block();
+  LaunchDimensions::Dim3D block_counts = dims.block_counts();
+  thread_dims_ = se::ThreadDim(thread_counts.x, thread_counts.y,
+                               thread_counts.z);
+  block_dims_ = se::BlockDim(block_counts.x, block_counts.y, block_counts.z);
+}
+
+Status PreparedKernelLaunch::Launch(se::Stream* stream) const {
+  return stream->parent()->Launch(stream, thread_dims_, block_dims_, *kernel_,
+                                  *kernel_args_);
+}
+
 // Unimplemented for integers yet.
 template <typename T, typename Generator>
 typename std::enable_if<std::is_integral<T>::value,
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_STREAM_EXECUTOR_UTIL_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_STREAM_EXECUTOR_UTIL_H_
 
+#include <memory>
+
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/layout.h"
@@ -87,6 +89,33 @@ Status ExecuteKernelOnStream(const se::KernelBase& kernel,
                              absl::Span<const se::DeviceMemoryBase> args,
                              const LaunchDimensions& dims, se::Stream* stream);
 
+// Added by Alpa. A launch of a loaded kernel with its launch dimensions and
+// argument array prepared once, so that launching it again only updates the
+// buffer addresses. The kernel must outlive this object.
+//
+// This is thread-compatible.
+class PreparedKernelLaunch {
+ public:
+  PreparedKernelLaunch(const se::KernelBase* kernel, int num_args,
+                       const LaunchDimensions& dims);
+
+  // Sets the buffer passed as argument `index` by the next launches.
+  void SetArgument(int index, se::DeviceMemoryBase buffer) {
+    set_argument_(kernel_args_.get(), index, buffer);
+  }
+
+  // Launches the kernel on `stream` with the arguments set so far.
+  Status Launch(se::Stream* stream) const;
+
+ private:
+  const se::KernelBase* kernel_;
+  se::ThreadDim thread_dims_;
+  se::BlockDim block_dims_;
+  std::unique_ptr<se::KernelArgsArrayBase> kernel_args_;
+  // Updates an argument of the concrete KernelArgsArray in kernel_args_.
+  void (*set_argument_)(se::KernelArgsArrayBase*, int, se::DeviceMemoryBase);
+};
+
 // Initializes `buffer` with random data on `stream`.
 // `rng_state` is an inout parameter for the pseudorandom generator state.
 // `buffer_type` determines what buffer would be filled out with.
@@ -17,6 +17,7 @@ limitations under the License.
 #include <utility>
 
 #include "absl/strings/str_replace.h"
+#include "tensorflow/compiler/xla/service/gpu/backend_configs.pb.h"
 #include "tensorflow/compiler/xla/service/gpu/gemm_rewriter.h"
 #include "tensorflow/compiler/xla/service/gpu/gpu_executable.h"
 #include "tensorflow/compiler/xla/service/gpu/stream_executor_util.h"
@@ -192,6 +193,11 @@ class ParameterizedGemmRewriteTest
     const bool kUsingCublasLt = GetParam();
     replacements_[kCustomCallTargetPlaceholder] =
         kUsingCublasLt ? "__cublas$lt$matmul" : "__cublas$gemm";
+    // cublasLt only runs int8 matmuls on Turing and newer.
+    replacements_[kInt8CustomCallTargetPlaceholder] =
+        kUsingCublasLt && GetCudaComputeCapability().IsAtLeast(7, 5)
+            ? "__cublas$lt$matmul"
+            : "__cublas$gemm";
   }
   DebugOptions GetDebugOptionsForTest() override {
     DebugOptions debug_options = GemmRewriteTest::GetDebugOptionsForTest();
@@ -207,6 +213,8 @@ class ParameterizedGemmRewriteTest
  private:
   static constexpr const char* kCustomCallTargetPlaceholder{
       "<<CUBLAS_CUSTOM_CALL_TARGET_PLACEHOLDER>>"};
+  static constexpr const char* kInt8CustomCallTargetPlaceholder{
+      "<<CUBLAS_INT8_CUSTOM_CALL_TARGET_PLACEHOLDER>>"};
   absl::flat_hash_map<absl::string_view, absl::string_view> replacements_;
 };
 
@@ -879,7 +887,7 @@ ENTRY int8gemm {
   if (GetCudaComputeCapability().IsAtLeast(se::CudaComputeCapability::VOLTA)) {
     MatchOptimizedHlo(hlo_text,
                       R"(
-; CHECK: s32[12,8]{1,0} custom-call(s8[12,4]{1,0} [[A:%[^ ]+]], s8[4,8]{0,1} [[B:%[^ ]+]]), custom_call_target="__cublas$gemm"
+; CHECK: s32[12,8]{1,0} custom-call(s8[12,4]{1,0} [[A:%[^ ]+]], s8[4,8]{0,1} [[B:%[^ ]+]]), custom_call_target="<<CUBLAS_INT8_CUSTOM_CALL_TARGET_PLACEHOLDER>>"
   )",
                       /*print_operand_shape=*/true);
   } else {
@@ -911,7 +919,7 @@ ENTRY int8gemm {
     MatchOptimizedHlo(hlo_text,
                       R"(
 ; CHECK: s32[12,8]{1,0} custom-call(s8[12,4]{1,0} [[A:%[^ ]+]], s8[4,8]{0,1} [[B:%[^ ]+]]),
-; CHECK:           custom_call_target="__cublas$gemm",
+; CHECK:           custom_call_target="<<CUBLAS_INT8_CUSTOM_CALL_TARGET_PLACEHOLDER>>",
 ; CHECK:           backend_config="{
 ; CHECK-DAG:       \"alpha_real\":1
 ; CHECK-DAG:       \"alpha_imag\":0
@@ -945,7 +953,7 @@ ENTRY int8gemm {
     MatchOptimizedHlo(hlo_text,
                       R"(
 ; CHECK: s32[12,8]{1,0} custom-call(s8[12,4]{1,0} [[A:%[^ ]+]], s8[4,8]{0,1} [[B:%[^ ]+]]),
-; CHECK:           custom_call_target="__cublas$gemm",
+; CHECK:           custom_call_target="<<CUBLAS_INT8_CUSTOM_CALL_TARGET_PLACEHOLDER>>",
 ; CHECK:           backend_config="{
 ; CHECK-DAG:       \"alpha_real\":1
 ; CHECK-DAG:       \"alpha_imag\":0
@@ -977,7 +985,7 @@ ENTRY int8gemm {
   if (GetCudaComputeCapability().IsAtLeast(se::CudaComputeCapability::VOLTA)) {
     MatchOptimizedHlo(hlo_text,
                       R"(
-; CHECK: s32[16,12]{1,0} custom-call(s8[16,4]{1,0} [[A:%[^ ]+]], s8[4,12]{0,1} [[B:%[^ ]+]]), custom_call_target="__cublas$gemm"
+; CHECK: s32[16,12]{1,0} custom-call(s8[16,4]{1,0} [[A:%[^ ]+]], s8[4,12]{0,1} [[B:%[^ ]+]]), custom_call_target="<<CUBLAS_INT8_CUSTOM_CALL_TARGET_PLACEHOLDER>>"
   )",
                       /*print_operand_shape=*/true);
   } else {
@@ -1878,6 +1886,181 @@ ENTRY test {
           m::CustomCall(m::Parameter(0), m::Parameter(1), m::Constant()))));
 }
 
+TEST_F(CublasLtGemmRewriteTest, VectorBiasThenRelu) {
+  const char* hlo_text = R"(
+HloModule test
+ENTRY test {
+  x = f32[2,3] parameter(0)
+  y = f32[3,4] parameter(1)
+  z = f32[4] parameter(2)
+  dot = f32[2,4] dot(x, y), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  z_bcast = f32[2,4] broadcast(z), dimensions={1}
+  add = f32[2,4] add(dot, z_bcast)
+  zero = f32[] constant(0)
+  zero_bcast = f32[2,4] broadcast(zero), dimensions={}
+  ROOT out = f32[2,4] maximum(add, zero_bcast)
+}
+)";
+
+  EXPECT_TRUE(RunAndCompare(hlo_text, ErrorSpec{1e-5, 1e-5}));
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_text));
+  GemmRewriter pass(GetCudaComputeCapability());
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, this->RunHloPass(&pass, module.get()));
+  EXPECT_TRUE(changed);
+
+  HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, GmockMatch(m::CustomCall("__cublas$lt$matmul",
+                                             m::Parameter(0), m::Parameter(1),
+                                             m::Parameter(2))));
+  TF_ASSERT_OK_AND_ASSIGN(auto config,
+                          root->backend_config<GemmBackendConfig>());
+  EXPECT_EQ(config.epilogue(), GemmBackendConfig::BIAS_RELU);
+}
+
+TEST_F(CublasLtGemmRewriteTest, ReluThroughConvertAndBitcast) {
+  const char* hlo_text = R"(
+HloModule test
+ENTRY test {
+  x = bf16[2,3] parameter(0)
+  y = bf16[3,4] parameter(1)
+  dot = bf16[2,4] dot(x, y), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  convert = f32[2,4] convert(dot)
+  bitcast = f32[8] bitcast(convert)
+  zero = f32[] constant(0)
+  zero_bcast = f32[8] broadcast(zero), dimensions={}
+  ROOT out = f32[8] maximum(bitcast, zero_bcast)
+}
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_text));
+  GemmRewriter pass(GetCudaComputeCapability());
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, this->RunHloPass(&pass, module.get()));
+  EXPECT_TRUE(changed);
+
+  const HloInstruction* gemm;
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              GmockMatch(m::Bitcast(m::Convert(
+                  m::CustomCall(&gemm, "__cublas$lt$matmul", m::Parameter(0),
+                                m::Parameter(1))
+                      .WithShape(BF16, {2, 4})))));
+  TF_ASSERT_OK_AND_ASSIGN(auto config,
+                          gemm->backend_config<GemmBackendConfig>());
+  EXPECT_EQ(config.epilogue(), GemmBackendConfig::RELU);
+}
+
+TEST_F(CublasLtGemmRewriteTest, ReluWithOtherUsersNotFused) {
+  const char* hlo_text = R"(
+HloModule test
+ENTRY test {
+  x = f32[2,3] parameter(0)
+  y = f32[3,4] parameter(1)
+  dot = f32[2,4] dot(x, y), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  zero = f32[] constant(0)
+  zero_bcast = f32[2,4] broadcast(zero), dimensions={}
+  relu = f32[2,4] maximum(dot, zero_bcast)
+  ROOT out = tuple(relu, dot)
+}
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_text));
+  GemmRewriter pass(GetCudaComputeCapability());
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, this->RunHloPass(&pass, module.get()));
+  EXPECT_TRUE(changed);
+
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              GmockMatch(m::Tuple(m::Maximum(m::CustomCall(), m::Broadcast()),
+                                  m::CustomCall())));
+}
+
+TEST_F(CublasLtGemmRewriteTest, VectorBiasThenApproxGelu) {
+  const char* hlo_text = R"(
+HloModule test
+ENTRY test {
+  x = f32[2,3] parameter(0)
+  y = f32[3,4] parameter(1)
+  z = f32[4] parameter(2)
+  dot = f32[2,4] dot(x, y), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  z_bcast = f32[2,4] broadcast(z), dimensions={1}
+  add = f32[2,4] add(dot, z_bcast)
+  mul.0 = f32[2,4] multiply(add, add)
+  mul.1 = f32[2,4] multiply(add, mul.0)
+  const.0 = f32[] constant(0.044715)
+  bcast.0 = f32[2,4] broadcast(const.0), dimensions={}
+  mul.2 = f32[2,4] multiply(mul.1, bcast.0)
+  add.0 = f32[2,4] add(add, mul.2)
+  const.1 = f32[] constant(0.797884583)
+  bcast.1 = f32[2,4] broadcast(const.1), dimensions={}
+  mul.3 = f32[2,4] multiply(add.0, bcast.1)
+  tanh = f32[2,4] tanh(mul.3)
+  const.2 = f32[] constant(1)
+  bcast.2 = f32[2,4] broadcast(const.2), dimensions={}
+  add.2 = f32[2,4] add(tanh, bcast.2)
+  const.3 = f32[] constant(0.5)
+  bcast.3 = f32[2,4] broadcast(const.3), dimensions={}
+  mul.4 = f32[2,4] multiply(add.2, bcast.3)
+  ROOT out = f32[2,4] multiply(add, mul.4)
+}
+)";
+
+  EXPECT_TRUE(RunAndCompare(hlo_text, ErrorSpec{1e-5, 1e-5}));
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_text));
+  GemmRewriter pass(GetCudaComputeCapability());
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, this->RunHloPass(&pass, module.get()));
+  EXPECT_TRUE(changed);
+
+  HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, GmockMatch(m::CustomCall("__cublas$lt$matmul",
+                                             m::Parameter(0), m::Parameter(1),
+                                             m::Parameter(2))));
+  TF_ASSERT_OK_AND_ASSIGN(auto config,
+                          root->backend_config<GemmBackendConfig>());
+  EXPECT_EQ(config.epilogue(), GemmBackendConfig::BIAS_GELU);
+}
+
+TEST_F(CublasLtGemmRewriteTest, Int8GemmRequantize) {
+  if (!GetCudaComputeCapability().IsAtLeast(7, 5)) {
+    GTEST_SKIP() << "cublasLt int8 matmuls need Turing or newer";
+  }
+  const char* hlo_text = R"(
+HloModule test
+ENTRY test {
+  x = s8[16,32] parameter(0)
+  y = s8[32,8] parameter(1)
+  dot = s32[16,8] dot(x, y), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  convert = f32[16,8] convert(dot)
+  scale = f32[] constant(0.125)
+  scale_bcast = f32[16,8] broadcast(scale), dimensions={}
+  scaled = f32[16,8] multiply(convert, scale_bcast)
+  round = f32[16,8] round-nearest-even(scaled)
+  lo = f32[] constant(-128)
+  lo_bcast = f32[16,8] broadcast(lo), dimensions={}
+  hi = f32[] constant(127)
+  hi_bcast = f32[16,8] broadcast(hi), dimensions={}
+  clamp = f32[16,8] clamp(lo_bcast, round, hi_bcast)
+  ROOT out = s8[16,8] convert(clamp)
+}
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_text));
+  GemmRewriter pass(GetCudaComputeCapability());
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, this->RunHloPass(&pass, module.get()));
+  EXPECT_TRUE(changed);
+
+  HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, GmockMatch(m::CustomCall("__cublas$lt$matmul",
+                                             m::Parameter(0), m::Parameter(1))
+                                   .WithShape(S8, {16, 8})));
+  TF_ASSERT_OK_AND_ASSIGN(auto config,
+                          root->backend_config<GemmBackendConfig>());
+  EXPECT_EQ(config.alpha_real(), 0.125);
+  EXPECT_EQ(config.beta(), 0);
+}
+
 class GemmRewriteAllocationTest : public GpuCodegenTest {
  public:
   void CheckNumberOfAllocations(const std::string& hlo,
@@ -0,0 +1,125 @@
+// Benchmarks of the memory-bound reduction and transpose emitters. Reports
+// the achieved bandwidth and its fraction of the peak memory bandwidth of the
+// device, e.g.,
+//   memory_bound_emitter_benchmark --benchmark_filter=all
+
+#include <memory>
+#include <utility>
+
+#include "tensorflow/compiler/xla/client/client_library.h"
+#include "tensorflow/compiler/xla/client/lib/arithmetic.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/local_client.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/stream_executor/device_memory_allocator.h"
+#include "tensorflow/tsl/platform/logging.h"
+#include "tensorflow/tsl/platform/test_benchmark.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+enum class Kind { kRowReduction, kColumnReduction, kTranspose };
+
+constexpr int64_t kRows = 8192;
+constexpr int64_t kColumns = 8192;
+
+// Runs `kind` on a [kRows, kColumns] array of `type`, and counts the bytes of
+// the input and of the output.
+void RunBenchmark(::testing::benchmark::State& state, Kind kind,
+                  PrimitiveType type) {
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().value();
+  LocalClient* client = ClientLibrary::GetOrCreateLocalClient(platform).value();
+  int device_ordinal = client->default_device_ordinal();
+  se::StreamExecutor* executor =
+      client->backend().stream_executor(device_ordinal).value();
+  se::StreamExecutorMemoryAllocator allocator(executor);
+
+  Shape shape = ShapeUtil::MakeShape(type, {kRows, kColumns});
+  XlaBuilder builder("MemoryBound");
+  XlaOp param = Parameter(&builder, 0, shape, "param");
+  switch (kind) {
+    case Kind::kRowReduction:
+      Reduce(param, Zero(&builder, type),
+             CreateScalarAddComputation(type, &builder), {1});
+      break;
+    case Kind::kColumnReduction:
+      Reduce(param, Zero(&builder, type),
+             CreateScalarAddComputation(type, &builder), {0});
+      break;
+    case Kind::kTranspose:
+      Transpose(param, {1, 0});
+      break;
+  }
+  XlaComputation computation = builder.Build().value();
+
+  ScopedShapedBuffer buffer =
+      client
+          ->LiteralToShapedBuffer(Literal::CreateFromShape(shape),
+                                  device_ordinal)
+          .value();
+  std::unique_ptr<LocalExecutable> executable =
+      std::move(client
+                    ->Compile(computation, {&buffer.on_host_shape()},
+                              ExecutableBuildOptions())
+                    .value()[0]);
+
+  auto stream = client->mutable_backend()->BorrowStream(device_ordinal).value();
+  ExecutableRunOptions run_options;
+  run_options.set_allocator(&allocator).set_stream(stream.get());
+
+  const int kWarmups = 2;
+  for (int i = 0; i < kWarmups; ++i) {
+    CHECK(executable->Run({&buffer}, run_options).ok());
+  }
+
+  const int64_t input_bytes = ShapeUtil::ByteSizeOf(shape);
+  const int64_t output_bytes =
+      kind == Kind::kTranspose ? input_bytes
+      : kind == Kind::kRowReduction
+          ? kRows * ShapeUtil::ByteSizeOfPrimitiveType(type)
+          : kColumns * ShapeUtil::ByteSizeOfPrimitiveType(type);
+  for (auto s : state) {
+    CHECK(executable->Run({&buffer}, run_options).ok());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          (input_bytes + output_bytes));
+
+  // Bytes per second.
+  double peak_bandwidth = executor->GetDeviceDescription().memory_bandwidth();
+  state.counters["fraction_of_peak"] = ::benchmark::Counter(
+      (input_bytes + output_bytes) / peak_bandwidth,
+      ::benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_RowReduction(::testing::benchmark::State& state) {
+  RunBenchmark(state, Kind::kRowReduction,
+               static_cast<PrimitiveType>(state.range(0)));
+}
+
+void BM_ColumnReduction(::testing::benchmark::State& state) {
+  RunBenchmark(state, Kind::kColumnReduction,
+               static_cast<PrimitiveType>(state.range(0)));
+}
+
+void BM_Transpose(::testing::benchmark::State& state) {
+  RunBenchmark(state, Kind::kTranspose,
+               static_cast<PrimitiveType>(state.range(0)));
+}
+
+BENCHMARK(BM_RowReduction)->Arg(F32)->Arg(F16)->Arg(BF16)->UseRealTime();
+BENCHMARK(BM_ColumnReduction)->Arg(F32)->Arg(F16)->Arg(BF16)->UseRealTime();
+BENCHMARK(BM_Transpose)->Arg(F32)->Arg(F16)->Arg(BF16)->Arg(S8)->UseRealTime();
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
+
+int main(int argc, char** argv) {
+  tsl::testing::InitializeBenchmarks(&argc, argv);
+  tsl::testing::RunBenchmarks();
+  return 0;
+}
@@ -149,6 +149,59 @@ CHECK-NOT: ld.global.v2.f32
   EXPECT_TRUE(RunAndCompare(hlo_text, ErrorSpec{1e-5, 1e-5}));
 }
 
+TEST_F(ReductionVectorizationTest, HalfRowReductionReads128Bits) {
+  const char* hlo_text = R"(
+HloModule HalfRowReduction
+
+%add_f16 {
+  %x = f16[] parameter(0)
+  %y = f16[] parameter(1)
+  ROOT %add = f16[] add(%x, %y)
+}
+
+ENTRY %main {
+  %param_0 = f16[1024,4096] parameter(0)
+  %constant_0 = f16[] constant(0)
+  ROOT %reduce = f16[1024] reduce(%param_0, %constant_0), dimensions={1}, to_apply=%add_f16
+}
+)";
+  if (!backend()
+           .default_stream_executor()
+           ->GetDeviceDescription()
+           .cuda_compute_capability()
+           .IsAtLeast(se::CudaComputeCapability::VOLTA)) {
+    GTEST_SKIP() << "Only vectorized by 128 bits since Volta.";
+  }
+  // Eight halves per load.
+  std::string expected = R"(
+CHECK: ld.global.nc.v4
+)";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<VerifiedHloModule> optimized_module,
+                          ParseAndReturnVerifiedModule(hlo_text));
+  CompileAndOptionallyVerifyPtx(std::move(optimized_module), expected);
+  EXPECT_TRUE(RunAndCompare(hlo_text, ErrorSpec{1e-2, 1e-2}));
+}
+
+TEST_F(ReductionVectorizationTest, BF16ColumnReduction) {
+  const char* hlo_text = R"(
+HloModule BF16ColumnReduction
+
+%add_f32 {
+  %x = f32[] parameter(0)
+  %y = f32[] parameter(1)
+  ROOT %add = f32[] add(%x, %y)
+}
+
+ENTRY %main {
+  %param_0 = bf16[2048,1024] parameter(0)
+  %convert = f32[2048,1024] convert(%param_0)
+  %constant_0 = f32[] constant(0)
+  ROOT %reduce = f32[1024] reduce(%convert, %constant_0), dimensions={0}, to_apply=%add_f32
+}
+)";
+  EXPECT_TRUE(RunAndCompare(hlo_text, ErrorSpec{1e-2, 1e-2}));
+}
+
 }  // namespace
 }  // namespace gpu
 }  // namespace xla
@@ -218,5 +218,44 @@ ENTRY entry {
   EXPECT_TRUE(RunAndCompareNoHloPasses(hlo, ErrorSpec{1e-3}));
 }
 
+TEST_F(TransposeEmitterTest, HalfTransposeUsesWideTiles) {
+  const char* const kHloString = R"(
+  HloModule m
+
+  ENTRY e {
+    para0 = f16[8,96,160]{2,1,0} parameter(0)
+    ROOT copy1 = f16[8,160,96]{2,1,0} transpose(para0), dimensions={0,2,1}
+  })";
+
+  // Two elements per thread and row, in 64x64 tiles, with partial tiles.
+  auto expected_ir = R"(
+; CHECK: [64 x [65 x half]]
+; CHECK: call void BARRIER()
+)";
+  CompileAndVerifyIr(kHloString, MakePlatformSpecificLlvm(expected_ir),
+                     /*match_optimized_ir=*/true,
+                     /*run_optimization_passes=*/false);
+  EXPECT_TRUE(RunAndCompareNoHloPasses(kHloString, ErrorSpec{1e-3}));
+}
+
+TEST_F(TransposeEmitterTest, FloatTransposeUsesWarpTiles) {
+  const char* const kHloString = R"(
+  HloModule m
+
+  ENTRY e {
+    para0 = f32[8,96,160]{2,1,0} parameter(0)
+    ROOT copy1 = f32[8,160,96]{2,1,0} transpose(para0), dimensions={0,2,1}
+  })";
+
+  auto expected_ir = R"(
+; CHECK: [32 x [33 x float]]
+; CHECK: call void BARRIER()
+)";
+  CompileAndVerifyIr(kHloString, MakePlatformSpecificLlvm(expected_ir),
+                     /*match_optimized_ir=*/true,
+                     /*run_optimization_passes=*/false);
+  EXPECT_TRUE(RunAndCompareNoHloPasses(kHloString, ErrorSpec{1e-3}));
+}
+
 }  // namespace
 }  // namespace xla
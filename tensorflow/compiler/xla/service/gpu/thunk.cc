@@ -85,6 +85,8 @@ Thunk::ExecuteParams::ExecuteParams(
     // Added by Alpa
     case Thunk::kRngGetAndUpdateState:
       return "kRngGetAndUpdateState";
+    case Thunk::kNcclRaggedAllToAll:
+      return "kNcclRaggedAllToAll";
     default:
       LOG(FATAL) << "Invalid thunk kind: " << kind;
   }
@@ -74,6 +74,7 @@ class Thunk {
     // Added by Alpa
     kDoneEvent,
     kRngGetAndUpdateState,
+    kNcclRaggedAllToAll,
   };
 
   struct ThunkInfo {
@@ -0,0 +1,244 @@
+#include "tensorflow/compiler/xla/service/gpu/thunk_stream_assignment.h"
+
+#include <algorithm>
+
+#include "absl/algorithm/container.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "llvm/ADT/SmallVector.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"  // from @llvm-project
+#include "tensorflow/compiler/xla/mlir_hlo/include/mlir-hlo/Dialect/lhlo/IR/lhlo_ops.h"
+#include "tensorflow/compiler/xla/service/gpu/ir_emission_utils.h"
+#include "tensorflow/tsl/platform/logging.h"
+
+namespace xla {
+namespace gpu {
+
+namespace {
+
+using Placement = ThunkBufferUses::Placement;
+
+Placement GetPlacement(Thunk::Kind kind) {
+  switch (kind) {
+    case Thunk::kCopy:
+    case Thunk::kDoneEvent:
+    case Thunk::kGemm:
+    case Thunk::kKernel:
+    case Thunk::kMemset32BitValue:
+    case Thunk::kMemzero:
+    case Thunk::kPartitionId:
+    case Thunk::kReplicaId:
+    case Thunk::kRngGetAndUpdateState:
+    case Thunk::kTriangularSolve:
+      return Placement::kAnyStream;
+    // These allocate scratch memory at run time.
+    case Thunk::kCholesky:
+    case Thunk::kConvolution:
+    case Thunk::kCublasLtMatmul:
+    case Thunk::kCustomCall:
+    case Thunk::kFft:
+      return Placement::kMainStream;
+    default:
+      return Placement::kBarrier;
+  }
+}
+
+// Returns false if a buffer of `op` is not known.
+bool AddBufferUses(mlir::Operation* op,
+                   absl::Span<const BufferAllocation> allocations,
+                   ThunkBufferUses* uses) {
+  auto add_slice = [&](mlir::Value value, bool is_write) {
+    StatusOr<BufferAllocation::Slice> slice =
+        GetAllocationSlice(value, allocations);
+    if (!slice.ok()) {
+      return false;
+    }
+    (is_write ? uses->writes : uses->reads).push_back(*slice);
+    return true;
+  };
+
+  if (auto fusion = mlir::dyn_cast<mlir::lmhlo::FusionOp>(op)) {
+    for (mlir::Value input : fusion.getInputBuffers()) {
+      if (!add_slice(input, /*is_write=*/false)) return false;
+    }
+    for (mlir::Value output : fusion.getOutputBuffers()) {
+      if (!add_slice(output, /*is_write=*/true)) return false;
+    }
+    return true;
+  }
+
+  auto effect_op = mlir::dyn_cast<mlir::MemoryEffectOpInterface>(op);
+  if (!effect_op) {
+    return false;
+  }
+  llvm::SmallVector<mlir::MemoryEffects::EffectInstance, 4> effects;
+  effect_op.getEffects(effects);
+  for (const mlir::MemoryEffects::EffectInstance& effect : effects) {
+    mlir::Value value = effect.getValue();
+    if (!value) {
+      return false;
+    }
+    if (mlir::isa<mlir::MemoryEffects::Write>(effect.getEffect())) {
+      if (!add_slice(value, /*is_write=*/true)) return false;
+    } else if (mlir::isa<mlir::MemoryEffects::Read>(effect.getEffect())) {
+      if (!add_slice(value, /*is_write=*/false)) return false;
+    }
+  }
+  return true;
+}
+
+struct BufferAccess {
+  int64_t thunk;
+  BufferAllocation::Slice slice;
+  bool is_write;
+};
+
+}  // namespace
+
+std::vector<ThunkBufferUses> GetThunkBufferUses(
+    const ThunkSequence& thunks,
+    absl::Span<const BufferAllocation> allocations) {
+  std::vector<ThunkBufferUses> all_uses(thunks.size());
+  for (int64_t i = 0; i < thunks.size(); ++i) {
+    Thunk& thunk = *thunks[i];
+    ThunkBufferUses& uses = all_uses[i];
+    uses.placement = GetPlacement(thunk.kind());
+    if (uses.placement != Placement::kBarrier &&
+        (thunk.op() == nullptr ||
+         !AddBufferUses(thunk.op(), allocations, &uses))) {
+      VLOG(3) << "Unknown buffers of " << thunk.profile_annotation();
+      uses.placement = Placement::kBarrier;
+    }
+  }
+  return all_uses;
+}
+
+ThunkStreamAssignment::ThunkStreamAssignment(
+    absl::Span<const ThunkBufferUses> uses, int max_num_streams)
+    : thunk_streams_(uses.size()) {
+  const int64_t num_thunks = uses.size();
+  const int num_streams = std::max(max_num_streams, 1);
+  if (num_streams == 1) {
+    return;
+  }
+
+  // The last thunk of each stream.
+  std::vector<int64_t> last_thunk(num_streams, -1);
+  // synced[s][t] is the last thunk of stream t that stream s waited for.
+  std::vector<std::vector<int64_t>> synced(
+      num_streams, std::vector<int64_t>(num_streams, -1));
+
+  auto wait = [&](int s, int t, ThunkStream* thunk_stream) {
+    thunk_stream->wait_for.push_back(t);
+    for (int u = 0; u < num_streams; ++u) {
+      synced[s][u] = std::max(synced[s][u], synced[t][u]);
+    }
+    synced[s][t] = last_thunk[t];
+  };
+
+  // The accesses to each buffer allocation so far.
+  std::vector<std::vector<BufferAccess>> accesses;
+  int64_t last_barrier = -1;
+  for (int64_t i = 0; i < num_thunks; ++i) {
+    const ThunkBufferUses& use = uses[i];
+    ThunkStream& thunk_stream = thunk_streams_[i];
+
+    // The reads depend on the previous writes, and the writes on all the
+    // previous accesses.
+    std::vector<int64_t> deps;
+    if (last_barrier >= 0) {
+      deps.push_back(last_barrier);
+    }
+    auto add_deps = [&](const BufferAllocation::Slice& slice, bool is_write) {
+      if (slice.index() >= static_cast<int64_t>(accesses.size())) {
+        accesses.resize(slice.index() + 1);
+      }
+      for (const BufferAccess& access : accesses[slice.index()]) {
+        if ((is_write || access.is_write) && access.slice.OverlapsWith(slice)) {
+          deps.push_back(access.thunk);
+        }
+      }
+    };
+    for (const BufferAllocation::Slice& slice : use.reads) {
+      add_deps(slice, /*is_write=*/false);
+    }
+    for (const BufferAllocation::Slice& slice : use.writes) {
+      add_deps(slice, /*is_write=*/true);
+    }
+    for (const BufferAllocation::Slice& slice : use.reads) {
+      accesses[slice.index()].push_back({i, slice, /*is_write=*/false});
+    }
+    for (const BufferAllocation::Slice& slice : use.writes) {
+      accesses[slice.index()].push_back({i, slice, /*is_write=*/true});
+    }
+    absl::c_sort(deps);
+    deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+
+    int s = 0;
+    if (use.placement == Placement::kAnyStream) {
+      // Continue the latest chain that ends in a dependency, or else start on
+      // the stream idle the longest.
+      auto chain = std::find_if(deps.rbegin(), deps.rend(), [&](int64_t dep) {
+        return last_thunk[thunk_streams_[dep].stream] == dep;
+      });
+      if (chain != deps.rend()) {
+        s = thunk_streams_[*chain].stream;
+      } else {
+        s = absl::c_min_element(last_thunk) - last_thunk.begin();
+      }
+    }
+    thunk_stream.stream = s;
+
+    if (use.placement == Placement::kBarrier) {
+      for (int t = 1; t < num_streams; ++t) {
+        if (last_thunk[t] > synced[s][t]) {
+          wait(s, t, &thunk_stream);
+        }
+      }
+      last_barrier = i;
+    } else {
+      for (int64_t dep : deps) {
+        int t = thunk_streams_[dep].stream;
+        if (t != s && dep > synced[s][t]) {
+          wait(s, t, &thunk_stream);
+        }
+      }
+    }
+    last_thunk[s] = i;
+    synced[s][s] = i;
+    num_streams_ = std::max(num_streams_, s + 1);
+  }
+
+  for (int t = 1; t < num_streams; ++t) {
+    if (last_thunk[t] > synced[0][t]) {
+      join_streams_.push_back(t);
+    }
+  }
+}
+
+int64_t ThunkStreamAssignment::num_waits() const {
+  int64_t num_waits = 0;
+  for (const ThunkStream& thunk_stream : thunk_streams_) {
+    num_waits += thunk_stream.wait_for.size();
+  }
+  return num_waits;
+}
+
+std::string ThunkStreamAssignment::ToString() const {
+  std::string result =
+      absl::StrCat("streams: ", num_streams_, ", waits: ", num_waits(), "\n");
+  for (int64_t i = 0; i < thunk_streams_.size(); ++i) {
+    const ThunkStream& thunk_stream = thunk_streams_[i];
+    absl::StrAppend(&result, "thunk ", i, ": stream ", thunk_stream.stream);
+    if (!thunk_stream.wait_for.empty()) {
+      absl::StrAppend(&result, ", wait for ",
+                      absl::StrJoin(thunk_stream.wait_for, ", "));
+    }
+    absl::StrAppend(&result, "\n");
+  }
+  absl::StrAppend(&result, "join: ", absl::StrJoin(join_streams_, ", "), "\n");
+  return result;
+}
+
+}  // namespace gpu
+}  // namespace xla
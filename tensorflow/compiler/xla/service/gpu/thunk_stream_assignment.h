@@ -0,0 +1,86 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_THUNK_STREAM_ASSIGNMENT_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_THUNK_STREAM_ASSIGNMENT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/service/buffer_assignment.h"
+#include "tensorflow/compiler/xla/service/gpu/thunk.h"
+
+namespace xla {
+namespace gpu {
+
+// The buffers a top-level thunk reads and writes, and where it may run.
+struct ThunkBufferUses {
+  enum class Placement {
+    // May run on any stream after the thunks it depends on.
+    kAnyStream,
+    // Runs on the main stream, e.g., because it allocates scratch memory at
+    // run time, which may only be reused in the order of the main stream.
+    kMainStream,
+    // Runs on the main stream after all previous thunks, and before all later
+    // thunks, e.g., collectives, host transfers and control flow.
+    kBarrier,
+  };
+
+  std::vector<BufferAllocation::Slice> reads;
+  std::vector<BufferAllocation::Slice> writes;
+  Placement placement = Placement::kAnyStream;
+};
+
+// Returns the buffer uses of the top-level thunks of `thunks`. The thunks must
+// still have their operations, i.e., this must be called before
+// Thunk::ClearCompileTimeInfo. Thunks whose buffers are not known are
+// barriers.
+std::vector<ThunkBufferUses> GetThunkBufferUses(
+    const ThunkSequence& thunks,
+    absl::Span<const BufferAllocation> allocations);
+
+// Maps the independent chains of a thunk sequence onto a bounded pool of
+// streams, stream 0 being the main stream of the execution. The thunks are
+// still issued in order. A thunk continues the stream of one of the thunks it
+// depends on if that thunk is the last one of its stream, and independent
+// thunks start on the stream that has been idle the longest. Before a thunk,
+// its stream waits for the streams of the thunks it depends on, unless an
+// earlier wait already covers them, so that chains only synchronize where
+// they meet. The other streams wait for the main stream before the first
+// thunk, and the main stream waits for all of them after the last one.
+//
+// A thunk that records an Alpa done event (see alpa_events.h) only depends on
+// the buffers it signals, so cross-mesh communication waiting for the event
+// can start while independent compute is still running.
+class ThunkStreamAssignment {
+ public:
+  struct ThunkStream {
+    int stream = 0;
+    // The streams to wait for before running the thunk.
+    std::vector<int> wait_for;
+  };
+
+  ThunkStreamAssignment(absl::Span<const ThunkBufferUses> uses,
+                        int max_num_streams);
+
+  // The number of streams used, at most `max_num_streams`.
+  int num_streams() const { return num_streams_; }
+  const ThunkStream& thunk_stream(int64_t index) const {
+    return thunk_streams_[index];
+  }
+  // The streams the main stream waits for after the last thunk.
+  const std::vector<int>& join_streams() const { return join_streams_; }
+  // The number of waits before the thunks.
+  int64_t num_waits() const;
+
+  std::string ToString() const;
+
+ private:
+  int num_streams_ = 1;
+  std::vector<ThunkStream> thunk_streams_;
+  std::vector<int> join_streams_;
+};
+
+}  // namespace gpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_GPU_THUNK_STREAM_ASSIGNMENT_H_
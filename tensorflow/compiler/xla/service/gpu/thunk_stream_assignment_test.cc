@@ -0,0 +1,129 @@
+#include "tensorflow/compiler/xla/service/gpu/thunk_stream_assignment.h"
+
+#include <vector>
+
+#include "tensorflow/compiler/xla/service/buffer_assignment.h"
+#include "tensorflow/tsl/platform/test.h"
+
+namespace xla {
+namespace gpu {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using Placement = ThunkBufferUses::Placement;
+
+class ThunkStreamAssignmentTest : public ::testing::Test {
+ protected:
+  ThunkStreamAssignmentTest() {
+    for (int i = 0; i < 8; ++i) {
+      allocations_.emplace_back(/*index=*/i, /*size=*/1024, /*color=*/0);
+    }
+  }
+
+  BufferAllocation::Slice Buffer(int index) {
+    return BufferAllocation::Slice(&allocations_[index], 0, 1024);
+  }
+
+  ThunkBufferUses Uses(std::vector<int> reads, std::vector<int> writes,
+                       Placement placement = Placement::kAnyStream) {
+    ThunkBufferUses uses;
+    for (int read : reads) uses.reads.push_back(Buffer(read));
+    for (int write : writes) uses.writes.push_back(Buffer(write));
+    uses.placement = placement;
+    return uses;
+  }
+
+  std::vector<BufferAllocation> allocations_;
+};
+
+TEST_F(ThunkStreamAssignmentTest, IndependentChainsRunOnTwoStreams) {
+  std::vector<ThunkBufferUses> uses = {
+      Uses({0}, {1}),     // a0
+      Uses({0}, {2}),     // b0
+      Uses({1}, {3}),     // a1
+      Uses({2}, {4}),     // b1
+      Uses({3, 4}, {5}),  // c
+  };
+  ThunkStreamAssignment assignment(uses, /*max_num_streams=*/4);
+  EXPECT_EQ(assignment.num_streams(), 2);
+  EXPECT_EQ(assignment.thunk_stream(0).stream, 0);
+  EXPECT_EQ(assignment.thunk_stream(1).stream, 1);
+  EXPECT_EQ(assignment.thunk_stream(2).stream, 0);
+  EXPECT_EQ(assignment.thunk_stream(3).stream, 1);
+  // The chains only meet at c.
+  EXPECT_EQ(assignment.thunk_stream(4).stream, 1);
+  EXPECT_THAT(assignment.thunk_stream(4).wait_for, ElementsAre(0));
+  EXPECT_EQ(assignment.num_waits(), 1);
+  EXPECT_THAT(assignment.join_streams(), ElementsAre(1));
+}
+
+TEST_F(ThunkStreamAssignmentTest, WriteAfterReadIsADependency) {
+  std::vector<ThunkBufferUses> uses = {
+      Uses({0}, {1}),  // Reads 0.
+      Uses({2}, {0}),  // Overwrites 0.
+  };
+  ThunkStreamAssignment assignment(uses, /*max_num_streams=*/2);
+  EXPECT_EQ(assignment.thunk_stream(0).stream, 0);
+  EXPECT_EQ(assignment.thunk_stream(1).stream, 0);
+  EXPECT_EQ(assignment.num_waits(), 0);
+  EXPECT_THAT(assignment.join_streams(), IsEmpty());
+}
+
+TEST_F(ThunkStreamAssignmentTest, BarrierJoinsAllStreams) {
+  std::vector<ThunkBufferUses> uses = {
+      Uses({0}, {1}),
+      Uses({0}, {2}),
+      Uses({}, {}, Placement::kBarrier),
+      Uses({0}, {3}),
+  };
+  ThunkStreamAssignment assignment(uses, /*max_num_streams=*/2);
+  EXPECT_EQ(assignment.thunk_stream(1).stream, 1);
+  EXPECT_EQ(assignment.thunk_stream(2).stream, 0);
+  EXPECT_THAT(assignment.thunk_stream(2).wait_for, ElementsAre(1));
+  // Continues after the barrier on the main stream.
+  EXPECT_EQ(assignment.thunk_stream(3).stream, 0);
+  EXPECT_THAT(assignment.thunk_stream(3).wait_for, IsEmpty());
+  EXPECT_THAT(assignment.join_streams(), IsEmpty());
+}
+
+TEST_F(ThunkStreamAssignmentTest, MainStreamThunksStayOnTheMainStream) {
+  std::vector<ThunkBufferUses> uses = {
+      Uses({0}, {1}),
+      Uses({0}, {2}, Placement::kMainStream),
+      Uses({2}, {3}),
+  };
+  ThunkStreamAssignment assignment(uses, /*max_num_streams=*/2);
+  EXPECT_EQ(assignment.thunk_stream(1).stream, 0);
+  EXPECT_EQ(assignment.thunk_stream(2).stream, 0);
+  EXPECT_EQ(assignment.num_waits(), 0);
+}
+
+TEST_F(ThunkStreamAssignmentTest, CoveredWaitsAreElided) {
+  std::vector<ThunkBufferUses> uses = {
+      Uses({}, {1}),      // On stream 0.
+      Uses({}, {2}),      // On stream 1.
+      Uses({1, 2}, {3}),  // On stream 1, waits for stream 0.
+      Uses({1}, {4}),     // On stream 0.
+      Uses({3, 1}, {5}),  // On stream 1, already synced with thunk 0.
+  };
+  ThunkStreamAssignment assignment(uses, /*max_num_streams=*/2);
+  EXPECT_EQ(assignment.thunk_stream(2).stream, 1);
+  EXPECT_THAT(assignment.thunk_stream(2).wait_for, ElementsAre(0));
+  EXPECT_EQ(assignment.thunk_stream(3).stream, 0);
+  EXPECT_EQ(assignment.thunk_stream(4).stream, 1);
+  EXPECT_THAT(assignment.thunk_stream(4).wait_for, IsEmpty());
+  EXPECT_THAT(assignment.join_streams(), ElementsAre(1));
+}
+
+TEST_F(ThunkStreamAssignmentTest, SingleStream) {
+  std::vector<ThunkBufferUses> uses = {Uses({0}, {1}), Uses({0}, {2})};
+  ThunkStreamAssignment assignment(uses, /*max_num_streams=*/1);
+  EXPECT_EQ(assignment.num_streams(), 1);
+  EXPECT_EQ(assignment.thunk_stream(1).stream, 0);
+  EXPECT_EQ(assignment.num_waits(), 0);
+}
+
+}  // namespace
+}  // namespace gpu
+}  // namespace xla
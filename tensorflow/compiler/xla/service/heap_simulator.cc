@@ -32,6 +32,8 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/hlo_schedule.h"
 #include "tensorflow/compiler/xla/service/memory_space_assignment_repacking.h"
 #include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/threadpool.h"
 
 namespace xla {
 
@@ -522,13 +524,23 @@ template <typename BufferType>
 typename GlobalDecreasingSizeBestFitHeap<BufferType>::BufferIntervalCompare
 GlobalDecreasingSizeBestFitHeap<BufferType>::GetTemporalBufferIntervalCompare()
     const {
-  return LessThanByKey([this](const BufferInterval& x) {
-    int64_t x_end = x.end;
-    for (auto colocation : GetTransitiveColocations(x)) {
-      x_end = std::max(x_end, buffer_intervals_.at(colocation).end);
+  // Added by Alpa. The sort computes the key of a buffer O(log n) times, so
+  // cache the end of its colocations, which is only known once all buffers
+  // are freed, i.e. when the heap is finished.
+  auto colocation_ends =
+      std::make_shared<flat_hash_map<const BufferType*, int64_t>>();
+  return LessThanByKey([this, colocation_ends](const BufferInterval& x) {
+    auto it = colocation_ends->find(x.buffer);
+    if (it == colocation_ends->end()) {
+      int64_t x_end = x.end;
+      for (auto colocation : GetTransitiveColocations(x)) {
+        x_end = std::max(x_end, buffer_intervals_.at(colocation).end);
+      }
+      it = colocation_ends->emplace(x.buffer, x_end).first;
     }
     // Sort by duration (descending), size (descending), buffer (ascending).
-    return std::make_tuple(x.start - x_end, -x.size, std::cref(*x.buffer));
+    return std::make_tuple(x.start - it->second, -x.size,
+                           std::cref(*x.buffer));
   });
 }
 
@@ -842,6 +854,17 @@ typename GlobalDecreasingSizeBestFitHeap<BufferType>::Chunk
 GlobalDecreasingSizeBestFitHeap<BufferType>::FindChunkCandidate(
     const GlobalDecreasingSizeBestFitHeap::BufferInterval& buffer_interval,
     int64_t preferred_offset) const {
+  return FindChunkCandidate(buffer_interval,
+                            GetTransitiveColocations(buffer_interval),
+                            preferred_offset);
+}
+
+template <typename BufferType>
+typename GlobalDecreasingSizeBestFitHeap<BufferType>::Chunk
+GlobalDecreasingSizeBestFitHeap<BufferType>::FindChunkCandidate(
+    const GlobalDecreasingSizeBestFitHeap::BufferInterval& buffer_interval,
+    const flat_hash_set<const BufferType*>& colocations,
+    int64_t preferred_offset) const {
   VLOG(1) << "Finding chunks for buffer: "
           << buffer_interval.buffer->ToString();
   VLOG(1) << "Size " << buffer_interval.size << ", start "
@@ -875,8 +898,7 @@ GlobalDecreasingSizeBestFitHeap<BufferType>::FindChunkCandidate(
   // Find the max size of interval across its colocations and use this value to
   // determine whether the buffer will fit in the heap.
   int64_t max_colocation_size = buffer_interval.size;
-  for (const BufferType* colocation :
-       GetTransitiveColocations(buffer_interval)) {
+  for (const BufferType* colocation : colocations) {
     max_colocation_size =
         std::max(max_colocation_size, buffer_intervals_.at(colocation).size);
   }
@@ -918,8 +940,7 @@ GlobalDecreasingSizeBestFitHeap<BufferType>::FindChunkCandidate(
   subtract_used_chunks(interval_tree_.ChunksOverlappingInTime(
       buffer_interval.start, buffer_interval.end));
 
-  for (const BufferType* colocation :
-       GetTransitiveColocations(buffer_interval)) {
+  for (const BufferType* colocation : colocations) {
     const BufferInterval& interval = buffer_intervals_.at(colocation);
     VLOG(1) << "  Alias size " << interval.size << ", start " << interval.start
             << ", end " << interval.end << " " << interval.buffer->ToString();
@@ -1034,10 +1055,23 @@ HeapSimulator::Result<BufferType>
 ChooseBestHeapAlgorithm<BufferType>::Finish() {
   DCHECK(!algorithms_.empty());
   std::vector<Result> results(algorithms_.size());
+  // Added by Alpa
+  if (algorithms_.size() > 1 && num_buffers_ >= kMinBuffersToFinishInParallel) {
+    tsl::thread::ThreadPool pool(tsl::Env::Default(), "heap_simulator",
+                                 algorithms_.size() - 1);
+    for (int i = 1; i < algorithms_.size(); ++i) {
+      pool.Schedule([&, i]() { results[i] = algorithms_[i]->Finish(); });
+    }
+    results[0] = algorithms_[0]->Finish();
+    // The destructor of the pool waits for the algorithms.
+  } else {
+    for (int i = 0; i < algorithms_.size(); ++i) {
+      results[i] = algorithms_[i]->Finish();
+    }
+  }
   int64_t min_size = INT64_MAX;
   int min_size_index = -1;
   for (int i = 0; i < algorithms_.size(); ++i) {
-    results[i] = algorithms_[i]->Finish();
     if (results[i].heap_size < min_size) {
       min_size = results[i].heap_size;
       min_size_index = i;
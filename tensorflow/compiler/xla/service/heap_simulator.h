@@ -451,6 +451,13 @@ class GlobalDecreasingSizeBestFitHeap : public HeapAlgorithm<BufferType> {
   // returns all three of them.
   absl::flat_hash_set<const BufferType*> GetTransitiveColocations(
       const BufferInterval& interval) const;
+
+  // Added by Alpa. FindChunkCandidate with the transitive colocations of
+  // `buffer_interval` already computed.
+  Chunk FindChunkCandidate(
+      const BufferInterval& buffer_interval,
+      const absl::flat_hash_set<const BufferType*>& colocations,
+      int64_t preferred_offset) const;
 };
 
 // This class implements an algorithm that will produce multiple heaps, where
@@ -502,6 +509,7 @@ class ChooseBestHeapAlgorithm : public HeapAlgorithm<BufferType> {
   ~ChooseBestHeapAlgorithm() override {}
 
   void Alloc(const BufferType* buffer, int64_t size) override {
+    ++num_buffers_;
     for (auto& algorithm : algorithms_) {
       algorithm->Alloc(buffer, size);
     }
@@ -509,6 +517,7 @@ class ChooseBestHeapAlgorithm : public HeapAlgorithm<BufferType> {
 
   void ShareWith(const BufferType* buffer, const BufferType* share_with,
                  int64_t size) override {
+    ++num_buffers_;
     for (auto& algorithm : algorithms_) {
       algorithm->ShareWith(buffer, share_with, size);
     }
@@ -520,10 +529,16 @@ class ChooseBestHeapAlgorithm : public HeapAlgorithm<BufferType> {
     }
   }
 
+  // Added by Alpa. With at least kMinBuffersToFinishInParallel buffers, the
+  // algorithms run on separate threads. They do not share state, and the
+  // result is the same as when they run in sequence.
   Result Finish() override;
+  static constexpr int64_t kMinBuffersToFinishInParallel = 4096;
 
  private:
   std::vector<std::unique_ptr<HeapAlgorithm<BufferType>>> algorithms_;
+  // Added by Alpa. The number of Alloc and ShareWith calls.
+  int64_t num_buffers_ = 0;
 };
 
 }  // namespace xla
@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/heap_simulator.h"
 
 #include <memory>
+#include <random>
 #include <utility>
 #include <vector>
 
@@ -1513,6 +1514,66 @@ TEST_F(ConstrainedGlobalDecreasingSizeBestFitHeapTest, ColocatedII) {
   EXPECT_EQ(0, result.heap_results[0].chunk_map.at(buffer_c_).offset);
 }
 
+TEST(ChooseBestHeapAlgorithmTest, ParallelFinishMatchesSequential) {
+  HloComputation::Builder builder("heap_simulator_test");
+  std::vector<std::unique_ptr<HloValue>> values;
+  constexpr int kNumValues =
+      ChooseBestHeapAlgorithm<HloValue>::kMinBuffersToFinishInParallel;
+  for (int i = 0; i < kNumValues; ++i) {
+    auto constant = builder.AddInstruction(
+        HloInstruction::CreateConstant(LiteralUtil::CreateR0<float>(1.0)));
+    values.push_back(std::make_unique<HloValue>(i, constant, ShapeIndex{}));
+  }
+
+  using Heap = GlobalDecreasingSizeBestFitHeap<HloValue>;
+  auto algorithms =
+      std::make_unique<std::vector<std::unique_ptr<HeapAlgorithm<HloValue>>>>();
+  algorithms->push_back(
+      std::make_unique<Heap>(/*alignment=*/8, Heap::kSpatial));
+  algorithms->push_back(
+      std::make_unique<Heap>(/*alignment=*/8, Heap::kTemporal));
+  ChooseBestHeapAlgorithm<HloValue> best(std::move(algorithms));
+  Heap spatial(/*alignment=*/8, Heap::kSpatial);
+  Heap temporal(/*alignment=*/8, Heap::kTemporal);
+  std::vector<HeapAlgorithm<HloValue>*> heaps = {&best, &spatial, &temporal};
+
+  // Keep a window of live buffers of random sizes.
+  std::mt19937 rng(0);
+  std::vector<std::pair<const HloValue*, int64_t>> live;
+  for (const auto& value : values) {
+    int64_t size = 1 + rng() % 1000;
+    for (HeapAlgorithm<HloValue>* heap : heaps) {
+      heap->Alloc(value.get(), size);
+    }
+    live.push_back({value.get(), size});
+    if (live.size() > 64) {
+      auto freed = live.begin() + rng() % live.size();
+      for (HeapAlgorithm<HloValue>* heap : heaps) {
+        heap->Free(freed->first, freed->second);
+      }
+      live.erase(freed);
+    }
+  }
+  for (const auto& [value, size] : live) {
+    for (HeapAlgorithm<HloValue>* heap : heaps) {
+      heap->Free(value, size);
+    }
+  }
+
+  HeapSimulator::Result<HloValue> spatial_result = spatial.Finish();
+  HeapSimulator::Result<HloValue> temporal_result = temporal.Finish();
+  const HeapSimulator::Result<HloValue>& expected =
+      temporal_result.heap_size < spatial_result.heap_size ? temporal_result
+                                                           : spatial_result;
+  HeapSimulator::Result<HloValue> result = best.Finish();
+  EXPECT_EQ(result.heap_size, expected.heap_size);
+  ASSERT_EQ(result.heap_results.size(), 1);
+  for (const auto& value : values) {
+    EXPECT_EQ(result.heap_results[0].chunk_map.at(value.get()),
+              expected.heap_results[0].chunk_map.at(value.get()));
+  }
+}
+
 class IntervalTreeTest : public ::testing::Test {};
 
 TEST_F(IntervalTreeTest, InsertAndRemove) {
@@ -384,14 +384,26 @@ std::string HloAliasAnalysis::ToString() const {
 StatusOr<std::unique_ptr<HloAliasAnalysis>> HloAliasAnalysis::Run(
     const HloModule* module,
     const HloDataflowAnalysis::CanShareBuffer& can_share_buffer) {
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<HloDataflowAnalysis> dataflow_analysis,
+                      HloDataflowAnalysis::Run(*module, /*ssa_form=*/true,
+                                               /*bitcast_defines_value=*/false,
+                                               can_share_buffer));
+  return RunOnDataflowAnalysis(module, std::move(dataflow_analysis));
+}
+
+/* static */
+StatusOr<std::unique_ptr<HloAliasAnalysis>>
+HloAliasAnalysis::RunOnDataflowAnalysis(
+    const HloModule* module,
+    std::unique_ptr<HloDataflowAnalysis> dataflow_analysis) {
   VLOG(2) << "HloAliasAnalysis::Run on module " << module->name();
   XLA_VLOG_LINES(2, module->ToString());
+  TF_RET_CHECK(&dataflow_analysis->module() == module);
+  TF_RET_CHECK(dataflow_analysis->ssa_form())
+      << "HloAliasAnalysis requires a dataflow analysis in SSA form";
 
   auto alias_analysis = absl::WrapUnique(new HloAliasAnalysis(module));
-  TF_ASSIGN_OR_RETURN(alias_analysis->dataflow_analysis_,
-                      HloDataflowAnalysis::Run(*module, /*ssa_form=*/true,
-                                               /*bitcast_defines_value=*/false,
-                                               can_share_buffer));
+  alias_analysis->dataflow_analysis_ = std::move(dataflow_analysis);
 
   size_t num_values = alias_analysis->dataflow_analysis_->values().size();
   alias_analysis->buffers_ = CreateBuffers(alias_analysis->dataflow_analysis());
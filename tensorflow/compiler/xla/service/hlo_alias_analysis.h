@@ -43,6 +43,13 @@ class HloAliasAnalysis {
       const HloModule* module,
       const HloDataflowAnalysis::CanShareBuffer& can_share_buffer = nullptr);
 
+  // Runs the analysis on top of an existing dataflow analysis of 'module', so
+  // that a pass which already computed the dataflow does not recompute it. The
+  // dataflow analysis must be in SSA form and up to date with the module.
+  static StatusOr<std::unique_ptr<HloAliasAnalysis>> RunOnDataflowAnalysis(
+      const HloModule* module,
+      std::unique_ptr<HloDataflowAnalysis> dataflow_analysis);
+
   std::string ToString() const;
 
   // Return the buffer containing the given value.
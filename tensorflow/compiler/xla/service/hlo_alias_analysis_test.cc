@@ -1008,5 +1008,35 @@ ENTRY main {
             analysis.GetUniqueBufferAt(fusion));
 }
 
+TEST_F(HloAliasAnalysisTest, RunOnDataflowAnalysis) {
+  absl::string_view hlo_string = R"(
+HloModule Module
+
+ENTRY main {
+  param = f32[8] parameter(0)
+  negate = f32[8] negate(param)
+  ROOT tuple = (f32[8], f32[8]) tuple(param, negate)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(module_, ParseAndReturnVerifiedModule(hlo_string));
+  HloAliasAnalysis& analysis = RunAnalysis();
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloDataflowAnalysis> dataflow,
+                          HloDataflowAnalysis::Run(*module_, /*ssa_form=*/true));
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<HloAliasAnalysis> shared,
+      HloAliasAnalysis::RunOnDataflowAnalysis(module_.get(),
+                                              std::move(dataflow)));
+  EXPECT_EQ(shared->buffers().size(), analysis.buffers().size());
+  EXPECT_EQ(shared->LiveOutBuffers().size(), analysis.LiveOutBuffers().size());
+
+  TF_ASSERT_OK_AND_ASSIGN(dataflow,
+                          HloDataflowAnalysis::Run(*module_,
+                                                   /*ssa_form=*/false));
+  EXPECT_FALSE(
+      HloAliasAnalysis::RunOnDataflowAnalysis(module_.get(), std::move(dataflow))
+          .ok());
+}
+
 }  // namespace
 }  // namespace xla
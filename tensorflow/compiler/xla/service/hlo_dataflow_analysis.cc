@@ -81,6 +81,17 @@ absl::flat_hash_map<HloInstruction*, int64_t> CalculatePostOrderSchedule(
   return map;
 }
 
+// Added by Alpa. Pipeline markers are identities that delimit pipeline
+// stages. They are lowered to bitcasts before code generation, so they forward
+// the values of their operand instead of defining new ones or updating their
+// operand in place.
+bool IsPipelineMarker(const HloInstruction* instruction) {
+  return instruction->IsCustomCall("pipeline_marker") &&
+         instruction->operand_count() == 1 &&
+         ShapeUtil::Compatible(instruction->shape(),
+                               instruction->operand(0)->shape());
+}
+
 }  // namespace
 using absl::StrAppend;
 using absl::StrCat;
@@ -313,18 +324,17 @@ HloValue* HloDataflowAnalysis::NewHloValue(HloInstruction* instruction,
                                            const ShapeIndex& index,
                                            bool is_phi) {
   const int64_t value_id = next_value_id_++;
-  auto result =
-      values_.insert({value_id, std::make_unique<HloValue>(
-                                    value_id, instruction, index, is_phi)});
-  CHECK(result.second);
+  HloValue* value =
+      &value_arena_.emplace_back(value_id, instruction, index, is_phi);
+  values_.push_back(value);
 
-  VLOG(4) << "NewHloValue = " << result.first->second->ToShortString();
+  VLOG(4) << "NewHloValue = " << value->ToShortString();
 
-  return result.first->second.get();
+  return value;
 }
 
 void HloDataflowAnalysis::MarkValueForDeletion(HloValue::Id value_id) {
-  const HloValue& value = *values_.at(value_id);
+  const HloValue& value = GetValue(value_id);
   VLOG(4) << "MarkValueForDeletion(" << value.ToShortString() << ")";
 
   value_ids_to_delete_.push_back(value_id);
@@ -353,7 +363,7 @@ void HloDataflowAnalysis::DeleteMarkedValues() {
 #endif
 
   for (HloValue::Id value_id : id_set) {
-    values_.erase(value_id);
+    values_[value_id] = nullptr;
   }
   value_ids_to_delete_.clear();
 }
@@ -510,11 +520,15 @@ bool HloDataflowAnalysis::Phi(
 }
 
 const HloValue& HloDataflowAnalysis::GetValue(HloValue::Id value_id) const {
-  return *values_.at(value_id);
+  const HloValue* value = values_.at(value_id);
+  CHECK(value != nullptr) << "Value " << value_id << " was deleted";
+  return *value;
 }
 
 HloValue& HloDataflowAnalysis::GetValue(HloValue::Id value_id) {
-  return *values_.at(value_id);
+  HloValue* value = values_.at(value_id);
+  CHECK(value != nullptr) << "Value " << value_id << " was deleted";
+  return *value;
 }
 
 HloValueSet HloDataflowAnalysis::GetFlattenedValueSet(
@@ -826,6 +840,22 @@ bool HloDataflowAnalysis::UpdateOptimizationBarrierValueSet(
   return changed;
 }
 
+bool HloDataflowAnalysis::UpdatePipelineMarkerValueSet(
+    HloInstruction* marker) {
+  CHECK(IsPipelineMarker(marker));
+  bool changed = false;
+  for (auto& pair : GetInstructionValueSet(marker)) {
+    const ShapeIndex& index = pair.first;
+    HloValueSet& value_set = pair.second;
+    HloValueSet& operand_value_set = GetValueSet(marker->operand(0), index);
+    if (value_set != operand_value_set) {
+      value_set = operand_value_set;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
 bool HloDataflowAnalysis::UpdateDomainValueSet(HloInstruction* domain) {
   // Domain instructions just forward their operand. Given that domains can have
   // a tuple operand, we iterate through its indexes, like for copies.
@@ -1185,6 +1215,11 @@ bool HloDataflowAnalysis::UpdateInstructionValueSet(
       return UpdateCollectivePermuteDoneValueSet(instruction);
     case HloOpcode::kOptimizationBarrier:
       return UpdateOptimizationBarrierValueSet(instruction);
+    case HloOpcode::kCustomCall:
+      if (IsPipelineMarker(instruction)) {
+        return UpdatePipelineMarkerValueSet(instruction);
+      }
+      return false;
     default:
       // Instruction does not forward HloValues (it defines all values in its
       // output). No update is necessary.
@@ -1320,6 +1355,12 @@ InstructionValueSet& HloDataflowAnalysis::GetInstructionValueSet(
 }
 
 Status HloDataflowAnalysis::InitializeInstructionValueSets() {
+  // Most instructions define at least one value, so reserve room for one value
+  // and one value set per instruction up front to avoid rehashing on large
+  // modules.
+  const int64_t instruction_count = module_.instruction_count();
+  value_sets_.reserve(instruction_count);
+  values_.reserve(instruction_count);
   for (const HloComputation* computation : module_.MakeComputationSorted()) {
     const CallGraphNode& call_graph_node = call_graph_->GetNode(computation);
     for (HloInstruction* instruction :
@@ -1396,6 +1437,12 @@ Status HloDataflowAnalysis::InitializeInstructionValueSets() {
           // values flow from their operands.
           define_value_at(/*index=*/{});
           break;
+        case HloOpcode::kCustomCall:
+          // Pipeline markers define no values.
+          if (!IsPipelineMarker(instruction)) {
+            define_all_values();
+          }
+          break;
         case HloOpcode::kAsyncStart:
           // AsyncStart produces a tuple of {{aliased operands}, {destination},
           // contexts}. It defines all of the tuple-shaped values and the
@@ -1569,18 +1616,16 @@ StatusOr<std::unique_ptr<HloDataflowAnalysis>> HloDataflowAnalysis::Run(
       }
     }
   }
-  for (auto& pair : dataflow_analysis->values_) {
-    HloValue::Id value_id = pair.first;
-    HloValue& value = *pair.second;
-    value.SetPositions(value_positions[value_id]);
-  }
-
-  // Construct vector of values.
+  // Construct vector of values. values_ is indexed by id, so it is already
+  // sorted.
   dataflow_analysis->values_vector_.reserve(dataflow_analysis->values_.size());
-  for (const auto& pair : dataflow_analysis->values_) {
-    dataflow_analysis->values_vector_.push_back(pair.second.get());
+  for (HloValue* value : dataflow_analysis->values_) {
+    if (value == nullptr) {
+      continue;
+    }
+    value->SetPositions(value_positions[value->id()]);
+    dataflow_analysis->values_vector_.push_back(value);
   }
-  absl::c_sort(dataflow_analysis->values_vector_, HloValue::IdLessThan);
 
   TF_DCHECK_OK(dataflow_analysis->Verify());
 
@@ -1807,6 +1852,9 @@ HloDataflowAnalysis::GetInPlaceInputOutputPairs(
     } else {
       return {{HloOperandIndex{1, {}}, {1}}};
     }
+  } else if (IsPipelineMarker(instruction)) {
+    // Pipeline markers forward their operand, so nothing is updated in place.
+    return {};
   } else if (instruction->opcode() == HloOpcode::kCustomCall) {
     // Custom Calls previously assumed that aliased operands were
     // forwarded, but now supports modifiction semantics.
@@ -20,6 +20,7 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_HLO_DATAFLOW_ANALYSIS_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_DATAFLOW_ANALYSIS_H_
 
+#include <deque>
 #include <functional>
 #include <iterator>
 #include <memory>
@@ -147,7 +148,7 @@ class HloDataflowAnalysis {
   HloValue& GetValue(HloValue::Id value_id);
 
   // Returns the total number of HloValues.
-  int64_t value_count() const { return values_.size(); }
+  int64_t value_count() const { return values_vector_.size(); }
 
   // Returns a vector of all HloValues stabily sorted by HloValue::Id.
   const std::vector<HloValue*>& values() const { return values_vector_; }
@@ -177,6 +178,9 @@ class HloDataflowAnalysis {
 
   const HloModule& module() const { return module_; }
 
+  // Returns true if the analysis was run with ssa_form.
+  bool ssa_form() const { return ssa_form_; }
+
   // Returns true if the operation is an in-place operation and its operand 0
   // must alias with the output.
   static bool IsInPlaceOperation(HloOpcode opcode);
@@ -273,6 +277,7 @@ class HloDataflowAnalysis {
   bool UpdateCopyStartValueSet(HloInstruction* copy_start);
   bool UpdateCopyDoneValueSet(HloInstruction* copy_done);
   bool UpdateOptimizationBarrierValueSet(HloInstruction* barrier);
+  bool UpdatePipelineMarkerValueSet(HloInstruction* marker);
   bool UpdateRecvDoneValueSet(HloInstruction* recv_done);
   bool UpdateSendValueSet(HloInstruction* send);
   bool UpdateSetDimensionSizeValueSet(HloInstruction* set_dimension_size);
@@ -317,10 +322,15 @@ class HloDataflowAnalysis {
 
   std::unique_ptr<CallGraph> call_graph_;
 
-  // The map of all HloValues in the module. We pass around pointers to the
-  // mapped HloValues, so the underlying container must keep them valid despite
-  // mutations touching other map entries.
-  absl::flat_hash_map<HloValue::Id, std::unique_ptr<HloValue>> values_;
+  // Storage for all HloValues created by the analysis. We pass around pointers
+  // to the HloValues, so the container must keep them valid while new values
+  // are appended. Deleted values stay in the arena until the analysis is
+  // destroyed.
+  std::deque<HloValue> value_arena_;
+
+  // All HloValues in the module indexed by HloValue::Id. Ids are allocated
+  // densely, so a vector is cheaper than a map. Deleted values are null.
+  std::vector<HloValue*> values_;
 
   // A map from instruction to InstructionValueSet.
   absl::flat_hash_map<const HloInstruction*,
@@ -1036,6 +1036,34 @@ TEST_P(HloDataflowAnalysisTest, OptimizationBarrier) {
               UnorderedElementsAre(&analysis.GetValueDefinedAt(param1)));
 }
 
+TEST_P(HloDataflowAnalysisTest, PipelineMarker) {
+  // Test that a pipeline marker forwards the values of its operand.
+  auto builder = HloComputation::Builder(TestName());
+  auto param0 = builder.AddInstruction(
+      HloInstruction::CreateParameter(0, scalar_shape_, "param0"));
+  auto param1 = builder.AddInstruction(
+      HloInstruction::CreateParameter(1, scalar_shape_, "param1"));
+  auto tuple =
+      builder.AddInstruction(HloInstruction::CreateTuple({param0, param1}));
+  auto marker = builder.AddInstruction(HloInstruction::CreateCustomCall(
+      tuple->shape(), {tuple}, "pipeline_marker"));
+  module_->AddEntryComputation(builder.Build());
+  SCOPED_TRACE(module_->ToString());
+
+  bool ssa_form = GetParam();
+  const HloDataflowAnalysis& analysis = RunAnalysis(ssa_form);
+
+  EXPECT_EQ(analysis.values().size(), 3);
+  EXPECT_FALSE(analysis.ValueIsDefinedAt(marker, /*index=*/{}));
+  EXPECT_FALSE(analysis.ValueIsDefinedAt(marker, /*index=*/{0}));
+  EXPECT_FALSE(analysis.ValueIsDefinedAt(marker, /*index=*/{1}));
+  EXPECT_THAT(HloValuesAt(marker, /*index=*/{0}),
+              UnorderedElementsAre(&analysis.GetValueDefinedAt(param0)));
+  EXPECT_THAT(HloValuesAt(marker, /*index=*/{1}),
+              UnorderedElementsAre(&analysis.GetValueDefinedAt(param1)));
+  EXPECT_TRUE(HloDataflowAnalysis::GetInPlaceInputOutputPairs(marker).empty());
+}
+
 TEST_P(HloDataflowAnalysisTest, CopyStartAndCopyDone) {
   // Test that a CopyDone forwards its operand tuple element at {0} to the
   // output.
@@ -34,6 +34,7 @@ limitations under the License.
 #include "absl/container/inlined_vector.h"
 #include "absl/strings/match.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/index_util.h"
 #include "tensorflow/compiler/xla/layout_util.h"
@@ -58,11 +59,14 @@ limitations under the License.
 #include "tensorflow/compiler/xla/window_util.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/tsl/lib/core/bitmap.h"
+#include "tensorflow/tsl/platform/cpu_info.h"
+#include "tensorflow/tsl/platform/env.h"
 #include "tensorflow/tsl/platform/errors.h"
 #include "tensorflow/tsl/platform/logging.h"
 #include "tensorflow/tsl/platform/protobuf.h"
 #include "tensorflow/tsl/platform/status.h"
 #include "tensorflow/tsl/platform/statusor.h"
+#include "tensorflow/tsl/platform/threadpool.h"
 #include "tensorflow/tsl/platform/types.h"
 
 namespace xla {
@@ -2968,6 +2972,22 @@ Status HloEvaluator::HandleScatter(HloInstruction* hlo) {
   return OkStatus();
 }
 
+// Added by Alpa. Advances `index` to the next index of `shape` in the order of
+// its layout, which is the index of the next linear index.
+static void IncrementIndexInLayoutOrder(const Shape& shape,
+                                        absl::Span<int64_t> index) {
+  for (int64_t dim : shape.layout().minor_to_major()) {
+    if (++index[dim] < shape.dimensions(dim)) {
+      return;
+    }
+    index[dim] = 0;
+  }
+}
+
+// Added by Alpa. The cycles per element of copying elements for
+// ParallelForElements.
+static constexpr int64_t kCopyCostPerElement = 16;
+
 Status HloEvaluator::HandleBroadcast(HloInstruction* broadcast) {
   const Literal& operand = GetEvaluatedLiteralFor(broadcast->operand(0));
   TF_RET_CHECK(broadcast->shape().element_type() ==
@@ -2989,6 +3009,41 @@ Status HloEvaluator::HandleBroadcast(HloInstruction* broadcast) {
         broadcast->ToString());
   }
 
+  // Added by Alpa: large broadcasts are evaluated on several threads.
+  const int64_t result_size = ShapeUtil::ElementsIn(broadcast->shape());
+  if (!operand.shape().is_dynamic() &&
+      result_size * kCopyCostPerElement >= kMinParallelEvaluationCost) {
+    Literal result(broadcast->shape());
+    const Shape& result_shape = result.shape();
+    absl::Span<const int64_t> dimensions = broadcast->dimensions();
+    char* result_data = static_cast<char*>(result.untyped_data());
+    const char* operand_data = static_cast<const char*>(operand.untyped_data());
+    const int64_t primitive_size =
+        ShapeUtil::ByteSizeOfPrimitiveType(result_shape.element_type());
+    ParallelForElements(
+        result_size, kCopyCostPerElement, [&](int64_t begin, int64_t end) {
+          std::vector<int64_t> result_index =
+              IndexUtil::LinearIndexToMultidimensionalIndex(result_shape,
+                                                            begin);
+          DimensionVector operand_index(dimensions.size());
+          for (int64_t i = begin; i < end; ++i) {
+            for (int64_t j = 0; j < dimensions.size(); ++j) {
+              operand_index[j] = result_index[dimensions[j]];
+            }
+            int64_t operand_linear_index =
+                IndexUtil::MultidimensionalIndexToLinearIndex(operand.shape(),
+                                                              operand_index);
+            memcpy(result_data + primitive_size * i,
+                   operand_data + primitive_size * operand_linear_index,
+                   primitive_size);
+            IncrementIndexInLayoutOrder(result_shape,
+                                        absl::MakeSpan(result_index));
+          }
+        });
+    evaluated_[broadcast] = std::move(result);
+    return OkStatus();
+  }
+
   TF_ASSIGN_OR_RETURN(
       evaluated_[broadcast],
       operand.Broadcast(broadcast->shape(), broadcast->dimensions()));
@@ -3774,20 +3829,43 @@ Status HloEvaluator::HandleReduce(HloInstruction* instr) {
     }
   }
 
-  std::unique_ptr<HloEvaluator> embedded_evaluator =
-      CreateEmbedded(max_loop_iterations_);
   absl::InlinedVector<Literal, 1> results(num_args);
   for (int64_t i = 0; i < num_args; ++i) {
     results[i] = Literal(is_tuple ? out_shape.tuple_shapes(i) : out_shape);
   }
 
-  TF_RETURN_IF_ERROR(ShapeUtil::ForEachIndexWithStatus(
-      output_shape, [&](absl::Span<const int64_t> output_index) {
-        return GenerateReduceOutputElement(
-            is_tuple, output_index, init_values, input_args,
-            absl::Span<Literal>(results), function, embedded_evaluator.get(),
-            arg_dim_steps, arg_dim_counts, result_to_arg_index);
-      }));
+  // Added by Alpa: large reductions are evaluated on several threads, each
+  // with its own embedded evaluator. The output elements are independent, so
+  // the result does not depend on the number of threads.
+  const Shape& result_shape = results[0].shape();
+  const int64_t result_size = ShapeUtil::ElementsIn(result_shape);
+  const int64_t reduced_size =
+      result_size == 0 ? 0 : ShapeUtil::ElementsIn(arg_shape) / result_size;
+  absl::Mutex mu;
+  Status status;
+  ParallelForElements(
+      result_size,
+      std::max<int64_t>(reduced_size, 1) * kElementwiseCostPerElement,
+      [&](int64_t begin, int64_t end) {
+        std::unique_ptr<HloEvaluator> embedded_evaluator =
+            CreateEmbedded(max_loop_iterations_);
+        std::vector<int64_t> output_index =
+            IndexUtil::LinearIndexToMultidimensionalIndex(result_shape, begin);
+        for (int64_t i = begin; i < end; ++i) {
+          StatusOr<bool> generated = GenerateReduceOutputElement(
+              is_tuple, output_index, init_values, input_args,
+              absl::Span<Literal>(results), function, embedded_evaluator.get(),
+              arg_dim_steps, arg_dim_counts, result_to_arg_index);
+          if (!generated.ok()) {
+            absl::MutexLock lock(&mu);
+            status.Update(generated.status());
+            return;
+          }
+          IncrementIndexInLayoutOrder(result_shape,
+                                      absl::MakeSpan(output_index));
+        }
+      });
+  TF_RETURN_IF_ERROR(status);
 
   if (is_tuple) {
     Literal tuple_result(inferred_return_shape);
@@ -3894,15 +3972,40 @@ std::unique_ptr<Array2D<T>> MatmulArray2DImpl(
   // Because Eigen is a header-oriented library, make sure that the Eigen code
   // is the same as the code used by the CPU backend (otherwise the linker will
   // randomly pick *some* definition).
-  impl_fn(
-      /*run_options_ptr=*/nullptr, result->data(), rhs.data(), lhs.data(), n, m,
-      k,
-      /*transpose_lhs=*/0,
-      /*transpose_rhs=*/0);
+  //
+  // Added by Alpa: large products multiply blocks of rows of lhs on several
+  // threads.
+  HloEvaluator::ParallelForElements(
+      m, int64_t{n} * k, [&](int64_t begin, int64_t end) {
+        impl_fn(
+            /*run_options_ptr=*/nullptr, result->data() + begin * n,
+            rhs.data(), lhs.data() + begin * k, n, end - begin, k,
+            /*transpose_lhs=*/0,
+            /*transpose_rhs=*/0);
+      });
   return result;
 }
+
+// Added by Alpa. The threads shared by all evaluators.
+tsl::thread::ThreadPool* GetEvaluatorThreadPool() {
+  static tsl::thread::ThreadPool* pool = new tsl::thread::ThreadPool(
+      tsl::Env::Default(), "hlo_evaluator", tsl::port::MaxParallelism());
+  return pool;
+}
 }  // namespace
 
+void HloEvaluator::ParallelForElements(
+    int64_t n, int64_t cost_per_element,
+    const std::function<void(int64_t, int64_t)>& fn) {
+  if (n * cost_per_element < kMinParallelEvaluationCost ||
+      tsl::port::MaxParallelism() < 2 ||
+      GetEvaluatorThreadPool()->CurrentThreadId() != -1) {
+    fn(0, n);
+    return;
+  }
+  GetEvaluatorThreadPool()->ParallelFor(n, cost_per_element, fn);
+}
+
 std::unique_ptr<Array2D<Eigen::half>> HloEvaluator::MatmulArray2D(
     const Array2D<Eigen::half>& lhs, const Array2D<Eigen::half>& rhs) {
   return MatmulArray2DImpl<Eigen::half>(
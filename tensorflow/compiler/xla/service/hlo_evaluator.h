@@ -230,6 +230,19 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
   static std::unique_ptr<Array2D<int32_t>> MatmulArray2D(
       const Array2D<int32_t>& lhs, const Array2D<int32_t>& rhs);
 
+  // Added by Alpa. The elementwise, broadcast, reduce and dot handlers evaluate
+  // results that take at least this many cycles on several threads, and
+  // smaller ones on the calling thread.
+  static constexpr int64_t kMinParallelEvaluationCost = int64_t{1} << 21;
+
+  // Added by Alpa. Calls `fn(begin, end)` on ranges that cover [0, n). The
+  // ranges run on a pool of threads shared by all evaluators if their cost of
+  // n * cost_per_element cycles is at least kMinParallelEvaluationCost, and the
+  // caller is not one of these threads.
+  static void ParallelForElements(
+      int64_t n, int64_t cost_per_element,
+      const std::function<void(int64_t, int64_t)>& fn);
+
  protected:
   // Evaluates the given instruction, and stores the evaluation result in the
   // evaluated_ map.
@@ -439,6 +452,20 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
     TF_RET_CHECK(ShapeUtil::SameDimensions(shape, operand->shape()));
 
     Literal result(shape);
+    // Added by Alpa: operands with the layout of the result are evaluated by
+    // linear index, on several threads if they are large.
+    if (ShapeUtil::EqualIgnoringElementType(result.shape(),
+                                            operand_literal.shape())) {
+      absl::Span<ReturnT> result_data = result.data<ReturnT>();
+      absl::Span<const NativeT> operand_data = operand_literal.data<NativeT>();
+      ParallelForElements(result_data.size(), kElementwiseCostPerElement,
+                          [&](int64_t begin, int64_t end) {
+                            for (int64_t i = begin; i < end; ++i) {
+                              result_data[i] = unary_op(operand_data[i]);
+                            }
+                          });
+      return std::move(result);
+    }
     TF_RETURN_IF_ERROR(
         result.Populate<ReturnT>([&](absl::Span<const int64_t> multi_index) {
           return unary_op(operand_literal.Get<NativeT>(multi_index));
@@ -446,6 +473,10 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
     return std::move(result);
   }
 
+  // Added by Alpa. The cycles per element of elementwise ops for
+  // ParallelForElements.
+  static constexpr int64_t kElementwiseCostPerElement = 32;
+
   // Map from a primitive type to its associated (templated) DfsHloVisitor.
   std::unique_ptr<DfsHloVisitor> typed_visitors_[PrimitiveType_ARRAYSIZE];
 
@@ -4965,6 +4965,67 @@ TEST_F(HloEvaluatorTest, GetTupleElementInterleavedWithTupleSucceeds) {
   TestRecursivelyEvaluateInstruction(gte2, expected);
 }
 
+// Added by Alpa. The ops are large enough to be evaluated on several threads.
+TEST_F(HloEvaluatorTest, LargeBroadcastAddReduce) {
+  const char* hlo_text = R"(
+HloModule LargeBroadcastAddReduce
+
+add {
+  x = f32[] parameter(0)
+  y = f32[] parameter(1)
+  ROOT sum = f32[] add(x, y)
+}
+
+ENTRY main {
+  p = f32[512,512] parameter(0)
+  q = f32[512] parameter(1)
+  b = f32[512,512] broadcast(q), dimensions={1}
+  a = f32[512,512] add(p, b)
+  zero = f32[] constant(0)
+  ROOT r = f32[512] reduce(a, zero), dimensions={1}, to_apply=add
+}
+)";
+  Array2D<float> p_array(512, 512);
+  p_array.Each([](int64_t i, int64_t j, float* v) { *v = i; });
+  std::vector<float> q_values(512);
+  std::vector<float> expected_values(512);
+  for (int64_t i = 0; i < 512; ++i) {
+    q_values[i] = i;
+    expected_values[i] = 512 * i + 512 * 511 / 2;
+  }
+  Literal p = LiteralUtil::CreateR2FromArray2D(p_array);
+  Literal q = LiteralUtil::CreateR1<float>(q_values);
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  TF_ASSERT_OK_AND_ASSIGN(Literal result, Evaluate({&p, &q}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(
+      LiteralUtil::CreateR1<float>(expected_values), result));
+}
+
+// Added by Alpa.
+TEST_F(HloEvaluatorTest, LargeDotF64) {
+  const char* hlo_text = R"(
+HloModule LargeDotF64
+
+ENTRY main {
+  lhs = f64[256,256] parameter(0)
+  rhs = f64[256,256] parameter(1)
+  ROOT dot = f64[256,256] dot(lhs, rhs), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+}
+)";
+  Array2D<double> lhs_array(256, 256, 1.0);
+  Array2D<double> rhs_array(256, 256);
+  rhs_array.Each([](int64_t i, int64_t j, double* v) { *v = j; });
+  Array2D<double> expected_array(256, 256);
+  expected_array.Each([](int64_t i, int64_t j, double* v) { *v = 256 * j; });
+  Literal lhs = LiteralUtil::CreateR2FromArray2D(lhs_array);
+  Literal rhs = LiteralUtil::CreateR2FromArray2D(rhs_array);
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  TF_ASSERT_OK_AND_ASSIGN(Literal result, Evaluate({&lhs, &rhs}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(
+      LiteralUtil::CreateR2FromArray2D(expected_array), result));
+}
+
 class PatternMatchParseWhileLoopTest : public HloTestBase {};
 
 TEST_F(PatternMatchParseWhileLoopTest, LoopBoundDefinedInsideOfCond) {
@@ -1187,8 +1187,10 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
     return HandleDotSlowPath(dot);
   }
 
+  // Added by Alpa: the fast path also covers double.
   template <typename NativeT, typename std::enable_if_t<
-                                  std::is_same_v<NativeT, float>>* = nullptr>
+                                  std::is_same_v<NativeT, float> ||
+                                  std::is_same_v<NativeT, double>>* = nullptr>
   Status HandleDot(HloInstruction* dot) {
     const HloInstruction* lhs = dot->operand(0);
     const HloInstruction* rhs = dot->operand(1);
@@ -1253,7 +1255,8 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
   }
 
   template <typename NativeT, typename std::enable_if_t<
-                                  !std::is_same_v<NativeT, float>>* = nullptr>
+                                  !std::is_same_v<NativeT, float> &&
+                                  !std::is_same_v<NativeT, double>>* = nullptr>
   Status HandleDot(HloInstruction* dot) {
     return HandleDotSlowPath(dot);
   }
@@ -2494,6 +2497,27 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
 
     Literal result(shape);
 
+    // Added by Alpa: operands with the layout of the result are evaluated by
+    // linear index, on several threads if they are large.
+    if (ShapeUtil::EqualIgnoringElementType(result.shape(),
+                                            lhs_literal.shape()) &&
+        ShapeUtil::EqualIgnoringElementType(result.shape(),
+                                            rhs_literal.shape())) {
+      absl::Span<ReturnT> result_data = result.data<ReturnT>();
+      absl::Span<const ReturnT> lhs_data = lhs_literal.data<ReturnT>();
+      absl::Span<const ReturnT> rhs_data = rhs_literal.data<ReturnT>();
+      HloEvaluator::ParallelForElements(
+          result_data.size(), HloEvaluator::kElementwiseCostPerElement,
+          [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) {
+              result_data[i] = static_cast<ReturnT>(
+                  binary_op(static_cast<ElementwiseT>(lhs_data[i]),
+                            static_cast<ElementwiseT>(rhs_data[i])));
+            }
+          });
+      return std::move(result);
+    }
+
     TF_RETURN_IF_ERROR(
         result.Populate<ReturnT>([&](absl::Span<const int64_t> multi_index) {
           return ConvertBinaryFunction(binary_op)(
@@ -2521,6 +2545,29 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
 
     Literal result(shape);
 
+    // Added by Alpa: operands with the layout of the result are evaluated by
+    // linear index, on several threads if they are large.
+    if (ShapeUtil::EqualIgnoringElementType(result.shape(),
+                                            lhs_literal.shape()) &&
+        ShapeUtil::EqualIgnoringElementType(result.shape(),
+                                            rhs_literal.shape()) &&
+        ShapeUtil::EqualIgnoringElementType(result.shape(),
+                                            ehs_literal.shape())) {
+      absl::Span<ReturnT> result_data = result.data<ReturnT>();
+      absl::Span<const LhsType> lhs_data = lhs_literal.data<LhsType>();
+      absl::Span<const RhsType> rhs_data = rhs_literal.data<RhsType>();
+      absl::Span<const EhsType> ehs_data = ehs_literal.data<EhsType>();
+      HloEvaluator::ParallelForElements(
+          result_data.size(), HloEvaluator::kElementwiseCostPerElement,
+          [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) {
+              result_data[i] =
+                  ternary_op(lhs_data[i], rhs_data[i], ehs_data[i]);
+            }
+          });
+      return std::move(result);
+    }
+
     TF_RETURN_IF_ERROR(
         result.Populate<ReturnT>([&](absl::Span<const int64_t> multi_index) {
           return ternary_op(lhs_literal.Get<LhsType>(multi_index),
@@ -0,0 +1,156 @@
+#include "tensorflow/compiler/xla/service/hlo_fingerprint.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/tsl/lib/strings/proto_serialization.h"
+#include "tensorflow/tsl/platform/fingerprint.h"
+
+namespace xla {
+namespace {
+
+// Combines `values` and their count into `fp`, so that lists of different
+// lengths do not collide.
+template <typename Range, typename Fn>
+uint64_t CombineList(uint64_t fp, const Range& values, Fn fingerprint_of) {
+  uint64_t count = 0;
+  for (const auto& value : values) {
+    fp = tsl::FingerprintCat64(fp, fingerprint_of(value));
+    ++count;
+  }
+  return tsl::FingerprintCat64(fp, count);
+}
+
+}  // namespace
+
+uint64_t HloFingerprinter::InstructionFingerprint(
+    const HloInstruction* instruction,
+    const absl::flat_hash_map<const HloInstruction*, uint64_t>&
+        instruction_fingerprints) {
+  uint64_t fp;
+  if (instruction->opcode() == HloOpcode::kConstant &&
+      instruction->shape().IsArray()) {
+    // Fingerprint the literal bytes directly instead of copying them into a
+    // proto.
+    const Literal& literal = instruction->literal();
+    fp = tsl::Fingerprint64(
+        ShapeUtil::HumanStringWithLayout(instruction->shape()));
+    fp = tsl::FingerprintCat64(
+        fp, tsl::Fingerprint64(absl::string_view(
+                static_cast<const char*>(literal.untyped_data()),
+                literal.size_bytes())));
+    if (instruction->has_sharding()) {
+      fp = tsl::FingerprintCat64(
+          fp, tsl::Fingerprint64(instruction->sharding().ToString()));
+    }
+  } else {
+    HloInstructionProto proto = instruction->ToProto();
+    proto.clear_name();
+    proto.clear_id();
+    proto.clear_operand_ids();
+    proto.clear_control_predecessor_ids();
+    proto.clear_called_computation_ids();
+    proto.clear_metadata();
+    std::string serialized;
+    tsl::SerializeToStringDeterministic(proto, &serialized);
+    fp = tsl::Fingerprint64(serialized);
+  }
+
+  auto instruction_fp = [&](const HloInstruction* other) {
+    return instruction_fingerprints.at(other);
+  };
+  fp = CombineList(fp, instruction->operands(), instruction_fp);
+  fp = CombineList(fp, instruction->control_predecessors(), instruction_fp);
+  fp = CombineList(fp, instruction->called_computations(),
+                   [&](const HloComputation* callee) {
+                     return computations_.at(callee).fingerprint;
+                   });
+  return fp;
+}
+
+uint64_t HloFingerprinter::ComputeComputationFingerprint(
+    const HloComputation& computation) {
+  absl::flat_hash_map<const HloInstruction*, uint64_t> fingerprints;
+  fingerprints.reserve(computation.instruction_count());
+  std::vector<uint64_t> dead_fingerprints;
+  for (const HloInstruction* instruction :
+       computation.MakeInstructionPostOrder()) {
+    uint64_t fp = InstructionFingerprint(instruction, fingerprints);
+    fingerprints[instruction] = fp;
+    // Instructions that are not used keep their side effects, so they are
+    // part of the fingerprint regardless of their order in the computation.
+    if (instruction != computation.root_instruction() &&
+        instruction->user_count() == 0 &&
+        instruction->control_successors().empty()) {
+      dead_fingerprints.push_back(fp);
+    }
+  }
+  std::sort(dead_fingerprints.begin(), dead_fingerprints.end());
+
+  uint64_t fp = fingerprints.at(computation.root_instruction());
+  fp = tsl::FingerprintCat64(fp, computation.num_parameters());
+  return CombineList(fp, dead_fingerprints, [](uint64_t v) { return v; });
+}
+
+uint64_t HloFingerprinter::GetComputationFingerprint(
+    const HloComputation& computation, Walk* walk) {
+  auto it = computations_.find(&computation);
+  bool stale = it == computations_.end() ||
+               it->second.unique_id != computation.unique_id();
+  if (!walk->visited.insert(&computation).second && !stale) {
+    return it->second.fingerprint;
+  }
+
+  std::vector<const HloComputation*> callees;
+  if (stale) {
+    for (const HloInstruction* instruction : computation.instructions()) {
+      for (const HloComputation* callee : instruction->called_computations()) {
+        callees.push_back(callee);
+      }
+    }
+  } else {
+    callees = it->second.callees;
+  }
+  // Fingerprint the callees first, so that a recomputed callee makes its
+  // callers stale too.
+  for (const HloComputation* callee : callees) {
+    GetComputationFingerprint(*callee, walk);
+    stale |= walk->recomputed.contains(callee);
+  }
+  if (!stale) {
+    return it->second.fingerprint;
+  }
+  uint64_t fp = ComputeComputationFingerprint(computation);
+  computations_[&computation] = {computation.unique_id(), fp,
+                                 std::move(callees)};
+  walk->recomputed.insert(&computation);
+  return fp;
+}
+
+uint64_t HloFingerprinter::ComputationFingerprint(
+    const HloComputation& computation) {
+  Walk walk;
+  return GetComputationFingerprint(computation, &walk);
+}
+
+uint64_t HloFingerprinter::ModuleFingerprint(const HloModule& module) {
+  uint64_t fp = ComputationFingerprint(*module.entry_computation());
+  return tsl::FingerprintCat64(
+      fp, tsl::Fingerprint64(module.entry_computation_layout().ToString()));
+}
+
+void HloFingerprinter::Invalidate(const HloComputation* computation) {
+  computations_.erase(computation);
+}
+
+uint64_t HloModuleStructuralFingerprint(const HloModule& module) {
+  HloFingerprinter fingerprinter;
+  return fingerprinter.ModuleFingerprint(module);
+}
+
+}  // namespace xla
@@ -0,0 +1,77 @@
+// This file contains a structural fingerprint of HLO modules and computations
+// that is cheap to compute on large modules and stable across processes,
+// e.g. as the key of a persistent cache.
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_HLO_FINGERPRINT_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_FINGERPRINT_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+
+namespace xla {
+
+// Computes fingerprints of the structure of HLO computations in one pass over
+// their instructions. The fingerprint of an instruction combines its opcode,
+// shape, attributes and the fingerprints of its operands, control
+// predecessors and called computations, so it ignores instruction and
+// computation names, ids, metadata and the order of the instruction list. A
+// computation called from several places is fingerprinted once.
+//
+// The fingerprints of computations are kept between calls. After a pass
+// modifies a computation, call Invalidate() on it; the next
+// ModuleFingerprint() then recomputes it and the computations that call it,
+// and reuses the others.
+//
+// The fingerprint depends on the proto serialization of the instruction
+// attributes, so it is only stable for a given binary.
+class HloFingerprinter {
+ public:
+  HloFingerprinter() = default;
+
+  uint64_t ModuleFingerprint(const HloModule& module);
+  uint64_t ComputationFingerprint(const HloComputation& computation);
+
+  // Marks the fingerprint of `computation` as stale.
+  void Invalidate(const HloComputation* computation);
+  // Marks all fingerprints as stale.
+  void InvalidateAll() { computations_.clear(); }
+
+ private:
+  struct CachedFingerprint {
+    int64_t unique_id;
+    uint64_t fingerprint;
+    // The computations called by the instructions of the computation.
+    std::vector<const HloComputation*> callees;
+  };
+  // The computations visited by one fingerprint request.
+  struct Walk {
+    absl::flat_hash_set<const HloComputation*> visited;
+    absl::flat_hash_set<const HloComputation*> recomputed;
+  };
+
+  uint64_t InstructionFingerprint(
+      const HloInstruction* instruction,
+      const absl::flat_hash_map<const HloInstruction*, uint64_t>&
+          instruction_fingerprints);
+  uint64_t ComputeComputationFingerprint(const HloComputation& computation);
+  // Returns the cached fingerprint of `computation`, or computes it if it is
+  // stale or one of its callees was recomputed in `walk`.
+  uint64_t GetComputationFingerprint(const HloComputation& computation,
+                                     Walk* walk);
+
+  absl::flat_hash_map<const HloComputation*, CachedFingerprint> computations_;
+};
+
+// Returns the structural fingerprint of `module`, as computed by a fresh
+// HloFingerprinter.
+uint64_t HloModuleStructuralFingerprint(const HloModule& module);
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_HLO_FINGERPRINT_H_
@@ -0,0 +1,117 @@
+#include "tensorflow/compiler/xla/service/hlo_fingerprint.h"
+
+#include <memory>
+
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/tsl/lib/core/status_test_util.h"
+
+namespace xla {
+namespace {
+
+using HloFingerprintTest = HloTestBase;
+
+constexpr char kReduceModule[] = R"(
+HloModule m
+
+add {
+  x = f32[] parameter(0)
+  y = f32[] parameter(1)
+  ROOT sum = f32[] add(x, y)
+}
+
+ENTRY main {
+  p = f32[8,16] parameter(0)
+  zero = f32[] constant(0)
+  ROOT r = f32[8] reduce(p, zero), dimensions={1}, to_apply=add
+}
+)";
+
+TEST_F(HloFingerprintTest, IgnoresNames) {
+  constexpr char kRenamed[] = R"(
+HloModule other
+
+reducer {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT c = f32[] add(a, b)
+}
+
+ENTRY entry {
+  input = f32[8,16] parameter(0)
+  init = f32[] constant(0)
+  ROOT out = f32[8] reduce(input, init), dimensions={1}, to_apply=reducer
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(auto m1, ParseAndReturnVerifiedModule(kReduceModule));
+  TF_ASSERT_OK_AND_ASSIGN(auto m2, ParseAndReturnVerifiedModule(kRenamed));
+  EXPECT_EQ(HloModuleStructuralFingerprint(*m1),
+            HloModuleStructuralFingerprint(*m2));
+  EXPECT_EQ(HloModuleStructuralFingerprint(*m1),
+            HloModuleStructuralFingerprint(*m1->Clone()));
+}
+
+TEST_F(HloFingerprintTest, DependsOnStructure) {
+  constexpr char kMultiply[] = R"(
+HloModule m
+
+mul {
+  x = f32[] parameter(0)
+  y = f32[] parameter(1)
+  ROOT product = f32[] multiply(x, y)
+}
+
+ENTRY main {
+  p = f32[8,16] parameter(0)
+  zero = f32[] constant(0)
+  ROOT r = f32[8] reduce(p, zero), dimensions={1}, to_apply=mul
+}
+)";
+  constexpr char kOtherConstant[] = R"(
+HloModule m
+
+add {
+  x = f32[] parameter(0)
+  y = f32[] parameter(1)
+  ROOT sum = f32[] add(x, y)
+}
+
+ENTRY main {
+  p = f32[8,16] parameter(0)
+  one = f32[] constant(1)
+  ROOT r = f32[8] reduce(p, one), dimensions={1}, to_apply=add
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(auto m1, ParseAndReturnVerifiedModule(kReduceModule));
+  TF_ASSERT_OK_AND_ASSIGN(auto m2, ParseAndReturnVerifiedModule(kMultiply));
+  TF_ASSERT_OK_AND_ASSIGN(auto m3, ParseAndReturnVerifiedModule(kOtherConstant));
+  uint64_t fp = HloModuleStructuralFingerprint(*m1);
+  EXPECT_NE(fp, HloModuleStructuralFingerprint(*m2));
+  EXPECT_NE(fp, HloModuleStructuralFingerprint(*m3));
+}
+
+TEST_F(HloFingerprintTest, InvalidateRecomputesCallers) {
+  TF_ASSERT_OK_AND_ASSIGN(auto m, ParseAndReturnVerifiedModule(kReduceModule));
+  HloFingerprinter fingerprinter;
+  uint64_t fp = fingerprinter.ModuleFingerprint(*m);
+
+  HloComputation* add = m->GetComputationWithName("add");
+  HloInstruction* sum = add->root_instruction();
+  HloInstruction* product = add->AddInstruction(HloInstruction::CreateBinary(
+      sum->shape(), HloOpcode::kMultiply, sum->mutable_operand(0),
+      sum->mutable_operand(1)));
+  TF_ASSERT_OK(add->ReplaceInstruction(sum, product));
+
+  // The fingerprint of the modified computation is stale until invalidated.
+  EXPECT_EQ(fingerprinter.ModuleFingerprint(*m), fp);
+  fingerprinter.Invalidate(add);
+  uint64_t new_fp = fingerprinter.ModuleFingerprint(*m);
+  EXPECT_NE(new_fp, fp);
+  EXPECT_EQ(new_fp, HloModuleStructuralFingerprint(*m));
+}
+
+}  // namespace
+}  // namespace xla
@@ -1446,10 +1446,15 @@ std::unique_ptr<HloInstruction> HloSliceInstruction::CloneWithNewOperandsImpl(
 
 HloConstantInstruction::HloConstantInstruction(Literal literal)
     : HloInstruction(HloOpcode::kConstant, literal.shape()),
-      literal_(std::move(literal)) {}
+      literal_(std::make_shared<Literal>(std::move(literal))) {}
 
 HloConstantInstruction::HloConstantInstruction(Literal literal,
                                                const Shape& shape)
+    : HloInstruction(HloOpcode::kConstant, shape),
+      literal_(std::make_shared<Literal>(std::move(literal))) {}
+
+HloConstantInstruction::HloConstantInstruction(
+    std::shared_ptr<Literal> literal, const Shape& shape)
     : HloInstruction(HloOpcode::kConstant, shape),
       literal_(std::move(literal)) {}
 
@@ -1458,7 +1463,7 @@ HloConstantInstruction::HloConstantInstruction(const Shape& shape)
 
 HloInstructionProto HloConstantInstruction::ToProto() const {
   HloInstructionProto proto = HloInstruction::ToProto();
-  if (literal_.has_value()) {
+  if (literal_ != nullptr) {
     *proto.mutable_literal() = literal_->ToProto();
   }
   return proto;
@@ -1480,7 +1485,8 @@ void HloConstantInstruction::RelayoutConstant(const Layout& new_layout,
 
   if (!mutable_array_subshape->has_layout() ||
       !LayoutUtil::Equal(mutable_array_subshape->layout(), new_layout)) {
-    *literal_ = literal_->Relayout(new_layout, shape_index);
+    literal_ =
+        std::make_shared<Literal>(literal_->Relayout(new_layout, shape_index));
     *mutable_array_subshape->mutable_layout() = new_layout;
   }
 }
@@ -1497,23 +1503,21 @@ std::unique_ptr<HloInstruction>
 HloConstantInstruction::CloneWithNewOperandsImpl(
     const Shape& shape, absl::Span<HloInstruction* const> new_operands,
     HloCloneContext* context) const {
-  if (!literal_.has_value()) {
+  if (literal_ == nullptr) {
     return std::make_unique<HloConstantInstruction>(this->shape());
   }
-  CHECK(literal_.has_value());
   // Literal's shape may have no/different tiling info. Use this instruction's
   // shape instead.
   CHECK(Shape::Equal().MinorToMajorOnlyInLayout()(literal_->shape(),
                                                   this->shape()));
-  return std::make_unique<HloConstantInstruction>(literal_->Clone(),
-                                                  this->shape());
+  return std::make_unique<HloConstantInstruction>(literal_, this->shape());
 }
 
 std::string HloConstantInstruction::OperandsToStringWithCanonicalNameMap(
     const HloPrintOptions& options,
     CanonicalNameMap* canonical_name_map) const {
   if (options.print_only_essential_constants()) {
-    if (!literal_.has_value()) {
+    if (literal_ == nullptr) {
       return "{...}";
     }
     if (literal().IsAll(0)) {
@@ -1529,7 +1533,7 @@ std::string HloConstantInstruction::OperandsToStringWithCanonicalNameMap(
   }
 
   // For constants, show the actual value in place of an empty operand list.
-  if (literal_.has_value() &&
+  if (literal_ != nullptr &&
       ((shape().IsArray() && ShapeUtil::ElementsIn(shape()) <= 10) ||
        options.print_large_constants())) {
     // Literal::ToString emits multidimensional arrays over multiple
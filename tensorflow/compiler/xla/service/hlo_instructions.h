@@ -1099,14 +1099,22 @@ class HloConstantInstruction : public HloInstruction {
  public:
   explicit HloConstantInstruction(Literal literal);
   explicit HloConstantInstruction(Literal literal, const Shape& shape);
+  explicit HloConstantInstruction(std::shared_ptr<Literal> literal,
+                                  const Shape& shape);
   // Used when the literal is too large and dropped.
   explicit HloConstantInstruction(const Shape& shape);
   // Returns the literal associated with this instruction.
   const Literal& literal() const { return *literal_; }
-  // Returns the (mutable) literal associated with this instruction.
-  Literal* mutable_literal() { return &literal_.value(); }
+  // Returns the (mutable) literal associated with this instruction. The
+  // literal is copied first if it is shared with clones of this instruction.
+  Literal* mutable_literal() {
+    if (literal_.use_count() > 1) {
+      literal_ = std::make_shared<Literal>(literal_->Clone());
+    }
+    return literal_.get();
+  }
   // Returns whether there is literal associated with this instruction.
-  bool HasLiteral() const { return literal_.has_value(); }
+  bool HasLiteral() const { return literal_ != nullptr; }
   // Returns a serialized representation of this instruction.
   HloInstructionProto ToProto() const override;
 
@@ -1134,7 +1142,9 @@ class HloConstantInstruction : public HloInstruction {
   std::unique_ptr<HloInstruction> CloneWithNewOperandsImpl(
       const Shape& shape, absl::Span<HloInstruction* const> new_operands,
       HloCloneContext* context) const override;
-  std::optional<Literal> literal_;
+  // Clones of a constant share its literal, so that cloning a module does not
+  // copy large constants. It is never mutated while shared.
+  std::shared_ptr<Literal> literal_;
 };
 
 // Abstract class that represents an HLO instruction that "calls" a computation.
@@ -18,12 +18,17 @@ limitations under the License.
 #include <algorithm>
 #include <limits>
 #include <map>
+#include <optional>
 #include <queue>
+#include <tuple>
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "tensorflow/compiler/xla/service/dfs_hlo_visitor_with_default.h"
 #include "tensorflow/compiler/xla/service/heap_simulator.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
@@ -37,6 +42,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/tsl/lib/gtl/map_util.h"
+#include "tensorflow/tsl/platform/errors.h"
 #include "tensorflow/tsl/platform/logging.h"
 
 namespace xla {
@@ -44,6 +50,13 @@ namespace {
 
 using ::tensorflow::strings::HumanReadableNumBytes;
 
+// Added by Alpa. The beam width of BeamSearchMemoryScheduler if the
+// DebugOptions do not set one.
+constexpr int64_t kDefaultBeamWidth = 8;
+// Added by Alpa. The most sets of scheduled instructions ExactMemoryScheduler
+// visits.
+constexpr int64_t kMaxExactSchedulerStates = 1 << 20;
+
 // Class implementing a list scheduler of HLO instructions which produces a
 // sequence which minimizes memory usage by preferring to schedule the node that
 // frees bigger buffer and defines smaller outputs.
@@ -431,6 +444,192 @@ StatusOr<HloInstructionSequence> ScheduleComputationHelper(
                                 postprocessor, peak_memory);
 }
 
+// Added by Alpa. The memory accounting of the list scheduler over a
+// computation, indexed densely for the beam search and exact schedulers.
+// Scheduling an instruction needs bytes_during[i] on top of the live bytes,
+// then adds bytes_defined[i] to them and frees the buffers whose last use it
+// is.
+struct SchedulingGraph {
+  std::vector<HloInstruction*> instructions;
+  std::vector<std::vector<int>> successors;
+  std::vector<int> num_predecessors;
+  std::vector<int64_t> bytes_defined;
+  std::vector<int64_t> bytes_during;
+  // The buffers defined and used by each instruction.
+  std::vector<std::vector<int>> defined_buffers;
+  std::vector<std::vector<int>> used_buffers;
+  // The size of each buffer, or 0 if the list scheduler ignores it.
+  std::vector<int64_t> buffer_sizes;
+  // The number of uses of each buffer, with an extra one if it is live out.
+  std::vector<int> buffer_use_counts;
+  std::vector<bool> buffer_live_out;
+};
+
+SchedulingGraph BuildSchedulingGraph(
+    HloComputation* computation,
+    const TuplePointsToAnalysis& points_to_analysis,
+    const BufferValue::SizeFunction& size_function,
+    const absl::flat_hash_map<const HloComputation*, int64_t>&
+        memory_by_computation) {
+  SchedulingGraph graph;
+  graph.instructions = computation->MakeInstructionPostOrder();
+  int n = graph.instructions.size();
+  absl::flat_hash_map<const HloInstruction*, int> index;
+  index.reserve(n);
+  for (int i = 0; i < n; ++i) {
+    index[graph.instructions[i]] = i;
+  }
+
+  absl::flat_hash_map<const LogicalBuffer*, int> buffer_index;
+  graph.successors.resize(n);
+  graph.num_predecessors.resize(n);
+  graph.bytes_defined.resize(n);
+  graph.bytes_during.resize(n);
+  graph.defined_buffers.resize(n);
+  graph.used_buffers.resize(n);
+  for (int i = 0; i < n; ++i) {
+    const HloInstruction* instruction = graph.instructions[i];
+    for (const LogicalBuffer* buffer :
+         points_to_analysis.GetBuffersDefinedByInstruction(instruction)) {
+      int64_t size = ListScheduler::IgnoreInstruction(*instruction)
+                         ? 0
+                         : size_function(*buffer);
+      buffer_index[buffer] = graph.buffer_sizes.size();
+      graph.defined_buffers[i].push_back(graph.buffer_sizes.size());
+      graph.buffer_sizes.push_back(size);
+      graph.bytes_defined[i] += size;
+    }
+  }
+  graph.buffer_use_counts.resize(graph.buffer_sizes.size());
+  graph.buffer_live_out.resize(graph.buffer_sizes.size());
+
+  for (int i = 0; i < n; ++i) {
+    HloInstruction* instruction = graph.instructions[i];
+    absl::flat_hash_set<int> successors;
+    for (const HloInstruction* user : instruction->users()) {
+      successors.insert(index.at(user));
+    }
+    for (const HloInstruction* successor :
+         instruction->control_successors()) {
+      successors.insert(index.at(successor));
+    }
+    graph.successors[i].assign(successors.begin(), successors.end());
+    absl::c_sort(graph.successors[i]);
+    for (int successor : graph.successors[i]) {
+      ++graph.num_predecessors[successor];
+    }
+
+    absl::flat_hash_set<int> uses;
+    for (const HloInstruction* operand : instruction->operands()) {
+      points_to_analysis.GetPointsToSet(operand).ForEachElement(
+          [&](const ShapeIndex& /*index*/,
+              const PointsToSet::BufferList& buffers) {
+            for (const LogicalBuffer* buffer : buffers) {
+              auto it = buffer_index.find(buffer);
+              if (it != buffer_index.end()) {
+                uses.insert(it->second);
+              }
+            }
+          });
+    }
+    graph.used_buffers[i].assign(uses.begin(), uses.end());
+    absl::c_sort(graph.used_buffers[i]);
+    for (int buffer : graph.used_buffers[i]) {
+      ++graph.buffer_use_counts[buffer];
+    }
+
+    // The same accounting of subcomputations as BytesFreedIfScheduled.
+    int64_t max_subcomputation_bytes = 0;
+    for (const HloComputation* called : instruction->called_computations()) {
+      auto it = memory_by_computation.find(called);
+      if (it != memory_by_computation.end()) {
+        max_subcomputation_bytes =
+            std::max(max_subcomputation_bytes, it->second);
+      }
+    }
+    HloOpcode opcode = instruction->opcode();
+    if (max_subcomputation_bytes > 0 &&
+        (opcode == HloOpcode::kWhile || opcode == HloOpcode::kCall ||
+         opcode == HloOpcode::kConditional)) {
+      graph.bytes_during[i] =
+          std::max(max_subcomputation_bytes, graph.bytes_defined[i]);
+    } else {
+      graph.bytes_during[i] =
+          graph.bytes_defined[i] + max_subcomputation_bytes;
+    }
+  }
+
+  for (const LogicalBuffer* buffer :
+       points_to_analysis.GetPointsToSet(computation->root_instruction())
+           .CreateFlattenedSet()) {
+    auto it = buffer_index.find(buffer);
+    if (it != buffer_index.end()) {
+      ++graph.buffer_use_counts[it->second];
+      graph.buffer_live_out[it->second] = true;
+    }
+  }
+  return graph;
+}
+
+// Added by Alpa. A partial schedule of the beam search.
+struct BeamState {
+  std::vector<int> sequence;
+  std::vector<int> ready;
+  std::vector<int> pending_predecessors;
+  std::vector<int> remaining_uses;
+  int64_t live_bytes = 0;
+  int64_t peak_bytes = 0;
+  // A hash of the set of scheduled instructions, to drop the partial
+  // schedules that schedule the same instructions in another order.
+  uint64_t hash = 0;
+};
+
+// Returns a fixed pseudo-random hash of instruction `i` (splitmix64).
+uint64_t InstructionHash(int i) {
+  uint64_t z = static_cast<uint64_t>(i + 1) * 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Returns the live bytes after scheduling instruction `i` in `state`.
+int64_t LiveBytesAfter(const SchedulingGraph& graph, const BeamState& state,
+                       int i) {
+  int64_t live = state.live_bytes + graph.bytes_defined[i];
+  for (int buffer : graph.used_buffers[i]) {
+    if (state.remaining_uses[buffer] == 1) {
+      live -= graph.buffer_sizes[buffer];
+    }
+  }
+  for (int buffer : graph.defined_buffers[i]) {
+    if (state.remaining_uses[buffer] == 0) {
+      live -= graph.buffer_sizes[buffer];
+    }
+  }
+  return live;
+}
+
+// Schedules the instruction at `ready_position` of the ready list of `state`.
+void ScheduleReadyInstruction(const SchedulingGraph& graph,
+                              int ready_position, BeamState* state) {
+  int i = state->ready[ready_position];
+  state->peak_bytes = std::max(state->peak_bytes,
+                               state->live_bytes + graph.bytes_during[i]);
+  state->live_bytes = LiveBytesAfter(graph, *state, i);
+  state->hash ^= InstructionHash(i);
+  state->sequence.push_back(i);
+  for (int buffer : graph.used_buffers[i]) {
+    --state->remaining_uses[buffer];
+  }
+  state->ready[ready_position] = state->ready.back();
+  state->ready.pop_back();
+  for (int successor : graph.successors[i]) {
+    if (--state->pending_predecessors[successor] == 0) {
+      state->ready.push_back(successor);
+    }
+  }
+}
+
 }  // namespace
 
 StatusOr<HloInstructionSequence> DFSMemoryScheduler(
@@ -599,6 +798,212 @@ StatusOr<HloInstructionSequence> PostOrderMemoryScheduler(
   return sequence;
 }
 
+StatusOr<HloInstructionSequence> BeamSearchMemoryScheduler(
+    HloComputation* computation,
+    const TuplePointsToAnalysis& points_to_analysis,
+    const HloAliasAnalysis& alias_analysis,
+    const BufferValue::SizeFunction& size_function,
+    const absl::flat_hash_map<const HloComputation*, int64_t>&
+        memory_by_computation,
+    const MemorySchedulerPostprocessor& postprocessor, int64_t* peak_memory) {
+  const DebugOptions& options = computation->parent()->config().debug_options();
+  int64_t beam_width = options.xla_memory_scheduler_beam_width() > 0
+                           ? options.xla_memory_scheduler_beam_width()
+                           : kDefaultBeamWidth;
+  absl::Time deadline =
+      options.xla_memory_scheduler_beam_time_limit_ms() > 0
+          ? absl::Now() + absl::Milliseconds(
+                              options.xla_memory_scheduler_beam_time_limit_ms())
+          : absl::InfiniteFuture();
+
+  SchedulingGraph graph = BuildSchedulingGraph(
+      computation, points_to_analysis, size_function, memory_by_computation);
+  int n = graph.instructions.size();
+  std::vector<BeamState> beam(1);
+  beam[0].sequence.reserve(n);
+  beam[0].pending_predecessors = graph.num_predecessors;
+  beam[0].remaining_uses = graph.buffer_use_counts;
+  for (int i = 0; i < n; ++i) {
+    if (graph.num_predecessors[i] == 0) {
+      beam[0].ready.push_back(i);
+    }
+  }
+
+  struct Candidate {
+    int64_t peak_bytes;
+    int64_t live_bytes;
+    int state;
+    int ready_position;
+    uint64_t hash;
+  };
+  std::vector<Candidate> candidates;
+  absl::flat_hash_set<uint64_t> hashes;
+  for (int step = 0; step < n; ++step) {
+    if (beam_width > 1 && absl::Now() > deadline) {
+      VLOG(1) << "Beam search of " << computation->name()
+              << " ran out of time after " << step << " of " << n
+              << " instructions";
+      // The beam is sorted, so the rest of the best partial schedule is
+      // scheduled greedily.
+      beam.resize(1);
+      beam_width = 1;
+    }
+    candidates.clear();
+    for (int s = 0; s < beam.size(); ++s) {
+      const BeamState& state = beam[s];
+      for (int r = 0; r < state.ready.size(); ++r) {
+        int i = state.ready[r];
+        candidates.push_back(
+            {std::max(state.peak_bytes,
+                      state.live_bytes + graph.bytes_during[i]),
+             LiveBytesAfter(graph, state, i), s, r,
+             state.hash ^ InstructionHash(i)});
+      }
+    }
+    absl::c_sort(candidates, [](const Candidate& a, const Candidate& b) {
+      return std::tie(a.peak_bytes, a.live_bytes, a.state, a.ready_position) <
+             std::tie(b.peak_bytes, b.live_bytes, b.state, b.ready_position);
+    });
+
+    std::vector<BeamState> next_beam;
+    hashes.clear();
+    for (const Candidate& candidate : candidates) {
+      if (next_beam.size() == beam_width) {
+        break;
+      }
+      if (!hashes.insert(candidate.hash).second) {
+        continue;
+      }
+      next_beam.push_back(beam_width == 1 ? std::move(beam[candidate.state])
+                                          : beam[candidate.state]);
+      ScheduleReadyInstruction(graph, candidate.ready_position,
+                               &next_beam.back());
+    }
+    beam = std::move(next_beam);
+  }
+
+  HloInstructionSequence sequence;
+  for (int i : beam[0].sequence) {
+    sequence.push_back(graph.instructions[i]);
+  }
+  CHECK_EQ(sequence.size(), computation->instruction_count());
+  if (postprocessor) {
+    sequence = postprocessor(sequence);
+  }
+  if (peak_memory) {
+    TF_ASSIGN_OR_RETURN(
+        *peak_memory, HeapSimulator::MinimumMemoryForComputation(
+                          *computation, sequence, alias_analysis, size_function,
+                          &memory_by_computation));
+  }
+  return sequence;
+}
+
+StatusOr<HloInstructionSequence> ExactMemoryScheduler(
+    HloComputation* computation,
+    const TuplePointsToAnalysis& points_to_analysis,
+    const HloAliasAnalysis& alias_analysis,
+    const BufferValue::SizeFunction& size_function,
+    const absl::flat_hash_map<const HloComputation*, int64_t>&
+        memory_by_computation,
+    const MemorySchedulerPostprocessor& postprocessor, int64_t* peak_memory) {
+  if (computation->instruction_count() > kMaxExactSchedulerInstructions) {
+    return InvalidArgument(
+        "The exact memory scheduler supports at most %d instructions, but %s "
+        "has %d",
+        kMaxExactSchedulerInstructions, computation->name(),
+        computation->instruction_count());
+  }
+  SchedulingGraph graph = BuildSchedulingGraph(
+      computation, points_to_analysis, size_function, memory_by_computation);
+  int n = graph.instructions.size();
+  std::vector<uint64_t> predecessor_masks(n);
+  for (int i = 0; i < n; ++i) {
+    for (int successor : graph.successors[i]) {
+      predecessor_masks[successor] |= uint64_t{1} << i;
+    }
+  }
+  std::vector<uint64_t> user_masks(graph.buffer_sizes.size());
+  for (int i = 0; i < n; ++i) {
+    for (int buffer : graph.used_buffers[i]) {
+      user_masks[buffer] |= uint64_t{1} << i;
+    }
+  }
+
+  // The live bytes only depend on the set of scheduled instructions, so the
+  // minimum peak to reach each set is found layer by layer over the sets of
+  // the same size. Ties between the ways to reach a set are broken by the
+  // previous set and instruction, so that the result does not depend on the
+  // iteration order of the maps.
+  struct ExactState {
+    int64_t peak_bytes;
+    int64_t live_bytes;
+    uint64_t previous;
+    int last;
+  };
+  std::vector<absl::flat_hash_map<uint64_t, ExactState>> layers(n + 1);
+  layers[0][0] = {0, 0, 0, -1};
+  int64_t num_states = 1;
+  for (int k = 0; k < n; ++k) {
+    for (const auto& [scheduled, state] : layers[k]) {
+      for (int i = 0; i < n; ++i) {
+        uint64_t bit = uint64_t{1} << i;
+        if ((scheduled & bit) != 0 || (predecessor_masks[i] & ~scheduled)) {
+          continue;
+        }
+        uint64_t next = scheduled | bit;
+        int64_t peak_bytes = std::max(
+            state.peak_bytes, state.live_bytes + graph.bytes_during[i]);
+        int64_t live_bytes = state.live_bytes + graph.bytes_defined[i];
+        for (int buffer : graph.used_buffers[i]) {
+          if (!graph.buffer_live_out[buffer] &&
+              (user_masks[buffer] & ~next) == 0) {
+            live_bytes -= graph.buffer_sizes[buffer];
+          }
+        }
+        for (int buffer : graph.defined_buffers[i]) {
+          if (!graph.buffer_live_out[buffer] && user_masks[buffer] == 0) {
+            live_bytes -= graph.buffer_sizes[buffer];
+          }
+        }
+        ExactState next_state = {peak_bytes, live_bytes, scheduled, i};
+        auto [it, inserted] = layers[k + 1].try_emplace(next, next_state);
+        if (inserted) {
+          if (++num_states > kMaxExactSchedulerStates) {
+            return ResourceExhausted(
+                "The exact memory scheduler search of %s has more than %d "
+                "states",
+                computation->name(), kMaxExactSchedulerStates);
+          }
+        } else if (std::tie(peak_bytes, scheduled, i) <
+                   std::tie(it->second.peak_bytes, it->second.previous,
+                            it->second.last)) {
+          it->second = next_state;
+        }
+      }
+    }
+  }
+
+  std::vector<HloInstruction*> instructions(n);
+  uint64_t scheduled = n == 64 ? ~uint64_t{0} : (uint64_t{1} << n) - 1;
+  for (int k = n; k > 0; --k) {
+    const ExactState& state = layers[k].at(scheduled);
+    instructions[k - 1] = graph.instructions[state.last];
+    scheduled = state.previous;
+  }
+  HloInstructionSequence sequence(instructions);
+  if (postprocessor) {
+    sequence = postprocessor(sequence);
+  }
+  if (peak_memory) {
+    TF_ASSIGN_OR_RETURN(
+        *peak_memory, HeapSimulator::MinimumMemoryForComputation(
+                          *computation, sequence, alias_analysis, size_function,
+                          &memory_by_computation));
+  }
+  return sequence;
+}
+
 StatusOr<HloInstructionSequence> DefaultMemoryScheduler(
     HloComputation* computation,
     const TuplePointsToAnalysis& points_to_analysis,
@@ -645,6 +1050,54 @@ StatusOr<HloInstructionSequence> DefaultMemoryScheduler(
     *peak_memory = min_memory;
   }
 
+  // Added by Alpa
+  const DebugOptions& options = computation->parent()->config().debug_options();
+  std::optional<HloInstructionSequence> search_sequence;
+  int64_t search_memory = min_memory;
+  if (options.xla_memory_scheduler_beam_width() > 0) {
+    int64_t beam_memory;
+    TF_ASSIGN_OR_RETURN(
+        HloInstructionSequence beam_sequence,
+        BeamSearchMemoryScheduler(computation, points_to_analysis,
+                                  alias_analysis, size_function,
+                                  memory_by_computation, postprocessor,
+                                  &beam_memory));
+    VLOG(2) << "Min-memory beam search sequence: "
+            << HumanReadableNumBytes(beam_memory);
+    if (beam_memory < search_memory) {
+      search_memory = beam_memory;
+      search_sequence = std::move(beam_sequence);
+    }
+  }
+  int64_t exact_max_instructions =
+      std::min<int64_t>(options.xla_memory_scheduler_exact_max_instructions(),
+                        kMaxExactSchedulerInstructions);
+  if (computation->instruction_count() <= exact_max_instructions) {
+    int64_t exact_memory;
+    StatusOr<HloInstructionSequence> exact_sequence = ExactMemoryScheduler(
+        computation, points_to_analysis, alias_analysis, size_function,
+        memory_by_computation, postprocessor, &exact_memory);
+    if (tsl::errors::IsResourceExhausted(exact_sequence.status())) {
+      VLOG(2) << "Skipped exact sequence: " << exact_sequence.status();
+    } else {
+      TF_RETURN_IF_ERROR(exact_sequence.status());
+      VLOG(2) << "Min-memory exact sequence: "
+              << HumanReadableNumBytes(exact_memory);
+      if (exact_memory < search_memory) {
+        search_memory = exact_memory;
+        search_sequence = std::move(exact_sequence).value();
+      }
+    }
+  }
+  if (search_sequence.has_value()) {
+    VLOG(2) << "Chose min-memory search sequence: "
+            << HumanReadableNumBytes(search_memory);
+    if (peak_memory) {
+      *peak_memory = search_memory;
+    }
+    return *std::move(search_sequence);
+  }
+
   if (min_memory == list_memory) {
     VLOG(2) << "Chose min-memory list sequence: "
             << HumanReadableNumBytes(list_memory);
@@ -705,6 +1158,29 @@ StatusOr<HloSchedule> DefaultModuleScheduler(
     *peak_memory = min_memory;
   }
 
+  // Added by Alpa. The search schedulers are tried per computation by
+  // DefaultMemoryScheduler.
+  const DebugOptions& options = module->config().debug_options();
+  if (options.xla_memory_scheduler_beam_width() > 0 ||
+      options.xla_memory_scheduler_exact_max_instructions() > 0) {
+    int64_t search_memory;
+    TF_ASSIGN_OR_RETURN(
+        HloSchedule search_sequence,
+        ComputationSchedulerToModuleScheduler(DefaultMemoryScheduler, {})(
+            module, points_to_analysis, alias_analysis, size_function,
+            execution_threads, &search_memory));
+    VLOG(2) << "Min-memory search sequence: "
+            << HumanReadableNumBytes(search_memory);
+    if (search_memory < min_memory) {
+      VLOG(2) << "Chose min-memory search sequence: "
+              << HumanReadableNumBytes(search_memory);
+      if (peak_memory) {
+        *peak_memory = search_memory;
+      }
+      return search_sequence;
+    }
+  }
+
   if (min_memory == list_memory) {
     VLOG(2) << "Chose min-memory list sequence: "
             << HumanReadableNumBytes(list_memory);
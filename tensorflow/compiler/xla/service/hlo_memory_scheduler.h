@@ -97,10 +97,41 @@ StatusOr<HloInstructionSequence> PostOrderMemoryScheduler(
         memory_by_computation,
     const MemorySchedulerPostprocessor& postprocessor, int64_t* peak_memory);
 
+// Added by Alpa. Beam search scheduler. Keeps the best partial schedules by
+// (peak, live) bytes at each step, with the beam width and time budget of the
+// module's DebugOptions (xla_memory_scheduler_beam_width and
+// xla_memory_scheduler_beam_time_limit_ms). When the time budget runs out, the
+// best partial schedule is completed greedily.
+StatusOr<HloInstructionSequence> BeamSearchMemoryScheduler(
+    HloComputation* computation,
+    const TuplePointsToAnalysis& points_to_analysis,
+    const HloAliasAnalysis& alias_analysis,
+    const LogicalBuffer::SizeFunction& size_function,
+    const absl::flat_hash_map<const HloComputation*, int64_t>&
+        memory_by_computation,
+    const MemorySchedulerPostprocessor& postprocessor, int64_t* peak_memory);
+
+// Added by Alpa. Exact scheduler for small computations. Searches all the
+// orders of the instructions for the minimum peak of the live bytes, as
+// accounted by the list scheduler. Returns an error if the computation has more
+// than kMaxExactSchedulerInstructions instructions or its search space is too
+// large.
+StatusOr<HloInstructionSequence> ExactMemoryScheduler(
+    HloComputation* computation,
+    const TuplePointsToAnalysis& points_to_analysis,
+    const HloAliasAnalysis& alias_analysis,
+    const LogicalBuffer::SizeFunction& size_function,
+    const absl::flat_hash_map<const HloComputation*, int64_t>&
+        memory_by_computation,
+    const MemorySchedulerPostprocessor& postprocessor, int64_t* peak_memory);
+inline constexpr int64_t kMaxExactSchedulerInstructions = 64;
+
 // The default scheduling algorithm. Runs the list scheduler, the DFS scheduler,
 // and the post-order scheduler and chooses whichever returns a lower min-
 // memory, not accounting for fragmentation. peak_memory (may be nullptr) is set
 // to the peak memory of the resulting schedule according to the HeapSimulator.
+// Added by Alpa: the beam search and exact schedulers are also tried if they
+// are enabled in the module's DebugOptions.
 StatusOr<HloInstructionSequence> DefaultMemoryScheduler(
     HloComputation* computation,
     const TuplePointsToAnalysis& points_to_analysis,
@@ -343,5 +343,63 @@ ENTRY main {
   TF_ASSERT_OK(clone->schedule().Verify());
 }
 
+TEST_F(HloSchedulingTest, SearchSchedulersAreNoWorseThanHeuristics) {
+  // b and f are twice as large as the other buffers, so the order of the two
+  // branches matters.
+  const char* const hlo_string = R"(
+HloModule Branches
+
+ENTRY main {
+  p = f32[] parameter(0)
+  a = f32[1024] broadcast(p), dimensions={}
+  b = f32[2048] concatenate(a, a), dimensions={0}
+  c = f32[1024] slice(b), slice={[0:1024]}
+  d = f32[1024] reverse(a), dimensions={0}
+  e = f32[1024] reverse(a), dimensions={0}
+  f = f32[2048] concatenate(d, e), dimensions={0}
+  ROOT g = f32[3072] concatenate(c, f), dimensions={0}
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  auto size_fn = [](const BufferValue& buffer) {
+    return ShapeUtil::ByteSizeOf(buffer.shape());
+  };
+  auto peak_memory = [&](const MemorySchedulerAlgorithm& algorithm) {
+    int64_t peak;
+    HloSchedule schedule =
+        ScheduleModule(module.get(), size_fn,
+                       ComputationSchedulerToModuleScheduler(algorithm),
+                       /*execution_threads=*/{}, &peak)
+            .value();
+    TF_CHECK_OK(schedule.Verify());
+    return peak;
+  };
+
+  int64_t exact_memory = peak_memory(ExactMemoryScheduler);
+  int64_t beam_memory = peak_memory(BeamSearchMemoryScheduler);
+  EXPECT_LE(exact_memory, peak_memory(ListMemoryScheduler));
+  EXPECT_LE(exact_memory, peak_memory(DFSMemoryScheduler));
+  EXPECT_LE(exact_memory, peak_memory(PostOrderMemoryScheduler));
+  EXPECT_LE(exact_memory, beam_memory);
+
+  // The default scheduler keeps the best of all schedulers when the search
+  // schedulers are enabled.
+  int64_t default_memory;
+  TF_ASSERT_OK(ScheduleModule(module.get(), size_fn, /*algorithm=*/{},
+                              /*execution_threads=*/{}, &default_memory)
+                   .status());
+  DebugOptions debug_options = module->config().debug_options();
+  debug_options.set_xla_memory_scheduler_beam_width(4);
+  debug_options.set_xla_memory_scheduler_exact_max_instructions(
+      kMaxExactSchedulerInstructions);
+  module->config().set_debug_options(debug_options);
+  int64_t search_memory;
+  TF_ASSERT_OK(ScheduleModule(module.get(), size_fn, /*algorithm=*/{},
+                              /*execution_threads=*/{}, &search_memory)
+                   .status());
+  EXPECT_LE(search_memory, default_memory);
+}
+
 }  // namespace
 }  // namespace xla
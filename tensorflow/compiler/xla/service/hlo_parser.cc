@@ -3736,7 +3736,11 @@ bool HloParserImpl::ParseDenseLiteral(Literal* literal, const Shape& shape) {
     }  // end of switch
   } while (nest_level > 0);
 
-  *literal = literal->Relayout(shape.layout());
+  // Added by Alpa: most literals are in the default layout already, so avoid
+  // holding a relayouted copy of them.
+  if (!LayoutUtil::Equal(literal->shape().layout(), shape.layout())) {
+    *literal = literal->Relayout(shape.layout());
+  }
   return true;
 }
 
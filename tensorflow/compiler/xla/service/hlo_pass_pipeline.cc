@@ -16,19 +16,25 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/hlo_pass_pipeline.h"
 
 #include <functional>
+#include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "tensorflow/compiler/xla/service/dump.h"
+#include "tensorflow/compiler/xla/service/hlo_fingerprint.h"
 #include "tensorflow/compiler/xla/service/hlo_graph_dumper.h"
 #include "tensorflow/compiler/xla/service/hlo_proto_util.h"
 #include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/tsl/platform/errors.h"
+#include "tensorflow/tsl/platform/fingerprint.h"
 #include "tensorflow/tsl/platform/logging.h"
 
 namespace xla {
@@ -122,6 +128,19 @@ void SetInstructionMetadata(HloModuleGroup& module_group) {
 
 }  // namespace
 
+/* static */ std::optional<uint64_t> HloPassPipeline::SkipFingerprint(
+    const HloModule& module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  std::vector<absl::string_view> threads(execution_threads.begin(),
+                                         execution_threads.end());
+  absl::c_sort(threads);
+  uint64_t fp = HloModuleStructuralFingerprint(module);
+  for (absl::string_view thread : threads) {
+    fp = tsl::FingerprintCat64(fp, tsl::Fingerprint64(thread));
+  }
+  return fp;
+}
+
 template <typename HloT>
 Status HloPassPipeline::RunInvariantCheckers(
     HloT* hlo, absl::string_view after_pass_name,
@@ -169,19 +188,49 @@ StatusOr<bool> HloPassPipeline::RunPassesInternal(
   RecordPassEndMetadata(*hlo, std::string(kPipelineStart),
                         /*module_changed=*/false);
 
+  // Added by Alpa. Without stats of its own, the pipeline reports to the
+  // stats installed by ScopedCompilationStats, if any.
+  CompilationStats* compilation_stats = compilation_stats_;
+  if (compilation_stats_ == empty_compilation_stats_.get() &&
+      ScopedCompilationStats::Current() != nullptr) {
+    compilation_stats = ScopedCompilationStats::Current();
+  }
+
   bool changed = false;
+  // Added by Alpa. The fingerprint of the module if it is known, i.e. if it
+  // was computed after the last pass that changed the module.
+  std::optional<uint64_t> fingerprint;
   for (int i = 0; i < passes.size(); i++) {
     HloPassInterface* pass = passes[i];
+    // Added by Alpa
+    if (skip_unchanged_passes_) {
+      auto it = unchanged_fingerprints_.find(pass);
+      if (it != unchanged_fingerprints_.end()) {
+        if (!fingerprint.has_value()) {
+          fingerprint = SkipFingerprint(*hlo, execution_threads);
+        }
+        if (fingerprint == it->second) {
+          VLOG(1) << "  Skipping HLO pass " << pass->name()
+                  << " on an unchanged module";
+          continue;
+        }
+      }
+    }
     XLA_SCOPED_LOGGING_TIMER(absl::StrCat("HLO pass: ", pass->name()));
     std::string pass_name = std::string(pass->name());
     VLOG(1) << "  HLO pass " << pass_name;
     VLOG(2) << "  Module hash " << absl::HashOf(*hlo);
     if (!pass->IsPassPipeline()) {
-      compilation_stats_->StartPass(pass_name);
+      compilation_stats->StartPass(pass_name);
     }
     RecordPassStartMetadata(*hlo, pass_name, pipeline_name);
-    TF_ASSIGN_OR_RETURN(bool pass_changed,
-                        RunHelper(pass, hlo, execution_threads));
+    StatusOr<bool> pass_result = RunHelper(pass, hlo, execution_threads);
+    // Added by Alpa. End the failed pass, since the stats may outlive this
+    // compilation.
+    if (!pass_result.ok() && !pass->IsPassPipeline()) {
+      compilation_stats->EndPass(pass_name, /*module_changed=*/false);
+    }
+    TF_ASSIGN_OR_RETURN(bool pass_changed, std::move(pass_result));
     SetInstructionMetadata(*hlo);
     if (!dump_regex.empty() && (pass_changed || dump_regex != ".*")) {
       MaybeDumpHloAndSaveFilenames(*hlo,
@@ -191,13 +240,27 @@ StatusOr<bool> HloPassPipeline::RunPassesInternal(
                                        : passes[i + 1]->name());
     }
     RecordPassEndMetadata(*hlo, pass_name, pass_changed);
+    // Added by Alpa
+    if (skip_unchanged_passes_) {
+      if (pass_changed) {
+        fingerprint.reset();
+        unchanged_fingerprints_.erase(pass);
+      } else {
+        if (!fingerprint.has_value()) {
+          fingerprint = SkipFingerprint(*hlo, execution_threads);
+        }
+        if (fingerprint.has_value()) {
+          unchanged_fingerprints_[pass] = *fingerprint;
+        }
+      }
+    }
     changed |= pass_changed;
     if (pass_changed) {
       VLOG(3) << "  Pass caused changes " << pass->name();
     }
     TF_RETURN_IF_ERROR(RunInvariantCheckers(hlo, pass_name));
     if (!pass->IsPassPipeline()) {
-      compilation_stats_->EndPass(pass_name);
+      compilation_stats->EndPass(pass_name, pass_changed);
     }
   }
   return changed;
@@ -17,10 +17,13 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_PASS_PIPELINE_H_
 
 #include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_cat.h"
 #include "tensorflow/compiler/xla/service/compilation_stats.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
@@ -94,6 +97,14 @@ class HloPassPipeline : public HloPassInterface {
   // Return reference to pass specified by index.
   HloPassInterface& GetPass(int index) { return *passes_[index]; }
 
+  // Added by Alpa. Skips a pass on a module with the structural fingerprint
+  // on which the pass last ran without changes, e.g. in the later iterations
+  // of an HloPassFix<HloPassPipeline>. Only valid if the passes are
+  // idempotent and depend on nothing but the module.
+  void set_skip_unchanged_passes(bool skip_unchanged_passes) {
+    skip_unchanged_passes_ = skip_unchanged_passes;
+  }
+
  private:
   // Returns the set of passes which are enabled. DebugOptions can selectively
   // disable passes via --xla_disable_hlo_passes flag.
@@ -150,6 +161,17 @@ class HloPassPipeline : public HloPassInterface {
     return changed;
   }
 
+  // Added by Alpa. Returns the fingerprint that keys the passes to skip.
+  // Module groups are never skipped.
+  static std::optional<uint64_t> SkipFingerprint(
+      const HloModule& module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads);
+  static std::optional<uint64_t> SkipFingerprint(
+      const HloModuleGroup& module_group,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) {
+    return std::nullopt;
+  }
+
   const std::string name_;
   std::vector<std::unique_ptr<HloPassInterface>> passes_;
   std::vector<std::unique_ptr<HloPassInterface>> invariant_checkers_;
@@ -160,6 +182,12 @@ class HloPassPipeline : public HloPassInterface {
   // Use via compilation_stats_, not directly.
   std::unique_ptr<CompilationStats> empty_compilation_stats_;
 
+  // Added by Alpa. The fingerprint of the module after the last run of each
+  // pass that did not change it.
+  bool skip_unchanged_passes_ = false;
+  absl::flat_hash_map<const HloPassInterface*, uint64_t>
+      unchanged_fingerprints_;
+
   // Allow PhaseOrderPipeline to modify private passes_ member in order to
   // perform PhaseOrdering.
   friend class ::xla::PhaseOrderPipeline;
@@ -401,5 +401,84 @@ TEST_F(HloPassPipelineTest, SetHloModuleMetadata) {
   }
 }
 
+// A module pass which never changes the module and counts its runs.
+class CountingModulePass : public HloModulePass {
+ public:
+  explicit CountingModulePass(int* num_runs) : num_runs_(num_runs) {}
+  absl::string_view name() const override { return "counting"; }
+
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(HloModule* module,
+                     const absl::flat_hash_set<absl::string_view>&
+                         execution_threads) override {
+    ++*num_runs_;
+    return false;
+  }
+
+ private:
+  int* num_runs_;
+};
+
+TEST_F(HloPassPipelineTest, SkipUnchangedPasses) {
+  const std::string module_str = R"(
+HloModule SkipUnchangedPasses
+
+ENTRY main {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT foo = f32[] multiply(a, b)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<VerifiedHloModule> module,
+                          ParseAndReturnVerifiedModule(module_str));
+  int num_runs = 0;
+  HloPassPipeline pipeline(TestName());
+  pipeline.set_skip_unchanged_passes(true);
+  pipeline.AddPass<CountingModulePass>(&num_runs);
+  // Renames the root, which does not change the structural fingerprint.
+  pipeline.AddPass<FooToBarModulePass>();
+
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, pipeline.Run(module.get()));
+  EXPECT_TRUE(changed);
+  TF_ASSERT_OK_AND_ASSIGN(changed, pipeline.Run(module.get()));
+  EXPECT_FALSE(changed);
+  EXPECT_EQ(num_runs, 1);
+
+  HloComputation* entry = module->entry_computation();
+  HloInstruction* root = entry->root_instruction();
+  entry->set_root_instruction(entry->AddInstruction(
+      HloInstruction::CreateBinary(root->shape(), HloOpcode::kAdd,
+                                   root->mutable_operand(0),
+                                   root->mutable_operand(1))));
+  TF_ASSERT_OK_AND_ASSIGN(changed, pipeline.Run(module.get()));
+  EXPECT_EQ(num_runs, 2);
+}
+
+TEST_F(HloPassPipelineTest, ScopedCompilationStats) {
+  const std::string module_str = R"(
+HloModule ScopedCompilationStats
+
+ENTRY main {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT foo = f32[] multiply(a, b)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<VerifiedHloModule> module,
+                          ParseAndReturnVerifiedModule(module_str));
+  std::unique_ptr<CompilationStats> stats = CompilationStats::MakeStats();
+  {
+    ScopedCompilationStats scoped_stats(stats.get());
+    HloPassPipeline pipeline(TestName());
+    pipeline.AddPass<FooToBarModulePass>();
+    TF_ASSERT_OK(pipeline.Run(module.get()).status());
+  }
+  EXPECT_EQ(ScopedCompilationStats::Current(), nullptr);
+  EXPECT_EQ(stats->GetPassesSize(), 1);
+  EXPECT_THAT(stats->ToJson(),
+              ::testing::HasSubstr("\"pass\": \"foo2bar\""));
+  EXPECT_THAT(stats->ToJson(), ::testing::HasSubstr("\"changed\": true"));
+}
+
 }  // namespace
 }  // namespace xla
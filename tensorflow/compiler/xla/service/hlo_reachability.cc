@@ -15,21 +15,171 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/hlo_reachability.h"
 
+#include <algorithm>
+#include <iterator>
 #include <queue>
 
+#include "absl/algorithm/container.h"
 #include "tensorflow/compiler/xla/service/hlo_opcode.h"
 
 namespace xla {
 
+namespace {
+
+// Appends `run` to the sorted `runs`, coalescing it with the last run if they
+// overlap or are adjacent.
+template <typename Run>
+void AppendRun(const Run& run, std::vector<Run>* runs) {
+  if (!runs->empty() && run.begin <= runs->back().end) {
+    runs->back().end = std::max(runs->back().end, run.end);
+  } else {
+    runs->push_back(run);
+  }
+}
+
+// Merges the sorted runs `a` and `b` into `out`.
+template <typename Run>
+void MergeRuns(const std::vector<Run>& a, const std::vector<Run>& b,
+               std::vector<Run>* out) {
+  out->clear();
+  out->reserve(a.size() + b.size());
+  auto a_it = a.begin();
+  auto b_it = b.begin();
+  while (a_it != a.end() || b_it != b.end()) {
+    if (b_it == b.end() || (a_it != a.end() && a_it->begin < b_it->begin)) {
+      AppendRun(*a_it++, out);
+    } else {
+      AppendRun(*b_it++, out);
+    }
+  }
+}
+
+}  // namespace
+
+bool HloReachabilityMap::BitVector::CompressedGet(size_t index) const {
+  uint32_t word_index = index / kBits;
+  auto run = std::upper_bound(
+      runs_.begin(), runs_.end(), word_index,
+      [](uint32_t value, const Run& run) { return value < run.begin; });
+  if (run != runs_.begin() && std::prev(run)->end > word_index) {
+    return true;
+  }
+  auto word = absl::c_lower_bound(word_indices_, word_index);
+  if (word == word_indices_.end() || *word != word_index) {
+    return false;
+  }
+  return words_[word - word_indices_.begin()] & (1ull << (index % kBits));
+}
+
+void HloReachabilityMap::BitVector::CompressedSet(size_t index) {
+  if (CompressedGet(index)) {
+    return;
+  }
+  uint32_t word_index = index / kBits;
+  Word bit = 1ull << (index % kBits);
+  auto word = absl::c_lower_bound(word_indices_, word_index);
+  size_t position = word - word_indices_.begin();
+  if (word == word_indices_.end() || *word != word_index) {
+    word_indices_.insert(word, word_index);
+    words_.insert(words_.begin() + position, bit);
+    return;
+  }
+  words_[position] |= bit;
+  if (words_[position] != kAllOnes) {
+    return;
+  }
+  // The word became all ones, so move it to the runs.
+  word_indices_.erase(word);
+  words_.erase(words_.begin() + position);
+  std::vector<Run> runs;
+  MergeRuns(runs_, {Run{word_index, word_index + 1}}, &runs);
+  runs_.swap(runs);
+}
+
+void HloReachabilityMap::BitVector::CompressedOrWith(const BitVector& other) {
+  DCHECK(other.compressed_);
+  if (other.runs_.empty() && other.words_.empty()) {
+    return;
+  }
+
+  // Merge the words, and collect the ones that became all ones as runs.
+  std::vector<uint32_t> word_indices;
+  std::vector<Word> words;
+  std::vector<Run> full_words;
+  word_indices.reserve(word_indices_.size() + other.word_indices_.size());
+  words.reserve(word_indices.capacity());
+  size_t i = 0;
+  size_t j = 0;
+  while (i < word_indices_.size() || j < other.word_indices_.size()) {
+    uint32_t word_index;
+    Word word;
+    if (j == other.word_indices_.size() ||
+        (i < word_indices_.size() &&
+         word_indices_[i] < other.word_indices_[j])) {
+      word_index = word_indices_[i];
+      word = words_[i++];
+    } else if (i == word_indices_.size() ||
+               other.word_indices_[j] < word_indices_[i]) {
+      word_index = other.word_indices_[j];
+      word = other.words_[j++];
+    } else {
+      word_index = word_indices_[i];
+      word = words_[i++] | other.words_[j++];
+    }
+    if (word == kAllOnes) {
+      AppendRun(Run{word_index, word_index + 1}, &full_words);
+    } else {
+      word_indices.push_back(word_index);
+      words.push_back(word);
+    }
+  }
+
+  std::vector<Run> runs;
+  MergeRuns(runs_, other.runs_, &runs);
+  if (!full_words.empty()) {
+    std::vector<Run> merged;
+    MergeRuns(runs, full_words, &merged);
+    runs.swap(merged);
+  }
+
+  // Drop the words covered by the runs.
+  size_t num_words = 0;
+  auto run = runs.begin();
+  for (size_t k = 0; k < word_indices.size(); ++k) {
+    while (run != runs.end() && run->end <= word_indices[k]) {
+      ++run;
+    }
+    if (run != runs.end() && run->begin <= word_indices[k]) {
+      continue;
+    }
+    word_indices[num_words] = word_indices[k];
+    words[num_words] = words[k];
+    ++num_words;
+  }
+  word_indices.resize(num_words);
+  words.resize(num_words);
+
+  runs_.swap(runs);
+  word_indices_.swap(word_indices);
+  words_.swap(words);
+}
+
 HloReachabilityMap::HloReachabilityMap(
     absl::Span<const HloInstruction* const> instructions)
+    : HloReachabilityMap(
+          instructions,
+          /*compressed=*/instructions.size() >= kMinInstructionsToCompress) {}
+
+HloReachabilityMap::HloReachabilityMap(
+    absl::Span<const HloInstruction* const> instructions, bool compressed)
     : size_(instructions.size()) {
   bit_vectors_.reserve(size_);
   for (const HloInstruction* hlo : instructions) {
     indices_[GetKey(hlo)] = bit_vectors_.size();
-    bit_vectors_.emplace_back(size_);
+    bit_vectors_.emplace_back(size_, compressed);
   }
   CHECK_EQ(size_, indices_.size());  // instructions should be unique
+  tmp_bit_vector_ = BitVector(size_, compressed);
 }
 
 bool HloReachabilityMap::SetReachabilityToUnion(
@@ -62,6 +62,14 @@ class HloReachabilityMap {
   explicit HloReachabilityMap(
       absl::Span<const HloInstruction* const> instructions);
 
+  // Added by Alpa. As above, but chooses whether the reachability sets are
+  // stored compressed. By default they are compressed for at least
+  // kMinInstructionsToCompress instructions, where the dense N x N bit matrix
+  // would take gigabytes.
+  HloReachabilityMap(absl::Span<const HloInstruction* const> instructions,
+                     bool compressed);
+  static constexpr int64_t kMinInstructionsToCompress = 1 << 15;
+
   // Computes and returns the reachability between HLO instructions in the
   // computation. The returned HloReachabilityMap is constructed such that
   // HloReachabilityMap::IsReachable(a, b) returns true iff there exists a
@@ -159,49 +167,96 @@ class HloReachabilityMap {
  private:
   // A bit-vector implementation specialized for this use case which provides a
   // fast bitwise OR operation not available in tsl::gtl::BitMap.
+  //
+  // Added by Alpa. A compressed bit vector only stores its runs of all-ones
+  // words and its other non-zero words. Since an instruction is reachable
+  // from most of the instructions before it in a deep graph, and from none
+  // after it, the reachability sets are mostly such runs and zeros.
   class BitVector {
    public:
     BitVector() = default;
-    BitVector(size_t size)
-        : size_(size), vector_((size + kBits - 1) / kBits, 0) {}
+    BitVector(size_t size, bool compressed = false)
+        : size_(size),
+          compressed_(compressed),
+          vector_(compressed ? 0 : (size + kBits - 1) / kBits, 0) {}
 
     // Return the bit at the given index.
     bool Get(size_t index) const {
       DCHECK(index >= 0 && index < size_);
+      if (compressed_) {
+        return CompressedGet(index);
+      }
       return vector_[index / kBits] & (1ull << (index % kBits));
     }
 
     // Set the bit at the given index.
     void Set(size_t index) {
       DCHECK(index >= 0 && index < size_);
+      if (compressed_) {
+        CompressedSet(index);
+        return;
+      }
       vector_[index / kBits] |= 1ull << (index % kBits);
     }
 
     // Set this bitvector to the Logical OR of this bitvector and 'other'.
     void OrWith(const BitVector& other) {
+      if (compressed_) {
+        CompressedOrWith(other);
+        return;
+      }
       for (size_t i = 0; i < vector_.size(); ++i) {
         vector_[i] |= other.vector_[i];
       }
     }
 
     // Set the bitvector to all zeros.
-    void SetToZero() { std::fill(vector_.begin(), vector_.end(), 0); }
+    void SetToZero() {
+      std::fill(vector_.begin(), vector_.end(), 0);
+      runs_.clear();
+      word_indices_.clear();
+      words_.clear();
+    }
 
+    // The representation of a compressed bit vector is canonical, so it can
+    // be compared member-wise.
     bool operator==(const BitVector& other) const {
-      return vector_ == other.vector_;
-    }
-    bool operator!=(const BitVector& other) const {
-      return vector_ != other.vector_;
+      return vector_ == other.vector_ && runs_ == other.runs_ &&
+             word_indices_ == other.word_indices_ && words_ == other.words_;
     }
+    bool operator!=(const BitVector& other) const { return !(*this == other); }
 
    private:
     using Word = uint64_t;
     static constexpr size_t kBits = 64;
+    static constexpr Word kAllOnes = ~Word{0};
+
+    // A run of all-ones words [begin, end).
+    struct Run {
+      uint32_t begin;
+      uint32_t end;
+      bool operator==(const Run& other) const {
+        return begin == other.begin && end == other.end;
+      }
+    };
+
+    bool CompressedGet(size_t index) const;
+    void CompressedSet(size_t index);
+    void CompressedOrWith(const BitVector& other);
 
     // Number of bits in the bitvector.
     size_t size_;
+    bool compressed_ = false;
 
+    // The words of a dense bit vector.
     std::vector<Word> vector_;
+
+    // The words of a compressed bit vector: sorted runs that are neither
+    // overlapping nor adjacent, and the sorted indices and values of the
+    // words outside the runs that are neither zero nor all ones.
+    std::vector<Run> runs_;
+    std::vector<uint32_t> word_indices_;
+    std::vector<Word> words_;
   };
 
   // Return the bitvector storing the reachability-to of the given instruction.
@@ -15,7 +15,9 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/hlo_reachability.h"
 
+#include <random>
 #include <set>
+#include <vector>
 
 #include "tensorflow/compiler/xla/service/computation_placer.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
@@ -240,6 +242,50 @@ TEST_F(HloReachabilityTest, ReplaceInstructions) {
   EXPECT_TRUE(reachability->IsReachable(p0, fusion));
 }
 
+TEST_F(HloReachabilityTest, CompressedMatchesDense) {
+  // Build the same random DAG in a dense and a compressed map. Most nodes
+  // depend on the previous node and some on a random older one, so that the
+  // compressed sets contain both runs of ones and sparse words.
+  constexpr int kNumNodes = 400;
+  auto builder = HloComputation::Builder(TestName());
+  std::vector<HloInstruction*> nodes;
+  for (int i = 0; i < kNumNodes; ++i) {
+    nodes.push_back(builder.AddInstruction(
+        HloInstruction::CreateConstant(LiteralUtil::CreateR0<float>(i))));
+  }
+  auto module = CreateNewVerifiedModule();
+  module->AddEntryComputation(builder.Build());
+
+  HloReachabilityMap dense(nodes, /*compressed=*/false);
+  HloReachabilityMap compressed(nodes, /*compressed=*/true);
+  std::mt19937 rng(42);
+  std::vector<const HloInstruction*> inputs;
+  for (int i = 0; i < kNumNodes; ++i) {
+    inputs.clear();
+    if (i > 0 && rng() % 8 != 0) {
+      inputs.push_back(nodes[i - 1]);
+    }
+    if (i > 0 && rng() % 4 == 0) {
+      inputs.push_back(nodes[rng() % i]);
+    }
+    EXPECT_EQ(dense.SetReachabilityToUnion(inputs, nodes[i]),
+              compressed.SetReachabilityToUnion(inputs, nodes[i]));
+  }
+  dense.SetReachable(nodes[kNumNodes - 1], nodes[0]);
+  compressed.SetReachable(nodes[kNumNodes - 1], nodes[0]);
+
+  for (const HloInstruction* a : nodes) {
+    for (const HloInstruction* b : nodes) {
+      ASSERT_EQ(dense.IsReachable(a, b), compressed.IsReachable(a, b))
+          << a->name() << " -> " << b->name();
+    }
+  }
+  // Both maps report the same change when a set is recomputed.
+  inputs.assign({nodes[kNumNodes - 3], nodes[kNumNodes - 2]});
+  EXPECT_EQ(dense.SetReachabilityToUnion(inputs, nodes[kNumNodes - 1]),
+            compressed.SetReachabilityToUnion(inputs, nodes[kNumNodes - 1]));
+}
+
 }  // namespace
 
 }  // namespace xla
@@ -507,7 +507,9 @@ class MemoryUsageTracker {
       const HloRematerialization::CompactShapeFunction& compact_shape_function,
       const HloDataflowAnalysis& dataflow_analysis,
       const InstructionList& instruction_list,
-      HloRematerialization::RematerializationMode mode);
+      HloRematerialization::RematerializationMode mode,
+      const HloRematerialization::RecomputeCostFunction&
+          recompute_cost_function);
 
   // Starts the placement of the given instruction. This adds the sizes of the
   // HloValues defined by the instruction to the current memory
@@ -538,6 +540,16 @@ class MemoryUsageTracker {
     }
 
     CHECK_GT(memory_reduced, 0);
+    if (recompute_cost_function_ != nullptr) {
+      // Scale the inverse of the benefit by the compute spent to recompute
+      // the block.
+      double recompute_cost = 0;
+      for (auto* item : items) {
+        recompute_cost += recompute_cost_function_(*item->instruction);
+      }
+      return static_cast<int64_t>(static_cast<double>(memory_limit_bytes) /
+                                  memory_reduced * (1.0 + recompute_cost));
+    }
     // Return the inverse of the benefit of rematerialization.
     return memory_limit_bytes / memory_reduced;
   }
@@ -792,6 +804,9 @@ class MemoryUsageTracker {
   Item* in_progress_item_ = nullptr;
 
   HloRematerialization::RematerializationMode mode_;
+
+  const HloRematerialization::RecomputeCostFunction& recompute_cost_function_;
+
   // All buffers in the computation.
   std::vector<Buffer> buffers_;
 };
@@ -802,12 +817,14 @@ MemoryUsageTracker::MemoryUsageTracker(
     const HloRematerialization::CompactShapeFunction& compact_shape_function,
     const HloDataflowAnalysis& dataflow_analysis,
     const InstructionList& instruction_list,
-    HloRematerialization::RematerializationMode mode)
+    HloRematerialization::RematerializationMode mode,
+    const HloRematerialization::RecomputeCostFunction& recompute_cost_function)
     : computation_(computation),
       instruction_list_(instruction_list),
       size_function_(size_function),
       compact_shape_function_(compact_shape_function),
-      mode_(mode) {
+      mode_(mode),
+      recompute_cost_function_(recompute_cost_function) {
   tsl::gtl::CompactPointerSet<const HloValue*> live_out_set;
   for (auto& [_, hlo_value_set] : dataflow_analysis.GetInstructionValueSet(
            computation_->root_instruction())) {
@@ -1861,7 +1878,8 @@ StatusOr<int64_t> HloRematerialization::ComputePeakMemory(
   InstructionList instruction_list(order);
   MemoryUsageTracker tracker(computation, size_function_,
                              compact_shape_function_, *dataflow_analysis_,
-                             instruction_list, mode_);
+                             instruction_list, mode_,
+                             recompute_cost_function_);
   int64_t peak_memory = tracker.memory_usage();
   for (auto* item = instruction_list.first(); item != nullptr;
        item = instruction_list.next(item)) {
@@ -1918,7 +1936,7 @@ StatusOr<bool> HloRematerialization::RematerializeComputation(
   InstructionList instruction_list(schedule->sequence(computation));
   MemoryUsageTracker memory_tracker(
       computation, size_function_, compact_shape_function_, *dataflow_analysis_,
-      instruction_list, mode_);
+      instruction_list, mode_, recompute_cost_function_);
 
   instruction_list.PromoteNodesToSkip([&](Item* item) {
     return memory_tracker.AllocatedSize(item) >= min_remat_size;
@@ -42,6 +42,8 @@ class HloRematerialization : public HloModulePass {
 
   using CompactShapeFunction = std::function<StatusOr<Shape>(const Shape&)>;
 
+  using RecomputeCostFunction = std::function<double(const HloInstruction&)>;
+
   // Helper struct that communicates the before / after sizes for the
   // rematerialization process.
   struct RematerializationSizes {
@@ -80,13 +82,21 @@ class HloRematerialization : public HloModulePass {
   //
   //   compact_shape_function: Function which returns the compact form of a
   //   shape. If nullptr is provided, an default identity function is used.
+  //
+  //   recompute_cost_function: Function which returns the relative compute
+  //     cost of recomputing an instruction, e.g., its estimated time divided
+  //     by the average time of an instruction. The cost per byte of a
+  //     recomputed block is scaled by one plus the sum of the costs of its
+  //     instructions, so that cheap recomputes are preferred among blocks
+  //     saving similar memory. If nullptr is provided, compute is free.
   explicit HloRematerialization(
       const ShapeSizeFunction& size_function, int64_t memory_limit_bytes,
       RematerializationSizes* sizes, RematerializationPass pass_location,
       int block_size_limit, int block_rematerialization_factor,
       CompactShapeFunction compact_shape_function = nullptr,
       RematerializationMode mode = RematerializationMode::kRecomputeAndCompress,
-      int64_t min_remat_size = 0)
+      int64_t min_remat_size = 0,
+      RecomputeCostFunction recompute_cost_function = nullptr)
       : size_function_(size_function),
         memory_limit_bytes_(memory_limit_bytes),
         sizes_(sizes),
@@ -97,7 +107,8 @@ class HloRematerialization : public HloModulePass {
                                     ? DefaultCompactShapeFunction
                                     : std::move(compact_shape_function)),
         mode_(mode),
-        min_remat_size_(min_remat_size) {}
+        min_remat_size_(min_remat_size),
+        recompute_cost_function_(std::move(recompute_cost_function)) {}
   ~HloRematerialization() override = default;
 
   absl::string_view name() const override { return "rematerialization"; }
@@ -224,6 +235,9 @@ class HloRematerialization : public HloModulePass {
 
   int64_t min_remat_size_;
 
+  // Returns the relative cost of recomputing an instruction. Can be nullptr.
+  const RecomputeCostFunction recompute_cost_function_;
+
   // Tracking available channel id numbers to use to apply to rematerialized
   // channel instructions
   int64_t next_channel_id_;
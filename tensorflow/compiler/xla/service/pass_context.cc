@@ -106,6 +106,10 @@ double GetDouble(const std::string& name) {
   return GetWithoutDefaultValue<double>(name);
 }
 
+double GetDouble(const std::string& name, double default_value) {
+  return GetWithDefaultValue<double>(name, default_value);
+}
+
 std::string GetString(const std::string& name,
                       const std::string& default_value) {
   return GetWithDefaultValue<std::string>(name, default_value);
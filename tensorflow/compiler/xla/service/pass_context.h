@@ -25,6 +25,8 @@ bool GetBool(const std::string& name, bool default_value);
 
 double GetDouble(const std::string& name);
 
+double GetDouble(const std::string& name, double default_value);
+
 std::string GetString(const std::string& name, const std::string& default_value);
 
 std::vector<int64_t> GetIntVector(const std::string& name);
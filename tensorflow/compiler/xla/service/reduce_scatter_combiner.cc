@@ -110,9 +110,11 @@ Status CombineReduceScatters(absl::Span<HloInstruction* const> to_combine) {
 }  // namespace
 
 ReduceScatterCombiner::ReduceScatterCombiner(int64_t combine_threshold_in_bytes,
-                                             int64_t combine_threshold_count)
+                                             int64_t combine_threshold_count,
+                                             CollectiveCombinerOptions options)
     : combine_threshold_in_bytes_(combine_threshold_in_bytes),
-      combine_threshold_count_(combine_threshold_count) {}
+      combine_threshold_count_(combine_threshold_count),
+      options_(std::move(options)) {}
 
 StatusOr<bool> ReduceScatterCombiner::Run(
     HloModule* module,
@@ -157,7 +159,7 @@ StatusOr<bool> ReduceScatterCombiner::Run(
         bool computation_changed,
         CombineInstructionsByKey<ReduceScatterKey>(
             computation, key_fn, &CombineReduceScatters,
-            combine_threshold_in_bytes_, combine_threshold_count_));
+            combine_threshold_in_bytes_, combine_threshold_count_, options_));
     changed |= computation_changed;
   }
 
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_REDUCE_SCATTER_COMBINER_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_REDUCE_SCATTER_COMBINER_H_
 
+#include "tensorflow/compiler/xla/service/collective_combiner_utils.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
 #include "tensorflow/compiler/xla/statusor.h"
@@ -29,7 +30,8 @@ namespace xla {
 class ReduceScatterCombiner : public HloModulePass {
  public:
   ReduceScatterCombiner(int64_t combine_threshold_in_bytes,
-                        int64_t combine_threshold_count);
+                        int64_t combine_threshold_count,
+                        CollectiveCombinerOptions options = {});
 
   absl::string_view name() const override { return "reduce-scatter-combiner"; }
 
@@ -44,6 +46,8 @@ class ReduceScatterCombiner : public HloModulePass {
 
   // Combine reduce-scatter ops up to this threshold (number of operands).
   int64_t combine_threshold_count_;
+
+  CollectiveCombinerOptions options_;
 };
 
 }  // namespace xla
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/client/lib/prng.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
 #include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
@@ -46,8 +47,65 @@ XlaOp GetPhiloxOutputStateOp(XlaOp output_state, const Shape& state_shape) {
   return output_state;
 }
 
+// Clones the computation built by `builder` into `module`.
+StatusOr<HloComputation*> AddBuiltComputation(XlaBuilder* builder,
+                                              HloModule* module) {
+  TF_ASSIGN_OR_RETURN(XlaComputation xla_computation, builder->Build());
+  TF_ASSIGN_OR_RETURN(ProgramShape program_shape,
+                      xla_computation.GetProgramShape());
+  HloModuleConfig config(program_shape);
+  TF_ASSIGN_OR_RETURN(auto new_module, HloModule::CreateFromProto(
+                                           xla_computation.proto(), config));
+  HloCloneContext context(module);
+  return module->DeepCloneComputation(new_module->entry_computation(),
+                                      &context);
+}
+
 }  // namespace
 
+int64_t PhiloxElementsPerCounter(PrimitiveType type) {
+  switch (primitive_util::BitWidth(type)) {
+    case 32:
+      return 4;
+    case 64:
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+StatusOr<HloComputation*> CreatePhiloxShardStateComputation(
+    const Shape& data_shape, const Shape& state_shape, HloModule* module) {
+  const int64_t elements_per_counter =
+      PhiloxElementsPerCounter(data_shape.element_type());
+  if (elements_per_counter == 0) {
+    return Unimplemented("Unsupported Philox data type: %s",
+                         PrimitiveType_Name(data_shape.element_type()));
+  }
+  const int64_t num_counters = CeilOfRatio<int64_t>(
+      ShapeUtil::ElementsIn(data_shape), elements_per_counter);
+
+  XlaBuilder builder("rng_shard_state");
+  XlaOp state_param = Parameter(&builder, 0, state_shape, "state");
+  XlaOp offset_param =
+      Parameter(&builder, 1, ShapeUtil::MakeShape(U64, {}), "offset");
+  XlaOp key = Slice(state_param, {0}, {1}, {1});
+  XlaOp counter = GetPhiloxStateOp(state_param, state_shape);
+  // Always use the three element state for the shard, so that a carry into
+  // the high half of the counter is kept.
+  XlaOp shard_state = ConcatInDim(
+      &builder, {key, PhiloxIncreaseCounter(counter, offset_param)}, 0);
+  XlaOp output_state = ConcatInDim(
+      &builder,
+      {key, GetPhiloxOutputStateOp(
+                PhiloxIncreaseCounter(
+                    counter, ConstantR0<uint64_t>(&builder, num_counters)),
+                state_shape)},
+      0);
+  Tuple(&builder, {shard_state, output_state});
+  return AddBuiltComputation(&builder, module);
+}
+
 bool RngBitGeneratorExpander::InstructionMatchesPattern(
     HloInstruction* instruction) {
   return instruction->opcode() == HloOpcode::kRngBitGenerator;
@@ -84,16 +142,8 @@ StatusOr<HloComputation*> RngBitGeneratorExpander::GetGeneratorComputation(
   XlaOp final_state =
       ConcatInDim(&builder, {Reshape(key_op, {1}), output.state}, 0);
   Tuple(&builder, {final_state, output.value});
-  TF_ASSIGN_OR_RETURN(XlaComputation xla_computation, builder.Build());
-
-  TF_ASSIGN_OR_RETURN(ProgramShape program_shape,
-                      xla_computation.GetProgramShape());
-  HloModuleConfig config(program_shape);
-  TF_ASSIGN_OR_RETURN(auto new_module, HloModule::CreateFromProto(
-                                           xla_computation.proto(), config));
-  HloCloneContext context(module);
-  HloComputation* new_computation =
-      module->DeepCloneComputation(new_module->entry_computation(), &context);
+  TF_ASSIGN_OR_RETURN(HloComputation * new_computation,
+                      AddBuiltComputation(&builder, module));
   computation_cache_.emplace(cache_key, new_computation);
   return new_computation;
 }
@@ -26,6 +26,23 @@ limitations under the License.
 
 namespace xla {
 
+// Returns the number of elements of `type` that the Philox expansion of
+// rng-bit-generator derives from one 128-bit counter, or 0 if the type is not
+// supported. Element i of the flattened output only depends on the key and on
+// counter i / PhiloxElementsPerCounter(type).
+int64_t PhiloxElementsPerCounter(PrimitiveType type);
+
+// Returns a computation in `module` that takes the state operand of a Philox
+// rng-bit-generator with the given shapes and a u64 scalar counter offset, and
+// returns a tuple of
+//  - a u64[3] state for which rng-bit-generator produces the bits of the
+//    original rng-bit-generator starting at that counter offset, and
+//  - the output state of the original rng-bit-generator.
+// This lets every partition generate only its own shard of the random bits,
+// bitwise identical to the unpartitioned rng-bit-generator.
+StatusOr<HloComputation*> CreatePhiloxShardStateComputation(
+    const Shape& data_shape, const Shape& state_shape, HloModule* module);
+
 class RngBitGeneratorExpander : public OpExpanderPass {
  public:
   explicit RngBitGeneratorExpander(RandomAlgorithm default_algorithm)
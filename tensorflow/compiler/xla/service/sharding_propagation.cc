@@ -19,6 +19,7 @@ limitations under the License.
 #include <cstdint>
 #include <functional>
 #include <iterator>
+#include <limits>
 #include <list>
 #include <map>
 #include <memory>
@@ -28,6 +29,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/algorithm/container.h"
+#include "absl/container/btree_set.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/types/span.h"
@@ -1277,6 +1279,90 @@ bool IsCSEPreventionSharding(const HloSharding& sharding) {
          "_sharding_propagation_cse_prevention";
 }
 
+// The instructions whose sharding has already been inferred in one direction
+// of the propagation. With `positions`, which maps every instruction to its
+// computation and its index in the post order of the computation, the
+// instructions that are not in the cache are also kept in post order, so that
+// a sweep only visits them instead of every instruction.
+class InferenceCache {
+ public:
+  using PositionMap =
+      absl::flat_hash_map<const HloInstruction*, std::pair<int64_t, int64_t>>;
+
+  InferenceCache(const PositionMap* positions,
+                 const std::vector<std::vector<HloInstruction*>>& post_orders)
+      : positions_(positions) {
+    if (positions_ == nullptr) {
+      return;
+    }
+    pending_.resize(post_orders.size());
+    for (int64_t c = 0; c < post_orders.size(); ++c) {
+      for (int64_t i = 0; i < post_orders[c].size(); ++i) {
+        pending_[c].insert(pending_[c].end(), i);
+      }
+    }
+  }
+
+  bool contains(const HloInstruction* hlo) const {
+    return inferred_.contains(hlo);
+  }
+
+  void insert(const HloInstruction* hlo) {
+    inferred_.insert(hlo);
+    Skip(hlo);
+  }
+
+  void erase(const HloInstruction* hlo) {
+    inferred_.erase(hlo);
+    if (const std::pair<int64_t, int64_t>* position = Find(hlo)) {
+      pending_[position->first].insert(position->second);
+    }
+  }
+
+  // Does not visit `hlo` again until it is erased, without adding it to the
+  // cache. This is only for the instructions whose visit is a no-op.
+  void Skip(const HloInstruction* hlo) {
+    if (const std::pair<int64_t, int64_t>* position = Find(hlo)) {
+      pending_[position->first].erase(position->second);
+    }
+  }
+
+  // Returns the index of the next instruction after `index` in the post order
+  // of `computation` that has to be visited, or INT64_MAX if there is none.
+  int64_t Next(int64_t computation, int64_t index) const {
+    if (positions_ == nullptr) {
+      return index + 1;
+    }
+    auto it = pending_[computation].upper_bound(index);
+    return it == pending_[computation].end()
+               ? std::numeric_limits<int64_t>::max()
+               : *it;
+  }
+
+  // Returns the index of the previous instruction before `index` that has to
+  // be visited, or -1 if there is none.
+  int64_t Prev(int64_t computation, int64_t index) const {
+    if (positions_ == nullptr) {
+      return index - 1;
+    }
+    auto it = pending_[computation].lower_bound(index);
+    return it == pending_[computation].begin() ? -1 : *std::prev(it);
+  }
+
+ private:
+  const std::pair<int64_t, int64_t>* Find(const HloInstruction* hlo) const {
+    if (positions_ == nullptr) {
+      return nullptr;
+    }
+    auto it = positions_->find(hlo);
+    return it == positions_->end() ? nullptr : &it->second;
+  }
+
+  const PositionMap* positions_;
+  absl::flat_hash_set<const HloInstruction*> inferred_;
+  std::vector<absl::btree_set<int64_t>> pending_;
+};
+
 }  // namespace
 
 std::optional<HloSharding> InferBroadcastOperandSharding(
@@ -2555,8 +2641,25 @@ StatusOr<bool> ShardingPropagation::Run(
 
   std::unique_ptr<CallGraph> call_graph = CallGraph::Build(module);
   auto run_to_fix_point = [&](int64_t aggressiveness) {
-    absl::flat_hash_set<const HloInstruction*> already_inferred_from_operands;
-    absl::flat_hash_set<const HloInstruction*> already_inferred_from_users;
+    // With the worklist, the post order of every computation is computed once,
+    // because the propagation does not change the graph, and a sweep only
+    // visits the instructions that are not in the caches. It visits them in
+    // the same order as a full sweep, so the results are the same.
+    std::vector<std::vector<HloInstruction*>> post_orders;
+    InferenceCache::PositionMap positions;
+    if (use_worklist_) {
+      for (const HloComputation* computation :
+           module->computations(execution_threads)) {
+        post_orders.push_back(computation->MakeInstructionPostOrder());
+        for (int64_t i = 0; i < post_orders.back().size(); ++i) {
+          positions[post_orders.back()[i]] = {post_orders.size() - 1, i};
+        }
+      }
+    }
+    InferenceCache already_inferred_from_operands(
+        use_worklist_ ? &positions : nullptr, post_orders);
+    InferenceCache already_inferred_from_users(
+        use_worklist_ ? &positions : nullptr, post_orders);
     bool changed_last_iter = true;
     const bool may_merge_partial = is_spmd_ && aggressiveness > 0;
     while (changed_last_iter) {
@@ -2565,16 +2668,26 @@ StatusOr<bool> ShardingPropagation::Run(
       int64_t inferred_from_user_counter = 0;
       int64_t instruction_counter = 0;
       int64_t already_sharded_counter = 0;
+      int64_t computation_index = -1;
       for (const HloComputation* computation :
            module->computations(execution_threads)) {
+        ++computation_index;
         VLOG(2) << "Consider computation: " << computation->name();
-        std::vector<HloInstruction*> instructions =
-            computation->MakeInstructionPostOrder();
-
-        instruction_counter += instructions.size();
-        already_sharded_counter += absl::c_count_if(
-            instructions,
-            [](const HloInstruction* inst) { return inst->has_sharding(); });
+        std::vector<HloInstruction*> computation_post_order;
+        if (!use_worklist_) {
+          computation_post_order = computation->MakeInstructionPostOrder();
+        }
+        const std::vector<HloInstruction*>& instructions =
+            use_worklist_ ? post_orders[computation_index]
+                          : computation_post_order;
+        const int64_t num_instructions = instructions.size();
+
+        if (VLOG_IS_ON(1)) {
+          instruction_counter += instructions.size();
+          already_sharded_counter += absl::c_count_if(
+              instructions,
+              [](const HloInstruction* inst) { return inst->has_sharding(); });
+        }
         auto clear_cache = [&](HloInstruction* hlo,
                                HloInstruction* hlo_for_users = nullptr) {
           for (auto operand : hlo->operands()) {
@@ -2589,18 +2702,22 @@ StatusOr<bool> ShardingPropagation::Run(
         };
         // First iterate the HLO graph in post order taking shardings from
         // operands.
-        for (HloInstruction* instruction : instructions) {
+        for (int64_t i =
+                 already_inferred_from_operands.Next(computation_index, -1);
+             i < num_instructions;
+             i = already_inferred_from_operands.Next(computation_index, i)) {
+          HloInstruction* instruction = instructions[i];
           if (already_inferred_from_operands.contains(instruction)) {
             continue;
           }
           if (provided_shardings.contains(instruction)) {
-            if (!may_merge_partial) {
+            auto it = unspecified_dims.find(instruction);
+            if (!may_merge_partial || it == unspecified_dims.end()) {
+              already_inferred_from_operands.Skip(instruction);
               continue;
             }
-            auto it = unspecified_dims.find(instruction);
             HloInstruction* man_conversion_op_after;
-            if (it != unspecified_dims.end() &&
-                InferUnspecifiedDimsFromOperand(instruction, it->second,
+            if (InferUnspecifiedDimsFromOperand(instruction, it->second,
                                                 &man_conversion_op_after)) {
               ++inferred_from_operand_counter;
               VLOG(2) << "Refined partial sharding (forward-pass): "
@@ -2630,34 +2747,43 @@ StatusOr<bool> ShardingPropagation::Run(
 
         // Then iterate the HLO graph in reverse post order taking shardings
         // from users.
-        for (auto it = instructions.rbegin(); it != instructions.rend(); ++it) {
-          if ((*it)->IsCustomCall("SPMDFullToShardShape") ||
-              (*it)->IsCustomCall("SPMDShardToFullShape")) {
+        for (int64_t i = already_inferred_from_users.Prev(computation_index,
+                                                          num_instructions);
+             i >= 0; i = already_inferred_from_users.Prev(computation_index, i)) {
+          HloInstruction* instruction = instructions[i];
+          const bool is_manual_conversion =
+              instruction->IsCustomCall("SPMDFullToShardShape") ||
+              instruction->IsCustomCall("SPMDShardToFullShape");
+          if (is_manual_conversion) {
             // The manual conversion op is processed together with the sharding
             // op before it. If the conversion op is removed from cache, the
             // sharding op should also be removed.
-            if (!already_inferred_from_users.contains(*it)) {
-              already_inferred_from_users.erase((*it)->operand(0));
+            if (!already_inferred_from_users.contains(instruction)) {
+              already_inferred_from_users.erase(instruction->operand(0));
             }
           }
-          if (already_inferred_from_users.contains(*it)) {
+          if (already_inferred_from_users.contains(instruction)) {
             continue;
           }
-          if (provided_shardings.contains(*it)) {
-            if (!may_merge_partial) {
+          if (provided_shardings.contains(instruction)) {
+            auto uit = unspecified_dims.find(instruction);
+            if (!may_merge_partial || uit == unspecified_dims.end()) {
+              // A manual conversion op is visited in every sweep, because it
+              // removes the sharding op before it from the cache.
+              if (!is_manual_conversion) {
+                already_inferred_from_users.Skip(instruction);
+              }
               continue;
             }
-            auto uit = unspecified_dims.find(*it);
             HloInstruction* man_conversion_op_after;
-            if (uit != unspecified_dims.end() &&
-                InferUnspecifiedDimsFromUsers(
-                    *it, uit->second, aggressiveness, is_spmd_,
+            if (InferUnspecifiedDimsFromUsers(
+                    instruction, uit->second, aggressiveness, is_spmd_,
                     &man_conversion_op_after, *call_graph)) {
               ++inferred_from_user_counter;
               VLOG(2) << "Refined partial sharding (backward-pass): "
-                      << (*it)->ToString();
-              clear_cache(*it, man_conversion_op_after);
-              already_inferred_from_users.insert(*it);
+                      << instruction->ToString();
+              clear_cache(instruction, man_conversion_op_after);
+              already_inferred_from_users.insert(instruction);
               if (man_conversion_op_after != nullptr) {
                 already_inferred_from_users.insert(man_conversion_op_after);
               }
@@ -2665,16 +2791,17 @@ StatusOr<bool> ShardingPropagation::Run(
             }
             continue;
           }
-          already_inferred_from_users.insert(*it);
-          if (InferShardingFromUsers(*it, computation_map, aggressiveness,
-                                     is_spmd_, sharding_helper_.get(),
-                                     *call_graph)) {
+          already_inferred_from_users.insert(instruction);
+          if (InferShardingFromUsers(instruction, computation_map,
+                                     aggressiveness, is_spmd_,
+                                     sharding_helper_.get(), *call_graph)) {
             ++inferred_from_user_counter;
             any_changed = true;
-            VLOG(2) << "Add sharding (backward-pass): " << (*it)->ToString();
+            VLOG(2) << "Add sharding (backward-pass): "
+                    << instruction->ToString();
             absl::flat_hash_set<HloInstruction*> changed_in_comp_prop;
-            maybe_computation_propagation(*it, &changed_in_comp_prop);
-            clear_cache(*it);
+            maybe_computation_propagation(instruction, &changed_in_comp_prop);
+            clear_cache(instruction);
             for (auto hlo : changed_in_comp_prop) {
               clear_cache(hlo);
             }
@@ -8426,5 +8426,59 @@ ENTRY %entry {
   EXPECT_TRUE(changed);
 }
 
+TEST_F(ShardingPropagationTest, WorklistMatchesFullSweep) {
+  const char* const hlo_string = R"(
+HloModule module
+
+ENTRY %entry {
+  %param0 = f32[8,16] parameter(0), sharding={devices=[2,1,2]0,1,2,3 last_tile_dim_replicate}
+  %param1 = f32[16,32] parameter(1)
+  %dot = f32[8,32] dot(%param0, %param1), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+  %annotate = f32[8,32] custom-call(%dot), custom_call_target="Sharding",
+    backend_config="unspecified_dims=[0]",
+    sharding={devices=[1,2,2]0,1,2,3 last_tile_dim_replicate}
+  %transpose = f32[32,8] transpose(%annotate), dimensions={1,0}
+  %reshape = f32[4,8,8] reshape(%transpose)
+  %constant = f32[] constant(0)
+  %broadcast = f32[4,8,8] broadcast(%constant), dimensions={}
+  %add = f32[4,8,8] add(%reshape, %broadcast)
+  %copy = f32[8,32] copy(%annotate)
+  ROOT %tuple = (f32[4,8,8], f32[8,32]) tuple(%add, %copy)
+})";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto full_sweep_module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(auto worklist_module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(
+      bool full_sweep_changed,
+      ShardingPropagation(/*is_spmd=*/true, /*propagate_metadata=*/true,
+                          /*allow_spmd_sharding_propagation_to_output=*/true)
+          .Run(full_sweep_module.get()));
+  TF_ASSERT_OK_AND_ASSIGN(
+      bool worklist_changed,
+      ShardingPropagation(/*is_spmd=*/true, /*propagate_metadata=*/true,
+                          /*allow_spmd_sharding_propagation_to_output=*/true,
+                          /*cse_prevention_only=*/false,
+                          /*sharding_helper=*/nullptr, /*use_worklist=*/true)
+          .Run(worklist_module.get()));
+  XLA_VLOG_LINES(1, worklist_module->ToString());
+  EXPECT_TRUE(full_sweep_changed);
+  EXPECT_EQ(worklist_changed, full_sweep_changed);
+  for (const HloInstruction* instruction :
+       full_sweep_module->entry_computation()->instructions()) {
+    const HloInstruction* other =
+        FindInstruction(worklist_module.get(), instruction->name());
+    ASSERT_NE(other, nullptr);
+    ASSERT_EQ(other->has_sharding(), instruction->has_sharding())
+        << instruction->name();
+    if (instruction->has_sharding()) {
+      EXPECT_EQ(other->sharding(), instruction->sharding())
+          << instruction->name();
+    }
+  }
+}
+
 }  // namespace
 }  // namespace xla
@@ -29,6 +29,7 @@
 #include "tensorflow/compiler/xla/service/hlo_pass_pipeline.h"
 #include "tensorflow/compiler/xla/service/hlo_sharding_metadata.h"
 #include "tensorflow/compiler/xla/service/hlo_verifier.h"
+#include "tensorflow/compiler/xla/service/pass_context.h"
 #include "tensorflow/compiler/xla/service/reshape_mover.h"
 #include "tensorflow/compiler/xla/service/scatter_expander.h"
 #include "tensorflow/compiler/xla/service/scatter_simplifier.h"
@@ -61,6 +62,37 @@ void AddHloVerifier(HloPassPipeline* pipeline, HloVerifierOpts&& opts = {},
 bool ConvIsLowerable(HloInstruction* conv) {
   return gpu::GpuConvRewriter::ConvIsLowerable(conv);
 }
+
+// Adds the SPMD partitioner to the given pipeline. With
+// auto_sharding::collective_matmul, an all-gather + dot or a dot +
+// reduce-scatter on a large operand is decomposed into a windowed einsum loop
+// of collective-permutes and partial dots. The loop is unrolled by two, so
+// that the collective-permute of the next step does not wait for the dot of
+// the current one.
+// With auto_sharding::cost_driven_reshard, a reshard that would fully
+// replicate a tensor goes through the cheapest partially replicated sharding
+// under the cost model of the device mesh in the pass context instead.
+Status AddSpmdPartitioner(HloPassPipeline* pipeline,
+                          const HloModuleConfig& config) {
+  int64_t threshold_for_windowed_einsum_mib = 100000;
+  bool unroll_windowed_einsum = false;
+  if (pass_context::GetBool("auto_sharding::collective_matmul", false)) {
+    threshold_for_windowed_einsum_mib = pass_context::GetInt(
+        "auto_sharding::collective_matmul_threshold_mib",
+        spmd::kDefaultCollectiveMatmulThresholdMib);
+    unroll_windowed_einsum = true;
+  }
+  spmd::ReshardingCostFn reshard_cost_fn = nullptr;
+  if (pass_context::GetBool("auto_sharding::cost_driven_reshard", false)) {
+    TF_ASSIGN_OR_RETURN(reshard_cost_fn,
+                        spmd::GetReshardingCostFnFromPassContext());
+  }
+  pipeline->AddPass<spmd::StatefulRngSpmdPartitioner>(
+      config.num_partitions(), config.replica_count(),
+      threshold_for_windowed_einsum_mib, unroll_windowed_einsum,
+      std::move(reshard_cost_fn));
+  return OkStatus();
+}
 }  // namespace
 
 namespace spmd {
@@ -115,6 +147,49 @@ StatusOr<HloModuleConfig> CreateHloModuleConfig(const HloModule* hlo_module,
   return module_config;
 }
 
+// Add the IR cleanup passes that run before the auto-sharding pass.
+void AddPassesBeforeAutoSharding(HloPassPipeline& spmd_pipeline,
+                                 const DebugOptions& debug_options) {
+  AlgebraicSimplifierOptions layout_insensitive_algsimp_opts({},
+                                                             ConvIsLowerable);
+  // "slow" minmax means we propagate nan.
+  layout_insensitive_algsimp_opts.set_minmax_propagate_nan(
+      !debug_options.xla_gpu_enable_fast_min_max());
+  layout_insensitive_algsimp_opts.set_enable_dot_strength_reduction(false);  // Added by Alpa
+
+  spmd_pipeline.AddPass<CallInliner>();
+  spmd_pipeline.AddPass<DotDecomposer>();  // Added by Alpa
+  spmd_pipeline.AddPass<ZeroSizedHloElimination>();
+  spmd_pipeline.AddPass<ConditionalCanonicalizer>();
+
+  HloPassPipeline& spmd_simplify =
+      spmd_pipeline.AddPass<HloPassFix<HloPassPipeline>>("spmd-simplify");
+
+  spmd_simplify.AddPass<AlgebraicSimplifier>(layout_insensitive_algsimp_opts);
+
+  spmd_simplify.AddPass<SortSimplifier>();
+  spmd_simplify.AddPass<TupleSimplifier>();
+  // spmd_simplify.AddPass<ScatterSimplifier>();
+  spmd_simplify.AddPass<ScatterExpander>(
+      ScatterExpander::kEliminateSimpleScatters);
+  // spmd_simplify.AddPass<GatherSimplifier>();
+  spmd_simplify.AddPass<GatherExpander>(
+      GatherExpander::kEliminateSimpleGathers);
+  spmd_simplify.AddPass<WhileLoopConstantSinking>();
+  spmd_simplify.AddPass<WhileLoopSimplifier>();
+
+  spmd_simplify.AddPass<ReshapeMover>();
+  spmd_simplify.AddPass<HloConstantFolding>();
+  spmd_simplify.AddPass<ConditionalSimplifier>();
+  spmd_simplify.AddPass<TransposeFolding>(
+      gpu::CanFoldTransposeOperandIntoDot);  // Added by Alpa
+  spmd_simplify.AddPass<HloCSE>(
+      /*is_layout_sensitive=*/false);  // Added by Alpa
+  spmd_simplify.AddPass<HloDCE>();
+
+  spmd_pipeline.AddPass<HloConstantSplitter>();
+}
+
 Status RunAutoShardingPass(HloModule* hlo_module,
                            const CompileOptions& options) {
   TF_ASSIGN_OR_RETURN(auto module_config,
@@ -125,13 +200,6 @@ Status RunAutoShardingPass(HloModule* hlo_module,
   // TODO(yonghao): TF Profiler Traceme
   const DebugOptions& debug_options = hlo_module->config().debug_options();
 
-  AlgebraicSimplifierOptions layout_insensitive_algsimp_opts({},
-                                                             ConvIsLowerable);
-  // "slow" minmax means we propagate nan.
-  layout_insensitive_algsimp_opts.set_minmax_propagate_nan(
-      !debug_options.xla_gpu_enable_fast_min_max());
-  layout_insensitive_algsimp_opts.set_enable_dot_strength_reduction(false);  // Added by Alpa
-
   if (hlo_module->config().use_spmd_partitioning()) {
     HloPassPipeline spmd_pipeline("run-auto-sharding");
     AddHloVerifier(&spmd_pipeline);
@@ -139,43 +207,14 @@ Status RunAutoShardingPass(HloModule* hlo_module,
     if (num_partitions > 1) {
       // Run some IR cleanup passes before running the SPMD partitioning
       // passes.
-      spmd_pipeline.AddPass<CallInliner>();
-      spmd_pipeline.AddPass<DotDecomposer>();  // Added by Alpa
-      spmd_pipeline.AddPass<ZeroSizedHloElimination>();
-      spmd_pipeline.AddPass<ConditionalCanonicalizer>();
-
-      HloPassPipeline& spmd_simplify =
-          spmd_pipeline.AddPass<HloPassFix<HloPassPipeline>>("spmd-simplify");
-
-      spmd_simplify.AddPass<AlgebraicSimplifier>(
-          layout_insensitive_algsimp_opts);
-
-      spmd_simplify.AddPass<SortSimplifier>();
-      spmd_simplify.AddPass<TupleSimplifier>();
-      // spmd_simplify.AddPass<ScatterSimplifier>();
-      spmd_simplify.AddPass<ScatterExpander>(
-          ScatterExpander::kEliminateSimpleScatters);
-      // spmd_simplify.AddPass<GatherSimplifier>();
-      spmd_simplify.AddPass<GatherExpander>(
-          GatherExpander::kEliminateSimpleGathers);
-      spmd_simplify.AddPass<WhileLoopConstantSinking>();
-      spmd_simplify.AddPass<WhileLoopSimplifier>();
-
-      spmd_simplify.AddPass<ReshapeMover>();
-      spmd_simplify.AddPass<HloConstantFolding>();
-      spmd_simplify.AddPass<ConditionalSimplifier>();
-      spmd_simplify.AddPass<TransposeFolding>(
-          gpu::CanFoldTransposeOperandIntoDot);  // Added by Alpa
-      spmd_simplify.AddPass<HloCSE>(
-          /*is_layout_sensitive=*/false);  // Added by Alpa
-      spmd_simplify.AddPass<HloDCE>();
-
-      spmd_pipeline.AddPass<HloConstantSplitter>();
+      AddPassesBeforeAutoSharding(spmd_pipeline, debug_options);
 
       spmd_pipeline.AddPass<AutoSharding>();
       spmd_pipeline.AddPass<ShardingPropagation>(
           /*is_spmd=*/true, /*propagate_metadata=*/false,
-          /*allow_spmd_sharding_propagation_to_output=*/true);
+          /*allow_spmd_sharding_propagation_to_output=*/true,
+          /*cse_prevention_only=*/false, /*sharding_helper=*/nullptr,
+          /*use_worklist=*/true);
       spmd_pipeline.AddPass<SliceAutoShardedStages>();
     } else {
       spmd_pipeline.AddPass<CallInliner>();
@@ -189,6 +228,27 @@ Status RunAutoShardingPass(HloModule* hlo_module,
   return OkStatus();
 }
 
+StatusOr<std::unique_ptr<AutoShardingProblem>> BuildAutoShardingProblem(
+    const HloModule* hlo_module, const CompileOptions& options) {
+  TF_ASSIGN_OR_RETURN(auto module_config,
+                      CreateHloModuleConfig(hlo_module, options));
+  if (!module_config.use_spmd_partitioning() ||
+      module_config.num_partitions() <= 1) {
+    return InvalidArgument(
+        "An auto-sharding problem needs SPMD partitioning with more than one "
+        "partition.");
+  }
+  std::unique_ptr<HloModule> module = hlo_module->Clone("");
+  module->set_config(module_config);
+
+  HloPassPipeline spmd_pipeline("build-auto-sharding-problem");
+  AddHloVerifier(&spmd_pipeline);
+  AddPassesBeforeAutoSharding(spmd_pipeline,
+                              module->config().debug_options());
+  TF_RETURN_IF_ERROR(spmd_pipeline.Run(module.get()).status());
+  return AutoShardingProblem::Create(std::move(module));
+}
+
 Status RunSpmdPartitionerPass(HloModule* hlo_module,
                               const CompileOptions& options) {
   TF_ASSIGN_OR_RETURN(auto module_config,
@@ -204,9 +264,11 @@ Status RunSpmdPartitionerPass(HloModule* hlo_module,
     if (num_partitions > 1) {
       spmd_pipeline.AddPass<ShardingPropagation>(
           /*is_spmd=*/true, /*propagate_metadata=*/false,
-          /*allow_spmd_sharding_propagation_to_output=*/true);
-      spmd_pipeline.AddPass<StatefulRngSpmdPartitioner>(
-          num_partitions, hlo_module->config().replica_count());
+          /*allow_spmd_sharding_propagation_to_output=*/true,
+          /*cse_prevention_only=*/false, /*sharding_helper=*/nullptr,
+          /*use_worklist=*/true);
+      TF_RETURN_IF_ERROR(
+          AddSpmdPartitioner(&spmd_pipeline, hlo_module->config()));
       spmd_pipeline.AddPass<RedundantSliceEliminator>();
       spmd_pipeline.AddPass<AllReduceReassociate>();
       spmd_pipeline.AddPass<GradAccRewrite>();
@@ -304,10 +366,12 @@ Status SetHloModuleInputShardings(HloModule* module,
     const int64_t num_partitions = backward_hlo->config().num_partitions();
     if (num_partitions > 1) {
       spmd_pipeline.AddPass<ShardingPropagation>(
-						 /*is_spmd=*/true, /*propagate_metadata=*/false,
-						 /*allow_spmd_sharding_propagation_to_output=*/true);
-      spmd_pipeline.AddPass<StatefulRngSpmdPartitioner>(
-							num_partitions, backward_hlo->config().replica_count());
+          /*is_spmd=*/true, /*propagate_metadata=*/false,
+          /*allow_spmd_sharding_propagation_to_output=*/true,
+          /*cse_prevention_only=*/false, /*sharding_helper=*/nullptr,
+          /*use_worklist=*/true);
+      TF_RETURN_IF_ERROR(
+          AddSpmdPartitioner(&spmd_pipeline, backward_hlo->config()));
       spmd_pipeline.AddPass<RedundantSliceEliminator>();
       spmd_pipeline.AddPass<AllReduceReassociate>();
       spmd_pipeline.AddPass<GradAccCommDelay>();
@@ -2,6 +2,7 @@
 #define TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_ALPA_COMPILER_H_
 
 #include "tensorflow/compiler/xla/pjrt/pjrt_client.h"
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding.h"
 
 namespace xla {
 namespace spmd {
@@ -11,6 +12,12 @@ namespace spmd {
 Status RunAutoShardingPass(HloModule* hlo_module,
                            const CompileOptions& options);
 
+// Build an auto-sharding problem on a copy of the module that can be solved
+// repeatedly for different device meshes and memory budgets. The module is
+// not changed.
+StatusOr<std::unique_ptr<AutoShardingProblem>> BuildAutoShardingProblem(
+    const HloModule* hlo_module, const CompileOptions& options);
+
 // Run the SPMD partitioner pass.
 Status RunSpmdPartitionerPass(HloModule* hlo_module,
                               const CompileOptions& options);
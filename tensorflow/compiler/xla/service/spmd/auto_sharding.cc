@@ -1,12 +1,21 @@
 #include "tensorflow/compiler/xla/service/spmd/auto_sharding.h"
 
-#include "pybind11/numpy.h"
+#include <atomic>
+
+#include "absl/algorithm/container.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_join.h"
 #include "pybind11/stl.h"
 #include "tensorflow/compiler/xla/service/heap_simulator.h"
 #include "tensorflow/compiler/xla/service/hlo_memory_scheduler.h"
 #include "tensorflow/compiler/xla/service/hlo_ordering.h"
 #include "tensorflow/compiler/xla/service/hlo_sharding_util.h"
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_cache.h"
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_compute_cost.h"
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_solver.h"
 #include "tensorflow/compiler/xla/service/spmd/auto_sharding_strategy.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/threadpool.h"
 
 namespace xla {
 namespace spmd {
@@ -249,58 +258,104 @@ void EnumerateAll1DPartition(const HloInstruction* ins,
   }
 }
 
-// Enumerate 2D partition
+// Enumerate all partitions that tile distinct tensor dims on all the given
+// mesh dims. The i-th chosen tensor dim is tiled on mesh_dims[i].
+void EnumerateAllPartitionOnMeshDims(const HloInstruction* ins,
+                                     const Array<int64_t>& device_mesh,
+                                     const std::vector<int64_t>& mesh_dims,
+                                     const ClusterEnvironment& cluster_env,
+                                     const StrategyMap& strategy_map,
+                                     std::unique_ptr<StrategyVector>& strategies,
+                                     bool only_allow_divisible) {
+  std::vector<int64_t> tensor_dims;
+  std::function<void()> enumerate;
+  enumerate = [&]() {
+    if (tensor_dims.size() < mesh_dims.size()) {
+      int64_t mesh_dim = mesh_dims[tensor_dims.size()];
+      for (int64_t i = 0; i < ins->shape().rank(); ++i) {
+        if (absl::c_linear_search(tensor_dims, i)) {
+          continue;
+        }
+        if (ins->shape().dimensions(i) < device_mesh.dim(mesh_dim)) {
+          continue;
+        }
+        if (only_allow_divisible &&
+            ins->shape().dimensions(i) % device_mesh.dim(mesh_dim) != 0) {
+          continue;
+        }
+        tensor_dims.push_back(i);
+        enumerate();
+        tensor_dims.pop_back();
+      }
+      return;
+    }
+
+    std::string name =
+        absl::StrFormat("S{%s} @ {%s}", absl::StrJoin(tensor_dims, ","),
+                        absl::StrJoin(mesh_dims, ","));
+    HloSharding output_spec =
+        Tile(ins->shape(), tensor_dims, mesh_dims, device_mesh);
+    double compute_cost = 0, communication_cost = 0;
+    double memory_cost = GetBytes(ins->shape()) / output_spec.NumTiles();
+    std::vector<std::vector<double>> resharding_costs;
+    for (int64_t k = 0; k < ins->operand_count(); ++k) {
+      const HloInstruction* operand = ins->operand(k);
+      if (operand->shape().rank() == 0) {
+        resharding_costs.push_back(std::vector<double>(
+            strategy_map.at(operand).get()->leaf_vector.size(), 0.0));
+      } else {
+        resharding_costs.push_back(
+            ReshardingCostVector(strategy_map.at(operand).get(),
+                                 operand->shape(), output_spec, cluster_env));
+      }
+    }
+    strategies->leaf_vector.push_back(
+        ShardingStrategy({name,
+                          output_spec,
+                          compute_cost,
+                          communication_cost,
+                          memory_cost,
+                          std::move(resharding_costs),
+                          {}}));
+  };
+  enumerate();
+}
+
+// Enumerate 2D partition on every pair of mesh dims.
 void EnumerateAll2DPartition(const HloInstruction* ins,
                              const Array<int64_t>& device_mesh,
                              const ClusterEnvironment& cluster_env,
                              const StrategyMap& strategy_map,
                              std::unique_ptr<StrategyVector>& strategies,
                              bool only_allow_divisible) {
-  // Fully tile the buffer to 2-d mesh
-  for (int64_t i = 0; i < ins->shape().rank(); ++i) {
-    for (int64_t j = 0; j < ins->shape().rank(); ++j) {
-      if (i == j) {
-        continue;
-      }
-      if (ins->shape().dimensions(i) < device_mesh.dim(0) ||
-          ins->shape().dimensions(j) < device_mesh.dim(1)) {
-        continue;
-      }
-
-      if (only_allow_divisible &&
-          (ins->shape().dimensions(i) % device_mesh.dim(0) != 0 ||
-           ins->shape().dimensions(j) % device_mesh.dim(1) != 0)) {
-        continue;
-      }
-
-      std::string name = absl::StrFormat("S{%d,%d} @ {0,1}", i, j);
-      HloSharding output_spec = Tile(ins->shape(), {i, j}, {0, 1}, device_mesh);
-      double compute_cost = 0, communication_cost = 0;
-      double memory_cost = GetBytes(ins->shape()) / output_spec.NumTiles();
-      std::vector<std::vector<double>> resharding_costs;
-      for (int64_t k = 0; k < ins->operand_count(); ++k) {
-        const HloInstruction* operand = ins->operand(k);
-        if (operand->shape().rank() == 0) {
-          resharding_costs.push_back(std::vector<double>(
-              strategy_map.at(operand).get()->leaf_vector.size(), 0.0));
-        } else {
-          resharding_costs.push_back(
-              ReshardingCostVector(strategy_map.at(operand).get(),
-                                   operand->shape(), output_spec, cluster_env));
-        }
-      }
-      strategies->leaf_vector.push_back(
-          ShardingStrategy({name,
-                            output_spec,
-                            compute_cost,
-                            communication_cost,
-                            memory_cost,
-                            std::move(resharding_costs),
-                            {}}));
+  for (int64_t i = 0; i < device_mesh.num_dimensions(); ++i) {
+    for (int64_t j = i + 1; j < device_mesh.num_dimensions(); ++j) {
+      EnumerateAllPartitionOnMeshDims(ins, device_mesh, {i, j}, cluster_env,
+                                      strategy_map, strategies,
+                                      only_allow_divisible);
     }
   }
 }
 
+// Enumerate partitions that tile the buffer on all dims of a mesh with more
+// than two dims. Partitions on two mesh dims are covered by
+// EnumerateAll2DPartition.
+void EnumerateAllNDPartition(const HloInstruction* ins,
+                             const Array<int64_t>& device_mesh,
+                             const ClusterEnvironment& cluster_env,
+                             const StrategyMap& strategy_map,
+                             std::unique_ptr<StrategyVector>& strategies,
+                             bool only_allow_divisible) {
+  if (cluster_env.non_zero_mesh_dims.size() <= 2) {
+    return;
+  }
+  std::vector<int64_t> mesh_dims(cluster_env.non_zero_mesh_dims.begin(),
+                                 cluster_env.non_zero_mesh_dims.end());
+  EnumerateAllPartitionOnMeshDims(ins, device_mesh, mesh_dims, cluster_env,
+                                  strategy_map, strategies,
+                                  only_allow_divisible);
+}
+
 // Enumerate all 1d partition strategies.
 void EnumerateAll1DPartitionReshape(const HloInstruction* ins,
                                     const Array<int64_t>& device_mesh,
@@ -517,19 +572,24 @@ BuildStrategyAndCost(const HloInstructionSequence& sequence,
   }
 
   // Add penalty for replicated tensors
-  double replicated_penalty = std::round(cluster_env.AllReduceCost(1, 0) +
-                                         cluster_env.AllReduceCost(1, 1));
+  double replicated_penalty =
+      std::round(cluster_env.AllReduceCostAllMeshDims(1));
 
   int64_t max_depth = -1;
   for (auto iter : depth_map) {
     max_depth = std::max(max_depth, iter.second);
   }
 
-  int64_t disallowed_follow = 0;
+  std::atomic<int64_t> disallowed_follow{0};
 
-  // Register strategies and their costs for each instruction.
-  for (size_t instruction_id = 0; instruction_id < instructions.size();
-       ++instruction_id) {
+  // Build the strategy vector of one instruction. It only reads the strategy
+  // vectors of the operands, so instructions whose operands have all been
+  // built can be handled concurrently. New leaf strategy vectors and
+  // associative dot pairs are appended to the given lists.
+  auto build_strategies = [&](size_t instruction_id,
+                              LeafStrategies& leaf_strategies,
+                              AssociativeDotPairs& associative_dot_pairs)
+      -> StatusOr<std::unique_ptr<StrategyVector>> {
     const HloInstruction* ins = instructions[instruction_id];
     std::unique_ptr<StrategyVector> strategies;
     HloOpcode opcode = ins->opcode();
@@ -557,6 +617,8 @@ BuildStrategyAndCost(const HloInstructionSequence& sequence,
             // typically input data and intermediate activations.
             EnumerateAll2DPartition(ins, device_mesh, cluster_env, strategy_map,
                                     strategies, true);
+            EnumerateAllNDPartition(ins, device_mesh, cluster_env, strategy_map,
+                                    strategies, true);
           }
 
           if (solver_option.allow_mixed_mesh_shape) {
@@ -1290,6 +1352,8 @@ BuildStrategyAndCost(const HloInstructionSequence& sequence,
         // Split 2 dims
         EnumerateAll2DPartition(ins, device_mesh, cluster_env, strategy_map,
                                 strategies, false);
+        EnumerateAllNDPartition(ins, device_mesh, cluster_env, strategy_map,
+                                strategies, false);
 
         if (solver_option.allow_mixed_mesh_shape &&
             cluster_env.non_zero_mesh_dims.size() > 1) {
@@ -1438,33 +1502,124 @@ BuildStrategyAndCost(const HloInstructionSequence& sequence,
         LOG(FATAL) << "Unhandled instruction: " + ins->ToString();
     }
 
-    // Debug options: forcibly set the the strategy of some instructions.
-    if (pass_context::GetBool("auto_sharding::force_strategy", false)) {
-      std::vector<int64_t> inst_indices = pass_context::GetIntVector(
-          "auto_sharding::force_strategy_inst_indices");
-      std::vector<std::string> stra_names = pass_context::GetStringVector(
-          "auto_sharding::force_strategy_stra_names");
-      CHECK_EQ(inst_indices.size(), stra_names.size());
-      auto it = absl::c_find(inst_indices, strategies->id);
-
-      if (it != inst_indices.end()) {
-        CHECK(!strategies->is_tuple);
-        std::vector<ShardingStrategy> new_leaf_vector;
-        int64_t idx = it - inst_indices.begin();
-
-        for (const auto& stra : strategies->leaf_vector) {
-          if (stra.name == stra_names[idx]) {
-            new_leaf_vector.push_back(stra);
-          }
+    return strategies;
+  };
+
+  // Debug options: forcibly set the the strategy of some instructions.
+  // This requires the final solver index of each strategy vector.
+  const bool force_strategy =
+      pass_context::GetBool("auto_sharding::force_strategy", false);
+  auto apply_force_strategy = [&](StrategyVector* strategies) {
+    std::vector<int64_t> inst_indices = pass_context::GetIntVector(
+        "auto_sharding::force_strategy_inst_indices");
+    std::vector<std::string> stra_names = pass_context::GetStringVector(
+        "auto_sharding::force_strategy_stra_names");
+    CHECK_EQ(inst_indices.size(), stra_names.size());
+    auto it = absl::c_find(inst_indices, strategies->id);
+
+    if (it != inst_indices.end()) {
+      CHECK(!strategies->is_tuple);
+      std::vector<ShardingStrategy> new_leaf_vector;
+      int64_t idx = it - inst_indices.begin();
+
+      for (const auto& stra : strategies->leaf_vector) {
+        if (stra.name == stra_names[idx]) {
+          new_leaf_vector.push_back(stra);
         }
+      }
+
+      strategies->leaf_vector = std::move(new_leaf_vector);
+    }
+  };
 
-        strategies->leaf_vector = std::move(new_leaf_vector);
+  int64_t num_threads =
+      pass_context::GetInt("auto_sharding::build_strategy_num_threads", 1);
+  if (num_threads <= 1 || force_strategy) {
+    // Register strategies and their costs for each instruction.
+    for (size_t instruction_id = 0; instruction_id < instructions.size();
+         ++instruction_id) {
+      const HloInstruction* ins = instructions[instruction_id];
+      TF_ASSIGN_OR_RETURN(
+          std::unique_ptr<StrategyVector> strategies,
+          build_strategies(instruction_id, leaf_strategies,
+                           associative_dot_pairs));
+      if (force_strategy) {
+        apply_force_strategy(strategies.get());
+      }
+      CHECK(strategies->is_tuple || !strategies->leaf_vector.empty())
+          << ins->ToString() << " does not have any valid strategies.";
+      strategy_map[ins] = std::move(strategies);
+    }
+  } else {
+    // Group instructions into levels. All operands of an instruction are in
+    // lower levels, so the instructions in one level can be built in parallel.
+    absl::flat_hash_map<const HloInstruction*, int64_t> ins_level;
+    std::vector<std::vector<size_t>> levels;
+    for (size_t instruction_id = 0; instruction_id < instructions.size();
+         ++instruction_id) {
+      const HloInstruction* ins = instructions[instruction_id];
+      int64_t level = 0;
+      for (const HloInstruction* operand : ins->operands()) {
+        level = std::max(level, ins_level.at(operand) + 1);
+      }
+      ins_level[ins] = level;
+      if (level >= static_cast<int64_t>(levels.size())) {
+        levels.resize(level + 1);
+      }
+      levels[level].push_back(instruction_id);
+    }
+
+    std::vector<std::unique_ptr<StrategyVector>> results(instructions.size());
+    std::vector<LeafStrategies> local_leaf_strategies(instructions.size());
+    std::vector<AssociativeDotPairs> local_associative_dot_pairs(
+        instructions.size());
+    std::vector<Status> statuses(instructions.size());
+
+    tsl::thread::ThreadPool thread_pool(tsl::Env::Default(),
+                                        "auto_sharding_build_strategy",
+                                        num_threads);
+    for (const std::vector<size_t>& level : levels) {
+      thread_pool.ParallelFor(
+          level.size(), /*cost_per_unit=*/1 << 20,
+          [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) {
+              size_t instruction_id = level[i];
+              StatusOr<std::unique_ptr<StrategyVector>> result =
+                  build_strategies(instruction_id,
+                                   local_leaf_strategies[instruction_id],
+                                   local_associative_dot_pairs[instruction_id]);
+              if (result.ok()) {
+                results[instruction_id] = std::move(result).value();
+              } else {
+                statuses[instruction_id] = result.status();
+              }
+            }
+          });
+
+      // The strategy map is only modified between levels.
+      for (size_t instruction_id : level) {
+        TF_RETURN_IF_ERROR(statuses[instruction_id]);
+        const HloInstruction* ins = instructions[instruction_id];
+        CHECK(results[instruction_id]->is_tuple ||
+              !results[instruction_id]->leaf_vector.empty())
+            << ins->ToString() << " does not have any valid strategies.";
+        strategy_map[ins] = std::move(results[instruction_id]);
       }
     }
 
-    CHECK(strategies->is_tuple || !strategies->leaf_vector.empty())
-        << ins->ToString() << " does not have any valid strategies.";
-    strategy_map[ins] = std::move(strategies);
+    // Assign solver indices in the instruction order, so that the result is
+    // identical to the sequential mode.
+    for (size_t instruction_id = 0; instruction_id < instructions.size();
+         ++instruction_id) {
+      for (StrategyVector* strategies : local_leaf_strategies[instruction_id]) {
+        strategies->id = leaf_strategies.size();
+        leaf_strategies.push_back(strategies);
+      }
+      associative_dot_pairs.insert(
+          associative_dot_pairs.end(),
+          local_associative_dot_pairs[instruction_id].begin(),
+          local_associative_dot_pairs[instruction_id].end());
+    }
   }
 
   // If gradient accumulation is used, adjust the cost of all-reduce for
@@ -1575,124 +1730,13 @@ AliasSet BuildAliasSet(const HloModule* module,
   return alias_set;
 }
 
-// Serialize parameters of the ILP problem as numpy arrays and call the python
-// solver.
-std::tuple<std::vector<int64_t>, std::vector<int64_t>, double> CallSolver(
+// Collect the ids of the leaf strategy vectors that are alive at every node.
+// Memory constraints are only added at dot and convolution instructions,
+// so the live set of other nodes is empty.
+std::vector<std::vector<int>> BuildLivenessNodeIndices(
     const HloInstructionSequence& sequence, const LivenessSet& liveness_set,
-    const StrategyMap& strategy_map, const LeafStrategies& leaf_strategies,
-    const CostGraph& cost_graph, const AliasSet& alias_set) {
+    const StrategyMap& strategy_map, const LeafStrategies& leaf_strategies) {
   const std::vector<HloInstruction*>& instructions = sequence.instructions();
-
-  // Serialize edges and edge costs to 1d numpy arrays
-  int64_t N = leaf_strategies.size();
-  int64_t M =
-      pass_context::GetInt("auto_sharding::memory_budget_per_device", -1);
-  std::vector<int> s_len_np = cost_graph.node_lens;
-  const std::vector<int>& s_follow_np = cost_graph.follow_idx;
-  std::vector<int> E_np;
-  std::vector<double> r_np;
-  for (const auto& iter : cost_graph.edge_costs) {
-    int src = iter.first.first;
-    int dst = iter.first.second;
-    Matrix edge_cost = iter.second;
-
-    E_np.push_back(src);
-    E_np.push_back(dst);
-
-    CHECK_EQ(edge_cost.n, s_len_np[src]);
-    CHECK_EQ(edge_cost.m, s_len_np[dst]);
-
-    for (size_t i = 0; i < edge_cost.n; i++) {
-      for (size_t j = 0; j < edge_cost.m; j++) {
-        r_np.push_back(edge_cost(i, j));
-      }
-    }
-  }
-
-  // Serialize node costs
-  std::vector<double> c_np, d_np, m_np;
-  for (size_t i = 0; i < N; ++i) {
-    const StrategyVector* strategies = leaf_strategies[i];
-    if (s_follow_np[i] < 0) {
-      for (size_t j = 0; j < strategies->leaf_vector.size(); ++j) {
-        c_np.push_back(strategies->leaf_vector[j].compute_cost);
-        d_np.push_back(strategies->leaf_vector[j].communication_cost +
-                       cost_graph.extra_node_costs[i][j]);
-        m_np.push_back(strategies->leaf_vector[j].memory_cost);
-      }
-    } else {
-      std::vector<int> reindexing = cost_graph.reindexing_vector.at(i);
-      s_len_np[i] = reindexing.size();
-      for (size_t k = 0; k < reindexing.size(); ++k) {
-        size_t j = reindexing[k];
-        c_np.push_back(strategies->leaf_vector[j].compute_cost);
-        d_np.push_back(strategies->leaf_vector[j].communication_cost +
-                       cost_graph.extra_node_costs[i][j]);
-        m_np.push_back(strategies->leaf_vector[j].memory_cost);
-      }
-    }
-  }
-
-  // Serialize special edges that forces a alias pair have the same sharding
-  // spec
-  std::vector<int> A_np;
-  std::vector<double> v_np;
-  for (const auto& pair : alias_set) {
-    const StrategyVector* src_strategies = leaf_strategies[pair.first];
-    const StrategyVector* dst_strategies = leaf_strategies[pair.second];
-
-    Matrix raw_cost(src_strategies->leaf_vector.size(),
-                    dst_strategies->leaf_vector.size());
-    bool compatible = false;
-    for (size_t i = 0; i < src_strategies->leaf_vector.size(); ++i) {
-      for (size_t j = 0; j < dst_strategies->leaf_vector.size(); ++j) {
-        if (src_strategies->leaf_vector[i].output_sharding ==
-            dst_strategies->leaf_vector[j].output_sharding) {
-          compatible = true;
-          raw_cost(i, j) = 0.0;
-        } else {
-          raw_cost(i, j) = 1.0;
-        }
-      }
-    }
-    CHECK(compatible) << "Incompatible alias pairs: "
-                      << "(" << src_strategies->instruction_id << ", "
-                      << dst_strategies->instruction_id << ")";
-
-    int idx_a = pair.first;
-    int idx_b = pair.second;
-    std::vector<int> row_indices;
-    std::vector<int> col_indices;
-
-    if (s_follow_np[idx_a] >= 0) {
-      row_indices = cost_graph.reindexing_vector.at(idx_a);
-      idx_a = s_follow_np[idx_a];
-    } else {
-      row_indices.assign(s_len_np[idx_a], 0);
-      std::iota(row_indices.begin(), row_indices.end(), 0);
-    }
-
-    if (s_follow_np[idx_b] >= 0) {
-      col_indices = cost_graph.reindexing_vector.at(idx_b);
-      idx_b = s_follow_np[idx_b];
-    } else {
-      col_indices.assign(s_len_np[idx_b], 0);
-      std::iota(col_indices.begin(), col_indices.end(), 0);
-    }
-
-    CHECK_EQ(s_len_np[idx_a], row_indices.size());
-    CHECK_EQ(s_len_np[idx_b], col_indices.size());
-
-    A_np.push_back(idx_a);
-    A_np.push_back(idx_b);
-    for (int i : row_indices) {
-      for (int j : col_indices) {
-        v_np.push_back(raw_cost(i, j));
-      }
-    }
-  }
-
-  // Serialize liveness_set
   auto filter_func = [&instructions](size_t i) {
     HloOpcode opcode = instructions[i]->opcode();
     if (opcode == HloOpcode::kDot || opcode == HloOpcode::kConvolution) {
@@ -1702,7 +1746,7 @@ std::tuple<std::vector<int64_t>, std::vector<int64_t>, double> CallSolver(
     }
   };
 
-  std::vector<int> L_np;
+  size_t N = leaf_strategies.size();
   std::vector<std::vector<int>> liveness_set_indices(N);
   for (size_t i = 0; i < N; ++i) {
     if (filter_func(leaf_strategies[i]->instruction_id)) {
@@ -1721,60 +1765,9 @@ std::tuple<std::vector<int64_t>, std::vector<int64_t>, double> CallSolver(
            liveness_set[leaf_strategies[i]->instruction_id]) {
         traverse_live_instructions(strategy_map.at(value->instruction()).get());
       }
-      L_np.push_back(current_liveness_set_indices.size());
-    } else {
-      L_np.push_back(0);
     }
   }
-
-  for (const auto& indices : liveness_set_indices) {
-    L_np.insert(L_np.end(), indices.begin(), indices.end());
-  }
-
-  // Call the solver function in python
-  size_t num_edges = E_np.size() / 2;
-  std::vector<int64_t> s_val, e_val;
-  double objective;
-
-  PyGILState_STATE gstate = PyGILState_Ensure();
-  {
-    py::object submodule =
-        py::module_::import("alpa.shard_parallel.auto_sharding");
-    py::object call_solver_serialized_args =
-        submodule.attr("call_solver_serialized_args");
-    py::object ret = call_solver_serialized_args(
-        N, M,
-        py::array(s_len_np.size(), s_len_np.data()),  // TODO: avoid this copy
-        py::array(s_follow_np.size(), s_follow_np.data()),
-        py::array(E_np.size(), E_np.data()),
-        py::array(A_np.size(), A_np.data()),
-        py::array(L_np.size(), L_np.data()),
-        py::array(c_np.size(), c_np.data()),
-        py::array(d_np.size(), d_np.data()),
-        py::array(m_np.size(), m_np.data()),
-        py::array(r_np.size(), r_np.data()),
-        py::array(v_np.size(), v_np.data()));
-    if (ret.is_none()) {
-      PyGILState_Release(gstate);
-      exit(-1);
-    }
-    py::tuple tuple_ret = ret;
-
-    py::object s_val_obj = tuple_ret[0], e_val_obj = tuple_ret[1];
-    objective = py::cast<double>(tuple_ret[2]);
-    py::array_t<int> s_val_array = s_val_obj, e_val_array = e_val_obj;
-    auto s_val_unckecked = s_val_array.unchecked<1>();
-    auto e_val_unckecked = e_val_array.unchecked<1>();
-    for (size_t i = 0; i < N; ++i) {
-      s_val.push_back(s_val_unckecked(i));
-    }
-    for (size_t i = 0; i < num_edges; ++i) {
-      e_val.push_back(e_val_unckecked(i));
-    }
-  }
-  PyGILState_Release(gstate);
-
-  return std::make_tuple(std::move(s_val), std::move(e_val), objective);
+  return liveness_set_indices;
 }
 
 // Set the HloSharding for all instructions according to the ILP solution.
@@ -2122,14 +2115,8 @@ void DisableIncompatibleMixedMeshShapeAndForceBatchDim(
   }
 }
 
-StatusOr<bool> AutoSharding::Run(
-    HloModule* module,
-    const absl::flat_hash_set<absl::string_view>& execution_threads) {
-  if (!pass_context::GetBool("auto_sharding::enable", true)) {
-    return false;
-  }
-
-  // ----- Read options of this pass -----
+// Read the options of the auto-sharding pass from the pass context.
+AutoShardingSolverOption GetSolverOptionFromPassContext() {
   AutoShardingSolverOption solver_option;
   solver_option.override_all_gather_cost = false;
   solver_option.override_all_reduce_cost = false;
@@ -2156,6 +2143,8 @@ StatusOr<bool> AutoSharding::Run(
       "auto_sharding::reduce_scatter_grad_acc_friendly", false);
   solver_option.reduce_scatter_aggressive_partition = pass_context::GetBool(
       "auto_sharding::reduce_scatter_aggressive_partition", false);
+  solver_option.reduce_scatter_shard_weights = pass_context::GetBool(
+      "auto_sharding::reduce_scatter_shard_weights", false);
   solver_option.batch_matmul_always_split_batch = pass_context::GetBool(
       "auto_sharding::batch_matmul_always_split_batch", false);
   solver_option.allow_recompute_heavy_op =
@@ -2168,28 +2157,338 @@ StatusOr<bool> AutoSharding::Run(
       pass_context::GetBool("auto_sharding::load_solution_vector", false);
   solver_option.force_simple_heuristic =
       pass_context::GetString("auto_sharding::force_simple_heuristic", "");
+  solver_option.solver_backend =
+      pass_context::GetString("auto_sharding::solver_backend", "python");
+  solver_option.memory_budget_per_device =
+      pass_context::GetInt("auto_sharding::memory_budget_per_device", -1);
+  solver_option.solver_time_limit_seconds =
+      pass_context::GetDouble("auto_sharding::solver_time_limit", -1.0);
+  solver_option.solver_relative_gap =
+      pass_context::GetDouble("auto_sharding::solver_relative_gap", 0.0);
+  solver_option.heuristic_solver_threshold = pass_context::GetInt(
+      "auto_sharding::heuristic_solver_threshold", 20'000'000);
+  solver_option.tie_repeated_layers =
+      pass_context::GetBool("auto_sharding::tie_repeated_layers", false);
+  solver_option.use_roofline_compute_cost =
+      pass_context::GetBool("auto_sharding::use_roofline_compute_cost", false);
+  solver_option.device_peak_flops =
+      pass_context::GetDouble("auto_sharding::device_peak_flops", 1.25e14);
+  solver_option.device_memory_bandwidth = pass_context::GetDouble(
+      "auto_sharding::device_memory_bandwidth", 9e11);
+  solver_option.compute_cost_scale =
+      pass_context::GetDouble("auto_sharding::compute_cost_scale", 1.0);
+  solver_option.overlap_communication =
+      pass_context::GetBool("auto_sharding::overlap_communication", false);
+  solver_option.overlap_window =
+      pass_context::GetInt("auto_sharding::overlap_window", 8);
+  solver_option.overlap_efficiency =
+      pass_context::GetDouble("auto_sharding::overlap_efficiency", 0.8);
+  solver_option.collective_matmul =
+      pass_context::GetBool("auto_sharding::collective_matmul", false);
+  solver_option.collective_matmul_threshold_mib = pass_context::GetInt(
+      "auto_sharding::collective_matmul_threshold_mib",
+      kDefaultCollectiveMatmulThresholdMib);
+  solver_option.allow_recompute_activations = pass_context::GetBool(
+      "auto_sharding::allow_recompute_activations", false);
+  solver_option.recompute_penalty =
+      pass_context::GetDouble("auto_sharding::recompute_penalty", 0.0);
+  solver_option.allow_all_to_all_resharding = pass_context::GetBool(
+      "auto_sharding::allow_all_to_all_resharding", false);
+  solver_option.allow_sequence_parallel =
+      pass_context::GetBool("auto_sharding::allow_sequence_parallel", false);
+  std::string calibration_file =
+      pass_context::GetString("auto_sharding::cost_calibration_file", "");
+  if (!calibration_file.empty()) {
+    StatusOr<CostCalibration> calibration =
+        CostCalibration::LoadFromFile(calibration_file);
+    if (calibration.ok()) {
+      solver_option.cost_calibration = *std::move(calibration);
+    } else {
+      LOG(WARNING) << "Failed to load the auto-sharding cost calibration: "
+                   << calibration.status();
+    }
+  }
+  if (solver_option.allow_recompute_activations &&
+      solver_option.solver_backend != "native") {
+    // The python solver has no recompute variables.
+    solver_option.allow_recompute_activations = false;
+    LOG(WARNING) << "auto_sharding::allow_recompute_activations is only "
+                 << "supported by the native solver backend. It is disabled.";
+  }
+  if (solver_option.allow_recompute_activations &&
+      !solver_option.use_roofline_compute_cost &&
+      solver_option.recompute_penalty <= 0) {
+    LOG(WARNING) << "Recomputing activations is free without "
+                 << "auto_sharding::use_roofline_compute_cost or a positive "
+                 << "auto_sharding::recompute_penalty.";
+  }
 
-  // ----- Read parameters of device mesh -----
+  return solver_option;
+}
+
+// Read the device mesh and its cost model from the pass context.
+// `prof_result` must outlive the returned cluster environment.
+StatusOr<ClusterEnvironment> GetClusterEnvironmentFromPassContext(
+    CollectiveCostModel& prof_result, AutoShardingSolverOption& solver_option) {
   Array<int64_t> device_mesh(
       pass_context::GetIntVector("auto_sharding::device_mesh_shape"));
   device_mesh.SetValues(
       pass_context::GetIntVector("auto_sharding::device_mesh_ids"));
-  ProfilingResult prof_result(
-      pass_context::GetPyObject("auto_sharding::device_mesh_prof_result"));
-  ClusterEnvironment cluster_env(
+  // A profile file does not need python. It takes precedence over the python
+  // profiling result.
+  std::string prof_file =
+      pass_context::GetString("auto_sharding::device_mesh_prof_file", "");
+  if (!prof_file.empty()) {
+    TF_ASSIGN_OR_RETURN(prof_result,
+                        CollectiveCostModel::LoadFromFile(prof_file));
+  } else {
+    prof_result = CollectiveCostModel::FromPyObject(
+        pass_context::GetPyObject("auto_sharding::device_mesh_prof_result"));
+  }
+  if (solver_option.allow_mixed_mesh_shape &&
+      device_mesh.num_dimensions() != 2) {
+    // Mixed mesh shape strategies mix a 2d mesh with its flattened 1d mesh.
+    solver_option.allow_mixed_mesh_shape = false;
+    LOG(WARNING) << "Mixed mesh shape is only supported for 2d device meshes. "
+                 << "It is disabled for the device mesh with "
+                 << device_mesh.num_dimensions() << " dims.";
+  }
+  return ClusterEnvironment(
       device_mesh,
       pass_context::GetDoubleVector("auto_sharding::device_mesh_alpha"),
       pass_context::GetDoubleVector("auto_sharding::device_mesh_beta"),
       prof_result, solver_option);
+}
 
-  // std::cerr << "===== Enter AutoSharding =====" << std::endl;
-  // std::cerr << module->ToString();
-  // std::cerr << "=====================================" << std::endl;
+StatusOr<ReshardingCostFn> GetReshardingCostFnFromPassContext() {
+  // The cluster environment keeps references to the profiling result and the
+  // solver options, so they are owned together by the returned function.
+  struct CostModel {
+    AutoShardingSolverOption solver_option;
+    CollectiveCostModel prof_result;
+    std::optional<ClusterEnvironment> cluster_env;
+  };
+  auto model = std::make_shared<CostModel>();
+  model->solver_option = GetSolverOptionFromPassContext();
+  TF_ASSIGN_OR_RETURN(ClusterEnvironment cluster_env,
+                      GetClusterEnvironmentFromPassContext(
+                          model->prof_result, model->solver_option));
+  model->cluster_env.emplace(std::move(cluster_env));
+
+  return ReshardingCostFn([model](const Shape& shape, const HloSharding& src,
+                                  const HloSharding& dst) -> double {
+    const ClusterEnvironment& cluster_env = *model->cluster_env;
+    // The cost model only understands shardings that map their tile dims to
+    // the dims of the device mesh.
+    for (const HloSharding* spec : {&src, &dst}) {
+      if (!shape.IsArray() || spec->IsTileMaximal() != spec->IsReplicated() ||
+          spec->IsManual() || !spec->subgroup_types().empty() ||
+          !IsValidTileAssignment(*spec) ||
+          (!spec->IsReplicated() &&
+           spec->tile_assignment().num_elements() !=
+               cluster_env.total_devices)) {
+        return INFINITY_COST;
+      }
+    }
+    return cluster_env.ReshardingCost(shape, src, dst);
+  });
+}
 
-  // ----- Pre-process to normalize the dot dimensions -----
-  TF_ASSIGN_OR_RETURN(bool changed, NormalizeDotDimension(module));
+Status CalibrateAutoShardingCostsFromPassContext(
+    const HloModule& module,
+    const absl::flat_hash_map<std::string, double>& op_seconds,
+    double damping, const std::string& output_file) {
+  AutoShardingSolverOption solver_option = GetSolverOptionFromPassContext();
+  CollectiveCostModel prof_result;
+  TF_ASSIGN_OR_RETURN(
+      ClusterEnvironment cluster_env,
+      GetClusterEnvironmentFromPassContext(prof_result, solver_option));
+  CostCalibration calibration = solver_option.cost_calibration;
+  TF_RETURN_IF_ERROR(FitCostCalibration(module, cluster_env, op_seconds,
+                                        damping, &calibration));
+  return calibration.SaveToFile(output_file);
+}
 
-  // ----- Get a sequential schedule and do liveness analysis -----
+// Tie the leaf strategies of `later` to those of `earlier` in `cost_graph` if
+// they have the same output shardings in the same order.
+void TieStrategies(const StrategyVector* later, const StrategyVector* earlier,
+                   CostGraph& cost_graph) {
+  if (later->is_tuple != earlier->is_tuple) {
+    return;
+  }
+  if (later->is_tuple) {
+    if (later->childs.size() == earlier->childs.size()) {
+      for (size_t i = 0; i < later->childs.size(); ++i) {
+        TieStrategies(later->childs[i].get(), earlier->childs[i].get(),
+                      cost_graph);
+      }
+    }
+    return;
+  }
+  if (later->leaf_vector.size() != earlier->leaf_vector.size()) {
+    return;
+  }
+  for (size_t i = 0; i < later->leaf_vector.size(); ++i) {
+    if (!(later->leaf_vector[i].output_sharding ==
+          earlier->leaf_vector[i].output_sharding)) {
+      return;
+    }
+  }
+  cost_graph.AddTiePair(later->id, earlier->id);
+}
+
+// Build the strategies of all instructions, estimate their costs and build
+// the simplified cost graph.
+StatusOr<AutoShardingStrategyGraph> BuildStrategyGraph(
+    const HloModule* module, const AutoShardingLiveness& liveness,
+    const ClusterEnvironment& cluster_env,
+    AutoShardingSolverOption& solver_option) {
+  AutoShardingStrategyGraph graph;
+
+  // ----- Analyze the batch dim -----
+  const HloInstructionSequence& sequence = liveness.sequence();
+  InstructionBatchDimMap batch_dim_map;
+  batch_dim_map = BuildInstructionBatchDimMap(sequence);
+  if (solver_option.force_batch_dim_to_mesh_dim >= 0) {
+    DisableIncompatibleMixedMeshShapeAndForceBatchDim(
+        batch_dim_map, cluster_env.device_mesh.num_elements(), solver_option);
+  }
+
+  // ----- Analyze depth -----
+  graph.ins_depth_map = BuildInstructionDepthMap(sequence, batch_dim_map);
+
+  // ----- Build strategies and costs -----
+  TF_ASSIGN_OR_RETURN(
+      std::tie(graph.strategy_map, graph.leaf_strategies,
+               graph.associative_dot_pairs),
+      BuildStrategyAndCost(sequence, graph.ins_depth_map, batch_dim_map,
+                           liveness.alias_map, cluster_env, solver_option));
+  if (solver_option.use_roofline_compute_cost) {
+    TF_RETURN_IF_ERROR(AddRooflineComputeCost(
+        sequence, graph.leaf_strategies, solver_option));
+  }
+  if (solver_option.overlap_communication) {
+    if (!solver_option.use_roofline_compute_cost) {
+      LOG(WARNING) << "auto_sharding::overlap_communication has little effect "
+                   << "without auto_sharding::use_roofline_compute_cost.";
+    }
+    TF_RETURN_IF_ERROR(DiscountOverlappedCommunication(
+        sequence, graph.leaf_strategies, graph.associative_dot_pairs,
+        solver_option));
+  }
+  if (solver_option.collective_matmul) {
+    TF_RETURN_IF_ERROR(DiscountCollectiveMatmul(
+        sequence, graph.leaf_strategies, solver_option));
+  }
+  graph.alias_set =
+      BuildAliasSet(module, liveness.alias_analysis->dataflow_analysis(),
+                    graph.strategy_map);
+  // std::cerr << PrintStrategyMap(graph.strategy_map, sequence);
+
+  // ----- Build cost graph and merge unimporant nodes -----
+  graph.cost_graph = std::make_unique<CostGraph>(graph.leaf_strategies,
+                                                 graph.associative_dot_pairs);
+  if (solver_option.tie_repeated_layers) {
+    constexpr int64_t kMinLayerSize = 16;
+    for (const auto& [later, earlier] :
+         FindRepeatedLayerInstructions(sequence, kMinLayerSize)) {
+      TieStrategies(graph.strategy_map.at(later).get(),
+                    graph.strategy_map.at(earlier).get(), *graph.cost_graph);
+    }
+  }
+  graph.cost_graph->Simplify();
+
+  return graph;
+}
+
+// The number of node and edge variables of the ILP.
+int64_t NumIlpVariables(const CostGraph& cost_graph) {
+  int64_t num_variables = 0;
+  for (size_t i = 0; i < cost_graph.node_lens.size(); ++i) {
+    if (cost_graph.follow_idx[i] < 0) {
+      num_variables += cost_graph.node_lens[i];
+    }
+  }
+  for (const auto& iter : cost_graph.edge_costs) {
+    num_variables += iter.second.n * iter.second.m;
+  }
+  return num_variables;
+}
+
+// Call the ILP solver of `solver_option.solver_backend`, or the greedy solver
+// if the ILP is too large.
+// `hint` is an optional solution vector to warm-start the native solver. If it
+// is empty and the native solver has a time limit, the greedy solution is used
+// as the hint, so that the solver has a good incumbent when it times out. If
+// the ILP solver fails, this falls back to the greedy solver.
+StatusOr<AutoShardingSolution> SolveStrategyGraph(
+    const AutoShardingLiveness& liveness,
+    const AutoShardingStrategyGraph& graph,
+    const AutoShardingSolverOption& solver_option,
+    const std::vector<int64_t>& hint) {
+  const HloInstructionSequence& sequence = liveness.sequence();
+  std::string backend = solver_option.solver_backend;
+  int64_t num_variables = NumIlpVariables(*graph.cost_graph);
+  if (solver_option.heuristic_solver_threshold >= 0 &&
+      num_variables > solver_option.heuristic_solver_threshold &&
+      backend != "greedy") {
+    LOG(INFO) << "The auto-sharding ILP has " << num_variables
+              << " variables. Using the greedy solver instead of " << backend
+              << ".";
+    backend = "greedy";
+  }
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<AutoShardingSolver> solver,
+                      CreateAutoShardingSolver(backend));
+  NativeSolverOption native_option;
+  native_option.memory_budget_per_device =
+      solver_option.memory_budget_per_device;
+  native_option.time_limit_seconds = solver_option.solver_time_limit_seconds;
+  native_option.relative_mip_gap = solver_option.solver_relative_gap;
+  native_option.allow_recompute = solver_option.allow_recompute_activations;
+  native_option.recompute_penalty = solver_option.recompute_penalty;
+  native_option.hint = hint;
+  AutoShardingSolverInput input{&sequence,
+                                &liveness.liveness_set,
+                                &graph.strategy_map,
+                                &graph.leaf_strategies,
+                                graph.cost_graph.get(),
+                                &graph.alias_set};
+  if (backend == "native" && hint.empty() &&
+      solver_option.solver_time_limit_seconds > 0) {
+    StatusOr<AutoShardingSolution> warm_start =
+        CallGreedySolver(input, native_option);
+    if (warm_start.ok()) {
+      native_option.hint = std::move(warm_start->s_val);
+    }
+  }
+  StatusOr<AutoShardingSolution> solution = solver->Solve(input, native_option);
+  if (!solution.ok() && backend != "greedy") {
+    LOG(WARNING) << "The " << backend << " auto-sharding solver failed: "
+                 << solution.status() << ". Falling back to the greedy solver.";
+    solution = CallGreedySolver(input, native_option);
+  }
+  TF_RETURN_IF_ERROR(solution.status());
+  if (!solution->recomputed_nodes.empty()) {
+    // The shardings are chosen assuming these activations are
+    // rematerialized. HloRematerialization makes the actual decisions
+    // later under the same memory budget.
+    LOG(INFO) << "Auto-sharding assumes " << solution->recomputed_nodes.size()
+              << " activations are rematerialized.";
+    for (int i : solution->recomputed_nodes) {
+      const HloInstruction* ins =
+          sequence.instructions()[graph.leaf_strategies[i]->instruction_id];
+      VLOG(1) << "Rematerialize: " << ins->name();
+    }
+  }
+  if (solution->optimality_gap > 0) {
+    LOG(INFO) << "Auto-sharding solution is within "
+              << solution->optimality_gap * 100 << "% of the optimum.";
+  }
+  return solution;
+}
+
+StatusOr<AutoShardingLiveness> AutoShardingLiveness::Run(HloModule* module) {
+  AutoShardingLiveness liveness;
   auto size_fn = [](const BufferValue& buffer) {
     return GetBytes(buffer.shape());
   };
@@ -2197,82 +2496,127 @@ StatusOr<bool> AutoSharding::Run(
                       ScheduleModule(module, size_fn,
                                      ComputationSchedulerToModuleScheduler(
                                          DFSMemoryScheduler)));
+  liveness.schedule = std::make_unique<HloSchedule>(std::move(schedule));
   const HloComputation* entry_computation = module->entry_computation();
-  std::unique_ptr<HloAliasAnalysis> alias_analysis =
-      HloAliasAnalysis::Run(module).ValueOrDie();
-  AliasMap alias_map =
-      BuildAliasMap(module, alias_analysis->dataflow_analysis());
-
-  TF_ASSIGN_OR_RETURN(
-      std::unique_ptr<HloLiveRange> hlo_live_range,
-      HloLiveRange::Run(schedule, *alias_analysis, entry_computation));
+  TF_ASSIGN_OR_RETURN(liveness.alias_analysis, HloAliasAnalysis::Run(module));
+  liveness.alias_map =
+      BuildAliasMap(module, liveness.alias_analysis->dataflow_analysis());
+
+  TF_ASSIGN_OR_RETURN(liveness.hlo_live_range,
+                      HloLiveRange::Run(*liveness.schedule,
+                                        *liveness.alias_analysis,
+                                        entry_computation));
   absl::flat_hash_map<const HloValue*, HloLiveRange::TimeBound>&
-      buffer_live_ranges = hlo_live_range->buffer_live_ranges();
-  LivenessSet liveness_set(hlo_live_range->schedule_end_time() + 1);
+      buffer_live_ranges = liveness.hlo_live_range->buffer_live_ranges();
+  liveness.liveness_set.resize(
+      liveness.hlo_live_range->schedule_end_time() + 1);
   for (const auto& iter : buffer_live_ranges) {
     for (int64_t i = iter.second.start; i <= iter.second.end; ++i) {
-      liveness_set[i].push_back(iter.first);
+      liveness.liveness_set[i].push_back(iter.first);
     }
   }
+  return liveness;
+}
 
-  if (solver_option.force_simple_heuristic != "") {
-    AnnotateShardingWithSimpleHeuristic(
-        module, solver_option.force_simple_heuristic, alias_map, cluster_env);
-    return true;
+StatusOr<bool> AutoSharding::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  if (!pass_context::GetBool("auto_sharding::enable", true)) {
+    return false;
   }
 
-  // ----- Analyze the batch dim -----
-  const HloInstructionSequence& sequence =
-      hlo_live_range->flattened_instruction_sequence();
-  InstructionBatchDimMap batch_dim_map;
-  batch_dim_map = BuildInstructionBatchDimMap(sequence);
-  if (solver_option.force_batch_dim_to_mesh_dim >= 0) {
-    DisableIncompatibleMixedMeshShapeAndForceBatchDim(
-        batch_dim_map, device_mesh.num_elements(), solver_option);
+  // ----- Read options of this pass -----
+  AutoShardingSolverOption solver_option = GetSolverOptionFromPassContext();
+
+  // ----- Read parameters of device mesh -----
+  CollectiveCostModel prof_result;
+  TF_ASSIGN_OR_RETURN(
+      ClusterEnvironment cluster_env,
+      GetClusterEnvironmentFromPassContext(prof_result, solver_option));
+
+  // std::cerr << "===== Enter AutoSharding =====" << std::endl;
+  // std::cerr << module->ToString();
+  // std::cerr << "=====================================" << std::endl;
+
+  // ----- Pre-process to normalize the dot dimensions -----
+  TF_ASSIGN_OR_RETURN(bool changed, NormalizeDotDimension(module));
+
+  // ----- Compute the key of the solution cache -----
+  // This must be done before any sharding annotation is changed.
+  std::string solution_cache_dir =
+      pass_context::GetString("auto_sharding::solution_cache_dir", "");
+  std::string solution_cache_key;
+  if (!solution_cache_dir.empty()) {
+    solution_cache_key = AutoShardingSolutionCache::ComputeKey(
+        module, cluster_env, solver_option,
+        solver_option.memory_budget_per_device);
   }
 
-  // ----- Analyze depth -----
-  InstructionDepthMap ins_depth_map;
-  ins_depth_map = BuildInstructionDepthMap(sequence, batch_dim_map);
+  // ----- Get a sequential schedule and do liveness analysis -----
+  TF_ASSIGN_OR_RETURN(AutoShardingLiveness liveness,
+                      AutoShardingLiveness::Run(module));
 
-  // ----- Build strategies and costs -----
-  StrategyMap strategy_map;
-  LeafStrategies leaf_strategies;
-  AssociativeDotPairs associative_dot_pairs;
+  if (solver_option.force_simple_heuristic != "") {
+    AnnotateShardingWithSimpleHeuristic(
+        module, solver_option.force_simple_heuristic, liveness.alias_map,
+        cluster_env);
+    return true;
+  }
 
+  // ----- Build strategies, costs and the cost graph -----
+  const HloInstructionSequence& sequence = liveness.sequence();
   TF_ASSIGN_OR_RETURN(
-      std::tie(strategy_map, leaf_strategies, associative_dot_pairs),
-      BuildStrategyAndCost(sequence, ins_depth_map, batch_dim_map, alias_map,
-                           cluster_env, solver_option));
-  AliasSet alias_set =
-      BuildAliasSet(module, alias_analysis->dataflow_analysis(), strategy_map);
-  // std::cerr << PrintStrategyMap(strategy_map, sequence);
-
-  // ----- Build cost graph and merge unimporant nodes -----
-  CostGraph cost_graph(leaf_strategies, associative_dot_pairs);
-  cost_graph.Simplify();
+      AutoShardingStrategyGraph graph,
+      BuildStrategyGraph(module, liveness, cluster_env, solver_option));
+  const StrategyMap& strategy_map = graph.strategy_map;
+  const LeafStrategies& leaf_strategies = graph.leaf_strategies;
+  const CostGraph& cost_graph = *graph.cost_graph;
 
   // ----- Call the ILP solver -----
-  std::vector<int64_t> s_val, e_val;
+  std::vector<int64_t> s_val;
   double objective = -1.0;
-  if (!solver_option.load_solution_vector) {
-    std::tie(s_val, e_val, objective) =
-        CallSolver(sequence, liveness_set, strategy_map, leaf_strategies,
-                   cost_graph, alias_set);
+  std::optional<std::vector<int64_t>> cached_s_val;
+  if (!solution_cache_key.empty() && !solver_option.load_solution_vector) {
+    cached_s_val = AutoShardingSolutionCache(solution_cache_dir)
+                       .Lookup(solution_cache_key, cost_graph);
+  }
+  if (cached_s_val.has_value()) {
+    s_val = std::move(*cached_s_val);
+  } else if (!solver_option.load_solution_vector) {
+    TF_ASSIGN_OR_RETURN(
+        AutoShardingSolution solution,
+        SolveStrategyGraph(liveness, graph, solver_option, /*hint=*/{}));
+    s_val = std::move(solution.s_val);
+    objective = solution.objective;
+    if (!solution_cache_key.empty()) {
+      Status status = AutoShardingSolutionCache(solution_cache_dir)
+                          .Insert(solution_cache_key, cost_graph, s_val);
+      if (!status.ok()) {
+        LOG(WARNING) << "Failed to write the auto-sharding solution cache: "
+                     << status;
+      }
+    }
   } else {
     s_val = pass_context::GetIntVector("auto_sharding::solution_vector");
+    if (s_val.size() != leaf_strategies.size()) {
+      return InvalidArgument(
+          "The solution vector has %d entries, but the module has %d "
+          "strategy nodes.",
+          s_val.size(), leaf_strategies.size());
+    }
   }
 
   if (pass_context::GetBool("auto_sharding::print_strategy", false)) {
     std::cerr << PrintAutoShardingSolution(
-        sequence, liveness_set, ins_depth_map, strategy_map, leaf_strategies,
-        cost_graph, s_val, objective);
+        sequence, liveness.liveness_set, graph.ins_depth_map, strategy_map,
+        leaf_strategies, cost_graph, s_val, objective);
   }
 
   // ----- Substitute all-reduce with reduce-scatter -----
   if (solver_option.prefer_reduce_scatter) {
-    GenerateReduceScatter(sequence, alias_map, ins_depth_map, strategy_map,
-                          cost_graph, s_val, cluster_env, solver_option);
+    GenerateReduceScatter(sequence, liveness.alias_map, graph.ins_depth_map,
+                          strategy_map, cost_graph, s_val, cluster_env,
+                          solver_option);
   }
 
   // ----- Set sharding for all instructions -----
@@ -2286,5 +2630,45 @@ StatusOr<bool> AutoSharding::Run(
   return true;
 }
 
+AutoShardingProblem::AutoShardingProblem(std::unique_ptr<HloModule> module,
+                                         AutoShardingLiveness liveness)
+    : module_(std::move(module)), liveness_(std::move(liveness)) {}
+
+StatusOr<std::unique_ptr<AutoShardingProblem>> AutoShardingProblem::Create(
+    std::unique_ptr<HloModule> module) {
+  TF_RETURN_IF_ERROR(NormalizeDotDimension(module.get()).status());
+  TF_ASSIGN_OR_RETURN(AutoShardingLiveness liveness,
+                      AutoShardingLiveness::Run(module.get()));
+  return absl::WrapUnique(
+      new AutoShardingProblem(std::move(module), std::move(liveness)));
+}
+
+StatusOr<AutoShardingSolution> AutoShardingProblem::Solve() {
+  AutoShardingSolverOption solver_option = GetSolverOptionFromPassContext();
+  CollectiveCostModel prof_result;
+  TF_ASSIGN_OR_RETURN(
+      ClusterEnvironment cluster_env,
+      GetClusterEnvironmentFromPassContext(prof_result, solver_option));
+
+  // The strategies and their costs only depend on the device mesh, the cost
+  // model and the solver options. The memory budget only enters the solver.
+  std::string cost_key =
+      AutoShardingSolutionCache::ComputeCostKey(cluster_env, solver_option);
+  if (!graph_.has_value() || cost_key != cost_key_) {
+    TF_ASSIGN_OR_RETURN(graph_, BuildStrategyGraph(module_.get(), liveness_,
+                                                   cluster_env, solver_option));
+    cost_key_ = std::move(cost_key);
+  }
+
+  // Warm-start from the last solution, e.g., when only the memory budget or
+  // the mesh alpha/beta changes. The solver ignores a hint that does not fit
+  // the strategy space.
+  TF_ASSIGN_OR_RETURN(
+      AutoShardingSolution solution,
+      SolveStrategyGraph(liveness_, *graph_, solver_option, last_s_val_));
+  last_s_val_ = solution.s_val;
+  return solution;
+}
+
 }  // namespace spmd
 }  // namespace xla
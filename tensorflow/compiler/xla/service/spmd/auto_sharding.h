@@ -1,8 +1,20 @@
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_GPU_AUTO_SHARDING_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_GPU_AUTO_SHARDING_H_
 
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/compiler/xla/service/hlo_alias_analysis.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_live_range.h"
 #include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/service/hlo_schedule.h"
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_solver.h"
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_strategy.h"
 
 namespace xla {
 namespace spmd {
@@ -18,6 +30,84 @@ class AutoSharding : public HloModulePass {
       const absl::flat_hash_set<absl::string_view>& execution_threads) override;
 };
 
+// The communication cost of resharding a tensor of the given unpartitioned
+// shape from the first sharding to the second one, estimated with the device
+// mesh and its cost model in the pass context like in the auto-sharding pass.
+// It is infinity for the resharding patterns the model does not support.
+using ReshardingCostFn = std::function<double(
+    const Shape&, const HloSharding&, const HloSharding&)>;
+StatusOr<ReshardingCostFn> GetReshardingCostFnFromPassContext();
+
+// Fit the cost calibration of the auto-sharding pass to the measured time of
+// the operations of `module`, which was partitioned for the device mesh in
+// the pass context, and save it to `output_file`. `op_seconds` maps
+// instruction names to seconds. The fit starts from the calibration in
+// auto_sharding::cost_calibration_file, so pointing that option to
+// `output_file` for the next compilations closes the feedback loop.
+Status CalibrateAutoShardingCostsFromPassContext(
+    const HloModule& module,
+    const absl::flat_hash_map<std::string, double>& op_seconds,
+    double damping, const std::string& output_file);
+
+// The sequential schedule and the liveness analysis of a module. They do not
+// depend on the device mesh.
+struct AutoShardingLiveness {
+  static StatusOr<AutoShardingLiveness> Run(HloModule* module);
+
+  const HloInstructionSequence& sequence() const {
+    return hlo_live_range->flattened_instruction_sequence();
+  }
+
+  std::unique_ptr<HloSchedule> schedule;
+  std::unique_ptr<HloAliasAnalysis> alias_analysis;
+  std::unique_ptr<HloLiveRange> hlo_live_range;
+  AliasMap alias_map;
+  LivenessSet liveness_set;
+};
+
+// The strategies of all instructions and the simplified cost graph.
+struct AutoShardingStrategyGraph {
+  InstructionDepthMap ins_depth_map;
+  StrategyMap strategy_map;
+  LeafStrategies leaf_strategies;
+  AssociativeDotPairs associative_dot_pairs;
+  AliasSet alias_set;
+  std::unique_ptr<CostGraph> cost_graph;
+};
+
+// An auto-sharding problem that can be solved repeatedly, e.g., by the stage
+// construction search that sweeps submesh shapes and memory budgets for the
+// same module.
+// The schedule and the liveness analysis are built once. The strategy graph is
+// rebuilt only when the device mesh, its cost model or the solver options in
+// the pass context change. A change of the memory budget only re-runs the
+// solver, which is warm-started from the previous solution.
+// The module is owned and never annotated. To apply a solution, run the
+// auto-sharding pass on the original module with
+// auto_sharding::load_solution_vector and auto_sharding::solution_vector.
+class AutoShardingProblem {
+ public:
+  // `module` must already be processed by the passes that run before the
+  // auto-sharding pass.
+  static StatusOr<std::unique_ptr<AutoShardingProblem>> Create(
+      std::unique_ptr<HloModule> module);
+
+  // Solve the problem with the options in the current pass context.
+  StatusOr<AutoShardingSolution> Solve();
+
+ private:
+  AutoShardingProblem(std::unique_ptr<HloModule> module,
+                      AutoShardingLiveness liveness);
+
+  std::unique_ptr<HloModule> module_;
+  AutoShardingLiveness liveness_;
+  // The strategy graph and the key of the options it is built with.
+  std::optional<AutoShardingStrategyGraph> graph_;
+  std::string cost_key_;
+  // The last solution vector, used as the hint of the next solve.
+  std::vector<int64_t> last_s_val_;
+};
+
 }  // namespace spmd
 }  // namespace xla
 
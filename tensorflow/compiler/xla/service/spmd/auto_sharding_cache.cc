@@ -0,0 +1,167 @@
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_cache.h"
+
+#include "absl/algorithm/container.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/fingerprint.h"
+#include "tensorflow/tsl/platform/path.h"
+#include "tensorflow/tsl/platform/random.h"
+
+namespace xla {
+namespace spmd {
+
+namespace {
+
+// Bump this when the strategy enumeration or the file format changes.
+constexpr int kCacheFormatVersion = 2;
+
+std::string SolverOptionToString(const AutoShardingSolverOption& option) {
+  return absl::StrCat(
+      option.force_batch_dim_to_mesh_dim, ",", option.override_all_gather_cost,
+      ",", option.override_all_gather_cost ? option.all_gather_cost : 0, ",",
+      option.override_all_reduce_cost, ",",
+      option.override_all_reduce_cost ? option.all_reduce_cost : 0, ",",
+      option.override_reduce_scatter_cost, ",",
+      option.override_reduce_scatter_cost ? option.reduce_scatter_cost : 0, ",",
+      option.override_all_to_all_cost, ",",
+      option.override_all_to_all_cost ? option.all_to_all_cost : 0, ",",
+      option.allow_replicated_parameters, ",", option.prefer_reduce_scatter,
+      ",", option.reduce_scatter_grad_acc_friendly, ",",
+      option.reduce_scatter_aggressive_partition, ",",
+      option.reduce_scatter_shard_weights, ",",
+      option.batch_matmul_always_split_batch, ",",
+      option.allow_recompute_heavy_op, ",", option.allow_mixed_mesh_shape, ",",
+      option.grad_acc_num_micro_batches, ",", option.use_roofline_compute_cost,
+      ",", option.device_peak_flops, ",", option.device_memory_bandwidth, ",",
+      option.compute_cost_scale, ",", option.overlap_communication, ",",
+      option.overlap_communication ? option.overlap_window : 0, ",",
+      option.overlap_communication || option.collective_matmul
+          ? option.overlap_efficiency
+          : 0,
+      ",",
+      option.collective_matmul, ",",
+      option.collective_matmul ? option.collective_matmul_threshold_mib : 0,
+      ",",
+      option.allow_recompute_activations, ",",
+      option.allow_recompute_activations ? option.recompute_penalty : 0, ",",
+      option.tie_repeated_layers, ",", option.allow_all_to_all_resharding, ",",
+      option.allow_sequence_parallel, ",",
+      option.cost_calibration.ToFileContents());
+}
+
+bool ParseIntList(absl::string_view line, std::vector<int64_t>* values) {
+  values->clear();
+  if (line.empty()) {
+    return true;
+  }
+  for (absl::string_view token : absl::StrSplit(line, ',')) {
+    int64_t value;
+    if (!absl::SimpleAtoi(token, &value)) {
+      return false;
+    }
+    values->push_back(value);
+  }
+  return true;
+}
+
+}  // namespace
+
+std::string AutoShardingSolutionCache::ComputeKey(
+    const HloModule* module, const ClusterEnvironment& cluster_env,
+    const AutoShardingSolverOption& solver_option,
+    int64_t memory_budget_per_device) {
+  std::string key = absl::StrCat(
+      "v", kCacheFormatVersion, ";",
+      module->ToString(HloPrintOptions::ModuleFingerprint()), ";",
+      memory_budget_per_device, ";",
+      ComputeCostKey(cluster_env, solver_option));
+  tsl::Fprint128 fp = tsl::Fingerprint128(key);
+  return absl::StrCat(absl::Hex(fp.high64, absl::kZeroPad16),
+                      absl::Hex(fp.low64, absl::kZeroPad16));
+}
+
+std::string AutoShardingSolutionCache::ComputeCostKey(
+    const ClusterEnvironment& cluster_env,
+    const AutoShardingSolverOption& solver_option) {
+  return absl::StrCat(
+      absl::StrJoin(cluster_env.device_mesh.dimensions(), ","), ";",
+      absl::StrJoin(cluster_env.device_mesh.begin(),
+                    cluster_env.device_mesh.end(), ","),
+      ";", absl::StrJoin(cluster_env.mesh_alpha, ","), ";",
+      absl::StrJoin(cluster_env.mesh_beta, ","), ";",
+      cluster_env.prof_result.ToFileContents(), ";",
+      SolverOptionToString(solver_option));
+}
+
+std::string AutoShardingSolutionCache::GetPath(const std::string& key) const {
+  return tsl::io::JoinPath(cache_dir_, absl::StrCat(key, ".sol"));
+}
+
+std::optional<std::vector<int64_t>> AutoShardingSolutionCache::Lookup(
+    const std::string& key, const CostGraph& cost_graph) const {
+  std::string path = GetPath(key);
+  tsl::Env* env = tsl::Env::Default();
+  if (!env->FileExists(path).ok()) {
+    return std::nullopt;
+  }
+
+  std::string contents;
+  if (!tsl::ReadFileToString(env, path, &contents).ok()) {
+    LOG(WARNING) << "Failed to read auto-sharding solution cache: " << path;
+    return std::nullopt;
+  }
+
+  // Line 0: node lengths, line 1: follow indices, line 2: solution vector.
+  std::vector<absl::string_view> lines = absl::StrSplit(contents, '\n');
+  std::vector<int64_t> node_lens, follow_idx, s_val;
+  if (lines.size() < 3 || !ParseIntList(lines[0], &node_lens) ||
+      !ParseIntList(lines[1], &follow_idx) || !ParseIntList(lines[2], &s_val)) {
+    LOG(WARNING) << "Corrupted auto-sharding solution cache: " << path;
+    return std::nullopt;
+  }
+
+  if (!absl::c_equal(node_lens, cost_graph.node_lens) ||
+      !absl::c_equal(follow_idx, cost_graph.follow_idx) ||
+      s_val.size() != node_lens.size()) {
+    LOG(WARNING) << "Ignore stale auto-sharding solution cache: " << path;
+    return std::nullopt;
+  }
+  for (size_t i = 0; i < s_val.size(); ++i) {
+    // The solution of a following node indexes the strategies of the node
+    // it follows.
+    int64_t len = follow_idx[i] < 0 ? node_lens[i] : node_lens[follow_idx[i]];
+    if (s_val[i] < 0 || s_val[i] >= len) {
+      LOG(WARNING) << "Ignore invalid auto-sharding solution cache: " << path;
+      return std::nullopt;
+    }
+  }
+
+  VLOG(1) << "Hit auto-sharding solution cache: " << path;
+  return s_val;
+}
+
+Status AutoShardingSolutionCache::Insert(
+    const std::string& key, const CostGraph& cost_graph,
+    const std::vector<int64_t>& s_val) const {
+  tsl::Env* env = tsl::Env::Default();
+  TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(cache_dir_));
+
+  std::string contents = absl::StrCat(
+      absl::StrJoin(cost_graph.node_lens, ","), "\n",
+      absl::StrJoin(cost_graph.follow_idx, ","), "\n",
+      absl::StrJoin(s_val, ","), "\n");
+
+  // Write to a temporary file first so that concurrent readers never see a
+  // partially written entry.
+  std::string path = GetPath(key);
+  std::string tmp_path = absl::StrCat(path, ".tmp.", tsl::random::New64());
+  TF_RETURN_IF_ERROR(tsl::WriteStringToFile(env, tmp_path, contents));
+  return env->RenameFile(tmp_path, path);
+}
+
+}  // namespace spmd
+}  // namespace xla
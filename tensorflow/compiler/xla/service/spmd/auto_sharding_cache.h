@@ -0,0 +1,57 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_CACHE_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_CACHE_H_
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_strategy.h"
+#include "tensorflow/compiler/xla/status.h"
+
+namespace xla {
+namespace spmd {
+
+// An on-disk cache of auto-sharding solution vectors.
+// Each entry is a file named by a fingerprint of the canonical HLO module,
+// the device mesh, the cost model parameters and the solver options. It stores
+// the number of strategies and the follow index of every node, so that a stale
+// entry whose strategy space no longer matches the cost graph is ignored.
+class AutoShardingSolutionCache {
+ public:
+  // `cache_dir` is created if it does not exist.
+  explicit AutoShardingSolutionCache(std::string cache_dir)
+      : cache_dir_(std::move(cache_dir)) {}
+
+  // Compute the cache key of a module. This must be called before any
+  // sharding annotation is added by the auto-sharding pass.
+  static std::string ComputeKey(const HloModule* module,
+                                const ClusterEnvironment& cluster_env,
+                                const AutoShardingSolverOption& solver_option,
+                                int64_t memory_budget_per_device);
+
+  // The part of the key that depends on neither the module nor the memory
+  // budget, i.e., everything the strategies and their costs are built from.
+  static std::string ComputeCostKey(
+      const ClusterEnvironment& cluster_env,
+      const AutoShardingSolverOption& solver_option);
+
+  // Return the cached solution vector, or nullopt if there is no valid entry.
+  std::optional<std::vector<int64_t>> Lookup(const std::string& key,
+                                             const CostGraph& cost_graph) const;
+
+  // Store a solution vector. Errors are returned but are not fatal for the
+  // compilation.
+  Status Insert(const std::string& key, const CostGraph& cost_graph,
+                const std::vector<int64_t>& s_val) const;
+
+ private:
+  std::string GetPath(const std::string& key) const;
+
+  std::string cache_dir_;
+};
+
+}  // namespace spmd
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_CACHE_H_
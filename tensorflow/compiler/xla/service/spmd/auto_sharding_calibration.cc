@@ -0,0 +1,250 @@
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_calibration.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/service/hlo_instructions.h"
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_compute_cost.h"
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_strategy.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/tsl/platform/env.h"
+
+namespace xla {
+namespace spmd {
+
+namespace {
+
+// Factors are clamped, so that one bad profile cannot make a kind of
+// operation free or prohibitive.
+constexpr double kMinFactor = 1.0 / 16;
+constexpr double kMaxFactor = 16.0;
+
+double ShapeBytes(const Shape& shape) {
+  double bytes = 0;
+  ShapeUtil::ForEachSubshape(
+      shape, [&](const Shape& subshape, const ShapeIndex&) {
+        if (subshape.IsArray()) {
+          bytes += ShapeUtil::ByteSizeOf(subshape);
+        }
+      });
+  return bytes;
+}
+
+double OperandBytes(const HloInstruction* ins) {
+  double bytes = 0;
+  for (const HloInstruction* operand : ins->operands()) {
+    bytes += ShapeBytes(operand->shape());
+  }
+  return bytes;
+}
+
+// The mesh dim whose replica groups are the groups of `ins`, or -1.
+int FindMeshDim(const HloInstruction* ins,
+                const ClusterEnvironment& cluster_env) {
+  std::vector<std::vector<int>> groups;
+  for (const ReplicaGroup& group : ins->replica_groups()) {
+    std::vector<int> ids(group.replica_ids().begin(),
+                         group.replica_ids().end());
+    absl::c_sort(ids);
+    groups.push_back(std::move(ids));
+  }
+  absl::c_sort(groups);
+  for (int d = 0; d < cluster_env.cached_replica_groups.size(); ++d) {
+    if (cluster_env.device_mesh.dim(d) <= 1) {
+      continue;
+    }
+    std::vector<std::vector<int>> mesh_groups =
+        cluster_env.cached_replica_groups[d];
+    for (std::vector<int>& ids : mesh_groups) {
+      absl::c_sort(ids);
+    }
+    absl::c_sort(mesh_groups);
+    if (groups == mesh_groups) {
+      return d;
+    }
+  }
+  return -1;
+}
+
+}  // namespace
+
+StatusOr<CostCalibration> CostCalibration::LoadFromFile(
+    const std::string& path) {
+  std::string contents;
+  TF_RETURN_IF_ERROR(
+      tsl::ReadFileToString(tsl::Env::Default(), path, &contents));
+  return FromFileContents(contents);
+}
+
+StatusOr<CostCalibration> CostCalibration::FromFileContents(
+    absl::string_view contents) {
+  CostCalibration calibration;
+  int line_no = 0;
+  for (absl::string_view line : absl::StrSplit(contents, '\n')) {
+    line_no++;
+    line = absl::StripAsciiWhitespace(line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::vector<absl::string_view> tokens =
+        absl::StrSplit(line, absl::ByAnyChar(" \t"), absl::SkipEmpty());
+    int mesh_dim;
+    double factor;
+    if (tokens.size() != 3 || !absl::SimpleAtoi(tokens[1], &mesh_dim) ||
+        !absl::SimpleAtod(tokens[2], &factor) || !(factor > 0)) {
+      return InvalidArgument("Invalid line %d of the cost calibration: %s",
+                             line_no, line);
+    }
+    TF_ASSIGN_OR_RETURN(ProfiledOpKind kind, StringToProfiledOpKind(tokens[0]));
+    calibration.SetFactor(kind, mesh_dim, factor);
+  }
+  return calibration;
+}
+
+std::string CostCalibration::ToFileContents() const {
+  std::vector<std::string> lines;
+  for (const auto& item : factors_) {
+    lines.push_back(absl::StrFormat("%s %d %.17g",
+                                    ProfiledOpKindToString(item.first.first),
+                                    item.first.second, item.second));
+  }
+  // Sort the lines so that the same factors are always serialized the same.
+  absl::c_sort(lines);
+  return absl::StrCat(absl::StrJoin(lines, "\n"), "\n");
+}
+
+Status CostCalibration::SaveToFile(const std::string& path) const {
+  return tsl::WriteStringToFile(tsl::Env::Default(), path, ToFileContents());
+}
+
+double CostCalibration::Factor(ProfiledOpKind kind, int mesh_dim) const {
+  auto iter = factors_.find({kind, mesh_dim});
+  return iter == factors_.end() ? 1.0 : iter->second;
+}
+
+void CostCalibration::SetFactor(ProfiledOpKind kind, int mesh_dim,
+                                double factor) {
+  factors_[{kind, mesh_dim}] = std::clamp(factor, kMinFactor, kMaxFactor);
+}
+
+void CostCalibration::Update(ProfiledOpKind kind, int mesh_dim,
+                             double estimated, double measured,
+                             double damping) {
+  if (!(estimated > 0) || !(measured > 0)) {
+    return;
+  }
+  SetFactor(kind, mesh_dim,
+            Factor(kind, mesh_dim) * std::pow(measured / estimated, damping));
+}
+
+Status FitCostCalibration(
+    const HloModule& module, const ClusterEnvironment& cluster_env,
+    const absl::flat_hash_map<std::string, double>& op_seconds, double damping,
+    CostCalibration* calibration) {
+  if (!(damping > 0 && damping <= 1)) {
+    return InvalidArgument("The damping must be in (0, 1], got %f", damping);
+  }
+
+  // The sums of the estimated and the measured time of each factor. The
+  // factors are only updated at the end, because the estimates of
+  // `cluster_env` may read `calibration`.
+  absl::flat_hash_map<std::pair<ProfiledOpKind, int>,
+                      std::pair<double, double>>
+      sums;
+  for (const HloComputation* computation : module.computations()) {
+    for (const HloInstruction* ins : computation->instructions()) {
+      auto measured = op_seconds.find(ins->name());
+      if (measured == op_seconds.end()) {
+        continue;
+      }
+
+      ProfiledOpKind kind;
+      double estimated;
+      int mesh_dim = -1;
+      switch (ins->opcode()) {
+        case HloOpcode::kAllReduce:
+        case HloOpcode::kAllReduceStart:
+          kind = ProfiledOpKind::kAllReduce;
+          mesh_dim = FindMeshDim(ins, cluster_env);
+          if (mesh_dim < 0) {
+            continue;
+          }
+          estimated = cluster_env.AllReduceCost(OperandBytes(ins), mesh_dim);
+          break;
+        case HloOpcode::kAllGather:
+        case HloOpcode::kAllGatherStart:
+          kind = ProfiledOpKind::kAllGather;
+          mesh_dim = FindMeshDim(ins, cluster_env);
+          if (mesh_dim < 0) {
+            continue;
+          }
+          // The cost model takes the gathered bytes.
+          estimated = cluster_env.AllGatherCost(
+              OperandBytes(ins) * cluster_env.device_mesh.dim(mesh_dim),
+              mesh_dim);
+          break;
+        case HloOpcode::kReduceScatter:
+          kind = ProfiledOpKind::kReduceScatter;
+          mesh_dim = FindMeshDim(ins, cluster_env);
+          if (mesh_dim < 0) {
+            continue;
+          }
+          estimated =
+              cluster_env.ReduceScatterCost(OperandBytes(ins), mesh_dim);
+          break;
+        case HloOpcode::kAllToAll:
+          kind = ProfiledOpKind::kAllToAll;
+          mesh_dim = FindMeshDim(ins, cluster_env);
+          if (mesh_dim < 0) {
+            continue;
+          }
+          // The cost model takes the bytes of the whole group.
+          estimated = cluster_env.AllToAllCost(
+              OperandBytes(ins) * cluster_env.device_mesh.dim(mesh_dim),
+              mesh_dim);
+          break;
+        case HloOpcode::kDot:
+          if (!cluster_env.solver_option.use_roofline_compute_cost) {
+            continue;
+          }
+          // The dots of a partitioned module are already local.
+          kind = ProfiledOpKind::kDot;
+          estimated = RooflineDotTime(
+              ins, HloSharding::Replicate(), HloSharding::Replicate(),
+              HloSharding::Replicate(), cluster_env.solver_option);
+          break;
+        default:
+          continue;
+      }
+      if (estimated >= INFINITY_COST) {
+        continue;
+      }
+
+      std::pair<double, double>& sum = sums[{kind, mesh_dim}];
+      sum.first += estimated;
+      sum.second += measured->second;
+    }
+  }
+
+  for (const auto& item : sums) {
+    VLOG(1) << "Calibrate " << ProfiledOpKindToString(item.first.first)
+            << " @ " << item.first.second << ": estimated "
+            << item.second.first << ", measured " << item.second.second;
+    calibration->Update(item.first.first, item.first.second, item.second.first,
+                        item.second.second, damping);
+  }
+  return OkStatus();
+}
+
+}  // namespace spmd
+}  // namespace xla
@@ -0,0 +1,72 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_CALIBRATION_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_CALIBRATION_H_
+
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/spmd/collective_cost_model.h"
+#include "tensorflow/compiler/xla/status.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace xla {
+namespace spmd {
+
+class ClusterEnvironment;
+
+// Correction factors for the costs estimated by the auto-sharding pass,
+// fitted from the measured time of the operations of a profiled step.
+// The collective costs of ClusterEnvironment are multiplied by the factor of
+// their kind and mesh dim, and the roofline dot time by the factor of kDot
+// (mesh dim -1). Recompiling the same model with the updated factors moves the
+// solution towards the plan that runs fastest on the real cluster.
+class CostCalibration {
+ public:
+  CostCalibration() = default;
+
+  // Load factors saved by ToFileContents / SaveToFile. Each non-empty line
+  // that does not start with '#' is
+  //   <kind> <mesh dim> <factor>
+  // e.g.,
+  //   all-gather 1 1.35
+  static StatusOr<CostCalibration> LoadFromFile(const std::string& path);
+  static StatusOr<CostCalibration> FromFileContents(absl::string_view contents);
+  std::string ToFileContents() const;
+  Status SaveToFile(const std::string& path) const;
+
+  // The factor of a kind of operation on a mesh dim, or 1 if it is not
+  // calibrated.
+  double Factor(ProfiledOpKind kind, int mesh_dim) const;
+  void SetFactor(ProfiledOpKind kind, int mesh_dim, double factor);
+
+  // Move the factor towards measured / estimated, where `estimated` is the
+  // cost predicted with the current factor. `damping` in (0, 1] is the
+  // fraction of the step taken in log space, so that the factors converge
+  // over several profiled steps instead of following the noise of one.
+  void Update(ProfiledOpKind kind, int mesh_dim, double estimated,
+              double measured, double damping);
+
+  bool empty() const { return factors_.empty(); }
+
+ private:
+  absl::flat_hash_map<std::pair<ProfiledOpKind, int>, double> factors_;
+};
+
+// Update `calibration` with the measured time of the collectives and dots of
+// a module partitioned with the device mesh of `cluster_env`. `op_seconds`
+// maps instruction names to their measured time, e.g., averaged over the
+// steps of a profile. The estimates are the costs of `cluster_env`, which
+// must use the current factors of `calibration`. Instructions without a
+// measurement and collectives whose replica groups are not the groups of one
+// mesh dim are ignored. Dots are only calibrated with the roofline compute
+// cost.
+Status FitCostCalibration(
+    const HloModule& module, const ClusterEnvironment& cluster_env,
+    const absl::flat_hash_map<std::string, double>& op_seconds, double damping,
+    CostCalibration* calibration);
+
+}  // namespace spmd
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_CALIBRATION_H_
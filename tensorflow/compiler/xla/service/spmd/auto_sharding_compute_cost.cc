@@ -0,0 +1,282 @@
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_compute_cost.h"
+
+#include <algorithm>
+
+#include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_reachability.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace xla {
+namespace spmd {
+
+namespace {
+
+// The tile sizes of typical tensor-core GEMM kernels. A GEMM whose local
+// dimensions are not multiples of these sizes still pays for full tiles.
+constexpr int64_t kGemmTileM = 128;
+constexpr int64_t kGemmTileN = 128;
+constexpr int64_t kGemmTileK = 32;
+
+int64_t RoundUp(int64_t value, int64_t multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+double Roofline(double flops, double bytes,
+                const AutoShardingSolverOption& solver_option) {
+  double time = std::max(flops / solver_option.device_peak_flops,
+                         bytes / solver_option.device_memory_bandwidth);
+  return time * solver_option.compute_cost_scale;
+}
+
+// The shape of the shard on one device.
+Shape LocalShape(const Shape& shape, const HloSharding& spec) {
+  if (IsUndefined(spec) || spec.IsReplicated() || spec.IsTileMaximal()) {
+    return shape;
+  }
+  return spec.TileShape(shape);
+}
+
+double NumElements(const Shape& shape) {
+  return static_cast<double>(ShapeUtil::ElementsIn(shape));
+}
+
+}  // namespace
+
+double RooflineDotTime(const HloInstruction* ins, const HloSharding& lhs_spec,
+                       const HloSharding& rhs_spec,
+                       const HloSharding& output_spec,
+                       const AutoShardingSolverOption& solver_option) {
+  const HloInstruction* lhs = ins->operand(0);
+  const HloInstruction* rhs = ins->operand(1);
+  const DotDimensionNumbers& dot_dnums = ins->dot_dimension_numbers();
+  Shape lhs_shape = LocalShape(lhs->shape(), lhs_spec);
+  Shape rhs_shape = LocalShape(rhs->shape(), rhs_spec);
+  Shape out_shape = LocalShape(ins->shape(), output_spec);
+
+  std::vector<int64_t> lhs_space_dims, rhs_space_dims;
+  std::tie(lhs_space_dims, rhs_space_dims) =
+      GetSpaceDims(lhs_shape, rhs_shape, dot_dnums);
+
+  int64_t batch = 1, m = 1, n = 1, k = 1;
+  for (int64_t dim : dot_dnums.lhs_batch_dimensions()) {
+    batch *= lhs_shape.dimensions(dim);
+  }
+  for (int64_t dim : lhs_space_dims) {
+    m *= lhs_shape.dimensions(dim);
+  }
+  for (int64_t dim : rhs_space_dims) {
+    n *= rhs_shape.dimensions(dim);
+  }
+  for (int64_t dim : dot_dnums.lhs_contracting_dimensions()) {
+    k *= lhs_shape.dimensions(dim);
+  }
+
+  double flops = 2.0 * batch * RoundUp(m, kGemmTileM) *
+                 RoundUp(n, kGemmTileN) * RoundUp(k, kGemmTileK);
+  double bytes =
+      GetBytes(lhs_shape) + GetBytes(rhs_shape) + GetBytes(out_shape);
+  return Roofline(flops, bytes, solver_option) *
+         solver_option.cost_calibration.Factor(ProfiledOpKind::kDot, -1);
+}
+
+Status AddRooflineComputeCost(const HloInstructionSequence& sequence,
+                              const LeafStrategies& leaf_strategies,
+                              const AutoShardingSolverOption& solver_option) {
+  const std::vector<HloInstruction*>& instructions = sequence.instructions();
+  if (instructions.empty()) {
+    return OkStatus();
+  }
+
+  HloCostAnalysis analysis([](const Shape& shape) {
+    return ShapeUtil::ByteSizeOf(shape, /*pointer_size=*/8);
+  });
+  TF_RETURN_IF_ERROR(instructions.front()->parent()->Accept(&analysis));
+
+  for (StrategyVector* strategies : leaf_strategies) {
+    const HloInstruction* ins = instructions[strategies->instruction_id];
+    // The cost of a tuple-shaped instruction cannot be split among the
+    // strategy vectors of its elements.
+    if (ins->shape().IsTuple()) {
+      continue;
+    }
+
+    double flops =
+        analysis.flop_count(*ins) + analysis.transcendental_count(*ins);
+    double bytes = analysis.bytes_accessed(*ins);
+    if (flops == 0 && bytes == 0) {
+      continue;
+    }
+
+    for (ShardingStrategy& stra : strategies->leaf_vector) {
+      if (stra.compute_cost >= INFINITY_COST) {
+        continue;
+      }
+
+      double time;
+      if (ins->opcode() == HloOpcode::kDot &&
+          stra.input_shardings.size() == 2) {
+        time = RooflineDotTime(ins, stra.input_shardings[0],
+                               stra.input_shardings[1], stra.output_sharding,
+                               solver_option);
+      } else {
+        // The fraction of the work done by one device.
+        double fraction =
+            NumElements(LocalShape(ins->shape(), stra.output_sharding)) /
+            std::max(NumElements(ins->shape()), 1.0);
+        if (ins->opcode() == HloOpcode::kConvolution &&
+            stra.input_shardings.size() == 2) {
+          const Shape& lhs_shape = ins->operand(0)->shape();
+          int64_t in_channel_dim =
+              ins->convolution_dimension_numbers().input_feature_dimension();
+          fraction *=
+              1.0 *
+              LocalShape(lhs_shape, stra.input_shardings[0])
+                  .dimensions(in_channel_dim) /
+              lhs_shape.dimensions(in_channel_dim);
+        }
+        time = Roofline(flops * fraction, bytes * fraction, solver_option);
+      }
+      stra.compute_cost += time;
+    }
+  }
+
+  return OkStatus();
+}
+
+Status DiscountOverlappedCommunication(
+    const HloInstructionSequence& sequence,
+    const LeafStrategies& leaf_strategies,
+    const AssociativeDotPairs& associative_dot_pairs,
+    const AutoShardingSolverOption& solver_option) {
+  const std::vector<HloInstruction*>& instructions = sequence.instructions();
+  if (instructions.empty() || solver_option.overlap_window <= 0 ||
+      solver_option.overlap_efficiency <= 0) {
+    return OkStatus();
+  }
+  const int64_t n = instructions.size();
+
+  // The cheapest compute cost of every instruction.
+  std::vector<double> compute(n, 0.0);
+  for (const StrategyVector* strategies : leaf_strategies) {
+    double min_cost = INFINITY_COST;
+    for (const ShardingStrategy& stra : strategies->leaf_vector) {
+      min_cost = std::min(min_cost, stra.compute_cost);
+    }
+    if (min_cost < INFINITY_COST) {
+      compute[strategies->instruction_id] =
+          std::max(compute[strategies->instruction_id], min_cost);
+    }
+  }
+
+  // The compute that can overlap with the communication of every
+  // instruction.
+  std::unique_ptr<HloReachabilityMap> reachability =
+      HloReachabilityMap::Build(instructions.front()->parent());
+  std::vector<double> overlap_capacity(n, 0.0);
+  for (int64_t t = 0; t < n; ++t) {
+    int64_t begin = std::max<int64_t>(0, t - solver_option.overlap_window);
+    int64_t end = std::min<int64_t>(n, t + solver_option.overlap_window + 1);
+    for (int64_t i = begin; i < end; ++i) {
+      if (i != t && compute[i] > 0 &&
+          !reachability->IsConnected(instructions[t], instructions[i])) {
+        overlap_capacity[t] += compute[i];
+      }
+    }
+    overlap_capacity[t] *= solver_option.overlap_efficiency;
+  }
+  // A dot can be in several pairs, so propagate the minimum to a fixed point.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (const auto& pair : associative_dot_pairs) {
+      double& a = overlap_capacity[pair.first->instruction_id];
+      double& b = overlap_capacity[pair.second->instruction_id];
+      if (a != b) {
+        a = b = std::min(a, b);
+        changed = true;
+      }
+    }
+  }
+
+  auto exposed = [](double cost, double capacity) {
+    if (cost >= INFINITY_COST) {
+      return cost;
+    }
+    return std::max(cost - capacity, 0.0);
+  };
+
+  for (StrategyVector* strategies : leaf_strategies) {
+    double capacity = overlap_capacity[strategies->instruction_id];
+    if (capacity <= 0) {
+      continue;
+    }
+    for (ShardingStrategy& stra : strategies->leaf_vector) {
+      stra.communication_cost = exposed(stra.communication_cost, capacity);
+      for (std::vector<double>& costs : stra.resharding_costs) {
+        for (double& cost : costs) {
+          cost = exposed(cost, capacity);
+        }
+      }
+    }
+  }
+
+  return OkStatus();
+}
+
+Status DiscountCollectiveMatmul(const HloInstructionSequence& sequence,
+                                const LeafStrategies& leaf_strategies,
+                                const AutoShardingSolverOption& solver_option) {
+  const std::vector<HloInstruction*>& instructions = sequence.instructions();
+  const double threshold_bytes =
+      solver_option.collective_matmul_threshold_mib * 1024.0 * 1024.0;
+
+  for (StrategyVector* strategies : leaf_strategies) {
+    const HloInstruction* ins = instructions[strategies->instruction_id];
+    if (ins->opcode() != HloOpcode::kDot ||
+        strategies->in_nodes.size() != 2) {
+      continue;
+    }
+
+    for (ShardingStrategy& stra : strategies->leaf_vector) {
+      // The windowed loop keeps the output sharded like the other operand.
+      if (stra.input_shardings.size() != 2 ||
+          IsUndefined(stra.output_sharding) ||
+          stra.output_sharding.NumTiles() <= 1) {
+        continue;
+      }
+      double dot_time =
+          RooflineDotTime(ins, stra.input_shardings[0], stra.input_shardings[1],
+                          stra.output_sharding, solver_option) *
+          solver_option.overlap_efficiency;
+
+      for (int64_t i = 0; i < 2; ++i) {
+        const StrategyVector* operand = strategies->in_nodes[i];
+        const HloSharding& required = stra.input_shardings[i];
+        if (operand->is_tuple || IsUndefined(required) ||
+            GetBytes(ins->operand(i)->shape()) < threshold_bytes) {
+          continue;
+        }
+        std::vector<double>& costs = stra.resharding_costs[i];
+        for (size_t j = 0; j < costs.size(); ++j) {
+          const HloSharding& src = operand->leaf_vector[j].output_sharding;
+          if (costs[j] <= 0 || costs[j] >= INFINITY_COST ||
+              IsUndefined(src)) {
+            continue;
+          }
+          // Only an all-gather, i.e., the required sharding has fewer tiles,
+          // is windowed.
+          int64_t num_steps = src.NumTiles() / required.NumTiles();
+          if (num_steps <= 1) {
+            continue;
+          }
+          costs[j] = std::max(costs[j] - dot_time, costs[j] / num_steps);
+        }
+      }
+    }
+  }
+
+  return OkStatus();
+}
+
+}  // namespace spmd
+}  // namespace xla
@@ -0,0 +1,62 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_COMPUTE_COST_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_COMPUTE_COST_H_
+
+#include "tensorflow/compiler/xla/service/hlo_schedule.h"
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_strategy.h"
+#include "tensorflow/compiler/xla/status.h"
+
+namespace xla {
+namespace spmd {
+
+// Estimate the per-device time of a dot on the local shards given by its
+// operand shardings with a roofline model. The GEMM dimensions are rounded up
+// to the tile sizes of tensor-core kernels, so that tiny or badly aligned
+// shards are charged for the wasted work.
+double RooflineDotTime(const HloInstruction* ins, const HloSharding& lhs_spec,
+                       const HloSharding& rhs_spec,
+                       const HloSharding& output_spec,
+                       const AutoShardingSolverOption& solver_option);
+
+// Add the roofline time of every leaf strategy to its compute cost.
+// The flops and bytes of non-dot instructions come from HloCostAnalysis on
+// the unpartitioned instruction and are divided among the shards of the
+// output (and of the input feature dim for convolutions).
+Status AddRooflineComputeCost(const HloInstructionSequence& sequence,
+                              const LeafStrategies& leaf_strategies,
+                              const AutoShardingSolverOption& solver_option);
+
+// Discount the communication costs and the resharding costs of every leaf
+// strategy by the compute that can run concurrently with them, so that only
+// the exposed part of a collective is charged. The compute that can overlap
+// with the communication of an instruction is the cheapest compute cost of
+// the instructions within `overlap_window` in the sequence that neither
+// depend on it nor are depended on by it, scaled by `overlap_efficiency`.
+// This assumes the collectives are made asynchronous and scheduled by a
+// latency-hiding scheduler. It is only meaningful when compute costs are
+// estimated, e.g., by AddRooflineComputeCost.
+// Both dots of an associative pair get the same discount, because the cost
+// graph cancels their all-reduce costs against each other.
+Status DiscountOverlappedCommunication(
+    const HloInstructionSequence& sequence,
+    const LeafStrategies& leaf_strategies,
+    const AssociativeDotPairs& associative_dot_pairs,
+    const AutoShardingSolverOption& solver_option);
+
+// Discount the resharding costs of the all-gathers of large dot operands,
+// which the SPMD partitioner decomposes into windowed einsum loops with
+// auto_sharding::collective_matmul.
+// An all-gather over p devices is then p collective-permutes, each of which
+// overlaps with the partial dot of the previous step, so only the first step
+// and the part not hidden by `overlap_efficiency` of the dot time are exposed.
+// Only operands of at least `collective_matmul_threshold_mib` are discounted,
+// because the partitioner does not window smaller ones.
+// Unlike DiscountOverlappedCommunication, this overlaps the communication
+// with the dependent dot itself, so the two discounts can be combined.
+Status DiscountCollectiveMatmul(const HloInstructionSequence& sequence,
+                                const LeafStrategies& leaf_strategies,
+                                const AutoShardingSolverOption& solver_option);
+
+}  // namespace spmd
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_COMPUTE_COST_H_
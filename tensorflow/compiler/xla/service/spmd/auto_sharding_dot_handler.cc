@@ -66,8 +66,8 @@ class DotHandler {
     out_lhs_space_dim = dot_dnums.lhs_batch_dimensions_size();
     out_rhs_space_dim = out_lhs_space_dim + 1;
 
-    // Only support 2 dimensional device mesh
-    CHECK_EQ(device_mesh.num_dimensions(), 2);
+    // Strategies are enumerated over pairs of mesh dims.
+    CHECK_GE(device_mesh.num_dimensions(), 2);
   }
 
   void SplitLhsSpaceRhsSpace(int mesh_dim0, int mesh_dim1) {
@@ -147,7 +147,7 @@ class DotHandler {
   }
 
   void SplitOneBatchDim() {
-    if (device_mesh.dim(0) == 1 || device_mesh.dim(1) == 1) {
+    if (cluster_env.non_zero_mesh_dims.size() <= 1) {
       for (int64_t i = 0; i < lhs_batch_dims.size(); ++i) {
         for (int64_t j = 0; j < device_mesh.num_dimensions(); ++j) {
           if (device_mesh.dim(j) == 1 ||
@@ -268,8 +268,62 @@ class DotHandler {
     }
   }
 
+  // Sequence parallelism: the partial sums of a contracting-dim split are
+  // reduce-scattered onto the lhs space dim (the flattened batch and sequence
+  // dims) instead of being all-reduced.
+  void SplitLhsSpaceBothContractReduceScatter() {
+    const std::vector<int>& mesh_dims = cluster_env.non_zero_mesh_dims;
+    if (mesh_dims.size() == 1) {
+      // SR = RS x SR @ {m} (reducescatter @ m)
+      int mesh_dim = mesh_dims[0];
+      if (ins->shape().dimensions(out_lhs_space_dim) %
+              device_mesh.dim(mesh_dim) !=
+          0) {
+        return;
+      }
+      std::string name = absl::StrFormat(
+          "SR = RS x SR @ {%d} (reducescatter @ %d)", mesh_dim, mesh_dim);
+      HloSharding output_spec =
+          Tile(ins->shape(), {out_lhs_space_dim}, {mesh_dim}, device_mesh);
+      HloSharding lhs_spec =
+          Tile(lhs->shape(), {lhs_con_dims[0]}, {mesh_dim}, device_mesh);
+      HloSharding rhs_spec =
+          Tile(rhs->shape(), {rhs_con_dims[0]}, {mesh_dim}, device_mesh);
+      double communication_cost =
+          cluster_env.ReduceScatterCost(GetBytes(ins->shape()), mesh_dim);
+      AppendNewStrategy(ins, name, output_spec, {lhs_spec, rhs_spec}, 0,
+                        communication_cost, cluster_env, strategy_map,
+                        strategies);
+    } else if (mesh_dims.size() == 2) {
+      // The lhs space dim is split on the first mesh dim and the contracting
+      // dims on the second one. The output space dim is split on both, which
+      // is the flattened 1d mesh because the first mesh dim is the major one.
+      int mesh_dim0 = mesh_dims[0], mesh_dim1 = mesh_dims[1];
+      if (ins->shape().dimensions(out_lhs_space_dim) %
+              device_mesh.num_elements() !=
+          0) {
+        return;
+      }
+      std::string name =
+          absl::StrFormat("S01R = SS x SR @ {%d,%d} (reducescatter @ %d)",
+                          mesh_dim0, mesh_dim1, mesh_dim1);
+      HloSharding output_spec =
+          Tile(ins->shape(), {out_lhs_space_dim}, {0}, device_mesh_1d);
+      HloSharding lhs_spec =
+          Tile(lhs->shape(), {lhs_space_dims[0], lhs_con_dims[0]},
+               {mesh_dim0, mesh_dim1}, device_mesh);
+      HloSharding rhs_spec =
+          Tile(rhs->shape(), {rhs_con_dims[0]}, {mesh_dim1}, device_mesh);
+      double communication_cost = cluster_env.ReduceScatterCost(
+          GetBytes(ins->shape()) / device_mesh.dim(mesh_dim0), mesh_dim1);
+      AppendNewStrategy(ins, name, output_spec, {lhs_spec, rhs_spec}, 0,
+                        communication_cost, cluster_env, strategy_map,
+                        strategies);
+    }
+  }
+
   void Add1DDataParallel() {
-    if (device_mesh.dim(0) > 1 && device_mesh.dim(1) > 1) {
+    if (cluster_env.non_zero_mesh_dims.size() > 1) {
       int mesh_dim = 0;
       int64_t num_devices = device_mesh_1d.dim(mesh_dim);
 
@@ -296,8 +350,8 @@ class DotHandler {
         HloSharding rhs_spec =
             Tile(rhs->shape(), {rhs_con_dims[0]}, {mesh_dim}, device_mesh_1d);
         double memory_cost = GetBytes(ins->shape()) / output_spec.NumTiles();
-        double communication_cost = cluster_env.AllReduceCost(memory_cost, 0) +
-                                    cluster_env.AllReduceCost(memory_cost, 1);
+        double communication_cost =
+            cluster_env.AllReduceCostAllMeshDims(memory_cost);
 
         AppendNewStrategy(ins, name, output_spec, {lhs_spec, rhs_spec}, 0,
                           communication_cost, cluster_env, strategy_map,
@@ -307,7 +361,7 @@ class DotHandler {
   }
 
   void Add1DBatchSplit() {
-    if (device_mesh.dim(0) > 1 && device_mesh.dim(1) > 1) {
+    if (cluster_env.non_zero_mesh_dims.size() > 1) {
       int mesh_dim = 0;
       for (int64_t i = 0; i < lhs_batch_dims.size(); ++i) {
         std::string name =
@@ -327,25 +381,35 @@ class DotHandler {
   Status RegisterStrategies() {
     // SS = SR x RS
     // Split lhs space dim and rhs space dim.
-    SplitLhsSpaceRhsSpace(0, 1);
-    SplitLhsSpaceRhsSpace(1, 0);
+    for (const auto& pair : cluster_env.mesh_dim_pairs) {
+      SplitLhsSpaceRhsSpace(pair.first, pair.second);
+    }
 
     // SR = SS x SR
     // Split lhs space dim and both contracting dims.
-    SplitLhsSpaceBothContract(0, 1);
-    SplitLhsSpaceBothContract(1, 0);
+    for (const auto& pair : cluster_env.mesh_dim_pairs) {
+      SplitLhsSpaceBothContract(pair.first, pair.second);
+    }
 
     // RS = RS x SS
     // Split rhs space dim and both contracting dims.
-    SplitRhsSpaceBothContract(0, 1);
-    SplitRhsSpaceBothContract(1, 0);
+    for (const auto& pair : cluster_env.mesh_dim_pairs) {
+      SplitRhsSpaceBothContract(pair.first, pair.second);
+    }
 
     // RR = RS x SR
     // This is a special case where we allow spliting only one dim in the
     // 2d-mesh case. This allows some recomputation (e.g., the dense layer in
     // the LM_head of BERT).
-    RecomputeSplitBothContract(0, 1);
-    RecomputeSplitBothContract(1, 0);
+    for (const auto& pair : cluster_env.mesh_dim_pairs) {
+      RecomputeSplitBothContract(pair.first, pair.second);
+    }
+
+    // SR = RS x SR (reducescatter)
+    // Split both contracting dims and reduce-scatter onto the lhs space dim.
+    if (solver_option.allow_sequence_parallel) {
+      SplitLhsSpaceBothContractReduceScatter();
+    }
 
     // Add 1d data parallel in 2d mesh
     if (solver_option.allow_mixed_mesh_shape) {
@@ -366,22 +430,25 @@ class DotHandler {
 
     // SbSi = SbSi x SbR
     // Split batch dim and lhs space dim
-    SplitBatchDimLhsSpace(0, 1);
-    SplitBatchDimLhsSpace(1, 0);
+    for (const auto& pair : cluster_env.mesh_dim_pairs) {
+      SplitBatchDimLhsSpace(pair.first, pair.second);
+    }
 
     // SbSj = SbR x SbSj
     // Split batch dim and lhs space dim
-    SplitBatchDimRhsSpace(0, 1);
-    SplitBatchDimRhsSpace(1, 0);
+    for (const auto& pair : cluster_env.mesh_dim_pairs) {
+      SplitBatchDimRhsSpace(pair.first, pair.second);
+    }
 
     // SbSj = SbR x SbSj
     // Split batch dim and lhs space dim
-    SplitBatchDimBothContract(0, 1);
-    SplitBatchDimBothContract(1, 0);
+    for (const auto& pair : cluster_env.mesh_dim_pairs) {
+      SplitBatchDimBothContract(pair.first, pair.second);
+    }
 
     if (solver_option.batch_matmul_always_split_batch &&
-        lhs_batch_dims.size() == 2 && device_mesh.dim(0) > 1 &&
-        device_mesh.dim(1) > 1) {
+        lhs_batch_dims.size() == 2 &&
+        cluster_env.non_zero_mesh_dims.size() > 1) {
       // If there are two batch dims, always split on these two dims.
       // Clear all old strategies.
       strategies->leaf_vector.clear();
@@ -389,8 +456,9 @@ class DotHandler {
 
     // Sb = Sb x Sb
     // Split batch dims.
-    SplitTwoBatchDims(0, 1);
-    SplitTwoBatchDims(1, 0);
+    for (const auto& pair : cluster_env.mesh_dim_pairs) {
+      SplitTwoBatchDims(pair.first, pair.second);
+    }
 
     if (solver_option.allow_mixed_mesh_shape) {
       Add1DBatchSplit();
@@ -470,8 +538,8 @@ class ConvHandler {
     out_batch_dim = conv_dnums.output_batch_dimension();
     out_out_channel_dim = conv_dnums.output_feature_dimension();
 
-    // Only support 2 dimensional device mesh
-    CHECK_EQ(device_mesh.num_dimensions(), 2);
+    // Strategies are enumerated over pairs of mesh dims.
+    CHECK_GE(device_mesh.num_dimensions(), 2);
   }
 
   void SplitLhsBatchRhsOutchannel(int mesh_dim0, int mesh_dim1) {
@@ -536,7 +604,7 @@ class ConvHandler {
   }
 
   void Add1DDataParallel() {
-    if (device_mesh.dim(0) > 1 && device_mesh.dim(1) > 1) {
+    if (cluster_env.non_zero_mesh_dims.size() > 1) {
       int mesh_dim = 0;
       int64_t num_devices = device_mesh_1d.dim(mesh_dim);
 
@@ -564,8 +632,8 @@ class ConvHandler {
         HloSharding rhs_spec = Tile(rhs->shape(), {rhs_in_channel_dim},
                                     {mesh_dim}, device_mesh_1d);
         double memory_cost = GetBytes(ins->shape()) / output_spec.NumTiles();
-        double communication_cost = cluster_env.AllReduceCost(memory_cost, 0) +
-                                    cluster_env.AllReduceCost(memory_cost, 1);
+        double communication_cost =
+            cluster_env.AllReduceCostAllMeshDims(memory_cost);
 
         AppendNewStrategy(ins, name, output_spec, {lhs_spec, rhs_spec}, 0,
                           communication_cost, cluster_env, strategy_map,
@@ -601,8 +669,9 @@ class ConvHandler {
       // for depthwise conv
       // SS = SS x S
       // Split batch dim and channel dim
-      SplitDepthwise(0, 1, true);
-      SplitDepthwise(1, 0, true);
+      for (const auto& pair : cluster_env.mesh_dim_pairs) {
+        SplitDepthwise(pair.first, pair.second, true);
+      }
     } else if ((ins->batch_group_count() ==
                     lhs->shape().dimensions(lhs_batch_dim) &&
                 ins->batch_group_count() ==
@@ -610,24 +679,28 @@ class ConvHandler {
       // for depthwise conv filter_backward
       // SS = SS x S
       // Split batch dim and channel dim
-      SplitDepthwise(0, 1, false);
-      SplitDepthwise(1, 0, false);
+      for (const auto& pair : cluster_env.mesh_dim_pairs) {
+        SplitDepthwise(pair.first, pair.second, false);
+      }
     }
 
     // SS = SR x RS
     // Split lhs batch dim and rhs out_channel dim.
-    SplitLhsBatchRhsOutchannel(0, 1);
-    SplitLhsBatchRhsOutchannel(1, 0);
+    for (const auto& pair : cluster_env.mesh_dim_pairs) {
+      SplitLhsBatchRhsOutchannel(pair.first, pair.second);
+    }
 
     // SR = SS x SR
     // Split lhs batch dim and both in_channel dims.
-    SplitLhsBatchBothInchannel(0, 1);
-    SplitLhsBatchBothInchannel(1, 0);
+    for (const auto& pair : cluster_env.mesh_dim_pairs) {
+      SplitLhsBatchBothInchannel(pair.first, pair.second);
+    }
 
     // RS = RS x SS
     // Split rhs out_channel dim and both in_channel dims.
-    SplitRhsOutchannelBothInchannel(0, 1);
-    SplitRhsOutchannelBothInchannel(1, 0);
+    for (const auto& pair : cluster_env.mesh_dim_pairs) {
+      SplitRhsOutchannelBothInchannel(pair.first, pair.second);
+    }
 
     // Add 1d data parallel in 2d mesh
     if (solver_option.allow_mixed_mesh_shape) {
@@ -0,0 +1,897 @@
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_solver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <numeric>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "ortools/linear_solver/linear_solver.h"
+#include "pybind11/numpy.h"
+#include "tensorflow/compiler/xla/util.h"
+
+namespace xla {
+namespace spmd {
+
+using operations_research::MPConstraint;
+using operations_research::MPObjective;
+using operations_research::MPSolver;
+using operations_research::MPSolverParameters;
+using operations_research::MPVariable;
+
+namespace {
+
+// Return the strategy indices of a node in the space of the variables of the
+// node it follows. For a node that does not follow others, this is an arange.
+std::vector<int> GetStrategyIndices(const CostGraph& cost_graph, int node) {
+  if (cost_graph.follow_idx[node] >= 0) {
+    return cost_graph.reindexing_vector.at(node);
+  }
+  std::vector<int> ret(cost_graph.node_lens[node]);
+  std::iota(ret.begin(), ret.end(), 0);
+  return ret;
+}
+
+// Return, for every node, the time points at which the output of the node is
+// live but neither defined nor used. A node can free its memory at these time
+// points if it is recomputed before its next use. Recomputing a node must not
+// extend the live ranges of its operands, so a node only qualifies if all its
+// operands are live at all its uses. The set is empty for the other nodes.
+std::vector<absl::flat_hash_set<int64_t>> GetRecomputableLiveTimes(
+    const HloInstructionSequence& sequence, const LivenessSet& liveness_set,
+    const LeafStrategies& leaf_strategies) {
+  const std::vector<HloInstruction*>& instructions = sequence.instructions();
+  absl::flat_hash_map<const HloInstruction*, int64_t> time_of;
+  for (size_t t = 0; t < instructions.size(); ++t) {
+    time_of[instructions[t]] = t;
+  }
+  absl::flat_hash_map<const HloInstruction*, absl::flat_hash_set<int64_t>>
+      live_times;
+  for (size_t t = 0; t < liveness_set.size(); ++t) {
+    for (const HloValue* value : liveness_set[t]) {
+      live_times[value->instruction()].insert(t);
+    }
+  }
+
+  std::vector<absl::flat_hash_set<int64_t>> ret(leaf_strategies.size());
+  for (size_t i = 0; i < leaf_strategies.size(); ++i) {
+    const HloInstruction* ins =
+        instructions[leaf_strategies[i]->instruction_id];
+    if (ins->shape().IsTuple() || ins->HasSideEffect() ||
+        ins->opcode() == HloOpcode::kParameter ||
+        ins->opcode() == HloOpcode::kGetTupleElement ||
+        ins->opcode() == HloOpcode::kRng ||
+        ins->opcode() == HloOpcode::kCustomCall ||
+        ins->opcode() == HloOpcode::kWhile ||
+        ins->opcode() == HloOpcode::kConditional ||
+        ins == ins->parent()->root_instruction()) {
+      continue;
+    }
+    auto ins_live_times = live_times.find(ins);
+    if (ins_live_times == live_times.end()) {
+      continue;
+    }
+
+    absl::flat_hash_set<int64_t> use_times;
+    for (const HloInstruction* user : ins->users()) {
+      auto iter = time_of.find(user);
+      if (iter != time_of.end()) {
+        use_times.insert(iter->second);
+      }
+    }
+
+    bool operands_live = true;
+    for (const HloInstruction* operand : ins->operands()) {
+      auto operand_live_times = live_times.find(operand);
+      if (operand_live_times == live_times.end()) {
+        operands_live = false;
+        break;
+      }
+      for (int64_t t : use_times) {
+        if (!operand_live_times->second.contains(t)) {
+          operands_live = false;
+          break;
+        }
+      }
+      if (!operands_live) {
+        break;
+      }
+    }
+    if (!operands_live) {
+      continue;
+    }
+
+    for (int64_t t : ins_live_times->second) {
+      if (t != leaf_strategies[i]->instruction_id && !use_times.contains(t)) {
+        ret[i].insert(t);
+      }
+    }
+  }
+  return ret;
+}
+
+}  // namespace
+
+// The ILP formulation is the same as the one in
+// alpa/shard_parallel/auto_sharding.py::_call_solver_serialized_args:
+//   min  sum_i s[i]^T * (c[i] + d[i]) + sum_{(i, j) in E} e[i, j]^T * r[i, j]
+//   s.t. s[i] is one-hot, e[i, j] is one-hot and aligned with s[i] and s[j],
+//        sum_{i in L[t]} s[i]^T * m[i] <= M for every t,
+//        s[i][p] + s[j][q] <= 1 for every alias pair (i, j) if v[p, q] == 1.
+// Nodes that follow other nodes share the variables of the followed node.
+//
+// With option.allow_recompute, a node i that can be rematerialized also
+// gets variables y[i] <= s[i]. y[i][k] == 1 means node i uses strategy k and
+// is recomputed, which costs the compute cost of strategy k plus
+// option.recompute_penalty, and removes m[i][k] from the memory constraints at
+// the time points where node i is live but not used. This lets the solver
+// trade memory for recompute instead of only for replication or
+// communication.
+StatusOr<AutoShardingSolution> CallNativeSolver(
+    const HloInstructionSequence& sequence, const LivenessSet& liveness_set,
+    const StrategyMap& strategy_map, const LeafStrategies& leaf_strategies,
+    const CostGraph& cost_graph, const AliasSet& alias_set,
+    const NativeSolverOption& option) {
+  absl::Time start_time = absl::Now();
+  const size_t N = leaf_strategies.size();
+  const std::vector<int>& s_follow = cost_graph.follow_idx;
+
+  MPSolver solver("auto_sharding", MPSolver::GLPK_MIXED_INTEGER_PROGRAMMING);
+  MPObjective* objective = solver.MutableObjective();
+  objective->SetMinimization();
+
+  // Create node variables. Following nodes reuse the variables of the node
+  // they follow.
+  std::vector<std::vector<MPVariable*>> s(N);
+  for (size_t i = 0; i < N; ++i) {
+    if (s_follow[i] < 0) {
+      solver.MakeBoolVarArray(cost_graph.node_lens[i], "", &s[i]);
+    }
+  }
+  for (size_t i = 0; i < N; ++i) {
+    if (s_follow[i] >= 0) {
+      s[i] = s[s_follow[i]];
+    }
+  }
+
+  // Node costs and one-hot constraints.
+  std::vector<std::vector<double>> m(N);
+  for (size_t i = 0; i < N; ++i) {
+    const StrategyVector* strategies = leaf_strategies[i];
+    std::vector<int> indices = GetStrategyIndices(cost_graph, i);
+    CHECK_EQ(indices.size(), s[i].size());
+    m[i].reserve(indices.size());
+    for (size_t k = 0; k < indices.size(); ++k) {
+      const ShardingStrategy& stra = strategies->leaf_vector[indices[k]];
+      double cost = stra.compute_cost + stra.communication_cost +
+                    cost_graph.extra_node_costs[i][indices[k]];
+      objective->SetCoefficient(
+          s[i][k], objective->GetCoefficient(s[i][k]) + cost);
+      m[i].push_back(stra.memory_cost);
+    }
+  }
+
+  for (size_t i = 0; i < N; ++i) {
+    if (s_follow[i] >= 0) {
+      continue;
+    }
+    MPConstraint* constraint = solver.MakeRowConstraint(1.0, 1.0);
+    bool all_infinity = true;
+    for (MPVariable* var : s[i]) {
+      constraint->SetCoefficient(var, 1.0);
+      // Do not choose strategies with infinity costs, as they make the
+      // objective so large that other choices do not matter anymore.
+      if (objective->GetCoefficient(var) >= INFINITY_COST) {
+        var->SetUB(0.0);
+      } else {
+        all_infinity = false;
+      }
+    }
+    if (all_infinity) {
+      LOG(WARNING) << "All strategies of node " << i
+                   << " have infinity costs.";
+      for (MPVariable* var : s[i]) {
+        var->SetUB(1.0);
+      }
+    }
+  }
+
+  // Edge variables and costs. If one side of an edge has only one strategy,
+  // the edge cost is linear in the other side and no edge variable is needed.
+  size_t num_edge_vars = 0;
+  for (const auto& iter : cost_graph.edge_costs) {
+    int src = iter.first.first;
+    int dst = iter.first.second;
+    const Matrix& edge_cost = iter.second;
+    CHECK_EQ(edge_cost.n, s[src].size());
+    CHECK_EQ(edge_cost.m, s[dst].size());
+
+    if (edge_cost.n == 1 || edge_cost.m == 1) {
+      for (size_t p = 0; p < edge_cost.n; ++p) {
+        for (size_t q = 0; q < edge_cost.m; ++q) {
+          MPVariable* var = edge_cost.n == 1 ? s[dst][q] : s[src][p];
+          objective->SetCoefficient(
+              var, objective->GetCoefficient(var) + edge_cost(p, q));
+        }
+      }
+      continue;
+    }
+
+    std::vector<MPVariable*> e;
+    solver.MakeBoolVarArray(edge_cost.n * edge_cost.m, "", &e);
+    num_edge_vars += e.size();
+    MPConstraint* one_hot = solver.MakeRowConstraint(1.0, 1.0);
+    for (size_t p = 0; p < edge_cost.n; ++p) {
+      for (size_t q = 0; q < edge_cost.m; ++q) {
+        MPVariable* var = e[p * edge_cost.m + q];
+        double cost = edge_cost(p, q);
+        one_hot->SetCoefficient(var, 1.0);
+        objective->SetCoefficient(var, cost);
+        if (cost >= INFINITY_COST) {
+          var->SetUB(0.0);
+        }
+      }
+    }
+    // e[src, dst](p, *) <= s[src](p)
+    for (size_t p = 0; p < edge_cost.n; ++p) {
+      MPConstraint* constraint =
+          solver.MakeRowConstraint(-MPSolver::infinity(), 0.0);
+      constraint->SetCoefficient(s[src][p], -1.0);
+      for (size_t q = 0; q < edge_cost.m; ++q) {
+        constraint->SetCoefficient(e[p * edge_cost.m + q], 1.0);
+      }
+    }
+    // e[src, dst](*, q) <= s[dst](q)
+    for (size_t q = 0; q < edge_cost.m; ++q) {
+      MPConstraint* constraint =
+          solver.MakeRowConstraint(-MPSolver::infinity(), 0.0);
+      constraint->SetCoefficient(s[dst][q], -1.0);
+      for (size_t p = 0; p < edge_cost.n; ++p) {
+        constraint->SetCoefficient(e[p * edge_cost.m + q], 1.0);
+      }
+    }
+  }
+
+  // Memory constraints.
+  std::vector<std::vector<MPVariable*>> y(N);
+  if (option.memory_budget_per_device > 0) {
+    std::vector<std::vector<int>> L = BuildLivenessNodeIndices(
+        sequence, liveness_set, strategy_map, leaf_strategies);
+
+    // Recompute variables.
+    std::vector<absl::flat_hash_set<int64_t>> recomputable_live_times;
+    if (option.allow_recompute) {
+      recomputable_live_times =
+          GetRecomputableLiveTimes(sequence, liveness_set, leaf_strategies);
+      for (size_t i = 0; i < N; ++i) {
+        if (recomputable_live_times[i].empty()) {
+          continue;
+        }
+        const StrategyVector* strategies = leaf_strategies[i];
+        std::vector<int> indices = GetStrategyIndices(cost_graph, i);
+        solver.MakeBoolVarArray(s[i].size(), "", &y[i]);
+        for (size_t k = 0; k < s[i].size(); ++k) {
+          double cost = strategies->leaf_vector[indices[k]].compute_cost;
+          if (cost >= INFINITY_COST) {
+            y[i][k]->SetUB(0.0);
+            continue;
+          }
+          objective->SetCoefficient(y[i][k], cost + option.recompute_penalty);
+          // y[i][k] <= s[i][k]
+          MPConstraint* constraint =
+              solver.MakeRowConstraint(-MPSolver::infinity(), 0.0);
+          constraint->SetCoefficient(y[i][k], 1.0);
+          constraint->SetCoefficient(s[i][k], -1.0);
+        }
+      }
+    }
+
+    for (size_t t = 0; t < N; ++t) {
+      if (L[t].empty()) {
+        continue;
+      }
+      const int64_t time = leaf_strategies[t]->instruction_id;
+      MPConstraint* constraint = solver.MakeRowConstraint(
+          -MPSolver::infinity(), option.memory_budget_per_device);
+      for (int i : L[t]) {
+        for (size_t k = 0; k < s[i].size(); ++k) {
+          constraint->SetCoefficient(
+              s[i][k], constraint->GetCoefficient(s[i][k]) + m[i][k]);
+        }
+        if (!y[i].empty() && recomputable_live_times[i].contains(time)) {
+          for (size_t k = 0; k < y[i].size(); ++k) {
+            constraint->SetCoefficient(
+                y[i][k], constraint->GetCoefficient(y[i][k]) - m[i][k]);
+          }
+        }
+      }
+    }
+  }
+
+  // Alias constraints: aliased nodes must have the same sharding spec.
+  for (const auto& pair : alias_set) {
+    const StrategyVector* src_strategies = leaf_strategies[pair.first];
+    const StrategyVector* dst_strategies = leaf_strategies[pair.second];
+    std::vector<int> row_indices = GetStrategyIndices(cost_graph, pair.first);
+    std::vector<int> col_indices = GetStrategyIndices(cost_graph, pair.second);
+    const std::vector<MPVariable*>& s_a = s[pair.first];
+    const std::vector<MPVariable*>& s_b = s[pair.second];
+
+    bool compatible = false;
+    for (size_t p = 0; p < row_indices.size(); ++p) {
+      for (size_t q = 0; q < col_indices.size(); ++q) {
+        if (src_strategies->leaf_vector[row_indices[p]].output_sharding ==
+            dst_strategies->leaf_vector[col_indices[q]].output_sharding) {
+          compatible = true;
+          continue;
+        }
+        if (s_a[p] == s_b[q]) {
+          // Both nodes follow the same node. The combination is impossible.
+          s_a[p]->SetUB(0.0);
+          continue;
+        }
+        MPConstraint* constraint =
+            solver.MakeRowConstraint(-MPSolver::infinity(), 1.0);
+        constraint->SetCoefficient(s_a[p], 1.0);
+        constraint->SetCoefficient(s_b[q], 1.0);
+      }
+    }
+    if (!compatible) {
+      return InternalError("Incompatible alias pairs: (%d, %d)",
+                           src_strategies->instruction_id,
+                           dst_strategies->instruction_id);
+    }
+  }
+
+  // Warm start
+  bool valid_hint = option.hint.size() == N;
+  for (size_t i = 0; valid_hint && i < N; ++i) {
+    valid_hint = option.hint[i] >= 0 &&
+                 static_cast<size_t>(option.hint[i]) < s[i].size();
+  }
+  if (valid_hint) {
+    std::vector<std::pair<const MPVariable*, double>> hint;
+    for (size_t i = 0; i < N; ++i) {
+      if (s_follow[i] >= 0) {
+        continue;
+      }
+      for (size_t k = 0; k < s[i].size(); ++k) {
+        hint.push_back(
+            {s[i][k], static_cast<int64_t>(k) == option.hint[i] ? 1.0 : 0.0});
+      }
+    }
+    solver.SetHint(std::move(hint));
+  } else if (!option.hint.empty()) {
+    VLOG(1) << "Native ILP solver: ignore the hint that does not fit the "
+            << "strategy space.";
+  }
+
+  VLOG(1) << "Native ILP solver: nodes " << N << ", edge variables "
+          << num_edge_vars << ", variables " << solver.NumVariables()
+          << ", constraints " << solver.NumConstraints();
+
+  // Solve
+  if (option.time_limit_seconds > 0) {
+    solver.set_time_limit(
+        static_cast<int64_t>(option.time_limit_seconds * 1000));
+  }
+  MPSolverParameters params;
+  params.SetDoubleParam(MPSolverParameters::RELATIVE_MIP_GAP,
+                        option.relative_mip_gap);
+  MPSolver::ResultStatus status = solver.Solve(params);
+  if (status != MPSolver::OPTIMAL && status != MPSolver::FEASIBLE) {
+    return InternalError(
+        "The native auto-sharding solver could not find any feasible "
+        "solution (status: %d).",
+        static_cast<int>(status));
+  }
+
+  AutoShardingSolution solution;
+  solution.objective = objective->Value();
+  if (status == MPSolver::OPTIMAL && option.relative_mip_gap <= 0) {
+    solution.optimality_gap = 0.0;
+  } else {
+    solution.optimality_gap =
+        std::abs(solution.objective - objective->BestBound()) /
+        std::max(std::abs(solution.objective), 1e-9);
+  }
+
+  solution.s_val.assign(N, -1);
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t k = 0; k < s[i].size(); ++k) {
+      if (s[i][k]->solution_value() > 0.5) {
+        solution.s_val[i] = k;
+        break;
+      }
+    }
+    CHECK_GE(solution.s_val[i], 0);
+    if (!y[i].empty() && y[i][solution.s_val[i]]->solution_value() > 0.5) {
+      solution.recomputed_nodes.push_back(i);
+    }
+  }
+  solution.e_val.reserve(cost_graph.edge_costs.size());
+  for (const auto& iter : cost_graph.edge_costs) {
+    solution.e_val.push_back(solution.s_val[iter.first.first] *
+                                 iter.second.m +
+                             solution.s_val[iter.first.second]);
+  }
+
+  if (solution.objective >= INFINITY_COST) {
+    LOG(WARNING) << "The objective (" << solution.objective
+                 << ") is larger than INFINITY_COST. The solver chose a "
+                 << "strategy with infinity cost.";
+  }
+  VLOG(1) << "Native ILP solver: status " << status << ", objective "
+          << solution.objective << ", gap " << solution.optimality_gap
+          << ", time " << absl::ToDoubleSeconds(absl::Now() - start_time)
+          << " s";
+
+  return solution;
+}
+
+StatusOr<AutoShardingSolution> CallPythonSolver(
+    const AutoShardingSolverInput& input, const NativeSolverOption& option) {
+  const LeafStrategies& leaf_strategies = *input.leaf_strategies;
+  const CostGraph& cost_graph = *input.cost_graph;
+  // Serialize edges and edge costs to 1d numpy arrays
+  int64_t N = leaf_strategies.size();
+  int64_t M = option.memory_budget_per_device;
+  std::vector<int> s_len_np = cost_graph.node_lens;
+  const std::vector<int>& s_follow_np = cost_graph.follow_idx;
+  std::vector<int> E_np;
+  // The edge cost arena is already laid out in the iteration order of
+  // edge_costs after CostGraph::Simplify, so it is passed as is.
+  const std::vector<double>& r_np = *cost_graph.edge_cost_arena;
+  size_t r_offset = 0;
+  for (const auto& iter : cost_graph.edge_costs) {
+    int src = iter.first.first;
+    int dst = iter.first.second;
+    const Matrix& edge_cost = iter.second;
+
+    E_np.push_back(src);
+    E_np.push_back(dst);
+
+    CHECK_EQ(edge_cost.n, s_len_np[src]);
+    CHECK_EQ(edge_cost.m, s_len_np[dst]);
+    CHECK(!edge_cost.transpose);
+    CHECK_EQ(edge_cost.offset, r_offset);
+    r_offset += edge_cost.n * edge_cost.m;
+  }
+  CHECK_EQ(r_offset, r_np.size());
+
+  // Serialize node costs
+  std::vector<double> c_np, d_np, m_np;
+  for (size_t i = 0; i < N; ++i) {
+    const StrategyVector* strategies = leaf_strategies[i];
+    if (s_follow_np[i] < 0) {
+      for (size_t j = 0; j < strategies->leaf_vector.size(); ++j) {
+        c_np.push_back(strategies->leaf_vector[j].compute_cost);
+        d_np.push_back(strategies->leaf_vector[j].communication_cost +
+                       cost_graph.extra_node_costs[i][j]);
+        m_np.push_back(strategies->leaf_vector[j].memory_cost);
+      }
+    } else {
+      std::vector<int> reindexing = cost_graph.reindexing_vector.at(i);
+      s_len_np[i] = reindexing.size();
+      for (size_t k = 0; k < reindexing.size(); ++k) {
+        size_t j = reindexing[k];
+        c_np.push_back(strategies->leaf_vector[j].compute_cost);
+        d_np.push_back(strategies->leaf_vector[j].communication_cost +
+                       cost_graph.extra_node_costs[i][j]);
+        m_np.push_back(strategies->leaf_vector[j].memory_cost);
+      }
+    }
+  }
+
+  // Serialize special edges that forces a alias pair have the same sharding
+  // spec
+  std::vector<int> A_np;
+  std::vector<double> v_np;
+  for (const auto& pair : *input.alias_set) {
+    const StrategyVector* src_strategies = leaf_strategies[pair.first];
+    const StrategyVector* dst_strategies = leaf_strategies[pair.second];
+
+    Matrix raw_cost(src_strategies->leaf_vector.size(),
+                    dst_strategies->leaf_vector.size());
+    bool compatible = false;
+    for (size_t i = 0; i < src_strategies->leaf_vector.size(); ++i) {
+      for (size_t j = 0; j < dst_strategies->leaf_vector.size(); ++j) {
+        if (src_strategies->leaf_vector[i].output_sharding ==
+            dst_strategies->leaf_vector[j].output_sharding) {
+          compatible = true;
+          raw_cost(i, j) = 0.0;
+        } else {
+          raw_cost(i, j) = 1.0;
+        }
+      }
+    }
+    CHECK(compatible) << "Incompatible alias pairs: "
+                      << "(" << src_strategies->instruction_id << ", "
+                      << dst_strategies->instruction_id << ")";
+
+    int idx_a = pair.first;
+    int idx_b = pair.second;
+    std::vector<int> row_indices;
+    std::vector<int> col_indices;
+
+    if (s_follow_np[idx_a] >= 0) {
+      row_indices = cost_graph.reindexing_vector.at(idx_a);
+      idx_a = s_follow_np[idx_a];
+    } else {
+      row_indices.assign(s_len_np[idx_a], 0);
+      std::iota(row_indices.begin(), row_indices.end(), 0);
+    }
+
+    if (s_follow_np[idx_b] >= 0) {
+      col_indices = cost_graph.reindexing_vector.at(idx_b);
+      idx_b = s_follow_np[idx_b];
+    } else {
+      col_indices.assign(s_len_np[idx_b], 0);
+      std::iota(col_indices.begin(), col_indices.end(), 0);
+    }
+
+    CHECK_EQ(s_len_np[idx_a], row_indices.size());
+    CHECK_EQ(s_len_np[idx_b], col_indices.size());
+
+    A_np.push_back(idx_a);
+    A_np.push_back(idx_b);
+    for (int i : row_indices) {
+      for (int j : col_indices) {
+        v_np.push_back(raw_cost(i, j));
+      }
+    }
+  }
+
+  // Serialize liveness_set
+  std::vector<std::vector<int>> liveness_set_indices =
+      BuildLivenessNodeIndices(*input.sequence, *input.liveness_set,
+                               *input.strategy_map, leaf_strategies);
+  std::vector<int> L_np;
+  for (const auto& indices : liveness_set_indices) {
+    L_np.push_back(indices.size());
+  }
+  for (const auto& indices : liveness_set_indices) {
+    L_np.insert(L_np.end(), indices.begin(), indices.end());
+  }
+
+  // Call the solver function in python
+  size_t num_edges = E_np.size() / 2;
+  AutoShardingSolution solution;
+  // PuLP only reports optimal solutions.
+  solution.optimality_gap = 0.0;
+
+  PyGILState_STATE gstate = PyGILState_Ensure();
+  {
+    py::object submodule =
+        py::module_::import("alpa.shard_parallel.auto_sharding");
+    py::object call_solver_serialized_args =
+        submodule.attr("call_solver_serialized_args");
+    py::object ret = call_solver_serialized_args(
+        N, M,
+        py::array(s_len_np.size(), s_len_np.data()),  // TODO: avoid this copy
+        py::array(s_follow_np.size(), s_follow_np.data()),
+        py::array(E_np.size(), E_np.data()),
+        py::array(A_np.size(), A_np.data()),
+        py::array(L_np.size(), L_np.data()),
+        py::array(c_np.size(), c_np.data()),
+        py::array(d_np.size(), d_np.data()),
+        py::array(m_np.size(), m_np.data()),
+        py::array(r_np.size(), r_np.data()),
+        py::array(v_np.size(), v_np.data()));
+    if (ret.is_none()) {
+      PyGILState_Release(gstate);
+      return InternalError("The python auto-sharding solver failed.");
+    }
+    py::tuple tuple_ret = ret;
+
+    py::object s_val_obj = tuple_ret[0], e_val_obj = tuple_ret[1];
+    solution.objective = py::cast<double>(tuple_ret[2]);
+    py::array_t<int> s_val_array = s_val_obj, e_val_array = e_val_obj;
+    auto s_val_unckecked = s_val_array.unchecked<1>();
+    auto e_val_unckecked = e_val_array.unchecked<1>();
+    for (size_t i = 0; i < N; ++i) {
+      solution.s_val.push_back(s_val_unckecked(i));
+    }
+    for (size_t i = 0; i < num_edges; ++i) {
+      solution.e_val.push_back(e_val_unckecked(i));
+    }
+  }
+  PyGILState_Release(gstate);
+
+  return solution;
+}
+
+
+StatusOr<AutoShardingSolution> CallGreedySolver(
+    const AutoShardingSolverInput& input, const NativeSolverOption& option) {
+  absl::Time start_time = absl::Now();
+  const LeafStrategies& leaf_strategies = *input.leaf_strategies;
+  const CostGraph& cost_graph = *input.cost_graph;
+  const std::vector<int>& s_follow = cost_graph.follow_idx;
+  const size_t N = leaf_strategies.size();
+  auto root_of = [&](int node) {
+    return s_follow[node] >= 0 ? s_follow[node] : node;
+  };
+
+  // The node costs of every variable, including the nodes that follow it,
+  // and the memory costs of every node in the strategy space of its variable.
+  std::vector<std::vector<double>> node_costs(N);
+  std::vector<std::vector<double>> node_memory(N);
+  for (size_t i = 0; i < N; ++i) {
+    if (s_follow[i] < 0) {
+      node_costs[i].assign(cost_graph.node_lens[i], 0.0);
+    }
+  }
+  for (size_t i = 0; i < N; ++i) {
+    std::vector<int> indices = GetStrategyIndices(cost_graph, i);
+    std::vector<double>& costs = node_costs[root_of(i)];
+    CHECK_EQ(indices.size(), costs.size());
+    for (size_t k = 0; k < indices.size(); ++k) {
+      const ShardingStrategy& stra =
+          leaf_strategies[i]->leaf_vector[indices[k]];
+      costs[k] += stra.compute_cost + stra.communication_cost +
+                  cost_graph.extra_node_costs[i][indices[k]];
+      node_memory[i].push_back(stra.memory_cost);
+    }
+  }
+
+  // Edges between variables. Alias pairs become edges that charge
+  // INFINITY_COST for mismatched output shardings.
+  struct Edge {
+    int src;
+    int dst;
+    size_t m;
+    const Matrix* cost;
+    std::vector<double> alias_cost;
+
+    double operator()(size_t p, size_t q) const {
+      return cost != nullptr ? (*cost)(p, q) : alias_cost[p * m + q];
+    }
+  };
+  std::vector<Edge> edges;
+  for (const auto& iter : cost_graph.edge_costs) {
+    edges.push_back(Edge{root_of(iter.first.first),
+                         root_of(iter.first.second), iter.second.m,
+                         &iter.second, {}});
+  }
+  const size_t num_cost_graph_edges = edges.size();
+  for (const auto& pair : *input.alias_set) {
+    std::vector<int> rows = GetStrategyIndices(cost_graph, pair.first);
+    std::vector<int> cols = GetStrategyIndices(cost_graph, pair.second);
+    const auto& src_vector = leaf_strategies[pair.first]->leaf_vector;
+    const auto& dst_vector = leaf_strategies[pair.second]->leaf_vector;
+    Edge edge{root_of(pair.first), root_of(pair.second), cols.size(), nullptr,
+              std::vector<double>(rows.size() * cols.size(), 0.0)};
+    for (size_t p = 0; p < rows.size(); ++p) {
+      for (size_t q = 0; q < cols.size(); ++q) {
+        if (!(src_vector[rows[p]].output_sharding ==
+              dst_vector[cols[q]].output_sharding)) {
+          edge.alias_cost[p * cols.size() + q] = INFINITY_COST;
+        }
+      }
+    }
+    edges.push_back(std::move(edge));
+  }
+  std::vector<std::vector<int>> edges_of(N);
+  for (size_t e = 0; e < edges.size(); ++e) {
+    edges_of[edges[e].src].push_back(e);
+    if (edges[e].dst != edges[e].src) {
+      edges_of[edges[e].dst].push_back(e);
+    }
+  }
+
+  // The cost of choosing strategy k for variable r given the strategies of
+  // its neighbors. Neighbors with a negative strategy are not assigned yet.
+  std::vector<int64_t> s_val(N, -1);
+  auto local_cost = [&](int r, int64_t k) {
+    double cost = node_costs[r][k];
+    for (int e : edges_of[r]) {
+      const Edge& edge = edges[e];
+      int64_t p = edge.src == r ? k : s_val[edge.src];
+      int64_t q = edge.dst == r ? k : s_val[edge.dst];
+      if (p >= 0 && q >= 0) {
+        cost += edge(p, q);
+      }
+    }
+    return cost;
+  };
+  auto best_strategy = [&](int r) {
+    int64_t best = 0;
+    double best_cost = std::numeric_limits<double>::infinity();
+    for (size_t k = 0; k < node_costs[r].size(); ++k) {
+      double cost = local_cost(r, k);
+      if (cost < best_cost) {
+        best = k;
+        best_cost = cost;
+      }
+    }
+    return best;
+  };
+
+  // Assign the variables in the order of the linearized graph, each given
+  // its already assigned neighbors, then move one variable at a time to its
+  // cheapest strategy given all its neighbors until no choice changes.
+  for (size_t i = 0; i < N; ++i) {
+    if (s_follow[i] < 0) {
+      s_val[i] = best_strategy(i);
+    }
+  }
+  constexpr int kMaxRounds = 16;
+  for (int round = 0; round < kMaxRounds; ++round) {
+    bool changed = false;
+    for (size_t i = 0; i < N; ++i) {
+      if (s_follow[i] >= 0) {
+        continue;
+      }
+      int64_t best = best_strategy(i);
+      if (best != s_val[i]) {
+        s_val[i] = best;
+        changed = true;
+      }
+    }
+    if (!changed) {
+      break;
+    }
+  }
+
+  // Repair the memory budget. While the peak memory exceeds the budget,
+  // change the variable that frees the most memory at the peak per unit of
+  // extra cost.
+  if (option.memory_budget_per_device >= 0) {
+    const double budget = option.memory_budget_per_device;
+    std::vector<std::vector<int>> L =
+        BuildLivenessNodeIndices(*input.sequence, *input.liveness_set,
+                                 *input.strategy_map, leaf_strategies);
+    std::vector<double> memory(L.size(), 0.0);
+    std::vector<std::vector<std::pair<int64_t, int>>> live_times_of(N);
+    for (size_t t = 0; t < L.size(); ++t) {
+      for (int i : L[t]) {
+        memory[t] += node_memory[i][s_val[root_of(i)]];
+        live_times_of[root_of(i)].push_back({t, i});
+      }
+    }
+
+    const size_t max_steps = 4 * N + 16;
+    size_t step = 0;
+    for (; step < max_steps && !memory.empty(); ++step) {
+      size_t peak = std::max_element(memory.begin(), memory.end()) -
+                    memory.begin();
+      if (memory[peak] <= budget) {
+        break;
+      }
+      int best_r = -1;
+      int64_t best_k = -1;
+      double best_ratio = std::numeric_limits<double>::infinity();
+      absl::flat_hash_set<int> candidates;
+      for (int i : L[peak]) {
+        candidates.insert(root_of(i));
+      }
+      for (int r : candidates) {
+        double current_cost = local_cost(r, s_val[r]);
+        for (size_t k = 0; k < node_costs[r].size(); ++k) {
+          if (static_cast<int64_t>(k) == s_val[r]) {
+            continue;
+          }
+          double saved = 0.0;
+          for (int i : L[peak]) {
+            if (root_of(i) == r) {
+              saved += node_memory[i][s_val[r]] - node_memory[i][k];
+            }
+          }
+          double extra_cost = local_cost(r, k) - current_cost;
+          if (saved <= 0 || extra_cost >= INFINITY_COST) {
+            continue;
+          }
+          double ratio = std::max(extra_cost, 0.0) / saved;
+          if (ratio < best_ratio) {
+            best_r = r;
+            best_k = k;
+            best_ratio = ratio;
+          }
+        }
+      }
+      if (best_r < 0) {
+        return ResourceExhausted(
+            "The greedy auto-sharding solver cannot fit the memory budget "
+            "%f at time %d, which needs %f.",
+            budget, peak, memory[peak]);
+      }
+      for (const auto& [t, i] : live_times_of[best_r]) {
+        memory[t] += node_memory[i][best_k] - node_memory[i][s_val[best_r]];
+      }
+      s_val[best_r] = best_k;
+    }
+    if (step == max_steps) {
+      return ResourceExhausted(
+          "The greedy auto-sharding solver did not fit the memory budget %f "
+          "within %d steps.",
+          budget, max_steps);
+    }
+  }
+
+  AutoShardingSolution solution;
+  solution.objective = 0.0;
+  solution.optimality_gap = -1.0;
+  for (size_t i = 0; i < N; ++i) {
+    if (s_follow[i] < 0) {
+      solution.objective += node_costs[i][s_val[i]];
+    }
+  }
+  solution.s_val.resize(N);
+  for (size_t i = 0; i < N; ++i) {
+    solution.s_val[i] = s_val[root_of(i)];
+  }
+  solution.e_val.reserve(num_cost_graph_edges);
+  for (size_t e = 0; e < num_cost_graph_edges; ++e) {
+    const Edge& edge = edges[e];
+    solution.objective += edge(s_val[edge.src], s_val[edge.dst]);
+    solution.e_val.push_back(s_val[edge.src] * edge.m + s_val[edge.dst]);
+  }
+  VLOG(1) << "Greedy auto-sharding solver: objective " << solution.objective
+          << ", time " << absl::ToDoubleSeconds(absl::Now() - start_time)
+          << " s";
+  return solution;
+}
+
+namespace {
+
+class NativeAutoShardingSolver : public AutoShardingSolver {
+ public:
+  absl::string_view name() const override { return "native"; }
+
+  StatusOr<AutoShardingSolution> Solve(
+      const AutoShardingSolverInput& input,
+      const NativeSolverOption& option) override {
+    return CallNativeSolver(*input.sequence, *input.liveness_set,
+                            *input.strategy_map, *input.leaf_strategies,
+                            *input.cost_graph, *input.alias_set, option);
+  }
+};
+
+class PythonAutoShardingSolver : public AutoShardingSolver {
+ public:
+  absl::string_view name() const override { return "python"; }
+
+  StatusOr<AutoShardingSolution> Solve(
+      const AutoShardingSolverInput& input,
+      const NativeSolverOption& option) override {
+    return CallPythonSolver(input, option);
+  }
+};
+
+class GreedyAutoShardingSolver : public AutoShardingSolver {
+ public:
+  absl::string_view name() const override { return "greedy"; }
+
+  StatusOr<AutoShardingSolution> Solve(
+      const AutoShardingSolverInput& input,
+      const NativeSolverOption& option) override {
+    return CallGreedySolver(input, option);
+  }
+};
+
+}  // namespace
+
+StatusOr<std::unique_ptr<AutoShardingSolver>> CreateAutoShardingSolver(
+    absl::string_view backend) {
+  if (backend == "native") {
+    return std::unique_ptr<AutoShardingSolver>(
+        std::make_unique<NativeAutoShardingSolver>());
+  }
+  if (backend == "python") {
+    return std::unique_ptr<AutoShardingSolver>(
+        std::make_unique<PythonAutoShardingSolver>());
+  }
+  if (backend == "greedy") {
+    return std::unique_ptr<AutoShardingSolver>(
+        std::make_unique<GreedyAutoShardingSolver>());
+  }
+  return InvalidArgument("Unknown auto-sharding solver backend: %s", backend);
+}
+
+}  // namespace spmd
+}  // namespace xla
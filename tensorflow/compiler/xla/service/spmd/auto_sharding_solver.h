@@ -0,0 +1,111 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_SOLVER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_SOLVER_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_strategy.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace xla {
+namespace spmd {
+
+// Options for the auto-sharding solvers. The python and greedy solvers only
+// honor `memory_budget_per_device`.
+struct NativeSolverOption {
+  // The memory budget per device in bytes. -1 means no memory constraint.
+  int64_t memory_budget_per_device = -1;
+  // Stop the search after this many seconds and return the best solution
+  // found so far. A non-positive value means no time limit.
+  double time_limit_seconds = -1;
+  // Stop the search once the relative gap between the incumbent and the best
+  // bound drops below this value.
+  double relative_mip_gap = 0.0;
+  // If true, every activation that is live across a memory constraint
+  // without being used there gets a second choice: free its memory and
+  // recompute it before its next use, for its compute cost plus
+  // `recompute_penalty`. This only has an effect under a memory budget.
+  bool allow_recompute = false;
+  double recompute_penalty = 0.0;
+  // An optional solution vector to warm-start the search, e.g., the solution
+  // of the same problem under another memory budget. It is ignored if it
+  // does not fit the strategy space.
+  std::vector<int64_t> hint;
+};
+
+// The solution of the auto-sharding ILP problem.
+struct AutoShardingSolution {
+  // The chosen strategy index of every node.
+  std::vector<int64_t> s_val;
+  // The chosen strategy pair of every edge in `cost_graph.edge_costs`,
+  // in the iteration order of that map.
+  std::vector<int64_t> e_val;
+  // The nodes whose outputs are chosen to be rematerialized, in increasing
+  // order. Empty unless NativeSolverOption::allow_recompute is set.
+  std::vector<int> recomputed_nodes;
+  double objective;
+  // The relative gap between the objective and the best bound.
+  // 0 if the solution is proven to be optimal, negative if it is unknown.
+  double optimality_gap;
+};
+
+// The auto-sharding ILP problem. All members are borrowed from the caller.
+struct AutoShardingSolverInput {
+  const HloInstructionSequence* sequence;
+  const LivenessSet* liveness_set;
+  const StrategyMap* strategy_map;
+  const LeafStrategies* leaf_strategies;
+  const CostGraph* cost_graph;
+  const AliasSet* alias_set;
+};
+
+// A solver of the auto-sharding ILP problem. Strategy building and the cost
+// graph are shared by all solvers, so a new solver only needs to map the
+// problem to a solution.
+class AutoShardingSolver {
+ public:
+  virtual ~AutoShardingSolver() = default;
+
+  virtual absl::string_view name() const = 0;
+
+  virtual StatusOr<AutoShardingSolution> Solve(
+      const AutoShardingSolverInput& input,
+      const NativeSolverOption& option) = 0;
+};
+
+// Create the solver for `backend`, which is one of:
+//   "python": the PuLP solver in alpa, called through the GIL.
+//   "native": the in-process OR-tools ILP solver.
+//   "greedy": a fast heuristic without optimality guarantees.
+StatusOr<std::unique_ptr<AutoShardingSolver>> CreateAutoShardingSolver(
+    absl::string_view backend);
+
+// Formulate and solve the auto-sharding ILP problem in process with OR-tools.
+// Unlike the python solver, this reads the cost graph, the leaf strategies,
+// the liveness set and the alias set in place and does not need the GIL.
+StatusOr<AutoShardingSolution> CallNativeSolver(
+    const HloInstructionSequence& sequence, const LivenessSet& liveness_set,
+    const StrategyMap& strategy_map, const LeafStrategies& leaf_strategies,
+    const CostGraph& cost_graph, const AliasSet& alias_set,
+    const NativeSolverOption& option);
+
+// Serialize the ILP problem as numpy arrays and solve it with the python
+// solver in alpa/shard_parallel/auto_sharding.py.
+StatusOr<AutoShardingSolution> CallPythonSolver(
+    const AutoShardingSolverInput& input, const NativeSolverOption& option);
+
+// A heuristic solver that runs in roughly linear time in the size of the cost
+// graph. It assigns the nodes in sequence order, each to its cheapest strategy
+// given the nodes assigned before it, then improves the choice of one node at
+// a time given all its neighbors until no choice changes. Finally, while the
+// peak memory exceeds the budget, it changes the node at the peak that frees
+// the most memory per unit of extra cost. Mismatched alias pairs are charged
+// INFINITY_COST. Returns ResourceExhausted if the budget cannot be met.
+StatusOr<AutoShardingSolution> CallGreedySolver(
+    const AutoShardingSolverInput& input, const NativeSolverOption& option);
+
+}  // namespace spmd
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_SOLVER_H_
@@ -2,12 +2,16 @@
 #define TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_STRATEGY_H_
 
 #include <cmath>
+#include <numeric>
+#include <optional>
 #include <vector>
 
 #include "pybind11/pybind11.h"
 #include "tensorflow/compiler/xla/service/hlo_live_range.h"
 #include "tensorflow/compiler/xla/service/pass_context.h"
+#include "tensorflow/compiler/xla/service/spmd/auto_sharding_calibration.h"
 #include "tensorflow/compiler/xla/service/spmd/auto_sharding_util.h"
+#include "tensorflow/compiler/xla/service/spmd/collective_cost_model.h"
 
 namespace xla {
 namespace spmd {
@@ -17,6 +21,11 @@ namespace py = pybind11;
 // A constant to represent infinity cost.
 constexpr double INFINITY_COST = 1e13;
 
+// The default of auto_sharding::collective_matmul_threshold_mib. It is much
+// lower than the TPU default of the SPMD partitioner, because the GEMMs on
+// GPUs are fast enough to hide the collective-permutes of smaller operands.
+constexpr int64_t kDefaultCollectiveMatmulThresholdMib = 32;
+
 // Options for the auto-sharding solver.
 struct AutoShardingSolverOption {
   // Forcibly split the batch dimension and map it to a mesh dimension.
@@ -56,6 +65,14 @@ struct AutoShardingSolverOption {
   // reduce-scatter, even if it introduces more communication.
   bool reduce_scatter_aggressive_partition;
 
+  // If true, fully shard the optimizer update (ZeRO-3 style): the
+  // accumulated gradients are reduce-scattered, the optimizer update runs on
+  // 1/N shards of every parameter it applies to, and the updated weights stay
+  // sharded until they are all-gathered right before their first use in the
+  // next forward pass. This implies reduce_scatter_aggressive_partition and
+  // ignores reduce_scatter_grad_acc_friendly.
+  bool reduce_scatter_shard_weights;
+
   // If true, the batch matmul will always be parallelized on the batch dim in
   // 2d mesh case.
   bool batch_matmul_always_split_batch;
@@ -78,6 +95,73 @@ struct AutoShardingSolverOption {
   // If it is not empty, forcibly use simple heuristic strategies
   // instead of the ILP solver. This is used for ablation study.
   std::string force_simple_heuristic;
+
+  // The backend of the ILP solver. "python" calls the PuLP solver in alpa,
+  // "native" calls the in-process OR-tools solver and "greedy" a heuristic.
+  // See CreateAutoShardingSolver.
+  std::string solver_backend;
+  // The memory budget per device in bytes. -1 means no memory constraint.
+  int64_t memory_budget_per_device;
+  // The time limit and the relative optimality gap of the native solver.
+  double solver_time_limit_seconds;
+  double solver_relative_gap;
+  // Use the greedy solver instead of `solver_backend` if the ILP has more
+  // variables than this. -1 means never.
+  int64_t heuristic_solver_threshold;
+
+  // If true, detect repeated layers in the instruction sequence and let the
+  // corresponding instructions of all layers share one strategy, which cuts
+  // the ILP size by the number of layers. See FindRepeatedLayerInstructions.
+  bool tie_repeated_layers;
+
+  // If true, add a roofline estimate of the per-device compute time of every
+  // strategy to its compute cost. See auto_sharding_compute_cost.h.
+  bool use_roofline_compute_cost;
+  // The peak flops and the memory bandwidth (bytes/s) of one device.
+  double device_peak_flops;
+  double device_memory_bandwidth;
+  // Convert the roofline time in seconds to the unit of communication costs.
+  double compute_cost_scale;
+
+  // If true, only charge the part of communication costs that cannot be
+  // hidden behind independent compute. See auto_sharding_compute_cost.h.
+  bool overlap_communication;
+  // The number of instructions before and after an instruction in the
+  // sequence whose compute may overlap with its communication.
+  int overlap_window;
+  // The fraction of independent compute time that can hide communication.
+  double overlap_efficiency;
+
+  // If true, the SPMD partitioner decomposes all-gather + dot into windowed
+  // einsum loops (collective matmul) and the all-gathers of dot operands are
+  // charged as overlapped with the dot. See auto_sharding_compute_cost.h.
+  bool collective_matmul;
+  // The minimum size in MiB of a gathered dot operand for collective matmul.
+  int64_t collective_matmul_threshold_mib;
+
+  // If true, let the ILP choose to rematerialize an activation instead of
+  // keeping it live between its uses, at the price of its compute cost.
+  // This is only supported by the native solver backend and only matters
+  // under a memory budget.
+  bool allow_recompute_activations;
+  // An extra cost charged for every rematerialized activation.
+  double recompute_penalty;
+
+  // If true, allow resharding with an all-to-all inside one mesh dim of a
+  // multi-dimensional mesh, which moves that mesh dim from one tensor dim to
+  // another. This is how MoE layers switch between sharding tokens and
+  // sharding experts (expert parallelism).
+  bool allow_all_to_all_resharding;
+
+  // If true, add dot strategies that reduce-scatter the partial sums of a
+  // contracting-dim split onto an lhs space dim instead of all-reducing
+  // them. The ops that follow (e.g., layer norm and dropout) can then be
+  // sharded along the sequence (Megatron-style sequence parallelism).
+  bool allow_sequence_parallel;
+
+  // Correction factors for the communication and dot costs, fitted from a
+  // profiled run of a previous compilation. See auto_sharding_calibration.h.
+  CostCalibration cost_calibration;
 };
 
 // One sharding strategy
@@ -127,200 +211,18 @@ using AssociativeDotPairs =
 // The set of all alias pairs
 using AliasSet = absl::flat_hash_set<std::pair<int64_t, int64_t>>;
 
-// Store the profiling results of communication and computation.
-class ProfilingResult {
- public:
-  // Construct the class from the corresponding python object
-  // alpa/mesh_profiling.py::ProfilingResult.
-  ProfilingResult(py::object prof_result) {
-    if (!prof_result.is_none()) {
-      PyGILState_STATE gstate = PyGILState_Ensure();
-      {
-        PyDictToCppDict(
-            py::cast<py::dict>(prof_result.attr("all_reduce_cost_dict")),
-            all_reduce_cost_dict_);
-        PyDictToCppDict(
-            py::cast<py::dict>(prof_result.attr("all_gather_cost_dict")),
-            all_gather_cost_dict_);
-        PyDictToCppDict(
-            py::cast<py::dict>(prof_result.attr("reduce_scatter_cost_dict")),
-            reduce_scatter_cost_dict_);
-      }
-      PyGILState_Release(gstate);
-    }
-
-    if (all_reduce_cost_dict_.empty()) {
-      enabled_ = false;
-    } else {
-      enabled_ = true;
-    }
-  }
-
-  bool Enabled() const { return enabled_; }
-
-  double EstimateAllGatherCost(
-      const std::vector<std::vector<int>>& replica_groups, int64_t size,
-      const std::string& dtype) const {
-    if (all_gather_cost_dict_.empty()) {
-      // Use all-reduce to approximate all-gather.
-      return EstimateAllReduceCost(replica_groups, size, dtype) / 2;
-    }
-
-    return EstimateInternal(replica_groups, size, dtype,
-                            all_gather_cost_dict_) -
-           EstimateInternal(replica_groups, 0, dtype, all_gather_cost_dict_);
-  }
-
-  double EstimateAllReduceCost(
-      const std::vector<std::vector<int>>& replica_groups, int64_t size,
-      const std::string& dtype) const {
-    return EstimateInternal(replica_groups, size, dtype,
-                            all_reduce_cost_dict_) -
-           EstimateInternal(replica_groups, 0, dtype, all_reduce_cost_dict_);
-  }
-
-  double EstimateReduceScatterCost(
-      const std::vector<std::vector<int>>& replica_groups, int64_t size,
-      const std::string& dtype) const {
-    if (reduce_scatter_cost_dict_.empty()) {
-      // Use all-reduce to approximate reduce-scatter.
-      return EstimateAllReduceCost(replica_groups, size, dtype) / 2;
-    }
-
-    return EstimateInternal(replica_groups, size, dtype,
-                            reduce_scatter_cost_dict_) -
-           EstimateInternal(replica_groups, 0, dtype,
-                            reduce_scatter_cost_dict_);
-  }
-
-  double EstimateAllToAllCost(
-      const std::vector<std::vector<int>>& replica_groups, int64_t size,
-      const std::string& dtype) const {
-    // A penalty factor to make the theoretical cost match the
-    // empirical cost on v100 + nvlink.
-    int64_t num_devices = replica_groups.front().size();
-    double penalty_factor = double(num_devices) / 2.0;
-    // Use all-gather to approximate all-to-all.
-    return EstimateAllGatherCost(replica_groups, size / num_devices, dtype) *
-           penalty_factor;
-  }
-
-  std::string ToString() {
-    std::ostringstream os;
-    for (const auto& item : all_reduce_cost_dict_) {
-      os << item.first.first << " " << item.first.second << "\n";
-    }
-    return os.str();
-  }
-
- private:
-  // pair<group, dtype>
-  using Key = std::pair<std::string, std::string>;
-  // vector<pair<size, time>>
-  using Value = std::vector<std::pair<int64_t, double>>;
-
-  // Estimate the cost by linear interpolation between the two closest points.
-  double EstimateInternal(
-      const std::vector<std::vector<int>>& replica_groups, int64_t size,
-      const std::string& dtype,
-      const absl::flat_hash_map<Key, Value>& cost_dict) const {
-    Key key(Group2Str(replica_groups), dtype);
-    Value cost_list = cost_dict.at(key);
-
-    CHECK(!cost_list.empty());
-
-    size_t i;
-    if (size > cost_list.back().first) {
-      i = cost_list.size() - 2;
-    } else if (size < cost_list.front().first) {
-      i = 0;
-    } else {
-      for (i = 0; i < cost_list.size() - 1; ++i) {
-        if (cost_list[i].first <= size && size <= cost_list[i + 1].first) {
-          break;
-        }
-      }
-    }
-
-    int64_t left_size = cost_list[i].first;
-    double left_cost = cost_list[i].second;
-    int64_t right_size = cost_list[i + 1].first;
-    double right_cost = cost_list[i + 1].second;
-
-    return 1.0 * (size - left_size) / (right_size - left_size) *
-               (right_cost - left_cost) +
-           left_cost;
-  }
-
-  // Convert a python dict to c++ dict.
-  void PyDictToCppDict(py::dict py_dict,
-                       absl::flat_hash_map<Key, Value>& cpp_dict) {
-    // the type of py_dict: Dict[Tuple(group, dtype) -> List[Tuple(size, time)]]
-    for (auto item : py_dict) {
-      py::tuple tuple_key = py::cast<py::tuple>(item.first);
-      Key key(Group2Str(py::cast<py::tuple>(tuple_key[0])),
-              py::cast<std::string>(tuple_key[1]));
-
-      py::list list_val = py::cast<py::list>(item.second);
-      for (const auto x : list_val) {
-        py::tuple tuple_val = py::cast<py::tuple>(x);
-        cpp_dict[key].push_back(std::make_pair(py::cast<int64_t>(tuple_val[0]),
-                                               py::cast<double>(tuple_val[1])));
-      }
-    }
-  }
-
-  // Make a string key of a replica_groups.
-  std::string Group2Str(const py::tuple& replica_groups) const {
-    std::ostringstream os;
-    os << "(";
-    for (const auto& group : replica_groups) {
-      os << "(";
-      for (const auto& id : py::cast<py::tuple>(group)) {
-        os << py::cast<int64_t>(id) << ",";
-      }
-      os << "),";
-    }
-    os << ")";
-
-    return os.str();
-  }
-
-  // Make a string key of a replica_groups.
-  std::string Group2Str(
-      const std::vector<std::vector<int>>& replica_groups) const {
-    std::ostringstream os;
-
-    os << "(";
-    for (const auto& group : replica_groups) {
-      os << "(";
-      for (const auto& id : group) {
-        os << id << ",";
-      }
-      os << "),";
-    }
-    os << ")";
-
-    return os.str();
-  }
-
-  bool enabled_;
-  absl::flat_hash_map<Key, Value> all_reduce_cost_dict_;
-  absl::flat_hash_map<Key, Value> all_gather_cost_dict_;
-  absl::flat_hash_map<Key, Value> reduce_scatter_cost_dict_;
-};
-
 // The cluster has a multi-dimensional device mesh topology.
 // Each mesh dimension has its own latency and bandwidth.
 // We use alpha-beta model to model the communication cost.
 // If profiling result is provided, we always prefer to use
-// the real profiling result.
+// the real profiling result, and fall back to the alpha-beta model for
+// replica groups that are not profiled.
 class ClusterEnvironment {
  public:
   ClusterEnvironment(const Array<int64_t>& device_mesh,
                      const std::vector<double>& mesh_alpha,
                      const std::vector<double>& mesh_beta,
-                     const ProfilingResult& prof_result,
+                     const CollectiveCostModel& prof_result,
                      const AutoShardingSolverOption& solver_option)
       : device_mesh(device_mesh),
         mesh_alpha(mesh_alpha),
@@ -329,36 +231,44 @@ class ClusterEnvironment {
         total_devices(device_mesh.num_elements()),
         device_mesh_1d(device_mesh),
         solver_option(solver_option) {
+    // The mesh can have any number of dimensions (e.g., node x switch
+    // island x device). The alpha-beta model is specified per dimension.
+    CHECK_GE(device_mesh.num_dimensions(), 1);
+    CHECK_EQ(mesh_alpha.size(), device_mesh.num_dimensions());
+    CHECK_EQ(mesh_beta.size(), device_mesh.num_dimensions());
+
     // Build replica group for each dimension.
-    CHECK_EQ(device_mesh.num_dimensions(), 2);
-
-    // Replica groups when communicating across dim 0
-    std::vector<std::vector<int>> replica_groups;
-    for (size_t j = 0; j < device_mesh.dim(1); ++j) {
-      std::vector<int> group;
-      for (size_t i = 0; i < device_mesh.dim(0); ++i) {
-        group.push_back(device_mesh(i, j));
-      }
-      replica_groups.push_back(std::move(group));
-    }
-    cached_replica_groups.push_back(replica_groups);
-
-    // Replica groups when communicating across dim 1
-    replica_groups.clear();
-    for (size_t i = 0; i < device_mesh.dim(0); ++i) {
-      std::vector<int> group;
-      for (size_t j = 0; j < device_mesh.dim(1); ++j) {
-        group.push_back(device_mesh(i, j));
+    // The groups of mesh dim d are the devices that only differ in the index
+    // of dim d. They are ordered by the indices of the other dims.
+    for (int64_t d = 0; d < device_mesh.num_dimensions(); ++d) {
+      std::vector<std::vector<int>> replica_groups;
+      device_mesh.Each([&](absl::Span<const int64_t> indices, int64_t) {
+        if (indices[d] != 0) {
+          return;
+        }
+        std::vector<int64_t> member(indices.begin(), indices.end());
+        std::vector<int> group;
+        for (int64_t k = 0; k < device_mesh.dim(d); ++k) {
+          member[d] = k;
+          group.push_back(device_mesh(member));
+        }
+        replica_groups.push_back(std::move(group));
+      });
+      cached_replica_groups.push_back(std::move(replica_groups));
+
+      if (device_mesh.dim(d) > 1) {
+        non_zero_mesh_dims.push_back(d);
       }
-      replica_groups.push_back(std::move(group));
     }
-    cached_replica_groups.push_back(replica_groups);
 
-    if (device_mesh.dim(0) > 1) {
-      non_zero_mesh_dims.push_back(0);
-    }
-    if (device_mesh.dim(1) > 1) {
-      non_zero_mesh_dims.push_back(1);
+    // All ordered pairs of different mesh dims. For a 2d mesh, these are
+    // (0, 1) and (1, 0).
+    for (int64_t i = 0; i < device_mesh.num_dimensions(); ++i) {
+      for (int64_t j = 0; j < device_mesh.num_dimensions(); ++j) {
+        if (i != j) {
+          mesh_dim_pairs.push_back({i, j});
+        }
+      }
     }
 
     device_mesh_1d.Reshape({device_mesh.num_elements(), 1});
@@ -370,8 +280,11 @@ class ClusterEnvironment {
     }
 
     if (prof_result.Enabled()) {
-      return prof_result.EstimateAllGatherCost(cached_replica_groups[mesh_dim],
-                                               num_bytes / 4, "float32");
+      std::optional<double> cost = prof_result.EstimateAllGatherCost(
+          cached_replica_groups[mesh_dim], num_bytes / 4, PrimitiveType::F32);
+      if (cost.has_value()) {
+        return Calibrated(ProfiledOpKind::kAllGather, mesh_dim, *cost);
+      }
     }
 
     if (solver_option.force_batch_dim_to_mesh_dim == mesh_dim) {
@@ -381,10 +294,11 @@ class ClusterEnvironment {
     }
 
     int64_t num_devices = device_mesh.dim(mesh_dim);
-    return (round(mesh_alpha[mesh_dim] + mesh_beta[mesh_dim] *
-                                             (num_devices - 1) / num_devices *
-                                             num_bytes) +
-            0.1);
+    double cost = round(mesh_alpha[mesh_dim] +
+                        mesh_beta[mesh_dim] * (num_devices - 1) / num_devices *
+                            num_bytes) +
+                  0.1;
+    return Calibrated(ProfiledOpKind::kAllGather, mesh_dim, cost);
   }
 
   // TODO(lmzheng): distinguish dtype and reduce_op.
@@ -394,15 +308,19 @@ class ClusterEnvironment {
     }
 
     if (prof_result.Enabled()) {
-      return prof_result.EstimateAllReduceCost(cached_replica_groups[mesh_dim],
-                                               num_bytes / 4, "float32");
+      std::optional<double> cost = prof_result.EstimateAllReduceCost(
+          cached_replica_groups[mesh_dim], num_bytes / 4, PrimitiveType::F32);
+      if (cost.has_value()) {
+        return Calibrated(ProfiledOpKind::kAllReduce, mesh_dim, *cost);
+      }
     }
 
     int64_t num_devices = device_mesh.dim(mesh_dim);
-    return (round(mesh_alpha[mesh_dim] + mesh_beta[mesh_dim] * 2 *
-                                             (num_devices - 1) / num_devices *
-                                             num_bytes) +
-            0.01);
+    double cost = round(mesh_alpha[mesh_dim] + mesh_beta[mesh_dim] * 2 *
+                                                   (num_devices - 1) /
+                                                   num_devices * num_bytes) +
+                  0.01;
+    return Calibrated(ProfiledOpKind::kAllReduce, mesh_dim, cost);
   }
 
   double ReduceScatterCost(double num_bytes, int mesh_dim) const {
@@ -411,15 +329,19 @@ class ClusterEnvironment {
     }
 
     if (prof_result.Enabled()) {
-      return prof_result.EstimateReduceScatterCost(
-          cached_replica_groups[mesh_dim], num_bytes / 4, "float32");
+      std::optional<double> cost = prof_result.EstimateReduceScatterCost(
+          cached_replica_groups[mesh_dim], num_bytes / 4, PrimitiveType::F32);
+      if (cost.has_value()) {
+        return Calibrated(ProfiledOpKind::kReduceScatter, mesh_dim, *cost);
+      }
     }
 
     int64_t num_devices = device_mesh.dim(mesh_dim);
-    return (round(mesh_alpha[mesh_dim] + mesh_beta[mesh_dim] *
-                                             (num_devices - 1) / num_devices *
-                                             num_bytes) +
-            0.001);
+    double cost = round(mesh_alpha[mesh_dim] +
+                        mesh_beta[mesh_dim] * (num_devices - 1) / num_devices *
+                            num_bytes) +
+                  0.001;
+    return Calibrated(ProfiledOpKind::kReduceScatter, mesh_dim, cost);
   }
 
   double AllToAllCost(double num_bytes, int mesh_dim) const {
@@ -428,8 +350,11 @@ class ClusterEnvironment {
     }
 
     if (prof_result.Enabled()) {
-      return prof_result.EstimateAllToAllCost(cached_replica_groups[mesh_dim],
-                                              num_bytes / 4, "float32");
+      std::optional<double> cost = prof_result.EstimateAllToAllCost(
+          cached_replica_groups[mesh_dim], num_bytes / 4, PrimitiveType::F32);
+      if (cost.has_value()) {
+        return Calibrated(ProfiledOpKind::kAllToAll, mesh_dim, *cost);
+      }
     }
 
     if (solver_option.force_batch_dim_to_mesh_dim == mesh_dim) {
@@ -442,10 +367,11 @@ class ClusterEnvironment {
     // empirical cost on v100 + nvlink.
     int64_t num_devices = device_mesh.dim(mesh_dim);
     double penalty_factor = double(num_devices) / 2.0;
-    return (round(mesh_alpha[mesh_dim] +
-                  mesh_beta[mesh_dim] * (num_devices - 1) / num_devices /
-                      num_devices * num_bytes * penalty_factor) +
-            0.001);
+    double cost = round(mesh_alpha[mesh_dim] +
+                        mesh_beta[mesh_dim] * (num_devices - 1) / num_devices /
+                            num_devices * num_bytes * penalty_factor) +
+                  0.001;
+    return Calibrated(ProfiledOpKind::kAllToAll, mesh_dim, cost);
   }
 
   double DotCost(const Shape& lhs_shape, const Shape& rhs_shape,
@@ -458,7 +384,16 @@ class ClusterEnvironment {
     // align the scale of compute cost and communication cost. Here we just use
     // a simple heurstic to compute the compute cost with communication cost.
     double num_bytes = GetBytes(lhs_shape) + GetBytes(rhs_shape);
-    return AllReduceCost(num_bytes, 0) + AllReduceCost(num_bytes, 1);
+    return AllReduceCostAllMeshDims(num_bytes);
+  }
+
+  // The cost of all-reducing along every mesh dim one after another.
+  double AllReduceCostAllMeshDims(double num_bytes) const {
+    double cost = 0;
+    for (int64_t i = 0; i < device_mesh.num_dimensions(); ++i) {
+      cost += AllReduceCost(num_bytes, i);
+    }
+    return cost;
   }
 
   // Get the corresponding mesh dimension for every tensor dimension.
@@ -508,7 +443,7 @@ class ClusterEnvironment {
         continue;
       }
       if (src_mesh_dim == -1) {
-        slice_dims.push_back(src_mesh_dim);
+        slice_dims.push_back(dst_mesh_dim);
         continue;
       }
       if (dst_mesh_dim == -1) {
@@ -531,8 +466,18 @@ class ClusterEnvironment {
 
     // Case 2: all-to-all
     if (slice_dims.size() == 1 && all_gather_dims.size() == 1) {
-      if (device_mesh.dim(0) > 1 && device_mesh.dim(1) > 1) {
-        return INFINITY_COST;
+      if (non_zero_mesh_dims.size() > 1) {
+        // The all-to-all runs inside the groups of one mesh dim, so the
+        // tensor dim that is sliced must take over the mesh dim of the one
+        // that is gathered.
+        int mesh_dim = all_gather_dims.front();
+        if (!solver_option.allow_all_to_all_resharding ||
+            slice_dims.front() != mesh_dim) {
+          return INFINITY_COST;
+        }
+        double bytes =
+            GetBytes(shape) * device_mesh.dim(mesh_dim) / src_spec.NumTiles();
+        return AllToAllCost(bytes, mesh_dim);
       }
 
       double bytes = GetBytes(shape);
@@ -674,8 +619,11 @@ class ClusterEnvironment {
   const Array<int64_t> device_mesh;
   const std::vector<double> mesh_alpha;
   const std::vector<double> mesh_beta;
-  const ProfilingResult& prof_result;
+  const CollectiveCostModel& prof_result;
   std::vector<int> non_zero_mesh_dims;
+  // All ordered pairs of different mesh dims. Strategies that split two
+  // tensor dims are enumerated over these pairs.
+  std::vector<std::pair<int64_t, int64_t>> mesh_dim_pairs;
   const int total_devices;
 
   // Cache a flatten 1d version of the device mesh.
@@ -689,6 +637,11 @@ class ClusterEnvironment {
   std::vector<std::vector<std::vector<int>>> cached_replica_groups;
 
  private:
+  // Apply the calibration factor of an operation kind on a mesh dim.
+  double Calibrated(ProfiledOpKind kind, int mesh_dim, double cost) const {
+    return cost * solver_option.cost_calibration.Factor(kind, mesh_dim);
+  }
+
   void AdjustTensorMeshDimMapping(std::vector<int>& mapping, int n_dim) const {
     // Shift the non-zero dim for 1d mesh
     if (n_dim == 1 && non_zero_mesh_dims.size() == 1) {
@@ -703,10 +656,15 @@ class ClusterEnvironment {
 
 // A graph data structure to simplify the edge cost graph.
 // It merges nodes and does path compression.
+// All edge cost matrices are views of one flat arena, so building and merging
+// edges does not allocate a buffer per edge. After Simplify(), the arena holds
+// exactly the matrices of the remaining edges, row-major, in the iteration
+// order of `edge_costs`, so a solver can consume it without copies.
 class CostGraph {
  public:
   CostGraph(const LeafStrategies& leaf_strategies,
-            const AssociativeDotPairs& associative_dot_pairs) {
+            const AssociativeDotPairs& associative_dot_pairs)
+      : edge_cost_arena(std::make_shared<std::vector<double>>()) {
     node_lens.reserve(leaf_strategies.size());
     extra_node_costs.reserve(leaf_strategies.size());
     adjacency.assign(leaf_strategies.size(), absl::flat_hash_set<int>());
@@ -721,7 +679,8 @@ class CostGraph {
         size_t src_idx = strategies->in_nodes[i]->id;
         size_t dst_idx = strategies->id;
 
-        Matrix edge_cost(node_lens[src_idx], node_lens[dst_idx]);
+        // Accumulate the resharding costs directly in the arena.
+        Matrix edge_cost = GetOrCreateEdgeCost(src_idx, dst_idx);
         for (size_t k = 0; k < strategies->leaf_vector.size(); ++k) {
           const ShardingStrategy& stra = strategies->leaf_vector[k];
 
@@ -729,11 +688,9 @@ class CostGraph {
           CHECK_EQ(stra.resharding_costs.size(), strategies->in_nodes.size());
 
           for (size_t j = 0; j < stra.resharding_costs[i].size(); ++j) {
-            edge_cost(j, k) = stra.resharding_costs[i][j];
+            edge_cost(j, k) += stra.resharding_costs[i][j];
           }
         }
-
-        AddEdgeCost(src_idx, dst_idx, edge_cost);
       }
 
       if (strategies->following) {
@@ -751,43 +708,58 @@ class CostGraph {
         continue;
       }
 
-      Matrix edge_cost(node_lens[src_idx], node_lens[dst_idx]);
+      Matrix edge_cost = GetOrCreateEdgeCost(src_idx, dst_idx);
       for (size_t i = 0; i < node_lens[src_idx]; ++i) {
         if (leaf_strategies[src_idx]->leaf_vector[i].communication_cost > 0) {
           CHECK_FLOAT_EQ(
               leaf_strategies[src_idx]->leaf_vector[i].communication_cost,
               leaf_strategies[dst_idx]->leaf_vector[i].communication_cost);
-          edge_cost(i, i) =
-              -leaf_strategies[src_idx]->leaf_vector[i].communication_cost;
+          edge_cost(i, i) -=
+              leaf_strategies[src_idx]->leaf_vector[i].communication_cost;
         }
       }
-      AddEdgeCost(src_idx, dst_idx, edge_cost);
     }
   }
 
-  Matrix GetEdgeCost(int i, int j) {
+  Matrix GetEdgeCost(int i, int j) const {
     if (i <= j) {
-      return edge_costs[{i, j}];
+      return edge_costs.at({i, j});
     } else {
-      return edge_costs[{j, i}].Transpose();
+      return edge_costs.at({j, i}).Transpose();
     }
   }
 
-  void AddEdgeCost(int i, int j, Matrix& cost) {
+  // Return a view of the cost matrix of edge (i, j), whose rows are the
+  // strategies of i. A zero matrix is allocated in the arena if the edge
+  // does not exist.
+  Matrix GetOrCreateEdgeCost(int i, int j) {
+    bool transposed = false;
     if (i > j) {
       std::swap(i, j);
-      cost = cost.Transpose();
+      transposed = true;
     }
 
-    if (edge_costs.count({i, j})) {
-      CHECK(adjacency[i].count(j));
-      CHECK(adjacency[j].count(i));
-      edge_costs[{i, j}] = edge_costs[{i, j}] + cost;
-    } else {
+    auto iter = edge_costs.find({i, j});
+    if (iter == edge_costs.end()) {
+      CHECK(!adjacency[i].count(j));
       adjacency[i].insert(j);
       adjacency[j].insert(i);
-      edge_costs[{i, j}] = cost;
+      size_t offset = edge_cost_arena->size();
+      edge_cost_arena->resize(offset + node_lens[i] * node_lens[j], 0.0);
+      iter = edge_costs
+                 .insert({{i, j},
+                          Matrix(node_lens[i], node_lens[j], false,
+                                 edge_cost_arena, offset)})
+                 .first;
+    } else {
+      CHECK(adjacency[i].count(j));
+      CHECK(adjacency[j].count(i));
     }
+    return transposed ? iter->second.Transpose() : iter->second;
+  }
+
+  void AddEdgeCost(int i, int j, const Matrix& cost) {
+    GetOrCreateEdgeCost(i, j).AddInPlace(cost);
   }
 
   void RemoveEdge(int i, int j) {
@@ -846,6 +818,17 @@ class CostGraph {
         reindexing[i] = arange.front();
       }
     }
+    MergeNodeWithReindexing(src, dst, reindexing);
+  }
+
+  // Make `src` share the strategy of `dst`, where the i-th strategy of `src`
+  // follows the `reindexing[i]`-th strategy of `dst`, and move the edges of
+  // `src` to `dst`.
+  void MergeNodeWithReindexing(int src, int dst,
+                               const std::vector<int>& reindexing) {
+    CHECK(!merged_to_.count(src));
+    CHECK(!merged_to_.count(dst));
+    CHECK_NE(src, dst);
     merged_to_[src] = dst;
     reindexing_vector[src] = reindexing;
 
@@ -853,20 +836,19 @@ class CostGraph {
     std::vector<int> adj_list(adjacency[src].begin(), adjacency[src].end());
     for (int adj : adj_list) {
       if (adj == dst) {
+        Matrix edge_cost = GetEdgeCost(dst, src);
         for (int i = 0; i < node_lens[dst]; ++i) {
           extra_node_costs[dst][i] += edge_cost(i, reindexing[i]);
         }
       } else {
-        Matrix added_edge_cost(node_lens[dst], node_lens[adj]);
+        Matrix added_edge_cost = GetOrCreateEdgeCost(dst, adj);
         Matrix edge_cost_src_adj = GetEdgeCost(src, adj);
 
         for (int i = 0; i < node_lens[dst]; ++i) {
           for (int k = 0; k < node_lens[adj]; ++k) {
-            added_edge_cost(i, k) = edge_cost_src_adj(reindexing[i], k);
+            added_edge_cost(i, k) += edge_cost_src_adj(reindexing[i], k);
           }
         }
-
-        AddEdgeCost(dst, adj, added_edge_cost);
       }
     }
 
@@ -897,6 +879,12 @@ class CostGraph {
     }
   }
 
+  // Make node `src` choose the same strategy as node `dst` in Simplify. The
+  // two nodes must have the same strategies in the same order, e.g., because
+  // they are the same instruction in two identical layers. Unlike following,
+  // the nodes do not need to be adjacent.
+  void AddTiePair(int src, int dst) { to_tie_pairs_.push_back({src, dst}); }
+
   void Simplify() {
     const bool enable =
         pass_context::GetBool("auto_sharding::simplify_graph", true);
@@ -911,6 +899,25 @@ class CostGraph {
       }
     }
 
+    // Tie nodes. A pair is skipped if its nodes already share a strategy or
+    // the nodes they follow have different strategies.
+    int num_tied = 0;
+    for (const auto& pair : to_tie_pairs_) {
+      int src = QueryDestination(pair.first);
+      int dst = QueryDestination(pair.second);
+      if (src == dst || node_lens[src] != node_lens[dst]) {
+        continue;
+      }
+      std::vector<int> reindexing(node_lens[dst]);
+      std::iota(reindexing.begin(), reindexing.end(), 0);
+      MergeNodeWithReindexing(src, dst, reindexing);
+      ++num_tied;
+    }
+    if (!to_tie_pairs_.empty()) {
+      VLOG(1) << "Tied " << num_tied << " of " << to_tie_pairs_.size()
+              << " node pairs of repeated layers.";
+    }
+
     // Build follow map
     follow_idx.reserve(node_lens.size());
     for (int i = 0; i < node_lens.size(); ++i) {
@@ -920,6 +927,30 @@ class CostGraph {
         follow_idx.push_back(-1);
       }
     }
+
+    CompactEdgeCosts();
+  }
+
+  // Drop the arena regions of removed edges and lay out the remaining
+  // matrices contiguously in the iteration order of `edge_costs`.
+  void CompactEdgeCosts() {
+    size_t total_size = 0;
+    for (const auto& iter : edge_costs) {
+      total_size += iter.second.n * iter.second.m;
+    }
+
+    auto new_arena = std::make_shared<std::vector<double>>();
+    new_arena->reserve(total_size);
+    for (auto& iter : edge_costs) {
+      Matrix& edge_cost = iter.second;
+      CHECK(!edge_cost.transpose);
+      size_t offset = new_arena->size();
+      auto begin = edge_cost.data->begin() + edge_cost.offset;
+      new_arena->insert(new_arena->end(), begin,
+                        begin + edge_cost.n * edge_cost.m);
+      edge_cost = Matrix(edge_cost.n, edge_cost.m, false, new_arena, offset);
+    }
+    edge_cost_arena = std::move(new_arena);
   }
 
   int RemapIndex(int node_id, int value) const {
@@ -951,8 +982,10 @@ class CostGraph {
   std::vector<int> node_lens;
   // The adjacency list of each node.
   std::vector<absl::flat_hash_set<int>> adjacency;
-  // The cost matrix between two nodes.
+  // The cost matrix between two nodes. The key (i, j) always has i < j.
   absl::flat_hash_map<std::pair<int, int>, Matrix> edge_costs;
+  // The flat buffer that backs all matrices in `edge_costs`.
+  std::shared_ptr<std::vector<double>> edge_cost_arena;
   // The extra node costs introduced by merging nodes.
   std::vector<std::vector<double>> extra_node_costs;
   // The reindexing vector of the node.
@@ -967,6 +1000,8 @@ class CostGraph {
   absl::flat_hash_map<int, int> merged_to_;
   // Save pairs that need to be merged.
   std::vector<std::pair<int, int>> to_merge_pairs_;
+  // Save pairs that need to be tied.
+  std::vector<std::pair<int, int>> to_tie_pairs_;
 };
 
 // Get the final sharding strategy according to the ilp solution.
@@ -1030,6 +1065,10 @@ Status HandleConv(std::unique_ptr<StrategyVector>& strategies,
                   const InstructionBatchDimMap& batch_map,
                   const AutoShardingSolverOption& solver_option);
 
+std::vector<std::vector<int>> BuildLivenessNodeIndices(
+    const HloInstructionSequence& sequence, const LivenessSet& liveness_set,
+    const StrategyMap& strategy_map, const LeafStrategies& leaf_strategies);
+
 void GenerateReduceScatter(const HloInstructionSequence& sequence,
                            const AliasMap& alias_map,
                            const InstructionDepthMap& depth_map,
@@ -1,10 +1,19 @@
 #include "tensorflow/compiler/xla/service/spmd/auto_sharding_util.h"
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+
 #include "tensorflow/compiler/xla/primitive_util.h"
 #include "tensorflow/compiler/xla/service/hlo_creation_utils.h"
 #include "tensorflow/compiler/xla/service/hlo_sharding_util.h"
 #include "tensorflow/compiler/xla/service/spmd/auto_sharding_strategy.h"
 #include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/tsl/platform/fingerprint.h"
 
 namespace xla {
 namespace spmd {
@@ -971,12 +980,35 @@ Status FilterStrategy(const HloInstruction* ins,
   return Status::OK();
 }
 
-inline std::pair<int, int> ParseMeshDims(const std::string& strategy_name) {
-  if (strategy_name.find("{0,1}") != std::string::npos) {
-    return {0, 1};
-  } else {
-    return {1, 0};
+// Parse the integers in the first "<prefix>...<close>" group of a strategy
+// name, e.g., "SR = SS x SR @ {0,2} (allreduce @ 2)" -> {0, 2} for "@ {".
+// Return an empty vector if there is no such group.
+inline std::vector<int64_t> ParseIntGroup(const std::string& strategy_name,
+                                          absl::string_view prefix,
+                                          char close) {
+  size_t begin = strategy_name.find(prefix);
+  if (begin == std::string::npos) {
+    return {};
+  }
+  begin += prefix.size();
+  size_t end = strategy_name.find(close, begin);
+  CHECK_NE(end, std::string::npos) << strategy_name;
+
+  std::vector<int64_t> ret;
+  for (absl::string_view token : absl::StrSplit(
+           absl::string_view(strategy_name).substr(begin, end - begin), ',')) {
+    int64_t value;
+    CHECK(absl::SimpleAtoi(absl::StripAsciiWhitespace(token), &value))
+        << strategy_name;
+    ret.push_back(value);
   }
+  return ret;
+}
+
+inline std::pair<int, int> ParseMeshDims(const std::string& strategy_name) {
+  std::vector<int64_t> mesh_dims = ParseIntGroup(strategy_name, "@ {", '}');
+  CHECK_EQ(mesh_dims.size(), 2) << strategy_name;
+  return {mesh_dims[0], mesh_dims[1]};
 }
 
 // Return whether the tensor shape is divisible by
@@ -1036,7 +1068,9 @@ HloSharding GetReduceScatterOutput(const HloInstruction* ins,
       return Tile(ins->shape(), {0, space_base_dim}, {mesh_dim0, mesh_dim1},
                   device_mesh);
     } else if (StrStartsWith(strategy.name, "RR = RS x SR")) {
-      int mesh_dim = strategy.name.find("{0}") != std::string::npos ? 0 : 1;
+      std::vector<int64_t> mesh_dims = ParseIntGroup(strategy.name, "@ {", '}');
+      CHECK_EQ(mesh_dims.size(), 1) << strategy.name;
+      int mesh_dim = mesh_dims.front();
 
       if (!IsDivisible(ins, device_mesh, {space_base_dim}, {mesh_dim})) {
         return Undefined();
@@ -1083,12 +1117,9 @@ HloSharding GetReduceScatterOutput(const HloInstruction* ins,
     // TODO(lmzheng): support more cases.
     CHECK_EQ(ins->shape().rank(), 1);
 
-    int mesh_dim;
-    if (strategy.name.find("allreduce @ [0]") != std::string::npos) {
-      mesh_dim = 0;
-    } else {
-      mesh_dim = 1;
-    }
+    std::vector<int64_t> all_reduce_dims =
+        ParseIntGroup(strategy.name, "allreduce @ [", ']');
+    int mesh_dim = all_reduce_dims.empty() ? 1 : all_reduce_dims.front();
 
     if (strategy.output_sharding.IsReplicated()) {
       if (strategy.name.find("1d") != std::string::npos) {
@@ -1494,8 +1525,14 @@ void GenerateReduceScatter(const HloInstructionSequence& sequence,
   // to generate all-reduce + all-gather instead of reduce-scatter + all-gather.
   // This simplification uses the same memory but incurs 50% communication
   // overhead.
+  // When the weights are fully sharded, the gradient buffers are partitioned
+  // as well, so the gradients are reduce-scattered in every micro batch.
   bool use_all_reduce_for_grad_acc =
-      solver_option.reduce_scatter_grad_acc_friendly;
+      solver_option.reduce_scatter_grad_acc_friendly &&
+      !solver_option.reduce_scatter_shard_weights;
+  bool aggressive_partition =
+      solver_option.reduce_scatter_aggressive_partition ||
+      solver_option.reduce_scatter_shard_weights;
   int verbose = 0;
 
   std::vector<HloInstruction*> insert_all_gather;
@@ -1615,9 +1652,11 @@ void GenerateReduceScatter(const HloInstructionSequence& sequence,
     }
 
     // If applicable, replace all-reduce with reduce-scatter by
-    // setting instructions' sharding.
+    // setting instructions' sharding. When the weights are fully sharded,
+    // the update of every parameter is partitioned, no matter how small it is.
     if (num_replicated_parameters >= 1 && need_all_gather.size() <= 1 &&
-        replicated_set.size() >= 5) {
+        (replicated_set.size() >= 5 ||
+         solver_option.reduce_scatter_shard_weights)) {
       HloSharding output_spec =
           GetReduceScatterOutput(inst, strategy, cluster_env);
       if (IsUndefined(output_spec)) {
@@ -1648,7 +1687,7 @@ void GenerateReduceScatter(const HloInstructionSequence& sequence,
         SetSharding(to_split, output_spec, inst);
       }
 
-      if (!solver_option.reduce_scatter_aggressive_partition) {
+      if (!aggressive_partition) {
         // The normal case
         for (HloInstruction* to_split : need_all_gather) {
           SetSharding(to_split, output_spec, inst);
@@ -1701,32 +1740,50 @@ void GenerateReduceScatter(const HloInstructionSequence& sequence,
 
             CHECK(!cur->users().empty());
 
-            // Find the first user
-            HloInstruction* first_user = nullptr;
-            int64_t min_depth = ((int64_t)1) << 50;
-            for (const auto& x : cur->users()) {
-              auto iter = depth_map.find(x);
-              if (iter == depth_map.end()) {
-                LOG(FATAL) << "ERROR: " << x->ToString() << std::endl;
+            // Find the users that read the all-gathered weight.
+            std::vector<HloInstruction*> gather_users;
+            if (solver_option.reduce_scatter_shard_weights) {
+              // All users outside of the partitioned update are in the
+              // forward pass. They share one all-gather, which the
+              // partitioner emits right before the first of them.
+              for (HloInstruction* x : cur->users()) {
+                if (!modified.count(x)) {
+                  gather_users.push_back(x);
+                }
               }
-              if (x->opcode() != HloOpcode::kConvolution &&
-                  x->opcode() != HloOpcode::kDot) {
-                // Only apply this aggressive optimization for dot and conv
-                continue;
+            } else {
+              // Find the first user
+              HloInstruction* first_user = nullptr;
+              int64_t min_depth = ((int64_t)1) << 50;
+              for (const auto& x : cur->users()) {
+                auto iter = depth_map.find(x);
+                if (iter == depth_map.end()) {
+                  LOG(FATAL) << "ERROR: " << x->ToString() << std::endl;
+                }
+                if (x->opcode() != HloOpcode::kConvolution &&
+                    x->opcode() != HloOpcode::kDot) {
+                  // Only apply this aggressive optimization for dot and conv
+                  continue;
+                }
+                if (iter->second < min_depth) {
+                  first_user = x;
+                  min_depth = iter->second;
+                }
               }
-              if (iter->second < min_depth) {
-                first_user = x;
-                min_depth = iter->second;
+              if (first_user != nullptr) {
+                gather_users.push_back(first_user);
               }
             }
 
-            if (first_user != nullptr) {
+            if (!gather_users.empty()) {
               // Insert an optimization barrier to prevent CSE of all-gather
               HloInstruction* barrier =
                   inst->parent()->AddInstruction(HloInstruction::CreateUnary(
                       cur->shape(), HloOpcode::kOptimizationBarrier, cur));
               SetSharding(barrier, output_spec, inst);
-              ReplaceOperand(first_user, cur, barrier);
+              for (HloInstruction* x : gather_users) {
+                ReplaceOperand(x, cur, barrier);
+              }
             }
           }
         }
@@ -2282,5 +2339,119 @@ StatusOr<bool> NormalizeDotDimension(HloModule* module) {
   return changed;
 }
 
+std::vector<std::pair<const HloInstruction*, const HloInstruction*>>
+FindRepeatedLayerInstructions(const HloInstructionSequence& sequence,
+                              int64_t min_layer_size) {
+  const std::vector<HloInstruction*>& instructions = sequence.instructions();
+  const int64_t n = instructions.size();
+  std::vector<std::pair<const HloInstruction*, const HloInstruction*>> ret;
+
+  // A structural signature of every instruction, which ignores names and
+  // parameter numbers.
+  const HloPrintOptions options = HloPrintOptions::Fingerprint();
+  absl::flat_hash_map<const HloInstruction*, int64_t> position;
+  std::vector<uint64_t> signature(n);
+  for (int64_t i = 0; i < n; ++i) {
+    const HloInstruction* ins = instructions[i];
+    position[ins] = i;
+    std::string text =
+        ins->opcode() == HloOpcode::kParameter
+            ? absl::StrCat("parameter ", ins->shape().ToString(true))
+            : absl::StrCat(
+                  HloOpcodeString(ins->opcode()), " ",
+                  ins->shape().ToString(true), " ",
+                  ins->OperandsToString(options), " ",
+                  absl::StrJoin(ins->ExtraAttributesToString(options), ","));
+    signature[i] = tsl::Fingerprint64(text);
+  }
+
+  // The candidate periods are the most common distances between consecutive
+  // occurrences of the same signature.
+  absl::flat_hash_map<uint64_t, int64_t> last_position;
+  absl::flat_hash_map<int64_t, int64_t> gap_counts;
+  for (int64_t i = 0; i < n; ++i) {
+    auto [iter, inserted] = last_position.insert({signature[i], i});
+    if (!inserted) {
+      int64_t gap = i - iter->second;
+      if (gap >= min_layer_size) {
+        gap_counts[gap]++;
+      }
+      iter->second = i;
+    }
+  }
+  std::vector<std::pair<int64_t, int64_t>> gaps(gap_counts.begin(),
+                                                gap_counts.end());
+  std::sort(gaps.begin(), gaps.end(), [](const auto& a, const auto& b) {
+    return a.second > b.second || (a.second == b.second && a.first < b.first);
+  });
+  constexpr size_t kNumCandidatePeriods = 4;
+  gaps.resize(std::min(gaps.size(), kNumCandidatePeriods));
+
+  // Pick the period with the longest run of repeated signatures. A run of
+  // (L - 1) * period instructions covers L layers.
+  int64_t best_period = 0, best_start = 0, best_length = 0;
+  for (const auto& [period, count] : gaps) {
+    int64_t start = 0;
+    for (int64_t i = 0; i + period < n; ++i) {
+      if (signature[i] != signature[i + period]) {
+        start = i + 1;
+      } else if (i + 1 - start > best_length) {
+        best_period = period;
+        best_start = start;
+        best_length = i + 1 - start;
+      }
+    }
+  }
+  if (best_length < best_period || best_period == 0) {
+    return ret;
+  }
+  VLOG(1) << "Found " << best_length / best_period + 1 << " repeated layers of "
+          << best_period << " instructions.";
+
+  // Pair the instructions of the run with the previous layer. An instruction
+  // is only paired if its operands are the corresponding operands of the
+  // previous layer, the same operands, or corresponding parameters.
+  absl::flat_hash_set<const HloInstruction*> paired;
+  for (int64_t i = best_start; i < best_start + best_length; ++i) {
+    const HloInstruction* earlier = instructions[i];
+    const HloInstruction* later = instructions[i + best_period];
+    if (earlier->operand_count() != later->operand_count()) {
+      continue;
+    }
+    std::vector<std::pair<const HloInstruction*, const HloInstruction*>>
+        parameter_pairs;
+    bool consistent = true;
+    for (int64_t k = 0; k < earlier->operand_count(); ++k) {
+      const HloInstruction* earlier_operand = earlier->operand(k);
+      const HloInstruction* later_operand = later->operand(k);
+      if (earlier_operand == later_operand ||
+          position.at(later_operand) ==
+              position.at(earlier_operand) + best_period) {
+        continue;
+      }
+      if (earlier_operand->opcode() == HloOpcode::kParameter &&
+          later_operand->opcode() == HloOpcode::kParameter &&
+          earlier_operand->shape() == later_operand->shape()) {
+        parameter_pairs.push_back({later_operand, earlier_operand});
+        continue;
+      }
+      consistent = false;
+      break;
+    }
+    if (!consistent) {
+      continue;
+    }
+    if (paired.insert(later).second) {
+      ret.push_back({later, earlier});
+    }
+    for (const auto& pair : parameter_pairs) {
+      if (paired.insert(pair.first).second) {
+        ret.push_back(pair);
+      }
+    }
+  }
+  return ret;
+}
+
 }  // namespace spmd
 }  // namespace xla
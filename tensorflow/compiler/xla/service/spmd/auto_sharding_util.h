@@ -2,6 +2,7 @@
 #define TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_AUTO_SHARDING_UTIL_H_
 
 #include <algorithm>
+#include <utility>
 #include <vector>
 
 #include "absl/types/span.h"
@@ -88,26 +89,30 @@ std::string ToString(const std::vector<T>& vector) {
 
 // A simple matrix class to store and manipulate the cost matrices on edges.
 // It can create a view for matrix transpose without copying the memory.
+// A matrix can also be a view of a region starting at `offset` in a larger
+// buffer, which allows many matrices to share one flat arena.
 class Matrix {
  public:
-  Matrix() : n(0), m(0), transpose(false), data(nullptr) {}
+  Matrix() : n(0), m(0), transpose(false), data(nullptr), offset(0) {}
 
   Matrix(size_t n, size_t m) {
     this->n = n;
     this->m = m;
     transpose = false;
     data = std::make_shared<std::vector<double>>(n * m, 0.0);
+    offset = 0;
   }
 
   Matrix(size_t n, size_t m, bool transpose,
-         std::shared_ptr<std::vector<double>> data) {
+         std::shared_ptr<std::vector<double>> data, size_t offset = 0) {
     this->n = n;
     this->m = m;
     this->transpose = transpose;
     this->data = data;
+    this->offset = offset;
   }
 
-  Matrix Transpose() { return Matrix(m, n, !transpose, data); }
+  Matrix Transpose() const { return Matrix(m, n, !transpose, data, offset); }
 
   double operator()(size_t i, size_t j) const {
     size_t idx;
@@ -118,7 +123,7 @@ class Matrix {
     }
     CHECK(data != nullptr) << n << " , " << m;
     CHECK(idx < n * m) << idx << " , " << n << " , " << m;
-    return (*data)[idx];
+    return (*data)[offset + idx];
   }
 
   double& operator()(size_t i, size_t j) {
@@ -130,7 +135,7 @@ class Matrix {
     }
     CHECK(data != nullptr) << n << " , " << m;
     CHECK(idx < n * m) << idx << " , " << n << " , " << m;
-    return (*data)[idx];
+    return (*data)[offset + idx];
   }
 
   Matrix operator+(const Matrix& other) {
@@ -145,6 +150,18 @@ class Matrix {
     return ret;
   }
 
+  // Add `other` to this matrix in place. This writes through to the
+  // underlying buffer, so all views of it see the change.
+  void AddInPlace(const Matrix& other) {
+    CHECK_EQ(n, other.n);
+    CHECK_EQ(m, other.m);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < m; ++j) {
+        operator()(i, j) += other(i, j);
+      }
+    }
+  }
+
   std::string ToString() const {
     std::ostringstream os;
 
@@ -162,6 +179,7 @@ class Matrix {
   size_t m;
   bool transpose;
   std::shared_ptr<std::vector<double>> data;
+  size_t offset;
 };
 
 // Return whether a string starts with another substring.
@@ -273,6 +291,16 @@ InstructionDepthMap BuildInstructionDepthMap(
 InstructionBatchDimMap BuildInstructionBatchDimMap(
     const HloInstructionSequence& sequence);
 
+// Find the structurally identical, consecutive layers in `sequence`, e.g., the
+// layers of a transformer, as the longest run of instructions that repeats
+// with a fixed period of at least `min_layer_size` instructions. Returns pairs
+// of an instruction and the corresponding instruction of the previous layer,
+// including the corresponding parameters, e.g., the weights of the layers.
+// Returns an empty vector if there are no repeated layers.
+std::vector<std::pair<const HloInstruction*, const HloInstruction*>>
+FindRepeatedLayerInstructions(const HloInstructionSequence& sequence,
+                              int64_t min_layer_size);
+
 // Remove all custom call makers in an HloModule.
 void RemoveCustomCallMarker(HloModule* module);
 
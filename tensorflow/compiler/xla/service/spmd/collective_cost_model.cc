@@ -0,0 +1,437 @@
+#include "tensorflow/compiler/xla/service/spmd/collective_cost_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "absl/algorithm/container.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/tsl/platform/env.h"
+
+namespace xla {
+namespace spmd {
+
+namespace py = pybind11;
+
+namespace {
+
+// Profiles only distinguish f16 and f32. Other types are costed as f32.
+PrimitiveType NormalizeDtype(PrimitiveType dtype) {
+  if (dtype != PrimitiveType::F16 && dtype != PrimitiveType::F32) {
+    return PrimitiveType::F32;
+  }
+  return dtype;
+}
+
+StatusOr<PrimitiveType> ParseDtype(absl::string_view name) {
+  // Python profiles use both the XLA and the numpy names.
+  if (name == "float16") {
+    return PrimitiveType::F16;
+  }
+  if (name == "float32") {
+    return PrimitiveType::F32;
+  }
+  TF_ASSIGN_OR_RETURN(PrimitiveType dtype,
+                      primitive_util::StringToPrimitiveType(name));
+  return NormalizeDtype(dtype);
+}
+
+std::vector<std::vector<int>> PyToGroups(py::handle obj) {
+  std::vector<std::vector<int>> replica_groups;
+  if (obj.is_none()) {
+    return replica_groups;
+  }
+  for (const auto& group : py::cast<py::tuple>(obj)) {
+    std::vector<int> ids;
+    for (const auto& id : py::cast<py::tuple>(group)) {
+      ids.push_back(py::cast<int>(id));
+    }
+    replica_groups.push_back(std::move(ids));
+  }
+  return replica_groups;
+}
+
+}  // namespace
+
+std::string ProfiledOpKindToString(ProfiledOpKind kind) {
+  switch (kind) {
+    case ProfiledOpKind::kAllReduce:
+      return "all-reduce";
+    case ProfiledOpKind::kAllGather:
+      return "all-gather";
+    case ProfiledOpKind::kReduceScatter:
+      return "reduce-scatter";
+    case ProfiledOpKind::kAllToAll:
+      return "all-to-all";
+    case ProfiledOpKind::kDot:
+      return "dot";
+    case ProfiledOpKind::kBroadcast:
+      return "broadcast";
+    case ProfiledOpKind::kSendRecv:
+      return "send-recv";
+  }
+  return "unknown";
+}
+
+StatusOr<ProfiledOpKind> StringToProfiledOpKind(absl::string_view name) {
+  for (ProfiledOpKind kind :
+       {ProfiledOpKind::kAllReduce, ProfiledOpKind::kAllGather,
+        ProfiledOpKind::kReduceScatter, ProfiledOpKind::kAllToAll,
+        ProfiledOpKind::kDot, ProfiledOpKind::kBroadcast,
+        ProfiledOpKind::kSendRecv}) {
+    if (name == ProfiledOpKindToString(kind)) {
+      return kind;
+    }
+  }
+  return InvalidArgument("Invalid profiled op kind: %s", name);
+}
+
+CollectiveCostModel CollectiveCostModel::FromPyObject(py::object prof_result) {
+  CollectiveCostModel model;
+  if (prof_result.is_none()) {
+    return model;
+  }
+
+  PyGILState_STATE gstate = PyGILState_Ensure();
+  {
+    // the type of each dict:
+    //   Dict[Tuple(group, dtype) -> List[Tuple(size, time)]]
+    auto add_dict = [&](const char* attr, ProfiledOpKind kind) {
+      if (!py::hasattr(prof_result, attr)) {
+        return;
+      }
+      for (auto item : py::cast<py::dict>(prof_result.attr(attr))) {
+        py::tuple tuple_key = py::cast<py::tuple>(item.first);
+        std::string dtype_str = py::cast<std::string>(tuple_key[1]);
+        StatusOr<PrimitiveType> dtype = ParseDtype(dtype_str);
+        CHECK(dtype.ok()) << "Invalid dtype: " << dtype_str;
+
+        std::vector<std::pair<int64_t, double>> points;
+        for (const auto x : py::cast<py::list>(item.second)) {
+          py::tuple tuple_val = py::cast<py::tuple>(x);
+          points.push_back(std::make_pair(py::cast<int64_t>(tuple_val[0]),
+                                          py::cast<double>(tuple_val[1])));
+        }
+        model.AddCurve(kind, GroupsToString(PyToGroups(tuple_key[0])), *dtype,
+                       "", std::move(points));
+      }
+    };
+    add_dict("all_reduce_cost_dict", ProfiledOpKind::kAllReduce);
+    add_dict("all_gather_cost_dict", ProfiledOpKind::kAllGather);
+    add_dict("reduce_scatter_cost_dict", ProfiledOpKind::kReduceScatter);
+    add_dict("all_to_all_cost_dict", ProfiledOpKind::kAllToAll);
+    add_dict("dot_cost_dict", ProfiledOpKind::kDot);
+  }
+  PyGILState_Release(gstate);
+
+  return model;
+}
+
+StatusOr<CollectiveCostModel> CollectiveCostModel::LoadFromFile(
+    const std::string& path) {
+  std::string contents;
+  TF_RETURN_IF_ERROR(
+      tsl::ReadFileToString(tsl::Env::Default(), path, &contents));
+  return FromFileContents(contents);
+}
+
+StatusOr<CollectiveCostModel> CollectiveCostModel::FromFileContents(
+    absl::string_view contents) {
+  CollectiveCostModel model;
+  int line_no = 0;
+  for (absl::string_view line : absl::StrSplit(contents, '\n')) {
+    line_no++;
+    line = absl::StripAsciiWhitespace(line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::vector<absl::string_view> tokens =
+        absl::StrSplit(line, absl::ByAnyChar(" \t"), absl::SkipEmpty());
+    if (tokens.size() < 5) {
+      return InvalidArgument("Line %d of the profile has too few fields: %s",
+                             line_no, line);
+    }
+    TF_ASSIGN_OR_RETURN(ProfiledOpKind kind, StringToProfiledOpKind(tokens[0]));
+    TF_ASSIGN_OR_RETURN(PrimitiveType dtype, ParseDtype(tokens[2]));
+    std::string algorithm(tokens[3] == "-" ? "" : tokens[3]);
+
+    std::vector<std::pair<int64_t, double>> points;
+    for (size_t i = 4; i < tokens.size(); ++i) {
+      std::pair<absl::string_view, absl::string_view> point =
+          absl::StrSplit(tokens[i], absl::MaxSplits(':', 1));
+      int64_t size;
+      double seconds;
+      if (!absl::SimpleAtoi(point.first, &size) ||
+          !absl::SimpleAtod(point.second, &seconds)) {
+        return InvalidArgument(
+            "Line %d of the profile has an invalid point: %s", line_no,
+            tokens[i]);
+      }
+      points.push_back(std::make_pair(size, seconds));
+    }
+    model.AddCurve(kind, std::string(tokens[1]), dtype, algorithm,
+                   std::move(points));
+  }
+  return model;
+}
+
+std::string CollectiveCostModel::ToFileContents() const {
+  std::vector<std::string> lines;
+  for (const auto& item : curves_) {
+    for (const auto& curve : item.second) {
+      std::vector<std::string> points;
+      for (const auto& point : curve.second) {
+        points.push_back(
+            absl::StrFormat("%d:%.17g", point.first, point.second));
+      }
+      lines.push_back(absl::StrCat(
+          ProfiledOpKindToString(std::get<0>(item.first)), " ",
+          std::get<1>(item.first), " ",
+          primitive_util::LowercasePrimitiveTypeName(std::get<2>(item.first)),
+          " ", curve.first.empty() ? "-" : curve.first, " ",
+          absl::StrJoin(points, " ")));
+    }
+  }
+  // Sort the lines so that the same profile is always serialized the same.
+  absl::c_sort(lines);
+  return absl::StrCat(absl::StrJoin(lines, "\n"), "\n");
+}
+
+Status CollectiveCostModel::SaveToFile(const std::string& path) const {
+  return tsl::WriteStringToFile(tsl::Env::Default(), path, ToFileContents());
+}
+
+void CollectiveCostModel::AddCurve(
+    ProfiledOpKind kind, const std::string& replica_groups, PrimitiveType dtype,
+    const std::string& algorithm,
+    std::vector<std::pair<int64_t, double>> points) {
+  CHECK(!points.empty());
+  absl::c_sort(points);
+  curves_[Key(kind, replica_groups, NormalizeDtype(dtype))][algorithm] =
+      std::move(points);
+}
+
+const CollectiveCostModel::Curves* CollectiveCostModel::FindCurves(
+    ProfiledOpKind kind, const std::vector<std::vector<int>>& replica_groups,
+    PrimitiveType dtype) const {
+  dtype = NormalizeDtype(dtype);
+  auto iter = curves_.find(Key(kind, GroupsToString(replica_groups), dtype));
+  if (iter == curves_.end()) {
+    iter = curves_.find(Key(kind, GroupsToShapeString(replica_groups), dtype));
+  }
+  if (iter == curves_.end()) {
+    return nullptr;
+  }
+  return &iter->second;
+}
+
+double CollectiveCostModel::Interpolate(const Curve& curve, double size) {
+  CHECK(!curve.empty());
+  if (curve.size() == 1 || size <= curve.front().first) {
+    return curve.front().second;
+  }
+
+  size_t i;
+  if (size >= curve.back().first) {
+    i = curve.size() - 2;
+  } else {
+    for (i = 0; i < curve.size() - 2; ++i) {
+      if (size <= curve[i + 1].first) {
+        break;
+      }
+    }
+  }
+
+  double left_size = curve[i].first;
+  double left_cost = curve[i].second;
+  double right_size = curve[i + 1].first;
+  double right_cost = curve[i + 1].second;
+  if (right_size <= left_size) {
+    return right_cost;
+  }
+
+  if (left_size > 0 && left_cost > 0 && right_cost > 0) {
+    double t = (std::log(size) - std::log(left_size)) /
+               (std::log(right_size) - std::log(left_size));
+    return std::exp(std::log(left_cost) +
+                    t * (std::log(right_cost) - std::log(left_cost)));
+  }
+  // Fall back to linear interpolation when a point is not positive.
+  return (size - left_size) / (right_size - left_size) *
+             (right_cost - left_cost) +
+         left_cost;
+}
+
+std::optional<double> CollectiveCostModel::Estimate(
+    ProfiledOpKind kind, const std::vector<std::vector<int>>& replica_groups,
+    double size, PrimitiveType dtype, const std::string& algorithm) const {
+  const Curves* curves = FindCurves(kind, replica_groups, dtype);
+  if (curves == nullptr) {
+    return std::nullopt;
+  }
+
+  if (!algorithm.empty()) {
+    auto iter = curves->find(algorithm);
+    if (iter == curves->end()) {
+      return std::nullopt;
+    }
+    return Interpolate(iter->second, size);
+  }
+
+  std::optional<double> best;
+  for (const auto& item : *curves) {
+    double cost = Interpolate(item.second, size);
+    if (!best.has_value() || cost < *best) {
+      best = cost;
+    }
+  }
+  return best;
+}
+
+std::optional<double> CollectiveCostModel::EstimateAboveOverhead(
+    ProfiledOpKind kind, const std::vector<std::vector<int>>& replica_groups,
+    double size, PrimitiveType dtype) const {
+  std::optional<double> cost = Estimate(kind, replica_groups, size, dtype);
+  if (!cost.has_value()) {
+    return std::nullopt;
+  }
+  return *cost - *Estimate(kind, replica_groups, 0, dtype);
+}
+
+std::optional<double> CollectiveCostModel::EstimateAllReduceCost(
+    const std::vector<std::vector<int>>& replica_groups, double size,
+    PrimitiveType dtype) const {
+  return EstimateAboveOverhead(ProfiledOpKind::kAllReduce, replica_groups,
+                               size, dtype);
+}
+
+std::optional<double> CollectiveCostModel::EstimateAllGatherCost(
+    const std::vector<std::vector<int>>& replica_groups, double size,
+    PrimitiveType dtype) const {
+  std::optional<double> cost = EstimateAboveOverhead(
+      ProfiledOpKind::kAllGather, replica_groups, size, dtype);
+  if (cost.has_value()) {
+    return cost;
+  }
+  // Use all-reduce to approximate all-gather.
+  cost = EstimateAllReduceCost(replica_groups, size, dtype);
+  if (cost.has_value()) {
+    return *cost / 2;
+  }
+  return std::nullopt;
+}
+
+std::optional<double> CollectiveCostModel::EstimateReduceScatterCost(
+    const std::vector<std::vector<int>>& replica_groups, double size,
+    PrimitiveType dtype) const {
+  std::optional<double> cost = EstimateAboveOverhead(
+      ProfiledOpKind::kReduceScatter, replica_groups, size, dtype);
+  if (cost.has_value()) {
+    return cost;
+  }
+  // Use all-reduce to approximate reduce-scatter.
+  cost = EstimateAllReduceCost(replica_groups, size, dtype);
+  if (cost.has_value()) {
+    return *cost / 2;
+  }
+  return std::nullopt;
+}
+
+std::optional<double> CollectiveCostModel::EstimateAllToAllCost(
+    const std::vector<std::vector<int>>& replica_groups, double size,
+    PrimitiveType dtype) const {
+  std::optional<double> cost = EstimateAboveOverhead(
+      ProfiledOpKind::kAllToAll, replica_groups, size, dtype);
+  if (cost.has_value() || replica_groups.empty()) {
+    return cost;
+  }
+  // Use all-gather to approximate all-to-all. A penalty factor makes the
+  // theoretical cost match the empirical cost on v100 + nvlink.
+  int64_t num_devices = replica_groups.front().size();
+  double penalty_factor = double(num_devices) / 2.0;
+  cost = EstimateAllGatherCost(replica_groups, size / num_devices, dtype);
+  if (cost.has_value()) {
+    return *cost * penalty_factor;
+  }
+  return std::nullopt;
+}
+
+std::optional<double> CollectiveCostModel::EstimateDotCost(
+    double flop_count, PrimitiveType dtype) const {
+  return EstimateAboveOverhead(ProfiledOpKind::kDot, {}, flop_count, dtype);
+}
+
+std::optional<double> CollectiveCostModel::EstimateCrossoverSize(
+    ProfiledOpKind kind, const std::vector<std::vector<int>>& replica_groups,
+    PrimitiveType dtype) const {
+  const Curves* curves = FindCurves(kind, replica_groups, dtype);
+  if (curves == nullptr) {
+    return std::nullopt;
+  }
+  // Use the largest crossover over the algorithms, so that a message of that
+  // size is bandwidth bound with any of them.
+  std::optional<double> crossover;
+  for (const auto& item : *curves) {
+    const Curve& curve = item.second;
+    if (curve.size() < 2 || curve.back().first <= curve.front().first) {
+      continue;
+    }
+    double beta = (curve.back().second - curve.front().second) /
+                  (curve.back().first - curve.front().first);
+    if (beta <= 0) {
+      continue;
+    }
+    crossover = std::max(crossover.value_or(0.0), curve.front().second / beta);
+  }
+  return crossover;
+}
+
+std::string CollectiveCostModel::ToString() const {
+  std::ostringstream os;
+  for (const auto& item : curves_) {
+    os << "key: (" << ProfiledOpKindToString(std::get<0>(item.first)) << ", "
+       << std::get<1>(item.first) << ", "
+       << primitive_util::LowercasePrimitiveTypeName(std::get<2>(item.first))
+       << "), algorithms:";
+    for (const auto& curve : item.second) {
+      os << " " << (curve.first.empty() ? "-" : curve.first);
+    }
+    os << "\n";
+  }
+  return os.str();
+}
+
+std::string CollectiveCostModel::GroupsToString(
+    const std::vector<std::vector<int>>& replica_groups) {
+  std::ostringstream os;
+  os << "(";
+  for (const auto& group : replica_groups) {
+    os << "(";
+    for (const auto& id : group) {
+      os << id << ",";
+    }
+    os << "),";
+  }
+  os << ")";
+  return os.str();
+}
+
+std::string CollectiveCostModel::GroupsToShapeString(
+    const std::vector<std::vector<int>>& replica_groups) {
+  if (replica_groups.empty()) {
+    return "()";
+  }
+  return absl::StrCat(replica_groups.size(), "x",
+                      replica_groups.front().size());
+}
+
+}  // namespace spmd
+}  // namespace xla
@@ -0,0 +1,145 @@
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_COLLECTIVE_COST_MODEL_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_COLLECTIVE_COST_MODEL_H_
+
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "pybind11/pybind11.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+
+namespace xla {
+namespace spmd {
+
+// The kinds of operations whose cost is profiled.
+// kDot is keyed by the flop count with empty replica groups. kBroadcast and
+// kSendRecv are the cross-mesh primitives of alpa::CommGroup, measured by
+// gpu/alpa_comm_benchmark.
+enum class ProfiledOpKind {
+  kAllReduce,
+  kAllGather,
+  kReduceScatter,
+  kAllToAll,
+  kDot,
+  kBroadcast,
+  kSendRecv,
+};
+
+std::string ProfiledOpKindToString(ProfiledOpKind kind);
+StatusOr<ProfiledOpKind> StringToProfiledOpKind(absl::string_view name);
+
+// The profiled cost of collective communication and dot operations.
+// It is shared by the auto-sharding pass and the GPU module cost model.
+//
+// A profile is a set of curves of (message bytes or flop count, seconds).
+// Each curve is keyed by the operation kind, the replica groups, the dtype
+// and the algorithm (e.g., "ring" or "tree"; empty when unknown).
+// The replica groups are either the exact device ids, e.g.
+// "((0,1,),(2,3,),)", or only the shape of the groups, e.g. "2x2" for two
+// groups of two devices. Lookups try the exact ids first, so a profile taken
+// on one part of a cluster can be reused for other groups with the same shape.
+//
+// Between two profiled sizes, the cost is interpolated linearly in log-log
+// space. This follows latency-bound (flat) and bandwidth-bound (linear)
+// regions of a collective much better than linear interpolation between
+// sparse, exponentially spaced points. Sizes below the smallest profiled size
+// cost as much as the smallest size, and sizes above the largest one are
+// extrapolated along the last segment.
+class CollectiveCostModel {
+ public:
+  CollectiveCostModel() = default;
+
+  // Construct the model from the python object
+  // alpa/mesh_profiling.py::ProfilingResult. The python object carries no
+  // algorithm information. Acquires the GIL.
+  static CollectiveCostModel FromPyObject(pybind11::object prof_result);
+
+  // Load a profile serialized by ToFileContents / SaveToFile. This does not
+  // need python. Each non-empty line that does not start with '#' is
+  //   <kind> <replica groups> <dtype> <algorithm or -> <size>:<seconds> ...
+  // e.g.,
+  //   all-reduce 2x4 f32 ring 1024:2.1e-05 1048576:1.3e-04
+  static StatusOr<CollectiveCostModel> LoadFromFile(const std::string& path);
+  static StatusOr<CollectiveCostModel> FromFileContents(
+      absl::string_view contents);
+  std::string ToFileContents() const;
+  Status SaveToFile(const std::string& path) const;
+
+  // Add a profiled curve. The points are sorted by size.
+  void AddCurve(ProfiledOpKind kind, const std::string& replica_groups,
+                PrimitiveType dtype, const std::string& algorithm,
+                std::vector<std::pair<int64_t, double>> points);
+
+  bool Enabled() const { return !curves_.empty(); }
+
+  // Estimate the cost of an operation of `size` bytes (flops for kDot).
+  // If `algorithm` is empty, the fastest profiled algorithm is used.
+  // Return nullopt if there is no matching curve.
+  std::optional<double> Estimate(
+      ProfiledOpKind kind, const std::vector<std::vector<int>>& replica_groups,
+      double size, PrimitiveType dtype,
+      const std::string& algorithm = "") const;
+
+  // Estimate the cost above the fixed overhead of the operation, i.e.,
+  // Estimate(size) - Estimate(0). Missing all-gather and reduce-scatter
+  // curves are approximated by half an all-reduce, and a missing all-to-all
+  // curve by a scaled all-gather.
+  std::optional<double> EstimateAllReduceCost(
+      const std::vector<std::vector<int>>& replica_groups, double size,
+      PrimitiveType dtype) const;
+  std::optional<double> EstimateAllGatherCost(
+      const std::vector<std::vector<int>>& replica_groups, double size,
+      PrimitiveType dtype) const;
+  std::optional<double> EstimateReduceScatterCost(
+      const std::vector<std::vector<int>>& replica_groups, double size,
+      PrimitiveType dtype) const;
+  std::optional<double> EstimateAllToAllCost(
+      const std::vector<std::vector<int>>& replica_groups, double size,
+      PrimitiveType dtype) const;
+  std::optional<double> EstimateDotCost(double flop_count,
+                                        PrimitiveType dtype) const;
+
+  // Estimate the size at which the fixed overhead of an operation equals its
+  // size-dependent cost, fitting alpha + size * beta through the smallest and
+  // largest profiled sizes of each algorithm. Messages much smaller than this
+  // are latency bound. Return nullopt if there is no matching curve.
+  std::optional<double> EstimateCrossoverSize(
+      ProfiledOpKind kind, const std::vector<std::vector<int>>& replica_groups,
+      PrimitiveType dtype) const;
+
+  std::string ToString() const;
+
+  // Make string keys of replica groups.
+  static std::string GroupsToString(
+      const std::vector<std::vector<int>>& replica_groups);
+  static std::string GroupsToShapeString(
+      const std::vector<std::vector<int>>& replica_groups);
+
+ private:
+  // tuple<kind, replica groups, dtype>
+  using Key = std::tuple<ProfiledOpKind, std::string, PrimitiveType>;
+  // vector<pair<size, time>>, sorted by size
+  using Curve = std::vector<std::pair<int64_t, double>>;
+  // The curves of one key, by algorithm.
+  using Curves = absl::flat_hash_map<std::string, Curve>;
+
+  const Curves* FindCurves(ProfiledOpKind kind,
+                           const std::vector<std::vector<int>>& replica_groups,
+                           PrimitiveType dtype) const;
+
+  std::optional<double> EstimateAboveOverhead(
+      ProfiledOpKind kind, const std::vector<std::vector<int>>& replica_groups,
+      double size, PrimitiveType dtype) const;
+
+  static double Interpolate(const Curve& curve, double size);
+
+  absl::flat_hash_map<Key, Curves> curves_;
+};
+
+}  // namespace spmd
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_COLLECTIVE_COST_MODEL_H_
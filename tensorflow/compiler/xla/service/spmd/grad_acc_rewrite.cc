@@ -1,6 +1,15 @@
 #include "tensorflow/compiler/xla/service/spmd/grad_acc_rewrite.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <optional>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
 #include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_creation_utils.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_instructions.h"
 #include "tensorflow/compiler/xla/service/hlo_opcode.h"
@@ -158,6 +167,422 @@ std::string GetGradSyncChannelIds(const HloModule* module) {
   return ret;
 }
 
+// Combine the skippable all-reduces into buckets of at most
+// `threshold_bytes` and `threshold_count`, in the order their gradients are
+// final in `computation`. Unlike AllReduceCombiner, which combines all
+// independent all-reduces up to the threshold, a bucket only holds the
+// gradients that are final around the same time, so the all-reduce of a
+// bucket can start before the backward pass of the earlier layers is done.
+Status BucketSkippableAllReduces(HloComputation* computation,
+                                 std::vector<HloInstruction*> all_reduces,
+                                 int64_t threshold_bytes,
+                                 int64_t threshold_count) {
+  absl::flat_hash_map<const HloInstruction*, int64_t> position;
+  int64_t next_position = 0;
+  for (HloInstruction* ins : computation->MakeInstructionPostOrder()) {
+    position[ins] = next_position++;
+  }
+  absl::c_sort(all_reduces, [&](HloInstruction* a, HloInstruction* b) {
+    return position.at(a->operand(0)) < position.at(b->operand(0));
+  });
+
+  std::vector<HloInstruction*> bucket;
+  int64_t bucket_bytes = 0;
+  auto compatible = [](const HloInstruction* a, const HloInstruction* b) {
+    auto a_ar = Cast<HloAllReduceInstruction>(a);
+    auto b_ar = Cast<HloAllReduceInstruction>(b);
+    return ShapeUtil::SameElementType(a->shape(), b->shape()) &&
+           a_ar->replica_groups().size() == b_ar->replica_groups().size() &&
+           absl::c_equal(a_ar->replica_groups(), b_ar->replica_groups(),
+                         [](const ReplicaGroup& x, const ReplicaGroup& y) {
+                           return absl::c_equal(x.replica_ids(),
+                                                y.replica_ids());
+                         }) &&
+           a_ar->constrain_layout() == b_ar->constrain_layout() &&
+           a_ar->channel_id().has_value() == b_ar->channel_id().has_value() &&
+           a_ar->use_global_device_ids() == b_ar->use_global_device_ids();
+  };
+  auto flush = [&]() -> Status {
+    if (bucket.size() > 1) {
+      auto first = Cast<HloAllReduceInstruction>(bucket.front());
+      std::vector<HloInstruction*> operands;
+      std::vector<Shape> shapes;
+      for (HloInstruction* ins : bucket) {
+        operands.push_back(ins->mutable_operand(0));
+        shapes.push_back(ins->shape());
+      }
+      HloInstruction* combined =
+          computation->AddInstruction(HloInstruction::CreateAllReduce(
+              ShapeUtil::MakeTupleShape(shapes), operands, first->to_apply(),
+              first->replica_groups(), first->constrain_layout(),
+              first->channel_id(), first->use_global_device_ids()));
+      combined->set_metadata(first->metadata());
+      combined->set_metadata_op_name(kSkippableAllReduce);
+      for (int64_t i = 0; i < bucket.size(); ++i) {
+        HloInstruction* element =
+            computation->AddInstruction(HloInstruction::CreateGetTupleElement(
+                bucket[i]->shape(), combined, i));
+        TF_RETURN_IF_ERROR(bucket[i]->ReplaceAllUsesWith(element));
+        TF_RETURN_IF_ERROR(computation->RemoveInstruction(bucket[i]));
+      }
+    }
+    bucket.clear();
+    bucket_bytes = 0;
+    return OkStatus();
+  };
+
+  for (HloInstruction* ins : all_reduces) {
+    int64_t bytes = ShapeUtil::ByteSizeOf(ins->shape());
+    if (!bucket.empty() &&
+        (!compatible(bucket.front(), ins) ||
+         bucket_bytes + bytes > threshold_bytes ||
+         bucket.size() >= threshold_count)) {
+      TF_RETURN_IF_ERROR(flush());
+    }
+    bucket.push_back(ins);
+    bucket_bytes += bytes;
+  }
+  return flush();
+}
+
+// Returns a computation that applies `opcode` to two scalars, or returns the
+// second one if `opcode` is std::nullopt.
+HloComputation* MakeBinaryComputation(std::optional<HloOpcode> opcode,
+                                      PrimitiveType type, HloModule* module) {
+  HloComputation::Builder b(opcode ? HloOpcodeString(*opcode) : "assign");
+  auto x = b.AddInstruction(HloInstruction::CreateParameter(
+      /*parameter_number=*/0, ShapeUtil::MakeShape(type, {}), "x"));
+  auto y = b.AddInstruction(HloInstruction::CreateParameter(
+      /*parameter_number=*/1, ShapeUtil::MakeShape(type, {}), "y"));
+  if (!opcode) {
+    return module->AddEmbeddedComputation(b.Build(y));
+  }
+  b.AddInstruction(HloInstruction::CreateBinary(ShapeUtil::MakeShape(type, {}),
+                                                *opcode, x, y));
+  return module->AddEmbeddedComputation(b.Build());
+}
+
+// Compresses the delayed all-reduces of the f32 gradients in the apply_grad
+// module with auto_sharding::grad_acc_compression:
+//   "bf16": all-reduce the gradients in bf16.
+//   "int8": quantize the gradients to int8 with a scale shared by the replica
+//           group, all-gather them and sum them in f32.
+//   "topk": all-gather the auto_sharding::grad_acc_compression_topk_ratio of
+//           the gradients largest in magnitude with their indices and
+//           scatter-add them.
+// With auto_sharding::grad_acc_compression_error_feedback, and always with
+// topk, the compression error of a gradient is kept in a residual buffer and
+// added to the gradient of the next batch. The residual buffers are appended
+// to both the parameters and the outputs of the apply_grad module in the same
+// order, so that the runtime can feed each output to the parameter of the
+// next batch. They start as zeros.
+class GradCompressor {
+ public:
+  enum class Mode { kNone, kBF16, kInt8, kTopK };
+
+  GradCompressor(HloModule* module, int64_t* next_channel_id)
+      : module_(module), next_channel_id_(next_channel_id) {
+    std::string mode =
+        pass_context::GetString("auto_sharding::grad_acc_compression", "none");
+    if (mode == "bf16") {
+      mode_ = Mode::kBF16;
+    } else if (mode == "int8") {
+      mode_ = Mode::kInt8;
+    } else if (mode == "topk") {
+      mode_ = Mode::kTopK;
+    } else {
+      LOG_IF(WARNING, mode != "none")
+          << "Unknown gradient compression " << mode;
+      mode_ = Mode::kNone;
+    }
+    error_feedback_ =
+        mode_ == Mode::kTopK ||
+        (mode_ != Mode::kNone &&
+         pass_context::GetBool(
+             "auto_sharding::grad_acc_compression_error_feedback", false));
+    topk_ratio_ = pass_context::GetDouble(
+        "auto_sharding::grad_acc_compression_topk_ratio", 0.01);
+    if (error_feedback_ && module->entry_computation()->root_instruction()
+                                   ->opcode() != HloOpcode::kTuple) {
+      LOG(WARNING) << "Gradient compression without error feedback, because "
+                   << "the output of " << module->name() << " is not a tuple.";
+      error_feedback_ = false;
+    }
+  }
+
+  // Returns whether the all-reduce `like` of `grad` is compressed by
+  // AllReduce.
+  bool Compresses(const HloInstruction* grad,
+                  const HloAllReduceInstruction* like) const {
+    if (mode_ == Mode::kNone || grad->shape().element_type() != F32) {
+      return false;
+    }
+    // The all-gathers need the group size.
+    return mode_ == Mode::kBF16 || !like->replica_groups().empty();
+  }
+
+  // Returns the compressed all-reduce of the gradient parameter `grad` over
+  // the replica groups of `like`.
+  StatusOr<HloInstruction*> AllReduce(HloInstruction* grad,
+                                      const HloAllReduceInstruction* like) {
+    HloComputation* entry = grad->parent();
+    HloInstruction* residual = nullptr;
+    HloInstruction* value = grad;
+    if (error_feedback_) {
+      residual =
+          entry->AddEntryComputationParameter(HloInstruction::CreateParameter(
+              entry->num_parameters(), grad->shape(),
+              absl::StrCat(grad->name(), ".residual")));
+      TF_ASSIGN_OR_RETURN(value,
+                          MakeBinaryHlo(HloOpcode::kAdd, value, residual));
+    }
+
+    HloInstruction* reduced;
+    HloInstruction* new_residual;
+    switch (mode_) {
+      case Mode::kBF16: {
+        HloInstruction* compressed = MakeConvertToHlo(value, BF16);
+        TF_ASSIGN_OR_RETURN(
+            new_residual,
+            MakeBinaryHlo(HloOpcode::kSubtract, value,
+                          MakeConvertToHlo(compressed, F32)));
+        reduced = MakeConvertToHlo(
+            entry->AddInstruction(HloInstruction::CreateAllReduce(
+                compressed->shape(), {compressed},
+                MakeBinaryAdd(BF16, module_), like->replica_groups(),
+                /*constrain_layout=*/false, NextChannelId(like),
+                like->use_global_device_ids())),
+            F32);
+        break;
+      }
+      case Mode::kInt8:
+        TF_RETURN_IF_ERROR(
+            QuantizedAllReduce(value, like, &reduced, &new_residual));
+        break;
+      case Mode::kTopK:
+        TF_RETURN_IF_ERROR(
+            TopKAllReduce(value, like, &reduced, &new_residual));
+        break;
+      case Mode::kNone:
+        return FailedPrecondition("Gradient compression is disabled.");
+    }
+
+    if (error_feedback_) {
+      residuals_.push_back(new_residual);
+      if (module_->has_spmd_parameters_shardings()) {
+        std::vector<HloSharding> shardings =
+            module_->spmd_parameters_shardings();
+        shardings.push_back(shardings[grad->parameter_number()]);
+        module_->set_spmd_parameters_shardings(shardings);
+        residual_shardings_.push_back(shardings.back());
+      }
+    }
+    return reduced;
+  }
+
+  // Appends the new values of the residual buffers to the outputs.
+  Status AddResidualOutputs() {
+    if (residuals_.empty()) {
+      return OkStatus();
+    }
+    HloComputation* entry = module_->entry_computation();
+    HloInstruction* root = entry->root_instruction();
+    std::vector<HloInstruction*> outputs(root->operands().begin(),
+                                         root->operands().end());
+    absl::c_copy(residuals_, std::back_inserter(outputs));
+    HloInstruction* new_root =
+        entry->AddInstruction(HloInstruction::CreateTuple(outputs));
+    entry->set_root_instruction(new_root, /*accept_different_shape=*/true);
+
+    HloModuleConfig config = module_->config();
+    *config.mutable_entry_computation_layout()->mutable_result_layout() =
+        ShapeLayout(new_root->shape());
+    module_->set_config(config);
+    if (module_->has_spmd_output_sharding() &&
+        residual_shardings_.size() == residuals_.size()) {
+      const HloSharding& sharding = module_->spmd_output_sharding();
+      std::vector<HloSharding> elements =
+          sharding.IsTuple()
+              ? sharding.tuple_elements()
+              : std::vector<HloSharding>(root->operand_count(), sharding);
+      absl::c_copy(residual_shardings_, std::back_inserter(elements));
+      module_->set_spmd_output_sharding(
+          HloSharding::Tuple(new_root->shape(), elements));
+    }
+    return OkStatus();
+  }
+
+ private:
+  std::optional<int64_t> NextChannelId(const HloAllReduceInstruction* like) {
+    if (!like->channel_id().has_value()) {
+      return std::nullopt;
+    }
+    return (*next_channel_id_)++;
+  }
+
+  HloInstruction* AllGather(HloInstruction* operand,
+                            const HloAllReduceInstruction* like) {
+    Shape shape = operand->shape();
+    shape.set_dimensions(
+        0, shape.dimensions(0) * like->replica_groups()[0].replica_ids_size());
+    return operand->parent()->AddInstruction(HloInstruction::CreateAllGather(
+        shape, {operand}, /*all_gather_dimension=*/0, like->replica_groups(),
+        /*constrain_layout=*/false, NextChannelId(like),
+        like->use_global_device_ids()));
+  }
+
+  // The scale is the largest magnitude in the replica group divided by 127, so
+  // no value needs to be clamped.
+  Status QuantizedAllReduce(HloInstruction* value,
+                            const HloAllReduceInstruction* like,
+                            HloInstruction** reduced,
+                            HloInstruction** new_residual) {
+    HloComputation* entry = value->parent();
+    const Shape& shape = value->shape();
+    TF_ASSIGN_OR_RETURN(HloInstruction * abs,
+                        MakeUnaryHlo(HloOpcode::kAbs, value));
+    HloInstruction* zero = MakeR0ConstantHlo<float>(entry, 0);
+    TF_ASSIGN_OR_RETURN(
+        HloInstruction * local_max,
+        MakeReduceHlo(abs, zero, HloOpcode::kMaximum, module_));
+    HloInstruction* group_max =
+        entry->AddInstruction(HloInstruction::CreateAllReduce(
+            local_max->shape(), {local_max},
+            MakeBinaryComputation(HloOpcode::kMaximum, F32, module_),
+            like->replica_groups(), /*constrain_layout=*/false,
+            NextChannelId(like), like->use_global_device_ids()));
+    TF_ASSIGN_OR_RETURN(
+        HloInstruction * scale,
+        MakeBinaryHlo(HloOpcode::kDivide, group_max,
+                      MakeR0ConstantHlo<float>(entry, 127)));
+    TF_ASSIGN_OR_RETURN(
+        scale, MakeBinaryHlo(HloOpcode::kMaximum, scale,
+                             MakeR0ConstantHlo<float>(entry, 1e-30)));
+    HloInstruction* broadcast_scale = MakeBroadcastHlo(scale, {}, shape);
+
+    TF_ASSIGN_OR_RETURN(
+        HloInstruction * scaled,
+        MakeBinaryHlo(HloOpcode::kDivide, value, broadcast_scale));
+    TF_ASSIGN_OR_RETURN(HloInstruction * rounded,
+                        MakeUnaryHlo(HloOpcode::kRoundNearestAfz, scaled));
+    HloInstruction* quantized = MakeConvertToHlo(rounded, S8);
+    TF_ASSIGN_OR_RETURN(
+        HloInstruction * dequantized,
+        MakeBinaryHlo(HloOpcode::kMultiply, MakeConvertToHlo(quantized, F32),
+                      broadcast_scale));
+    TF_ASSIGN_OR_RETURN(
+        *new_residual,
+        MakeBinaryHlo(HloOpcode::kSubtract, value, dequantized));
+
+    int64_t num_elements = ShapeUtil::ElementsIn(shape);
+    TF_ASSIGN_OR_RETURN(
+        HloInstruction * flat,
+        MakeReshapeHlo(ShapeUtil::MakeShape(S8, {1, num_elements}), quantized));
+    HloInstruction* gathered = MakeConvertToHlo(AllGather(flat, like), F32);
+    TF_ASSIGN_OR_RETURN(
+        HloInstruction * sum,
+        MakeReduceHlo(gathered, zero, /*dimensions=*/{0}, HloOpcode::kAdd));
+    TF_ASSIGN_OR_RETURN(HloInstruction * reshaped,
+                        MakeReshapeHlo(shape, sum));
+    TF_ASSIGN_OR_RETURN(
+        *reduced,
+        MakeBinaryHlo(HloOpcode::kMultiply, reshaped, broadcast_scale));
+    return OkStatus();
+  }
+
+  Status TopKAllReduce(HloInstruction* value,
+                       const HloAllReduceInstruction* like,
+                       HloInstruction** reduced,
+                       HloInstruction** new_residual) {
+    HloComputation* entry = value->parent();
+    const Shape& shape = value->shape();
+    int64_t num_elements = ShapeUtil::ElementsIn(shape);
+    int64_t k = std::clamp<int64_t>(std::ceil(topk_ratio_ * num_elements), 1,
+                                    num_elements);
+
+    TF_ASSIGN_OR_RETURN(
+        HloInstruction * flat,
+        MakeReshapeHlo(ShapeUtil::MakeShape(F32, {num_elements}), value));
+    TF_ASSIGN_OR_RETURN(HloInstruction * abs,
+                        MakeUnaryHlo(HloOpcode::kAbs, flat));
+    HloInstruction* iota =
+        MakeIotaHlo(entry, ShapeUtil::MakeShape(S32, {num_elements}), 0);
+
+    // Sort the magnitudes in descending order with the indices and the values.
+    HloComputation::Builder compare_b("compare-gt");
+    std::vector<HloInstruction*> params;
+    for (PrimitiveType type : {F32, S32, F32}) {
+      for (int64_t i = 0; i < 2; ++i) {
+        params.push_back(compare_b.AddInstruction(
+            HloInstruction::CreateParameter(params.size(),
+                                            ShapeUtil::MakeShape(type, {}),
+                                            absl::StrCat("p", params.size()))));
+      }
+    }
+    compare_b.AddInstruction(HloInstruction::CreateCompare(
+        ShapeUtil::MakeShape(PRED, {}), params[0], params[1],
+        ComparisonDirection::kGt));
+    HloComputation* compare =
+        module_->AddEmbeddedComputation(compare_b.Build());
+    HloInstruction* sort = entry->AddInstruction(HloInstruction::CreateSort(
+        ShapeUtil::MakeTupleShape(
+            {abs->shape(), iota->shape(), flat->shape()}),
+        /*dimension=*/0, {abs, iota, flat}, compare, /*is_stable=*/false));
+    TF_ASSIGN_OR_RETURN(HloInstruction * sorted_indices,
+                        MakeGetTupleElementHlo(sort, 1));
+    TF_ASSIGN_OR_RETURN(HloInstruction * sorted_values,
+                        MakeGetTupleElementHlo(sort, 2));
+    TF_ASSIGN_OR_RETURN(HloInstruction * indices,
+                        MakeSliceHlo(sorted_indices, {0}, {k}, {1}));
+    TF_ASSIGN_OR_RETURN(HloInstruction * values,
+                        MakeSliceHlo(sorted_values, {0}, {k}, {1}));
+
+    ScatterDimensionNumbers dnums;
+    dnums.add_inserted_window_dims(0);
+    dnums.add_scatter_dims_to_operand_dims(0);
+    dnums.set_index_vector_dim(1);
+    auto scatter =
+        [&](HloInstruction* operand, HloInstruction* indices,
+            HloInstruction* updates,
+            std::optional<HloOpcode> opcode) -> StatusOr<HloInstruction*> {
+      TF_ASSIGN_OR_RETURN(
+          HloInstruction * indices_2d,
+          MakeReshapeHlo(ShapeUtil::MakeShape(
+                             S32, {indices->shape().dimensions(0), 1}),
+                         indices));
+      return entry->AddInstruction(HloInstruction::CreateScatter(
+          operand->shape(), operand, indices_2d, updates,
+          MakeBinaryComputation(opcode, F32, module_), dnums,
+          /*indices_are_sorted=*/false, /*unique_indices=*/false));
+    };
+
+    // Sum the selected values of all devices.
+    HloInstruction* zeros = MakeBroadcastHlo(
+        MakeR0ConstantHlo<float>(entry, 0), {}, flat->shape());
+    TF_ASSIGN_OR_RETURN(HloInstruction * sum,
+                        scatter(zeros, AllGather(indices, like),
+                                AllGather(values, like), HloOpcode::kAdd));
+    TF_ASSIGN_OR_RETURN(*reduced, MakeReshapeHlo(shape, sum));
+
+    // The residual is everything that is not selected.
+    HloInstruction* selected_zeros = MakeBroadcastHlo(
+        MakeR0ConstantHlo<float>(entry, 0), {}, values->shape());
+    TF_ASSIGN_OR_RETURN(
+        HloInstruction * residual,
+        scatter(flat, indices, selected_zeros, /*opcode=*/std::nullopt));
+    TF_ASSIGN_OR_RETURN(*new_residual, MakeReshapeHlo(shape, residual));
+    return OkStatus();
+  }
+
+  HloModule* module_;
+  int64_t* next_channel_id_;
+  Mode mode_;
+  bool error_feedback_;
+  double topk_ratio_;
+  std::vector<HloInstruction*> residuals_;
+  std::vector<HloSharding> residual_shardings_;
+};
+
 /***** Added by Ryb7532 *****/
 StatusOr<bool> GradAccCommDelay::RunOnModuleGroup(
     HloModuleGroup* module_group,
@@ -188,6 +613,16 @@ StatusOr<bool> GradAccCommDelay::RunOnModuleGroup(
 
   int64_t next_channel_id = hlo_query::NextChannelId(*applygrad_hlo);
 
+  // Keep the all-reduces of the accumulated gradients in the backward module
+  // instead of moving them to apply_grad. Like with GradAccRewrite, they are
+  // skipped at runtime except in the last micro batch, where they are issued
+  // as soon as each gradient is final and overlap with the rest of its
+  // backward pass (with xla_gpu_enable_async_all_reduce).
+  bool overlap_delayed_all_reduce = pass_context::GetBool(
+      "auto_sharding::grad_acc_overlap_delayed_all_reduce", false);
+  std::vector<HloInstruction*> skippable_allreduces;
+  GradCompressor compressor(applygrad_hlo, &next_channel_id);
+
   std::vector<HloInstruction*> to_remove;
 
   CHECK_EQ(output_indices.size(), input_indices.size());
@@ -218,7 +653,7 @@ StatusOr<bool> GradAccCommDelay::RunOnModuleGroup(
       }
     }
 
-    if (in_index == -1) {
+    if (in_index == -1 || overlap_delayed_all_reduce) {
       // insert allreduce_ins between add_ins and output
       allreduce_ins->ReplaceOperandWith(
           0, MaybeReshapeConvert(add_ins, allreduce_ins->shape()));
@@ -242,7 +677,9 @@ StatusOr<bool> GradAccCommDelay::RunOnModuleGroup(
         old_allreduce->ReplaceAllUsesWith(
             MaybeReshapeConvert(new_allreduce, old_allreduce->shape()));
         to_remove.push_back(old_allreduce);
+        allreduce_ins = new_allreduce;
       }
+      skippable_allreduces.push_back(allreduce_ins);
     } else {
       allreduce_ins->set_metadata_op_name(kDelayedAllReduce);
 
@@ -255,17 +692,23 @@ StatusOr<bool> GradAccCommDelay::RunOnModuleGroup(
       const Shape& new_shape = param_ins->shape();
       HloInstruction::InstructionVector new_operands;
       new_operands.push_back(param_ins);
-      std::optional<int64_t> channel_id = old_allreduce->channel_id();
-      if (channel_id)
-        channel_id = next_channel_id++;
-      auto new_allreduce =
-	applygrad_entry->AddInstruction(HloInstruction::CreateAllReduce(
-	    new_shape,
-	    MaybeReshapeConvertTuple(new_operands, new_shape),
-	    MakeBinaryAdd(new_shape.element_type(), applygrad_entry->parent()),
-	    old_allreduce->replica_groups(),
-	    old_allreduce->constrain_layout(), channel_id,
-	    old_allreduce->use_global_device_ids()));
+      HloInstruction* new_allreduce;
+      if (compressor.Compresses(param_ins, old_allreduce)) {
+        TF_ASSIGN_OR_RETURN(new_allreduce,
+                            compressor.AllReduce(param_ins, old_allreduce));
+      } else {
+        std::optional<int64_t> channel_id = old_allreduce->channel_id();
+        if (channel_id)
+          channel_id = next_channel_id++;
+        new_allreduce =
+            applygrad_entry->AddInstruction(HloInstruction::CreateAllReduce(
+                new_shape, MaybeReshapeConvertTuple(new_operands, new_shape),
+                MakeBinaryAdd(new_shape.element_type(),
+                              applygrad_entry->parent()),
+                old_allreduce->replica_groups(),
+                old_allreduce->constrain_layout(), channel_id,
+                old_allreduce->use_global_device_ids()));
+      }
       new_allreduce->set_metadata(old_allreduce->metadata());
       for (HloInstruction* param_user: param_users) {
 	for (size_t i = 0; i < param_user->operand_count(); ++i) {
@@ -283,6 +726,17 @@ StatusOr<bool> GradAccCommDelay::RunOnModuleGroup(
   for (auto ins : to_remove) {
     backward_entry->RemoveInstruction(ins);
   }
+  TF_RETURN_IF_ERROR(compressor.AddResidualOutputs());
+
+  if (overlap_delayed_all_reduce) {
+    TF_RETURN_IF_ERROR(BucketSkippableAllReduces(
+        backward_entry, skippable_allreduces,
+        pass_context::GetInt("combiner::all_reduce_threshold",
+                             backward_hlo->config()
+                                 .debug_options()
+                                 .xla_gpu_all_reduce_combine_threshold_bytes()),
+        /*threshold_count=*/512));
+  }
 
   // for debug
   // std::cerr << "===== Exit GradAccRewrite =====" << std::endl;
@@ -38,6 +38,15 @@ std::string GetGradSyncChannelIds(const HloModule* module);
 const char* const kSkippableAllReduce = "grad_acc_skippable_all_reduce";
 
 /***** Added by Ryb7532 *****/
+// Move the all-reduces of the accumulated gradients from the backward module
+// to the apply_grad module, so that they run once per batch.
+// With auto_sharding::grad_acc_overlap_delayed_all_reduce, they stay in the
+// backward module as skippable all-reduces (see GradAccRewrite), combined into
+// buckets by the all-reduce combiner threshold, so that they overlap with the
+// backward pass of the last micro batch.
+// With auto_sharding::grad_acc_compression, the all-reduces moved to the
+// apply_grad module are compressed, optionally with error feedback through
+// residual buffers appended to its parameters and outputs.
 class GradAccCommDelay : public HloModuleGroupPass {
  public:
   GradAccCommDelay() = default;
@@ -1,12 +1,18 @@
 #include "tensorflow/compiler/xla/service/spmd/slice_auto_sharded_stages.h"
 
+#include <algorithm>
+
 #include "pybind11/numpy.h"
 #include "pybind11/pybind11.h"
 #include "pybind11/stl.h"
 #include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_computation_deduplicator.h"
 #include "tensorflow/compiler/xla/service/hlo_instructions.h"
 #include "tensorflow/compiler/xla/service/hlo_opcode.h"
 #include "tensorflow/compiler/xla/service/spmd/auto_sharding_util.h"
+#include "tensorflow/tsl/platform/cpu_info.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/threadpool.h"
 
 namespace xla {
 namespace spmd {
@@ -36,6 +42,9 @@ std::pair<std::string, std::string> ParseNameAndType(const HloInstruction* ins)
 
 enum VisitState { kVisiting, kVisited };
 
+// Clone the instructions between a pair of pipeline markers into a new module.
+// The full module is only read, so the stages can be created concurrently.
+// The constants of the stage share their literals with the full module.
 std::unique_ptr<HloModule> CreateStageModule(
     HloModule* full_module, HloInstruction* stage_start_instruction,
     HloInstruction* stage_end_instruction, std::string stage_name_suffix) {
@@ -202,19 +211,40 @@ std::vector<std::unique_ptr<HloModule>> SliceAutoShardedStagesInternal(
   }
 
   std::vector<std::string> pipeline_stage_names;
-  std::vector<std::unique_ptr<HloModule>> pipeline_stages;
+  std::vector<std::pair<HloInstruction*, HloInstruction*>> stage_markers;
   for (const auto& it : stage_start_end_instructions) {
     if (it.second.first != nullptr && it.second.second != nullptr) {
       pipeline_stage_names.push_back(it.first);
-      pipeline_stages.push_back(CreateStageModule(module, it.second.first,
-                                                  it.second.second, it.first));
+      stage_markers.push_back(it.second);
     }
   }
 
+  std::vector<std::unique_ptr<HloModule>> pipeline_stages(
+      stage_markers.size());
   if (pipeline_stages.empty()) {
     return pipeline_stages;
   }
 
+  // Each stage only visits its own instructions, so the total cost is linear
+  // in the size of the module.
+  int num_threads = std::min<int>(pipeline_stages.size(),
+                                  tsl::port::MaxParallelism());
+  auto create_stages = [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      pipeline_stages[i] = CreateStageModule(
+          module, stage_markers[i].first, stage_markers[i].second,
+          pipeline_stage_names[i]);
+    }
+  };
+  if (num_threads <= 1) {
+    create_stages(0, pipeline_stages.size());
+  } else {
+    tsl::thread::ThreadPool thread_pool(
+        tsl::Env::Default(), "slice_auto_sharded_stages", num_threads);
+    thread_pool.ParallelFor(pipeline_stages.size(), /*cost_per_unit=*/1 << 20,
+                            create_stages);
+  }
+
   // ----- Put the sharded HLO module back to Python -----
   PyGILState_STATE gstate = PyGILState_Ensure();
   {
@@ -260,8 +290,14 @@ std::vector<std::unique_ptr<HloModule>> SliceAutoShardedStagesInternal(
 StatusOr<bool> SliceAutoShardedStages::Run(
     HloModule* module,
     const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  // Deduplicate the computations once in the full module, so that identical
+  // computations (e.g., the reducers of different reduce ops) are not cloned
+  // separately into every stage.
+  TF_ASSIGN_OR_RETURN(
+      bool changed,
+      HloComputationDeduplicator().Run(module, execution_threads));
   SliceAutoShardedStagesInternal(module);
-  return false;
+  return changed;
 }
 
 }  // namespace spmd
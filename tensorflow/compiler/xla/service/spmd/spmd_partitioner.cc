@@ -518,6 +518,17 @@ PartitionedHlo PartitionedHlo::ReshardNoCache(const HloSharding& target,
       if (!allow_full_replication) {
         return *this;
       }
+      if (state_.partitioner->options().reshard_cost_fn) {
+        // Going through the intermediate strictly reduces the number of
+        // tiles, so the recursion terminates.
+        std::optional<HloSharding> intermediate =
+            state_.partitioner->ChooseReshardIntermediate(base_shape_,
+                                                          sharding(), target);
+        if (intermediate.has_value()) {
+          VLOG(2) << "Resharding through " << intermediate->ToString();
+          return Reshard(*intermediate).Reshard(target);
+        }
+      }
       LOG(ERROR)
           << "[spmd] Involuntary full rematerialization. The compiled was "
              "not able to go from sharding "
@@ -4363,6 +4374,59 @@ SpmdPartitioner::SpmdPartitioner(int64_t num_partitions, int64_t num_replicas,
           num_partitions, num_replicas, std::move(options),
           GetDefaultCollectiveOpsCreator(num_partitions, num_replicas)) {}
 
+std::optional<HloSharding> SpmdPartitioner::ChooseReshardIntermediate(
+    const Shape& shape, const HloSharding& source, const HloSharding& target) {
+  auto key = std::make_tuple(shape, source, target);
+  auto it = reshard_intermediate_cache_.find(key);
+  if (it != reshard_intermediate_cache_.end()) {
+    return it->second;
+  }
+
+  std::optional<HloSharding> best;
+  if (!source.IsTileMaximal() && !target.IsTileMaximal() &&
+      !source.IsManual() && !target.IsManual()) {
+    std::vector<int64_t> tiled_dims;
+    for (int64_t i = 0; i < source.TiledDataRank(); ++i) {
+      if (source.tile_assignment().dim(i) > 1) {
+        tiled_dims.push_back(i);
+      }
+    }
+    // Enumerating the subsets is exponential in the number of tiled dims,
+    // which is at most the number of mesh dims in practice.
+    constexpr int64_t kMaxTiledDims = 6;
+    const auto& cost_fn = options_.reshard_cost_fn;
+    double best_cost =
+        cost_fn(shape, source, HloSharding::Replicate());
+    if (tiled_dims.size() <= kMaxTiledDims) {
+      // Every nonempty proper subset of the tiled dims to replicate.
+      for (int64_t mask = 1; mask + 1 < (int64_t{1} << tiled_dims.size());
+           ++mask) {
+        std::vector<int64_t> dims;
+        for (int64_t i = 0; i < tiled_dims.size(); ++i) {
+          if (mask & (int64_t{1} << i)) {
+            dims.push_back(tiled_dims[i]);
+          }
+        }
+        HloSharding candidate =
+            hlo_sharding_util::PartiallyReplicateTiledShardingOnDims(source,
+                                                                     dims);
+        if (candidate == target || candidate.IsReplicated()) {
+          continue;
+        }
+        double cost = cost_fn(shape, source, candidate) +
+                      cost_fn(shape, candidate, target);
+        if (cost < best_cost) {
+          best_cost = cost;
+          best = std::move(candidate);
+        }
+      }
+    }
+  }
+
+  reshard_intermediate_cache_.emplace(std::move(key), best);
+  return best;
+}
+
 HloInstruction* SpmdPartitioner::AllGatherShards(
     SpmdBuilder* b, HloInstruction* operand, const HloSharding& sharding,
     int64_t* next_channel_id, absl::Span<const int64_t> selected_dims,
@@ -4524,6 +4588,7 @@ StatusOr<bool> SpmdPartitioner::Run(
     const absl::flat_hash_set<absl::string_view>& execution_threads) {
   TF_RETURN_IF_ERROR(PreprocessSharding(module, execution_threads));
   TF_RETURN_IF_ERROR(PreprocessHlos(module, execution_threads));
+  reshard_intermediate_cache_.clear();
 
   //std::cerr << "===== Enter SPMD Partitioner =====" << std::endl;
   //std::cerr << module->ToString();
@@ -16,9 +16,11 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_SPMD_PARTITIONER_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_SPMD_PARTITIONER_H_
 
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string>
+#include <tuple>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
@@ -72,6 +74,15 @@ struct SpmdPartitionerOptions {
   // Whether doing bidirectional communication when decomposing independent
   // all-gathers.
   bool bidirectional_decomposed_all_gather = false;
+
+  // If set, estimates the time of resharding a tensor of the given
+  // unpartitioned shape from the first sharding to the second one in one step.
+  // A reshard that would otherwise fully replicate its operand then picks the
+  // cheapest partially replicated intermediate sharding under this cost model,
+  // e.g., to only all-gather along the fast mesh dims. A cost of infinity or
+  // higher means the reshard is not supported.
+  std::function<double(const Shape&, const HloSharding&, const HloSharding&)>
+      reshard_cost_fn = nullptr;
 };
 
 // Class to wrap the computation builder to capture information during SPMD
@@ -247,6 +258,14 @@ class SpmdPartitioner : public HloModulePass {
 
   const SpmdPartitionerOptions& options() { return options_; }
 
+  // Returns the cheapest sharding to go through when resharding a tensor of
+  // the unpartitioned `shape` from `source` to `target` under
+  // options().reshard_cost_fn, or nullopt if full replication is the cheapest.
+  // The candidates partially replicate a subset of the tiled dims of `source`.
+  // Decisions are cached across the module.
+  std::optional<HloSharding> ChooseReshardIntermediate(
+      const Shape& shape, const HloSharding& source, const HloSharding& target);
+
  protected:
   virtual std::unique_ptr<SpmdPartitioningVisitor> CreateVisitor(
       HloComputation* computation, int64_t num_partitions, int64_t num_replicas,
@@ -297,6 +316,11 @@ class SpmdPartitioner : public HloModulePass {
   SpmdPartitionerOptions options_;
   SPMDCollectiveOpsCreator collective_ops_creator_;
   std::vector<std::vector<int64_t>> device_groups_;
+
+  // The decisions of ChooseReshardIntermediate.
+  absl::flat_hash_map<std::tuple<Shape, HloSharding, HloSharding>,
+                      std::optional<HloSharding>>
+      reshard_intermediate_cache_;
 };
 
 // Class describes partition state of the data represented by an HLO created
@@ -12450,6 +12450,51 @@ ENTRY entry {
                         _, _, _));
 }
 
+TEST_F(SpmdPartitioningTest, ChooseReshardIntermediateByCost) {
+  // Replicating a tensor costs more than partially replicating it on any dim
+  // and then resharding it to the target.
+  int64_t num_calls = 0;
+  SpmdPartitionerOptions options;
+  options.reshard_cost_fn = [&](const Shape&, const HloSharding&,
+                                const HloSharding& dst) {
+    ++num_calls;
+    return dst.IsReplicated() ? 10.0 : 1.0;
+  };
+  SpmdPartitioner partitioner(/*num_partitions=*/4, /*num_replicas=*/1,
+                              options);
+  Shape shape = ShapeUtil::MakeShape(F32, {8, 8});
+  HloSharding source = HloSharding::Tile(Array<int64_t>({{0, 1}, {2, 3}}));
+  HloSharding target = HloSharding::Tile(Array<int64_t>({{0, 2}, {1, 3}}));
+
+  std::optional<HloSharding> intermediate =
+      partitioner.ChooseReshardIntermediate(shape, source, target);
+  ASSERT_TRUE(intermediate.has_value());
+  EXPECT_EQ(*intermediate,
+            hlo_sharding_util::PartiallyReplicateTiledShardingOnDims(source,
+                                                                     {0}));
+
+  // The decision is cached.
+  int64_t num_calls_before = num_calls;
+  EXPECT_EQ(partitioner.ChooseReshardIntermediate(shape, source, target),
+            intermediate);
+  EXPECT_EQ(num_calls, num_calls_before);
+}
+
+TEST_F(SpmdPartitioningTest, ChooseReshardIntermediateKeepsReplication) {
+  SpmdPartitionerOptions options;
+  options.reshard_cost_fn = [](const Shape&, const HloSharding&,
+                               const HloSharding& dst) {
+    return dst.IsReplicated() ? 1.0 : 10.0;
+  };
+  SpmdPartitioner partitioner(/*num_partitions=*/4, /*num_replicas=*/1,
+                              options);
+  Shape shape = ShapeUtil::MakeShape(F32, {8, 8});
+  HloSharding source = HloSharding::Tile(Array<int64_t>({{0, 1}, {2, 3}}));
+  HloSharding target = HloSharding::Tile(Array<int64_t>({{0, 2}, {1, 3}}));
+  EXPECT_FALSE(partitioner.ChooseReshardIntermediate(shape, source, target)
+                   .has_value());
+}
+
 }  // namespace
 }  // namespace spmd
 }  // namespace xla
@@ -20,6 +20,8 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/service/rng_bit_generator_expander.h"
+#include "tensorflow/compiler/xla/service/spmd/spmd_partitioner_util.h"
 
 // Added by alpa
 #include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
@@ -51,6 +53,103 @@ Status StatefulRngSpmdPartitioningVisitor::HandleRngGetAndUpdateState(
   return OkStatus();
 }
 
+Status StatefulRngSpmdPartitioningVisitor::HandleRngBitGenerator(
+    HloInstruction* hlo) {
+  // Philox is counter based, so every partition can generate the bits of its
+  // own shard from the key and the counter of the first element of the shard.
+  // This needs the shard to be a contiguous range of the flattened data,
+  // starting at a counter boundary. Everything else falls back to generating
+  // all the bits on every partition. RNG_DEFAULT is expanded to Philox by the
+  // CPU and GPU compilers.
+  auto* rng = Cast<HloRngBitGeneratorInstruction>(hlo);
+  const Shape& state_shape = hlo->shape().tuple_shapes(0);
+  const Shape& data_shape = hlo->shape().tuple_shapes(1);
+  if ((rng->algorithm() != RandomAlgorithm::RNG_PHILOX &&
+       rng->algorithm() != RandomAlgorithm::RNG_DEFAULT) ||
+      !hlo->sharding().IsTuple() || state_shape.rank() != 1 ||
+      (state_shape.dimensions(0) != 2 && state_shape.dimensions(0) != 3)) {
+    return DefaultAction(hlo);
+  }
+  const HloSharding state_sharding =
+      hlo->sharding().GetSubSharding(hlo->shape(), {0});
+  const HloSharding data_sharding =
+      hlo->sharding().GetSubSharding(hlo->shape(), {1});
+  const int64_t elements_per_counter =
+      PhiloxElementsPerCounter(data_shape.element_type());
+  if (!state_sharding.IsReplicated() || !data_sharding.IsTiled() ||
+      data_sharding.IsManualSubgroup() || elements_per_counter == 0) {
+    return DefaultAction(hlo);
+  }
+
+  // The shard is contiguous if only the first non-trivial dimension is tiled,
+  // and aligned to a counter if its size is a multiple of the elements per
+  // counter.
+  int64_t tiled_dim = 0;
+  while (tiled_dim < data_shape.rank() &&
+         data_shape.dimensions(tiled_dim) == 1) {
+    ++tiled_dim;
+  }
+  if (tiled_dim == data_shape.rank()) {
+    return DefaultAction(hlo);
+  }
+  for (int64_t i = 0; i < data_shape.rank(); ++i) {
+    if (i != tiled_dim && data_sharding.tile_assignment().dim(i) != 1) {
+      return DefaultAction(hlo);
+    }
+  }
+  const int64_t num_tiles = data_sharding.tile_assignment().dim(tiled_dim);
+  const Shape shard_shape = MakePartitionedShape(data_shape, data_sharding);
+  if (data_shape.dimensions(tiled_dim) % num_tiles != 0 ||
+      ShapeUtil::ElementsIn(shard_shape) % elements_per_counter != 0) {
+    return DefaultAction(hlo);
+  }
+
+  TF_ASSIGN_OR_RETURN(HloComputation * shard_state_computation,
+                      CreatePhiloxShardStateComputation(
+                          data_shape, state_shape, hlo->GetModule()));
+  SetPartitionedHlo(hlo, [&] {
+    HloInstruction* state = GetPartitionedHlo(hlo->operand(0))
+                                .Reshard(HloSharding::Replicate())
+                                .hlo();
+    const Shape scalar_u64 = ShapeUtil::MakeShape(U64, {});
+    HloInstruction* row_offset =
+        b_.AddInstruction(HloInstruction::CreateConvert(
+            scalar_u64,
+            MakePartitionOffsets(data_shape, data_sharding,
+                                 MakePartitioningState().partition_id, &b_,
+                                 {tiled_dim})[tiled_dim]));
+    const int64_t row_size = ShapeUtil::ElementsIn(data_shape) /
+                             data_shape.dimensions(tiled_dim);
+    HloInstruction* element_offset =
+        b_.AddInstruction(HloInstruction::CreateBinary(
+            scalar_u64, HloOpcode::kMultiply, row_offset,
+            b_.AddInstruction(HloInstruction::CreateConstant(
+                LiteralUtil::CreateR0<uint64_t>(row_size)))));
+    HloInstruction* counter_offset =
+        b_.AddInstruction(HloInstruction::CreateBinary(
+            scalar_u64, HloOpcode::kDivide, element_offset,
+            b_.AddInstruction(HloInstruction::CreateConstant(
+                LiteralUtil::CreateR0<uint64_t>(elements_per_counter)))));
+    HloInstruction* states = b_.AddInstruction(HloInstruction::CreateCall(
+        shard_state_computation->root_instruction()->shape(),
+        {state, counter_offset}, shard_state_computation));
+    HloInstruction* shard_state =
+        b_.AddInstruction(HloInstruction::CreateGetTupleElement(states, 0));
+    HloInstruction* output_state =
+        b_.AddInstruction(HloInstruction::CreateGetTupleElement(states, 1));
+    HloInstruction* shard_rng = b_.AddInstruction(
+        HloInstruction::CreateRngBitGenerator(
+            ShapeUtil::MakeTupleShapeWithPtrs(
+                {&shard_state->shape(), &shard_shape}),
+            shard_state, rng->algorithm()));
+    HloInstruction* shard_data =
+        b_.AddInstruction(HloInstruction::CreateGetTupleElement(shard_rng, 1));
+    return b_.AddInstruction(
+        HloInstruction::CreateTuple({output_state, shard_data}));
+  });
+  return OkStatus();
+}
+
 std::unique_ptr<spmd::SpmdPartitioningVisitor>
 StatefulRngSpmdPartitioner::CreateVisitor(
     HloComputation* computation, int64_t num_partitions, int64_t num_replicas,
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_STATEFUL_RNG_SPMD_PARTITIONER_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_STATEFUL_RNG_SPMD_PARTITIONER_H_
 
+#include <functional>
 #include <utility>
 
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
@@ -41,13 +42,23 @@ class StatefulRngSpmdPartitioningVisitor
                                       logger, std::move(options), partitioner,
                                       call_graph) {}
   Status HandleRngGetAndUpdateState(HloInstruction* hlo) override;
+  Status HandleRngBitGenerator(HloInstruction* hlo) override;
 };
 
 class StatefulRngSpmdPartitioner : public spmd::SpmdPartitioner {
  public:
-  StatefulRngSpmdPartitioner(int64_t num_partitions, int64_t num_replicas)
-      : spmd::SpmdPartitioner(num_partitions, num_replicas,
-                              GetSpmdPartitionerOptions()) {}
+  StatefulRngSpmdPartitioner(
+      int64_t num_partitions, int64_t num_replicas,
+      int64_t threshold_for_windowed_einsum_mib = 100000,
+      bool unroll_windowed_einsum = false,
+      std::function<double(const Shape&, const HloSharding&,
+                           const HloSharding&)>
+          reshard_cost_fn = nullptr)
+      : spmd::SpmdPartitioner(
+            num_partitions, num_replicas,
+            GetSpmdPartitionerOptions(threshold_for_windowed_einsum_mib,
+                                      unroll_windowed_einsum,
+                                      std::move(reshard_cost_fn))) {}
 
  protected:
   std::unique_ptr<spmd::SpmdPartitioningVisitor> CreateVisitor(
@@ -64,12 +75,18 @@ class StatefulRngSpmdPartitioner : public spmd::SpmdPartitioner {
       const HloInstruction* hlo) override;
 
  private:
-  static spmd::SpmdPartitionerOptions GetSpmdPartitionerOptions() {
+  static spmd::SpmdPartitionerOptions GetSpmdPartitionerOptions(
+      int64_t threshold_for_windowed_einsum_mib, bool unroll_windowed_einsum,
+      std::function<double(const Shape&, const HloSharding&,
+                           const HloSharding&)>
+          reshard_cost_fn) {
     spmd::SpmdPartitionerOptions options;
     options.allow_module_signature_change = true;
-    // Setting windowed einsum threshold to be large to disable it for GPU by
-    // default.
-    options.threshold_for_windowed_einsum_mib = 100000;
+    // The default windowed einsum threshold is large to disable it for GPU.
+    options.threshold_for_windowed_einsum_mib =
+        threshold_for_windowed_einsum_mib;
+    options.unroll_windowed_einsum = unroll_windowed_einsum;
+    options.reshard_cost_fn = std::move(reshard_cost_fn);
     return options;
   }
 };
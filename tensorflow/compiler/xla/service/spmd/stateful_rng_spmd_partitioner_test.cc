@@ -15,7 +15,9 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/spmd/stateful_rng_spmd_partitioner.h"
 
+#include "tensorflow/compiler/xla/literal_util.h"
 #include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_evaluator.h"
 #include "tensorflow/compiler/xla/service/hlo_instructions.h"
 #include "tensorflow/compiler/xla/service/hlo_matchers.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
@@ -23,6 +25,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/hlo_parser.h"
 #include "tensorflow/compiler/xla/service/hlo_pass_pipeline.h"
 #include "tensorflow/compiler/xla/service/hlo_verifier.h"
+#include "tensorflow/compiler/xla/service/rng_bit_generator_expander.h"
 #include "tensorflow/compiler/xla/service/rng_expander.h"
 #include "tensorflow/compiler/xla/service/sharding_propagation.h"
 #include "tensorflow/compiler/xla/tests/hlo_test_base.h"
@@ -116,6 +119,73 @@ ENTRY entry {
   VerifyNoAllReduce(module.get());
 }
 
+TEST_F(StatefulRngSpmdPartitionerTest, RngBitGeneratorShardedData) {
+  absl::string_view hlo_string = R"(
+HloModule module
+
+ENTRY entry {
+  %state = u64[2] parameter(0), sharding={replicated}
+  %rng = (u64[2], u32[8,6]) rng-bit-generator(%state), algorithm=rng_philox,
+    sharding={{replicated}, {devices=[4,1]0,1,2,3}}
+  %new_state = u64[2] get-tuple-element(%rng), index=0,
+    sharding={replicated}
+  %data = u32[8,6] get-tuple-element(%rng), index=1,
+    sharding={devices=[4,1]0,1,2,3}
+  ROOT %tuple = (u64[2], u32[8,6]) tuple(%new_state, %data),
+    sharding={{replicated}, {devices=[4,1]0,1,2,3}}
+}
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto module, PartitionComputation(hlo_string, /*num_partitions=*/4));
+  XLA_VLOG_LINES(1, module->ToString());
+
+  // Every partition generates only its own shard, without communication.
+  VerifyNoAllReduce(module.get());
+  for (HloComputation *computation : module->computations()) {
+    for (HloInstruction *hlo : computation->instructions()) {
+      EXPECT_NE(hlo->opcode(), HloOpcode::kAllGather);
+      if (hlo->opcode() == HloOpcode::kRngBitGenerator) {
+        EXPECT_TRUE(ShapeUtil::Equal(
+            hlo->shape(),
+            ShapeUtil::MakeTupleShape({ShapeUtil::MakeShape(U64, {3}),
+                                       ShapeUtil::MakeShape(U32, {2, 6})})));
+      }
+    }
+  }
+
+  // The shards are bitwise identical to the unpartitioned random bits.
+  TF_ASSERT_OK_AND_ASSIGN(auto reference,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  RngBitGeneratorExpander expander(RandomAlgorithm::RNG_PHILOX);
+  TF_ASSERT_OK(expander.Run(reference.get()).status());
+  Literal state = LiteralUtil::CreateR1<uint64_t>({0x1234567890abcdefull,
+                                                   0xffffffffffffffffull});
+  HloEvaluator evaluator;
+  TF_ASSERT_OK_AND_ASSIGN(Literal expected_tuple,
+                          evaluator.Evaluate(*reference, {&state}));
+  std::vector<Literal> expected = expected_tuple.DecomposeTuple();
+  for (int64_t partition = 0; partition < 4; ++partition) {
+    std::unique_ptr<HloModule> shard_module = module->Clone();
+    for (HloComputation *computation : shard_module->computations()) {
+      for (HloInstruction *hlo : computation->MakeInstructionPostOrder()) {
+        if (hlo->opcode() == HloOpcode::kPartitionId) {
+          TF_ASSERT_OK(computation->ReplaceWithNewInstruction(
+              hlo, HloInstruction::CreateConstant(
+                       LiteralUtil::CreateR0<uint32_t>(partition))));
+        }
+      }
+    }
+    TF_ASSERT_OK(expander.Run(shard_module.get()).status());
+    TF_ASSERT_OK_AND_ASSIGN(Literal result_tuple,
+                            evaluator.Evaluate(*shard_module, {&state}));
+    std::vector<Literal> result = result_tuple.DecomposeTuple();
+    EXPECT_EQ(result[0], expected[0]);
+    EXPECT_EQ(result[1],
+              expected[1].Slice({partition * 2, 0}, {partition * 2 + 2, 6}));
+  }
+}
+
 }  // namespace
 }  // namespace spmd
 }  // namespace xla
@@ -130,6 +130,11 @@ port::Status BlasLt::Init() {
 
 /*static*/ blas::DataType BlasLt::GetScaleType(
     blas::DataType c_type, blas::ComputationType computation_type) {
+  // int8 outputs of int32 accumulations are scaled in f32 (requantization).
+  if (computation_type == blas::ComputationType::kI32 &&
+      c_type == blas::DataType::kInt8) {
+    return blas::DataType::kFloat;
+  }
   return ((computation_type == blas::ComputationType::kF32) &&
           (c_type != blas::DataType::kComplexFloat))
              ? blas::DataType::kFloat
@@ -18,11 +18,13 @@ limitations under the License.
 
 #include <cstdint>
 #include <map>
+#include <optional>
 #include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
+#include "tensorflow/tsl/framework/allocator.h"
 #include "tensorflow/compiler/xla/stream_executor/device_memory.h"
 #include "tensorflow/compiler/xla/stream_executor/lib/statusor.h"
 #include "tensorflow/compiler/xla/stream_executor/platform.h"
@@ -241,6 +243,12 @@ class DeviceMemoryAllocator {
     return false;
   }
 
+  // Added by Alpa. The stats of the allocator of a device, if it keeps them.
+  virtual std::optional<tsl::AllocatorStats> GetAllocatorStats(
+      int64_t device_ordinal) const {
+    return std::nullopt;
+  }
+
  protected:
   const Platform *platform_;
 };
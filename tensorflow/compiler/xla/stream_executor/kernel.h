@@ -424,6 +424,12 @@ class KernelArgsArray : public KernelArgsArrayBase {
     ++number_of_argument_addresses_;
   }
 
+  // Added by Alpa. Replaces the address of the device memory argument at
+  // `index`, which must have been added with add_device_memory_argument().
+  void set_device_memory_argument(size_t index, const DeviceMemoryBase &arg) {
+    device_memory_opaque_pointers_[index] = arg.opaque();
+  }
+
   // Adds a shared memory argument to the list.
   //
   // The only significant information about a shared argument is its size, so
@@ -153,6 +153,15 @@ class MultiDeviceAdapter : public DeviceMemoryAllocator {
     return allocator->ClearStats();
   }
 
+  std::optional<tsl::AllocatorStats> GetAllocatorStats(
+      int64_t device_ordinal) const override {
+    if (device_ordinal < 0 ||
+        device_ordinal >= static_cast<int64_t>(tf_allocators_.size())) {
+      return std::nullopt;
+    }
+    return tf_allocators_[device_ordinal]->GetStats();
+  }
+
  private:
   std::vector<std::unique_ptr<TfAllocatorAdapter>> per_device_allocators_;
   // The wrapped TF allocators backing per_device_allocators_
@@ -18,13 +18,14 @@ limitations under the License.
 #include "tensorflow/compiler/xla/tools/hlo_module_loader.h"
 
 #include <functional>
+#include <limits>
 #include <memory>
 #include <string>
 #include <utility>
 
 #include "absl/strings/str_cat.h"
-#include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
 #include "tensorflow/compiler/xla/debug_options_flags.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
@@ -45,34 +46,54 @@ Status OverrideConfig(const hlo_module_loader_details::Config& ovr_config,
   return OkStatus();
 }
 
+// Added by Alpa. Returns true if a line of `hlo_string` starts with a log
+// header.
+bool ContainsLogHeaders(absl::string_view hlo_string) {
+  static RE2* matcher = new RE2(
+      "(?m)^[IWEF]\\d{4} \\d{2}:\\d{2}:\\d{2}\\.\\d+\\s+\\d+\\s+[^:]+:\\d+\\]");
+  return RE2::PartialMatch(hlo_string, *matcher);
+}
+
 }  // namespace
 
-std::string StripLogHeaders(const std::string& hlo_string) {
+std::string StripLogHeaders(absl::string_view hlo_string) {
   // I0521 12:04:45.883483    1509 service.cc:186] ...
   static RE2* matcher = new RE2(
       "[IWEF]\\d{4} "
       "\\d{2}:\\d{2}:\\d{2}\\.\\d+\\s+\\d+\\s+[^:]+:\\d+\\]\\s?(.*)");
   absl::string_view matches[4];
-  std::vector<std::string> lines = absl::StrSplit(hlo_string, '\n');
-  for (auto& line : lines) {
+  // Added by Alpa: strip the lines one by one into the result, without
+  // splitting the whole dump into a vector of copies first.
+  std::string result;
+  result.reserve(hlo_string.size());
+  bool first = true;
+  for (absl::string_view line : absl::StrSplit(hlo_string, '\n')) {
+    if (!first) {
+      result.push_back('\n');
+    }
+    first = false;
     if (matcher->Match(line, 0, line.size(), RE2::ANCHOR_START, matches, 4)) {
-      line = std::string(matches[1]);
+      line = matches[1];
     }
+    absl::StrAppend(&result, line);
   }
-  return absl::StrJoin(lines, "\n",
-                       [](std::string* out, const std::string& line) {
-                         absl::StrAppend(out, line);
-                       });
+  return result;
 }
 
 StatusOr<std::unique_ptr<HloModule>> LoadModuleFromData(
-    const std::string& data, const std::string& format,
+    absl::string_view data, absl::string_view format,
     hlo_module_loader_details::Config ovr_config,
     const std::function<void(HloModuleConfig*)>& config_modifier_hook) {
   DebugOptions debug_options = GetDebugOptionsFromFlags();
   std::unique_ptr<HloModule> module;
   if (format == "hlo" || format == "txt") {
-    std::string hlo_string = StripLogHeaders(data);
+    // Added by Alpa: only copy the text if it has log headers to strip.
+    std::string stripped;
+    absl::string_view hlo_string = data;
+    if (ContainsLogHeaders(data)) {
+      stripped = StripLogHeaders(data);
+      hlo_string = stripped;
+    }
     HloModuleConfig config;
     config.set_debug_options(debug_options);
     TF_RETURN_IF_ERROR(OverrideConfig(ovr_config, &config));
@@ -84,17 +105,22 @@ StatusOr<std::unique_ptr<HloModule>> LoadModuleFromData(
   } else {
     HloSnapshot proto;
     if (format == "pb") {
-      if (!proto.ParseFromString(data) &&
-          !proto.mutable_hlo()->ParseFromString(data) &&
-          !proto.mutable_hlo()->mutable_hlo_module()->ParseFromString(data)) {
+      // Added by Alpa: parse from the bytes in place, e.g. a mapped file.
+      const int size = static_cast<int>(data.size());
+      if (data.size() > std::numeric_limits<int>::max() ||
+          (!proto.ParseFromArray(data.data(), size) &&
+           !proto.mutable_hlo()->ParseFromArray(data.data(), size) &&
+           !proto.mutable_hlo()->mutable_hlo_module()->ParseFromArray(
+               data.data(), size))) {
         return InvalidArgument("Failed to parse input as HLO protobuf binary");
       }
     } else if (format == "pbtxt") {
-      if (!tsl::protobuf::TextFormat::ParseFromString(data, &proto) &&
-          !tsl::protobuf::TextFormat::ParseFromString(data,
+      std::string text(data);
+      if (!tsl::protobuf::TextFormat::ParseFromString(text, &proto) &&
+          !tsl::protobuf::TextFormat::ParseFromString(text,
                                                       proto.mutable_hlo()) &&
           !tsl::protobuf::TextFormat::ParseFromString(
-              data, proto.mutable_hlo()->mutable_hlo_module())) {
+              text, proto.mutable_hlo()->mutable_hlo_module())) {
         return InvalidArgument("Failed to parse input as HLO protobuf text");
       }
     } else {
@@ -120,11 +146,20 @@ StatusOr<std::unique_ptr<HloModule>> LoadModuleFromFile(
     const std::string& path, hlo_module_loader_details::Config ovr_config,
     std::string format,
     const std::function<void(HloModuleConfig*)>& config_modifier_hook) {
-  std::string data;
   if (format.empty()) {
     format = std::string(tsl::io::Extension(path));
   }
-  TF_RETURN_IF_ERROR(tsl::ReadFileToString(tsl::Env::Default(), path, &data));
+  // Added by Alpa: map the file instead of reading it into a string, so the
+  // text or proto bytes are backed by the page cache rather than the heap.
+  tsl::Env* env = tsl::Env::Default();
+  std::unique_ptr<tsl::ReadOnlyMemoryRegion> region;
+  if (env->NewReadOnlyMemoryRegionFromFile(path, &region).ok()) {
+    absl::string_view data(static_cast<const char*>(region->data()),
+                           region->length());
+    return LoadModuleFromData(data, format, ovr_config, config_modifier_hook);
+  }
+  std::string data;
+  TF_RETURN_IF_ERROR(tsl::ReadFileToString(env, path, &data));
   return LoadModuleFromData(data, format, ovr_config, config_modifier_hook);
 }
 
@@ -20,6 +20,7 @@ limitations under the License.
 #include <memory>
 #include <string>
 
+#include "absl/strings/string_view.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/statusor.h"
 
@@ -36,7 +37,7 @@ struct Config {
 
 // Given a string composed by multiple lines, strip the log headers, if present
 // at the beginning of each line.
-std::string StripLogHeaders(const std::string& hlo_string);
+std::string StripLogHeaders(absl::string_view hlo_string);
 
 // Loads an HLO module from a string.
 // The data can have the followings formats:
@@ -51,7 +52,7 @@ std::string StripLogHeaders(const std::string& hlo_string);
 // The HloModuleConfig is passed to config_modifier_hook for custom
 // modifications before use.
 StatusOr<std::unique_ptr<HloModule>> LoadModuleFromData(
-    const std::string& data, const std::string& format,
+    absl::string_view data, absl::string_view format,
     hlo_module_loader_details::Config ovr_config =
         hlo_module_loader_details::Config(),
     const std::function<void(HloModuleConfig*)>& config_modifier_hook = {});
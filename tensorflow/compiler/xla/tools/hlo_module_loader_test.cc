@@ -17,8 +17,11 @@ limitations under the License.
 
 #include <string>
 
+#include "tensorflow/compiler/xla/literal_util.h"
 #include "tensorflow/compiler/xla/tests/hlo_test_base.h"
 #include "tensorflow/tsl/lib/core/status_test_util.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/path.h"
 #include "tensorflow/tsl/platform/test.h"
 
 namespace xla {
@@ -46,5 +49,28 @@ I0521 12:04:45.883483    1509 service.cc:186] }
   EXPECT_NE(FindInstruction(hlo_module.get(), "rooty"), nullptr);
 }
 
+// Added by Alpa.
+TEST_F(HloModuleLoaderTest, LoadsFromFile) {
+  const std::string hlo_string = R"(
+HloModule test_load_from_file
+
+ENTRY entry {
+  p0 = f32[4]{0} parameter(0)
+  c0 = f32[4]{0} constant({1, 2, 3, 4})
+  ROOT add = f32[4]{0} add(p0, c0)
+}
+)";
+  std::string path =
+      tsl::io::JoinPath(tsl::testing::TmpDir(), "load_from_file.hlo");
+  TF_ASSERT_OK(tsl::WriteStringToFile(tsl::Env::Default(), path, hlo_string));
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> hlo_module,
+                          LoadModuleFromFile(path));
+  EXPECT_EQ(hlo_module->name(), "test_load_from_file");
+  HloInstruction* constant = FindInstruction(hlo_module.get(), "c0");
+  ASSERT_NE(constant, nullptr);
+  EXPECT_EQ(constant->literal(), LiteralUtil::CreateR1<float>({1, 2, 3, 4}));
+}
+
 }  // namespace
 }  // namespace xla
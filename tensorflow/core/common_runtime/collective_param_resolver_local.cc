@@ -21,6 +21,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_join.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
@@ -83,6 +84,45 @@ const char* GetCollectiveName(const CollectiveParams* cp, bool nccl) {
   }
 }
 
+// Added by Alpa. Ring reductions smaller than this are latency bound, so they
+// run as a single ring. Larger ones use several rings of
+// kMaxSubdivsPerDeviceDefault when every task has more than one device and
+// the devices of a task are all directly linked, so that the rings use
+// different links.
+constexpr int64_t kMinSubdividedRingReductionBytes = 8 * 1024 * 1024;
+
+// Added by Alpa. Returns true if every task of `group` has more than one
+// member and each member has an interconnect link to all the other members of
+// its task. Links name their peer by the device id within the task.
+bool LocalDevicesFullyLinked(const CollGroupParams& group) {
+  absl::flat_hash_map<string, std::vector<const DeviceAttributes*>> by_task;
+  for (const CollGroupMember& member : group.members) {
+    by_task[member.task].push_back(&member.device);
+  }
+  for (const auto& it : by_task) {
+    const std::vector<const DeviceAttributes*>& devices = it.second;
+    if (devices.size() < 2) return false;
+    absl::flat_hash_set<int> ids;
+    for (const DeviceAttributes* device : devices) {
+      DeviceNameUtils::ParsedName parsed;
+      if (!DeviceNameUtils::ParseFullName(device->name(), &parsed) ||
+          !parsed.has_id) {
+        return false;
+      }
+      ids.insert(parsed.id);
+    }
+    for (const DeviceAttributes* device : devices) {
+      absl::flat_hash_set<int> linked;
+      for (const InterconnectLink& link : device->locality().links().link()) {
+        if (ids.contains(link.device_id())) linked.insert(link.device_id());
+      }
+      // A device does not link to itself.
+      if (linked.size() + 1 < ids.size()) return false;
+    }
+  }
+  return true;
+}
+
 string TaskNameFromDeviceName(const string& device_name) {
   DeviceNameUtils::ParsedName parsed_device;
   CHECK(DeviceNameUtils::ParseFullName(device_name, &parsed_device));
@@ -691,6 +731,28 @@ void CollectiveParamResolverLocal::CompleteInstanceAsync(
                        "intended only for non-distributed deployment."));
 }
 
+void CollectiveParamResolverLocal::AssignRingSubdivisions(
+    CollectiveParams* cp) {
+  CollImplDetails& details = cp->instance.impl_details;
+  if (cp->instance.type != REDUCTION_COLLECTIVE ||
+      details.collective_name != "RingReduce" ||
+      !details.subdiv_offsets.empty() || details.max_subdivs_per_device != -1 ||
+      (!details.communication_hint.empty() &&
+       details.communication_hint != "auto")) {
+    return;
+  }
+  const int64_t bytes =
+      cp->instance.shape.num_elements() * DataTypeSize(cp->instance.data_type);
+  if (bytes >= kMinSubdividedRingReductionBytes &&
+      LocalDevicesFullyLinked(cp->group)) {
+    // 0 selects the default upper bound in GenerateSubdivsInCollectiveParams,
+    // which still keeps each chunk at most kMaxChunkSizeBytes.
+    details.max_subdivs_per_device = 0;
+  }
+  VLOG(1) << "AssignRingSubdivisions bytes " << bytes
+          << " max_subdivs_per_device " << details.max_subdivs_per_device;
+}
+
 // TODO(b/111897089): we need a better way to pick the collective
 // implementation.  The ideal way would depend upon the topology and link
 // strength before picking a particular implementation.
@@ -710,6 +772,8 @@ void CollectiveParamResolverLocal::AssignCollectiveType(CollectiveParams* cp) {
   cp->instance.impl_details.collective_name = GetCollectiveName(cp, use_nccl);
   VLOG(1) << "AssignCollectiveType "
           << cp->instance.impl_details.collective_name;
+  // Added by Alpa
+  AssignRingSubdivisions(cp);
 }
 
 void CollectiveParamResolverLocal::CompleteInstanceLocal(
@@ -182,6 +182,12 @@ class CollectiveParamResolverLocal : public ParamResolverInterface {
   // best implementation.
   void AssignCollectiveType(CollectiveParams* cp);
 
+  // Added by Alpa. Picks cp->instance.impl_details.max_subdivs_per_device for
+  // a ring reduction whose subdivisions are neither given by the user nor
+  // constrained by communication_hint, from the size of the reduced tensor
+  // and the interconnect links between the devices of each task in the group.
+  static void AssignRingSubdivisions(CollectiveParams* cp);
+
   void StartAbortLocal(const Status& s)
       TF_LOCKS_EXCLUDED(status_mu_, group_mu_, instance_mu_);
 
@@ -77,6 +77,36 @@ class CollectiveParamResolverLocalTest : public ::testing::Test {
     EXPECT_EQ(actual_device_order, expected_device_order);
   }
 
+  // Returns the max_subdivs_per_device chosen for a ring reduction of
+  // `num_elements` floats on 2 tasks of 2 GPUs, whose GPUs are linked within
+  // their task if `linked`.
+  int AssignRingSubdivisions(int64_t num_elements, bool linked) {
+    CollectiveParams* cp = new CollectiveParams();
+    core::ScopedUnref unref(cp);
+    cp->group.device_type = DeviceType("GPU");
+    for (int task = 0; task < 2; ++task) {
+      for (int id = 0; id < 2; ++id) {
+        CollGroupMember member;
+        member.task = strings::StrCat("/job:worker/replica:0/task:", task);
+        member.device.set_name(
+            strings::StrCat(member.task, "/device:GPU:", id));
+        if (linked) {
+          InterconnectLink* link =
+              member.device.mutable_locality()->mutable_links()->add_link();
+          link->set_device_id(1 - id);
+          link->set_strength(1);
+        }
+        cp->group.members.push_back(member);
+      }
+    }
+    cp->instance.type = REDUCTION_COLLECTIVE;
+    cp->instance.data_type = DT_FLOAT;
+    cp->instance.shape = TensorShape({num_elements});
+    cp->instance.impl_details.collective_name = "RingReduce";
+    CollectiveParamResolverLocal::AssignRingSubdivisions(cp);
+    return cp->instance.impl_details.max_subdivs_per_device;
+  }
+
   DeviceAttributes GetDeviceAttributes(const string& device_name) {
     Device* device = nullptr;
     TF_CHECK_OK(device_mgr_->LookupDevice(device_name, &device));
@@ -208,6 +238,14 @@ TEST_F(CollectiveParamResolverLocalTest, CompleteParamsReduction1Task) {
   }
 }
 
+TEST_F(CollectiveParamResolverLocalTest, AssignRingSubdivisions) {
+  // Large reductions over linked devices use several rings.
+  EXPECT_EQ(AssignRingSubdivisions(4 * 1024 * 1024, /*linked=*/true), 0);
+  // Small reductions and unlinked devices use a single ring.
+  EXPECT_EQ(AssignRingSubdivisions(1024, /*linked=*/true), -1);
+  EXPECT_EQ(AssignRingSubdivisions(4 * 1024 * 1024, /*linked=*/false), -1);
+}
+
 void InitializeCollectiveParamsForBroadcast(int instance_key, int device_idx,
                                             bool is_source,
                                             CollectiveParams* cp) {
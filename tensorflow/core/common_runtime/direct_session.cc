@@ -40,6 +40,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
 #include "tensorflow/core/common_runtime/scoped_allocator_mgr.h"
+#include "tensorflow/core/common_runtime/static_memory_plan_allocator.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/graph.pb.h"
@@ -90,6 +91,9 @@ auto* direct_session_runs = monitoring::Counter<0>::New(
     "/tensorflow/core/direct_session_runs",
     "The number of times DirectSession::Run() has been called.");
 
+// Added by Alpa. The maximum size of the arena of a static memory plan.
+constexpr size_t kMaxStaticMemoryPlanBytes = size_t{1} << 30;
+
 Status NewThreadPoolFromThreadPoolOptions(
     const SessionOptions& options,
     const ThreadPoolOptionProto& thread_pool_options, int pool_number,
@@ -98,6 +102,9 @@ Status NewThreadPoolFromThreadPoolOptions(
   if (num_threads == 0) {
     num_threads = NumInterOpThreadsFromSessionOptions(options);
   }
+  const bool numa_partitioned =
+      thread_pool_options.numa_partitioned() ||
+      options.config.experimental().numa_partitioned_inter_op_pool();
   const string& name = thread_pool_options.global_name();
   if (name.empty()) {
     // Session-local threadpool.
@@ -106,7 +113,7 @@ Status NewThreadPoolFromThreadPoolOptions(
     *pool = new thread::ThreadPool(
         options.env, ThreadOptions(), strings::StrCat("Compute", pool_number),
         num_threads, !options.config.experimental().disable_thread_spinning(),
-        /*allocator=*/nullptr);
+        /*allocator=*/nullptr, numa_partitioned);
     *owned = true;
     return OkStatus();
   }
@@ -123,7 +130,7 @@ Status NewThreadPoolFromThreadPoolOptions(
     mvalue->second = new thread::ThreadPool(
         options.env, ThreadOptions(), strings::StrCat("Compute", pool_number),
         num_threads, !options.config.experimental().disable_thread_spinning(),
-        /*allocator=*/nullptr);
+        /*allocator=*/nullptr, numa_partitioned);
   } else {
     if (mvalue->first != thread_pool_options.num_threads()) {
       return errors::InvalidArgument(
@@ -778,6 +785,14 @@ Status DirectSession::RunInternal(
 
   TF_RETURN_IF_ERROR(run_status);
 
+  // Added by Alpa: plan the arenas from the allocations of the first
+  // successful run.
+  for (const auto& item : executors_and_keys->items) {
+    if (item.static_memory_plan) {
+      item.static_memory_plan->FinishRecording();
+    }
+  }
+
   // Save the output tensors of this run we choose to keep.
   if (!run_state.tensor_store.empty()) {
     TF_RETURN_IF_ERROR(run_state.tensor_store.SaveTensors(
@@ -1389,6 +1404,13 @@ Status DirectSession::CreateExecutors(
     params.device = device;
     params.session_metadata = session_metadata;
     params.function_library = lib;
+    // Added by Alpa.
+    if (options_.config.experimental().use_static_memory_plan()) {
+      item->static_memory_plan.reset(new StaticMemoryPlanAllocator(
+          device->GetAllocator(AllocatorAttributes()),
+          kMaxStaticMemoryPlanBytes));
+      params.intermediate_allocator = item->static_memory_plan.get();
+    }
     auto opseg = device->op_segment();
     params.create_kernel =
         [this, lib, opseg](const std::shared_ptr<const NodeProperties>& props,
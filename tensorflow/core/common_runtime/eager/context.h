@@ -264,6 +264,11 @@ class EagerContext : public ImmediateExecutionContext, public core::RefCounted {
 
   void AddKernelToCache(Fprint128 cache_key, KernelAndDevice* kernel);
   void AddDeviceToCache(Fprint128 device_cache_key, Device* device);
+  // Added by Alpa. Incremented whenever the kernel cache is cleared, so that
+  // kernels cached by an EagerOperation can be dropped with it.
+  int64_t KernelCacheGeneration() const {
+    return kernel_cache_generation_.load(std::memory_order_acquire);
+  }
 
   bool LogDevicePlacement() const { return log_device_placement_; }
   void SetLogDevicePlacement(bool enable) override {
@@ -723,6 +728,7 @@ class EagerContext : public ImmediateExecutionContext, public core::RefCounted {
       TF_GUARDED_BY(cache_mu_);
   absl::flat_hash_map<Fprint128, Device*, Fprint128Hasher> device_cache_
       TF_GUARDED_BY(device_cache_mu_);
+  std::atomic<int64_t> kernel_cache_generation_{0};  // Added by Alpa
 
   // Whether we should compute RunMetadata.
   std::atomic<bool> should_store_graphs_{false};
@@ -40,6 +40,29 @@ void EagerOperation::Clear() {
   ClearInferenceState();
 }
 
+// Added by Alpa
+KernelAndDevice* EagerOperation::GetCachedKernel(const Fprint128& signature,
+                                                 Device** device) {
+  if (cached_kernel_ == nullptr) return nullptr;
+  if (cached_kernel_generation_ != ctx_.KernelCacheGeneration()) {
+    cached_kernel_.reset();
+    return nullptr;
+  }
+  if (!(cached_kernel_signature_ == signature)) return nullptr;
+  *device = cached_kernel_device_;
+  return cached_kernel_.get();
+}
+
+// Added by Alpa
+void EagerOperation::CacheKernel(const Fprint128& signature,
+                                 KernelAndDevice* kernel, Device* device) {
+  kernel->Ref();
+  cached_kernel_.reset(kernel);
+  cached_kernel_signature_ = signature;
+  cached_kernel_generation_ = ctx_.KernelCacheGeneration();
+  cached_kernel_device_ = device;
+}
+
 Status EagerOperation::SetAttrValue(const char* attr_name,
                                     const AttrValue& value) {
   MutableAttrs()->Set(attr_name, value);
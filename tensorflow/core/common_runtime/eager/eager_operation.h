@@ -216,6 +216,21 @@ class EagerOperation : public ImmediateExecutionOperation {
   // Op name recorded for memory debugging purpose.
   const char* op_name() const { return op_name_; }
 
+  // Added by Alpa. The kernel of the last execution of this operation, keyed
+  // by its signature: the op name, attrs and device name of the operation
+  // before placement, and the soft placement policy. An operation that is
+  // executed repeatedly with new inputs (replaced with SetInput(), or with
+  // Clear() and AddInput()) reuses this kernel and its device without the
+  // device selection and the kernel cache lookup. The kernel is kept across
+  // Reset(), since the signature includes the op name.
+  //
+  // Returns the kernel cached with `signature`, or nullptr. `device` is set to
+  // the device the operation was placed on.
+  KernelAndDevice* GetCachedKernel(const Fprint128& signature,
+                                   Device** device);
+  void CacheKernel(const Fprint128& signature, KernelAndDevice* kernel,
+                   Device* device);
+
   // For LLVM style RTTI.
   static bool classof(const AbstractOperation* ptr) {
     return ptr->getKind() == kEager;
@@ -279,6 +294,13 @@ class EagerOperation : public ImmediateExecutionOperation {
 
   absl::optional<EagerFunctionParams> eager_func_params_;
 
+  // Added by Alpa. See GetCachedKernel(). The kernel is dropped when the
+  // kernel cache of the context is cleared.
+  Fprint128 cached_kernel_signature_ = {0, 0};
+  int64_t cached_kernel_generation_ = 0;
+  core::RefCountPtr<KernelAndDevice> cached_kernel_;
+  Device* cached_kernel_device_ = nullptr;
+
   // Inference information
   const tensorflow::OpDef* op_def_;  // op definition from protobuf
   int inference_arg_idx_;  // arg definition index for the next input to be
@@ -1049,16 +1049,56 @@ Fprint128 GetDeviceCacheKey(EagerOperation* op, const EagerContext& ctx) {
   return device_cache_key;
 }
 
+// Added by Alpa. Checks that `kernel` has at most `*num_retvals` outputs and
+// returns it in `out_kernel`.
+Status SetKernelOutput(KernelAndDevice* kernel, int* num_retvals,
+                       core::RefCountPtr<KernelAndDevice>* out_kernel) {
+  int num_outputs = kernel->num_outputs();
+  if (num_outputs > *num_retvals) {
+    return errors::InvalidArgument("Expecting ", num_outputs,
+                                   " outputs, but *num_retvals is ",
+                                   *num_retvals);
+  }
+  *num_retvals = num_outputs;
+
+  kernel->Ref();  // Ownership of reference is passed to out_kernel.
+  out_kernel->reset(kernel);
+  return OkStatus();
+}
+
 Status GetOrCreateKernelAndDevice(
     EagerOperation* op, TensorHandle** retvals, int* num_retvals,
     core::RefCountPtr<KernelAndDevice>* out_kernel) {
   EagerContext& ctx = op->EagerContext();
   Device* device = absl::get<Device*>(op->Device());
 
+  // Added by Alpa. Reuse the kernel of the last execution of `op` if its
+  // signature did not change, skipping the device selection and the kernel
+  // cache lookup. The signature is the device cache key. Functions and ops run
+  // as functions also key their kernels on the input devices, so they always
+  // take the slow path.
+  const bool use_op_kernel_cache =
+      !op->is_function() && !ctx.RunEagerOpAsFunction();
+  Fprint128 signature = {0, 0};
+  if (use_op_kernel_cache) {
+    signature = GetDeviceCacheKey(op, ctx);
+    Device* cached_device = nullptr;
+    KernelAndDevice* cached_kernel =
+        op->GetCachedKernel(signature, &cached_device);
+    if (cached_kernel != nullptr &&
+        (device == nullptr || device == cached_device)) {
+      if (device == nullptr) {
+        op->SetDevice(cached_device);
+      }
+      return SetKernelOutput(cached_kernel, num_retvals, out_kernel);
+    }
+  }
+
   // Set the EagerOperation's device prior to extracting the input_device_ptrs
   // to avoid any redundant H2D/D2H copies.
   if (device == nullptr && !op->is_function()) {
-    Fprint128 device_cache_key = GetDeviceCacheKey(op, ctx);
+    Fprint128 device_cache_key =
+        use_op_kernel_cache ? signature : GetDeviceCacheKey(op, ctx);
     device = ctx.GetCachedDevice(device_cache_key);
     if (device == nullptr) {
       TF_RETURN_IF_ERROR(SetOpDevice(ctx, op, &device));
@@ -1098,6 +1138,7 @@ Status GetOrCreateKernelAndDevice(
                         input_device_ptrs,
                         input_resource_variable_dtypes_and_shapes));
   core::RefCountPtr<KernelAndDevice> kernel = ctx.GetCachedKernel(cache_key);
+  bool kernel_cacheable = true;  // Added by Alpa
   AbstractOperationPtr wrapped_op_releaser;
   // We can eliminate some overhead by running simple functions using regular
   // CallOp kernel. However, it is tricky to figure out which functions should
@@ -1255,23 +1296,18 @@ Status GetOrCreateKernelAndDevice(
       // programs that build input pipeline graphs in a loop.
       const OpDef* op_def;
       TF_RETURN_IF_ERROR(OpDefForOp(op->Name().data(), &op_def));
-      if (KernelCacheEnabled(*op_def)) {
+      kernel_cacheable = KernelCacheEnabled(*op_def);
+      if (kernel_cacheable) {
         ctx.AddKernelToCache(cache_key, kernel.get());
       }
     }
   }
 
-  int num_outputs = kernel->num_outputs();
-  if (num_outputs > *num_retvals) {
-    return errors::InvalidArgument("Expecting ", num_outputs,
-                                   " outputs, but *num_retvals is ",
-                                   *num_retvals);
+  // Added by Alpa
+  if (use_op_kernel_cache && kernel_cacheable) {
+    op->CacheKernel(signature, kernel.get(), absl::get<Device*>(op->Device()));
   }
-  *num_retvals = num_outputs;
-
-  kernel->Ref();  // Ownership of reference is passed to out_kernel.
-  out_kernel->reset(kernel.get());
-  return OkStatus();
+  return SetKernelOutput(kernel.get(), num_retvals, out_kernel);
 }
 
 Status CreateUnshapedOutput(
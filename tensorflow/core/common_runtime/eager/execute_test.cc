@@ -58,5 +58,62 @@ TEST(ExecuteTest, EagerOperationAsFunction) {
   ctx->Unref();
 }
 
+TEST(ExecuteTest, ReusesCachedKernelWithNewInputs) {
+  StaticDeviceMgr device_mgr(
+      DeviceFactory::NewDevice("CPU", {}, "/job:localhost/replica:0/task:0"));
+  auto ctx = new EagerContext(
+      SessionOptions(),
+      tensorflow::ContextDevicePlacementPolicy::DEVICE_PLACEMENT_EXPLICIT,
+      false, &device_mgr, false, nullptr, nullptr);
+  ctx->SetRunEagerOpAsFunction(false);
+
+  auto op = std::make_unique<EagerOperation>(ctx);
+  TF_ASSERT_OK(op->Reset(
+      /*op=*/"Mul",
+      /*raw_device_name=*/"/job:localhost/replica:0/task:0/device:CPU:0"));
+  std::vector<core::RefCountPtr<ImmediateExecutionTensorHandle>> inputs;
+  for (int64_t value : {3, 2, 5}) {
+    inputs.emplace_back(ctx->CreateLocalHandleFromTFTensor(
+        test::AsScalar<int64_t>(value), ctx->HostCPUName().c_str()));
+  }
+  TF_ASSERT_OK(op->AddInput(inputs[0].get()));
+  TF_ASSERT_OK(op->AddInput(inputs[1].get()));
+
+  auto execute = [&](int64_t expected) {
+    std::vector<TensorHandle*> retvals(1);
+    int num_retvals = retvals.size();
+    TF_ASSERT_OK(EagerExecute(op.get(), retvals.data(), &num_retvals));
+    const Tensor* result;
+    TF_ASSERT_OK(retvals[0]->Tensor(&result));
+    test::ExpectTensorEqual<int64_t>(*result,
+                                     test::AsScalar<int64_t>(expected));
+    retvals[0]->Unref();
+  };
+  // The kernel is cached with the signature of the placed op, which may differ
+  // from the one before the first execution.
+  execute(6);
+  execute(6);
+  const Fprint128 signature =
+      FingerprintCat128(op->MutableAttrs()->CacheKey(op->DeviceName()),
+                        ctx->AllowSoftPlacement());
+  Device* device = nullptr;
+  KernelAndDevice* kernel = op->GetCachedKernel(signature, &device);
+  ASSERT_NE(kernel, nullptr);
+  EXPECT_EQ(device, absl::get<Device*>(op->Device()));
+
+  // The op is executed again with a new input and the cached kernel.
+  TF_ASSERT_OK(op->SetInput(1, inputs[2].get()));
+  execute(15);
+  EXPECT_EQ(op->GetCachedKernel(signature, &device), kernel);
+
+  // Clearing the kernel cache of the context drops the kernel of the op.
+  ctx->ClearCachesAndThreadExecutors();
+  EXPECT_EQ(op->GetCachedKernel(signature, &device), nullptr);
+  execute(15);
+
+  op.reset();
+  ctx->Unref();
+}
+
 }  // namespace
 }  // namespace tensorflow
@@ -336,6 +336,13 @@ class ExecutorState {
   // REQUIRES: `!ready->empty()`.
   void ScheduleReady(TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready);
 
+  // Added by Alpa. Schedules `nodes` in tasks of up to `batch_size` nodes.
+  // A task processes its nodes and their inexpensive successors inline.
+  //
+  // This method will clear `*nodes` before returning.
+  void ScheduleBatches(TaggedNodeSeq* nodes, int64_t batch_size,
+                       int64_t scheduled_nsec);
+
   // A wrapper for runner_ to keep track of the pending queue length. Op
   // execution should dispatch work using this function instead of using runner_
   // directly.
@@ -365,6 +372,12 @@ class ExecutorState {
   // TODO(fishx): Make it configurable if necessary.
   static constexpr uint64 kInlineScheduleReadyThreshold = 500;
 
+  // Added by Alpa. Maximum number of inexpensive kernels that are scheduled
+  // together in one task when they are not run inline. Batching them avoids a
+  // closure and a kernel context setup per kernel in graphs of many tiny ops,
+  // while keeping enough tasks for the other threads to pick up.
+  static constexpr int64_t kInexpensiveNodesPerTask = 16;
+
   // Not owned.
   RendezvousInterface* rendezvous_;
   CollectiveExecutor* collective_executor_ = nullptr;
@@ -737,6 +750,8 @@ void ExecutorState<PropagatorStateType>::ProcessInline(
   params.slice_reader_cache = slice_reader_cache_;
   params.runner = &runner_;
   params.run_all_kernels_inline = run_all_kernels_inline_;
+  params.intermediate_allocator =
+      immutable_state_.params().intermediate_allocator;  // Added by Alpa
   params.stats_collector = stats_collector_;
   params.inc_num_deferred_ops_function = [this]() {
     mutex_lock lock(num_deferred_ops_mu_);
@@ -1250,17 +1265,36 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
     const TaggedNode* curr_expensive_node = nullptr;
     TaggedNodeSeq expensive_nodes;
     if (inline_ready == nullptr) {
-      // Schedule to run all the ready ops in thread pool.
+      // Schedule to run all the ready ops in thread pool. Added by Alpa: the
+      // inexpensive ops are scheduled in batches.
+      TaggedNodeSeq inexpensive_nodes;
       for (auto& tagged_node : *ready) {
-        RunTask([=]() { Process(tagged_node, scheduled_nsec); },
-                /*sample_rate=*/ready->size());
+        const NodeItem& item = *tagged_node.node_item;
+        if (tagged_node.get_is_dead() || !kernel_stats_->IsExpensive(item)) {
+          inexpensive_nodes.push_back(tagged_node);
+        } else {
+          RunTask([=]() { Process(tagged_node, scheduled_nsec); },
+                  /*sample_rate=*/ready->size());
+        }
       }
+      ScheduleBatches(&inexpensive_nodes, kInexpensiveNodesPerTask,
+                      scheduled_nsec);
     } else {
+      // Added by Alpa: if too many inexpensive nodes are ready at the same
+      // time, only inline the first kInlineScheduleReadyThreshold of them and
+      // schedule the others in batches on other threads.
+      uint64 num_inlined = 0;
+      TaggedNodeSeq inexpensive_overflow;
       for (auto& tagged_node : *ready) {
         const NodeItem& item = *tagged_node.node_item;
         if (tagged_node.get_is_dead() || !kernel_stats_->IsExpensive(item)) {
-          // Inline this inexpensive node.
-          inline_ready->push_back(tagged_node);
+          if (num_inlined < kInlineScheduleReadyThreshold) {
+            // Inline this inexpensive node.
+            inline_ready->push_back(tagged_node);
+            ++num_inlined;
+          } else {
+            inexpensive_overflow.push_back(tagged_node);
+          }
         } else {
           if (curr_expensive_node) {
             expensive_nodes.push_back(*curr_expensive_node);
@@ -1268,6 +1302,8 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
           curr_expensive_node = &tagged_node;
         }
       }
+      ScheduleBatches(&inexpensive_overflow, kInlineScheduleReadyThreshold,
+                      scheduled_nsec);
     }
     if (curr_expensive_node) {
       if (inline_ready->empty()) {
@@ -1288,9 +1324,6 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
       } else {
         // There are too many ready expensive nodes. Schedule them in child
         // threads.
-        // TODO(fishx): Apply the same optimization to cheap ops as well since
-        // executing lots of cheap ops in one thread can potentially be the
-        // bottleneck as well.
         auto it = expensive_nodes.begin();
         while (it < expensive_nodes.end()) {
           auto end = it;
@@ -1323,6 +1356,26 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
   ready->clear();
 }
 
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::ScheduleBatches(
+    TaggedNodeSeq* nodes, int64_t batch_size, int64_t scheduled_nsec) {
+  const int64_t num_nodes = nodes->size();
+  for (int64_t begin = 0; begin < num_nodes; begin += batch_size) {
+    const int64_t end = std::min(begin + batch_size, num_nodes);
+    TaggedNodeSeq batch{nodes->begin() + begin, nodes->begin() + end};
+    RunTask(
+        [this, batch = std::move(batch), scheduled_nsec]() {
+          TaggedNodeReadyQueue inline_ready;
+          for (auto& tagged_node : batch) {
+            inline_ready.push_back(tagged_node);
+          }
+          ProcessInline(&inline_ready, scheduled_nsec);
+        },
+        /*sample_rate=*/num_nodes);
+  }
+  nodes->clear();
+}
+
 template <class PropagatorStateType>
 void ExecutorState<PropagatorStateType>::ScheduleFinish() {
   // Checks condition to decide if needs to invoke Finish(). If there are
@@ -261,6 +261,34 @@ TEST_F(ExecutorTest, RandomTree) {
   EXPECT_EQ(4096.0, V(out));
 }
 
+// Added by Alpa. Many inexpensive nodes are ready at the start and after the
+// first level of adds, so they are scheduled in batches.
+TEST_F(ExecutorTest, ManyInexpensiveRoots) {
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  const int N = 2048;
+  std::vector<Node*> nodes;
+  for (int i = 0; i < N; ++i) {
+    nodes.push_back(test::graph::Constant(g.get(), V(1.0)));
+  }
+  while (nodes.size() > 1) {
+    std::vector<Node*> sums;
+    for (int i = 0; i + 1 < nodes.size(); i += 2) {
+      sums.push_back(test::graph::Add(g.get(), nodes[i], nodes[i + 1]));
+    }
+    nodes = std::move(sums);
+  }
+  test::graph::Send(g.get(), nodes[0], "b", BOB, 1, ALICE);
+  FixupSourceAndSinkEdges(g.get());
+  Create(std::move(g));
+  TF_ASSERT_OK(Run(rendez_));
+  Rendezvous::Args args;
+  Tensor out = V(-1);
+  bool is_dead = false;
+  TF_ASSERT_OK(
+      rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out, &is_dead));
+  EXPECT_EQ(static_cast<float>(N), V(out));
+}
+
 void BuildConcurrentAddAssign(Graph* g) {
   auto one = test::graph::Constant(g, V(1.0));
   // A variable holds one float.
@@ -90,6 +90,7 @@ GPUBFCAllocator::GPUBFCAllocator(std::unique_ptr<SubAllocator> sub_allocator,
           o.garbage_collection = GetGarbageCollectionValue();
         }
         o.fragmentation_fraction = opts.fragmentation_fraction;
+        o.small_chunk_cache_bytes = opts.small_chunk_cache_bytes;
         return o;
       }()) {}
 
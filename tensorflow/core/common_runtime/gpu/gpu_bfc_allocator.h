@@ -50,6 +50,9 @@ class GPUBFCAllocator : public BFCAllocator {
 
     double fragmentation_fraction = 0;
     bool allow_retry_on_failure = true;
+
+    // Added by Alpa. See BFCAllocator::Options.
+    size_t small_chunk_cache_bytes = 0;
   };
 
   GPUBFCAllocator(std::unique_ptr<SubAllocator> sub_allocator,
@@ -261,6 +261,37 @@ TEST_P(GPUBFCAllocatorTest, TestCustomMemoryLimit) {
   a.DeallocateRaw(first_ptr);
 }
 
+TEST_P(GPUBFCAllocatorTest, SmallChunkCache) {
+  GPUBFCAllocator::Options opts;
+  opts.allow_retry_on_failure = false;
+  opts.small_chunk_cache_bytes = 16 << 20;
+  GPUBFCAllocator a(GetParam()(1ull << 32), 2 << 20, "GPU_0_bfc", opts);
+
+  // A freed small chunk is reused for the same size class and doesn't count
+  // as in use while it is cached.
+  void* first_ptr = a.AllocateRaw(1, 1000);
+  a.DeallocateRaw(first_ptr);
+  CheckStats(&a, 1, 0, 1024, 1024);
+  void* second_ptr = a.AllocateRaw(1, 1024);
+  EXPECT_EQ(first_ptr, second_ptr);
+  CheckStats(&a, 2, 1024, 1024, 1024);
+  a.DeallocateRaw(second_ptr);
+
+  // Fill half of the memory with cached chunks, which are flushed back to the
+  // bins when a larger allocation doesn't fit.
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 16; ++i) {
+    ptrs.push_back(a.AllocateRaw(1, 64 << 10));
+    EXPECT_NE(nullptr, ptrs.back());
+  }
+  for (void* ptr : ptrs) {
+    a.DeallocateRaw(ptr);
+  }
+  void* large_ptr = a.AllocateRaw(1, 3 << 19);
+  EXPECT_NE(nullptr, large_ptr);
+  a.DeallocateRaw(large_ptr);
+}
+
 TEST_P(GPUBFCAllocatorTest, AllocationsAndDeallocationsWithGrowth) {
   GPUOptions options;
   options.set_allow_growth(true);
@@ -372,7 +372,23 @@ size_t GpuCudaMallocAsyncAllocator::AllocatedSize(const void* ptr) const {
 absl::optional<AllocatorStats> GpuCudaMallocAsyncAllocator::GetStats() {
   if (!stats_) return absl::nullopt;
   mutex_lock l(lock_);
-  return *stats_;
+  AllocatorStats stats = *stats_;
+#if TF_CUDA_MALLOC_ASYNC_SUPPORTED && CUDA_VERSION >= 11030
+  // Added by Alpa. Report the memory held by the pool like the regions of the
+  // BFC allocator.
+  if (pool_) {
+    cuuint64_t mem_reserved_current;
+    cuuint64_t mem_reserved_high;
+    if (!cuMemPoolGetAttribute(pool_, CU_MEMPOOL_ATTR_RESERVED_MEM_CURRENT,
+                               &mem_reserved_current) &&
+        !cuMemPoolGetAttribute(pool_, CU_MEMPOOL_ATTR_RESERVED_MEM_HIGH,
+                               &mem_reserved_high)) {
+      stats.bytes_reserved = static_cast<int64_t>(mem_reserved_current);
+      stats.peak_bytes_reserved = static_cast<int64_t>(mem_reserved_high);
+    }
+  }
+#endif
+  return stats;
 }
 
 bool GpuCudaMallocAsyncAllocator::ClearStats() {
@@ -381,6 +397,18 @@ bool GpuCudaMallocAsyncAllocator::ClearStats() {
   stats_->num_allocs = 0;
   stats_->peak_bytes_in_use = stats_->bytes_in_use;
   stats_->largest_alloc_size = 0;
+#if TF_CUDA_MALLOC_ASYNC_SUPPORTED && CUDA_VERSION >= 11030
+  // Added by Alpa. Setting the high watermarks to zero resets them to the
+  // current values.
+  if (pool_) {
+    cuuint64_t zero = 0;
+    if (auto result = cuMemPoolSetAttribute(
+            pool_, CU_MEMPOOL_ATTR_RESERVED_MEM_HIGH, &zero)) {
+      LOG(ERROR) << "Failed to reset the reserved memory high watermark: "
+                 << GetCudaErrorMessage(result);
+    }
+  }
+#endif
   return true;
 }
 
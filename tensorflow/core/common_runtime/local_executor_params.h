@@ -20,6 +20,7 @@ limitations under the License.
 #include <memory>
 
 namespace tsl {
+class Allocator;
 class Status;
 }
 namespace tensorflow {
@@ -29,6 +30,7 @@ class SessionMetadata;
 class FunctionLibraryRuntime;
 class NodeProperties;
 class OpKernel;
+using tsl::Allocator;
 using tsl::Status;
 
 // LocalExecutorParams provides arguments that will be shared by all invocations
@@ -52,6 +54,10 @@ struct LocalExecutorParams {
 
   // Whether control flow nodes are allowed to be executed synchronously.
   bool allow_control_flow_sync_execution = false;
+
+  // Added by Alpa. If not null, serves the kernel allocations with default
+  // attributes instead of the device allocator. Not owned.
+  Allocator* intermediate_allocator = nullptr;
 };
 
 }  // end namespace tensorflow
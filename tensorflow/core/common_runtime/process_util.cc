@@ -80,7 +80,8 @@ static thread::ThreadPool* InitComputePool(const SessionOptions& options) {
   return new thread::ThreadPool(
       Env::Default(), ThreadOptions(), "Compute", inter_op_parallelism_threads,
       !options.config.experimental().disable_thread_spinning(),
-      /*allocator=*/nullptr);
+      /*allocator=*/nullptr,
+      options.config.experimental().numa_partitioned_inter_op_pool());
 }
 
 }  // namespace
@@ -160,7 +161,8 @@ thread::ThreadPool* NewThreadPoolFromSessionOptions(
   return new thread::ThreadPool(
       options.env, ThreadOptions(), "Compute", num_threads,
       !options.config.experimental().disable_thread_spinning(),
-      /*allocator=*/nullptr);
+      /*allocator=*/nullptr,
+      options.config.experimental().numa_partitioned_inter_op_pool());
 }
 
 void SchedClosure(std::function<void()> closure) {
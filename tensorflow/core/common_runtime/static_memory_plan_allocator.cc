@@ -0,0 +1,156 @@
+#include "tensorflow/core/common_runtime/static_memory_plan_allocator.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/strcat.h"
+
+namespace tensorflow {
+namespace {
+
+size_t RoundUpToAlignment(size_t num_bytes) {
+  return (num_bytes + Allocator::kAllocatorAlignment - 1) /
+         Allocator::kAllocatorAlignment * Allocator::kAllocatorAlignment;
+}
+
+}  // namespace
+
+StaticMemoryPlanAllocator::StaticMemoryPlanAllocator(Allocator* base,
+                                                     size_t max_arena_bytes)
+    : base_(base), max_arena_bytes_(max_arena_bytes) {}
+
+StaticMemoryPlanAllocator::~StaticMemoryPlanAllocator() {
+  if (arena_ != nullptr) {
+    base_->DeallocateRaw(arena_);
+  }
+}
+
+std::string StaticMemoryPlanAllocator::Name() {
+  return strings::StrCat("static_memory_plan_", base_->Name());
+}
+
+void* StaticMemoryPlanAllocator::AllocateRaw(size_t alignment,
+                                             size_t num_bytes) {
+  return AllocateRaw(alignment, num_bytes, AllocationAttributes());
+}
+
+void* StaticMemoryPlanAllocator::AllocateRaw(
+    size_t alignment, size_t num_bytes,
+    const AllocationAttributes& allocation_attr) {
+  const size_t size = RoundUpToAlignment(num_bytes);
+  const bool plannable = num_bytes > 0 && alignment <= kAllocatorAlignment;
+  {
+    mutex_lock l(mu_);
+    if (planned_ && plannable) {
+      auto it = free_slots_.find(size);
+      if (it != free_slots_.end() && !it->second.empty()) {
+        char* slot = it->second.back();
+        it->second.pop_back();
+        ++num_arena_allocations_;
+        Ref();
+        return slot;
+      }
+    }
+  }
+  void* ptr = base_->AllocateRaw(alignment, num_bytes, allocation_attr);
+  if (ptr == nullptr) {
+    return nullptr;
+  }
+  if (plannable) {
+    mutex_lock l(mu_);
+    if (!planned_) {
+      recorded_[ptr] = size;
+      SizeRecord& record = sizes_[size];
+      record.peak = std::max(record.peak, ++record.live);
+    }
+  }
+  Ref();
+  return ptr;
+}
+
+void StaticMemoryPlanAllocator::DeallocateRaw(void* ptr) {
+  bool from_arena = false;
+  {
+    mutex_lock l(mu_);
+    auto slot = slot_sizes_.find(static_cast<const char*>(ptr));
+    if (slot != slot_sizes_.end()) {
+      free_slots_[slot->second].push_back(static_cast<char*>(ptr));
+      from_arena = true;
+    } else if (!planned_) {
+      auto it = recorded_.find(ptr);
+      if (it != recorded_.end()) {
+        --sizes_[it->second].live;
+        recorded_.erase(it);
+      }
+    }
+  }
+  if (!from_arena) {
+    base_->DeallocateRaw(ptr);
+  }
+  Unref();
+}
+
+void StaticMemoryPlanAllocator::FinishRecording() {
+  mutex_lock l(mu_);
+  if (planned_) {
+    return;
+  }
+  planned_ = true;
+  // Plans the smallest sizes first, which save the most allocations per byte
+  // of the arena.
+  std::vector<std::pair<size_t, int64_t>> peaks;
+  peaks.reserve(sizes_.size());
+  for (const auto& [size, record] : sizes_) {
+    peaks.emplace_back(size, record.peak);
+  }
+  std::sort(peaks.begin(), peaks.end());
+  size_t total_bytes = 0;
+  int64_t num_planned_sizes = 0;
+  for (; num_planned_sizes < peaks.size(); ++num_planned_sizes) {
+    const auto& [size, count] = peaks[num_planned_sizes];
+    if (total_bytes + size * count > max_arena_bytes_) {
+      break;
+    }
+    total_bytes += size * count;
+  }
+  recorded_.clear();
+  sizes_.clear();
+  if (total_bytes == 0) {
+    return;
+  }
+
+  arena_ = static_cast<char*>(
+      base_->AllocateRaw(kAllocatorAlignment, total_bytes));
+  if (arena_ == nullptr) {
+    LOG(WARNING) << "Failed to allocate a static memory plan arena of "
+                 << total_bytes << " bytes from " << base_->Name();
+    return;
+  }
+  arena_bytes_ = total_bytes;
+  char* slot = arena_;
+  for (int64_t i = 0; i < num_planned_sizes; ++i) {
+    const auto& [size, count] = peaks[i];
+    std::vector<char*>& free_slots = free_slots_[size];
+    free_slots.reserve(count);
+    for (int64_t j = 0; j < count; ++j) {
+      free_slots.push_back(slot);
+      slot_sizes_[slot] = size;
+      slot += size;
+    }
+  }
+  VLOG(1) << "Planned " << num_planned_sizes << " of " << peaks.size()
+          << " allocation sizes in an arena of " << total_bytes << " bytes";
+}
+
+size_t StaticMemoryPlanAllocator::arena_bytes() const {
+  mutex_lock l(mu_);
+  return arena_bytes_;
+}
+
+int64_t StaticMemoryPlanAllocator::num_arena_allocations() const {
+  mutex_lock l(mu_);
+  return num_arena_allocations_;
+}
+
+}  // namespace tensorflow
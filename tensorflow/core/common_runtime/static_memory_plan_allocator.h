@@ -0,0 +1,78 @@
+// This file contains an allocator that serves the fixed-size intermediate
+// tensors of a graph from one arena, planned from the allocations of its first
+// run.
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLAN_ALLOCATOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLAN_ALLOCATOR_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+
+// Until FinishRecording() is called, forwards all allocations to `base` and
+// records the peak number of live allocations of each size. FinishRecording()
+// then allocates one arena from `base` with that many slots of each size, at
+// fixed offsets, and later allocations of a planned size take a free slot.
+// Allocations of other sizes, e.g. of tensors with dynamic shapes, and
+// allocations that find no free slot fall back to `base`.
+//
+// Tensors allocated from this allocator may outlive its owner, e.g. fetched
+// outputs, so every allocation holds a reference to it.
+class StaticMemoryPlanAllocator : public Allocator, public core::RefCounted {
+ public:
+  // Sizes are planned smallest first until the arena reaches
+  // `max_arena_bytes`.
+  StaticMemoryPlanAllocator(Allocator* base, size_t max_arena_bytes);
+  ~StaticMemoryPlanAllocator() override;
+
+  std::string Name() override;
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override;
+  void* AllocateRaw(size_t alignment, size_t num_bytes,
+                    const AllocationAttributes& allocation_attr) override;
+  void DeallocateRaw(void* ptr) override;
+  AllocatorMemoryType GetMemoryType() const override {
+    return base_->GetMemoryType();
+  }
+
+  // Builds the plan from the allocations recorded so far. Does nothing after
+  // the first call.
+  void FinishRecording() TF_LOCKS_EXCLUDED(mu_);
+
+  // Returns the size of the arena, or 0 if there is no plan yet.
+  size_t arena_bytes() const TF_LOCKS_EXCLUDED(mu_);
+  // Returns the number of allocations served from the arena.
+  int64_t num_arena_allocations() const TF_LOCKS_EXCLUDED(mu_);
+
+ private:
+  struct SizeRecord {
+    int64_t live = 0;
+    int64_t peak = 0;
+  };
+
+  Allocator* const base_;
+  const size_t max_arena_bytes_;
+
+  mutable mutex mu_;
+  bool planned_ TF_GUARDED_BY(mu_) = false;
+  // While recording, the live allocations and the counts of each size.
+  absl::flat_hash_map<void*, size_t> recorded_ TF_GUARDED_BY(mu_);
+  absl::flat_hash_map<size_t, SizeRecord> sizes_ TF_GUARDED_BY(mu_);
+  // After planning, the arena and the free slots of each planned size.
+  char* arena_ TF_GUARDED_BY(mu_) = nullptr;
+  size_t arena_bytes_ TF_GUARDED_BY(mu_) = 0;
+  absl::flat_hash_map<size_t, std::vector<char*>> free_slots_
+      TF_GUARDED_BY(mu_);
+  absl::flat_hash_map<const char*, size_t> slot_sizes_ TF_GUARDED_BY(mu_);
+  int64_t num_arena_allocations_ TF_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_MEMORY_PLAN_ALLOCATOR_H_
@@ -0,0 +1,64 @@
+#include "tensorflow/core/common_runtime/static_memory_plan_allocator.h"
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr size_t kAlignment = Allocator::kAllocatorAlignment;
+
+// Records two live 100-byte allocations and one 1000-byte allocation.
+void Record(StaticMemoryPlanAllocator* allocator) {
+  void* a = allocator->AllocateRaw(kAlignment, 100);
+  void* b = allocator->AllocateRaw(kAlignment, 100);
+  allocator->DeallocateRaw(a);
+  void* c = allocator->AllocateRaw(kAlignment, 1000);
+  allocator->DeallocateRaw(b);
+  allocator->DeallocateRaw(c);
+}
+
+TEST(StaticMemoryPlanAllocatorTest, ServesPlannedSizesFromArena) {
+  auto* allocator = new StaticMemoryPlanAllocator(cpu_allocator(),
+                                                  /*max_arena_bytes=*/1 << 20);
+  Record(allocator);
+  EXPECT_EQ(allocator->arena_bytes(), 0);
+  allocator->FinishRecording();
+  EXPECT_EQ(allocator->arena_bytes(), 2 * 128 + 1024);
+
+  void* a = allocator->AllocateRaw(kAlignment, 100);
+  void* b = allocator->AllocateRaw(kAlignment, 90);
+  // Both slots of the size are taken, so this one falls back.
+  void* c = allocator->AllocateRaw(kAlignment, 100);
+  // An unplanned size falls back too.
+  void* d = allocator->AllocateRaw(kAlignment, 5000);
+  EXPECT_EQ(allocator->num_arena_allocations(), 2);
+  EXPECT_NE(a, b);
+  allocator->DeallocateRaw(a);
+  void* e = allocator->AllocateRaw(kAlignment, 128);
+  EXPECT_EQ(e, a);
+  EXPECT_EQ(allocator->num_arena_allocations(), 3);
+
+  // The allocations keep the allocator alive after its owner releases it.
+  allocator->Unref();
+  allocator->DeallocateRaw(b);
+  allocator->DeallocateRaw(c);
+  allocator->DeallocateRaw(d);
+  allocator->DeallocateRaw(e);
+}
+
+TEST(StaticMemoryPlanAllocatorTest, PlansSmallestSizesWithinLimit) {
+  auto* allocator =
+      new StaticMemoryPlanAllocator(cpu_allocator(), /*max_arena_bytes=*/512);
+  Record(allocator);
+  allocator->FinishRecording();
+  EXPECT_EQ(allocator->arena_bytes(), 2 * 128);
+
+  void* a = allocator->AllocateRaw(kAlignment, 1000);
+  EXPECT_EQ(allocator->num_arena_allocations(), 0);
+  allocator->DeallocateRaw(a);
+  allocator->Unref();
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_COMMON_RUNTIME_THREADPOOL_DEVICE_H_
 #define TENSORFLOW_CORE_COMMON_RUNTIME_THREADPOOL_DEVICE_H_
 
+#include <vector>
+
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/local_device.h"
 #include "tensorflow/core/common_runtime/node_file_writer.h"
@@ -30,6 +32,14 @@ class ThreadPoolDevice : public LocalDevice {
                    Allocator* allocator);
   ~ThreadPoolDevice() override;
 
+  // Makes GetAllocator() return numa_allocators[n] when called from a thread
+  // of a NUMA-partitioned thread pool that is pinned to NUMA node n, and the
+  // allocator passed to the constructor otherwise. Not thread-safe; call
+  // before the device is used.
+  void SetNumaLocalAllocators(std::vector<Allocator*> numa_allocators) {
+    numa_allocators_ = std::move(numa_allocators);
+  }
+
   Allocator* GetAllocator(AllocatorAttributes attr) override;
   Allocator* GetScopedAllocator(AllocatorAttributes attr,
                                 int64_t step_id) override;
@@ -54,6 +64,7 @@ class ThreadPoolDevice : public LocalDevice {
   void LogOutputs(OpKernel* op_kernel, OpKernelContext* context);
 
   Allocator* allocator_;  // Not owned
+  std::vector<Allocator*> numa_allocators_;  // Not owned
   std::unique_ptr<ScopedAllocatorMgr> scoped_allocator_mgr_;
   NodeFileWriter* node_file_writer_ = nullptr;  // not owned
 };
@@ -43,6 +43,18 @@ class ThreadPoolDeviceFactory : public DeviceFactory {
     if (iter != options.config.device_count().end()) {
       n = iter->second;
     }
+    // With a NUMA-partitioned inter-op pool, tensors are allocated on the
+    // NUMA node of the inter-op thread that runs the kernel.
+    std::vector<Allocator*> numa_allocators;
+    if (options.config.experimental().numa_partitioned_inter_op_pool() &&
+        !options.config.experimental().use_numa_affinity() &&
+        port::NUMAEnabled() && num_numa_nodes > 1) {
+      ProcessState::singleton()->EnableNUMA();
+      for (int node = 0; node < num_numa_nodes; ++node) {
+        numa_allocators.push_back(
+            ProcessState::singleton()->GetCPUAllocator(node));
+      }
+    }
     for (int i = 0; i < n; i++) {
       string name = strings::StrCat(name_prefix, "/device:CPU:", i);
       std::unique_ptr<ThreadPoolDevice> tpd;
@@ -63,6 +75,9 @@ class ThreadPoolDeviceFactory : public DeviceFactory {
         tpd = std::make_unique<ThreadPoolDevice>(
             options, name, Bytes(256 << 20), DeviceLocality(),
             ProcessState::singleton()->GetCPUAllocator(port::kNUMANoAffinity));
+        if (!numa_allocators.empty()) {
+          tpd->SetNumaLocalAllocators(numa_allocators);
+        }
       }
       devices->push_back(std::move(tpd));
     }
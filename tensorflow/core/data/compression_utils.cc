@@ -23,6 +23,13 @@ limitations under the License.
 
 namespace tensorflow {
 namespace data {
+namespace {
+
+// Added by Alpa. Elements are kept uncompressed unless snappy shrinks them to
+// at most this fraction of their size.
+constexpr double kMaxCompressionRatio = 0.875;
+
+}  // namespace
 
 Status CompressElement(const std::vector<Tensor>& element,
                        CompressedElement* out) {
@@ -78,6 +85,13 @@ Status CompressElement(const std::vector<Tensor>& element,
                              out->mutable_data())) {
     return errors::Internal("Failed to compress using snappy.");
   }
+  if (out->data().size() > kMaxCompressionRatio * total_size) {
+    out->set_data(uncompressed.data(), total_size);
+    out->set_codec(CompressedElement::UNCOMPRESSED);
+    VLOG(3) << "Stored incompressible element of " << total_size
+            << " bytes uncompressed";
+    return OkStatus();
+  }
   VLOG(3) << "Compressed element from " << total_size << " bytes to "
           << out->data().size() << " bytes";
   return OkStatus();
@@ -126,22 +140,39 @@ Status UncompressElement(const CompressedElement& compressed,
 
   // Step 2: Uncompress into the iovec.
   const std::string& compressed_data = compressed.data();
-  size_t uncompressed_size;
-  if (!port::Snappy_GetUncompressedLength(
-          compressed_data.data(), compressed_data.size(), &uncompressed_size)) {
-    return errors::Internal(
-        "Could not get snappy uncompressed length. Compressed data size: ",
-        compressed_data.size());
-  }
-  if (uncompressed_size != static_cast<size_t>(total_size)) {
-    return errors::Internal(
-        "Uncompressed size mismatch. Snappy expects ", uncompressed_size,
-        " whereas the tensor metadata suggests ", total_size);
-  }
-  if (!port::Snappy_UncompressToIOVec(compressed_data.data(),
-                                      compressed_data.size(), iov.data(),
-                                      num_components)) {
-    return errors::Internal("Failed to perform snappy decompression.");
+  if (compressed.codec() == CompressedElement::UNCOMPRESSED) {
+    if (compressed_data.size() != static_cast<size_t>(total_size)) {
+      return errors::Internal("Uncompressed size mismatch. The element has ",
+                              compressed_data.size(),
+                              " bytes whereas the tensor metadata suggests ",
+                              total_size);
+    }
+    const char* position = compressed_data.data();
+    for (const struct iovec& component_iov : iov) {
+      if (component_iov.iov_len > 0) {
+        memcpy(component_iov.iov_base, position, component_iov.iov_len);
+      }
+      position += component_iov.iov_len;
+    }
+  } else {
+    size_t uncompressed_size;
+    if (!port::Snappy_GetUncompressedLength(compressed_data.data(),
+                                            compressed_data.size(),
+                                            &uncompressed_size)) {
+      return errors::Internal(
+          "Could not get snappy uncompressed length. Compressed data size: ",
+          compressed_data.size());
+    }
+    if (uncompressed_size != static_cast<size_t>(total_size)) {
+      return errors::Internal(
+          "Uncompressed size mismatch. Snappy expects ", uncompressed_size,
+          " whereas the tensor metadata suggests ", total_size);
+    }
+    if (!port::Snappy_UncompressToIOVec(compressed_data.data(),
+                                        compressed_data.size(), iov.data(),
+                                        num_components)) {
+      return errors::Internal("Failed to perform snappy decompression.");
+    }
   }
 
   // Step 3: Deserialize tensor proto strings to tensors.
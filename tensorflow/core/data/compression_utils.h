@@ -28,6 +28,10 @@ namespace data {
 // out the per-component metadata for the `CompressedElement`.
 //
 // Returns an error if the uncompressed size of the element exceeds 4GB.
+//
+// Added by Alpa: elements that snappy does not shrink by at least 1/8, e.g.
+// encoded images, are stored uncompressed, so that reading them only costs a
+// copy.
 Status CompressElement(const std::vector<Tensor>& element,
                        CompressedElement* out);
 
@@ -16,6 +16,8 @@ limitations under the License.
 
 #include "tensorflow/core/data/dataset_test_base.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/status_matchers.h"
 #include "tensorflow/core/platform/test.h"
 
@@ -50,6 +52,30 @@ TEST_P(ParameterizedCompressionUtilsTest, RoundTrip) {
       ExpectEqual(element, round_trip_element, /*compare_order=*/true));
 }
 
+TEST(CompressionUtilsTest, IncompressibleElementIsStoredUncompressed) {
+  random::PhiloxRandom philox(/*seed=*/123);
+  random::SimplePhilox rng(&philox);
+  Tensor incompressible(DT_INT64, TensorShape{1024});
+  for (int i = 0; i < 1024; ++i) {
+    incompressible.flat<int64_t>()(i) = rng.Rand64();
+  }
+  std::vector<Tensor> element = {
+      incompressible, CreateTensor<tstring>(TensorShape{1}, {"a"})};
+  CompressedElement compressed;
+  TF_ASSERT_OK(CompressElement(element, &compressed));
+  EXPECT_EQ(compressed.codec(), CompressedElement::UNCOMPRESSED);
+  std::vector<Tensor> round_trip_element;
+  TF_ASSERT_OK(UncompressElement(compressed, &round_trip_element));
+  TF_EXPECT_OK(
+      ExpectEqual(element, round_trip_element, /*compare_order=*/true));
+
+  std::vector<Tensor> compressible = {
+      CreateTensor<int64_t>(TensorShape{1024}, std::vector<int64_t>(1024))};
+  CompressedElement compressed_compressible;
+  TF_ASSERT_OK(CompressElement(compressible, &compressed_compressible));
+  EXPECT_EQ(compressed_compressible.codec(), CompressedElement::SNAPPY);
+}
+
 std::vector<std::vector<Tensor>> TestCases() {
   return {
       CreateTensors<int64_t>(TensorShape{1}, {{1}}),           // int64
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <memory>
 #include <queue>
@@ -27,6 +28,7 @@ limitations under the License.
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_join.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/common_runtime/function.h"
 #include "tensorflow/core/framework/attr_value.pb.h"
 #include "tensorflow/core/framework/dataset.h"
@@ -82,6 +84,7 @@ constexpr char kShuffleAndRepeatFusionOpt[] = "shuffle_and_repeat_fusion";
 constexpr char kFilterFusionOpt[] = "filter_fusion";
 constexpr char kMapAndFilterFusionOpt[] = "map_and_filter_fusion";
 constexpr char kMapFusionOpt[] = "map_fusion";
+constexpr char kMapVectorizationOpt[] = "map_vectorization";
 constexpr char kParallelBatchOpt[] = "parallel_batch";
 constexpr char kAutotuneBufferSizesOpt[] = "autotune_buffer_sizes";
 constexpr char kDisablePrefetchLegacyAutotuneOpt[] =
@@ -181,6 +184,14 @@ void DefaultOptimizationGraphRewrites(
       optimization_disabled->insert(kMapFusionOpt);
     }
   }
+  if (optimization_options.optional_map_vectorization_case() ==
+      OptimizationOptions::kMapVectorization) {
+    if (optimization_options.map_vectorization()) {
+      optimization_enabled->insert(kMapVectorizationOpt);
+    } else {
+      optimization_disabled->insert(kMapVectorizationOpt);
+    }
+  }
   if (optimization_options.optional_noop_elimination_case() ==
       OptimizationOptions::kNoopElimination) {
     if (optimization_options.noop_elimination()) {
@@ -227,6 +238,103 @@ bool IsOpAllowlisted(const OpDef* op_def) {
          AllowlistedStatefulOpRegistry::Global()->Contains(op_def->name());
 }
 
+// Added by Alpa. A view of `size` bytes of `root` at `data`, holding a
+// reference to `root`.
+class BatchViewBuffer : public TensorBuffer {
+ public:
+  BatchViewBuffer(TensorBuffer* root, void* data, size_t size)
+      : TensorBuffer(data), root_(root), size_(size) {
+    root_->Ref();
+  }
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return root_; }
+  bool GetAllocatedBytes(size_t* out_bytes) const override {
+    return root_->GetAllocatedBytes(out_bytes);
+  }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    root_->FillAllocationDescription(proto);
+  }
+
+ private:
+  ~BatchViewBuffer() override { root_->Unref(); }
+
+  TensorBuffer* const root_;
+  const size_t size_;
+};
+
+// Added by Alpa. If the elements of a batch component are consecutive slots
+// of one buffer, e.g. the slices of a batch tensor preallocated by their
+// producer, sets `*batch` to a view of the slots instead of copying them.
+bool MaybeViewBatch(const std::vector<std::vector<Tensor>>& batch_elements,
+                    size_t component_index, const TensorShape& batch_shape,
+                    Tensor* batch) {
+  const Tensor& first_element = batch_elements.at(0)[component_index];
+  const int64_t element_bytes = first_element.TotalBytes();
+  if (!DataTypeCanUseMemcpy(first_element.dtype()) || element_bytes == 0 ||
+      !first_element.IsAligned()) {
+    return false;
+  }
+  const TensorBuffer* first_buffer = DMAHelper::buffer(&first_element);
+  if (first_buffer == nullptr) {
+    return false;
+  }
+  TensorBuffer* root = const_cast<TensorBuffer*>(first_buffer)->root_buffer();
+  const char* data = first_element.tensor_data().data();
+  for (int64_t i = 0; i < batch_elements.size(); ++i) {
+    const Tensor& element = batch_elements[i][component_index];
+    const TensorBuffer* buffer = DMAHelper::buffer(&element);
+    if (buffer == nullptr || element.dtype() != first_element.dtype() ||
+        element.shape() != first_element.shape() ||
+        const_cast<TensorBuffer*>(buffer)->root_buffer() != root ||
+        element.tensor_data().data() != data + i * element_bytes) {
+      return false;
+    }
+  }
+  const size_t batch_bytes = batch_elements.size() * element_bytes;
+  if (data + batch_bytes > root->base<char>() + root->size()) {
+    return false;
+  }
+  *batch = Tensor(first_element.dtype(), batch_shape,
+                  core::RefCountPtr<TensorBuffer>(new BatchViewBuffer(
+                      root, const_cast<char*>(data), batch_bytes)));
+  return true;
+}
+
+// Added by Alpa. Copies the elements of a batch component of a memcpy-able
+// type to `batch` on `num_shards` threads, in ranges of bytes rather than of
+// elements, so that all threads copy even when the batch has fewer elements
+// than threads. The element shapes must have been checked.
+void ParallelCopyBytes(const CopyBatchParams& params,
+                       const std::vector<std::vector<Tensor>>& batch_elements,
+                       size_t component_index, int64_t num_shards,
+                       Tensor* batch) {
+  const int64_t element_bytes =
+      batch_elements.at(0)[component_index].TotalBytes();
+  const int64_t total_bytes = element_bytes * batch_elements.size();
+  char* dst = const_cast<char*>(batch->tensor_data().data());
+  const int64_t shard_bytes = (total_bytes + num_shards - 1) / num_shards;
+  BlockingCounter counter(num_shards);
+  for (int64_t shard = 0; shard < num_shards; ++shard) {
+    (*params.runner)([&, shard]() {
+      const int64_t begin = std::min(total_bytes, shard * shard_bytes);
+      const int64_t end = std::min(total_bytes, begin + shard_bytes);
+      for (int64_t offset = begin; offset < end;) {
+        const int64_t index = offset / element_bytes;
+        const int64_t element_offset = offset - index * element_bytes;
+        const int64_t length =
+            std::min(end - offset, element_bytes - element_offset);
+        const char* src =
+            batch_elements[index][component_index].tensor_data().data();
+        std::memcpy(dst + offset, src + element_offset, length);
+        offset += length;
+      }
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+}
+
 }  // namespace
 
 std::pair<int64_t, int64_t> MaybeOverrideSeeds(
@@ -756,12 +864,22 @@ Status CopyBatch(CopyBatchParams params,
   const size_t num_tuple_components = batch_elements.at(0).size();
   out_tensors->reserve(num_tuple_components);
   const int64_t num_batch_elements = batch_elements.size();
+  // Added by Alpa. Whether the batch of a component is a view of its
+  // elements, which need no copy.
+  std::vector<bool> is_view(num_tuple_components, false);
   for (size_t component_index = 0; component_index < num_tuple_components;
        ++component_index) {
     const Tensor& first_element = batch_elements.at(0)[component_index];
     TensorShape first_element_shape(first_element.shape());
     TensorShape batch_component_shape({num_batch_elements});
     batch_component_shape.AppendShape(first_element_shape);
+    Tensor view;
+    if (MaybeViewBatch(batch_elements, component_index, batch_component_shape,
+                       &view)) {
+      out_tensors->push_back(std::move(view));
+      is_view[component_index] = true;
+      continue;
+    }
     out_tensors->emplace_back(params.allocator, first_element.dtype(),
                               batch_component_shape);
     if (!out_tensors->back().IsInitialized()) {
@@ -775,13 +893,14 @@ Status CopyBatch(CopyBatchParams params,
   }
   for (size_t component_index = 0; component_index < num_tuple_components;
        ++component_index) {
+    if (is_view[component_index]) {
+      continue;
+    }
     Tensor& batch_component = out_tensors->at(component_index);
     const Tensor& first_element = batch_elements.at(0)[component_index];
     TensorShape first_element_shape(first_element.shape());
-    // Build the output tuple component by copying one slice from each input
-    // element in the batch.
-    auto copy_element_fn = [component_index, &batch_elements, &batch_component,
-                            &first_element_shape](int index) {
+    auto check_shape_fn = [component_index, &batch_elements,
+                           &first_element_shape](int index) {
       if (batch_elements.at(index)[component_index].shape() !=
           first_element_shape) {
         return errors::InvalidArgument(
@@ -792,6 +911,13 @@ Status CopyBatch(CopyBatchParams params,
             batch_elements.at(index)[component_index].shape().DebugString(),
             ".");
       }
+      return OkStatus();
+    };
+    // Build the output tuple component by copying one slice from each input
+    // element in the batch.
+    auto copy_element_fn = [component_index, &batch_elements, &batch_component,
+                            &check_shape_fn](int index) {
+      TF_RETURN_IF_ERROR(check_shape_fn(index));
       return batch_util::CopyElementToSlice(
           std::move(batch_elements.at(index)[component_index]),
           &batch_component, index);
@@ -800,7 +926,17 @@ Status CopyBatch(CopyBatchParams params,
         first_element.AllocatedBytes() * num_batch_elements;
     // Use parallelism for creating the batch as long as the final batch is at
     // least 1MB.
-    if (parallel_copy && total_bytes >= (1 << 20)) {
+    if (parallel_copy && total_bytes >= (1 << 20) &&
+        DataTypeCanUseMemcpy(first_element.dtype())) {
+      // Added by Alpa. Large elements of memcpy-able types are copied in
+      // ranges of bytes, so that a batch of few large elements, e.g. decoded
+      // images, is still copied on all threads.
+      for (size_t i = 0; i < num_batch_elements; ++i) {
+        TF_RETURN_IF_ERROR(check_shape_fn(i));
+      }
+      ParallelCopyBytes(params, batch_elements, component_index,
+                        params.runner_threadpool_size, &batch_component);
+    } else if (parallel_copy && total_bytes >= (1 << 20)) {
       Status status;
       mutex status_mu;
       const auto num_threads = params.runner_threadpool_size;
@@ -295,6 +295,14 @@ struct CopyBatchParams {
     runner = ctx->runner();
     runner_threadpool_size = GetRunnerThreadpoolSizeFromOpKernelContext(ctx);
   }
+
+  // Added by Alpa
+  CopyBatchParams(Allocator* allocator,
+                  std::function<void(std::function<void()>)>* runner,
+                  int64 runner_threadpool_size)
+      : allocator(allocator),
+        runner(runner),
+        runner_threadpool_size(runner_threadpool_size) {}
 };
 
 // Copies the input elements to a batch.
@@ -305,6 +313,10 @@ struct CopyBatchParams {
 // invoke upon successful allocation of the memory for the batch. The
 // `out_tensors` argument will be used to store the resulting batch (one for
 // each component of the input).
+//
+// Added by Alpa. If the elements of a component are consecutive slots of one
+// buffer, e.g. slices of a batch tensor that their producer preallocated, the
+// batch of the component is a view of the slots and nothing is copied.
 Status CopyBatch(CopyBatchParams params,
                  const std::vector<std::vector<Tensor>>& batch_elements,
                  bool parallel_copy,
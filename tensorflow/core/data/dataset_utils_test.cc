@@ -26,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/framework/function.pb.h"
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/framework/variant.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
@@ -160,6 +161,59 @@ TEST(DatasetUtilsTest, RunnerWithMaxParallelism) {
   runner(fn);
 }
 
+// Added by Alpa
+TEST(DatasetUtilsTest, CopyBatchViewsConsecutiveSlots) {
+  Tensor slots(DT_FLOAT, TensorShape({4, 8}));
+  test::FillIota<float>(&slots, 0.0f);
+  std::vector<std::vector<Tensor>> batch_elements;
+  for (int i = 0; i < 4; ++i) {
+    batch_elements.push_back({slots.SubSlice(i)});
+  }
+  std::function<void(std::function<void()>)> runner =
+      [](std::function<void()> fn) { fn(); };
+  std::vector<Tensor> batch;
+  TF_ASSERT_OK(CopyBatch(CopyBatchParams(cpu_allocator(), &runner,
+                                         /*runner_threadpool_size=*/1),
+                         batch_elements, /*parallel_copy=*/false,
+                         /*allocation_callback=*/nullptr, &batch));
+  ASSERT_EQ(batch.size(), 1);
+  EXPECT_TRUE(batch[0].SharesBufferWith(slots));
+  test::ExpectTensorEqual<float>(batch[0], slots);
+
+  // Slots out of order are copied.
+  std::swap(batch_elements[1], batch_elements[2]);
+  batch.clear();
+  TF_ASSERT_OK(CopyBatch(CopyBatchParams(cpu_allocator(), &runner,
+                                         /*runner_threadpool_size=*/1),
+                         batch_elements, /*parallel_copy=*/false,
+                         /*allocation_callback=*/nullptr, &batch));
+  EXPECT_FALSE(batch[0].SharesBufferWith(slots));
+  EXPECT_EQ(batch[0].matrix<float>()(1, 0), 16.0f);
+}
+
+// Added by Alpa
+TEST(DatasetUtilsTest, CopyBatchParallelCopyOfLargeElements) {
+  // Fewer elements than threads, each larger than a shard of the copy.
+  const int64_t element_size = 1 << 18;
+  std::vector<std::vector<Tensor>> batch_elements;
+  for (int i = 0; i < 2; ++i) {
+    Tensor element(DT_FLOAT, TensorShape({element_size}));
+    test::FillIota<float>(&element, i * element_size);
+    batch_elements.push_back({element});
+  }
+  std::function<void(std::function<void()>)> runner =
+      [](std::function<void()> fn) { fn(); };
+  std::vector<Tensor> batch;
+  TF_ASSERT_OK(CopyBatch(CopyBatchParams(cpu_allocator(), &runner,
+                                         /*runner_threadpool_size=*/3),
+                         batch_elements, /*parallel_copy=*/true,
+                         /*allocation_callback=*/nullptr, &batch));
+  ASSERT_EQ(batch.size(), 1);
+  Tensor expected(DT_FLOAT, TensorShape({2, element_size}));
+  test::FillIota<float>(&expected, 0.0f);
+  test::ExpectTensorEqual<float>(batch[0], expected);
+}
+
 TEST(DatasetUtilsTest, ParseDeterminismPolicy) {
   DeterminismPolicy determinism;
   TF_ASSERT_OK(DeterminismPolicy::FromString("true", &determinism));
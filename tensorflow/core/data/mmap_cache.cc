@@ -0,0 +1,403 @@
+#include "tensorflow/core/data/mmap_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/coding.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/refcount.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+constexpr char kIndexSuffix[] = ".mmap_index";
+constexpr char kDataSuffix[] = ".mmap_data-";
+constexpr char kTempSuffix[] = ".tempstate";
+constexpr uint64 kIndexVersion = 1;
+// The components are aligned like the buffers of the default allocator, so that
+// the tensors pointing into the mapping are aligned too.
+constexpr int64_t kAlignment = Allocator::kAllocatorAlignment;
+
+std::string DataFilename(const std::string& prefix, size_t file) {
+  return strings::StrCat(prefix, kDataSuffix, file);
+}
+
+struct IndexEntry {
+  int64_t file;
+  int64_t offset;
+  TensorShape shape;
+};
+
+// The parsed index of a cache. The files are relative to its directory.
+struct Index {
+  DataTypeVector dtypes;
+  std::vector<std::string> files;
+  int64_t num_elements = 0;
+  std::vector<IndexEntry> entries;
+};
+
+void PutString(const std::string& value, std::string* out) {
+  core::PutVarint64(out, value.size());
+  out->append(value);
+}
+
+std::string SerializeIndex(const Index& index) {
+  std::string out;
+  core::PutVarint64(&out, kIndexVersion);
+  core::PutVarint64(&out, index.dtypes.size());
+  for (DataType dtype : index.dtypes) {
+    core::PutVarint64(&out, dtype);
+  }
+  core::PutVarint64(&out, index.files.size());
+  for (const std::string& file : index.files) {
+    PutString(file, &out);
+  }
+  core::PutVarint64(&out, index.num_elements);
+  for (const IndexEntry& entry : index.entries) {
+    core::PutVarint64(&out, entry.file);
+    core::PutVarint64(&out, entry.offset);
+    core::PutVarint64(&out, entry.shape.dims());
+    for (int64_t dim : entry.shape.dim_sizes()) {
+      core::PutVarint64(&out, dim);
+    }
+  }
+  return out;
+}
+
+Status ParseIndex(const std::string& filename, StringPiece data,
+                  Index* index) {
+  auto corrupted = [&filename]() {
+    return errors::DataLoss("Corrupted memory-mapped cache index ", filename);
+  };
+  uint64 value;
+  if (!core::GetVarint64(&data, &value)) return corrupted();
+  if (value != kIndexVersion) {
+    return errors::FailedPrecondition("Unsupported version ", value,
+                                      " of memory-mapped cache index ",
+                                      filename);
+  }
+  uint64 num_components;
+  if (!core::GetVarint64(&data, &num_components)) return corrupted();
+  for (uint64 i = 0; i < num_components; ++i) {
+    if (!core::GetVarint64(&data, &value)) return corrupted();
+    index->dtypes.push_back(static_cast<DataType>(value));
+  }
+  uint64 num_files;
+  if (!core::GetVarint64(&data, &num_files)) return corrupted();
+  for (uint64 i = 0; i < num_files; ++i) {
+    if (!core::GetVarint64(&data, &value) || data.size() < value) {
+      return corrupted();
+    }
+    index->files.emplace_back(data.data(), value);
+    data.remove_prefix(value);
+  }
+  uint64 num_elements;
+  if (!core::GetVarint64(&data, &num_elements)) return corrupted();
+  // Every entry takes at least three bytes.
+  if (num_components > 0 && num_elements > data.size() / num_components) {
+    return corrupted();
+  }
+  index->num_elements = num_elements;
+  index->entries.reserve(num_elements * num_components);
+  for (uint64 i = 0; i < num_elements * num_components; ++i) {
+    IndexEntry entry;
+    uint64 file, offset, rank;
+    if (!core::GetVarint64(&data, &file) || file >= num_files ||
+        !core::GetVarint64(&data, &offset) ||
+        !core::GetVarint64(&data, &rank)) {
+      return corrupted();
+    }
+    entry.file = file;
+    entry.offset = offset;
+    for (uint64 d = 0; d < rank; ++d) {
+      if (!core::GetVarint64(&data, &value)) return corrupted();
+      TF_RETURN_IF_ERROR(entry.shape.AddDimWithStatus(value));
+    }
+    index->entries.push_back(std::move(entry));
+  }
+  if (!data.empty()) return corrupted();
+  return OkStatus();
+}
+
+Status ReadIndex(Env* env, const std::string& prefix, Index* index) {
+  const std::string filename = MmapCacheIndexFilename(prefix);
+  std::string data;
+  TF_RETURN_IF_ERROR(ReadFileToString(env, filename, &data));
+  return ParseIndex(filename, data, index);
+}
+
+// Writes the index atomically, so that a reader never sees a partial index.
+Status WriteIndex(Env* env, const std::string& prefix, const Index& index) {
+  const std::string filename = MmapCacheIndexFilename(prefix);
+  const std::string temp_filename = strings::StrCat(filename, kTempSuffix);
+  TF_RETURN_IF_ERROR(
+      WriteStringToFile(env, temp_filename, SerializeIndex(index)));
+  return env->RenameFile(temp_filename, filename);
+}
+
+// A memory region read into aligned memory, for the filesystems that cannot
+// map files.
+class HeapMemoryRegion : public ReadOnlyMemoryRegion {
+ public:
+  explicit HeapMemoryRegion(uint64 length)
+      : data_(port::AlignedMalloc(std::max<uint64>(length, 1), kAlignment)),
+        length_(length) {}
+  ~HeapMemoryRegion() override { port::AlignedFree(data_); }
+
+  const void* data() override { return data_; }
+  uint64 length() override { return length_; }
+  char* mutable_data() { return static_cast<char*>(data_); }
+
+ private:
+  void* const data_;
+  const uint64 length_;
+};
+
+Status ReadMemoryRegion(Env* env, const std::string& filename,
+                        std::unique_ptr<ReadOnlyMemoryRegion>* region) {
+  Status s = env->NewReadOnlyMemoryRegionFromFile(filename, region);
+  if (!errors::IsUnimplemented(s)) {
+    return s;
+  }
+  uint64 length;
+  TF_RETURN_IF_ERROR(env->GetFileSize(filename, &length));
+  std::unique_ptr<RandomAccessFile> file;
+  TF_RETURN_IF_ERROR(env->NewRandomAccessFile(filename, &file));
+  auto heap_region = std::make_unique<HeapMemoryRegion>(length);
+  StringPiece result;
+  TF_RETURN_IF_ERROR(
+      file->Read(0, length, &result, heap_region->mutable_data()));
+  if (result.size() != length) {
+    return errors::DataLoss("Read ", result.size(), " of ", length,
+                            " bytes of ", filename);
+  }
+  if (result.data() != heap_region->mutable_data()) {
+    memcpy(heap_region->mutable_data(), result.data(), length);
+  }
+  *region = std::move(heap_region);
+  return OkStatus();
+}
+
+// A tensor buffer pointing into a memory region of the cache.
+class MmapTensorBuffer : public TensorBuffer {
+ public:
+  MmapTensorBuffer(std::shared_ptr<ReadOnlyMemoryRegion> region, void* data,
+                   size_t size)
+      : TensorBuffer(data), region_(std::move(region)), size_(size) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("MmapCache");
+  }
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const std::shared_ptr<ReadOnlyMemoryRegion> region_;
+  const size_t size_;
+};
+
+}  // namespace
+
+std::string MmapCacheIndexFilename(const std::string& prefix) {
+  return strings::StrCat(prefix, kIndexSuffix);
+}
+
+bool MmapCacheSupportsTypes(const DataTypeVector& dtypes) {
+  for (DataType dtype : dtypes) {
+    if (!DataTypeCanUseMemcpy(dtype)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+MmapCacheWriter::MmapCacheWriter(Env* env, const std::string& prefix,
+                                 const DataTypeVector& dtypes)
+    : env_(env),
+      prefix_(prefix),
+      dtypes_(dtypes),
+      files_(dtypes.size()),
+      file_sizes_(dtypes.size(), 0) {
+  if (!MmapCacheSupportsTypes(dtypes_)) {
+    status_ = errors::Unimplemented(
+        "Memory-mapped caches only support types that can be copied with "
+        "memcpy, got ",
+        DataTypeVectorString(dtypes_));
+    return;
+  }
+  for (size_t i = 0; i < files_.size() && status_.ok(); ++i) {
+    status_ = env_->NewWritableFile(DataFilename(prefix_, i), &files_[i]);
+  }
+}
+
+Status MmapCacheWriter::Add(const std::vector<Tensor>& element) {
+  TF_RETURN_IF_ERROR(status_);
+  if (element.size() != dtypes_.size()) {
+    return errors::InvalidArgument("Expected ", dtypes_.size(),
+                                   " components, got ", element.size());
+  }
+  static const char kPadding[kAlignment] = {0};
+  for (size_t i = 0; i < element.size(); ++i) {
+    const Tensor& t = element[i];
+    if (t.dtype() != dtypes_[i]) {
+      return errors::InvalidArgument("Expected component ", i, " of type ",
+                                     DataTypeString(dtypes_[i]), ", got ",
+                                     DataTypeString(t.dtype()));
+    }
+    const int64_t padding = -file_sizes_[i] & (kAlignment - 1);
+    if (padding > 0) {
+      status_.Update(files_[i]->Append(StringPiece(kPadding, padding)));
+      file_sizes_[i] += padding;
+    }
+    entries_.push_back({file_sizes_[i], t.shape()});
+    status_.Update(files_[i]->Append(t.tensor_data()));
+    file_sizes_[i] += t.TotalBytes();
+    TF_RETURN_IF_ERROR(status_);
+  }
+  return OkStatus();
+}
+
+Status MmapCacheWriter::Finish() {
+  TF_RETURN_IF_ERROR(status_);
+  Index index;
+  index.dtypes = dtypes_;
+  for (size_t i = 0; i < files_.size(); ++i) {
+    status_.Update(files_[i]->Close());
+    index.files.push_back(std::string(io::Basename(DataFilename(prefix_, i))));
+  }
+  TF_RETURN_IF_ERROR(status_);
+  const size_t num_components = dtypes_.size();
+  index.num_elements =
+      num_components == 0 ? 0 : entries_.size() / num_components;
+  index.entries.reserve(entries_.size());
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    index.entries.push_back(
+        {static_cast<int64_t>(i % num_components), entries_[i].offset,
+         entries_[i].shape});
+  }
+  status_ = WriteIndex(env_, prefix_, index);
+  if (status_.ok()) {
+    status_ = errors::FailedPrecondition("The writer has been finished.");
+    return OkStatus();
+  }
+  return status_;
+}
+
+Status MergeMmapCaches(Env* env, const std::vector<tstring>& prefixes,
+                       const std::string& merged_prefix) {
+  Index merged;
+  for (const tstring& prefix : prefixes) {
+    Index index;
+    TF_RETURN_IF_ERROR(ReadIndex(env, prefix, &index));
+    if (merged.dtypes.empty()) {
+      merged.dtypes = index.dtypes;
+    } else if (index.dtypes != merged.dtypes) {
+      return errors::InvalidArgument(
+          "The memory-mapped caches to merge have different types: ",
+          DataTypeVectorString(merged.dtypes), " and ",
+          DataTypeVectorString(index.dtypes));
+    }
+    // The data files are renamed to the merged prefix, so that the merged
+    // cache does not share files with the prefixes.
+    const int64_t file_offset = merged.files.size();
+    const std::string dir(io::Dirname(std::string(prefix)));
+    for (const std::string& file : index.files) {
+      const std::string merged_file =
+          DataFilename(merged_prefix, merged.files.size());
+      TF_RETURN_IF_ERROR(
+          env->RenameFile(io::JoinPath(dir, file), merged_file));
+      merged.files.push_back(std::string(io::Basename(merged_file)));
+    }
+    merged.num_elements += index.num_elements;
+    for (IndexEntry& entry : index.entries) {
+      entry.file += file_offset;
+      merged.entries.push_back(std::move(entry));
+    }
+  }
+  TF_RETURN_IF_ERROR(WriteIndex(env, merged_prefix, merged));
+  for (const tstring& prefix : prefixes) {
+    TF_RETURN_IF_ERROR(env->DeleteFile(MmapCacheIndexFilename(prefix)));
+  }
+  return OkStatus();
+}
+
+StatusOr<std::unique_ptr<MmapCacheReader>> MmapCacheReader::Open(
+    Env* env, const std::string& prefix, const DataTypeVector& dtypes) {
+  Index index;
+  TF_RETURN_IF_ERROR(ReadIndex(env, prefix, &index));
+  if (index.dtypes != dtypes) {
+    return errors::InvalidArgument(
+        "The memory-mapped cache ", prefix, " has types ",
+        DataTypeVectorString(index.dtypes), ", expected ",
+        DataTypeVectorString(dtypes));
+  }
+  const std::string dir(io::Dirname(prefix));
+  std::vector<std::shared_ptr<ReadOnlyMemoryRegion>> regions;
+  regions.reserve(index.files.size());
+  for (const std::string& file : index.files) {
+    std::unique_ptr<ReadOnlyMemoryRegion> region;
+    TF_RETURN_IF_ERROR(
+        ReadMemoryRegion(env, io::JoinPath(dir, file), &region));
+    regions.push_back(std::move(region));
+  }
+  std::vector<Entry> entries;
+  entries.reserve(index.entries.size());
+  for (IndexEntry& entry : index.entries) {
+    const int64_t bytes =
+        entry.shape.num_elements() *
+        DataTypeSize(dtypes[entries.size() % dtypes.size()]);
+    if (entry.offset + bytes > regions[entry.file]->length()) {
+      return errors::DataLoss("The memory-mapped cache ", prefix,
+                              " is truncated.");
+    }
+    entries.push_back({entry.file, entry.offset, std::move(entry.shape)});
+  }
+  return absl::WrapUnique(new MmapCacheReader(
+      dtypes, index.num_elements, std::move(entries), std::move(regions)));
+}
+
+Status MmapCacheReader::Get(int64_t index,
+                            std::vector<Tensor>* out_tensors) const {
+  if (index < 0 || index >= num_elements_) {
+    return errors::OutOfRange("Index out of range [0, ", num_elements_,
+                              "):", index);
+  }
+  out_tensors->clear();
+  out_tensors->reserve(dtypes_.size());
+  for (size_t i = 0; i < dtypes_.size(); ++i) {
+    const Entry& entry = entries_[index * dtypes_.size() + i];
+    const size_t bytes = entry.shape.num_elements() * DataTypeSize(dtypes_[i]);
+    if (bytes == 0) {
+      out_tensors->emplace_back(dtypes_[i], entry.shape);
+      continue;
+    }
+    const std::shared_ptr<ReadOnlyMemoryRegion>& region =
+        regions_[entry.file];
+    // The tensors are never mutated, so that the const data of the mapping
+    // can back them.
+    char* data =
+        const_cast<char*>(static_cast<const char*>(region->data())) +
+        entry.offset;
+    out_tensors->emplace_back(
+        dtypes_[i], entry.shape,
+        core::RefCountPtr<TensorBuffer>(
+            new MmapTensorBuffer(region, data, bytes)));
+  }
+  return OkStatus();
+}
+
+}  // namespace data
+}  // namespace tensorflow
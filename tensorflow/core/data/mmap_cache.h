@@ -0,0 +1,118 @@
+// This file contains a columnar file cache format for tf.data, in which the
+// components of the cached elements are laid out aligned in one data file per
+// component, so that the cache can be memory-mapped on read and its tensors
+// point into the mapping instead of being deserialized on every epoch.
+//
+// A cache with prefix `p` consists of the data files `p.mmap_data-<i>`, one per
+// component and per merged shard, and of the index `p.mmap_index`, which
+// records the file, offset and shape of every component of every element. The
+// index is only written once the data is complete, so its existence marks a
+// complete cache.
+
+#ifndef TENSORFLOW_CORE_DATA_MMAP_CACHE_H_
+#define TENSORFLOW_CORE_DATA_MMAP_CACHE_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/statusor.h"
+#include "tensorflow/core/platform/tstring.h"
+
+namespace tensorflow {
+namespace data {
+
+// The name of the index file of the memory-mapped cache with `prefix`.
+std::string MmapCacheIndexFilename(const std::string& prefix);
+
+// Returns whether elements of `dtypes` can be stored in a memory-mapped cache,
+// i.e. whether all the types can be copied with memcpy.
+bool MmapCacheSupportsTypes(const DataTypeVector& dtypes);
+
+// Writes elements to a memory-mapped cache. The data files are appended to as
+// elements are added, and the index is written by Finish().
+class MmapCacheWriter {
+ public:
+  MmapCacheWriter(Env* env, const std::string& prefix,
+                  const DataTypeVector& dtypes);
+
+  // Appends `element`, whose components must match the types of the cache.
+  Status Add(const std::vector<Tensor>& element);
+
+  // Closes the data files and writes the index. The writer must not be used
+  // afterwards.
+  Status Finish();
+
+  // The first error of the writer, if any.
+  Status status() const { return status_; }
+
+ private:
+  struct Entry {
+    int64_t offset;
+    TensorShape shape;
+  };
+
+  Env* const env_;
+  const std::string prefix_;
+  const DataTypeVector dtypes_;
+  std::vector<std::unique_ptr<WritableFile>> files_;
+  // The number of bytes written to each data file.
+  std::vector<int64_t> file_sizes_;
+  // The locations of the components, element-major.
+  std::vector<Entry> entries_;
+  Status status_;
+};
+
+// Merges the completed memory-mapped caches with `prefixes`, e.g. the shards
+// written between checkpoints, into one cache with `merged_prefix`. The data
+// files are renamed rather than copied, and the indices of the shards are
+// deleted. All the prefixes must be in the same directory.
+Status MergeMmapCaches(Env* env, const std::vector<tstring>& prefixes,
+                       const std::string& merged_prefix);
+
+// Reads a completed memory-mapped cache. The data files are mapped once, and
+// the returned tensors reference the mappings, which stay alive as long as
+// any of them. Filesystems without memory-mapping support are read into
+// memory instead. Get() may be called concurrently.
+class MmapCacheReader {
+ public:
+  static StatusOr<std::unique_ptr<MmapCacheReader>> Open(
+      Env* env, const std::string& prefix, const DataTypeVector& dtypes);
+
+  int64_t num_elements() const { return num_elements_; }
+
+  // Sets `out_tensors` to the element at `index`, without copying its data.
+  Status Get(int64_t index, std::vector<Tensor>* out_tensors) const;
+
+ private:
+  struct Entry {
+    int64_t file;
+    int64_t offset;
+    TensorShape shape;
+  };
+
+  MmapCacheReader(const DataTypeVector& dtypes, int64_t num_elements,
+                  std::vector<Entry> entries,
+                  std::vector<std::shared_ptr<ReadOnlyMemoryRegion>> regions)
+      : dtypes_(dtypes),
+        num_elements_(num_elements),
+        entries_(std::move(entries)),
+        regions_(std::move(regions)) {}
+
+  const DataTypeVector dtypes_;
+  const int64_t num_elements_;
+  const std::vector<Entry> entries_;
+  const std::vector<std::shared_ptr<ReadOnlyMemoryRegion>> regions_;
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_MMAP_CACHE_H_
@@ -0,0 +1,89 @@
+#include "tensorflow/core/data/mmap_cache.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+std::vector<Tensor> MakeElement(int64_t i) {
+  return {test::AsTensor<int64_t>({i, i + 1, i + 2}, TensorShape({3})),
+          test::AsScalar<float>(i * 0.5f)};
+}
+
+void WriteCache(const std::string& prefix, int64_t begin, int64_t end) {
+  MmapCacheWriter writer(Env::Default(), prefix, {DT_INT64, DT_FLOAT});
+  for (int64_t i = begin; i < end; ++i) {
+    TF_ASSERT_OK(writer.Add(MakeElement(i)));
+  }
+  TF_ASSERT_OK(writer.Finish());
+}
+
+TEST(MmapCacheTest, ReadsElementsByIndex) {
+  const std::string prefix = io::JoinPath(testing::TmpDir(), "read_cache");
+  WriteCache(prefix, 0, 5);
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MmapCacheReader> reader,
+      MmapCacheReader::Open(Env::Default(), prefix, {DT_INT64, DT_FLOAT}));
+  ASSERT_EQ(reader->num_elements(), 5);
+  for (int64_t i : {3, 0, 4, 1, 2}) {
+    std::vector<Tensor> element;
+    TF_ASSERT_OK(reader->Get(i, &element));
+    ASSERT_EQ(element.size(), 2);
+    test::ExpectTensorEqual<int64_t>(element[0], MakeElement(i)[0]);
+    test::ExpectTensorEqual<float>(element[1], MakeElement(i)[1]);
+    // The tensors point into the aligned mapping.
+    EXPECT_TRUE(element[0].IsAligned());
+    EXPECT_TRUE(element[1].IsAligned());
+  }
+  std::vector<Tensor> element;
+  EXPECT_TRUE(errors::IsOutOfRange(reader->Get(5, &element)));
+}
+
+TEST(MmapCacheTest, MergesShards) {
+  const std::string prefix = io::JoinPath(testing::TmpDir(), "merged_cache");
+  const std::string shard0 = prefix + "_0";
+  const std::string shard1 = prefix + "_1";
+  WriteCache(shard0, 0, 2);
+  WriteCache(shard1, 2, 3);
+  TF_ASSERT_OK(MergeMmapCaches(Env::Default(), {shard0, shard1}, prefix));
+  EXPECT_FALSE(
+      Env::Default()->FileExists(MmapCacheIndexFilename(shard0)).ok());
+
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MmapCacheReader> reader,
+      MmapCacheReader::Open(Env::Default(), prefix, {DT_INT64, DT_FLOAT}));
+  ASSERT_EQ(reader->num_elements(), 3);
+  for (int64_t i = 0; i < 3; ++i) {
+    std::vector<Tensor> element;
+    TF_ASSERT_OK(reader->Get(i, &element));
+    test::ExpectTensorEqual<int64_t>(element[0], MakeElement(i)[0]);
+  }
+}
+
+TEST(MmapCacheTest, RejectsMismatchedTypes) {
+  const std::string prefix = io::JoinPath(testing::TmpDir(), "typed_cache");
+  WriteCache(prefix, 0, 1);
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      MmapCacheReader::Open(Env::Default(), prefix, {DT_INT32, DT_FLOAT})
+          .status()));
+
+  MmapCacheWriter writer(Env::Default(),
+                         io::JoinPath(testing::TmpDir(), "string_cache"),
+                         {DT_STRING});
+  EXPECT_TRUE(errors::IsUnimplemented(writer.status()));
+  EXPECT_FALSE(MmapCacheSupportsTypes({DT_INT64, DT_STRING}));
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -22,12 +22,17 @@ limitations under the License.
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
 #include "tensorflow/core/data/service/logging_utils.h"
 #include "tensorflow/core/framework/metrics.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/random.h"
 #include "tensorflow/core/platform/status.h"
 #include "tensorflow/core/platform/statusor.h"
 #include "tensorflow/core/platform/thread_annotations.h"
@@ -89,6 +94,16 @@ class CachableSequence {
 
   // Returns the estimated size of the element in bytes.
   virtual size_t GetElementSizeBytes(const ElementType&) const = 0;
+
+  // Added by Alpa. Writes `element` to `filename`, and reads it back. These
+  // are only used by caches that spill evicted elements to disk.
+  virtual Status SaveElement(const ElementType& element,
+                             const std::string& filename) const {
+    return errors::Unimplemented("Spilling elements is not supported.");
+  }
+  virtual StatusOr<ElementType> LoadElement(const std::string& filename) const {
+    return errors::Unimplemented("Spilling elements is not supported.");
+  }
 };
 
 // Sliding-window cache shared across concurrent trainers.
@@ -98,10 +113,18 @@ class CrossTrainerCache {
   // Creates a `CrossTrainerCache` with `max_cache_size_bytes` of memory budget.
   // The cache should be able to hold at least one element, i.e.:
   // REQUIRES: `max_cache_size_bytes >= max(GetElementSizeBytes(*))`
+  //
+  // Added by Alpa: if `spill_directory` is not empty, the elements evicted
+  // from memory are written there instead of being discarded, and trainers
+  // that fall behind the memory window read them from disk. The spilled
+  // elements are evicted oldest first to keep them below
+  // `max_spill_size_bytes`.
   explicit CrossTrainerCache(
       size_t max_cache_size_bytes,
-      std::unique_ptr<CachableSequence<ElementType>> cachable_sequence);
-  virtual ~CrossTrainerCache() = default;
+      std::unique_ptr<CachableSequence<ElementType>> cachable_sequence,
+      const std::string& spill_directory = "",
+      size_t max_spill_size_bytes = 0);
+  virtual ~CrossTrainerCache();
   CrossTrainerCache(const CrossTrainerCache&) = delete;
   CrossTrainerCache& operator=(const CrossTrainerCache&) = delete;
 
@@ -138,9 +161,10 @@ class CrossTrainerCache {
   // the cached elements).
   size_t GetElementIndex(const std::string& trainer_id);
 
-  // Returns the next element for `trainer_id`.
+  // Returns the next element for `trainer_id`. Added by Alpa: if the element
+  // is on disk, returns no element and sets `spilled_filename` instead.
   StatusOr<std::shared_ptr<const ElementType>> GetElement(
-      const std::string& trainer_id);
+      const std::string& trainer_id, std::string& spilled_filename);
 
   // Reads a new element and writes it into the cache.
   Status ExtendCache();
@@ -149,12 +173,28 @@ class CrossTrainerCache {
   // `new_element_size_bytes` is the size of the new element being inserted.
   void FreeSpace(size_t new_element_size_bytes);
 
+  // Added by Alpa. Writes the elements evicted from memory to disk, and
+  // evicts the oldest spilled elements to keep them below
+  // `max_spill_size_bytes_`. Only called by the thread extending the cache.
+  void SpillElements() TF_LOCKS_EXCLUDED(mu_);
+
+  // Added by Alpa. Returns the index of the oldest element in the cache,
+  // which is the oldest spilled element if there are any.
+  size_t OldestElementIndex() const;
+
   // Records the cache hit rate and cache size.
   void RecordMetrics(const CacheQueryResult& result);
 
   // Maximum cache size in bytes.
   const size_t max_cache_size_bytes_;
 
+  // Added by Alpa. Where evicted elements are spilled, or empty if they are
+  // discarded, and the maximum size of the spilled elements in bytes.
+  const std::string spill_directory_;
+  const size_t max_spill_size_bytes_;
+  // Distinguishes the files of caches spilling to the same directory.
+  const uint64 spill_id_;
+
   // The element sequence over which the sliding window cache operates.
   std::unique_ptr<CachableSequence<ElementType>> cachable_sequence_;
 
@@ -170,6 +210,17 @@ class CrossTrainerCache {
   size_t cache_size_bytes_ TF_GUARDED_BY(mu_) = 0;
   size_t cache_start_index_ TF_GUARDED_BY(mu_) = 0;
 
+  // Added by Alpa. The elements preceding `cache_` are, newest last, the
+  // elements evicted from memory that are being written to disk, and before
+  // those, the elements on disk.
+  struct SpilledElement {
+    std::string filename;
+    size_t size_bytes;
+  };
+  std::deque<std::shared_ptr<const ElementType>> spilling_ TF_GUARDED_BY(mu_);
+  std::deque<SpilledElement> spilled_ TF_GUARDED_BY(mu_);
+  size_t spilled_size_bytes_ TF_GUARDED_BY(mu_) = 0;
+
   // True if one thread is extending the cache.
   bool extending_cache_ TF_GUARDED_BY(mu_) = false;
 
@@ -183,8 +234,12 @@ class CrossTrainerCache {
 template <class ElementType>
 CrossTrainerCache<ElementType>::CrossTrainerCache(
     size_t max_cache_size_bytes,
-    std::unique_ptr<CachableSequence<ElementType>> cachable_sequence)
+    std::unique_ptr<CachableSequence<ElementType>> cachable_sequence,
+    const std::string& spill_directory, size_t max_spill_size_bytes)
     : max_cache_size_bytes_(max_cache_size_bytes),
+      spill_directory_(spill_directory),
+      max_spill_size_bytes_(max_spill_size_bytes),
+      spill_id_(random::New64()),
       cachable_sequence_(std::move(cachable_sequence)) {
   DCHECK_GT(max_cache_size_bytes, 0)
       << "CrossTrainerCache size must be greater than 0.";
@@ -192,6 +247,13 @@ CrossTrainerCache<ElementType>::CrossTrainerCache(
           << FormatBytes(max_cache_size_bytes) << " of memory.";
 }
 
+template <class ElementType>
+CrossTrainerCache<ElementType>::~CrossTrainerCache() {
+  for (const SpilledElement& element : spilled_) {
+    Env::Default()->DeleteFile(element.filename).IgnoreError();
+  }
+}
+
 template <class ElementType>
 StatusOr<std::shared_ptr<const ElementType>>
 CrossTrainerCache<ElementType>::Get(const std::string& trainer_id)
@@ -212,20 +274,22 @@ CrossTrainerCache<ElementType>::GetCacheQueryResult(
     const std::string& trainer_id) {
   bool should_extend_cache = false;
   while (true) {
+    std::string spilled_filename;
     {
       mutex_lock l(mu_);
       TF_RETURN_IF_ERROR(status_);
       if (IsElementReady(trainer_id)) {
         TF_ASSIGN_OR_RETURN(std::shared_ptr<const ElementType> element,
-                            GetElement(trainer_id));
-        return CacheQueryResult{element,
-                                /*is_cache_hit=*/!should_extend_cache};
-      }
-
-      // Extends the cache or waits for another thread to extend the cache. When
-      // concurrent trainers wait for the next element, only one of them should
-      // extend the cache.
-      if (extending_cache_) {
+                            GetElement(trainer_id, spilled_filename));
+        if (element != nullptr) {
+          return CacheQueryResult{element,
+                                  /*is_cache_hit=*/!should_extend_cache};
+        }
+        should_extend_cache = false;
+      } else if (extending_cache_) {
+        // Extends the cache or waits for another thread to extend the cache.
+        // When concurrent trainers wait for the next element, only one of
+        // them should extend the cache.
         should_extend_cache = false;
         cv_.wait(l);
       } else {
@@ -234,6 +298,21 @@ CrossTrainerCache<ElementType>::GetCacheQueryResult(
       }
     }
 
+    if (!spilled_filename.empty()) {
+      // Added by Alpa. Reads the spilled element without holding the lock. If
+      // it has been evicted from disk meanwhile, the trainer skips to the
+      // next element.
+      StatusOr<ElementType> element =
+          cachable_sequence_->LoadElement(spilled_filename);
+      if (errors::IsNotFound(element.status())) {
+        continue;
+      }
+      TF_RETURN_IF_ERROR(element.status());
+      return CacheQueryResult{
+          std::make_shared<const ElementType>(std::move(*element)),
+          /*is_cache_hit=*/true};
+    }
+
     if (should_extend_cache) {
       Status s = ExtendCache();
       mutex_lock l(mu_);
@@ -252,7 +331,8 @@ bool CrossTrainerCache<ElementType>::IsElementReady(
 
 template <class ElementType>
 StatusOr<std::shared_ptr<const ElementType>>
-CrossTrainerCache<ElementType>::GetElement(const std::string& trainer_id)
+CrossTrainerCache<ElementType>::GetElement(const std::string& trainer_id,
+                                           std::string& spilled_filename)
     TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
   size_t element_index = GetElementIndex(trainer_id);
   if (element_index >= std::numeric_limits<size_t>::max()) {
@@ -261,22 +341,34 @@ CrossTrainerCache<ElementType>::GetElement(const std::string& trainer_id)
         element_index);
   }
 
-  std::shared_ptr<const ElementType> result =
-      cache_[element_index - cache_start_index_];
   trainer_to_element_index_map_[trainer_id] = element_index + 1;
-  return result;
+  if (element_index >= cache_start_index_) {
+    return cache_[element_index - cache_start_index_];
+  }
+  const size_t spilling_start_index = cache_start_index_ - spilling_.size();
+  if (element_index >= spilling_start_index) {
+    return spilling_[element_index - spilling_start_index];
+  }
+  spilled_filename = spilled_[element_index - OldestElementIndex()].filename;
+  return std::shared_ptr<const ElementType>();
 }
 
 template <class ElementType>
 size_t CrossTrainerCache<ElementType>::GetElementIndex(
     const std::string& trainer_id) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
   size_t element_index = trainer_to_element_index_map_[trainer_id];
-  if (element_index < cache_start_index_) {
-    element_index = cache_start_index_;
+  if (element_index < OldestElementIndex()) {
+    element_index = OldestElementIndex();
   }
   return element_index;
 }
 
+template <class ElementType>
+size_t CrossTrainerCache<ElementType>::OldestElementIndex() const
+    TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+  return cache_start_index_ - spilling_.size() - spilled_.size();
+}
+
 template <class ElementType>
 Status CrossTrainerCache<ElementType>::ExtendCache() TF_LOCKS_EXCLUDED(mu_) {
   TF_ASSIGN_OR_RETURN(ElementType element, cachable_sequence_->GetNext());
@@ -289,14 +381,81 @@ Status CrossTrainerCache<ElementType>::ExtendCache() TF_LOCKS_EXCLUDED(mu_) {
         " and cache size: ", max_cache_size_bytes_);
   }
 
-  mutex_lock l(mu_);
-  TF_RETURN_IF_ERROR(status_);
-  FreeSpace(new_element_size_bytes);
-  cache_.push_back(std::make_shared<ElementType>(std::move(element)));
-  cache_size_bytes_ += new_element_size_bytes;
+  {
+    mutex_lock l(mu_);
+    TF_RETURN_IF_ERROR(status_);
+    FreeSpace(new_element_size_bytes);
+    cache_.push_back(std::make_shared<ElementType>(std::move(element)));
+    cache_size_bytes_ += new_element_size_bytes;
+  }
+  SpillElements();
   return OkStatus();
 }
 
+template <class ElementType>
+void CrossTrainerCache<ElementType>::SpillElements() TF_LOCKS_EXCLUDED(mu_) {
+  std::vector<std::shared_ptr<const ElementType>> elements;
+  size_t first_index = 0;
+  {
+    mutex_lock l(mu_);
+    elements.assign(spilling_.begin(), spilling_.end());
+    first_index = cache_start_index_ - spilling_.size();
+  }
+  if (elements.empty()) {
+    return;
+  }
+
+  // The files are written without holding the lock, while the trainers read
+  // the elements from `spilling_`.
+  std::vector<SpilledElement> spilled;
+  std::vector<std::string> files_to_delete;
+  for (size_t i = 0; i < elements.size(); ++i) {
+    SpilledElement element{
+        io::JoinPath(spill_directory_,
+                     absl::StrCat("cross_trainer_cache_", spill_id_, "_",
+                                  first_index + i)),
+        cachable_sequence_->GetElementSizeBytes(*elements[i])};
+    Status s = cachable_sequence_->SaveElement(*elements[i], element.filename);
+    if (!s.ok()) {
+      // The elements before a failed one are dropped too, so that the spilled
+      // elements stay contiguous.
+      LOG(WARNING) << "Failed to spill a tf.data service cross-trainer cache "
+                   << "element to " << element.filename << ": " << s;
+      for (const SpilledElement& dropped : spilled) {
+        files_to_delete.push_back(dropped.filename);
+      }
+      spilled.clear();
+      continue;
+    }
+    spilled.push_back(std::move(element));
+  }
+
+  {
+    mutex_lock l(mu_);
+    const size_t num_dropped = elements.size() - spilled.size();
+    if (num_dropped > 0) {
+      for (const SpilledElement& dropped : spilled_) {
+        files_to_delete.push_back(dropped.filename);
+      }
+      spilled_.clear();
+      spilled_size_bytes_ = 0;
+    }
+    for (SpilledElement& element : spilled) {
+      spilled_size_bytes_ += element.size_bytes;
+      spilled_.push_back(std::move(element));
+    }
+    spilling_.erase(spilling_.begin(), spilling_.begin() + elements.size());
+    while (!spilled_.empty() && spilled_size_bytes_ > max_spill_size_bytes_) {
+      spilled_size_bytes_ -= spilled_.front().size_bytes;
+      files_to_delete.push_back(std::move(spilled_.front().filename));
+      spilled_.pop_front();
+    }
+  }
+  for (const std::string& filename : files_to_delete) {
+    Env::Default()->DeleteFile(filename).IgnoreError();
+  }
+}
+
 template <class ElementType>
 void CrossTrainerCache<ElementType>::FreeSpace(size_t new_element_size_bytes)
     TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
@@ -305,6 +464,9 @@ void CrossTrainerCache<ElementType>::FreeSpace(size_t new_element_size_bytes)
          cache_size_bytes_ + new_element_size_bytes > max_cache_size_bytes_) {
     size_t free_bytes =
         cachable_sequence_->GetElementSizeBytes(*cache_.front());
+    if (!spill_directory_.empty()) {
+      spilling_.push_back(std::move(cache_.front()));
+    }
     cache_.pop_front();
     cache_size_bytes_ -= free_bytes;
     ++cache_start_index_;
@@ -22,6 +22,7 @@ limitations under the License.
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/time/time.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -86,6 +87,23 @@ class SlowDataset : public CachableSequence<Tensor> {
   absl::Duration delay_;
 };
 
+class SpillableRange : public InfiniteRange {
+ public:
+  Status SaveElement(const int64_t& element,
+                     const std::string& filename) const override {
+    return WriteStringToFile(Env::Default(), filename, absl::StrCat(element));
+  }
+  StatusOr<int64_t> LoadElement(const std::string& filename) const override {
+    std::string contents;
+    TF_RETURN_IF_ERROR(ReadFileToString(Env::Default(), filename, &contents));
+    int64_t element;
+    if (!absl::SimpleAtoi(contents, &element)) {
+      return errors::DataLoss("Invalid element ", contents);
+    }
+    return element;
+  }
+};
+
 template <class T>
 class ElementOrErrorDataset : public CachableSequence<T> {
  public:
@@ -190,6 +208,28 @@ TEST(CrossTrainerCacheTest, SlowTrainersSkipData) {
   EXPECT_THAT(cache.Get("Slow trainer 2"), IsOkAndHolds(Pointee(Gt(94))));
 }
 
+TEST(CrossTrainerCacheTest, SlowTrainersReadSpilledData) {
+  CrossTrainerCache<int64_t> cache(
+      /*max_cache_size_bytes=*/5 * sizeof(int64_t),
+      std::make_unique<SpillableRange>(),
+      /*spill_directory=*/testing::TmpDir(),
+      /*max_spill_size_bytes=*/50 * sizeof(int64_t));
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_THAT(cache.Get("Fast trainer"), IsOkAndHolds(Pointee(i)));
+  }
+  // The elements evicted from memory are read from disk.
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_THAT(cache.Get("Slow trainer"), IsOkAndHolds(Pointee(i)));
+  }
+
+  for (int i = 20; i < 100; ++i) {
+    EXPECT_THAT(cache.Get("Fast trainer"), IsOkAndHolds(Pointee(i)));
+  }
+  // When 99 is cached, 5 elements are in memory and 50 on disk, so 44 must
+  // have been discarded.
+  EXPECT_THAT(cache.Get("Slow trainer"), IsOkAndHolds(Pointee(Gt(44))));
+}
+
 TEST(CrossTrainerCacheTest, NewTrainersStartLate) {
   CrossTrainerCache<int64_t> cache(
       /*max_cache_size_bytes=*/5 * sizeof(int64_t),
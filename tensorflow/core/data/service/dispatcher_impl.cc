@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <algorithm>
 #include <array>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <string>
@@ -81,6 +82,7 @@ constexpr int64_t kDefaultIterationGcCheckIntervalMs =
     10 * 60 * 1000;                                              // 10 minutes.
 constexpr int64_t kDefaultIterationGcTimeoutMs = 5 * 60 * 1000;  // 5 minutes.
 constexpr int64_t kDefaultClientTimeoutMs = 2 * 60 * 1000;       // 2 minutes.
+constexpr int64_t kDefaultJournalCompactionUpdates = 100 * 1000;
 
 constexpr std::array<const char*, 8> kNodeNameSharingOps = {
     "HashTable",
@@ -153,6 +155,10 @@ DispatcherConfig ApplyConfigDefaults(const DispatcherConfig& config) {
   if (new_config.client_timeout_ms() == 0) {
     new_config.set_client_timeout_ms(kDefaultClientTimeoutMs);
   }
+  if (new_config.journal_compaction_updates() == 0) {
+    new_config.set_journal_compaction_updates(
+        kDefaultJournalCompactionUpdates);
+  }
   return new_config;
 }
 
@@ -221,9 +227,21 @@ Status DataServiceDispatcherImpl::Start() {
   } else if (!s.ok()) {
     return s;
   } else {
+    int64_t num_updates = 0;
     while (!end_of_journal) {
       TF_RETURN_IF_ERROR(ApplyWithoutJournaling(update));
       TF_RETURN_IF_ERROR(reader.Read(update, end_of_journal));
+      ++num_updates;
+    }
+    // Added by Alpa. Nothing writes to the journal yet, so all of it can be
+    // compacted, and the next restart only replays the compacted checkpoint.
+    if (config_.journal_compaction_updates() > 0 &&
+        num_updates >= config_.journal_compaction_updates()) {
+      Status s = CompactJournal(env_, JournalDir(config_.work_dir()),
+                                std::numeric_limits<int64_t>::max());
+      if (!s.ok()) {
+        LOG(WARNING) << "Error compacting the dispatcher journal: " << s;
+      }
     }
   }
   for (const auto& iteration : state_.ListIterations()) {
@@ -309,9 +327,8 @@ Status DataServiceDispatcherImpl::FindNewTasks(
   for (const auto& task : assigned_tasks) {
     assigned_iteration_ids.insert(task->iteration->iteration_id);
   }
-  for (const auto& iteration : state_.ListIterations()) {
-    if (!assigned_iteration_ids.contains(iteration->iteration_id) &&
-        iteration->IsRoundRobin() && !iteration->finished) {
+  for (const auto& iteration : state_.ListUnfinishedRoundRobinIterations()) {
+    if (!assigned_iteration_ids.contains(iteration->iteration_id)) {
       VLOG(1) << "Creating pending task for reconnected worker "
               << worker_address;
       TF_RETURN_IF_ERROR(CreatePendingTask(iteration, worker_address));
@@ -1066,6 +1083,16 @@ Status DataServiceDispatcherImpl::PopulateTaskDef(
   std::shared_ptr<const Dataset> dataset;
   TF_RETURN_IF_ERROR(
       state_.DatasetFromId(task->iteration->job->dataset_id, dataset));
+  // Added by Alpa. Without dynamic sharding, the elements of a task only
+  // depend on the dataset and the static shard of the worker, so the cached
+  // tasks of jobs that read identical datasets share their elements.
+  if (task->iteration->job->use_cross_trainer_cache &&
+      !task->iteration->distributed_epoch_state.has_value()) {
+    task_def->set_cross_job_cache_key(absl::StrCat(
+        "fp_", dataset->fingerprint, "_sharding_",
+        task->iteration->job->processing_mode.sharding_policy(), "_worker_",
+        task_def->worker_index(), "_of_", task_def->num_workers()));
+  }
   std::string dataset_key =
       DatasetKey(dataset->dataset_id, dataset->fingerprint);
   if (config_.work_dir().empty()) {
@@ -1109,37 +1136,69 @@ Status DataServiceDispatcherImpl::Apply(const Update& update)
     TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
   if (journal_writer_.has_value()) {
     TF_RETURN_IF_ERROR(journal_writer_.value()->Write(update));
+    ++journal_updates_since_compaction_;
   }
   return state_.Apply(update);
 }
 
+std::optional<int64_t> DataServiceDispatcherImpl::MaybeRotateJournal()
+    TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+  if (!journal_writer_.has_value() ||
+      config_.journal_compaction_updates() <= 0 ||
+      journal_updates_since_compaction_ <
+          config_.journal_compaction_updates()) {
+    return std::nullopt;
+  }
+  int64_t sequence_number;
+  Status s = journal_writer_.value()->Rotate(sequence_number);
+  if (!s.ok()) {
+    LOG(WARNING) << "Error rotating the dispatcher journal: " << s;
+    return std::nullopt;
+  }
+  journal_updates_since_compaction_ = 0;
+  return sequence_number;
+}
+
 void DataServiceDispatcherImpl::IterationGcThread() {
   int64_t next_check_micros = 0;
   while (true) {
-    mutex_lock l(mu_);
-    while (!cancelled_ && env_->NowMicros() < next_check_micros) {
-      int64_t remaining_micros = next_check_micros - env_->NowMicros();
-      iteration_gc_thread_cv_.wait_for(
-          l, std::chrono::microseconds(remaining_micros));
-    }
-    if (cancelled_) {
-      return;
-    }
+    std::optional<int64_t> compacted_sequence_number;
     {
-      Status s = ReleaseMissingClients();
-      if (!s.ok()) {
-        LOG(WARNING) << "Error releasing missing clients: " << s;
+      mutex_lock l(mu_);
+      while (!cancelled_ && env_->NowMicros() < next_check_micros) {
+        int64_t remaining_micros = next_check_micros - env_->NowMicros();
+        iteration_gc_thread_cv_.wait_for(
+            l, std::chrono::microseconds(remaining_micros));
+      }
+      if (cancelled_) {
+        return;
+      }
+      {
+        Status s = ReleaseMissingClients();
+        if (!s.ok()) {
+          LOG(WARNING) << "Error releasing missing clients: " << s;
+        }
       }
-    }
 
-    {
-      Status s = GcOldIterations();
+      {
+        Status s = GcOldIterations();
+        if (!s.ok()) {
+          LOG(WARNING) << "Error garbage collecting old iterations: " << s;
+        }
+      }
+      compacted_sequence_number = MaybeRotateJournal();
+      next_check_micros =
+          env_->NowMicros() + (config_.job_gc_check_interval_ms() * 1000);
+    }
+    // Added by Alpa. The rotated journal files are no longer written to, so
+    // they are compacted without blocking the dispatcher.
+    if (compacted_sequence_number.has_value()) {
+      Status s = CompactJournal(env_, JournalDir(config_.work_dir()),
+                                *compacted_sequence_number);
       if (!s.ok()) {
-        LOG(WARNING) << "Error garbage collecting old iterations: " << s;
+        LOG(WARNING) << "Error compacting the dispatcher journal: " << s;
       }
     }
-    next_check_micros =
-        env_->NowMicros() + (config_.job_gc_check_interval_ms() * 1000);
   }
 }
 
@@ -299,7 +299,12 @@ class DataServiceDispatcherImpl {
   // used when recovering state when the dispatcher starts.
   Status ApplyWithoutJournaling(const Update& update)
       TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
-  // A thread which periodically checks for iterations to clean up.
+  // Added by Alpa. Rotates the journal once enough updates were journaled
+  // since the last compaction, and returns the sequence number of the journal
+  // files to compact.
+  std::optional<int64_t> MaybeRotateJournal() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // A thread which periodically checks for iterations to clean up, and
+  // compacts the journal.
   void IterationGcThread();
   // Releases iteration clients that haven't heartbeated recently.
   Status ReleaseMissingClients() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
@@ -344,6 +349,9 @@ class DataServiceDispatcherImpl {
 
   std::optional<std::unique_ptr<JournalWriter>> journal_writer_
       TF_GUARDED_BY(mu_);
+  // Added by Alpa. The number of updates journaled since the journal was last
+  // rotated for compaction.
+  int64_t journal_updates_since_compaction_ TF_GUARDED_BY(mu_) = 0;
   DispatcherState state_ TF_GUARDED_BY(mu_);
   // Condition variable for waking up the iteration gc thread.
   condition_variable iteration_gc_thread_cv_;
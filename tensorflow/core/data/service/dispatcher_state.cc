@@ -173,6 +173,7 @@ void DispatcherState::CreateIteration(
   DCHECK(!iterations_by_key_.contains(iteration_key) ||
          iterations_by_key_[iteration_key]->garbage_collected);
   iterations_by_key_[iteration_key] = iteration;
+  UpdateUnfinishedRoundRobinIteration(iteration);
   next_available_iteration_id_ =
       std::max(next_available_iteration_id_, iteration_id + 1);
 }
@@ -189,7 +190,8 @@ void DispatcherState::ProduceSplit(const ProduceSplitUpdate& produce_split) {
     state.indices[provider_index] = 0;
     return;
   }
-  state.indices[provider_index]++;
+  state.indices[provider_index] +=
+      std::max<int64_t>(1, produce_split.num_splits());
 }
 
 void DispatcherState::AcquireIterationClient(
@@ -227,6 +229,7 @@ void DispatcherState::GarbageCollectIteration(
   }
   iterations_[iteration_id]->finished = true;
   iterations_[iteration_id]->garbage_collected = true;
+  UpdateUnfinishedRoundRobinIteration(iterations_[iteration_id]);
 }
 
 void DispatcherState::RemoveTask(const RemoveTaskUpdate& remove_task) {
@@ -313,6 +316,20 @@ void DispatcherState::FinishTask(const FinishTaskUpdate& finish_task) {
   VLOG(3) << "Iteration " << task->iteration->iteration_id
           << " finished: " << all_finished;
   iterations_[task->iteration->iteration_id]->finished = all_finished;
+  UpdateUnfinishedRoundRobinIteration(
+      iterations_[task->iteration->iteration_id]);
+}
+
+void DispatcherState::UpdateUnfinishedRoundRobinIteration(
+    const std::shared_ptr<Iteration>& iteration) {
+  if (!iteration->IsRoundRobin()) {
+    return;
+  }
+  if (iteration->finished) {
+    unfinished_round_robin_iterations_.erase(iteration->iteration_id);
+  } else {
+    unfinished_round_robin_iterations_[iteration->iteration_id] = iteration;
+  }
 }
 
 std::string DispatcherState::NextAvailableDatasetId() const {
@@ -375,6 +392,16 @@ DispatcherState::ListIterations() const {
   return iterations;
 }
 
+std::vector<std::shared_ptr<const DispatcherState::Iteration>>
+DispatcherState::ListUnfinishedRoundRobinIterations() const {
+  std::vector<std::shared_ptr<const DispatcherState::Iteration>> iterations;
+  iterations.reserve(unfinished_round_robin_iterations_.size());
+  for (const auto& it : unfinished_round_robin_iterations_) {
+    iterations.push_back(it.second);
+  }
+  return iterations;
+}
+
 Status DispatcherState::IterationFromId(
     int64_t id, std::shared_ptr<const Iteration>& iteration) const {
   auto it = iterations_.find(id);
@@ -254,6 +254,11 @@ class DispatcherState {
   int64_t NextAvailableIterationId() const;
   // Returns a list of all iterations.
   std::vector<std::shared_ptr<const Iteration>> ListIterations() const;
+  // Added by Alpa. Returns a list of the round-robin iterations which are not
+  // finished. Unlike `ListIterations`, its cost does not grow with the number
+  // of finished iterations, so it is cheap enough for every worker heartbeat.
+  std::vector<std::shared_ptr<const Iteration>>
+  ListUnfinishedRoundRobinIterations() const;
   // Gets an iteration by id. Returns NOT_FOUND if there is no such iteration.
   Status IterationFromId(int64_t id,
                          std::shared_ptr<const Iteration>& iteration) const;
@@ -311,6 +316,10 @@ class DispatcherState {
   void ClientHeartbeat(const ClientHeartbeatUpdate& client_heartbeat);
   void CreateTask(const CreateTaskUpdate& create_task);
   void FinishTask(const FinishTaskUpdate& finish_task);
+  // Added by Alpa. Updates `unfinished_round_robin_iterations_` after the
+  // `finished` state of `iteration` may have changed.
+  void UpdateUnfinishedRoundRobinIteration(
+      const std::shared_ptr<Iteration>& iteration);
   // Updates the next available dataset ID.
   void UpdateNextAvailableDatasetId();
 
@@ -340,6 +349,10 @@ class DispatcherState {
   // Iterations, keyed by their iteration keys.
   absl::flat_hash_map<IterationKey, std::shared_ptr<Iteration>>
       iterations_by_key_;
+  // Added by Alpa. Round-robin iterations which are not finished, keyed by
+  // iteration ids.
+  absl::flat_hash_map<int64_t, std::shared_ptr<Iteration>>
+      unfinished_round_robin_iterations_;
 
   int64_t next_available_iteration_client_id_ = 3000;
   // Mapping from client ids to the iterations they are associated with.
@@ -692,5 +692,79 @@ TEST(DispatcherState, ListActiveClients) {
   EXPECT_THAT(state.ListActiveClientIds(), UnorderedElementsAre(6, 8));
 }
 
+TEST(DispatcherState, ListUnfinishedRoundRobinIterations) {
+  std::string dataset_id = "dataset_id";
+  int64_t job_id = 2;
+  int64_t round_robin_iteration_id = 3;
+  int64_t iteration_id = 4;
+  int64_t task_id = 5;
+  DispatcherState state;
+  TF_EXPECT_OK(RegisterDataset(dataset_id, state));
+  {
+    Update update;
+    CreateJobUpdate* create_job = update.mutable_create_job();
+    create_job->set_job_id(job_id);
+    create_job->set_dataset_id(dataset_id);
+    create_job->set_job_name("round_robin_job");
+    create_job->set_num_consumers(2);
+    TF_EXPECT_OK(state.Apply(update));
+  }
+  {
+    Update update;
+    CreateIterationUpdate* create_iteration = update.mutable_create_iteration();
+    create_iteration->set_job_id(job_id);
+    create_iteration->set_iteration_id(round_robin_iteration_id);
+    TF_EXPECT_OK(state.Apply(update));
+  }
+  TF_EXPECT_OK(CreateIteration(iteration_id, dataset_id, state));
+  TF_EXPECT_OK(
+      CreateTask(task_id, round_robin_iteration_id, "worker_address", state));
+  std::vector<std::shared_ptr<const Iteration>> iterations =
+      state.ListUnfinishedRoundRobinIterations();
+  ASSERT_THAT(iterations, SizeIs(1));
+  EXPECT_EQ(iterations[0]->iteration_id, round_robin_iteration_id);
+
+  TF_EXPECT_OK(FinishTask(task_id, state));
+  EXPECT_THAT(state.ListUnfinishedRoundRobinIterations(), IsEmpty());
+}
+
+TEST(DispatcherState, ProduceMergedSplits) {
+  std::string dataset_id = "dataset_id";
+  int64_t job_id = 2;
+  int64_t iteration_id = 3;
+  DispatcherState state;
+  TF_EXPECT_OK(RegisterDataset(dataset_id, state));
+  {
+    Update update;
+    CreateJobUpdate* create_job = update.mutable_create_job();
+    create_job->set_job_id(job_id);
+    create_job->set_dataset_id(dataset_id);
+    create_job->set_job_name("dynamic_job");
+    create_job->mutable_processing_mode_def()->set_sharding_policy(
+        ProcessingModeDef::DYNAMIC);
+    TF_EXPECT_OK(state.Apply(update));
+  }
+  {
+    Update update;
+    CreateIterationUpdate* create_iteration = update.mutable_create_iteration();
+    create_iteration->set_job_id(job_id);
+    create_iteration->set_iteration_id(iteration_id);
+    create_iteration->set_num_split_providers(1);
+    TF_EXPECT_OK(state.Apply(update));
+  }
+  for (int64_t num_splits : {0, 5}) {
+    Update update;
+    ProduceSplitUpdate* produce_split = update.mutable_produce_split();
+    produce_split->set_iteration_id(iteration_id);
+    produce_split->set_num_splits(num_splits);
+    TF_EXPECT_OK(state.Apply(update));
+  }
+  std::shared_ptr<const Iteration> iteration;
+  TF_EXPECT_OK(state.IterationFromId(iteration_id, iteration));
+  ASSERT_TRUE(iteration->distributed_epoch_state.has_value());
+  EXPECT_EQ(iteration->distributed_epoch_state->indices[0], 6);
+  EXPECT_EQ(iteration->distributed_epoch_state->repetitions[0], 0);
+}
+
 }  // namespace data
 }  // namespace tensorflow
@@ -16,11 +16,15 @@ limitations under the License.
 #include "tensorflow/core/data/service/journal.h"
 
 #include <algorithm>
+#include <functional>
+#include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "tensorflow/core/data/service/journal.pb.h"
 #include "tensorflow/core/lib/io/record_reader.h"
 #include "tensorflow/core/lib/io/record_writer.h"
@@ -34,6 +38,7 @@ namespace data {
 
 namespace {
 constexpr StringPiece kJournal = "journal";
+constexpr StringPiece kCheckpoint = "checkpoint";
 
 Status ParseSequenceNumber(const std::string& journal_file,
                            int64_t* sequence_number) {
@@ -43,6 +48,97 @@ Status ParseSequenceNumber(const std::string& journal_file,
   }
   return OkStatus();
 }
+
+// Parses the sequence number of the checkpoint file `filename`. Returns false
+// if `filename` is not a checkpoint file name.
+bool ParseCheckpointSequenceNumber(const std::string& filename,
+                                   int64_t* sequence_number) {
+  return RE2::FullMatch(filename, absl::StrCat(kCheckpoint, "_(\\d+)"),
+                        sequence_number);
+}
+
+// Calls `callback` on the updates of the journal file `filename`, in order.
+Status ReadJournalFile(Env* env, const std::string& filename,
+                       const std::function<Status(const Update&)>& callback) {
+  std::unique_ptr<RandomAccessFile> file;
+  TF_RETURN_IF_ERROR(env->NewRandomAccessFile(filename, &file));
+  io::RecordReaderOptions opts;
+  opts.buffer_size = 2 << 20;  // 2MB
+  io::SequentialRecordReader reader(file.get(), opts);
+  while (true) {
+    tstring record;
+    Status s = reader.ReadRecord(&record);
+    if (errors::IsOutOfRange(s)) {
+      return OkStatus();
+    }
+    TF_RETURN_IF_ERROR(s);
+    Update update;
+    if (!update.ParseFromString(record)) {
+      return errors::DataLoss("Failed to parse journal record in ", filename);
+    }
+    TF_RETURN_IF_ERROR(callback(update));
+  }
+}
+
+// Writes updates to a checkpoint, merging the runs of `ProduceSplitUpdate`s of
+// each split provider.
+class CheckpointWriter {
+ public:
+  explicit CheckpointWriter(io::RecordWriter* writer) : writer_(writer) {}
+
+  Status Add(const Update& update) {
+    if (!update.has_produce_split()) {
+      return Write(update);
+    }
+    const ProduceSplitUpdate& produce_split = update.produce_split();
+    std::pair<int64_t, int64_t> key(produce_split.iteration_id(),
+                                    produce_split.split_provider_index());
+    auto it = runs_.find(key);
+    if (it != runs_.end() &&
+        (produce_split.finished() ||
+         it->second.repetition() != produce_split.repetition())) {
+      TF_RETURN_IF_ERROR(Flush(it->second));
+      runs_.erase(it);
+      it = runs_.end();
+    }
+    if (produce_split.finished()) {
+      return Write(update);
+    }
+    int64_t num_splits = std::max<int64_t>(1, produce_split.num_splits());
+    if (it == runs_.end()) {
+      ProduceSplitUpdate& run = runs_[key];
+      run = produce_split;
+      run.set_num_splits(num_splits);
+      return OkStatus();
+    }
+    it->second.set_num_splits(it->second.num_splits() + num_splits);
+    return OkStatus();
+  }
+
+  // Writes the runs that are not finished yet.
+  Status Finish() {
+    for (const auto& run : runs_) {
+      TF_RETURN_IF_ERROR(Flush(run.second));
+    }
+    runs_.clear();
+    return OkStatus();
+  }
+
+ private:
+  Status Flush(const ProduceSplitUpdate& run) {
+    Update update;
+    *update.mutable_produce_split() = run;
+    return Write(update);
+  }
+
+  Status Write(const Update& update) {
+    return writer_->WriteRecord(update.SerializeAsString());
+  }
+
+  io::RecordWriter* const writer_;
+  // The pending run of each (iteration id, split provider index).
+  std::map<std::pair<int64_t, int64_t>, ProduceSplitUpdate> runs_;
+};
 }  // namespace
 
 std::string DataServiceJournalFile(const std::string& journal_dir,
@@ -51,6 +147,89 @@ std::string DataServiceJournalFile(const std::string& journal_dir,
                       absl::StrCat(kJournal, "_", sequence_number));
 }
 
+std::string DataServiceJournalCheckpointFile(const std::string& journal_dir,
+                                             int64_t sequence_number) {
+  return io::JoinPath(journal_dir,
+                      absl::StrCat(kCheckpoint, "_", sequence_number));
+}
+
+Status CompactJournal(Env* env, const std::string& journal_dir,
+                      int64_t sequence_number) {
+  std::vector<std::string> filenames;
+  TF_RETURN_IF_ERROR(env->GetChildren(journal_dir, &filenames));
+  int64_t latest_checkpoint = -1;
+  std::vector<int64_t> checkpoints;
+  std::vector<int64_t> journals;
+  for (const auto& filename : filenames) {
+    int64_t file_sequence_number;
+    if (ParseCheckpointSequenceNumber(filename, &file_sequence_number)) {
+      if (file_sequence_number <= sequence_number) {
+        checkpoints.push_back(file_sequence_number);
+        latest_checkpoint = std::max(latest_checkpoint, file_sequence_number);
+      }
+      continue;
+    }
+    TF_RETURN_IF_ERROR(ParseSequenceNumber(filename, &file_sequence_number));
+    if (file_sequence_number <= sequence_number) {
+      journals.push_back(file_sequence_number);
+    }
+  }
+  std::sort(journals.begin(), journals.end());
+  // The journal files superseded by the latest checkpoint are left over from
+  // an interrupted compaction, and only need to be deleted.
+  auto first_journal =
+      std::upper_bound(journals.begin(), journals.end(), latest_checkpoint);
+  if (first_journal == journals.end()) {
+    VLOG(1) << "No journal files to compact in " << journal_dir;
+  } else {
+    const int64_t checkpoint_sequence_number = journals.back();
+    // The checkpoint is written outside of the journal directory so that
+    // readers and writers never see it partially written.
+    const std::string tmp_filename =
+        absl::StrCat(journal_dir, "_", kCheckpoint, "_tmp");
+    std::unique_ptr<WritableFile> file;
+    TF_RETURN_IF_ERROR(env->NewWritableFile(tmp_filename, &file));
+    auto writer = std::make_unique<io::RecordWriter>(file.get());
+    CheckpointWriter checkpoint_writer(writer.get());
+    auto add = [&checkpoint_writer](const Update& update) {
+      return checkpoint_writer.Add(update);
+    };
+    if (latest_checkpoint >= 0) {
+      TF_RETURN_IF_ERROR(ReadJournalFile(
+          env, DataServiceJournalCheckpointFile(journal_dir, latest_checkpoint),
+          add));
+    }
+    for (auto it = first_journal; it != journals.end(); ++it) {
+      TF_RETURN_IF_ERROR(
+          ReadJournalFile(env, DataServiceJournalFile(journal_dir, *it), add));
+    }
+    TF_RETURN_IF_ERROR(checkpoint_writer.Finish());
+    TF_RETURN_IF_ERROR(writer->Close());
+    TF_RETURN_IF_ERROR(file->Sync());
+    TF_RETURN_IF_ERROR(file->Close());
+    TF_RETURN_IF_ERROR(env->RenameFile(
+        tmp_filename,
+        DataServiceJournalCheckpointFile(journal_dir,
+                                         checkpoint_sequence_number)));
+    VLOG(1) << "Compacted journal files up to " << checkpoint_sequence_number
+            << " in " << journal_dir;
+    latest_checkpoint = checkpoint_sequence_number;
+  }
+  for (int64_t checkpoint : checkpoints) {
+    if (checkpoint < latest_checkpoint) {
+      TF_RETURN_IF_ERROR(env->DeleteFile(
+          DataServiceJournalCheckpointFile(journal_dir, checkpoint)));
+    }
+  }
+  for (int64_t journal : journals) {
+    if (journal <= latest_checkpoint) {
+      TF_RETURN_IF_ERROR(
+          env->DeleteFile(DataServiceJournalFile(journal_dir, journal)));
+    }
+  }
+  return OkStatus();
+}
+
 FileJournalWriter::FileJournalWriter(Env* env, const std::string& journal_dir)
     : env_(env), journal_dir_(journal_dir) {}
 
@@ -67,8 +246,9 @@ Status FileJournalWriter::EnsureInitialized() {
     TF_RETURN_IF_ERROR(ParseSequenceNumber(file, &sequence_number));
     latest_sequence_number = std::max(latest_sequence_number, sequence_number);
   }
+  sequence_number_ = latest_sequence_number + 1;
   std::string journal_file =
-      DataServiceJournalFile(journal_dir_, latest_sequence_number + 1);
+      DataServiceJournalFile(journal_dir_, sequence_number_);
   TF_RETURN_IF_ERROR(env_->NewAppendableFile(journal_file, &file_));
   writer_ = std::make_unique<io::RecordWriter>(file_.get());
   VLOG(1) << "Created journal writer to write to " << journal_file;
@@ -91,6 +271,21 @@ Status FileJournalWriter::Write(const Update& update) {
   return OkStatus();
 }
 
+Status FileJournalWriter::Rotate(int64_t& sequence_number) {
+  if (!writer_) {
+    return errors::FailedPrecondition(
+        "The journal writer has no journal file to rotate.");
+  }
+  TF_RETURN_IF_ERROR(writer_->Close());
+  TF_RETURN_IF_ERROR(file_->Close());
+  writer_.reset();
+  file_.reset();
+  sequence_number = sequence_number_;
+  VLOG(1) << "Rotated journal file "
+          << DataServiceJournalFile(journal_dir_, sequence_number_);
+  return OkStatus();
+}
+
 FileJournalReader::FileJournalReader(Env* env, StringPiece journal_dir)
     : env_(env), journal_dir_(journal_dir) {}
 
@@ -98,6 +293,24 @@ Status FileJournalReader::EnsureInitialized() {
   if (reader_) {
     return OkStatus();
   }
+  std::vector<std::string> filenames;
+  Status s = env_->GetChildren(journal_dir_, &filenames);
+  if (!errors::IsNotFound(s)) {
+    TF_RETURN_IF_ERROR(s);
+  }
+  int64_t latest_checkpoint = -1;
+  for (const auto& filename : filenames) {
+    int64_t sequence_number;
+    if (ParseCheckpointSequenceNumber(filename, &sequence_number)) {
+      latest_checkpoint = std::max(latest_checkpoint, sequence_number);
+    }
+  }
+  if (latest_checkpoint >= 0) {
+    // The journal files after the checkpoint are read next.
+    sequence_number_ = latest_checkpoint;
+    return UpdateFile(
+        DataServiceJournalCheckpointFile(journal_dir_, latest_checkpoint));
+  }
   return UpdateFile(DataServiceJournalFile(journal_dir_, 0));
 }
 
@@ -15,6 +15,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DATA_SERVICE_JOURNAL_H_
 #define TENSORFLOW_CORE_DATA_SERVICE_JOURNAL_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -23,6 +24,7 @@ limitations under the License.
 #include "tensorflow/core/lib/io/record_reader.h"
 #include "tensorflow/core/lib/io/record_writer.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
 
 namespace tensorflow {
 namespace data {
@@ -31,6 +33,20 @@ namespace data {
 std::string DataServiceJournalFile(const std::string& journal_dir,
                                    int64_t sequence_number);
 
+// Added by Alpa. Returns the location of the checkpoint file within the
+// journal directory which replaces the journal files up to `sequence_number`.
+std::string DataServiceJournalCheckpointFile(const std::string& journal_dir,
+                                             int64_t sequence_number);
+
+// Added by Alpa. Compacts the journal files in `journal_dir` up to and
+// including `sequence_number`, together with any older checkpoint, into the
+// checkpoint `DataServiceJournalCheckpointFile(journal_dir, sequence_number)`
+// and deletes them. The runs of `ProduceSplitUpdate`s of a split provider are
+// merged into one update. The journal files up to `sequence_number` must no
+// longer be written to, see `JournalWriter::Rotate`.
+Status CompactJournal(Env* env, const std::string& journal_dir,
+                      int64_t sequence_number);
+
 // Interface for writing to a journal.
 class JournalWriter {
  public:
@@ -39,6 +55,12 @@ class JournalWriter {
   virtual Status Write(const Update& update) = 0;
   // Initializes the writer if it is not yet initialized.
   virtual Status EnsureInitialized() = 0;
+  // Added by Alpa. Closes the journal file being written and sets
+  // `sequence_number` to its sequence number. The next update is written to a
+  // new journal file.
+  virtual Status Rotate(int64_t& sequence_number) {
+    return errors::Unimplemented("Journal rotation is not supported.");
+  }
 };
 
 // FileJournalWriter is not thread-safe, requiring external synchronization when
@@ -52,6 +74,9 @@ class JournalWriter {
 //   journal_1
 //   ...
 //
+// Added by Alpa: once compacted, the journal files up to `journal_<n>` are
+// replaced by the file `checkpoint_<n>`, which holds the same updates.
+//
 // When the writer is created, it lists the directory to find the next available
 // journal file name. For example, if the journal directory contains
 // "journal_0", "journal_1", and "journal_2", the writer will write to
@@ -68,10 +93,13 @@ class FileJournalWriter : public JournalWriter {
 
   Status Write(const Update& update) override;
   Status EnsureInitialized() override;
+  Status Rotate(int64_t& sequence_number) override;
 
  private:
   Env* env_;
   const std::string journal_dir_;
+  // Added by Alpa. Sequence number of the journal file being written.
+  int64_t sequence_number_ = -1;
   std::unique_ptr<WritableFile> file_;
   std::unique_ptr<io::RecordWriter> writer_;
 };
@@ -90,6 +118,8 @@ class JournalReader {
 //
 // The journal reader reads through all journal files in the configured journal
 // directory, in order of their sequence numbers. See FileJournalWriter above.
+// Added by Alpa: if the directory has a checkpoint, the reader starts from the
+// latest checkpoint and continues with the journal files after it.
 class FileJournalReader : public JournalReader {
  public:
   explicit FileJournalReader(Env* env, StringPiece journal_dir);
@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/data/service/journal.h"
 
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -66,6 +67,15 @@ Update MakeRegisterDatasetUpdate() {
   return update;
 }
 
+Update MakeProduceSplitUpdate(bool finished) {
+  Update update;
+  ProduceSplitUpdate* produce_split = update.mutable_produce_split();
+  produce_split->set_iteration_id(8);
+  produce_split->set_split_provider_index(0);
+  produce_split->set_finished(finished);
+  return update;
+}
+
 Status CheckJournalContent(StringPiece journal_dir,
                            const std::vector<Update>& expected) {
   FileJournalReader reader(Env::Default(), journal_dir);
@@ -114,6 +124,52 @@ TEST(Journal, AppendExistingJournal) {
   TF_EXPECT_OK(CheckJournalContent(journal_dir, updates));
 }
 
+TEST(Journal, CompactJournal) {
+  std::string journal_dir;
+  EXPECT_TRUE(NewJournalDir(journal_dir));
+  {
+    FileJournalWriter writer(Env::Default(), journal_dir);
+    TF_EXPECT_OK(writer.Write(MakeCreateIterationUpdate()));
+    TF_EXPECT_OK(writer.Write(MakeProduceSplitUpdate(/*finished=*/false)));
+    int64_t sequence_number;
+    TF_EXPECT_OK(writer.Rotate(sequence_number));
+    EXPECT_EQ(sequence_number, 0);
+    TF_EXPECT_OK(writer.Write(MakeProduceSplitUpdate(/*finished=*/false)));
+    TF_EXPECT_OK(writer.Write(MakeProduceSplitUpdate(/*finished=*/true)));
+    TF_EXPECT_OK(writer.Write(MakeProduceSplitUpdate(/*finished=*/false)));
+    TF_EXPECT_OK(writer.Rotate(sequence_number));
+    EXPECT_EQ(sequence_number, 1);
+    TF_EXPECT_OK(CompactJournal(Env::Default(), journal_dir, sequence_number));
+    TF_EXPECT_OK(writer.Write(MakeFinishTaskUpdate()));
+  }
+  TF_EXPECT_OK(Env::Default()->FileExists(
+      DataServiceJournalCheckpointFile(journal_dir, /*sequence_number=*/1)));
+  EXPECT_TRUE(errors::IsNotFound(Env::Default()->FileExists(
+      DataServiceJournalFile(journal_dir, /*sequence_number=*/0))));
+
+  Update merged_splits = MakeProduceSplitUpdate(/*finished=*/false);
+  merged_splits.mutable_produce_split()->set_num_splits(2);
+  Update split = MakeProduceSplitUpdate(/*finished=*/false);
+  split.mutable_produce_split()->set_num_splits(1);
+  TF_EXPECT_OK(CheckJournalContent(
+      journal_dir, {MakeCreateIterationUpdate(), merged_splits,
+                    MakeProduceSplitUpdate(/*finished=*/true), split,
+                    MakeFinishTaskUpdate()}));
+
+  // Compacting again replaces the checkpoint. The pending run of splits is
+  // written at the end.
+  TF_EXPECT_OK(CompactJournal(Env::Default(), journal_dir,
+                              std::numeric_limits<int64_t>::max()));
+  EXPECT_TRUE(errors::IsNotFound(Env::Default()->FileExists(
+      DataServiceJournalCheckpointFile(journal_dir, /*sequence_number=*/1))));
+  TF_EXPECT_OK(Env::Default()->FileExists(
+      DataServiceJournalCheckpointFile(journal_dir, /*sequence_number=*/2)));
+  TF_EXPECT_OK(CheckJournalContent(
+      journal_dir, {MakeCreateIterationUpdate(), merged_splits,
+                    MakeProduceSplitUpdate(/*finished=*/true),
+                    MakeFinishTaskUpdate(), split}));
+}
+
 TEST(Journal, MissingFile) {
   std::string journal_dir;
   EXPECT_TRUE(NewJournalDir(journal_dir));
@@ -19,6 +19,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "tensorflow/core/data/service/common.h"
 #include "tensorflow/core/data/service/cross_trainer_cache.h"
 #include "tensorflow/core/data/service/data_transfer.h"
@@ -37,6 +38,7 @@ limitations under the License.
 #include "tensorflow/core/platform/statusor.h"
 #include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/protobuf/service_config.pb.h"
+#include "tensorflow/core/protobuf/snapshot.pb.h"
 
 namespace tensorflow {
 namespace data {
@@ -45,6 +47,9 @@ namespace {
 constexpr int64_t kWaitBeforeSkipUs = 100 * 1000;  // 100ms.
 constexpr size_t kDefaultCrossTrainerCacheSizeBytes =
     10 * (size_t{1} << 30);  // 10GB
+// Added by Alpa.
+constexpr size_t kDefaultCrossTrainerCacheSpillSizeBytes =
+    100 * (size_t{1} << 30);  // 100GB
 
 }  // namespace
 
@@ -80,12 +85,7 @@ Status TaskRunner::Create(const experimental::WorkerConfig& worker_config,
                                                  task_def.num_consumers(),
                                                  task_def.worker_address());
   } else if (task_def.use_cross_trainer_cache()) {
-    const size_t max_cache_size_bytes =
-        worker_config.cross_trainer_cache_size_bytes() > 0
-            ? worker_config.cross_trainer_cache_size_bytes()
-            : kDefaultCrossTrainerCacheSizeBytes;
-    out = std::make_unique<CachingTaskRunner>(std::move(iterator),
-                                              max_cache_size_bytes);
+    out = CachingTaskRunner::Create(worker_config, std::move(iterator));
   } else {
     out = std::make_unique<FirstComeFirstServedTaskRunner>(std::move(iterator));
   }
@@ -154,14 +154,34 @@ void FirstComeFirstServedTaskRunner::Cancel() {
 }
 
 CachingTaskRunner::CachingTaskRunner(std::unique_ptr<TaskIterator> iterator,
-                                     size_t max_cache_size_bytes)
+                                     size_t max_cache_size_bytes,
+                                     const std::string& spill_directory,
+                                     size_t max_spill_size_bytes)
     : fcfs_task_runner_(std::move(iterator)),
       cache_(max_cache_size_bytes,
-             std::make_unique<GetElementResultSequence>(fcfs_task_runner_)) {
+             std::make_unique<GetElementResultSequence>(fcfs_task_runner_),
+             spill_directory, max_spill_size_bytes) {
   LOG(INFO) << "Initialized tf.data service cross-trainer cache with "
             << FormatBytes(max_cache_size_bytes) << " of memory.";
 }
 
+std::unique_ptr<CachingTaskRunner> CachingTaskRunner::Create(
+    const experimental::WorkerConfig& worker_config,
+    std::unique_ptr<TaskIterator> iterator) {
+  const size_t max_cache_size_bytes =
+      worker_config.cross_trainer_cache_size_bytes() > 0
+          ? worker_config.cross_trainer_cache_size_bytes()
+          : kDefaultCrossTrainerCacheSizeBytes;
+  const size_t max_spill_size_bytes =
+      worker_config.cross_trainer_cache_spill_size_bytes() > 0
+          ? worker_config.cross_trainer_cache_spill_size_bytes()
+          : kDefaultCrossTrainerCacheSpillSizeBytes;
+  return std::make_unique<CachingTaskRunner>(
+      std::move(iterator), max_cache_size_bytes,
+      worker_config.cross_trainer_cache_spill_directory(),
+      max_spill_size_bytes);
+}
+
 CachingTaskRunner::~CachingTaskRunner() { Cancel(); }
 
 Status CachingTaskRunner::GetNext(const GetElementRequest& req,
@@ -193,6 +213,43 @@ size_t CachingTaskRunner::GetElementResultSequence::GetElementSizeBytes(
   return element.EstimatedMemoryUsageBytes();
 }
 
+Status CachingTaskRunner::GetElementResultSequence::SaveElement(
+    const GetElementResult& element, const std::string& filename) const {
+  // The element index is stored as a trailing scalar after the components.
+  experimental::SnapshotRecord record;
+  for (const Tensor& component : element.components) {
+    component.AsProtoTensorContent(record.add_tensor());
+  }
+  Tensor element_index(element.element_index);
+  element_index.AsProtoTensorContent(record.add_tensor());
+  return WriteBinaryProto(Env::Default(), filename, record);
+}
+
+StatusOr<GetElementResult>
+CachingTaskRunner::GetElementResultSequence::LoadElement(
+    const std::string& filename) const {
+  experimental::SnapshotRecord record;
+  TF_RETURN_IF_ERROR(ReadBinaryProto(Env::Default(), filename, &record));
+  if (record.tensor_size() == 0) {
+    return errors::DataLoss("Spilled tf.data service element ", filename,
+                            " has no element index.");
+  }
+  GetElementResult result;
+  for (int i = 0; i < record.tensor_size(); ++i) {
+    Tensor tensor;
+    if (!tensor.FromProto(record.tensor(i))) {
+      return errors::DataLoss(
+          "Could not parse spilled tf.data service element ", filename);
+    }
+    if (i == record.tensor_size() - 1) {
+      result.element_index = tensor.scalar<int64_t>()();
+    } else {
+      result.components.push_back(std::move(tensor));
+    }
+  }
+  return result;
+}
+
 void CachingTaskRunner::Cancel() {
   VLOG(2) << "Cancelling tf.data service cross-trainer cache task.";
   if (!cache_.IsCancelled()) {
@@ -202,6 +259,36 @@ void CachingTaskRunner::Cancel() {
   fcfs_task_runner_.Cancel();
 }
 
+SharedCachingTaskRunner::SharedCachingTaskRunner(
+    std::shared_ptr<CachingTaskRunner> task_runner,
+    const std::string& trainer_id_prefix)
+    : task_runner_(std::move(task_runner)),
+      trainer_id_prefix_(trainer_id_prefix) {}
+
+Status SharedCachingTaskRunner::GetNext(const GetElementRequest& req,
+                                        GetElementResult& result) {
+  {
+    mutex_lock l(mu_);
+    if (cancelled_) {
+      return errors::Cancelled(
+          "tf.data service shared cross-trainer cache task is cancelled.");
+    }
+  }
+  if (req.trainer_id().empty()) {
+    return task_runner_->GetNext(req, result);
+  }
+  GetElementRequest qualified_req = req;
+  qualified_req.set_trainer_id(
+      absl::StrCat(trainer_id_prefix_, "/", req.trainer_id()));
+  return task_runner_->GetNext(qualified_req, result);
+}
+
+void SharedCachingTaskRunner::Cancel() {
+  VLOG(2) << "Cancelling tf.data service shared cross-trainer cache task.";
+  mutex_lock l(mu_);
+  cancelled_ = true;
+}
+
 RoundRobinTaskRunner::RoundRobinTaskRunner(
     std::unique_ptr<TaskIterator> iterator, int64_t num_consumers,
     string worker_address)
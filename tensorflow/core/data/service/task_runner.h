@@ -16,6 +16,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_DATA_SERVICE_TASK_RUNNER_H_
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "tensorflow/core/data/service/common.pb.h"
@@ -122,10 +123,20 @@ class FirstComeFirstServedTaskRunner : public TaskRunner {
 // read the full dataset.
 class CachingTaskRunner : public TaskRunner {
  public:
+  // Added by Alpa: if `spill_directory` is not empty, the elements evicted
+  // from memory are spilled there, up to `max_spill_size_bytes`.
   explicit CachingTaskRunner(std::unique_ptr<TaskIterator> iterator,
-                             size_t max_cache_size_bytes);
+                             size_t max_cache_size_bytes,
+                             const std::string& spill_directory = "",
+                             size_t max_spill_size_bytes = 0);
   ~CachingTaskRunner() override;
 
+  // Added by Alpa. Creates a caching task runner configured by
+  // `worker_config`.
+  static std::unique_ptr<CachingTaskRunner> Create(
+      const experimental::WorkerConfig& worker_config,
+      std::unique_ptr<TaskIterator> iterator);
+
   // Gets the next element from the cross-trainer cache, blocking if the data is
   // not ready.
   // REQUIRES: !req.trainer_id().empty()
@@ -146,6 +157,10 @@ class CachingTaskRunner : public TaskRunner {
         FirstComeFirstServedTaskRunner& fcfs_task_runner);
     StatusOr<GetElementResult> GetNext() override;
     size_t GetElementSizeBytes(const GetElementResult& element) const override;
+    Status SaveElement(const GetElementResult& element,
+                       const std::string& filename) const override;
+    StatusOr<GetElementResult> LoadElement(
+        const std::string& filename) const override;
 
    private:
     FirstComeFirstServedTaskRunner& fcfs_task_runner_;
@@ -157,6 +172,29 @@ class CachingTaskRunner : public TaskRunner {
   TF_DISALLOW_COPY_AND_ASSIGN(CachingTaskRunner);
 };
 
+// Added by Alpa. A task runner which reads from a `CachingTaskRunner` shared
+// by the tasks of several jobs that produce the same elements, so that the
+// jobs do not each compute the dataset. The trainer IDs are qualified with
+// `trainer_id_prefix`, which identifies the job, so that trainers of
+// different jobs read independently. Cancelling only cancels this task's
+// reads; the shared runner is cancelled once no task holds it.
+class SharedCachingTaskRunner : public TaskRunner {
+ public:
+  SharedCachingTaskRunner(std::shared_ptr<CachingTaskRunner> task_runner,
+                          const std::string& trainer_id_prefix);
+
+  Status GetNext(const GetElementRequest& req,
+                 GetElementResult& result) override;
+  void Cancel() override;
+
+ private:
+  const std::shared_ptr<CachingTaskRunner> task_runner_;
+  const std::string trainer_id_prefix_;
+
+  mutex mu_;
+  bool cancelled_ TF_GUARDED_BY(mu_) = false;
+};
+
 // An element produced by a task.
 struct Element {
   explicit Element(std::vector<Tensor>&& components, int64_t index)
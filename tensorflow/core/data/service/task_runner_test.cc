@@ -356,6 +356,54 @@ TEST(CachingTaskRunnerTest, SlowClientSkipsData) {
   EXPECT_THAT(slow_trainer_output[0], Gt(0));
 }
 
+TEST(CachingTaskRunnerTest, SlowClientReadsSpilledData) {
+  size_t range = 100;
+  CachingTaskRunner runner(std::make_unique<InfiniteRangeIterator>(),
+                           /*max_cache_size_bytes=*/kSmallCache,
+                           /*spill_directory=*/testing::TmpDir(),
+                           /*max_spill_size_bytes=*/kLargeCache);
+
+  GetElementRequest request;
+  request.set_trainer_id("Fast trainer");
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<int64_t> fast_trainer_output,
+      GetElementsFromTaskRunner<int64_t>(runner, request, range));
+  EXPECT_THAT(fast_trainer_output, ElementsAreArray(GetRange(range)));
+
+  request.set_trainer_id("Slow trainer");
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<int64_t> slow_trainer_output,
+      GetElementsFromTaskRunner<int64_t>(runner, request, range));
+  EXPECT_THAT(slow_trainer_output, ElementsAreArray(GetRange(range)));
+}
+
+TEST(SharedCachingTaskRunnerTest, JobsReadIndependently) {
+  size_t range = 10;
+  auto shared_runner = std::make_shared<CachingTaskRunner>(
+      std::make_unique<InfiniteRangeIterator>(),
+      /*max_cache_size_bytes=*/kLargeCache);
+  SharedCachingTaskRunner job1(shared_runner, "iteration_1");
+  SharedCachingTaskRunner job2(shared_runner, "iteration_2");
+
+  GetElementRequest request;
+  request.set_trainer_id("Trainer");
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<int64_t> job1_output,
+      GetElementsFromTaskRunner<int64_t>(job1, request, range));
+  EXPECT_THAT(job1_output, ElementsAreArray(GetRange(range)));
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<int64_t> job2_output,
+      GetElementsFromTaskRunner<int64_t>(job2, request, range));
+  EXPECT_THAT(job2_output, ElementsAreArray(GetRange(range)));
+
+  // Cancelling one job does not cancel the shared cache.
+  job1.Cancel();
+  EXPECT_THAT(GetNextFromTaskRunner<int64_t>(job1, request),
+              testing::StatusIs(error::CANCELLED));
+  EXPECT_THAT(GetNextFromTaskRunner<int64_t>(job2, request),
+              IsOkAndHolds(range));
+}
+
 TEST(CachingTaskRunnerTest, ConcurrentTrainers) {
   size_t range = 100;
   size_t num_readers = 10;
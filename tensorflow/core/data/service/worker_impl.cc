@@ -23,6 +23,7 @@ limitations under the License.
 #include "grpcpp/create_channel.h"
 #include "absl/algorithm/container.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
 #include "absl/strings/substitute.h"
@@ -75,7 +76,8 @@ using WorkerConfig = experimental::WorkerConfig;
 
 // Moves the element into the response. If the tensor contains a single
 // CompressedElement variant, the move will be zero-copy. Otherwise, the tensor
-// data will be serialized as TensorProtos.
+// data will be serialized as TensorProtos. Added by Alpa: elements whose tensor
+// is shared, e.g. with the cross-trainer cache, are copied.
 Status MoveElementToResponse(std::vector<Tensor>&& element,
                              GetElementResponse& resp) {
   if (element.size() != 1 || element[0].dtype() != DT_VARIANT ||
@@ -94,7 +96,11 @@ Status MoveElementToResponse(std::vector<Tensor>&& element,
         "it produced ",
         variant.TypeName());
   }
-  *resp.mutable_compressed() = *compressed;
+  if (element[0].RefCountIsOne()) {
+    resp.mutable_compressed()->Swap(compressed);
+  } else {
+    *resp.mutable_compressed() = *compressed;
+  }
   return OkStatus();
 }
 
@@ -318,6 +324,18 @@ Status DataServiceWorkerImpl::EnsureTaskInitialized(
   if (task.initialized) {
     return OkStatus();
   }
+  const std::string trainer_id_prefix =
+      absl::StrCat("iteration_", task.task_def.iteration_id());
+  if (std::shared_ptr<CachingTaskRunner> cache =
+          FindCrossJobCache(task.task_def)) {
+    VLOG(3) << "Task " << task.task_def.task_id()
+            << " reads from the shared cross-trainer cache "
+            << task.task_def.cross_job_cache_key();
+    task.task_runner = std::make_unique<SharedCachingTaskRunner>(
+        std::move(cache), trainer_id_prefix);
+    task.initialized = true;
+    return OkStatus();
+  }
   TF_ASSIGN_OR_RETURN(DatasetDef dataset_def, GetDatasetDef(task.task_def));
   TF_ASSIGN_OR_RETURN(std::unique_ptr<standalone::Dataset> dataset,
                       MakeDataset(dataset_def, task.task_def));
@@ -325,14 +343,55 @@ Status DataServiceWorkerImpl::EnsureTaskInitialized(
                       MakeDatasetIterator(*dataset, task.task_def));
   auto task_iterator = std::make_unique<StandaloneTaskIterator>(
       std::move(dataset), std::move(iterator));
-  TF_RETURN_IF_ERROR(TaskRunner::Create(
-      config_, task.task_def, std::move(task_iterator), task.task_runner));
+  if (task.task_def.cross_job_cache_key().empty()) {
+    TF_RETURN_IF_ERROR(TaskRunner::Create(
+        config_, task.task_def, std::move(task_iterator), task.task_runner));
+  } else {
+    std::shared_ptr<CachingTaskRunner> cache = RegisterCrossJobCache(
+        task.task_def,
+        CachingTaskRunner::Create(config_, std::move(task_iterator)));
+    task.task_runner = std::make_unique<SharedCachingTaskRunner>(
+        std::move(cache), trainer_id_prefix);
+  }
 
   task.initialized = true;
   VLOG(3) << "Created iterator for task " << task.task_def.task_id();
   return OkStatus();
 }
 
+std::shared_ptr<CachingTaskRunner> DataServiceWorkerImpl::FindCrossJobCache(
+    const TaskDef& task_def) TF_LOCKS_EXCLUDED(mu_) {
+  if (task_def.cross_job_cache_key().empty()) {
+    return nullptr;
+  }
+  mutex_lock l(mu_);
+  auto it = cross_job_caches_.find(task_def.cross_job_cache_key());
+  if (it == cross_job_caches_.end()) {
+    return nullptr;
+  }
+  return it->second.lock();
+}
+
+std::shared_ptr<CachingTaskRunner> DataServiceWorkerImpl::RegisterCrossJobCache(
+    const TaskDef& task_def, std::shared_ptr<CachingTaskRunner> task_runner)
+    TF_LOCKS_EXCLUDED(mu_) {
+  mutex_lock l(mu_);
+  std::weak_ptr<CachingTaskRunner>& cache =
+      cross_job_caches_[task_def.cross_job_cache_key()];
+  if (std::shared_ptr<CachingTaskRunner> existing = cache.lock()) {
+    return existing;
+  }
+  cache = task_runner;
+  for (auto it = cross_job_caches_.begin(); it != cross_job_caches_.end();) {
+    if (it->second.expired()) {
+      cross_job_caches_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  return task_runner;
+}
+
 StatusOr<DatasetDef> DataServiceWorkerImpl::GetDatasetDef(
     const TaskDef& task_def) const {
   switch (task_def.dataset_case()) {
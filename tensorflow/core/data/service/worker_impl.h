@@ -104,6 +104,16 @@ class DataServiceWorkerImpl {
   Status ProcessTaskInternal(const TaskDef& task)
       TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
   Status EnsureTaskInitialized(Task& task);
+  // Added by Alpa. Returns the cross-trainer cache shared by the tasks with
+  // `task_def.cross_job_cache_key()`, or nullptr if there is none.
+  std::shared_ptr<CachingTaskRunner> FindCrossJobCache(const TaskDef& task_def)
+      TF_LOCKS_EXCLUDED(mu_);
+  // Added by Alpa. Shares `task_runner` with the later tasks with the same
+  // cross-job cache key, unless another task registered a cache for the key
+  // first, in which case that one is returned.
+  std::shared_ptr<CachingTaskRunner> RegisterCrossJobCache(
+      const TaskDef& task_def, std::shared_ptr<CachingTaskRunner> task_runner)
+      TF_LOCKS_EXCLUDED(mu_);
   // Stops a task, cancelling the task's outstanding requests and waiting for
   // them to finish.
   void StopTask(Task& task) TF_LOCKS_EXCLUDED(mu_);
@@ -138,6 +148,11 @@ class DataServiceWorkerImpl {
   absl::flat_hash_map<int64_t, std::shared_ptr<Task>> tasks_ TF_GUARDED_BY(mu_);
   // Ids of tasks that have finished.
   absl::flat_hash_set<int64_t> finished_tasks_ TF_GUARDED_BY(mu_);
+  // Added by Alpa. Cross-trainer caches shared by the tasks of different jobs,
+  // keyed by `TaskDef.cross_job_cache_key`. A cache is released once the last
+  // task reading it is deleted.
+  absl::flat_hash_map<std::string, std::weak_ptr<CachingTaskRunner>>
+      cross_job_caches_ TF_GUARDED_BY(mu_);
   // Completed tasks which haven't yet been communicated to the dispatcher.
   absl::flat_hash_set<int64_t> pending_completed_tasks_ TF_GUARDED_BY(mu_);
   // Tasks deleted by the local client. If the client tries to read from them
@@ -22,11 +22,14 @@ limitations under the License.
 #include <utility>
 
 #include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/data/name_utils.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
 #include "tensorflow/core/lib/io/buffered_inputstream.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
 #include "tensorflow/core/lib/io/record_writer.h"
@@ -58,8 +61,26 @@ constexpr const char* const kCurrentCheckpointID = "current_checkpoint_id";
 constexpr const char* const kIndex = "index";
 constexpr const char* const kStartIndex = "start_index";
 
+// Added by Alpa. The codecs of the chunks of an adaptive file. A chunk starts
+// with its codec and the masked crc32c of its payload.
+constexpr uint8 kChunkUncompressed = 0;
+constexpr uint8 kChunkSnappy = 1;
+constexpr size_t kChunkHeaderSize = 1 + sizeof(uint32);
+
+// Added by Alpa. The weight of a new measurement in the moving averages of
+// `AdaptiveCodecSelector`.
+constexpr double kCodecSelectorDecay = 0.25;
+
+void UpdateAverage(double value, double* average) {
+  *average = *average < 0 ? value
+                          : (1 - kCodecSelectorDecay) * *average +
+                                kCodecSelectorDecay * value;
+}
+
 }  // namespace
 
+/* static */ constexpr const int AdaptiveCodecSelector::kSampleInterval;
+
 /* static */ constexpr const int64_t
     CustomReader::kSnappyReaderInputBufferSizeBytes;
 /* static */ constexpr const int64_t
@@ -108,6 +129,10 @@ Status Writer::Create(Env* env, const std::string& filename,
       *out_writer =
           std::make_unique<TFRecordWriter>(filename, compression_type);
       break;
+    case kAdaptiveFileFormatVersion:
+      *out_writer = std::make_unique<CustomWriter>(filename, compression_type,
+                                                   dtypes, version);
+      break;
     default:
       return errors::InvalidArgument("Snapshot writer version: ", version,
                                      " is not supported.");
@@ -173,12 +198,42 @@ TFRecordWriter::~TFRecordWriter() {
   }
 }
 
+bool AdaptiveCodecSelector::ShouldCompress() {
+  const bool sample = num_chunks_++ % kSampleInterval == 0;
+  if (sample || compression_ratio_ < 0 || write_seconds_per_byte_ < 0) {
+    return true;
+  }
+  // Compressing a byte costs its compression time, and saves the time of
+  // writing the part of it that compression removes.
+  return compress_seconds_per_byte_ <
+         (1 - compression_ratio_) * write_seconds_per_byte_;
+}
+
+void AdaptiveCodecSelector::RecordCompression(int64_t uncompressed_bytes,
+                                              int64_t compressed_bytes,
+                                              double seconds) {
+  if (uncompressed_bytes <= 0) {
+    return;
+  }
+  UpdateAverage(seconds / uncompressed_bytes, &compress_seconds_per_byte_);
+  UpdateAverage(static_cast<double>(compressed_bytes) / uncompressed_bytes,
+                &compression_ratio_);
+}
+
+void AdaptiveCodecSelector::RecordWrite(int64_t bytes, double seconds) {
+  if (bytes <= 0) {
+    return;
+  }
+  UpdateAverage(seconds / bytes, &write_seconds_per_byte_);
+}
+
 CustomWriter::CustomWriter(const std::string& filename,
                            const std::string& compression_type,
-                           const DataTypeVector& dtypes)
+                           const DataTypeVector& dtypes, int version)
     : filename_(filename),
       compression_type_(compression_type),
-      dtypes_(dtypes) {}
+      dtypes_(dtypes),
+      version_(version) {}
 
 Status CustomWriter::Initialize(tensorflow::Env* env) {
   TF_RETURN_IF_ERROR(env->NewAppendableFile(filename_, &dest_));
@@ -215,7 +270,8 @@ Status CustomWriter::Initialize(tensorflow::Env* env) {
 }
 
 Status CustomWriter::WriteTensors(const std::vector<Tensor>& tensors) {
-  if (compression_type_ != io::compression::kSnappy) {
+  if (version_ != kAdaptiveFileFormatVersion &&
+      compression_type_ != io::compression::kSnappy) {
     experimental::SnapshotRecord record;
     for (const auto& tensor : tensors) {
       TensorProto* t = record.add_tensor();
@@ -279,7 +335,8 @@ Status CustomWriter::WriteTensors(const std::vector<Tensor>& tensors) {
   DCHECK_EQ(position, uncompressed.data() + total_size);
 
   string output;
-  if (!tsl::port::Snappy_Compress(uncompressed.data(), total_size, &output)) {
+  if (version_ != kAdaptiveFileFormatVersion &&
+      !tsl::port::Snappy_Compress(uncompressed.data(), total_size, &output)) {
     return errors::Internal("Failed to compress using snappy.");
   }
 
@@ -293,6 +350,9 @@ Status CustomWriter::WriteTensors(const std::vector<Tensor>& tensors) {
   std::string metadata_serialized = metadata.SerializeAsString();
 #endif  // TF_CORD_SUPPORT
   TF_RETURN_IF_ERROR(WriteRecord(metadata_serialized));
+  if (version_ == kAdaptiveFileFormatVersion) {
+    return WriteAdaptiveChunk(uncompressed);
+  }
   TF_RETURN_IF_ERROR(WriteRecord(output));
   return OkStatus();
 }
@@ -318,6 +378,41 @@ CustomWriter::~CustomWriter() {
   }
 }
 
+Status CustomWriter::WriteAdaptiveChunk(const std::vector<char>& uncompressed) {
+  StringPiece payload(uncompressed.data(), uncompressed.size());
+  uint8 codec = kChunkUncompressed;
+  string compressed;
+  if (compression_type_ == io::compression::kSnappy &&
+      codec_selector_.ShouldCompress()) {
+    const absl::Time start = absl::Now();
+    if (!tsl::port::Snappy_Compress(uncompressed.data(), uncompressed.size(),
+                                    &compressed)) {
+      return errors::Internal("Failed to compress using snappy.");
+    }
+    codec_selector_.RecordCompression(
+        uncompressed.size(), compressed.size(),
+        absl::ToDoubleSeconds(absl::Now() - start));
+    // Incompressible chunks are stored as they are.
+    if (compressed.size() < uncompressed.size()) {
+      payload = compressed;
+      codec = kChunkSnappy;
+    }
+  }
+
+  char header[kHeaderSize + kChunkHeaderSize];
+  core::EncodeFixed64(header, kChunkHeaderSize + payload.size());
+  header[kHeaderSize] = codec;
+  core::EncodeFixed32(
+      header + kHeaderSize + 1,
+      crc32c::Mask(crc32c::Value(payload.data(), payload.size())));
+  const absl::Time start = absl::Now();
+  TF_RETURN_IF_ERROR(dest_->Append(StringPiece(header, sizeof(header))));
+  TF_RETURN_IF_ERROR(dest_->Append(payload));
+  codec_selector_.RecordWrite(sizeof(header) + payload.size(),
+                              absl::ToDoubleSeconds(absl::Now() - start));
+  return OkStatus();
+}
+
 Status CustomWriter::WriteRecord(const StringPiece& data) {
   char header[kHeaderSize];
   core::EncodeFixed64(header, data.size());
@@ -344,6 +439,7 @@ Status Reader::Create(Env* env, const std::string& filename,
     // strictly worse than V1.
     case 0:
     case 1:
+    case kAdaptiveFileFormatVersion:
       *out_reader = std::make_unique<CustomReader>(filename, compression_type,
                                                    version, dtypes);
       break;
@@ -767,7 +863,8 @@ Status CustomReader::Initialize(Env* env) {
     input_stream_ = std::make_unique<io::ZlibInputStream>(
         input_stream_.release(), zlib_options.input_buffer_size,
         zlib_options.output_buffer_size, zlib_options, true);
-  } else if (compression_type_ == io::compression::kSnappy) {
+  } else if (compression_type_ == io::compression::kSnappy ||
+             version_ == kAdaptiveFileFormatVersion) {
     if (version_ == 0) {
       input_stream_ = std::make_unique<tsl::io::SnappyInputBuffer>(
           file_.get(), /*input_buffer_bytes=*/kSnappyReaderInputBufferSizeBytes,
@@ -796,13 +893,14 @@ Status CustomReader::ReadTensors(std::vector<Tensor>* read_tensors) {
   profiler::TraceMe activity(
       [&]() { return absl::StrCat(kClassName, kSeparator, "ReadTensors"); },
       profiler::TraceMeLevel::kInfo);
-  if (version_ == 0 || compression_type_ != io::compression::kSnappy) {
+  if (version_ == 0 || (version_ != kAdaptiveFileFormatVersion &&
+                        compression_type_ != io::compression::kSnappy)) {
     return ReadTensorsV0(read_tensors);
   }
-  if (version_ != 1) {
+  if (version_ != 1 && version_ != kAdaptiveFileFormatVersion) {
     return errors::InvalidArgument("Version: ", version_, " is not supported.");
   }
-  if (compression_type_ != io::compression::kSnappy) {
+  if (version_ == 1 && compression_type_ != io::compression::kSnappy) {
     return errors::InvalidArgument("Compression ", compression_type_,
                                    " is not supported.");
   }
@@ -819,8 +917,13 @@ Status CustomReader::ReadTensors(std::vector<Tensor>* read_tensors) {
   simple_tensors.reserve(num_simple_);
   std::vector<std::pair<std::unique_ptr<char[]>, size_t>> tensor_proto_strs;
   tensor_proto_strs.reserve(num_complex_);
-  TF_RETURN_IF_ERROR(
-      SnappyUncompress(&metadata, &simple_tensors, &tensor_proto_strs));
+  if (version_ == kAdaptiveFileFormatVersion) {
+    TF_RETURN_IF_ERROR(
+        ReadAdaptiveChunk(&metadata, &simple_tensors, &tensor_proto_strs));
+  } else {
+    TF_RETURN_IF_ERROR(
+        SnappyUncompress(&metadata, &simple_tensors, &tensor_proto_strs));
+  }
 
   int simple_index = 0;
   int complex_index = 0;
@@ -881,7 +984,28 @@ Status CustomReader::SnappyUncompress(
   }
 
   int num_tensors = metadata->tensor_metadata_size();
-  std::vector<tsl::iovec> iov(num_tensors);
+  std::vector<tsl::iovec> iov;
+  const int64_t total_size =
+      AllocateTensors(metadata, simple_tensors, tensor_proto_strs, &iov);
+  const int64_t size_int = size;
+  if (size_int != total_size) {
+    return errors::Internal("Uncompressed size mismatch. Snappy expects ", size,
+                            " whereas the tensor metadata suggests ",
+                            total_size);
+  }
+  if (!tsl::port::Snappy_UncompressToIOVec(compressed.data(), compressed.size(),
+                                           iov.data(), num_tensors)) {
+    return errors::Internal("Failed to perform snappy decompression.");
+  }
+  return OkStatus();
+}
+
+int64_t CustomReader::AllocateTensors(
+    const experimental::SnapshotTensorMetadata* metadata,
+    std::vector<Tensor>* simple_tensors,
+    std::vector<std::pair<std::unique_ptr<char[]>, size_t>>* tensor_proto_strs,
+    std::vector<tsl::iovec>* iov) {
+  iov->resize(metadata->tensor_metadata_size());
   int index = 0;
   int64_t total_size = 0;
   for (int i = 0, end = simple_tensor_mask_.size(); i < end; ++i) {
@@ -890,31 +1014,80 @@ Status CustomReader::SnappyUncompress(
       TensorShape shape(tensor_metadata.tensor_shape());
       Tensor simple_tensor(dtypes_[i], shape);
       TensorBuffer* buffer = DMAHelper::buffer(&simple_tensor);
-      iov[index].iov_base = buffer->data();
-      iov[index].iov_len = buffer->size();
+      (*iov)[index].iov_base = buffer->data();
+      (*iov)[index].iov_len = buffer->size();
       simple_tensors->push_back(std::move(simple_tensor));
     } else {
       auto tensor_proto_str =
           std::make_unique<char[]>(tensor_metadata.tensor_size_bytes());
-      iov[index].iov_base = tensor_proto_str.get();
-      iov[index].iov_len = tensor_metadata.tensor_size_bytes();
+      (*iov)[index].iov_base = tensor_proto_str.get();
+      (*iov)[index].iov_len = tensor_metadata.tensor_size_bytes();
       tensor_proto_strs->push_back(std::make_pair(
           std::move(tensor_proto_str), tensor_metadata.tensor_size_bytes()));
     }
-    total_size += iov[index].iov_len;
+    total_size += (*iov)[index].iov_len;
     index++;
   }
-  const int64_t size_int = size;
-  if (size_int != total_size) {
-    return errors::Internal("Uncompressed size mismatch. Snappy expects ", size,
-                            " whereas the tensor metadata suggests ",
-                            total_size);
+  return total_size;
+}
+
+Status CustomReader::ReadAdaptiveChunk(
+    const experimental::SnapshotTensorMetadata* metadata,
+    std::vector<Tensor>* simple_tensors,
+    std::vector<std::pair<std::unique_ptr<char[]>, size_t>>*
+        tensor_proto_strs) {
+  tstring chunk;
+  TF_RETURN_IF_ERROR(ReadRecord(&chunk));
+  if (chunk.size() < kChunkHeaderSize) {
+    return errors::DataLoss("Truncated chunk in snapshot file ", filename_);
   }
-  if (!tsl::port::Snappy_UncompressToIOVec(compressed.data(), compressed.size(),
-                                           iov.data(), num_tensors)) {
-    return errors::Internal("Failed to perform snappy decompression.");
+  const uint8 codec = chunk[0];
+  StringPiece payload(chunk.data() + kChunkHeaderSize,
+                      chunk.size() - kChunkHeaderSize);
+  const uint32 expected_crc =
+      crc32c::Unmask(core::DecodeFixed32(chunk.data() + 1));
+  if (crc32c::Value(payload.data(), payload.size()) != expected_crc) {
+    return errors::DataLoss("Checksum mismatch in a chunk of snapshot file ",
+                            filename_);
+  }
+
+  std::vector<tsl::iovec> iov;
+  const int64_t total_size =
+      AllocateTensors(metadata, simple_tensors, tensor_proto_strs, &iov);
+  switch (codec) {
+    case kChunkUncompressed: {
+      if (payload.size() != total_size) {
+        return errors::DataLoss("Chunk size mismatch. The chunk has ",
+                                payload.size(),
+                                " bytes whereas the tensor metadata suggests ",
+                                total_size);
+      }
+      const char* position = payload.data();
+      for (const tsl::iovec& buffer : iov) {
+        memcpy(buffer.iov_base, position, buffer.iov_len);
+        position += buffer.iov_len;
+      }
+      return OkStatus();
+    }
+    case kChunkSnappy: {
+      size_t size;
+      if (!tsl::port::Snappy_GetUncompressedLength(payload.data(),
+                                                   payload.size(), &size) ||
+          size != total_size) {
+        return errors::DataLoss(
+            "Uncompressed size mismatch in a chunk of snapshot file ",
+            filename_);
+      }
+      if (!tsl::port::Snappy_UncompressToIOVec(payload.data(), payload.size(),
+                                               iov.data(), iov.size())) {
+        return errors::Internal("Failed to perform snappy decompression.");
+      }
+      return OkStatus();
+    }
+    default:
+      return errors::DataLoss("Unknown codec ", static_cast<int>(codec),
+                              " of a chunk of snapshot file ", filename_);
   }
-  return OkStatus();
 }
 
 Status CustomReader::ReadRecord(tstring* record) {
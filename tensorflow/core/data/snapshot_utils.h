@@ -28,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/platform/file_system.h"
 #include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/status.h"
+#include "tensorflow/tsl/platform/snappy.h"
 
 namespace tensorflow {
 
@@ -52,6 +53,11 @@ constexpr char kModeRead[] = "read";
 constexpr char kModePassthrough[] = "passthrough";
 constexpr char kShardDirectorySuffix[] = ".shard";
 
+// Added by Alpa. The version of the `CustomWriter` file format whose elements
+// are written as checksummed chunks, each of which is compressed or not
+// depending on `AdaptiveCodecSelector`.
+constexpr int kAdaptiveFileFormatVersion = 3;
+
 enum Mode { READER = 0, WRITER = 1, PASSTHROUGH = 2 };
 
 // Returns the name of the "hash" directory for the given base path and hash ID.
@@ -120,6 +126,34 @@ class TFRecordWriter : public Writer {
   std::unique_ptr<io::RecordWriter> record_writer_;
 };
 
+// Added by Alpa. Chooses whether to compress each chunk of an adaptive snapshot
+// file, by comparing the measured time of compressing the chunk with the
+// measured time of writing the bytes that compressing it would save. Every
+// kSampleInterval-th chunk is compressed regardless, to keep the estimates
+// current as the data and the load of the storage change.
+class AdaptiveCodecSelector {
+ public:
+  static constexpr const int kSampleInterval = 16;
+
+  // Returns whether the next chunk should be compressed.
+  bool ShouldCompress();
+
+  // Records that compressing `uncompressed_bytes` into `compressed_bytes` took
+  // `seconds`.
+  void RecordCompression(int64_t uncompressed_bytes, int64_t compressed_bytes,
+                         double seconds);
+
+  // Records that writing `bytes` took `seconds`.
+  void RecordWrite(int64_t bytes, double seconds);
+
+ private:
+  int64_t num_chunks_ = 0;
+  // Moving averages of the measurements, or negative before the first one.
+  double compress_seconds_per_byte_ = -1.0;
+  double compression_ratio_ = -1.0;
+  double write_seconds_per_byte_ = -1.0;
+};
+
 // Writes snapshot with a custom (legacy) file format.
 class CustomWriter : public Writer {
  public:
@@ -130,8 +164,11 @@ class CustomWriter : public Writer {
   static constexpr const char* const kWriteCord = "WriteCord";
   static constexpr const char* const kSeparator = "::";
 
+  // Added by Alpa: `version` is 1, or kAdaptiveFileFormatVersion to write
+  // checksummed chunks that are compressed with snappy when it pays off. The
+  // adaptive chunks are only compressed if `compression_type` is SNAPPY.
   CustomWriter(const std::string& filename, const std::string& compression_type,
-               const DataTypeVector& dtypes);
+               const DataTypeVector& dtypes, int version = 1);
 
   Status WriteTensors(const std::vector<Tensor>& tensors) override;
 
@@ -151,10 +188,16 @@ class CustomWriter : public Writer {
   Status WriteRecord(const absl::Cord& data);
 #endif  // TF_CORD_SUPPORT
 
+  // Added by Alpa. Writes the uncompressed data of an element as a chunk of
+  // an adaptive file.
+  Status WriteAdaptiveChunk(const std::vector<char>& uncompressed);
+
   std::unique_ptr<WritableFile> dest_;
   const std::string filename_;
   const std::string compression_type_;
   const DataTypeVector dtypes_;
+  const int version_;
+  AdaptiveCodecSelector codec_selector_;
   // We hold zlib_dest_ because we may create a ZlibOutputBuffer and put that
   // in dest_ if we want compression. ZlibOutputBuffer doesn't own the original
   // dest_ and so we need somewhere to store the original one.
@@ -294,6 +337,24 @@ class CustomReader : public Reader {
       std::vector<std::pair<std::unique_ptr<char[]>, size_t>>*
           tensor_proto_strs);
 
+  // Added by Alpa. Reads a chunk of an adaptive file, verifies its checksum
+  // and decodes it like SnappyUncompress.
+  Status ReadAdaptiveChunk(
+      const experimental::SnapshotTensorMetadata* metadata,
+      std::vector<Tensor>* simple_tensors,
+      std::vector<std::pair<std::unique_ptr<char[]>, size_t>>*
+          tensor_proto_strs);
+
+  // Added by Alpa. Allocates the tensors described by `metadata` and sets
+  // `iov` to their buffers, in the order of their data in a chunk. Returns the
+  // total size of the buffers.
+  int64_t AllocateTensors(
+      const experimental::SnapshotTensorMetadata* metadata,
+      std::vector<Tensor>* simple_tensors,
+      std::vector<std::pair<std::unique_ptr<char[]>, size_t>>*
+          tensor_proto_strs,
+      std::vector<tsl::iovec>* iov);
+
   Status ReadRecord(tstring* record);
 
 #if defined(TF_CORD_SUPPORT)
@@ -89,6 +89,58 @@ TEST(SnapshotUtilTest, CombinationRoundTripTest) {
   SnapshotRoundTrip(io::compression::kNone, 2);
   SnapshotRoundTrip(io::compression::kGzip, 2);
   SnapshotRoundTrip(io::compression::kSnappy, 2);
+
+  SnapshotRoundTrip(io::compression::kNone, kAdaptiveFileFormatVersion);
+  SnapshotRoundTrip(io::compression::kGzip, kAdaptiveFileFormatVersion);
+  SnapshotRoundTrip(io::compression::kSnappy, kAdaptiveFileFormatVersion);
+}
+
+TEST(SnapshotUtilTest, AdaptiveCodecSelector) {
+  AdaptiveCodecSelector selector;
+  // Compresses until it has measurements.
+  EXPECT_TRUE(selector.ShouldCompress());
+  EXPECT_TRUE(selector.ShouldCompress());
+  // Compression takes longer than writing the bytes it saves.
+  selector.RecordCompression(/*uncompressed_bytes=*/1000,
+                             /*compressed_bytes=*/900, /*seconds=*/1.0);
+  selector.RecordWrite(/*bytes=*/1000, /*seconds=*/1.0);
+  int num_compressed = 0;
+  for (int i = 0; i < AdaptiveCodecSelector::kSampleInterval; ++i) {
+    num_compressed += selector.ShouldCompress();
+  }
+  EXPECT_EQ(num_compressed, 1);
+
+  // Writing becomes slow.
+  selector.RecordWrite(/*bytes=*/1, /*seconds=*/1000.0);
+  EXPECT_TRUE(selector.ShouldCompress());
+}
+
+TEST(SnapshotUtilTest, AdaptiveChunkChecksum) {
+  std::string filename;
+  EXPECT_TRUE(Env::Default()->LocalTempFilename(&filename));
+  const DataTypeVector dtypes = {DT_FLOAT};
+  std::unique_ptr<Writer> writer;
+  TF_ASSERT_OK(Writer::Create(Env::Default(), filename,
+                              io::compression::kNone,
+                              kAdaptiveFileFormatVersion, dtypes, &writer));
+  Tensor tensor(DT_FLOAT, TensorShape({16}));
+  tensor.flat<float>().setConstant(1.0f);
+  TF_ASSERT_OK(writer->WriteTensors({tensor}));
+  TF_ASSERT_OK(writer->Close());
+
+  // Flips the last byte of the chunk.
+  std::string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), filename, &contents));
+  contents.back() ^= 1;
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), filename, contents));
+
+  std::unique_ptr<Reader> reader;
+  TF_ASSERT_OK(Reader::Create(Env::Default(), filename,
+                              io::compression::kNone,
+                              kAdaptiveFileFormatVersion, dtypes, &reader));
+  std::vector<Tensor> read_tensors;
+  EXPECT_TRUE(errors::IsDataLoss(reader->ReadTensors(&read_tensors)));
+  TF_ASSERT_OK(Env::Default()->DeleteFile(filename));
 }
 
 void SnapshotReaderBenchmarkLoop(::testing::benchmark::State& state,
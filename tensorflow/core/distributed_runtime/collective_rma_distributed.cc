@@ -16,6 +16,7 @@ limitations under the License.
 
 #include <memory>
 
+#include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/common_runtime/base_collective_executor.h"
 #include "tensorflow/core/common_runtime/copy_tensor.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
@@ -72,8 +73,7 @@ void PopulateTensorFromExtra(const RecvBufRespExtra& extra,
                              Tensor* cpu_tensor) {
   char* head = reinterpret_cast<char*>(DMAHelper::base(cpu_tensor));
   for (const auto& tensor_content_chunk : extra.tensor_content()) {
-    memcpy(head, std::string(tensor_content_chunk).data(),
-           tensor_content_chunk.size());
+    memcpy(head, tensor_content_chunk.data(), tensor_content_chunk.size());
     head += tensor_content_chunk.size();
   }
 }
@@ -296,4 +296,47 @@ void CollectiveRemoteAccessDistributed::StartAbort(const Status& s) {
   abortion_cancel_mgr_.StartCancel();
 }
 
+// Added by Alpa
+namespace {
+using CollectiveTransportMap =
+    absl::flat_hash_map<string, CollectiveTransportRegistry::Factory>;
+
+CollectiveTransportMap* MutableCollectiveTransports() {
+  static CollectiveTransportMap* transports = new CollectiveTransportMap;
+  return transports;
+}
+}  // namespace
+
+// Added by Alpa
+Status CollectiveTransportRegistry::Lookup(const string& name,
+                                           Factory* factory) {
+  if (name.empty() || name == "grpc") {
+    *factory = [](const CollectiveTransportArgs& args) {
+      return new CollectiveRemoteAccessDistributed(
+          args.dev_mgr, args.dev_resolver, args.work_queue, args.worker_cache,
+          args.step_id, args.task_name);
+    };
+    return OkStatus();
+  }
+  auto it = MutableCollectiveTransports()->find(name);
+  if (it == MutableCollectiveTransports()->end()) {
+    return errors::NotFound("No collective transport registered as ", name);
+  }
+  *factory = it->second;
+  return OkStatus();
+}
+
+// Added by Alpa
+Status CollectiveTransportRegistry::Register(const string& name,
+                                             Factory factory) {
+  if (name.empty() || name == "grpc" ||
+      !MutableCollectiveTransports()
+           ->emplace(name, std::move(factory))
+           .second) {
+    return errors::AlreadyExists("Collective transport ", name,
+                                 " already registered");
+  }
+  return OkStatus();
+}
+
 }  // namespace tensorflow
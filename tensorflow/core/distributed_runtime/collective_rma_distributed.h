@@ -15,6 +15,9 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_COLLECTIVE_RMA_DISTRIBUTED_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_COLLECTIVE_RMA_DISTRIBUTED_H_
 
+#include <functional>
+#include <memory>
+
 #include "tensorflow/core/common_runtime/collective_rma_local.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -60,5 +63,51 @@ class CollectiveRemoteAccessDistributed : public CollectiveRemoteAccessLocal {
   string task_name_;
 };
 
+// Added by Alpa. The arguments of a collective transport factory.
+struct CollectiveTransportArgs {
+  const DeviceMgr* dev_mgr;
+  DeviceResolverInterface* dev_resolver;
+  std::shared_ptr<UnboundedWorkQueue> work_queue;
+  WorkerCacheInterface* worker_cache;
+  int64_t step_id;
+  string task_name;
+};
+
+// Added by Alpa. A registry of transports for the data of collectives between
+// workers, selected with ConfigProto.Experimental.collective_transport. The
+// built-in "grpc" transport, also used for an empty name, is
+// CollectiveRemoteAccessDistributed, which moves the data with
+// WorkerInterface::RecvBufAsync and stages device tensors in host memory.
+// Other transports, e.g. RDMA verbs or UCX with registered memory regions and
+// GPUDirect, typically extend CollectiveRemoteAccessDistributed, override
+// RecvFromPeer and register themselves with REGISTER_COLLECTIVE_TRANSPORT.
+class CollectiveTransportRegistry {
+ public:
+  using Factory =
+      std::function<CollectiveRemoteAccess*(const CollectiveTransportArgs&)>;
+
+  // Looks up the factory of the transport registered under `name`.
+  static Status Lookup(const string& name, Factory* factory);
+
+ private:
+  friend class CollectiveTransportRegistration;
+  static Status Register(const string& name, Factory factory);
+};
+
+// Class used to call CollectiveTransportRegistry::Register.  This should only
+// be used to create a global static object.
+class CollectiveTransportRegistration {
+ public:
+  CollectiveTransportRegistration(
+      const string& name, CollectiveTransportRegistry::Factory factory) {
+    TF_CHECK_OK(
+        CollectiveTransportRegistry::Register(name, std::move(factory)));
+  }
+};
+
+#define REGISTER_COLLECTIVE_TRANSPORT(name, factory) \
+  static CollectiveTransportRegistration             \
+      register_##name##_collective_transport(#name, factory);
+
 }  // namespace tensorflow
 #endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_COLLECTIVE_RMA_DISTRIBUTED_H_
@@ -651,5 +651,32 @@ INSTANTIATE_TEST_SUITE_P(
                        ::testing::Values(TEST_PARAM_DEVICE_TYPE_CPU,
                                          TEST_PARAM_DEVICE_TYPE_GPU)));
 
+// A transport counting the CollectiveRemoteAccess objects it creates.
+int num_counting_transport_rmas = 0;
+CollectiveRemoteAccess* NewCountingTransport(
+    const CollectiveTransportArgs& args) {
+  ++num_counting_transport_rmas;
+  return new CollectiveRemoteAccessDistributed(
+      args.dev_mgr, args.dev_resolver, args.work_queue, args.worker_cache,
+      args.step_id, args.task_name);
+}
+REGISTER_COLLECTIVE_TRANSPORT(counting, NewCountingTransport);
+
+TEST(CollectiveTransportRegistryTest, Lookup) {
+  CollectiveTransportRegistry::Factory factory;
+  TF_ASSERT_OK(CollectiveTransportRegistry::Lookup("counting", &factory));
+  std::unique_ptr<CollectiveRemoteAccess> rma(
+      factory({/*dev_mgr=*/nullptr, /*dev_resolver=*/nullptr,
+               /*work_queue=*/nullptr, /*worker_cache=*/nullptr,
+               /*step_id=*/7, /*task_name=*/"/job:worker/replica:0/task:0"}));
+  EXPECT_NE(rma, nullptr);
+  EXPECT_EQ(num_counting_transport_rmas, 1);
+
+  TF_EXPECT_OK(CollectiveTransportRegistry::Lookup("", &factory));
+  TF_EXPECT_OK(CollectiveTransportRegistry::Lookup("grpc", &factory));
+  EXPECT_TRUE(errors::IsNotFound(
+      CollectiveTransportRegistry::Lookup("unknown", &factory)));
+}
+
 }  // namespace
 }  // namespace tensorflow
@@ -15,7 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/eager/grpc_eager_client.h"
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "grpcpp/generic/generic_stub.h"
 #include "tensorflow/core/distributed_runtime/call_options.h"
@@ -72,6 +74,25 @@ bool EnableStreaming() {
   return result;
 }
 
+// Added by Alpa. Setting "TF_EAGER_CLIENT_ENQUEUE_BATCH_WINDOW_US" to a
+// positive value coalesces the streaming enqueue requests of a context that
+// are issued within that many microseconds into one request of the stream, so
+// that many small remote ops and tensor copies share one message and one
+// round of server dispatch. A batch is sent early once it holds
+// kMaxEnqueueBatchBytes, and larger requests are sent alone. Disabled by
+// default, since the first request of a batch waits up to the window.
+int64_t EnqueueBatchWindowMicros() {
+  static const int64_t window_us = [] {
+    int64_t result;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_EAGER_CLIENT_ENQUEUE_BATCH_WINDOW_US",
+                                    0, &result));
+    return result;
+  }();
+  return window_us;
+}
+
+constexpr size_t kMaxEnqueueBatchBytes = 1 << 20;
+
 // Ref-counted thread to handle callbacks for completed requests a GRPC
 // completion queue. The thread might be shared by multiple eager clients, and
 // each one of them should hold a reference count to ensure that the thread
@@ -178,6 +199,8 @@ class GrpcEagerClient : public EagerClient {
             << request->DebugString();
 
     mutex_lock l(mu_);
+    // Added by Alpa: the pending batch fails with the streaming call.
+    FlushEnqueueBatch(request->context_id());
     const auto& it = enqueue_dispatchers_.find(request->context_id());
     if (it != enqueue_dispatchers_.end()) {
       it->second.CancelCall();
@@ -200,18 +223,14 @@ class GrpcEagerClient : public EagerClient {
     // Streaming enqueue is allowed only when the both are enabled.
     if (EnableStreaming() && enable_streaming_enqueue) {
       mutex_lock l(mu_);
-      auto it = enqueue_dispatchers_.find(request->context_id());
-      if (it == enqueue_dispatchers_.end()) {
-        auto it_and_bool = enqueue_dispatchers_.emplace(
-            std::piecewise_construct,
-            std::forward_as_tuple(request->context_id()),
-            std::forward_as_tuple(
-                &stub_, cq_,
-                "/tensorflow.eager.EagerService/StreamingEnqueue"));
-        it = it_and_bool.first;
+      // Added by Alpa
+      if (EnqueueBatchWindowMicros() > 0) {
+        BatchEnqueueRequest(*request, response, std::move(done_wrapped));
+        return;
       }
       // TODO(haoyuzhang): Consider supporting cancellation for streaming RPC?
-      it->second.SendNextRequest(*request, response, std::move(done_wrapped));
+      GetEnqueueDispatcher(request->context_id())
+          .SendNextRequest(*request, response, std::move(done_wrapped));
     } else {
       Notification n;
       Status status;
@@ -237,6 +256,114 @@ class GrpcEagerClient : public EagerClient {
   std::unordered_map<uint64, StreamingRPCDispatcher<EnqueueResponse>>
       enqueue_dispatchers_ TF_GUARDED_BY(mu_);
 
+  // Added by Alpa. A request of a pending batch, and how many queue items of
+  // the batch belong to it.
+  struct BatchedEnqueue {
+    EnqueueResponse* response;
+    int num_items;
+    StatusCallback done;
+  };
+  // Added by Alpa. The enqueue requests of a context waiting to be sent as one
+  // request of the stream. See EnqueueBatchWindowMicros().
+  struct EnqueueBatch {
+    int64_t id = 0;
+    EnqueueRequest request;
+    size_t bytes = 0;
+    std::vector<BatchedEnqueue> entries;
+  };
+  std::unordered_map<uint64, EnqueueBatch> enqueue_batches_
+      TF_GUARDED_BY(mu_);
+  int64_t next_enqueue_batch_id_ TF_GUARDED_BY(mu_) = 0;
+
+  StreamingRPCDispatcher<EnqueueResponse>& GetEnqueueDispatcher(
+      uint64 context_id) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    auto it = enqueue_dispatchers_.find(context_id);
+    if (it == enqueue_dispatchers_.end()) {
+      auto it_and_bool = enqueue_dispatchers_.emplace(
+          std::piecewise_construct, std::forward_as_tuple(context_id),
+          std::forward_as_tuple(
+              &stub_, cq_, "/tensorflow.eager.EagerService/StreamingEnqueue"));
+      it = it_and_bool.first;
+    }
+    return it->second;
+  }
+
+  // Added by Alpa. Appends the queue items of `request` to the pending batch
+  // of its context, which is sent after the batch window or once it is full.
+  void BatchEnqueueRequest(const EnqueueRequest& request,
+                           EnqueueResponse* response, StatusCallback done)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const uint64 context_id = request.context_id();
+    const size_t bytes = request.ByteSizeLong();
+    auto it = enqueue_batches_.find(context_id);
+    if (it != enqueue_batches_.end() &&
+        it->second.bytes + bytes > kMaxEnqueueBatchBytes) {
+      FlushEnqueueBatch(context_id);
+      it = enqueue_batches_.end();
+    }
+    if (bytes >= kMaxEnqueueBatchBytes) {
+      // Large requests, e.g. tensor copies, are sent without copying them into
+      // a batch.
+      GetEnqueueDispatcher(context_id)
+          .SendNextRequest(request, response, std::move(done));
+      return;
+    }
+    if (it == enqueue_batches_.end()) {
+      it = enqueue_batches_.emplace(context_id, EnqueueBatch()).first;
+      const int64_t id = next_enqueue_batch_id_++;
+      it->second.id = id;
+      it->second.request.set_context_id(context_id);
+      Ref();
+      Env::Default()->SchedClosureAfter(
+          EnqueueBatchWindowMicros(), [this, context_id, id]() {
+            {
+              mutex_lock l(mu_);
+              auto it = enqueue_batches_.find(context_id);
+              if (it != enqueue_batches_.end() && it->second.id == id) {
+                FlushEnqueueBatch(context_id);
+              }
+            }
+            this->Unref();
+          });
+    }
+    EnqueueBatch& batch = it->second;
+    for (const QueueItem& item : request.queue()) {
+      *batch.request.add_queue() = item;
+    }
+    batch.bytes += bytes;
+    batch.entries.push_back({response, request.queue_size(), std::move(done)});
+  }
+
+  // Added by Alpa. Sends the pending batch of `context_id`, if any. The
+  // responses of the queue items are handed back to the batched requests in
+  // order. If the batch fails, all of its requests fail with the same status,
+  // as the requests after a failed one on the stream do.
+  void FlushEnqueueBatch(uint64 context_id) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    auto it = enqueue_batches_.find(context_id);
+    if (it == enqueue_batches_.end()) return;
+    EnqueueBatch batch = std::move(it->second);
+    enqueue_batches_.erase(it);
+    auto response = std::make_shared<EnqueueResponse>();
+    auto entries =
+        std::make_shared<std::vector<BatchedEnqueue>>(std::move(batch.entries));
+    GetEnqueueDispatcher(context_id)
+        .SendNextRequest(
+            batch.request, response.get(),
+            [response, entries](const Status& status) {
+              int offset = 0;
+              for (BatchedEnqueue& entry : *entries) {
+                for (int i = 0; status.ok() && i < entry.num_items &&
+                                offset + i < response->queue_response_size();
+                     ++i) {
+                  entry.response->add_queue_response()->Swap(
+                      response->mutable_queue_response(offset + i));
+                }
+                offset += entry.num_items;
+                entry.done(status);
+              }
+            });
+  }
+
   StatusCallback callback_wrapper(StatusCallback done) {
     Ref();
     return [this, done = std::move(done)](const Status& status) {
@@ -15,6 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "grpcpp/support/byte_buffer.h"
 #include "grpcpp/support/slice.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
@@ -25,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/io/proto_encode_helper.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 
 namespace tensorflow {
@@ -249,5 +253,114 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
   }
 }
 
+// Added by Alpa. Writes the tag and length of a length-delimited field of
+// field number "tag" to "dst", and returns the end of the encoding.
+static char* EncodeVarlengthBeginning(char* dst, uint32 tag, uint64 length) {
+  dst = core::EncodeVarint32(dst, (tag << 3) | 2);  // WIRETYPE_LENGTH_DELIMITED
+  return core::EncodeVarint64(dst, length);
+}
+
+// Added by Alpa. We hand-encode the RecvBufResponse as follows:
+//
+// A:   <protocol buffer encoding of fields except transport_options>
+// B:   <tag and length of RecvBufResponse::transport_options>
+// C:   <tag, length and contents of Any::type_url>
+// D:   <tag and length of Any::value>
+// E:   for each chunk of the tensor data:
+//      E1: <tag and length of RecvBufRespExtra::tensor_content>
+//      E2: <chunk data>
+//
+// If the chunks are at least "kMinSharedChunkBytes", each chunk data (E2) is a
+// grpc::Slice that points to the backing store of the tensor, and the rest of
+// the encoding lives in small slices in between. Otherwise, a slice per chunk
+// would cost more than copying it, and everything is copied into one slice.
+void EncodeRecvBufResponseToByteBuffer(const Tensor& val,
+                                       int64_t max_chunk_bytes,
+                                       int64_t send_start_micros,
+                                       bool require_ack,
+                                       ::grpc::ByteBuffer* result) {
+  static const int64_t kMinSharedChunkBytes = 64 << 10;
+  static const char kExtraTypeUrl[] =
+      "type.googleapis.com/tensorflow.RecvBufRespExtra";
+  static const int kMaxVarlengthBeginning = 5 + 10;  // Varint32 + varint64
+
+  const StringPiece tdata(static_cast<const char*>(DMAHelper::base(&val)),
+                          val.TotalBytes());
+  const int64_t chunk_bytes =
+      max_chunk_bytes > 0 ? max_chunk_bytes
+                          : std::max<int64_t>(tdata.size(), 1);
+  gtl::InlinedVector<StringPiece, 4> chunks;
+  for (size_t offset = 0; offset < tdata.size(); offset += chunk_bytes) {
+    chunks.push_back(tdata.substr(offset, chunk_bytes));
+  }
+  size_t extra_bytes = 0;
+  for (const StringPiece& chunk : chunks) {
+    extra_bytes += VarLengthEncodingSize(
+        RecvBufRespExtra::kTensorContentFieldNumber, chunk.size());
+  }
+  const StringPiece type_url(kExtraTypeUrl);
+  const size_t any_bytes =
+      VarLengthEncodingSize(/*Any::type_url*/ 1, type_url.size()) +
+      VarLengthEncodingSize(/*Any::value*/ 2, extra_bytes);
+
+  // (A)
+  RecvBufResponse header;
+  header.set_send_start_micros(send_start_micros);
+  header.set_require_ack(require_ack);
+  string prefix;
+  header.AppendToString(&prefix);
+  // (B), (C) and (D)
+  const size_t header_size = prefix.size();
+  prefix.resize(header_size + 3 * kMaxVarlengthBeginning + type_url.size());
+  char* end = &prefix[header_size];
+  end = EncodeVarlengthBeginning(
+      end, RecvBufResponse::kTransportOptionsFieldNumber, any_bytes);
+  end = EncodeVarlengthBeginning(end, 1, type_url.size());
+  memcpy(end, type_url.data(), type_url.size());
+  end = EncodeVarlengthBeginning(end + type_url.size(), 2, extra_bytes);
+  prefix.resize(end - prefix.data());
+
+  const bool share_tensor_slice_memory =
+      chunk_bytes >= kMinSharedChunkBytes && !chunks.empty();
+  std::vector<::grpc::Slice> slices;
+  if (!share_tensor_slice_memory) {
+    ::grpc::Slice slice(prefix.size() + extra_bytes);
+    char* dst = reinterpret_cast<char*>(const_cast<uint8_t*>(slice.begin()));
+    memcpy(dst, prefix.data(), prefix.size());
+    dst += prefix.size();
+    for (const StringPiece& chunk : chunks) {
+      // (E1) & (E2)
+      dst = EncodeVarlengthBeginning(
+          dst, RecvBufRespExtra::kTensorContentFieldNumber, chunk.size());
+      memcpy(dst, chunk.data(), chunk.size());
+      dst += chunk.size();
+    }
+    CHECK_EQ(dst, reinterpret_cast<const char*>(slice.end()));
+    slices.push_back(std::move(slice));
+  } else {
+    const TensorBuffer* buf = DMAHelper::buffer(&val);
+    slices.reserve(2 * chunks.size());
+    for (const StringPiece& chunk : chunks) {
+      // (E1), preceded by the rest of the encoding for the first chunk.
+      char head[kMaxVarlengthBeginning];
+      char* head_end = EncodeVarlengthBeginning(
+          head, RecvBufRespExtra::kTensorContentFieldNumber, chunk.size());
+      prefix.append(head, head_end - head);
+      slices.emplace_back(prefix.data(), prefix.size());
+      prefix.clear();
+      // (E2) Encode the chunk, but by sharing backing store
+      buf->Ref();
+      slices.emplace_back(
+          const_cast<void*>(static_cast<const void*>(chunk.data())),
+          chunk.size(),
+          [](void* backing) { static_cast<TensorBuffer*>(backing)->Unref(); },
+          const_cast<TensorBuffer*>(buf));
+    }
+  }
+
+  ::grpc::ByteBuffer tmp(slices.data(), slices.size());
+  result->Swap(&tmp);
+}
+
 }  // namespace grpc
 }  // namespace tensorflow
@@ -49,6 +49,19 @@ void EncodeRecvTensorResponseToByteBuffer(const RecvTensorResponse& proto,
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
                               ::grpc::ByteBuffer* result);
 
+// Added by Alpa. Encode a Tensor into a byte buffer in a format that is
+// parseable as a RecvBufResponse protocol buffer, whose transport_options hold
+// a RecvBufRespExtra with the data of "val" split into chunks of at most
+// "max_chunk_bytes" (if positive). Large chunks share the backing store of
+// "val" instead of being copied; small ones are copied into one slice.
+//
+// Discards original contents of *result.
+void EncodeRecvBufResponseToByteBuffer(const Tensor& val,
+                                       int64_t max_chunk_bytes,
+                                       int64_t send_start_micros,
+                                       bool require_ack,
+                                       ::grpc::ByteBuffer* result);
+
 }  // namespace grpc
 }  // namespace tensorflow
 
@@ -22,6 +22,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 
 namespace tensorflow {
@@ -100,4 +101,41 @@ TEST_F(GrpcTensorCodingTest, Simple) {
 
 TEST_F(GrpcTensorCodingTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(GrpcTensorCodingTest, RecvBufResponse) {
+  for (int64_t num_elements : {0, 10, 100000}) {
+    Tensor t(DT_FLOAT, TensorShape({num_elements}));
+    for (int64_t i = 0; i < num_elements; ++i) {
+      t.flat<float>()(i) = i;
+    }
+    // No chunking, copied chunks and chunks sharing the tensor buffer.
+    for (int64_t max_chunk_bytes : {0, 4096, 65536}) {
+      ::grpc::ByteBuffer buf;
+      grpc::EncodeRecvBufResponseToByteBuffer(t, max_chunk_bytes,
+                                              /*send_start_micros=*/123,
+                                              /*require_ack=*/true, &buf);
+      std::vector<::grpc::Slice> slices;
+      (void)buf.Dump(&slices);
+      string tmp;
+      for (const auto& s : slices) {
+        tmp.append(reinterpret_cast<const char*>(s.begin()), s.size());
+      }
+
+      RecvBufResponse response;
+      ASSERT_TRUE(response.ParseFromString(tmp));
+      EXPECT_EQ(response.send_start_micros(), 123);
+      EXPECT_TRUE(response.require_ack());
+      RecvBufRespExtra extra;
+      ASSERT_TRUE(response.transport_options().UnpackTo(&extra));
+      string data;
+      for (const auto& chunk : extra.tensor_content()) {
+        if (max_chunk_bytes > 0) {
+          EXPECT_LE(chunk.size(), max_chunk_bytes);
+        }
+        data.append(chunk);
+      }
+      EXPECT_EQ(data, t.tensor_data());
+    }
+  }
+}
+
 }  // namespace tensorflow
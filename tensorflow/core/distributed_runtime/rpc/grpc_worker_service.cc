@@ -144,7 +144,6 @@ class GrpcWorkerServiceThread {
     SETUP_FOR_REQUEST(CompleteGroup, 10, true);
     SETUP_FOR_REQUEST(CompleteInstance, 10, true);
     SETUP_FOR_REQUEST(GetStepSequence, 10, true);
-    SETUP_FOR_REQUEST(RecvBuf, 500, true);
     SETUP_FOR_REQUEST(RunGraph, 100, true);
     SETUP_FOR_REQUEST(CleanupGraph, 100, false);
     SETUP_FOR_REQUEST(MarkRecvFinished, 10, false);
@@ -158,6 +157,14 @@ class GrpcWorkerServiceThread {
          ++i) {
       EnqueueRecvTensorRequestRaw();
     }
+    // Added by Alpa
+    for (int i = 0;
+         i < gtl::FindWithDefault(
+                 queue_depth_, static_cast<int>(GrpcWorkerMethod::kRecvBuf),
+                 500);
+         ++i) {
+      EnqueueRecvBufRequestRaw();
+    }
 
     void* tag;
     bool ok;
@@ -284,21 +291,25 @@ class GrpcWorkerServiceThread {
     EnqueueRecvTensorRequestRaw();
   }
 
-  void RecvBufHandler(WorkerCall<RecvBufRequest, RecvBufResponse>* call) {
+  // Added by Alpa: RecvBuf responses are encoded directly into a
+  // ::grpc::ByteBuffer, like RecvTensor responses.
+  void RecvBufHandlerRaw(
+      WorkerCall<RecvBufRequest, ::grpc::ByteBuffer>* call) {
     Schedule([this, call]() {
       CallOptions* call_opts = new CallOptions;
       call->SetCancelCallback([call_opts]() { call_opts->StartCancel(); });
-      worker_->RecvBufAsync(call_opts, &call->request, &call->response,
-                            [call, call_opts](const Status& s) {
-                              call->ClearCancelCallback();
-                              delete call_opts;
-                              if (!s.ok()) {
-                                VLOG(3) << "Bad response from RecvBuf:" << s;
-                              }
-                              call->SendResponse(ToGrpcStatus(s));
-                            });
+      worker_->GrpcRecvBufAsync(call_opts, &call->request, &call->response,
+                                [call, call_opts](const Status& s) {
+                                  call->ClearCancelCallback();
+                                  delete call_opts;
+                                  if (!s.ok()) {
+                                    VLOG(3)
+                                        << "Bad response from RecvBuf:" << s;
+                                  }
+                                  call->SendResponse(ToGrpcStatus(s));
+                                });
     });
-    ENQUEUE_REQUEST(RecvBuf, true);
+    EnqueueRecvBufRequestRaw();
   }
 
   void CompleteGroupHandler(
@@ -353,6 +364,20 @@ class GrpcWorkerServiceThread {
     }
   }
 
+  // Added by Alpa
+  void EnqueueRecvBufRequestRaw() {
+    mutex_lock l(shutdown_mu_);
+    if (!is_shutdown_) {
+      Call<GrpcWorkerServiceThread, grpc::WorkerService::AsyncService,
+           RecvBufRequest, ::grpc::ByteBuffer>::
+          EnqueueRequestForMethod(
+              worker_service_, cq_.get(),
+              static_cast<int>(GrpcWorkerMethod::kRecvBuf),
+              &GrpcWorkerServiceThread::RecvBufHandlerRaw,
+              true /* supports cancel*/);
+    }
+  }
+
   GrpcWorker* const worker_ = nullptr;  // Not owned.
   std::unique_ptr<::grpc::ServerCompletionQueue> cq_;
   std::unique_ptr<Thread> thread_;
@@ -590,9 +615,8 @@ void SetTensorInRecvBufResp(int64_t max_chunk_bytes, const Tensor* tensor,
 
 void GrpcWorker::RecvBufAsync(CallOptions* opts, const RecvBufRequest* request,
                               RecvBufResponse* response, StatusCallback done) {
-  const int64_t request_id = request->request_id();
-  const int64_t step_id = request->step_id();
-  bool cache_enabled = (response_cache_ != nullptr && request_id != 0);
+  bool cache_enabled =
+      (response_cache_ != nullptr && request->request_id() != 0);
 
   auto do_response = [this, response, done, cache_enabled](
                          const Tensor& tensor, bool is_dead,
@@ -604,6 +628,35 @@ void GrpcWorker::RecvBufAsync(CallOptions* opts, const RecvBufRequest* request,
     response->set_require_ack(cache_enabled);
     done(status);
   };
+  RecvBufAsyncImpl(opts, request, cache_enabled, std::move(do_response));
+}
+
+// Added by Alpa
+void GrpcWorker::GrpcRecvBufAsync(CallOptions* opts,
+                                  const RecvBufRequest* request,
+                                  ::grpc::ByteBuffer* response,
+                                  StatusCallback done) {
+  bool cache_enabled =
+      (response_cache_ != nullptr && request->request_id() != 0);
+
+  auto do_response = [this, response, done, cache_enabled](
+                         const Tensor& tensor, bool is_dead,
+                         const Status& status) {
+    if (status.ok()) {
+      grpc::EncodeRecvBufResponseToByteBuffer(tensor, recv_buf_max_chunk_,
+                                              env_->env->NowMicros(),
+                                              cache_enabled, response);
+    }
+    done(status);
+  };
+  RecvBufAsyncImpl(opts, request, cache_enabled, std::move(do_response));
+}
+
+void GrpcWorker::RecvBufAsyncImpl(
+    CallOptions* opts, const RecvBufRequest* request, bool cache_enabled,
+    GrpcResponseCache::FinishResponseCB do_response) {
+  const int64_t request_id = request->request_id();
+  const int64_t step_id = request->step_id();
 
   // If response cache is enabled and the response cache already contains the
   // request, we delegate this retry request to the response cache. Otherwise,
@@ -52,6 +52,14 @@ class GrpcWorker : public Worker {
   void RecvBufAsync(CallOptions* opts, const RecvBufRequest* request,
                     RecvBufResponse* response, StatusCallback done) override;
 
+  // Added by Alpa. Specialized version of RecvBuf for gRPC, which encodes the
+  // response directly into a ::grpc::ByteBuffer that shares the memory of
+  // large tensors.
+  virtual void GrpcRecvBufAsync(CallOptions* opts,
+                                const RecvBufRequest* request,
+                                ::grpc::ByteBuffer* response,
+                                StatusCallback done);
+
   void CleanupGraphAsync(const CleanupGraphRequest* request,
                          CleanupGraphResponse* response,
                          StatusCallback done) override;
@@ -63,6 +71,12 @@ class GrpcWorker : public Worker {
   void RemoveCacheEntryForId(int64_t request_id);
 
  private:
+  // Added by Alpa. Receives the buffer of `request` and passes it to
+  // `do_response`, through the response cache if `cache_enabled`.
+  void RecvBufAsyncImpl(CallOptions* opts, const RecvBufRequest* request,
+                        bool cache_enabled,
+                        GrpcResponseCache::FinishResponseCB do_response);
+
   std::unique_ptr<GrpcResponseCache> response_cache_;
   const int32 recv_buf_max_chunk_;
 };
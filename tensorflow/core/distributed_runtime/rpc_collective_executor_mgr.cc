@@ -39,6 +39,15 @@ RpcCollectiveExecutorMgr::RpcCollectiveExecutorMgr(
   group_leader_ = (task_name == config.experimental().collective_group_leader())
                       ? ""
                       : config.experimental().collective_group_leader();
+  // Added by Alpa
+  const string& transport = config.experimental().collective_transport();
+  Status s =
+      CollectiveTransportRegistry::Lookup(transport, &transport_factory_);
+  if (!s.ok()) {
+    LOG(ERROR) << s << ", falling back to the grpc collective transport";
+    TF_CHECK_OK(
+        CollectiveTransportRegistry::Lookup("grpc", &transport_factory_));
+  }
 }
 
 RpcCollectiveExecutorMgr::~RpcCollectiveExecutorMgr() {
@@ -48,10 +57,9 @@ RpcCollectiveExecutorMgr::~RpcCollectiveExecutorMgr() {
 }
 
 CollectiveExecutor* RpcCollectiveExecutorMgr::Create(int64_t step_id) {
-  CollectiveRemoteAccessDistributed* rma =
-      new CollectiveRemoteAccessDistributed(dev_mgr_, dev_resolver_.get(),
-                                            work_queue_, worker_cache_, step_id,
-                                            task_name_);
+  CollectiveRemoteAccess* rma =
+      transport_factory_({dev_mgr_, dev_resolver_.get(), work_queue_,
+                          worker_cache_, step_id, task_name_});
   return new BaseCollectiveExecutor(this, rma, step_id, dev_mgr_, work_queue_);
 }
 
@@ -16,6 +16,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_COLLECTIVE_EXECUTOR_MGR_H_
 
 #include "tensorflow/core/common_runtime/collective_executor_mgr.h"
+#include "tensorflow/core/distributed_runtime/collective_rma_distributed.h"
 #include "tensorflow/core/framework/collective.h"
 
 namespace tensorflow {
@@ -61,6 +62,9 @@ class RpcCollectiveExecutorMgr : public CollectiveExecutorMgr {
 
   WorkerCacheInterface* const worker_cache_;  // Not owned.
   const string task_name_;
+  // Added by Alpa. Creates the CollectiveRemoteAccess of each step, as selected
+  // by ConfigProto.Experimental.collective_transport.
+  CollectiveTransportRegistry::Factory transport_factory_;
   string group_leader_;
   friend class RpcCollectiveExecutorMgrTest;
 
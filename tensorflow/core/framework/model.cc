@@ -1036,6 +1036,17 @@ class AsyncRatio : public Node {
     return result;
   }
 
+  // Added by Alpa. Each in-flight function call holds one input element, e.g.
+  // the image that a parallel map is decoding. Prefetching nodes, which have
+  // no `parallelism` parameter, make no calls.
+  double MaximumInFlightBytes() const TF_SHARED_LOCKS_REQUIRED(mu_) {
+    auto* parameter = gtl::FindOrNull(parameters_, kParallelism);
+    if (!parameter) {
+      return 0;
+    }
+    return (*parameter)->value * AverageConsumedElementSize();
+  }
+
  private:
   // Identifies how many input elements need to be created to construct an
   // element for the dataset.
@@ -1644,6 +1655,19 @@ double Node::TotalMaximumBufferedBytes() const {
   return total_bytes[long_name()];
 }
 
+double Node::TotalMaximumInFlightBytes() const {
+  Node::NodeValues total_bytes;
+  tf_shared_lock l(mu_);
+  for (const auto& node :
+       CollectNodesLocked(TraversalOrder::REVERSE_BFS, IsAnyNode)) {
+    tf_shared_lock l(node->mu_);
+    node->TotalMaximumInFlightBytesHelper(&total_bytes);
+  }
+  TotalMaximumInFlightBytesHelper(&total_bytes);
+
+  return total_bytes[long_name()];
+}
+
 double Node::TotalProcessingTime(Node::NodeValues* processing_times) {
   // Create a hash map to store the per-element CPU time spent in the subtree
   // rooted in each node.
@@ -1995,6 +2019,36 @@ double Node::MaximumBufferedBytes() const TF_SHARED_LOCKS_REQUIRED(mu_) {
   return 0;
 }
 
+void Node::TotalMaximumInFlightBytesHelper(Node::NodeValues* total_bytes) const
+    TF_SHARED_LOCKS_REQUIRED(mu_) {
+  if (!autotune_) {
+    total_bytes->insert(std::make_pair(long_name(), 0));
+    return;
+  }
+
+  double result = MaximumInFlightBytes();
+  for (auto& input : inputs_) {
+    result += total_bytes->at(input->long_name());
+  }
+  total_bytes->insert(std::make_pair(long_name(), result));
+}
+
+double Node::MaximumInFlightBytes() const TF_SHARED_LOCKS_REQUIRED(mu_) {
+  return 0;
+}
+
+double Node::AverageConsumedElementSize() const TF_SHARED_LOCKS_REQUIRED(mu_) {
+  if (inputs_.empty()) {
+    return 0;
+  }
+  const int64_t num_consumed = inputs_.front()->num_elements();
+  if (num_consumed <= 0) {
+    return 0;
+  }
+  return static_cast<double>(bytes_consumed_) /
+         static_cast<double>(num_consumed);
+}
+
 Status Node::ToProto(ModelProto::Node* node_proto) const {
   tf_shared_lock l(mu_);
   node_proto->set_id(id_);
@@ -2007,6 +2061,8 @@ Status Node::ToProto(ModelProto::Node* node_proto) const {
   node_proto->set_num_elements(num_elements_);
   node_proto->set_processing_time(processing_time_);
   node_proto->set_record_metrics(record_metrics_);
+  node_proto->set_maximum_buffered_bytes(MaximumBufferedBytes());
+  node_proto->set_maximum_in_flight_bytes(MaximumInFlightBytes());
 
   // Produce protos for all parameters.
   for (auto const& parameter : parameters_) {
@@ -2211,6 +2267,14 @@ void Model::Optimize(AutotuneAlgorithm algorithm, int64_t cpu_budget,
   if (experiment_ == "autotune_buffer_optimization") {
     OptimizeBuffers(snapshot, optimization_params.ram_budget());
   }
+  ModelProto::OptimizationResult optimization_result;
+  optimization_result.set_ram_budget(ram_budget);
+  optimization_result.set_total_maximum_buffered_bytes(
+      TotalMaximumBufferedBytes(snapshot));
+  optimization_result.set_total_maximum_in_flight_bytes(
+      snapshot->TotalMaximumInFlightBytes());
+  mutex_lock l(mu_);
+  optimization_result_ = std::move(optimization_result);
 }
 
 void Model::RemoveNode(std::shared_ptr<Node> node) {
@@ -2276,7 +2340,7 @@ bool Model::ShouldStop(int64_t cpu_budget, int64_t ram_budget,
 
   // If all parameters have reached their maximum values or RAM budget is
   // reached, we stop the iterations.
-  return all_max || TotalMaximumBufferedBytes(snapshot) > ram_budget;
+  return all_max || TotalMaximumMemoryBytes(snapshot) > ram_budget;
 }
 
 // TODO(jsimsa): Add support for tracking and using the model input time.
@@ -2376,6 +2440,10 @@ void Model::OptimizeGradientDescent(
   // and we only increase the buffer size parameters.
   bool cpu_budget_reached = false;
 
+  // Added by Alpa. The parameter values before the last update, which were
+  // within the RAM budget.
+  std::vector<double> values_within_budget;
+
   for (int i = 0; i < kMaxIterations; ++i) {
     if (cancellation_manager->IsCancelled() ||
         ShouldStop(optimization_params.cpu_budget(),
@@ -2393,6 +2461,10 @@ void Model::OptimizeGradientDescent(
       break;
     }
 
+    values_within_budget.clear();
+    for (auto& pair : parameters) {
+      values_within_budget.push_back(pair.second->value);
+    }
     UpdateParameterValues(
         gradients, &(cpu_budget_reached ? buffer_size_parameters : parameters));
     output_time = new_output_time;
@@ -2401,6 +2473,17 @@ void Model::OptimizeGradientDescent(
   for (auto& pair : parameters) {
     pair.second->value = std::round(pair.second->value);
   }
+  // Added by Alpa. The last update or the rounding may exceed the RAM budget,
+  // which is a hard limit. Falls back to the values before the last update,
+  // rounded down.
+  if (!values_within_budget.empty() &&
+      TotalMaximumMemoryBytes(snapshot) > optimization_params.ram_budget()) {
+    for (int i = 0; i < parameters.size(); ++i) {
+      parameters[i].second->value =
+          std::max(parameters[i].second->min,
+                   std::floor(values_within_budget[i]));
+    }
+  }
   UpdateStateValues(&parameters);
 }
 
@@ -2443,7 +2526,7 @@ void Model::OptimizeHillClimbHelper(
         OutputTime(snapshot, optimization_params.model_input_time(),
                    /*gradients=*/nullptr);
     if (should_stop(parameters, processing_time, output_time,
-                    TotalMaximumBufferedBytes(snapshot))) {
+                    TotalMaximumMemoryBytes(snapshot))) {
       break;
     }
 
@@ -2455,6 +2538,14 @@ void Model::OptimizeHillClimbHelper(
         continue;
       }
       pair.second->value++;
+      // Added by Alpa. Skips increments that would exceed the RAM budget, so
+      // that the budget is a hard limit and the remaining memory goes to the
+      // parameters that still fit.
+      if (TotalMaximumMemoryBytes(snapshot) >
+          optimization_params.ram_budget()) {
+        pair.second->value--;
+        continue;
+      }
       double new_output_time =
           OutputTime(snapshot, optimization_params.model_input_time(),
                      /*gradients=*/nullptr);
@@ -2552,8 +2643,7 @@ void Model::OptimizeStageBasedParallelism(
       break;
     }
     parallelism_parameter->value += 1.0;
-    if (TotalMaximumBufferedBytes(snapshot) >
-        optimization_params.ram_budget()) {
+    if (TotalMaximumMemoryBytes(snapshot) > optimization_params.ram_budget()) {
       // Increasing the parallelism by 1 exceeded ram budget. Reduce it back and
       // stop optimization because we cannot improve the most critical stage.
       // There is also a decent chance that the current optimization iteration
@@ -2610,7 +2700,7 @@ bool Model::UpsizeBuffers(std::shared_ptr<Node> snapshot, int64_t ram_budget) {
 
   // Compute available memory.
   double available_ram_bytes =
-      static_cast<double>(ram_budget) - TotalMaximumBufferedBytes(snapshot);
+      static_cast<double>(ram_budget) - TotalMaximumMemoryBytes(snapshot);
 
   // Compute the max memory used by all buffers that should be upsized.
   double max_buffered_bytes = 0;
@@ -2735,6 +2825,10 @@ double Model::TotalMaximumBufferedBytes(std::shared_ptr<Node> node) {
   return node->TotalMaximumBufferedBytes();
 }
 
+double Model::TotalMaximumMemoryBytes(std::shared_ptr<Node> node) {
+  return node->TotalMaximumBufferedBytes() + node->TotalMaximumInFlightBytes();
+}
+
 double Model::TotalProcessingTime(std::shared_ptr<Node> node) {
   return node->TotalProcessingTime(/*processing_times=*/nullptr);
 }
@@ -2742,6 +2836,9 @@ double Model::TotalProcessingTime(std::shared_ptr<Node> node) {
 Status Model::ToProto(ModelProto* model_proto) {
   tf_shared_lock l(mu_);
   model_proto->set_id_counter(id_counter_);
+  if (optimization_result_.has_value()) {
+    *model_proto->mutable_optimization_result() = *optimization_result_;
+  }
   return ModelToProtoHelper(output_, model_proto);
 }
 
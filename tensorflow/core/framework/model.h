@@ -18,6 +18,7 @@ limitations under the License.
 #include <algorithm>
 #include <list>
 #include <memory>
+#include <optional>
 #include <string>
 // TODO(b/114492873): Move this include into core/platform.
 #include <thread>  // NOLINT
@@ -456,6 +457,11 @@ class Node {
   // would be used by the subtree nodes if all of their buffers were full.
   double TotalMaximumBufferedBytes() const TF_LOCKS_EXCLUDED(mu_);
 
+  // Added by Alpa. Collects the bytes of the input elements held by the
+  // in-flight function calls of all nodes in the subtree for which autotuning
+  // is enabled, if all of their parallelism is used.
+  double TotalMaximumInFlightBytes() const TF_LOCKS_EXCLUDED(mu_);
+
   // Returns the per-element CPU time in nanoseconds spent in the subtree rooted
   // in this node. If `processing_times` is not `nullptr`, collects the
   // per-element CPU time spent in each node of the subtree.
@@ -655,6 +661,20 @@ class Node {
   // that the optimization algorithm respects the memory budget.
   virtual double MaximumBufferedBytes() const TF_SHARED_LOCKS_REQUIRED(mu_);
 
+  // Added by Alpa. Compute total maximum in-flight bytes for the node and store
+  // in the total bytes map.
+  void TotalMaximumInFlightBytesHelper(NodeValues* total_bytes) const
+      TF_SHARED_LOCKS_REQUIRED(mu_);
+
+  // Added by Alpa. Compute and return the bytes of the input elements held by
+  // the in-flight function calls of the node itself. Nodes without function
+  // calls hold none.
+  virtual double MaximumInFlightBytes() const TF_SHARED_LOCKS_REQUIRED(mu_);
+
+  // Added by Alpa. Returns the average size of the input elements consumed by
+  // this node, or 0 if it has not consumed any.
+  double AverageConsumedElementSize() const TF_SHARED_LOCKS_REQUIRED(mu_);
+
   // Restores node from the proto. Note that this is not done recursively, i.e.
   // input nodes are not restored.
   static Status FromProtoHelper(ModelProto::Node node_proto,
@@ -957,6 +977,11 @@ class Model {
   // buffers were full.
   double TotalMaximumBufferedBytes(std::shared_ptr<Node> node);
 
+  // Added by Alpa. Collects the memory of the subtree rooted in the given node
+  // that the RAM budget limits: the maximum buffered bytes and the in-flight
+  // bytes of the function calls.
+  double TotalMaximumMemoryBytes(std::shared_ptr<Node> node);
+
   // Used for coordination between different input pipeline threads. Exclusive
   // access is required only when adding or removing nodes. Concurrent access to
   // existing nodes is protected by a node mutex.
@@ -996,6 +1021,9 @@ class Model {
   std::deque<uint64_t> gap_times_usec_ TF_GUARDED_BY(gap_mu_);
   // The experiment that this job is part of.
   std::string experiment_ = "";
+  // Added by Alpa. The memory estimates of the most recent optimization.
+  std::optional<ModelProto::OptimizationResult> optimization_result_
+      TF_GUARDED_BY(mu_);
 };
 
 // Class to compute timing information for a model.
@@ -1315,6 +1315,52 @@ TEST_P(OptimizeZeroRamBudgetTest, Model) {
 INSTANTIATE_TEST_SUITE_P(Test, OptimizeZeroRamBudgetTest,
                          ::testing::Values(0, 1, 2, 3));
 
+// Added by Alpa
+TEST(ModelTest, InFlightBytesLimitParallelism) {
+  std::shared_ptr<mutex> mutex1 = std::make_shared<mutex>();
+  std::shared_ptr<condition_variable> cv1 =
+      std::make_shared<condition_variable>();
+  std::shared_ptr<Node> map = model::MakeAsyncKnownRatioNode(
+      {1, "map", nullptr}, 1,
+      {model::MakeParameter("parallelism",
+                            std::make_shared<SharedState>(
+                                /*value=*/model::kAutotune, mutex1, cv1),
+                            /*min=*/1, /*max=*/16)});
+  std::shared_ptr<Node> source = model::MakeSourceNode({2, "source", map});
+  map->add_input(source);
+  // Each call decodes a 100 byte input element into a 10 byte element.
+  source->record_element();
+  source->record_bytes_produced(100);
+  map->record_bytes_consumed(100);
+  map->record_element();
+  map->record_bytes_produced(10);
+
+  model::Model model;
+  model.AddNode([&map](model::Node::Args args) { return map; }, "map",
+                nullptr, &map);
+  model.AddNode([&source](model::Node::Args args) { return source; },
+                "source", map, &source);
+
+  // Each unit of parallelism takes 110 bytes, of which the buffer only
+  // accounts for 10.
+  CancellationManager cancellation_manager;
+  model.Optimize(model::AutotuneAlgorithm::MAX_PARALLELISM, /*cpu_budget=*/40,
+                 /*ram_budget=*/500, /*model_input_time=*/0,
+                 &cancellation_manager);
+  EXPECT_EQ(map->parameter_value("parallelism"), 4);
+  EXPECT_EQ(map->TotalMaximumInFlightBytes(), 400);
+
+  ModelProto model_proto;
+  TF_ASSERT_OK(model.ToProto(&model_proto));
+  EXPECT_EQ(model_proto.optimization_result().ram_budget(), 500);
+  EXPECT_EQ(model_proto.optimization_result().total_maximum_buffered_bytes(),
+            40);
+  EXPECT_EQ(model_proto.optimization_result().total_maximum_in_flight_bytes(),
+            400);
+  EXPECT_EQ(model_proto.nodes().at(1).maximum_in_flight_bytes(), 400);
+  EXPECT_EQ(model_proto.nodes().at(2).maximum_in_flight_bytes(), 0);
+}
+
 TEST(RecordTimeTest, RecordTimeTest) {
   std::shared_ptr<Node> source = model::MakeSourceNode({});
   EXPECT_FALSE(source->is_recording());
@@ -661,6 +661,10 @@ class OpKernelContext {
     bool run_all_kernels_inline = false;
     const std::string* executor_type = nullptr;
 
+    // Added by Alpa. If not null, serves the allocations with default
+    // attributes instead of the device allocator.
+    Allocator* intermediate_allocator = nullptr;
+
     // TensorSliceReaderCache support.
     checkpoint::TensorSliceReaderCacheWrapper* slice_reader_cache = nullptr;
 
@@ -0,0 +1,308 @@
+#include "tensorflow/core/grappler/optimizers/data/map_vectorization.h"
+
+#include <array>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/mutable_graph_view.h"
+#include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
+#include "tensorflow/core/grappler/optimizers/data/function_utils.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/lib/gtl/map_util.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kMapDataset[] = "MapDataset";
+constexpr char kParallelMapDatasetV2[] = "ParallelMapDatasetV2";
+constexpr char kOutputShapesAttr[] = "_output_shapes";
+
+// Element-wise ops whose output has the shape of their input.
+constexpr std::array<const char*, 25> kUnaryConverters = {
+    "Abs",      "Cast",       "Ceil",    "Cos",      "Elu",
+    "Exp",      "Expm1",      "Floor",   "Identity", "Log",
+    "Log1p",    "LogicalNot", "Neg",     "Relu",     "Relu6",
+    "Round",    "Rsqrt",      "Sigmoid", "Sign",     "Sin",
+    "Snapshot", "Softplus",   "Sqrt",    "Square",   "Tanh"};
+
+// Element-wise ops which broadcast their two inputs.
+constexpr std::array<const char*, 15> kBinaryConverters = {
+    "Add",     "AddV2",             "Greater",    "GreaterEqual",
+    "Less",    "LessEqual",         "LogicalAnd", "LogicalOr",
+    "Maximum", "Minimum",           "Mul",        "Pow",
+    "RealDiv", "SquaredDifference", "Sub"};
+
+// How a tensor of a map function relates to the batch once the function is
+// vectorized.
+struct TensorInfo {
+  // Whether the tensor gains the leading batch dimension. Tensors which don't
+  // are scalars, which broadcast the same way against any batched tensor.
+  bool batched = false;
+  // For batched tensors, the index of the function argument whose shape the
+  // tensor has.
+  int arg_index = -1;
+};
+
+// Checks whether the body of a map function has a converter for every node,
+// tracking the shape of each tensor relative to the function arguments.
+class VectorizationAnalysis {
+ public:
+  explicit VectorizationAnalysis(const FunctionDef& function)
+      : function_(function) {
+    const auto& input_args = function.signature().input_arg();
+    for (int i = 0; i < input_args.size(); ++i) {
+      args_[input_args[i].name()] = i;
+    }
+    for (const NodeDef& node : function.node_def()) {
+      nodes_[node.name()] = &node;
+    }
+  }
+
+  // Returns, for each output of the function, the index of the argument whose
+  // shape it has, or std::nullopt if the function is not vectorizable.
+  std::optional<std::vector<int>> OutputArgIndices() {
+    std::vector<int> indices;
+    absl::flat_hash_set<int> used_args;
+    for (const auto& output_arg : function_.signature().output_arg()) {
+      const string* output =
+          gtl::FindOrNull(function_.ret(), output_arg.name());
+      if (output == nullptr) return std::nullopt;
+      std::optional<TensorInfo> info = ResolveTensor(*output);
+      // Unbatched outputs would have to be tiled to the batch size.
+      if (!info.has_value() || !info->batched) return std::nullopt;
+      indices.push_back(info->arg_index);
+      used_args.insert(info->arg_index);
+    }
+    // The arguments are batched before the function is applied, so they must
+    // have the same shape across elements, as the outputs did.
+    if (used_args.size() != args_.size()) return std::nullopt;
+    return indices;
+  }
+
+ private:
+  std::optional<TensorInfo> ResolveTensor(const string& tensor) {
+    std::vector<string> parts = absl::StrSplit(tensor, ':');
+    if (parts.size() == 1) {
+      const int* arg_index = gtl::FindOrNull(args_, parts[0]);
+      if (arg_index != nullptr) {
+        return TensorInfo{/*batched=*/true, *arg_index};
+      }
+    } else if (parts.back() != "0") {
+      // All converted ops have a single output.
+      return std::nullopt;
+    }
+    return ResolveNode(parts[0]);
+  }
+
+  std::optional<TensorInfo> ResolveNode(const string& name) {
+    auto it = resolved_.find(name);
+    if (it != resolved_.end()) return it->second;
+    // Guards against malformed functions with cycles.
+    resolved_[name] = std::nullopt;
+    std::optional<TensorInfo> info;
+    const NodeDef* const* node = gtl::FindOrNull(nodes_, name);
+    if (node != nullptr) {
+      info = ConvertNode(**node);
+    }
+    resolved_[name] = info;
+    return info;
+  }
+
+  std::optional<TensorInfo> ConvertNode(const NodeDef& node) {
+    for (const string& input : node.input()) {
+      if (IsControlInput(input)) return std::nullopt;
+    }
+    if (node.op() == "Const") {
+      const AttrValue* value = gtl::FindOrNull(node.attr(), "value");
+      if (value == nullptr || value->tensor().tensor_shape().dim_size() != 0) {
+        return std::nullopt;
+      }
+      return TensorInfo();
+    }
+    if (absl::c_linear_search(kUnaryConverters, node.op())) {
+      if (node.input_size() != 1) return std::nullopt;
+      return ResolveTensor(node.input(0));
+    }
+    if (absl::c_linear_search(kBinaryConverters, node.op())) {
+      if (node.input_size() != 2) return std::nullopt;
+      std::optional<TensorInfo> x = ResolveTensor(node.input(0));
+      std::optional<TensorInfo> y = ResolveTensor(node.input(1));
+      if (!x.has_value() || !y.has_value()) return std::nullopt;
+      if (!x->batched) return y;
+      if (!y->batched) return x;
+      // Batched tensors of different argument shapes may broadcast against
+      // each other only without the batch dimension.
+      if (x->arg_index != y->arg_index) return std::nullopt;
+      return x;
+    }
+    return std::nullopt;
+  }
+
+  const FunctionDef& function_;
+  absl::flat_hash_map<string, int> args_;
+  absl::flat_hash_map<string, const NodeDef*> nodes_;
+  absl::flat_hash_map<string, std::optional<TensorInfo>> resolved_;
+};
+
+// Sets `types` to the argument types of `function` instantiated with the
+// attributes of `func_attr`. Returns false if they can't be determined.
+bool GetArgTypes(const FunctionDef& function, const AttrValue& func_attr,
+                 DataTypeVector* types) {
+  for (const auto& arg : function.signature().input_arg()) {
+    if (!arg.number_attr().empty() || !arg.type_list_attr().empty()) {
+      return false;
+    }
+    if (arg.type() != DT_INVALID) {
+      types->push_back(arg.type());
+      continue;
+    }
+    const AttrValue* type = gtl::FindOrNull(func_attr.func().attr(),
+                                            arg.type_attr());
+    if (type == nullptr) return false;
+    types->push_back(type->type());
+  }
+  return true;
+}
+
+// Returns the number of captured inputs of the map node.
+int NumCapturedInputs(const NodeDef& map_node) {
+  const AttrValue* targuments = gtl::FindOrNull(map_node.attr(), "Targuments");
+  return targuments == nullptr ? 0 : targuments->list().type_size();
+}
+
+// Copies `function` into a function which runs on batches. The body is kept
+// as is, but the per-element shapes recorded for the arguments and nodes no
+// longer hold.
+FunctionDef MakeVectorizedFunction(const FunctionDef& function,
+                                   const FunctionDefLibrary& library) {
+  FunctionDef vectorized_function = function;
+  graph_utils::SetUniqueGraphFunctionName(
+      absl::StrCat("vectorized_", function.signature().name()), &library,
+      &vectorized_function);
+  for (auto& arg_attr : *vectorized_function.mutable_arg_attr()) {
+    arg_attr.second.mutable_attr()->erase(kOutputShapesAttr);
+  }
+  for (NodeDef& node : *vectorized_function.mutable_node_def()) {
+    node.mutable_attr()->erase(kOutputShapesAttr);
+  }
+  return vectorized_function;
+}
+
+}  // namespace
+
+Status MapVectorization::OptimizeAndCollectStats(Cluster* cluster,
+                                                 const GrapplerItem& item,
+                                                 GraphDef* output,
+                                                 OptimizationStats* stats) {
+  *output = item.graph;
+  MutableGraphView graph(output);
+  absl::flat_hash_set<string> nodes_to_delete;
+  FunctionLibraryDefinition function_library(OpRegistry::Global(),
+                                             item.graph.library());
+
+  for (const NodeDef& node : item.graph.node()) {
+    if (node.op() != "BatchDataset" && node.op() != "BatchDatasetV2") {
+      continue;
+    }
+    // Use a more descriptive variable name now that we know the node type.
+    const NodeDef& batch_node = node;
+    NodeDef* map_node = graph_utils::GetInputNode(batch_node, graph);
+    if (map_node == nullptr || (map_node->op() != kMapDataset &&
+                                map_node->op() != kParallelMapDatasetV2)) {
+      continue;
+    }
+    // The map is removed, so the batch must be its only consumer.
+    if (graph.GetFanouts(*map_node, /*include_controlled_nodes=*/true)
+            .size() != 1) {
+      continue;
+    }
+    // Captured inputs are not batched, and their shapes are not known.
+    if (NumCapturedInputs(*map_node) > 0) continue;
+
+    const AttrValue& func_attr = map_node->attr().at("f");
+    const FunctionDef* function =
+        function_library.Find(func_attr.func().name());
+    if (function == nullptr ||
+        function_utils::IsFunctionStateful(function_library, *function)) {
+      continue;
+    }
+    std::optional<std::vector<int>> output_arg_indices =
+        VectorizationAnalysis(*function).OutputArgIndices();
+    if (!output_arg_indices.has_value()) {
+      VLOG(2) << "Not vectorizing " << map_node->name()
+              << ": its function has ops without converters.";
+      continue;
+    }
+    DataTypeVector arg_types;
+    if (!GetArgTypes(*function, func_attr, &arg_types)) continue;
+    const AttrValue* batch_shapes =
+        gtl::FindOrNull(batch_node.attr(), "output_shapes");
+    if (batch_shapes == nullptr || batch_shapes->list().shape_size() !=
+                                       output_arg_indices->size()) {
+      continue;
+    }
+
+    // The batch of the arguments has the batched shape of an output with the
+    // same shape.
+    NodeDef vectorized_batch = batch_node;
+    graph_utils::SetUniqueGraphNodeName("vectorized_batch", graph.graph(),
+                                        &vectorized_batch);
+    vectorized_batch.set_input(0, map_node->input(0));
+    AttrValue arg_shapes;
+    arg_shapes.mutable_list();
+    for (int i = 0; i < arg_types.size(); ++i) {
+      int output_index =
+          absl::c_find(*output_arg_indices, i) - output_arg_indices->begin();
+      *arg_shapes.mutable_list()->add_shape() =
+          batch_shapes->list().shape(output_index);
+    }
+    (*vectorized_batch.mutable_attr())["output_shapes"] = arg_shapes;
+    AttrValue arg_types_attr;
+    SetAttrValue(arg_types, &arg_types_attr);
+    (*vectorized_batch.mutable_attr())["output_types"] = arg_types_attr;
+
+    FunctionDef vectorized_function =
+        MakeVectorizedFunction(*function, output->library());
+    NodeDef vectorized_map = *map_node;
+    graph_utils::SetUniqueGraphNodeName("vectorized_map", graph.graph(),
+                                        &vectorized_map);
+    vectorized_map.set_input(0, vectorized_batch.name());
+    (*vectorized_map.mutable_attr())["f"].mutable_func()->set_name(
+        vectorized_function.signature().name());
+    graph_utils::CopyShapesAndTypesAttrs(batch_node, &vectorized_map);
+    TF_RETURN_IF_ERROR(function_library.AddFunctionDef(vectorized_function));
+    *output->mutable_library()->add_function() = vectorized_function;
+
+    graph.AddNode(std::move(vectorized_batch));
+    NodeDef* new_map = graph.AddNode(std::move(vectorized_map));
+    TF_RETURN_IF_ERROR(graph.UpdateFanouts(batch_node.name(), new_map->name()));
+
+    // Mark the original `Map` and `Batch` nodes for removal.
+    nodes_to_delete.insert(map_node->name());
+    nodes_to_delete.insert(batch_node.name());
+    stats->num_changes++;
+  }
+
+  TF_RETURN_IF_ERROR(graph.DeleteNodes(nodes_to_delete));
+  return OkStatus();
+}
+
+REGISTER_GRAPH_OPTIMIZER_AS(MapVectorization, "map_vectorization");
+
+}  // namespace grappler
+}  // namespace tensorflow
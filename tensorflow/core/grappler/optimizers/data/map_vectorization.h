@@ -0,0 +1,44 @@
+// This file contains the map_vectorization tf.data optimization, which swaps
+// `map(f).batch(n)` for `batch(n).map(vectorized_f)` so that `f` is invoked
+// once per batch instead of once per element.
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_MAP_VECTORIZATION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_MAP_VECTORIZATION_H_
+
+#include "tensorflow/core/grappler/optimizers/data/optimizer_base.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// This optimization moves a map transformation after the batch transformation
+// that consumes it, when the map function can be vectorized. A function is
+// vectorizable when every node of its body has a converter, i.e. is an
+// element-wise op whose batched inputs are guaranteed to broadcast the same
+// way with and without the leading batch dimension. Such a body computes the
+// batched result as is, so `vectorized_f` is a copy of `f` without its
+// per-element shape annotations. Pipelines whose functions are not
+// vectorizable, e.g. because they are stateful, capture inputs, or use an op
+// without a converter, are left unchanged.
+class MapVectorization : public TFDataOptimizerBase {
+ public:
+  MapVectorization() = default;
+  ~MapVectorization() override = default;
+
+  string name() const override { return "map_vectorization"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Init(
+      const tensorflow::RewriterConfig_CustomGraphOptimizer* config) override {
+    return OkStatus();
+  }
+
+  Status OptimizeAndCollectStats(Cluster* cluster, const GrapplerItem& item,
+                                 GraphDef* output,
+                                 OptimizationStats* stats) override;
+};
+
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_MAP_VECTORIZATION_H_
@@ -0,0 +1,132 @@
+#include "tensorflow/core/grappler/optimizers/data/map_vectorization.h"
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+using test::function::NDef;
+
+// Returns x + [1, 2], which broadcasts differently once `x` is batched.
+FunctionDef XPlusVector() {
+  const Tensor kVector = test::AsTensor<int64_t>({1, 2});
+  return FunctionDefHelper::Define(
+      // Name
+      "XPlusVector",
+      // Args
+      {"x: int64"},
+      // Return values
+      {"y: int64"},
+      // Attr def
+      {},
+      // Nodes
+      {
+          {{"vector"}, "Const", {}, {{"value", kVector}, {"dtype", DT_INT64}}},
+          {{"y"}, "AddV2", {"x", "vector"}, {{"T", DT_INT64}}},
+      });
+}
+
+// Creates a graph with range -> map(`function_name`) -> batch.
+GrapplerItem MakeMapAndBatchItem(const string& function_name,
+                                 const FunctionDef& function) {
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("start", "Const", {}, {{"value", 0}, {"dtype", DT_INT64}}),
+       NDef("stop", "Const", {}, {{"value", 10}, {"dtype", DT_INT64}}),
+       NDef("step", "Const", {}, {{"value", 1}, {"dtype", DT_INT64}}),
+       NDef("range", "RangeDataset", {"start", "stop", "step"},
+            {{"output_shapes", gtl::ArraySlice<TensorShape>{TensorShape({})}},
+             {"output_types", gtl::ArraySlice<DataType>{DT_INT64}}}),
+       NDef("map", "MapDataset", {"range"},
+            {{"f", FunctionDefHelper::FunctionRef(function_name,
+                                                  {{"T", DT_INT64}})},
+             {"Targuments", gtl::ArraySlice<DataType>{}},
+             {"output_shapes", gtl::ArraySlice<TensorShape>{TensorShape({})}},
+             {"output_types", gtl::ArraySlice<DataType>{DT_INT64}}}),
+       NDef("batch_size", "Const", {}, {{"value", 5}, {"dtype", DT_INT64}}),
+       NDef("drop_remainder", "Const", {},
+            {{"value", false}, {"dtype", DT_BOOL}}),
+       NDef("batch", "BatchDatasetV2",
+            {"map", "batch_size", "drop_remainder"},
+            {{"parallel_copy", false},
+             {"output_shapes",
+              gtl::ArraySlice<PartialTensorShape>{PartialTensorShape({-1})}},
+             {"output_types", gtl::ArraySlice<DataType>{DT_INT64}}}),
+       NDef("Sink", "Identity", {"batch"}, {})},
+      // FunctionLib
+      {function});
+  item.fetch.push_back("Sink");
+  return item;
+}
+
+class VectorizableFunction : public ::testing::TestWithParam<FunctionDef> {};
+
+TEST_P(VectorizableFunction, MapVectorizationTest) {
+  const FunctionDef& function = GetParam();
+  GrapplerItem item =
+      MakeMapAndBatchItem(function.signature().name(), function);
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("batch", output));
+  const NodeDef& batch_node = output.node(
+      graph_utils::FindGraphNodeWithOp("BatchDatasetV2", output));
+  const NodeDef& map_node =
+      output.node(graph_utils::FindGraphNodeWithOp("MapDataset", output));
+  EXPECT_EQ(batch_node.input(0), "range");
+  EXPECT_EQ(map_node.input(0), batch_node.name());
+  const NodeDef& sink_node =
+      output.node(graph_utils::FindGraphNodeWithName("Sink", output));
+  EXPECT_EQ(sink_node.input(0), map_node.name());
+
+  EXPECT_EQ(batch_node.attr().at("output_types").list().type(0), DT_INT64);
+  EXPECT_EQ(
+      batch_node.attr().at("output_shapes").list().shape(0).DebugString(),
+      map_node.attr().at("output_shapes").list().shape(0).DebugString());
+  const string& vectorized_function = map_node.attr().at("f").func().name();
+  EXPECT_TRUE(absl::StartsWith(vectorized_function, "vectorized_"));
+  EXPECT_TRUE(
+      graph_utils::ContainsGraphFunctionWithName(vectorized_function,
+                                                 output.library()));
+}
+
+INSTANTIATE_TEST_SUITE_P(Test, VectorizableFunction,
+                         ::testing::Values(test::function::XTimesTwo(),
+                                           test::function::XAddX()));
+
+class NonVectorizableFunction
+    : public ::testing::TestWithParam<FunctionDef> {};
+
+TEST_P(NonVectorizableFunction, MapVectorizationTest) {
+  const FunctionDef& function = GetParam();
+  GrapplerItem item =
+      MakeMapAndBatchItem(function.signature().name(), function);
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("batch", output));
+  const NodeDef& batch_node =
+      output.node(graph_utils::FindGraphNodeWithName("batch", output));
+  EXPECT_EQ(batch_node.input(0), "map");
+}
+
+INSTANTIATE_TEST_SUITE_P(Test, NonVectorizableFunction,
+                         ::testing::Values(test::function::RandomUniform(),
+                                           XPlusVector()));
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -797,6 +797,10 @@ Status BuildSwapPair(NodeDef* node, int input_to_swap,
   return OkStatus();
 }
 
+// Added by Alpa. Bandwidth assumed for the copies between host and GPU memory
+// of swapped tensors, in bytes per nanosecond (16 GBps, PCIe 3.0 x16).
+constexpr int64_t kHostDeviceBytesPerNs = 16;
+
 struct SwapInfo {
   std::vector<int> inputs_to_swap;
   Costs::NanoSeconds time_to_swap = 0;
@@ -973,14 +977,50 @@ struct MemInfo {
   int64_t memory_used;
   std::vector<MutableGraphView::InputPort> uses_left;
   double fitness;
+  // Added by Alpa. Only set when swaps are planned with the cost model.
+  Costs::Duration allocation_time;
+  Costs::Duration earliest_use;
+  Costs::Duration swap_time;
 
   bool operator<(const MemInfo& other) const { return fitness < other.fitness; }
 };
 
+// Added by Alpa. A copy over one direction of the host link, which has to
+// start after `release` and finish by `deadline`.
+struct LinkTransfer {
+  Costs::Duration release;
+  Costs::Duration deadline;
+  Costs::Duration duration;
+};
+
+// Added by Alpa. Returns true if `transfers` can run one after the other on
+// the link within their release times and deadlines. The transfers either all
+// share a deadline (swap-outs before the peak) or all share a release time
+// (swap-ins after the peak), for which running them in the order of release
+// and then deadline is optimal.
+static bool FitsOnLink(std::vector<LinkTransfer> transfers) {
+  std::sort(transfers.begin(), transfers.end(),
+            [](const LinkTransfer& a, const LinkTransfer& b) {
+              return std::make_pair(a.release, a.deadline) <
+                     std::make_pair(b.release, b.deadline);
+            });
+  Costs::Duration link_free(0);
+  for (const LinkTransfer& transfer : transfers) {
+    link_free = std::max(link_free, transfer.release) + transfer.duration;
+    if (link_free > transfer.deadline) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Added by Alpa: with `use_cost_model`, only the tensors whose swaps can be
+// hidden behind compute in the estimated schedule are picked, instead of
+// ranking them by their distance to the peak.
 static bool IdentifySwappingCandidates(
     Cluster* cluster, GrapplerItem* item,
     std::unique_ptr<GraphMemory>* memory_ptr,
-    std::unordered_set<string>* skip_list,
+    std::unordered_set<string>* skip_list, bool use_cost_model,
     std::unordered_map<NodeDef*, SwapInfo>* nodes_to_swap) {
   if ((*memory_ptr) == nullptr) {
     memory_ptr->reset(new GraphMemory(*item));
@@ -1052,8 +1092,9 @@ static bool IdentifySwappingCandidates(
         // Don't bother with small tensors.
         continue;
       }
-      if (live_tensor.deallocation_time - live_tensor.allocation_time <=
-          Costs::Duration(1e6)) {
+      if (!use_cost_model &&
+          live_tensor.deallocation_time - live_tensor.allocation_time <=
+              Costs::Duration(1e6)) {
         // Not enough time to swap.
         VLOG(1) << "Not enough time to swap: skipping " << live_tensor.node;
         continue;
@@ -1103,7 +1144,24 @@ static bool IdentifySwappingCandidates(
         mem_info.uses_left.emplace_back(input);
         earliest_use = std::min(earliest_use, it->second);
       }
-      if (valid && !mem_info.uses_left.empty()) {
+      if (valid && !mem_info.uses_left.empty() && use_cost_model) {
+        // Each use gets its own swap pair. The swap-outs have to be done by
+        // the peak, and the swap-ins can only start after it and have to be
+        // done by the earliest use.
+        mem_info.swap_time =
+            Costs::NanoSeconds(mem_info.memory_used / kHostDeviceBytesPerNs);
+        if (allocation_time + mem_info.swap_time > peak_time ||
+            peak_time + mem_info.swap_time > earliest_use) {
+          VLOG(1) << "Swap can't be hidden: skipping " << live_tensor.node;
+          continue;
+        }
+        mem_info.allocation_time = allocation_time;
+        mem_info.earliest_use = earliest_use;
+        // Prefer the tensors that free the most memory per copy.
+        mem_info.fitness = -static_cast<double>(mem_info.memory_used) /
+                           mem_info.uses_left.size();
+        mem_state.push_back(mem_info);
+      } else if (valid && !mem_info.uses_left.empty()) {
         // Compute the fitness: we need the tensor to be generated way away of
         // the time of peak memory usage (to ensure there is enough time to swap
         // it out). We also need to ensure it's used way after the peak time, to
@@ -1125,7 +1183,28 @@ static bool IdentifySwappingCandidates(
     // Sort by fitness
     std::sort(mem_state.begin(), mem_state.end());
 
+    // Added by Alpa. The copies planned so far, in each direction of the host
+    // link.
+    std::vector<LinkTransfer> swap_outs;
+    std::vector<LinkTransfer> swap_ins;
     for (const MemInfo& mem_info : mem_state) {
+      if (use_cost_model) {
+        std::vector<LinkTransfer> new_swap_outs = swap_outs;
+        std::vector<LinkTransfer> new_swap_ins = swap_ins;
+        for (int i = 0; i < mem_info.uses_left.size(); ++i) {
+          new_swap_outs.push_back(
+              {mem_info.allocation_time, peak_time, mem_info.swap_time});
+          new_swap_ins.push_back(
+              {peak_time, mem_info.earliest_use, mem_info.swap_time});
+        }
+        if (!FitsOnLink(new_swap_outs) || !FitsOnLink(new_swap_ins)) {
+          VLOG(1) << "Host link is busy: skipping "
+                  << mem_info.port.node->name();
+          continue;
+        }
+        swap_outs = std::move(new_swap_outs);
+        swap_ins = std::move(new_swap_ins);
+      }
       for (const MutableGraphView::InputPort fanout_to_swap :
            mem_info.uses_left) {
         VLOG(1) << "Will swap fanout " << fanout_to_swap.node->name() << ":"
@@ -1155,7 +1234,11 @@ bool SwappingPass(RewriterConfig::MemOptType optimization_level,
       optimization_level == RewriterConfig::HEURISTICS) {
     // Use heuristics to figure out what needs to be swapped;
     IdentifySwappingCandidates(cluster, item, memory, skip_list,
-                               &nodes_to_swap);
+                               /*use_cost_model=*/false, &nodes_to_swap);
+  } else if (optimization_level == RewriterConfig::SWAPPING_COST_MODEL) {
+    // Added by Alpa
+    IdentifySwappingCandidates(cluster, item, memory, skip_list,
+                               /*use_cost_model=*/true, &nodes_to_swap);
   }
   // Look for manual annotations in the graph.
   for (auto& node : *item->graph.mutable_node()) {
@@ -1197,7 +1280,7 @@ bool SwappingPass(RewriterConfig::MemOptType optimization_level,
       bytes_to_swap += CalculateTensorSize(t);
     }
     // Let's assume we're going to swap over PCIe running at 16 GBps.
-    swap_info.time_to_swap = bytes_to_swap / 16;
+    swap_info.time_to_swap = bytes_to_swap / kHostDeviceBytesPerNs;
   }
 
   std::unordered_map<const NodeDef*, Costs::NanoSeconds> execution_times;
@@ -1426,7 +1509,9 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
       if ((optimization_level_ == RewriterConfig::DEFAULT_MEM_OPT ||
            optimization_level_ == RewriterConfig::SWAPPING_HEURISTICS ||
            optimization_level_ == RewriterConfig::HEURISTICS ||
-           optimization_level_ == RewriterConfig::MANUAL) &&
+           optimization_level_ == RewriterConfig::MANUAL ||
+           // Added by Alpa
+           optimization_level_ == RewriterConfig::SWAPPING_COST_MODEL) &&
           cluster != nullptr) {
         if (SwappingPass(optimization_level_, cluster, &memory, &optimized_item,
                          &skip_list)) {
@@ -20,6 +20,7 @@ limitations under the License.
 #include <string>
 #include <utility>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
@@ -59,7 +60,11 @@ limitations under the License.
 #include "tensorflow/core/grappler/verifiers/structure_verifier.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/threadpool.h"
 #include "tensorflow/core/util/dump_graph.h"
 #include "tensorflow/core/util/ptr_util.h"
 #include "tensorflow/core/util/util.h"
@@ -184,6 +189,40 @@ Status GetGraphDevice(const GraphDef& g_def, std::set<std::string>* devices) {
   return OkStatus();
 }
 
+// Added by Alpa. The upper bound on the number of optimized function bodies
+// kept by FunctionOptimizationCache.
+constexpr int kMaxCachedFunctions = 4096;
+
+// Added by Alpa. Optimized function bodies shared by the meta optimizers of
+// the process, keyed by the fingerprint of the function, its library and the
+// configuration of the optimization.
+class FunctionOptimizationCache {
+ public:
+  static FunctionOptimizationCache* Global() {
+    static FunctionOptimizationCache* cache = new FunctionOptimizationCache;
+    return cache;
+  }
+
+  bool Lookup(const Fprint128& key, GraphDef* optimized_func_graph) {
+    mutex_lock l(mu_);
+    auto it = graphs_.find(key);
+    if (it == graphs_.end()) return false;
+    *optimized_func_graph = it->second;
+    return true;
+  }
+
+  void Insert(const Fprint128& key, const GraphDef& optimized_func_graph) {
+    mutex_lock l(mu_);
+    if (graphs_.size() >= kMaxCachedFunctions) return;
+    graphs_.emplace(key, optimized_func_graph);
+  }
+
+ private:
+  mutex mu_;
+  absl::flat_hash_map<Fprint128, GraphDef, Fprint128Hasher> graphs_
+      TF_GUARDED_BY(mu_);
+};
+
 }  // namespace
 
 #define MK_OPT(NAME, CONFIG, VALUE)                                    \
@@ -802,6 +841,14 @@ Status MetaOptimizer::OptimizeGraph(
     CompressConstants(optimized_graph);
   }
 
+  // Added by Alpa. An optimizer that left the graph unchanged doesn't run again
+  // until another optimizer changes the graph. Maps each such optimizer to the
+  // fingerprint of the graph it left unchanged.
+  const bool skip_unchanged = NumIterations(cfg_) > 1;
+  absl::flat_hash_map<const GraphOptimizer*, uint64> unchanged_fingerprints;
+  uint64 fingerprint =
+      skip_unchanged ? DeterministicProtoHash64(*optimized_graph) : 0;
+
   for (int iteration = 0; iteration < NumIterations(cfg_); ++iteration) {
     // Don't bother optimizing further if the graph is already tiny.
     if (optimized_graph->node_size() < min_graph_nodes) {
@@ -831,6 +878,15 @@ Status MetaOptimizer::OptimizeGraph(
       }
 #endif
 
+      if (skip_unchanged) {
+        auto it = unchanged_fingerprints.find(optimizer.get());
+        if (it != unchanged_fingerprints.end() && it->second == fingerprint) {
+          VLOG(3) << "Skipping " << optimizer->name()
+                  << ", the graph is unchanged since its last run";
+          continue;
+        }
+      }
+
       TF_RETURN_IF_ERROR(RunOptimizer(optimizer.get(), cluster, &item,
                                       optimized_graph, &optimization_result));
 
@@ -838,6 +894,17 @@ Status MetaOptimizer::OptimizeGraph(
         CompressConstants(optimized_graph);
       }
 
+      if (skip_unchanged) {
+        const uint64 new_fingerprint =
+            DeterministicProtoHash64(*optimized_graph);
+        if (new_fingerprint == fingerprint) {
+          unchanged_fingerprints[optimizer.get()] = fingerprint;
+        } else {
+          unchanged_fingerprints.erase(optimizer.get());
+          fingerprint = new_fingerprint;
+        }
+      }
+
       if (VLOG_IS_ON(4)) {
         DumpGraphDefToFile(
             strings::StrCat("after_MetaOptimizer_iteration_", iteration, "_",
@@ -877,7 +944,11 @@ Status MetaOptimizer::OptimizeGraph(
                                    }) != optimization_result.results.end();
 
   // Record graph optimization result.
-  optimization_results_.push_back(optimization_result);
+  {
+    // Added by Alpa: functions may be optimized in parallel.
+    mutex_lock l(optimization_results_mu_);
+    optimization_results_.push_back(optimization_result);
+  }
 
   if (is_optimized) {
     TF_RETURN_IF_ERROR(TopologicalSort(optimized_graph));
@@ -1152,11 +1223,139 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
   // True if this is a TPU graph using the old bridge.
   bool is_tpu_graph = IsLegacyTPUBridgeGraphDef(*optimized_graph);
 
+  // Added by Alpa. Everything the optimization of a function depends on
+  // besides the function and its library, for the function cache.
+  string function_cache_key_prefix;
+  const bool use_function_cache =
+      cfg_.function_optimization_cache() == RewriterConfig::ON;
+  if (use_function_cache) {
+    SerializeToStringDeterministic(cfg_, &function_cache_key_prefix);
+    if (cluster != nullptr) {
+      std::vector<string> device_names = cluster->GetDeviceNames();
+      std::sort(device_names.begin(), device_names.end());
+      absl::StrAppend(&function_cache_key_prefix,
+                      absl::StrJoin(device_names, ","));
+    }
+    absl::StrAppend(&function_cache_key_prefix, ";", producer, ";",
+                    is_tpu_graph);
+  }
+
+  // Added by Alpa. Makes a GrapplerFunctionItem from `func` and optimizes its
+  // body into `optimized_func_graph`. Only reads `flib`, so that functions can
+  // be optimized in parallel.
+  const auto optimize_function =
+      [&](const FunctionDef& func, GrapplerFunctionItem* func_item,
+          GraphDef* optimized_func_graph) -> Status {
+    const string& func_name = func.signature().name();
+
+    // Make a GrapplerItem from a FunctionDef.
+    TF_RETURN_IF_ERROR(
+        MakeGrapplerFunctionItem(func, flib, producer, func_item));
+
+    // If we need to compute the gradient of optimized function at runtime, we
+    // can't perform non-differentiable rewrites.
+    func_item->optimization_options().allow_non_differentiable_rewrites =
+        !differentiable_functions.contains(func_name);
+
+    // Device set available to the function is defined only by the runtime,
+    // when we instantiate and execute the function. We can't use all devices
+    // available to the main graph, because after partitioning the function
+    // call node might execute on a remote worker.
+    if (!func_item->devices().empty()) {
+      return errors::Internal("GrapplerFunctionItem devices must be empty.");
+    }
+
+    // We are not allowed to prune certain types of ops from the graph
+    // instantiated by the function definition, because we must guarantee
+    // function execution semantics wrt side effects (see
+    // function_optimizer.cc).
+    func_item->optimization_options().allow_pruning_stateful_and_dataset_ops =
+        false;
+
+    Fprint128 cache_key = {0, 0};
+    if (use_function_cache) {
+      string key = function_cache_key_prefix;
+      absl::StrAppend(
+          &key, ";",
+          func_item->optimization_options().allow_non_differentiable_rewrites);
+      string serialized;
+      SerializeToStringDeterministic(func, &serialized);
+      absl::StrAppend(&key, ";", serialized);
+      SerializeToStringDeterministic(func_item->graph, &serialized);
+      absl::StrAppend(&key, ";", serialized);
+      cache_key = Fingerprint128(key);
+      if (FunctionOptimizationCache::Global()->Lookup(cache_key,
+                                                      optimized_func_graph)) {
+        VLOG(3) << "Reuse the optimized function " << func_name;
+        return OkStatus();
+      }
+    }
+
+    // Optimize function body graph.
+    if (is_tpu_graph) {
+      // Skip optimizing functions if this is a TPU graph. Currently, Grappler
+      // passes do not handle TPU functions correctly in a variety of ways
+      // (Note that due to the pre-placement TPU graph rewriting passes, the
+      // TPU-related ops are encapsulated away into functions). For example,
+      // TPU graphs contain TPUReplicateMetadata node that carries relevant
+      // TPU metadata and Grappler passes could prune that away. Grappler
+      // passes could also cause issues around shape inference. Since the
+      // desired and existing behavior is to not optimize TPU functions with
+      // Grappler, this check preserves that. The only exception is
+      // implementation selector what is required to swap in some TPU specific
+      // lowering code and is verified the work correctly on TPUs.
+      ImplementationSelector implementation_selector;
+
+      // Implementation selector needs to have access to valid function
+      // signature and attributes, and it doesn't need actual function body.
+      std::unique_ptr<FunctionDefLibrary> func_item_function_library(
+          func_item->graph.release_library());
+      *func_item->graph.mutable_library() =
+          GetFunctionDefLibraryStub(*func_item_function_library);
+
+      TF_RETURN_IF_ERROR(implementation_selector.Optimize(
+          cluster, *func_item, optimized_func_graph));
+    } else {
+      GrapplerFunctionItem func_item_copy = *func_item;
+      TF_RETURN_IF_ERROR(OptimizeGraph(cluster, std::move(func_item_copy),
+                                       optimized_func_graph));
+    }
+    if (use_function_cache) {
+      FunctionOptimizationCache::Global()->Insert(cache_key,
+                                                  *optimized_func_graph);
+    }
+    return OkStatus();
+  };
+
+  // Added by Alpa. Replaces `func_name` in `flib` with the optimized body.
+  const auto update_function = [&](const string& func_name,
+                                   GrapplerFunctionItem* func_item,
+                                   GraphDef* optimized_func_graph) -> Status {
+    // Function body optimization might have created new specialized
+    // functions for each instantiation context. Add them to the library.
+    for (const FunctionDef& func_def :
+         optimized_func_graph->library().function()) {
+      if (flib.Find(func_def.signature().name()) == nullptr) {
+        TF_RETURN_IF_ERROR(flib.AddFunctionDef(func_def));
+      }
+    }
+
+    // Convert optimized graph back to FunctionDef.
+    FunctionDef optimized_func;
+    func_item->SwapFunctionBody(std::move(*optimized_func_graph));
+    TF_RETURN_IF_ERROR(MakeFunctionDef(*func_item, flib, &optimized_func));
+
+    // Replace optimized function with a new FunctionDef.
+    return flib.ReplaceFunction(func_name, optimized_func);
+  };
+
   // Optimize each function only once.
   absl::flat_hash_set<string> optimized_funcs;
   while (optimize_function_library) {
     optimize_function_library = false;
 
+    // Added by Alpa. The functions to optimize in this pass.
+    std::vector<const FunctionDef*> funcs;
     int function_idx = 0;
     for (const FunctionDef& func : optimized_graph->library().function()) {
       GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
@@ -1188,79 +1387,45 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
       // have to reset the flag and do at least one more pass over the library.
       optimize_function_library = true;
       optimized_funcs.insert(func_name);
+      funcs.push_back(&func);
+    }
 
-      // Make a GrapplerItem from a FunctionDef.
-      GrapplerFunctionItem func_item;
-      TF_RETURN_IF_ERROR(
-          MakeGrapplerFunctionItem(func, flib, producer, &func_item));
-
-      // If we need to compute the gradient of optimized function at runtime, we
-      // can't perform non-differentiable rewrites.
-      func_item.optimization_options().allow_non_differentiable_rewrites =
-          !differentiable_functions.contains(func_name);
-
-      // Device set available to the function is defined only by the runtime,
-      // when we instantiate and execute the function. We can't use all devices
-      // available to the main graph, because after partitioning the function
-      // call node might execute on a remote worker.
-      if (!func_item.devices().empty()) {
-        return errors::Internal("GrapplerFunctionItem devices must be empty.");
-      }
-
-      // We are not allowed to prune certain types of ops from the graph
-      // instantiated by the function definition, because we must guarantee
-      // function execution semantics wrt side effects (see
-      // function_optimizer.cc).
-      func_item.optimization_options().allow_pruning_stateful_and_dataset_ops =
-          false;
-
-      // Optimize function body graph.
-      GraphDef optimized_func_graph;
-      if (is_tpu_graph) {
-        // Skip optimizing functions if this is a TPU graph. Currently, Grappler
-        // passes do not handle TPU functions correctly in a variety of ways
-        // (Note that due to the pre-placement TPU graph rewriting passes, the
-        // TPU-related ops are encapsulated away into functions). For example,
-        // TPU graphs contain TPUReplicateMetadata node that carries relevant
-        // TPU metadata and Grappler passes could prune that away. Grappler
-        // passes could also cause issues around shape inference. Since the
-        // desired and existing behavior is to not optimize TPU functions with
-        // Grappler, this check preserves that. The only exception is
-        // implementation selector what is required to swap in some TPU specific
-        // lowering code and is verified the work correctly on TPUs.
-        ImplementationSelector implementation_selector;
-
-        // Implementation selector needs to have access to valid function
-        // signature and attributes, and it doesn't need actual function body.
-        std::unique_ptr<FunctionDefLibrary> func_item_function_library(
-            func_item.graph.release_library());
-        *func_item.graph.mutable_library() =
-            GetFunctionDefLibraryStub(*func_item_function_library);
-
-        TF_RETURN_IF_ERROR(implementation_selector.Optimize(
-            cluster, func_item, &optimized_func_graph));
-      } else {
-        GrapplerFunctionItem func_item_copy = func_item;
-        TF_RETURN_IF_ERROR(OptimizeGraph(cluster, std::move(func_item_copy),
-                                         &optimized_func_graph));
+    const int num_threads =
+        std::min<int>(cfg_.function_optimization_threads(), funcs.size());
+    if (num_threads <= 1) {
+      for (const FunctionDef* func : funcs) {
+        GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
+        GrapplerFunctionItem func_item;
+        GraphDef optimized_func_graph;
+        TF_RETURN_IF_ERROR(
+            optimize_function(*func, &func_item, &optimized_func_graph));
+        TF_RETURN_IF_ERROR(update_function(func->signature().name(),
+                                           &func_item, &optimized_func_graph));
       }
-
-      // Function body optimization might have created new specialized
-      // functions for each instantiation context. Add them to the library.
-      for (const FunctionDef& func_def :
-           optimized_func_graph.library().function()) {
-        if (flib.Find(func_def.signature().name()) == nullptr) {
-          TF_RETURN_IF_ERROR(flib.AddFunctionDef(func_def));
+    } else {
+      // Added by Alpa. Optimize the functions of this pass in parallel against
+      // the library at the start of the pass, and then update the library in
+      // order.
+      std::vector<GrapplerFunctionItem> func_items(funcs.size());
+      std::vector<GraphDef> optimized_func_graphs(funcs.size());
+      std::vector<Status> statuses(funcs.size());
+      {
+        thread::ThreadPool pool(Env::Default(), "optimize_functions",
+                                num_threads);
+        for (int i = 0; i < funcs.size(); ++i) {
+          pool.Schedule([&, i]() {
+            statuses[i] = optimize_function(*funcs[i], &func_items[i],
+                                            &optimized_func_graphs[i]);
+          });
         }
       }
-
-      // Convert optimized graph back to FunctionDef.
-      FunctionDef optimized_func;
-      func_item.SwapFunctionBody(std::move(optimized_func_graph));
-      TF_RETURN_IF_ERROR(MakeFunctionDef(func_item, flib, &optimized_func));
-
-      // Replace optimized function with a new FunctionDef.
-      TF_RETURN_IF_ERROR(flib.ReplaceFunction(func_name, optimized_func));
+      for (int i = 0; i < funcs.size(); ++i) {
+        TF_RETURN_IF_ERROR(statuses[i]);
+        TF_RETURN_IF_ERROR(update_function(funcs[i]->signature().name(),
+                                           &func_items[i],
+                                           &optimized_func_graphs[i]));
+      }
+      GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
     }
 
     // If optimized at least one function, update the graph library.
@@ -18,6 +18,7 @@ limitations under the License.
 #include <atomic>
 
 #include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/framework/dataset.h"
@@ -1412,6 +1413,78 @@ INSTANTIATE_TEST_SUITE_P(
       return test_name;
     });
 
+TEST_F(MetaOptimizerTest, SkipsOptimizerThatDidNotChangeGraph) {
+  TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {kDevice});
+  GrapplerItem item;
+  ASSERT_TRUE(fake_input.NextItem(&item));
+
+  TfDataTestOptimizer::InitCount();
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.add_optimizers("TfDataTestOptimizer");
+  rewriter_config.set_min_graph_nodes(-1);
+  rewriter_config.set_meta_optimizer_iterations(RewriterConfig::TWO);
+
+  MetaOptimizer optimizer(nullptr, config_proto);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  // The optimizer returned its input, so it doesn't run a second time.
+  EXPECT_EQ(TfDataTestOptimizer::GetCount(), 1);
+}
+
+TEST_F(MetaOptimizerTest, OptimizeFunctionLibraryInParallelWithCache) {
+  using test::function::NDef;
+
+  std::vector<FunctionDef> funcs;
+  std::vector<NodeDef> nodes = {
+      NDef("a", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice)};
+  for (int i = 0; i < 4; ++i) {
+    const string name = absl::StrCat("CachedMul", i);
+    funcs.push_back(FunctionDefHelper::Create(
+        name, {"x:float", "y:float"}, {"z:float"}, {},
+        /*node_def=*/
+        {{{"mul"}, "Mul", {"x", "y"}, {{"T", DT_FLOAT}}}},
+        /*ret_def=*/
+        {{"z", "mul:z:0"}}));
+    nodes.push_back(NDef(absl::StrCat("call_", i), name, {"a", "a"}, {},
+                         kDevice));
+  }
+  GrapplerItem item;
+  item.id = "tf_graph";
+  item.graph = test::function::GDef(nodes, funcs);
+
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.add_optimizers("TfDataTestOptimizer");
+  rewriter_config.set_min_graph_nodes(-1);
+  rewriter_config.set_meta_optimizer_iterations(RewriterConfig::ONE);
+  rewriter_config.set_function_optimization_threads(2);
+  rewriter_config.set_function_optimization_cache(RewriterConfig::ON);
+
+  // The main graph and the four functions are optimized.
+  TfDataTestOptimizer::InitCount();
+  GraphDef output;
+  MetaOptimizer optimizer(nullptr, config_proto);
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_EQ(TfDataTestOptimizer::GetCount(), 5);
+  FunctionLibraryDefinition flib(OpRegistry::Global(), output.library());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_NE(flib.Find(absl::StrCat("CachedMul", i)), nullptr);
+  }
+
+  // Another meta optimizer reuses the optimized functions.
+  TfDataTestOptimizer::InitCount();
+  GraphDef cached_output;
+  MetaOptimizer cached_optimizer(nullptr, config_proto);
+  TF_EXPECT_OK(cached_optimizer.Optimize(nullptr, item, &cached_output));
+  EXPECT_EQ(TfDataTestOptimizer::GetCount(), 1);
+  CompareGraphs(output, cached_output);
+  EXPECT_EQ(output.library().DebugString(),
+            cached_output.library().DebugString());
+}
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
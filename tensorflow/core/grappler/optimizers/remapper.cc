@@ -1540,11 +1540,11 @@ bool FindSigmoidAndMul(RemapperContext* ctx, int node_index,
 // pattern is only for the case, when LayerNormalization uses FusedBatcNormV3.
 // We further restrict it to only 2D or 3D tensor inputs to keras
 // LayerNormalization api.
-bool FindMklLayerNorm(RemapperContext* ctx, int node_index,
-                      std::map<string, int>* matched_nodes_map,
-                      std::set<int>* remove_node_indices) {
-  if (!IsMKLEnabled()) return false;
-
+// Added by Alpa: the pattern is shared by FindMklLayerNorm and
+// FindGpuLayerNorm, which add the device specific checks.
+bool FindLayerNorm(RemapperContext* ctx, int node_index,
+                   std::map<string, int>* matched_nodes_map,
+                   std::set<int>* remove_node_indices) {
   // The following pattern will be searched in the graph with additional
   // contraints. Here * means any type of op.
   // clang-format off
@@ -1634,8 +1634,6 @@ bool FindMklLayerNorm(RemapperContext* ctx, int node_index,
         !is_training)
       return false;
 
-    if (!NodeIsOnCpu(fused_batch_norm_node)) return false;
-
     // FusedBatchNorm node should have mean/variance as empty constant
     NodeDef* empty_const_node =
         ctx->graph_view.GetNode(matched_nodes_map->at("empty"))->node();
@@ -1646,18 +1644,40 @@ bool FindMklLayerNorm(RemapperContext* ctx, int node_index,
     } else {
       return false;
     }
+  }
+  return found_op_type_match;
+}
+
+// Added by Alpa. Infers the graph properties if they are not yet.
+bool InferLayerNormProperties(RemapperContext* ctx) {
+  if (!ctx->inferred_graph_properties) {
+    Status s = ctx->graph_properties.InferStatically(
+        /*assume_valid_feeds=*/true,
+        /*aggressive_shape_inference=*/false,
+        /*include_input_tensor_values=*/true,
+        /*include_output_tensor_values=*/false);
+    if (!s.ok()) return false;
+    ctx->inferred_graph_properties = true;
+  }
+  return true;
+}
+
+bool FindMklLayerNorm(RemapperContext* ctx, int node_index,
+                      std::map<string, int>* matched_nodes_map,
+                      std::set<int>* remove_node_indices) {
+  if (!IsMKLEnabled()) return false;
+
+  bool found_op_type_match = FindLayerNorm(ctx, node_index, matched_nodes_map,
+                                           remove_node_indices);
+  if (found_op_type_match) {
+    NodeDef* fused_batch_norm_node =
+        ctx->graph_view.GetNode(matched_nodes_map->at("fused_batch_norm"))
+            ->node();
+    if (!NodeIsOnCpu(fused_batch_norm_node)) return false;
 
     // TODO(intel-tf): Relax the restriction of 2D/3D tensor once kernel
     // supports that.
-    if (!ctx->inferred_graph_properties) {
-      Status s = ctx->graph_properties.InferStatically(
-          /*assume_valid_feeds=*/true,
-          /*aggressive_shape_inference=*/false,
-          /*include_input_tensor_values=*/true,
-          /*include_output_tensor_values=*/false);
-      if (!s.ok()) return false;
-      ctx->inferred_graph_properties = true;
-    }
+    if (!InferLayerNormProperties(ctx)) return false;
     NodeDef* input_node_def =
         ctx->graph_view.GetNode(matched_nodes_map->at("input"))->node();
     auto input_props =
@@ -1677,6 +1697,60 @@ bool FindMklLayerNorm(RemapperContext* ctx, int node_index,
   return found_op_type_match;
 }
 
+// Added by Alpa. Matches the layer norm pattern of FindMklLayerNorm on GPU,
+// for _FusedLayerNorm. The normalized axes must be the last dimension only,
+// i.e. gamma and beta are vectors of its size.
+bool FindGpuLayerNorm(RemapperContext* ctx, int node_index,
+                      std::map<string, int>* matched_nodes_map,
+                      std::set<int>* remove_node_indices) {
+  if (!FindLayerNorm(ctx, node_index, matched_nodes_map,
+                     remove_node_indices)) {
+    return false;
+  }
+  NodeDef* fused_batch_norm_node =
+      ctx->graph_view.GetNode(matched_nodes_map->at("fused_batch_norm"))
+          ->node();
+  NodeDef* output_node_def =
+      ctx->graph_view.GetNode(matched_nodes_map->at("output"))->node();
+  if (!NodeIsOnGpu(output_node_def)) return false;
+  const DataType dtype = GetDataTypeFromAttr(*output_node_def, "T");
+  if (dtype != DT_FLOAT && dtype != DT_HALF) return false;
+  string data_format;
+  if (!TryGetNodeAttr(*fused_batch_norm_node, kDataFormat, &data_format) ||
+      data_format != "NCHW") {
+    return false;
+  }
+
+  if (!InferLayerNormProperties(ctx)) return false;
+  NodeDef* input_node_def =
+      ctx->graph_view.GetNode(matched_nodes_map->at("input"))->node();
+  auto input_props =
+      ctx->graph_properties.GetOutputProperties(input_node_def->name());
+  auto output_props =
+      ctx->graph_properties.GetOutputProperties(output_node_def->name());
+  if (input_props.empty() || output_props.empty() ||
+      !ShapesSymbolicallyEqual(input_props[0].shape(),
+                               output_props[0].shape())) {
+    return false;
+  }
+  const TensorShapeProto& input_shape = input_props[0].shape();
+  if (input_shape.unknown_rank() || input_shape.dim_size() < 2) return false;
+  const int64_t depth = input_shape.dim(input_shape.dim_size() - 1).size();
+  if (depth <= 0) return false;
+  for (const char* param : {"gamma", "beta"}) {
+    const NodeDef* param_node =
+        ctx->graph_view.GetNode(matched_nodes_map->at(param))->node();
+    auto param_props =
+        ctx->graph_properties.GetOutputProperties(param_node->name());
+    if (param_props.empty() || param_props[0].shape().unknown_rank() ||
+        param_props[0].shape().dim_size() != 1 ||
+        param_props[0].shape().dim(0).size() != depth) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool FindFusedBatchNorm(const RemapperContext& ctx, int node_index,
                         FusedBatchNorm* matched) {
   const auto* node_view = ctx.graph_view.GetNode(node_index);
@@ -2733,11 +2807,13 @@ Status AddFusedMatMulBiasAddAndGelu(
   return OkStatus();
 }
 
-Status AddMklLayerNorm(RemapperContext* ctx,
-                       const std::map<string, int>& matched_nodes_map,
-                       const std::set<int>& remove_node_indices,
-                       std::vector<bool>* invalidated_nodes,
-                       std::vector<bool>* nodes_to_delete) {
+// Added by Alpa: `fused_op` is _MklLayerNorm or _FusedLayerNorm.
+Status AddLayerNorm(RemapperContext* ctx,
+                    const std::map<string, int>& matched_nodes_map,
+                    const std::set<int>& remove_node_indices,
+                    const string& fused_op,
+                    std::vector<bool>* invalidated_nodes,
+                    std::vector<bool>* nodes_to_delete) {
   auto* pre_reshape_node =
       ctx->graph_view.GetNode(matched_nodes_map.at("pre_reshape"))->node();
   auto* scale_node =
@@ -2747,7 +2823,7 @@ Status AddMklLayerNorm(RemapperContext* ctx,
 
   NodeDef fused_node;
   fused_node.set_name(output_node->name());
-  fused_node.set_op("_MklLayerNorm");
+  fused_node.set_op(fused_op);
   fused_node.set_device(output_node->device());
   fused_node.add_input(pre_reshape_node->input(0));
   fused_node.add_input(scale_node->name());
@@ -2755,6 +2831,13 @@ Status AddMklLayerNorm(RemapperContext* ctx,
   auto* attr = fused_node.mutable_attr();
   auto& src_attr = output_node->attr();
   (*attr)["T"] = src_attr.at("T");
+  // Added by Alpa
+  auto* fused_batch_norm_node =
+      ctx->graph_view.GetNode(matched_nodes_map.at("fused_batch_norm"))
+          ->node();
+  if (fused_batch_norm_node->attr().count("epsilon")) {
+    (*attr)["epsilon"] = fused_batch_norm_node->attr().at("epsilon");
+  }
 
   utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
   Status status;
@@ -3710,9 +3793,9 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
       matched_nodes_map.clear();
       remove_node_indices.clear();
       if (FindMklLayerNorm(&ctx, i, &matched_nodes_map, &remove_node_indices)) {
-        TF_RETURN_IF_ERROR(
-            AddMklLayerNorm(&ctx, matched_nodes_map, remove_node_indices,
-                            &invalidated_nodes, &nodes_to_delete));
+        TF_RETURN_IF_ERROR(AddLayerNorm(
+            &ctx, matched_nodes_map, remove_node_indices, "_MklLayerNorm",
+            &invalidated_nodes, &nodes_to_delete));
         continue;
       }
     }
@@ -3729,6 +3812,18 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
       continue;
     }
 
+    // Added by Alpa. Remap smaller ops from layernorm python api into
+    // _FusedLayerNorm on GPU.
+    matched_nodes_map.clear();
+    remove_node_indices.clear();
+    if (allow_non_differentiable_rewrites &&
+        FindGpuLayerNorm(&ctx, i, &matched_nodes_map, &remove_node_indices)) {
+      TF_RETURN_IF_ERROR(AddLayerNorm(
+          &ctx, matched_nodes_map, remove_node_indices, "_FusedLayerNorm",
+          &invalidated_nodes, &nodes_to_delete));
+      continue;
+    }
+
     // Remap {Conv2D,DepthwiseConv2D,MatMul}+BiasAdd into the
     // _Fused{Conv2D,DepthwiseConv2dNative,MatMul}
     ContractionWithBiasAdd contract_with_bias;
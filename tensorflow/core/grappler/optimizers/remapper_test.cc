@@ -2506,5 +2506,78 @@ class RemapperLeakyReluTest : public GrapplerTest {
 TEST_F(RemapperLeakyReluTest, F32) { RunTest<DT_FLOAT>(); }
 TEST_F(RemapperLeakyReluTest, BF16) { RunTest<DT_BFLOAT16>(); }
 
+// Added by Alpa
+TEST_F(RemapperTest, FuseLayerNormOnGPU) {
+  using ::tensorflow::ops::Placeholder;
+  const int rows = 4;
+  const int depth = 8;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  auto input = Placeholder(s.WithOpName("input"), DT_FLOAT,
+                           ops::Placeholder::Shape({rows, depth}));
+  auto gamma = Placeholder(s.WithOpName("gamma"), DT_FLOAT,
+                           ops::Placeholder::Shape({depth}));
+  auto beta = Placeholder(s.WithOpName("beta"), DT_FLOAT,
+                          ops::Placeholder::Shape({depth}));
+
+  // The graph of the Keras LayerNormalization layer on the last axis.
+  tensorflow::Scope gpu = s.WithDevice("/device:GPU:0");
+  auto pre_shape = ops::Const(s.WithOpName("pre_shape"), {1, rows, depth, 1});
+  auto pre_reshape =
+      ops::Reshape(gpu.WithOpName("pre_reshape"), input, pre_shape);
+  auto fill_dims = ops::Const(s.WithOpName("fill_dims"), {rows});
+  auto unit_gamma = ops::Const(s.WithOpName("unit_gamma"), 1.0f);
+  auto zero_beta = ops::Const(s.WithOpName("zero_beta"), 0.0f);
+  auto fill_scale =
+      ops::Fill(gpu.WithOpName("fill_scale"), fill_dims, unit_gamma);
+  auto fill_offset =
+      ops::Fill(gpu.WithOpName("fill_offset"), fill_dims, zero_beta);
+  auto empty = ops::Const(s.WithOpName("empty"),
+                          Input::Initializer(Tensor(DT_FLOAT, {0})));
+  auto fbn = ops::FusedBatchNormV3(
+      gpu.WithOpName("fused_batch_norm"), pre_reshape, fill_scale,
+      fill_offset, empty, empty,
+      ops::FusedBatchNormV3::Attrs().IsTraining(true).DataFormat("NCHW"));
+  auto post_shape = ops::Const(s.WithOpName("post_shape"), {rows, depth});
+  auto post_reshape =
+      ops::Reshape(gpu.WithOpName("post_reshape"), fbn.y, post_shape);
+  auto scale = ops::Mul(gpu.WithOpName("scale"), post_reshape, gamma);
+  auto output = ops::AddV2(gpu.WithOpName("output"), scale, beta);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), output);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output_graph;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output_graph));
+
+  int found = 0;
+  for (const NodeDef& node : output_graph.node()) {
+    if (node.name() == "output") {
+      EXPECT_EQ(node.op(), "_FusedLayerNorm");
+      ASSERT_EQ(node.input_size(), 3);
+      EXPECT_EQ(node.input(0), "input");
+      EXPECT_EQ(node.input(1), "gamma");
+      EXPECT_EQ(node.input(2), "beta");
+      found++;
+    }
+  }
+  EXPECT_EQ(found, 1);
+
+  if (GetNumAvailableGPUs() > 0) {
+    auto input_t = GenerateRandomTensor<DT_FLOAT>({rows, depth});
+    auto gamma_t = GenerateRandomTensor<DT_FLOAT>({depth});
+    auto beta_t = GenerateRandomTensor<DT_FLOAT>({depth});
+    item.feed = {{"input", input_t}, {"gamma", gamma_t}, {"beta", beta_t}};
+    auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+    ASSERT_EQ(tensors_expected.size(), 1);
+    auto tensors = EvaluateNodes(output_graph, item.fetch, item.feed);
+    ASSERT_EQ(tensors.size(), 1);
+    test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-4);
+  }
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
@@ -48,6 +48,8 @@ constexpr char kMinInflightBatchesAttr[] = "_min_inflight_batches";
 constexpr char kInitialInflightBatchesAttr[] = "_initial_inflight_batches";
 constexpr char kMaxInflightBatchesAttr[] = "_max_inflight_batches";
 constexpr char kBatchesToAverageOverAttr[] = "_batches_to_average_over";
+// Added by Alpa.
+constexpr char kLatencySloMicrosAttr[] = "_latency_slo_micros";
 
 // Default thread count in the per-process batching thread pool.
 constexpr int64_t kBatchThreadPoolSize = 128;
@@ -138,6 +140,7 @@ class BatchResource : public serving::BatchResourceBase {
                        FunctionLibraryRuntime::Handle fhandle,
                        FunctionLibraryRuntime* flib,
                        bool enable_large_batch_splitting,
+                       const std::vector<int32>& sequence_length_buckets,
                        std::unique_ptr<BatchResource>* resource) {
     BatcherT::Options batcher_options;
     batcher_options.num_batch_threads = num_batch_threads;
@@ -150,7 +153,7 @@ class BatchResource : public serving::BatchResourceBase {
                                batch_timeout_micros, max_enqueued_batches,
                                allowed_batch_sizes,
                                enable_large_batch_splitting),
-        allowed_batch_sizes));
+        allowed_batch_sizes, sequence_length_buckets));
     return OkStatus();
   }
 
@@ -160,6 +163,7 @@ class BatchResource : public serving::BatchResourceBase {
       int32_t max_enqueued_batches,
       const std::vector<int32>& allowed_batch_sizes,
       FunctionLibraryRuntime::Handle fhandle, FunctionLibraryRuntime* flib,
+      const std::vector<int32>& sequence_length_buckets,
       std::unique_ptr<BatchResource>* resource) {
     std::shared_ptr<AdaptiveBatcherT> batcher;
     TF_RETURN_IF_ERROR(AdaptiveBatcherT::Create(
@@ -170,7 +174,7 @@ class BatchResource : public serving::BatchResourceBase {
         GetAdaptiveBatcherQueueOptions(
             max_batch_size, batch_timeout_micros, max_enqueued_batches,
             true /* enable large batch split */, allowed_batch_sizes),
-        allowed_batch_sizes));
+        allowed_batch_sizes, sequence_length_buckets));
     return OkStatus();
   }
 
@@ -180,11 +184,13 @@ class BatchResource : public serving::BatchResourceBase {
   BatchResource(FunctionLibraryRuntime::Handle fhandle,
                 FunctionLibraryRuntime* flib, std::shared_ptr<BatcherT> batcher,
                 const BatcherT::QueueOptions& batcher_queue_options,
-                std::vector<int32> allowed_batch_sizes)
+                std::vector<int32> allowed_batch_sizes,
+                std::vector<int32> sequence_length_buckets)
       : BatchResourceBase(
             /*has_process_batch_function=*/fhandle != kInvalidHandle,
             std::move(batcher), batcher_queue_options,
-            std::move(allowed_batch_sizes)),
+            std::move(allowed_batch_sizes),
+            std::move(sequence_length_buckets)),
         fhandle_(fhandle),
         flib_(flib) {}
 
@@ -192,11 +198,13 @@ class BatchResource : public serving::BatchResourceBase {
                 FunctionLibraryRuntime* flib,
                 std::shared_ptr<AdaptiveBatcherT> batcher,
                 const AdaptiveBatcherT::QueueOptions& batcher_queue_options,
-                std::vector<int32> allowed_batch_sizes)
+                std::vector<int32> allowed_batch_sizes,
+                std::vector<int32> sequence_length_buckets)
       : BatchResourceBase(
             /*has_process_batch_function=*/fhandle != kInvalidHandle,
             std::move(batcher), batcher_queue_options,
-            std::move(allowed_batch_sizes)),
+            std::move(allowed_batch_sizes),
+            std::move(sequence_length_buckets)),
         fhandle_(fhandle),
         flib_(flib) {}
 
@@ -246,6 +254,11 @@ BatchFunctionKernel::BatchFunctionKernel(OpKernelConstruction* c)
   OP_REQUIRES_OK(c, c->GetAttr("allowed_batch_sizes", &allowed_batch_sizes_));
 
   OP_REQUIRES_OK(c, c->GetAttr("f", &func_));
+  // Added by Alpa.
+  if (c->HasAttr("sequence_length_buckets")) {
+    OP_REQUIRES_OK(
+        c, c->GetAttr("sequence_length_buckets", &sequence_length_buckets_));
+  }
   flib_ = c->function_library();
 
   if (c->HasAttr("enable_large_batch_splitting")) {
@@ -281,6 +294,7 @@ BatchFunctionKernel::BatchFunctionKernel(OpKernelConstruction* c)
   }
 
   OP_REQUIRES_OK(c, ValidateAllowedBatchSizes());
+  OP_REQUIRES_OK(c, ValidateSequenceLengthBuckets());
 }
 
 bool BatchFunctionKernel::IsExpensive() { return false; }
@@ -328,11 +342,14 @@ void BatchFunctionKernel::ComputeAsync(OpKernelContext* c, DoneCallback done) {
       adaptive_shared_batch_scheduler_options.batches_to_average_over =
           adaptive_batch_scheduler_options_->batches_to_average_over;
       adaptive_shared_batch_scheduler_options.fifo_scheduling = true;
+      // Added by Alpa.
+      adaptive_shared_batch_scheduler_options.latency_slo_micros =
+          adaptive_batch_scheduler_options_->latency_slo_micros;
       std::unique_ptr<BatchResource> new_resource;
       TF_RETURN_IF_ERROR(BatchResource::Create(
           adaptive_shared_batch_scheduler_options, max_batch_size_,
           batch_timeout_micros_, max_enqueued_batches_, allowed_batch_sizes_,
-          handle, flib_, &new_resource));
+          handle, flib_, sequence_length_buckets_, &new_resource));
       *r = new_resource.release();
       return OkStatus();
     };
@@ -342,7 +359,8 @@ void BatchFunctionKernel::ComputeAsync(OpKernelContext* c, DoneCallback done) {
       TF_RETURN_IF_ERROR(BatchResource::Create(
           num_batch_threads_, max_batch_size_, batch_timeout_micros_,
           max_enqueued_batches_, allowed_batch_sizes_, handle, flib_,
-          enable_large_batch_splitting_, &new_resource));
+          enable_large_batch_splitting_, sequence_length_buckets_,
+          &new_resource));
       *r = new_resource.release();
       return OkStatus();
     };
@@ -460,6 +478,21 @@ Status BatchFunctionKernel::ValidateAllowedBatchSizes() const {
   return OkStatus();
 }
 
+// Added by Alpa. Validates 'sequence_length_buckets_'. The entries must be
+// positive and increase monotonically.
+Status BatchFunctionKernel::ValidateSequenceLengthBuckets() const {
+  for (size_t i = 0; i < sequence_length_buckets_.size(); ++i) {
+    if (sequence_length_buckets_[i] <= 0 ||
+        (i > 0 &&
+         sequence_length_buckets_[i] <= sequence_length_buckets_[i - 1])) {
+      return errors::InvalidArgument(
+          "sequence_length_buckets entries must be positive and "
+          "monotonically increasing");
+    }
+  }
+  return OkStatus();
+}
+
 // Initialize vars by reading from op-kernel-construction.
 // Vars
 // - enable_adaptive_batch_threads_
@@ -506,6 +539,12 @@ void BatchFunctionKernel::SetAdaptiveBatchSchedulerOptions(
                                  &options.max_in_flight_batches_limit));
   }
 
+  // Added by Alpa.
+  if (c->HasAttr(kLatencySloMicrosAttr)) {
+    OP_REQUIRES_OK(
+        c, c->GetAttr(kLatencySloMicrosAttr, &options.latency_slo_micros));
+  }
+
   // At this point, the batch kernel is configured to use adaptive scheduling.
   // To validate or return error at kernel construction time, invokes
   // `GetOrCreateBatchThreadsPool` and validates returned `thread_pool` is
@@ -564,7 +603,8 @@ class BatchKernel : public AsyncOpKernel {
       TF_RETURN_IF_ERROR(BatchResource::Create(
           num_batch_threads_, max_batch_size_, batch_timeout_micros_,
           max_enqueued_batches_, allowed_batch_sizes_, kInvalidHandle,
-          /*flib=*/nullptr, false, &new_resource));
+          /*flib=*/nullptr, false, /*sequence_length_buckets=*/{},
+          &new_resource));
       *r = new_resource.release();
       return OkStatus();
     };
@@ -21,10 +21,12 @@ limitations under the License.
 #include <functional>
 #include <memory>
 #include <random>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "absl/types/optional.h"
+#include "tensorflow/core/kernels/batching_util/batch_latency_model.h"
 #include "tensorflow/core/kernels/batching_util/batch_scheduler.h"
 #include "tensorflow/core/kernels/batching_util/periodic_function.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -47,6 +49,8 @@ class ASBSBatch;
 
 template <typename TaskType>
 class ASBSQueue;
+
+struct ASBSLatencySloState;
 }  // namespace internal
 
 // Shared batch scheduler designed to minimize latency. The scheduler keeps
@@ -74,6 +78,13 @@ class ASBSQueue;
 // CPU utilization - If the batch processing is cpu dominated, you can reap
 //   latency gains when underutilized by increasing the processing rate, but
 //   back the rate off when the load increases to avoid overload.
+//
+// Added by Alpa. With a latency SLO (Options::latency_slo_micros), ASBS also
+// picks the batch size and the timeout of each queue, which are otherwise
+// static. It models the processing latency of each padded batch size from the
+// processed batches, and periodically chooses the parameters maximizing
+// throughput under the SLO at the current arrival rate of the queue (see
+// batch_latency_model.h). The decisions are exported as metrics.
 
 template <typename TaskType>
 class AdaptiveSharedBatchScheduler
@@ -132,6 +143,16 @@ class AdaptiveSharedBatchScheduler
     // full_batch_scheduling_boost_micros==zero) for backward compatibility of
     // API.
     bool fifo_scheduling = false;
+
+    // Added by Alpa. If positive, the p99 latency of the requests, from their
+    // scheduling to the end of the processing of their batch, that the
+    // scheduler targets by picking the batch size and batch timeout of each
+    // queue, instead of using QueueOptions::max_batch_size and
+    // QueueOptions::batch_timeout_micros as is.
+    int64_t latency_slo_micros = 0;
+    // Added by Alpa. Minimum interval between two adjustments of the batching
+    // parameters of the queues under a latency SLO.
+    int64_t latency_slo_adjustment_interval_micros = 1000000;
   };
 
   // Ownership is shared between the caller of Create() and any queues created
@@ -168,6 +189,13 @@ class AdaptiveSharedBatchScheduler
                          int max_batch_size,
                          std::vector<std::unique_ptr<TaskType>>* output_tasks)>
         split_input_task_func;
+    // Added by Alpa. Sizes the batches of the queue are padded to, in
+    // increasing order and at most max_batch_size. Under a latency SLO, the
+    // batch size of the queue is picked among them, or is max_batch_size if
+    // there are none.
+    std::vector<int32> allowed_batch_sizes;
+    // Added by Alpa. Name of the queue in the latency SLO metrics.
+    std::string name;
   };
 
   using BatchProcessor = std::function<void(std::unique_ptr<Batch<TaskType>>)>;
@@ -211,6 +239,10 @@ class AdaptiveSharedBatchScheduler
 
   void MaybeAdjustInflightLimit() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
+  // Added by Alpa. Occasionally picks the batching parameters of the queues
+  // from their latency models, under a latency SLO.
+  void MaybeAdjustBatchingDecisions() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   // Notifies scheduler of non-empty batch which is eligible for processing.
   void AddBatch(const internal::ASBSBatch<TaskType>* batch);
 
@@ -234,6 +266,14 @@ class AdaptiveSharedBatchScheduler
   std::unordered_map<const internal::ASBSQueue<TaskType>*, BatchProcessor>
       queues_and_callbacks_ TF_GUARDED_BY(mu_);
 
+  // Added by Alpa. Latency SLO states of the queues added by AddQueue, if
+  // options_.latency_slo_micros is positive.
+  std::unordered_map<internal::ASBSQueue<TaskType>*,
+                     std::shared_ptr<internal::ASBSLatencySloState>>
+      latency_slo_states_ TF_GUARDED_BY(mu_);
+  // Added by Alpa. Time of the last MaybeAdjustBatchingDecisions adjustment.
+  int64_t last_batching_decisions_micros_ TF_GUARDED_BY(mu_);
+
   mutex mu_;
 
   // Responsible for running the batch processing callbacks.
@@ -288,6 +328,20 @@ class AdaptiveSharedBatchScheduler
 // Implementation details follow. API users need not read.
 
 namespace internal {
+// Added by Alpa. Latency SLO state of a queue, shared with its batches, which
+// may outlive it.
+struct ASBSLatencySloState {
+  explicit ASBSLatencySloState(std::vector<int> batch_sizes)
+      : model(std::move(batch_sizes)) {}
+
+  // Number of elements scheduled on the queue.
+  std::atomic<int64_t> num_scheduled_elements{0};
+  // The fields below are guarded by the mutex of the scheduler.
+  BatchLatencyModel model;
+  // Value of num_scheduled_elements at the last batching decision.
+  int64_t last_num_scheduled_elements = 0;
+};
+
 // Consolidates tasks into batches, passing them off to the
 // AdaptiveSharedBatchScheduler for processing.
 template <typename TaskType>
@@ -297,7 +351,8 @@ class ASBSQueue : public BatchScheduler<TaskType> {
       typename AdaptiveSharedBatchScheduler<TaskType>::QueueOptions;
 
   ASBSQueue(std::shared_ptr<AdaptiveSharedBatchScheduler<TaskType>> scheduler,
-            const QueueOptions& options);
+            const QueueOptions& options,
+            std::shared_ptr<ASBSLatencySloState> latency_slo_state = nullptr);
 
   ~ASBSQueue() override;
 
@@ -318,6 +373,13 @@ class ASBSQueue : public BatchScheduler<TaskType> {
 
   size_t max_task_size() const override { return options_.max_batch_size; }
 
+  // Added by Alpa. Applies the batching parameters chosen under a latency SLO
+  // to the batches created from now on.
+  void SetBatchingDecision(const BatchingDecision& decision);
+
+  // Added by Alpa.
+  const std::string& name() const { return options_.name; }
+
  private:
   // Number of size 1 tasks which could currently be scheduled without failing.
   size_t SchedulingCapacityLocked() const TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
@@ -328,6 +390,12 @@ class ASBSQueue : public BatchScheduler<TaskType> {
 
   std::shared_ptr<AdaptiveSharedBatchScheduler<TaskType>> scheduler_;
   const QueueOptions options_;
+  // Added by Alpa. Null unless the scheduler has a latency SLO.
+  const std::shared_ptr<ASBSLatencySloState> latency_slo_state_;
+  // Added by Alpa. Current batch size and batch timeout, which differ from
+  // options_ under a latency SLO.
+  int max_batch_size_ TF_GUARDED_BY(mu_);
+  int64_t batch_timeout_micros_ TF_GUARDED_BY(mu_);
   // Owned by scheduler_.
   ASBSBatch<TaskType>* current_batch_ TF_GUARDED_BY(mu_) = nullptr;
   int64_t num_enqueued_batches_ TF_GUARDED_BY(mu_) = 0;
@@ -341,11 +409,13 @@ template <typename TaskType>
 class ASBSBatch : public Batch<TaskType> {
  public:
   ASBSBatch(ASBSQueue<TaskType>* queue, int64_t creation_time_micros,
-            int64_t batch_timeout_micros, uint64 traceme_context_id)
+            int64_t batch_timeout_micros, uint64 traceme_context_id,
+            std::shared_ptr<ASBSLatencySloState> latency_slo_state = nullptr)
       : queue_(queue),
         creation_time_micros_(creation_time_micros),
         schedulable_time_micros_(creation_time_micros + batch_timeout_micros),
-        traceme_context_id_(traceme_context_id) {}
+        traceme_context_id_(traceme_context_id),
+        latency_slo_state_(std::move(latency_slo_state)) {}
 
   ~ASBSBatch() override {}
 
@@ -357,11 +427,17 @@ class ASBSBatch : public Batch<TaskType> {
 
   uint64 traceme_context_id() const { return traceme_context_id_; }
 
+  // Added by Alpa. Latency SLO state of the queue, or null.
+  const std::shared_ptr<ASBSLatencySloState>& latency_slo_state() const {
+    return latency_slo_state_;
+  }
+
  private:
   ASBSQueue<TaskType>* queue_;
   const int64_t creation_time_micros_;
   const int64_t schedulable_time_micros_;
   const uint64 traceme_context_id_;
+  const std::shared_ptr<ASBSLatencySloState> latency_slo_state_;
   TF_DISALLOW_COPY_AND_ASSIGN(ASBSBatch);
 };
 }  // namespace internal
@@ -417,6 +493,15 @@ Status AdaptiveSharedBatchScheduler<TaskType>::Create(
         "greater than or equal to 1; was ",
         options.batches_to_average_over);
   }
+  if (options.latency_slo_micros < 0) {
+    return errors::InvalidArgument("latency_slo_micros can't be negative; was ",
+                                   options.latency_slo_micros);
+  }
+  if (options.latency_slo_adjustment_interval_micros <= 0) {
+    return errors::InvalidArgument(
+        "latency_slo_adjustment_interval_micros must be positive; was ",
+        options.latency_slo_adjustment_interval_micros);
+  }
   scheduler->reset(new AdaptiveSharedBatchScheduler<TaskType>(options));
   return OkStatus();
 }
@@ -425,6 +510,7 @@ template <typename TaskType>
 AdaptiveSharedBatchScheduler<TaskType>::AdaptiveSharedBatchScheduler(
     const Options& options)
     : options_(options),
+      last_batching_decisions_micros_(options.env->NowMicros()),
       in_flight_batches_limit_(options.initial_in_flight_batches_limit),
       rand_double_(0.0, 1.0) {
   std::random_device device;
@@ -461,11 +547,31 @@ Status AdaptiveSharedBatchScheduler<TaskType>::AddQueue(
           options.max_batch_size);
     }
   }
+  std::shared_ptr<internal::ASBSLatencySloState> latency_slo_state;
+  if (options_.latency_slo_micros > 0) {
+    std::vector<int> batch_sizes(options.allowed_batch_sizes.begin(),
+                                 options.allowed_batch_sizes.end());
+    if (batch_sizes.empty()) batch_sizes.push_back(options.max_batch_size);
+    for (int i = 0; i < batch_sizes.size(); ++i) {
+      if (batch_sizes[i] <= 0 || batch_sizes[i] > options.max_batch_size ||
+          (i > 0 && batch_sizes[i] <= batch_sizes[i - 1])) {
+        return errors::InvalidArgument(
+            "allowed_batch_sizes must be positive, increasing and at most "
+            "max_batch_size (",
+            options.max_batch_size, "); entry ", i, " was ", batch_sizes[i]);
+      }
+    }
+    latency_slo_state = std::make_shared<internal::ASBSLatencySloState>(
+        std::move(batch_sizes));
+  }
   internal::ASBSQueue<TaskType>* asbs_queue_raw;
   queue->reset(asbs_queue_raw = new internal::ASBSQueue<TaskType>(
-                   this->shared_from_this(), options));
+                   this->shared_from_this(), options, latency_slo_state));
   mutex_lock l(mu_);
   queues_and_callbacks_[asbs_queue_raw] = process_batch_callback;
+  if (latency_slo_state != nullptr) {
+    latency_slo_states_[asbs_queue_raw] = std::move(latency_slo_state);
+  }
   return OkStatus();
 }
 
@@ -501,6 +607,7 @@ void AdaptiveSharedBatchScheduler<TaskType>::RemoveQueue(
     const internal::ASBSQueue<TaskType>* queue) {
   mutex_lock l(mu_);
   queues_and_callbacks_.erase(queue);
+  latency_slo_states_.erase(const_cast<internal::ASBSQueue<TaskType>*>(queue));
 }
 
 template <typename TaskType>
@@ -636,10 +743,20 @@ void AdaptiveSharedBatchScheduler<TaskType>::CallbackWrapper(
       profiler::ContextType::kAdaptiveSharedBatchScheduler,
       batch->traceme_context_id());
   const int64_t start_time = batch->creation_time_micros();
+  // The batch is deleted by the callback.
+  const std::shared_ptr<internal::ASBSLatencySloState> latency_slo_state =
+      batch->latency_slo_state();
+  const int batch_size = batch->size();
+  const int64_t processing_start_time = GetEnv()->NowMicros();
   callback(std::unique_ptr<Batch<TaskType>>(
       const_cast<internal::ASBSBatch<TaskType>*>(batch)));
   int64_t end_time = GetEnv()->NowMicros();
   mutex_lock l(mu_);
+  if (latency_slo_state != nullptr) {
+    latency_slo_state->model.Record(batch_size,
+                                    end_time - processing_start_time);
+    MaybeAdjustBatchingDecisions();
+  }
   if (is_express) {
     in_flight_express_batches_--;
     MaybeScheduleClosedBatchesLocked();
@@ -697,14 +814,44 @@ void AdaptiveSharedBatchScheduler<TaskType>::MaybeAdjustInflightLimit() {
   }
 }
 
+template <typename TaskType>
+void AdaptiveSharedBatchScheduler<TaskType>::MaybeAdjustBatchingDecisions() {
+  const int64_t now_micros = GetEnv()->NowMicros();
+  const int64_t elapsed_micros = now_micros - last_batching_decisions_micros_;
+  if (elapsed_micros < options_.latency_slo_adjustment_interval_micros) {
+    return;
+  }
+  last_batching_decisions_micros_ = now_micros;
+  for (auto& queue_and_state : latency_slo_states_) {
+    internal::ASBSLatencySloState* state = queue_and_state.second.get();
+    const int64_t num_scheduled_elements =
+        state->num_scheduled_elements.load(std::memory_order_relaxed);
+    const double elements_per_micro =
+        static_cast<double>(num_scheduled_elements -
+                            state->last_num_scheduled_elements) /
+        elapsed_micros;
+    state->last_num_scheduled_elements = num_scheduled_elements;
+    if (state->model.empty()) continue;
+    const BatchingDecision decision = ChooseBatchingDecision(
+        state->model, elements_per_micro, options_.latency_slo_micros);
+    queue_and_state.first->SetBatchingDecision(decision);
+    RecordBatchingDecision(queue_and_state.first->name(), decision);
+  }
+}
+
 // ---------------- ASBSQueue ----------------
 
 namespace internal {
 template <typename TaskType>
 ASBSQueue<TaskType>::ASBSQueue(
     std::shared_ptr<AdaptiveSharedBatchScheduler<TaskType>> scheduler,
-    const QueueOptions& options)
-    : scheduler_(scheduler), options_(options) {}
+    const QueueOptions& options,
+    std::shared_ptr<ASBSLatencySloState> latency_slo_state)
+    : scheduler_(scheduler),
+      options_(options),
+      latency_slo_state_(std::move(latency_slo_state)),
+      max_batch_size_(options.max_batch_size),
+      batch_timeout_micros_(options.batch_timeout_micros) {}
 
 template <typename TaskType>
 ASBSQueue<TaskType>::~ASBSQueue() {
@@ -743,14 +890,20 @@ Status ASBSQueue<TaskType>::Schedule(std::unique_ptr<TaskType>* task) {
   bool closed_batch = false;
   {
     mutex_lock l(mu_);
+    // The batch size may have been decreased since current_batch_ was filled.
+    if (current_batch_ && current_batch_->size() >= max_batch_size_) {
+      current_batch_->Close();
+      closed_batch = true;
+      current_batch_ = nullptr;
+    }
     if (size > SchedulingCapacityLocked()) {
       return errors::Unavailable("The batch scheduling queue is full");
     }
 
     int remaining_batch_size =
         current_batch_ == nullptr
-            ? options_.max_batch_size
-            : options_.max_batch_size - current_batch_->size();
+            ? max_batch_size_
+            : max_batch_size_ - current_batch_->size();
     if (options_.split_input_task_func == nullptr ||
         size <= remaining_batch_size) {
       // Either we don't allow task splitting or task fits within the current
@@ -761,13 +914,12 @@ Status ASBSQueue<TaskType>::Schedule(std::unique_ptr<TaskType>* task) {
       // Beyond this point Schedule should not fail, as the caller has been
       // promised that all of the split tasks will be scheduled.
       TF_RETURN_IF_ERROR(options_.split_input_task_func(
-          task, remaining_batch_size, options_.max_batch_size,
-          &tasks_to_schedule));
+          task, remaining_batch_size, max_batch_size_, &tasks_to_schedule));
     }
     for (auto& task : tasks_to_schedule) {
       // Can't fit within current batch, close it off and try to create another.
       if (current_batch_ &&
-          current_batch_->size() + task->size() > options_.max_batch_size) {
+          current_batch_->size() + task->size() > max_batch_size_) {
         current_batch_->Close();
         closed_batch = true;
         current_batch_ = nullptr;
@@ -779,8 +931,8 @@ Status ASBSQueue<TaskType>::Schedule(std::unique_ptr<TaskType>* task) {
         // When multiple calls to "ASBS::Schedule" accumulate to one batch, they
         // are processed in the same batch and should share traceme_context_id.
         current_batch_ = new ASBSBatch<TaskType>(
-            this, scheduler_->GetEnv()->NowMicros(),
-            options_.batch_timeout_micros, NewTraceMeContextIdForBatch());
+            this, scheduler_->GetEnv()->NowMicros(), batch_timeout_micros_,
+            NewTraceMeContextIdForBatch(), latency_slo_state_);
         new_batches.push_back(current_batch_);
       }
 
@@ -800,14 +952,17 @@ Status ASBSQueue<TaskType>::Schedule(std::unique_ptr<TaskType>* task) {
       bool reached_max_tasks =
           (options_.max_tasks_per_batch.has_value() &&
            current_batch_->num_tasks() >= options_.max_tasks_per_batch.value());
-      if (current_batch_->size() == options_.max_batch_size ||
-          reached_max_tasks) {
+      if (current_batch_->size() >= max_batch_size_ || reached_max_tasks) {
         current_batch_->Close();
         closed_batch = true;
         current_batch_ = nullptr;
       }
     }
   }
+  if (latency_slo_state_ != nullptr) {
+    latency_slo_state_->num_scheduled_elements.fetch_add(
+        size, std::memory_order_relaxed);
+  }
   // Scheduler functions must be called outside of lock, since they may call
   // ReleaseBatch.
   for (auto* batch : new_batches) {
@@ -830,6 +985,14 @@ void ASBSQueue<TaskType>::ReleaseBatch(const ASBSBatch<TaskType>* batch) {
   }
 }
 
+template <typename TaskType>
+void ASBSQueue<TaskType>::SetBatchingDecision(
+    const BatchingDecision& decision) {
+  mutex_lock l(mu_);
+  max_batch_size_ = decision.max_batch_size;
+  batch_timeout_micros_ = decision.batch_timeout_micros;
+}
+
 template <typename TaskType>
 size_t ASBSQueue<TaskType>::NumEnqueuedTasks() const {
   mutex_lock l(mu_);
@@ -845,10 +1008,10 @@ size_t ASBSQueue<TaskType>::SchedulingCapacity() const {
 template <typename TaskType>
 size_t ASBSQueue<TaskType>::SchedulingCapacityLocked() const {
   const int current_batch_capacity =
-      current_batch_ ? options_.max_batch_size - current_batch_->size() : 0;
+      current_batch_ ? max_batch_size_ - current_batch_->size() : 0;
   const int spare_batches =
       options_.max_enqueued_batches - num_enqueued_batches_;
-  return spare_batches * options_.max_batch_size + current_batch_capacity;
+  return spare_batches * max_batch_size_ + current_batch_capacity;
 }
 
 template <typename TaskType>
@@ -516,6 +516,74 @@ TEST(AdaptiveSharedBatchSchedulerTest, MaxTasksPerBatch) {
     if (processed_batches == 3) break;
   }
 }
+
+TEST(AdaptiveSharedBatchSchedulerTest, LatencySloBadOptions) {
+  using Scheduler = AdaptiveSharedBatchScheduler<FakeTask>;
+  std::shared_ptr<Scheduler> scheduler;
+  Scheduler::Options options;
+  options.latency_slo_micros = -1;
+  EXPECT_FALSE(Scheduler::Create(options, &scheduler).ok());
+  options = Scheduler::Options();
+  options.latency_slo_adjustment_interval_micros = 0;
+  EXPECT_FALSE(Scheduler::Create(options, &scheduler).ok());
+
+  options = Scheduler::Options();
+  options.latency_slo_micros = 10000;
+  TF_ASSERT_OK(Scheduler::Create(options, &scheduler));
+  auto queue_callback = [](std::unique_ptr<Batch<FakeTask>> batch) {};
+  std::unique_ptr<BatchScheduler<FakeTask>> queue;
+  Scheduler::QueueOptions queue_options;
+  queue_options.max_batch_size = 8;
+  queue_options.allowed_batch_sizes = {2, 16};
+  EXPECT_FALSE(
+      scheduler->AddQueue(queue_options, queue_callback, &queue).ok());
+  queue_options.allowed_batch_sizes = {4, 2, 8};
+  EXPECT_FALSE(
+      scheduler->AddQueue(queue_options, queue_callback, &queue).ok());
+  queue_options.allowed_batch_sizes = {2, 4, 8};
+  TF_EXPECT_OK(scheduler->AddQueue(queue_options, queue_callback, &queue));
+}
+
+TEST(AdaptiveSharedBatchSchedulerTest, LatencySloPicksBatchSize) {
+  AdaptiveSharedBatchScheduler<FakeTask>::Options options;
+  options.initial_in_flight_batches_limit = 1;
+  options.num_batch_threads = 1;
+  options.latency_slo_micros = 20000;
+  options.latency_slo_adjustment_interval_micros = 1;
+  mutex mu;
+  int max_processed_batch_size = 0;
+  auto queue_callback = [&mu, &max_processed_batch_size](
+                            std::unique_ptr<Batch<FakeTask>> batch) {
+    ASSERT_TRUE(batch->IsClosed());
+    mutex_lock l(mu);
+    max_processed_batch_size =
+        std::max(max_processed_batch_size, static_cast<int>(batch->size()));
+  };
+  std::shared_ptr<AdaptiveSharedBatchScheduler<FakeTask>> scheduler;
+  TF_ASSERT_OK(
+      AdaptiveSharedBatchScheduler<FakeTask>::Create(options, &scheduler));
+  std::unique_ptr<BatchScheduler<FakeTask>> queue;
+  AdaptiveSharedBatchScheduler<FakeTask>::QueueOptions queue_options;
+  queue_options.max_batch_size = 100;
+  queue_options.allowed_batch_sizes = {1, 2, 100};
+  TF_ASSERT_OK(scheduler->AddQueue(queue_options, queue_callback, &queue));
+
+  // Batches of a single task measure the first bucket.
+  for (int i = 0; i < 2 * BatchLatencyModel::kMinSamples; ++i) {
+    TF_ASSERT_OK(ScheduleTask(1, queue.get()));
+    while (queue->NumEnqueuedTasks() > 0) {
+    }
+  }
+  // The batch size is now picked among the padding buckets, and the next
+  // bucket is explored before the largest one, so that tasks of size 1 fill
+  // batches of at most 2 elements.
+  for (int i = 0; i < 4; ++i) {
+    TF_ASSERT_OK(ScheduleTask(1, queue.get()));
+  }
+  queue.reset();
+  mutex_lock l(mu);
+  EXPECT_LE(max_processed_batch_size, 2);
+}
 }  // namespace anonymous
 }  // namespace serving
 }  // namespace tensorflow
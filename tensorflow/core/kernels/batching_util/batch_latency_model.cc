@@ -0,0 +1,148 @@
+// This file contains the implementation of BatchLatencyModel and of the
+// latency SLO batching decisions.
+
+#include "tensorflow/core/kernels/batching_util/batch_latency_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "tensorflow/core/lib/monitoring/gauge.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace serving {
+
+BatchLatencyModel::BatchLatencyModel(std::vector<int> batch_sizes)
+    : batch_sizes_(std::move(batch_sizes)), buckets_(batch_sizes_.size()) {
+  DCHECK(!batch_sizes_.empty());
+  DCHECK(std::is_sorted(batch_sizes_.begin(), batch_sizes_.end()));
+}
+
+int BatchLatencyModel::BucketIndex(int batch_size) const {
+  const auto it =
+      std::lower_bound(batch_sizes_.begin(), batch_sizes_.end(), batch_size);
+  if (it == batch_sizes_.end()) return batch_sizes_.size() - 1;
+  return it - batch_sizes_.begin();
+}
+
+void BatchLatencyModel::Record(int batch_size, int64_t latency_micros) {
+  Bucket& bucket = buckets_[BucketIndex(batch_size)];
+  if (bucket.samples.size() < kWindowSize) {
+    bucket.samples.push_back(latency_micros);
+    if (bucket.samples.size() == kMinSamples) ++num_measured_buckets_;
+  } else {
+    bucket.samples[bucket.next_sample] = latency_micros;
+    bucket.next_sample = (bucket.next_sample + 1) % kWindowSize;
+  }
+  double sum = 0;
+  for (int64_t sample : bucket.samples) sum += sample;
+  bucket.mean_micros = sum / bucket.samples.size();
+  std::vector<int64_t> sorted = bucket.samples;
+  const int p99_index = (99 * sorted.size() + 99) / 100 - 1;
+  std::nth_element(sorted.begin(), sorted.begin() + p99_index, sorted.end());
+  bucket.p99_micros = sorted[p99_index];
+}
+
+bool BatchLatencyModel::IsMeasured(int index) const {
+  return buckets_[index].samples.size() >= kMinSamples;
+}
+
+double BatchLatencyModel::MeanMicros(int index) const {
+  if (IsMeasured(index)) return buckets_[index].mean_micros;
+  return Estimate(index, &Bucket::mean_micros);
+}
+
+double BatchLatencyModel::P99Micros(int index) const {
+  if (IsMeasured(index)) return buckets_[index].p99_micros;
+  return Estimate(index, &Bucket::p99_micros);
+}
+
+double BatchLatencyModel::Estimate(int index, double Bucket::*stat) const {
+  // Least squares fit of stat = intercept + slope * batch_size.
+  double n = 0, sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+  for (int i = 0; i < buckets_.size(); ++i) {
+    if (!IsMeasured(i)) continue;
+    const double x = batch_sizes_[i];
+    const double y = buckets_[i].*stat;
+    n += 1;
+    sum_x += x;
+    sum_y += y;
+    sum_xx += x * x;
+    sum_xy += x * y;
+  }
+  if (n == 0) return 0;
+  const double denominator = n * sum_xx - sum_x * sum_x;
+  if (n == 1 || denominator <= 0) return sum_y / n;
+  // Latency does not decrease with the batch size.
+  const double slope =
+      std::max((n * sum_xy - sum_x * sum_y) / denominator, 0.0);
+  const double intercept = (sum_y - slope * sum_x) / n;
+  return std::max(intercept + slope * batch_sizes_[index], 0.0);
+}
+
+BatchingDecision ChooseBatchingDecision(const BatchLatencyModel& model,
+                                        double elements_per_micro,
+                                        int64_t latency_slo_micros) {
+  const std::vector<int>& batch_sizes = model.batch_sizes();
+  BatchingDecision decision;
+  decision.max_batch_size = batch_sizes[0];
+  decision.estimated_p99_latency_micros =
+      static_cast<int64_t>(model.P99Micros(0));
+  double best_throughput = -1;
+  for (int i = 0; i < batch_sizes.size(); ++i) {
+    if (i > 0 && !model.IsMeasured(i) && !model.IsMeasured(i - 1)) break;
+    const double p99_micros = model.P99Micros(i);
+    const double budget_micros = latency_slo_micros - p99_micros;
+    if (budget_micros < 0) continue;
+    // Non-full batches may wait for the whole budget, but no longer than the
+    // arrivals take to fill them.
+    double timeout_micros = budget_micros;
+    if (elements_per_micro > 0) {
+      timeout_micros =
+          std::min(timeout_micros, batch_sizes[i] / elements_per_micro);
+    }
+    // Batches close when full or on timeout, and are then padded to the
+    // bucket of their size.
+    const double batch_size =
+        std::min(static_cast<double>(batch_sizes[i]),
+                 std::max(1.0, elements_per_micro * timeout_micros));
+    const double processing_micros =
+        model.MeanMicros(model.BucketIndex(std::ceil(batch_size)));
+    const double throughput = batch_size / std::max(processing_micros, 1.0);
+    if (throughput > best_throughput) {
+      best_throughput = throughput;
+      decision.max_batch_size = batch_sizes[i];
+      decision.batch_timeout_micros = static_cast<int64_t>(timeout_micros);
+      decision.estimated_p99_latency_micros =
+          static_cast<int64_t>(p99_micros);
+    }
+  }
+  return decision;
+}
+
+void RecordBatchingDecision(const std::string& queue_name,
+                            const BatchingDecision& decision) {
+  static auto* max_batch_size_cell = monitoring::Gauge<int64_t, 1>::New(
+      "/tensorflow/serving/batching/slo_max_batch_size",
+      "Tracks the maximum batch size, i.e. the largest allowed padding "
+      "bucket, chosen by the latency SLO batch scheduler per queue.",
+      "queue");
+  static auto* batch_timeout_cell = monitoring::Gauge<int64_t, 1>::New(
+      "/tensorflow/serving/batching/slo_batch_timeout_micros",
+      "Tracks the batch timeout chosen by the latency SLO batch scheduler per "
+      "queue.",
+      "queue");
+  static auto* p99_latency_cell = monitoring::Gauge<int64_t, 1>::New(
+      "/tensorflow/serving/batching/slo_estimated_p99_latency_micros",
+      "Tracks the estimated p99 processing latency of the batches of the "
+      "maximum batch size chosen by the latency SLO batch scheduler per queue.",
+      "queue");
+  max_batch_size_cell->GetCell(queue_name)->Set(decision.max_batch_size);
+  batch_timeout_cell->GetCell(queue_name)->Set(decision.batch_timeout_micros);
+  p99_latency_cell->GetCell(queue_name)->Set(
+      decision.estimated_p99_latency_micros);
+}
+
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,105 @@
+// This file contains BatchLatencyModel, a live model of the processing latency
+// of a batched function per padded batch size, and the choice of the batching
+// parameters of a queue that maximize throughput under a p99 latency SLO. They
+// implement the latency SLO mode of AdaptiveSharedBatchScheduler.
+
+#ifndef TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_BATCH_LATENCY_MODEL_H_
+#define TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_BATCH_LATENCY_MODEL_H_
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace serving {
+
+// The batching parameters of a queue.
+struct BatchingDecision {
+  // Maximum size of the batches formed by the queue. This is one of the padded
+  // batch sizes of the model, i.e. the largest padding bucket batches may use.
+  int max_batch_size = 0;
+  // Amount of time non-full batches wait before becoming schedulable.
+  int64_t batch_timeout_micros = 0;
+  // Estimated p99 processing latency of a batch of `max_batch_size`.
+  int64_t estimated_p99_latency_micros = 0;
+};
+
+// Tracks the processing latency of batches per padded batch size, i.e. per
+// padding bucket, over a sliding window of the most recent batches. Buckets
+// without enough samples are estimated from the measured ones. Not
+// thread-safe.
+class BatchLatencyModel {
+ public:
+  // Number of recent latencies kept per bucket.
+  static constexpr int kWindowSize = 256;
+  // Number of samples from which the latencies of a bucket are measured
+  // rather than estimated.
+  static constexpr int kMinSamples = 16;
+
+  // `batch_sizes` are the sizes batches are padded to, in increasing order.
+  explicit BatchLatencyModel(std::vector<int> batch_sizes);
+
+  const std::vector<int>& batch_sizes() const { return batch_sizes_; }
+
+  // Returns the index of the smallest padded batch size not smaller than
+  // `batch_size`, or of the largest one if there is none.
+  int BucketIndex(int batch_size) const;
+
+  // Records that a batch of `batch_size` elements, before padding, was
+  // processed in `latency_micros`.
+  void Record(int batch_size, int64_t latency_micros);
+
+  // Whether bucket `index` has at least kMinSamples samples.
+  bool IsMeasured(int index) const;
+
+  // Whether no bucket is measured yet.
+  bool empty() const { return num_measured_buckets_ == 0; }
+
+  // Estimated mean and p99 processing latencies of a batch padded to bucket
+  // `index`. Unmeasured buckets are estimated by a linear fit of the measured
+  // ones, or are assumed as fast as the only measured bucket, so that the
+  // scheduler tries them. Returns 0 if the model is empty.
+  double MeanMicros(int index) const;
+  double P99Micros(int index) const;
+
+ private:
+  struct Bucket {
+    // Ring buffer of the most recent latencies.
+    std::vector<int64_t> samples;
+    int next_sample = 0;
+    // Statistics of `samples`, updated on Record().
+    double mean_micros = 0;
+    double p99_micros = 0;
+  };
+
+  // Estimates a statistic of bucket `index` from the measured buckets.
+  double Estimate(int index, double Bucket::*stat) const;
+
+  const std::vector<int> batch_sizes_;
+  std::vector<Bucket> buckets_;
+  int num_measured_buckets_ = 0;
+};
+
+// Returns the batching parameters of a queue whose batches are processed with
+// the latencies of `model`, and whose elements arrive at
+// `elements_per_micro`. The p99 latency of a request is modeled as the timeout
+// of its batch plus the p99 processing latency of the batch, which must not
+// exceed `latency_slo_micros`. Among the feasible padded batch sizes, the one
+// processing the most elements per unit of processing time at the arrival
+// rate is chosen, i.e. the one maximizing throughput under the SLO. A bucket
+// that is not measured yet is only a candidate when the next smaller bucket
+// is, so that batches grow one bucket at a time. Returns the smallest bucket,
+// without timeout, when no bucket meets the SLO.
+BatchingDecision ChooseBatchingDecision(const BatchLatencyModel& model,
+                                        double elements_per_micro,
+                                        int64_t latency_slo_micros);
+
+// Exports `decision` as the serving batching metrics of queue `queue_name`.
+void RecordBatchingDecision(const std::string& queue_name,
+                            const BatchingDecision& decision);
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_BATCH_LATENCY_MODEL_H_
@@ -0,0 +1,127 @@
+#include "tensorflow/core/kernels/batching_util/batch_latency_model.h"
+
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// Records kMinSamples batches of `batch_size` processed in `latency_micros`.
+void Measure(int batch_size, int64_t latency_micros,
+             BatchLatencyModel* model) {
+  for (int i = 0; i < BatchLatencyModel::kMinSamples; ++i) {
+    model->Record(batch_size, latency_micros);
+  }
+}
+
+TEST(BatchLatencyModelTest, BucketIndex) {
+  BatchLatencyModel model({2, 4, 8});
+  EXPECT_EQ(model.BucketIndex(1), 0);
+  EXPECT_EQ(model.BucketIndex(2), 0);
+  EXPECT_EQ(model.BucketIndex(3), 1);
+  EXPECT_EQ(model.BucketIndex(8), 2);
+  EXPECT_EQ(model.BucketIndex(9), 2);
+}
+
+TEST(BatchLatencyModelTest, MeasuredBucket) {
+  BatchLatencyModel model({2, 4, 8});
+  EXPECT_TRUE(model.empty());
+  for (int i = 1; i < BatchLatencyModel::kMinSamples; ++i) {
+    model.Record(3, i);
+  }
+  EXPECT_FALSE(model.IsMeasured(1));
+  EXPECT_TRUE(model.empty());
+  for (int i = BatchLatencyModel::kMinSamples; i <= 100; ++i) {
+    model.Record(3, i);
+  }
+  EXPECT_TRUE(model.IsMeasured(1));
+  EXPECT_FALSE(model.empty());
+  EXPECT_DOUBLE_EQ(model.MeanMicros(1), 50.5);
+  EXPECT_DOUBLE_EQ(model.P99Micros(1), 99);
+}
+
+TEST(BatchLatencyModelTest, SlidingWindow) {
+  BatchLatencyModel model({4});
+  for (int i = 0; i < BatchLatencyModel::kWindowSize; ++i) {
+    model.Record(4, 1000);
+  }
+  for (int i = 0; i < BatchLatencyModel::kWindowSize; ++i) {
+    model.Record(4, 10);
+  }
+  EXPECT_DOUBLE_EQ(model.MeanMicros(0), 10);
+  EXPECT_DOUBLE_EQ(model.P99Micros(0), 10);
+}
+
+TEST(BatchLatencyModelTest, EstimatedBuckets) {
+  BatchLatencyModel model({2, 4, 8});
+  EXPECT_DOUBLE_EQ(model.P99Micros(2), 0);
+  Measure(2, 100, &model);
+  // Assumed as fast as the only measured bucket.
+  EXPECT_DOUBLE_EQ(model.P99Micros(2), 100);
+  Measure(4, 200, &model);
+  // Linear fit of the measured buckets.
+  EXPECT_DOUBLE_EQ(model.MeanMicros(2), 400);
+  EXPECT_DOUBLE_EQ(model.P99Micros(2), 400);
+}
+
+TEST(ChooseBatchingDecisionTest, ExploresNextBucket) {
+  BatchLatencyModel model({2, 4, 8});
+  Measure(2, 100, &model);
+  const BatchingDecision decision =
+      ChooseBatchingDecision(model, /*elements_per_micro=*/1.0 / 128,
+                             /*latency_slo_micros=*/10000);
+  EXPECT_EQ(decision.max_batch_size, 4);
+  EXPECT_EQ(decision.batch_timeout_micros, 512);
+  EXPECT_EQ(decision.estimated_p99_latency_micros, 100);
+}
+
+class ChooseBatchingDecisionMeasuredTest : public ::testing::Test {
+ protected:
+  ChooseBatchingDecisionMeasuredTest() : model_({2, 4, 8}) {
+    Measure(2, 100, &model_);
+    Measure(4, 150, &model_);
+    Measure(8, 250, &model_);
+  }
+
+  BatchLatencyModel model_;
+};
+
+TEST_F(ChooseBatchingDecisionMeasuredTest, RespectsSlo) {
+  const BatchingDecision decision =
+      ChooseBatchingDecision(model_, /*elements_per_micro=*/1,
+                             /*latency_slo_micros=*/200);
+  EXPECT_EQ(decision.max_batch_size, 4);
+  EXPECT_EQ(decision.batch_timeout_micros, 4);
+  EXPECT_EQ(decision.estimated_p99_latency_micros, 150);
+}
+
+TEST_F(ChooseBatchingDecisionMeasuredTest, FillsLargestBucket) {
+  const BatchingDecision decision =
+      ChooseBatchingDecision(model_, /*elements_per_micro=*/1.0 / 1024,
+                             /*latency_slo_micros=*/10000);
+  EXPECT_EQ(decision.max_batch_size, 8);
+  EXPECT_EQ(decision.batch_timeout_micros, 8192);
+  EXPECT_EQ(decision.estimated_p99_latency_micros, 250);
+}
+
+TEST_F(ChooseBatchingDecisionMeasuredTest, LowTraffic) {
+  // The batches time out before reaching 2 elements in any bucket.
+  const BatchingDecision decision =
+      ChooseBatchingDecision(model_, /*elements_per_micro=*/1.0 / 16384,
+                             /*latency_slo_micros=*/10000);
+  EXPECT_EQ(decision.max_batch_size, 2);
+  EXPECT_EQ(decision.batch_timeout_micros, 9900);
+}
+
+TEST_F(ChooseBatchingDecisionMeasuredTest, NoFeasibleBucket) {
+  const BatchingDecision decision =
+      ChooseBatchingDecision(model_, /*elements_per_micro=*/1,
+                             /*latency_slo_micros=*/50);
+  EXPECT_EQ(decision.max_batch_size, 2);
+  EXPECT_EQ(decision.batch_timeout_micros, 0);
+  EXPECT_EQ(decision.estimated_p99_latency_micros, 100);
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/batching_util/batch_resource_base.h"
 
+#include <algorithm>
 #include <sstream>
 
 #include "absl/strings/str_cat.h"
@@ -231,6 +232,7 @@ BatchResourceBase::BatchTask::CreateSplitTask(
 }
 
 using ::tensorflow::concat_split_util::Concat;
+using ::tensorflow::concat_split_util::PadFirstDimension;
 using ::tensorflow::concat_split_util::Split;
 using TensorMatrix = std::vector<std::vector<Tensor>>;
 
@@ -337,11 +339,32 @@ Status BatchResourceBase::RegisterInput(
   }
 
   BatcherQueueT* batcher_queue;
-  TF_RETURN_IF_ERROR(
-      LookupOrCreateBatcherQueue(batcher_queue_name, &batcher_queue));
+  TF_RETURN_IF_ERROR(LookupOrCreateBatcherQueue(
+      SequenceLengthBucketQueueName(batcher_queue_name,
+                                    batch_components->inputs),
+      &batcher_queue));
   return batcher_queue->Schedule(&batch_components);
 }
 
+string BatchResourceBase::SequenceLengthBucketQueueName(
+    const string& queue_name, const std::vector<Tensor>& inputs) const {
+  if (sequence_length_buckets_.empty()) {
+    return queue_name;
+  }
+  int64_t sequence_length = 0;
+  for (const Tensor& input : inputs) {
+    if (input.dims() >= 2) {
+      sequence_length = std::max(sequence_length, input.dim_size(1));
+    }
+  }
+  // Inputs longer than the last bucket get a bucket of their own.
+  const int bucket =
+      std::lower_bound(sequence_length_buckets_.begin(),
+                       sequence_length_buckets_.end(), sequence_length) -
+      sequence_length_buckets_.begin();
+  return absl::StrCat(queue_name, "/sequence_length_bucket_", bucket);
+}
+
 /*static*/ BatchResourceBase::BatcherT::QueueOptions
 BatchResourceBase::GetBatcherQueueOptions(
     int32_t num_batch_threads, int32_t max_batch_size,
@@ -389,6 +412,8 @@ BatchResourceBase::GetAdaptiveBatcherQueueOptions(
   } else {
     batcher_queue_options.max_batch_size = *allowed_batch_sizes.rbegin();
   }
+  // Added by Alpa: the padding buckets a latency SLO scheduler picks from.
+  batcher_queue_options.allowed_batch_sizes = allowed_batch_sizes;
 
   if (enable_large_batch_splitting) {
     batcher_queue_options.split_input_task_func =
@@ -472,10 +497,25 @@ Status BatchResourceBase::ConcatInputTensors(
       to_concatenate.push_back(batch.task(task_idx).inputs.at(i));
     }
 
+    // Added by Alpa: with sequence length buckets, pad the tensors along their
+    // first dimension to the longest one of the batch.
+    if (!sequence_length_buckets_.empty() && to_concatenate[0].dims() >= 2) {
+      int64_t sequence_length = 0;
+      for (const Tensor& tensor : to_concatenate) {
+        sequence_length = std::max(sequence_length, tensor.dim_size(1));
+      }
+      for (Tensor& tensor : to_concatenate) {
+        Tensor padded;
+        TF_RETURN_IF_ERROR(
+            PadFirstDimension(context, tensor, sequence_length, &padded));
+        tensor = std::move(padded);
+      }
+    }
+
     // Add padding as needed. Use the first row of the first task's tensor as
     // the data for padding.
     if (padding_amount > 0) {
-      const Tensor& padding_source = batch.task(0).inputs.at(i);
+      const Tensor& padding_source = to_concatenate[0];
       Tensor padding;
       if (padding_source.shape().dim_size(0) == 0) {
         return errors::InvalidArgument(
@@ -899,8 +939,11 @@ Status BatchResourceBase::LookupOrCreateBatcherQueue(const string& queue_name,
     TF_RETURN_IF_ERROR(batcher_->AddQueue(batcher_queue_options_,
                                           process_batch_callback, &new_queue));
   } else if (adaptive_batcher_) {
+    AdaptiveBatcherT::QueueOptions queue_options =
+        adaptive_batcher_queue_options_;
+    queue_options.name = queue_name;  // Added by Alpa
     TF_RETURN_IF_ERROR(adaptive_batcher_->AddQueue(
-        adaptive_batcher_queue_options_, process_batch_callback, &new_queue));
+        queue_options, process_batch_callback, &new_queue));
   } else {
     return errors::Internal("No batcher defined.");
   }
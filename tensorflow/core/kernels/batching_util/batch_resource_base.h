@@ -126,25 +126,32 @@ class BatchResourceBase : public ResourceBase {
   using BatcherQueueT = BatchScheduler<BatchResourceBase::BatchTask>;
   using BatchT = Batch<BatchResourceBase::BatchTask>;
 
+  // Added by Alpa: if 'sequence_length_buckets' is not empty, inputs are only
+  // batched with inputs whose first dimension falls in the same bucket, and
+  // are padded with zeros along it to the longest input of their batch.
   BatchResourceBase(bool has_process_batch_function,
                     std::shared_ptr<BatcherT> batcher,
                     const BatcherT::QueueOptions& batcher_queue_options,
-                    std::vector<int32> allowed_batch_sizes)
+                    std::vector<int32> allowed_batch_sizes,
+                    std::vector<int32> sequence_length_buckets = {})
       : has_process_batch_function_(has_process_batch_function),
         batcher_(std::move(batcher)),
         batcher_queue_options_(batcher_queue_options),
-        allowed_batch_sizes_(std::move(allowed_batch_sizes)) {
+        allowed_batch_sizes_(std::move(allowed_batch_sizes)),
+        sequence_length_buckets_(std::move(sequence_length_buckets)) {
     allowed_batch_sizes_str_ = absl::StrJoin(allowed_batch_sizes_, ",");
   }
 
   BatchResourceBase(bool has_process_batch_function,
                     std::shared_ptr<AdaptiveBatcherT> batcher,
                     const AdaptiveBatcherT::QueueOptions& batcher_queue_options,
-                    std::vector<int32> allowed_batch_sizes)
+                    std::vector<int32> allowed_batch_sizes,
+                    std::vector<int32> sequence_length_buckets = {})
       : has_process_batch_function_(has_process_batch_function),
         adaptive_batcher_(std::move(batcher)),
         adaptive_batcher_queue_options_(batcher_queue_options),
-        allowed_batch_sizes_(std::move(allowed_batch_sizes)) {}
+        allowed_batch_sizes_(std::move(allowed_batch_sizes)),
+        sequence_length_buckets_(std::move(sequence_length_buckets)) {}
 
   static BatcherT::QueueOptions GetBatcherQueueOptions(
       int32_t num_batch_threads, int32_t max_batch_size,
@@ -238,6 +245,13 @@ class BatchResourceBase : public ResourceBase {
   static Status EmitIndexTensor(OpKernelContext* context, const BatchT& batch,
                                 int output_index);
 
+  // Added by Alpa. Returns the name of the queue of the inputs of a task, i.e.
+  // 'queue_name' followed by the bucket of the inputs' sequence length, the
+  // largest size of their first dimension, if there are sequence length
+  // buckets.
+  string SequenceLengthBucketQueueName(const string& queue_name,
+                                       const std::vector<Tensor>& inputs) const;
+
   // Looks up the batcher queue for 'queue_name'. If it did't previously exist,
   // creates it.
   Status LookupOrCreateBatcherQueue(const string& queue_name,
@@ -264,6 +278,9 @@ class BatchResourceBase : public ResourceBase {
   // A concatenated string of <allowed_batch_sizes_>, separated by ",". This is
   // used to record batching parameter.
   string allowed_batch_sizes_str_;
+
+  // Added by Alpa. Increasing upper bounds of the sequence length buckets.
+  std::vector<int32> sequence_length_buckets_;
 };
 
 }  // namespace serving
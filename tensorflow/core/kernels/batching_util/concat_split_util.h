@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_CONCAT_SPLIT_UTIL_H_
 #define TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_CONCAT_SPLIT_UTIL_H_
 
+#include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/ops_util.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -90,9 +91,82 @@ Status Concat(OpKernelContext* context, const gtl::ArraySlice<Tensor> inputs,
   return OkStatus();
 }
 
+// Added by Alpa. A buffer aliasing 'size' bytes of another buffer from 'data'.
+class AliasTensorBuffer : public TensorBuffer {
+ public:
+  AliasTensorBuffer(TensorBuffer* buf, void* data, size_t size)
+      : TensorBuffer(data), root_(buf->root_buffer()), size_(size) {
+    root_->Ref();
+  }
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return root_; }
+  bool GetAllocatedBytes(size_t* out_bytes) const override {
+    return root_->GetAllocatedBytes(out_bytes);
+  }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    root_->FillAllocationDescription(proto);
+  }
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  ~AliasTensorBuffer() override { root_->Unref(); }
+
+  TensorBuffer* const root_;
+  const size_t size_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AliasTensorBuffer);
+};
+
+// Added by Alpa. Concatenates 'inputs' along the zeroth dimension without
+// copying if they are already contiguous, i.e. if there is a single input or
+// if the inputs are consecutive slices of the same buffer, as produced by
+// 'Split'. Returns whether 'output' was set.
+inline bool ConcatContiguous(const gtl::ArraySlice<Tensor> inputs,
+                             Tensor* output) {
+  const Tensor& first = inputs[0];
+  if (inputs.size() == 1) {
+    *output = first;
+    return true;
+  }
+  const TensorBuffer* first_buffer = DMAHelper::buffer(&first);
+  if (first_buffer == nullptr) return false;
+  TensorBuffer* root =
+      const_cast<TensorBuffer*>(first_buffer)->root_buffer();
+  const char* next_data = static_cast<const char*>(DMAHelper::base(&first));
+  int64_t output_dim0 = 0;
+  size_t total_bytes = 0;
+  for (const Tensor& input : inputs) {
+    const TensorBuffer* buffer = DMAHelper::buffer(&input);
+    if (buffer == nullptr || input.dtype() != first.dtype() ||
+        input.dims() != first.dims() ||
+        const_cast<TensorBuffer*>(buffer)->root_buffer() != root ||
+        DMAHelper::base(&input) != next_data) {
+      return false;
+    }
+    for (int j = 1; j < first.dims(); ++j) {
+      if (input.dim_size(j) != first.dim_size(j)) return false;
+    }
+    next_data += input.TotalBytes();
+    total_bytes += input.TotalBytes();
+    output_dim0 += input.dim_size(0);
+  }
+  TensorShape output_shape(first.shape());
+  output_shape.set_dim(0, output_dim0);
+  TensorBuffer* buffer = new AliasTensorBuffer(
+      root, const_cast<void*>(DMAHelper::base(&first)), total_bytes);
+  *output = Tensor(first.dtype(), output_shape, buffer);
+  buffer->Unref();
+  return true;
+}
+
 // Same as 'Concat' above, but handles Tensor dtype deduction automatically.
 inline Status Concat(OpKernelContext* context,
                      const gtl::ArraySlice<Tensor> inputs, Tensor* output) {
+  // Added by Alpa: contiguous inputs are aliased rather than copied.
+  if (ConcatContiguous(inputs, output)) {
+    return OkStatus();
+  }
   const DataType type = inputs[0].dtype();
   Status concat_status;
   switch (type) {
@@ -109,6 +183,59 @@ inline Status Concat(OpKernelContext* context,
   return concat_status;
 }
 
+// Added by Alpa. Pads 'input', of rank at least 2, with default-initialized,
+// i.e. zero, elements along its first dimension to 'length'. Allocates
+// 'output' using 'context'.
+template <typename T>
+Status PadFirstDimension(OpKernelContext* context, const Tensor& input,
+                         int64_t length, Tensor* output) {
+  TensorShape output_shape(input.shape());
+  output_shape.set_dim(1, length);
+  AllocatorAttributes attr;
+  attr.set_on_host(true);
+  TF_RETURN_IF_ERROR(context->allocate_temp(DataTypeToEnum<T>::value,
+                                            output_shape, output, attr));
+  int64_t inner_size = 1;
+  for (int j = 2; j < input.dims(); ++j) {
+    inner_size *= input.dim_size(j);
+  }
+  auto output_shaped =
+      output->shaped<T, 3>({output->dim_size(0), length, inner_size});
+  output_shaped.setConstant(T());
+  if (input.NumElements() > 0) {
+    auto input_shaped = input.shaped<T, 3>(
+        {input.dim_size(0), input.dim_size(1), inner_size});
+    const Eigen::DSizes<Eigen::DenseIndex, 3> offsets(0, 0, 0);
+    output_shaped.slice(offsets, input_shaped.dimensions()) = input_shaped;
+  }
+  return OkStatus();
+}
+
+// Added by Alpa. Same as 'PadFirstDimension' above, but handles Tensor dtype
+// automatically.
+inline Status PadFirstDimension(OpKernelContext* context, const Tensor& input,
+                                int64_t length, Tensor* output) {
+  if (input.dims() < 2 || input.dim_size(1) > length) {
+    return errors::InvalidArgument("Cannot pad input of shape ",
+                                   input.shape().DebugString(),
+                                   " along its first dimension to ", length);
+  }
+  if (input.dim_size(1) == length) {
+    *output = input;
+    return OkStatus();
+  }
+  switch (input.dtype()) {
+#define CASE(type)                                                    \
+  case DataTypeToEnum<type>::value:                                   \
+    return PadFirstDimension<type>(context, input, length, output);
+    TF_CALL_ALL_TYPES(CASE);
+#undef CASE
+    default:
+      return errors::InvalidArgument("Unsupported data type: ",
+                                     input.dtype());
+  }
+}
+
 // The Split*() functions split 'input' with element type T into 'sizes.size()'
 // tensors along the zeroth dimension, with the ith split having zeroth-
 // dimension size 'sizes[i]'. They allocate the output tensors using 'context',
@@ -19,6 +19,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "tensorflow/core/data/mmap_cache.h"
 #include "tensorflow/core/data/name_utils.h"
 #include "tensorflow/core/data/serialization_utils.h"
 #include "tensorflow/core/framework/dataset.h"
@@ -46,6 +47,7 @@ namespace data {
 /* static */ constexpr const char* const CacheDatasetOp::kFileName;
 /* static */ constexpr const char* const CacheDatasetOp::kOutputTypes;
 /* static */ constexpr const char* const CacheDatasetOp::kOutputShapes;
+/* static */ constexpr const char* const CacheDatasetOp::kCacheFormat;
 
 namespace {
 
@@ -64,6 +66,8 @@ constexpr char kCacheCompleted[] = "cache_completed";
 constexpr char kIndex[] = "index";
 constexpr char kImpl[] = "Impl";
 constexpr char kCacheDataset[] = "CacheDataset";
+constexpr char kBundleCacheFormat[] = "bundle";
+constexpr char kMmapCacheFormat[] = "mmap";
 constexpr char kIncompleteCacheErrorMessage[] =
     "The calling iterator did not fully read the dataset being cached. In "
     "order to avoid unexpected truncation of the dataset, the partially cached "
@@ -134,10 +138,12 @@ class PartialCache {
 class CacheDatasetOp::FileDatasetBase : public DatasetBase {
  public:
   FileDatasetBase(OpKernelContext* ctx, const DatasetBase* input,
-                  string filename, Env* env)
+                  string filename, Env* env, bool mmap_cache)
       : DatasetBase(DatasetContext(ctx)),
         input_(input),
         filename_(std::move(filename)),
+        mmap_cache_(mmap_cache &&
+                    MmapCacheSupportsTypes(input->output_dtypes())),
         env_(env),
         num_tensors_(input->output_dtypes().size()),
         tensor_index_padding_size_(StringPaddingSize(num_tensors_)),
@@ -147,6 +153,11 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
                                               tensor_index_padding_size_)) {
     input_->Ref();
     DCHECK_EQ(item_index_padding_size_, 7);
+    if (mmap_cache != mmap_cache_) {
+      LOG(WARNING) << "The memory-mapped cache format does not support the "
+                   << "types " << DataTypeVectorString(input->output_dtypes())
+                   << ", falling back to the bundle format for " << filename_;
+    }
   }
 
   ~FileDatasetBase() override { input_->Unref(); }
@@ -184,11 +195,59 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
     return input_->CheckExternalState();
   }
 
+  // Added by Alpa. Random access into a completed memory-mapped cache.
+  Status Get(OpKernelContext* ctx, int64 index,
+             std::vector<Tensor>* out_tensors) const override {
+    if (!mmap_cache_) {
+      return DatasetBase::Get(ctx, index, out_tensors);
+    }
+    TF_ASSIGN_OR_RETURN(std::shared_ptr<const MmapCacheReader> reader,
+                        GetMmapReader());
+    return reader->Get(index, out_tensors);
+  }
+
  protected:
+  // Added by Alpa. Adds the attributes of the cache to the graph of the
+  // dataset.
+  Status AddAttributes(
+      DatasetGraphDefBuilder* b,
+      std::vector<std::pair<StringPiece, AttrValue>>* attrs) const {
+    AttrValue cache_format;
+    b->BuildAttrValue<string>(
+        mmap_cache_ ? kMmapCacheFormat : kBundleCacheFormat, &cache_format);
+    attrs->emplace_back(kCacheFormat, cache_format);
+    return OkStatus();
+  }
+
   const DatasetBase* const input_;
   const tstring filename_;
+  // Added by Alpa. Whether the cache uses the memory-mapped format of
+  // mmap_cache.h instead of a tensor bundle.
+  const bool mmap_cache_;
 
  private:
+  // Added by Alpa. The file that marks a complete cache with `prefix`.
+  string CacheMetaFilename(const string& prefix) const {
+    return mmap_cache_ ? MmapCacheIndexFilename(prefix)
+                       : MetaFilename(prefix);
+  }
+
+  // Added by Alpa. Returns the reader of the completed memory-mapped cache,
+  // which maps the cache once for all the iterators of the dataset.
+  StatusOr<std::shared_ptr<const MmapCacheReader>> GetMmapReader() const {
+    mutex_lock l(mu_);
+    if (!mmap_reader_) {
+      if (!env_->FileExists(MmapCacheIndexFilename(filename_)).ok()) {
+        return errors::FailedPrecondition(
+            "The cache ", filename_, " has not been completely written.");
+      }
+      TF_ASSIGN_OR_RETURN(
+          mmap_reader_,
+          MmapCacheReader::Open(env_, filename_, input_->output_dtypes()));
+    }
+    return std::shared_ptr<const MmapCacheReader>(mmap_reader_);
+  }
+
   static size_t StringPaddingSize(size_t num_tensors) {
     return strings::Printf(kPaddingSizeStrFormat, num_tensors - 1).size();
   }
@@ -203,7 +262,8 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
     explicit FileIterator(const Params& params)
         : DatasetIterator<FileDatasetBase>(params) {
       if (params.dataset->env_
-              ->FileExists(MetaFilename(params.dataset->filename_))
+              ->FileExists(
+                  params.dataset->CacheMetaFilename(params.dataset->filename_))
               .ok()) {
         mode_ = Mode::read;
       } else {
@@ -246,13 +306,14 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
       }
       if (mode_ == Mode::write &&
           dataset()
-              ->env_->FileExists(MetaFilename(dataset()->filename_))
+              ->env_->FileExists(
+                  dataset()->CacheMetaFilename(dataset()->filename_))
               .ok()) {
         // This could happen if the cache was completely written after the
         // checkpoint was saved.
         LOG(WARNING)
             << "It looks like the cache was already completely written("
-            << MetaFilename(dataset()->filename_)
+            << dataset()->CacheMetaFilename(dataset()->filename_)
             << ") after the last checkpoint was saved. Attempting to read "
             << "the cache instead of continuing to write. If this is a "
             << "mistake, please remove the above file and try running again.";
@@ -292,7 +353,9 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
             iteration_completed_(false) {}
 
       ~FileWriterIterator() override {
-        if (!dataset()->env_->FileExists(MetaFilename(filename_)).ok()) {
+        if (!dataset()
+                 ->env_->FileExists(dataset()->CacheMetaFilename(filename_))
+                 .ok()) {
           LOG(WARNING) << kIncompleteCacheErrorMessage;
           std::vector<string> cache_files;
           Status s = dataset()->env_->GetMatchingPaths(
@@ -325,7 +388,7 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
         if (*end_of_sequence) {
           return OkStatus();
         }
-        TF_RETURN_IF_ERROR(writer_->status());
+        TF_RETURN_IF_ERROR(WriterStatus());
         if (cur_index_ >= kMaxItems) {
           // As a courtesy, close the [truncated] cache file.
           Status s = Finish();
@@ -350,11 +413,15 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
               "Expected ",
               dataset()->num_tensors_, " got: ", out_tensors->size());
         }
-        size_t tensor_index = 0;
-        for (const Tensor& t : *out_tensors) {
-          DCHECK_LT(tensor_index, dataset()->num_tensors_);
-          string key = dataset()->FormatName(cur_index_, tensor_index++);
-          TF_RETURN_IF_ERROR(writer_->Add(key, t));
+        if (dataset()->mmap_cache_) {
+          TF_RETURN_IF_ERROR(mmap_writer_->Add(*out_tensors));
+        } else {
+          size_t tensor_index = 0;
+          for (const Tensor& t : *out_tensors) {
+            DCHECK_LT(tensor_index, dataset()->num_tensors_);
+            string key = dataset()->FormatName(cur_index_, tensor_index++);
+            TF_RETURN_IF_ERROR(writer_->Add(key, t));
+          }
         }
         if (*end_of_sequence) {
           TF_RETURN_IF_ERROR(Finish());
@@ -389,7 +456,7 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
         // empty shards.
         if (lockfile_created_) {
           // Flush the current bundle.
-          TF_RETURN_IF_ERROR(writer_->Finish());
+          TF_RETURN_IF_ERROR(FinishWriter());
 
           // Note: We do not delete the lockfile here. We keep lockfiles of
           // all shards around until the entire cache has been written to
@@ -438,7 +505,7 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
         }
         filename_ = strings::StrCat(dataset()->filename_, "_", shard_id_);
         lockfile_ = strings::StrCat(filename_, kLockFileSuffix);
-        writer_ = std::make_unique<BundleWriter>(dataset()->env_, filename_);
+        NewWriter();
         return OkStatus();
       }
 
@@ -458,6 +525,15 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
 
         // 1. Check that a checkpoint for the shard has not already been
         // written.
+        if (dataset()->mmap_cache_ &&
+            dataset()
+                ->env_->FileExists(MmapCacheIndexFilename(filename_))
+                .ok()) {
+          return errors::AlreadyExists("Existing cache files found: \n",
+                                       MmapCacheIndexFilename(filename_),
+                                       "\n",
+                                       "To continue delete the above file.");
+        }
         if (dataset()->env_->FileExists(MetaFilename(filename_)).ok()) {
           return errors::AlreadyExists("Existing cache files found: \n",
                                        MetaFilename(filename_), "\n",
@@ -500,15 +576,36 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
         // conditions are not met since BundleWriter's constructor creates
         // new temp files which can delete the temp files created by a
         // BundleWriter in another Session.
-        writer_ = std::make_unique<BundleWriter>(dataset()->env_, filename_);
+        NewWriter();
         lockfile_created_ = true;
         return OkStatus();
       }
 
+      // Added by Alpa. Creates the writer of the current shard in the format
+      // of the cache.
+      void NewWriter() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (dataset()->mmap_cache_) {
+          mmap_writer_ = std::make_unique<MmapCacheWriter>(
+              dataset()->env_, filename_, dataset()->output_dtypes());
+        } else {
+          writer_ = std::make_unique<BundleWriter>(dataset()->env_, filename_);
+        }
+      }
+
+      Status WriterStatus() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        return dataset()->mmap_cache_ ? mmap_writer_->status()
+                                      : writer_->status();
+      }
+
+      Status FinishWriter() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        return dataset()->mmap_cache_ ? mmap_writer_->Finish()
+                                      : writer_->Finish();
+      }
+
       Status Finish() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
         iteration_completed_ = true;
         // Flush the current bundle.
-        TF_RETURN_IF_ERROR(writer_->Finish());
+        TF_RETURN_IF_ERROR(FinishWriter());
         // Merge all the bundles.
         // Currently there are `shard_id_ + 1` bundles, one for each
         // checkpoint. Each bundle has prefix <filename>_<id> where `id` is an
@@ -523,8 +620,13 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
             prefixes.emplace_back(
                 strings::StrCat(dataset()->filename_, "_", i));
           }
-          TF_RETURN_IF_ERROR(
-              MergeBundles(dataset()->env_, prefixes, dataset()->filename_));
+          if (dataset()->mmap_cache_) {
+            TF_RETURN_IF_ERROR(MergeMmapCaches(dataset()->env_, prefixes,
+                                               dataset()->filename_));
+          } else {
+            TF_RETURN_IF_ERROR(MergeBundles(dataset()->env_, prefixes,
+                                            dataset()->filename_));
+          }
         }
         // Delete all lockfiles.
         for (size_t i = 0; i <= shard_id_; ++i) {
@@ -544,6 +646,7 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
       // `StrCat(dataset()->filename_, "_", shard_id_)`.
       string filename_;
       std::unique_ptr<BundleWriter> writer_ TF_GUARDED_BY(mu_);
+      std::unique_ptr<MmapCacheWriter> mmap_writer_ TF_GUARDED_BY(mu_);
       string lockfile_ TF_GUARDED_BY(mu_);
       bool lockfile_created_ TF_GUARDED_BY(mu_);
       bool iteration_completed_ TF_GUARDED_BY(mu_);
@@ -638,6 +741,66 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
       bool iterator_restored_ TF_GUARDED_BY(mu_);
     };  // FileReaderIterator
 
+    // Added by Alpa. Reads a memory-mapped cache. The elements point into the
+    // mapping of the cache rather than being deserialized, and restoring
+    // seeks to the element at `cur_index` directly.
+    class MmapFileReaderIterator : public DatasetIterator<FileDatasetBase> {
+     public:
+      explicit MmapFileReaderIterator(const Params& params)
+          : DatasetIterator<FileDatasetBase>(params), cur_index_(0) {}
+
+      Status Initialize(IteratorContext* ctx) override {
+        mutex_lock l(mu_);
+        TF_ASSIGN_OR_RETURN(reader_, dataset()->GetMmapReader());
+        return OkStatus();
+      }
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        mutex_lock l(mu_);
+        if (cur_index_ >= reader_->num_elements()) {
+          *end_of_sequence = true;
+          return OkStatus();
+        }
+        *end_of_sequence = false;
+        TF_RETURN_IF_ERROR(reader_->Get(cur_index_, out_tensors));
+        cur_index_++;
+        return OkStatus();
+      }
+
+     protected:
+      std::shared_ptr<model::Node> CreateNode(
+          IteratorContext* ctx, model::Node::Args args) const override {
+        return model::MakeKnownRatioNode(std::move(args),
+                                         /*ratio=*/1);
+      }
+
+      Status SaveInternal(SerializationContext* ctx,
+                          IteratorStateWriter* writer) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name(kCurIndex), cur_index_));
+        return OkStatus();
+      }
+
+      Status RestoreInternal(IteratorContext* ctx,
+                             IteratorStateReader* reader) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name(kCurIndex), &cur_index_));
+        if (cur_index_ < 0) {
+          return errors::Internal("Invalid value for cur_index ", cur_index_);
+        }
+        return OkStatus();
+      }
+
+     private:
+      mutex mu_;
+      int64_t cur_index_ TF_GUARDED_BY(mu_);
+      std::shared_ptr<const MmapCacheReader> reader_ TF_GUARDED_BY(mu_);
+    };  // MmapFileReaderIterator
+
     Status InitializeIterator(IteratorContext* ctx)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       // We intentionally use the same prefix for both `FileReaderIterator` and
@@ -650,6 +813,12 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
       // `cur_index`.
       switch (mode_) {
         case Mode::read:
+          if (dataset()->mmap_cache_) {
+            iterator_ = std::make_unique<MmapFileReaderIterator>(
+                MmapFileReaderIterator::Params{
+                    dataset(), strings::StrCat(prefix(), kImpl)});
+            break;
+          }
           iterator_ =
               std::make_unique<FileReaderIterator>(FileReaderIterator::Params{
                   dataset(), strings::StrCat(prefix(), kImpl)});
@@ -675,6 +844,8 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
   static constexpr size_t kMaxItems = 10000000;  // 10 million
   const size_t item_index_padding_size_;
   const string tensor_format_string_;
+  mutable mutex mu_;
+  mutable std::shared_ptr<MmapCacheReader> mmap_reader_ TF_GUARDED_BY(mu_);
 };  // FileDatasetBase
 
 class CacheDatasetOp::FileDataset : public CacheDatasetOp::FileDatasetBase {
@@ -689,7 +860,10 @@ class CacheDatasetOp::FileDataset : public CacheDatasetOp::FileDatasetBase {
     TF_RETURN_IF_ERROR(b->AddInputDataset(ctx, input_, &input_graph));
     Node* filename = nullptr;
     TF_RETURN_IF_ERROR(b->AddScalar(filename_, &filename));
-    TF_RETURN_IF_ERROR(b->AddDataset(this, {input_graph, filename}, output));
+    std::vector<std::pair<StringPiece, AttrValue>> attrs;
+    TF_RETURN_IF_ERROR(AddAttributes(b, &attrs));
+    TF_RETURN_IF_ERROR(
+        b->AddDataset(this, {input_graph, filename}, attrs, output));
     return OkStatus();
   }
 };
@@ -697,9 +871,9 @@ class CacheDatasetOp::FileDataset : public CacheDatasetOp::FileDatasetBase {
 class CacheDatasetOp::FileDatasetV2 : public CacheDatasetOp::FileDatasetBase {
  public:
   explicit FileDatasetV2(OpKernelContext* ctx, const DatasetBase* input,
-                         string filename, Env* env,
+                         string filename, Env* env, bool mmap_cache,
                          const Tensor& resource_handle)
-      : FileDatasetBase(ctx, input, filename, env),
+      : FileDatasetBase(ctx, input, filename, env, mmap_cache),
         resource_handle_(resource_handle) {}
 
  protected:
@@ -712,8 +886,11 @@ class CacheDatasetOp::FileDatasetV2 : public CacheDatasetOp::FileDatasetBase {
     TF_RETURN_IF_ERROR(b->AddScalar(filename_, &filename_node));
     Node* resource_handle_node = nullptr;
     TF_RETURN_IF_ERROR(b->AddTensor(resource_handle_, &resource_handle_node));
+    std::vector<std::pair<StringPiece, AttrValue>> attrs;
+    TF_RETURN_IF_ERROR(AddAttributes(b, &attrs));
     TF_RETURN_IF_ERROR(b->AddDataset(
-        this, {input_node, filename_node, resource_handle_node}, output));
+        this, {input_node, filename_node, resource_handle_node}, attrs,
+        output));
     return OkStatus();
   }
 
@@ -1112,7 +1289,14 @@ class CacheDatasetOp::MemoryDatasetV2
 
 CacheDatasetOp::CacheDatasetOp(OpKernelConstruction* ctx)
     : UnaryDatasetOpKernel(ctx),
-      op_version_(ctx->def().op() == kCacheDataset ? 1 : 2) {}
+      op_version_(ctx->def().op() == kCacheDataset ? 1 : 2),
+      mmap_cache_(false) {
+  if (ctx->HasAttr(kCacheFormat)) {
+    string cache_format;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kCacheFormat, &cache_format));
+    mmap_cache_ = cache_format == kMmapCacheFormat;
+  }
+}
 
 void CacheDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
                                  DatasetBase** output) {
@@ -1161,10 +1345,10 @@ void CacheDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
     }
   } else {
     if (op_version_ == 2) {
-      *output =
-          new FileDatasetV2(ctx, input, filename, ctx->env(), ctx->input(2));
+      *output = new FileDatasetV2(ctx, input, filename, ctx->env(),
+                                  mmap_cache_, ctx->input(2));
     } else {
-      *output = new FileDataset(ctx, input, filename, ctx->env());
+      *output = new FileDataset(ctx, input, filename, ctx->env(), mmap_cache_);
     }
   }
 }
@@ -30,6 +30,7 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
   static constexpr const char* const kFileName = "filename";
   static constexpr const char* const kOutputTypes = "output_types";
   static constexpr const char* const kOutputShapes = "output_shapes";
+  static constexpr const char* const kCacheFormat = "cache_format";
 
   explicit CacheDatasetOp(OpKernelConstruction* ctx);
 
@@ -44,6 +45,8 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
   class MemoryDatasetV2;
 
   const int op_version_;
+  // Added by Alpa. Whether file caches use the memory-mapped format.
+  bool mmap_cache_;
 };
 
 }  // namespace data
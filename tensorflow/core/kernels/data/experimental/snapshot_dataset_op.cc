@@ -101,7 +101,8 @@ class SnapshotDatasetV2Op::Dataset : public DatasetBase {
  public:
   Dataset(OpKernelContext* ctx, const DatasetBase* input, uint64 hash,
           const std::string& path, const std::string& compression,
-          const std::string& reader_prefix, const std::string& writer_prefix,
+          int version, const std::string& reader_prefix,
+          const std::string& writer_prefix,
           std::unique_ptr<CapturedFunction> reader_func,
           std::unique_ptr<CapturedFunction> shard_func)
       : DatasetBase(DatasetContext(ctx)),
@@ -109,6 +110,7 @@ class SnapshotDatasetV2Op::Dataset : public DatasetBase {
         hash_(hash),
         path_(path),
         compression_(compression),
+        version_(version),
         reader_prefix_(reader_prefix),
         writer_prefix_(writer_prefix),
         reader_func_(std::move(reader_func)),
@@ -174,7 +176,11 @@ class SnapshotDatasetV2Op::Dataset : public DatasetBase {
                                                &shard_func_other_args_types));
 
     AttrValue compression_attr;
-    b->BuildAttrValue(compression_, &compression_attr);
+    // Added by Alpa: only AUTO writes the adaptive file format.
+    b->BuildAttrValue(version_ == snapshot_util::kAdaptiveFileFormatVersion
+                          ? std::string(kCompressionAuto)
+                          : compression_,
+                      &compression_attr);
 
     AttrValue reader_prefix_attr;
     b->BuildAttrValue(reader_prefix_, &reader_prefix_attr);
@@ -227,6 +233,8 @@ class SnapshotDatasetV2Op::Dataset : public DatasetBase {
   const uint64 hash_;
   const tstring path_;
   const std::string compression_;
+  // Added by Alpa. The file format version of the written snapshots.
+  const int version_;
   const std::string reader_prefix_;
   const std::string writer_prefix_;
 
@@ -414,7 +422,8 @@ class SnapshotDatasetV2Op::Dataset : public DatasetBase {
           auto writer = std::make_unique<snapshot_util::AsyncWriter>(
               ctx->env(), shard_index, snapshot_shard_directory,
               current_checkpoint_id_, dataset()->compression_,
-              kFileFormatVersion, dataset()->output_dtypes(), [this](Status s) {
+              dataset()->version_, dataset()->output_dtypes(),
+              [this](Status s) {
                 if (!s.ok()) {
                   LOG(ERROR) << "AsyncWriter in snapshot writer failed: " << s;
                   mutex_lock l(writer_status_mu_);
@@ -497,7 +506,7 @@ class SnapshotDatasetV2Op::Dataset : public DatasetBase {
       metadata.set_creation_timestamp(EnvTime::NowMicros());
       metadata.set_graph_hash(strings::StrCat(dataset()->hash_));
       metadata.set_run_id(strings::StrCat(run_id_));
-      metadata.set_version(kFileFormatVersion);
+      metadata.set_version(dataset()->version_);
       for (const auto& output_dtype : dataset()->output_dtypes()) {
         metadata.add_dtype(output_dtype);
       }
@@ -745,6 +754,11 @@ void SnapshotDatasetV2Op::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
   std::string compression = compression_ == kCompressionAuto
                                 ? io::compression::kSnappy
                                 : compression_;
+  // Added by Alpa: AUTO writes chunks that are only compressed with snappy
+  // when that is cheaper than writing them uncompressed.
+  const int version = compression_ == kCompressionAuto
+                          ? snapshot_util::kAdaptiveFileFormatVersion
+                          : kFileFormatVersion;
   uint64 hash;
   if (hash_valid_) {
     hash = hash_;
@@ -772,8 +786,8 @@ void SnapshotDatasetV2Op::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
                                           kShardFuncOtherArgs, &shard_func));
 
   *output = new SnapshotDatasetV2Op::Dataset(
-      ctx, input, hash, path, compression, reader_prefix_, writer_prefix_,
-      std::move(reader_func), std::move(shard_func));
+      ctx, input, hash, path, compression, version, reader_prefix_,
+      writer_prefix_, std::move(reader_func), std::move(shard_func));
 }
 
 namespace {
@@ -43,6 +43,9 @@ constexpr char kGcsFsPrefix[] = "gs://";
 constexpr char kS3FsPrefix[] = "s3://";
 constexpr int64_t kCloudTpuBlockSize = 127LL << 20;  // 127MB.
 constexpr int64_t kS3BlockSize = kCloudTpuBlockSize;
+// Added by Alpa. The number of buffered reads kept in flight when reading local
+// files, whose filesystem serves them asynchronously.
+constexpr int64_t kLocalAsyncReadDepth = 4;
 
 bool is_cloud_tpu_gcs_fs() {
 #if (defined(PLATFORM_CLOUD_TPU) && defined(TPU_GCS_FS)) || \
@@ -55,7 +58,8 @@ bool is_cloud_tpu_gcs_fs() {
 class TFRecordDatasetOp::Dataset : public DatasetBase {
  public:
   explicit Dataset(OpKernelContext* ctx, std::vector<string> filenames,
-                   const string& compression_type, int64_t buffer_size)
+                   const string& compression_type, int64_t buffer_size,
+                   bool is_local_fs)
       : DatasetBase(DatasetContext(ctx)),
         filenames_(std::move(filenames)),
         compression_type_(compression_type),
@@ -63,6 +67,9 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
             compression_type)) {
     if (buffer_size > 0) {
       options_.buffer_size = buffer_size;
+      if (is_local_fs) {
+        options_.async_read_depth = kLocalAsyncReadDepth;
+      }
     }
   }
 
@@ -288,6 +295,7 @@ void TFRecordDatasetOp::MakeDataset(OpKernelContext* ctx,
 
   bool is_gcs_fs = true;
   bool is_s3_fs = true;
+  bool is_local_fs = true;
   std::vector<string> filenames;
   filenames.reserve(filenames_tensor->NumElements());
   for (int i = 0; i < filenames_tensor->NumElements(); ++i) {
@@ -295,6 +303,8 @@ void TFRecordDatasetOp::MakeDataset(OpKernelContext* ctx,
     filenames.push_back(filenames_tensor->flat<tstring>()(i));
     is_gcs_fs &= absl::StartsWith(filenames[i], kGcsFsPrefix);
     is_s3_fs &= absl::StartsWith(filenames[i], kS3FsPrefix);
+    is_local_fs &= !absl::StrContains(filenames[i], "://") ||
+                   absl::StartsWith(filenames[i], "file://");
     metrics::RecordTFDataFilename(kDatasetType, filenames[i]);
   }
 
@@ -325,7 +335,8 @@ void TFRecordDatasetOp::MakeDataset(OpKernelContext* ctx,
   }
 
   *output =
-      new Dataset(ctx, std::move(filenames), compression_type, buffer_size);
+      new Dataset(ctx, std::move(filenames), compression_type, buffer_size,
+                  is_local_fs);
 }
 
 namespace {
@@ -0,0 +1,424 @@
+// This file contains the CPU and GPU kernels of EmbeddingLookupSparse and
+// EmbeddingLookupSparseGrad.
+
+#define EIGEN_USE_THREADS
+
+#if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+#define EIGEN_USE_GPU
+#endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+
+#include "tensorflow/core/kernels/embedding_lookup_sparse_op.h"
+
+#include <algorithm>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/platform/errors.h"
+
+namespace tensorflow {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+typedef Eigen::GpuDevice GPUDevice;
+
+namespace functor {
+
+template <typename T>
+using ConstEmbeddingRow = Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>;
+template <typename T>
+using EmbeddingRow = Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>>;
+
+template <typename T, typename Index, typename SegmentId>
+struct EmbeddingLookupSparse<CPUDevice, T, Index, SegmentId> {
+  void operator()(const CPUDevice& d, EmbeddingCombiner combiner,
+                  const T* params, int64_t num_rows, int64_t dim,
+                  const Index* indices, const SegmentId* segment_ids,
+                  const T* weights, int64_t num_ids, int64_t num_segments,
+                  T* output) {
+    auto combine_segments = [=](Eigen::Index begin, Eigen::Index end) {
+      // The ids of the segments [begin, end) are contiguous since the segment
+      // ids are sorted.
+      int64_t i =
+          std::lower_bound(segment_ids, segment_ids + num_ids, begin) -
+          segment_ids;
+      for (Eigen::Index s = begin; s < end; ++s) {
+        EmbeddingRow<T> out(output + s * dim, dim);
+        out.setZero();
+        T weight_sum = 0;
+        T weight_square_sum = 0;
+        for (; i < num_ids && segment_ids[i] == s; ++i) {
+          const T weight = weights == nullptr ? T(1) : weights[i];
+          out += weight * ConstEmbeddingRow<T>(
+                              params + static_cast<int64_t>(indices[i]) * dim,
+                              dim);
+          weight_sum += weight;
+          weight_square_sum += weight * weight;
+        }
+        out *= EmbeddingCombinerScale(combiner, weight_sum, weight_square_sum);
+      }
+    };
+    // Each segment reads its rows once and writes its output row once.
+    const double ids_per_segment =
+        static_cast<double>(num_ids) / std::max<int64_t>(num_segments, 1);
+    const Eigen::TensorOpCost cost(
+        /*bytes_loaded=*/ids_per_segment * (dim * sizeof(T) + sizeof(Index)),
+        /*bytes_stored=*/dim * sizeof(T),
+        /*compute_cycles=*/2 * ids_per_segment * dim);
+    d.parallelFor(num_segments, cost, combine_segments);
+  }
+};
+
+template <typename T, typename Index, typename SegmentId>
+struct EmbeddingLookupSparseGrad<CPUDevice, T, Index, SegmentId> {
+  void operator()(const CPUDevice& d, EmbeddingCombiner combiner,
+                  const T* grad, const T* params, int64_t num_rows,
+                  int64_t dim, const Index* indices,
+                  const SegmentId* segment_ids, const T* weights,
+                  const T* output, int64_t num_ids, int64_t num_segments,
+                  T* params_grad, T* weights_grad) {
+    // The scale of every segment and, for the weights gradient, the dot
+    // product of its incoming gradient and its output.
+    std::vector<T> scales(num_segments);
+    std::vector<T> grad_dot_outputs(weights_grad == nullptr ? 0
+                                                            : num_segments);
+    auto scale_segments = [&](Eigen::Index begin, Eigen::Index end) {
+      int64_t i =
+          std::lower_bound(segment_ids, segment_ids + num_ids, begin) -
+          segment_ids;
+      for (Eigen::Index s = begin; s < end; ++s) {
+        T weight_sum = 0;
+        T weight_square_sum = 0;
+        for (; i < num_ids && segment_ids[i] == s; ++i) {
+          const T weight = weights == nullptr ? T(1) : weights[i];
+          weight_sum += weight;
+          weight_square_sum += weight * weight;
+        }
+        scales[s] =
+            EmbeddingCombinerScale(combiner, weight_sum, weight_square_sum);
+        if (weights_grad != nullptr) {
+          grad_dot_outputs[s] = (ConstEmbeddingRow<T>(grad + s * dim, dim) *
+                                 ConstEmbeddingRow<T>(output + s * dim, dim))
+                                    .sum();
+        }
+      }
+    };
+    const double ids_per_segment =
+        static_cast<double>(num_ids) / std::max<int64_t>(num_segments, 1);
+    d.parallelFor(num_segments,
+                  Eigen::TensorOpCost(
+                      /*bytes_loaded=*/ids_per_segment * sizeof(T) +
+                          (weights_grad == nullptr ? 0 : 2 * dim * sizeof(T)),
+                      /*bytes_stored=*/sizeof(T),
+                      /*compute_cycles=*/2 * ids_per_segment + 2 * dim),
+                  scale_segments);
+
+    auto scatter_ids = [&](Eigen::Index begin, Eigen::Index end) {
+      for (Eigen::Index i = begin; i < end; ++i) {
+        const int64_t s = segment_ids[i];
+        const T weight = weights == nullptr ? T(1) : weights[i];
+        const T scale = scales[s];
+        ConstEmbeddingRow<T> grad_row(grad + s * dim, dim);
+        EmbeddingRow<T>(params_grad + i * dim, dim) =
+            (weight * scale) * grad_row;
+        if (weights_grad == nullptr) continue;
+        // d output[s] / d weights[i] is params[indices[i]] * scale minus, for
+        // the mean and sqrtn combiners, the derivative of the scale.
+        const T grad_dot_row =
+            (grad_row * ConstEmbeddingRow<T>(
+                            params + static_cast<int64_t>(indices[i]) * dim,
+                            dim))
+                .sum();
+        T scale_derivative = 0;
+        if (combiner == EmbeddingCombiner::kMean) {
+          scale_derivative = scale;
+        } else if (combiner == EmbeddingCombiner::kSqrtN) {
+          scale_derivative = weight * scale * scale;
+        }
+        weights_grad[i] =
+            scale * grad_dot_row - grad_dot_outputs[s] * scale_derivative;
+      }
+    };
+    d.parallelFor(num_ids,
+                  Eigen::TensorOpCost(
+                      /*bytes_loaded=*/(weights_grad == nullptr ? 1 : 2) *
+                          dim * sizeof(T),
+                      /*bytes_stored=*/dim * sizeof(T),
+                      /*compute_cycles=*/3 * dim),
+                  scatter_ids);
+  }
+};
+
+}  // namespace functor
+
+namespace {
+
+Status ParseEmbeddingCombiner(const std::string& name,
+                              EmbeddingCombiner* combiner) {
+  if (name == "sum") {
+    *combiner = EmbeddingCombiner::kSum;
+  } else if (name == "mean") {
+    *combiner = EmbeddingCombiner::kMean;
+  } else if (name == "sqrtn") {
+    *combiner = EmbeddingCombiner::kSqrtN;
+  } else {
+    return errors::InvalidArgument("Unknown combiner: ", name);
+  }
+  return OkStatus();
+}
+
+// Checks that the ids are in range and that the segment ids are sorted. Only
+// the CPU kernels check the ids, since they are not in host memory on GPU; the
+// GPU kernels skip the rows and segments that are out of range.
+template <typename Index, typename SegmentId>
+Status ValidateEmbeddingIds(const Index* indices, const SegmentId* segment_ids,
+                            int64_t num_ids, int64_t num_rows,
+                            int64_t num_segments) {
+  for (int64_t i = 0; i < num_ids; ++i) {
+    if (!FastBoundsCheck(indices[i], num_rows)) {
+      return errors::InvalidArgument("indices[", i, "] = ", indices[i],
+                                     " is not in [0, ", num_rows, ")");
+    }
+    if (!FastBoundsCheck(segment_ids[i], num_segments)) {
+      return errors::InvalidArgument("segment_ids[", i, "] = ", segment_ids[i],
+                                     " is not in [0, ", num_segments, ")");
+    }
+    if (i > 0 && segment_ids[i] < segment_ids[i - 1]) {
+      return errors::InvalidArgument("segment_ids are not sorted: ",
+                                     "segment_ids[", i, "] = ", segment_ids[i],
+                                     " < segment_ids[", i - 1,
+                                     "] = ", segment_ids[i - 1]);
+    }
+  }
+  return OkStatus();
+}
+
+// Checks the shapes of the ids and weights shared by the forward and backward
+// ops.
+Status ValidateEmbeddingInputs(const Tensor& params, const Tensor& indices,
+                               const Tensor& segment_ids,
+                               const Tensor& weights) {
+  if (params.dims() < 1) {
+    return errors::InvalidArgument("params must have at least 1 dimension: ",
+                                   params.shape().DebugString());
+  }
+  if (!TensorShapeUtils::IsVector(indices.shape()) ||
+      !TensorShapeUtils::IsVector(segment_ids.shape()) ||
+      indices.NumElements() != segment_ids.NumElements()) {
+    return errors::InvalidArgument(
+        "indices and segment_ids must be vectors of the same size, got ",
+        indices.shape().DebugString(), " and ",
+        segment_ids.shape().DebugString());
+  }
+  if (weights.NumElements() != 0 &&
+      (!TensorShapeUtils::IsVector(weights.shape()) ||
+       weights.NumElements() != indices.NumElements())) {
+    return errors::InvalidArgument(
+        "weights must be empty or a vector of the size of indices, got ",
+        weights.shape().DebugString(), " and ", indices.shape().DebugString());
+  }
+  return OkStatus();
+}
+
+}  // namespace
+
+template <typename Device, typename T, typename Index, typename SegmentId>
+class EmbeddingLookupSparseOp : public OpKernel {
+ public:
+  explicit EmbeddingLookupSparseOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    std::string combiner;
+    OP_REQUIRES_OK(context, context->GetAttr("combiner", &combiner));
+    OP_REQUIRES_OK(context, ParseEmbeddingCombiner(combiner, &combiner_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& params = context->input(0);
+    const Tensor& indices = context->input(1);
+    const Tensor& segment_ids = context->input(2);
+    const Tensor& weights = context->input(3);
+    const Tensor& num_segments_t = context->input(4);
+    OP_REQUIRES_OK(context, ValidateEmbeddingInputs(params, indices,
+                                                    segment_ids, weights));
+    OP_REQUIRES(context, TensorShapeUtils::IsScalar(num_segments_t.shape()),
+                errors::InvalidArgument("num_segments must be a scalar: ",
+                                        num_segments_t.shape().DebugString()));
+    const int64_t num_segments = num_segments_t.dtype() == DT_INT32
+                                     ? num_segments_t.scalar<int32>()()
+                                     : num_segments_t.scalar<int64_t>()();
+    OP_REQUIRES(context, num_segments >= 0,
+                errors::InvalidArgument("num_segments must be non-negative: ",
+                                        num_segments));
+
+    TensorShape output_shape = params.shape();
+    output_shape.set_dim(0, num_segments);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+
+    const int64_t num_rows = params.dim_size(0);
+    const int64_t dim = output->NumElements() / num_segments;
+    const int64_t num_ids = indices.NumElements();
+    if (std::is_same<Device, CPUDevice>::value) {
+      OP_REQUIRES_OK(context, ValidateEmbeddingIds(
+                                  indices.flat<Index>().data(),
+                                  segment_ids.flat<SegmentId>().data(),
+                                  num_ids, num_rows, num_segments));
+    }
+    functor::EmbeddingLookupSparse<Device, T, Index, SegmentId>()(
+        context->eigen_device<Device>(), combiner_, params.flat<T>().data(),
+        num_rows, dim, indices.flat<Index>().data(),
+        segment_ids.flat<SegmentId>().data(),
+        weights.NumElements() == 0 ? nullptr : weights.flat<T>().data(),
+        num_ids, num_segments, output->flat<T>().data());
+  }
+
+ private:
+  EmbeddingCombiner combiner_;
+};
+
+template <typename Device, typename T, typename Index, typename SegmentId>
+class EmbeddingLookupSparseGradOp : public OpKernel {
+ public:
+  explicit EmbeddingLookupSparseGradOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    std::string combiner;
+    OP_REQUIRES_OK(context, context->GetAttr("combiner", &combiner));
+    OP_REQUIRES_OK(context, ParseEmbeddingCombiner(combiner, &combiner_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& grad = context->input(0);
+    const Tensor& params = context->input(1);
+    const Tensor& indices = context->input(2);
+    const Tensor& segment_ids = context->input(3);
+    const Tensor& weights = context->input(4);
+    const Tensor& output = context->input(5);
+    OP_REQUIRES_OK(context, ValidateEmbeddingInputs(params, indices,
+                                                    segment_ids, weights));
+    OP_REQUIRES(
+        context,
+        grad.dims() == params.dims() && grad.IsSameSize(output),
+        errors::InvalidArgument(
+            "grad and output must have the same shape and the rank of params, "
+            "got grad ",
+            grad.shape().DebugString(), ", output ",
+            output.shape().DebugString(), " and params ",
+            params.shape().DebugString()));
+    for (int d = 1; d < params.dims(); ++d) {
+      OP_REQUIRES(context, grad.dim_size(d) == params.dim_size(d),
+                  errors::InvalidArgument(
+                      "grad and params must have the same row shape, got ",
+                      grad.shape().DebugString(), " and ",
+                      params.shape().DebugString()));
+    }
+
+    const int64_t num_ids = indices.NumElements();
+    TensorShape params_grad_shape = params.shape();
+    params_grad_shape.set_dim(0, num_ids);
+    Tensor* params_grad = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, params_grad_shape,
+                                                     &params_grad));
+    Tensor* weights_grad = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(1, weights.shape(),
+                                                     &weights_grad));
+    if (params_grad->NumElements() == 0) return;
+
+    const int64_t num_rows = params.dim_size(0);
+    const int64_t num_segments = grad.dim_size(0);
+    const int64_t dim = params_grad->NumElements() / num_ids;
+    if (std::is_same<Device, CPUDevice>::value) {
+      OP_REQUIRES_OK(context, ValidateEmbeddingIds(
+                                  indices.flat<Index>().data(),
+                                  segment_ids.flat<SegmentId>().data(),
+                                  num_ids, num_rows, num_segments));
+    }
+    const bool weighted = weights.NumElements() != 0;
+    functor::EmbeddingLookupSparseGrad<Device, T, Index, SegmentId>()(
+        context->eigen_device<Device>(), combiner_, grad.flat<T>().data(),
+        params.flat<T>().data(), num_rows, dim, indices.flat<Index>().data(),
+        segment_ids.flat<SegmentId>().data(),
+        weighted ? weights.flat<T>().data() : nullptr,
+        output.flat<T>().data(), num_ids, num_segments,
+        params_grad->flat<T>().data(),
+        weighted ? weights_grad->flat<T>().data() : nullptr);
+  }
+
+ private:
+  EmbeddingCombiner combiner_;
+};
+
+#define REGISTER_KERNELS(DEVICE, D, T, Index, SegmentId)                  \
+  REGISTER_KERNEL_BUILDER(Name("EmbeddingLookupSparse")                   \
+                              .Device(DEVICE)                             \
+                              .HostMemory("num_segments")                 \
+                              .TypeConstraint<T>("T")                     \
+                              .TypeConstraint<Index>("Tidx")              \
+                              .TypeConstraint<SegmentId>("Tsegmentids"),  \
+                          EmbeddingLookupSparseOp<D, T, Index, SegmentId>); \
+  REGISTER_KERNEL_BUILDER(                                                \
+      Name("EmbeddingLookupSparseGrad")                                   \
+          .Device(DEVICE)                                                 \
+          .TypeConstraint<T>("T")                                         \
+          .TypeConstraint<Index>("Tidx")                                  \
+          .TypeConstraint<SegmentId>("Tsegmentids"),                      \
+      EmbeddingLookupSparseGradOp<D, T, Index, SegmentId>);
+
+#define REGISTER_KERNELS_FOR_ID_TYPES(DEVICE, D, T) \
+  REGISTER_KERNELS(DEVICE, D, T, int32, int32)      \
+  REGISTER_KERNELS(DEVICE, D, T, int32, int64_t)    \
+  REGISTER_KERNELS(DEVICE, D, T, int64_t, int32)    \
+  REGISTER_KERNELS(DEVICE, D, T, int64_t, int64_t)
+
+#define REGISTER_CPU(T) REGISTER_KERNELS_FOR_ID_TYPES(DEVICE_CPU, CPUDevice, T)
+
+TF_CALL_float(REGISTER_CPU);
+TF_CALL_double(REGISTER_CPU);
+#undef REGISTER_CPU
+
+#if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+namespace functor {
+#define DECLARE_GPU_SPEC(T, Index, SegmentId)                                \
+  template <>                                                                \
+  void EmbeddingLookupSparse<GPUDevice, T, Index, SegmentId>::operator()(    \
+      const GPUDevice& d, EmbeddingCombiner combiner, const T* params,       \
+      int64_t num_rows, int64_t dim, const Index* indices,                   \
+      const SegmentId* segment_ids, const T* weights, int64_t num_ids,       \
+      int64_t num_segments, T* output);                                      \
+  template <>                                                                \
+  void EmbeddingLookupSparseGrad<GPUDevice, T, Index, SegmentId>::operator()( \
+      const GPUDevice& d, EmbeddingCombiner combiner, const T* grad,         \
+      const T* params, int64_t num_rows, int64_t dim, const Index* indices,  \
+      const SegmentId* segment_ids, const T* weights, const T* output,       \
+      int64_t num_ids, int64_t num_segments, T* params_grad,                 \
+      T* weights_grad);
+
+#define DECLARE_GPU_SPECS(T)             \
+  DECLARE_GPU_SPEC(T, int32, int32)      \
+  DECLARE_GPU_SPEC(T, int32, int64_t)    \
+  DECLARE_GPU_SPEC(T, int64_t, int32)    \
+  DECLARE_GPU_SPEC(T, int64_t, int64_t)
+
+TF_CALL_float(DECLARE_GPU_SPECS);
+TF_CALL_double(DECLARE_GPU_SPECS);
+#undef DECLARE_GPU_SPECS
+#undef DECLARE_GPU_SPEC
+}  // namespace functor
+
+#define REGISTER_GPU(T) REGISTER_KERNELS_FOR_ID_TYPES(DEVICE_GPU, GPUDevice, T)
+
+TF_CALL_float(REGISTER_GPU);
+TF_CALL_double(REGISTER_GPU);
+#undef REGISTER_GPU
+#endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+
+#undef REGISTER_KERNELS_FOR_ID_TYPES
+#undef REGISTER_KERNELS
+
+}  // namespace tensorflow
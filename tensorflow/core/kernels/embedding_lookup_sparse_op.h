@@ -0,0 +1,70 @@
+// This file contains the functors of EmbeddingLookupSparse and its gradient,
+// which gather the rows of an embedding table and combine them per segment in
+// one pass, without materializing the gathered rows.
+
+#ifndef TENSORFLOW_CORE_KERNELS_EMBEDDING_LOOKUP_SPARSE_OP_H_
+#define TENSORFLOW_CORE_KERNELS_EMBEDDING_LOOKUP_SPARSE_OP_H_
+
+#include <cstdint>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+
+namespace tensorflow {
+
+enum class EmbeddingCombiner { kSum, kMean, kSqrtN };
+
+namespace functor {
+
+// Returns the factor that a segment with the sum of weights `weight_sum` and
+// the sum of squared weights `weight_square_sum` is scaled by. Like the
+// div_no_nan of the unfused lookup, an empty segment is scaled by 0.
+template <typename T>
+EIGEN_DEVICE_FUNC inline T EmbeddingCombinerScale(EmbeddingCombiner combiner,
+                                                  T weight_sum,
+                                                  T weight_square_sum) {
+  switch (combiner) {
+    case EmbeddingCombiner::kSum:
+      return T(1);
+    case EmbeddingCombiner::kMean:
+      return weight_sum == T(0) ? T(0) : T(1) / weight_sum;
+    case EmbeddingCombiner::kSqrtN:
+      return weight_square_sum == T(0)
+                 ? T(0)
+                 : T(1) / Eigen::numext::sqrt(weight_square_sum);
+  }
+  return T(0);
+}
+
+// Computes, for `params` of shape [num_rows, dim], `indices`, `segment_ids`
+// and `weights` of shape [num_ids] and `output` of shape [num_segments, dim]:
+//   output[s, :] = scale[s] * sum_{i : segment_ids[i] == s}
+//                                 weights[i] * params[indices[i], :]
+// where scale[s] is given by EmbeddingCombinerScale. `segment_ids` must be
+// sorted. `weights` may be null, in which case all weights are 1.
+template <typename Device, typename T, typename Index, typename SegmentId>
+struct EmbeddingLookupSparse {
+  void operator()(const Device& d, EmbeddingCombiner combiner, const T* params,
+                  int64_t num_rows, int64_t dim, const Index* indices,
+                  const SegmentId* segment_ids, const T* weights,
+                  int64_t num_ids, int64_t num_segments, T* output);
+};
+
+// Computes the gradient of EmbeddingLookupSparse for the incoming gradient
+// `grad` of shape [num_segments, dim] and the forward `output`:
+//   params_grad[i, :] = weights[i] * scale[s] * grad[s, :]
+// with s = segment_ids[i], so that `params_grad` and `indices` are the values
+// and indices of the IndexedSlices gradient of `params`. If `weights_grad` is
+// not null, it is set to the gradient of the weights.
+template <typename Device, typename T, typename Index, typename SegmentId>
+struct EmbeddingLookupSparseGrad {
+  void operator()(const Device& d, EmbeddingCombiner combiner, const T* grad,
+                  const T* params, int64_t num_rows, int64_t dim,
+                  const Index* indices, const SegmentId* segment_ids,
+                  const T* weights, const T* output, int64_t num_ids,
+                  int64_t num_segments, T* params_grad, T* weights_grad);
+};
+
+}  // namespace functor
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_EMBEDDING_LOOKUP_SPARSE_OP_H_
@@ -0,0 +1,178 @@
+// This file contains the GPU implementation of the EmbeddingLookupSparse and
+// EmbeddingLookupSparseGrad functors.
+
+#if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+
+#define EIGEN_USE_GPU
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/kernels/embedding_lookup_sparse_op.h"
+#include "tensorflow/core/kernels/gpu_prim.h"
+#include "tensorflow/core/util/gpu_kernel_helper.h"
+
+namespace tensorflow {
+
+typedef Eigen::GpuDevice GPUDevice;
+
+namespace {
+
+constexpr int kThreadsPerRow = 128;
+
+// Returns the first position of `segment_ids` that is not less than `s`.
+template <typename SegmentId>
+__device__ int64_t SegmentBegin(const SegmentId* __restrict__ segment_ids,
+                                int64_t num_ids, int64_t s) {
+  int64_t begin = 0;
+  int64_t end = num_ids;
+  while (begin < end) {
+    const int64_t mid = begin + (end - begin) / 2;
+    if (static_cast<int64_t>(segment_ids[mid]) < s) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+  return begin;
+}
+
+// Combines one segment per block. The threads of the block read consecutive
+// columns of each row of the segment, so that the row loads are coalesced,
+// and accumulate them in registers. Ids out of [0, num_rows) are skipped.
+template <typename T, typename Index, typename SegmentId>
+__global__ __launch_bounds__(kThreadsPerRow) void EmbeddingLookupSparseKernel(
+    EmbeddingCombiner combiner, const T* __restrict__ params, int64_t num_rows,
+    int64_t dim, const Index* __restrict__ indices,
+    const SegmentId* __restrict__ segment_ids, const T* __restrict__ weights,
+    int64_t num_ids, T* __restrict__ output) {
+  const int64_t s = blockIdx.x;
+  const int64_t begin = SegmentBegin(segment_ids, num_ids, s);
+  const int64_t end = SegmentBegin(segment_ids, num_ids, s + 1);
+  T weight_sum = 0;
+  T weight_square_sum = 0;
+  for (int64_t i = begin; i < end; ++i) {
+    const T weight = weights == nullptr ? T(1) : weights[i];
+    weight_sum += weight;
+    weight_square_sum += weight * weight;
+  }
+  const T scale =
+      functor::EmbeddingCombinerScale(combiner, weight_sum, weight_square_sum);
+  for (int64_t c = threadIdx.x; c < dim; c += kThreadsPerRow) {
+    T sum = 0;
+    for (int64_t i = begin; i < end; ++i) {
+      const int64_t row = indices[i];
+      if (row < 0 || row >= num_rows) continue;
+      const T weight = weights == nullptr ? T(1) : weights[i];
+      sum += weight * ldg(params + row * dim + c);
+    }
+    output[s * dim + c] = sum * scale;
+  }
+}
+
+// Computes the gradient of one id per block. The weights gradient is reduced
+// over the columns of the block.
+template <typename T, typename Index, typename SegmentId>
+__global__ __launch_bounds__(kThreadsPerRow) void
+    EmbeddingLookupSparseGradKernel(
+        EmbeddingCombiner combiner, const T* __restrict__ grad,
+        const T* __restrict__ params, int64_t num_rows, int64_t dim,
+        const Index* __restrict__ indices,
+        const SegmentId* __restrict__ segment_ids,
+        const T* __restrict__ weights, const T* __restrict__ output,
+        int64_t num_ids, int64_t num_segments, T* __restrict__ params_grad,
+        T* __restrict__ weights_grad) {
+  typedef gpuprim::BlockReduce<T, kThreadsPerRow> BlockReduce;
+  __shared__ typename BlockReduce::TempStorage temp_storage;
+
+  const int64_t i = blockIdx.x;
+  const int64_t s = segment_ids[i];
+  const int64_t row = indices[i];
+  const bool valid =
+      s >= 0 && s < num_segments && row >= 0 && row < num_rows;
+  T scale = 0;
+  if (valid) {
+    const int64_t begin = SegmentBegin(segment_ids, num_ids, s);
+    const int64_t end = SegmentBegin(segment_ids, num_ids, s + 1);
+    T weight_sum = 0;
+    T weight_square_sum = 0;
+    for (int64_t j = begin; j < end; ++j) {
+      const T weight = weights == nullptr ? T(1) : weights[j];
+      weight_sum += weight;
+      weight_square_sum += weight * weight;
+    }
+    scale = functor::EmbeddingCombinerScale(combiner, weight_sum,
+                                            weight_square_sum);
+  }
+  const T weight = weights == nullptr ? T(1) : weights[i];
+
+  T grad_dot_row = 0;
+  T grad_dot_output = 0;
+  for (int64_t c = threadIdx.x; c < dim; c += kThreadsPerRow) {
+    const T g = valid ? ldg(grad + s * dim + c) : T(0);
+    params_grad[i * dim + c] = weight * scale * g;
+    if (weights_grad != nullptr && valid) {
+      grad_dot_row += g * ldg(params + row * dim + c);
+      grad_dot_output += g * ldg(output + s * dim + c);
+    }
+  }
+  if (weights_grad == nullptr) return;
+  grad_dot_row = BlockReduce(temp_storage).Sum(grad_dot_row);
+  __syncthreads();
+  grad_dot_output = BlockReduce(temp_storage).Sum(grad_dot_output);
+  if (threadIdx.x == 0) {
+    T scale_derivative = 0;
+    if (combiner == EmbeddingCombiner::kMean) {
+      scale_derivative = scale;
+    } else if (combiner == EmbeddingCombiner::kSqrtN) {
+      scale_derivative = weight * scale * scale;
+    }
+    weights_grad[i] = scale * grad_dot_row - grad_dot_output * scale_derivative;
+  }
+}
+
+}  // namespace
+
+namespace functor {
+
+#define DEFINE_GPU_SPEC(T, Index, SegmentId)                                 \
+  template <>                                                                \
+  void EmbeddingLookupSparse<GPUDevice, T, Index, SegmentId>::operator()(    \
+      const GPUDevice& d, EmbeddingCombiner combiner, const T* params,       \
+      int64_t num_rows, int64_t dim, const Index* indices,                   \
+      const SegmentId* segment_ids, const T* weights, int64_t num_ids,       \
+      int64_t num_segments, T* output) {                                     \
+    TF_CHECK_OK(GpuLaunchKernel(                                             \
+        EmbeddingLookupSparseKernel<T, Index, SegmentId>,                    \
+        static_cast<int>(num_segments), kThreadsPerRow, 0, d.stream(),       \
+        combiner, params, num_rows, dim, indices, segment_ids, weights,      \
+        num_ids, output));                                                   \
+  }                                                                          \
+  template <>                                                                \
+  void EmbeddingLookupSparseGrad<GPUDevice, T, Index, SegmentId>::operator()( \
+      const GPUDevice& d, EmbeddingCombiner combiner, const T* grad,         \
+      const T* params, int64_t num_rows, int64_t dim, const Index* indices,  \
+      const SegmentId* segment_ids, const T* weights, const T* output,       \
+      int64_t num_ids, int64_t num_segments, T* params_grad,                 \
+      T* weights_grad) {                                                     \
+    TF_CHECK_OK(GpuLaunchKernel(                                             \
+        EmbeddingLookupSparseGradKernel<T, Index, SegmentId>,                \
+        static_cast<int>(num_ids), kThreadsPerRow, 0, d.stream(), combiner,  \
+        grad, params, num_rows, dim, indices, segment_ids, weights, output,  \
+        num_ids, num_segments, params_grad, weights_grad));                  \
+  }
+
+#define DEFINE_GPU_SPECS(T)             \
+  DEFINE_GPU_SPEC(T, int32, int32)      \
+  DEFINE_GPU_SPEC(T, int32, int64_t)    \
+  DEFINE_GPU_SPEC(T, int64_t, int32)    \
+  DEFINE_GPU_SPEC(T, int64_t, int64_t)
+
+TF_CALL_float(DEFINE_GPU_SPECS);
+TF_CALL_double(DEFINE_GPU_SPECS);
+#undef DEFINE_GPU_SPECS
+#undef DEFINE_GPU_SPEC
+
+}  // namespace functor
+}  // namespace tensorflow
+
+#endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
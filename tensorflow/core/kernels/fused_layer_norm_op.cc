@@ -0,0 +1,138 @@
+// This file contains the CPU and GPU kernels of _FusedLayerNorm.
+
+#define EIGEN_USE_THREADS
+
+#if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+#define EIGEN_USE_GPU
+#endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+
+#include "tensorflow/core/kernels/fused_layer_norm_op.h"
+
+#include <cmath>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/platform/errors.h"
+
+namespace tensorflow {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+typedef Eigen::GpuDevice GPUDevice;
+
+namespace functor {
+
+template <typename T>
+struct FusedLayerNorm<CPUDevice, T> {
+  void operator()(const CPUDevice& d, const T* x, const T* scale,
+                  const T* offset, float epsilon, int64_t rows, int64_t cols,
+                  T* y) {
+    auto normalize_rows = [=](Eigen::Index begin, Eigen::Index end) {
+      for (Eigen::Index r = begin; r < end; ++r) {
+        const T* x_row = x + r * cols;
+        T* y_row = y + r * cols;
+        float mean = 0;
+        for (int64_t c = 0; c < cols; ++c) {
+          mean += static_cast<float>(x_row[c]);
+        }
+        mean /= cols;
+        float variance = 0;
+        for (int64_t c = 0; c < cols; ++c) {
+          const float centered = static_cast<float>(x_row[c]) - mean;
+          variance += centered * centered;
+        }
+        variance /= cols;
+        const float inv_stddev = 1.0f / std::sqrt(variance + epsilon);
+        for (int64_t c = 0; c < cols; ++c) {
+          y_row[c] = static_cast<T>(
+              (static_cast<float>(x_row[c]) - mean) * inv_stddev *
+                  static_cast<float>(scale[c]) +
+              static_cast<float>(offset[c]));
+        }
+      }
+    };
+    // Each row is read twice and written once.
+    const Eigen::TensorOpCost cost(/*bytes_loaded=*/2 * cols * sizeof(T),
+                                   /*bytes_stored=*/cols * sizeof(T),
+                                   /*compute_cycles=*/5 * cols);
+    d.parallelFor(rows, cost, normalize_rows);
+  }
+};
+
+}  // namespace functor
+
+template <typename Device, typename T>
+class FusedLayerNormOp : public OpKernel {
+ public:
+  explicit FusedLayerNormOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("epsilon", &epsilon_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& x = context->input(0);
+    const Tensor& scale = context->input(1);
+    const Tensor& offset = context->input(2);
+    OP_REQUIRES(context, x.dims() >= 1,
+                errors::InvalidArgument("x must have at least 1 dimension: ",
+                                        x.shape().DebugString()));
+    const int64_t cols = x.dim_size(x.dims() - 1);
+    OP_REQUIRES(
+        context,
+        scale.dims() == 1 && scale.dim_size(0) == cols &&
+            offset.dims() == 1 && offset.dim_size(0) == cols,
+        errors::InvalidArgument(
+            "scale and offset must be vectors of the size of the last "
+            "dimension of x, got x ",
+            x.shape().DebugString(), ", scale ", scale.shape().DebugString(),
+            " and offset ", offset.shape().DebugString()));
+
+    Tensor* y = nullptr;
+    OP_REQUIRES_OK(context, context->forward_input_or_allocate_output(
+                                {0}, 0, x.shape(), &y));
+    if (x.NumElements() == 0) return;
+    functor::FusedLayerNorm<Device, T>()(
+        context->eigen_device<Device>(), x.flat<T>().data(),
+        scale.flat<T>().data(), offset.flat<T>().data(), epsilon_,
+        x.NumElements() / cols, cols, y->flat<T>().data());
+  }
+
+ private:
+  float epsilon_;
+};
+
+#define REGISTER_CPU(T)                                                   \
+  REGISTER_KERNEL_BUILDER(                                                \
+      Name("_FusedLayerNorm").Device(DEVICE_CPU).TypeConstraint<T>("T"), \
+      FusedLayerNormOp<CPUDevice, T>);
+
+REGISTER_CPU(float);
+REGISTER_CPU(Eigen::half);
+#undef REGISTER_CPU
+
+#if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+namespace functor {
+#define DECLARE_GPU_SPEC(T)                                                   \
+  template <>                                                                 \
+  void FusedLayerNorm<GPUDevice, T>::operator()(                              \
+      const GPUDevice& d, const T* x, const T* scale, const T* offset,        \
+      float epsilon, int64_t rows, int64_t cols, T* y);
+
+DECLARE_GPU_SPEC(float);
+DECLARE_GPU_SPEC(Eigen::half);
+#undef DECLARE_GPU_SPEC
+}  // namespace functor
+
+#define REGISTER_GPU(T)                                                   \
+  REGISTER_KERNEL_BUILDER(                                                \
+      Name("_FusedLayerNorm").Device(DEVICE_GPU).TypeConstraint<T>("T"), \
+      FusedLayerNormOp<GPUDevice, T>);
+
+REGISTER_GPU(float);
+REGISTER_GPU(Eigen::half);
+#undef REGISTER_GPU
+#endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+
+}  // namespace tensorflow
@@ -0,0 +1,28 @@
+// This file contains the functor of _FusedLayerNorm, which normalizes its
+// input over the last dimension and then scales and offsets it, in one pass
+// over memory instead of the reshapes, batch norm, multiply and add that the
+// remapper replaces.
+
+#ifndef TENSORFLOW_CORE_KERNELS_FUSED_LAYER_NORM_OP_H_
+#define TENSORFLOW_CORE_KERNELS_FUSED_LAYER_NORM_OP_H_
+
+#include <cstdint>
+
+namespace tensorflow {
+namespace functor {
+
+// Computes, for `x` and `y` of shape [rows, cols] and `scale` and `offset` of
+// shape [cols]:
+//   y[r, c] = (x[r, c] - mean[r]) * rsqrt(variance[r] + epsilon) * scale[c] +
+//             offset[c]
+// where mean and variance are taken over the row and accumulated in float.
+template <typename Device, typename T>
+struct FusedLayerNorm {
+  void operator()(const Device& d, const T* x, const T* scale, const T* offset,
+                  float epsilon, int64_t rows, int64_t cols, T* y);
+};
+
+}  // namespace functor
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_FUSED_LAYER_NORM_OP_H_
@@ -0,0 +1,84 @@
+// This file contains the GPU implementation of the _FusedLayerNorm functor.
+
+#if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+
+#define EIGEN_USE_GPU
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/kernels/fused_layer_norm_op.h"
+#include "tensorflow/core/kernels/gpu_prim.h"
+#include "tensorflow/core/util/gpu_kernel_helper.h"
+
+namespace tensorflow {
+
+typedef Eigen::GpuDevice GPUDevice;
+
+namespace {
+
+constexpr int kThreadsPerRow = 256;
+
+// Normalizes one row of `x` per block. The row is read once for the mean,
+// once for the variance and once for the output, and stays in L1/L2 for the
+// last two reads on the row sizes of transformers.
+template <typename T>
+__global__ __launch_bounds__(kThreadsPerRow) void FusedLayerNormKernel(
+    const T* __restrict__ x, const T* __restrict__ scale,
+    const T* __restrict__ offset, float epsilon, int64_t cols,
+    T* __restrict__ y) {
+  typedef gpuprim::BlockReduce<float, kThreadsPerRow> BlockReduce;
+  __shared__ typename BlockReduce::TempStorage temp_storage;
+  __shared__ float row_mean;
+  __shared__ float row_inv_stddev;
+
+  const T* x_row = x + blockIdx.x * cols;
+  T* y_row = y + blockIdx.x * cols;
+
+  float sum = 0;
+  for (int64_t c = threadIdx.x; c < cols; c += kThreadsPerRow) {
+    sum += static_cast<float>(x_row[c]);
+  }
+  sum = BlockReduce(temp_storage).Sum(sum);
+  if (threadIdx.x == 0) row_mean = sum / cols;
+  __syncthreads();
+  const float mean = row_mean;
+
+  float sum_squares = 0;
+  for (int64_t c = threadIdx.x; c < cols; c += kThreadsPerRow) {
+    const float centered = static_cast<float>(x_row[c]) - mean;
+    sum_squares += centered * centered;
+  }
+  sum_squares = BlockReduce(temp_storage).Sum(sum_squares);
+  if (threadIdx.x == 0) row_inv_stddev = rsqrtf(sum_squares / cols + epsilon);
+  __syncthreads();
+  const float inv_stddev = row_inv_stddev;
+
+  for (int64_t c = threadIdx.x; c < cols; c += kThreadsPerRow) {
+    y_row[c] = static_cast<T>((static_cast<float>(x_row[c]) - mean) *
+                                  inv_stddev * static_cast<float>(scale[c]) +
+                              static_cast<float>(offset[c]));
+  }
+}
+
+}  // namespace
+
+namespace functor {
+
+#define DEFINE_GPU_SPEC(T)                                                    \
+  template <>                                                                 \
+  void FusedLayerNorm<GPUDevice, T>::operator()(                              \
+      const GPUDevice& d, const T* x, const T* scale, const T* offset,        \
+      float epsilon, int64_t rows, int64_t cols, T* y) {                      \
+    TF_CHECK_OK(GpuLaunchKernel(FusedLayerNormKernel<T>,                      \
+                                static_cast<int>(rows), kThreadsPerRow, 0,    \
+                                d.stream(), x, scale, offset, epsilon, cols,  \
+                                y));                                          \
+  }
+
+DEFINE_GPU_SPEC(float);
+DEFINE_GPU_SPEC(Eigen::half);
+#undef DEFINE_GPU_SPEC
+
+}  // namespace functor
+}  // namespace tensorflow
+
+#endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
@@ -16,9 +16,12 @@ limitations under the License.
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #define EIGEN_USE_THREADS
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/types.h"
@@ -26,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/initializable_lookup_table.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/prefetch.h"
 #include "tensorflow/core/platform/random.h"
 
 namespace tensorflow {
@@ -41,6 +45,9 @@ std::string UniqueNodeName(const std::string& base) {
 // required, use MutableHashTableOfTensors.
 //
 // This table is mutable and thread safe - Insert can be called at any time.
+// Added by Alpa: the keys are spread over the `num_shards` attribute many
+// shards, each with its own lock, so that the batches of concurrent Find and
+// Insert calls only contend on the shards they share.
 //
 // Sample use case:
 //
@@ -53,11 +60,23 @@ std::string UniqueNodeName(const std::string& base) {
 template <class K, class V>
 class MutableHashTableOfScalars final : public LookupInterface {
  public:
-  MutableHashTableOfScalars(OpKernelContext* ctx, OpKernel* kernel) {}
+  MutableHashTableOfScalars(OpKernelContext* ctx, OpKernel* kernel) {
+    int64_t num_shards = 1;
+    if (TryGetNodeAttr(kernel->def(), "num_shards", &num_shards)) {
+      OP_REQUIRES(ctx, num_shards >= 1,
+                  errors::InvalidArgument("num_shards must be positive, got: ",
+                                          num_shards));
+    }
+    shards_ = std::vector<Shard>(num_shards);
+  }
 
   size_t size() const override {
-    tf_shared_lock l(mu_);
-    return table_.size();
+    size_t size = 0;
+    for (const Shard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      size += shard.table.size();
+    }
+    return size;
   }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
@@ -70,18 +89,22 @@ class MutableHashTableOfScalars final : public LookupInterface {
     int64_t default_total = default_flat.size();
     bool is_full_size_default = (total == default_total);
 
-    tf_shared_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      // is_full_size_default is true:
-      //   Each key has an independent default value, key_values(i)
-      //   corresponding uses default_flat(i) as its default value.
-      //
-      // is_full_size_default is false:
-      //   All keys will share the default_flat(0) as default value.
-      value_values(i) = gtl::FindWithDefault(
-          table_, SubtleMustCopyIfIntegral(key_values(i)),
-          is_full_size_default ? default_flat(i) : default_flat(0));
-    }
+    ForEachShard(key_values, [&](const Shard& shard, const int64_t* indices,
+                                 int64_t num_indices) {
+      tf_shared_lock l(shard.mu);
+      for (int64_t n = 0; n < num_indices; ++n) {
+        const int64_t i = indices == nullptr ? n : indices[n];
+        // is_full_size_default is true:
+        //   Each key has an independent default value, key_values(i)
+        //   corresponding uses default_flat(i) as its default value.
+        //
+        // is_full_size_default is false:
+        //   All keys will share the default_flat(0) as default value.
+        value_values(i) = gtl::FindWithDefault(
+            shard.table, SubtleMustCopyIfIntegral(key_values(i)),
+            is_full_size_default ? default_flat(i) : default_flat(0));
+      }
+    });
 
     return OkStatus();
   }
@@ -90,14 +113,25 @@ class MutableHashTableOfScalars final : public LookupInterface {
     const auto key_values = keys.flat<K>();
     const auto value_values = values.flat<V>();
 
-    mutex_lock l(mu_);
     if (clear) {
-      table_.clear();
-    }
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
-                          SubtleMustCopyIfIntegral(value_values(i)));
+      // Replaces the contents of all the shards at once.
+      std::vector<std::unique_ptr<mutex_lock>> locks;
+      for (Shard& shard : shards_) {
+        locks.push_back(std::make_unique<mutex_lock>(shard.mu));
+      }
+      ReplaceLocked(key_values, value_values);
+      return OkStatus();
     }
+    ForEachShard(key_values, [&](Shard& shard, const int64_t* indices,
+                                 int64_t num_indices) {
+      mutex_lock l(shard.mu);
+      for (int64_t n = 0; n < num_indices; ++n) {
+        const int64_t i = indices == nullptr ? n : indices[n];
+        gtl::InsertOrUpdate(&shard.table,
+                            SubtleMustCopyIfIntegral(key_values(i)),
+                            SubtleMustCopyIfIntegral(value_values(i)));
+      }
+    });
     return OkStatus();
   }
 
@@ -109,10 +143,14 @@ class MutableHashTableOfScalars final : public LookupInterface {
   Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
     const auto key_values = keys.flat<K>();
 
-    mutex_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      table_.erase(SubtleMustCopyIfIntegral(key_values(i)));
-    }
+    ForEachShard(key_values, [&](Shard& shard, const int64_t* indices,
+                                 int64_t num_indices) {
+      mutex_lock l(shard.mu);
+      for (int64_t n = 0; n < num_indices; ++n) {
+        const int64_t i = indices == nullptr ? n : indices[n];
+        shard.table.erase(SubtleMustCopyIfIntegral(key_values(i)));
+      }
+    });
     return OkStatus();
   }
 
@@ -122,8 +160,8 @@ class MutableHashTableOfScalars final : public LookupInterface {
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
+    std::vector<std::unique_ptr<tf_shared_lock>> locks = LockAllShared();
+    int64_t size = SizeLocked();
 
     Tensor* keys;
     Tensor* values;
@@ -145,21 +183,23 @@ class MutableHashTableOfScalars final : public LookupInterface {
 
   int64_t MemoryUsed() const override {
     int64_t ret = 0;
-    tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
+    for (const Shard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      for (unsigned i = 0; i < shard.table.bucket_count(); ++i) {
+        size_t bucket_size = shard.table.bucket_size(i);
+        if (bucket_size == 0) {
+          ret++;
+        } else {
+          ret += bucket_size;
+        }
       }
     }
     return sizeof(MutableHashTableOfScalars) + ret;
   }
 
   Status AsGraphDef(GraphDefBuilder* builder, Node** out) const override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
+    std::vector<std::unique_ptr<tf_shared_lock>> locks = LockAllShared();
+    int64_t size = SizeLocked();
     Tensor keys(key_dtype(), TensorShape({size}));
     Tensor values(value_dtype(), TensorShape({size}));
     ExportKeysAndValues(&keys, &values);
@@ -176,7 +216,8 @@ class MutableHashTableOfScalars final : public LookupInterface {
             .WithName(UniqueNodeName("MutableHashTableFromGraphDef"))
             .WithAttr("use_node_name_sharing", true)
             .WithAttr("key_dtype", key_dtype())
-            .WithAttr("value_dtype", value_dtype()));
+            .WithAttr("value_dtype", value_dtype())
+            .WithAttr("num_shards", static_cast<int64_t>(shards_.size())));
     Node* keys_node = ops::SourceOp(
         "Const",
         builder->opts().WithAttr("dtype", key_dtype()).WithAttr("value", keys));
@@ -195,21 +236,104 @@ class MutableHashTableOfScalars final : public LookupInterface {
   }
 
  private:
+  // Aligned so that the locks of different shards do not share a cache line.
+  struct alignas(64) Shard {
+    mutable mutex mu;
+    std::unordered_map<K, V> table TF_GUARDED_BY(mu);
+  };
+
+  size_t ShardIndex(const K& key) const {
+    if (shards_.size() == 1) return 0;
+    // Keys are often consecutive integers, whose std::hash is the identity, so
+    // the shard is picked from the high bits of a multiplicative hash.
+    const uint64 hash = std::hash<K>()(key) * 0x9E3779B97F4A7C15ULL;
+    return (hash >> 32) % shards_.size();
+  }
+
+  // Calls `fn(shard, indices, num_indices)` once for every shard with keys of
+  // `key_values`, with the indices of its keys in increasing order. `indices`
+  // is null when all the keys are in the only shard, in which case they are
+  // 0, ..., num_indices - 1.
+  template <typename Keys, typename Fn>
+  void ForEachShard(const Keys& key_values, Fn fn) {
+    const int64_t num_keys = key_values.size();
+    if (shards_.size() == 1) {
+      fn(shards_[0], nullptr, num_keys);
+      return;
+    }
+    // Groups the keys by shard with a counting sort, so that every shard is
+    // locked once per batch.
+    std::vector<int32> shard_of_key(num_keys);
+    std::vector<int64_t> shard_begin(shards_.size() + 1, 0);
+    for (int64_t i = 0; i < num_keys; ++i) {
+      shard_of_key[i] = ShardIndex(SubtleMustCopyIfIntegral(key_values(i)));
+      ++shard_begin[shard_of_key[i] + 1];
+    }
+    for (size_t s = 0; s < shards_.size(); ++s) {
+      shard_begin[s + 1] += shard_begin[s];
+    }
+    std::vector<int64_t> indices(num_keys);
+    std::vector<int64_t> next = shard_begin;
+    for (int64_t i = 0; i < num_keys; ++i) {
+      indices[next[shard_of_key[i]]++] = i;
+    }
+    for (size_t s = 0; s < shards_.size(); ++s) {
+      const int64_t num_indices = shard_begin[s + 1] - shard_begin[s];
+      if (num_indices == 0) continue;
+      fn(shards_[s], indices.data() + shard_begin[s], num_indices);
+    }
+  }
+
+  // Locks all the shards in order, for a consistent view of the table.
+  std::vector<std::unique_ptr<tf_shared_lock>> LockAllShared() const {
+    std::vector<std::unique_ptr<tf_shared_lock>> locks;
+    for (const Shard& shard : shards_) {
+      locks.push_back(std::make_unique<tf_shared_lock>(shard.mu));
+    }
+    return locks;
+  }
+
+  // Replaces the contents of the table by `key_values` and `value_values`.
+  // REQUIRES: all the shards are locked exclusively.
+  template <typename Keys, typename Values>
+  void ReplaceLocked(const Keys& key_values, const Values& value_values)
+      TF_NO_THREAD_SAFETY_ANALYSIS {
+    for (Shard& shard : shards_) {
+      shard.table.clear();
+    }
+    for (int64_t i = 0; i < key_values.size(); ++i) {
+      const K key = SubtleMustCopyIfIntegral(key_values(i));
+      gtl::InsertOrUpdate(&shards_[ShardIndex(key)].table, key,
+                          SubtleMustCopyIfIntegral(value_values(i)));
+    }
+  }
+
+  // REQUIRES: all the shards are locked.
+  int64_t SizeLocked() const TF_NO_THREAD_SAFETY_ANALYSIS {
+    int64_t size = 0;
+    for (const Shard& shard : shards_) {
+      size += shard.table.size();
+    }
+    return size;
+  }
+
   // Writes all keys and values into `keys` and `values`. `keys` and `values`
-  // must point to tensors of size `table_.size()`.
+  // must point to tensors of size `SizeLocked()`.
+  // REQUIRES: all the shards are locked.
   void ExportKeysAndValues(Tensor* keys, Tensor* values) const
-      TF_SHARED_LOCKS_REQUIRED(mu_) {
+      TF_NO_THREAD_SAFETY_ANALYSIS {
     auto keys_data = keys->flat<K>();
     auto values_data = values->flat<V>();
     int64_t i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      keys_data(i) = it->first;
-      values_data(i) = it->second;
+    for (const Shard& shard : shards_) {
+      for (auto it = shard.table.begin(); it != shard.table.end(); ++it, ++i) {
+        keys_data(i) = it->first;
+        values_data(i) = it->second;
+      }
     }
   }
 
-  mutable mutex mu_;
-  std::unordered_map<K, V> table_ TF_GUARDED_BY(mu_);
+  std::vector<Shard> shards_;
 };
 
 // Lookup table that wraps an unordered_map. Behaves identical to
@@ -520,9 +644,26 @@ class MutableDenseHashTable final : public LookupInterface {
     const auto deleted_key_matrix =
         deleted_key_.template shaped<K, 2>({1, key_size});
     const int64_t bit_mask = num_buckets_ - 1;
+    // Added by Alpa. The keys are probed in batches: the first buckets of all
+    // the keys of a batch are prefetched before any is probed, so that their
+    // cache misses overlap instead of being paid one after the other.
+    constexpr int64_t kProbeBatchSize = 16;
+    uint64 key_hashes[kProbeBatchSize];
     // TODO(andreasst): parallelize using work_sharder
     for (int64_t i = 0; i < num_elements; ++i) {
-      const uint64 key_hash = HashKey(key_matrix, i);
+      if (i % kProbeBatchSize == 0) {
+        const int64_t batch_end = std::min(num_elements, i + kProbeBatchSize);
+        for (int64_t k = i; k < batch_end; ++k) {
+          const uint64 hash = HashKey(key_matrix, k);
+          key_hashes[k - i] = hash;
+          const int64_t first_bucket = hash & bit_mask;
+          port::prefetch<port::PREFETCH_HINT_T0>(
+              &key_buckets_matrix(first_bucket, 0));
+          port::prefetch<port::PREFETCH_HINT_T0>(
+              &value_buckets_matrix(first_bucket, 0));
+        }
+      }
+      const uint64 key_hash = key_hashes[i % kProbeBatchSize];
       if (empty_key_hash_ == key_hash &&
           IsEqualKey(empty_key_matrix, 0, key_matrix, i)) {
         return errors::InvalidArgument(
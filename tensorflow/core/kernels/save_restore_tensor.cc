@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/save_restore_tensor.h"
 
+#include <algorithm>
 #include <memory>
 #include <numeric>
 #include <unordered_map>
@@ -33,6 +34,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 #include "tensorflow/core/util/tensor_slice_reader.h"
 #include "tensorflow/core/util/tensor_slice_reader_cache.h"
@@ -257,13 +259,14 @@ const int64_t kLargeShapeThreshold = 16 << 20;  // 16M
 struct RestoreOp {
   RestoreOp(OpKernelContext* context, int idx, const string& tensor_name,
             const string& shape_and_slice, const string& reader_prefix,
-            DataType dtype)
+            DataType dtype, const BundleReader::Options& reader_options)
       : context(context),
         idx(idx),
         tensor_name(tensor_name),
         shape_and_slice(shape_and_slice),
         reader_prefix(reader_prefix),
-        dtype(dtype) {}
+        dtype(dtype),
+        reader_options(reader_options) {}
 
   // Move-only. It does not make sense to "run()" a copied RestoreOp.
   RestoreOp(const RestoreOp&) = delete;
@@ -284,7 +287,7 @@ struct RestoreOp {
 
   // Run this restore operation using a new BundleReader.
   void run_with_new_reader() {
-    BundleReader reader(Env::Default(), reader_prefix);
+    BundleReader reader(Env::Default(), reader_prefix, reader_options);
     if (!reader.status().ok()) {
       status = reader.status();
       return;
@@ -355,10 +358,49 @@ struct RestoreOp {
   string shape_and_slice;
   string reader_prefix;
   DataType dtype;
+  BundleReader::Options reader_options;  // Added by Alpa.
 
   ::tensorflow::Status status;
 };
 
+// Added by Alpa. A contiguous run of small restore operations, in file order,
+// that is restored from the thread pool with its own BundleReader.
+struct RestoreBatch {
+  std::vector<RestoreOp*> ops;
+  int64_t bytes = 0;
+  ::tensorflow::Status status;
+
+  void run_with_new_reader() {
+    if (ops.empty()) {
+      return;
+    }
+    BundleReader reader(Env::Default(), ops.front()->reader_prefix,
+                        ops.front()->reader_options);
+    status = reader.status();
+    for (RestoreOp* op : ops) {
+      if (!status.ok()) {
+        return;
+      }
+      status = op->run(&reader);
+    }
+  }
+};
+
+// Small tensors are only split into batches if each batch reads at least this
+// many bytes, so that the extra readers pay off.
+const int64_t kMinRestoreBatchBytes = 16 << 20;  // 16MB
+
+// Returns the number of bytes read to restore the tensor keyed by "key", or 0
+// if it cannot be looked up.
+int64_t RestoredBytes(BundleReader* reader, const string& key) {
+  DataType dtype;
+  TensorShape shape;
+  if (!reader->LookupDtypeAndShape(key, &dtype, &shape).ok()) {
+    return 0;
+  }
+  return shape.num_elements() * std::max(DataTypeSize(dtype), 1);
+}
+
 }  // namespace
 
 Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
@@ -370,14 +412,21 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
   const auto& tensor_names_flat = tensor_names.flat<tstring>();
   const auto& shape_and_slices_flat = shape_and_slices.flat<tstring>();
 
+  // Added by Alpa. Restores from memory-mapped data files, which lets the
+  // tensors restored in parallel share the page cache without buffered reads.
+  BundleReader::Options reader_options;
+  TF_RETURN_IF_ERROR(ReadBoolFromEnvVar("TF_MEMORY_MAPPED_CHECKPOINT_RESTORE",
+                                        false, &reader_options.memory_mapped));
+
   std::vector<RestoreOp> restore_ops;
   restore_ops.reserve(tensor_names_flat.size());
   for (int i = 0; i < tensor_names_flat.size(); ++i) {
     restore_ops.push_back({context, i, tensor_names_flat(i),
-                           shape_and_slices_flat(i), prefix_string, dtypes[i]});
+                           shape_and_slices_flat(i), prefix_string, dtypes[i],
+                           reader_options});
   }
 
-  BundleReader default_reader(Env::Default(), prefix_string);
+  BundleReader default_reader(Env::Default(), prefix_string, reader_options);
   TF_RETURN_IF_ERROR(default_reader.status());
 
   TF_RETURN_IF_ERROR(default_reader.SortForSequentialAccess<RestoreOp>(
@@ -404,24 +453,56 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
 
   std::vector<RestoreOp*> pool_restore_ops;
   std::vector<RestoreOp*> direct_restore_ops;
+  int64_t direct_restore_bytes = 0;
   for (RestoreOp& restore_op : restore_ops) {
     if (restore_op.should_run_in_pool(&default_reader)) {
       pool_restore_ops.push_back(&restore_op);
     } else {
       direct_restore_ops.push_back(&restore_op);
+      direct_restore_bytes +=
+          RestoredBytes(&default_reader, restore_op.tensor_name);
     }
   }
 
+  // Added by Alpa. Checkpoints of large models have many tensors below the
+  // pool threshold, which add up to most of the restore time when they are
+  // read one by one on the op thread. Split them into contiguous runs of about
+  // the same size in file order, so that every run still reads sequentially,
+  // and restore the runs from the pool too.
+  int64_t num_restore_threads;
+  TF_RETURN_IF_ERROR(ReadInt64FromEnvVar("TF_CHECKPOINT_RESTORE_THREADS", 8,
+                                         &num_restore_threads));
+  num_restore_threads = std::max<int64_t>(num_restore_threads, 1);
+  std::vector<RestoreBatch> restore_batches;
+  const int64_t batch_bytes =
+      std::max(direct_restore_bytes / num_restore_threads,
+               kMinRestoreBatchBytes);
+  if (num_restore_threads > 1 && direct_restore_bytes >= 2 * batch_bytes) {
+    restore_batches.emplace_back();
+    for (RestoreOp* op : direct_restore_ops) {
+      if (restore_batches.back().bytes >= batch_bytes) {
+        restore_batches.emplace_back();
+      }
+      restore_batches.back().ops.push_back(op);
+      restore_batches.back().bytes +=
+          RestoredBytes(&default_reader, op->tensor_name);
+    }
+    direct_restore_ops.clear();
+  }
+
   {
     // Schedule any threaded operations first, skipping thread pool creation if
     // we don't have any expensive operations.
     std::unique_ptr<thread::ThreadPool> reader_pool;
-    if (!pool_restore_ops.empty()) {
-      reader_pool.reset(
-          new thread::ThreadPool(Env::Default(), "restore_tensors", 8));
+    if (!pool_restore_ops.empty() || !restore_batches.empty()) {
+      reader_pool.reset(new thread::ThreadPool(
+          Env::Default(), "restore_tensors", num_restore_threads));
       for (auto* op : pool_restore_ops) {
         reader_pool->Schedule([op]() { op->run_with_new_reader(); });
       }
+      for (RestoreBatch& batch : restore_batches) {
+        reader_pool->Schedule([&batch]() { batch.run_with_new_reader(); });
+      }
     }
 
     // Read small tensors from the op thread
@@ -434,6 +515,9 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
   for (auto* op : pool_restore_ops) {
     TF_RETURN_IF_ERROR(op->status);
   }
+  for (const RestoreBatch& batch : restore_batches) {
+    TF_RETURN_IF_ERROR(batch.status);
+  }
 
   for (const RestoreOp& restore_op : restore_ops) {
     if (restore_op.dtype != context->mutable_output(restore_op.idx)->dtype()) {
@@ -193,6 +193,119 @@ __global__ void UnsortedSegmentCustomKernel(
   }
 }
 
+// Added by Alpa. Logical warp size of the warp-level pre-aggregation of
+// UnsortedSegmentPrivatizedKernel.
+constexpr int kUnsortedSegmentWarpSize = 32;
+// Added by Alpa. Minimum number of input elements per output element from
+// which the unsorted segment reductions pre-aggregate in shared memory.
+constexpr int64_t kUnsortedSegmentMinPrivatizedRatio = 32;
+// Added by Alpa. Minimum number of input rows per segment from which the
+// unsorted segment reductions whose output does not fit in shared memory sort
+// the segment ids and run the sorted segmented reduction.
+constexpr int64_t kUnsortedSegmentMinSortedRatio = 64;
+
+// Added by Alpa. Same as UnsortedSegmentCustomKernel, but each block first
+// reduces into a private copy of the output in shared memory, so that the
+// global atomics are one per output element and block instead of one per
+// input element, which serializes when many elements map to few segments.
+// With 'inner_dim_size' == 1, the runs of equal segment ids of each warp are
+// also reduced with warp shuffles, leaving one shared atomic per run.
+// REQUIRES: blockDim.x is a multiple of kUnsortedSegmentWarpSize.
+template <typename T, typename Index, typename ReductionF,
+          typename AtomicReductionF>
+__global__ void UnsortedSegmentPrivatizedKernel(
+    const int64_t input_outer_dim_size, const int64_t inner_dim_size,
+    const int64_t output_outer_dim_size, const Index* __restrict__ segment_ids,
+    const T* __restrict__ input, const T initial_value,
+    T* __restrict__ output) {
+  GPU_DYNAMIC_SHARED_MEM_DECL(16, char, shared_memory);
+  T* private_output = reinterpret_cast<T*>(shared_memory);
+  const int64_t output_size = output_outer_dim_size * inner_dim_size;
+  for (int64_t i = threadIdx.x; i < output_size; i += blockDim.x) {
+    private_output[i] = initial_value;
+  }
+  __syncthreads();
+
+  const int64_t input_total_size = input_outer_dim_size * inner_dim_size;
+  if (inner_dim_size == 1) {
+    typedef gpuprim::WarpReduce<T, kUnsortedSegmentWarpSize> WarpReduce;
+    __shared__ typename WarpReduce::TempStorage
+        temp_storage[1024 / kUnsortedSegmentWarpSize];
+    const int lane = threadIdx.x % kUnsortedSegmentWarpSize;
+    const int64_t stride = static_cast<int64_t>(blockDim.x) * gridDim.x;
+    // All the threads of a warp run the same iterations.
+    for (int64_t begin = static_cast<int64_t>(blockIdx.x) * blockDim.x;
+         begin < input_total_size; begin += stride) {
+      const int64_t i = begin + threadIdx.x;
+      Index segment_id = -1;
+      T value = initial_value;
+      bool head = lane == 0;
+      if (i < input_total_size) {
+        segment_id = segment_ids[i];
+        value = ldg(input + i);
+        head = head || segment_ids[i - 1] != segment_id;
+      }
+      const T aggregate = WarpReduce(temp_storage[threadIdx.x /
+                                                  kUnsortedSegmentWarpSize])
+                              .HeadSegmentedReduce(value, head, ReductionF());
+      if (head && segment_id >= 0 && segment_id < output_outer_dim_size) {
+        AtomicReductionF()(private_output + segment_id, aggregate);
+      }
+    }
+  } else {
+    for (int64_t input_index : GpuGridRangeX(input_total_size)) {
+      const int64_t input_segment_index = input_index / inner_dim_size;
+      const int64_t segment_offset = input_index % inner_dim_size;
+      const Index output_segment_index = segment_ids[input_segment_index];
+      if (output_segment_index < 0 ||
+          output_segment_index >= output_outer_dim_size) {
+        continue;
+      }
+      AtomicReductionF()(
+          private_output + output_segment_index * inner_dim_size +
+              segment_offset,
+          ldg(input + input_index));
+    }
+  }
+  __syncthreads();
+
+  for (int64_t i = threadIdx.x; i < output_size; i += blockDim.x) {
+    AtomicReductionF()(output + i, private_output[i]);
+  }
+}
+
+// Added by Alpa. The kernels of the non-deterministic unsorted segment
+// reductions.
+enum class UnsortedSegmentReductionKernel {
+  // One global atomic per input element.
+  kAtomic,
+  // Pre-aggregation in shared memory, see UnsortedSegmentPrivatizedKernel.
+  kPrivatized,
+  // Sort of the segment ids, then sorted segmented reduction.
+  kSorted,
+};
+
+// Added by Alpa. Picks the kernel of an unsorted segment reduction from the
+// ratio of input to output sizes, i.e. from the contention on the output
+// elements. Contended outputs that fit in 'max_shared_memory_bytes' are
+// pre-aggregated in shared memory, the others are sorted when the segments
+// are large enough to amortize the sort.
+inline UnsortedSegmentReductionKernel ChooseUnsortedSegmentReductionKernel(
+    int64_t input_outer_dim_size, int64_t inner_dim_size,
+    int64_t num_segments, int64_t element_bytes,
+    int64_t max_shared_memory_bytes) {
+  const int64_t output_size = num_segments * inner_dim_size;
+  if (output_size * element_bytes <= max_shared_memory_bytes &&
+      input_outer_dim_size >= kUnsortedSegmentMinPrivatizedRatio *
+                                  num_segments) {
+    return UnsortedSegmentReductionKernel::kPrivatized;
+  }
+  if (input_outer_dim_size >= kUnsortedSegmentMinSortedRatio * num_segments) {
+    return UnsortedSegmentReductionKernel::kSorted;
+  }
+  return UnsortedSegmentReductionKernel::kAtomic;
+}
+
 template <typename Tindex, typename Tsegmentids>
 __global__ void SegmentOffsetsKernel(
     Tindex size, Tsegmentids nsegments,
@@ -816,12 +929,22 @@ struct UnsortedSegmentFunctor<GPUDevice, T, Index, InitialValueF, ReductionF> {
     const Index output_outer_dim_size = output.dimension(0);
     const Index num_segments = output.size() / input_inner_dim_size;
 
+    // Added by Alpa. The non-deterministic reductions pick their kernel from
+    // the contention on the output elements.
+    GPUDevice d = ctx->template eigen_device<GPUDevice>();
+    const int64_t max_shared_memory_bytes = d.sharedMemPerBlock() / 2;
+    const UnsortedSegmentReductionKernel kernel =
+        use_deterministic_kernels
+            ? UnsortedSegmentReductionKernel::kSorted
+            : ChooseUnsortedSegmentReductionKernel(
+                  input_outer_dim_size, input_inner_dim_size, num_segments,
+                  sizeof(T), max_shared_memory_bytes);
+
     // TODO(benbarsdell): If there are no performance concerns with the new
     // deterministic kernels, remove this runtime check and the old
     // non-deterministic kernels.
-    if (!use_deterministic_kernels) {
+    if (kernel != UnsortedSegmentReductionKernel::kSorted) {
       // Set 'output' to initial value.
-      GPUDevice d = ctx->template eigen_device<GPUDevice>();
       GpuLaunchConfig config = GetGpuLaunchConfig(output.size(), d);
       TF_CHECK_OK(GpuLaunchKernel(
           SetToValue<T>, config.block_count, config.thread_per_block, 0,
@@ -830,10 +953,25 @@ struct UnsortedSegmentFunctor<GPUDevice, T, Index, InitialValueF, ReductionF> {
       if (data_size == 0 || segment_ids_shape.num_elements() == 0) {
         return;
       }
+      using AtomicReductionF =
+          typename ReduceUpdateOpFor<ReductionF>::atomic_op;
       config = GetGpuLaunchConfig(data_size, d);
+      if (kernel == UnsortedSegmentReductionKernel::kPrivatized) {
+        // Whole warps, for the warp-level pre-aggregation.
+        const int thread_per_block =
+            Eigen::divup(config.thread_per_block, kUnsortedSegmentWarpSize) *
+            kUnsortedSegmentWarpSize;
+        TF_CHECK_OK(GpuLaunchKernel(
+            UnsortedSegmentPrivatizedKernel<T, Index, ReductionF,
+                                            AtomicReductionF>,
+            config.block_count, thread_per_block, output.size() * sizeof(T),
+            d.stream(), input_outer_dim_size, input_inner_dim_size,
+            output_outer_dim_size, unsorted_segment_ids.data(), data.data(),
+            InitialValueF()(), output.data()));
+        return;
+      }
       TF_CHECK_OK(GpuLaunchKernel(
-          UnsortedSegmentCustomKernel<
-              T, Index, typename ReduceUpdateOpFor<ReductionF>::atomic_op>,
+          UnsortedSegmentCustomKernel<T, Index, AtomicReductionF>,
           config.block_count, config.thread_per_block, 0, d.stream(),
           input_outer_dim_size, input_inner_dim_size, output_outer_dim_size,
           unsorted_segment_ids.data(), data.data(), output.data()));
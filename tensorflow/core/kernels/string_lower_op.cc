@@ -17,11 +17,11 @@ limitations under the License.
 
 #include <string>
 
-#include "absl/strings/ascii.h"
 #include "unicode/unistr.h"  // from @icu
 #include "tensorflow/core/framework/kernel_def_builder.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/string_util.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/strings/str_util.h"
@@ -51,7 +51,9 @@ class StringLowerOp : public OpKernel {
     if (encoding_.empty()) {
       for (int64_t i = 0; i < input.size(); ++i) {
         StringPiece entry(input(i));
-        output(i) = absl::AsciiStrToLower(entry);
+        // Added by Alpa. Converts in place, without a temporary string.
+        output(i).resize_uninitialized(entry.size());
+        AsciiToLower(entry, output(i).mdata());
       }
     } else {
       // The validation of utf-8 has already been done in GetAttr above.
@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/macros.h"
@@ -44,18 +45,38 @@ class StringToHashBucketOp : public OpKernel {
                                             &output_tensor));
     auto output_flat = output_tensor->flat<int64_t>();
 
-    typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = hash(input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64_t>(bucket_id);
+    // Added by Alpa. Large batches are hashed in parallel blocks.
+    const int64_t num_buckets = num_buckets_;
+    auto hash_range = [&input_flat, &output_flat, num_buckets](
+                          int64_t begin, int64_t end) {
+      for (int64_t i = begin; i < end; ++i) {
+        const uint64 input_hash = hash(input_flat(i));
+        const uint64 bucket_id = input_hash % num_buckets;
+        // The number of buckets is always in the positive range of int64 so is
+        // the resulting bucket_id. Casting the bucket_id from uint64 to int64
+        // is safe.
+        output_flat(i) = static_cast<int64_t>(bucket_id);
+      }
+    };
+    const int64_t size = input_flat.size();
+    if (size < kMinParallelSize) {
+      hash_range(0, size);
+      return;
     }
+    // Approximates the cost of hashing a string by its length.
+    int64_t total_bytes = 0;
+    for (int64_t i = 0; i < size; ++i) total_bytes += input_flat(i).size();
+    context->device()->tensorflow_cpu_worker_threads()->workers->ParallelFor(
+        size, /*cost_per_unit=*/kCostPerString + total_bytes / size,
+        hash_range);
   }
 
  private:
+  // Added by Alpa. Batches smaller than this are hashed on the calling thread.
+  static constexpr int64_t kMinParallelSize = 1024;
+  // Added by Alpa. Cost of hashing a string on top of its bytes.
+  static constexpr int64_t kCostPerString = 20;
+
   int64_t num_buckets_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(StringToHashBucketOp);
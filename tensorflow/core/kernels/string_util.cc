@@ -14,9 +14,48 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/string_util.h"
 
+#include <cstring>
+
+#include "absl/strings/ascii.h"
 #include "tensorflow/core/lib/core/errors.h"
 
 namespace tensorflow {
+namespace {
+
+// Added by Alpa. Flips the case of the bytes of "word" in [lo, hi], a range of
+// ASCII letters, as eight independent bytes.
+inline uint64 FlipAsciiCase(uint64 word, char lo, char hi) {
+  constexpr uint64 kOnes = 0x0101010101010101ULL;
+  constexpr uint64 kHighBits = 0x8080808080808080ULL;
+  // The additions below do not carry across bytes on the low seven bits.
+  const uint64 heptets = word & ~kHighBits;
+  // The high bit of each byte is set iff its low seven bits are > hi, resp.
+  // >= lo.
+  const uint64 above_hi = heptets + (0x7f - hi) * kOnes;
+  const uint64 at_least_lo = heptets + (0x80 - lo) * kOnes;
+  // Bytes with the high bit set are not ASCII, and are left unchanged.
+  const uint64 in_range = at_least_lo & ~above_hi & ~word & kHighBits;
+  // 0x80 >> 2 is the bit distinguishing the cases of ASCII letters.
+  return word ^ (in_range >> 2);
+}
+
+template <char lo, char hi, char (*convert)(unsigned char)>
+void ConvertAsciiCase(StringPiece in, char* out) {
+  const char* data = in.data();
+  const size_t size = in.size();
+  size_t i = 0;
+  for (; i + sizeof(uint64) <= size; i += sizeof(uint64)) {
+    uint64 word;
+    std::memcpy(&word, data + i, sizeof(word));
+    word = FlipAsciiCase(word, lo, hi);
+    std::memcpy(out + i, &word, sizeof(word));
+  }
+  for (; i < size; ++i) {
+    out[i] = convert(data[i]);
+  }
+}
+
+}  // namespace
 
 // Sets unit value based on str.
 Status ParseUnicodeEncoding(const string& str, UnicodeEncoding* encoding) {
@@ -61,4 +100,12 @@ int32 UTF8StrLen(const string& str) {
   return result;
 }
 
+void AsciiToLower(StringPiece in, char* out) {
+  ConvertAsciiCase<'A', 'Z', absl::ascii_tolower>(in, out);
+}
+
+void AsciiToUpper(StringPiece in, char* out) {
+  ConvertAsciiCase<'a', 'z', absl::ascii_toupper>(in, out);
+}
+
 }  // namespace tensorflow
@@ -42,6 +42,12 @@ Status ParseCharUnit(const string& str, CharUnit* unit);
 // Result may be incorrect if the input string is not valid UTF-8.
 int32 UTF8StrLen(const string& str);
 
+// Added by Alpa. Writes "in" with its ASCII letters converted to lower case,
+// resp. upper case, to the in.size() bytes at "out", eight bytes at a time.
+// Other bytes are copied unchanged, as by absl::AsciiStrToLower().
+void AsciiToLower(StringPiece in, char* out);
+void AsciiToUpper(StringPiece in, char* out);
+
 // Get the next UTF8 character position starting at the given position and
 // skipping the given number of characters. Position is a byte offset, and
 // should never be `null`. The function return true if successful. However, if
@@ -17,7 +17,9 @@ limitations under the License.
 #include "tensorflow/core/kernels/training_ops.h"
 
 #include <algorithm>  // NOLINT
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -242,6 +244,80 @@ struct SparseApplyAdagrad<CPUDevice, T, Tindex, has_epsilon> {
   }
 };
 
+template <typename T, typename Tindex, bool has_epsilon>
+struct SparseApplyAdagradDeduplicated<CPUDevice, T, Tindex, has_epsilon> {
+  Status operator()(OpKernelContext* ctx, typename TTypes<T>::Matrix var,
+                    typename TTypes<T>::Matrix accum,
+                    typename TTypes<T>::ConstScalar lr,
+                    typename TTypes<T>::ConstScalar epsilon,
+                    typename TTypes<T>::ConstMatrix grad,
+                    typename TTypes<Tindex>::ConstVec indices,
+                    int64_t inner_dim, bool update_slots) {
+    const Tindex N = static_cast<Tindex>(indices.dimension(0));
+    if (N == 0) return OkStatus();
+    const Tindex first_dim_size = static_cast<Tindex>(var.dimension(0));
+
+    // Groups the positions of the indices by unique row, like the unique op:
+    // the positions of unique_rows[u] are positions[offsets[u], offsets[u+1]).
+    absl::flat_hash_map<Tindex, Tindex> unique_slots;
+    unique_slots.reserve(N);
+    std::vector<Tindex> unique_rows;
+    std::vector<Tindex> slots(N);
+    for (Tindex i = 0; i < N; ++i) {
+      const Tindex index = internal::SubtleMustCopy(indices(i));
+      if (!FastBoundsCheck(index, first_dim_size)) {
+        return errors::InvalidArgument(
+            strings::StrCat("Index ", index, " at offset ", i,
+                            " in indices is out of range"));
+      }
+      const auto inserted = unique_slots.try_emplace(
+          index, static_cast<Tindex>(unique_rows.size()));
+      if (inserted.second) unique_rows.push_back(index);
+      slots[i] = inserted.first->second;
+    }
+    const Tindex num_unique = static_cast<Tindex>(unique_rows.size());
+    std::vector<Tindex> offsets(num_unique + 1, 0);
+    for (Tindex i = 0; i < N; ++i) ++offsets[slots[i] + 1];
+    for (Tindex u = 0; u < num_unique; ++u) offsets[u + 1] += offsets[u];
+    std::vector<Tindex> positions(N);
+    std::vector<Tindex> next(offsets.begin(), offsets.end() - 1);
+    for (Tindex i = 0; i < N; ++i) positions[next[slots[i]]++] = i;
+
+    const T lr_scalar = lr();
+    const T epsilon_scalar = epsilon();
+    const auto shard = [&](Tindex start_idx, Tindex end_idx) -> void {
+      Eigen::Tensor<T, 1, Eigen::RowMajor> g(inner_dim);
+      for (Tindex u = start_idx; u < end_idx; ++u) {
+        g = grad.template chip<0>(positions[offsets[u]]);
+        for (Tindex j = offsets[u] + 1; j < offsets[u + 1]; ++j) {
+          g += grad.template chip<0>(positions[j]);
+        }
+        auto a = accum.template chip<0>(unique_rows[u]);
+        auto v = var.template chip<0>(unique_rows[u]);
+        if (update_slots) {
+          a += g.square();
+        }
+        if (has_epsilon) {
+          v -= g.constant(lr_scalar) * g /
+               (a.sqrt() + a.constant(epsilon_scalar));
+        } else {
+          v -= g.constant(lr_scalar) * g * a.rsqrt();
+        }
+      }
+    };
+    // Each unique row reads the gradients of its duplicates once.
+    const double ids_per_row = static_cast<double>(N) / num_unique;
+    const Eigen::TensorOpCost cost(
+        /*bytes_loaded=*/inner_dim * sizeof(T) * (ids_per_row + 2),
+        /*bytes_stored=*/inner_dim * sizeof(T) * 2,
+        /*compute_cycles=*/inner_dim *
+            (Eigen::TensorOpCost::AddCost<T>() * (ids_per_row + 1) +
+             Eigen::TensorOpCost::MulCost<T>() * 2));
+    ctx->eigen_device<CPUDevice>().parallelFor(num_unique, cost, shard);
+    return OkStatus();
+  }
+};
+
 template <typename T>
 struct ApplyProximalAdagrad<CPUDevice, T> {
   void operator()(const CPUDevice& d, typename TTypes<T>::Flat var,
@@ -1884,6 +1960,8 @@ class SparseApplyAdagradOp : public OpKernel {
   explicit SparseApplyAdagradOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("update_slots", &update_slots_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("deduplicate_indices",
+                                     &deduplicate_indices_));
   }
 
   void Compute(OpKernelContext* ctx) override TF_NO_THREAD_SAFETY_ANALYSIS {
@@ -1938,6 +2016,17 @@ class SparseApplyAdagradOp : public OpKernel {
                 errors::InvalidArgument(
                     "Inner dimension should be greater than zero."));
 
+    if (deduplicate_indices_) {
+      OP_REQUIRES_OK(
+          ctx, functor::SparseApplyAdagradDeduplicated<
+                   Device, T, Tindex, /*has_epsilon = */ false>()(
+                   ctx, var.flat_outer_dims<T>(), accum.flat_outer_dims<T>(),
+                   // Note: Passing lr as a placeholder for unused epsilon.
+                   lr.scalar<T>(), lr.scalar<T>(), grad.flat_outer_dims<T>(),
+                   indices.vec<Tindex>(), inner_dim, update_slots_));
+      MaybeForwardRefInputToRefOutput(ctx, 0, 0);
+      return;
+    }
     const Device& device = ctx->template eigen_device<Device>();
     OP_REQUIRES_OK(
         ctx, functor::SparseApplyAdagrad<Device, T, Tindex,
@@ -1953,6 +2042,7 @@ class SparseApplyAdagradOp : public OpKernel {
  private:
   bool use_exclusive_lock_;
   bool update_slots_;
+  bool deduplicate_indices_;
 };
 
 #define REGISTER_KERNELS(D, T, Tindices)                                 \
@@ -1989,7 +2079,18 @@ namespace functor {
       typename TTypes<Tindex>::ConstVec indices, int64_t inner_dim,            \
       bool update_slots);                                                      \
   extern template struct SparseApplyAdagrad<GPUDevice, T, Tindex,              \
-                                            /*has_epsilon=*/false>;
+                                            /*has_epsilon=*/false>;            \
+  template <>                                                                  \
+  Status SparseApplyAdagradDeduplicated<GPUDevice, T, Tindex,                  \
+                                        /*has_epsilon=*/false>::operator()(    \
+      OpKernelContext* ctx, typename TTypes<T>::Matrix var,                    \
+      typename TTypes<T>::Matrix accum, typename TTypes<T>::ConstScalar lr,    \
+      typename TTypes<T>::ConstScalar epsilon,                                 \
+      typename TTypes<T>::ConstMatrix grad,                                    \
+      typename TTypes<Tindex>::ConstVec indices, int64_t inner_dim,            \
+      bool update_slots);                                                      \
+  extern template struct SparseApplyAdagradDeduplicated<                       \
+      GPUDevice, T, Tindex, /*has_epsilon=*/false>;
 DECLARE_GPU_SPEC(Eigen::half, int32);
 DECLARE_GPU_SPEC(Eigen::half, int64_t);
 DECLARE_GPU_SPEC(float, int32);
@@ -2014,6 +2115,8 @@ class SparseApplyAdagradV2Op : public OpKernel {
   explicit SparseApplyAdagradV2Op(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("update_slots", &update_slots_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("deduplicate_indices",
+                                     &deduplicate_indices_));
   }
 
   void Compute(OpKernelContext* ctx) override TF_NO_THREAD_SAFETY_ANALYSIS {
@@ -2072,6 +2175,17 @@ class SparseApplyAdagradV2Op : public OpKernel {
                 errors::InvalidArgument(
                     "Inner dimension should be greater than zero."));
 
+    if (deduplicate_indices_) {
+      OP_REQUIRES_OK(
+          ctx, functor::SparseApplyAdagradDeduplicated<
+                   Device, T, Tindex, /*has_epsilon = */ true>()(
+                   ctx, var.flat_outer_dims<T>(), accum.flat_outer_dims<T>(),
+                   lr.scalar<T>(), epsilon.scalar<T>(),
+                   grad.flat_outer_dims<T>(), indices.vec<Tindex>(), inner_dim,
+                   update_slots_));
+      MaybeForwardRefInputToRefOutput(ctx, 0, 0);
+      return;
+    }
     const Device& device = ctx->template eigen_device<Device>();
     OP_REQUIRES_OK(
         ctx, functor::SparseApplyAdagrad<Device, T, Tindex,
@@ -2086,6 +2200,7 @@ class SparseApplyAdagradV2Op : public OpKernel {
  private:
   bool use_exclusive_lock_;
   bool update_slots_;
+  bool deduplicate_indices_;
 };
 
 #define REGISTER_KERNELS(D, T, Tindices)                                   \
@@ -2122,7 +2237,18 @@ namespace functor {
       typename TTypes<Tindex>::ConstVec indices, int64_t inner_dim,           \
       bool update_slots);                                                     \
   extern template struct SparseApplyAdagrad<GPUDevice, T, Tindex,             \
-                                            /*has_epsilon=*/true>;
+                                            /*has_epsilon=*/true>;            \
+  template <>                                                                 \
+  Status SparseApplyAdagradDeduplicated<GPUDevice, T, Tindex,                 \
+                                        /*has_epsilon=*/true>::operator()(    \
+      OpKernelContext* ctx, typename TTypes<T>::Matrix var,                   \
+      typename TTypes<T>::Matrix accum, typename TTypes<T>::ConstScalar lr,   \
+      typename TTypes<T>::ConstScalar epsilon,                                \
+      typename TTypes<T>::ConstMatrix grad,                                   \
+      typename TTypes<Tindex>::ConstVec indices, int64_t inner_dim,           \
+      bool update_slots);                                                     \
+  extern template struct SparseApplyAdagradDeduplicated<                      \
+      GPUDevice, T, Tindex, /*has_epsilon=*/true>;
 DECLARE_GPU_SPEC(Eigen::half, int32);
 DECLARE_GPU_SPEC(Eigen::half, int64_t);
 DECLARE_GPU_SPEC(float, int32);
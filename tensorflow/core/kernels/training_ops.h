@@ -22,6 +22,9 @@ limitations under the License.
 #include "tensorflow/core/platform/types.h"
 
 namespace tensorflow {
+
+class OpKernelContext;
+
 namespace functor {
 
 // Each training algorithm has a ApplyXYZ functor struct declared in
@@ -116,6 +119,21 @@ struct SparseApplyAdagrad {
                     int64_t inner_dim, bool update_slots);
 };
 
+// Added by Alpa. Like SparseApplyAdagrad, but sums the gradients of duplicate
+// indices first and applies them once per unique row, in parallel over the
+// unique rows. This is the update of the deduplicated IndexedSlices, without
+// the unique and segment sum ops that build them.
+template <typename Device, typename T, typename Tindex, bool has_epsilon>
+struct SparseApplyAdagradDeduplicated {
+  Status operator()(OpKernelContext* ctx, typename TTypes<T>::Matrix var,
+                    typename TTypes<T>::Matrix accum,
+                    typename TTypes<T>::ConstScalar lr,
+                    typename TTypes<T>::ConstScalar epsilon,
+                    typename TTypes<T>::ConstMatrix grad,
+                    typename TTypes<Tindex>::ConstVec indices,
+                    int64_t inner_dim, bool update_slots);
+};
+
 template <typename Device, typename T>
 struct ApplyProximalAdagrad {
   void operator()(const Device& d, typename TTypes<T>::Flat var,
@@ -17,7 +17,11 @@ limitations under the License.
 
 #define EIGEN_USE_GPU
 
+#include <algorithm>
+
+#include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/kernels/gpu_prim_helpers.h"
 #include "tensorflow/core/kernels/training_ops.h"
 #include "tensorflow/core/util/gpu_kernel_helper.h"
 
@@ -71,6 +75,46 @@ __global__ __launch_bounds__(1024) void SparseApplyAdagradKernel(
   }
 }
 
+// Applies the summed gradients of one unique row per block, given the sorted
+// indices and their permutation. Only the block of the first occurrence of a
+// row does work, so the rows are updated without races. Out of range indices
+// are ignored.
+template <typename T, typename Tindex, bool has_epsilon>
+__global__ __launch_bounds__(256) void SparseApplyAdagradDeduplicatedKernel(
+    T* var, T* accum, const T* lr, const T* epsilon, const T* grad,
+    const Tindex* sorted_indices, const Tindex* permutation,
+    Tindex param_rows, Tindex indices_size, int64 inner_dim,
+    bool update_slots) {
+  const Tindex start = blockIdx.x;
+  const Tindex param_row = sorted_indices[start];
+  if (start > 0 && sorted_indices[start - 1] == param_row) return;
+  if (param_row < 0 || param_row >= param_rows) return;
+  Tindex end = start + 1;
+  while (end < indices_size && sorted_indices[end] == param_row) ++end;
+
+  const T lr_t = *lr;
+  const T epsilon_t = *epsilon;
+  for (int64 col = threadIdx.x; col < inner_dim; col += blockDim.x) {
+    T grad_i = T(0);
+    for (Tindex j = start; j < end; ++j) {
+      grad_i += grad[static_cast<int64>(permutation[j]) * inner_dim + col];
+    }
+    const int64 param_index = static_cast<int64>(param_row) * inner_dim + col;
+    T var_i = var[param_index];
+    T accum_i = accum[param_index];
+    if (update_slots) {
+      accum_i += grad_i * grad_i;
+    }
+    if (has_epsilon) {
+      var_i -= lr_t * grad_i / (Eigen::numext::sqrt(accum_i) + epsilon_t);
+    } else {
+      var_i -= lr_t * grad_i * Eigen::numext::rsqrt(accum_i);
+    }
+    var[param_index] = var_i;
+    accum[param_index] = accum_i;
+  }
+}
+
 template <typename T, typename Tindex>
 __global__ __launch_bounds__(1024) void SparseApplyProximalAdagradKernel(
     T* var, T* accum, const T* lr, const T* l1, const T* l2, const T* grad,
@@ -451,6 +495,47 @@ struct SparseApplyAdagrad<GPUDevice, T, Tindex, has_epsilon> {
   }
 };
 
+template <typename T, typename Tindex, bool has_epsilon>
+struct SparseApplyAdagradDeduplicated<GPUDevice, T, Tindex, has_epsilon> {
+  Status operator()(OpKernelContext* ctx, typename TTypes<T>::Matrix var,
+                    typename TTypes<T>::Matrix accum,
+                    typename TTypes<T>::ConstScalar lr,
+                    typename TTypes<T>::ConstScalar epsilon,
+                    typename TTypes<T>::ConstMatrix grad,
+                    typename TTypes<Tindex>::ConstVec indices, int64 inner_dim,
+                    bool update_slots) {
+    const Tindex indices_size = indices.size();
+    if (indices_size == 0) {
+      return OkStatus();
+    }
+    // Sorting the indices groups the duplicates of every row.
+    Tensor sorted_indices;
+    TF_RETURN_IF_ERROR(ctx->allocate_temp(DataTypeToEnum<Tindex>::value,
+                                          TensorShape({indices_size}),
+                                          &sorted_indices));
+    Tensor permutation;
+    TF_RETURN_IF_ERROR(ctx->allocate_temp(DataTypeToEnum<Tindex>::value,
+                                          TensorShape({indices_size}),
+                                          &permutation));
+    TF_RETURN_IF_ERROR(GpuRadixSort(
+        ctx, static_cast<int>(indices_size), indices.data(),
+        sorted_indices.flat<Tindex>().data(),
+        /*indices_in=*/static_cast<const Tindex*>(nullptr),
+        permutation.flat<Tindex>().data()));
+
+    const GPUDevice& d = ctx->eigen_device<GPUDevice>();
+    const int threads_per_block =
+        static_cast<int>(std::min<int64>(256, (inner_dim + 31) / 32 * 32));
+    return GpuLaunchKernel(
+        SparseApplyAdagradDeduplicatedKernel<T, Tindex, has_epsilon>,
+        static_cast<int>(indices_size), threads_per_block, 0, d.stream(),
+        var.data(), accum.data(), lr.data(), epsilon.data(), grad.data(),
+        sorted_indices.flat<Tindex>().data(), permutation.flat<Tindex>().data(),
+        static_cast<Tindex>(var.dimension(0)), indices_size, inner_dim,
+        update_slots);
+  }
+};
+
 template <typename T>
 struct ApplyProximalAdagrad<GPUDevice, T> {
   void operator()(const GPUDevice& d, typename TTypes<T>::Flat var,
@@ -1102,7 +1187,15 @@ template struct functor::ApplyAdagradV2<GPUDevice, complex128>;
   template struct functor::SparseApplyAdagrad<GPUDevice, T, int32,    \
                                               /*has_epsilon=*/true>;  \
   template struct functor::SparseApplyAdagrad<GPUDevice, T, int64,    \
-                                              /*has_epsilon=*/true>
+                                              /*has_epsilon=*/true>;  \
+  template struct functor::SparseApplyAdagradDeduplicated<            \
+      GPUDevice, T, int32, /*has_epsilon=*/false>;                    \
+  template struct functor::SparseApplyAdagradDeduplicated<            \
+      GPUDevice, T, int64, /*has_epsilon=*/false>;                    \
+  template struct functor::SparseApplyAdagradDeduplicated<            \
+      GPUDevice, T, int32, /*has_epsilon=*/true>;                     \
+  template struct functor::SparseApplyAdagradDeduplicated<            \
+      GPUDevice, T, int64, /*has_epsilon=*/true>
 EXPLICITLY_INSTANTIATE_FUNCTOR(Eigen::half);
 EXPLICITLY_INSTANTIATE_FUNCTOR(float);
 EXPLICITLY_INSTANTIATE_FUNCTOR(double);
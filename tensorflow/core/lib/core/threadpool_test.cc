@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/platform/context.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 
@@ -63,6 +64,43 @@ TEST(ThreadPool, DoWork) {
   }
 }
 
+TEST(ThreadPool, NumaPartitionedDoWork) {
+  const int num_numa_nodes = port::NUMANumNodes();
+  for (int num_threads = 1; num_threads < kNumThreads; num_threads++) {
+    fprintf(stderr, "Testing with %d threads\n", num_threads);
+    const int kWorkItems = 100;
+    std::atomic<bool> work[kWorkItems];
+    std::atomic<int> numa_node[kWorkItems];
+    for (int i = 0; i < kWorkItems; i++) {
+      work[i] = false;
+      numa_node[i] = port::kNUMANoAffinity;
+    }
+    {
+      // Falls back to the default pool on hosts with a single NUMA node.
+      ThreadPool pool(Env::Default(), ThreadOptions(), "test", num_threads,
+                      /*low_latency_hint=*/true, /*allocator=*/nullptr,
+                      /*numa_partitioned=*/true);
+      EXPECT_EQ(pool.NumThreads(), num_threads);
+      for (int i = 0; i < kWorkItems; i++) {
+        pool.Schedule([&work, &numa_node, i]() {
+          numa_node[i] = ThreadPool::CurrentThreadNumaNode();
+          ASSERT_FALSE(work[i].exchange(true));
+        });
+      }
+    }
+    for (int i = 0; i < kWorkItems; i++) {
+      ASSERT_TRUE(work[i]);
+      if (num_numa_nodes > 1 && num_threads >= num_numa_nodes) {
+        EXPECT_GE(numa_node[i], 0);
+        EXPECT_LT(numa_node[i], num_numa_nodes);
+      } else {
+        EXPECT_EQ(numa_node[i], port::kNUMANoAffinity);
+      }
+    }
+  }
+  EXPECT_EQ(ThreadPool::CurrentThreadNumaNode(), port::kNUMANoAffinity);
+}
+
 void RunWithFixedBlockSize(int64_t block_size, int64_t total,
                            ThreadPool* threads) {
   mutex mu;
@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/nccl/nccl_manager.h"
 
+#include <algorithm>
 #include <utility>
 
 #if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
@@ -28,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/profiler/lib/annotated_traceme.h"
 #include "tensorflow/core/profiler/lib/connected_traceme.h"
 #include "tensorflow/core/profiler/lib/traceme.h"
+#include "tensorflow/core/util/env_var.h"
 #if GOOGLE_CUDA
 #include "tensorflow/compiler/xla/stream_executor/cuda/cuda_activation.h"
 #elif TENSORFLOW_USE_ROCM
@@ -230,6 +232,12 @@ NcclManager::NcclManager() {
 #if TENSORFLOW_USE_ROCM
   ++instance_count;
 #endif
+  int64_t max_grouped_launches;
+  TF_CHECK_OK(ReadInt64FromEnvVar("TF_NCCL_MAX_GROUPED_LAUNCHES", 1,
+                                  &max_grouped_launches));
+  max_grouped_launches_ = std::max<int64_t>(max_grouped_launches, 1);
+  TF_CHECK_OK(ReadInt64FromEnvVar("TF_NCCL_GROUP_LAUNCH_WINDOW_US", 0,
+                                  &group_launch_window_us_));
 }
 NcclManager::~NcclManager() {
   VLOG(2) << "~NcclManager " << this;
@@ -705,33 +713,17 @@ void NcclManager::LoopKernelLaunches(NcclStream* nccl_stream) {
   const cudaStream_t* cu_stream = reinterpret_cast<const cudaStream_t*>(
       comm_stream->implementation()->GpuStreamMemberHack());
 
-  while (true) {
-    // Find collective to run.
-    std::pair<Collective*, int> next_launch;
-    {
-      VLOG(3) << "Locking mutex nccl_stream " << nccl_stream;
-      mutex_lock l(nccl_stream->mu);
-      while (nccl_stream->pending_launches_.empty()) {
-        if (nccl_stream->shutdown_requested) {
-          // No work and shutdown requested, exit.
-          return;
-        }
-        nccl_stream->cv.wait(l);
-      }
-      next_launch = nccl_stream->pending_launches_.back();
-      nccl_stream->pending_launches_.pop_back();
-    }
-
-    // Launch the nccl kernel.
-    Collective* collective = next_launch.first;
+  // Enqueues the nccl kernel of participant `p_idx` of `collective`, and
+  // returns the result of the nccl call in `nccl_result`.
+  auto launch_kernel = [&](Collective* collective, int p_idx,
+                           ncclResult_t* nccl_result) -> Status {
     tensorflow::profiler::TraceMeConsumer traceme("Run Collective",
                                                   collective->trace_context);
 
     ncclDataType_t data_type = ToNcclType(collective->data_type);
-    int p_idx = next_launch.second;
     Participant* p = collective->participants[p_idx].get();
     auto nccl_comm = collective->communicator->members[p_idx].nccl_comm;
-    ncclResult_t nccl_result = ncclSuccess;
+    *nccl_result = ncclSuccess;
     switch (collective->type) {
       case kAllReduce: {
         const void* sendbuff = p->input->tensor_data().data();
@@ -749,9 +741,9 @@ void NcclManager::LoopKernelLaunches(NcclStream* nccl_stream) {
               {{"buffer_size", ComputeBufferSize(p, collective->data_type)},
                {"collective_type", "all_reduce"}});
         });
-        nccl_result = ncclAllReduce(sendbuff, recvbuff, p->input->NumElements(),
-                                    data_type, collective->reduction_op,
-                                    nccl_comm, *cu_stream);
+        *nccl_result = ncclAllReduce(
+            sendbuff, recvbuff, p->input->NumElements(), data_type,
+            collective->reduction_op, nccl_comm, *cu_stream);
         break;
       }
       case kBroadcast: {
@@ -770,10 +762,8 @@ void NcclManager::LoopKernelLaunches(NcclStream* nccl_stream) {
           recvbuff = const_cast<void*>(sendbuff);
         }
         if (num_elements < 0) {
-          p->done_callback(errors::Internal(
-              "Both input and output are null in ncclBroadcast"));
-          collective->Unref();
-          continue;
+          return errors::Internal(
+              "Both input and output are null in ncclBroadcast");
         }
         VLOG(2) << "call NcclBroadcast collective_key "
                 << collective->collective_key << " participant " << p_idx
@@ -786,7 +776,7 @@ void NcclManager::LoopKernelLaunches(NcclStream* nccl_stream) {
               {{"buffer_size", ComputeBufferSize(p, collective->data_type)},
                {"collective_type", "broadcast"}});
         });
-        nccl_result =
+        *nccl_result =
             ncclBroadcast(sendbuff, recvbuff, num_elements, data_type,
                           collective->root_rank, nccl_comm, *cu_stream);
         break;
@@ -802,9 +792,10 @@ void NcclManager::LoopKernelLaunches(NcclStream* nccl_stream) {
               {{"output_size", ComputeBufferSize(p, collective->data_type)},
                {"collective_type", "reduce"}});
         });
-        nccl_result = ncclReduce(sendbuff, recvbuff, p->input->NumElements(),
-                                 data_type, collective->reduction_op,
-                                 collective->root_rank, nccl_comm, *cu_stream);
+        *nccl_result = ncclReduce(
+            sendbuff, recvbuff, p->input->NumElements(), data_type,
+            collective->reduction_op, collective->root_rank, nccl_comm,
+            *cu_stream);
         break;
       }
       case kAllGather: {
@@ -824,28 +815,98 @@ void NcclManager::LoopKernelLaunches(NcclStream* nccl_stream) {
               {{"buffer_size", ComputeBufferSize(p, collective->data_type)},
                {"collective_type", "all_gather"}});
         });
-        nccl_result = ncclAllGather(sendbuff, recvbuff, p->input->NumElements(),
-                                    data_type, nccl_comm, *cu_stream);
+        *nccl_result =
+            ncclAllGather(sendbuff, recvbuff, p->input->NumElements(),
+                          data_type, nccl_comm, *cu_stream);
         break;
       }
     }
+    return OkStatus();
+  };
 
-    // Run the done_callback when the nccl kernel finishes running.
-    auto done_callback = [collective, p_idx, nccl_result]() {
-      VLOG(2) << "done Nccl kernel collective_key "
-              << collective->collective_key << " participant " << p_idx
-              << " ncclResult " << nccl_result;
-      if (nccl_result == ncclSuccess) {
-        collective->participants[p_idx]->done_callback(OkStatus());
-      } else {
-        // Propagate the error, but note that if other members of the collective
-        // did launch their kernels, then they are hanging.
-        collective->participants[p_idx]->done_callback(errors::Unknown(
-            "Error invoking NCCL: ", ncclGetErrorString(nccl_result)));
+  std::vector<std::pair<Collective*, int>> launches;
+  std::vector<ncclResult_t> nccl_results;
+  while (true) {
+    // Find collectives to run. Collectives are queued on every stream in the
+    // same order, so launching the pending ones as one nccl group keeps the
+    // order of the kernels on every communicator.
+    launches.clear();
+    {
+      VLOG(3) << "Locking mutex nccl_stream " << nccl_stream;
+      mutex_lock l(nccl_stream->mu);
+      while (nccl_stream->pending_launches_.empty()) {
+        if (nccl_stream->shutdown_requested) {
+          // No work and shutdown requested, exit.
+          return;
+        }
+        nccl_stream->cv.wait(l);
+      }
+      // Wait for collectives that become ready shortly after this one.
+      const uint64 deadline_us =
+          Env::Default()->NowMicros() + group_launch_window_us_;
+      while (nccl_stream->pending_launches_.size() < max_grouped_launches_ &&
+             !nccl_stream->shutdown_requested) {
+        const uint64 now_us = Env::Default()->NowMicros();
+        if (now_us >= deadline_us) break;
+        nccl_stream->cv.wait_for(
+            l, std::chrono::microseconds(deadline_us - now_us));
+      }
+      while (!nccl_stream->pending_launches_.empty() &&
+             launches.size() < max_grouped_launches_) {
+        launches.push_back(nccl_stream->pending_launches_.back());
+        nccl_stream->pending_launches_.pop_back();
+      }
+    }
+
+    // Launch the nccl kernels.
+    const bool grouped = launches.size() > 1;
+    ncclResult_t group_result = ncclSuccess;
+    if (grouped) {
+      VLOG(2) << "Launching " << launches.size()
+              << " collectives as one nccl group on comm_stream "
+              << comm_stream;
+      group_result = ncclGroupStart();
+    }
+    nccl_results.assign(launches.size(), ncclSuccess);
+    for (int i = 0; i < launches.size(); ++i) {
+      Collective* collective = launches[i].first;
+      int p_idx = launches[i].second;
+      Status status = launch_kernel(collective, p_idx, &nccl_results[i]);
+      if (!status.ok()) {
+        collective->participants[p_idx]->done_callback(status);
+        collective->Unref();
+        launches[i].first = nullptr;
       }
-      collective->Unref();
-    };
-    p->event_mgr->ThenExecute(comm_stream, done_callback);
+    }
+    if (grouped) {
+      ncclResult_t group_end_result = ncclGroupEnd();
+      if (group_result == ncclSuccess) group_result = group_end_result;
+    }
+
+    for (int i = 0; i < launches.size(); ++i) {
+      Collective* collective = launches[i].first;
+      if (collective == nullptr) continue;
+      int p_idx = launches[i].second;
+      ncclResult_t nccl_result =
+          nccl_results[i] == ncclSuccess ? group_result : nccl_results[i];
+      // Run the done_callback when the nccl kernel finishes running.
+      auto done_callback = [collective, p_idx, nccl_result]() {
+        VLOG(2) << "done Nccl kernel collective_key "
+                << collective->collective_key << " participant " << p_idx
+                << " ncclResult " << nccl_result;
+        if (nccl_result == ncclSuccess) {
+          collective->participants[p_idx]->done_callback(OkStatus());
+        } else {
+          // Propagate the error, but note that if other members of the
+          // collective did launch their kernels, then they are hanging.
+          collective->participants[p_idx]->done_callback(errors::Unknown(
+              "Error invoking NCCL: ", ncclGetErrorString(nccl_result)));
+        }
+        collective->Unref();
+      };
+      collective->participants[p_idx]->event_mgr->ThenExecute(comm_stream,
+                                                              done_callback);
+    }
   }
 }
 
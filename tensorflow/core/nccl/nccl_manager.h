@@ -257,6 +257,16 @@ class NcclManager {
 
   Status status_ TF_GUARDED_BY(mu_);
 
+  // The most collectives that a stream launches as one nccl group, set by
+  // TF_NCCL_MAX_GROUPED_LAUNCHES. Collectives that are pending on the stream
+  // when it becomes idle are grouped, so that many small collectives pay the
+  // launch latency once.
+  size_t max_grouped_launches_;
+
+  // How long a stream waits for more collectives to group with the first
+  // pending one, set by TF_NCCL_GROUP_LAUNCH_WINDOW_US.
+  int64_t group_launch_window_us_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(NcclManager);
 };
 
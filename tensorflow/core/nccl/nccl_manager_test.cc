@@ -573,6 +573,47 @@ TYPED_TEST(NcclManagerTest, MultipleCallers) {
   }
 }
 
+// Same as the Basic test, but with many reductions that become ready together
+// and are launched in nccl groups.
+TYPED_TEST(NcclManagerTest, GroupedLaunches) {
+  const int num_ranks = this->NumGPUs();
+  const int num_collectives = 16;
+  setenv("TF_NCCL_MAX_GROUPED_LAUNCHES", "8", 1 /* replace */);
+  setenv("TF_NCCL_GROUP_LAUNCH_WINDOW_US", "1000", 1 /* replace */);
+  NcclManager nccl_manager;
+  unsetenv("TF_NCCL_MAX_GROUPED_LAUNCHES");
+  unsetenv("TF_NCCL_GROUP_LAUNCH_WINDOW_US");
+
+  std::vector<std::unique_ptr<typename TestFixture::TestCase>> test_cases;
+  for (int i = 0; i < num_collectives; ++i) {
+    test_cases.emplace_back(this->MakeReductionTestCase(
+        /*num_nodes=*/1, num_ranks, ncclSum, TensorShape({i + 1, 3}),
+        1.1f * i));
+  }
+  for (int rank = 0; rank < num_ranks; ++rank) {
+    auto* device = this->GetDevice(num_ranks, /*node=*/0, rank);
+    auto* info = device->tensorflow_accelerator_device_info();
+    auto* stream = device->tensorflow_accelerator_device_info()->stream;
+    for (int i = 0; i < num_collectives; ++i) {
+      typename TestFixture::TestCase* test_case = test_cases[i].get();
+      auto participant = absl::make_unique<NcclManager::Participant>(
+          device->executor(), stream, info, &test_case->ins[rank],
+          &test_case->outs[rank], /*global_rank=*/-1,
+          this->CreateDoneCallback(test_case));
+      nccl_manager.AddToAllReduce(
+          std::move(participant),
+          {strings::StrCat("allreduce", i), /*num_local_devices=*/num_ranks,
+           /*num_global_devices=*/num_ranks, /*communicator_key=*/"",
+           /*source_rank=*/-1},
+          ncclSum);
+    }
+  }
+
+  for (int i = 0; i < num_collectives; ++i) {
+    this->VerifyResults(test_cases[i].get());
+  }
+}
+
 // Test basic all-gather.
 TYPED_TEST(NcclManagerTest, BasicAllGather) {
   const int num_ranks = this->NumGPUs();
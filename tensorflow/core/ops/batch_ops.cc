@@ -54,6 +54,9 @@ REGISTER_OP("BatchFunction")
     // NOTE: Support for `enable_large_batch_splitting == true` is still
     // developed in progress.
     .Attr("enable_large_batch_splitting: bool = false")
+    // If 'sequence_length_buckets' is not empty, inputs are batched by bucket
+    // of the size of their first dimension, and padded with zeros along it.
+    .Attr("sequence_length_buckets: list(int) = []")  // Added by Alpa.
     // TODO(apassos): Fix this shape inference function. It requires shape
     // inference of function calls.
     .SetShapeFn(shape_inference::UnknownShape)
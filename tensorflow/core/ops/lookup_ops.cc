@@ -400,6 +400,7 @@ REGISTER_OP("MutableHashTableV2")
     .Attr("use_node_name_sharing: bool = false")
     .Attr("key_dtype: type")
     .Attr("value_dtype: type")
+    .Attr("num_shards: int >= 1 = 1")  // Added by Alpa.
     .SetIsStateful()
     .SetShapeFn(MutableHashTableShapeFn);
 
@@ -1449,6 +1449,66 @@ REGISTER_OP("SparseSegmentSqrtNGrad")
     .Attr("Tsegmentids: {int32, int64} = DT_INT32")
     .SetShapeFn(SparseSegmentReductionGradShapeFn);
 
+// Added by Alpa
+REGISTER_OP("EmbeddingLookupSparse")
+    .Input("params: T")
+    .Input("indices: Tidx")
+    .Input("segment_ids: Tsegmentids")
+    .Input("weights: T")
+    .Input("num_segments: Tnumsegments")
+    .Output("output: T")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'} = 'mean'")
+    .Attr("T: {float, double}")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .Attr("Tnumsegments: {int32, int64} = DT_INT32")
+    .Attr("Tsegmentids: {int32, int64} = DT_INT32")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle params_shape;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &params_shape));
+      ShapeHandle ids_shape;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &ids_shape));
+      ShapeHandle segment_ids_shape;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &segment_ids_shape));
+      TF_RETURN_IF_ERROR(c->Merge(ids_shape, segment_ids_shape, &ids_shape));
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 1, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(4), 0, &unused));
+
+      DimensionHandle num_segments;
+      TF_RETURN_IF_ERROR(c->MakeDimForScalarInput(4, &num_segments));
+      ShapeHandle out;
+      TF_RETURN_IF_ERROR(c->ReplaceDim(params_shape, 0, num_segments, &out));
+      c->set_output(0, out);
+      return OkStatus();
+    });
+
+// Added by Alpa
+REGISTER_OP("EmbeddingLookupSparseGrad")
+    .Input("grad: T")
+    .Input("params: T")
+    .Input("indices: Tidx")
+    .Input("segment_ids: Tsegmentids")
+    .Input("weights: T")
+    .Input("output: T")
+    .Output("params_grad: T")
+    .Output("weights_grad: T")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'} = 'mean'")
+    .Attr("T: {float, double}")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .Attr("Tsegmentids: {int32, int64} = DT_INT32")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle params_shape;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(1), 1, &params_shape));
+      ShapeHandle ids_shape;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &ids_shape));
+      ShapeHandle out;
+      TF_RETURN_IF_ERROR(
+          c->ReplaceDim(params_shape, 0, c->Dim(ids_shape, 0), &out));
+      c->set_output(0, out);
+      c->set_output(1, c->input(4));
+      return OkStatus();
+    });
+
 REGISTER_OP("All")
     .Input("input: bool")
     .Input("reduction_indices: Tidx")
@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/map_util.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/scanner.h"
 #include "tensorflow/core/platform/str_util.h"
 #include "tensorflow/core/platform/types.h"
@@ -115,9 +116,55 @@ class LibCurlProxy : public LibCurl {
 
   void curl_free(void* p) override { ::curl_free(p); }
 };
+
+// Process-wide share handle through which requests made with the real libcurl
+// share their connection pool, DNS cache and TLS sessions. Without it every
+// CurlHttpRequest opens (and handshakes) a new connection.
+class CurlShare {
+ public:
+  static CURLSH* Get() {
+    static CurlShare* share = new CurlShare;
+    return share->share_;
+  }
+
+ private:
+  CurlShare() {
+    LibCurlProxy::Load();  // Ensures curl_global_init has run.
+    share_ = curl_share_init();
+    CHECK(share_ != nullptr) << "Couldn't initialize a curl share handle.";
+    CHECK_EQ(curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &CurlShare::Lock),
+             CURLSHE_OK);
+    CHECK_EQ(
+        curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, &CurlShare::Unlock),
+        CURLSHE_OK);
+    CHECK_EQ(curl_share_setopt(share_, CURLSHOPT_USERDATA, this), CURLSHE_OK);
+    for (curl_lock_data data :
+         {CURL_LOCK_DATA_CONNECT, CURL_LOCK_DATA_DNS,
+          CURL_LOCK_DATA_SSL_SESSION}) {
+      CHECK_EQ(curl_share_setopt(share_, CURLSHOPT_SHARE, data), CURLSHE_OK);
+    }
+  }
+
+  static void Lock(CURL* handle, curl_lock_data data, curl_lock_access access,
+                   void* userptr) {
+    static_cast<CurlShare*>(userptr)->mu_[data].lock();
+  }
+
+  static void Unlock(CURL* handle, curl_lock_data data, void* userptr) {
+    static_cast<CurlShare*>(userptr)->mu_[data].unlock();
+  }
+
+  CURLSH* share_;
+  mutex mu_[CURL_LOCK_DATA_LAST];
+};
 }  // namespace
 
-CurlHttpRequest::CurlHttpRequest() : CurlHttpRequest(LibCurlProxy::Load()) {}
+CurlHttpRequest::CurlHttpRequest() : CurlHttpRequest(LibCurlProxy::Load()) {
+  // Reuse connections across requests. Injected LibCurl implementations (used
+  // in tests) do not get a share handle.
+  CHECK_CURL_OK(libcurl_->curl_easy_setopt(
+      curl_, CURLOPT_SHARE, static_cast<void*>(CurlShare::Get())));
+}
 
 CurlHttpRequest::CurlHttpRequest(LibCurl* libcurl, Env* env)
     : libcurl_(libcurl), env_(env) {
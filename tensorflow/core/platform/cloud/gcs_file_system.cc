@@ -24,6 +24,8 @@ limitations under the License.
 #include <cstring>
 #include <fstream>
 #include <functional>
+#include <memory>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -36,6 +38,7 @@ limitations under the License.
 #include "absl/base/macros.h"
 #include "json/json.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/cloud/curl_http_request.h"
 #include "tensorflow/core/platform/cloud/file_block_cache.h"
 #include "tensorflow/core/platform/cloud/google_auth_provider.h"
@@ -47,6 +50,7 @@ limitations under the License.
 #include "tensorflow/core/platform/numbers.h"
 #include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/platform/random.h"
 #include "tensorflow/core/platform/retrying_utils.h"
 #include "tensorflow/core/platform/str_util.h"
 #include "tensorflow/core/platform/stringprintf.h"
@@ -149,6 +153,40 @@ constexpr char kAppendMode[] = "GCS_APPEND_MODE";
 // objects.
 constexpr char kComposeAppend[] = "compose";
 
+// The environment variable that overrides the number of concurrent ranged GETs
+// used to load a single block or buffer. "1" disables parallel reads.
+constexpr char kReadParallelism[] = "GCS_READ_PARALLELISM";
+constexpr int kDefaultReadParallelism = 8;
+// The environment variable that overrides the minimum size of a single ranged
+// GET of a parallel read. Specified in MB.
+constexpr char kReadMinRangeSize[] = "GCS_READ_MIN_RANGE_SIZE_MB";
+// The environment variable that enables ("1", the default) or disables ("0")
+// background read-ahead of sequentially read files.
+constexpr char kReadPrefetch[] = "GCS_READ_PREFETCH";
+// The environment variable that overrides the smallest buffer size a buffered
+// file shrinks to on random reads. Specified in MB; "0" keeps the buffer size
+// fixed at the block size.
+constexpr char kReadMinBufferSize[] = "GCS_READ_MIN_BUFFER_SIZE_MB";
+constexpr size_t kDefaultReadMinBufferSize = 1024 * 1024;
+// Number of threads running background read-ahead. Read-ahead that has not
+// started by the time its data is needed is cancelled, so a busy pool only
+// costs the overlap, not correctness.
+constexpr int kReadPrefetchThreads = 16;
+
+// The environment variable that enables ("1") parallel composite uploads of
+// files opened with NewWritableFile. Like GCS_APPEND_MODE=compose, this is
+// disabled by default as the temporary component objects may be stranded if
+// the process dies before the file is closed.
+constexpr char kCompositeUpload[] = "GCS_COMPOSITE_UPLOAD";
+// The environment variable that overrides the number of chunks a single file
+// uploads concurrently.
+constexpr char kWriteParallelism[] = "GCS_WRITE_PARALLELISM";
+// The environment variable that overrides the chunk size of composite uploads.
+// Specified in MB.
+constexpr char kWriteChunkSize[] = "GCS_WRITE_CHUNK_SIZE_MB";
+// Number of threads uploading chunks, shared by all files.
+constexpr int kUploadThreads = 32;
+
 Status GetTmpFilename(string* filename) {
   *filename = io::GetTempFilename("");
   return OkStatus();
@@ -299,15 +337,34 @@ class BufferedGcsRandomAccessFile : public RandomAccessFile {
   using ReadFn =
       std::function<Status(const string& filename, uint64 offset, size_t n,
                            StringPiece* result, char* scratch)>;
+  using ScheduleFn = std::function<void(std::function<void()>)>;
 
   // Initialize the reader. Provided read_fn should be thread safe.
+  //
+  // If min_buffer_size is nonzero, the buffer shrinks towards it on random
+  // reads and grows back to buffer_size on sequential reads. If schedule_fn is
+  // set, the next buffer is fetched in the background through it once reads
+  // are sequential.
   BufferedGcsRandomAccessFile(const string& filename, uint64 buffer_size,
-                              ReadFn read_fn)
+                              ReadFn read_fn, uint64 min_buffer_size = 0,
+                              ScheduleFn schedule_fn = nullptr)
       : filename_(filename),
         read_fn_(std::move(read_fn)),
         buffer_size_(buffer_size),
+        min_buffer_size_(std::min(min_buffer_size, buffer_size)),
+        schedule_fn_(std::move(schedule_fn)),
         buffer_start_(0),
-        buffer_end_is_past_eof_(false) {}
+        buffer_end_is_past_eof_(false),
+        current_buffer_size_(buffer_size) {}
+
+  ~BufferedGcsRandomAccessFile() override {
+    mutex_lock l(buffer_mutex_);
+    if (prefetch_ != nullptr) {
+      // A prefetch that is already running finishes into its own buffer.
+      mutex_lock prefetch_lock(prefetch_->mu);
+      prefetch_->cancelled = true;
+    }
+  }
 
   Status Name(StringPiece* result) const override {
     *result = filename_;
@@ -334,7 +391,7 @@ class BufferedGcsRandomAccessFile : public RandomAccessFile {
       bool consumed_buffer_to_eof =
           offset + copy_size >= buffer_end && buffer_end_is_past_eof_;
       if (copy_size < n && !consumed_buffer_to_eof) {
-        Status status = FillBuffer(offset + copy_size);
+        Status status = FillBuffer(offset + copy_size, n - copy_size);
         if (!status.ok() && !errors::IsOutOfRange(status)) {
           // Empty the buffer to avoid caching bad reads.
           buffer_.resize(0);
@@ -357,27 +414,125 @@ class BufferedGcsRandomAccessFile : public RandomAccessFile {
   }
 
  private:
-  Status FillBuffer(uint64 start) const
+  // A background read of the buffer following the current one.
+  struct Prefetch {
+    Prefetch(uint64 start, size_t size) : start(start), size(size) {}
+
+    const uint64 start;
+    const size_t size;
+
+    mutex mu;
+    condition_variable done_cv;
+    bool started TF_GUARDED_BY(mu) = false;
+    bool cancelled TF_GUARDED_BY(mu) = false;
+    bool done TF_GUARDED_BY(mu) = false;
+    string data TF_GUARDED_BY(mu);
+    Status status TF_GUARDED_BY(mu);
+  };
+
+  // Refills the buffer from `start` with at least `min_size` bytes (unless EOF
+  // is reached first).
+  Status FillBuffer(uint64 start, size_t min_size) const
       TF_EXCLUSIVE_LOCKS_REQUIRED(buffer_mutex_) {
+    const bool sequential =
+        !first_fill_ && start == buffer_start_ + buffer_.size();
+    if (min_buffer_size_ > 0 && !first_fill_) {
+      current_buffer_size_ =
+          sequential ? std::min(current_buffer_size_ * 2, buffer_size_)
+                     : std::max(current_buffer_size_ / 2, min_buffer_size_);
+    }
+    first_fill_ = false;
+
+    Status status;
+    std::shared_ptr<Prefetch> prefetch = std::move(prefetch_);
+    if (!TakePrefetch(prefetch.get(), start, min_size, &status)) {
+      const size_t size = std::max<uint64>(current_buffer_size_, min_size);
+      buffer_.resize(size);
+      StringPiece str_piece;
+      status = read_fn_(filename_, start, size, &str_piece, &(buffer_[0]));
+      buffer_.resize(str_piece.size());
+    }
     buffer_start_ = start;
-    buffer_.resize(buffer_size_);
-    StringPiece str_piece;
-    Status status = read_fn_(filename_, buffer_start_, buffer_size_, &str_piece,
-                             &(buffer_[0]));
     buffer_end_is_past_eof_ = errors::IsOutOfRange(status);
-    buffer_.resize(str_piece.size());
+    if (status.ok() && sequential && schedule_fn_ != nullptr) {
+      StartPrefetch(start + buffer_.size(), current_buffer_size_);
+    }
     return status;
   }
 
+  // Moves the data of `prefetch` into the buffer if it covers the requested
+  // range, waiting for it to finish if needed. Returns false if the caller has
+  // to read the range itself; a prefetch that has not started yet is cancelled
+  // since reading directly is never slower.
+  bool TakePrefetch(Prefetch* prefetch, uint64 start, size_t min_size,
+                    Status* status) const
+      TF_EXCLUSIVE_LOCKS_REQUIRED(buffer_mutex_) {
+    if (prefetch == nullptr) {
+      return false;
+    }
+    mutex_lock l(prefetch->mu);
+    if (!prefetch->started) {
+      prefetch->cancelled = true;
+      return false;
+    }
+    if (prefetch->start != start || prefetch->size < min_size) {
+      return false;
+    }
+    while (!prefetch->done) {
+      prefetch->done_cv.wait(l);
+    }
+    if (!prefetch->status.ok() && !errors::IsOutOfRange(prefetch->status)) {
+      // Let the caller retry the read so that the error is reported for the
+      // read that actually needs the data.
+      return false;
+    }
+    buffer_.swap(prefetch->data);
+    *status = prefetch->status;
+    return true;
+  }
+
+  void StartPrefetch(uint64 start, size_t size) const
+      TF_EXCLUSIVE_LOCKS_REQUIRED(buffer_mutex_) {
+    auto prefetch = std::make_shared<Prefetch>(start, size);
+    prefetch_ = prefetch;
+    // The task only holds copies, so it may outlive this file.
+    schedule_fn_([prefetch, read_fn = read_fn_, filename = filename_]() {
+      {
+        mutex_lock l(prefetch->mu);
+        if (prefetch->cancelled) {
+          return;
+        }
+        prefetch->started = true;
+      }
+      string data(prefetch->size, '\0');
+      StringPiece str_piece;
+      Status status =
+          read_fn(filename, prefetch->start, prefetch->size, &str_piece,
+                  &(data[0]));
+      data.resize(str_piece.size());
+      mutex_lock l(prefetch->mu);
+      prefetch->data = std::move(data);
+      prefetch->status = status;
+      prefetch->done = true;
+      prefetch->done_cv.notify_all();
+    });
+  }
+
   // The filename of this file.
   const string filename_;
 
   // The implementation of the read operation (provided by the GCSFileSystem).
   const ReadFn read_fn_;
 
-  // Size of buffer that we read from GCS each time we send a request.
+  // Maximum size of buffer that we read from GCS each time we send a request.
   const uint64 buffer_size_;
 
+  // Smallest size the buffer adapts down to; 0 keeps it at buffer_size_.
+  const uint64 min_buffer_size_;
+
+  // Schedules background read-ahead; null if read-ahead is disabled.
+  const ScheduleFn schedule_fn_;
+
   // Mutex for buffering operations that can be accessed from multiple threads.
   // The following members are mutable in order to provide a const Read.
   mutable mutex buffer_mutex_;
@@ -388,6 +543,13 @@ class BufferedGcsRandomAccessFile : public RandomAccessFile {
   mutable bool buffer_end_is_past_eof_ TF_GUARDED_BY(buffer_mutex_);
 
   mutable string buffer_ TF_GUARDED_BY(buffer_mutex_);
+
+  // Size of the next buffer fill, adapted to the access pattern.
+  mutable uint64 current_buffer_size_ TF_GUARDED_BY(buffer_mutex_);
+
+  mutable bool first_fill_ TF_GUARDED_BY(buffer_mutex_) = true;
+
+  mutable std::shared_ptr<Prefetch> prefetch_ TF_GUARDED_BY(buffer_mutex_);
 };
 
 // Function object declaration with params needed to create upload sessions.
@@ -737,6 +899,295 @@ class GcsWritableFile : public WritableFile {
   const GenerationGetter generation_getter_;
 };
 
+/// \brief GCS-based implementation of a writeable file that streams its
+/// content as a parallel composite upload.
+///
+/// Appended data is buffered in memory in chunks of `chunk_size` bytes. Full
+/// chunks are uploaded concurrently as temporary component objects, and
+/// Sync() composes all components into the destination object. At most
+/// `max_pending_uploads` chunks are in flight; Append() blocks once that limit
+/// is reached, which bounds memory use to about
+/// (max_pending_uploads + 1) * chunk_size. Files smaller than one chunk are
+/// uploaded directly without temporary objects.
+class GcsCompositeWritableFile : public WritableFile {
+ public:
+  using ScheduleFn = std::function<void(std::function<void()>)>;
+
+  GcsCompositeWritableFile(const string& bucket, const string& object,
+                           GcsFileSystem* filesystem,
+                           GcsFileSystem::TimeoutConfig* timeouts,
+                           std::function<void()> file_cache_erase,
+                           RetryConfig retry_config, size_t chunk_size,
+                           int max_pending_uploads, ScheduleFn schedule_fn)
+      : bucket_(bucket),
+        object_(object),
+        filesystem_(filesystem),
+        timeouts_(timeouts),
+        file_cache_erase_(std::move(file_cache_erase)),
+        retry_config_(retry_config),
+        chunk_size_(std::max<size_t>(chunk_size, 1)),
+        max_pending_uploads_(std::max(max_pending_uploads, 1)),
+        schedule_fn_(std::move(schedule_fn)),
+        component_prefix_(strings::StrCat(
+            io::Dirname(object_), "/.tmpcompose/", io::Basename(object_), ".",
+            strings::Hex(random::New64()))) {
+    VLOG(3) << "GcsCompositeWritableFile: " << GetGcsPath();
+  }
+
+  ~GcsCompositeWritableFile() override {
+    Close().IgnoreError();
+    WaitForUploads().IgnoreError();
+    DeleteTemporaryObjects();
+  }
+
+  Status Append(StringPiece data) override {
+    TF_RETURN_IF_ERROR(CheckWritable());
+    VLOG(3) << "Append: " << GetGcsPath() << " size " << data.length();
+    sync_needed_ = true;
+    position_ += data.size();
+    while (!data.empty()) {
+      const size_t copy_size =
+          std::min(data.size(), chunk_size_ - chunk_.size());
+      chunk_.append(data.data(), copy_size);
+      data.remove_prefix(copy_size);
+      if (chunk_.size() == chunk_size_) {
+        TF_RETURN_IF_ERROR(StartComponentUpload());
+      }
+    }
+    return OkStatus();
+  }
+
+  Status Close() override {
+    VLOG(3) << "Close:" << GetGcsPath();
+    if (closed_) {
+      return OkStatus();
+    }
+    TF_RETURN_IF_ERROR(Sync());
+    closed_ = true;
+    chunk_.clear();
+    chunk_.shrink_to_fit();
+    DeleteTemporaryObjects();
+    return OkStatus();
+  }
+
+  Status Flush() override {
+    VLOG(3) << "Flush:" << GetGcsPath();
+    return Sync();
+  }
+
+  Status Name(StringPiece* result) const override {
+    return errors::Unimplemented(
+        "GcsCompositeWritableFile does not support Name()");
+  }
+
+  Status Sync() override {
+    VLOG(3) << "Sync started:" << GetGcsPath();
+    TF_RETURN_IF_ERROR(CheckWritable());
+    if (!sync_needed_) {
+      return OkStatus();
+    }
+    Status status = SyncImpl();
+    VLOG(3) << "Sync finished " << GetGcsPath();
+    if (status.ok()) {
+      sync_needed_ = false;
+      // Erase the file from the file cache on every successful write.
+      file_cache_erase_();
+    }
+    return status;
+  }
+
+  Status Tell(int64_t* position) override {
+    *position = position_;
+    return OkStatus();
+  }
+
+ private:
+  // The maximum number of source objects of a single compose request.
+  static constexpr size_t kMaxComposeSources = 32;
+
+  Status SyncImpl() {
+    if (components_.empty()) {
+      // Everything still fits into the first chunk. Upload it directly and
+      // keep it buffered, so that later appends re-upload it like
+      // GcsWritableFile does.
+      return UploadObject(object_, chunk_);
+    }
+    if (!chunk_.empty()) {
+      TF_RETURN_IF_ERROR(StartComponentUpload());
+    }
+    TF_RETURN_IF_ERROR(WaitForUploads());
+    return ComposeComponents();
+  }
+
+  Status CheckWritable() const {
+    if (closed_) {
+      return errors::FailedPrecondition("The file is already closed.");
+    }
+    return OkStatus();
+  }
+
+  // Hands the current chunk to the upload pool as the next component.
+  Status StartComponentUpload() {
+    {
+      mutex_lock l(mu_);
+      while (pending_uploads_ >= max_pending_uploads_) {
+        upload_done_.wait(l);
+      }
+      TF_RETURN_IF_ERROR(upload_status_);
+      ++pending_uploads_;
+    }
+    auto data = std::make_shared<string>();
+    data->swap(chunk_);
+    const string component =
+        strings::StrCat(component_prefix_, ".", components_.size());
+    components_.push_back(component);
+    schedule_fn_([this, data, component]() {
+      Status status = UploadObject(component, *data);
+      mutex_lock l(mu_);
+      upload_status_.Update(status);
+      --pending_uploads_;
+      upload_done_.notify_all();
+    });
+    return OkStatus();
+  }
+
+  // Waits for all component uploads and returns the first error, if any.
+  Status WaitForUploads() {
+    mutex_lock l(mu_);
+    while (pending_uploads_ > 0) {
+      upload_done_.wait(l);
+    }
+    return upload_status_;
+  }
+
+  /// Composes all components into the destination object. More components
+  /// than a single compose request accepts are first composed into
+  /// intermediate objects.
+  Status ComposeComponents() {
+    std::vector<string> sources = components_;
+    for (int level = 0; sources.size() > kMaxComposeSources; ++level) {
+      std::vector<string> composed;
+      for (size_t i = 0; i < sources.size(); i += kMaxComposeSources) {
+        const string target = strings::StrCat(component_prefix_, ".compose",
+                                              level, ".", composed.size());
+        const size_t end = std::min(i + kMaxComposeSources, sources.size());
+        TF_RETURN_IF_ERROR(ComposeObjects(
+            std::vector<string>(sources.begin() + i, sources.begin() + end),
+            target));
+        intermediates_.insert(target);
+        composed.push_back(target);
+      }
+      sources = std::move(composed);
+    }
+    return ComposeObjects(sources, object_);
+  }
+
+  Status ComposeObjects(const std::vector<string>& sources,
+                        const string& target) {
+    VLOG(3) << "ComposeObjects: " << sources.size() << " objects to "
+            << GetGcsPathWithObject(target);
+    string request_body = "{'sourceObjects': [";
+    for (size_t i = 0; i < sources.size(); ++i) {
+      strings::StrAppend(&request_body, i > 0 ? "," : "", "{'name': '",
+                         sources[i], "'}");
+    }
+    request_body.append("]}");
+    return RetryingUtils::CallWithRetries(
+        [&request_body, &target, this]() {
+          std::unique_ptr<HttpRequest> request;
+          TF_RETURN_IF_ERROR(filesystem_->CreateHttpRequest(&request));
+          request->SetUri(strings::StrCat(kGcsUriBase, "b/", bucket_, "/o/",
+                                          request->EscapeString(target),
+                                          "/compose"));
+          request->SetTimeouts(timeouts_->connect, timeouts_->idle,
+                               timeouts_->metadata);
+          request->AddHeader("content-type", "application/json");
+          request->SetPostFromBuffer(request_body.c_str(), request_body.size());
+          TF_RETURN_WITH_CONTEXT_IF_ERROR(
+              request->Send(), " when composing to ",
+              GetGcsPathWithObject(target));
+          return OkStatus();
+        },
+        retry_config_);
+  }
+
+  /// Uploads `data` as `object` with a single-request media upload.
+  Status UploadObject(const string& object, const string& data) {
+    return RetryingUtils::CallWithRetries(
+        [&object, &data, this]() {
+          std::unique_ptr<HttpRequest> request;
+          TF_RETURN_IF_ERROR(filesystem_->CreateHttpRequest(&request));
+          request->SetUri(strings::StrCat(
+              kGcsUploadUriBase, "b/", bucket_,
+              "/o?uploadType=media&name=", request->EscapeString(object)));
+          request->SetTimeouts(timeouts_->connect, timeouts_->idle,
+                               timeouts_->write);
+          if (data.empty()) {
+            request->SetPostEmptyBody();
+          } else {
+            request->SetPostFromBuffer(data.data(), data.size());
+          }
+          TF_RETURN_WITH_CONTEXT_IF_ERROR(request->Send(), " when uploading ",
+                                          GetGcsPathWithObject(object));
+          return OkStatus();
+        },
+        retry_config_);
+  }
+
+  /// Deletes the uploaded components and intermediate objects. Failures are
+  /// only logged since the destination object is complete at this point.
+  void DeleteTemporaryObjects() {
+    std::vector<string> objects = std::move(components_);
+    objects.insert(objects.end(), intermediates_.begin(), intermediates_.end());
+    components_.clear();
+    intermediates_.clear();
+    BlockingCounter counter(objects.size());
+    for (const string& object : objects) {
+      schedule_fn_([this, &object, &counter]() {
+        const string path = GetGcsPathWithObject(object);
+        Status status = RetryingUtils::DeleteWithRetries(
+            [&path, this]() { return filesystem_->DeleteFile(path, nullptr); },
+            retry_config_);
+        if (!status.ok()) {
+          LOG(WARNING) << "Could not delete temporary object " << path << ": "
+                       << status;
+        }
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+
+  string GetGcsPathWithObject(string object) const {
+    return strings::StrCat("gs://", bucket_, "/", object);
+  }
+  string GetGcsPath() const { return GetGcsPathWithObject(object_); }
+
+  const string bucket_;
+  const string object_;
+  GcsFileSystem* const filesystem_;  // Not owned.
+  GcsFileSystem::TimeoutConfig* timeouts_;
+  std::function<void()> file_cache_erase_;
+  const RetryConfig retry_config_;
+  const size_t chunk_size_;
+  const int max_pending_uploads_;
+  const ScheduleFn schedule_fn_;
+  // Common prefix of the temporary objects of this file.
+  const string component_prefix_;
+
+  string chunk_;  // Data not handed to an upload yet.
+  int64_t position_ = 0;
+  bool sync_needed_ = true;
+  bool closed_ = false;
+  std::vector<string> components_;  // In file order.
+  std::set<string> intermediates_;
+
+  mutex mu_;
+  condition_variable upload_done_;
+  int pending_uploads_ TF_GUARDED_BY(mu_) = 0;
+  Status upload_status_ TF_GUARDED_BY(mu_);
+};
+
 class GcsReadOnlyMemoryRegion : public ReadOnlyMemoryRegion {
  public:
   GcsReadOnlyMemoryRegion(std::unique_ptr<char[]> data, uint64 length)
@@ -929,6 +1380,46 @@ GcsFileSystem::GcsFileSystem(bool make_default_cache) {
   } else {
     compose_append_ = false;
   }
+
+  // Apply the overrides for parallel reads and read-ahead, which are enabled by
+  // default outside of tests.
+  ReadConfig read_config;
+  read_config.parallelism = kDefaultReadParallelism;
+  read_config.prefetch = true;
+  read_config.min_buffer_size = kDefaultReadMinBufferSize;
+  int64_t parallelism;
+  if (GetEnvVar(kReadParallelism, strings::safe_strto64, &parallelism)) {
+    read_config.parallelism = static_cast<int>(parallelism);
+  }
+  if (GetEnvVar(kReadMinRangeSize, strings::safe_strtou64, &value)) {
+    read_config.min_range_size = value * 1024 * 1024;
+  }
+  if (GetEnvVar(kReadPrefetch, strings::safe_strtou64, &value)) {
+    read_config.prefetch = value != 0;
+  }
+  if (GetEnvVar(kReadMinBufferSize, strings::safe_strtou64, &value)) {
+    read_config.min_buffer_size = value * 1024 * 1024;
+  }
+  VLOG(1) << "GCS read parallelism = " << read_config.parallelism << " ; "
+          << "min range size = " << read_config.min_range_size << " ; "
+          << "prefetch = " << read_config.prefetch << " ; "
+          << "min buffer size = " << read_config.min_buffer_size;
+  SetReadConfig(read_config);
+
+  WriteConfig write_config;
+  if (GetEnvVar(kCompositeUpload, strings::safe_strtou64, &value)) {
+    write_config.composite_upload = value != 0;
+  }
+  if (GetEnvVar(kWriteParallelism, strings::safe_strtou64, &value)) {
+    write_config.parallelism = static_cast<int>(value);
+  }
+  if (GetEnvVar(kWriteChunkSize, strings::safe_strtou64, &value)) {
+    write_config.chunk_size = value * 1024 * 1024;
+  }
+  VLOG(1) << "GCS composite upload = " << write_config.composite_upload
+          << " ; write parallelism = " << write_config.parallelism << " ; "
+          << "chunk size = " << write_config.chunk_size;
+  SetWriteConfig(write_config);
 }
 
 GcsFileSystem::GcsFileSystem(
@@ -996,6 +1487,12 @@ Status GcsFileSystem::NewRandomAccessFile(
       return OkStatus();
     }));
   } else {
+    BufferedGcsRandomAccessFile::ScheduleFn schedule_fn;
+    if (prefetch_thread_pool_ != nullptr) {
+      schedule_fn = [this](std::function<void()> fn) {
+        prefetch_thread_pool_->Schedule(std::move(fn));
+      };
+    }
     result->reset(new BufferedGcsRandomAccessFile(
         fname, block_size_,
         [this, bucket, object](const string& fname, uint64 offset, size_t n,
@@ -1011,11 +1508,39 @@ Status GcsFileSystem::NewRandomAccessFile(
                                       " bytes requested.");
           }
           return OkStatus();
-        }));
+        },
+        read_config_.min_buffer_size, std::move(schedule_fn)));
   }
   return OkStatus();
 }
 
+void GcsFileSystem::SetReadConfig(const ReadConfig& read_config) {
+  read_config_ = read_config;
+  read_config_.min_range_size = std::max<size_t>(read_config_.min_range_size, 1);
+  // Destroying the old pools waits for their outstanding tasks.
+  read_thread_pool_.reset();
+  prefetch_thread_pool_.reset();
+  if (read_config_.parallelism > 1) {
+    // Each parallel read runs one of its ranges on the calling thread; size the
+    // pool so that a few files can load their remaining ranges concurrently.
+    read_thread_pool_ = std::make_unique<thread::ThreadPool>(
+        Env::Default(), "gcs_read", 4 * (read_config_.parallelism - 1));
+  }
+  if (read_config_.prefetch) {
+    prefetch_thread_pool_ = std::make_unique<thread::ThreadPool>(
+        Env::Default(), "gcs_prefetch", kReadPrefetchThreads);
+  }
+}
+
+void GcsFileSystem::SetWriteConfig(const WriteConfig& write_config) {
+  write_config_ = write_config;
+  upload_thread_pool_.reset();
+  if (write_config_.composite_upload) {
+    upload_thread_pool_ = std::make_unique<thread::ThreadPool>(
+        Env::Default(), "gcs_upload", kUploadThreads);
+  }
+}
+
 void GcsFileSystem::ResetFileBlockCache(size_t block_size_bytes,
                                         size_t max_bytes,
                                         uint64 max_staleness_secs) {
@@ -1043,11 +1568,57 @@ std::unique_ptr<FileBlockCache> GcsFileSystem::MakeFileBlockCache(
   return file_block_cache;
 }
 
-// A helper function to actually read the data from GCS.
+// Reads the data from GCS, splitting large reads into concurrent ranged GETs.
 Status GcsFileSystem::LoadBufferFromGCS(const string& fname, size_t offset,
                                         size_t n, char* buffer,
                                         size_t* bytes_transferred) {
   *bytes_transferred = 0;
+  size_t num_ranges = 1;
+  if (read_thread_pool_ != nullptr) {
+    num_ranges = std::min<size_t>(read_config_.parallelism,
+                                  n / read_config_.min_range_size);
+  }
+  if (num_ranges <= 1) {
+    return LoadRangeFromGCS(fname, offset, n, buffer, bytes_transferred);
+  }
+  const size_t range_size = (n + num_ranges - 1) / num_ranges;
+  num_ranges = (n + range_size - 1) / range_size;
+
+  std::vector<Status> statuses(num_ranges);
+  std::vector<size_t> bytes(num_ranges, 0);
+  auto load_range = [&](size_t i) {
+    const size_t start = i * range_size;
+    statuses[i] = LoadRangeFromGCS(fname, offset + start,
+                                   std::min(range_size, n - start),
+                                   buffer + start, &bytes[i]);
+  };
+  BlockingCounter counter(num_ranges - 1);
+  for (size_t i = 1; i < num_ranges; ++i) {
+    read_thread_pool_->Schedule([&load_range, &counter, i]() {
+      load_range(i);
+      counter.DecrementCount();
+    });
+  }
+  load_range(0);
+  counter.Wait();
+
+  // The ranges are contiguous; stop at the first one that ended at EOF, since
+  // all ranges after it are past the end of the object.
+  for (size_t i = 0; i < num_ranges; ++i) {
+    TF_RETURN_IF_ERROR(statuses[i]);
+    *bytes_transferred += bytes[i];
+    if (bytes[i] < std::min(range_size, n - i * range_size)) {
+      break;
+    }
+  }
+  return OkStatus();
+}
+
+// A helper function to actually read the data from GCS.
+Status GcsFileSystem::LoadRangeFromGCS(const string& fname, size_t offset,
+                                       size_t n, char* buffer,
+                                       size_t* bytes_transferred) {
+  *bytes_transferred = 0;
 
   string bucket, object;
   TF_RETURN_IF_ERROR(ParseGcsPath(fname, false, &bucket, &object));
@@ -1266,6 +1837,17 @@ Status GcsFileSystem::NewWritableFile(const string& fname,
   string bucket, object;
   TF_RETURN_IF_ERROR(ParseGcsPath(fname, false, &bucket, &object));
 
+  if (upload_thread_pool_ != nullptr) {
+    result->reset(new GcsCompositeWritableFile(
+        bucket, object, this, &timeouts_,
+        [this, fname]() { ClearFileCaches(fname); }, retry_config_,
+        write_config_.chunk_size, write_config_.parallelism,
+        [this](std::function<void()> fn) {
+          upload_thread_pool_->Schedule(std::move(fn));
+        }));
+    return OkStatus();
+  }
+
   auto session_creator =
       [this](uint64 start_offset, const std::string& object_to_upload,
              const std::string& bucket, uint64 file_size,
@@ -32,6 +32,7 @@ limitations under the License.
 #include "tensorflow/core/platform/file_system.h"
 #include "tensorflow/core/platform/retrying_file_system.h"
 #include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/threadpool.h"
 
 namespace tensorflow {
 
@@ -125,6 +126,8 @@ struct UploadSessionHandle {
 class GcsFileSystem : public FileSystem {
  public:
   struct TimeoutConfig;
+  struct ReadConfig;
+  struct WriteConfig;
 
   // Main constructor used (via RetryingFileSystem) throughout Tensorflow
   explicit GcsFileSystem(bool make_default_cache = true);
@@ -215,6 +218,8 @@ class GcsFileSystem : public FileSystem {
   }
 
   bool compose_append() const { return compose_append_; }
+  ReadConfig read_config() const { return read_config_; }
+  WriteConfig write_config() const { return write_config_; }
   string additional_header_name() const {
     return additional_header_ ? additional_header_->first : "";
   }
@@ -267,6 +272,52 @@ class GcsFileSystem : public FileSystem {
           write(write) {}
   };
 
+  /// Structure containing the configuration of object reads.
+  ///
+  /// The defaults reproduce the original behavior: a single ranged GET per
+  /// block on the caller's thread, with a fixed buffer size.
+  struct ReadConfig {
+    // Maximum number of concurrent ranged GETs used to load a single block or
+    // buffer. Values <= 1 disable parallel reads.
+    int parallelism = 1;
+
+    // Reads are only split into ranges of at least this many bytes.
+    size_t min_range_size = 8 * 1024 * 1024;
+
+    // If true, buffered files fetch the next buffer in the background once a
+    // sequential access pattern has been observed.
+    bool prefetch = false;
+
+    // If nonzero, buffered files shrink their buffer (down to this size) on
+    // random reads and grow it back to the block size on sequential reads.
+    size_t min_buffer_size = 0;
+  };
+
+  /// \brief Sets a new ReadConfig on the GCS FileSystem.
+  ///
+  /// Must be called before any file is opened; files that are already open
+  /// keep the read-ahead and buffer settings they were created with.
+  void SetReadConfig(const ReadConfig& read_config);
+
+  /// Structure containing the configuration of object writes.
+  struct WriteConfig {
+    // If true, files opened with NewWritableFile stream their content as a
+    // parallel composite upload instead of buffering it in a local temporary
+    // file. Appendable files always use the temporary file.
+    bool composite_upload = false;
+
+    // Maximum number of chunks a single file uploads concurrently.
+    int parallelism = 8;
+
+    // Size of the chunks (and of the temporary component objects).
+    size_t chunk_size = 16 * 1024 * 1024;
+  };
+
+  /// \brief Sets a new WriteConfig on the GCS FileSystem.
+  ///
+  /// Must be called before any file is opened for writing.
+  void SetWriteConfig(const WriteConfig& write_config);
+
   Status CreateHttpRequest(std::unique_ptr<HttpRequest>* request);
 
   /// \brief Sets a new AuthProvider on the GCS FileSystem.
@@ -404,6 +455,10 @@ class GcsFileSystem : public FileSystem {
 
   Status RenameObject(const string& src, const string& target);
 
+  /// Loads a single range of file contents from GCS with one ranged GET.
+  Status LoadRangeFromGCS(const string& fname, size_t offset, size_t n,
+                          char* buffer, size_t* bytes_transferred);
+
   // Clear all the caches related to the file with name `filename`.
   void ClearFileCaches(const string& fname);
 
@@ -441,6 +496,25 @@ class GcsFileSystem : public FileSystem {
   // Additional header material to be transmitted with all GCS requests
   std::unique_ptr<std::pair<const string, const string>> additional_header_;
 
+  ReadConfig read_config_;
+  WriteConfig write_config_;
+
+  // Runs the ranged GETs of parallel reads. Tasks scheduled here never block
+  // on other tasks, so the pool cannot deadlock.
+  std::unique_ptr<thread::ThreadPool> read_thread_pool_;
+
+  // Runs the background read-ahead of buffered files. These tasks may fan out
+  // into read_thread_pool_, so they must not share it.
+  //
+  std::unique_ptr<thread::ThreadPool> prefetch_thread_pool_;
+
+  // Runs the chunk uploads and temporary object deletions of composite
+  // uploads.
+  //
+  // The pools are declared last so that they are joined before the members
+  // their tasks use are destroyed.
+  std::unique_ptr<thread::ThreadPool> upload_thread_pool_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(GcsFileSystem);
 };
 
@@ -431,6 +431,122 @@ TEST(GcsFileSystemTest, NewRandomAccessFile_Buffered_ReadBackwards) {
   EXPECT_EQ("0123456789", result);
 }
 
+TEST(GcsFileSystemTest, NewRandomAccessFile_Buffered_AdaptiveBufferSize) {
+  // The buffer halves on a random read and grows back on a sequential one.
+  std::vector<HttpRequest*> requests({
+      new FakeHttpRequest(
+          "Uri: https://storage.googleapis.com/bucket/random_access.txt\n"
+          "Auth Token: fake_token\n"
+          "Range: 0-15\n"
+          "Timeouts: 5 1 20\n",
+          "0123456789abcdef"),
+      new FakeHttpRequest(
+          "Uri: https://storage.googleapis.com/bucket/random_access.txt\n"
+          "Auth Token: fake_token\n"
+          "Range: 30-37\n"
+          "Timeouts: 5 1 20\n",
+          "uvwxyzAB"),
+      new FakeHttpRequest(
+          "Uri: https://storage.googleapis.com/bucket/random_access.txt\n"
+          "Auth Token: fake_token\n"
+          "Range: 38-53\n"
+          "Timeouts: 5 1 20\n",
+          "CD"),
+  });
+  GcsFileSystem fs(
+      std::unique_ptr<AuthProvider>(new FakeAuthProvider),
+      std::unique_ptr<HttpRequest::Factory>(
+          new FakeHttpRequestFactory(&requests)),
+      std::unique_ptr<ZoneProvider>(new FakeZoneProvider), 16 /* block size */,
+      0 /* max bytes */, 0 /* max staleness */, 0 /* stat cache max age */,
+      0 /* stat cache max entries */, 0 /* matching paths cache max age */,
+      0 /* matching paths cache max entries */, kTestRetryConfig,
+      kTestTimeoutConfig, *kAllowedLocationsDefault,
+      nullptr /* gcs additional header */, false /* compose append */);
+  GcsFileSystem::ReadConfig read_config;
+  read_config.min_buffer_size = 4;
+  fs.SetReadConfig(read_config);
+
+  std::unique_ptr<RandomAccessFile> file;
+  TF_EXPECT_OK(
+      fs.NewRandomAccessFile("gs://bucket/random_access.txt", nullptr, &file));
+
+  char scratch[4];
+  StringPiece result;
+
+  // The first read fills the whole buffer.
+  TF_EXPECT_OK(file->Read(0, sizeof(scratch), &result, scratch));
+  EXPECT_EQ("0123", result);
+
+  // Jumping ahead shrinks the buffer to 8 bytes.
+  TF_EXPECT_OK(file->Read(30, sizeof(scratch), &result, scratch));
+  EXPECT_EQ("uvwx", result);
+  TF_EXPECT_OK(file->Read(34, sizeof(scratch), &result, scratch));
+  EXPECT_EQ("yzAB", result);
+
+  // Continuing sequentially grows it back to 16 bytes.
+  EXPECT_TRUE(
+      errors::IsOutOfRange(file->Read(38, sizeof(scratch), &result, scratch)));
+  EXPECT_EQ("CD", result);
+}
+
+TEST(GcsFileSystemTest, NewRandomAccessFile_Buffered_Prefetch) {
+  // The second sequential fill schedules a read-ahead of the third buffer.
+  // Whether the read-ahead runs or is cancelled in favor of a direct read, the
+  // range is requested exactly once.
+  std::vector<HttpRequest*> requests({
+      new FakeHttpRequest(
+          "Uri: https://storage.googleapis.com/bucket/random_access.txt\n"
+          "Auth Token: fake_token\n"
+          "Range: 0-9\n"
+          "Timeouts: 5 1 20\n",
+          "0123456789"),
+      new FakeHttpRequest(
+          "Uri: https://storage.googleapis.com/bucket/random_access.txt\n"
+          "Auth Token: fake_token\n"
+          "Range: 10-19\n"
+          "Timeouts: 5 1 20\n",
+          "abcdefghij"),
+      new FakeHttpRequest(
+          "Uri: https://storage.googleapis.com/bucket/random_access.txt\n"
+          "Auth Token: fake_token\n"
+          "Range: 20-29\n"
+          "Timeouts: 5 1 20\n",
+          "ABCDE"),
+  });
+  GcsFileSystem fs(
+      std::unique_ptr<AuthProvider>(new FakeAuthProvider),
+      std::unique_ptr<HttpRequest::Factory>(
+          new FakeHttpRequestFactory(&requests)),
+      std::unique_ptr<ZoneProvider>(new FakeZoneProvider), 10 /* block size */,
+      0 /* max bytes */, 0 /* max staleness */, 0 /* stat cache max age */,
+      0 /* stat cache max entries */, 0 /* matching paths cache max age */,
+      0 /* matching paths cache max entries */, kTestRetryConfig,
+      kTestTimeoutConfig, *kAllowedLocationsDefault,
+      nullptr /* gcs additional header */, false /* compose append */);
+  GcsFileSystem::ReadConfig read_config;
+  read_config.prefetch = true;
+  fs.SetReadConfig(read_config);
+
+  std::unique_ptr<RandomAccessFile> file;
+  TF_EXPECT_OK(
+      fs.NewRandomAccessFile("gs://bucket/random_access.txt", nullptr, &file));
+
+  char scratch[10];
+  StringPiece result;
+
+  TF_EXPECT_OK(file->Read(0, sizeof(scratch), &result, scratch));
+  EXPECT_EQ("0123456789", result);
+
+  TF_EXPECT_OK(file->Read(10, sizeof(scratch), &result, scratch));
+  EXPECT_EQ("abcdefghij", result);
+
+  // Hitting EOF does not schedule another read-ahead.
+  EXPECT_TRUE(
+      errors::IsOutOfRange(file->Read(20, sizeof(scratch), &result, scratch)));
+  EXPECT_EQ("ABCDE", result);
+}
+
 TEST(GcsFileSystemTest,
      NewRandomAccessFile_WithLocationConstraintInSameLocation) {
   std::vector<HttpRequest*> requests({new FakeHttpRequest(
@@ -1333,6 +1449,55 @@ TEST(GcsFileSystemTest, NewWritableFile_NoObjectName) {
       fs.NewWritableFile("gs://bucket/", nullptr, &file)));
 }
 
+TEST(GcsFileSystemTest, NewWritableFile_CompositeUpload_SingleChunk) {
+  // A file that fits into one chunk is uploaded directly, without temporary
+  // component objects.
+  std::vector<HttpRequest*> requests(
+      {new FakeHttpRequest(
+           "Uri: https://www.googleapis.com/upload/storage/v1/b/bucket/o?"
+           "uploadType=media&name=path%2Fwriteable.txt\n"
+           "Auth Token: fake_token\n"
+           "Timeouts: 5 1 30\n"
+           "Post body: content1,\n",
+           ""),
+       new FakeHttpRequest(
+           "Uri: https://www.googleapis.com/upload/storage/v1/b/bucket/o?"
+           "uploadType=media&name=path%2Fwriteable.txt\n"
+           "Auth Token: fake_token\n"
+           "Timeouts: 5 1 30\n"
+           "Post body: content1,content2\n",
+           "")});
+  GcsFileSystem fs(
+      std::unique_ptr<AuthProvider>(new FakeAuthProvider),
+      std::unique_ptr<HttpRequest::Factory>(
+          new FakeHttpRequestFactory(&requests)),
+      std::unique_ptr<ZoneProvider>(new FakeZoneProvider), 0 /* block size */,
+      0 /* max bytes */, 0 /* max staleness */, 0 /* stat cache max age */,
+      0 /* stat cache max entries */, 0 /* matching paths cache max age */,
+      0 /* matching paths cache max entries */, kTestRetryConfig,
+      kTestTimeoutConfig, *kAllowedLocationsDefault,
+      nullptr /* gcs additional header */, false /* compose append */);
+  GcsFileSystem::WriteConfig write_config;
+  write_config.composite_upload = true;
+  write_config.chunk_size = 32;
+  fs.SetWriteConfig(write_config);
+
+  std::unique_ptr<WritableFile> file;
+  TF_EXPECT_OK(
+      fs.NewWritableFile("gs://bucket/path/writeable.txt", nullptr, &file));
+
+  TF_EXPECT_OK(file->Append("content1,"));
+  TF_EXPECT_OK(file->Flush());
+  TF_EXPECT_OK(file->Append("content2"));
+  int64_t pos;
+  TF_EXPECT_OK(file->Tell(&pos));
+  EXPECT_EQ(17, pos);
+  TF_EXPECT_OK(file->Close());
+  // Closing again does not upload anything.
+  TF_EXPECT_OK(file->Close());
+  EXPECT_TRUE(errors::IsFailedPrecondition(file->Append("content3")));
+}
+
 TEST(GcsFileSystemTest, NewAppendableFile) {
   std::vector<HttpRequest*> requests(
       {new FakeHttpRequest(
@@ -3685,6 +3850,50 @@ TEST(GcsFileSystemTest, OverrideCacheParameters) {
   EXPECT_EQ(40, fs5.timeouts().write);
 }
 
+TEST(GcsFileSystemTest, OverrideReadParameters) {
+  // Verify defaults are propagated correctly.
+  GcsFileSystem fs1;
+  EXPECT_EQ(8, fs1.read_config().parallelism);
+  EXPECT_EQ(8 * 1024 * 1024, fs1.read_config().min_range_size);
+  EXPECT_TRUE(fs1.read_config().prefetch);
+  EXPECT_EQ(1024 * 1024, fs1.read_config().min_buffer_size);
+
+  // Verify overrides.
+  setenv("GCS_READ_PARALLELISM", "1", 1);
+  setenv("GCS_READ_MIN_RANGE_SIZE_MB", "4", 1);
+  setenv("GCS_READ_PREFETCH", "0", 1);
+  setenv("GCS_READ_MIN_BUFFER_SIZE_MB", "0", 1);
+  GcsFileSystem fs2;
+  EXPECT_EQ(1, fs2.read_config().parallelism);
+  EXPECT_EQ(4 * 1024 * 1024, fs2.read_config().min_range_size);
+  EXPECT_FALSE(fs2.read_config().prefetch);
+  EXPECT_EQ(0, fs2.read_config().min_buffer_size);
+  unsetenv("GCS_READ_PARALLELISM");
+  unsetenv("GCS_READ_MIN_RANGE_SIZE_MB");
+  unsetenv("GCS_READ_PREFETCH");
+  unsetenv("GCS_READ_MIN_BUFFER_SIZE_MB");
+}
+
+TEST(GcsFileSystemTest, OverrideWriteParameters) {
+  // Verify defaults are propagated correctly.
+  GcsFileSystem fs1;
+  EXPECT_FALSE(fs1.write_config().composite_upload);
+  EXPECT_EQ(8, fs1.write_config().parallelism);
+  EXPECT_EQ(16 * 1024 * 1024, fs1.write_config().chunk_size);
+
+  // Verify overrides.
+  setenv("GCS_COMPOSITE_UPLOAD", "1", 1);
+  setenv("GCS_WRITE_PARALLELISM", "4", 1);
+  setenv("GCS_WRITE_CHUNK_SIZE_MB", "64", 1);
+  GcsFileSystem fs2;
+  EXPECT_TRUE(fs2.write_config().composite_upload);
+  EXPECT_EQ(4, fs2.write_config().parallelism);
+  EXPECT_EQ(64 * 1024 * 1024, fs2.write_config().chunk_size);
+  unsetenv("GCS_COMPOSITE_UPLOAD");
+  unsetenv("GCS_WRITE_PARALLELISM");
+  unsetenv("GCS_WRITE_CHUNK_SIZE_MB");
+}
+
 TEST(GcsFileSystemTest, CreateHttpRequest) {
   std::vector<HttpRequest*> requests(
       {// IsDirectory is checking whether there are children objects.
@@ -55,6 +55,10 @@ class HostTracer : public ProfilerInterface {
   // True if currently recording.
   bool recording_ = false;
 
+  // True if recording takes a snapshot of always-on recording instead of
+  // starting and stopping TraceMeRecorder.
+  bool snapshot_ = false;
+
   // Timestamp at the start of tracing.
   uint64 start_timestamp_ns_ = 0;
 
@@ -76,6 +80,12 @@ Status HostTracer::Start() {
   // start_timestamp_ns_ to prevent timestamp underflow in XPlane.
   // Therefore this have to be done before TraceMeRecorder::Start.
   start_timestamp_ns_ = GetCurrentTimeNanos();
+  if (TraceMeRecorder::AlwaysOn()) {
+    // Always-on recording keeps running; Stop() takes a snapshot of it.
+    snapshot_ = true;
+    recording_ = true;
+    return OkStatus();
+  }
   recording_ = TraceMeRecorder::Start(host_trace_level_);
   if (!recording_) {
     return errors::Internal("Failed to start TraceMeRecorder");
@@ -87,7 +97,12 @@ Status HostTracer::Stop() {
   if (!recording_) {
     return errors::Internal("TraceMeRecorder not started");
   }
-  events_ = TraceMeRecorder::Stop();
+  if (snapshot_) {
+    events_ = TraceMeRecorder::Snapshot(start_timestamp_ns_);
+    snapshot_ = false;
+  } else {
+    events_ = TraceMeRecorder::Stop();
+  }
   recording_ = false;
   return OkStatus();
 }
@@ -0,0 +1,198 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/profiler/convert/xplane_to_pipeline_analysis.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/profiler/protobuf/pipeline_analysis.pb.h"
+#include "tensorflow/core/profiler/protobuf/xplane.pb.h"
+#include "tensorflow/core/profiler/utils/gpu_event_stats.h"
+#include "tensorflow/core/profiler/utils/tf_xplane_visitor.h"
+#include "tensorflow/core/profiler/utils/trace_utils.h"
+#include "tensorflow/core/profiler/utils/xplane_schema.h"
+#include "tensorflow/core/profiler/utils/xplane_utils.h"
+#include "tensorflow/core/profiler/utils/xplane_visitor.h"
+
+namespace tensorflow {
+namespace profiler {
+namespace {
+
+// Microbatches issued by the host, by stage name.
+using HostStages =
+    absl::flat_hash_map<std::string, absl::flat_hash_set<int64_t>>;
+
+// An activity on a device.
+struct Interval {
+  uint64 begin_ps;
+  uint64 end_ps;
+  absl::string_view stage;
+};
+
+HostStages CollectHostStages(const XSpace& space) {
+  HostStages stages;
+  const XPlane* host_plane = FindPlaneWithName(space, kHostThreadsPlaneName);
+  if (host_plane == nullptr) return stages;
+  XPlaneVisitor plane = CreateTfXPlaneVisitor(host_plane);
+  plane.ForEachLine([&](const XLineVisitor& line) {
+    line.ForEachEvent([&](const XEventVisitor& event) {
+      auto stage = event.GetStat(StatType::kPipelineStage);
+      if (!stage.has_value() || stage->StrOrRefValue().empty()) return;
+      auto& microbatches = stages[std::string(stage->StrOrRefValue())];
+      if (auto microbatch = event.GetStat(StatType::kMicrobatch)) {
+        int64_t value = microbatch->IntValue();
+        if (value >= 0) microbatches.insert(value);
+      }
+    });
+  });
+  return stages;
+}
+
+// Returns the stage of an XLA module: the longest annotated stage name that
+// the module name ends with as "-<stage>", or the module name itself.
+absl::string_view StageOfModule(absl::string_view module,
+                                const HostStages& host_stages) {
+  // Strip a program id suffix, e.g. "module(123)".
+  if (absl::EndsWith(module, ")")) {
+    size_t pos = module.rfind('(');
+    if (pos != absl::string_view::npos) module = module.substr(0, pos);
+  }
+  absl::string_view stage = module;
+  size_t best_size = 0;
+  for (const auto& name_and_microbatches : host_stages) {
+    absl::string_view name = name_and_microbatches.first;
+    if (name.size() <= best_size || module.size() <= name.size()) continue;
+    if (absl::EndsWith(module, name) &&
+        module[module.size() - name.size() - 1] == '-') {
+      stage = module.substr(module.size() - name.size());
+      best_size = name.size();
+    }
+  }
+  return stage;
+}
+
+// Returns the total length of the union of `intervals`, which must be sorted
+// by begin_ps.
+uint64 UnionLength(const std::vector<const Interval*>& intervals) {
+  uint64 length = 0;
+  uint64 end_ps = 0;
+  for (const Interval* interval : intervals) {
+    uint64 begin_ps = std::max(interval->begin_ps, end_ps);
+    if (interval->end_ps > begin_ps) {
+      length += interval->end_ps - begin_ps;
+      end_ps = interval->end_ps;
+    }
+  }
+  return length;
+}
+
+void ConvertDevicePlane(const XPlane& device_plane,
+                        const HostStages& host_stages,
+                        PipelineDeviceAnalysis* device) {
+  std::vector<Interval> intervals;
+  absl::flat_hash_map<absl::string_view, uint64> num_executions;
+  XPlaneVisitor plane = CreateTfXPlaneVisitor(&device_plane);
+  plane.ForEachLine([&](const XLineVisitor& line) {
+    if (line.Name() == kXlaModuleLineName) {
+      line.ForEachEvent([&](const XEventVisitor& event) {
+        ++num_executions[StageOfModule(event.Name(), host_stages)];
+      });
+      return;
+    }
+    if (IsDerivedThreadId(line.Id())) return;
+    line.ForEachEvent([&](const XEventVisitor& event) {
+      if (event.DurationPs() == 0) return;
+      GpuEventStats stats(&event);
+      absl::string_view stage;
+      if (!stats.hlo_module_name.empty()) {
+        stage = StageOfModule(stats.hlo_module_name, host_stages);
+      }
+      intervals.push_back(
+          {static_cast<uint64>(event.TimestampPs()),
+           static_cast<uint64>(event.EndTimestampPs()), stage});
+    });
+  });
+  if (intervals.empty()) return;
+  std::sort(intervals.begin(), intervals.end(),
+            [](const Interval& a, const Interval& b) {
+              return a.begin_ps < b.begin_ps;
+            });
+
+  // Stages in order of their first activity.
+  std::vector<absl::string_view> stage_order;
+  absl::flat_hash_map<absl::string_view, std::vector<const Interval*>>
+      stage_intervals;
+  absl::flat_hash_map<absl::string_view, uint64> stage_idle_ps;
+  uint64 busy_ps = 0;
+  uint64 end_ps = intervals.front().begin_ps;
+  for (const Interval& interval : intervals) {
+    auto& by_stage = stage_intervals[interval.stage];
+    if (by_stage.empty()) stage_order.push_back(interval.stage);
+    by_stage.push_back(&interval);
+    if (interval.begin_ps > end_ps) {
+      // The device waited for this stage.
+      stage_idle_ps[interval.stage] += interval.begin_ps - end_ps;
+    }
+    uint64 begin_ps = std::max(interval.begin_ps, end_ps);
+    if (interval.end_ps > begin_ps) {
+      busy_ps += interval.end_ps - begin_ps;
+      end_ps = interval.end_ps;
+    }
+  }
+
+  device->set_device_name(device_plane.name());
+  device->set_span_time_ps(end_ps - intervals.front().begin_ps);
+  device->set_busy_time_ps(busy_ps);
+  device->set_idle_time_ps(device->span_time_ps() - busy_ps);
+  for (absl::string_view stage : stage_order) {
+    PipelineStageTime* stage_time = device->add_stages();
+    stage_time->set_stage(std::string(stage));
+    stage_time->set_busy_time_ps(UnionLength(stage_intervals[stage]));
+    stage_time->set_idle_time_ps(stage_idle_ps[stage]);
+    auto executions = num_executions.find(stage);
+    if (executions != num_executions.end()) {
+      stage_time->set_num_executions(executions->second);
+    }
+    auto host_stage = host_stages.find(stage);
+    if (host_stage != host_stages.end()) {
+      stage_time->set_num_microbatches(host_stage->second.size());
+    }
+  }
+}
+
+}  // namespace
+
+void ConvertXSpaceToPipelineAnalysis(const XSpace& space,
+                                     PipelineAnalysis* analysis) {
+  HostStages host_stages = CollectHostStages(space);
+  for (const XPlane* device_plane :
+       FindPlanesWithPrefix(space, kGpuPlanePrefix)) {
+    PipelineDeviceAnalysis device;
+    ConvertDevicePlane(*device_plane, host_stages, &device);
+    if (device.stages_size() == 0) continue;
+    if (space.hostnames_size() > 0) device.set_host_name(space.hostnames(0));
+    *analysis->add_devices() = std::move(device);
+  }
+}
+
+}  // namespace profiler
+}  // namespace tensorflow
@@ -0,0 +1,38 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_PROFILER_CONVERT_XPLANE_TO_PIPELINE_ANALYSIS_H_
+#define TENSORFLOW_CORE_PROFILER_CONVERT_XPLANE_TO_PIPELINE_ANALYSIS_H_
+
+#include "tensorflow/core/profiler/protobuf/pipeline_analysis.pb.h"
+#include "tensorflow/core/profiler/protobuf/xplane.pb.h"
+
+namespace tensorflow {
+namespace profiler {
+
+// Adds the pipeline bubble analysis of the GPU planes of `space` to
+// `analysis`. Device activity is attributed to the pipeline stages annotated
+// by the Alpa pipeline executor on the host plane (matched by the
+// "<module>-<stage>" names slice_auto_sharded_stages gives the stage
+// modules), or to its XLA module if there are no annotations. Each idle gap
+// on a device is attributed to the stage that runs right after it.
+// Expects a space preprocessed with a derived timeline to count executions.
+void ConvertXSpaceToPipelineAnalysis(const XSpace& space,
+                                     PipelineAnalysis* analysis);
+
+}  // namespace profiler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_PROFILER_CONVERT_XPLANE_TO_PIPELINE_ANALYSIS_H_
@@ -0,0 +1,113 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/profiler/convert/xplane_to_pipeline_analysis.h"
+
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/profiler/protobuf/pipeline_analysis.pb.h"
+#include "tensorflow/core/profiler/protobuf/xplane.pb.h"
+#include "tensorflow/core/profiler/utils/trace_utils.h"
+#include "tensorflow/core/profiler/utils/xplane_builder.h"
+#include "tensorflow/core/profiler/utils/xplane_schema.h"
+#include "tensorflow/core/profiler/utils/xplane_test_utils.h"
+
+namespace tensorflow {
+namespace profiler {
+namespace {
+
+TEST(ConvertXSpaceToPipelineAnalysis, IdleTimePerStage) {
+  XSpace space;
+  space.add_hostnames("host0");
+
+  XPlaneBuilder host_plane(GetOrCreateHostXPlane(&space));
+  XLineBuilder host_line = host_plane.GetOrCreateLine(0);
+  CreateXEvent(&host_plane, &host_line, "PipelineRun", 0, 10,
+               {{StatType::kPipelineStage, "stage_0"},
+                {StatType::kMicrobatch, int64_t{0}}});
+  CreateXEvent(&host_plane, &host_line, "PipelineRun", 20, 10,
+               {{StatType::kPipelineStage, "stage_1"},
+                {StatType::kMicrobatch, int64_t{0}}});
+  CreateXEvent(&host_plane, &host_line, "PipelineRun", 40, 10,
+               {{StatType::kPipelineStage, "stage_0"},
+                {StatType::kMicrobatch, int64_t{1}}});
+
+  XPlaneBuilder device_plane(
+      GetOrCreateGpuXPlane(&space, /*device_ordinal=*/0));
+  XLineBuilder stream = device_plane.GetOrCreateLine(1);
+  CreateXEvent(&device_plane, &stream, "kernel", 0, 100,
+               {{StatType::kHloModule, "train-stage_0"}});
+  CreateXEvent(&device_plane, &stream, "kernel", 100, 100,
+               {{StatType::kHloModule, "train-stage_0"}});
+  CreateXEvent(&device_plane, &stream, "kernel", 300, 100,
+               {{StatType::kHloModule, "train-stage_1"}});
+  // Cross-mesh communication, outside of XLA modules.
+  CreateXEvent(&device_plane, &stream, "nccl", 400, 20);
+  CreateXEvent(&device_plane, &stream, "kernel", 450, 100,
+               {{StatType::kHloModule, "train-stage_0"}});
+  XLineBuilder modules = device_plane.GetOrCreateLine(kThreadIdHloModule);
+  modules.SetName(kXlaModuleLineName);
+  CreateXEvent(&device_plane, &modules, "train-stage_0(1)", 0, 200);
+  CreateXEvent(&device_plane, &modules, "train-stage_1(2)", 300, 100);
+  CreateXEvent(&device_plane, &modules, "train-stage_0(1)", 450, 100);
+
+  PipelineAnalysis analysis;
+  ConvertXSpaceToPipelineAnalysis(space, &analysis);
+
+  ASSERT_EQ(analysis.devices_size(), 1);
+  const PipelineDeviceAnalysis& device = analysis.devices(0);
+  EXPECT_EQ(device.host_name(), "host0");
+  EXPECT_EQ(device.span_time_ps(), 550);
+  EXPECT_EQ(device.busy_time_ps(), 420);
+  EXPECT_EQ(device.idle_time_ps(), 130);
+  ASSERT_EQ(device.stages_size(), 3);
+
+  EXPECT_EQ(device.stages(0).stage(), "stage_0");
+  EXPECT_EQ(device.stages(0).num_executions(), 2);
+  EXPECT_EQ(device.stages(0).num_microbatches(), 2);
+  EXPECT_EQ(device.stages(0).busy_time_ps(), 300);
+  EXPECT_EQ(device.stages(0).idle_time_ps(), 30);
+
+  EXPECT_EQ(device.stages(1).stage(), "stage_1");
+  EXPECT_EQ(device.stages(1).num_executions(), 1);
+  EXPECT_EQ(device.stages(1).num_microbatches(), 1);
+  EXPECT_EQ(device.stages(1).busy_time_ps(), 100);
+  EXPECT_EQ(device.stages(1).idle_time_ps(), 100);
+
+  EXPECT_EQ(device.stages(2).stage(), "");
+  EXPECT_EQ(device.stages(2).busy_time_ps(), 20);
+  EXPECT_EQ(device.stages(2).idle_time_ps(), 0);
+}
+
+TEST(ConvertXSpaceToPipelineAnalysis, ModuleNamesWithoutAnnotations) {
+  XSpace space;
+  XPlaneBuilder device_plane(
+      GetOrCreateGpuXPlane(&space, /*device_ordinal=*/0));
+  XLineBuilder stream = device_plane.GetOrCreateLine(1);
+  CreateXEvent(&device_plane, &stream, "kernel", 0, 100,
+               {{StatType::kHloModule, "train-stage_0"}});
+
+  PipelineAnalysis analysis;
+  ConvertXSpaceToPipelineAnalysis(space, &analysis);
+
+  ASSERT_EQ(analysis.devices_size(), 1);
+  ASSERT_EQ(analysis.devices(0).stages_size(), 1);
+  EXPECT_EQ(analysis.devices(0).stages(0).stage(), "train-stage_0");
+  EXPECT_EQ(analysis.devices(0).stages(0).busy_time_ps(), 100);
+  EXPECT_EQ(analysis.devices(0).idle_time_ps(), 0);
+}
+
+}  // namespace
+}  // namespace profiler
+}  // namespace tensorflow
@@ -30,7 +30,7 @@ StatusOr<std::string> GetAvailableToolNames(
     const SessionSnapshot& session_snapshot) {
   std::vector<std::string> tools;
   if (session_snapshot.XSpaceSize() != 0) {
-    tools.reserve(9);
+    tools.reserve(10);
     tools.push_back("trace_viewer");
     tools.push_back("overview_page");
     tools.push_back("input_pipeline_analyzer");
@@ -40,6 +40,7 @@ StatusOr<std::string> GetAvailableToolNames(
     tools.push_back("pod_viewer");
     tools.push_back("tf_data_bottleneck_analysis");
     tools.push_back("op_profile");
+    tools.push_back("pipeline_analysis");
   }
 
   TF_ASSIGN_OR_RETURN(bool has_hlo,
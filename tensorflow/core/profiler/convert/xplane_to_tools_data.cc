@@ -33,6 +33,7 @@ limitations under the License.
 #include "tensorflow/core/profiler/convert/tool_options.h"
 #include "tensorflow/core/profiler/convert/xplane_to_memory_profile.h"
 #include "tensorflow/core/profiler/convert/xplane_to_op_stats.h"
+#include "tensorflow/core/profiler/convert/xplane_to_pipeline_analysis.h"
 #include "tensorflow/core/profiler/convert/xplane_to_tf_data_stats.h"
 #include "tensorflow/core/profiler/convert/xplane_to_tool_names.h"
 #include "tensorflow/core/profiler/convert/xplane_to_trace_events.h"
@@ -42,6 +43,7 @@ limitations under the License.
 #include "tensorflow/core/profiler/protobuf/op_profile.pb.h"
 #include "tensorflow/core/profiler/protobuf/op_stats.pb.h"
 #include "tensorflow/core/profiler/protobuf/overview_page.pb.h"
+#include "tensorflow/core/profiler/protobuf/pipeline_analysis.pb.h"
 #include "tensorflow/core/profiler/protobuf/pod_viewer.pb.h"
 #include "tensorflow/core/profiler/protobuf/tf_data_stats.pb.h"
 #include "tensorflow/core/profiler/protobuf/tf_stats.pb.h"
@@ -158,6 +160,31 @@ StatusOr<std::string> ConvertMultiXSpacesToPodViewer(
   return json_output;
 }
 
+StatusOr<std::string> ConvertMultiXSpacesToPipelineAnalysis(
+    const SessionSnapshot& session_snapshot) {
+  PipelineAnalysis analysis;
+  for (int idx = 0; idx < session_snapshot.XSpaceSize(); ++idx) {
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<XSpace> xspace,
+                        session_snapshot.GetXSpace(idx));
+    PreprocessSingleHostXSpace(xspace.get(), /*step_grouping=*/true,
+                               /*derived_timeline=*/true);
+    ConvertXSpaceToPipelineAnalysis(*xspace, &analysis);
+  }
+
+  std::string json_output;
+  protobuf::util::JsonPrintOptions opts;
+  opts.always_print_primitive_fields = true;
+  auto encode_status =
+      protobuf::util::MessageToJsonString(analysis, &json_output, opts);
+  if (!encode_status.ok()) {
+    const auto& error_message = encode_status.message();
+    return errors::Internal(
+        "Could not convert pipeline analysis to json. Error: ",
+        absl::string_view(error_message.data(), error_message.length()));
+  }
+  return json_output;
+}
+
 StatusOr<std::string> ConvertMultiXSpacesToTfDataBottleneckAnalysis(
     const SessionSnapshot& session_snapshot) {
   CombinedTfDataStats combined_tf_data_stats;
@@ -251,6 +278,8 @@ StatusOr<std::string> ConvertMultiXSpacesToToolData(
     return ConvertMultiXSpacesToTfDataBottleneckAnalysis(session_snapshot);
   } else if (tool_name == "op_profile") {
     return ConvertMultiXSpacesToOpProfileViewer(session_snapshot);
+  } else if (tool_name == "pipeline_analysis") {
+    return ConvertMultiXSpacesToPipelineAnalysis(session_snapshot);
   } else if (tool_name == "memory_viewer" || tool_name == "graph_viewer") {
     return ConvertHloProtoToToolData(session_snapshot, tool_name, options);
   } else if (tool_name == "tool_names") {
@@ -42,6 +42,7 @@ using tsl::profiler::kVerbose;            // NOLINT
 using tsl::profiler::TfOpDetailsEnabled;  // NOLINT
 using tsl::profiler::TraceMe;             // NOLINT
 using tsl::profiler::TraceMeLevel;        // NOLINT
+using tsl::profiler::TraceMeName;         // NOLINT
 
 }  // namespace profiler
 }  // namespace tensorflow
@@ -132,6 +132,7 @@ ThreadWorkSource::ThreadWorkSource()
       blocking_inflight_(0),
       non_blocking_inflight_(0),
       pending_tasks_(0),
+      task_time_ns_(0),
       traceme_id_(0),
       version_(0),
       sub_thread_pool_waiter_(nullptr) {
@@ -319,6 +320,16 @@ void ThreadWorkSource::DecrementPendingTaskCount() {
   pending_tasks_.fetch_sub(1, std::memory_order_release);
 }
 
+int64_t ThreadWorkSource::GetTaskTimeNanos() {
+  return task_time_ns_.load(std::memory_order_relaxed);
+}
+
+void ThreadWorkSource::AddTaskTimeNanos(int64_t nanos) {
+  task_time_ns_.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+void ThreadWorkSource::ResetTaskTime() { task_time_ns_ = 0; }
+
 unsigned ThreadWorkSource::NonBlockingWorkShardingFactor() {
   return non_blocking_work_sharding_factor_;
 }
@@ -348,6 +359,7 @@ RunHandlerThreadPool::RunHandlerThreadPool(
       blocking_thread_max_waiting_time_(
           options.blocking_threads_max_sleep_time_micro_sec),
       enable_wake_up_(options.enable_wake_up),
+      max_task_time_share_(options.max_task_time_share),
       thread_data_(num_threads_),
       env_(env, thread_options, name),
       name_(name),
@@ -416,8 +428,26 @@ void RunHandlerThreadPool::AddWorkToQueue(ThreadWorkSource* tws,
   if (t.f) {
     VLOG(3) << "Running " << (is_blocking ? "inter" : "intra") << " work for "
             << tws->GetTracemeId();
-    env_.ExecuteTask(t);
+    ExecuteTask(tws, t);
+  }
+}
+
+void RunHandlerThreadPool::ExecuteTask(ThreadWorkSource* tws, const Task& t) {
+  uint64_t start_ns = tensorflow::EnvTime::NowNanos();
+  env_.ExecuteTask(t);
+  tws->AddTaskTimeNanos(tensorflow::EnvTime::NowNanos() - start_ns);
+}
+
+int64_t RunHandlerThreadPool::TaskTimeBudget(
+    const Eigen::MaxSizeVector<ThreadWorkSource*>& thread_work_sources) {
+  if (max_task_time_share_ >= 1.0 || thread_work_sources.size() < 2) {
+    return -1;
+  }
+  int64_t total_task_time_ns = 0;
+  for (int i = 0; i < thread_work_sources.size(); ++i) {
+    total_task_time_ns += thread_work_sources[i]->GetTaskTimeNanos();
   }
+  return static_cast<int64_t>(total_task_time_ns * max_task_time_share_);
 }
 
 void RunHandlerThreadPool::SetThreadWorkSources(
@@ -479,27 +509,42 @@ Task RunHandlerThreadPool::FindTask(
   int current_index = thread_data_[thread_id].current_index;
   *task_from_blocking_queue = false;
 
-  for (int i = 0; i < searching_range_end - searching_range_start; ++i) {
-    if (current_index >= searching_range_end ||
-        current_index < searching_range_start) {
-      current_index = searching_range_start;
-    }
-    *tws = thread_work_sources[current_index];
-    ++current_index;
+  // Work sources that used more than their share of the task time are skipped
+  // in the first pass, and only searched if no other work source has a task.
+  int64_t task_time_budget = TaskTimeBudget(thread_work_sources);
+  bool skipped_over_budget = false;
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < searching_range_end - searching_range_start; ++i) {
+      if (current_index >= searching_range_end ||
+          current_index < searching_range_start) {
+        current_index = searching_range_start;
+      }
+      *tws = thread_work_sources[current_index];
+      ++current_index;
 
-    // For blocking thread, search for blocking tasks first.
-    if (may_steal_blocking_work &&
-        (*tws)->GetInflightTaskCount(true) < max_blocking_inflight) {
-      t = (*tws)->PopBlockingTask();
+      if (pass == 0 && task_time_budget >= 0 &&
+          (*tws)->GetTaskTimeNanos() > task_time_budget) {
+        skipped_over_budget = true;
+        continue;
+      }
+
+      // For blocking thread, search for blocking tasks first.
+      if (may_steal_blocking_work &&
+          (*tws)->GetInflightTaskCount(true) < max_blocking_inflight) {
+        t = (*tws)->PopBlockingTask();
+        if (t.f) {
+          *task_from_blocking_queue = true;
+          break;
+        }
+      }
+
+      // Search for non-blocking tasks.
+      t = (*tws)->PopNonBlockingTask(thread_id, true);
       if (t.f) {
-        *task_from_blocking_queue = true;
         break;
       }
     }
-
-    // Search for non-blocking tasks.
-    t = (*tws)->PopNonBlockingTask(thread_id, true);
-    if (t.f) {
+    if (t.f || !skipped_over_budget) {
       break;
     }
   }
@@ -574,7 +619,7 @@ void RunHandlerThreadPool::WorkerLoop(int thread_id,
       VLOG(2) << "Running " << (task_from_blocking_queue ? "inter" : "intra")
               << " work from " << tws->GetTracemeId();
       tws->IncrementInflightTaskCount(task_from_blocking_queue);
-      env_.ExecuteTask(t);
+      ExecuteTask(tws, t);
       tws->DecrementInflightTaskCount(task_from_blocking_queue);
       tws->DecrementPendingTaskCount();
     } else {
@@ -724,7 +769,8 @@ class RunHandlerPool::Impl {
                 options.use_adaptive_waiting_time, options.enable_wake_up,
                 options.max_concurrent_handler,
                 options.num_threads_in_sub_thread_pool,
-                options.sub_thread_request_percentage),
+                options.sub_thread_request_percentage,
+                options.max_task_time_share),
             tensorflow::Env::Default(), tensorflow::ThreadOptions(),
             "tf_run_handler_pool", &waiters_mu_, &queue_waiters_)),
         iterations_(0),
@@ -1010,6 +1056,7 @@ void RunHandler::Impl::Reset(int64_t step_id,
   step_id_ = step_id;
   options_ = options;
   tws_.SetTracemeId(step_id);
+  tws_.ResetTaskTime();
 }
 
 int RunHandler::Impl::RunHandlerEigenThreadPool::NumThreads() const {
@@ -1052,6 +1099,10 @@ int RunHandler::NumThreads() const {
 
 int64_t RunHandler::step_id() const { return impl_->step_id(); }
 
+int64_t RunHandler::task_time_ns() const {
+  return impl_->tws()->GetTaskTimeNanos();
+}
+
 tensorflow::thread::ThreadPoolInterface*
 RunHandler::AsIntraThreadPoolInterface() const {
   return impl_->thread_pool_interface();
@@ -101,6 +101,13 @@ class RunHandlerPool {
 
     // If true, threads will be waken up by new tasks.
     bool enable_wake_up = true;
+
+    // The largest share of the task time of all active requests that a single
+    // request may use. Threads pick the request of every task anew, and only
+    // run tasks of a request above its share if no other request has one, so
+    // a long running request yields to the others at op boundaries. Values
+    // greater than or equal to 1 disable the limit.
+    double max_task_time_share = 1.0;
   };
   explicit RunHandlerPool(Options options);
   ~RunHandlerPool();
@@ -154,6 +161,10 @@ class RunHandler {
 
   int64_t step_id() const;
 
+  // Returns the time in nanoseconds the pool threads spent running the tasks
+  // of this request so far.
+  int64_t task_time_ns() const;
+
   ~RunHandler();
 
  private:
@@ -246,6 +257,13 @@ class ThreadWorkSource {
 
   void DecrementPendingTaskCount();
 
+  // The time in nanoseconds spent running the tasks of this work source.
+  int64_t GetTaskTimeNanos();
+
+  void AddTaskTimeNanos(int64_t nanos);
+
+  void ResetTaskTime();
+
   unsigned NonBlockingWorkShardingFactor();
 
   std::string ToString();
@@ -267,6 +285,8 @@ class ThreadWorkSource {
   // The number of tasks that are enqueued and not finished.
   std::atomic<int64_t> pending_tasks_;
 
+  std::atomic<int64_t> task_time_ns_;
+
   Queue blocking_work_queue_;
   tensorflow::mutex blocking_queue_op_mu_;
   char pad_[128];
@@ -294,6 +314,7 @@ class RunHandlerThreadPool {
     int max_concurrent_handler;
     std::vector<int> num_threads_in_sub_thread_pool;
     std::vector<double> sub_thread_request_percentage;
+    double max_task_time_share;
     Options(int num_blocking_threads, int num_non_blocking_threads,
             bool wait_if_no_active_request,
             int non_blocking_threads_sleep_time_micro_sec,
@@ -301,7 +322,8 @@ class RunHandlerThreadPool {
             bool use_adaptive_waiting_time, bool enable_wake_up,
             int max_concurrent_handler,
             const std::vector<int>& num_threads_in_sub_thread_pool,
-            const std::vector<double>& sub_thread_request_percentage)
+            const std::vector<double>& sub_thread_request_percentage,
+            double max_task_time_share = 1.0)
         : num_blocking_threads(num_blocking_threads),
           num_non_blocking_threads(num_non_blocking_threads),
           wait_if_no_active_request(wait_if_no_active_request),
@@ -313,7 +335,8 @@ class RunHandlerThreadPool {
           enable_wake_up(enable_wake_up),
           max_concurrent_handler(max_concurrent_handler),
           num_threads_in_sub_thread_pool(num_threads_in_sub_thread_pool),
-          sub_thread_request_percentage(sub_thread_request_percentage) {}
+          sub_thread_request_percentage(sub_thread_request_percentage),
+          max_task_time_share(max_task_time_share) {}
   };
   struct PerThread {
     constexpr PerThread() : pool(nullptr), thread_id(-1) {}
@@ -366,6 +389,14 @@ class RunHandlerThreadPool {
                                   int sub_thread_pool_id);
 
  private:
+  // Runs `t` and adds its run time to `tws`.
+  void ExecuteTask(ThreadWorkSource* tws, const Task& t);
+
+  // Returns the task time above which the tasks of a work source are only run
+  // if no other work source has a task, or -1 if there is no limit.
+  int64_t TaskTimeBudget(
+      const Eigen::MaxSizeVector<ThreadWorkSource*>& thread_work_sources);
+
   struct ThreadData {
     ThreadData();
     tensorflow::mutex mu;
@@ -392,6 +423,7 @@ class RunHandlerThreadPool {
   const int non_blocking_thread_sleep_time_;
   const int blocking_thread_max_waiting_time_;
   const bool enable_wake_up_;
+  const double max_task_time_share_;
   Eigen::MaxSizeVector<ThreadData> thread_data_;
   internal::RunHandlerEnvironment env_;
   std::atomic<bool> cancelled_;
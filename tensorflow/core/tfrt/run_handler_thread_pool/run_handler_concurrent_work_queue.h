@@ -77,6 +77,11 @@ class RunHandlerThreadWorkQueue
 
     // If true, threads will be waken up by new tasks.
     bool enable_wake_up = true;
+
+    // The largest share of the task time of all active requests that a single
+    // request may use before it yields to the other requests. Values greater
+    // than or equal to 1 disable the limit.
+    double max_task_time_share = 1.0;
   };
 
   explicit RunHandlerThreadWorkQueue(const Options& options);
@@ -134,6 +134,20 @@ TEST(RunHandlerUtilTest, IntraOpThreadPool) {
   notification.WaitForNotification();
 }
 
+TEST(RunHandlerUtilTest, TaskTime) {
+  RunHandlerPool::Options pool_options;
+  pool_options.num_intra_op_threads = 1;
+  pool_options.num_inter_op_threads = 1;
+  std::unique_ptr<RunHandlerPool> pool(new RunHandlerPool(pool_options));
+
+  auto handler = pool->Get(/*step_id=*/1);
+  EXPECT_EQ(handler->task_time_ns(), 0);
+  handler->ScheduleInterOpClosure(TaskFunction(
+      [] { tensorflow::Env::Default()->SleepForMicroseconds(1000); }));
+  pool->Quiesce();
+  EXPECT_GE(handler->task_time_ns(), 1000 * 1000);
+}
+
 class RunHandlerThreadPoolTest
     : public testing::TestWithParam<std::tuple<bool, bool>> {
  protected:
@@ -477,6 +491,63 @@ TEST_P(RunHandlerThreadPoolTest, FindTask) {
   }
 }
 
+TEST_P(RunHandlerThreadPoolTest, FindTaskWithTaskTimeShare) {
+  Eigen::MaxSizeVector<tensorflow::mutex> waiters_mu(1);
+  waiters_mu.resize(1);
+  Eigen::MaxSizeVector<internal::Waiter> waiters(1);
+  waiters.resize(1);
+  internal::RunHandlerThreadPool run_handler_thread_pool(
+      internal::RunHandlerThreadPool::Options(
+          /*num_blocking_threads=*/1, /*num_non_blocking_threads=*/0,
+          /*wait_if_no_active_request=*/true,
+          /*non_blocking_threads_sleep_time_micro_sec=*/250,
+          /*blocking_threads_max_sleep_time_micro_sec=*/250,
+          /*use_adaptive_waiting_time=*/true, /*enable_wake_up=*/true,
+          /*max_concurrent_handler=*/128,
+          /*num_threads_in_sub_thread_pool=*/{1},
+          /*sub_thread_request_percentage=*/{1},
+          /*max_task_time_share=*/0.5),
+      tensorflow::Env::Default(), tensorflow::ThreadOptions(),
+      "tf_run_handler_pool", &waiters_mu, &waiters);
+  Eigen::MaxSizeVector<internal::ThreadWorkSource*> thread_work_sources(3);
+  thread_work_sources.resize(3);
+  internal::ThreadWorkSource tws[3];
+  for (int i = 0; i < 3; ++i) {
+    tws[i].SetWaiter(1, &waiters[0], &waiters_mu[0]);
+    thread_work_sources[i] = &tws[i];
+  }
+  // The first request used all the task time so far.
+  tws[0].AddTaskTimeNanos(1000);
+
+  int result = -1;
+  run_handler_thread_pool.AddWorkToQueue(
+      &tws[0], /*is_blocking=*/true, TaskFunction([&result] { result = 0; }));
+  run_handler_thread_pool.AddWorkToQueue(
+      &tws[1], /*is_blocking=*/true, TaskFunction([&result] { result = 1; }));
+
+  const auto find_task = [&](internal::Task* t) {
+    bool task_from_blocking_queue;
+    internal::ThreadWorkSource* tws;
+    *t = run_handler_thread_pool.FindTask(
+        /*searching_range_start=*/0, /*searching_range_end=*/3,
+        /*thread_id=*/0,
+        /*sub_thread_pool_id=*/0, /*max_blocking_inflight=*/10,
+        /*may_steal_blocking_work=*/true, thread_work_sources,
+        &task_from_blocking_queue, &tws);
+  };
+
+  // The request above its share yields to the other request.
+  internal::Task t;
+  find_task(&t);
+  t.f->f();
+  EXPECT_EQ(result, 1);
+
+  // It still runs when no other request has a task.
+  find_task(&t);
+  t.f->f();
+  EXPECT_EQ(result, 0);
+}
+
 TEST_P(RunHandlerThreadPoolTest, RoundRobinExecution) {
   Eigen::MaxSizeVector<tensorflow::mutex> waiters_mu(1);
   waiters_mu.resize(1);
@@ -14,10 +14,12 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 
+#include <cstring>
 #include <vector>
 
 #include "absl/base/casts.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/numeric/bits.h"
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
 #include "tensorflow/core/framework/allocator.h"
@@ -33,7 +35,6 @@ limitations under the License.
 #include "tensorflow/core/platform/byte_order.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
-#include "tensorflow/core/util/presized_cuckoo_map.h"
 #include "tensorflow/core/util/sparse/sparse_tensor.h"
 
 namespace tensorflow {
@@ -113,6 +114,107 @@ constexpr uint8 kVarintTag(uint32 tag) { return (tag << 3) | 0; }
 constexpr uint8 kDelimitedTag(uint32 tag) { return (tag << 3) | 2; }
 constexpr uint8 kFixed32Tag(uint32 tag) { return (tag << 3) | 5; }
 
+// Added by Alpa. Decodes the varints packed in [ptr, end) into the first
+// `capacity` elements of `out`, and returns their number, or -1 if the data
+// ends inside a varint or a varint is longer than 10 bytes. On little endian
+// machines, runs of eight one-byte varints, and varints of up to eight bytes,
+// are decoded from a single 64-bit load instead of byte by byte.
+constexpr uint64 kContinuationBits = 0x8080808080808080ULL;
+
+int64_t DecodePackedVarint64s(const uint8* ptr, const uint8* end, int64_t* out,
+                              int64_t capacity) {
+  int64_t count = 0;
+  auto emit = [&](uint64 value) {
+    if (count < capacity) out[count] = static_cast<int64_t>(value);
+    ++count;
+  };
+  while (ptr < end) {
+    if (port::kLittleEndian && end - ptr >= 8) {
+      uint64 word;
+      memcpy(&word, ptr, sizeof(word));
+      // The last byte of a varint is the one without continuation bit.
+      const uint64 stops = ~word & kContinuationBits;
+      if (stops == kContinuationBits) {
+        if (count + 8 <= capacity) {
+          for (int i = 0; i < 8; ++i) {
+            out[count + i] = static_cast<int64_t>((word >> (8 * i)) & 0xff);
+          }
+          count += 8;
+        } else {
+          for (int i = 0; i < 8; ++i) emit((word >> (8 * i)) & 0xff);
+        }
+        ptr += 8;
+        continue;
+      }
+      if (stops != 0) {
+        const int length = (absl::countr_zero(stops) >> 3) + 1;
+        if (length < 8) word &= (uint64{1} << (8 * length)) - 1;
+        // Gathers the 7-bit groups of the varint, doubling their width at
+        // every step.
+        word = (word & 0x007f007f007f007fULL) |
+               ((word & 0x7f007f007f007f00ULL) >> 1);
+        word = (word & 0x00003fff00003fffULL) |
+               ((word & 0x3fff00003fff0000ULL) >> 2);
+        word = (word & 0x000000000fffffffULL) |
+               ((word & 0x0fffffff00000000ULL) >> 4);
+        emit(word);
+        ptr += length;
+        continue;
+      }
+      // A varint of nine or ten bytes, e.g. a negative value.
+    }
+    uint64 value = 0;
+    for (int shift = 0;; shift += 7) {
+      if (ptr == end || shift > 63) return -1;
+      const uint8 byte = *ptr++;
+      value |= static_cast<uint64>(byte & 0x7f) << shift;
+      if (byte < 0x80) break;
+    }
+    emit(value);
+  }
+  return count;
+}
+
+// Added by Alpa. Returns the number of varints starting in [ptr, end), i.e. the
+// number of bytes without continuation bit, counting eight bytes at a time.
+int64_t CountVarints(const uint8* ptr, const uint8* end) {
+  int64_t count = 0;
+  for (; end - ptr >= 8; ptr += 8) {
+    uint64 word;
+    memcpy(&word, ptr, sizeof(word));
+    count += absl::popcount(~word & kContinuationBits);
+  }
+  for (; ptr < end; ++ptr) count += *ptr < 0x80;
+  return count;
+}
+
+// Added by Alpa. Parses the packed varints of length `packed_length` at the
+// current position of `stream` into `out`, and skips them.
+template <typename Result>
+bool ParsePackedInt64s(protobuf::io::CodedInputStream* stream,
+                       uint32 packed_length, Result* out) {
+  if (packed_length == 0) return true;
+  const void* data;
+  int size;
+  if (!stream->GetDirectBufferPointer(&data, &size) ||
+      static_cast<uint32>(size) < packed_length) {
+    return false;
+  }
+  const uint8* begin = static_cast<const uint8*>(data);
+  const uint8* end = begin + packed_length;
+  // The output is resized once, upfront.
+  const int64_t num_values = CountVarints(begin, end);
+  const size_t initial_size = out->size();
+  out->resize(initial_size + num_values);
+  // A LimitedArraySlice may hold fewer elements than requested.
+  const int64_t capacity = out->size() - initial_size;
+  if (DecodePackedVarint64s(begin, end, out->data() + initial_size,
+                            capacity) != num_values) {
+    return false;
+  }
+  return stream->Skip(packed_length);
+}
+
 namespace parsed {
 
 // ParseDataType has to be called first, then appropriate ParseZzzzList.
@@ -299,15 +401,9 @@ class Feature {
         if (!stream.ExpectTag(kDelimitedTag(1))) return false;  // packed tag
         uint32 packed_length;
         if (!stream.ReadVarint32(&packed_length)) return false;
-        auto packed_limit = stream.PushLimit(packed_length);
-
-        while (!stream.ExpectAtEnd()) {
-          protobuf_uint64 n;  // There is no API for int64
-          if (!stream.ReadVarint64(&n)) return false;
-          int64_list->push_back(static_cast<int64_t>(n));
+        if (!ParsePackedInt64s(&stream, packed_length, int64_list)) {
+          return false;
         }
-
-        stream.PopLimit(packed_limit);
       } else {  // non-packed
         while (!stream.ExpectAtEnd()) {
           if (!stream.ExpectTag(kVarintTag(1))) return false;
@@ -554,11 +650,90 @@ struct SparseBuffer {
   std::vector<size_t> example_end_indices;
 };
 
-struct SeededHasher {
-  uint64 operator()(StringPiece s) const {
-    return Hash64(s.data(), s.size(), seed);
+// Added by Alpa. A perfect hash table from the feature names of a config to
+// their index and type. The seed is searched for when the table is built, so
+// that a lookup is one hash, one probe and one name comparison.
+class FeatureIndex {
+ public:
+  Status Init(const Config& config) {
+    std::vector<Slot> entries;
+    for (size_t d = 0; d < config.dense.size(); ++d) {
+      entries.push_back({config.dense[d].feature_name, d, Type::Dense, true});
+    }
+    for (size_t d = 0; d < config.sparse.size(); ++d) {
+      entries.push_back(
+          {config.sparse[d].feature_name, d, Type::Sparse, true});
+    }
+    for (size_t d = 0; d < config.ragged.size(); ++d) {
+      entries.push_back(
+          {config.ragged[d].feature_name, d, Type::Ragged, true});
+    }
+    // Seeds are tried for a table with at least twice as many slots as there
+    // are names, then for twice as many slots again.
+    size_t num_slots = 1;
+    while (num_slots < 2 * entries.size()) num_slots *= 2;
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+      if (attempt > 0 && attempt % 100 == 0) num_slots *= 2;
+      seed_ = 0xDECAFCAFFE + attempt;
+      mask_ = num_slots - 1;
+      slots_.assign(num_slots, Slot());
+      bool ok = true;
+      for (const Slot& entry : entries) {
+        Slot& slot = slots_[SlotIndex(entry.name)];
+        if (slot.used) {
+          if (slot.name == entry.name) {
+            return errors::InvalidArgument("Duplicate feature name: ",
+                                           entry.name);
+          }
+          ok = false;
+          break;
+        }
+        slot = entry;
+      }
+      if (ok) return OkStatus();
+    }
+    return errors::Internal(
+        "Could not avoid collision. This should not happen.");
   }
-  uint64 seed{0xDECAFCAFFE};
+
+  bool Find(StringPiece feature_name,
+            std::pair<size_t, Type>* d_and_type) const {
+    const Slot& slot = slots_[SlotIndex(feature_name)];
+    if (!slot.used || slot.name != feature_name) return false;
+    *d_and_type = {slot.d, slot.type};
+    return true;
+  }
+
+ private:
+  struct Slot {
+    StringPiece name;
+    size_t d = 0;
+    Type type = Type::Dense;
+    bool used = false;
+  };
+
+  size_t SlotIndex(StringPiece name) const {
+    return Hash64(name.data(), name.size(), seed_) & mask_;
+  }
+
+  std::vector<Slot> slots_;
+  uint64 seed_ = 0;
+  uint64 mask_ = 0;
+};
+
+// Added by Alpa. The per example state of FastParseSerializedExample(), reused
+// by the examples of a minibatch so that parsing them does not allocate.
+struct ExampleScratch {
+  explicit ExampleScratch(const Config& config)
+      : sparse_feature_last_example(config.sparse.size(), -1),
+        dense_feature_last_example(config.dense.size(), -1),
+        ragged_feature_last_example(config.ragged.size(), -1) {}
+
+  parsed::Example parsed_example;
+  // The index of the last example in which each feature was found.
+  std::vector<int64_t> sparse_feature_last_example;
+  std::vector<int64_t> dense_feature_last_example;
+  std::vector<int64_t> ragged_feature_last_example;
 };
 
 void LogDenseFeatureDataLoss(StringPiece feature_name) {
@@ -586,8 +761,8 @@ void LogSparseFeatureDataLoss(StringPiece feature_name) {
 Status FastParseSerializedExample(
     const tstring& serialized_example, const tstring& example_name,
     const size_t example_index, const Config& config,
-    const PresizedCuckooMap<std::pair<size_t, Type>>& config_index,
-    SeededHasher hasher, std::vector<Tensor>* output_dense,
+    const FeatureIndex& config_index, ExampleScratch* scratch,
+    std::vector<Tensor>* output_dense,
     std::vector<SparseBuffer>* output_varlen_dense,
     std::vector<SparseBuffer>* output_sparse,
     std::vector<SparseBuffer>* output_ragged,
@@ -595,14 +770,20 @@ Status FastParseSerializedExample(
   DCHECK(output_dense != nullptr);
   DCHECK(output_sparse != nullptr);
   DCHECK(output_ragged != nullptr);
-  parsed::Example parsed_example;
+  parsed::Example& parsed_example = scratch->parsed_example;
+  parsed_example.clear();
   if (!ParseExample(serialized_example, &parsed_example)) {
     return errors::InvalidArgument("Could not parse example input, value: '",
                                    serialized_example, "'");
   }
-  std::vector<int64_t> sparse_feature_last_example(config.sparse.size(), -1);
-  std::vector<int64_t> dense_feature_last_example(config.dense.size(), -1);
-  std::vector<int64_t> ragged_feature_last_example(config.ragged.size(), -1);
+  // The examples are parsed with increasing indices, so the indices of the
+  // previous examples of the minibatch need not be reset.
+  std::vector<int64_t>& sparse_feature_last_example =
+      scratch->sparse_feature_last_example;
+  std::vector<int64_t>& dense_feature_last_example =
+      scratch->dense_feature_last_example;
+  std::vector<int64_t>& ragged_feature_last_example =
+      scratch->ragged_feature_last_example;
 
   // Handle features present in the example.
   const size_t parsed_example_size = parsed_example.size();
@@ -624,23 +805,12 @@ Status FastParseSerializedExample(
     parsed::Feature& feature = name_and_feature.second;
 
     std::pair<size_t, Type> d_and_type;
-    uint64 h = hasher(feature_name);
-    if (!config_index.Find(h, &d_and_type)) continue;
+    if (!config_index.Find(feature_name, &d_and_type)) continue;
 
     size_t d = d_and_type.first;
     bool is_dense = d_and_type.second == Type::Dense;
     bool is_ragged = d_and_type.second == Type::Ragged;
 
-    {
-      // Testing for PresizedCuckooMap collision.
-      // TODO(lew): Use dense_hash_map and avoid this and hasher creation.
-      const tstring& config_feature_name =
-          is_dense ? config.dense[d].feature_name
-                   : (is_ragged ? config.ragged[d].feature_name
-                                : config.sparse[d].feature_name);
-      if (feature_name != config_feature_name) continue;
-    }
-
     auto example_error = [&](StringPiece suffix) {
       return errors::InvalidArgument("Name: ", example_name,
                                      ", Key: ", feature_name,
@@ -1139,36 +1309,9 @@ Status FastParseExample(const Config& config,
     result->feature_stats.resize(serialized.size());
   }
 
-  size_t config_size =
-      config.dense.size() + config.sparse.size() + config.ragged.size();
-  SeededHasher hasher;
   // Build config index.
-  PresizedCuckooMap<std::pair<size_t, Type>> config_index(config_size);
-  bool ok = true;
-  for (size_t i = 0; i < 1000; ++i) {
-    for (size_t d = 0; d < config.dense.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.dense[d].feature_name),
-                                      {d, Type::Dense});
-    }
-    for (size_t d = 0; d < config.sparse.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.sparse[d].feature_name),
-                                      {d, Type::Sparse});
-    }
-    for (size_t d = 0; d < config.ragged.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.ragged[d].feature_name),
-                                      {d, Type::Ragged});
-    }
-    if (ok) break;
-    LOG(WARNING) << "Collision found. This should happen only if you have "
-                    "around 2^32 entries in your config.";
-    hasher.seed++;
-    config_index.Clear(config_size);
-    ok = true;
-  }
-  if (!ok) {
-    return errors::Internal(
-        "Could not avoid collision. This should not happen.");
-  }
+  FeatureIndex config_index;
+  TF_RETURN_IF_ERROR(config_index.Init(config));
 
   // Allocate dense output for fixed length dense values
   // (variable-length dense and sparse and ragged have to be buffered).
@@ -1231,6 +1374,7 @@ Status FastParseExample(const Config& config,
     ragged_buffers[minibatch].resize(config.ragged.size());
     size_t start = first_example_of_minibatch(minibatch);
     size_t end = first_example_of_minibatch(minibatch + 1);
+    ExampleScratch scratch(config);
     for (size_t e = start; e < end; ++e) {
       PerExampleFeatureStats* stats = nullptr;
       if (config.collect_feature_stats) {
@@ -1239,7 +1383,7 @@ Status FastParseExample(const Config& config,
       status_of_minibatch[minibatch] = FastParseSerializedExample(
           serialized[e],
           (!example_names.empty() ? example_names[e] : "<unknown>"), e, config,
-          config_index, hasher, &fixed_dense_values,
+          config_index, &scratch, &fixed_dense_values,
           &varlen_dense_buffers[minibatch], &sparse_buffers[minibatch],
           &ragged_buffers[minibatch], stats);
       if (!status_of_minibatch[minibatch].ok()) break;
@@ -1454,36 +1598,9 @@ Status FastParseSingleExample(const Config& config, StringPiece serialized,
   }
 
   // TODO(mrry): Cache the construction of this map at Op construction time.
-  size_t config_size =
-      config.dense.size() + config.sparse.size() + config.ragged.size();
-  SeededHasher hasher;
   // Build config index.
-  PresizedCuckooMap<std::pair<size_t, Type>> config_index(config_size);
-  bool ok = true;
-  for (size_t i = 0; i < 1000; ++i) {
-    for (size_t d = 0; d < config.dense.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.dense[d].feature_name),
-                                      {d, Type::Dense});
-    }
-    for (size_t d = 0; d < config.sparse.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.sparse[d].feature_name),
-                                      {d, Type::Sparse});
-    }
-    for (size_t d = 0; d < config.ragged.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.ragged[d].feature_name),
-                                      {d, Type::Ragged});
-    }
-    if (ok) break;
-    LOG(WARNING) << "Collision found. This should happen only if you have "
-                    "around 2^32 entries in your config.";
-    hasher.seed++;
-    config_index.Clear(config_size);
-    ok = true;
-  }
-  if (!ok) {
-    return errors::Internal(
-        "Could not avoid collision. This should not happen.");
-  }
+  FeatureIndex config_index;
+  TF_RETURN_IF_ERROR(config_index.Init(config));
 
   result->sparse_indices.reserve(config.sparse.size());
   result->sparse_values.reserve(config.sparse.size());
@@ -1553,23 +1670,12 @@ Status FastParseSingleExample(const Config& config, StringPiece serialized,
     parsed::Feature& feature = name_and_feature.second;
 
     std::pair<size_t, Type> d_and_type;
-    uint64 h = hasher(feature_name);
-    if (!config_index.Find(h, &d_and_type)) continue;
+    if (!config_index.Find(feature_name, &d_and_type)) continue;
 
     size_t d = d_and_type.first;
     bool is_dense = d_and_type.second == Type::Dense;
     bool is_sparse = d_and_type.second == Type::Sparse;
 
-    {
-      // Testing for PresizedCuckooMap collision.
-      // TODO(lew): Use dense_hash_map and avoid this and hasher creation.
-      const tstring& config_feature_name =
-          is_dense ? config.dense[d].feature_name
-                   : (is_sparse ? config.sparse[d].feature_name
-                                : config.ragged[d].feature_name);
-      if (feature_name != config_feature_name) continue;
-    }
-
     auto example_error = [feature_name](StringPiece suffix) {
       return errors::InvalidArgument("Key: ", feature_name, ".  ", suffix);
     };
@@ -1971,18 +2077,22 @@ inline int ParseInt64Feature(protobuf::io::CodedInputStream* stream,
           !stream->ReadVarint32(&packed_length)) {
         return -1;
       }
-      auto packed_limit = stream->PushLimit(packed_length);
-      while (!stream->ExpectAtEnd()) {
-        protobuf_uint64 n;  // There is no API for int64
-        if (!stream->ReadVarint64(&n)) {
+      const void* data;
+      int size;
+      if (packed_length > 0) {
+        if (!stream->GetDirectBufferPointer(&data, &size) ||
+            static_cast<uint32>(size) < packed_length) {
           return -1;
         }
-        if (out != nullptr) {
-          *out++ = n;
+        const uint8* begin = static_cast<const uint8*>(data);
+        // The callers size `out` from a first call without it.
+        num_elements = DecodePackedVarint64s(
+            begin, begin + packed_length, out,
+            out != nullptr ? packed_length : 0);
+        if (num_elements < 0 || !stream->Skip(packed_length)) {
+          return -1;
         }
-        num_elements++;
       }
-      stream->PopLimit(packed_limit);
     } else if (peek_tag == kVarintTag(1)) {
       while (!stream->ExpectAtEnd()) {
         protobuf_uint64 n;  // There is no API for int64
@@ -13,6 +13,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <limits>
 #include <utility>
 
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
@@ -136,6 +137,26 @@ TEST(FastParse, SingleInt64WithContext) {
   TestCorrectness(strings::StrCat(Serialize(example), Serialize(context)));
 }
 
+TEST(FastParse, PackedInt64sOfAllWidths) {
+  Example example;
+  auto* int64_list = (*example.mutable_features()->mutable_feature())["ids"]
+                         .mutable_int64_list();
+  // Runs of one-byte varints, and varints of every length up to ten bytes.
+  for (int64_t i = 0; i < 100; ++i) {
+    int64_list->add_value(i);
+  }
+  for (int shift = 0; shift < 63; shift += 3) {
+    int64_list->add_value(int64_t{1} << shift);
+    int64_list->add_value((int64_t{1} << shift) - 1);
+    int64_list->add_value(-(int64_t{1} << shift));
+  }
+  int64_list->add_value(std::numeric_limits<int64_t>::max());
+  int64_list->add_value(std::numeric_limits<int64_t>::min());
+  int64_list->add_value(7);
+
+  TestCorrectness(Serialize(example));
+}
+
 TEST(FastParse, DenseInt64WithContext) {
   Example example;
   (*example.mutable_features()->mutable_feature())["age"]
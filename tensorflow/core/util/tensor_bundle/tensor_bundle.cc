@@ -24,6 +24,7 @@ limitations under the License.
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/framework/variant.h"
@@ -76,6 +77,9 @@ const int64_t kLargeTensorThreshold = static_cast<int64_t>(1) << 32;
 const int kMaxFileReadThreads = 8;
 // Minimum size of a file section handled by each thread.
 const int64_t kMinSectionSize = static_cast<int64_t>(1) << 31;
+// Added by Alpa. Minimum size of a section of a memory-mapped tensor copied by
+// each thread.
+const int64_t kMinMappedSectionSize = static_cast<int64_t>(1) << 26;
 
 namespace {
 
@@ -418,10 +422,40 @@ Status PadAlignment(FileOutputBuffer* out, int alignment, int64_t* size) {
   return status;
 }
 
+// Added by Alpa. Appends the tensor "val" to "out", of "*size" bytes, and
+// records its offset, size and checksum into "entry". Then pads "out" to
+// "alignment".
+Status AppendTensor(const Tensor& val, int alignment, FileOutputBuffer* out,
+                    int64_t* size, BundleEntryProto* entry) {
+  entry->set_offset(*size);
+  size_t data_bytes_written = 0;
+  uint32 crc32c = 0;
+  out->clear_crc32c();
+  if (val.dtype() == DT_STRING) {
+    TF_RETURN_IF_ERROR(
+        WriteStringTensor(val, out, &data_bytes_written, &crc32c));
+  } else if (val.dtype() == DT_VARIANT) {
+    TF_RETURN_IF_ERROR(
+        WriteVariantTensor(val, out, &data_bytes_written, &crc32c));
+  } else {
+    TF_RETURN_IF_ERROR(WriteTensor(val, out, &data_bytes_written));
+    crc32c = out->crc32c();
+  }
+  entry->set_size(data_bytes_written);
+  entry->set_crc32c(crc32c::Mask(crc32c));
+  *size += data_bytes_written;
+  return PadAlignment(out, alignment, size);
+}
+
 }  // namespace
 
 BundleWriter::BundleWriter(Env* env, StringPiece prefix, const Options& options)
     : env_(env), options_(options), prefix_(prefix), out_(nullptr), size_(0) {
+  if (options_.num_data_shards < 1) {
+    status_ = errors::InvalidArgument("num_data_shards must be >= 1, got ",
+                                      options_.num_data_shards);
+    return;
+  }
   status_ = env_->HasAtomicMove(prefix_, &use_temp_file_);
   if (!status_.ok()) return;
 
@@ -438,6 +472,26 @@ BundleWriter::BundleWriter(Env* env, StringPiece prefix, const Options& options)
     return;
   }
 
+  if (options_.num_data_shards > 1) {
+    shards_.resize(options_.num_data_shards);
+    for (int i = 0; i < shards_.size(); ++i) {
+      DataShard& shard = shards_[i];
+      shard.path = DataFilename(prefix_, i, options_.num_data_shards);
+      if (use_temp_file_) {
+        shard.path = strings::StrCat(shard.path, ".tempstate", random::New64());
+      }
+      std::unique_ptr<WritableFile> file;
+      status_ = env_->NewWritableFile(shard.path, &file);
+      if (!status_.ok()) return;
+      shard.out = std::make_unique<FileOutputBuffer>(
+          file.release(), 8 << 20 /* 8MB write buffer */);
+      shard.writer = std::make_unique<thread::ThreadPool>(
+          env_, "bundle_writer", /*num_threads=*/1);
+      VLOG(1) << "Writing to file " << shard.path;
+    }
+    return;
+  }
+
   std::unique_ptr<WritableFile> wrapper;
   status_ = env_->NewWritableFile(data_path_, &wrapper);
   if (!status_.ok()) return;
@@ -459,28 +513,36 @@ Status BundleWriter::Add(StringPiece key, const Tensor& val) {
   BundleEntryProto* entry = &entries_[key_string];
   entry->set_dtype(val.dtype());
   val.shape().AsProto(entry->mutable_shape());
-  entry->set_shard_id(0);
-  entry->set_offset(size_);
 
-  // Updates the data file.
-  size_t data_bytes_written = 0;
-  uint32 crc32c = 0;
-  out_->clear_crc32c();
-  if (val.dtype() == DT_STRING) {
-    status_ = WriteStringTensor(val, out_.get(), &data_bytes_written, &crc32c);
-  } else if (val.dtype() == DT_VARIANT) {
-    status_ = WriteVariantTensor(val, out_.get(), &data_bytes_written, &crc32c);
-  } else {
-    status_ = WriteTensor(val, out_.get(), &data_bytes_written);
-    crc32c = out_->crc32c();
+  // Added by Alpa. A sharded writer hands a snapshot of the tensor to the
+  // writer thread of the data file with the fewest bytes.
+  if (!shards_.empty()) {
+    int shard_id = 0;
+    for (int i = 1; i < shards_.size(); ++i) {
+      if (shards_[i].scheduled_bytes < shards_[shard_id].scheduled_bytes) {
+        shard_id = i;
+      }
+    }
+    entry->set_shard_id(shard_id);
+    DataShard* shard = &shards_[shard_id];
+    shard->scheduled_bytes += val.TotalBytes();
+    const int alignment = options_.data_alignment;
+    shard->writer->Schedule(
+        [shard, entry, alignment, snapshot = tensor::DeepCopy(val)]() {
+          if (!shard->status.ok()) return;
+          BundleEntryProto written;
+          shard->status = AppendTensor(snapshot, alignment, shard->out.get(),
+                                       &shard->size, &written);
+          shard->written.emplace_back(entry, std::move(written));
+        });
+    return status_;
   }
 
-  if (status_.ok()) {
-    entry->set_size(data_bytes_written);
-    entry->set_crc32c(crc32c::Mask(crc32c));
-    size_ += data_bytes_written;
-    status_ = PadAlignment(out_.get(), options_.data_alignment, &size_);
-  }
+  entry->set_shard_id(0);
+
+  // Updates the data file.
+  status_ = AppendTensor(val, options_.data_alignment, out_.get(), &size_,
+                         entry);
   return status_;
 }
 
@@ -527,7 +589,47 @@ Status BundleWriter::AddSlice(StringPiece full_tensor_key,
 
 // TODO(zongheng): on metadata write failure or !status_.ok(), consider removing
 // the orphaned data file.
+Status BundleWriter::FinishDataShards() {
+  // The data files are synced in parallel, then closed.
+  for (DataShard& shard : shards_) {
+    if (shard.writer == nullptr) continue;
+    DataShard* shard_ptr = &shard;
+    shard.writer->Schedule([shard_ptr]() {
+      if (shard_ptr->status.ok()) shard_ptr->status = shard_ptr->out->Sync();
+      shard_ptr->status.Update(shard_ptr->out->Close());
+    });
+  }
+  // Deletes the data files if the writer failed before Finish().
+  Status status = status_;
+  for (DataShard& shard : shards_) {
+    shard.writer.reset();  // Waits for the writes.
+    shard.out = nullptr;
+    status.Update(shard.status);
+    for (const auto& p : shard.written) {
+      p.first->set_offset(p.second.offset());
+      p.first->set_size(p.second.size());
+      p.first->set_crc32c(p.second.crc32c());
+    }
+  }
+  for (int i = 0; i < shards_.size(); ++i) {
+    const string& path = shards_[i].path;
+    if (path.empty()) continue;
+    if (!status.ok()) {
+      Env::Default()->DeleteFile(path).IgnoreError();
+    } else if (use_temp_file_) {
+      status.Update(Env::Default()->RenameFile(
+          path, DataFilename(prefix_, i, options_.num_data_shards)));
+    }
+  }
+  shards_.clear();
+  return status;
+}
+
 Status BundleWriter::Finish() {
+  // Added by Alpa.
+  if (!shards_.empty()) {
+    status_.Update(FinishDataShards());
+  }
   if (out_) {
     status_.Update(out_->Close());
     out_ = nullptr;
@@ -553,7 +655,7 @@ Status BundleWriter::Finish() {
     table::TableBuilder builder(options, file.get());
     // Header entry.
     BundleHeaderProto header;
-    header.set_num_shards(1);
+    header.set_num_shards(options_.num_data_shards);
     header.set_endianness(BundleHeaderProto::LITTLE);
     if (!port::kLittleEndian) header.set_endianness(BundleHeaderProto::BIG);
     VersionDef* version = header.mutable_version();
@@ -761,19 +863,77 @@ Status MergeBundles(Env* env, gtl::ArraySlice<tstring> prefixes,
   return status;
 }
 
+namespace {
+
+// Added by Alpa. Copies the "size" bytes at "offset" of the memory-mapped data
+// file "mapped_file" into "destination" and checksums them into
+// "actual_crc32c". Large tensors, or all of them if "multi_threaded", are
+// copied in sections on a thread pool while the calling thread checksums the
+// mapped bytes, so that the checksum does not delay the restore.
+Status ReadMappedTensor(const ReadOnlyMemoryRegion& mapped_file, uint64 offset,
+                        uint64 size, bool multi_threaded, char* destination,
+                        uint32* actual_crc32c) {
+  if (offset > mapped_file.length() || size > mapped_file.length() - offset) {
+    return errors::OutOfRange("Reading ", size, " bytes at offset ", offset,
+                              " past the end of a data file of ",
+                              mapped_file.length(), " bytes");
+  }
+  if (size == 0) return OkStatus();
+  const char* source = static_cast<const char*>(mapped_file.data()) + offset;
+  int64_t num_sections = 1;
+  if (multi_threaded) {
+    num_sections = kMaxFileReadThreads;
+  } else if (size >= 2 * kMinMappedSectionSize) {
+    num_sections = std::min<int64_t>(kMaxFileReadThreads,
+                                     size / kMinMappedSectionSize);
+  }
+  if (num_sections == 1) {
+    memcpy(destination, source, size);
+    *actual_crc32c = crc32c::Value(source, size);
+    return OkStatus();
+  }
+  const int64_t section_size = (size + num_sections - 1) / num_sections;
+  {
+    thread::ThreadPool copy_pool(Env::Default(), "restore_mapped_tensor",
+                                 num_sections);
+    for (int64_t i = 0; i < num_sections; ++i) {
+      const int64_t begin = std::min<int64_t>(i * section_size, size);
+      const int64_t end = std::min<int64_t>(begin + section_size, size);
+      copy_pool.Schedule([destination, source, begin, end]() {
+        memcpy(destination + begin, source + begin, end - begin);
+      });
+    }
+    *actual_crc32c = crc32c::Value(source, size);
+  }  // Waits for the copies.
+  return OkStatus();
+}
+
+}  // namespace
+
 // Interface for reading a tensor bundle.
 
 BundleReader::BundleReader(
     Env* env, StringPiece prefix,
     bool enable_multi_threading_for_testing /* = false */)
+    : BundleReader(env, prefix, [enable_multi_threading_for_testing]() {
+        Options options;
+        options.enable_multi_threading_for_testing =
+            enable_multi_threading_for_testing;
+        return options;
+      }()) {}
+
+BundleReader::BundleReader(Env* env, StringPiece prefix,
+                           const Options& options)
     : env_(env),
       prefix_(prefix),
       metadata_(nullptr),
       table_(nullptr),
       index_cache_(nullptr),
       iter_(nullptr),
+      memory_mapped_(options.memory_mapped),
       need_to_swap_bytes_(false),
-      enable_multi_threading_for_testing_(enable_multi_threading_for_testing) {
+      enable_multi_threading_for_testing_(
+          options.enable_multi_threading_for_testing) {
   const string filename = MetaFilename(prefix_);
   uint64 file_size;
   status_ = env_->GetFileSize(filename, &file_size);
@@ -865,6 +1025,24 @@ Status BundleReader::GetBundleEntryProto(StringPiece key,
   return OkStatus();
 }
 
+const ReadOnlyMemoryRegion* BundleReader::GetMappedData(int32 shard_id) {
+  if (!memory_mapped_) return nullptr;
+  auto it = mapped_data_.find(shard_id);
+  if (it != mapped_data_.end()) return it->second.get();
+  const string filename = DataFilename(prefix_, shard_id, num_shards_);
+  std::unique_ptr<ReadOnlyMemoryRegion> mapped_file;
+  Status s = env_->NewReadOnlyMemoryRegionFromFile(filename, &mapped_file);
+  if (!s.ok()) {
+    // E.g. the file system does not support memory mapping, or the file is
+    // empty: falls back to buffered reads.
+    VLOG(1) << "Unable to memory-map " << filename << ": " << s;
+    mapped_file.reset();
+  }
+  std::unique_ptr<ReadOnlyMemoryRegion>& entry = mapped_data_[shard_id];
+  entry = std::move(mapped_file);
+  return entry.get();
+}
+
 Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
   Tensor* ret = val;
   const TensorShape stored_shape(TensorShape(entry.shape()));
@@ -894,22 +1072,40 @@ Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
     }
   }
 
+  // Added by Alpa. Tensors of memcpy-able types are read from the mapped data
+  // file, if any, rather than from the buffered one.
+  const ReadOnlyMemoryRegion* mapped_file =
+      DataTypeCanUseMemcpy(entry.dtype()) ? GetMappedData(entry.shard_id())
+                                          : nullptr;
+
   // Open the data file if it has not been opened.
-  io::InputBuffer* buffered_file = data_[entry.shard_id()];
-  if (buffered_file == nullptr) {
-    std::unique_ptr<RandomAccessFile> file = nullptr;
-    TF_RETURN_IF_ERROR(env_->NewRandomAccessFile(
-        DataFilename(prefix_, entry.shard_id(), num_shards_), &file));
-    buffered_file = new io::InputBuffer(file.release(), kBufferSize);
-    // The InputBuffer and RandomAccessFile objects are both released in dtor.
-    data_[entry.shard_id()] = buffered_file;
-  }
-  CHECK(buffered_file != nullptr);
-
-  TF_RETURN_IF_ERROR(buffered_file->Seek(entry.offset()));
+  io::InputBuffer* buffered_file = nullptr;
+  if (mapped_file == nullptr) {
+    buffered_file = data_[entry.shard_id()];
+    if (buffered_file == nullptr) {
+      std::unique_ptr<RandomAccessFile> file = nullptr;
+      TF_RETURN_IF_ERROR(env_->NewRandomAccessFile(
+          DataFilename(prefix_, entry.shard_id(), num_shards_), &file));
+      buffered_file = new io::InputBuffer(file.release(), kBufferSize);
+      // The InputBuffer and RandomAccessFile objects are both released in
+      // dtor.
+      data_[entry.shard_id()] = buffered_file;
+    }
+    CHECK(buffered_file != nullptr);
+
+    TF_RETURN_IF_ERROR(buffered_file->Seek(entry.offset()));
+  }
   uint32 actual_crc32c = 0;
 
-  if (DataTypeCanUseMemcpy(entry.dtype())) {
+  if (mapped_file != nullptr) {
+    TF_RETURN_IF_ERROR(ReadMappedTensor(
+        *mapped_file, entry.offset(), entry.size(),
+        enable_multi_threading_for_testing_,
+        const_cast<char*>(ret->tensor_data().data()), &actual_crc32c));
+    if (need_to_swap_bytes_) {
+      TF_RETURN_IF_ERROR(ByteSwapTensor(ret));
+    }
+  } else if (DataTypeCanUseMemcpy(entry.dtype())) {
     char* backing_buffer = const_cast<char*>((ret->tensor_data().data()));
     size_t unused_bytes_read;
     if (entry.size() > kBufferSize) {
@@ -1262,6 +1458,11 @@ Status FileOutputBuffer::Close() {
   return file_->Close();
 }
 
+Status FileOutputBuffer::Sync() {
+  TF_RETURN_IF_ERROR(FlushBuffer(false));
+  return file_->Sync();
+}
+
 Status FileOutputBuffer::FlushBuffer(bool closing) {
   if (position_ > 0) {
     // Use Cord to avoid extra data copy for some WritableFile implementations.
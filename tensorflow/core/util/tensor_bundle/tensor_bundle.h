@@ -62,8 +62,11 @@ limitations under the License.
 #define TENSORFLOW_CORE_UTIL_TENSOR_BUNDLE_TENSOR_BUNDLE_H_
 
 #include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_map.h"
@@ -72,6 +75,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_slice.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/io/cache.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
@@ -116,6 +120,12 @@ class BundleWriter {
     // Alignment, in bytes, for tensor data.
     // Must be >= 1. The default size of 1 densely packs tensors.
     int data_alignment{1};
+    // Added by Alpa. Number of data files the tensors are spread over.
+    // Must be >= 1. With more than one, each data file is written, checksummed
+    // and synced by its own writer thread: Add() snapshots the tensor into a
+    // host copy, so that the caller may modify it right away, and returns
+    // before it is written. Errors of the writes are returned by Finish().
+    int num_data_shards{1};
   };
   BundleWriter(Env* env, StringPiece prefix,
                const Options& options = Options());
@@ -150,6 +160,25 @@ class BundleWriter {
   Status status() const { return status_; }
 
  private:
+  // Added by Alpa. A data file written by its own thread when
+  // options_.num_data_shards > 1. Only "scheduled_bytes" is accessed from the
+  // caller before Finish() joins the writer thread.
+  struct DataShard {
+    string path;
+    std::unique_ptr<FileOutputBuffer> out;
+    int64_t size = 0;  // Number of bytes written into out.
+    // Number of bytes of the tensors added to the shard.
+    int64_t scheduled_bytes = 0;
+    // The written entries and their offsets, sizes and checksums, merged
+    // into "entries_" by Finish().
+    std::vector<std::pair<BundleEntryProto*, BundleEntryProto>> written;
+    Status status;
+    std::unique_ptr<thread::ThreadPool> writer;
+  };
+
+  // Added by Alpa. Finishes the data files of a sharded writer.
+  Status FinishDataShards();
+
   Env* const env_;  // Not owned.
   const Options options_;
   const string prefix_;
@@ -158,6 +187,7 @@ class BundleWriter {
   bool use_temp_file_;
   std::unique_ptr<FileOutputBuffer> out_;
   int64_t size_;  // Number of bytes written into out_.
+  std::vector<DataShard> shards_;  // Added by Alpa.
   std::map<string, BundleEntryProto> entries_;
   Status status_;
 
@@ -196,8 +226,21 @@ Status MergeBundles(Env* env, gtl::ArraySlice<tstring> prefixes,
 // All threads accessing the same BundleReader must synchronize.
 class BundleReader {
  public:
+  // Added by Alpa.
+  struct Options {
+    Options() {}
+    // Memory-maps the data files, when their file system supports it, and
+    // reads the tensors of memcpy-able types from the mapped files instead of
+    // through buffered reads. Large tensors are then copied in sections on a
+    // thread pool while their checksum is computed on the mapped bytes.
+    bool memory_mapped{false};
+    // Splits the reads of every large tensor into sections read in parallel.
+    bool enable_multi_threading_for_testing{false};
+  };
   BundleReader(Env* const env, StringPiece prefix,
                bool enable_multi_threading_for_testing = false);
+  BundleReader(Env* const env, StringPiece prefix,
+               const Options& options);  // Added by Alpa.
   ~BundleReader();
 
   // Is ok() iff the reader construction is successful (completed the read of
@@ -310,6 +353,11 @@ class BundleReader {
                        const TensorSlice& slice_spec,
                        Tensor* val) TF_MUST_USE_RESULT;
 
+  // Added by Alpa. Returns the memory-mapped data file of shard "shard_id",
+  // mapping it on first use, or nullptr if the reader is not memory-mapped or
+  // the file cannot be mapped.
+  const ReadOnlyMemoryRegion* GetMappedData(int32 shard_id);
+
   Env* env_;  // Not owned.
   const string prefix_;
 
@@ -320,6 +368,11 @@ class BundleReader {
   table::Iterator* iter_;
   // Owned the InputBuffer objects and their underlying RandomAccessFile's.
   std::unordered_map<int32, io::InputBuffer*> data_;
+  // Added by Alpa. The memory-mapped data files, or nullptr for the files that
+  // cannot be mapped, which are read through "data_".
+  const bool memory_mapped_;
+  std::unordered_map<int32, std::unique_ptr<ReadOnlyMemoryRegion>>
+      mapped_data_;
 
   // Maps each partitioned tensor's key to its stored slices (represented in a
   // TensorSliceSet).  Populated on-demand.
@@ -359,6 +412,9 @@ class FileOutputBuffer {
   // Appends the buffered data, then closes the underlying file.
   Status Close();
 
+  // Added by Alpa. Appends the buffered data, then syncs the underlying file.
+  Status Sync();
+
  private:
   // Appends the buffered data to the underlying file. Does NOT flush the file.
   Status FlushBuffer(bool closing);
@@ -1148,6 +1148,90 @@ TEST(TensorBundleTest, LargeVariableLoadingTest) {
   }
 }
 
+TEST(TensorBundleTest, ShardedWriter) {
+  {
+    BundleWriter::Options options;
+    options.num_data_shards = 3;
+    BundleWriter writer(Env::Default(), Prefix("sharded"), options);
+    TF_ASSERT_OK(writer.status());
+    Tensor val = Constant_100x100<float>(0);
+    TF_EXPECT_OK(writer.Add("foo_000", val));
+    // The writer snapshots the tensor on Add().
+    val.flat<float>().setConstant(1);
+    TF_EXPECT_OK(writer.Add("foo_001", val));
+    TF_EXPECT_OK(
+        writer.Add("foo_002", test::AsTensor<tstring>({"hello", "world"})));
+    TF_EXPECT_OK(writer.Add("foo_003", Constant_2x3<int32>(3)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  for (int i = 0; i < 3; ++i) {
+    TF_EXPECT_OK(
+        Env::Default()->FileExists(DataFilename(Prefix("sharded"), i, 3)));
+  }
+  BundleReader reader(Env::Default(), Prefix("sharded"));
+  TF_ASSERT_OK(reader.status());
+  EXPECT_EQ(
+      AllTensorKeys(&reader),
+      std::vector<string>({"foo_000", "foo_001", "foo_002", "foo_003"}));
+  Expect<float>(&reader, "foo_000", Constant_100x100<float>(0));
+  Expect<float>(&reader, "foo_001", Constant_100x100<float>(1));
+  Expect<tstring>(&reader, "foo_002",
+                  test::AsTensor<tstring>({"hello", "world"}));
+  Expect<int32>(&reader, "foo_003", Constant_2x3<int32>(3));
+}
+
+TEST(TensorBundleTest, MemoryMapped) {
+  {
+    BundleWriter writer(Env::Default(), Prefix("mapped"));
+    TF_EXPECT_OK(writer.Add("foo_000", Constant_100x100<float>(0)));
+    TF_EXPECT_OK(writer.Add("foo_001", Constant_2x3<int32>(1)));
+    TF_EXPECT_OK(
+        writer.Add("foo_002", test::AsTensor<tstring>({"hello", "world"})));
+    TF_EXPECT_OK(writer.Add("foo_003", Constant_100x100<double>(3)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  for (bool multi_threaded : {false, true}) {
+    BundleReader::Options options;
+    options.memory_mapped = true;
+    options.enable_multi_threading_for_testing = multi_threaded;
+    BundleReader reader(Env::Default(), Prefix("mapped"), options);
+    TF_ASSERT_OK(reader.status());
+    Expect<float>(&reader, "foo_000", Constant_100x100<float>(0));
+    Expect<int32>(&reader, "foo_001", Constant_2x3<int32>(1));
+    Expect<tstring>(&reader, "foo_002",
+                    test::AsTensor<tstring>({"hello", "world"}));
+    Expect<double>(&reader, "foo_003", Constant_100x100<double>(3));
+  }
+
+  // Corrupts the float tensor, which is first in the data file.
+  const string datafile = DataFilename(Prefix("mapped"), 0, 1);
+  string data;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), datafile, &data));
+  data[0] = ~data[0];
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), datafile, data));
+  BundleReader::Options options;
+  options.memory_mapped = true;
+  {
+    BundleReader reader(Env::Default(), Prefix("mapped"), options);
+    TF_ASSERT_OK(reader.status());
+    Tensor val(DT_FLOAT, TensorShape({100, 100}));
+    Status status = reader.Lookup("foo_000", &val);
+    EXPECT_TRUE(errors::IsDataLoss(status));
+    EXPECT_TRUE(
+        absl::StrContains(status.ToString(), "Checksum does not match"));
+  }
+
+  // Truncates the last tensor.
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), datafile,
+                                 StringPiece(data.data(), data.size() - 1)));
+  {
+    BundleReader reader(Env::Default(), Prefix("mapped"), options);
+    TF_ASSERT_OK(reader.status());
+    Tensor val(DT_DOUBLE, TensorShape({100, 100}));
+    EXPECT_TRUE(errors::IsOutOfRange(reader.Lookup("foo_003", &val)));
+  }
+}
+
 class TensorBundleAlignmentTest : public ::testing::Test {
  protected:
   template <typename T>
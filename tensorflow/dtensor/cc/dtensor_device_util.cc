@@ -518,11 +518,28 @@ absl::flat_hash_map<int, NodeDef> GetConstantFoldableTensors(
   return small_tensors;
 }
 
+// Thread unsafe method. go/thread-unsafe
+tensorflow::Fprint128 FunctionManager::FingerprintForOperation(
+    const DTensorOperation& doperation) {
+  if (!doperation.is_func()) return tensorflow::Fingerprint128(doperation.name);
+  auto iter = function_body_fingerprints_.find(doperation.name);
+  if (iter != function_body_fingerprints_.end()) return iter->second;
+
+  FunctionDef body = *doperation.function_def;
+  body.mutable_signature()->clear_name();
+  std::string serialized;
+  SerializeToStringDeterministic(body, &serialized);
+  const tensorflow::Fprint128 fingerprint =
+      tensorflow::Fingerprint128(serialized);
+  function_body_fingerprints_.insert({doperation.name, fingerprint});
+  return fingerprint;
+}
+
 // Thread unsafe method. go/thread-unsafe
 // Cache key computation should consider all features of an op that affects
 // the SPMD lowering. The cache keys of two ops must be different if the
 // translated functions are different.
-// - op name and attr
+// - op name (eager ops) or function body (functions) and attr
 // - input shapes and layouts
 // - default layout of outputs.
 // - values of constant foldable inputs.
@@ -530,7 +547,7 @@ tensorflow::Fprint128 FunctionManager::CacheKeyForGraph(
     const DTensorOperation& doperation, const NameAttrList& attributes,
     const std::vector<TensorWithLayout*>& inputs,
     const std::vector<const Layout*>& output_layouts) {
-  tensorflow::Fprint128 cache_key = tensorflow::Fingerprint128(doperation.name);
+  tensorflow::Fprint128 cache_key = FingerprintForOperation(doperation);
   std::string serialized;
   SerializeToStringDeterministic(attributes, &serialized);
   cache_key =
@@ -568,6 +568,13 @@ class FunctionManager {
   const tensorflow::Fprint128 CacheKeyForDTensorOperation(
       const DTensorOperation& doperation) const;
 
+  // Fingerprint of the operation body. For functions this hashes the
+  // FunctionDef with its signature name cleared, so that a retraced
+  // tf.function with an identical body (but a fresh name) maps to the same
+  // lowered graph. Memoized by function name.
+  tensorflow::Fprint128 FingerprintForOperation(
+      const DTensorOperation& doperation);
+
   // Generates a cache key for the graph, including its attributes,
   // inputs, and outputs.
   tensorflow::Fprint128 CacheKeyForGraph(
@@ -587,6 +594,10 @@ class FunctionManager {
   absl::flat_hash_map<tensorflow::Fprint128, absl::flat_hash_map<int, NodeDef>,
                       tensorflow::Fprint128Hasher>
       dtensor_op_and_small_inputs_;
+
+  // Maps a function name to the fingerprint of its name-independent body.
+  absl::flat_hash_map<std::string, tensorflow::Fprint128>
+      function_body_fingerprints_;
 };
 
 // Returns the shape of a given tensor.
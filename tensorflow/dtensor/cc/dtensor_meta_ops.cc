@@ -155,5 +155,60 @@ REGISTER_OP("DTensorAllGather")
       return OkStatus();
     });
 
+REGISTER_OP("DTensorAllToAll")
+    .Input("input: T")
+    .Output("output: T")
+    .Attr("T: {half, bfloat16, float, int32, uint32, int64, bool}")
+    .Attr("input_layout: string")
+    .Attr("output_layout: string")
+    .SetShapeFn([](shape_inference::InferenceContext* c) -> Status {
+      shape_inference::ShapeHandle in = c->input(0);
+      if (!c->RankKnown(in)) {
+        // Input shape unknown, so set unknown output shape.
+        c->set_output(0, in);
+        return OkStatus();
+      }
+
+      std::string input_layout_string;
+      std::string output_layout_string;
+      TF_RETURN_IF_ERROR(c->GetAttr("input_layout", &input_layout_string));
+      TF_RETURN_IF_ERROR(c->GetAttr("output_layout", &output_layout_string));
+      TF_ASSIGN_OR_RETURN(Layout input_layout,
+                          Layout::FromString(input_layout_string));
+      TF_ASSIGN_OR_RETURN(Layout output_layout,
+                          Layout::FromString(output_layout_string));
+      if (c->Rank(in) != input_layout.rank() ||
+          c->Rank(in) != output_layout.rank()) {
+        return errors::InvalidArgument(
+            "Input tensor rank and layout ranks do not agree: input rank ",
+            c->Rank(in), " input layout rank ", input_layout.rank(),
+            " output "
+            "layout rank ",
+            output_layout.rank());
+      }
+      const std::vector<int32> input_sharding = input_layout.num_shards();
+      const std::vector<int32> output_sharding = output_layout.num_shards();
+      std::vector<shape_inference::DimensionHandle> out_dims;
+      out_dims.reserve(c->Rank(in));
+      for (int32 i = 0; i < c->Rank(in); ++i) {
+        shape_inference::DimensionHandle dim = c->Dim(in, i);
+        if (!c->ValueKnown(dim) ||
+            input_layout.sharding_spec(i) == output_layout.sharding_spec(i)) {
+          out_dims.emplace_back(dim);
+        } else {
+          // Global size divided by the output sharding of this dimension.
+          shape_inference::DimensionHandle global_dim;
+          TF_RETURN_IF_ERROR(
+              c->Multiply(dim, input_sharding[i], &global_dim));
+          shape_inference::DimensionHandle out_dim;
+          TF_RETURN_IF_ERROR(c->Divide(global_dim, output_sharding[i],
+                                       /*evenly_divisible=*/true, &out_dim));
+          out_dims.push_back(out_dim);
+        }
+      }
+      c->set_output(0, c->MakeShape(out_dims));
+      return OkStatus();
+    });
+
 }  // namespace dtensor
 }  // namespace tensorflow
@@ -146,6 +146,42 @@ StatusOr<const mlir::Value> EmitAllScatter(
   return all_scatter.output();
 }
 
+StatusOr<mlir::Value> EmitAllToAll(
+    mlir::OpBuilder& builder, mlir::Value input,
+    const dtensor::Layout& src_layout, const dtensor::Layout& tgt_layout,
+    llvm::SmallPtrSet<mlir::Operation*, 4>* newly_created_ops) {
+  if (src_layout.IsEquivalent(tgt_layout)) return input;
+
+  if (src_layout.rank() != tgt_layout.rank()) {
+    return errors::InvalidArgument(
+        "Expected source and target layout to have the same rank, got ",
+        src_layout.rank(), " vs ", tgt_layout.rank());
+  }
+
+  const mlir::TensorType input_type =
+      input.getType().dyn_cast<mlir::TensorType>();
+  if (!input_type)
+    return errors::InvalidArgument(
+        "input to EmitAllToAll does not have a TensorType");
+
+  TF_ASSIGN_OR_RETURN(mlir::TensorType global_type,
+                      GlobalTypeFromLocalType(src_layout, input_type));
+  TF_ASSIGN_OR_RETURN(mlir::TensorType output_type,
+                      LocalTypeFromGlobalType(tgt_layout, global_type));
+
+  mlir::Location loc = DT_LOC2(input.getLoc(), "DTensorAllToAllOp");
+  mlir::TF::DTensorAllToAllOp all_to_all =
+      builder.create<mlir::TF::DTensorAllToAllOp>(
+          loc, output_type, input,
+          mlir::dtensor::LayoutAttr::get(builder.getContext(), src_layout),
+          mlir::dtensor::LayoutAttr::get(builder.getContext(), tgt_layout));
+  SetSingleLayoutOnOp(all_to_all, tgt_layout);
+
+  if (newly_created_ops != nullptr) newly_created_ops->insert(all_to_all);
+
+  return all_to_all.output();
+}
+
 StatusOr<mlir::Value> EmitDenseToSparseToDense(
     mlir::OpBuilder& builder, mlir::Value input,
     llvm::SmallPtrSet<mlir::Operation*, 4>* newly_created_ops) {
@@ -199,14 +235,19 @@ StatusOr<mlir::Value> EmitRelayout(
     mlir::Value input, const dtensor::Layout& src_layout,
     const dtensor::Layout& tgt_layout,
     llvm::SmallPtrSet<mlir::Operation*, 4>* newly_created_ops) {
-  // EmitRelayout is performed by doing a split, an AllGather and another split.
+  // EmitRelayout is performed by doing a split, a sequence of AllToAlls, an
+  // AllGather and another split.
   // The first split oppertunistically splits input tensor dimension i on mesh
   // mesh axis x if:
   // 1.  tgt_layout contains x at position i
   // 2.  src_layout is unsharded at position i.
   // 3.  src_layout does not contain mesh axis x.
   // This produces intermediate layout 1.
-  // Next an all concat is performed on any axis in the intermediate layout 1
+  // Next, every mesh axis x that is sharding dimension i in the current layout
+  // but dimension j in tgt_layout, where dimension j is currently unsharded,
+  // is moved from i to j with an AllToAll. Unlike gathering dimension i and
+  // splitting dimension j, this never holds more than one shard per device.
+  // Then an all concat is performed on any axis in the intermediate layout
   // that does not agree with the sharding on the output axis.
   // This produces intermediate layout 2.
   // A split is performed from intermediate layout 2 to the tgt layout.
@@ -254,6 +295,39 @@ StatusOr<mlir::Value> EmitRelayout(
                       EmitAllScatter(builder, input, src_layout,
                                      intermediate_layout_1, newly_created_ops));
 
+  // Move mesh axes between tensor dimensions with AllToAlls. Each exchange
+  // unshards a dimension, which may in turn free a mesh axis for a following
+  // exchange, so iterate until no more moves apply.
+  bool moved = true;
+  while (moved) {
+    moved = false;
+    for (int i = 0; i < src_layout.rank() && !moved; ++i) {
+      if (!Layout::IsShardedSpec(intermediate_specs_1[i]) ||
+          intermediate_specs_1[i].sharding_spec() ==
+              tgt_layout.sharding_spec(i))
+        continue;
+      for (int j = 0; j < src_layout.rank(); ++j) {
+        if (j == i || Layout::IsShardedSpec(intermediate_specs_1[j]) ||
+            tgt_layout.sharding_spec(j) !=
+                intermediate_specs_1[i].sharding_spec())
+          continue;
+        std::vector<ShardingSpec> moved_specs = intermediate_specs_1;
+        moved_specs[j] = intermediate_specs_1[i];
+        moved_specs[i].set_sharding_spec(Layout::kUnshardedDim);
+        TF_ASSIGN_OR_RETURN(Layout moved_layout,
+                            Layout::GetLayout(moved_specs, src_layout.mesh()));
+        TF_ASSIGN_OR_RETURN(
+            split_result,
+            EmitAllToAll(builder, split_result, intermediate_layout_1,
+                         moved_layout, newly_created_ops));
+        intermediate_specs_1 = std::move(moved_specs);
+        intermediate_layout_1 = std::move(moved_layout);
+        moved = true;
+        break;
+      }
+    }
+  }
+
   std::vector<ShardingSpec> intermediate_specs_2(src_layout.rank());
   for (int i = 0; i < src_layout.rank(); ++i) {
     if (Layout::IsShardedSpec(intermediate_specs_1[i]) &&
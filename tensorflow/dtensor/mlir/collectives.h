@@ -45,8 +45,20 @@ StatusOr<const mlir::Value> EmitAllScatter(
     const Layout& original_layout, const Layout& desired_layout,
     llvm::SmallPtrSet<mlir::Operation*, 4>* newly_created_ops = nullptr);
 
-// Emits splits and calls EmitAllGather (once) to relayout from the src layout
-// to the tgt layout on a single mesh.
+// Emits an all-to-all that moves a single mesh dimension from one tensor
+// dimension of `src_layout` to another (unsharded) tensor dimension of
+// `tgt_layout`. All other dimensions must agree. `input` must have static
+// shapes.
+StatusOr<mlir::Value> EmitAllToAll(
+    mlir::OpBuilder& builder, mlir::Value input,
+    const dtensor::Layout& src_layout, const dtensor::Layout& tgt_layout,
+    llvm::SmallPtrSet<mlir::Operation*, 4>* newly_created_ops = nullptr);
+
+// Emits splits, all-to-alls and calls EmitAllGather (once) to relayout from
+// the src layout to the tgt layout on a single mesh. Mesh dimensions that only
+// move between tensor dimensions are exchanged with all-to-alls so that no
+// device materializes more than its shards; only mesh dimensions that are
+// dropped entirely are gathered.
 // Shape of input is expected to be the local shape for src_layout.
 StatusOr<mlir::Value> EmitRelayout(
     mlir::Value input, const dtensor::Layout& src_layout,
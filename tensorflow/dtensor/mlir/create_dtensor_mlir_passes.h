@@ -117,6 +117,9 @@ CreateDTensorAllGatherLoweringPass();
 std::unique_ptr<mlir::OperationPass<mlir::ModuleOp>>
 CreateDTensorAllScatterLoweringPass();
 
+std::unique_ptr<mlir::OperationPass<mlir::ModuleOp>>
+CreateDTensorAllToAllLoweringPass();
+
 std::unique_ptr<mlir::OperationPass<mlir::ModuleOp>>
 CreateDTensorMergeClustersPass();
 
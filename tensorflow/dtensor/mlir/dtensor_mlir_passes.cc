@@ -176,6 +176,10 @@ void CreateDTensorMLIRPass(const mlir::TF::StandardPipelineOptions &options,
   // const only had one usage) as part of layout propagation.
   pm->addPass(mlir::createCSEPass());
 
+  // Lower the AllToAll collectives. This has to happen before AllGather and
+  // AllScatter lowering, as AllToAll may fall back to those on non-TPU meshes.
+  pm->addPass(CreateDTensorAllToAllLoweringPass());
+
   // Lower the AllGather collectives. This has to happen before the all reduce
   // optimizations and AllGather may emit an AllReduce.
   pm->addPass(CreateDTensorAllGatherLoweringPass());
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <cstdint>
 
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/FormatVariadic.h"
 #include "mlir/IR/BuiltinTypes.h"  // from @llvm-project
 #include "mlir/IR/MLIRContext.h"  // from @llvm-project
@@ -196,6 +197,79 @@ mlir::LogicalResult DTensorAllScatterOp::verify() {
   return mlir::success();
 }
 
+mlir::LogicalResult DTensorAllToAllOp::verify() {
+  DTensorAllToAllOp op = *this;
+  const tensorflow::dtensor::Layout input_layout = op.input_layout();
+  const tensorflow::dtensor::Layout output_layout = op.output_layout();
+
+  if (input_layout.rank() != output_layout.rank())
+    return op.emitOpError()
+           << "received input and output layouts of unequal ranks "
+           << input_layout.rank() << " and " << output_layout.rank();
+
+  // Exactly two tensor dimensions may differ: one that loses its mesh
+  // dimension and one that gains the same mesh dimension.
+  llvm::SmallVector<int32_t, 2> changed_dims;
+  for (int32_t i = 0; i < input_layout.rank(); ++i) {
+    if (input_layout.sharding_spec(i) != output_layout.sharding_spec(i))
+      changed_dims.push_back(i);
+  }
+  if (changed_dims.size() != 2)
+    return op.emitOpError() << "expected input and output layouts to differ in "
+                               "exactly two dimensions, got "
+                            << changed_dims.size();
+  const int32_t a = changed_dims[0];
+  const int32_t b = changed_dims[1];
+  const bool a_to_b =
+      tensorflow::dtensor::Layout::IsUnshardedDimension(
+          output_layout.sharding_spec(a)) &&
+      tensorflow::dtensor::Layout::IsUnshardedDimension(
+          input_layout.sharding_spec(b)) &&
+      input_layout.sharding_spec(a) == output_layout.sharding_spec(b);
+  const bool b_to_a =
+      tensorflow::dtensor::Layout::IsUnshardedDimension(
+          output_layout.sharding_spec(b)) &&
+      tensorflow::dtensor::Layout::IsUnshardedDimension(
+          input_layout.sharding_spec(a)) &&
+      input_layout.sharding_spec(b) == output_layout.sharding_spec(a);
+  if (!a_to_b && !b_to_a)
+    return op.emitOpError()
+           << "dimensions " << a << " and " << b
+           << " must exchange a single mesh dimension, got input specs "
+           << input_layout.sharding_spec(a) << ", "
+           << input_layout.sharding_spec(b) << " and output specs "
+           << output_layout.sharding_spec(a) << ", "
+           << output_layout.sharding_spec(b);
+
+  RankedTensorType input_type =
+      op.input().getType().dyn_cast<RankedTensorType>();
+  if (!input_type) return mlir::success();
+
+  if (input_type.getRank() != input_layout.rank())
+    return op.emitOpError()
+           << "input layout rank " << input_layout.rank()
+           << " is not equal to input rank " << input_type.getRank();
+
+  RankedTensorType output_type =
+      op.output().getType().dyn_cast<RankedTensorType>();
+  if (!output_type) return mlir::success();
+
+  std::vector<int64_t> computed_output_shape =
+      output_layout.LocalShapeFromGlobalShape(
+          input_layout.GlobalShapeFromLocalShape(input_type.getShape()));
+
+  for (int32_t i = 0; i < computed_output_shape.size(); ++i) {
+    if (computed_output_shape[i] != output_type.getShape()[i]) {
+      return op.emitOpError()
+             << "computed output shape " << computed_output_shape[i]
+             << " at dimension " << i << " is not equal to actual output shape "
+             << output_type.getShape()[i];
+    }
+  }
+
+  return mlir::success();
+}
+
 LogicalResult DTensorLayout::inferReturnTypes(
     MLIRContext* context, Optional<Location> location, ValueRange operands,
     DictionaryAttr attributes, RegionRange regions,
@@ -39,6 +39,7 @@ limitations under the License.
 #include "tensorflow/dtensor/cc/constants.h"
 #include "tensorflow/dtensor/cc/dstatus.h"
 #include "tensorflow/dtensor/cc/dtensor_utils.h"
+#include "tensorflow/dtensor/mlir/collectives.h"
 #include "tensorflow/dtensor/mlir/collectives_common.h"
 #include "tensorflow/dtensor/mlir/device_utils.h"
 #include "tensorflow/dtensor/mlir/dtensor_dialect/ir/dialect.h"
@@ -58,6 +59,7 @@ namespace {
 #define GEN_PASS_DEF_DTENSORREDUCESCATTERLOWERING
 #define GEN_PASS_DEF_DTENSORALLGATHERLOWERING
 #define GEN_PASS_DEF_DTENSORALLSCATTERLOWERING
+#define GEN_PASS_DEF_DTENSORALLTOALLLOWERING
 #include "tensorflow/dtensor/mlir/dtensor_passes.h.inc"
 
 namespace ops_util = ::mlir::TF::collection_ops_util;
@@ -726,6 +728,96 @@ mlir::LogicalResult LowerAllScatterOp(
   return mlir::LogicalResult::success();
 }
 
+mlir::LogicalResult LowerAllToAllOp(mlir::TF::DTensorAllToAllOp all_to_all) {
+  const Layout src_layout = all_to_all.input_layout();
+  const Layout tgt_layout = all_to_all.output_layout();
+
+  // The verifier guarantees a single mesh dimension moving from `concat_dim`
+  // (sharded in the input) to `split_dim` (sharded in the output).
+  int64 concat_dim = -1;
+  int64 split_dim = -1;
+  for (int64 i = 0; i < src_layout.rank(); ++i) {
+    if (src_layout.sharding_spec(i) == tgt_layout.sharding_spec(i)) continue;
+    if (Layout::IsUnshardedDimension(tgt_layout.sharding_spec(i)))
+      concat_dim = i;
+    else
+      split_dim = i;
+  }
+  if (concat_dim < 0 || split_dim < 0)
+    return all_to_all.emitOpError()
+           << "could not find the exchanged dimensions between "
+           << src_layout.ToString() << " and " << tgt_layout.ToString();
+
+  mlir::OpBuilder builder(all_to_all);
+  const mlir::Location loc = DT_LOC(all_to_all.getLoc());
+
+  if (!src_layout.mesh().is_tpu_mesh()) {
+    // There is no host all-to-all collective available to DTensor, so fall
+    // back to gathering `concat_dim` and slicing `split_dim`. The gather only
+    // spans the moved mesh dimension, so peak memory is one shard times that
+    // dimension's size rather than the whole tensor.
+    std::vector<ShardingSpec> gathered_specs(
+        src_layout.sharding_specs().begin(), src_layout.sharding_specs().end());
+    gathered_specs[concat_dim].set_sharding_spec(Layout::kUnshardedDim);
+    StatusOr<Layout> gathered_layout =
+        Layout::GetLayout(gathered_specs, src_layout.mesh());
+    if (!gathered_layout.ok())
+      return all_to_all.emitOpError()
+             << gathered_layout.status().error_message();
+    StatusOr<mlir::Value> gathered = EmitAllGather(
+        builder, all_to_all.input(), src_layout, gathered_layout.value());
+    if (!gathered.ok())
+      return all_to_all.emitOpError() << gathered.status().error_message();
+    StatusOr<const mlir::Value> scattered = EmitAllScatter(
+        builder, gathered.value(), gathered_layout.value(), tgt_layout);
+    if (!scattered.ok())
+      return all_to_all.emitOpError() << scattered.status().error_message();
+
+    all_to_all.output().replaceAllUsesWith(scattered.value());
+    all_to_all.erase();
+    return mlir::success();
+  }
+
+  absl::flat_hash_set<std::string> exchanged_dims;
+  exchanged_dims.insert(src_layout.sharding_spec(concat_dim));
+  auto partitions_or_status =
+      GetAllReducePartitionsFromReducedDims(src_layout, exchanged_dims);
+  if (!partitions_or_status.ok())
+    return all_to_all.emitOpError()
+           << partitions_or_status.status().error_message();
+  auto partitions = partitions_or_status.value();
+
+  // Devices within a partition are ordered by their coordinate along the
+  // exchanged mesh dimension, which is the block order AllToAll expects.
+  std::vector<int32> partitions_flat;
+  for (auto& p : partitions) {
+    if (p.second.size() != partitions.begin()->second.size())
+      return all_to_all.emitOpError() << "partitions had different sizes -- "
+                                         "this is not supported in MLIR.";
+    partitions_flat.insert(partitions_flat.end(), p.second.begin(),
+                           p.second.end());
+  }
+  const int32 num_partitions = partitions.size();
+  const int32 partition_size = partitions.begin()->second.size();
+  const mlir::RankedTensorType shaped_type = mlir::RankedTensorType::get(
+      {num_partitions, partition_size},
+      mlir::IntegerType::get(builder.getContext(), 32));
+  const mlir::DenseIntElementsAttr group_assignment =
+      mlir::DenseIntElementsAttr::get(shaped_type, partitions_flat);
+
+  mlir::TF::AllToAllOp result = builder.create<mlir::TF::AllToAllOp>(
+      loc, all_to_all.output().getType(), all_to_all.input(),
+      builder.create<mlir::TF::ConstOp>(loc, group_assignment),
+      builder.getI64IntegerAttr(concat_dim),
+      builder.getI64IntegerAttr(split_dim),
+      builder.getI64IntegerAttr(partition_size));
+  SetSingleLayoutOnOp(result, tgt_layout);
+
+  all_to_all.output().replaceAllUsesWith(result.output());
+  all_to_all.erase();
+  return mlir::success();
+}
+
 struct DTensorAllReduceLowering
     : public impl::DTensorAllReduceLoweringBase<DTensorAllReduceLowering> {
   void runOnOperation() override {
@@ -802,6 +894,23 @@ struct DTensorAllScatterLowering
   }
 };
 
+struct DTensorAllToAllLowering
+    : public impl::DTensorAllToAllLoweringBase<DTensorAllToAllLowering> {
+  void runOnOperation() override {
+    mlir::ModuleOp module = getOperation();
+
+    // Process all DTensorAllToAll ops.
+    llvm::SmallVector<mlir::TF::DTensorAllToAllOp, 4> all_to_alls;
+    module.walk([&](mlir::TF::DTensorAllToAllOp all_to_all) {
+      all_to_alls.emplace_back(all_to_all);
+    });
+
+    for (mlir::TF::DTensorAllToAllOp all_to_all : all_to_alls)
+      if (mlir::failed(LowerAllToAllOp(all_to_all)))
+        return signalPassFailure();
+  }
+};
+
 }  // namespace
 
 std::unique_ptr<mlir::OperationPass<mlir::ModuleOp>>
@@ -824,5 +933,10 @@ CreateDTensorAllScatterLoweringPass() {
   return std::make_unique<DTensorAllScatterLowering>();
 }
 
+std::unique_ptr<mlir::OperationPass<mlir::ModuleOp>>
+CreateDTensorAllToAllLoweringPass() {
+  return std::make_unique<DTensorAllToAllLowering>();
+}
+
 }  // namespace dtensor
 }  // namespace tensorflow
@@ -64,10 +64,20 @@ std::intptr_t ArenaPlanner::BasePointer(TfLiteAllocationType type) {
 }
 
 TfLiteStatus ArenaPlanner::ResetAllocations() {
+  // Added by Alpa. The current allocations become the plan of the next ones,
+  // so that tensors resized within the size they were planned with keep their
+  // offsets instead of being planned again. A plan set since the last
+  // allocations takes precedence over them.
+  if (!offline_plan_is_set_ && HasArenaAllocations() &&
+      GetOfflinePlan(&offline_plan_) != kTfLiteOk) {
+    offline_plan_.clear();
+  }
+  offline_plan_is_set_ = false;
   TF_LITE_ENSURE_STATUS(arena_.ClearPlan());
   TF_LITE_ENSURE_STATUS(persistent_arena_.ClearPlan());
   allocs_.clear();
   allocs_.resize(graph_info_->num_tensors());
+  use_offline_plan_ = !offline_plan_.empty();  // Added by Alpa.
   // NOMUTANTS -- Setting last_active_node_ to kLastActiveNodeUndefined causes
   // all allocs to be cleared. if this is not set, the slow path is taken
   // (Purge) which inspects each alloc. Both paths give the exact same result.
@@ -283,6 +293,16 @@ bool ArenaPlanner::HasNonPersistentMemory() {
   return arena_.GetBufferSize() != 0;
 }
 
+TfLiteStatus ArenaPlanner::RefreshNonPersistentMemory() {
+  if (!arena_.IsSharedBufferStale()) return kTfLiteOk;
+  return AcquireNonPersistentMemory();
+}
+
+TfLiteStatus ArenaPlanner::SetSharedArenaBuffer(
+    std::shared_ptr<SharedArenaBuffer> buffer) {
+  return arena_.SetSharedBuffer(context_, std::move(buffer));
+}
+
 void ArenaPlanner::DumpDebugInfo(const std::vector<int>& execution_plan) const {
   arena_.DumpDebugInfo("kTfLiteArenaRw Dump:", execution_plan);
   persistent_arena_.DumpDebugInfo("kTfLiteArenaRwPersistent Dump:",
@@ -383,15 +403,30 @@ TfLiteStatus ArenaPlanner::CalculateAllocations(
     // exection faster.
     arena_.PurgeActiveAllocs(first_node);
   }
-  CreateTensorAllocationVector(tensors_allocated);
+  // Added by Alpa. Tensors placed by the offline plan need neither sorting nor
+  // searching for gaps.
+  if (use_offline_plan_ && !FitsOfflinePlan(*tensors_allocated)) {
+    use_offline_plan_ = false;
+  }
+  if (!use_offline_plan_) CreateTensorAllocationVector(tensors_allocated);
   // Vector of ids of already allocated tensors, ordered by offset.
   for (const auto& tensor_index : *tensors_allocated) {
     TfLiteTensor& tensor = tensors[tensor_index];
-    if (tensor.allocation_type == kTfLiteArenaRw) {
-      TF_LITE_ENSURE_STATUS(
-          arena_.Allocate(context_, tensor_alignment_, tensor.bytes,
-                          tensor_index, alloc_node_[tensor_index],
-                          dealloc_node_[tensor_index], &allocs_[tensor_index]));
+    if (tensor.allocation_type == kTfLiteArenaRw && use_offline_plan_) {
+      // The planned size is reserved, so that the tensor may grow up to it.
+      TF_LITE_ENSURE_STATUS(arena_.AllocateAt(
+          context_, offline_plan_[4 * tensor_index],
+          offline_plan_[4 * tensor_index + 1], tensor_index,
+          FirstConcurrentNode(alloc_node_[tensor_index]),
+          LastConcurrentNode(dealloc_node_[tensor_index]),
+          &allocs_[tensor_index]));
+    } else if (tensor.allocation_type == kTfLiteArenaRw) {
+      // Added by Alpa. The tensors of concurrent nodes must not overlap.
+      TF_LITE_ENSURE_STATUS(arena_.Allocate(
+          context_, tensor_alignment_, tensor.bytes, tensor_index,
+          FirstConcurrentNode(alloc_node_[tensor_index]),
+          LastConcurrentNode(dealloc_node_[tensor_index]),
+          &allocs_[tensor_index]));
     }
     // Check allocs_[].size to prevent from reallocation of persistent tensors.
     if (tensor.allocation_type == kTfLiteArenaRwPersistent &&
@@ -409,6 +444,91 @@ TfLiteStatus ArenaPlanner::CalculateAllocations(
   return kTfLiteOk;
 }
 
+bool ArenaPlanner::FitsOfflinePlan(
+    const std::vector<int32_t>& tensors_to_allocate) const {
+  const TfLiteTensor* tensors = graph_info_->tensors();
+  for (int32_t tensor_index : tensors_to_allocate) {
+    const TfLiteTensor& tensor = tensors[tensor_index];
+    if (tensor.allocation_type != kTfLiteArenaRw || tensor.bytes == 0) {
+      continue;
+    }
+    if (4 * static_cast<size_t>(tensor_index) >= offline_plan_.size()) {
+      return false;
+    }
+    const int32_t* planned = &offline_plan_[4 * tensor_index];
+    if (planned[0] < 0 || planned[0] % tensor_alignment_ != 0 ||
+        static_cast<size_t>(planned[1]) < tensor.bytes ||
+        planned[2] != FirstConcurrentNode(alloc_node_[tensor_index]) ||
+        planned[3] != LastConcurrentNode(dealloc_node_[tensor_index])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ArenaPlanner::HasArenaAllocations() const {
+  const TfLiteTensor* tensors = graph_info_->tensors();
+  for (size_t i = 0; i < allocs_.size(); ++i) {
+    if (tensors[i].allocation_type == kTfLiteArenaRw && allocs_[i].size > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+TfLiteStatus ArenaPlanner::SetOfflinePlan(std::vector<int32_t> plan) {
+  TF_LITE_ENSURE_EQ(context_, plan.size() % 4, 0);
+  offline_plan_ = std::move(plan);
+  offline_plan_is_set_ = true;
+  return kTfLiteOk;
+}
+
+TfLiteStatus ArenaPlanner::GetOfflinePlan(std::vector<int32_t>* plan) const {
+  const TfLiteTensor* tensors = graph_info_->tensors();
+  plan->assign(4 * allocs_.size(), 0);
+  for (size_t i = 0; i < allocs_.size(); ++i) {
+    const ArenaAllocWithUsageInterval& alloc = allocs_[i];
+    int32_t* planned = &(*plan)[4 * i];
+    if (tensors[i].allocation_type != kTfLiteArenaRw || alloc.size == 0) {
+      planned[0] = -1;
+      continue;
+    }
+    TF_LITE_ENSURE(context_, alloc.offset + alloc.size <=
+                                 std::numeric_limits<int32_t>::max());
+    planned[0] = alloc.offset;
+    planned[1] = alloc.size;
+    planned[2] = alloc.first_node;
+    planned[3] = alloc.last_node;
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus ArenaPlanner::SetExecutionWaves(const std::vector<int>& waves) {
+  const int num_nodes = waves.size();
+  wave_first_node_.resize(num_nodes);
+  wave_last_node_.resize(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    wave_first_node_[i] =
+        i > 0 && waves[i] == waves[i - 1] ? wave_first_node_[i - 1] : i;
+  }
+  for (int i = num_nodes - 1; i >= 0; --i) {
+    wave_last_node_[i] = i + 1 < num_nodes && waves[i] == waves[i + 1]
+                             ? wave_last_node_[i + 1]
+                             : i;
+  }
+  return kTfLiteOk;
+}
+
+int32_t ArenaPlanner::FirstConcurrentNode(int32_t node) const {
+  if (node < 0 || node >= wave_first_node_.size()) return node;
+  return wave_first_node_[node];
+}
+
+int32_t ArenaPlanner::LastConcurrentNode(int32_t node) const {
+  if (node < 0 || node >= wave_last_node_.size()) return node;
+  return wave_last_node_[node];
+}
+
 TfLiteStatus ArenaPlanner::ResolveTensorAllocation(int32_t tensor_index,
                                                    TfLiteTensor& tensor) {
   if (tensor.allocation_type == kTfLiteArenaRw) {
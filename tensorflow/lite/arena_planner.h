@@ -64,6 +64,15 @@ class ArenaPlanner : public MemoryPlanner {
   TfLiteStatus ReleaseNonPersistentMemory() override;
   TfLiteStatus AcquireNonPersistentMemory() override;
   bool HasNonPersistentMemory() override;
+  TfLiteStatus RefreshNonPersistentMemory() override;
+  TfLiteStatus SetOfflinePlan(std::vector<int32_t> plan) override;
+  TfLiteStatus GetOfflinePlan(std::vector<int32_t>* plan) const override;
+  TfLiteStatus SetExecutionWaves(const std::vector<int>& waves) override;
+
+  // Added by Alpa. Makes the non-persistent arena use `buffer`, shared with
+  // the planners of interpreters that never run concurrently with this one.
+  // Must be called before any allocation is executed.
+  TfLiteStatus SetSharedArenaBuffer(std::shared_ptr<SharedArenaBuffer> buffer);
   void DumpDebugInfo(const std::vector<int>& execution_plan) const override;
   void GetAllocInfo(size_t* arena_size,
                     size_t* arena_persist_size) const override;
@@ -93,6 +102,19 @@ class ArenaPlanner : public MemoryPlanner {
   TfLiteStatus CalculateAllocations(int first_node, int last_node,
                                     std::vector<int32_t>* tensors_allocated);
 
+  // Added by Alpa. Returns true if the offline plan places all the
+  // non-persistent tensors of `tensors_to_allocate` with their current sizes
+  // and usage intervals.
+  bool FitsOfflinePlan(const std::vector<int32_t>& tensors_to_allocate) const;
+
+  // Added by Alpa. Returns the first and last nodes of the execution wave of
+  // `node`, or `node` if it is not in a wave.
+  int32_t FirstConcurrentNode(int32_t node) const;
+  int32_t LastConcurrentNode(int32_t node) const;
+
+  // Added by Alpa. Returns true if any non-persistent tensor is allocated.
+  bool HasArenaAllocations() const;
+
   // Assign absolute memory location to a tensor, based on its relative
   // position inside the corresponding arena buffer.
   TfLiteStatus ResolveTensorAllocation(int32_t tensor_index,
@@ -142,6 +164,21 @@ class ArenaPlanner : public MemoryPlanner {
 
   // Index of the last node whose tensors were allocated.
   int last_active_node_;
+
+  // Added by Alpa. The offline plan, see SetOfflinePlan(), or the previous
+  // allocations, and whether it is used by the current allocations. Once a
+  // tensor does not fit the plan, all later ones are planned online, taking
+  // the tensors already placed by the plan into account.
+  std::vector<int32_t> offline_plan_;
+  bool use_offline_plan_ = false;
+  // Whether `offline_plan_` was set by SetOfflinePlan() since the last
+  // ResetAllocations(), which then keeps it instead of the allocations.
+  bool offline_plan_is_set_ = false;
+
+  // Added by Alpa. The first and last nodes of the execution wave of each
+  // node, see SetExecutionWaves().
+  std::vector<int32_t> wave_first_node_;
+  std::vector<int32_t> wave_last_node_;
 };
 
 }  // namespace tflite
@@ -837,5 +837,104 @@ TEST_F(ArenaPlannerTest, SimpleProfilerTest) {
   EXPECT_EQ(gNumDealloc, 2);
 }
 
+TEST_F(ArenaPlannerTest, OfflinePlan) {
+  TestGraph graph({0, 1},
+                  {
+                      /* in, out, tmp */
+                      {{0, 1}, {2}, {}},     // First op
+                      {{2, 0}, {4, 5}, {}},  // Second op
+                      {{4, 5}, {3}, {}}      // Third op
+                  },
+                  {3});
+  SetGraph(&graph);
+  Execute(0, graph.nodes().size() - 1);
+  std::vector<int32_t> plan;
+  ASSERT_EQ(planner_->GetOfflinePlan(&plan), kTfLiteOk);
+  ASSERT_EQ(plan.size(), 4 * graph.tensors()->size());
+  EXPECT_EQ(plan[4 * 5], GetOffset(5));
+  EXPECT_EQ(plan[4 * 5 + 1], (*graph.tensors())[5].bytes);
+
+  // The tensors are placed where the plan says, rather than where the planner
+  // would place them.
+  plan[4 * 5] = 1024;
+  SetGraph(&graph);
+  ASSERT_EQ(planner_->SetOfflinePlan(plan), kTfLiteOk);
+  ResetAllocations();
+  Execute(0, graph.nodes().size() - 1);
+  EXPECT_EQ(GetOffset(5), 1024);
+  EXPECT_EQ(GetOffset(1), 4);
+
+  // Tensors no longer fitting the plan are planned online.
+  (*graph.tensors())[5].bytes = plan[4 * 5 + 1] + 1;
+  ResetAllocations();
+  Execute(0, graph.nodes().size() - 1);
+  EXPECT_NE(GetOffset(5), 1024);
+}
+
+TEST_F(ArenaPlannerTest, ResizeWithinPlannedSizes) {
+  TestGraph graph({0, 1},
+                  {
+                      /* in, out, tmp */
+                      {{0, 1}, {2}, {}},     // First op
+                      {{2, 0}, {4, 5}, {}},  // Second op
+                      {{4, 5}, {3}, {}}      // Third op
+                  },
+                  {3});
+  SetGraph(&graph);
+  Execute(0, graph.nodes().size() - 1);
+  std::vector<std::ptrdiff_t> offsets;
+  for (int i = 0; i < graph.tensors()->size(); ++i) {
+    offsets.push_back(GetOffset(i));
+  }
+
+  // Shrunk tensors keep their offsets.
+  (*graph.tensors())[5].bytes = 1;
+  ResetAllocations();
+  Execute(0, graph.nodes().size() - 1);
+  for (int i = 0; i < graph.tensors()->size(); ++i) {
+    EXPECT_EQ(GetOffset(i), offsets[i]);
+  }
+
+  // And may grow back to their planned sizes.
+  (*graph.tensors())[5].bytes = 18;
+  ResetAllocations();
+  Execute(0, graph.nodes().size() - 1);
+  for (int i = 0; i < graph.tensors()->size(); ++i) {
+    EXPECT_EQ(GetOffset(i), offsets[i]);
+  }
+
+  // Larger tensors are planned again.
+  (*graph.tensors())[5].bytes = 40;
+  ResetAllocations();
+  Execute(0, graph.nodes().size() - 1);
+  EXPECT_EQ(GetOffset(5), 12);
+  EXPECT_EQ(GetOffset(4), GetOffsetAfter(5));
+}
+
+TEST_F(ArenaPlannerTest, ExecutionWaves) {
+  TestGraph graph({0},
+                  {
+                      /* in, out, tmp */
+                      {{0}, {4}, {}},    // First op
+                      {{4}, {2}, {}},    // Second op
+                      {{0}, {3}, {}},    // Third op
+                      {{2, 3}, {1}, {}}  // Fourth op
+                  },
+                  {1});
+  SetGraph(&graph);
+  Execute(0, graph.nodes().size() - 1);
+  // Run sequentially, the third op reuses the output of the first one.
+  EXPECT_EQ(GetOffset(3), GetOffset(4));
+
+  // Run concurrently, the second and third ops use distinct buffers.
+  ASSERT_EQ(planner_->SetExecutionWaves({0, 1, 1, 2}), kTfLiteOk);
+  ResetAllocations();
+  Execute(0, graph.nodes().size() - 1);
+  EXPECT_TRUE(GetOffset(3) >= GetOffsetAfter(4) ||
+              GetOffset(4) >= GetOffsetAfter(3));
+  EXPECT_TRUE(GetOffset(3) >= GetOffsetAfter(2) ||
+              GetOffset(2) >= GetOffsetAfter(3));
+}
+
 }  // namespace
 }  // namespace tflite
@@ -0,0 +1,31 @@
+// This file contains the implementation of ConstantBufferCache.
+
+#include "tensorflow/lite/constant_buffer_cache.h"
+
+#include <string.h>
+
+#include <functional>
+#include <string_view>
+
+namespace tflite {
+
+void ConstantBufferCache::Deduplicate(const char** data, size_t size,
+                                      const Allocation** allocation) {
+  if (*data == nullptr || size < kMinBufferSize) return;
+  const size_t hash =
+      std::hash<std::string_view>()(std::string_view(*data, size));
+  auto range = buffers_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    const Buffer& buffer = it->second;
+    if (buffer.data == *data) return;
+    if (buffer.size == size && memcmp(buffer.data, *data, size) == 0) {
+      *data = buffer.data;
+      *allocation = buffer.allocation;
+      deduplicated_bytes_ += size;
+      return;
+    }
+  }
+  buffers_.emplace(hash, Buffer{*data, size, *allocation});
+}
+
+}  // namespace tflite
@@ -0,0 +1,51 @@
+// This file contains ConstantBufferCache, which deduplicates the identical
+// constant buffers of the models loaded into several interpreters, e.g. the
+// shared backbone weights of models with different heads.
+
+#ifndef TENSORFLOW_LITE_CONSTANT_BUFFER_CACHE_H_
+#define TENSORFLOW_LITE_CONSTANT_BUFFER_CACHE_H_
+
+#include <stddef.h>
+
+#include <unordered_map>
+
+#include "tensorflow/lite/allocation.h"
+
+namespace tflite {
+
+// Maps the content of constant tensor buffers to the first buffer seen with
+// that content, so that the read-only tensors of later models point to the
+// buffers of the first model and the pages of their own copies are never
+// touched again. The buffers are not owned: the models whose tensors were
+// added must outlive the cache and all the interpreters built with it. Not
+// thread-safe.
+class ConstantBufferCache {
+ public:
+  // Buffers smaller than this are not deduplicated, since they share their
+  // pages with other data anyway.
+  static constexpr size_t kMinBufferSize = 4096;
+
+  // Replaces `*data` and `*allocation` with those of the first buffer added
+  // with the same `size` bytes of content, or adds the buffer if there is
+  // none.
+  void Deduplicate(const char** data, size_t size,
+                   const Allocation** allocation);
+
+  // Number of bytes of the buffers replaced by a cached one.
+  size_t deduplicated_bytes() const { return deduplicated_bytes_; }
+
+ private:
+  struct Buffer {
+    const char* data;
+    size_t size;
+    const Allocation* allocation;
+  };
+
+  // Buffers by hash of their content.
+  std::unordered_multimap<size_t, Buffer> buffers_;
+  size_t deduplicated_bytes_ = 0;
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_CONSTANT_BUFFER_CACHE_H_
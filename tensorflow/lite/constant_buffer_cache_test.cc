@@ -0,0 +1,52 @@
+#include "tensorflow/lite/constant_buffer_cache.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace tflite {
+namespace {
+
+constexpr size_t kSize = ConstantBufferCache::kMinBufferSize;
+
+TEST(ConstantBufferCacheTest, DeduplicatesIdenticalBuffers) {
+  ConstantBufferCache cache;
+  const std::vector<char> first(kSize, 1);
+  const std::vector<char> second(kSize, 1);
+  const std::vector<char> other(kSize, 2);
+  const Allocation* first_allocation =
+      reinterpret_cast<const Allocation*>(&first);
+
+  const char* data = first.data();
+  const Allocation* allocation = first_allocation;
+  cache.Deduplicate(&data, kSize, &allocation);
+  EXPECT_EQ(data, first.data());
+
+  data = second.data();
+  allocation = nullptr;
+  cache.Deduplicate(&data, kSize, &allocation);
+  EXPECT_EQ(data, first.data());
+  EXPECT_EQ(allocation, first_allocation);
+
+  data = other.data();
+  cache.Deduplicate(&data, kSize, &allocation);
+  EXPECT_EQ(data, other.data());
+  EXPECT_EQ(cache.deduplicated_bytes(), kSize);
+}
+
+TEST(ConstantBufferCacheTest, SkipsSmallBuffers) {
+  ConstantBufferCache cache;
+  const std::vector<char> first(kSize - 1, 1);
+  const std::vector<char> second(kSize - 1, 1);
+
+  const char* data = first.data();
+  const Allocation* allocation = nullptr;
+  cache.Deduplicate(&data, first.size(), &allocation);
+  data = second.data();
+  cache.Deduplicate(&data, second.size(), &allocation);
+  EXPECT_EQ(data, second.data());
+  EXPECT_EQ(cache.deduplicated_bytes(), 0);
+}
+
+}  // namespace
+}  // namespace tflite
@@ -593,6 +593,8 @@ class Interpreter {
   /// 2. Set the buffer handle to a tensor that uses the same delegate.
   ///    For example, set an OpenGL texture as the output of inference, while
   ///    the node which produces output is an OpenGL delegate node.
+  /// The handle bound to the tensor before is released, unless it is
+  /// `buffer_handle` itself, so the same buffer may be bound for every frame.
   /// WARNING: This is an experimental API and subject to change.
   TfLiteStatus SetBufferHandle(int tensor_index,
                                TfLiteBufferHandle buffer_handle,
@@ -40,9 +40,11 @@ limitations under the License.
 #include "tensorflow/lite/core/macros.h"
 #include "tensorflow/lite/experimental/remat/metadata_util.h"
 #include "tensorflow/lite/experimental/resource/resource_base.h"
+#include "tensorflow/lite/external_cpu_backend_context.h"
 #include "tensorflow/lite/graph_info.h"
 #include "tensorflow/lite/memory_planner.h"
 #include "tensorflow/lite/minimal_logging.h"
+#include "tensorflow/lite/parallel_task_runner.h"
 #include "tensorflow/lite/schema/schema_generated.h"
 #include "tensorflow/lite/util.h"
 #ifdef TFLITE_USE_SIMPLE_MEMORY_PLANNER
@@ -76,6 +78,10 @@ struct TfLiteSparsityDeleter {
 using ScopedTfLiteSparsity =
     std::unique_ptr<TfLiteSparsity, TfLiteSparsityDeleter>;
 
+// Added by Alpa. The CPU backend context of the thread running the current
+// node of a parallel wave, see Subgraph::InvokeInParallel().
+thread_local TfLiteExternalContext* parallel_cpu_backend_context = nullptr;
+
 TfLiteStatus ReportOpError(TfLiteContext* context, const TfLiteNode& node,
                            const TfLiteRegistration& registration,
                            int node_index, const char* message) {
@@ -488,6 +494,11 @@ TfLiteStatus Subgraph::ReplaceNodeSubsetsWithDelegateKernels(
 
 TfLiteExternalContext* Subgraph::GetExternalContext(
     TfLiteExternalContextType type) {
+  // Added by Alpa. Concurrent nodes do not share the CPU backend context.
+  if (type == kTfLiteCpuBackendContext &&
+      parallel_cpu_backend_context != nullptr) {
+    return parallel_cpu_backend_context;
+  }
   if (static_cast<int>(type) >= 0 && type < kTfLiteMaxExternalContexts) {
     return external_contexts_[type];
   }
@@ -657,6 +668,25 @@ TfLiteStatus Subgraph::EnsureTensorDataIsReadable(int tensor_index) {
   return status;
 }
 
+TfLiteStatus Subgraph::SetBufferHandle(int tensor_index,
+                                       TfLiteBufferHandle buffer_handle,
+                                       TfLiteDelegate* delegate) {
+  TF_LITE_ENSURE(&context_,
+                 tensor_index >= 0 && tensor_index < tensors_size());
+  TfLiteTensor* tensor = &tensors_[tensor_index];
+  TF_LITE_ENSURE(&context_,
+                 tensor->delegate == nullptr || tensor->delegate == delegate);
+  tensor->delegate = delegate;
+  // Rebinding the same handle, e.g. for every frame, keeps it registered.
+  if (tensor->buffer_handle != kTfLiteNullBufferHandle &&
+      tensor->buffer_handle != buffer_handle) {
+    TF_LITE_ENSURE_STATUS(TfLiteDelegateFreeBufferHandleInternal(
+        &context_, tensor->delegate, &(tensor->buffer_handle)));
+  }
+  tensor->buffer_handle = buffer_handle;
+  return kTfLiteOk;
+}
+
 bool Subgraph::IsCancelled() {
   return (check_cancelled_func_ != nullptr) &&
          (*check_cancelled_func_)(cancellation_data_);
@@ -758,6 +788,10 @@ TfLiteStatus Subgraph::AllocateTensors() {
     if (memory_planner_ && !memory_planner_->HasNonPersistentMemory()) {
       memory_planner_->AcquireNonPersistentMemory();
     }
+    // Added by Alpa. Pick up the shared arena buffer if it was replaced.
+    if (memory_planner_) {
+      TF_LITE_ENSURE_STATUS(memory_planner_->RefreshNonPersistentMemory());
+    }
     // Check custom allocations, which may have been modified since last
     // AllocateTensors() call.
     if (!custom_allocations_.empty()) {
@@ -779,6 +813,7 @@ TfLiteStatus Subgraph::AllocateTensors() {
   next_execution_plan_index_to_prepare_ = 0;
   next_execution_plan_index_to_plan_allocation_ = 0;
   next_original_execution_plan_index_to_prepare_ = 0;
+  TF_LITE_ENSURE_STATUS(PlanParallelExecution());
   if (memory_planner_) {
     TF_LITE_ENSURE_STATUS(memory_planner_->ResetAllocations());
   }
@@ -892,6 +927,21 @@ TfLiteStatus Subgraph::AddNodeWithParameters(
 }
 
 namespace {
+// Added by Alpa. Returns true if any tensor identified by indexes in
+// 'tensor_indexes' is a variable or of type 'kTfLiteVariant', i.e. may be
+// updated by ops that do not output it.
+bool AnyTensorVariableOrVariant(const std::vector<TfLiteTensor>& tensors,
+                                const TfLiteIntArray* tensor_indexes) {
+  for (int i = 0; i < tensor_indexes->size; ++i) {
+    int tensor_index = tensor_indexes->data[i];
+    if (tensor_index >= 0 && tensor_index < tensors.size() &&
+        (tensors[tensor_index].is_variable ||
+         tensors[tensor_index].type == kTfLiteVariant))
+      return true;
+  }
+  return false;
+}
+
 // Returns true if any tensor identified by indexes in 'tensor_indexes' is
 // of type 'kTfLiteResource'. False otherwise.
 bool AnyTensorOfTypeResource(const std::vector<TfLiteTensor>& tensors,
@@ -984,6 +1034,22 @@ TfLiteStatus Subgraph::ResizeInputTensorStrict(int tensor_index,
   return ResizeInputTensor(tensor_index, dims);
 }
 
+TfLiteStatus Subgraph::SetOfflineMemoryPlan(std::vector<int32_t> plan) {
+  offline_memory_plan_ = std::move(plan);
+  if (memory_planner_) {
+    return memory_planner_->SetOfflinePlan(offline_memory_plan_);
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus Subgraph::GetOfflineMemoryPlan(std::vector<int32_t>* plan) {
+  if (!memory_planner_) {
+    ReportError("GetOfflineMemoryPlan called before AllocateTensors.");
+    return kTfLiteError;
+  }
+  return memory_planner_->GetOfflinePlan(plan);
+}
+
 TfLiteStatus Subgraph::ReleaseNonPersistentMemory() {
   state_ = kStateUninvokable;
   if (memory_planner_) {
@@ -1157,10 +1223,24 @@ TfLiteStatus Subgraph::PrepareOpsAndTensors() {
 #ifdef TFLITE_USE_SIMPLE_MEMORY_PLANNER
     memory_planner_.reset(new SimplePlanner(&context_, CreateGraphInfo()));
 #else
-    memory_planner_ = std::make_unique<ArenaPlanner>(
+    auto arena_planner = std::make_unique<ArenaPlanner>(
         &context_, CreateGraphInfo(), ShouldPreserveAllTensors(),
         kDefaultTensorAlignment, subgraph_index_);
+    // Added by Alpa. Only the primary subgraph shares its arena, since the
+    // other subgraphs run nested in it, e.g. as the bodies of control flow ops.
+    if (subgraph_index_ == 0 && options_ &&
+        options_->GetSharedArenaBuffer() != nullptr) {
+      TF_LITE_ENSURE_STATUS(arena_planner->SetSharedArenaBuffer(
+          options_->GetSharedArenaBuffer()));
+    }
+    memory_planner_ = std::move(arena_planner);
 #endif
+    if (!offline_memory_plan_.empty()) {
+      TF_LITE_ENSURE_STATUS(
+          memory_planner_->SetOfflinePlan(offline_memory_plan_));
+    }
+    TF_LITE_ENSURE_STATUS(
+        memory_planner_->SetExecutionWaves(parallel_execution_waves_));
     memory_planner_->PlanAllocations();
   }
 
@@ -1278,6 +1358,12 @@ TfLiteStatus Subgraph::Invoke() {
     ReportError("Non-persistent memory is not available.");
     return kTfLiteError;
   }
+  // Added by Alpa. The shared arena buffer may have been replaced by another
+  // interpreter since this one was last invoked.
+  if (memory_planner_) {
+    TF_LITE_ENSURE_STATUS(memory_planner_->RefreshNonPersistentMemory());
+  }
+  if (CanInvokeInParallel()) return InvokeInParallel();
   TFLITE_SCOPED_TAGGED_DEFAULT_PROFILE(profiler_.get(), "Invoke");
 #ifdef TF_LITE_TENSORFLOW_PROFILER
   tensorflow::profiler::TraceMe* trace_subgraph =
@@ -1391,6 +1477,153 @@ TfLiteStatus Subgraph::Invoke() {
   return status;
 }
 
+TfLiteStatus Subgraph::PlanParallelExecution() {
+  const int num_threads =
+      options_ != nullptr ? options_->GetParallelExecutionThreads() : 0;
+  std::vector<int> waves;
+  if (subgraph_index_ == 0 && num_threads > 1 && delegates_applied_.empty()) {
+    // The wave of a node is the length of the longest path of nodes producing
+    // its inputs.
+    std::vector<int> tensor_waves(tensors_.size(), 0);
+    waves.resize(execution_plan_.size());
+    for (int i = 0; i < execution_plan_.size(); ++i) {
+      const auto& node_and_registration =
+          nodes_and_registration_[execution_plan_[i]];
+      const TfLiteNode& node = node_and_registration.first;
+      if (OpMightHaveSideEffect(&node, &node_and_registration.second) ||
+          AnyTensorVariableOrVariant(tensors_, node.inputs) ||
+          AnyTensorVariableOrVariant(tensors_, node.outputs)) {
+        waves.clear();
+        break;
+      }
+      for (int tensor_index : TfLiteIntArrayView(node.inputs)) {
+        if (tensor_index == kTfLiteOptionalTensor) continue;
+        waves[i] = std::max(waves[i], tensor_waves[tensor_index]);
+      }
+      for (int tensor_index : TfLiteIntArrayView(node.outputs)) {
+        if (tensor_index == kTfLiteOptionalTensor) continue;
+        tensor_waves[tensor_index] = waves[i] + 1;
+      }
+    }
+  }
+
+  if (!waves.empty()) {
+    std::vector<int> order(execution_plan_.size());
+    for (int i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&waves](int a, int b) { return waves[a] < waves[b]; });
+    std::vector<int> execution_plan(order.size());
+    parallel_execution_waves_.resize(order.size());
+    for (int i = 0; i < order.size(); ++i) {
+      execution_plan[i] = execution_plan_[order[i]];
+      parallel_execution_waves_[i] = waves[order[i]];
+    }
+    if (execution_plan != execution_plan_) {
+      execution_plan_ = std::move(execution_plan);
+      if (memory_planner_) {
+        TF_LITE_ENSURE_STATUS(memory_planner_->PlanAllocations());
+      }
+    }
+    parallel_execution_plan_ = execution_plan_;
+    if (parallel_task_runner_ == nullptr ||
+        parallel_task_runner_->num_threads() != num_threads) {
+      parallel_task_runner_ = std::make_unique<ParallelTaskRunner>(num_threads);
+      parallel_cpu_backend_contexts_.resize(num_threads);
+      for (auto& cpu_backend_context : parallel_cpu_backend_contexts_) {
+        cpu_backend_context = std::make_unique<ExternalCpuBackendContext>();
+      }
+    }
+  } else {
+    parallel_execution_plan_.clear();
+    parallel_execution_waves_.clear();
+    parallel_task_runner_.reset();
+    parallel_cpu_backend_contexts_.clear();
+  }
+  if (memory_planner_) {
+    TF_LITE_ENSURE_STATUS(
+        memory_planner_->SetExecutionWaves(parallel_execution_waves_));
+  }
+  return kTfLiteOk;
+}
+
+bool Subgraph::CanInvokeInParallel() const {
+  // Dynamic tensors are resized, and the nodes using them prepared again, in
+  // between the nodes.
+  return parallel_task_runner_ != nullptr && profiler_ == nullptr &&
+         !has_dynamic_tensors_ &&
+         next_execution_plan_index_to_prepare_ == execution_plan_.size() &&
+         execution_plan_ == parallel_execution_plan_;
+}
+
+TfLiteStatus Subgraph::InvokeInParallel() {
+  EnsureTensorsVectorCapacity();
+  tensor_resized_since_op_invoke_ = false;
+  std::vector<TfLiteStatus> statuses;
+  for (int first = 0; first < execution_plan_.size();) {
+    int last = first + 1;
+    const int wave = parallel_execution_waves_[first];
+    while (last < execution_plan_.size() &&
+           parallel_execution_waves_[last] == wave) {
+      ++last;
+    }
+    if (check_cancelled_func_ != nullptr &&
+        check_cancelled_func_(cancellation_data_)) {
+      ReportError("Client requested cancel during Invoke()");
+      return kTfLiteError;
+    }
+    // The inputs of a wave are produced by the previous waves.
+    for (int i = first; i < last; ++i) {
+      const TfLiteNode& node =
+          nodes_and_registration_[execution_plan_[i]].first;
+      const TfLiteRegistration& registration =
+          nodes_and_registration_[execution_plan_[i]].second;
+      for (int j = 0; j < node.inputs->size; ++j) {
+        const int tensor_index = node.inputs->data[j];
+        if (tensor_index == kTfLiteOptionalTensor) continue;
+        const TfLiteTensor& tensor = tensors_[tensor_index];
+        // See Invoke() for the shape input of reshape ops.
+        if (tensor.data.raw == nullptr && tensor.bytes > 0 &&
+            !(registration.builtin_code == kTfLiteBuiltinReshape && j == 1 &&
+              tensor.dims->size != 1)) {
+          ReportError("Input tensor %d lacks data", tensor_index);
+          return kTfLiteError;
+        }
+      }
+    }
+    // Single nodes keep the CPU backend context of the subgraph, and with it
+    // all the threads set for the interpreter.
+    const bool concurrent = last - first > 1;
+    statuses.assign(last - first, kTfLiteOk);
+    parallel_task_runner_->Run(last - first, [&](int task, int thread) {
+      auto& node_and_registration =
+          nodes_and_registration_[execution_plan_[first + task]];
+      ExternalCpuBackendContext* cpu_backend_context =
+          concurrent ? parallel_cpu_backend_contexts_[thread].get() : nullptr;
+      parallel_cpu_backend_context = cpu_backend_context;
+      statuses[task] = OpInvoke(node_and_registration.second,
+                                &node_and_registration.first);
+      parallel_cpu_backend_context = nullptr;
+      // Contexts are created by the first kernel using them, with the
+      // threads set for the interpreter.
+      if (cpu_backend_context != nullptr &&
+          cpu_backend_context->internal_backend_context() != nullptr) {
+        cpu_backend_context->internal_backend_context()->SetMaxNumThreads(1);
+      }
+    });
+    for (int i = first; i < last; ++i) {
+      if (statuses[i - first] != kTfLiteOk) {
+        const int node_index = execution_plan_[i];
+        const auto& node_and_registration = nodes_and_registration_[node_index];
+        return ReportOpError(&context_, node_and_registration.first,
+                             node_and_registration.second, node_index,
+                             "failed to invoke");
+      }
+    }
+    first = last;
+  }
+  return kTfLiteOk;
+}
+
 TfLiteStatus Subgraph::ResizeTensor(TfLiteContext* context,
                                     TfLiteTensor* tensor,
                                     TfLiteIntArray* new_size) {
@@ -1511,6 +1744,8 @@ TfLiteStatus Subgraph::SetTensorParametersReadOnly(
     size_t required_bytes;
     TF_LITE_ENSURE_OK(&context_,
                       BytesRequired(type, dims, ndims, &required_bytes));
+    // Added by Alpa. Constant int4 tensors pack two values per byte.
+    if (type == kTfLiteInt4) required_bytes = (required_bytes + 1) / 2;
     TF_LITE_ENSURE_EQ(&context_, required_bytes, bytes);
   }
 
@@ -36,9 +36,11 @@ limitations under the License.
 #include "tensorflow/lite/core/macros.h"
 #include "tensorflow/lite/experimental/resource/initialization_status.h"
 #include "tensorflow/lite/experimental/resource/resource_base.h"
+#include "tensorflow/lite/external_cpu_backend_context.h"
 #include "tensorflow/lite/graph_info.h"
 #include "tensorflow/lite/interpreter_options.h"
 #include "tensorflow/lite/memory_planner.h"
+#include "tensorflow/lite/parallel_task_runner.h"
 #include "tensorflow/lite/util.h"
 
 namespace tflite {
@@ -298,6 +300,14 @@ class Subgraph {
   // WARNING: This is an experimental API and subject to change.
   TfLiteStatus EnsureTensorDataIsReadable(int tensor_index);
 
+  // Added by Alpa. Binds `buffer_handle` of `delegate` to the tensor at
+  // `tensor_index`, and releases the handle bound to it before, unless it is
+  // the same. The tensor must not be bound to the handles of another delegate.
+  // WARNING: This is an experimental API and subject to change.
+  TfLiteStatus SetBufferHandle(int tensor_index,
+                               TfLiteBufferHandle buffer_handle,
+                               TfLiteDelegate* delegate);
+
   // The default capacity of `tensors_` vector.
   static constexpr int kTensorsReservedCapacity = 128;
   // The capacity headroom of `tensors_` vector before calling ops'
@@ -440,6 +450,17 @@ class Subgraph {
     return (options_ && options_->GetDisableDelegateClustering());
   }
 
+  // Added by Alpa. Sets the offline plan of the non-persistent tensors, see
+  // MemoryPlanner::SetOfflinePlan().
+  // WARNING: This is an experimental API and subject to change.
+  TfLiteStatus SetOfflineMemoryPlan(std::vector<int32_t> plan);
+
+  // Added by Alpa. Returns the current allocations of the non-persistent
+  // tensors in the format of SetOfflineMemoryPlan(), e.g. to store them in the
+  // model. Must be called after AllocateTensors().
+  // WARNING: This is an experimental API and subject to change.
+  TfLiteStatus GetOfflineMemoryPlan(std::vector<int32_t>* plan);
+
  private:
   friend class InterpreterBuilder;
   friend class TestDelegate;
@@ -532,6 +553,20 @@ class Subgraph {
                                     const std::vector<int>& execution_plan,
                                     int* last_execution_plan_index_prepared);
 
+  // Added by Alpa. Orders the execution plan by waves of nodes independent of
+  // each other and sets up their concurrent execution, if enabled by the
+  // interpreter options and supported by the nodes. See
+  // InterpreterOptions::SetParallelExecutionThreads().
+  TfLiteStatus PlanParallelExecution();
+
+  // Added by Alpa. Returns true if the waves planned by PlanParallelExecution()
+  // can be invoked in the current state of the subgraph.
+  bool CanInvokeInParallel() const;
+
+  // Added by Alpa. Invokes the execution plan wave by wave, the nodes of a wave
+  // concurrently.
+  TfLiteStatus InvokeInParallel();
+
   // Tensors needed by the interpreter. Use `AddTensors` to add more blank
   // tensor entries. Note, `tensors_.data()` needs to be synchronized to the
   // `context_` whenever this std::vector is reallocated. Currently this
@@ -860,6 +895,19 @@ class Subgraph {
 
   std::unique_ptr<MemoryPlanner> memory_planner_;
 
+  // Added by Alpa. The offline plan given to the memory planner.
+  std::vector<int32_t> offline_memory_plan_;
+
+  // Added by Alpa. The execution plan ordered by PlanParallelExecution() and
+  // the wave of each of its nodes, the threads running the nodes of a wave,
+  // and the CPU backend context of each thread, used by the kernels instead
+  // of the one of the subgraph while a wave runs.
+  std::vector<int> parallel_execution_plan_;
+  std::vector<int> parallel_execution_waves_;
+  std::unique_ptr<ParallelTaskRunner> parallel_task_runner_;
+  std::vector<std::unique_ptr<ExternalCpuBackendContext>>
+      parallel_cpu_backend_contexts_;
+
   // Maps tensor index to custom allocation for all applicable tensors.
   std::map<int, TfLiteCustomAllocation> custom_allocations_;
 
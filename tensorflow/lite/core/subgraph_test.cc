@@ -15,16 +15,21 @@ limitations under the License.
 
 #include "tensorflow/lite/core/subgraph.h"
 
+#include <stdlib.h>
+
 #include <algorithm>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/core/interpreter.h"
+#include "tensorflow/lite/interpreter_options.h"
 
 namespace tflite {
 
 namespace ops {
 namespace builtin {
+TfLiteRegistration* Register_ADD();
 TfLiteRegistration* Register_PADV2();
 TfLiteRegistration* Register_NEG();
 }  // namespace builtin
@@ -71,5 +76,44 @@ TEST(RemoveUnusedInputs, BypassInputsWithoutOp) {
   ASSERT_EQ(subgraph.inputs(), std::vector<int>({0, -1, 2}));
 }
 
+TEST(ParallelExecution, RunsBranchesByWaves) {
+  Interpreter interpreter;
+  InterpreterOptions options;
+  options.SetParallelExecutionThreads(2);
+  ASSERT_EQ(interpreter.ApplyOptions(&options), kTfLiteOk);
+  auto& subgraph = interpreter.primary_subgraph();
+  subgraph.AddTensors(6);
+  for (int i = 0; i < 6; ++i) {
+    subgraph.SetTensorParametersReadWrite(i, kTfLiteFloat32, "", {2},
+                                          TfLiteQuantization());
+  }
+  subgraph.SetInputs({0});
+  subgraph.SetOutputs({5});
+  TfLiteRegistration* add_op = tflite::ops::builtin::Register_ADD();
+  TfLiteRegistration* neg_op = tflite::ops::builtin::Register_NEG();
+  // Two branches of two ops, joined by the last op.
+  subgraph.AddNodeWithParameters({0}, {1}, {}, nullptr, 0, nullptr, neg_op);
+  subgraph.AddNodeWithParameters({1}, {2}, {}, nullptr, 0, nullptr, neg_op);
+  subgraph.AddNodeWithParameters({0}, {3}, {}, nullptr, 0, nullptr, neg_op);
+  subgraph.AddNodeWithParameters({3}, {4}, {}, nullptr, 0, nullptr, neg_op);
+  auto* add_params =
+      reinterpret_cast<TfLiteAddParams*>(malloc(sizeof(TfLiteAddParams)));
+  add_params->activation = kTfLiteActNone;
+  add_params->pot_scale_int16 = false;
+  subgraph.AddNodeWithParameters({2, 4}, {5}, {}, nullptr, 0, add_params,
+                                 add_op);
+
+  ASSERT_EQ(subgraph.AllocateTensors(), kTfLiteOk);
+  // The ops of each branch are in distinct waves.
+  ASSERT_EQ(subgraph.execution_plan(), std::vector<int>({0, 2, 1, 3, 4}));
+  for (float value : {1.f, 2.f}) {
+    subgraph.tensor(0)->data.f[0] = value;
+    subgraph.tensor(0)->data.f[1] = -value;
+    ASSERT_EQ(subgraph.Invoke(), kTfLiteOk);
+    EXPECT_EQ(subgraph.tensor(5)->data.f[0], 2 * value);
+    EXPECT_EQ(subgraph.tensor(5)->data.f[1], -2 * value);
+  }
+}
+
 }  // namespace
 }  // namespace tflite
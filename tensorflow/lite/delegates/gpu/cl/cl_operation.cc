@@ -163,12 +163,23 @@ absl::Status ClOperation::SetDstTensor(int index, Tensor* tensor) {
 }
 
 absl::Status ClOperation::Compile(const CreationContext& creation_context) {
+  RETURN_IF_ERROR(CreateArguments(creation_context));
+  return CompileKernel(creation_context);
+}
+
+absl::Status ClOperation::CreateArguments(
+    const CreationContext& creation_context) {
   operation_->code_ =
       GetCommonOpenCLDefines(operation_->GetPrecision()) + operation_->code_;
   RETURN_IF_ERROR(cl_args_.Init(
       creation_context.GetGpuInfo(),
       creation_context.context, &operation_->args_, &operation_->code_));
   operation_->args_.ReleaseCPURepresentation();
+  return absl::OkStatus();
+}
+
+absl::Status ClOperation::CompileKernel(
+    const CreationContext& creation_context) {
   RETURN_IF_ERROR(creation_context.cache->GetOrCreateCLKernel(
       operation_->code_, "main_function", operation_->compiler_options_,
       *creation_context.context, *creation_context.device, &kernel_,
@@ -114,6 +114,14 @@ class ClOperation {
 
   absl::Status Compile(const CreationContext& creation_context);
 
+  // Added by Alpa. The two steps of Compile(): CreateArguments() creates the
+  // GPU objects of the arguments, which uploads the weights, and generates the
+  // code that CompileKernel() then builds. The kernels of operations may be
+  // built on another thread than the one creating the arguments, as long as a
+  // single thread at a time uses the program cache.
+  absl::Status CreateArguments(const CreationContext& creation_context);
+  absl::Status CompileKernel(const CreationContext& creation_context);
+
   absl::Status RestoreDeserialized(const ProgramCache& program_cache,
                                    uint64_t fingerprint,
                                    const GpuInfo& gpu_info,
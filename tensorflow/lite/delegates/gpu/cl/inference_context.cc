@@ -17,15 +17,18 @@ limitations under the License.
 
 #include <algorithm>
 #include <cmath>
+#include <condition_variable>  // NOLINT(build/c++11)
 #include <cstdint>
 #include <cstring>
 #include <functional>
 #include <limits>
 #include <map>
 #include <memory>
+#include <mutex>  // NOLINT(build/c++11)
 #include <numeric>
 #include <set>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
@@ -673,10 +676,47 @@ void InferenceContext::BindMemoryToOperations() {
 
 absl::Status InferenceContext::Compile(
     const CreationContext& creation_context) {
-  for (auto& node : nodes_) {
-    RETURN_IF_ERROR(node.cl_operation.Compile(creation_context));
+  if (nodes_.size() < 2) {
+    for (auto& node : nodes_) {
+      RETURN_IF_ERROR(node.cl_operation.Compile(creation_context));
+    }
+    return absl::OkStatus();
   }
-  return absl::OkStatus();
+  // Added by Alpa. The weights of the operations are uploaded on this thread
+  // while another one builds the kernels of the operations whose arguments
+  // are created, since the OpenCL calls involved are thread safe.
+  std::mutex mutex;
+  std::condition_variable arguments_created;
+  int num_nodes_with_arguments = 0;  // Guarded by mutex.
+  bool arguments_failed = false;     // Guarded by mutex.
+  absl::Status compile_status;
+  std::thread compiler([&] {
+    for (int i = 0; i < nodes_.size(); ++i) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        arguments_created.wait(lock, [&] {
+          return arguments_failed || num_nodes_with_arguments > i;
+        });
+        if (num_nodes_with_arguments <= i) return;
+      }
+      compile_status = nodes_[i].cl_operation.CompileKernel(creation_context);
+      if (!compile_status.ok()) return;
+    }
+  });
+  absl::Status arguments_status;
+  for (int i = 0; i < nodes_.size() && arguments_status.ok(); ++i) {
+    arguments_status = nodes_[i].cl_operation.CreateArguments(creation_context);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (arguments_status.ok()) {
+      ++num_nodes_with_arguments;
+    } else {
+      arguments_failed = true;
+    }
+    arguments_created.notify_one();
+  }
+  compiler.join();
+  RETURN_IF_ERROR(arguments_status);
+  return compile_status;
 }
 
 absl::Status InferenceContext::Tune(TuningType tuning_type,
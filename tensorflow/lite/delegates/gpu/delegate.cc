@@ -49,6 +49,10 @@ using delegates::Serialization;
 using delegates::SerializationParams;
 
 constexpr char kSerializedDataPrefix[] = "gpuv2_data_";
+// Added by Alpa. Key prefix of the cached programs, and the model token used
+// for them when none is given.
+constexpr char kProgramCachePrefix[] = "gpuv2_programs_";
+constexpr char kProgramCacheModelToken[] = "gpuv2_program_cache";
 
 InferencePriority ToPriority(int32_t priority) {
   switch (priority) {
@@ -99,10 +103,22 @@ class Delegate {
       params.cache_dir = options_.serialization_dir;
       serialization_ = std::make_unique<Serialization>(params);
     }
+    // Added by Alpa. Compiled programs are cached by default, unless the whole
+    // model is serialized with them.
+    if (!serialization_ && options_.serialization_dir &&
+        !(options_.experimental_flags &
+          TFLITE_GPU_EXPERIMENTAL_FLAGS_DISABLE_PROGRAM_CACHE)) {
+      SerializationParams params;
+      params.model_token = options_.model_token ? options_.model_token
+                                                : kProgramCacheModelToken;
+      params.cache_dir = options_.serialization_dir;
+      program_cache_ = std::make_unique<Serialization>(params);
+    }
   }
 
   TfLiteDelegate* tflite_delegate() { return &delegate_; }
   Serialization* serialization() { return serialization_.get(); }
+  Serialization* program_cache() { return program_cache_.get(); }
   const TfLiteGpuDelegateOptionsV2& options() const { return options_; }
 
   bool IsQuantOpsAllowed() const {
@@ -120,6 +136,8 @@ class Delegate {
   int num_delegate_kernels_ = 0;
 
   std::unique_ptr<Serialization> serialization_;
+  // Added by Alpa. Stores the compiled programs of the delegate kernels.
+  std::unique_ptr<Serialization> program_cache_;
 
   friend class DelegateKernel;
 };
@@ -366,11 +384,27 @@ class DelegateKernel {
 
     if (!serialization) {
       // This path is faster when there is no serialization involved.
+      // Added by Alpa. The programs compiled before for this partition are
+      // loaded from the program cache, if any. The environment only reads them
+      // while it creates the builder.
+      Serialization* program_cache = delegate_->program_cache();
+      std::string cached_programs;
+      if (program_cache) {
+        GetProgramCacheEntry(context, delegate_params, options, program_cache)
+            .GetData(context, &cached_programs);
+        env_options.serialized_binary_cache = absl::MakeConstSpan(
+            reinterpret_cast<const uint8_t*>(cached_programs.data()),
+            cached_programs.size());
+      }
       RETURN_IF_ERROR(cl::NewInferenceEnvironment(env_options, &cl_environment_,
                                                   &properties));
       *graph_is_destroyed = true;
       RETURN_IF_ERROR(cl_environment_->NewInferenceBuilder(
           options, std::move(*graph), builder));
+      if (program_cache) {
+        SaveProgramCache(context, delegate_params, options, program_cache,
+                         cached_programs.size());
+      }
     } else {
       // If serialization data is found, initialize CL from it & return early.
       if (MaybeInitializeSerializedOpenCL(context, delegate_params, builder,
@@ -455,6 +489,37 @@ class DelegateKernel {
     return absl::OkStatus();
   }
 
+  // Added by Alpa. Returns the program cache entry of this partition.
+  delegates::SerializationEntry GetProgramCacheEntry(
+      TfLiteContext* context, const TfLiteDelegateParams* delegate_params,
+      const cl::InferenceOptions& options, Serialization* program_cache) {
+    // The programs differ with the precision chosen from the options.
+    const std::string options_fingerprint =
+        delegates::StrFingerprint(&options, sizeof(cl::InferenceOptions));
+    return program_cache->GetEntryForKernel(
+        std::string(kProgramCachePrefix) + options_fingerprint, context,
+        delegate_params);
+  }
+
+  // Added by Alpa. Stores the programs of the environment in the program
+  // cache, unless they are the `cached_programs_size` bytes loaded from it,
+  // i.e. no program was compiled and the driver did not change.
+  void SaveProgramCache(TfLiteContext* context,
+                        const TfLiteDelegateParams* delegate_params,
+                        const cl::InferenceOptions& options,
+                        Serialization* program_cache,
+                        size_t cached_programs_size) {
+    const std::vector<uint8_t> programs =
+        cl_environment_->GetSerializedBinaryCache();
+    if (programs.empty() || programs.size() == cached_programs_size) return;
+    if (GetProgramCacheEntry(context, delegate_params, options, program_cache)
+            .SetData(context, reinterpret_cast<const char*>(programs.data()),
+                     programs.size()) != kTfLiteOk) {
+      TFLITE_LOG_PROD(tflite::TFLITE_LOG_WARNING,
+                      "Failed to store the compiled OpenCL programs.");
+    }
+  }
+
   absl::Status InitializeOpenGlApi(GraphFloat32* graph,
                                    std::unique_ptr<InferenceBuilder>* builder) {
 #ifndef CL_DELEGATE_NO_GL
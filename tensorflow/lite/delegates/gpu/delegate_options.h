@@ -66,6 +66,13 @@ enum TfLiteGpuExperimentalFlags {
   // TfLiteGpuDelegateOptionsV2.
   // Currently works only if CL backend is used.
   TFLITE_GPU_EXPERIMENTAL_FLAGS_ENABLE_SERIALIZATION = 1 << 3,
+  // Added by Alpa. Disables the cache of compiled OpenCL programs. Unless
+  // serialization is enabled, the programs compiled for each delegated
+  // partition are stored in serialization_dir by default, keyed by the
+  // partition, model_token if set and the inference options, and validated
+  // against the OpenCL driver version. Later initializations only compile
+  // the programs missing from the cache.
+  TFLITE_GPU_EXPERIMENTAL_FLAGS_DISABLE_PROGRAM_CACHE = 1 << 4,
 };
 
 // IMPORTANT: Always use TfLiteGpuDelegateOptionsV2Default() method to create
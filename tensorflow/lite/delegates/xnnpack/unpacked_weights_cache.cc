@@ -0,0 +1,113 @@
+// This file contains the implementation of the unpacked weights cache of the
+// XNNPACK delegate.
+
+#include "tensorflow/lite/delegates/xnnpack/unpacked_weights_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "tensorflow/lite/stderr_reporter.h"
+
+namespace tflite {
+namespace xnnpack {
+namespace {
+
+constexpr char kMagic[8] = {'T', 'F', 'L', 'X', 'N', 'N', 'U', 'W'};
+constexpr uint32_t kVersion = 1;
+// The weights start at this offset of the file, which keeps the alignment of
+// the offsets of their tensors.
+constexpr size_t kHeaderSize = 64;
+// Zero bytes stored after the weights.
+constexpr size_t kPaddingSize = 64;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t fingerprint;
+  uint64_t size;
+};
+static_assert(sizeof(Header) <= kHeaderSize, "Header too large");
+
+void Mix(uint64_t word, uint64_t* state) {
+  *state = (*state ^ word) * 0x9e3779b97f4a7c15ull;
+  *state ^= *state >> 29;
+}
+
+}  // namespace
+
+void WeightsFingerprint::Update(const void* data, size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  for (; size >= sizeof(uint64_t);
+       bytes += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    Mix(word, &state_);
+  }
+  for (; size > 0; ++bytes, --size) {
+    Mix(static_cast<uint8_t>(*bytes), &state_);
+  }
+}
+
+std::unique_ptr<MappedUnpackedWeights> MappedUnpackedWeights::Load(
+    const char* path, uint64_t fingerprint, size_t size) {
+  if (!MMAPAllocation::IsSupported()) return nullptr;
+  // The header is checked first, so that missing or stale files are not
+  // reported as errors.
+  FILE* file = std::fopen(path, "rb");
+  if (file == nullptr) return nullptr;
+  Header header;
+  const bool read = std::fread(&header, sizeof(header), 1, file) == 1;
+  std::fclose(file);
+  if (!read || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.header_size != kHeaderSize ||
+      header.fingerprint != fingerprint || header.size != size) {
+    return nullptr;
+  }
+  auto allocation =
+      std::make_unique<MMAPAllocation>(path, DefaultErrorReporter());
+  if (!allocation->valid() ||
+      allocation->bytes() < kHeaderSize + size + kPaddingSize) {
+    return nullptr;
+  }
+  return std::unique_ptr<MappedUnpackedWeights>(
+      new MappedUnpackedWeights(std::move(allocation)));
+}
+
+const char* MappedUnpackedWeights::data() const {
+  return static_cast<const char*>(allocation_->base()) + kHeaderSize;
+}
+
+bool SaveUnpackedWeights(const char* path, uint64_t fingerprint,
+                         const char* data, size_t size) {
+  if (!MMAPAllocation::IsSupported()) return false;
+  Header header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.header_size = kHeaderSize;
+  header.fingerprint = fingerprint;
+  header.size = size;
+  const char zeros[kHeaderSize > kPaddingSize ? kHeaderSize : kPaddingSize] =
+      {};
+
+  // Other processes may map the file at any time, so it is written aside and
+  // then renamed.
+  const std::string temp_path = std::string(path) + ".tmp";
+  FILE* file = std::fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) return false;
+  bool written =
+      std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+      std::fwrite(zeros, kHeaderSize - sizeof(header), 1, file) == 1 &&
+      (size == 0 || std::fwrite(data, size, 1, file) == 1) &&
+      std::fwrite(zeros, kPaddingSize, 1, file) == 1;
+  written = std::fclose(file) == 0 && written;
+  if (!written || std::rename(temp_path.c_str(), path) != 0) {
+    std::remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace xnnpack
+}  // namespace tflite
@@ -0,0 +1,65 @@
+// This file contains the persistent cache of the static weights the XNNPACK
+// delegate unpacks, i.e. dequantizes from FP16/INT8 or densifies from sparse
+// tensors, so that later delegates map the unpacked weights from the cache
+// file instead of unpacking them again into memory of their own.
+
+#ifndef TENSORFLOW_LITE_DELEGATES_XNNPACK_UNPACKED_WEIGHTS_CACHE_H_
+#define TENSORFLOW_LITE_DELEGATES_XNNPACK_UNPACKED_WEIGHTS_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "tensorflow/lite/allocation.h"
+
+namespace tflite {
+namespace xnnpack {
+
+// Incremental fingerprint of the data unpacked weights are computed from.
+class WeightsFingerprint {
+ public:
+  void Update(const void* data, size_t size);
+
+  template <typename T>
+  void Update(const T& value) {
+    Update(&value, sizeof(T));
+  }
+
+  uint64_t value() const { return state_; }
+
+ private:
+  uint64_t state_ = 0xcbf29ce484222325ull;
+};
+
+// Unpacked weights mapped from a cache file.
+class MappedUnpackedWeights {
+ public:
+  // Maps the `size` bytes of unpacked weights stored in `path` with
+  // `fingerprint`. Returns nullptr if the file does not exist, holds other
+  // weights, or cannot be mapped.
+  static std::unique_ptr<MappedUnpackedWeights> Load(const char* path,
+                                                     uint64_t fingerprint,
+                                                     size_t size);
+
+  // The weights, followed by zero padding that may be read past the end of
+  // the last tensor.
+  const char* data() const;
+
+ private:
+  explicit MappedUnpackedWeights(std::unique_ptr<MMAPAllocation> allocation)
+      : allocation_(std::move(allocation)) {}
+
+  std::unique_ptr<MMAPAllocation> allocation_;
+};
+
+// Stores `size` bytes of unpacked weights at `data` in `path` with
+// `fingerprint`, replacing any previous file atomically. Returns false on
+// failure.
+bool SaveUnpackedWeights(const char* path, uint64_t fingerprint,
+                         const char* data, size_t size);
+
+}  // namespace xnnpack
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_DELEGATES_XNNPACK_UNPACKED_WEIGHTS_CACHE_H_
@@ -0,0 +1,47 @@
+#include "tensorflow/lite/delegates/xnnpack/unpacked_weights_cache.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace tflite {
+namespace xnnpack {
+namespace {
+
+TEST(UnpackedWeightsCache, Fingerprint) {
+  const std::vector<float> weights = {1.f, 2.f, 3.f};
+  WeightsFingerprint fingerprint, same_fingerprint, other_fingerprint;
+  fingerprint.Update(weights.data(), weights.size() * sizeof(float));
+  same_fingerprint.Update(weights.data(), weights.size() * sizeof(float));
+  other_fingerprint.Update(weights.data(), 2 * sizeof(float));
+  EXPECT_EQ(fingerprint.value(), same_fingerprint.value());
+  EXPECT_NE(fingerprint.value(), other_fingerprint.value());
+  same_fingerprint.Update(0);
+  EXPECT_NE(fingerprint.value(), same_fingerprint.value());
+}
+
+TEST(UnpackedWeightsCache, SaveAndLoad) {
+  if (!MMAPAllocation::IsSupported()) GTEST_SKIP();
+  const std::string path = ::testing::TempDir() + "/unpacked_weights";
+  const std::vector<char> weights = {1, 2, 3, 4, 5};
+  EXPECT_EQ(MappedUnpackedWeights::Load(path.c_str(), 42, weights.size()),
+            nullptr);
+  ASSERT_TRUE(
+      SaveUnpackedWeights(path.c_str(), 42, weights.data(), weights.size()));
+
+  auto mapped = MappedUnpackedWeights::Load(path.c_str(), 42, weights.size());
+  ASSERT_NE(mapped, nullptr);
+  EXPECT_EQ(std::memcmp(mapped->data(), weights.data(), weights.size()), 0);
+  EXPECT_EQ(mapped->data()[weights.size()], 0);
+  // Weights unpacked from other data are not loaded.
+  EXPECT_EQ(MappedUnpackedWeights::Load(path.c_str(), 43, weights.size()),
+            nullptr);
+  EXPECT_EQ(MappedUnpackedWeights::Load(path.c_str(), 42, weights.size() + 1),
+            nullptr);
+}
+
+}  // namespace
+}  // namespace xnnpack
+}  // namespace tflite
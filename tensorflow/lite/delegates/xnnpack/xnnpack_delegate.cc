@@ -34,6 +34,7 @@ limitations under the License.
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/core/api/profiler.h"
 #include "tensorflow/lite/delegates/xnnpack/quantization_util.h"
+#include "tensorflow/lite/delegates/xnnpack/unpacked_weights_cache.h"
 #include "tensorflow/lite/kernels/internal/compatibility.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/internal/utils/sparsity_format_converter.h"
@@ -296,6 +297,81 @@ xnn_datatype GetXNNPackDatatype(TfLiteContext* context,
   return xnn_datatype_invalid;
 }
 
+// Added by Alpa. Returns the offset of the unpacked data of a tensor following
+// `size` bytes of unpacked data.
+size_t AlignUnpackedDataOffset(size_t size) {
+  return (size + XNN_EXTRA_BYTES - 1) / XNN_EXTRA_BYTES * XNN_EXTRA_BYTES;
+}
+
+// Added by Alpa. Computes the fingerprint of the static data the quasi-static
+// tensors `tensors` are unpacked from, in this order, by the nodes
+// `producers`, and the size of their unpacked data.
+bool FingerprintStaticUnpacking(TfLiteContext* context,
+                                const std::vector<int>& tensors,
+                                const std::unordered_map<int, int>& producers,
+                                uint64_t* fingerprint, size_t* size) {
+  WeightsFingerprint result;
+  const auto update_int_array = [&result](const TfLiteIntArray* array) {
+    if (array == nullptr) {
+      result.Update(-1);
+      return;
+    }
+    result.Update(array->size);
+    result.Update(array->data, array->size * sizeof(int));
+  };
+  result.Update(XNN_EXTRA_BYTES);
+  *size = 0;
+  for (int t : tensors) {
+    TfLiteNode* node = nullptr;
+    TfLiteRegistration* registration = nullptr;
+    if (context->GetNodeAndRegistration(context, producers.at(t), &node,
+                                        &registration) != kTfLiteOk ||
+        node->inputs->size != 1) {
+      return false;
+    }
+    const TfLiteTensor& input_tensor = context->tensors[node->inputs->data[0]];
+    const TfLiteTensor& output_tensor = context->tensors[t];
+    result.Update(registration->builtin_code);
+    result.Update(t);
+    result.Update(node->inputs->data[0]);
+    result.Update(output_tensor.type);
+    result.Update(output_tensor.bytes);
+    update_int_array(output_tensor.dims);
+    // Quasi-static inputs are covered by the fingerprint of their own data.
+    if (input_tensor.allocation_type == kTfLiteMmapRo) {
+      result.Update(input_tensor.type);
+      update_int_array(input_tensor.dims);
+      result.Update(input_tensor.params);
+      if (input_tensor.quantization.type == kTfLiteAffineQuantization &&
+          input_tensor.quantization.params != nullptr) {
+        const auto* quant_params = static_cast<TfLiteAffineQuantization*>(
+            input_tensor.quantization.params);
+        result.Update(quant_params->scale->size);
+        result.Update(quant_params->scale->data,
+                      quant_params->scale->size * sizeof(float));
+        update_int_array(quant_params->zero_point);
+        result.Update(quant_params->quantized_dimension);
+      }
+      if (input_tensor.sparsity != nullptr) {
+        const TfLiteSparsity& sparsity = *input_tensor.sparsity;
+        update_int_array(sparsity.traversal_order);
+        update_int_array(sparsity.block_map);
+        result.Update(sparsity.dim_metadata_size);
+        for (int i = 0; i < sparsity.dim_metadata_size; ++i) {
+          result.Update(sparsity.dim_metadata[i].format);
+          result.Update(sparsity.dim_metadata[i].dense_size);
+          update_int_array(sparsity.dim_metadata[i].array_segments);
+          update_int_array(sparsity.dim_metadata[i].array_indices);
+        }
+      }
+      result.Update(input_tensor.data.raw_const, input_tensor.bytes);
+    }
+    *size = AlignUnpackedDataOffset(*size) + output_tensor.bytes;
+  }
+  *fingerprint = result.value();
+  return true;
+}
+
 // Forward declaration.
 TfLiteStatus DelegatePrepare(TfLiteContext* context, TfLiteDelegate* delegate);
 
@@ -317,6 +393,9 @@ class Delegate {
     options_ =
         options != nullptr ? *options : TfLiteXNNPackDelegateOptionsDefault();
     workspace_.reset(workspace);
+    if (options_.unpacked_weights_cache_path != nullptr) {
+      unpacked_weights_cache_path_ = options_.unpacked_weights_cache_path;
+    }
   }
 
   TfLiteIntArray* PrepareOpsToDelegate(TfLiteContext* context);
@@ -361,6 +440,13 @@ class Delegate {
 
   xnn_workspace_t workspace() const { return workspace_.get(); }
 
+  // Added by Alpa. The unpacked data for quasi-static tensors, mapped from the
+  // unpacked weights cache if possible.
+  const char* static_unpacked_data() const {
+    return mapped_unpacked_data_ != nullptr ? mapped_unpacked_data_->data()
+                                            : static_unpacked_data_.data();
+  }
+
  private:
   TfLiteDelegate delegate_ = {
       reinterpret_cast<void*>(this),  // .data_
@@ -374,8 +460,13 @@ class Delegate {
   // Unpacked data for quasi-static tensors, i.e. tensors produced by
   // dequantizing or unpacking static buffers.
   std::vector<char> static_unpacked_data_;
+  // Added by Alpa. The unpacked data for quasi-static tensors, when mapped
+  // from the unpacked weights cache instead of static_unpacked_data_, and the
+  // path of the cache.
+  std::unique_ptr<MappedUnpackedWeights> mapped_unpacked_data_;
+  std::string unpacked_weights_cache_path_;
   // Mapping from a tensor index for a quasi-static tensor to the offset to
-  // its unpacked data within static_unpacked_data_.
+  // its unpacked data within static_unpacked_data().
   std::unordered_map<int, size_t> static_unpacked_data_map_;
   // Set of indices of nodes which unpack static data, e.g. Dequantize
   // operators which convert FP16 static weights to FP32. These nodes are simply
@@ -541,7 +632,7 @@ class Subgraph {
         // Check for quasi-static data.
         const auto it = delegate.static_unpacked_data_map_.find(t);
         if (it != delegate.static_unpacked_data_map_.end()) {
-          data = delegate.static_unpacked_data_.data() + it->second;
+          data = delegate.static_unpacked_data() + it->second;
         }
       }
       if (inputs.count(t) != 0) {
@@ -4710,6 +4801,7 @@ TfLiteIntArray* Delegate::PrepareOpsToDelegate(TfLiteContext* context) {
   // Clear previous data, in case the delegate is reused without re-creation.
   static_unpacked_data_map_.clear();
   static_unpacked_data_.clear();
+  mapped_unpacked_data_.reset();
   static_unpack_nodes_.clear();
   static_sparse_weights_.clear();
 
@@ -4854,6 +4946,24 @@ TfLiteIntArray* Delegate::PrepareOpsToDelegate(TfLiteContext* context) {
                      quasi_static_tensors_producers[t2];
             });
 
+  // Added by Alpa. Map the data unpacked from the same static data by an
+  // earlier delegate, if it is in the unpacked weights cache.
+  uint64_t unpacked_data_fingerprint = 0;
+  size_t cached_unpacked_data_size = 0;
+  const bool cache_unpacked_data =
+      !unpacked_weights_cache_path_.empty() &&
+      !sorted_quasi_static_tensors_to_unpack.empty() &&
+      FingerprintStaticUnpacking(
+          context, sorted_quasi_static_tensors_to_unpack,
+          quasi_static_tensors_producers, &unpacked_data_fingerprint,
+          &cached_unpacked_data_size);
+  if (cache_unpacked_data) {
+    mapped_unpacked_data_ = MappedUnpackedWeights::Load(
+        unpacked_weights_cache_path_.c_str(), unpacked_data_fingerprint,
+        cached_unpacked_data_size);
+  }
+  size_t unpacked_data_size = 0;
+
   // Unpack static data of all tensors
   for (int t : sorted_quasi_static_tensors_to_unpack) {
     const int producer_index = quasi_static_tensors_producers[t];
@@ -4924,11 +5034,14 @@ TfLiteIntArray* Delegate::PrepareOpsToDelegate(TfLiteContext* context) {
     }
 
     // Align to XNN_EXTRA_BYTES bytes
-    while (static_unpacked_data_.size() % XNN_EXTRA_BYTES != 0) {
-      static_unpacked_data_.push_back(0);
+    const size_t tensor_offset = AlignUnpackedDataOffset(unpacked_data_size);
+    unpacked_data_size = tensor_offset + context->tensors[t].bytes;
+    if (mapped_unpacked_data_ != nullptr) {
+      // Added by Alpa. The data is already unpacked in the mapped cache.
+      static_unpacked_data_map_[t] = tensor_offset;
+      continue;
     }
-    const size_t tensor_offset = static_unpacked_data_.size();
-    static_unpacked_data_.resize(tensor_offset + context->tensors[t].bytes);
+    static_unpacked_data_.resize(unpacked_data_size);
 
     char* unpacked_data = static_unpacked_data_.data() + tensor_offset;
     const char* packed_data =
@@ -5042,6 +5155,26 @@ TfLiteIntArray* Delegate::PrepareOpsToDelegate(TfLiteContext* context) {
     static_unpacked_data_map_[t] = tensor_offset;
   }
 
+  // Added by Alpa. Cache the unpacked data, and map it so that its pages are
+  // shared with the later delegates using the cache.
+  if (cache_unpacked_data && mapped_unpacked_data_ == nullptr) {
+    if (SaveUnpackedWeights(unpacked_weights_cache_path_.c_str(),
+                            unpacked_data_fingerprint,
+                            static_unpacked_data_.data(),
+                            static_unpacked_data_.size())) {
+      mapped_unpacked_data_ = MappedUnpackedWeights::Load(
+          unpacked_weights_cache_path_.c_str(), unpacked_data_fingerprint,
+          static_unpacked_data_.size());
+    } else {
+      TFLITE_LOG_PROD(tflite::TFLITE_LOG_WARNING,
+                      "Failed to write the XNNPACK unpacked weights cache %s.",
+                      unpacked_weights_cache_path_.c_str());
+    }
+    if (mapped_unpacked_data_ != nullptr) {
+      std::vector<char>().swap(static_unpacked_data_);
+    }
+  }
+
   // Add nodes that unpack static data consumed by delegated nodes.
   // Note: this is done purely to avoid the overhead of running these nodes
   // again in TFLite interpreter which would allocate memory for their outputs.
@@ -44,6 +44,13 @@ typedef struct {
   // Cache for packed weights, can be shared between multiple instances of
   // delegates.
   struct TfLiteXNNPackDelegateWeightsCache* weights_cache;
+  // Added by Alpa. Path of a file caching the static weights the delegate
+  // unpacks, i.e. dequantizes from FP16/INT8 or densifies from sparse tensors,
+  // or NULL. Once the file holds the weights of a model, later delegates map
+  // them from the file, sharing their pages, instead of unpacking them again
+  // into memory of their own. The file is rewritten when it holds the weights
+  // of another model. The weights packed by XNNPACK operators are not cached.
+  const char* unpacked_weights_cache_path;
 } TfLiteXNNPackDelegateOptions;
 
 // Returns a structure with the default XNNPack delegate options.
@@ -37,6 +37,7 @@ limitations under the License.
 #include "tensorflow/lite/internal/signature_def.h"
 #include "tensorflow/lite/kernels/internal/compatibility.h"
 #include "tensorflow/lite/model_builder.h"
+#include "tensorflow/lite/offline_memory_plan.h"
 #include "tensorflow/lite/profiling/platform_profiler.h"
 #include "tensorflow/lite/schema/schema_generated.h"
 #include "tensorflow/lite/schema/schema_utils.h"
@@ -151,6 +152,19 @@ inline bool ShouldCreateLazyDelegateProviders(int num_fp32_tensors) {
 #endif
 }
 
+// Added by Alpa. Returns whether `num_scales` scales describe grouped
+// quantization of a 2-D tensor: dims[0] rows whose dims[1] values are split
+// into num_scales / dims[0] groups of equal size.
+bool IsGroupedQuantization(size_t num_scales, int quantized_dimension,
+                           const std::vector<int>& dims) {
+  if (dims.size() != 2 || quantized_dimension != 0 || dims[0] <= 0) {
+    return false;
+  }
+  if (num_scales % dims[0] != 0) return false;
+  const size_t groups = num_scales / dims[0];
+  return groups > 1 && dims[1] % groups == 0;
+}
+
 }  // namespace
 
 constexpr const char* kEmptyTensorName = "";
@@ -424,9 +438,13 @@ TfLiteStatus InterpreterBuilder::ParseQuantization(
 
   // Ensure that the number of scales is 1 for per-layer quantization, and
   // matches number of quantization dimensions for per-axis quantization.
-  if (num_scales != 1 &&
-      (!dims.empty() &&
-       num_scales != dims[src_quantization->quantized_dimension()])) {
+  // Added by Alpa. Grouped quantization of a 2-D tensor along dimension 0
+  // splits the innermost dimension into groups that each have their own
+  // scale, so the number of scales is a multiple of dims[0].
+  if (num_scales != 1 && !dims.empty() &&
+      num_scales != dims[src_quantization->quantized_dimension()] &&
+      !IsGroupedQuantization(num_scales,
+                             src_quantization->quantized_dimension(), dims)) {
     error_reporter_->Report(
         "num_scales must be 1 for per-layer quantization, or %d for per-axis "
         "quantization, but got %d.",
@@ -646,9 +664,16 @@ TfLiteStatus InterpreterBuilder::ParseTensors(
         status = kTfLiteError;
       }
 
+      // Added by Alpa.
+      const Allocation* allocation = allocation_;
+      if (constant_buffer_cache_ != nullptr) {
+        constant_buffer_cache_->Deduplicate(&buffer_ptr, buffer_size,
+                                            &allocation);
+      }
+
       if (subgraph->SetTensorParametersReadOnly(
               i, type, get_name(tensor), dims, quantization, buffer_ptr,
-              buffer_size, allocation_, sparsity) != kTfLiteOk) {
+              buffer_size, allocation, sparsity) != kTfLiteOk) {
         error_reporter_->Report("Tensor %d is invalidly specified in schema.\n",
                                 i);
         status = kTfLiteError;
@@ -822,6 +847,25 @@ TfLiteStatus InterpreterBuilder::operator()(
     return cleanup_and_error();
   }
 
+  // Added by Alpa. An invalid plan only costs the online planning.
+  auto offline_memory_plans = metadata_.find(kOfflineMemoryAllocationMetadata);
+  if (offline_memory_plans != metadata_.end()) {
+    std::vector<std::vector<int32_t>> plans;
+    if (ParseOfflineMemoryPlans(offline_memory_plans->second,
+                                subgraphs->size(), &plans) != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter_,
+                           "Ignoring invalid offline memory plan.\n");
+    } else {
+      for (int i = 0; i < plans.size(); ++i) {
+        if (plans[i].empty()) continue;
+        if ((*interpreter)->subgraph(i)->SetOfflineMemoryPlan(
+                std::move(plans[i])) != kTfLiteOk) {
+          return cleanup_and_error();
+        }
+      }
+    }
+  }
+
   if (ShouldCreateLazyDelegateProviders(num_fp32_tensors_)) {
     (*interpreter)->lazy_delegate_providers_ =
         op_resolver_.GetDelegateCreators();
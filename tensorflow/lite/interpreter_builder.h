@@ -26,6 +26,7 @@ limitations under the License.
 #include "flatbuffers/flatbuffers.h"  // from @flatbuffers
 #include "tensorflow/lite/allocation.h"
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/constant_buffer_cache.h"
 #include "tensorflow/lite/core/api/error_reporter.h"
 #include "tensorflow/lite/core/api/op_resolver.h"
 #include "tensorflow/lite/core/interpreter.h"
@@ -104,6 +105,17 @@ class InterpreterBuilder {
   /// any Interpreter generated by this InterpreterBuilder.
   void AddDelegate(TfLiteDelegate* delegate);
 
+  /// Added by Alpa. Makes the read-only tensors of the interpreters generated
+  /// by operator() use the buffers in `cache` that have the same content, and
+  /// adds their other buffers to `cache`. Building the interpreters of several
+  /// models with the same cache keeps one copy of their identical weights.
+  /// The cache, and all the models added to it, must outlive the generated
+  /// interpreters.
+  /// WARNING: This is an experimental API and subject to change.
+  void SetConstantBufferCache(ConstantBufferCache* cache) {
+    constant_buffer_cache_ = cache;
+  }
+
  private:
   TfLiteStatus BuildLocalIndexToRegistrationMapping();
   TfLiteStatus ParseNodes(
@@ -138,6 +150,7 @@ class InterpreterBuilder {
   std::vector<TfLiteRegistration> unresolved_custom_ops_;
   std::vector<BuiltinOperator> flatbuffer_op_index_to_registration_types_;
   const Allocation* allocation_ = nullptr;
+  ConstantBufferCache* constant_buffer_cache_ = nullptr;  // Added by Alpa.
 
   bool has_flex_op_ = false;
   int num_fp32_tensors_ = 0;
@@ -84,19 +84,8 @@ bool Interpreter::HasDelegates() { return primary_subgraph().HasDelegates(); }
 TfLiteStatus Interpreter::SetBufferHandle(int tensor_index,
                                           TfLiteBufferHandle buffer_handle,
                                           TfLiteDelegate* delegate) {
-  TF_LITE_ENSURE(context_, tensor_index < tensors_size());
-  TfLiteTensor* tensor = primary_subgraph().tensor(tensor_index);
-
-  TF_LITE_ENSURE(context_,
-                 tensor->delegate == nullptr || tensor->delegate == delegate);
-  tensor->delegate = delegate;
-  if (tensor->buffer_handle != kTfLiteNullBufferHandle) {
-    TF_LITE_ENSURE_STATUS(TfLiteDelegateFreeBufferHandleInternal(
-        context_, tensor->delegate, &(tensor->buffer_handle)));
-  }
-  tensor->buffer_handle = buffer_handle;
-
-  return kTfLiteOk;
+  return primary_subgraph().SetBufferHandle(tensor_index, buffer_handle,
+                                            delegate);
 }
 
 TfLiteStatus Interpreter::GetBufferHandle(int tensor_index,
@@ -18,8 +18,13 @@ limitations under the License.
 #ifndef TENSORFLOW_LITE_INTERPRETER_OPTIONS_H_
 #define TENSORFLOW_LITE_INTERPRETER_OPTIONS_H_
 
+#include <memory>
+#include <utility>
+
 namespace tflite {
 
+class SharedArenaBuffer;
+
 /// Options class for `Interpreter`.
 /// WARNING: This is an experimental API and subject to change.
 class InterpreterOptions {
@@ -28,7 +33,8 @@ class InterpreterOptions {
       : experimental_preserve_all_tensors_(false),
         experimental_ensure_dynamic_tensors_are_released_(false),
         experimental_optimize_memory_for_large_tensors_(0),
-        experimental_disable_delegate_clustering_(false) {}
+        experimental_disable_delegate_clustering_(false),
+        experimental_parallel_execution_threads_(0) {}
 
   /// Preserving all intermediates tensors for debugging.
   /// WARNING: This is an experimental API and subject to change.
@@ -92,11 +98,50 @@ class InterpreterOptions {
     experimental_disable_delegate_clustering_ = value;
   }
 
+  // Added by Alpa. Makes the interpreter keep its non-persistent tensors,
+  // i.e. its inputs, outputs and intermediates, in `buffer`, shared with other
+  // interpreters that never run concurrently with it. The inputs of an
+  // interpreter must be set, and its outputs read, without invoking another
+  // interpreter sharing `buffer` in between. Delegates keeping pointers to the
+  // non-persistent tensors across invocations are not supported.
+  // WARNING: This is an experimental API and subject to change.
+  void SetSharedArenaBuffer(std::shared_ptr<SharedArenaBuffer> buffer) {
+    experimental_shared_arena_buffer_ = std::move(buffer);
+  }
+
+  // Added by Alpa. Returns the buffer set by SetSharedArenaBuffer(), if any.
+  // WARNING: This is an experimental API and subject to change.
+  const std::shared_ptr<SharedArenaBuffer>& GetSharedArenaBuffer() const {
+    return experimental_shared_arena_buffer_;
+  }
+
+  // Added by Alpa. Runs the nodes of the primary subgraph that do not depend
+  // on each other concurrently, on up to `num_threads` threads including the
+  // invoking one. The nodes are executed by waves of independent nodes, in an
+  // order planned by AllocateTensors(), and the kernels using the CPU backend
+  // context run single-threaded. Subgraphs with delegates, control flow ops,
+  // resource or variable tensors, or dynamic tensors, and invocations with a
+  // profiler, run sequentially. A value of 0 or 1 disables it.
+  // WARNING: This is an experimental API and subject to change.
+  void SetParallelExecutionThreads(int num_threads) {
+    experimental_parallel_execution_threads_ = num_threads;
+  }
+
+  // Added by Alpa. Returns the value set by SetParallelExecutionThreads().
+  // WARNING: This is an experimental API and subject to change.
+  int GetParallelExecutionThreads() const {
+    return experimental_parallel_execution_threads_;
+  }
+
  private:
   bool experimental_preserve_all_tensors_;
   bool experimental_ensure_dynamic_tensors_are_released_;
   int experimental_optimize_memory_for_large_tensors_;
   bool experimental_disable_delegate_clustering_;
+  // Added by Alpa.
+  std::shared_ptr<SharedArenaBuffer> experimental_shared_arena_buffer_;
+  // Added by Alpa.
+  int experimental_parallel_execution_threads_;
 };
 
 }  // namespace tflite
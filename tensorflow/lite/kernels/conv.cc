@@ -17,6 +17,8 @@ limitations under the License.
 #include <stddef.h>
 
 #include <cstdint>
+#include <memory>
+#include <numeric>
 #include <vector>
 
 // Only use multi-threaded Eigen if ruy is disabled.
@@ -37,8 +39,10 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/optimized/multithreaded_conv.h"
 #endif
 #include "tensorflow/lite/kernels/internal/optimized/optimized_ops.h"
+#include "tensorflow/lite/kernels/internal/optimized/sparse_ops/fully_connected.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/conv.h"
+#include "tensorflow/lite/kernels/internal/reference/densify.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
 #include "tensorflow/lite/kernels/internal/tensor.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
@@ -120,6 +124,21 @@ struct OpData {
 
   // Number of convolution groups.
   int32_t groups = 1;
+
+  // Added by Alpa. Whether the float pointwise convolution with a constant
+  // sparse filter is computed by the sparse fully-connected kernels, the
+  // filter being read with `pointwise_sparsity`, i.e. its sparsity without
+  // the dimensions of size 1.
+  bool use_sparse_pointwise_kernel = false;
+  TfLiteSparsity pointwise_sparsity = {};
+  std::vector<TfLiteDimensionMetadata> pointwise_dim_metadata;
+  std::unique_ptr<TfLiteIntArray, TfLiteIntArrayDeleter>
+      pointwise_traversal_order;
+  std::unique_ptr<TfLiteIntArray, TfLiteIntArrayDeleter> pointwise_block_map;
+  // Added by Alpa. Whether the kernels read any other constant sparse filter
+  // from `dense_filter`, its densified copy.
+  bool densify_filter = false;
+  std::vector<char> dense_filter;
 };
 
 inline PaddingType RuntimePaddingType(TfLitePadding padding) {
@@ -152,6 +171,136 @@ void Free(TfLiteContext* context, void* buffer) {
   delete reinterpret_cast<OpData*>(buffer);
 }
 
+// Added by Alpa. Builds in `data` the sparsity of the weights of the
+// fully-connected layer computing the pointwise convolution with the constant
+// 1x1 filter of `sparsity` and `channels_in` input channels. Returns false if
+// the sparse fully-connected kernels do not support the block pattern.
+bool BuildPointwiseSparsity(const TfLiteSparsity& sparsity, int channels_in,
+                            OpData* data) {
+  using optimized_ops::SparseWeightsBlock;
+  const TfLiteIntArray* traversal_order = sparsity.traversal_order;
+  const int num_block_dims =
+      sparsity.block_map != nullptr ? sparsity.block_map->size : 0;
+  if (traversal_order == nullptr ||
+      traversal_order->size != 4 + num_block_dims ||
+      sparsity.dim_metadata_size != traversal_order->size ||
+      sparsity.dim_metadata[1].format != kTfLiteDimDense ||
+      sparsity.dim_metadata[2].format != kTfLiteDimDense) {
+    return false;
+  }
+  for (int i = 0; i < traversal_order->size; ++i) {
+    if (traversal_order->data[i] != i) return false;
+  }
+  // The output and input channels are the rows and columns of the weights.
+  std::vector<int> block_map(num_block_dims);
+  for (int i = 0; i < num_block_dims; ++i) {
+    const int dim = sparsity.block_map->data[i];
+    if (dim != 0 && dim != 3) return false;
+    block_map[i] = dim == 0 ? 0 : 1;
+  }
+  data->pointwise_dim_metadata = {sparsity.dim_metadata[0],
+                                  sparsity.dim_metadata[3]};
+  for (int i = 4; i < sparsity.dim_metadata_size; ++i) {
+    data->pointwise_dim_metadata.push_back(sparsity.dim_metadata[i]);
+  }
+  std::vector<int> pointwise_traversal_order(2 + num_block_dims);
+  std::iota(pointwise_traversal_order.begin(), pointwise_traversal_order.end(),
+            0);
+  data->pointwise_traversal_order =
+      BuildTfLiteIntArray(pointwise_traversal_order);
+  data->pointwise_block_map = BuildTfLiteIntArray(block_map);
+  TfLiteSparsity& pointwise_sparsity = data->pointwise_sparsity;
+  pointwise_sparsity.traversal_order = data->pointwise_traversal_order.get();
+  pointwise_sparsity.block_map = data->pointwise_block_map.get();
+  pointwise_sparsity.dim_metadata = data->pointwise_dim_metadata.data();
+  pointwise_sparsity.dim_metadata_size = data->pointwise_dim_metadata.size();
+
+  const SparseWeightsBlock block =
+      optimized_ops::GetSparseWeightsBlock(pointwise_sparsity);
+  if (block != SparseWeightsBlock::kRandom &&
+      block != SparseWeightsBlock::k1x4 && block != SparseWeightsBlock::k4x4) {
+    return false;
+  }
+  // The kernels read the inputs at the column indices unchecked.
+  const int block_cols = block == SparseWeightsBlock::kRandom ? 1 : 4;
+  const TfLiteIntArray* indices =
+      pointwise_sparsity.dim_metadata[1].array_indices;
+  for (int i = 0; i < indices->size; ++i) {
+    if (indices->data[i] < 0 ||
+        (indices->data[i] + 1) * block_cols > channels_in) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Added by Alpa. Decides how the kernels read a constant sparse `filter`:
+// through the sparse fully-connected kernels for the float pointwise
+// convolutions sparse enough for them to be faster, or densified as no
+// convolution kernel reads sparse filters.
+TfLiteStatus PrepareSparseFilter(KernelType kernel_type, TfLiteContext* context,
+                                 const TfLiteConvParams* params,
+                                 const TfLiteTensor* input,
+                                 const TfLiteTensor* filter, OpData* data) {
+  data->use_sparse_pointwise_kernel = false;
+  data->densify_filter = false;
+  if (filter->sparsity == nullptr) {
+    data->dense_filter.clear();
+    return kTfLiteOk;
+  }
+  TF_LITE_ENSURE_MSG(context, IsConstantTensor(filter),
+                     "Sparse filters must be constant.");
+  TF_LITE_ENSURE_MSG(
+      context,
+      filter->type == kTfLiteFloat32 || filter->type == kTfLiteInt8,
+      "Sparse filters must be float32 or int8.");
+  const bool is_pointwise =
+      filter->dims->data[1] == 1 && filter->dims->data[2] == 1 &&
+      params->stride_width == 1 && params->stride_height == 1 &&
+      params->dilation_width_factor == 1 &&
+      params->dilation_height_factor == 1 && data->groups == 1;
+  if (kernel_type != kReference && is_pointwise &&
+      input->type == kTfLiteFloat32 && filter->type == kTfLiteFloat32 &&
+      optimized_ops::PreferSparseWeights(filter->bytes / sizeof(float),
+                                         NumElements(filter)) &&
+      BuildPointwiseSparsity(*filter->sparsity, filter->dims->data[3], data)) {
+    data->use_sparse_pointwise_kernel = true;
+    data->dense_filter.clear();
+    return kTfLiteOk;
+  }
+  data->densify_filter = true;
+  return kTfLiteOk;
+}
+
+// Added by Alpa. Densifies the constant sparse `filter` into
+// `data->dense_filter` the first time it is needed.
+TfLiteStatus DensifyFilter(TfLiteContext* context, const TfLiteTensor* filter,
+                           OpData* data) {
+  if (!data->dense_filter.empty()) return kTfLiteOk;
+  const RuntimeShape filter_shape = GetTensorShape(filter);
+  data->dense_filter.resize(filter_shape.FlatSize() *
+                            TfLiteTypeGetSize(filter->type));
+  switch (filter->type) {
+    case kTfLiteFloat32:
+      reference_ops::Densify(
+          filter->sparsity, filter_shape, GetTensorData<float>(filter),
+          filter_shape, reinterpret_cast<float*>(data->dense_filter.data()),
+          context);
+      break;
+    case kTfLiteInt8:
+      reference_ops::Densify(
+          filter->sparsity, filter_shape, GetTensorData<int8_t>(filter),
+          filter_shape, reinterpret_cast<int8_t*>(data->dense_filter.data()),
+          context);
+      break;
+    default:
+      TF_LITE_KERNEL_LOG(context, "Type %s not supported for densification.",
+                         TfLiteTypeGetName(filter->type));
+      return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
 // Naive implementation of transpose for floats. Could be optimized to be more
 // cache friendly, but for now it's a one-time cost on first run, and we would
 // prefer to remove the need to do this at all eventually.
@@ -417,14 +566,20 @@ TfLiteStatus Prepare(KernelType kernel_type, TfLiteContext* context,
     }
   }
 
+  TF_LITE_ENSURE_STATUS(
+      PrepareSparseFilter(kernel_type, context, params, input, filter, data));
+
   // The multi-threaded kernel supports neither dilation nor hybrid kernels, and
   // is incompatible with mutable input filters that might change between evals.
+  // Added by Alpa. Reading a sparse pointwise filter as HWCN weights would
+  // overrun it.
   data->supports_multithreaded_kernel =
       (kernel_type == kMultithreadOptimized) &&
       (context->recommended_num_threads != 1) && !is_hybrid &&
       (params->dilation_width_factor == 1) &&
       (params->dilation_height_factor == 1) &&
-      (filter->allocation_type != kTfLiteArenaRw) && !IsDynamicTensor(filter);
+      (filter->allocation_type != kTfLiteArenaRw) && !IsDynamicTensor(filter) &&
+      !data->use_sparse_pointwise_kernel;
 
   int channels_in = filter->dims->data[3];
   int channels_out = filter->dims->data[0];
@@ -848,6 +1003,55 @@ void EvalQuantizedPerChannel16x8(TfLiteContext* context, TfLiteNode* node,
   }
 }
 
+// Added by Alpa. Computes the float pointwise convolution with a sparse
+// filter as a fully-connected layer over all the pixels.
+void EvalSparsePointwiseFloat(TfLiteContext* context, const OpData* data,
+                              float output_activation_min,
+                              float output_activation_max,
+                              const TfLiteTensor* input,
+                              const TfLiteTensor* filter,
+                              const TfLiteTensor* bias, TfLiteTensor* output) {
+  using optimized_ops::SparseWeightsBlock;
+  const int channels_in = filter->dims->data[3];
+  const int channels_out = filter->dims->data[0];
+  const int num_pixels = NumElements(input) / channels_in;
+  FullyConnectedParams op_params;
+  op_params.float_activation_min = output_activation_min;
+  op_params.float_activation_max = output_activation_max;
+  const RuntimeShape input_shape({num_pixels, channels_in});
+  const RuntimeShape filter_shape({channels_out, channels_in});
+  const RuntimeShape output_shape({num_pixels, channels_out});
+  const TfLiteSparsity& sparsity = data->pointwise_sparsity;
+  CpuBackendContext* cpu_backend_context =
+      CpuBackendContext::GetFromContext(context);
+  switch (optimized_ops::GetSparseWeightsBlock(sparsity)) {
+    case SparseWeightsBlock::kRandom:
+      optimized_ops::FullyConnectedSparseWeight(
+          sparsity, op_params, input_shape, GetTensorData<float>(input),
+          filter_shape, GetTensorData<float>(filter), GetTensorShape(bias),
+          GetTensorData<float>(bias), output_shape,
+          GetTensorData<float>(output));
+      break;
+    case SparseWeightsBlock::k1x4:
+      optimized_ops::FullyConnectedSparseWeight1x4(
+          sparsity, op_params, input_shape, GetTensorData<float>(input),
+          filter_shape, GetTensorData<float>(filter), GetTensorShape(bias),
+          GetTensorData<float>(bias), output_shape,
+          GetTensorData<float>(output), cpu_backend_context);
+      break;
+    case SparseWeightsBlock::k4x4:
+      optimized_ops::FullyConnectedSparseWeight4x4(
+          sparsity, op_params, input_shape, GetTensorData<float>(input),
+          filter_shape, GetTensorData<float>(filter), GetTensorShape(bias),
+          GetTensorData<float>(bias), output_shape,
+          GetTensorData<float>(output), cpu_backend_context);
+      break;
+    default:
+      // The block pattern was checked in Prepare().
+      TFLITE_DCHECK(false);
+  }
+}
+
 template <KernelType kernel_type>
 void EvalFloat(TfLiteContext* context, TfLiteNode* node,
                TfLiteConvParams* params, OpData* data,
@@ -857,6 +1061,12 @@ void EvalFloat(TfLiteContext* context, TfLiteNode* node,
   float output_activation_min, output_activation_max;
   CalculateActivationRange(params->activation, &output_activation_min,
                            &output_activation_max);
+  if (data->use_sparse_pointwise_kernel) {
+    EvalSparsePointwiseFloat(context, data, output_activation_min,
+                             output_activation_max, input, filter, bias,
+                             output);
+    return;
+  }
   KernelType effective_kernel_type = kernel_type;
   // Fall back to the optimized path if multi-threaded conv is unsupported.
   if ((kernel_type == kMultithreadOptimized) &&
@@ -1149,6 +1359,16 @@ TfLiteStatus EvalImpl(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE_OK(context, GetInputSafe(context, node, 1, &filter));
   bool has_bias = node->inputs->size == 3;
   const TfLiteTensor* bias = has_bias ? GetInput(context, node, 2) : nullptr;
+  // Added by Alpa. The kernels read densified filters like dense filters.
+  TfLiteTensor dense_filter;
+  if (data->densify_filter) {
+    TF_LITE_ENSURE_OK(context, DensifyFilter(context, filter, data));
+    dense_filter = *filter;
+    dense_filter.data.raw = data->dense_filter.data();
+    dense_filter.bytes = data->dense_filter.size();
+    dense_filter.sparsity = nullptr;
+    filter = &dense_filter;
+  }
   TfLiteTensor* im2col =
       data->need_im2col
           ? &context->tensors[node->temporaries->data[data->im2col_index]]
@@ -145,6 +145,43 @@ class ConvolutionOpModel : public BaseConvolutionOpModel<float> {
   std::vector<float> GetOutput() { return ExtractVector<float>(output_); }
 };
 
+class SparseConvolutionOpModel : public SingleOpModel {
+ public:
+  SparseConvolutionOpModel(TfLiteRegistration* registration,
+                           const TensorData& input, const TensorData& filter,
+                           const std::vector<float>& filter_data,
+                           int stride_width = 1, int stride_height = 1) {
+    input_ = AddInput(input);
+    filter_ = AddConstSparseInput(filter, filter_data);
+    bias_ = AddInput({TensorType_FLOAT32, {filter.shape[0]}});
+    output_ = AddOutput({TensorType_FLOAT32, {}});
+
+    SetBuiltinOp(BuiltinOperator_CONV_2D, BuiltinOptions_Conv2DOptions,
+                 CreateConv2DOptions(builder_, Padding_VALID, stride_width,
+                                     stride_height, ActivationFunctionType_NONE)
+                     .Union());
+
+    resolver_ = std::make_unique<SingleOpResolver>(BuiltinOperator_CONV_2D,
+                                                   registration);
+    BuildInterpreter({GetShape(input_), GetShape(filter_), GetShape(bias_)},
+                     /*num_threads=*/-1, /*allow_fp32_relax_to_fp16=*/false,
+                     /*apply_delegate=*/false);
+  }
+
+  void SetBias(std::initializer_list<float> f) { PopulateTensor(bias_, f); }
+
+  void SetInput(std::initializer_list<float> data) {
+    PopulateTensor(input_, data);
+  }
+  std::vector<float> GetOutput() { return ExtractVector<float>(output_); }
+
+ private:
+  int input_;
+  int filter_;
+  int bias_;
+  int output_;
+};
+
 const auto kKernelMap = new std::map<string, TfLiteRegistration*>({
     {"Reference", ops::builtin::Register_CONVOLUTION_REF()},
     {"GenericOptimized", ops::builtin::Register_CONVOLUTION_GENERIC_OPT()},
@@ -478,6 +515,76 @@ TEST_P(ConvolutionOpTest, PointwiseFloat32) {
                              }));
 }
 
+TEST_P(ConvolutionOpTest, SparsePointwiseFloat32) {
+  // Blocks of 1x4 input channels, three quarters of which are zeros.
+  TensorData filter = {TensorType_FLOAT32, {4, 1, 1, 8}};
+  filter.traversal_order = {0, 1, 2, 3, 4};
+  filter.format = {kTfLiteDimDense, kTfLiteDimDense, kTfLiteDimDense,
+                   kTfLiteDimSparseCSR};
+  filter.block_map = {3};
+  filter.block_size = {4};
+  SparseConvolutionOpModel m(GetRegistration(),
+                             {TensorType_FLOAT32, {1, 2, 2, 8}}, filter,
+                             {
+                                 0, 0, 0, 0, 1, 2, 3, 4,    // first filter
+                                 0, 0, 0, 0, 0, 0, 0, 0,    // second filter
+                                 0, 0, 0, 0, 0, 0, 0, 0,    // third filter
+                                 -1, 1, -1, 1, 0, 0, 0, 0,  // fourth filter
+                             });
+
+  m.SetInput({
+      1, 2, 3, 4, 5, 6, 7, 8,        // row = 1, left
+      1, 1, 1, 1, 1, 1, 1, 1,        // row = 1, right
+      0, 1, 0, 1, 0, 1, 0, 1,        // row = 2, left
+      -1, -2, -3, -4, 4, 3, 2, 1,    // row = 2, right
+  });
+  m.SetBias({1, 2, 3, 4});
+
+  ASSERT_EQ(m.Invoke(), kTfLiteOk);
+
+  EXPECT_THAT(m.GetOutput(), ElementsAreArray({
+                                 71, 2, 3, 6,  // row = 1, left
+                                 11, 2, 3, 4,  // row = 1, right
+                                 7, 2, 3, 6,   // row = 2, left
+                                 21, 2, 3, 2,  // row = 2, right
+                             }));
+}
+
+TEST_P(ConvolutionOpTest, SparseFilterFloat32) {
+  // The same convolution as SimpleTestFloat32, with a sparse filter.
+  TensorData filter = {TensorType_FLOAT32, {3, 2, 2, 1}};
+  filter.traversal_order = {0, 1, 2, 3};
+  filter.format = {kTfLiteDimDense, kTfLiteDimSparseCSR, kTfLiteDimDense,
+                   kTfLiteDimDense};
+  SparseConvolutionOpModel m(GetRegistration(),
+                             {TensorType_FLOAT32, {2, 2, 4, 1}}, filter,
+                             {
+                                 1, 2, 3, 4,    // first 2x2 filter
+                                 -1, 1, -1, 1,  // second 2x2 filter
+                                 -1, -1, 1, 1,  // third 2x2 filter
+                             },
+                             /*stride_width=*/2, /*stride_height=*/2);
+
+  m.SetInput({
+      // First batch
+      1, 1, 1, 1,  // row = 1
+      2, 2, 2, 2,  // row = 2
+      // Second batch
+      1, 2, 3, 4,  // row = 1
+      1, 2, 3, 4,  // row = 2
+  });
+  m.SetBias({1, 2, 3});
+
+  ASSERT_EQ(m.Invoke(), kTfLiteOk);
+
+  EXPECT_THAT(m.GetOutput(), ElementsAreArray({
+                                 18, 2, 5,  // first batch, left
+                                 18, 2, 5,  // first batch, right
+                                 17, 4, 3,  // second batch, left
+                                 37, 4, 3,  // second batch, right
+                             }));
+}
+
 // TODO(alanchiao): this passes locally, but fails on continuous build system.
 // Re-enable when root cause found.
 TEST_P(ConvolutionOpTest, DISABLED_PointwiseMultifilterFloat32) {
@@ -18,6 +18,7 @@ limitations under the License.
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
@@ -25,6 +26,7 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/optimized/optimized_ops.h"
 #include "tensorflow/lite/kernels/internal/optimized/sparse_ops/fully_connected.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/densify.h"
 #include "tensorflow/lite/kernels/internal/reference/fully_connected.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
 #include "tensorflow/lite/kernels/internal/reference/reference_ops.h"
@@ -52,6 +54,8 @@ bool SupportedSparsityFormat(const TfLiteSparsity& sparsity) {
 
 static const int kDimMetadataSizeRandomSparse = 2;
 static const int kDimMetadataSizeBlockSparse = 3;
+// Added by Alpa. Sparse weights blocked along both dimensions.
+static const int kDimMetadataSizeBlockSparse4x4 = 4;
 
 TfLiteStatus CreateLedgerTensor(const TfLiteSparsity* sparsity,
                                 TfLiteContext* context, TfLiteTensor* ledger) {
@@ -121,6 +125,20 @@ struct OpData {
   bool compute_row_sums = false;
   // Only used for sparse hybrid fully connected kernels.
   bool ledger_initialized;
+  // Added by Alpa. Whether the optimized kernel reads constant sparse weights
+  // from `dense_filter`, their densified copy, because no sparse kernel
+  // multiplies them faster than the dense kernels.
+  bool densify_filter = false;
+  std::vector<char> dense_filter;
+  // Added by Alpa. Whether the float activations are multiplied by int8 or
+  // int4 weights directly (see IsWeightOnlyQuantized). The weights of each
+  // output channel are split into groups of `weight_group_size` values, each
+  // with its scale and zero point; `weight_zero_points` is empty when they
+  // are all zero.
+  bool weight_only = false;
+  int weight_group_size = 0;
+  std::vector<float> weight_scales;
+  std::vector<int32_t> weight_zero_points;
 };
 
 constexpr int kInputTensor = 0;
@@ -135,7 +153,8 @@ inline TfLiteStatus CheckTypes(TfLiteContext* context,
                                const TfLiteTensor* bias, TfLiteTensor* output,
                                TfLiteFullyConnectedParams* params) {
   const bool is_quantized =
-      ((filter->type == kTfLiteUInt8) || (filter->type == kTfLiteInt8));
+      ((filter->type == kTfLiteUInt8) || (filter->type == kTfLiteInt8) ||
+       (filter->type == kTfLiteInt4));
   const bool is_hybrid = is_quantized && (input->type == kTfLiteFloat32);
   const bool is_shuffled =
       is_quantized && (params->weights_format ==
@@ -154,9 +173,13 @@ inline TfLiteStatus CheckTypes(TfLiteContext* context,
       TF_LITE_ENSURE_EQ(context, is_optional_bias_int, true);
     } else if (is_hybrid) {
       TF_LITE_ENSURE_TYPES_EQ(context, input->type, kTfLiteFloat32);
+      TF_LITE_ENSURE(context, filter->sparsity == nullptr ||
+                                  filter->type != kTfLiteInt4);
       TF_LITE_ENSURE_TYPES_EQ(context, output->type, kTfLiteFloat32);
       TF_LITE_ENSURE_EQ(context, is_optional_bias_float, true);
     } else {
+      // int4 weights are only supported with float activations.
+      TF_LITE_ENSURE(context, filter->type != kTfLiteInt4);
       TF_LITE_ENSURE(context, input->type == kTfLiteUInt8 ||
                                   input->type == kTfLiteInt8 ||
                                   input->type == kTfLiteInt16);
@@ -176,6 +199,84 @@ inline TfLiteStatus CheckTypes(TfLiteContext* context,
   return kTfLiteOk;
 }
 
+// Added by Alpa. Returns whether a layer with float activations has weight-only
+// quantized weights: dense int4 weights, or dense int8 weights with a scale per
+// output channel or per group of input channels. Those are multiplied with the
+// float activations directly, whereas the hybrid kernels quantize the
+// activations and only support a single weight scale.
+bool IsWeightOnlyQuantized(const TfLiteTensor* input,
+                           const TfLiteTensor* filter) {
+  if (input->type != kTfLiteFloat32 || filter->sparsity != nullptr) {
+    return false;
+  }
+  if (filter->type == kTfLiteInt4) return true;
+  if (filter->type != kTfLiteInt8 ||
+      filter->quantization.type != kTfLiteAffineQuantization) {
+    return false;
+  }
+  const auto* affine_quantization =
+      reinterpret_cast<const TfLiteAffineQuantization*>(
+          filter->quantization.params);
+  return affine_quantization && affine_quantization->scale &&
+         affine_quantization->scale->size > 1;
+}
+
+// Added by Alpa. Fills the weight-only quantization parameters of `data` from
+// the affine quantization of `filter`. The scales may hold one value for the
+// whole tensor, one per output channel or, for grouped quantization,
+// num_units * groups values in row-major order, where every group covers
+// accum_depth / groups consecutive input channels.
+TfLiteStatus PrepareWeightOnly(TfLiteContext* context,
+                               const TfLiteTensor* filter, OpData* data) {
+  TF_LITE_ENSURE_EQ(context, filter->quantization.type,
+                    kTfLiteAffineQuantization);
+  const auto* affine_quantization =
+      reinterpret_cast<const TfLiteAffineQuantization*>(
+          filter->quantization.params);
+  TF_LITE_ENSURE(context, affine_quantization);
+  TF_LITE_ENSURE(context, affine_quantization->scale);
+  const int num_units = SizeOfDimension(filter, 0);
+  const int accum_depth = SizeOfDimension(filter, 1);
+  const int num_scales = affine_quantization->scale->size;
+  int groups = 1;
+  if (num_scales > 1) {
+    TF_LITE_ENSURE_EQ(context, affine_quantization->quantized_dimension, 0);
+    TF_LITE_ENSURE(context, num_units > 0);
+    TF_LITE_ENSURE_EQ(context, num_scales % num_units, 0);
+    groups = num_scales / num_units;
+    TF_LITE_ENSURE_EQ(context, accum_depth % groups, 0);
+  }
+  const int group_size = accum_depth / groups;
+  if (filter->type == kTfLiteInt4) {
+    // Every group has to start on a byte of the packed weights.
+    TF_LITE_ENSURE_EQ(context, group_size % 2, 0);
+  }
+  const TfLiteIntArray* zero_points = affine_quantization->zero_point;
+  if (zero_points) {
+    TF_LITE_ENSURE(context, zero_points->size == 1 ||
+                                zero_points->size == num_scales);
+  }
+
+  data->weight_only = true;
+  data->weight_group_size = group_size;
+  data->weight_scales.resize(num_units * groups);
+  data->weight_zero_points.clear();
+  bool has_zero_points = false;
+  for (int i = 0; zero_points && i < zero_points->size; ++i) {
+    has_zero_points |= zero_points->data[i] != 0;
+  }
+  if (has_zero_points) data->weight_zero_points.resize(num_units * groups);
+  for (int i = 0; i < num_units * groups; ++i) {
+    const int index = num_scales == 1 ? 0 : i;
+    data->weight_scales[i] = affine_quantization->scale->data[index];
+    if (has_zero_points) {
+      data->weight_zero_points[i] =
+          zero_points->data[zero_points->size == 1 ? 0 : index];
+    }
+  }
+  return kTfLiteOk;
+}
+
 void* Init(TfLiteContext* context, const char* buffer, size_t length) {
   // This is a builtin op, so we don't use the contents in 'buffer', if any.
   // Instead, we allocate a new object to carry information from Prepare() to
@@ -190,6 +291,69 @@ void Free(TfLiteContext* context, void* buffer) {
   delete reinterpret_cast<OpData*>(buffer);
 }
 
+// Added by Alpa. Returns whether the optimized kernels should multiply the
+// densified copy of the constant sparse `filter`, i.e. when no sparse kernel
+// supports its block pattern and types, or when it is not sparse enough for
+// the sparse kernels to be faster.
+bool ShouldDensifyFilter(const OpData* data, const TfLiteTensor* filter,
+                         const TfLiteTensor* output) {
+  using optimized_ops::SparseWeightsBlock;
+  if (filter->sparsity == nullptr || !IsConstantTensor(filter)) return false;
+  const SparseWeightsBlock block =
+      optimized_ops::GetSparseWeightsBlock(*filter->sparsity);
+  bool supported;
+  switch (filter->type) {
+    case kTfLiteFloat32:
+      supported = block == SparseWeightsBlock::kRandom ||
+                  block == SparseWeightsBlock::k1x4 ||
+                  block == SparseWeightsBlock::k4x4;
+      break;
+    case kTfLiteInt8:
+      supported = output->type == kTfLiteInt8 &&
+                  filter->params.zero_point == 0 &&
+                  data->per_channel_output_multiplier.size() <= 1 &&
+                  (block == SparseWeightsBlock::k1x4 ||
+                   block == SparseWeightsBlock::k1x16);
+      break;
+    default:
+      // Only float and int8 weights are densified.
+      return false;
+  }
+  const int64_t num_stored_values =
+      filter->bytes / TfLiteTypeGetSize(filter->type);
+  return !supported || !optimized_ops::PreferSparseWeights(
+                           num_stored_values, NumElements(filter));
+}
+
+// Added by Alpa. Densifies the constant sparse `filter` into
+// `data->dense_filter` the first time it is needed.
+TfLiteStatus DensifyFilter(TfLiteContext* context, const TfLiteTensor* filter,
+                           OpData* data) {
+  if (!data->dense_filter.empty()) return kTfLiteOk;
+  const RuntimeShape filter_shape = GetTensorShape(filter);
+  data->dense_filter.resize(filter_shape.FlatSize() *
+                            TfLiteTypeGetSize(filter->type));
+  switch (filter->type) {
+    case kTfLiteFloat32:
+      reference_ops::Densify(
+          filter->sparsity, filter_shape, GetTensorData<float>(filter),
+          filter_shape, reinterpret_cast<float*>(data->dense_filter.data()),
+          context);
+      break;
+    case kTfLiteInt8:
+      reference_ops::Densify(
+          filter->sparsity, filter_shape, GetTensorData<int8_t>(filter),
+          filter_shape, reinterpret_cast<int8_t*>(data->dense_filter.data()),
+          context);
+      break;
+    default:
+      TF_LITE_KERNEL_LOG(context, "Type %s not supported for densification.",
+                         TfLiteTypeGetName(filter->type));
+      return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
 TfLiteStatus PrepareImpl(TfLiteContext* context, TfLiteNode* node) {
   auto* params =
       reinterpret_cast<TfLiteFullyConnectedParams*>(node->builtin_data);
@@ -332,9 +496,15 @@ TfLiteStatus PrepareImpl(TfLiteContext* context, TfLiteNode* node) {
   // buffer to store the intermediate quantized values.
   // Additionally, we allocate a temporary buffer to store the accumulated
   // quantized values prior to multiplication by the scaling factor.
+  const bool is_weight_only = IsWeightOnlyQuantized(input, filter);
+  data->weight_only = false;
+  if (is_weight_only) {
+    TF_LITE_ENSURE_STATUS(PrepareWeightOnly(context, filter, data));
+  }
   const bool is_hybrid =
       (input->type == kTfLiteFloat32 &&
-       (filter->type == kTfLiteUInt8 || filter->type == kTfLiteInt8));
+       (filter->type == kTfLiteUInt8 || filter->type == kTfLiteInt8)) &&
+      !is_weight_only;
   const bool is_sparse = filter->sparsity != nullptr;
   if (is_hybrid) {
     TfLiteIntArrayFree(node->temporaries);
@@ -452,6 +622,7 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   // Check for supported activation types.
   auto* params =
       reinterpret_cast<TfLiteFullyConnectedParams*>(node->builtin_data);
+  OpData* data = reinterpret_cast<OpData*>(node->user_data);
   const TfLiteTensor* filter;
   TF_LITE_ENSURE_OK(context,
                     GetInputSafe(context, node, kWeightsTensor, &filter));
@@ -459,7 +630,8 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE_OK(context, GetInputSafe(context, node, kInputTensor, &input));
   const bool is_quantized =
       ((filter->type == kTfLiteUInt8) || (filter->type == kTfLiteInt8));
-  const bool is_hybrid = is_quantized && (input->type == kTfLiteFloat32);
+  const bool is_hybrid = is_quantized && (input->type == kTfLiteFloat32) &&
+                         !IsWeightOnlyQuantized(input, filter);
   const bool is_pie = kernel_type == kLegacyPie;
 
   // Pie and hybrid path supports all kinds of fused activations, otherwise only
@@ -470,7 +642,17 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
                                 params->activation == kTfLiteActReluN1To1 ||
                                 params->activation == kTfLiteActRelu6);
   }
-  return PrepareImpl(context, node);
+  TF_LITE_ENSURE_STATUS(PrepareImpl(context, node));
+
+  // Added by Alpa. The hybrid kernels and the reference kernels always read
+  // the sparse weights.
+  TfLiteTensor* output;
+  TF_LITE_ENSURE_OK(context,
+                    GetOutputSafe(context, node, kOutputTensor, &output));
+  data->densify_filter = kernel_type == kGenericOptimized && !is_hybrid &&
+                         ShouldDensifyFilter(data, filter, output);
+  if (!data->densify_filter) data->dense_filter.clear();
+  return kTfLiteOk;
 }
 
 TfLiteStatus EvalPie(TfLiteContext* context, TfLiteNode* node,
@@ -1030,6 +1212,16 @@ TfLiteStatus EvalQuantized(TfLiteContext* context, TfLiteNode* node,
                 GetTensorData<int32_t>(bias), output_shape,
                 GetTensorData<int8_t>(output),
                 CpuBackendContext::GetFromContext(context));
+          } else if (sparsity.dim_metadata_size ==
+                         kDimMetadataSizeBlockSparse &&
+                     sparsity.dim_metadata[2].dense_size == 4) {
+            // Added by Alpa. Block sparse with block size of 1x4.
+            optimized_ops::FullyConnectedSparseWeight1x4(
+                sparsity, op_params, input_shape, GetTensorData<int8_t>(input),
+                filter_shape, GetTensorData<int8_t>(filter), bias_shape,
+                GetTensorData<int32_t>(bias), output_shape,
+                GetTensorData<int8_t>(output),
+                CpuBackendContext::GetFromContext(context));
           } else {
             TF_LITE_KERNEL_LOG(
                 context, "Unsupported sparse fully-connected weight format.");
@@ -1221,6 +1413,17 @@ TfLiteStatus EvalFloat(TfLiteContext* context, TfLiteNode* node,
             bias_shape, GetTensorData<float>(bias),      // Disable formatting
             output_shape, GetTensorData<float>(output),
             CpuBackendContext::GetFromContext(context));
+      } else if (sparsity.dim_metadata_size == kDimMetadataSizeBlockSparse4x4 &&
+                 optimized_ops::GetSparseWeightsBlock(sparsity) ==
+                     optimized_ops::SparseWeightsBlock::k4x4) {
+        // Added by Alpa. Block sparse with block size of 4x4.
+        optimized_ops::FullyConnectedSparseWeight4x4(
+            sparsity, op_params,                         // Disable formatting
+            input_shape, GetTensorData<float>(input),    // Disable formatting
+            filter_shape, GetTensorData<float>(filter),  // Disable formatting
+            bias_shape, GetTensorData<float>(bias),      // Disable formatting
+            output_shape, GetTensorData<float>(output),
+            CpuBackendContext::GetFromContext(context));
       } else {
         TF_LITE_KERNEL_LOG(context,
                            "Unsupported sparse fully-connected weight format.");
@@ -1242,6 +1445,42 @@ TfLiteStatus EvalFloat(TfLiteContext* context, TfLiteNode* node,
   return kTfLiteOk;
 }
 
+// Added by Alpa. Evaluates a layer with weight-only quantized weights on its
+// float activations.
+template <KernelType kernel_type>
+TfLiteStatus EvalWeightOnly(TfLiteContext* context, TfLiteNode* node,
+                            TfLiteFullyConnectedParams* params, OpData* data,
+                            const TfLiteTensor* input,
+                            const TfLiteTensor* filter,
+                            const TfLiteTensor* bias, TfLiteTensor* output) {
+  FullyConnectedParams op_params;
+  CalculateActivationRange(params->activation, &op_params.float_activation_min,
+                           &op_params.float_activation_max);
+  const bool weights_are_int4 = filter->type == kTfLiteInt4;
+  const int32_t* zero_points = data->weight_zero_points.empty()
+                                   ? nullptr
+                                   : data->weight_zero_points.data();
+  if (kernel_type == kGenericOptimized) {
+    optimized_ops::FullyConnectedWeightOnly(
+        op_params, GetTensorShape(input), GetTensorData<float>(input),
+        GetTensorShape(filter), GetTensorData<int8_t>(filter),
+        weights_are_int4, data->weight_scales.data(), zero_points,
+        data->weight_group_size, GetTensorShape(bias),
+        GetTensorData<float>(bias), GetTensorShape(output),
+        GetTensorData<float>(output),
+        CpuBackendContext::GetFromContext(context));
+  } else {
+    reference_ops::FullyConnectedWeightOnly(
+        op_params, GetTensorShape(input), GetTensorData<float>(input),
+        GetTensorShape(filter), GetTensorData<int8_t>(filter),
+        weights_are_int4, data->weight_scales.data(), zero_points,
+        data->weight_group_size, GetTensorShape(bias),
+        GetTensorData<float>(bias), GetTensorShape(output),
+        GetTensorData<float>(output));
+  }
+  return kTfLiteOk;
+}
+
 template <KernelType kernel_type>
 TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   auto* params =
@@ -1270,6 +1509,22 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
     return kTfLiteOk;
   }
 
+  // Added by Alpa. The kernels read densified weights like dense weights.
+  TfLiteTensor dense_filter;
+  if (data->densify_filter) {
+    TF_LITE_ENSURE_OK(context, DensifyFilter(context, filter, data));
+    dense_filter = *filter;
+    dense_filter.data.raw = data->dense_filter.data();
+    dense_filter.bytes = data->dense_filter.size();
+    dense_filter.sparsity = nullptr;
+    filter = &dense_filter;
+  }
+
+  if (data->weight_only) {
+    return EvalWeightOnly<kernel_type>(context, node, params, data, input,
+                                       filter, bias, output);
+  }
+
   switch (filter->type) {
     case kTfLiteFloat32:
       return EvalFloat<kernel_type>(context, node, params, data, input, filter,
@@ -1334,6 +1334,167 @@ TEST(HybridAsymmetricInputFullyConnectedOpTest, SimpleTestQuantizedInt8) {
                                  /*max_abs_error=*/1.3f)));
 }
 
+// Added by Alpa. Float inputs with constant int8 or int4 weights that have a
+// scale per output channel or per group of input channels.
+class WeightOnlyFullyConnectedOpModel : public SingleOpModel {
+ public:
+  WeightOnlyFullyConnectedOpModel(TfLiteRegistration* registration, int units,
+                                  int batches, int input_size,
+                                  const TensorData& weights,
+                                  const std::vector<int8_t>& weights_data,
+                                  int num_threads = 1) {
+    input_ = AddInput({TensorType_FLOAT32, {batches, input_size}});
+    weights_ =
+        AddConstInput(weights, weights_data.data(), weights_data.size());
+    bias_ = AddInput({TensorType_FLOAT32, {units}});
+    output_ = AddOutput({TensorType_FLOAT32});
+
+    SetBuiltinOp(
+        BuiltinOperator_FULLY_CONNECTED, BuiltinOptions_FullyConnectedOptions,
+        CreateFullyConnectedOptions(builder_, ActivationFunctionType_NONE)
+            .Union());
+    resolver_ = std::make_unique<SingleOpResolver>(
+        BuiltinOperator_FULLY_CONNECTED, registration);
+    BuildInterpreter({GetShape(input_), GetShape(weights_), GetShape(bias_)},
+                     num_threads, /*allow_fp32_relax_to_fp16=*/false,
+                     /*apply_delegate=*/false);
+  }
+
+  void SetBias(const std::vector<float>& f) { PopulateTensor(bias_, f); }
+  void SetInput(const std::vector<float>& f) { PopulateTensor(input_, f); }
+  std::vector<float> GetOutput() { return ExtractVector<float>(output_); }
+  std::vector<int> GetOutputShape() { return GetTensorShape(output_); }
+
+ protected:
+  int input_;
+  int weights_;
+  int bias_;
+  int output_;
+};
+
+class WeightOnlyFullyConnectedOpTest : public SingleOpTest {
+ protected:
+  const std::map<string, TfLiteRegistration*>& GetKernelMap() override {
+    return *kKernelMap;
+  }
+};
+
+TEST_P(WeightOnlyFullyConnectedOpTest, GroupedInt8WithZeroPoints) {
+  // Two groups of two input channels per output channel.
+  WeightOnlyFullyConnectedOpModel m(
+      GetRegistration(), /*units=*/2, /*batches=*/2, /*input_size=*/4,
+      /*weights=*/
+      {TensorType_INT8, {2, 4}, 0, 0, 0, 0, /*per_channel_quantization=*/true,
+       /*per_channel_quantization_scales=*/{0.5, 1.0, 2.0, 0.25},
+       /*per_channel_quantization_offsets=*/{0, 1, 0, -1},
+       /*channel_index=*/0},
+      /*weights_data=*/{1, 2, 3, 4, -1, -2, 2, 1});
+  m.SetBias({1, 2});
+  m.SetInput({
+      1, 1, 1, 1,  // b = 0
+      1, 2, 3, 4,  // b = 1
+  });
+
+  ASSERT_EQ(m.Invoke(), kTfLiteOk);
+
+  EXPECT_THAT(m.GetOutputShape(), ElementsAre(2, 2));
+  EXPECT_THAT(m.GetOutput(),
+              ElementsAreArray(ArrayFloatNear({7.5, -2.75, 21.5, -3.75})));
+}
+
+TEST_P(WeightOnlyFullyConnectedOpTest, PerChannelInt8) {
+  WeightOnlyFullyConnectedOpModel m(
+      GetRegistration(), /*units=*/2, /*batches=*/1, /*input_size=*/3,
+      /*weights=*/
+      {TensorType_INT8, {2, 3}, 0, 0, 0, 0, /*per_channel_quantization=*/true,
+       /*per_channel_quantization_scales=*/{0.5, 2.0},
+       /*per_channel_quantization_offsets=*/{0, 0}, /*channel_index=*/0},
+      /*weights_data=*/{2, 4, 6, -1, 0, 1});
+  m.SetBias({0, 1});
+  m.SetInput({1, 2, 3});
+
+  ASSERT_EQ(m.Invoke(), kTfLiteOk);
+
+  EXPECT_THAT(m.GetOutput(), ElementsAreArray(ArrayFloatNear({14, 5})));
+}
+
+TEST_P(WeightOnlyFullyConnectedOpTest, GroupedInt4) {
+  // Same weights as in GroupedInt8WithZeroPoints, packed two per byte with the
+  // first value in the low nibble, without zero points.
+  WeightOnlyFullyConnectedOpModel m(
+      GetRegistration(), /*units=*/2, /*batches=*/2, /*input_size=*/4,
+      /*weights=*/
+      {TensorType_INT4, {2, 4}, 0, 0, 0, 0, /*per_channel_quantization=*/true,
+       /*per_channel_quantization_scales=*/{0.5, 1.0, 2.0, 0.25},
+       /*per_channel_quantization_offsets=*/{0, 0, 0, 0},
+       /*channel_index=*/0},
+      /*weights_data=*/{0x21, 0x43, static_cast<int8_t>(0xEF), 0x12});
+  m.SetBias({1, 2});
+  m.SetInput({
+      1, 1, 1, 1,  // b = 0
+      1, 2, 3, 4,  // b = 1
+  });
+
+  ASSERT_EQ(m.Invoke(), kTfLiteOk);
+
+  EXPECT_THAT(m.GetOutput(),
+              ElementsAreArray(ArrayFloatNear({9.5, -3.25, 28.5, -5.5})));
+}
+
+TEST_P(WeightOnlyFullyConnectedOpTest, GroupedInt4MultiThreaded) {
+  constexpr int kUnits = 64;
+  constexpr int kBatches = 4;
+  constexpr int kInputSize = 512;
+  constexpr int kGroups = 8;
+  constexpr int kGroupSize = kInputSize / kGroups;
+  std::vector<int8_t> weights(kUnits * kInputSize);
+  std::vector<float> scales(kUnits * kGroups);
+  for (int i = 0; i < kUnits * kInputSize; ++i) weights[i] = i % 16 - 8;
+  for (int i = 0; i < kUnits * kGroups; ++i) scales[i] = 0.01f * (i % 7 + 1);
+  std::vector<int8_t> packed_weights(kUnits * kInputSize / 2);
+  for (int i = 0; i < kUnits * kInputSize / 2; ++i) {
+    packed_weights[i] = static_cast<int8_t>(
+        (weights[2 * i] & 0x0F) |
+        (static_cast<uint8_t>(weights[2 * i + 1]) << 4));
+  }
+  std::vector<float> input(kBatches * kInputSize);
+  for (int i = 0; i < kBatches * kInputSize; ++i) {
+    input[i] = (i % 11 - 5) * 0.1f;
+  }
+  std::vector<float> expected(kBatches * kUnits);
+  for (int b = 0; b < kBatches; ++b) {
+    for (int u = 0; u < kUnits; ++u) {
+      float total = 0.f;
+      for (int d = 0; d < kInputSize; ++d) {
+        total += input[b * kInputSize + d] * weights[u * kInputSize + d] *
+                 scales[u * kGroups + d / kGroupSize];
+      }
+      expected[b * kUnits + u] = total;
+    }
+  }
+
+  for (int num_threads = 1; num_threads <= 4; ++num_threads) {
+    WeightOnlyFullyConnectedOpModel m(
+        GetRegistration(), kUnits, kBatches, kInputSize,
+        /*weights=*/
+        {TensorType_INT4, {kUnits, kInputSize}, 0, 0, 0, 0,
+         /*per_channel_quantization=*/true, scales,
+         std::vector<int64_t>(scales.size(), 0), /*channel_index=*/0},
+        packed_weights, num_threads);
+    m.SetBias(std::vector<float>(kUnits, 0.f));
+    m.SetInput(input);
+
+    ASSERT_EQ(m.Invoke(), kTfLiteOk);
+
+    EXPECT_THAT(m.GetOutput(),
+                ElementsAreArray(ArrayFloatNear(expected, 1e-3)));
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    WeightOnlyFullyConnectedOpTest, WeightOnlyFullyConnectedOpTest,
+    ::testing::ValuesIn(SingleOpTest::GetKernelTags(*kKernelMap)));
+
 TEST_P(FloatFullyConnectedOpTest, SimpleTest4DInput) {
   // Note that it is not required that the first dimension be the number of
   // batches. All we care is that the input can be evenly distributed in
@@ -1860,6 +2021,86 @@ TEST_P(SparseFullyConnectedOpTest, Simple1x4TestMultiThreadedMoreBatches) {
   }
 }
 
+TEST_P(SparseFullyConnectedOpTest, Sparse1x4TestMultiThreaded) {
+  // Two thirds of the blocks are zeros, so that the optimized kernel does not
+  // densify the weights.
+  std::initializer_list<float> weight_data = {
+      1, 2, 3, 4, 0, 0, 0, 0, 0,  0, 0,  0,  // u = 0
+      0, 0, 0, 0, 0, 0, 0, 0, -1, 2, -3, 4,  // u = 1
+      0, 0, 0, 0, 5, 6, 7, 8, 0,  0, 0,  0,  // u = 2
+  };
+  TensorData weight = {};
+  weight.type = TensorType_FLOAT32;
+  weight.shape = {3, 12};
+  weight.traversal_order = {0, 1, 2};
+  weight.format = {kTfLiteDimDense, kTfLiteDimSparseCSR};
+  weight.block_map = {1};
+  weight.block_size = {4};
+  for (int num_threads = 1; num_threads <= 4; num_threads++) {
+    SparseFullyConnectedOpModel<float> m(
+        GetRegistration(),
+        /*units=*/3, /*batches=*/4,
+        /*input=*/{TensorType_FLOAT32, {4, 12}}, weight, weight_data,
+        /*output=*/{TensorType_FLOAT32},
+        /*bias_tensor_optional=*/false, /*num_threads=*/num_threads);
+    m.SetBias({1, 2, 3});
+
+    m.SetInput({
+        1, 2, 3, 4, 5, 6, 7, 8,  -9, -10, 11,  12,  // b = 0
+        1, 2, 3, 4, 5, 6, 7, -8, 9,  -10, -11, 12,  // b = 1
+        1, 2, 3, 4, 5, 6, 7, 8,  -9, -10, 11,  12,  // b = 2
+        1, 2, 3, 4, 5, 6, 7, -8, 9,  -10, -11, 12,  // b = 3
+    });
+
+    ASSERT_EQ(m.Invoke(), kTfLiteOk);
+
+    EXPECT_THAT(m.GetOutputShape(), ElementsAre(4, 3));
+    EXPECT_THAT(m.GetOutput(), ElementsAre(31, 6, 177,  // b = 0
+                                           31, 54, 49,  // b = 1
+                                           31, 6, 177,  // b = 2
+                                           31, 54, 49   // b = 3
+                                           ));
+  }
+}
+
+TEST_P(SparseFullyConnectedOpTest, Sparse4x4Test) {
+  std::initializer_list<float> weight_data = {
+      0,    0,    0,    0,    1,  2,  3,  4,   // u = 0
+      0,    0,    0,    0,    5,  6,  7,  8,   // u = 1
+      0,    0,    0,    0,    9,  10, 11, 12,  // u = 2
+      0,    0,    0,    0,    13, 14, 15, 16,  // u = 3
+      -0.5, -1,   -1.5, -2,   0,  0,  0,  0,   // u = 4
+      -2.5, -3,   -3.5, -4,   0,  0,  0,  0,   // u = 5
+      -4.5, -5,   -5.5, -6,   0,  0,  0,  0,   // u = 6
+      -6.5, -7,   -7.5, -8,   0,  0,  0,  0,   // u = 7
+  };
+  TensorData weight = {};
+  weight.type = TensorType_FLOAT32;
+  weight.shape = {8, 8};
+  weight.traversal_order = {0, 1, 2, 3};
+  weight.format = {kTfLiteDimDense, kTfLiteDimSparseCSR};
+  weight.block_map = {0, 1};
+  weight.block_size = {4, 4};
+  SparseFullyConnectedOpModel<float> m(GetRegistration(),
+                                       /*units=*/8, /*batches=*/2,
+                                       /*input=*/{TensorType_FLOAT32, {2, 8}},
+                                       weight, weight_data);
+  m.SetBias({1, 2, 3, 4, 5, 6, 7, 8});
+
+  m.SetInput({
+      1,  2, 3, 4, 1, 1, 1, 1,  // b = 0
+      -1, 0, 1, 0, 2, 2, 1, 1,  // b = 1
+  });
+
+  ASSERT_EQ(m.Invoke(), kTfLiteOk);
+
+  EXPECT_THAT(m.GetOutputShape(), ElementsAre(2, 8));
+  EXPECT_THAT(m.GetOutput(),
+              ElementsAre(11, 28, 45, 62, 0, 0, 0, 0,  // b = 0
+                          14, 39, 64, 89, 4, 5, 6, 7   // b = 1
+                          ));
+}
+
 TEST_P(SparseHybridFullyConnectedOpTest, SparseHybrid1x16Test) {
   std::initializer_list<float> weight_data = {
       /* 1st row */
@@ -2145,6 +2386,35 @@ TEST_P(SparseQuantizedFullyConnectedOpTest, Simple1x16TestScaledInputOutput) {
   EXPECT_THAT(m.GetOutput(), ElementsAre(-52, -50, -52));
 }
 
+TEST_P(SparseQuantizedFullyConnectedOpTest, Simple1x4Test) {
+  std::vector<float> weight_data = {
+      1, 2,  3,  4,  0,  0,  0,  0,  -1, -2, -3, -4, 0, 0, 0, 0,  // u = 0
+      0, 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 0, 0, 0,  // u = 1
+      0, 0,  0,  0,  -4, -3, -2, -1, 0,  0,  0,  0,  4, 3, 2, 1,  // u = 2
+  };
+  TensorData weight = {TensorType_INT8, {3, 16}, 0, 0, 1};
+  weight.traversal_order = {0, 1, 2};
+  weight.format = {kTfLiteDimDense, kTfLiteDimSparseCSR};
+  weight.block_map = {1};
+  weight.block_size = {4};
+  SparseQuantizedFullyConnectedOpModel m(
+      GetRegistration(),
+      /*units=*/3, /*batches=*/2,
+      /*input=*/{TensorType_INT8, {2, 16}, 0, 0, 1}, weight, weight_data,
+      /*output=*/{TensorType_INT8, {}, 0, 0, 1});
+
+  m.SetBias({1, 2, 3});
+  m.SetInput({
+      1, 2, 3, 4, 1, 2, 3, 4, 4, 3, 2, 1, 1, 1, 1, 1,  // b = 0
+      4, 3, 2, 1, 0, 0, 0, 0, 1, 1, 1, 1, 4, 3, 2, 1,  // b = 1
+  });
+
+  ASSERT_EQ(m.Invoke(), kTfLiteOk);
+
+  EXPECT_THAT(m.GetOutputShape(), ElementsAre(2, 3));
+  EXPECT_THAT(m.GetOutput(), ElementsAre(11, 2, 0, 11, 2, 33));
+}
+
 INSTANTIATE_TEST_SUITE_P(
     SparseQuantizedFullyConnectedOpTest, SparseQuantizedFullyConnectedOpTest,
     ::testing::ValuesIn(SingleOpTest::GetKernelTags(*kKernelMapNoPie)));
@@ -1955,6 +1955,47 @@ void NeonSparseMatrixBatchVectorMultiplyAccumulate1x4(
   }
 }
 
+void NeonSparseMatrixBatchVectorMultiplyAccumulate4x4(
+    const float* __restrict__ matrix, const int32_t* __restrict__ segments,
+    const int32_t* __restrict__ indices, int m_rows, int m_cols,
+    const float* __restrict__ vector, int n_batch, float* __restrict__ result) {
+  constexpr int kBlockSize = kFloatValuesPerNeonVector;
+  TFLITE_DCHECK_EQ(m_rows % kBlockSize, 0);
+  TFLITE_DCHECK_EQ(m_cols % kBlockSize, 0);
+
+  for (int batch = 0; batch < n_batch; batch++) {
+    const float* matrix_ptr = matrix;
+    const float* vector_in_batch = vector + batch * m_cols;
+    float* result_in_batch = result + batch * m_rows;
+    for (int block_row = 0; block_row < m_rows / kBlockSize; block_row++) {
+      // One accumulator per row of the blocks.
+      float32x4_t acc0_32x4 = vmovq_n_f32(0.0);
+      float32x4_t acc1_32x4 = vmovq_n_f32(0.0);
+      float32x4_t acc2_32x4 = vmovq_n_f32(0.0);
+      float32x4_t acc3_32x4 = vmovq_n_f32(0.0);
+
+      for (int i = segments[block_row]; i < segments[block_row + 1]; i++) {
+        // Load the 4 float values of the vector the block is multiplied with.
+        const float32x4_t vector_f32x4 =
+            vld1q_f32(vector_in_batch + indices[i] * kBlockSize);
+        acc0_32x4 = vmlaq_f32(acc0_32x4, vld1q_f32(matrix_ptr), vector_f32x4);
+        acc1_32x4 = vmlaq_f32(acc1_32x4, vld1q_f32(matrix_ptr + 4),
+                              vector_f32x4);
+        acc2_32x4 = vmlaq_f32(acc2_32x4, vld1q_f32(matrix_ptr + 8),
+                              vector_f32x4);
+        acc3_32x4 = vmlaq_f32(acc3_32x4, vld1q_f32(matrix_ptr + 12),
+                              vector_f32x4);
+        matrix_ptr += kBlockSize * kBlockSize;
+      }
+      float* result_ptr = result_in_batch + block_row * kBlockSize;
+      result_ptr[0] += AccumulateNeonLane(acc0_32x4);
+      result_ptr[1] += AccumulateNeonLane(acc1_32x4);
+      result_ptr[2] += AccumulateNeonLane(acc2_32x4);
+      result_ptr[3] += AccumulateNeonLane(acc3_32x4);
+    }
+  }
+}
+
 void NeonSparseMatrixBatchVectorMultiplyAccumulate1x16(
     const int8_t* __restrict__ matrix, const int32_t* __restrict__ segments,
     const int32_t* __restrict__ indices, int m_rows, int m_cols,
@@ -2031,6 +2072,51 @@ void NeonSparseMatrixBatchVectorMultiplyAccumulate1x16(
   }
 }
 
+void NeonSparseMatrixBatchVectorMultiplyAccumulate1x4(
+    const int8_t* __restrict__ matrix, const int32_t* __restrict__ segments,
+    const int32_t* __restrict__ indices, int m_rows, int m_cols,
+    const int8_t* __restrict__ vector, const int32_t* __restrict__ bias_vector,
+    int n_batch, const int32_t input_offset, const int32_t output_multiplier,
+    const int32_t output_shift, const int32_t output_offset,
+    const int32_t output_activation_min, const int32_t output_activation_max,
+    int8_t* __restrict__ result) {
+  constexpr int kBlockSize = 4;
+  TFLITE_DCHECK_EQ(m_cols % kBlockSize, 0);
+  const int16x4_t input_offset_i16x4 = vdup_n_s16(input_offset);
+
+  for (int batch = 0; batch < n_batch; ++batch) {
+    const int8_t* matrix_ptr = matrix;
+    const int8_t* vector_in_batch = vector + batch * m_cols;
+    for (int row = 0; row < m_rows; ++row) {
+      int32x4_t acc_i32x4 = vmovq_n_s32(0);
+      for (int i = segments[row]; i < segments[row + 1]; ++i) {
+        // Widen the 4 int8 values of the block and of the vector to int16, the
+        // input offset being added to the latter.
+        int32_t matrix_block, vector_block;
+        memcpy(&matrix_block, matrix_ptr, kBlockSize);
+        memcpy(&vector_block, vector_in_batch + indices[i] * kBlockSize,
+               kBlockSize);
+        const int16x4_t matrix_i16x4 = vget_low_s16(
+            vmovl_s8(vreinterpret_s8_s32(vdup_n_s32(matrix_block))));
+        const int16x4_t vector_i16x4 = vadd_s16(
+            vget_low_s16(
+                vmovl_s8(vreinterpret_s8_s32(vdup_n_s32(vector_block)))),
+            input_offset_i16x4);
+        acc_i32x4 = vmlal_s16(acc_i32x4, matrix_i16x4, vector_i16x4);
+        matrix_ptr += kBlockSize;
+      }
+      int32_t acc = AccumulateNeonLane(acc_i32x4);
+      const int32_t bias_value = bias_vector != nullptr ? bias_vector[row] : 0;
+      acc = MultiplyByQuantizedMultiplier(acc + bias_value, output_multiplier,
+                                          output_shift);
+      acc += output_offset;
+      result[batch * m_rows + row] =
+          static_cast<int8_t>(ActivationFunctionWithMinMax(
+              acc, output_activation_min, output_activation_max));
+    }
+  }
+}
+
 void NeonSparseMatrixBatchVectorMultiplyAccumulate(
     const float* __restrict__ matrix, const uint8_t* __restrict__ ledger,
     int m_rows, int m_cols, const float* __restrict__ vector, int n_batch,
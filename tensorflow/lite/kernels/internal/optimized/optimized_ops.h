@@ -873,6 +873,161 @@ inline void ShuffledFullyConnected(
                                   cpu_backend_context);
 }
 
+// Added by Alpa. Computes the rows [row_start, row_end) of a weight-only
+// quantized FullyConnected. Each row of weights is read once for all batches,
+// dequantized group by group inside the dot products, so the weights never
+// leave their 8-bit or 4-bit form in memory. int4 weights need even
+// accum_depth and group_size so that every group starts on a byte.
+inline void FullyConnectedWeightOnlyWorkerImpl(
+    const float* input_data, const int8* weights_data, bool weights_are_int4,
+    const float* weights_scales, const int32* weights_zero_points,
+    int group_size, const float* bias_data, int batches, int output_depth,
+    int accum_depth, int row_start, int row_end, float output_activation_min,
+    float output_activation_max, float* output_data) {
+  const int groups = accum_depth / group_size;
+  for (int out_c = row_start; out_c < row_end; ++out_c) {
+    const float* row_scales = weights_scales + out_c * groups;
+    const int32* row_zero_points =
+        weights_zero_points ? weights_zero_points + out_c * groups : nullptr;
+    for (int b = 0; b < batches; ++b) {
+      const float* input_ptr = input_data + b * accum_depth;
+      float total = bias_data ? bias_data[out_c] : 0.f;
+      for (int g = 0; g < groups; ++g) {
+        const float* group_input = input_ptr + g * group_size;
+        float dot = 0.f;
+        if (weights_are_int4) {
+          const int8* packed =
+              weights_data + (out_c * accum_depth + g * group_size) / 2;
+          for (int k = 0; k < group_size / 2; ++k) {
+            const int8 low = static_cast<int8>(packed[k] << 4) >> 4;
+            const int8 high = packed[k] >> 4;
+            dot += low * group_input[2 * k] + high * group_input[2 * k + 1];
+          }
+        } else {
+          const int8* group_weights =
+              weights_data + out_c * accum_depth + g * group_size;
+          for (int k = 0; k < group_size; ++k) {
+            dot += group_weights[k] * group_input[k];
+          }
+        }
+        if (row_zero_points && row_zero_points[g] != 0) {
+          float input_sum = 0.f;
+          for (int k = 0; k < group_size; ++k) {
+            input_sum += group_input[k];
+          }
+          dot -= row_zero_points[g] * input_sum;
+        }
+        total += row_scales[g] * dot;
+      }
+      output_data[b * output_depth + out_c] = ActivationFunctionWithMinMax(
+          total, output_activation_min, output_activation_max);
+    }
+  }
+}
+
+struct FullyConnectedWeightOnlyWorkerTask : cpu_backend_threadpool::Task {
+  FullyConnectedWeightOnlyWorkerTask(
+      const float* input_data, const int8* weights_data, bool weights_are_int4,
+      const float* weights_scales, const int32* weights_zero_points,
+      int group_size, const float* bias_data, int batches, int output_depth,
+      int accum_depth, int row_start, int row_end,
+      float output_activation_min, float output_activation_max,
+      float* output_data)
+      : input_data_(input_data),
+        weights_data_(weights_data),
+        weights_are_int4_(weights_are_int4),
+        weights_scales_(weights_scales),
+        weights_zero_points_(weights_zero_points),
+        group_size_(group_size),
+        bias_data_(bias_data),
+        batches_(batches),
+        output_depth_(output_depth),
+        accum_depth_(accum_depth),
+        row_start_(row_start),
+        row_end_(row_end),
+        output_activation_min_(output_activation_min),
+        output_activation_max_(output_activation_max),
+        output_data_(output_data) {}
+
+  void Run() override {
+    FullyConnectedWeightOnlyWorkerImpl(
+        input_data_, weights_data_, weights_are_int4_, weights_scales_,
+        weights_zero_points_, group_size_, bias_data_, batches_, output_depth_,
+        accum_depth_, row_start_, row_end_, output_activation_min_,
+        output_activation_max_, output_data_);
+  }
+
+  const float* input_data_;
+  const int8* weights_data_;
+  bool weights_are_int4_;
+  const float* weights_scales_;
+  const int32* weights_zero_points_;
+  int group_size_;
+  const float* bias_data_;
+  int batches_;
+  int output_depth_;
+  int accum_depth_;
+  int row_start_;
+  int row_end_;
+  float output_activation_min_;
+  float output_activation_max_;
+  float* output_data_;
+};
+
+// Added by Alpa. Optimized counterpart of
+// reference_ops::FullyConnectedWeightOnly. Decoding-sized layers are bound by
+// the weight bandwidth, so the rows are split across the threadpool instead of
+// dequantizing the weights for the float GEMM.
+inline void FullyConnectedWeightOnly(
+    const FullyConnectedParams& params, const RuntimeShape& input_shape,
+    const float* input_data, const RuntimeShape& weights_shape,
+    const int8* weights_data, bool weights_are_int4,
+    const float* weights_scales, const int32* weights_zero_points,
+    int group_size, const RuntimeShape& bias_shape, const float* bias_data,
+    const RuntimeShape& output_shape, float* output_data,
+    CpuBackendContext* cpu_backend_context) {
+  ruy::profiler::ScopeLabel label("FullyConnectedWeightOnly");
+  const int output_dim_count = output_shape.DimensionsCount();
+  const int weights_dim_count = weights_shape.DimensionsCount();
+  const int batches = FlatSizeSkipDim(output_shape, output_dim_count - 1);
+  const int output_depth = MatchingDim(weights_shape, weights_dim_count - 2,
+                                       output_shape, output_dim_count - 1);
+  const int accum_depth = weights_shape.Dims(weights_dim_count - 1);
+  TFLITE_DCHECK_EQ(accum_depth % group_size, 0);
+  TFLITE_DCHECK(!weights_are_int4 || group_size % 2 == 0);
+
+  static constexpr int kKernelRows = 4;
+  const int thread_count =
+      LegacyHowManyThreads<kKernelRows>(cpu_backend_context->max_num_threads(),
+                                        output_depth, batches, accum_depth);
+  if (thread_count == 1) {
+    FullyConnectedWeightOnlyWorkerImpl(
+        input_data, weights_data, weights_are_int4, weights_scales,
+        weights_zero_points, group_size, bias_data, batches, output_depth,
+        accum_depth, 0, output_depth, params.float_activation_min,
+        params.float_activation_max, output_data);
+    return;
+  }
+
+  std::vector<FullyConnectedWeightOnlyWorkerTask> tasks;
+  tasks.reserve(thread_count);
+  const int kRowsPerWorker =
+      RoundUp<kKernelRows>(CeilQuotient(output_depth, thread_count));
+  int row_start = 0;
+  for (int i = 0; i < thread_count && row_start < output_depth; i++) {
+    const int row_end = std::min(output_depth, row_start + kRowsPerWorker);
+    tasks.emplace_back(input_data, weights_data, weights_are_int4,
+                       weights_scales, weights_zero_points, group_size,
+                       bias_data, batches, output_depth, accum_depth,
+                       row_start, row_end, params.float_activation_min,
+                       params.float_activation_max, output_data);
+    row_start = row_end;
+  }
+  TFLITE_DCHECK_EQ(row_start, output_depth);
+  cpu_backend_threadpool::Execute(tasks.size(), tasks.data(),
+                                  cpu_backend_context);
+}
+
 #ifdef USE_NEON
 
 inline int32x4_t RoundToNearest(const float32x4_t input) {
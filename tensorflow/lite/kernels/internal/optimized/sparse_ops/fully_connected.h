@@ -30,6 +30,61 @@ limitations under the License.
 namespace tflite {
 namespace optimized_ops {
 
+// Added by Alpa. The block patterns of the sparse weights of fully-connected
+// layers the optimized kernels support.
+enum class SparseWeightsBlock {
+  kUnsupported,
+  kRandom,
+  k1x4,
+  k1x16,
+  k4x4,
+};
+
+// Added by Alpa. Returns the block pattern of `sparsity`, the rows of the
+// weights being dense and their columns CSR.
+inline SparseWeightsBlock GetSparseWeightsBlock(
+    const TfLiteSparsity& sparsity) {
+  if (sparsity.dim_metadata_size < 2 ||
+      sparsity.dim_metadata[0].format != kTfLiteDimDense ||
+      sparsity.dim_metadata[1].format != kTfLiteDimSparseCSR) {
+    return SparseWeightsBlock::kUnsupported;
+  }
+  const TfLiteDimensionMetadata* dim_metadata = sparsity.dim_metadata;
+  const TfLiteIntArray* block_map = sparsity.block_map;
+  switch (sparsity.dim_metadata_size) {
+    case 2:
+      return SparseWeightsBlock::kRandom;
+    case 3:
+      if (block_map == nullptr || block_map->size != 1 ||
+          block_map->data[0] != 1) {
+        return SparseWeightsBlock::kUnsupported;
+      }
+      if (dim_metadata[2].dense_size == 4) return SparseWeightsBlock::k1x4;
+      if (dim_metadata[2].dense_size == 16) return SparseWeightsBlock::k1x16;
+      return SparseWeightsBlock::kUnsupported;
+    case 4:
+      if (block_map == nullptr || block_map->size != 2 ||
+          block_map->data[0] != 0 || block_map->data[1] != 1 ||
+          sparsity.traversal_order == nullptr ||
+          sparsity.traversal_order->data[2] != 2 ||
+          dim_metadata[2].dense_size != 4 || dim_metadata[3].dense_size != 4) {
+        return SparseWeightsBlock::kUnsupported;
+      }
+      return SparseWeightsBlock::k4x4;
+    default:
+      return SparseWeightsBlock::kUnsupported;
+  }
+}
+
+// Added by Alpa. Returns whether the sparse kernels multiply weights of
+// `num_elements` values, `num_stored_values` of which are stored, faster than
+// the dense kernels multiply the densified weights. The gather of the inputs
+// only pays off once at least two thirds of the weights are zeros.
+inline bool PreferSparseWeights(int64_t num_stored_values,
+                                int64_t num_elements) {
+  return 3 * num_stored_values <= num_elements;
+}
+
 inline void FullyConnectedSparseWeight(
     const TfLiteSparsity& sparsity, const FullyConnectedParams& params,
     const RuntimeShape& input_shape, const float* input_data,
@@ -151,6 +206,77 @@ inline void FullyConnectedSparseWeight1x4Impl(
   }
 }
 
+// Added by Alpa.
+inline void FullyConnectedSparseWeight1x4Impl(
+    const TfLiteSparsity& sparsity, const FullyConnectedParams& params,
+    const RuntimeShape& input_shape, const int8_t* input_data,
+    const RuntimeShape& weights_shape, const int8_t* weights_data,
+    const RuntimeShape& bias_shape, const int32_t* bias_data,
+    const RuntimeShape& output_shape, int8_t* output_data, int thread_start,
+    int thread_end, const CpuBackendContext& cpu_backend_context) {
+  ruy::profiler::ScopeLabel label("FullyConnected");
+  ruy::profiler::ScopeLabel inner_label("1x4 Block Sparse");
+
+  const int input_dims_count = input_shape.DimensionsCount();
+  const int output_dims_count = output_shape.DimensionsCount();
+  const int weights_dims_count = weights_shape.DimensionsCount();
+  const int batches = thread_end - thread_start;
+  const int input_depth = MatchingDim(weights_shape, weights_dims_count - 1,
+                                      input_shape, input_dims_count - 1);
+  const int output_depth = MatchingDim(weights_shape, weights_dims_count - 2,
+                                       output_shape, output_dims_count - 1);
+  const int* w1_segments = sparsity.dim_metadata[1].array_segments->data;
+  const int* w1_indices = sparsity.dim_metadata[1].array_indices->data;
+
+  tensor_utils::SparseMatrixBatchVectorMultiplyAccumulate1x4(
+      weights_data, w1_segments, w1_indices, weights_shape.Dims(0),
+      weights_shape.Dims(1), input_data + thread_start * input_depth, bias_data,
+      batches, params.input_offset, params.output_multiplier,
+      params.output_shift, params.output_offset,
+      params.quantized_activation_min, params.quantized_activation_max,
+      output_data + thread_start * output_depth);
+}
+
+// Added by Alpa.
+inline void FullyConnectedSparseWeight4x4Impl(
+    const TfLiteSparsity& sparsity, const FullyConnectedParams& params,
+    const RuntimeShape& input_shape, const float* input_data,
+    const RuntimeShape& weights_shape, const float* weights_data,
+    const RuntimeShape& bias_shape, const float* bias_data,
+    const RuntimeShape& output_shape, float* output_data, int thread_start,
+    int thread_end, const CpuBackendContext& cpu_backend_context) {
+  ruy::profiler::ScopeLabel label("FullyConnected");
+  ruy::profiler::ScopeLabel inner_label("4x4 Block Sparse");
+  const float output_activation_min = params.float_activation_min;
+  const float output_activation_max = params.float_activation_max;
+
+  const int input_dims_count = input_shape.DimensionsCount();
+  const int output_dims_count = output_shape.DimensionsCount();
+  const int weights_dims_count = weights_shape.DimensionsCount();
+  const int batches = thread_end - thread_start;
+  const int input_depth = MatchingDim(weights_shape, weights_dims_count - 1,
+                                      input_shape, input_dims_count - 1);
+  const int output_depth = MatchingDim(weights_shape, weights_dims_count - 2,
+                                       output_shape, output_dims_count - 1);
+  const int* w1_segments = sparsity.dim_metadata[1].array_segments->data;
+  const int* w1_indices = sparsity.dim_metadata[1].array_indices->data;
+
+  tensor_utils::SparseMatrixBatchVectorMultiplyAccumulate4x4(
+      weights_data, w1_segments, w1_indices, weights_shape.Dims(0),
+      weights_shape.Dims(1), input_data + thread_start * input_depth, batches,
+      output_data + thread_start * output_depth);
+
+  ruy::profiler::ScopeLabel activation_label("activation function");
+  for (int b = thread_start; b < thread_end; ++b) {
+    for (int i = 0; i < output_depth; ++i) {
+      float total = output_data[b * output_depth + i];
+      const float bias_value = bias_data ? bias_data[i] : 0;
+      output_data[b * output_depth + i] = ActivationFunctionWithMinMax(
+          total + bias_value, output_activation_min, output_activation_max);
+    }
+  }
+}
+
 struct FullyConnectedSparseWeight1x4Task : cpu_backend_threadpool::Task {
   FullyConnectedSparseWeight1x4Task(
       const TfLiteSparsity& sparsity, const FullyConnectedParams& params,
@@ -216,6 +342,42 @@ inline void FullyConnectedSparseWeight1x16(
       *cpu_backend_context);
 }
 
+// Added by Alpa. Same as the float kernel below, but for symmetric int8
+// weights.
+inline void FullyConnectedSparseWeight1x4(
+    const TfLiteSparsity& sparsity, const FullyConnectedParams& params,
+    const RuntimeShape& input_shape, const int8_t* input_data,
+    const RuntimeShape& weights_shape, const int8_t* weights_data,
+    const RuntimeShape& bias_shape, const int32_t* bias_data,
+    const RuntimeShape& output_shape, int8_t* output_data,
+    CpuBackendContext* cpu_backend_context) {
+  const int batches =
+      FlatSizeSkipDim(output_shape, output_shape.DimensionsCount() - 1);
+  return FullyConnectedSparseWeight1x4Impl(
+      sparsity, params, input_shape, input_data, weights_shape, weights_data,
+      bias_shape, bias_data, output_shape, output_data, 0, batches,
+      *cpu_backend_context);
+}
+
+// Added by Alpa. Same as the 1x4 kernel below, but for 4x4 blocks.
+inline void FullyConnectedSparseWeight4x4(
+    const TfLiteSparsity& sparsity, const FullyConnectedParams& params,
+    const RuntimeShape& input_shape, const float* input_data,
+    const RuntimeShape& weights_shape, const float* weights_data,
+    const RuntimeShape& bias_shape, const float* bias_data,
+    const RuntimeShape& output_shape, float* output_data,
+    CpuBackendContext* cpu_backend_context) {
+  const int output_elements = output_shape.FlatSize();
+  memset(output_data, 0, output_elements * sizeof(float));
+
+  const int batches =
+      FlatSizeSkipDim(output_shape, output_shape.DimensionsCount() - 1);
+  return FullyConnectedSparseWeight4x4Impl(
+      sparsity, params, input_shape, input_data, weights_shape, weights_data,
+      bias_shape, bias_data, output_shape, output_data, 0, batches,
+      *cpu_backend_context);
+}
+
 // The multi-threaded kernel slices the workload along the batch dimension. If
 // there's not enough batches of data, the number of threads used is equal to
 // the batch size. We can improve this later with slicing along the row
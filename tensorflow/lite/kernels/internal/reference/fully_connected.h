@@ -164,6 +164,59 @@ inline void FullyConnected(
   }
 }
 
+// Added by Alpa. Float FullyConnected with weight-only quantized weights. The
+// weights are int8, or int4 packed two per byte (low nibble first) when
+// `weights_are_int4`. Each row of weights is split into groups of
+// `group_size` values; group g of row c is dequantized with
+// weights_scales[c * groups + g] and weights_zero_points[c * groups + g],
+// where groups = accum_depth / group_size. A null `weights_zero_points` means
+// symmetric quantization.
+inline void FullyConnectedWeightOnly(
+    const FullyConnectedParams& params, const RuntimeShape& input_shape,
+    const float* input_data, const RuntimeShape& weights_shape,
+    const int8_t* weights_data, bool weights_are_int4,
+    const float* weights_scales, const int32_t* weights_zero_points,
+    int group_size, const RuntimeShape& bias_shape, const float* bias_data,
+    const RuntimeShape& output_shape, float* output_data) {
+  const float output_activation_min = params.float_activation_min;
+  const float output_activation_max = params.float_activation_max;
+  const int output_dims_count = output_shape.DimensionsCount();
+  const int weights_dims_count = weights_shape.DimensionsCount();
+  const int batches = FlatSizeSkipDim(output_shape, output_dims_count - 1);
+  const int output_depth = MatchingDim(weights_shape, weights_dims_count - 2,
+                                       output_shape, output_dims_count - 1);
+  const int accum_depth = weights_shape.Dims(weights_dims_count - 1);
+  TFLITE_DCHECK_EQ(accum_depth % group_size, 0);
+  const int groups = accum_depth / group_size;
+  for (int b = 0; b < batches; ++b) {
+    for (int out_c = 0; out_c < output_depth; ++out_c) {
+      float total = 0.f;
+      for (int d = 0; d < accum_depth; ++d) {
+        const int index = out_c * accum_depth + d;
+        int32_t weight;
+        if (weights_are_int4) {
+          const int8_t packed = weights_data[index / 2];
+          weight = (index % 2 == 0) ? static_cast<int8_t>(packed << 4) >> 4
+                                    : packed >> 4;
+        } else {
+          weight = weights_data[index];
+        }
+        const int group = out_c * groups + d / group_size;
+        const int32_t zero_point =
+            weights_zero_points ? weights_zero_points[group] : 0;
+        total += input_data[b * accum_depth + d] * weights_scales[group] *
+                 static_cast<float>(weight - zero_point);
+      }
+      float bias_value = 0.0f;
+      if (bias_data) {
+        bias_value = bias_data[out_c];
+      }
+      output_data[out_c + output_depth * b] = ActivationFunctionWithMinMax(
+          total + bias_value, output_activation_min, output_activation_max);
+    }
+  }
+}
+
 inline void ShuffledFullyConnected(
     const FullyConnectedParams& params, const RuntimeShape& input_shape,
     const uint8_t* input_data, const RuntimeShape& weights_shape,
@@ -15,6 +15,7 @@ limitations under the License.
 #ifndef TENSORFLOW_LITE_MEMORY_PLANNER_H_
 #define TENSORFLOW_LITE_MEMORY_PLANNER_H_
 
+#include <cstdint>
 #include <vector>
 
 #include "tensorflow/lite/c/common.h"
@@ -62,6 +63,33 @@ class MemoryPlanner {
   // Returns true if the non-persistent memory is available.
   virtual bool HasNonPersistentMemory() = 0;
 
+  // Added by Alpa. Resolves the non-persistent tensors again if their memory,
+  // shared with other planners, was moved by one of them.
+  virtual TfLiteStatus RefreshNonPersistentMemory() { return kTfLiteOk; }
+
+  // Added by Alpa. Sets an offline plan of the non-persistent tensors, with
+  // the offset, size, first node and last node of each tensor, in this order,
+  // or an offset of -1 for the tensors it does not place. The planner places
+  // the tensors at their planned offsets, instead of planning them itself, as
+  // long as their sizes and usage intervals fit the plan.
+  virtual TfLiteStatus SetOfflinePlan(std::vector<int32_t> plan) {
+    return kTfLiteOk;
+  }
+
+  // Added by Alpa. Returns the current allocations of the non-persistent
+  // tensors in the format of SetOfflinePlan().
+  virtual TfLiteStatus GetOfflinePlan(std::vector<int32_t>* plan) const {
+    return kTfLiteError;
+  }
+
+  // Added by Alpa. Sets the execution wave of each node of the execution plan,
+  // the nodes of a wave running concurrently with each other, or no waves for
+  // a sequential execution. The tensors used by a node of a wave are then kept
+  // from the first node of the wave to the last one.
+  virtual TfLiteStatus SetExecutionWaves(const std::vector<int>& waves) {
+    return kTfLiteOk;
+  }
+
   // Dumps the memory planning information against the specified op node
   // execution plan (i.e. `execution_plan`) for the purpose of debugging.
   virtual void DumpDebugInfo(const std::vector<int>& execution_plan) const = 0;
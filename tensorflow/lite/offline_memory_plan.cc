@@ -0,0 +1,223 @@
+// This file contains the implementation of the offline memory plan encoding.
+
+#include "tensorflow/lite/offline_memory_plan.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <functional>
+#include <random>
+#include <utility>
+
+namespace tflite {
+
+namespace {
+
+// A planned tensor, used at nodes [first_node, last_node].
+struct PlannedTensor {
+  int index;
+  size_t size;
+  int32_t first_node;
+  int32_t last_node;
+};
+
+bool Overlap(const PlannedTensor& a, const PlannedTensor& b) {
+  return a.first_node <= b.last_node && b.first_node <= a.last_node;
+}
+
+size_t AlignTo(size_t alignment, size_t offset) {
+  return offset % alignment == 0 ? offset
+                                 : offset + alignment - offset % alignment;
+}
+
+// Places the tensors in `order` one by one at the lowest aligned offset where
+// they do not overlap the tensors live at the same time. Returns the arena
+// size.
+size_t PlaceGreedily(const std::vector<PlannedTensor>& tensors,
+                     const std::vector<int>& order, size_t alignment,
+                     std::vector<size_t>* offsets) {
+  offsets->assign(tensors.size(), 0);
+  std::vector<int> placed;
+  std::vector<std::pair<size_t, size_t>> live;  // (offset, end)
+  size_t arena_size = 0;
+  for (int i : order) {
+    const PlannedTensor& tensor = tensors[i];
+    live.clear();
+    for (int j : placed) {
+      if (Overlap(tensor, tensors[j])) {
+        live.emplace_back((*offsets)[j], (*offsets)[j] + tensors[j].size);
+      }
+    }
+    std::sort(live.begin(), live.end());
+    size_t offset = 0;
+    for (const auto& [start, end] : live) {
+      if (offset + tensor.size <= start) break;
+      offset = std::max(offset, AlignTo(alignment, end));
+    }
+    (*offsets)[i] = offset;
+    arena_size = std::max(arena_size, offset + tensor.size);
+    placed.push_back(i);
+  }
+  return arena_size;
+}
+
+// The largest total size of the tensors live at one node.
+size_t LiveSizeLowerBound(const std::vector<PlannedTensor>& tensors) {
+  std::vector<std::pair<int64_t, int64_t>> events;
+  for (const PlannedTensor& tensor : tensors) {
+    events.emplace_back(tensor.first_node, tensor.size);
+    events.emplace_back(static_cast<int64_t>(tensor.last_node) + 1,
+                        -static_cast<int64_t>(tensor.size));
+  }
+  // Frees sort before allocations at the same node.
+  std::sort(events.begin(), events.end());
+  int64_t live = 0, max_live = 0;
+  for (const auto& [node, delta] : events) {
+    live += delta;
+    max_live = std::max(max_live, live);
+  }
+  return max_live;
+}
+
+}  // namespace
+
+std::string SerializeOfflineMemoryPlans(
+    const std::vector<std::vector<int32_t>>& plans) {
+  std::vector<int32_t> words;
+  for (int i = 0; i < static_cast<int>(plans.size()); ++i) {
+    if (plans[i].empty()) continue;
+    words.push_back(kOfflineMemoryPlanVersion);
+    words.push_back(i);
+    words.push_back(plans[i].size() / 4);
+    words.insert(words.end(), plans[i].begin(), plans[i].end());
+  }
+  return std::string(reinterpret_cast<const char*>(words.data()),
+                     words.size() * sizeof(int32_t));
+}
+
+TfLiteStatus ParseOfflineMemoryPlans(const std::string& data,
+                                     int num_subgraphs,
+                                     std::vector<std::vector<int32_t>>* plans) {
+  plans->assign(num_subgraphs, {});
+  if (data.size() % sizeof(int32_t) != 0) return kTfLiteError;
+  // The metadata buffer may not be aligned. Like flatbuffers, this assumes a
+  // little-endian host.
+  std::vector<int32_t> words(data.size() / sizeof(int32_t));
+  memcpy(words.data(), data.data(), data.size());
+  size_t pos = 0;
+  while (pos < words.size()) {
+    if (words.size() - pos < 3) return kTfLiteError;
+    const int32_t version = words[pos];
+    const int32_t subgraph_index = words[pos + 1];
+    const int32_t num_tensors = words[pos + 2];
+    pos += 3;
+    if (version != kOfflineMemoryPlanVersion || subgraph_index < 0 ||
+        subgraph_index >= num_subgraphs || num_tensors < 0 ||
+        (words.size() - pos) / 4 < static_cast<size_t>(num_tensors)) {
+      return kTfLiteError;
+    }
+    (*plans)[subgraph_index].assign(words.begin() + pos,
+                                    words.begin() + pos + 4 * num_tensors);
+    pos += 4 * num_tensors;
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus OptimizeOfflineMemoryPlan(const std::vector<int32_t>& plan,
+                                       int alignment,
+                                       double time_budget_seconds,
+                                       std::vector<int32_t>* optimized,
+                                       OfflineMemoryPlanStats* stats) {
+  const auto deadline =
+      std::chrono::steady_clock::now() +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(std::max(time_budget_seconds, 0.0)));
+  if (plan.size() % 4 != 0 || alignment <= 0) return kTfLiteError;
+  std::vector<PlannedTensor> tensors;
+  size_t initial_arena_size = 0;
+  for (size_t i = 0; i < plan.size() / 4; ++i) {
+    const int32_t* planned = &plan[4 * i];
+    if (planned[0] < 0) continue;
+    if (planned[1] < 0 || planned[2] > planned[3]) return kTfLiteError;
+    initial_arena_size = std::max(
+        initial_arena_size, static_cast<size_t>(planned[0]) + planned[1]);
+    if (planned[1] == 0) continue;
+    tensors.push_back({static_cast<int>(i), static_cast<size_t>(planned[1]),
+                       planned[2], planned[3]});
+  }
+  const size_t lower_bound = LiveSizeLowerBound(tensors);
+
+  // Greedy placements in the orders that usually pack interval graphs well.
+  using Less = std::function<bool(const PlannedTensor&, const PlannedTensor&)>;
+  auto length = [](const PlannedTensor& tensor) {
+    return static_cast<int64_t>(tensor.last_node) - tensor.first_node + 1;
+  };
+  const std::vector<Less> orderings = {
+      [](const PlannedTensor& a, const PlannedTensor& b) {
+        return a.size > b.size;
+      },
+      [&](const PlannedTensor& a, const PlannedTensor& b) {
+        return length(a) > length(b);
+      },
+      [&](const PlannedTensor& a, const PlannedTensor& b) {
+        return static_cast<int64_t>(a.size) * length(a) >
+               static_cast<int64_t>(b.size) * length(b);
+      },
+      [](const PlannedTensor& a, const PlannedTensor& b) {
+        return a.first_node < b.first_node;
+      },
+  };
+  std::vector<int> best_order;
+  std::vector<size_t> best_offsets, offsets;
+  size_t best_arena_size = 0;
+  for (const Less& less : orderings) {
+    std::vector<int> order(tensors.size());
+    for (int i = 0; i < static_cast<int>(order.size()); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+      return less(tensors[a], tensors[b]);
+    });
+    const size_t arena_size =
+        PlaceGreedily(tensors, order, alignment, &offsets);
+    if (best_order.empty() || arena_size < best_arena_size) {
+      best_order = std::move(order);
+      best_offsets = offsets;
+      best_arena_size = arena_size;
+    }
+  }
+
+  // Local search over the order of the best placement. Equal placements are
+  // accepted too, to move across plateaus.
+  std::mt19937 rng(0);
+  while (tensors.size() > 1 && best_arena_size > lower_bound &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::vector<int> order = best_order;
+    std::uniform_int_distribution<int> pick(0, order.size() - 1);
+    std::swap(order[pick(rng)], order[pick(rng)]);
+    const size_t arena_size =
+        PlaceGreedily(tensors, order, alignment, &offsets);
+    if (arena_size <= best_arena_size) {
+      best_order = std::move(order);
+      best_offsets.swap(offsets);
+      best_arena_size = arena_size;
+    }
+  }
+
+  *optimized = plan;
+  if (best_arena_size < initial_arena_size) {
+    for (size_t i = 0; i < tensors.size(); ++i) {
+      (*optimized)[4 * tensors[i].index] =
+          static_cast<int32_t>(best_offsets[i]);
+    }
+  } else {
+    best_arena_size = initial_arena_size;
+  }
+  if (stats != nullptr) {
+    stats->initial_arena_size = initial_arena_size;
+    stats->arena_size = best_arena_size;
+    stats->lower_bound = lower_bound;
+  }
+  return kTfLiteOk;
+}
+
+}  // namespace tflite
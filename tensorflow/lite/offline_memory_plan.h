@@ -0,0 +1,72 @@
+// This file contains the encoding of offline memory plans, which are stored in
+// the "OfflineMemoryAllocation" metadata of TFLite models so that the
+// interpreters of the models place their non-persistent tensors at planned
+// offsets instead of planning them on every allocation.
+
+#ifndef TENSORFLOW_LITE_OFFLINE_MEMORY_PLAN_H_
+#define TENSORFLOW_LITE_OFFLINE_MEMORY_PLAN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/c/common.h"
+
+namespace tflite {
+
+// Name of the model metadata holding the offline memory plans.
+constexpr char kOfflineMemoryAllocationMetadata[] = "OfflineMemoryAllocation";
+
+// Version of the encoding. Version 1 is the offsets-only encoding of a single
+// subgraph used by TFLite Micro.
+constexpr int32_t kOfflineMemoryPlanVersion = 2;
+
+// Encodes `plans`, the plans of the subgraphs in the format of
+// MemoryPlanner::SetOfflinePlan(), empty for the subgraphs without a plan. The
+// encoding is a sequence of little-endian int32 words holding, for each
+// planned subgraph, the version, the subgraph index, the number of tensors
+// and the plan itself.
+std::string SerializeOfflineMemoryPlans(
+    const std::vector<std::vector<int32_t>>& plans);
+
+// Decodes the plans of `num_subgraphs` subgraphs encoded by
+// SerializeOfflineMemoryPlans(). Returns kTfLiteError if `data` is invalid or
+// of another version.
+TfLiteStatus ParseOfflineMemoryPlans(const std::string& data,
+                                     int num_subgraphs,
+                                     std::vector<std::vector<int32_t>>* plans);
+
+// The arena sizes of an optimized plan.
+struct OfflineMemoryPlanStats {
+  // The arena size of the original plan.
+  size_t initial_arena_size = 0;
+  // The arena size of the optimized plan.
+  size_t arena_size = 0;
+  // The largest total size of the tensors live at one node. No plan of the
+  // tensors fits in a smaller arena, so the optimized plan is optimal if
+  // `arena_size` reaches it.
+  size_t lower_bound = 0;
+};
+
+// Places the tensors of `plan`, a plan in the format of
+// MemoryPlanner::SetOfflinePlan(), e.g., from MemoryPlanner::GetOfflinePlan(),
+// at new offsets that minimize the size of the arena. The sizes and usage
+// intervals of the tensors are kept, and the offsets are multiples of
+// `alignment`.
+//
+// The tensors that are live at the same time form an interval graph, and the
+// tensors are packed greedily at the lowest offset that fits, in several
+// orders (by size, usage interval length and area). The best order is then
+// improved by random swaps until the arena reaches the lower bound or
+// `time_budget_seconds` elapses. The original offsets are kept if no order
+// beats them.
+TfLiteStatus OptimizeOfflineMemoryPlan(const std::vector<int32_t>& plan,
+                                       int alignment,
+                                       double time_budget_seconds,
+                                       std::vector<int32_t>* optimized,
+                                       OfflineMemoryPlanStats* stats);
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_OFFLINE_MEMORY_PLAN_H_
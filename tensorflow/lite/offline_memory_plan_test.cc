@@ -0,0 +1,87 @@
+#include "tensorflow/lite/offline_memory_plan.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace tflite {
+namespace {
+
+TEST(OfflineMemoryPlanTest, RoundTrip) {
+  const std::vector<std::vector<int32_t>> plans = {
+      {0, 16, 0, 1, -1, 0, 0, 0}, {}, {64, 32, 1, 2}};
+  std::vector<std::vector<int32_t>> parsed;
+  ASSERT_EQ(ParseOfflineMemoryPlans(SerializeOfflineMemoryPlans(plans),
+                                    plans.size(), &parsed),
+            kTfLiteOk);
+  EXPECT_EQ(parsed, plans);
+}
+
+TEST(OfflineMemoryPlanTest, InvalidPlans) {
+  const std::string data = SerializeOfflineMemoryPlans({{}, {0, 16, 0, 1}});
+  std::vector<std::vector<int32_t>> parsed;
+  // Subgraph out of range.
+  EXPECT_EQ(ParseOfflineMemoryPlans(data, 1, &parsed), kTfLiteError);
+  // Truncated.
+  EXPECT_EQ(ParseOfflineMemoryPlans(data.substr(0, data.size() - 4), 2,
+                                    &parsed),
+            kTfLiteError);
+  // Another version.
+  std::string other_version = data;
+  other_version[0] = 1;
+  EXPECT_EQ(ParseOfflineMemoryPlans(other_version, 2, &parsed), kTfLiteError);
+}
+
+TEST(OfflineMemoryPlanTest, OptimizeReachesLowerBound) {
+  // Tensors of 32, 16 and 32 bytes used at nodes 0-1, 1-2 and 2-3, placed one
+  // after the other, and an unplaced tensor.
+  const std::vector<int32_t> plan = {0,  32, 0, 1, 32, 16, 1, 2,
+                                     48, 32, 2, 3, -1, 0,  0, 0};
+  std::vector<int32_t> optimized;
+  OfflineMemoryPlanStats stats;
+  ASSERT_EQ(OptimizeOfflineMemoryPlan(plan, /*alignment=*/16,
+                                      /*time_budget_seconds=*/1.0, &optimized,
+                                      &stats),
+            kTfLiteOk);
+  EXPECT_EQ(stats.initial_arena_size, 80);
+  EXPECT_EQ(stats.lower_bound, 48);
+  EXPECT_EQ(stats.arena_size, 48);
+  ASSERT_EQ(optimized.size(), plan.size());
+  // The first and last tensors share their offset, and the second one is
+  // placed after them.
+  EXPECT_EQ(optimized[0], optimized[8]);
+  EXPECT_EQ(optimized[4], optimized[0] == 0 ? 32 : 0);
+  EXPECT_EQ(optimized[12], -1);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(optimized[4 * i + 1], plan[4 * i + 1]);
+    EXPECT_EQ(optimized[4 * i + 2], plan[4 * i + 2]);
+    EXPECT_EQ(optimized[4 * i + 3], plan[4 * i + 3]);
+  }
+}
+
+TEST(OfflineMemoryPlanTest, OptimizeKeepsOptimalPlan) {
+  const std::vector<int32_t> plan = {16, 32, 0, 1, 0, 16, 1, 2, 16, 32, 2, 3};
+  std::vector<int32_t> optimized;
+  OfflineMemoryPlanStats stats;
+  ASSERT_EQ(OptimizeOfflineMemoryPlan(plan, /*alignment=*/16,
+                                      /*time_budget_seconds=*/0.0, &optimized,
+                                      &stats),
+            kTfLiteOk);
+  EXPECT_EQ(optimized, plan);
+  EXPECT_EQ(stats.arena_size, 48);
+  EXPECT_EQ(stats.lower_bound, 48);
+}
+
+TEST(OfflineMemoryPlanTest, OptimizeInvalidPlan) {
+  std::vector<int32_t> optimized;
+  EXPECT_EQ(OptimizeOfflineMemoryPlan({0, 16, 0}, 16, 0.0, &optimized,
+                                      /*stats=*/nullptr),
+            kTfLiteError);
+  EXPECT_EQ(OptimizeOfflineMemoryPlan({0, 16, 2, 1}, 16, 0.0, &optimized,
+                                      /*stats=*/nullptr),
+            kTfLiteError);
+}
+
+}  // namespace
+}  // namespace tflite
@@ -0,0 +1,67 @@
+// This file contains the implementation of ParallelTaskRunner.
+
+#include "tensorflow/lite/parallel_task_runner.h"
+
+namespace tflite {
+
+ParallelTaskRunner::ParallelTaskRunner(int num_threads) {
+  for (int thread = 1; thread < num_threads; ++thread) {
+    workers_.emplace_back([this, thread] { WorkerLoop(thread); });
+  }
+}
+
+ParallelTaskRunner::~ParallelTaskRunner() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  batch_started_.notify_all();
+  for (std::thread& worker : workers_) worker.join();
+}
+
+void ParallelTaskRunner::Run(int num_tasks,
+                             const std::function<void(int, int)>& task) {
+  if (workers_.empty() || num_tasks <= 1) {
+    for (int i = 0; i < num_tasks; ++i) task(i, 0);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    num_tasks_ = num_tasks;
+    next_task_.store(0, std::memory_order_relaxed);
+    num_busy_workers_ = workers_.size();
+    ++batch_;
+  }
+  batch_started_.notify_all();
+  RunTasks(0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  batch_done_.wait(lock, [this] { return num_busy_workers_ == 0; });
+  task_ = nullptr;
+}
+
+void ParallelTaskRunner::WorkerLoop(int thread) {
+  int64_t last_batch = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      batch_started_.wait(lock, [this, last_batch] {
+        return stopping_ || batch_ != last_batch;
+      });
+      if (stopping_) return;
+      last_batch = batch_;
+    }
+    RunTasks(thread);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--num_busy_workers_ == 0) batch_done_.notify_one();
+  }
+}
+
+void ParallelTaskRunner::RunTasks(int thread) {
+  for (int i = next_task_.fetch_add(1, std::memory_order_relaxed);
+       i < num_tasks_; i = next_task_.fetch_add(1, std::memory_order_relaxed)) {
+    (*task_)(i, thread);
+  }
+}
+
+}  // namespace tflite
@@ -0,0 +1,60 @@
+// This file contains ParallelTaskRunner, a fixed set of worker threads that
+// run batches of independent tasks together with the calling thread, e.g. the
+// independent nodes of a subgraph.
+
+#ifndef TENSORFLOW_LITE_PARALLEL_TASK_RUNNER_H_
+#define TENSORFLOW_LITE_PARALLEL_TASK_RUNNER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <functional>
+#include <mutex>   // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+namespace tflite {
+
+// Runs the tasks of a batch on `num_threads` threads, the calling thread being
+// one of them, and returns once all of them are done. The workers sleep in
+// between batches. Batches must not be run concurrently.
+class ParallelTaskRunner {
+ public:
+  // Starts `num_threads - 1` worker threads.
+  explicit ParallelTaskRunner(int num_threads);
+  ~ParallelTaskRunner();
+  ParallelTaskRunner(const ParallelTaskRunner&) = delete;
+  ParallelTaskRunner& operator=(const ParallelTaskRunner&) = delete;
+
+  int num_threads() const { return workers_.size() + 1; }
+
+  // Calls `task(i, thread)` for all i in [0, num_tasks), where `thread` in
+  // [0, num_threads()) identifies the thread running the task, 0 being the
+  // calling thread. Tasks are handed out in increasing order.
+  void Run(int num_tasks, const std::function<void(int, int)>& task);
+
+ private:
+  void WorkerLoop(int thread);
+
+  // Runs the tasks of the current batch until none is left.
+  void RunTasks(int thread);
+
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable batch_started_;
+  std::condition_variable batch_done_;
+  // The current batch, set under `mutex_` before `batch_` is incremented.
+  const std::function<void(int, int)>* task_ = nullptr;
+  int num_tasks_ = 0;
+  std::atomic<int> next_task_{0};
+  // Number of the current batch, and of workers still running it.
+  int64_t batch_ = 0;
+  int num_busy_workers_ = 0;
+  bool stopping_ = false;
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_PARALLEL_TASK_RUNNER_H_
@@ -0,0 +1,50 @@
+#include "tensorflow/lite/parallel_task_runner.h"
+
+#include <atomic>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace tflite {
+namespace {
+
+TEST(ParallelTaskRunnerTest, RunsAllTasksOnce) {
+  ParallelTaskRunner runner(4);
+  EXPECT_EQ(runner.num_threads(), 4);
+  for (int num_tasks : {0, 1, 3, 100}) {
+    std::vector<std::atomic<int>> runs(num_tasks);
+    for (auto& run : runs) run = 0;
+    std::atomic<bool> valid_threads{true};
+    runner.Run(num_tasks, [&](int task, int thread) {
+      ++runs[task];
+      if (thread < 0 || thread >= 4) valid_threads = false;
+    });
+    for (const auto& run : runs) EXPECT_EQ(run, 1);
+    EXPECT_TRUE(valid_threads);
+  }
+}
+
+TEST(ParallelTaskRunnerTest, RunsTasksConcurrently) {
+  ParallelTaskRunner runner(2);
+  // Each task waits for the other one, so both must run at the same time.
+  std::atomic<int> started{0};
+  runner.Run(2, [&](int task, int thread) {
+    ++started;
+    while (started < 2) {
+    }
+  });
+  EXPECT_EQ(started, 2);
+}
+
+TEST(ParallelTaskRunnerTest, SingleThread) {
+  ParallelTaskRunner runner(1);
+  std::vector<int> order;
+  runner.Run(3, [&](int task, int thread) {
+    EXPECT_EQ(thread, 0);
+    order.push_back(task);
+  });
+  EXPECT_EQ(order, std::vector<int>({0, 1, 2}));
+}
+
+}  // namespace
+}  // namespace tflite
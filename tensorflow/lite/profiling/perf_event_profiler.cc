@@ -0,0 +1,274 @@
+// This file contains the implementation of PerfEventProfiler and
+// HardwareCounterSummarizer.
+
+#include "tensorflow/lite/profiling/perf_event_profiler.h"
+
+#include <cstring>
+#include <sstream>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "tensorflow/lite/profiling/time.h"
+
+namespace tflite {
+namespace profiling {
+namespace {
+
+constexpr uint32_t kInvalidHandle = static_cast<uint32_t>(~0);
+// Used to estimate the memory traffic from the cache misses.
+constexpr int64_t kCacheLineSize = 64;
+
+bool IsOperatorEvent(Profiler::EventType event_type) {
+  return event_type == Profiler::EventType::OPERATOR_INVOKE_EVENT ||
+         event_type == Profiler::EventType::DELEGATE_OPERATOR_INVOKE_EVENT;
+}
+
+#if defined(__linux__)
+uint64_t PerfEventConfig(HardwareCounter counter) {
+  switch (counter) {
+    case HardwareCounter::kCycles:
+      return PERF_COUNT_HW_CPU_CYCLES;
+    case HardwareCounter::kInstructions:
+      return PERF_COUNT_HW_INSTRUCTIONS;
+    case HardwareCounter::kCacheReferences:
+      return PERF_COUNT_HW_CACHE_REFERENCES;
+    case HardwareCounter::kCacheMisses:
+      return PERF_COUNT_HW_CACHE_MISSES;
+    case HardwareCounter::kBranchMisses:
+      return PERF_COUNT_HW_BRANCH_MISSES;
+  }
+  return PERF_COUNT_HW_CPU_CYCLES;
+}
+
+int OpenPerfEvent(HardwareCounter counter, int group_fd) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PerfEventConfig(counter);
+  attr.read_format = PERF_FORMAT_GROUP;
+  // Only user space is counted, which needs the least privileges
+  // (perf_event_paranoid <= 2).
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return static_cast<int>(syscall(__NR_perf_event_open, &attr, /*pid=*/0,
+                                  /*cpu=*/-1, group_fd, /*flags=*/0));
+}
+#endif
+
+// Writes `value` or nothing if it is unknown.
+void WriteCounter(std::ostream* stream, int64_t value) {
+  if (value >= 0) (*stream) << value;
+}
+
+void WriteRatio(std::ostream* stream, int64_t numerator, int64_t denominator,
+                double scale = 1.0) {
+  if (numerator >= 0 && denominator > 0) {
+    (*stream) << scale * numerator / denominator;
+  }
+}
+
+std::string EscapeJson(const std::string& value) {
+  std::string escaped;
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) >= 0x20) {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+}  // namespace
+
+const char* HardwareCounterName(HardwareCounter counter) {
+  switch (counter) {
+    case HardwareCounter::kCycles:
+      return "cycles";
+    case HardwareCounter::kInstructions:
+      return "instructions";
+    case HardwareCounter::kCacheReferences:
+      return "cache_references";
+    case HardwareCounter::kCacheMisses:
+      return "cache_misses";
+    case HardwareCounter::kBranchMisses:
+      return "branch_misses";
+  }
+  return "unknown";
+}
+
+PerfEventProfiler::PerfEventProfiler() {
+  fds_.fill(-1);
+#if defined(__linux__)
+  for (int i = 0; i < kNumHardwareCounters; ++i) {
+    fds_[i] = OpenPerfEvent(static_cast<HardwareCounter>(i), group_fd_);
+    if (fds_[i] < 0) {
+      fds_[i] = -1;
+      continue;
+    }
+    if (group_fd_ < 0) group_fd_ = fds_[i];
+    ++num_open_counters_;
+  }
+#endif
+}
+
+PerfEventProfiler::~PerfEventProfiler() {
+#if defined(__linux__)
+  // The group leader is closed last.
+  for (int i = kNumHardwareCounters - 1; i >= 0; --i) {
+    if (fds_[i] >= 0) close(fds_[i]);
+  }
+#endif
+}
+
+void PerfEventProfiler::ReadCounters(HardwareCounterValues* values) const {
+  values->fill(-1);
+#if defined(__linux__)
+  // The group is read as the number of counters followed by their values, in
+  // the order they were opened.
+  uint64_t buffer[1 + kNumHardwareCounters];
+  const ssize_t size = read(group_fd_, buffer, sizeof(buffer));
+  if (size < static_cast<ssize_t>(sizeof(uint64_t)) ||
+      buffer[0] != static_cast<uint64_t>(num_open_counters_)) {
+    return;
+  }
+  int value_index = 1;
+  for (int i = 0; i < kNumHardwareCounters; ++i) {
+    if (fds_[i] >= 0) {
+      (*values)[i] = static_cast<int64_t>(buffer[value_index++]);
+    }
+  }
+#endif
+}
+
+uint32_t PerfEventProfiler::BeginEvent(const char* tag, EventType event_type,
+                                       int64_t event_metadata1,
+                                       int64_t event_metadata2) {
+  if (!enabled_ || !IsSupported() || !IsOperatorEvent(event_type)) {
+    return kInvalidHandle;
+  }
+  events_.emplace_back();
+  HardwareCounterEvent& event = events_.back();
+  event.tag = tag;
+  event.event_type = event_type;
+  event.node_index = event_metadata1;
+  event.subgraph_index = event_metadata2;
+  event.elapsed_time_us = 0;
+  event.begin_timestamp_us = time::NowMicros();
+  // The counters are read last, so that the profiler itself is not counted.
+  ReadCounters(&event.counters);
+  return static_cast<uint32_t>(events_.size() - 1);
+}
+
+void PerfEventProfiler::EndEvent(uint32_t event_handle) {
+  if (event_handle == kInvalidHandle || event_handle >= events_.size()) return;
+  HardwareCounterValues end_counters;
+  ReadCounters(&end_counters);
+  HardwareCounterEvent& event = events_[event_handle];
+  event.elapsed_time_us = time::NowMicros() - event.begin_timestamp_us;
+  for (int i = 0; i < kNumHardwareCounters; ++i) {
+    event.counters[i] = event.counters[i] >= 0 && end_counters[i] >= 0
+                            ? end_counters[i] - event.counters[i]
+                            : -1;
+  }
+}
+
+void HardwareCounterSummarizer::ProcessEvents(
+    const std::vector<HardwareCounterEvent>& events) {
+  for (const HardwareCounterEvent& event : events) {
+    OpStats& stats = ops_[std::make_tuple(event.subgraph_index,
+                                          static_cast<int>(event.event_type),
+                                          event.node_index)];
+    stats.tag = event.tag;
+    stats.event_type = event.event_type;
+    ++stats.num_runs;
+    stats.total_time_us += event.elapsed_time_us;
+    for (int i = 0; i < kNumHardwareCounters; ++i) {
+      // A counter is only reported if it was read in every run.
+      if (stats.total_counters[i] < 0 || event.counters[i] < 0) {
+        stats.total_counters[i] = -1;
+      } else {
+        stats.total_counters[i] += event.counters[i];
+      }
+    }
+  }
+  trace_events_.insert(trace_events_.end(), events.begin(), events.end());
+}
+
+std::string HardwareCounterSummarizer::GetCsvString() const {
+  std::stringstream stream;
+  stream << "Subgraph,Node,Op,Delegated,Runs,Avg time (us)";
+  for (int i = 0; i < kNumHardwareCounters; ++i) {
+    stream << ",Avg " << HardwareCounterName(static_cast<HardwareCounter>(i));
+  }
+  stream << ",IPC,Cache miss ratio,Est. memory traffic (MB/s)\n";
+  for (const auto& op : ops_) {
+    const OpStats& stats = op.second;
+    const HardwareCounterValues& totals = stats.total_counters;
+    stream << std::get<0>(op.first) << "," << std::get<2>(op.first) << ","
+           << stats.tag << ","
+           << (stats.event_type ==
+                       Profiler::EventType::DELEGATE_OPERATOR_INVOKE_EVENT
+                   ? "true"
+                   : "false")
+           << "," << stats.num_runs << ","
+           << stats.total_time_us / stats.num_runs;
+    for (int i = 0; i < kNumHardwareCounters; ++i) {
+      stream << ",";
+      WriteCounter(&stream,
+                   totals[i] < 0 ? -1 : totals[i] / stats.num_runs);
+    }
+    const int64_t cycles = totals[static_cast<int>(HardwareCounter::kCycles)];
+    const int64_t instructions =
+        totals[static_cast<int>(HardwareCounter::kInstructions)];
+    const int64_t references =
+        totals[static_cast<int>(HardwareCounter::kCacheReferences)];
+    const int64_t misses =
+        totals[static_cast<int>(HardwareCounter::kCacheMisses)];
+    stream << ",";
+    WriteRatio(&stream, instructions, cycles);
+    stream << ",";
+    WriteRatio(&stream, misses, references);
+    stream << ",";
+    // Bytes per microsecond are MB/s.
+    WriteRatio(&stream, misses, static_cast<int64_t>(stats.total_time_us),
+               kCacheLineSize);
+    stream << "\n";
+  }
+  return stream.str();
+}
+
+std::string HardwareCounterSummarizer::GetChromeTraceString() const {
+  std::stringstream stream;
+  stream << "{\"traceEvents\":[";
+  for (size_t i = 0; i < trace_events_.size(); ++i) {
+    const HardwareCounterEvent& event = trace_events_[i];
+    if (i > 0) stream << ",";
+    stream << "\n{\"name\":\"" << EscapeJson(event.tag) << "\",\"cat\":\""
+           << (event.event_type ==
+                       Profiler::EventType::DELEGATE_OPERATOR_INVOKE_EVENT
+                   ? "delegate_operator"
+                   : "operator")
+           << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.subgraph_index
+           << ",\"ts\":" << event.begin_timestamp_us
+           << ",\"dur\":" << event.elapsed_time_us
+           << ",\"args\":{\"node_index\":" << event.node_index;
+    for (int c = 0; c < kNumHardwareCounters; ++c) {
+      if (event.counters[c] < 0) continue;
+      stream << ",\"" << HardwareCounterName(static_cast<HardwareCounter>(c))
+             << "\":" << event.counters[c];
+    }
+    stream << "}}";
+  }
+  stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return stream.str();
+}
+
+}  // namespace profiling
+}  // namespace tflite
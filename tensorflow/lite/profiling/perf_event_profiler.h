@@ -0,0 +1,124 @@
+// This file contains a profiler that records hardware performance counters,
+// read through perf_event on Linux and Android, for each operator invocation.
+
+#ifndef TENSORFLOW_LITE_PROFILING_PERF_EVENT_PROFILER_H_
+#define TENSORFLOW_LITE_PROFILING_PERF_EVENT_PROFILER_H_
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "tensorflow/lite/core/api/profiler.h"
+
+namespace tflite {
+namespace profiling {
+
+// The hardware counters read for each operator invocation.
+enum class HardwareCounter {
+  kCycles = 0,
+  kInstructions,
+  kCacheReferences,
+  // Usually the last level cache misses, i.e. the lines read from memory.
+  kCacheMisses,
+  kBranchMisses,
+};
+constexpr int kNumHardwareCounters = 5;
+
+// Returns the name of `counter` used in the exported profiles.
+const char* HardwareCounterName(HardwareCounter counter);
+
+// The counters of an operator invocation. Counters that the CPU or kernel
+// does not provide are -1.
+using HardwareCounterValues = std::array<int64_t, kNumHardwareCounters>;
+
+// An operator invocation profiled by PerfEventProfiler.
+struct HardwareCounterEvent {
+  std::string tag;
+  Profiler::EventType event_type;
+  // The index of the node and of its subgraph, as in ProfileEvent.
+  int64_t node_index;
+  int64_t subgraph_index;
+  uint64_t begin_timestamp_us;
+  uint64_t elapsed_time_us;
+  HardwareCounterValues counters;
+};
+
+// Records the hardware counters of the thread invoking the interpreter for
+// each OPERATOR_INVOKE_EVENT and DELEGATE_OPERATOR_INVOKE_EVENT. The threads
+// of the CPU backend context or of the delegates are not counted, so the
+// counters of multi-threaded kernels are only those of their calling thread.
+// It may be installed next to other profilers with Interpreter::AddProfiler.
+// This class is *not thread safe*.
+class PerfEventProfiler : public tflite::Profiler {
+ public:
+  PerfEventProfiler();
+  ~PerfEventProfiler() override;
+
+  // Returns true if at least one counter could be opened. When false, no
+  // events are recorded.
+  bool IsSupported() const { return num_open_counters_ > 0; }
+
+  uint32_t BeginEvent(const char* tag, EventType event_type,
+                      int64_t event_metadata1,
+                      int64_t event_metadata2) override;
+  void EndEvent(uint32_t event_handle) override;
+
+  void StartProfiling() { enabled_ = true; }
+  void StopProfiling() { enabled_ = false; }
+  void Reset() { events_.clear(); }
+
+  // The events recorded since the last Reset(), in the order they began.
+  const std::vector<HardwareCounterEvent>& events() const { return events_; }
+
+ private:
+  // Reads the current values of the counters that are open.
+  void ReadCounters(HardwareCounterValues* values) const;
+
+  // perf_event file descriptors, or -1 for counters that are not open. The
+  // first open counter leads the group the others are read with.
+  std::array<int, kNumHardwareCounters> fds_;
+  int group_fd_ = -1;
+  int num_open_counters_ = 0;
+  bool enabled_ = false;
+  std::vector<HardwareCounterEvent> events_;
+};
+
+// Aggregates the hardware counters of the operators over several runs and
+// exports them as CSV or as a Chrome trace.
+class HardwareCounterSummarizer {
+ public:
+  // Adds the events of one run.
+  void ProcessEvents(const std::vector<HardwareCounterEvent>& events);
+
+  bool HasEvents() const { return !ops_.empty(); }
+
+  // Returns one CSV row per operator with its average time and counters per
+  // run, and the derived instructions per cycle, cache miss ratio and
+  // estimated memory traffic, which tell memory-bound from compute-bound ops.
+  std::string GetCsvString() const;
+
+  // Returns the events of all processed runs in the Chrome trace event
+  // format, with the counters as arguments of each event.
+  std::string GetChromeTraceString() const;
+
+ private:
+  struct OpStats {
+    std::string tag;
+    Profiler::EventType event_type;
+    int64_t num_runs = 0;
+    uint64_t total_time_us = 0;
+    HardwareCounterValues total_counters{};
+  };
+
+  // Keyed by the subgraph, event type and node index of the operators.
+  std::map<std::tuple<int64_t, int, int64_t>, OpStats> ops_;
+  std::vector<HardwareCounterEvent> trace_events_;
+};
+
+}  // namespace profiling
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_PROFILING_PERF_EVENT_PROFILER_H_
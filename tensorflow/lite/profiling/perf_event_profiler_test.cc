@@ -0,0 +1,87 @@
+#include "tensorflow/lite/profiling/perf_event_profiler.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace tflite {
+namespace profiling {
+namespace {
+
+HardwareCounterEvent CreateEvent(const char* tag, int64_t node_index,
+                                 uint64_t elapsed_time_us, int64_t cycles,
+                                 int64_t instructions) {
+  HardwareCounterEvent event;
+  event.tag = tag;
+  event.event_type = Profiler::EventType::OPERATOR_INVOKE_EVENT;
+  event.node_index = node_index;
+  event.subgraph_index = 0;
+  event.begin_timestamp_us = 100;
+  event.elapsed_time_us = elapsed_time_us;
+  event.counters = {cycles, instructions, 1000, 100, -1};
+  return event;
+}
+
+TEST(PerfEventProfilerTest, RecordsOnlyOperatorEvents) {
+  PerfEventProfiler profiler;
+  if (!profiler.IsSupported()) GTEST_SKIP();
+  profiler.StartProfiling();
+  profiler.EndEvent(
+      profiler.BeginEvent("Invoke", Profiler::EventType::DEFAULT, 0, 0));
+  const uint32_t handle = profiler.BeginEvent(
+      "ADD", Profiler::EventType::OPERATOR_INVOKE_EVENT, 3, 1);
+  volatile int sum = 0;
+  for (int i = 0; i < 100000; ++i) sum = sum + i;
+  profiler.EndEvent(handle);
+  profiler.StopProfiling();
+  profiler.EndEvent(
+      profiler.BeginEvent("ADD", Profiler::EventType::OPERATOR_INVOKE_EVENT,
+                          4, 1));
+
+  ASSERT_EQ(profiler.events().size(), 1);
+  const HardwareCounterEvent& event = profiler.events()[0];
+  EXPECT_EQ(event.tag, "ADD");
+  EXPECT_EQ(event.node_index, 3);
+  EXPECT_EQ(event.subgraph_index, 1);
+  bool has_counter = false;
+  for (int64_t counter : event.counters) has_counter |= counter >= 0;
+  EXPECT_TRUE(has_counter);
+
+  profiler.Reset();
+  EXPECT_TRUE(profiler.events().empty());
+}
+
+TEST(HardwareCounterSummarizerTest, AveragesRuns) {
+  HardwareCounterSummarizer summarizer;
+  EXPECT_FALSE(summarizer.HasEvents());
+  summarizer.ProcessEvents({CreateEvent("CONV_2D", 0, 10, 2000, 4000),
+                            CreateEvent("ADD", 1, 2, 100, 50)});
+  summarizer.ProcessEvents({CreateEvent("CONV_2D", 0, 30, 6000, 12000),
+                            CreateEvent("ADD", 1, 2, 100, 50)});
+  EXPECT_TRUE(summarizer.HasEvents());
+
+  EXPECT_EQ(summarizer.GetCsvString(),
+            "Subgraph,Node,Op,Delegated,Runs,Avg time (us),Avg cycles,"
+            "Avg instructions,Avg cache_references,Avg cache_misses,"
+            "Avg branch_misses,IPC,Cache miss ratio,"
+            "Est. memory traffic (MB/s)\n"
+            "0,0,CONV_2D,false,2,20,4000,8000,1000,100,,2,0.1,320\n"
+            "0,1,ADD,false,2,2,100,50,1000,100,,0.5,0.1,3200\n");
+}
+
+TEST(HardwareCounterSummarizerTest, ChromeTrace) {
+  HardwareCounterSummarizer summarizer;
+  summarizer.ProcessEvents({CreateEvent("CONV_2D", 0, 10, 2000, 4000)});
+  EXPECT_EQ(summarizer.GetChromeTraceString(),
+            "{\"traceEvents\":[\n"
+            "{\"name\":\"CONV_2D\",\"cat\":\"operator\",\"ph\":\"X\","
+            "\"pid\":0,\"tid\":0,\"ts\":100,\"dur\":10,\"args\":{"
+            "\"node_index\":0,\"cycles\":2000,\"instructions\":4000,"
+            "\"cache_references\":1000,\"cache_misses\":100}}\n"
+            "],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+}  // namespace
+}  // namespace profiling
+}  // namespace tflite
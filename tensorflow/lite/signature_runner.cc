@@ -75,9 +75,42 @@ TfLiteStatus SignatureRunner::Invoke() {
 
   // Makes sure output tensors are readable.
   for (int tensor_index : subgraph_->outputs()) {
+    // Added by Alpa. The outputs bound to buffer handles stay in them.
+    if (buffer_handle_outputs_.count(tensor_index)) {
+      subgraph_->tensor(tensor_index)->data_is_stale = true;
+      continue;
+    }
     TF_LITE_ENSURE_STATUS(subgraph_->EnsureTensorDataIsReadable(tensor_index));
   }
   return kTfLiteOk;
 }
 
+TfLiteStatus SignatureRunner::SetInputBufferHandle(
+    const char* input_name, TfLiteBufferHandle buffer_handle,
+    TfLiteDelegate* delegate) {
+  const auto& it = signature_def_->inputs.find(input_name);
+  if (it == signature_def_->inputs.end()) {
+    subgraph_->ReportError("Input name %s was not found", input_name);
+    return kTfLiteError;
+  }
+  TF_LITE_ENSURE_STATUS(
+      subgraph_->SetBufferHandle(it->second, buffer_handle, delegate));
+  subgraph_->tensor(it->second)->data_is_stale = true;
+  return kTfLiteOk;
+}
+
+TfLiteStatus SignatureRunner::SetOutputBufferHandle(
+    const char* output_name, TfLiteBufferHandle buffer_handle,
+    TfLiteDelegate* delegate) {
+  const auto& it = signature_def_->outputs.find(output_name);
+  if (it == signature_def_->outputs.end()) {
+    subgraph_->ReportError("Output name %s was not found", output_name);
+    return kTfLiteError;
+  }
+  TF_LITE_ENSURE_STATUS(
+      subgraph_->SetBufferHandle(it->second, buffer_handle, delegate));
+  buffer_handle_outputs_.insert(it->second);
+  return kTfLiteOk;
+}
+
 }  // namespace tflite
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <cstddef>
 #include <cstdint>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -135,6 +136,28 @@ class SignatureRunner {
   /// signature in dependency order).
   TfLiteStatus Invoke();
 
+  /// Binds `buffer_handle`, registered with `delegate`, to the input tensor
+  /// identified by 'input_name', so that the nodes run by `delegate` read the
+  /// input from the delegate's buffer, such as an AHardwareBuffer or a
+  /// dma-buf holding a camera frame, instead of the tensor memory. The data
+  /// of the tensor is marked stale, so that other nodes reading the input
+  /// first copy it from the buffer. Binding the same handle again, which is
+  /// cheap, signals that the buffer holds a new input.
+  /// WARNING: This is an experimental API and subject to change.
+  TfLiteStatus SetInputBufferHandle(const char* input_name,
+                                    TfLiteBufferHandle buffer_handle,
+                                    TfLiteDelegate* delegate);
+
+  /// Binds `buffer_handle`, registered with `delegate`, to the output tensor
+  /// identified by 'output_name', so that the node run by `delegate` that
+  /// produces it writes the output to the delegate's buffer. Invoke() then
+  /// leaves the output in the buffer and marks the data of the tensor stale,
+  /// instead of copying it back into the tensor memory.
+  /// WARNING: This is an experimental API and subject to change.
+  TfLiteStatus SetOutputBufferHandle(const char* output_name,
+                                     TfLiteBufferHandle buffer_handle,
+                                     TfLiteDelegate* delegate);
+
  private:
   // The life cycle of SignatureRunner depends on the life cycle of Subgraph,
   // which is owned by an Interpreter. Therefore, the Interpreter will takes the
@@ -155,6 +178,9 @@ class SignatureRunner {
   std::vector<const char*> input_names_;
   // The list of output tensor names.
   std::vector<const char*> output_names_;
+  // Added by Alpa. The indices of the output tensors bound to buffer handles
+  // with SetOutputBufferHandle.
+  std::set<int> buffer_handle_outputs_;
 };
 
 }  // namespace tflite
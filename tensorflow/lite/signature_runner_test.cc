@@ -14,7 +14,9 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/lite/signature_runner.h"
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -93,5 +95,75 @@ TEST(SignatureRunnerTest, TestMultiSignatures) {
   ASSERT_EQ(sub_output->data.f[2], 3);
 }
 
+// Added by Alpa. A delegate that only owns buffers, which hold 2 floats.
+struct BufferDelegate : public TfLiteDelegate {
+  BufferDelegate() : TfLiteDelegate(TfLiteDelegateCreate()) {
+    data_ = this;
+    CopyFromBufferHandle = [](TfLiteContext* context, TfLiteDelegate* delegate,
+                              TfLiteBufferHandle buffer_handle,
+                              TfLiteTensor* tensor) {
+      auto* self = static_cast<BufferDelegate*>(delegate->data_);
+      std::copy(self->buffers[buffer_handle].begin(),
+                self->buffers[buffer_handle].end(), tensor->data.f);
+      return kTfLiteOk;
+    };
+    FreeBufferHandle = [](TfLiteContext* context, TfLiteDelegate* delegate,
+                          TfLiteBufferHandle* buffer_handle) {
+      ++static_cast<BufferDelegate*>(delegate->data_)->num_freed;
+      *buffer_handle = kTfLiteNullBufferHandle;
+    };
+  }
+
+  std::vector<std::vector<float>> buffers = {{1, 2}, {5, 7}};
+  int num_freed = 0;
+};
+
+TEST(SignatureRunnerTest, BufferHandles) {
+  auto model = FlatBufferModel::BuildFromFile(
+      "tensorflow/lite/testdata/multi_signatures.bin");
+  ASSERT_TRUE(model);
+  ops::builtin::BuiltinOpResolver resolver;
+  std::unique_ptr<Interpreter> interpreter;
+  ASSERT_EQ(InterpreterBuilder(*model, resolver)(&interpreter), kTfLiteOk);
+  BufferDelegate delegate;
+
+  SignatureRunner* runner = interpreter->GetSignatureRunner("add");
+  ASSERT_NE(runner, nullptr);
+  ASSERT_EQ(runner->ResizeInputTensor("x", {2}), kTfLiteOk);
+  ASSERT_EQ(runner->AllocateTensors(), kTfLiteOk);
+  EXPECT_EQ(runner->SetInputBufferHandle("dummy", 0, &delegate), kTfLiteError);
+  EXPECT_EQ(runner->SetOutputBufferHandle("dummy", 0, &delegate),
+            kTfLiteError);
+
+  // The CPU kernel reading the input copies it from the buffer first.
+  ASSERT_EQ(runner->SetInputBufferHandle("x", 0, &delegate), kTfLiteOk);
+  ASSERT_EQ(runner->Invoke(), kTfLiteOk);
+  const TfLiteTensor* output = runner->output_tensor("output_0");
+  EXPECT_EQ(output->data.f[0], 3);
+  EXPECT_EQ(output->data.f[1], 4);
+
+  // Binding the same handle again reads the new input without releasing it.
+  delegate.buffers[0] = {3, 4};
+  ASSERT_EQ(runner->SetInputBufferHandle("x", 0, &delegate), kTfLiteOk);
+  ASSERT_EQ(runner->Invoke(), kTfLiteOk);
+  EXPECT_EQ(output->data.f[0], 5);
+  EXPECT_EQ(output->data.f[1], 6);
+  EXPECT_EQ(delegate.num_freed, 0);
+
+  // Binding another handle releases the previous one.
+  ASSERT_EQ(runner->SetInputBufferHandle("x", 1, &delegate), kTfLiteOk);
+  EXPECT_EQ(delegate.num_freed, 1);
+  ASSERT_EQ(runner->Invoke(), kTfLiteOk);
+  EXPECT_EQ(output->data.f[0], 7);
+  EXPECT_EQ(output->data.f[1], 9);
+
+  // Outputs bound to buffers are left in them.
+  ASSERT_EQ(runner->SetOutputBufferHandle("output_0", 0, &delegate),
+            kTfLiteOk);
+  ASSERT_EQ(runner->Invoke(), kTfLiteOk);
+  EXPECT_TRUE(output->data_is_stale);
+  interpreter.reset();
+}
+
 }  // namespace
 }  // namespace tflite
@@ -24,6 +24,7 @@ limitations under the License.
 #include <limits>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "tensorflow/lite/c/common.h"
@@ -141,9 +142,68 @@ TfLiteStatus SimpleMemoryArena::Allocate(
   return kTfLiteOk;
 }
 
+TfLiteStatus SimpleMemoryArena::AllocateAt(
+    TfLiteContext* context, size_t offset, size_t size, int32_t tensor,
+    int32_t first_node, int32_t last_node,
+    ArenaAllocWithUsageInterval* new_alloc) {
+  new_alloc->tensor = tensor;
+  new_alloc->first_node = first_node;
+  new_alloc->last_node = last_node;
+  new_alloc->size = size;
+  if (size == 0) {
+    new_alloc->offset = 0;
+    return kTfLiteOk;
+  }
+  new_alloc->offset = offset;
+  high_water_mark_ = std::max(high_water_mark_, offset + size);
+  auto insertion_it = std::upper_bound(active_allocs_.begin(),
+                                       active_allocs_.end(), *new_alloc);
+  active_allocs_.insert(insertion_it, *new_alloc);
+  return kTfLiteOk;
+}
+
+std::shared_ptr<char> SharedArenaBuffer::Acquire(size_t size) {
+  if (size > size_) {
+    std::shared_ptr<char> allocation(new char[size + alignment_],
+                                     std::default_delete<char[]>());
+    char* aligned_ptr = reinterpret_cast<char*>(
+        AlignTo(alignment_, reinterpret_cast<intptr_t>(allocation.get())));
+    // The aligned pointer shares the ownership of the allocation.
+    buffer_ = std::shared_ptr<char>(allocation, aligned_ptr);
+    size_ = size;
+  }
+  return buffer_;
+}
+
+TfLiteStatus SimpleMemoryArena::SetSharedBuffer(
+    TfLiteContext* context, std::shared_ptr<SharedArenaBuffer> buffer) {
+  TF_LITE_ENSURE(context, buffer != nullptr);
+  TF_LITE_ENSURE(context, underlying_buffer_size_ == 0);
+  TF_LITE_ENSURE_EQ(context, buffer->alignment() % arena_alignment_, 0);
+  shared_buffer_ = std::move(buffer);
+  return kTfLiteOk;
+}
+
 TfLiteStatus SimpleMemoryArena::Commit(TfLiteContext* context,
                                        bool* arena_reallocated) {
   size_t required_size = RequiredBufferSize();
+  if (shared_buffer_ != nullptr) {
+    // Added by Alpa. Switch to the current shared buffer if it was replaced,
+    // carrying over the content of the arena.
+    std::shared_ptr<char> buffer = shared_buffer_->Acquire(required_size);
+    *arena_reallocated = buffer != shared_buffer_data_;
+    if (*arena_reallocated) {
+      if (high_water_mark_ > 0 && underlying_buffer_size_ > 0) {
+        memcpy(buffer.get(), underlying_buffer_aligned_ptr_,
+               std::min(high_water_mark_, underlying_buffer_size_));
+      }
+      shared_buffer_data_ = std::move(buffer);
+      underlying_buffer_size_ = shared_buffer_->size();
+      underlying_buffer_aligned_ptr_ = shared_buffer_data_.get();
+    }
+    committed_ = true;
+    return kTfLiteOk;
+  }
   if (required_size > underlying_buffer_size_) {
     *arena_reallocated = true;
 #ifdef TF_LITE_TENSORFLOW_PROFILER
@@ -208,12 +268,16 @@ TfLiteStatus SimpleMemoryArena::ClearPlan() {
 TfLiteStatus SimpleMemoryArena::ReleaseBuffer() {
   committed_ = false;
 #ifdef TF_LITE_TENSORFLOW_PROFILER
-  OnTfLiteArenaDealloc(subgraph_index_, reinterpret_cast<std::uintptr_t>(this),
-                       underlying_buffer_size_);
+  if (shared_buffer_ == nullptr) {
+    OnTfLiteArenaDealloc(subgraph_index_,
+                         reinterpret_cast<std::uintptr_t>(this),
+                         underlying_buffer_size_);
+  }
 #endif
   underlying_buffer_size_ = 0;
   underlying_buffer_aligned_ptr_ = nullptr;
   underlying_buffer_.reset();
+  shared_buffer_data_.reset();
   return kTfLiteOk;
 }
 
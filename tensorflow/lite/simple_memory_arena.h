@@ -55,6 +55,33 @@ struct ArenaAllocWithUsageInterval {
   }
 };
 
+// Added by Alpa. A buffer shared by the non-persistent arenas of interpreters
+// that never run concurrently, e.g. several models invoked one after the
+// other, so that they need one buffer of the size of the largest arena instead
+// of one buffer each. The buffer grows to the largest size requested. An arena
+// keeps the buffer it was committed into alive after the buffer is replaced by
+// a larger one, and switches to the new buffer, copying its content, on its
+// next Commit(). Hence the inputs of an interpreter must be set, and its
+// outputs read, with no other interpreter sharing the buffer invoked in
+// between. Not thread-safe.
+class SharedArenaBuffer {
+ public:
+  explicit SharedArenaBuffer(size_t alignment) : alignment_(alignment) {}
+
+  // Returns the current buffer, aligned to `alignment()`, after growing it to
+  // at least `size` bytes.
+  std::shared_ptr<char> Acquire(size_t size);
+
+  const std::shared_ptr<char>& buffer() const { return buffer_; }
+  size_t size() const { return size_; }
+  size_t alignment() const { return alignment_; }
+
+ private:
+  const size_t alignment_;
+  std::shared_ptr<char> buffer_;
+  size_t size_ = 0;
+};
+
 // This small class is responsible for allocating, deallocating and reusing
 // dynamic memory from a common underlying buffer. The arena can be used in
 // scenarios when the pattern of memory allocations and deallocations is
@@ -99,6 +126,15 @@ class SimpleMemoryArena {
                         int32_t tensor, int32_t first_node, int32_t last_node,
                         ArenaAllocWithUsageInterval* new_alloc);
 
+  // Added by Alpa. Schedules memory allocation for a tensor like Allocate(),
+  // but at `offset`, chosen by an earlier planning, instead of searching for a
+  // gap. The caller guarantees that the allocation does not overlap the ones
+  // whose usage intervals intersect its own.
+  TfLiteStatus AllocateAt(TfLiteContext* context, size_t offset, size_t size,
+                          int32_t tensor, int32_t first_node,
+                          int32_t last_node,
+                          ArenaAllocWithUsageInterval* new_alloc);
+
   inline size_t RequiredBufferSize() {
     // Add in a small amount of padding to reduce the chance of resize events
     // for small allocations.
@@ -122,6 +158,20 @@ class SimpleMemoryArena {
   // again until Commit() is called & tensor allocations are resolved.
   TfLiteStatus ReleaseBuffer();
 
+  // Added by Alpa. Makes the arena commit into `buffer`, which is shared with
+  // other arenas, instead of into a buffer of its own. Must be called before
+  // the first Commit().
+  TfLiteStatus SetSharedBuffer(TfLiteContext* context,
+                               std::shared_ptr<SharedArenaBuffer> buffer);
+
+  // Added by Alpa. Returns true if the shared buffer was replaced since the
+  // last Commit(), which must then be called again and the allocations
+  // resolved again.
+  bool IsSharedBufferStale() const {
+    return shared_buffer_data_ != nullptr &&
+           shared_buffer_data_ != shared_buffer_->buffer();
+  }
+
   size_t GetBufferSize() const { return underlying_buffer_size_; }
 
   std::intptr_t BasePointer() const {
@@ -155,6 +205,10 @@ class SimpleMemoryArena {
   std::unique_ptr<char[]> underlying_buffer_;
   size_t underlying_buffer_size_;
   char* underlying_buffer_aligned_ptr_;
+  // Added by Alpa. The shared buffer, if any, and the one the arena was
+  // last committed into.
+  std::shared_ptr<SharedArenaBuffer> shared_buffer_;
+  std::shared_ptr<char> shared_buffer_data_;
   std::vector<ArenaAllocWithUsageInterval> active_allocs_;
 };
 
@@ -14,6 +14,8 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/lite/simple_memory_arena.h"
 
+#include <memory>
+
 #include <gtest/gtest.h>
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/testing/util.h"
@@ -369,5 +371,60 @@ TEST_P(BufferAndPlanClearingTest, TestClearBufferAndClearPlan) {
 INSTANTIATE_TEST_SUITE_P(BufferAndPlanClearingTest, BufferAndPlanClearingTest,
                          ::testing::Values(true, false));
 
+TEST(SimpleMemoryArenaTest, TestSharedBuffer) {
+  TfLiteContext context;
+  context.ReportError = ReportError;
+  auto buffer = std::make_shared<SharedArenaBuffer>(64);
+  SimpleMemoryArena small_arena(64);
+  SimpleMemoryArena large_arena(64);
+  ASSERT_EQ(small_arena.SetSharedBuffer(&context, buffer), kTfLiteOk);
+  ASSERT_EQ(large_arena.SetSharedBuffer(&context, buffer), kTfLiteOk);
+  ArenaAllocWithUsageInterval small_alloc;
+  ArenaAllocWithUsageInterval large_alloc;
+  small_arena.Allocate(&context, 32, 1024, 0, 0, 1, &small_alloc);
+  large_arena.Allocate(&context, 32, 4096, 0, 0, 1, &large_alloc);
+
+  bool reallocated = false;
+  ASSERT_EQ(small_arena.Commit(&context, &reallocated), kTfLiteOk);
+  EXPECT_TRUE(reallocated);
+  char* small_ptr = nullptr;
+  ASSERT_EQ(small_arena.ResolveAlloc(&context, small_alloc, &small_ptr),
+            kTfLiteOk);
+  small_ptr[0] = 42;
+
+  // The larger arena replaces the shared buffer.
+  ASSERT_EQ(large_arena.Commit(&context, &reallocated), kTfLiteOk);
+  EXPECT_TRUE(reallocated);
+  EXPECT_TRUE(small_arena.IsSharedBufferStale());
+  EXPECT_FALSE(large_arena.IsSharedBufferStale());
+  EXPECT_EQ(buffer->size(), large_arena.RequiredBufferSize());
+
+  // The smaller arena switches to it, carrying over its content.
+  ASSERT_EQ(small_arena.Commit(&context, &reallocated), kTfLiteOk);
+  EXPECT_TRUE(reallocated);
+  EXPECT_FALSE(small_arena.IsSharedBufferStale());
+  EXPECT_EQ(small_arena.BasePointer(), large_arena.BasePointer());
+  EXPECT_EQ(small_arena.BasePointer() % 64, 0);
+  ASSERT_EQ(small_arena.ResolveAlloc(&context, small_alloc, &small_ptr),
+            kTfLiteOk);
+  EXPECT_EQ(small_ptr[0], 42);
+
+  ASSERT_EQ(large_arena.Commit(&context, &reallocated), kTfLiteOk);
+  EXPECT_FALSE(reallocated);
+}
+
+TEST(SimpleMemoryArenaTest, TestSharedBufferAfterCommit) {
+  TfLiteContext context;
+  context.ReportError = ReportError;
+  SimpleMemoryArena arena(64);
+  ArenaAllocWithUsageInterval alloc;
+  arena.Allocate(&context, 32, 1024, 0, 0, 1, &alloc);
+  bool reallocated = false;
+  ASSERT_EQ(arena.Commit(&context, &reallocated), kTfLiteOk);
+  EXPECT_NE(arena.SetSharedBuffer(&context,
+                                  std::make_shared<SharedArenaBuffer>(64)),
+            kTfLiteOk);
+}
+
 }  // namespace
 }  // namespace tflite
@@ -46,6 +46,7 @@ limitations under the License.
 #include "tensorflow/lite/profiling/profile_summary_formatter.h"
 #include "tensorflow/lite/string_util.h"
 #include "tensorflow/lite/tools/benchmark/benchmark_utils.h"
+#include "tensorflow/lite/tools/benchmark/hardware_counters_listener.h"
 #include "tensorflow/lite/tools/benchmark/profiling_listener.h"
 #include "tensorflow/lite/tools/delegates/delegate_provider.h"
 #include "tensorflow/lite/tools/logging.h"
@@ -361,6 +362,13 @@ BenchmarkParams BenchmarkTfLiteModel::DefaultParams() {
                           BenchmarkParam::Create<bool>(false));
   default_params.AddParam("profiling_output_csv_file",
                           BenchmarkParam::Create<std::string>(""));
+  // Added by Alpa.
+  default_params.AddParam("enable_op_hardware_counters",
+                          BenchmarkParam::Create<bool>(false));
+  default_params.AddParam("op_hardware_counters_csv_file",
+                          BenchmarkParam::Create<std::string>(""));
+  default_params.AddParam("op_hardware_counters_trace_file",
+                          BenchmarkParam::Create<std::string>(""));
 
   default_params.AddParam("print_preinvoke_state",
                           BenchmarkParam::Create<bool>(false));
@@ -436,6 +444,16 @@ std::vector<Flag> BenchmarkTfLiteModel::GetFlags() {
           "profiling_output_csv_file", &params_,
           "File path to export profile data as CSV, if not set "
           "prints to stdout."),
+      CreateFlag<bool>("enable_op_hardware_counters", &params_,
+                       "collect the hardware counters of each op with "
+                       "perf_event (Linux and Android only)"),
+      CreateFlag<std::string>(
+          "op_hardware_counters_csv_file", &params_,
+          "File path to export the op hardware counters as CSV, if not set "
+          "prints to stdout."),
+      CreateFlag<std::string>(
+          "op_hardware_counters_trace_file", &params_,
+          "File path to export the op hardware counters as a Chrome trace."),
       CreateFlag<bool>(
           "print_preinvoke_state", &params_,
           "print out the interpreter internals just before calling Invoke. The "
@@ -490,6 +508,13 @@ void BenchmarkTfLiteModel::LogParams() {
                       verbose);
   LOG_BENCHMARK_PARAM(std::string, "profiling_output_csv_file",
                       "CSV File to export profiling data to", verbose);
+  LOG_BENCHMARK_PARAM(bool, "enable_op_hardware_counters",
+                      "Enable op hardware counters", verbose);
+  LOG_BENCHMARK_PARAM(std::string, "op_hardware_counters_csv_file",
+                      "CSV File to export op hardware counters to", verbose);
+  LOG_BENCHMARK_PARAM(std::string, "op_hardware_counters_trace_file",
+                      "Chrome trace file to export op hardware counters to",
+                      verbose);
   LOG_BENCHMARK_PARAM(bool, "print_preinvoke_state",
                       "Print pre-invoke interpreter state", verbose);
   LOG_BENCHMARK_PARAM(bool, "print_postinvoke_state",
@@ -727,6 +752,15 @@ TfLiteStatus BenchmarkTfLiteModel::Init() {
   }
 
   AddOwnedListener(MayCreateProfilingListener());
+  // Added by Alpa. Installed after the op profiling listener, which replaces
+  // the profilers of the interpreter.
+  if (params_.Get<bool>("enable_op_hardware_counters")) {
+    AddOwnedListener(std::unique_ptr<BenchmarkListener>(
+        new HardwareCountersListener(
+            interpreter_.get(),
+            params_.Get<std::string>("op_hardware_counters_csv_file"),
+            params_.Get<std::string>("op_hardware_counters_trace_file"))));
+  }
   AddOwnedListener(std::unique_ptr<BenchmarkListener>(
       new InterpreterStatePrinter(interpreter_.get())));
 
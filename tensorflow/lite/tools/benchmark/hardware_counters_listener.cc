@@ -0,0 +1,64 @@
+// This file contains the implementation of HardwareCountersListener.
+
+#include "tensorflow/lite/tools/benchmark/hardware_counters_listener.h"
+
+#include <fstream>
+#include <string>
+
+#include "tensorflow/lite/tools/logging.h"
+
+namespace tflite {
+namespace benchmark {
+
+HardwareCountersListener::HardwareCountersListener(
+    Interpreter* interpreter, const std::string& csv_file_path,
+    const std::string& trace_file_path)
+    : csv_file_path_(csv_file_path), trace_file_path_(trace_file_path) {
+  TFLITE_TOOLS_CHECK(interpreter);
+  if (!profiler_.IsSupported()) {
+    TFLITE_LOG(WARN) << "Hardware counters are not available, check that "
+                        "perf_event is supported and allowed "
+                        "(/proc/sys/kernel/perf_event_paranoid).";
+    return;
+  }
+  // Added next to the profiler of the op profiling, if any, which is
+  // installed before and would otherwise replace this one.
+  interpreter->AddProfiler(&profiler_);
+}
+
+void HardwareCountersListener::OnSingleRunStart(RunType run_type) {
+  if (run_type == REGULAR) {
+    profiler_.Reset();
+    profiler_.StartProfiling();
+  }
+}
+
+void HardwareCountersListener::OnSingleRunEnd() {
+  profiler_.StopProfiling();
+  summarizer_.ProcessEvents(profiler_.events());
+  profiler_.Reset();
+}
+
+void HardwareCountersListener::OnBenchmarkEnd(
+    const BenchmarkResults& results) {
+  if (!summarizer_.HasEvents()) return;
+  std::ofstream csv_file(csv_file_path_);
+  if (csv_file.good()) {
+    csv_file << summarizer_.GetCsvString();
+  } else {
+    TFLITE_LOG(INFO) << "Operator-wise Hardware Counters for Regular "
+                        "Benchmark Runs:\n"
+                     << summarizer_.GetCsvString();
+  }
+  if (!trace_file_path_.empty()) {
+    std::ofstream trace_file(trace_file_path_);
+    if (trace_file.good()) {
+      trace_file << summarizer_.GetChromeTraceString();
+    } else {
+      TFLITE_LOG(ERROR) << "Failed to write " << trace_file_path_;
+    }
+  }
+}
+
+}  // namespace benchmark
+}  // namespace tflite
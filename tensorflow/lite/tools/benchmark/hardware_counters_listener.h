@@ -0,0 +1,40 @@
+// This file contains the benchmark listener that collects the hardware
+// counters of each operator with a PerfEventProfiler.
+
+#ifndef TENSORFLOW_LITE_TOOLS_BENCHMARK_HARDWARE_COUNTERS_LISTENER_H_
+#define TENSORFLOW_LITE_TOOLS_BENCHMARK_HARDWARE_COUNTERS_LISTENER_H_
+
+#include <string>
+
+#include "tensorflow/lite/profiling/perf_event_profiler.h"
+#include "tensorflow/lite/tools/benchmark/benchmark_model.h"
+
+namespace tflite {
+namespace benchmark {
+
+// Aggregates the hardware counters of the operators over the regular runs,
+// and exports them as CSV to `csv_file_path`, or to the log if it is empty,
+// and as a Chrome trace to `trace_file_path` if it is not empty.
+class HardwareCountersListener : public BenchmarkListener {
+ public:
+  HardwareCountersListener(Interpreter* interpreter,
+                           const std::string& csv_file_path,
+                           const std::string& trace_file_path);
+
+  void OnSingleRunStart(RunType run_type) override;
+
+  void OnSingleRunEnd() override;
+
+  void OnBenchmarkEnd(const BenchmarkResults& results) override;
+
+ private:
+  std::string csv_file_path_;
+  std::string trace_file_path_;
+  profiling::PerfEventProfiler profiler_;
+  profiling::HardwareCounterSummarizer summarizer_;
+};
+
+}  // namespace benchmark
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_TOOLS_BENCHMARK_HARDWARE_COUNTERS_LISTENER_H_
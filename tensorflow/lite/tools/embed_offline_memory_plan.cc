@@ -0,0 +1,102 @@
+// This file contains a tool that plans the non-persistent tensors of a TFLite
+// model, as the interpreter does on AllocateTensors(), and stores the plans in
+// the "OfflineMemoryAllocation" metadata of the model. Interpreters of the
+// output model then place the tensors at the planned offsets instead of
+// planning them, as long as their shapes match the ones of the input model.
+// The model is planned without delegates, so the plans are only used by
+// interpreters with the same execution plan.
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "flatbuffers/flatbuffers.h"  // from @flatbuffers
+#include "tensorflow/lite/interpreter.h"
+#include "tensorflow/lite/interpreter_builder.h"
+#include "tensorflow/lite/kernels/register.h"
+#include "tensorflow/lite/model_builder.h"
+#include "tensorflow/lite/offline_memory_plan.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/tools/command_line_flags.h"
+#include "tensorflow/lite/tools/logging.h"
+
+namespace tflite {
+namespace {
+
+int Main(int argc, char* argv[]) {
+  std::string input_model_path;
+  std::string output_model_path;
+  std::vector<Flag> flag_list = {
+      Flag::CreateFlag("input_model", &input_model_path,
+                       "Path to the input TFLite model.", Flag::kRequired),
+      Flag::CreateFlag("output_model", &output_model_path,
+                       "Path to the output TFLite model.", Flag::kRequired),
+  };
+  if (!Flags::Parse(&argc, const_cast<const char**>(argv), flag_list)) {
+    TFLITE_LOG(ERROR) << Flags::Usage(argv[0], flag_list);
+    return 1;
+  }
+
+  std::unique_ptr<FlatBufferModel> model =
+      FlatBufferModel::BuildFromFile(input_model_path.c_str());
+  if (!model) {
+    TFLITE_LOG(ERROR) << "Failed to load " << input_model_path;
+    return 1;
+  }
+  ops::builtin::BuiltinOpResolverWithoutDefaultDelegates resolver;
+  std::unique_ptr<Interpreter> interpreter;
+  if (InterpreterBuilder(*model, resolver)(&interpreter) != kTfLiteOk ||
+      interpreter->AllocateTensors() != kTfLiteOk) {
+    TFLITE_LOG(ERROR) << "Failed to allocate the tensors of "
+                      << input_model_path;
+    return 1;
+  }
+
+  // Subgraphs that are not allocated along with the primary one, e.g. the
+  // branches of control flow ops, are left without a plan.
+  std::vector<std::vector<int32_t>> plans(interpreter->subgraphs_size());
+  for (int i = 0; i < plans.size(); ++i) {
+    if (interpreter->subgraph(i)->GetOfflineMemoryPlan(&plans[i]) !=
+        kTfLiteOk) {
+      plans[i].clear();
+    }
+  }
+  const std::string plan_data = SerializeOfflineMemoryPlans(plans);
+
+  std::unique_ptr<ModelT> model_t(model->GetModel()->UnPack());
+  auto buffer = std::make_unique<BufferT>();
+  buffer->data.assign(plan_data.begin(), plan_data.end());
+  MetadataT* metadata = nullptr;
+  for (auto& existing : model_t->metadata) {
+    if (existing->name == kOfflineMemoryAllocationMetadata) {
+      metadata = existing.get();
+    }
+  }
+  if (metadata == nullptr) {
+    model_t->metadata.push_back(std::make_unique<MetadataT>());
+    metadata = model_t->metadata.back().get();
+    metadata->name = kOfflineMemoryAllocationMetadata;
+  }
+  metadata->buffer = model_t->buffers.size();
+  model_t->buffers.push_back(std::move(buffer));
+
+  flatbuffers::FlatBufferBuilder builder;
+  FinishModelBuffer(builder, Model::Pack(builder, model_t.get()));
+  std::ofstream output(output_model_path, std::ios::binary);
+  output.write(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+               builder.GetSize());
+  if (!output) {
+    TFLITE_LOG(ERROR) << "Failed to write " << output_model_path;
+    return 1;
+  }
+  TFLITE_LOG(INFO) << "Stored the memory plans of " << input_model_path
+                   << " in " << output_model_path;
+  return 0;
+}
+
+}  // namespace
+}  // namespace tflite
+
+int main(int argc, char* argv[]) { return tflite::Main(argc, argv); }
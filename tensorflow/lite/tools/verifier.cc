@@ -419,10 +419,8 @@ bool VerifyNumericTensorBuffer(const Tensor& tensor, const Buffer& buffer,
       bytes_required *= sizeof(uint32_t);
       break;
     case TensorType_INT4:
-      // TODO(b/246647008): Multiplying this value by the number of elements
-      // does not yield the size of a tensor when 4-bit values are packed
-      // 2 to a byte.
-      bytes_required *= sizeof(int8_t);
+      // Added by Alpa. Constant int4 tensors pack two values per byte.
+      bytes_required = (bytes_required + 1) / 2;
       break;
     case TensorType_UINT8:
       bytes_required *= sizeof(uint8_t);
@@ -155,6 +155,12 @@ OpSignature GetOpSignature(const OperatorCode* op_code, const Operator* op,
           subgraph->tensors()->Get(op->inputs()->Get(1));
       op_sig.ext_options.fully_connected.sparse_weight =
           (weight_tensor->sparsity() != nullptr);
+      const QuantizationParameters* weight_quant =
+          weight_tensor->quantization();
+      if (weight_quant && weight_quant->scale() &&
+          weight_quant->scale()->Length() > 1) {
+        op_sig.ext_options.fully_connected.is_per_channel_quantized = true;
+      }
     } break;
 
     case BuiltinOperator_MUL: {
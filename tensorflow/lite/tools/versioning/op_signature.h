@@ -51,6 +51,9 @@ typedef struct {
       // TODO(b/156530611): Make this global when more ops support sparse
       // computation.
       bool sparse_weight;
+      // Added by Alpa. Whether the weights have more than one scale, i.e. are
+      // quantized per channel or in groups.
+      bool is_per_channel_quantized;
     } fully_connected;
     struct {
       float input1_scale;
@@ -151,6 +151,17 @@ int GetBuiltinOperatorVersion(const OpSignature& op_sig) {
         return 8;
       }
 
+      // Added by Alpa. Float inputs with int4 weights, or with int8 weights
+      // quantized per channel or in groups, are computed as weight-only
+      // quantized at version 10.
+      if (op_sig.inputs.at(0).type == kTfLiteFloat32 &&
+          op_sig.outputs.at(0).type == kTfLiteFloat32 &&
+          (op_sig.inputs.at(1).type == kTfLiteInt4 ||
+           (op_sig.inputs.at(1).type == kTfLiteInt8 &&
+            op_sig.ext_options.fully_connected.is_per_channel_quantized))) {
+        return 10;
+      }
+
       // Int16 fully fixed point kernel is at version 7.
       if (op_sig.inputs.at(0).type == kTfLiteInt16 &&
           op_sig.inputs.at(1).type == kTfLiteInt16 &&
@@ -109,6 +109,106 @@ void ReturnOp(TFE_Context* ctx, TFE_Op* op) {
   }
 }
 
+// The non-inferred attrs that the fast path set on an op, kept on an op that
+// is never executed so that they can be copied to later ops with the same
+// attr values without parsing the Python values again.
+struct CachedOpAttrs {
+  std::unique_ptr<TFE_Op, OpDeleter> op;
+  tensorflow::gtl::FlatMap<string, int64_t> attr_list_sizes;
+};
+// Keyed by the op name and the encoded attr names and values.
+thread_local std::unordered_map<
+    TFE_Context*, std::unordered_map<string, CachedOpAttrs>>
+    thread_local_op_attrs_cache;  // NOLINT
+constexpr int kMaxCachedOpAttrs = 1024;
+
+// Appends an encoding of `py_value` to `key`. Returns false if `py_value` is
+// not a None, bool, int, float, str or bytes value, or a list or tuple of
+// those, since the attr values of other objects can not be told apart by
+// such an encoding.
+bool AppendOpAttrsCacheKey(PyObject* py_value, string* key) {
+  if (py_value == Py_None) {
+    key->append("n;");
+  } else if (PyBool_Check(py_value)) {
+    key->append(py_value == Py_True ? "t;" : "f;");
+  } else if (PyLong_CheckExact(py_value)) {
+    int overflow;
+    long long value = PyLong_AsLongLongAndOverflow(py_value, &overflow);
+    if (overflow != 0 || (value == -1 && PyErr_Occurred())) {
+      PyErr_Clear();
+      return false;
+    }
+    absl::StrAppend(key, "i", value, ";");
+  } else if (PyFloat_CheckExact(py_value)) {
+    double value = PyFloat_AS_DOUBLE(py_value);
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    absl::StrAppend(key, "d", bits, ";");
+  } else if (PyBytes_CheckExact(py_value)) {
+    absl::StrAppend(key, "b", PyBytes_GET_SIZE(py_value), ":",
+                    absl::string_view(PyBytes_AS_STRING(py_value),
+                                      PyBytes_GET_SIZE(py_value)));
+  } else if (PyUnicode_CheckExact(py_value)) {
+    Py_ssize_t size;
+    const char* data = PyUnicode_AsUTF8AndSize(py_value, &size);
+    if (data == nullptr) {
+      PyErr_Clear();
+      return false;
+    }
+    absl::StrAppend(key, "u", size, ":", absl::string_view(data, size));
+  } else if (PyList_CheckExact(py_value) || PyTuple_CheckExact(py_value)) {
+    Py_ssize_t size = PySequence_Fast_GET_SIZE(py_value);
+    PyObject** items = PySequence_Fast_ITEMS(py_value);
+    absl::StrAppend(key, "(", size, ":");
+    for (Py_ssize_t i = 0; i < size; ++i) {
+      if (!AppendOpAttrsCacheKey(items[i], key)) return false;
+    }
+    key->append(")");
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Builds the key of the attr name and value pairs in `args` from
+// `start_index` on. Returns false if the attrs can not be cached.
+bool GetOpAttrsCacheKey(const char* op_name, PyObject* args, int start_index,
+                        string* key) {
+  absl::StrAppend(key, op_name, ";");
+  Py_ssize_t args_size = PyTuple_GET_SIZE(args);
+  for (int i = start_index; i < args_size; ++i) {
+    if (!AppendOpAttrsCacheKey(PyTuple_GET_ITEM(args, i), key)) return false;
+  }
+  return true;
+}
+
+const CachedOpAttrs* FindCachedOpAttrs(TFE_Context* ctx, const string& key) {
+  auto ctx_it = thread_local_op_attrs_cache.find(ctx);
+  if (ctx_it == thread_local_op_attrs_cache.end()) return nullptr;
+  auto it = ctx_it->second.find(key);
+  return it == ctx_it->second.end() ? nullptr : &it->second;
+}
+
+// Copies the attrs set on `op` so far to the cache.
+void CacheOpAttrs(
+    TFE_Context* ctx, TFE_Op* op, string key,
+    const tensorflow::gtl::FlatMap<string, int64_t>& attr_list_sizes) {
+  auto* immediate_op = tensorflow::unwrap(op);
+  std::unique_ptr<TFE_Op, OpDeleter> attrs_op(
+      tensorflow::wrap(tensorflow::unwrap(ctx)->CreateOperation()));
+  if (!tensorflow::unwrap(attrs_op.get())
+           ->Reset(immediate_op->Name().c_str(), nullptr)
+           .ok()) {
+    return;
+  }
+  tensorflow::unwrap(attrs_op.get())->AddAttrs(immediate_op->GetOpAttrs());
+  auto& cache = thread_local_op_attrs_cache[ctx];
+  if (cache.size() >= kMaxCachedOpAttrs) cache.clear();
+  CachedOpAttrs& cached = cache[std::move(key)];
+  cached.op = std::move(attrs_op);
+  cached.attr_list_sizes = attr_list_sizes;
+}
+
 TF_Status* ReleaseThreadLocalStatus() {
   if (thread_local_tf_status == nullptr) {
     return nullptr;
@@ -3772,33 +3872,49 @@ PyObject* TFE_Py_FastPathExecute_C(PyObject* args) {
   tensorflow::gtl::FlatMap<string, int64_t> attr_list_sizes;
 
   // Set non-inferred attrs, including setting defaults if the attr is passed in
-  // as None.
-  for (int i = FAST_PATH_EXECUTE_ARG_INPUT_START + op_def->input_arg_size();
-       i < args_size; i += 2) {
-    PyObject* py_attr_name = PyTuple_GET_ITEM(args, i);
-    const char* attr_name = TFE_GetPythonString(py_attr_name);
-    PyObject* py_attr_value = PyTuple_GET_ITEM(args, i + 1);
-
-    // Not creating an index since most of the time there are not more than a
-    // few attrs.
-    // TODO(nareshmodi): Maybe include the index as part of the
-    // OpRegistrationData.
-    for (const auto& attr : op_def->attr()) {
-      if (tensorflow::StringPiece(attr_name) == attr.name()) {
-        SetOpAttrWithDefaults(ctx, op, attr, attr_name, py_attr_value,
-                              &attr_list_sizes, status);
-
-        if (!status->status.ok()) {
-          VLOG(1) << "Falling back to slow path for Op \"" << op_def->name()
-                  << "\" since we are unable to set the value for attr \""
-                  << attr.name() << "\" due to: " << TF_Message(status);
-          RaiseFallbackException(TF_Message(status));
-          return nullptr;
-        }
+  // as None. Ops that are called again with the same attr values copy the
+  // attrs set by the previous call.
+  const int attrs_start =
+      FAST_PATH_EXECUTE_ARG_INPUT_START + op_def->input_arg_size();
+  string attrs_cache_key;
+  const bool cache_attrs =
+      GetOpAttrsCacheKey(op_name, args, attrs_start, &attrs_cache_key);
+  const CachedOpAttrs* cached_attrs =
+      cache_attrs ? FindCachedOpAttrs(ctx, attrs_cache_key) : nullptr;
+  if (cached_attrs != nullptr) {
+    tensorflow::unwrap(op)->AddAttrs(
+        tensorflow::unwrap(cached_attrs->op.get())->GetOpAttrs());
+    attr_list_sizes = cached_attrs->attr_list_sizes;
+  } else {
+    for (int i = attrs_start; i < args_size; i += 2) {
+      PyObject* py_attr_name = PyTuple_GET_ITEM(args, i);
+      const char* attr_name = TFE_GetPythonString(py_attr_name);
+      PyObject* py_attr_value = PyTuple_GET_ITEM(args, i + 1);
+
+      // Not creating an index since most of the time there are not more than
+      // a few attrs.
+      // TODO(nareshmodi): Maybe include the index as part of the
+      // OpRegistrationData.
+      for (const auto& attr : op_def->attr()) {
+        if (tensorflow::StringPiece(attr_name) == attr.name()) {
+          SetOpAttrWithDefaults(ctx, op, attr, attr_name, py_attr_value,
+                                &attr_list_sizes, status);
+
+          if (!status->status.ok()) {
+            VLOG(1) << "Falling back to slow path for Op \"" << op_def->name()
+                    << "\" since we are unable to set the value for attr \""
+                    << attr.name() << "\" due to: " << TF_Message(status);
+            RaiseFallbackException(TF_Message(status));
+            return nullptr;
+          }
 
-        break;
+          break;
+        }
       }
     }
+    if (cache_attrs) {
+      CacheOpAttrs(ctx, op, std::move(attrs_cache_key), attr_list_sizes);
+    }
   }
 
   // Flat attrs and inputs as required by the record_gradient call. The attrs
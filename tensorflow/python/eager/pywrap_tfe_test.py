@@ -64,6 +64,30 @@ class Tests(test.TestCase):
                                           "transpose_a", False, "transpose_b",
                                           True))
 
+  @test_util.assert_no_new_tensors
+  @test_util.assert_no_garbage_created
+  def testFastpathExecute_RepeatedAttrs(self):
+    a_2_by_3 = random_ops.random_uniform((2, 3))
+    b_2_by_3 = random_ops.random_uniform((2, 3))
+
+    ctx = context.context()
+    ctx.ensure_initialized()
+
+    # Calls with the same attr values reuse the attrs of the previous call, and
+    # calls with other values must not.
+    for _ in range(2):
+      for transpose_a, transpose_b in ((False, True), (True, False)):
+        self.assertAllClose(
+            math_ops.matmul(
+                a_2_by_3,
+                b_2_by_3,
+                transpose_a=transpose_a,
+                transpose_b=transpose_b),
+            pywrap_tfe.TFE_Py_FastPathExecute(ctx, "MatMul", None, a_2_by_3,
+                                              b_2_by_3, "transpose_a",
+                                              transpose_a, "transpose_b",
+                                              transpose_b))
+
   @test_util.assert_no_new_tensors
   @test_util.assert_no_garbage_created
   def testFastpathExecute_ResourceVariableMatMulCorrectResponse(self):
@@ -143,7 +143,8 @@ class Adagrad(optimizer_v2.OptimizerV2):
         grad=grad,
         use_locking=self._use_locking)
 
-  def _resource_apply_sparse(self, grad, var, indices, apply_state=None):
+  def _resource_apply_sparse(self, grad, var, indices, apply_state=None,
+                             deduplicate_indices=False):
     var_device, var_dtype = var.device, var.dtype.base_dtype
     coefficients = ((apply_state or {}).get((var_device, var_dtype))
                     or self._fallback_apply_state(var_device, var_dtype))
@@ -156,7 +157,15 @@ class Adagrad(optimizer_v2.OptimizerV2):
         epsilon=coefficients['epsilon'],
         grad=grad,
         indices=indices,
-        use_locking=self._use_locking)
+        use_locking=self._use_locking,
+        deduplicate_indices=deduplicate_indices)
+
+  # Added by Alpa: the kernel sums the gradients of duplicate indices itself,
+  # in one pass instead of a unique and a segment sum.
+  def _resource_apply_sparse_duplicate_indices(self, grad, handle, indices,
+                                               **kwargs):
+    return self._resource_apply_sparse(
+        grad, handle, indices, deduplicate_indices=True, **kwargs)
 
   def get_config(self):
     config = super(Adagrad, self).get_config()
@@ -42,6 +42,7 @@ from tensorflow.python.framework import test_ops
 from tensorflow.python.framework import test_util
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import control_flow_ops
+from tensorflow.python.ops import gen_lookup_ops
 from tensorflow.python.ops import lookup_ops
 from tensorflow.python.ops import map_fn
 from tensorflow.python.ops import variables
@@ -3355,6 +3356,31 @@ class MutableHashTableOpTest(test.TestCase):
     self.assertAllEqual([b"brain", b"salad", b"surgery"], sorted_keys)
     self.assertAllEqual([0, 1, 2], sorted_values)
 
+  # Added by Alpa
+  @test_util.run_v2_only
+  def testShardedMutableHashTable(self, is_anonymous):
+    if is_anonymous:
+      self.skipTest("Sharding is only an attribute of MutableHashTableV2")
+    table = gen_lookup_ops.mutable_hash_table_v2(
+        key_dtype=dtypes.int64, value_dtype=dtypes.int64, num_shards=8)
+    keys = constant_op.constant(np.arange(1000), dtypes.int64)
+    self.evaluate(
+        gen_lookup_ops.lookup_table_insert_v2(table, keys, keys * 2))
+    self.assertAllEqual(
+        1000, self.evaluate(gen_lookup_ops.lookup_table_size_v2(table)))
+    self.evaluate(
+        gen_lookup_ops.lookup_table_remove_v2(
+            table, constant_op.constant([3, 5], dtypes.int64)))
+    output = gen_lookup_ops.lookup_table_find_v2(
+        table, constant_op.constant([5, 1, 999, 3, 1000], dtypes.int64),
+        constant_op.constant(-1, dtypes.int64))
+    self.assertAllEqual([-1, 2, 1998, -1, -1], self.evaluate(output))
+    exported_keys, exported_values = self.evaluate(
+        gen_lookup_ops.lookup_table_export_v2(table, dtypes.int64,
+                                              dtypes.int64))
+    self.assertAllEqual(998, len(exported_keys))
+    self.assertAllEqual(exported_keys * 2, exported_values)
+
   # TODO(https://github.com/tensorflow/tensorflow/issues/24439): remove exepectedFailure when fixed
   @unittest.expectedFailure
   @test_util.run_v2_only
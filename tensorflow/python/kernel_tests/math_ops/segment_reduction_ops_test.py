@@ -346,6 +346,31 @@ class UnsortedSegmentTest(SegmentReductionHelper):
                 self.assertAllCloseAccordingToType(np_ans, tf_ans)
                 self.assertShapeEqual(np_ans, s)
 
+  def testHighContention(self):
+    # Many rows per segment, which the GPU implem pre-aggregates in shared
+    # memory when the output is small, or sorts otherwise.
+    rng = np.random.RandomState(0)
+    for num_rows, num_segments, inner_size in [(4096, 4, 1), (4096, 5, 3),
+                                               (8192, 64, 512)]:
+      # Runs of equal ids, with a few invalid ones.
+      indices = np.sort(rng.randint(-1, num_segments + 1, size=num_rows))
+      rng.shuffle(indices[:num_rows // 2])
+      values = rng.randint(-4, 4, size=(num_rows, inner_size))
+      for dtype in [np.int32, np.float32, np.float64]:
+        data = values.astype(dtype)
+        valid = (indices >= 0) & (indices < num_segments)
+        np_sum = np.zeros((num_segments, inner_size), dtype=dtype)
+        np.add.at(np_sum, indices[valid], data[valid])
+        lowest = (
+            np.iinfo(dtype).min if dtype == np.int32 else np.finfo(dtype).min)
+        np_max = np.full((num_segments, inner_size), lowest, dtype=dtype)
+        np.maximum.at(np_max, indices[valid], data[valid])
+        with self.cached_session():
+          tf_sum = math_ops.unsorted_segment_sum(data, indices, num_segments)
+          tf_max = math_ops.unsorted_segment_max(data, indices, num_segments)
+          self.assertAllClose(np_sum, self.evaluate(tf_sum))
+          self.assertAllClose(np_max, self.evaluate(tf_max))
+
   def testNumSegmentsTypes(self):
     dtypes = [dtypes_lib.int32, dtypes_lib.int64]
     indices_flat = np.array([0, 4, 0, 8, 3, 8, 4, 7, 7, 3])
@@ -789,6 +789,62 @@ class EmbeddingLookupSparseTest(test.TestCase):
             x, x_shape, y, y_shape, x_init_value=x_init_value)
       self.assertLess(err, 1e-5 if dtype == dtypes.float64 else 2e-3)
 
+  @test_util.run_deprecated_v1
+  def testFastEmbeddingLookupSparse(self):
+    vocab_size = 13
+    batch_size = 10
+    param_shape = [2, 5]
+    sp_ids, sp_weights, _, _, _ = self._RandomIdsAndWeights(
+        batch_size, vocab_size)
+
+    for combiner, dtype, ignore_weights in itertools.product(
+        ["sum", "mean", "sqrtn"], [dtypes.float32, dtypes.float64],
+        [True, False]):
+      with self.cached_session():
+        x, _, feed_dict = _EmbeddingParams(
+            1, vocab_size, shape=param_shape, dtype=dtype)
+        weights = None if ignore_weights else sp_weights
+        expected = embedding_ops.embedding_lookup_sparse(
+            x, sp_ids, weights, combiner=combiner)
+        fast = embedding_ops.embedding_lookup_sparse(
+            x, sp_ids, weights, combiner=combiner, allow_fast_lookup=True)
+        self.assertEqual(fast.op.type, "EmbeddingLookupSparse")
+        self.assertAllClose(
+            expected.eval(feed_dict=feed_dict), fast.eval(feed_dict=feed_dict))
+
+  @test_util.run_deprecated_v1
+  def testGradientsFastEmbeddingLookupSparse(self):
+    vocab_size = 12
+    batch_size = 4
+    param_shape = [2, 3]
+    sp_ids, _, _, weight_values, _ = self._RandomIdsAndWeights(
+        batch_size, vocab_size)
+
+    for combiner, ignore_weights in itertools.product(
+        ["sum", "mean", "sqrtn"], [True, False]):
+      with self.cached_session():
+        x, params, _ = _EmbeddingParams(
+            1, vocab_size, shape=param_shape, dtype=dtypes.float64)
+        weights = constant_op.constant(weight_values, dtypes.float64)
+        sp_weights = sparse_tensor.SparseTensor(sp_ids.indices, weights,
+                                                sp_ids.dense_shape)
+        y = embedding_ops.embedding_lookup_sparse(
+            x,
+            sp_ids,
+            None if ignore_weights else sp_weights,
+            combiner=combiner,
+            allow_fast_lookup=True)
+        x_init_value = params[_PName(0) + ":0"]
+        y_shape = [batch_size] + param_shape
+        inputs = [x[0]] if ignore_weights else [x[0], weights]
+        input_shapes = [x_init_value.shape] + [weight_values.shape] * (
+            0 if ignore_weights else 1)
+        input_values = [x_init_value] + ([] if ignore_weights else
+                                         [weight_values])
+        err = gradient_checker.compute_gradient_error(
+            inputs, input_shapes, y, y_shape, x_init_value=input_values)
+      self.assertLess(err, 1e-5)
+
   @test_util.run_deprecated_v1
   def testIncompatibleShapes(self):
     with self.cached_session():
@@ -39,6 +39,15 @@ class StringLowerOpTest(test.TestCase):
       self.assertAllEqual(output, [[b"pigs on the wing", b"animals"],
                                    [b" hello ", b"\n\tworld! \r \n"]])
 
+  def test_string_lower_all_bytes(self):
+    # Longer than a word, so that most bytes take the word-at-a-time path.
+    strings = [bytes(bytearray(range(256))) * 2 + b"@[`{"]
+
+    with self.cached_session():
+      output = string_ops.string_lower(strings)
+      output = self.evaluate(output)
+      self.assertAllEqual(output, [s.lower() for s in strings])
+
   def test_string_upper_unicode(self):
     strings = [["ÓÓSSCHLOË"]]
     with self.cached_session():
@@ -39,6 +39,15 @@ class StringUpperOpTest(test.TestCase):
       self.assertAllEqual(output, [[b"PIGS ON THE WING", b"ANIMALS"],
                                    [b" HELLO ", b"\n\tWORLD! \r \n"]])
 
+  def test_string_upper_all_bytes(self):
+    # Longer than a word, so that most bytes take the word-at-a-time path.
+    strings = [bytes(bytearray(range(256))) * 2 + b"@[`{"]
+
+    with self.cached_session():
+      output = string_ops.string_upper(strings)
+      output = self.evaluate(output)
+      self.assertAllEqual(output, [s.upper() for s in strings])
+
   def test_string_upper_unicode(self):
     strings = [["óósschloë"]]
     with self.cached_session():
@@ -32,7 +32,8 @@ def batch_function(num_batch_threads,
                    allowed_batch_sizes=None,
                    max_enqueued_batches=10,
                    autograph=True,
-                   enable_large_batch_splitting=True):
+                   enable_large_batch_splitting=True,
+                   sequence_length_buckets=None):
   """Batches the computation done by the decorated function.
 
   So, for example, in the following code
@@ -78,6 +79,13 @@ def batch_function(num_batch_threads,
      is 32 -> implementation can split input of 128 into 4 x 32, schedule
      concurrent processing, and then return concatenated results corresponding
      to 128.
+    sequence_length_buckets: Optional list of increasing upper bounds of
+     buckets of the sequence length of the arguments, i.e. of the size of their
+     second dimension. If set, arguments are only batched with arguments of
+     the same bucket, and are padded with zeros along their second dimension to
+     the longest of their batch, so that variable-length sequences can be
+     batched without padding every batch to the longest sequence. The decorated
+     function must then accept any sequence length.
 
   Returns:
     The decorated function will return the unbatched computation output Tensors.
@@ -91,9 +99,15 @@ def batch_function(num_batch_threads,
       def computation(*computation_args):
         return fn(*computation_args)
 
+      def spec_shape(x):
+        # Added by Alpa: batches of a bucket have any sequence length.
+        if sequence_length_buckets and x.shape.rank and x.shape.rank >= 2:
+          return x.shape[:1].concatenate([None]).concatenate(x.shape[2:])
+        return x.shape
+
       computation = computation.get_concrete_function(*[
           tensor_spec.TensorSpec(
-              dtype=x.dtype, shape=x.shape, name="batch_" + str(i))
+              dtype=x.dtype, shape=spec_shape(x), name="batch_" + str(i))
           for i, x in enumerate(args)
       ])
 
@@ -111,6 +125,7 @@ def batch_function(num_batch_threads,
             max_enqueued_batches=max_enqueued_batches,
             shared_name=name,
             enable_large_batch_splitting=enable_large_batch_splitting,
+            sequence_length_buckets=sequence_length_buckets,
             f=computation,
             in_tensors=list(args),
             captured_tensors=computation.captured_inputs,
@@ -395,6 +395,40 @@ class BatchOpsTest(test.TestCase):
       self.assertEqual(thread_results[0], [2])
       self.assertEqual(main_results[0], [3])
 
+  def testBatchFunctionOpWithSequenceLengthBuckets(self):
+    """Tests that batch_function pads sequences of the same bucket."""
+    if context.executing_eagerly():
+      return
+    with self.cached_session() as sess:
+
+      @function.Defun(dtypes.int32)
+      def computation(in_t):
+        return in_t * 2
+
+      inp = array_ops.placeholder(dtype=dtypes.int32, shape=[1, None])
+      result = gen_batch_ops.batch_function(
+          [inp],
+          num_batch_threads=1,
+          max_batch_size=2,
+          batch_timeout_micros=1000000,
+          Tout=[dtypes.int32],
+          f=computation,
+          captured_tensors=computation.captured_inputs,
+          sequence_length_buckets=[4, 8])
+      thread_results = []
+
+      def worker():
+        thread_results.extend(sess.run([result], feed_dict={inp: [[1, 2]]}))
+
+      worker_thread = threading.Thread(target=worker)
+      worker_thread.start()
+      main_results = sess.run([result], feed_dict={inp: [[1, 2, 3]]})
+      worker_thread.join()
+      # Both inputs are in the first bucket, so the shorter one is padded to
+      # the length of the longer one.
+      self.assertAllEqual(thread_results[0], [[2, 4, 0]])
+      self.assertAllEqual(main_results[0], [[2, 4, 6]])
+
   def testBatchFunctionOpWithCapturedInput(self):
     """Tests that batch_function op works with captured input."""
     if context.executing_eagerly():
@@ -24,6 +24,7 @@ from tensorflow.python.ops import clip_ops
 # Imports gradient definitions.
 from tensorflow.python.ops import data_flow_grad  # pylint: disable=unused-import
 from tensorflow.python.ops import data_flow_ops
+from tensorflow.python.ops import gen_math_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import resource_variable_ops
 from tensorflow.python.ops import sparse_ops
@@ -410,7 +411,8 @@ def embedding_lookup_sparse(params,
                             partition_strategy="mod",
                             name=None,
                             combiner=None,
-                            max_norm=None):
+                            max_norm=None,
+                            allow_fast_lookup=False):
   """Looks up embeddings for the given ids and weights from a list of tensors.
 
   This op assumes that there is at least one id for each row in the dense tensor
@@ -445,6 +447,12 @@ def embedding_lookup_sparse(params,
       of the squares of the weights. Defaults to `mean`.
     max_norm: If not `None`, each embedding is clipped if its l2-norm is larger
       than this value, before combining.
+    allow_fast_lookup: If `True` and `params` is a single float32 or float64
+      tensor or variable and `max_norm` is `None`, the embeddings are gathered
+      and combined by one fused op, without materializing the gathered
+      embeddings, and the gradient of `params` is computed without a
+      `tf.unique`. The ids must then be in range, and the shape of the output
+      is always `[d0, p1, ..., pm]`.
 
   Returns:
     A dense tensor representing the combined embeddings for the
@@ -516,6 +524,23 @@ def embedding_lookup_sparse(params,
     segment_ids = sp_ids.indices[:, 0]
 
     ids = sp_ids.values
+    if (allow_fast_lookup and len(params) == 1 and max_norm is None and
+        params[0].dtype.base_dtype in (dtypes.float32, dtypes.float64)):
+      # Added by Alpa: gathers and combines the embeddings in one op.
+      embedding_table = ops.convert_to_tensor(params[0])
+      if ignore_weights:
+        weights = array_ops.zeros([0], dtype=embedding_table.dtype)
+      else:
+        weights = math_ops.cast(sp_weights.values, embedding_table.dtype)
+      return gen_math_ops.embedding_lookup_sparse(
+          embedding_table,
+          ids,
+          segment_ids,
+          weights,
+          sp_ids.dense_shape[0],
+          combiner=combiner,
+          name=name)
+
     ids, idx = array_ops.unique(ids)
 
     embeddings = embedding_lookup(
@@ -595,7 +620,8 @@ def embedding_lookup_sparse_v2(params,
                                sp_weights,
                                combiner=None,
                                max_norm=None,
-                               name=None):
+                               name=None,
+                               allow_fast_lookup=False):
   """Looks up embeddings for the given ids and weights from a list of tensors.
 
   This op assumes that there is at least one id for each row in the dense tensor
@@ -633,6 +659,12 @@ def embedding_lookup_sparse_v2(params,
       of the squares of the weights. Defaults to `mean`.
     max_norm: If not `None`, each embedding is clipped if its l2-norm is larger
       than this value, before combining.
+    allow_fast_lookup: If `True` and `params` is a single float32 or float64
+      tensor or variable and `max_norm` is `None`, the embeddings are gathered
+      and combined by one fused op, without materializing the gathered
+      embeddings, and the gradient of `params` is computed without a
+      `tf.unique`. The ids must then be in range, and the shape of the output
+      is always `[d0, p1, ..., pm]`.
     name: Optional name for the op.
 
   Returns:
@@ -676,7 +708,7 @@ def embedding_lookup_sparse_v2(params,
     ValueError: If `combiner` is not one of {"mean", "sqrtn", "sum"}.
   """
   return embedding_lookup_sparse(params, sp_ids, sp_weights, "div", name,
-                                 combiner, max_norm)
+                                 combiner, max_norm, allow_fast_lookup)
 
 
 @tf_export("nn.safe_embedding_lookup_sparse", v1=[])
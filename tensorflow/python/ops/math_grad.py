@@ -19,6 +19,7 @@ from tensorflow.python.compat import compat
 from tensorflow.python.eager import context
 from tensorflow.python.framework import constant_op
 from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import indexed_slices
 from tensorflow.python.framework import ops
 from tensorflow.python.framework import tensor_util
 from tensorflow.python.ops import array_ops
@@ -388,6 +389,26 @@ def _SparseSegmentSqrtNWithNumSegmentsGrad(op, grad):
                                               dim0), None, None, None)
 
 
+# Added by Alpa
+@ops.RegisterGradient("EmbeddingLookupSparse")
+def _EmbeddingLookupSparseGrad(op, grad):
+  """Gradient for EmbeddingLookupSparse."""
+  params, indices, segment_ids, weights, _ = op.inputs
+  params_grad, weights_grad = gen_math_ops.embedding_lookup_sparse_grad(
+      grad,
+      params,
+      indices,
+      segment_ids,
+      weights,
+      op.outputs[0],
+      combiner=op.get_attr("combiner"))
+  # params can be large, so colocate the shape calculation with it.
+  with ops.colocate_with(params):
+    params_shape = array_ops.shape(params)
+  return (indexed_slices.IndexedSlices(params_grad, indices, params_shape),
+          None, None, weights_grad, None)
+
+
 def _SegmentMinOrMaxGrad(op, grad):
   """ Gradient for SegmentMin and SegmentMax. """
   zeros = array_ops.zeros_like(op.inputs[0], dtype=op.inputs[0].dtype)
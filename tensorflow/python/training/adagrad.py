@@ -174,7 +174,7 @@ class AdagradOptimizer(optimizer.Optimizer):
         grad,
         use_locking=self._use_locking)
 
-  def _apply_sparse(self, grad, var):
+  def _apply_sparse(self, grad, var, deduplicate_indices=False):
     acc = self.get_slot(var, "accumulator")
     return training_ops.sparse_apply_adagrad(
         var,
@@ -182,9 +182,11 @@ class AdagradOptimizer(optimizer.Optimizer):
         math_ops.cast(self._learning_rate_tensor, var.dtype.base_dtype),
         grad.values,
         grad.indices,
-        use_locking=self._use_locking)
+        use_locking=self._use_locking,
+        deduplicate_indices=deduplicate_indices)
 
-  def _resource_apply_sparse(self, grad, var, indices):
+  def _resource_apply_sparse(self, grad, var, indices,
+                             deduplicate_indices=False):
     acc = self.get_slot(var, "accumulator")
     return training_ops.resource_sparse_apply_adagrad(
         var.handle,
@@ -192,4 +194,14 @@ class AdagradOptimizer(optimizer.Optimizer):
         math_ops.cast(self._learning_rate_tensor, grad.dtype),
         grad,
         indices,
-        use_locking=self._use_locking)
+        use_locking=self._use_locking,
+        deduplicate_indices=deduplicate_indices)
+
+  # Added by Alpa: the kernels sum the gradients of duplicate indices
+  # themselves, in one pass instead of a unique and a segment sum.
+  def _apply_sparse_duplicate_indices(self, grad, var):
+    return self._apply_sparse(grad, var, deduplicate_indices=True)
+
+  def _resource_apply_sparse_duplicate_indices(self, grad, handle, indices):
+    return self._resource_apply_sparse(
+        grad, handle, indices, deduplicate_indices=True)
@@ -358,6 +358,41 @@ class TrainingOpsTest(TensorFlowTestCase):
       indices = np.array([0, 2]).astype(index_type)
       self._testTypesForSparseAdagrad(x, y, lr, grad, indices, use_gpu)
 
+  @test_util.run_v1_only("SparseApplyAdagrad op returns a ref, so it is not "
+                         "supported in eager mode.")
+  def testSparseApplyAdagradDeduplicateIndices(self):
+    for (dtype, index_type,
+         use_gpu) in itertools.product([np.float32, np.float64],
+                                       [np.int32, np.int64], [False, True]):
+      x = np.array([np.arange(4), np.arange(4, 8),
+                    np.arange(8, 12)]).astype(dtype)
+      y = np.array([np.arange(1, 5), np.arange(5, 9),
+                    np.arange(9, 13)]).astype(dtype)
+      lr = np.array(2.0).astype(dtype)
+      grad = np.array([np.arange(4), np.ones(4), np.arange(4, 8),
+                       np.arange(4)]).astype(dtype)
+      indices = np.array([2, 0, 2, 2]).astype(index_type)
+      self.setUp()
+      with self.session(use_gpu=use_gpu):
+        var = variables.VariableV1(x)
+        accum = variables.VariableV1(y)
+        self.evaluate(variables.global_variables_initializer())
+        self.evaluate(
+            training_ops.sparse_apply_adagrad(
+                var, accum, lr, grad, constant_op.constant(indices),
+                deduplicate_indices=True))
+
+        # The duplicates of row 2 are summed before the update.
+        for index, summed_grad in ((0, grad[1]),
+                                   (2, grad[0] + grad[2] + grad[3])):
+          new_accum = y[index] + summed_grad * summed_grad
+          self.assertAllCloseAccordingToType(
+              x[index] - lr * summed_grad * new_accum**(-0.5),
+              self.evaluate(var)[index])
+          self.assertAllCloseAccordingToType(new_accum,
+                                             self.evaluate(accum)[index])
+        self.assertAllCloseAccordingToType(x[1], self.evaluate(var)[1])
+
   @test_util.run_v1_only("SparseApplyFtrl op returns a ref, so it is not "
                          "supported in eager mode.")
   def testSparseApplyFtrlDim1(self):
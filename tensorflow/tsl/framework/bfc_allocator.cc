@@ -17,6 +17,8 @@ limitations under the License.
 
 #include <algorithm>
 #include <atomic>
+#include <functional>
+#include <thread>  // NOLINT
 #include <utility>
 
 #include "absl/strings/string_view.h"
@@ -83,6 +85,8 @@ BFCAllocator::BFCAllocator(std::unique_ptr<SubAllocator> sub_allocator,
 }
 
 BFCAllocator::~BFCAllocator() {
+  // Added by Alpa
+  FlushChunkCache();
   // Return memory back.
   VLOG(2) << "Number of regions allocated: "
           << region_manager_.regions().size();
@@ -258,7 +262,16 @@ void* BFCAllocator::AllocateRawInternalWithRetry(
 void* BFCAllocator::AllocateRaw(size_t unused_alignment, size_t num_bytes,
                                 const AllocationAttributes& allocation_attr) {
   VLOG(3) << "AllocateRaw " << Name() << "  " << num_bytes;
-  void* result = [&] {
+  // Added by Alpa
+  const bool use_chunk_cache = UseChunkCache(num_bytes, allocation_attr);
+  if (use_chunk_cache) {
+    if (void* cached = AllocateFromCache(RoundedBytes(num_bytes))) {
+      VLOG(3) << "AllocateRaw " << Name() << "  " << num_bytes << " "
+              << cached << " from the chunk cache";
+      return cached;
+    }
+  }
+  auto allocate = [&] {
     if (!opts_.allow_retry_on_failure || !allocation_attr.retry_on_failure) {
       // If we have globally disabled retry-on-failure and fail to allocate an
       // "important" alloc, we want to print a log, because the program may be
@@ -303,11 +316,125 @@ void* BFCAllocator::AllocateRaw(size_t unused_alignment, size_t num_bytes,
       return AllocateRawInternalWithRetry(unused_alignment, num_bytes,
                                           allocation_attr);
     }
-  }();
+  };
+  void* result = allocate();
+  // Added by Alpa
+  if (result == nullptr && FlushChunkCache()) {
+    result = allocate();
+  }
+  if (result != nullptr && use_chunk_cache) {
+    RecordCacheableChunk(result, RoundedBytes(num_bytes));
+  }
   VLOG(3) << "AllocateRaw " << Name() << "  " << num_bytes << " " << result;
   return result;
 }
 
+namespace {
+// Added by Alpa
+int ThreadCacheShard(int num_shards) {
+  static thread_local const size_t thread_hash =
+      std::hash<std::thread::id>()(std::this_thread::get_id());
+  return thread_hash % num_shards;
+}
+
+int PointerCacheShard(const void* ptr, int num_shards) {
+  return (reinterpret_cast<uintptr_t>(ptr) >> 8) % num_shards;
+}
+}  // namespace
+
+bool BFCAllocator::UseChunkCache(
+    size_t num_bytes, const AllocationAttributes& allocation_attr) const {
+  // Chunks freed at a timestamp must go through the bins to be reused safely.
+  return opts_.small_chunk_cache_bytes > 0 && timing_counter_ == nullptr &&
+         allocation_attr.freed_by_func == nullptr && num_bytes > 0 &&
+         num_bytes <= kMaxCachedAllocationBytes;
+}
+
+void* BFCAllocator::AllocateFromCache(size_t rounded_bytes) {
+  CacheShard& shard = cache_shards_[ThreadCacheShard(kNumCacheShards)];
+  mutex_lock l(shard.mu);
+  auto it = shard.free_chunks.find(rounded_bytes);
+  if (it == shard.free_chunks.end() || it->second.empty()) {
+    return nullptr;
+  }
+  auto [ptr, chunk_bytes] = it->second.back();
+  it->second.pop_back();
+  shard.cached_bytes -= chunk_bytes;
+  cached_bytes_.fetch_sub(chunk_bytes, std::memory_order_relaxed);
+  num_cached_allocs_.fetch_add(1, std::memory_order_relaxed);
+  return ptr;
+}
+
+void BFCAllocator::RecordCacheableChunk(void* ptr, size_t rounded_bytes) {
+  size_t chunk_bytes = AllocatedSize(ptr);
+  CacheShard& info_shard = cache_shards_[PointerCacheShard(ptr,
+                                                           kNumCacheShards)];
+  mutex_lock l(info_shard.mu);
+  info_shard.chunk_infos[ptr] = CachedChunkInfo{rounded_bytes, chunk_bytes};
+}
+
+bool BFCAllocator::DeallocateToCache(void* ptr) {
+  CacheShard& info_shard = cache_shards_[PointerCacheShard(ptr,
+                                                           kNumCacheShards)];
+  CachedChunkInfo info;
+  {
+    mutex_lock l(info_shard.mu);
+    auto it = info_shard.chunk_infos.find(ptr);
+    if (it == info_shard.chunk_infos.end()) {
+      return false;
+    }
+    info = it->second;
+  }
+  CacheShard& shard = cache_shards_[ThreadCacheShard(kNumCacheShards)];
+  {
+    mutex_lock l(shard.mu);
+    std::vector<std::pair<void*, size_t>>& chunks =
+        shard.free_chunks[info.size_class];
+    if (chunks.size() < kMaxCachedChunksPerSizeClass &&
+        shard.cached_bytes + info.chunk_bytes <=
+            opts_.small_chunk_cache_bytes / kNumCacheShards) {
+      chunks.emplace_back(ptr, info.chunk_bytes);
+      shard.cached_bytes += info.chunk_bytes;
+      cached_bytes_.fetch_add(info.chunk_bytes, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  mutex_lock l(info_shard.mu);
+  info_shard.chunk_infos.erase(ptr);
+  return false;
+}
+
+bool BFCAllocator::FlushChunkCache() {
+  if (cached_bytes_.load(std::memory_order_relaxed) == 0) {
+    return false;
+  }
+  std::vector<void*> flushed;
+  for (CacheShard& shard : cache_shards_) {
+    mutex_lock l(shard.mu);
+    for (auto& [size_class, chunks] : shard.free_chunks) {
+      for (const auto& [ptr, chunk_bytes] : chunks) {
+        flushed.push_back(ptr);
+      }
+      chunks.clear();
+    }
+    cached_bytes_.fetch_sub(shard.cached_bytes, std::memory_order_relaxed);
+    shard.cached_bytes = 0;
+  }
+  for (void* ptr : flushed) {
+    CacheShard& info_shard =
+        cache_shards_[PointerCacheShard(ptr, kNumCacheShards)];
+    {
+      mutex_lock l(info_shard.mu);
+      info_shard.chunk_infos.erase(ptr);
+    }
+    DeallocateRawInternal(ptr);
+  }
+  VLOG(2) << "Flushed " << flushed.size() << " chunks from the cache of "
+          << Name();
+  retry_helper_.NotifyDealloc();
+  return !flushed.empty();
+}
+
 // static
 size_t BFCAllocator::RoundedBytes(size_t bytes) {
   size_t rounded_bytes =
@@ -679,6 +806,11 @@ void BFCAllocator::SplitChunk(BFCAllocator::ChunkHandle h, size_t num_bytes) {
 void BFCAllocator::DeallocateRaw(void* ptr) {
   VLOG(3) << "DeallocateRaw " << Name() << " "
           << (ptr ? RequestedSize(ptr) : 0);
+  // Added by Alpa
+  if (ptr != nullptr && opts_.small_chunk_cache_bytes > 0 &&
+      DeallocateToCache(ptr)) {
+    return;
+  }
   DeallocateRawInternal(ptr);
   retry_helper_.NotifyDealloc();
 }
@@ -1203,11 +1335,18 @@ MemoryDump BFCAllocator::RecordMemoryMapInternal() {
 
 absl::optional<AllocatorStats> BFCAllocator::GetStats() {
   mutex_lock l(lock_);
-  return stats_;
+  // Added by Alpa. The cached chunks are free for the clients, but still
+  // reserved, so they count in peak_bytes_in_use.
+  AllocatorStats stats = stats_;
+  stats.largest_free_block_bytes = LargestFreeChunk();
+  stats.bytes_in_use -= cached_bytes_.load(std::memory_order_relaxed);
+  stats.num_allocs += num_cached_allocs_.load(std::memory_order_relaxed);
+  return stats;
 }
 
 bool BFCAllocator::ClearStats() {
   mutex_lock l(lock_);
+  num_cached_allocs_.store(0, std::memory_order_relaxed);
   stats_.num_allocs = 0;
   stats_.peak_bytes_in_use = stats_.bytes_in_use;
   stats_.largest_alloc_size = 0;
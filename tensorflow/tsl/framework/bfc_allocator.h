@@ -23,6 +23,7 @@ limitations under the License.
 #include <unordered_map>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "tensorflow/tsl/framework/allocator.h"
 #include "tensorflow/tsl/framework/allocator_retry.h"
@@ -68,6 +69,12 @@ class BFCAllocator : public Allocator {
     // Controls when a chunk should be split, if its size exceeds the requested
     // allocation size.
     double fragmentation_fraction = 0;
+
+    // Added by Alpa. If positive, freed chunks of small allocations are kept
+    // in per-thread size-class caches of up to this many bytes in total and
+    // reused without taking the allocator lock. The caches are flushed back
+    // to the bins when an allocation fails. Not used with a timing counter.
+    size_t small_chunk_cache_bytes = 0;
   };
   BFCAllocator(std::unique_ptr<SubAllocator> sub_allocator, size_t total_memory,
                const string& name, const Options& opts);
@@ -120,6 +127,41 @@ class BFCAllocator : public Allocator {
 
   void DeallocateRawInternal(void* ptr);
 
+  // Added by Alpa. The cache of small chunks. A cached chunk stays in use in
+  // the bins; its stats are moved out of bytes_in_use while it is cached.
+  static constexpr int kNumCacheShards = 16;
+  static constexpr size_t kMaxCachedAllocationBytes = 64 << 10;
+  static constexpr size_t kMaxCachedChunksPerSizeClass = 64;
+
+  struct CachedChunkInfo {
+    // The rounded requested size the chunk is cached for.
+    size_t size_class;
+    // The size of the chunk in the bins.
+    size_t chunk_bytes;
+  };
+
+  struct CacheShard {
+    mutex mu;
+    // Indexed by the thread: the cached chunks and their chunk_bytes by size
+    // class.
+    absl::flat_hash_map<size_t, std::vector<std::pair<void*, size_t>>>
+        free_chunks TF_GUARDED_BY(mu);
+    size_t cached_bytes TF_GUARDED_BY(mu) = 0;
+    // Indexed by the pointer: the chunks the cache may take back.
+    absl::flat_hash_map<const void*, CachedChunkInfo> chunk_infos
+        TF_GUARDED_BY(mu);
+  };
+
+  bool UseChunkCache(size_t num_bytes,
+                     const AllocationAttributes& allocation_attr) const;
+  void* AllocateFromCache(size_t rounded_bytes);
+  void RecordCacheableChunk(void* ptr, size_t rounded_bytes);
+  // Returns false if `ptr` must be given back to the bins.
+  bool DeallocateToCache(void* ptr);
+  // Gives all the cached chunks back to the bins. Returns false if there were
+  // none.
+  bool FlushChunkCache();
+
   // Chunks whose freed_at_count is later than the safe frontier value are kept
   // on a special list and not subject to merging immediately upon being freed.
   //
@@ -614,6 +656,12 @@ class BFCAllocator : public Allocator {
 
   // Stats.
   AllocatorStats stats_ TF_GUARDED_BY(lock_);
+
+  // Added by Alpa
+  std::array<CacheShard, kNumCacheShards> cache_shards_;
+  // The bytes of the chunks in the cache, and the allocations it served.
+  std::atomic<int64_t> cached_bytes_ = {0};
+  std::atomic<int64_t> num_cached_allocs_ = {0};
 #ifdef TENSORFLOW_MEM_DEBUG
   int64 action_counter_ = 0 TF_GUARDED_BY(lock_);
 #define MEM_DEBUG_SIZE_HISTORY_SIZE 4096
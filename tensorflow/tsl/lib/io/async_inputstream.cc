@@ -0,0 +1,144 @@
+#include "tensorflow/tsl/lib/io/async_inputstream.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "tensorflow/tsl/platform/errors.h"
+
+namespace tsl {
+namespace io {
+
+AsyncInputStream::AsyncInputStream(RandomAccessFile* file, size_t chunk_size,
+                                   int depth, bool owns_file)
+    : file_(file),
+      chunk_size_(std::max<size_t>(chunk_size, 1)),
+      depth_(std::max(depth, 1)),
+      owns_file_(owns_file) {}
+
+AsyncInputStream::~AsyncInputStream() {
+  chunks_.clear();
+  {
+    mutex_lock l(mu_);
+    while (in_flight_ > 0) {
+      cv_.wait(l);
+    }
+  }
+  if (owns_file_) {
+    delete file_;
+  }
+}
+
+void AsyncInputStream::IssueReads() {
+  while (!eof_ && chunks_.size() < static_cast<size_t>(depth_)) {
+    auto chunk = std::make_shared<Chunk>(next_offset_, chunk_size_);
+    next_offset_ += chunk_size_;
+    chunks_.push_back(chunk);
+    {
+      mutex_lock l(mu_);
+      ++in_flight_;
+    }
+    // The default ReadAsync() runs the callback before returning, so mu_ must
+    // not be held here.
+    file_->ReadAsync(chunk->offset, chunk_size_, chunk->buffer.get(),
+                     [this, chunk](const Status& s, StringPiece data) {
+                       mutex_lock l(mu_);
+                       chunk->status = s;
+                       chunk->data = data;
+                       chunk->done = true;
+                       --in_flight_;
+                       cv_.notify_all();
+                     });
+  }
+}
+
+void AsyncInputStream::Restart(int64_t position) {
+  // The callbacks of the dropped chunks keep their buffers alive.
+  chunks_.clear();
+  pos_ = position;
+  next_offset_ = position;
+  eof_ = false;
+}
+
+Status AsyncInputStream::Consume(int64_t n, tstring* result) {
+  while (n > 0) {
+    if (chunks_.empty()) {
+      IssueReads();
+      if (chunks_.empty()) {
+        return errors::OutOfRange("reached end of file");
+      }
+    }
+    Chunk* chunk = chunks_.front().get();
+    {
+      mutex_lock l(mu_);
+      while (!chunk->done) {
+        cv_.wait(l);
+      }
+    }
+    if (!chunk->status.ok() && !errors::IsOutOfRange(chunk->status)) {
+      Status s = chunk->status;
+      // Retry from the current position on the next call.
+      Restart(pos_);
+      return s;
+    }
+    const size_t available = chunk->data.size() - chunk->consumed;
+    const size_t to_consume = std::min<size_t>(available, n);
+    if (result != nullptr) {
+      result->append(chunk->data.data() + chunk->consumed, to_consume);
+    }
+    chunk->consumed += to_consume;
+    pos_ += to_consume;
+    n -= to_consume;
+    if (chunk->consumed == chunk->data.size()) {
+      if (chunk->data.size() < chunk_size_) {
+        // A short read means the end of the file, so the chunks after it are
+        // empty.
+        eof_ = true;
+        chunks_.clear();
+      } else {
+        chunks_.pop_front();
+        IssueReads();
+      }
+    }
+  }
+  return OkStatus();
+}
+
+Status AsyncInputStream::ReadNBytes(int64_t bytes_to_read, tstring* result) {
+  if (bytes_to_read < 0) {
+    return errors::InvalidArgument("Cannot read negative number of bytes");
+  }
+  result->clear();
+  result->reserve(bytes_to_read);
+  return Consume(bytes_to_read, result);
+}
+
+Status AsyncInputStream::SkipNBytes(int64_t bytes_to_skip) {
+  if (bytes_to_skip < 0) {
+    return errors::InvalidArgument("Can't skip a negative number of bytes");
+  }
+  if (bytes_to_skip < static_cast<int64_t>(chunk_size_) * depth_) {
+    return Consume(bytes_to_skip, nullptr);
+  }
+  // Skipping past the reads in flight: like RandomAccessInputStream, read the
+  // last byte skipped to check that the end of the file is not reached.
+  char scratch;
+  StringPiece data;
+  Status s = file_->Read(pos_ + bytes_to_skip - 1, 1, &data, &scratch);
+  if ((s.ok() || errors::IsOutOfRange(s)) && data.size() == 1) {
+    Restart(pos_ + bytes_to_skip);
+    return OkStatus();
+  }
+  if (!s.ok() && !errors::IsOutOfRange(s)) {
+    return s;
+  }
+  // Consume up to the end of the file so that Tell() returns its length.
+  return Consume(bytes_to_skip, nullptr);
+}
+
+Status AsyncInputStream::Reset() {
+  Restart(0);
+  return OkStatus();
+}
+
+}  // namespace io
+}  // namespace tsl
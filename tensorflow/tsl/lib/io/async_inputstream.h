@@ -0,0 +1,93 @@
+// This file contains AsyncInputStream, an input stream which reads a file
+// ahead of its consumer with many asynchronous reads in flight, so that the
+// latency of a remote or network-attached filesystem is hidden behind the
+// processing of what was read before.
+
+#ifndef TENSORFLOW_TSL_LIB_IO_ASYNC_INPUTSTREAM_H_
+#define TENSORFLOW_TSL_LIB_IO_ASYNC_INPUTSTREAM_H_
+
+#include <deque>
+#include <memory>
+
+#include "tensorflow/tsl/lib/io/inputstream_interface.h"
+#include "tensorflow/tsl/platform/file_system.h"
+#include "tensorflow/tsl/platform/mutex.h"
+#include "tensorflow/tsl/platform/status.h"
+#include "tensorflow/tsl/platform/stringpiece.h"
+#include "tensorflow/tsl/platform/thread_annotations.h"
+
+namespace tsl {
+namespace io {
+
+// Wraps a RandomAccessFile in an InputStreamInterface which keeps up to
+// `depth` reads of `chunk_size` bytes in flight ahead of the current position,
+// using RandomAccessFile::ReadAsync(). Reads should be sequential: skipping
+// far ahead, or resetting, discards the reads in flight. A given instance is
+// NOT safe for concurrent use by multiple threads.
+class AsyncInputStream : public InputStreamInterface {
+ public:
+  // Does not take ownership of 'file' unless owns_file is set to true. 'file'
+  // must outlive *this.
+  AsyncInputStream(RandomAccessFile* file, size_t chunk_size, int depth,
+                   bool owns_file = false);
+
+  // Waits for the reads in flight.
+  ~AsyncInputStream() override;
+
+  Status ReadNBytes(int64_t bytes_to_read, tstring* result) override;
+
+  Status SkipNBytes(int64_t bytes_to_skip) override;
+
+  int64_t Tell() const override { return pos_; }
+
+  Status Reset() override;
+
+ private:
+  // The buffer of one read, kept alive by the read's callback.
+  struct Chunk {
+    explicit Chunk(int64_t offset, size_t size)
+        : offset(offset), buffer(new char[size]) {}
+
+    const int64_t offset;
+    std::unique_ptr<char[]> buffer;
+    // Set by the read's callback, under mu_.
+    bool done = false;
+    Status status;
+    StringPiece data;
+    // The number of bytes of `data` consumed.
+    size_t consumed = 0;
+  };
+
+  // Issues reads until `depth_` chunks are queued, or the end of the file is
+  // known.
+  void IssueReads();
+
+  // Consumes `n` bytes, appending them to `result` unless it is null.
+  Status Consume(int64_t n, tstring* result);
+
+  // Drops the queued chunks and issues the next reads at `position`.
+  void Restart(int64_t position);
+
+  RandomAccessFile* const file_;
+  const size_t chunk_size_;
+  const int depth_;
+  const bool owns_file_;
+
+  // The queued chunks, in the order of the file.
+  std::deque<std::shared_ptr<Chunk>> chunks_;
+  // The offset of the next read to issue.
+  int64_t next_offset_ = 0;
+  // Where we are in the file.
+  int64_t pos_ = 0;
+  // Whether a read hit the end of the file, so that no more reads are issued.
+  bool eof_ = false;
+
+  mutex mu_;
+  condition_variable cv_;
+  int64_t in_flight_ TF_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace io
+}  // namespace tsl
+
+#endif  // TENSORFLOW_TSL_LIB_IO_ASYNC_INPUTSTREAM_H_
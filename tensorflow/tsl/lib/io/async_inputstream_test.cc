@@ -0,0 +1,75 @@
+#include "tensorflow/tsl/lib/io/async_inputstream.h"
+
+#include <memory>
+
+#include "tensorflow/tsl/lib/core/status_test_util.h"
+#include "tensorflow/tsl/platform/env.h"
+#include "tensorflow/tsl/platform/test.h"
+
+namespace tsl {
+namespace io {
+namespace {
+
+class AsyncInputStreamTest : public ::testing::TestWithParam<int> {
+ protected:
+  void SetUp() override {
+    string fname = testing::TmpDir() + "/async_inputstream_test";
+    TF_ASSERT_OK(WriteStringToFile(Env::Default(), fname, "0123456789"));
+    TF_ASSERT_OK(Env::Default()->NewRandomAccessFile(fname, &file_));
+  }
+
+  std::unique_ptr<RandomAccessFile> file_;
+};
+
+TEST_P(AsyncInputStreamTest, ReadNBytes) {
+  tstring read;
+  AsyncInputStream in(file_.get(), /*chunk_size=*/3, GetParam());
+  TF_ASSERT_OK(in.ReadNBytes(3, &read));
+  EXPECT_EQ(read, "012");
+  EXPECT_EQ(3, in.Tell());
+  TF_ASSERT_OK(in.ReadNBytes(0, &read));
+  EXPECT_EQ(read, "");
+  EXPECT_EQ(3, in.Tell());
+  TF_ASSERT_OK(in.ReadNBytes(5, &read));
+  EXPECT_EQ(read, "34567");
+  EXPECT_EQ(8, in.Tell());
+  EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(20, &read)));
+  EXPECT_EQ(read, "89");
+  EXPECT_EQ(10, in.Tell());
+  EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(1, &read)));
+  EXPECT_EQ(read, "");
+  EXPECT_EQ(10, in.Tell());
+}
+
+TEST_P(AsyncInputStreamTest, SkipNBytes) {
+  tstring read;
+  AsyncInputStream in(file_.get(), /*chunk_size=*/2, GetParam());
+  TF_ASSERT_OK(in.SkipNBytes(3));
+  EXPECT_EQ(3, in.Tell());
+  TF_ASSERT_OK(in.ReadNBytes(2, &read));
+  EXPECT_EQ(read, "34");
+  TF_ASSERT_OK(in.SkipNBytes(4));
+  EXPECT_EQ(9, in.Tell());
+  TF_ASSERT_OK(in.ReadNBytes(1, &read));
+  EXPECT_EQ(read, "9");
+  EXPECT_TRUE(errors::IsOutOfRange(in.SkipNBytes(5)));
+  EXPECT_EQ(10, in.Tell());
+}
+
+TEST_P(AsyncInputStreamTest, Reset) {
+  tstring read;
+  AsyncInputStream in(file_.get(), /*chunk_size=*/4, GetParam());
+  TF_ASSERT_OK(in.ReadNBytes(6, &read));
+  EXPECT_EQ(read, "012345");
+  TF_ASSERT_OK(in.Reset());
+  EXPECT_EQ(0, in.Tell());
+  TF_ASSERT_OK(in.ReadNBytes(10, &read));
+  EXPECT_EQ(read, "0123456789");
+}
+
+INSTANTIATE_TEST_SUITE_P(Depths, AsyncInputStreamTest,
+                         ::testing::Values(1, 2, 16));
+
+}  // namespace
+}  // namespace io
+}  // namespace tsl
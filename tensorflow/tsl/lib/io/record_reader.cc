@@ -18,6 +18,7 @@ limitations under the License.
 #include <limits.h>
 
 #include "tensorflow/tsl/lib/hash/crc32c.h"
+#include "tensorflow/tsl/lib/io/async_inputstream.h"
 #include "tensorflow/tsl/lib/io/buffered_inputstream.h"
 #include "tensorflow/tsl/lib/io/compression.h"
 #include "tensorflow/tsl/lib/io/random_inputstream.h"
@@ -59,7 +60,10 @@ RecordReader::RecordReader(RandomAccessFile* file,
     : options_(options),
       input_stream_(new RandomAccessInputStream(file)),
       last_read_failed_(false) {
-  if (options.buffer_size > 0) {
+  if (options.buffer_size > 0 && options.async_read_depth > 0) {
+    input_stream_.reset(new AsyncInputStream(file, options.buffer_size,
+                                             options.async_read_depth));
+  } else if (options.buffer_size > 0) {
     input_stream_.reset(new BufferedInputStream(input_stream_.release(),
                                                 options.buffer_size, true));
   }
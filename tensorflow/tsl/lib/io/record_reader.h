@@ -46,6 +46,12 @@ struct RecordReaderOptions {
   // compressed files.) Consider using SequentialRecordReader.
   int64_t buffer_size = 0;
 
+  // Added by Alpa. If both this and buffer_size are non-zero, the file is read
+  // ahead in chunks of buffer_size bytes with up to this many reads in flight,
+  // using RandomAccessFile::ReadAsync(). This hides the latency of remote
+  // filesystems, at the cost of this many buffers of memory.
+  int64_t async_read_depth = 0;
+
   static RecordReaderOptions CreateRecordReaderOptions(
       const string& compression_type);
 
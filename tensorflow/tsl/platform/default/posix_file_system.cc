@@ -26,14 +26,33 @@ limitations under the License.
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define TSL_POSIX_HAS_IO_URING 1
+#endif
+#endif
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
 #include "tensorflow/tsl/platform/default/posix_file_system.h"
 #include "tensorflow/tsl/platform/env.h"
 #include "tensorflow/tsl/platform/errors.h"
 #include "tensorflow/tsl/platform/file_system_helper.h"
 #include "tensorflow/tsl/platform/logging.h"
+#include "tensorflow/tsl/platform/mutex.h"
 #include "tensorflow/tsl/platform/status.h"
 #include "tensorflow/tsl/platform/strcat.h"
 #include "tensorflow/tsl/protobuf/error_codes.pb.h"
@@ -45,6 +64,183 @@ using ::tsl::errors::IOError;
 // 128KB of copy buffer
 constexpr size_t kPosixCopyFileBufferSize = 128 * 1024;
 
+#if defined(TSL_POSIX_HAS_IO_URING)
+namespace {
+
+// The number of submission queue entries of the io_uring, i.e. the maximum
+// number of reads in flight.
+constexpr unsigned kIoUringEntries = 256;
+
+// Added by Alpa. A process-wide io_uring which serves the asynchronous reads
+// of the POSIX filesystem. Reads are submitted by the reading threads and
+// reaped by one completion thread, which runs their callbacks. The ring is
+// used through the raw system calls, so that no liburing is needed.
+class IoUring {
+ public:
+  // Called with the number of bytes read, or with a negated errno.
+  using Callback = std::function<void(int64_t)>;
+
+  // Returns the ring, or nullptr if io_uring is not supported by the kernel or
+  // is disabled by setting the environment variable TF_DISABLE_IO_URING.
+  static IoUring* Get() {
+    static IoUring* ring = Create();
+    return ring;
+  }
+
+  // Submits a read of `n` bytes of `fd` at `offset` into `buffer`. Blocks while
+  // kIoUringEntries reads are in flight.
+  void SubmitRead(int fd, uint64 offset, size_t n, char* buffer,
+                  Callback done) {
+    auto* request = new Request{{buffer, n}, std::move(done)};
+    mutex_lock l(mu_);
+    while (in_flight_ >= entries_) {
+      cv_.wait(l);
+    }
+    ++in_flight_;
+    // Only this thread writes the tail, under mu_.
+    const unsigned tail = *sq_tail_;
+    const unsigned index = tail & *sq_mask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = reinterpret_cast<uint64_t>(&request->iov);
+    sqe->len = 1;
+    sqe->user_data = reinterpret_cast<uint64_t>(request);
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    while (true) {
+      // Also submits the entries a previous call failed to submit.
+      const unsigned to_submit =
+          tail + 1 - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+      if (syscall(__NR_io_uring_enter, ring_fd_, to_submit, 0, 0, nullptr,
+                  0) >= 0) {
+        return;
+      }
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        LOG(ERROR) << "io_uring_enter() failed to submit a read: "
+                   << strerror(errno);
+        return;
+      }
+    }
+  }
+
+ private:
+  struct Request {
+    struct iovec iov;
+    Callback done;
+  };
+
+  static IoUring* Create() {
+    const char* disable = std::getenv("TF_DISABLE_IO_URING");
+    if (disable != nullptr && strcmp(disable, "0") != 0) {
+      return nullptr;
+    }
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int ring_fd = syscall(__NR_io_uring_setup, kIoUringEntries, &params);
+    if (ring_fd < 0) {
+      VLOG(1) << "io_uring is unavailable: " << strerror(errno);
+      return nullptr;
+    }
+    const size_t sq_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    const size_t cq_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const size_t sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sq = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    void* cq = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    void* sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED) {
+      LOG(WARNING) << "Failed to map the io_uring: " << strerror(errno);
+      if (sq != MAP_FAILED) munmap(sq, sq_size);
+      if (cq != MAP_FAILED) munmap(cq, cq_size);
+      if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+      close(ring_fd);
+      return nullptr;
+    }
+    VLOG(1) << "Using io_uring for asynchronous file reads.";
+    // The ring lives as long as the process.
+    return new IoUring(ring_fd, params, static_cast<char*>(sq),
+                       static_cast<char*>(cq),
+                       static_cast<io_uring_sqe*>(sqes));
+  }
+
+  IoUring(int ring_fd, const io_uring_params& params, char* sq, char* cq,
+          io_uring_sqe* sqes)
+      : ring_fd_(ring_fd),
+        entries_(params.sq_entries),
+        sq_head_(reinterpret_cast<unsigned*>(sq + params.sq_off.head)),
+        sq_tail_(reinterpret_cast<unsigned*>(sq + params.sq_off.tail)),
+        sq_mask_(reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask)),
+        sq_array_(reinterpret_cast<unsigned*>(sq + params.sq_off.array)),
+        sqes_(sqes),
+        cq_head_(reinterpret_cast<unsigned*>(cq + params.cq_off.head)),
+        cq_tail_(reinterpret_cast<unsigned*>(cq + params.cq_off.tail)),
+        cq_mask_(reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask)),
+        cqes_(reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes)) {
+    thread_.reset(Env::Default()->StartThread(
+        ThreadOptions(), "io_uring_completions", [this]() { Reap(); }));
+  }
+
+  // Waits for completions and runs their callbacks, forever.
+  void Reap() {
+    std::vector<std::pair<Request*, int64_t>> completed;
+    while (true) {
+      if (syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS,
+                  nullptr, 0) < 0 &&
+          errno != EINTR) {
+        LOG(ERROR) << "io_uring_enter() failed to wait for completions: "
+                   << strerror(errno);
+      }
+      // Only this thread writes the head.
+      unsigned head = *cq_head_;
+      const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      for (; head != tail; ++head) {
+        const io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+        completed.emplace_back(reinterpret_cast<Request*>(cqe.user_data),
+                               cqe.res);
+      }
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+      if (completed.empty()) continue;
+      {
+        mutex_lock l(mu_);
+        in_flight_ -= completed.size();
+        cv_.notify_all();
+      }
+      for (auto& request : completed) {
+        request.first->done(request.second);
+        delete request.first;
+      }
+      completed.clear();
+    }
+  }
+
+  const int ring_fd_;
+  const unsigned entries_;
+  unsigned* const sq_head_;
+  unsigned* const sq_tail_;
+  unsigned* const sq_mask_;
+  unsigned* const sq_array_;
+  io_uring_sqe* const sqes_;
+  unsigned* const cq_head_;
+  unsigned* const cq_tail_;
+  unsigned* const cq_mask_;
+  io_uring_cqe* const cqes_;
+
+  mutex mu_;
+  condition_variable cv_;
+  unsigned in_flight_ TF_GUARDED_BY(mu_) = 0;
+  std::unique_ptr<Thread> thread_;
+};
+
+}  // namespace
+#endif  // TSL_POSIX_HAS_IO_URING
+
 // pread() based random-access
 class PosixRandomAccessFile : public RandomAccessFile {
  private:
@@ -96,6 +292,39 @@ class PosixRandomAccessFile : public RandomAccessFile {
     return s;
   }
 
+  // Added by Alpa. Reads through the process-wide io_uring when the kernel
+  // supports it, so that one thread can keep many reads in flight.
+  void ReadAsync(
+      uint64 offset, size_t n, char* scratch,
+      std::function<void(const Status&, StringPiece)> done) const override {
+#if defined(TSL_POSIX_HAS_IO_URING)
+    IoUring* ring = IoUring::Get();
+    if (ring != nullptr && n > 0 && n <= INT32_MAX) {
+      ring->SubmitRead(
+          fd_, offset, n, scratch,
+          [this, offset, n, scratch, done = std::move(done)](int64_t r) {
+            if (r == static_cast<int64_t>(n)) {
+              done(OkStatus(), StringPiece(scratch, n));
+              return;
+            }
+            if (r < 0 && r != -EINTR && r != -EAGAIN) {
+              done(IOError(filename_, -r), StringPiece(scratch, 0));
+              return;
+            }
+            // Short reads, e.g. at the end of the file, are rare, and are
+            // finished synchronously rather than resubmitted from the
+            // completion thread.
+            const size_t read = r > 0 ? r : 0;
+            StringPiece rest;
+            Status s = Read(offset + read, n - read, &rest, scratch + read);
+            done(s, StringPiece(scratch, read + rest.size()));
+          });
+      return;
+    }
+#endif  // TSL_POSIX_HAS_IO_URING
+    RandomAccessFile::ReadAsync(offset, n, scratch, std::move(done));
+  }
+
 #if defined(TF_CORD_SUPPORT)
   Status Read(uint64 offset, size_t n, absl::Cord* cord) const override {
     if (n == 0) {
@@ -765,6 +765,25 @@ class RandomAccessFile {
   virtual tsl::Status Read(uint64 offset, size_t n, StringPiece* result,
                            char* scratch) const = 0;
 
+  /// Added by Alpa.
+  /// \brief Reads up to `n` bytes from the file starting at `offset` without
+  /// waiting for the read to complete.
+  ///
+  /// Calls `done` with the status and the data read, which have the same
+  /// semantics as for Read(). `scratch` and the file must stay alive until
+  /// `done` is called. `done` may be called on an I/O completion thread, and
+  /// must not block. The default implementation calls Read() and then `done`,
+  /// before returning.
+  ///
+  /// Safe for concurrent use by multiple threads.
+  virtual void ReadAsync(
+      uint64 offset, size_t n, char* scratch,
+      std::function<void(const tsl::Status&, StringPiece)> done) const {
+    StringPiece result;
+    tsl::Status s = Read(offset, n, &result, scratch);
+    done(s, result);
+  }
+
 #if defined(TF_CORD_SUPPORT)
   /// \brief Read up to `n` bytes from the file starting at `offset`.
   virtual tsl::Status Read(uint64 offset, size_t n, absl::Cord* cord) const {
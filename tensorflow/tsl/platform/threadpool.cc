@@ -17,6 +17,9 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <atomic>
+#include <deque>
+
 #include "absl/types/optional.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/tsl/platform/blocking_counter.h"
@@ -87,6 +90,181 @@ struct EigenEnvironment {
   }
 };
 
+// A pool whose threads are partitioned over NUMA nodes and pinned to them.
+//
+// Every node has a FIFO task queue. Tasks scheduled from a pool thread stay on
+// that thread's node; tasks scheduled from outside are spread round-robin over
+// the nodes. A thread runs the tasks of its own node first and steals from the
+// other nodes only when its own queue is empty. Wakeups prefer sleeping
+// threads of the task's node.
+class NumaPartitionedThreadPool : public Eigen::ThreadPoolInterface {
+ public:
+  NumaPartitionedThreadPool(Env* env, const ThreadOptions& thread_options,
+                            const string& name, int num_threads, int num_nodes)
+      : num_threads_(num_threads) {
+    for (int node = 0; node < num_nodes; ++node) {
+      ThreadOptions node_options = thread_options;
+      node_options.numa_node = node;
+      envs_.emplace_back(new EigenEnvironment(env, node_options, name));
+      nodes_.emplace_back(new Node);
+    }
+    for (int i = 0; i < num_threads; ++i) {
+      // Contiguous thread ids share a node, like cores share a socket.
+      const int node = static_cast<int64_t>(i) * num_nodes / num_threads;
+      threads_.emplace_back(envs_[node]->CreateThread(
+          [this, i, node]() { WorkerLoop(i, node); }));
+    }
+  }
+
+  ~NumaPartitionedThreadPool() override {
+    {
+      mutex_lock l(sleep_mu_);
+      done_ = true;
+      for (auto& node : nodes_) {
+        node->wakeup_cv.notify_all();
+      }
+    }
+    // Deleting the threads joins them once all queued tasks have run.
+    threads_.clear();
+  }
+
+  void Schedule(std::function<void()> fn) override {
+    const PerThread* per_thread = GetPerThread();
+    const int node = per_thread->pool == this
+                         ? per_thread->node
+                         : next_node_.fetch_add(1, std::memory_order_relaxed) %
+                               nodes_.size();
+    Push(node, std::move(fn));
+  }
+
+  void ScheduleWithHint(std::function<void()> fn, int start,
+                        int limit) override {
+    if (start < 0 || start >= num_threads_) {
+      Schedule(std::move(fn));
+      return;
+    }
+    Push(NodeOfThread(start), std::move(fn));
+  }
+
+  int NumThreads() const override { return num_threads_; }
+
+  int CurrentThreadId() const override {
+    const PerThread* per_thread = GetPerThread();
+    return per_thread->pool == this ? per_thread->thread_id : -1;
+  }
+
+  static int CurrentNumaNode() { return GetPerThread()->node; }
+
+ private:
+  struct PerThread {
+    const NumaPartitionedThreadPool* pool = nullptr;
+    int thread_id = -1;
+    int node = port::kNUMANoAffinity;
+  };
+
+  struct Node {
+    mutex mu;
+    std::deque<EigenEnvironment::Task> queue TF_GUARDED_BY(mu);
+
+    // The following are guarded by sleep_mu_.
+    condition_variable wakeup_cv;
+    int sleepers = 0;
+    int wakeups = 0;  // Wakeups granted but not yet consumed by a sleeper.
+  };
+
+  static PerThread* GetPerThread() {
+    static thread_local PerThread per_thread;
+    return &per_thread;
+  }
+
+  int NodeOfThread(int thread_id) const {
+    return static_cast<int64_t>(thread_id) * nodes_.size() / num_threads_;
+  }
+
+  void Push(int node, std::function<void()> fn) {
+    EigenEnvironment::Task task = envs_[node]->CreateTask(std::move(fn));
+    {
+      mutex_lock l(nodes_[node]->mu);
+      nodes_[node]->queue.push_back(std::move(task));
+    }
+    // Pairs with the sleepers/pending check in WorkerLoop: either the worker
+    // sees the new task or this sees the worker as a sleeper.
+    pending_.fetch_add(1, std::memory_order_seq_cst);
+    if (num_sleepers_.load(std::memory_order_seq_cst) == 0) {
+      return;
+    }
+    mutex_lock l(sleep_mu_);
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      Node* target = nodes_[(node + i) % nodes_.size()].get();
+      if (target->sleepers > target->wakeups) {
+        ++target->wakeups;
+        target->wakeup_cv.notify_one();
+        return;
+      }
+    }
+  }
+
+  // Pops a task of `node`, or steals one from the other nodes.
+  bool Pop(int node, EigenEnvironment::Task* task) {
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      Node* source = nodes_[(node + i) % nodes_.size()].get();
+      mutex_lock l(source->mu);
+      if (!source->queue.empty()) {
+        *task = std::move(source->queue.front());
+        source->queue.pop_front();
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void WorkerLoop(int thread_id, int node) {
+    PerThread* per_thread = GetPerThread();
+    per_thread->pool = this;
+    per_thread->thread_id = thread_id;
+    per_thread->node = node;
+    Node* own = nodes_[node].get();
+    while (true) {
+      EigenEnvironment::Task task;
+      if (Pop(node, &task)) {
+        envs_[node]->ExecuteTask(task);
+        continue;
+      }
+      mutex_lock l(sleep_mu_);
+      ++own->sleepers;
+      num_sleepers_.fetch_add(1, std::memory_order_seq_cst);
+      if (pending_.load(std::memory_order_seq_cst) <= 0) {
+        if (done_) {
+          --own->sleepers;
+          num_sleepers_.fetch_sub(1, std::memory_order_relaxed);
+          return;
+        }
+        while (own->wakeups == 0 && !done_) {
+          own->wakeup_cv.wait(l);
+        }
+        if (own->wakeups > 0) {
+          --own->wakeups;
+        }
+      }
+      --own->sleepers;
+      num_sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  const int num_threads_;
+  std::vector<std::unique_ptr<EigenEnvironment>> envs_;  // One per node.
+  std::vector<std::unique_ptr<Node>> nodes_;
+  std::atomic<unsigned> next_node_{0};
+  // Number of queued tasks over all nodes. May briefly be negative, since a
+  // task can be popped before Push() counts it.
+  std::atomic<int64_t> pending_{0};
+  std::atomic<int> num_sleepers_{0};
+  mutex sleep_mu_;
+  bool done_ TF_GUARDED_BY(sleep_mu_) = false;
+  std::vector<std::unique_ptr<Thread>> threads_;
+};
+
 ThreadPool::ThreadPool(Env* env, const string& name, int num_threads)
     : ThreadPool(env, ThreadOptions(), name, num_threads, true, nullptr) {}
 
@@ -96,12 +274,31 @@ ThreadPool::ThreadPool(Env* env, const ThreadOptions& thread_options,
 
 ThreadPool::ThreadPool(Env* env, const ThreadOptions& thread_options,
                        const string& name, int num_threads,
-                       bool low_latency_hint, Eigen::Allocator* allocator) {
+                       bool low_latency_hint, Eigen::Allocator* allocator)
+    : ThreadPool(env, thread_options, name, num_threads, low_latency_hint,
+                 allocator, /*numa_partitioned=*/false) {}
+
+ThreadPool::ThreadPool(Env* env, const ThreadOptions& thread_options,
+                       const string& name, int num_threads,
+                       bool low_latency_hint, Eigen::Allocator* allocator,
+                       bool numa_partitioned) {
   CHECK_GE(num_threads, 1);
-  eigen_threadpool_.reset(new Eigen::ThreadPoolTempl<EigenEnvironment>(
-      num_threads, low_latency_hint,
-      EigenEnvironment(env, thread_options, "tf_" + name)));
-  underlying_threadpool_ = eigen_threadpool_.get();
+  const int num_nodes = numa_partitioned ? port::NUMANumNodes() : 1;
+  if (num_nodes <= 1 || num_threads < num_nodes) {
+    if (numa_partitioned) {
+      VLOG(1) << "Not partitioning thread pool " << name << " over "
+              << num_nodes << " NUMA nodes with " << num_threads
+              << " threads.";
+    }
+    eigen_threadpool_.reset(new Eigen::ThreadPoolTempl<EigenEnvironment>(
+        num_threads, low_latency_hint,
+        EigenEnvironment(env, thread_options, "tf_" + name)));
+    underlying_threadpool_ = eigen_threadpool_.get();
+  } else {
+    numa_threadpool_.reset(new NumaPartitionedThreadPool(
+        env, thread_options, "tf_" + name, num_threads, num_nodes));
+    underlying_threadpool_ = numa_threadpool_.get();
+  }
   threadpool_device_.reset(new Eigen::ThreadPoolDevice(underlying_threadpool_,
                                                        num_threads, allocator));
 }
@@ -250,6 +447,10 @@ int ThreadPool::CurrentThreadId() const {
   return underlying_threadpool_->CurrentThreadId();
 }
 
+int ThreadPool::CurrentThreadNumaNode() {
+  return NumaPartitionedThreadPool::CurrentNumaNode();
+}
+
 void ThreadPool::ScheduleWithHint(std::function<void()> fn, int start,
                                   int limit) {
   underlying_threadpool_->ScheduleWithHint(std::move(fn), start, limit);
@@ -38,6 +38,7 @@ namespace tsl {
 namespace thread {
 
 struct EigenEnvironment;
+class NumaPartitionedThreadPool;
 
 class ThreadPool {
  public:
@@ -112,6 +113,18 @@ class ThreadPool {
              const std::string& name, int num_threads, bool low_latency_hint,
              Eigen::Allocator* allocator = nullptr);
 
+  // Like the constructor above, but if "numa_partitioned" is true and the host
+  // has more than one NUMA node, the threads are split evenly over the nodes
+  // and pinned to them. Every node has its own task queue: Schedule() enqueues
+  // on the node of the calling pool thread (round-robin for other threads),
+  // and idle threads only steal from other nodes when their own node has no
+  // work. "low_latency_hint" is ignored in that mode; idle threads do not spin.
+  //
+  // REQUIRES: num_threads > 0
+  ThreadPool(Env* env, const ThreadOptions& thread_options,
+             const std::string& name, int num_threads, bool low_latency_hint,
+             Eigen::Allocator* allocator, bool numa_partitioned);
+
   // Constructs a pool for low-latency ops that contains "num_threads" threads
   // with specified "name". env->StartThread() is used to create individual
   // threads.
@@ -211,6 +224,10 @@ class ThreadPool {
   // thread in the pool. Returns -1 otherwise.
   int CurrentThreadId() const;
 
+  // Returns the NUMA node of the current thread if it is a thread of a
+  // NUMA-partitioned pool, port::kNUMANoAffinity otherwise.
+  static int CurrentThreadNumaNode();
+
   // If ThreadPool implementation is compatible with Eigen::ThreadPoolInterface,
   // returns a non-null pointer. The caller does not own the object the returned
   // pointer points to, and should not attempt to delete.
@@ -234,6 +251,9 @@ class ThreadPool {
   // eigen_threadpool_ is instantiated and owned by thread::ThreadPool if
   // user_threadpool is not in the constructor.
   std::unique_ptr<Eigen::ThreadPoolTempl<EigenEnvironment>> eigen_threadpool_;
+  // numa_threadpool_ is instantiated instead of eigen_threadpool_ for
+  // NUMA-partitioned pools.
+  std::unique_ptr<NumaPartitionedThreadPool> numa_threadpool_;
   std::unique_ptr<Eigen::ThreadPoolDevice> threadpool_device_;
   TF_DISALLOW_COPY_AND_ASSIGN(ThreadPool);
 };
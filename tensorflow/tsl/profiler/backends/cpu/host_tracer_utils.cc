@@ -17,6 +17,7 @@ limitations under the License.
 #include <string>
 #include <utility>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/string_view.h"
 #include "tensorflow/tsl/platform/types.h"
 #include "tensorflow/tsl/profiler/backends/cpu/traceme_recorder.h"
@@ -44,6 +45,10 @@ void ConvertCompleteEventsToXPlane(uint64 start_timestamp_ns,
                                    TraceMeRecorder::Events&& events,
                                    XPlane* raw_plane) {
   XPlaneBuilder xplane(raw_plane);
+  // Metadata of interned names, so they are looked up once per id rather than
+  // hashed once per event.
+  absl::flat_hash_map<uint32, XEventMetadata*> interned_event_metadata;
+  absl::flat_hash_map<uint32, XStatMetadata*> interned_stat_metadata;
   for (auto& thread : events) {
     XLineBuilder xline = xplane.GetOrCreateLine(thread.thread.tid);
     xline.SetName(thread.thread.name);
@@ -54,28 +59,45 @@ void ConvertCompleteEventsToXPlane(uint64 start_timestamp_ns,
       thread.events.pop_front();
       if (!event.IsComplete()) continue;
       if (event.start_time < start_timestamp_ns) continue;
-      if (!HasMetadata(event.name)) {
-        XEventMetadata* xevent_metadata =
+      XEventMetadata* xevent_metadata;
+      Annotation annotation;
+      if (event.name_id != 0) {
+        XEventMetadata*& interned = interned_event_metadata[event.name_id];
+        if (interned == nullptr) {
+          interned = xplane.GetOrCreateEventMetadata(
+              TraceMeRecorder::InternedName(event.name_id));
+          MayAddDisplayName(interned);
+        }
+        xevent_metadata = interned;
+      } else if (!HasMetadata(event.name)) {
+        xevent_metadata =
             xplane.GetOrCreateEventMetadata(std::move(event.name));
         MayAddDisplayName(xevent_metadata);
-        XEventBuilder xevent = xline.AddEvent(*xevent_metadata);
-        xevent.SetTimestampNs(event.start_time);
-        xevent.SetEndTimestampNs(event.end_time);
-        continue;
+      } else {
+        annotation = ParseAnnotation(event.name);
+        xevent_metadata = xplane.GetOrCreateEventMetadata(annotation.name);
+        MayAddDisplayName(xevent_metadata);
       }
-      Annotation annotation = ParseAnnotation(event.name);
-      XEventMetadata* xevent_metadata =
-          xplane.GetOrCreateEventMetadata(annotation.name);
-      MayAddDisplayName(xevent_metadata);
       XEventBuilder xevent = xline.AddEvent(*xevent_metadata);
       xevent.SetTimestampNs(event.start_time);
       xevent.SetEndTimestampNs(event.end_time);
-      xevent.ReserveStats(annotation.metadata.size());
+      if (annotation.metadata.empty() && !event.HasArg()) continue;
+      xevent.ReserveStats(annotation.metadata.size() + event.HasArg());
       for (const auto& metadata : annotation.metadata) {
         XStatMetadata* xstat_metadata =
             xplane.GetOrCreateStatMetadata(metadata.key);
         xevent.ParseAndAddStatValue(*xstat_metadata, metadata.value);
       }
+      if (event.HasArg()) {
+        // Deferred metadata is added without formatting and parsing it.
+        XStatMetadata*& xstat_metadata =
+            interned_stat_metadata[event.arg_key_id];
+        if (xstat_metadata == nullptr) {
+          xstat_metadata = xplane.GetOrCreateStatMetadata(
+              TraceMeRecorder::InternedName(event.arg_key_id));
+        }
+        xevent.AddStatValue(*xstat_metadata, event.arg_value);
+      }
     }
   }
   SortXLinesBy(raw_plane, XLinesComparatorByName());
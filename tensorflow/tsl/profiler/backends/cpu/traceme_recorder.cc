@@ -16,14 +16,20 @@ limitations under the License.
 
 #include <stddef.h>
 
+#include <string.h>
+
 #include <algorithm>
 #include <atomic>
+#include <deque>
 #include <memory>
 #include <new>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "tensorflow/tsl/platform/env.h"
 #include "tensorflow/tsl/platform/logging.h"
 #include "tensorflow/tsl/platform/macros.h"
@@ -35,6 +41,7 @@ namespace profiler {
 namespace internal {
 
 std::atomic<int> g_trace_level(TraceMeRecorder::kTracingDisabled);
+std::atomic<bool> g_always_on(false);
 
 // g_trace_level implementation must be lock-free for faster execution of the
 // TraceMe API. This can be commented (if compilation is failing) but execution
@@ -80,6 +87,11 @@ class SplitEventTracker {
     auto& start_event = iter->second;
     event->name = std::move(start_event.name);
     event->start_time = start_event.start_time;
+    event->name_id = start_event.name_id;
+    if (start_event.HasArg()) {
+      event->arg_key_id = start_event.arg_key_id;
+      event->arg_value = start_event.arg_value;
+    }
     start_events_.erase(iter);
     return true;
   }
@@ -92,6 +104,165 @@ class SplitEventTracker {
   std::vector<TraceMeRecorder::Event*> end_events_;
 };
 
+// Adds `event` to `events`, handing start and end events to
+// split_event_tracker so their data is merged (see SplitEventTracker).
+void AddEvent(TraceMeRecorder::Event&& event,
+              std::deque<TraceMeRecorder::Event>* events,
+              SplitEventTracker* split_event_tracker) {
+  // Copy data from start events to end events. TraceMe records events in
+  // its destructor, so this results in complete events sorted by their
+  // end_time in the thread they ended. Within the same thread, the start
+  // event must appear before the corresponding end event.
+  if (event.IsStart()) {
+    split_event_tracker->AddStart(std::move(event));
+    return;
+  }
+  events->emplace_back(std::move(event));
+  if (events->back().IsEnd()) {
+    split_event_tracker->AddEnd(&events->back());
+  }
+}
+
+// Names interned by TraceMeRecorder::InternName. Id 0 is reserved for
+// "not interned".
+class NameInterner {
+ public:
+  static NameInterner* Get() {
+    static NameInterner* singleton = new NameInterner;
+    return singleton;
+  }
+
+  uint32 Intern(absl::string_view name) {
+    mutex_lock lock(mutex_);
+    auto iter = ids_.find(name);
+    if (iter != ids_.end()) return iter->second;
+    names_.emplace_back(name);
+    const uint32 id = names_.size();
+    // The key views the deque element, whose address is stable.
+    ids_.emplace(names_.back(), id);
+    return id;
+  }
+
+  absl::string_view Name(uint32 id) {
+    mutex_lock lock(mutex_);
+    if (id == 0 || id > names_.size()) return absl::string_view();
+    return names_[id - 1];
+  }
+
+ private:
+  mutex mutex_;
+  std::deque<std::string> names_ TF_GUARDED_BY(mutex_);
+  absl::flat_hash_map<absl::string_view, uint32> ids_ TF_GUARDED_BY(mutex_);
+};
+
+// A fixed-size single-producer ring buffer of compact events used by
+// always-on recording. When full, Push overwrites the oldest event.
+//
+// Push is only called by the owner thread and is lock-free. Snapshot is only
+// called by the tracing control thread and may run concurrently with Push.
+// Each slot is protected by a sequence number (a seqlock): Push marks the slot
+// odd while writing it, and Snapshot discards slots that changed or were
+// being written while it read them. All slot fields are atomics accessed with
+// relaxed ordering so the concurrent reads are well-defined.
+class EventRing {
+ public:
+  explicit EventRing(size_t capacity)
+      : capacity_(RoundUpToPowerOfTwo(capacity)),
+        slots_(new Slot[capacity_]) {}
+
+  size_t capacity() const { return capacity_; }
+
+  void Push(const TraceMeRecorder::Event& event) {
+    const uint64 index = head_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[index & (capacity_ - 1)];
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.start_time.store(event.start_time, std::memory_order_relaxed);
+    slot.end_time.store(event.end_time, std::memory_order_relaxed);
+    slot.name_id.store(event.name_id, std::memory_order_relaxed);
+    slot.arg_key_id.store(event.arg_key_id, std::memory_order_relaxed);
+    slot.arg_value.store(event.arg_value, std::memory_order_relaxed);
+    absl::string_view name;
+    if (event.name_id == 0) name = TruncateName(event.name);
+    uint64 words[kNameWords] = {};
+    memcpy(words, name.data(), name.size());
+    for (size_t i = 0; i * sizeof(uint64) < name.size(); ++i) {
+      slot.name[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.name_size.store(name.size(), std::memory_order_relaxed);
+    slot.seq.store(2 * index + 2, std::memory_order_release);
+    head_.store(index + 1, std::memory_order_release);
+  }
+
+  // Appends the events in the ring that started or ended at or after
+  // since_ns to `events`, oldest first.
+  void Snapshot(int64_t since_ns, std::deque<TraceMeRecorder::Event>* events,
+                SplitEventTracker* split_event_tracker) const {
+    const uint64 head = head_.load(std::memory_order_acquire);
+    const uint64 begin = head > capacity_ ? head - capacity_ : 0;
+    for (uint64 index = begin; index < head; ++index) {
+      const Slot& slot = slots_[index & (capacity_ - 1)];
+      const uint64 seq = slot.seq.load(std::memory_order_acquire);
+      // Overwritten, or being overwritten, since we read head_.
+      if (seq != 2 * index + 2) continue;
+      TraceMeRecorder::Event event;
+      event.start_time = slot.start_time.load(std::memory_order_relaxed);
+      event.end_time = slot.end_time.load(std::memory_order_relaxed);
+      event.name_id = slot.name_id.load(std::memory_order_relaxed);
+      event.arg_key_id = slot.arg_key_id.load(std::memory_order_relaxed);
+      event.arg_value = slot.arg_value.load(std::memory_order_relaxed);
+      const size_t name_size =
+          std::min<size_t>(slot.name_size.load(std::memory_order_relaxed),
+                           TraceMeRecorder::kMaxInlineNameSize);
+      uint64 words[kNameWords];
+      for (size_t i = 0; i * sizeof(uint64) < name_size; ++i) {
+        words[i] = slot.name[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) != seq) continue;
+      if (std::max(event.start_time, event.end_time) < since_ns) continue;
+      event.name.assign(reinterpret_cast<const char*>(words), name_size);
+      AddEvent(std::move(event), events, split_event_tracker);
+    }
+  }
+
+ private:
+  static constexpr size_t kNameWords =
+      TraceMeRecorder::kMaxInlineNameSize / sizeof(uint64);
+  static_assert(TraceMeRecorder::kMaxInlineNameSize % sizeof(uint64) == 0,
+                "");
+
+  // Keeps the name (without metadata) if the whole name does not fit.
+  static absl::string_view TruncateName(absl::string_view name) {
+    if (name.size() <= TraceMeRecorder::kMaxInlineNameSize) return name;
+    name = name.substr(0, name.find('#'));
+    return name.substr(0, TraceMeRecorder::kMaxInlineNameSize);
+  }
+
+  static size_t RoundUpToPowerOfTwo(size_t n) {
+    size_t capacity = 1;
+    while (capacity < n) capacity <<= 1;
+    return capacity;
+  }
+
+  // 128 bytes: two cache lines.
+  struct alignas(64) Slot {
+    std::atomic<uint64> seq{0};
+    std::atomic<int64_t> start_time{0};
+    std::atomic<int64_t> end_time{0};
+    std::atomic<int64_t> arg_value{0};
+    std::atomic<uint32> name_id{0};
+    std::atomic<uint32> arg_key_id{0};
+    std::atomic<uint32> name_size{0};
+    std::atomic<uint64> name[kNameWords];
+  };
+
+  const size_t capacity_;
+  std::unique_ptr<Slot[]> slots_;
+  // Number of events pushed so far. Written by the producer thread only.
+  std::atomic<uint64> head_{0};
+};
+
 // A single-producer single-consumer queue of Events.
 //
 // Implemented as a linked-list of blocks containing numbered slots, with start
@@ -167,19 +338,7 @@ class EventQueue {
     size_t end = end_.load(std::memory_order_acquire);
     std::deque<TraceMeRecorder::Event> result;
     while (start_ != end) {
-      TraceMeRecorder::Event event = Pop();
-      // Copy data from start events to end events. TraceMe records events in
-      // its destructor, so this results in complete events sorted by their
-      // end_time in the thread they ended. Within the same thread, the start
-      // event must appear before the corresponding end event.
-      if (event.IsStart()) {
-        split_event_tracker->AddStart(std::move(event));
-        continue;
-      }
-      result.emplace_back(std::move(event));
-      if (result.back().IsEnd()) {
-        split_event_tracker->AddEnd(&result.back());
-      }
+      AddEvent(Pop(), &result, split_event_tracker);
     }
     return result;
   }
@@ -259,7 +418,36 @@ class TraceMeRecorder::ThreadLocalRecorder {
   void SetInactive() { active_.store(0, std::memory_order_release); }
 
   // Record is only called from the owner thread.
-  void Record(TraceMeRecorder::Event&& event) { queue_.Push(std::move(event)); }
+  void Record(TraceMeRecorder::Event&& event) {
+    if (internal::g_always_on.load(std::memory_order_relaxed)) {
+      if (EventRing* ring = ring_.load(std::memory_order_acquire)) {
+        ring->Push(event);
+        return;
+      }
+    }
+    queue_.Push(std::move(event));
+  }
+
+  // Makes Record use a ring buffer of the given capacity while always-on
+  // recording is active. Called from the control thread, or from the owner
+  // thread when it registers. Previous rings are kept alive because the owner
+  // thread may still be pushing to them.
+  void UseRing(size_t capacity) {
+    EventRing* ring = ring_.load(std::memory_order_acquire);
+    if (ring != nullptr && ring->capacity() >= capacity) return;
+    rings_.push_back(std::make_unique<EventRing>(capacity));
+    ring_.store(rings_.back().get(), std::memory_order_release);
+  }
+
+  // Snapshot is called from the control thread during always-on recording.
+  TF_MUST_USE_RESULT TraceMeRecorder::ThreadEvents Snapshot(
+      int64_t since_ns, SplitEventTracker* split_event_tracker) {
+    TraceMeRecorder::ThreadEvents events{info_, {}};
+    if (const EventRing* ring = ring_.load(std::memory_order_acquire)) {
+      ring->Snapshot(since_ns, &events.events, split_event_tracker);
+    }
+    return events;
+  }
 
   // Clear is called from the control thread when tracing starts to remove any
   // elements added due to Record racing with Consume.
@@ -274,6 +462,10 @@ class TraceMeRecorder::ThreadLocalRecorder {
  private:
   TraceMeRecorder::ThreadInfo info_;
   EventQueue queue_;
+  // The ring buffer used by always-on recording, one of rings_.
+  std::atomic<EventRing*> ring_{nullptr};
+  // Only accessed while holding TraceMeRecorder::mutex_.
+  std::vector<std::unique_ptr<EventRing>> rings_;
   std::atomic<int> active_{1};  // std::atomic<bool> is not always lock-free.
 };
 
@@ -312,6 +504,9 @@ class TraceMeRecorder::ThreadLocalRecorderWrapper {
 void TraceMeRecorder::RegisterThread(
     uint32 tid, std::shared_ptr<ThreadLocalRecorder> thread) {
   mutex_lock lock(mutex_);
+  if (always_on_events_per_thread_ > 0) {
+    thread->UseRing(always_on_events_per_thread_);
+  }
   threads_.insert_or_assign(tid, std::move(thread));
 }
 
@@ -387,6 +582,8 @@ void TraceMeRecorder::Record(Event&& event) {
 TraceMeRecorder::Events TraceMeRecorder::StopRecording() {
   TraceMeRecorder::Events events;
   mutex_lock lock(mutex_);
+  // Always-on recording is stopped by StopAlwaysOn().
+  if (AlwaysOn()) return events;
   // Change trace_level_ while holding mutex_.
   if (internal::g_trace_level.exchange(
           kTracingDisabled, std::memory_order_acq_rel) != kTracingDisabled) {
@@ -395,6 +592,96 @@ TraceMeRecorder::Events TraceMeRecorder::StopRecording() {
   return events;
 }
 
+bool TraceMeRecorder::StartAlwaysOnRecording(int level,
+                                             size_t events_per_thread) {
+  level = std::max(0, level);
+  events_per_thread = std::max<size_t>(1, events_per_thread);
+  mutex_lock lock(mutex_);
+  int expected = kTracingDisabled;
+  if (internal::g_trace_level.load(std::memory_order_acquire) != expected) {
+    return false;
+  }
+  always_on_events_per_thread_ = events_per_thread;
+  for (auto& id_and_recorder : threads_) {
+    id_and_recorder.second->UseRing(events_per_thread);
+  }
+  // Enable the rings before the trace level so threads that pass the
+  // Active() check record into them.
+  internal::g_always_on.store(true, std::memory_order_release);
+  bool started = internal::g_trace_level.compare_exchange_strong(
+      expected, level, std::memory_order_acq_rel);
+  if (started) {
+    // Events that raced with a previous Stop() are never consumed in
+    // always-on mode.
+    Clear();
+  }
+  return started;
+}
+
+TraceMeRecorder::Events TraceMeRecorder::SnapshotRecording(int64_t since_ns) {
+  TraceMeRecorder::Events result;
+  mutex_lock lock(mutex_);
+  if (!AlwaysOn()) return result;
+  result.reserve(threads_.size());
+  SplitEventTracker split_event_tracker;
+  for (auto iter = threads_.begin(); iter != threads_.end();) {
+    auto& recorder = iter->second;
+    TraceMeRecorder::ThreadEvents events =
+        recorder->Snapshot(since_ns, &split_event_tracker);
+    if (!events.events.empty()) {
+      result.push_back(std::move(events));
+    }
+    // The events of destroyed threads are only returned by one snapshot.
+    if (!recorder->IsActive()) {
+      threads_.erase(iter++);
+    } else {
+      ++iter;
+    }
+  }
+  split_event_tracker.HandleCrossThreadEvents();
+  return result;
+}
+
+void TraceMeRecorder::StopAlwaysOnRecording() {
+  mutex_lock lock(mutex_);
+  if (!AlwaysOn()) return;
+  internal::g_trace_level.store(kTracingDisabled, std::memory_order_release);
+  internal::g_always_on.store(false, std::memory_order_release);
+  always_on_events_per_thread_ = 0;
+  for (auto iter = threads_.begin(); iter != threads_.end();) {
+    if (!iter->second->IsActive()) {
+      threads_.erase(iter++);
+    } else {
+      ++iter;
+    }
+  }
+}
+
+/*static*/ uint32 TraceMeRecorder::InternName(absl::string_view name) {
+  return NameInterner::Get()->Intern(name);
+}
+
+/*static*/ absl::string_view TraceMeRecorder::InternedName(uint32 name_id) {
+  return NameInterner::Get()->Name(name_id);
+}
+
+/*static*/ std::string TraceMeRecorder::ResolveName(const Event& event) {
+  std::string name = event.name_id != 0
+                         ? std::string(InternedName(event.name_id))
+                         : event.name;
+  if (event.HasArg()) {
+    // Same encoding as TraceMeEncode: name#key1=value1,key2=value2#
+    if (!name.empty() && name.back() == '#') {
+      name.back() = ',';
+    } else {
+      name.push_back('#');
+    }
+    absl::StrAppend(&name, InternedName(event.arg_key_id), "=",
+                    event.arg_value, "#");
+  }
+  return name;
+}
+
 /*static*/ int64_t TraceMeRecorder::NewActivityId() {
   // Activity IDs: To avoid contention over a counter, the top 32 bits identify
   // the originating thread, the bottom 32 bits name the event within a thread.
@@ -22,6 +22,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
 #include "tensorflow/tsl/platform/macros.h"
 #include "tensorflow/tsl/platform/mutex.h"
 #include "tensorflow/tsl/platform/thread_annotations.h"
@@ -36,6 +37,10 @@ namespace internal {
 // Modified by TraceMeRecorder singleton when tracing starts/stops.
 TF_EXPORT extern std::atomic<int> g_trace_level;
 
+// Whether TraceMeRecorder records into the bounded always-on ring buffers
+// rather than the per-thread queues.
+TF_EXPORT extern std::atomic<bool> g_always_on;
+
 }  // namespace internal
 
 // TraceMeRecorder is a singleton repository of TraceMe events.
@@ -66,9 +71,20 @@ class TraceMeRecorder {
       return 1;  // complete
     }
 
+    // Returns true if the event has a deferred int64 argument.
+    bool HasArg() const { return arg_key_id != 0; }
+
+    // Either name or name_id is set. A non-zero name_id refers to a name
+    // interned with InternName(); it is resolved only when the events are
+    // converted, so recording does not copy or format strings.
     std::string name;
     int64_t start_time;
     int64_t end_time;
+    uint32 name_id = 0;
+    // Deferred metadata: an interned key and an int64 value which are only
+    // formatted (as "#key=value#") when the events are converted.
+    uint32 arg_key_id = 0;
+    int64_t arg_value = 0;
   };
   struct ThreadInfo {
     uint32 tid;
@@ -103,6 +119,46 @@ class TraceMeRecorder {
   // Returns an activity_id for TraceMe::ActivityStart.
   static int64_t NewActivityId();
 
+  // Interns `name` and returns its id, which is never 0. Interning the same
+  // name again returns the same id. Interned names are never freed, so this
+  // must only be used for names from a small fixed set (e.g. literals).
+  static uint32 InternName(absl::string_view name);
+
+  // Returns the name interned as `name_id`, or "" if the id is unknown.
+  static absl::string_view InternedName(uint32 name_id);
+
+  // Returns the display name of `event`: its name, or its interned name, with
+  // the deferred argument appended as TraceMe metadata.
+  static std::string ResolveName(const Event& event);
+
+  // Starts "always-on" recording of TraceMe() with bounded memory. Only
+  // traces <= level are recorded. Instead of an unbounded queue, each thread
+  // records into a lock-free ring buffer of `events_per_thread` compact
+  // events (rounded up to a power of two) that overwrites its oldest events.
+  // Names longer than kMaxInlineNameSize bytes are truncated to the part
+  // before their metadata. Returns false if recording is already active.
+  static bool StartAlwaysOn(int level, size_t events_per_thread) {
+    return Get()->StartAlwaysOnRecording(level, events_per_thread);
+  }
+
+  // Returns whether always-on recording is active.
+  static bool AlwaysOn() {
+    return internal::g_always_on.load(std::memory_order_acquire);
+  }
+
+  // Returns the events that are currently in the ring buffers and started or
+  // ended at or after `since_ns`, without stopping always-on recording.
+  static Events Snapshot(int64_t since_ns = 0) {
+    return Get()->SnapshotRecording(since_ns);
+  }
+
+  // Stops always-on recording. The ring buffers are kept for reuse by the
+  // next StartAlwaysOn().
+  static void StopAlwaysOn() { Get()->StopAlwaysOnRecording(); }
+
+  // Longest name stored in the always-on ring buffers.
+  static constexpr size_t kMaxInlineNameSize = 80;
+
  private:
   class ThreadLocalRecorder;
   class ThreadLocalRecorderWrapper;
@@ -120,6 +176,10 @@ class TraceMeRecorder {
   bool StartRecording(int level);
   Events StopRecording();
 
+  bool StartAlwaysOnRecording(int level, size_t events_per_thread);
+  Events SnapshotRecording(int64_t since_ns);
+  void StopAlwaysOnRecording();
+
   // Clears events from all active threads that were added due to Record
   // racing with StopRecording.
   void Clear() TF_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -137,6 +197,10 @@ class TraceMeRecorder {
   // stops so the events can be retrieved.
   absl::flat_hash_map<uint32, std::shared_ptr<ThreadLocalRecorder>> threads_
       TF_GUARDED_BY(mutex_);
+
+  // Ring buffer capacity of each thread while always-on recording is active,
+  // 0 otherwise.
+  size_t always_on_events_per_thread_ TF_GUARDED_BY(mutex_) = 0;
 };
 
 }  // namespace profiler
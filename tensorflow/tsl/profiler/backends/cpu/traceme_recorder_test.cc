@@ -56,6 +56,97 @@ TEST(RecorderTest, SingleThreaded) {
               ElementsAre(Named("during1"), Named("during2")));
 }
 
+TEST(RecorderTest, InternedNames) {
+  uint32 name_id = TraceMeRecorder::InternName("interned");
+  uint32 key_id = TraceMeRecorder::InternName("key");
+  EXPECT_NE(name_id, 0);
+  EXPECT_NE(name_id, key_id);
+  EXPECT_EQ(TraceMeRecorder::InternName("interned"), name_id);
+  EXPECT_EQ(TraceMeRecorder::InternedName(name_id), "interned");
+
+  int64_t start_time = GetCurrentTimeNanos();
+  int64_t end_time = start_time + UniToNano(1);
+  TraceMeRecorder::Start(/*level=*/1);
+  TraceMeRecorder::Record({"", start_time, end_time, name_id});
+  TraceMeRecorder::Record(
+      {"", start_time, end_time, name_id, key_id, /*arg_value=*/42});
+  TraceMeRecorder::Record(
+      {"named#a=1#", start_time, end_time, 0, key_id, /*arg_value=*/-1});
+  auto results = TraceMeRecorder::Stop();
+
+  ASSERT_EQ(results.size(), 1);
+  ASSERT_EQ(results[0].events.size(), 3);
+  EXPECT_EQ(results[0].events[0].name_id, name_id);
+  EXPECT_EQ(TraceMeRecorder::ResolveName(results[0].events[0]), "interned");
+  EXPECT_EQ(TraceMeRecorder::ResolveName(results[0].events[1]),
+            "interned#key=42#");
+  EXPECT_EQ(TraceMeRecorder::ResolveName(results[0].events[2]),
+            "named#a=1,key=-1#");
+}
+
+TEST(RecorderTest, AlwaysOn) {
+  constexpr int kEventsPerThread = 16;
+  int64_t start_time = GetCurrentTimeNanos();
+  int64_t end_time = start_time + UniToNano(1);
+  uint32 name_id = TraceMeRecorder::InternName("interned");
+
+  ASSERT_TRUE(TraceMeRecorder::StartAlwaysOn(/*level=*/1, kEventsPerThread));
+  EXPECT_TRUE(TraceMeRecorder::AlwaysOn());
+  EXPECT_TRUE(TraceMeRecorder::Active());
+  EXPECT_FALSE(TraceMeRecorder::Start(/*level=*/1));
+  // Stop() does not stop always-on recording.
+  EXPECT_TRUE(TraceMeRecorder::Stop().empty());
+  EXPECT_TRUE(TraceMeRecorder::AlwaysOn());
+
+  // Only the most recent kEventsPerThread events are kept.
+  for (int i = 0; i < 3 * kEventsPerThread; ++i) {
+    TraceMeRecorder::Record({absl::StrCat(i), start_time, end_time});
+  }
+  auto results = TraceMeRecorder::Snapshot();
+  ASSERT_EQ(results.size(), 1);
+  ASSERT_EQ(results[0].events.size(), kEventsPerThread);
+  EXPECT_EQ(results[0].events.front().name, absl::StrCat(2 * kEventsPerThread));
+  EXPECT_EQ(results[0].events.back().name,
+            absl::StrCat(3 * kEventsPerThread - 1));
+
+  // Snapshots do not consume the events.
+  TraceMeRecorder::Record(
+      {"", start_time, end_time, name_id, name_id, /*arg_value=*/7});
+  results = TraceMeRecorder::Snapshot();
+  ASSERT_EQ(results.size(), 1);
+  ASSERT_EQ(results[0].events.size(), kEventsPerThread);
+  EXPECT_EQ(TraceMeRecorder::ResolveName(results[0].events.back()),
+            "interned#interned=7#");
+
+  // Long names are truncated to the name without metadata.
+  std::string long_name(2 * TraceMeRecorder::kMaxInlineNameSize, 'x');
+  TraceMeRecorder::Record(
+      {absl::StrCat("short#", long_name, "#"), start_time, end_time});
+  TraceMeRecorder::Record({long_name, start_time, end_time});
+  results = TraceMeRecorder::Snapshot();
+  ASSERT_EQ(results.size(), 1);
+  auto& events = results[0].events;
+  EXPECT_EQ(events[events.size() - 2].name, "short");
+  EXPECT_EQ(events.back().name,
+            long_name.substr(0, TraceMeRecorder::kMaxInlineNameSize));
+
+  // Split events are merged, events before since_ns are dropped.
+  int64_t split_start_time = end_time + 1;
+  int64_t split_end_time = split_start_time + UniToNano(1);
+  TraceMeRecorder::Record({"split", split_start_time, -5});
+  TraceMeRecorder::Record({"", -5, split_end_time});
+  results = TraceMeRecorder::Snapshot(/*since_ns=*/split_start_time);
+  ASSERT_EQ(results.size(), 1);
+  ASSERT_EQ(results[0].events.size(), 1);
+  EXPECT_EQ(results[0].events[0].name, "split");
+  EXPECT_TRUE(results[0].events[0].IsComplete());
+
+  TraceMeRecorder::StopAlwaysOn();
+  EXPECT_FALSE(TraceMeRecorder::AlwaysOn());
+  EXPECT_FALSE(TraceMeRecorder::Active());
+  EXPECT_TRUE(TraceMeRecorder::Snapshot().empty());
+}
+
 // Checks the functional behavior of the recorder, when used from several
 // unsynchronized threads.
 //
@@ -44,6 +44,8 @@ const char* GetContextTypeString(ContextType context_type) {
       return "tpu_stream";
     case ContextType::kTpuLaunch:
       return "tpu_launch";
+    case ContextType::kAlpaPipelineTransfer:
+      return "alpa_pipeline_transfer";
   }
 }
 
@@ -34,7 +34,8 @@ enum class ContextType : int {
   kBatcher,
   kTpuStream,
   kTpuLaunch,
-  kLastContextType = ContextType::kTpuLaunch,
+  kAlpaPipelineTransfer,
+  kLastContextType = ContextType::kAlpaPipelineTransfer,
 };
 
 // In XFlow we encode context type as flow category as 6 bits.
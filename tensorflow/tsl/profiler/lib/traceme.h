@@ -63,6 +63,27 @@ inline int GetTFTraceMeLevel(bool is_expensive) {
   return is_expensive ? kInfo : kVerbose;
 }
 
+// A TraceMe name (or metadata key) that is interned once, so that recording
+// it neither copies nor formats a string; the name is resolved when the trace
+// is collected. Interned names are never freed, so only use this for names
+// from a small fixed set, typically in a static:
+//   static const TraceMeName kName("MyActivity");
+//   TraceMe trace_me(kName);
+// The name must not contain TraceMe metadata.
+class TraceMeName {
+ public:
+  explicit TraceMeName(absl::string_view name) {
+#if !defined(IS_MOBILE_PLATFORM)
+    id_ = TraceMeRecorder::InternName(name);
+#endif
+  }
+
+  uint32 id() const { return id_; }
+
+ private:
+  uint32 id_ = 0;
+};
+
 // This class permits user-specified (CPU) tracing activities. A trace activity
 // is started when an object of this class is created and stopped when the
 // object is destroyed.
@@ -119,6 +140,19 @@ class TraceMe {
   // strings (e.g., result of StrCat) use the name_generator template.
   explicit TraceMe(const std::string& name, int level = 1) = delete;
 
+  // Constructor for an interned name. Cheaper than the other constructors
+  // when tracing is enabled, as the name is not copied.
+  explicit TraceMe(const TraceMeName& name, int level = 1) {
+    DCHECK_GE(level, 1);
+#if !defined(IS_MOBILE_PLATFORM)
+    if (TF_PREDICT_FALSE(TraceMeRecorder::Active(level))) {
+      new (&no_init_.name) std::string();
+      name_id_ = name.id();
+      start_time_ = GetCurrentTimeNanos();
+    }
+#endif
+  }
+
   // This overload is necessary to make TraceMe's with string literals work.
   // Otherwise, the name_generator template would be used.
   explicit TraceMe(const char* raw, int level = 1)
@@ -161,6 +195,9 @@ class TraceMe {
     if (TF_PREDICT_FALSE(other.start_time_ != kUntracedActivity)) {
       new (&no_init_.name) std::string(std::move(other.no_init_.name));
       other.no_init_.name.~string();
+      name_id_ = other.name_id_;
+      arg_key_id_ = other.arg_key_id_;
+      arg_value_ = other.arg_value_;
       start_time_ = std::exchange(other.start_time_, kUntracedActivity);
     }
 #endif
@@ -184,8 +221,9 @@ class TraceMe {
 #if !defined(IS_MOBILE_PLATFORM)
     if (TF_PREDICT_FALSE(start_time_ != kUntracedActivity)) {
       if (TF_PREDICT_TRUE(TraceMeRecorder::Active())) {
-        TraceMeRecorder::Record(
-            {std::move(no_init_.name), start_time_, GetCurrentTimeNanos()});
+        TraceMeRecorder::Record({std::move(no_init_.name), start_time_,
+                                 GetCurrentTimeNanos(), name_id_, arg_key_id_,
+                                 arg_value_});
       }
       no_init_.name.~string();
       start_time_ = kUntracedActivity;
@@ -210,6 +248,10 @@ class TraceMe {
 #if !defined(IS_MOBILE_PLATFORM)
     if (TF_PREDICT_FALSE(start_time_ != kUntracedActivity)) {
       if (TF_PREDICT_TRUE(TraceMeRecorder::Active())) {
+        if (name_id_ != 0) {
+          no_init_.name = std::string(TraceMeRecorder::InternedName(name_id_));
+          name_id_ = 0;
+        }
         traceme_internal::AppendMetadata(
             &no_init_.name,
             std::forward<MetadataGeneratorT>(metadata_generator)());
@@ -218,6 +260,28 @@ class TraceMe {
 #endif
   }
 
+  // Appends the metadata key=value to the TraceMe name, deferring the
+  // formatting of the value until the trace is collected. Only the first
+  // deferred value is stored unformatted; later ones are formatted eagerly.
+  // Example Usage:
+  //   static const TraceMeName kBytes("bytes");
+  //   trace_me.AppendDeferredMetadata(kBytes, num_bytes);
+  void AppendDeferredMetadata(const TraceMeName& key, int64_t value) {
+#if !defined(IS_MOBILE_PLATFORM)
+    if (TF_PREDICT_FALSE(start_time_ != kUntracedActivity)) {
+      if (TF_PREDICT_TRUE(arg_key_id_ == 0)) {
+        arg_key_id_ = key.id();
+        arg_value_ = value;
+        return;
+      }
+      AppendMetadata([&key, value]() {
+        return TraceMeEncode(
+            {{TraceMeRecorder::InternedName(key.id()), value}});
+      });
+    }
+#endif
+  }
+
   // Static API, for use when scoped objects are inconvenient.
 
   // Record the start time of an activity.
@@ -251,6 +315,19 @@ class TraceMe {
     return kUntracedActivity;
   }
 
+  // Same as ActivityStart above, an overload for an interned name.
+  static int64_t ActivityStart(const TraceMeName& name, int level = 1) {
+#if !defined(IS_MOBILE_PLATFORM)
+    if (TF_PREDICT_FALSE(TraceMeRecorder::Active(level))) {
+      int64_t activity_id = TraceMeRecorder::NewActivityId();
+      TraceMeRecorder::Record(
+          {std::string(), GetCurrentTimeNanos(), -activity_id, name.id()});
+      return activity_id;
+    }
+#endif
+    return kUntracedActivity;
+  }
+
   // Same as ActivityStart above, an overload for "const std::string&"
   static int64_t ActivityStart(const std::string& name, int level = 1) {
     return ActivityStart(absl::string_view(name), level);
@@ -318,6 +395,12 @@ class TraceMe {
   } no_init_;
 
   int64_t start_time_ = kUntracedActivity;
+
+  // Interned name and deferred metadata, see TraceMeName and
+  // AppendDeferredMetadata. Only valid while start_time_ is set.
+  uint32 name_id_ = 0;
+  uint32 arg_key_id_ = 0;
+  int64_t arg_value_ = 0;
 };
 
 // Whether OpKernel::TraceString will populate additional information for
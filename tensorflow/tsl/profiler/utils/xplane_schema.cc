@@ -286,6 +286,11 @@ const StatTypeMap& GetStatTypeMap() {
       {"hlo_category", kHloCategory},
       {"tf_op_name", kTfOpName},
       {"dma_stall_duration_ps", kDmaStallDurationPs},
+      // Alpa pipeline related.
+      {"pipeline_stage", kPipelineStage},
+      {"microbatch", kMicrobatch},
+      {"comm_key", kCommGroupKey},
+      {"peer_rank", kPeerRank},
   });
   DCHECK_EQ(stat_type_map->size(), kNumStatTypes);
   return *stat_type_map;
@@ -277,7 +277,12 @@ enum StatType {
   kSymbolId,
   kTfOpName,
   kDmaStallDurationPs,
-  kLastStatType = kDmaStallDurationPs
+  // Alpa pipeline related.
+  kPipelineStage,
+  kMicrobatch,
+  kCommGroupKey,
+  kPeerRank,
+  kLastStatType = kPeerRank
 };
 
 inline std::string TpuPlaneName(int32_t device_ordinal) {